@@ -9,6 +9,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #include "config.h"
 #include "compress.h"
@@ -89,13 +90,74 @@ struct CompressorConfig *Compressor_getConfig(struct Compressor *obj)
         return &obj->prefs;
 }
 
+/*! Determine the new gain from the peak of the current block (on a
+ *  scale of 0-32767) and the peak history, and record both
+ *
+ *  \param peakPos the position of the peak within the block
+ *  \param curGain the previous gain, may be adjusted
+ *  \param ramp the number of samples to ramp over, may be truncated
+ *  \return the new gain (1<<10 is unity)
+ */
+static int Compressor_gain(struct Compressor *obj, int peakVal,
+			   unsigned int peakPos,
+			   int *curGain, unsigned int *ramp)
+{
+	struct CompressorConfig *prefs = Compressor_getConfig(obj);
+	int *peaks = obj->peaks;
+	int slot = (obj->pos + 1) % obj->bufsz;
+	int newGain;
+	unsigned int i;
+
+	peaks[slot] = peakVal;
+
+	for (i = 0; i < obj->bufsz; i++)
+	{
+		if (peaks[i] > peakVal)
+		{
+			peakVal = peaks[i];
+			peakPos = 0;
+		}
+	}
+
+	//! Determine target gain
+	newGain = (1 << 10)*prefs->target/peakVal;
+
+	//! Adjust the gain with inertia from the previous gain value
+	newGain = (*curGain*((1 << prefs->smooth) - 1) + newGain)
+		>> prefs->smooth;
+
+	//! Make sure it's no more than the maximum gain value
+	if (newGain > (prefs->maxgain << 10))
+		newGain = prefs->maxgain << 10;
+
+	//! Make sure it's no less than 1:1
+	if (newGain < (1 << 10))
+		newGain = 1 << 10;
+
+	//! Make sure the adjusted gain won't cause clipping
+	if ((peakVal*newGain >> 10) > 32767)
+	{
+		newGain = (32767 << 10)/peakVal;
+		//! Truncate the ramp time
+		*ramp = peakPos;
+	}
+
+	//! Record the new gain
+	obj->gain[slot] = newGain;
+
+	if (!*ramp)
+		*ramp = 1;
+	if (!*curGain)
+		*curGain = 1 << 10;
+
+	return newGain;
+}
+
 void Compressor_Process_int16(struct Compressor *obj, int16_t *audio,
                               unsigned int count)
 {
-        struct CompressorConfig *prefs = Compressor_getConfig(obj);
 	int16_t *ap;
 	unsigned int i;
-        int *peaks = obj->peaks;
         int curGain = obj->gain[obj->pos];
         int newGain;
         int peakVal = 1;
@@ -117,48 +179,7 @@ void Compressor_Process_int16(struct Compressor *obj, int16_t *audio,
                         peakPos = i;
                 }
 	}
-	peaks[slot] = peakVal;
-
-
-	for (i = 0; i < obj->bufsz; i++)
-	{
-		if (peaks[i] > peakVal)
-		{
-			peakVal = peaks[i];
-			peakPos = 0;
-		}
-	}
-
-	//! Determine target gain
-	newGain = (1 << 10)*prefs->target/peakVal;
-
-        //! Adjust the gain with inertia from the previous gain value
-        newGain = (curGain*((1 << prefs->smooth) - 1) + newGain)
-                >> prefs->smooth;
-
-        //! Make sure it's no more than the maximum gain value
-        if (newGain > (prefs->maxgain << 10))
-                newGain = prefs->maxgain << 10;
-
-        //! Make sure it's no less than 1:1
-	if (newGain < (1 << 10))
-		newGain = 1 << 10;
-
-        //! Make sure the adjusted gain won't cause clipping
-        if ((peakVal*newGain >> 10) > 32767)
-        {
-                newGain = (32767 << 10)/peakVal;
-                //! Truncate the ramp time
-                ramp = peakPos;
-        }
-
-        //! Record the new gain
-        obj->gain[slot] = newGain;
-
-        if (!ramp)
-                ramp = 1;
-        if (!curGain)
-                curGain = 1 << 10;
+	newGain = Compressor_gain(obj, peakVal, peakPos, &curGain, &ramp);
 	delta = (newGain - curGain) / (int)ramp;
 
 	ap = audio;
@@ -190,3 +211,137 @@ void Compressor_Process_int16(struct Compressor *obj, int16_t *audio,
         obj->pos = slot;
 }
 
+/*! The int32 and float variants look for the peak block by block,
+ *  which keeps the inner loop free of branches; the ramp is truncated
+ *  to the start of the loudest block, a little earlier than the
+ *  exact peak position.
+ */
+#define PEAK_BLOCK 64
+
+void Compressor_Process_int32(struct Compressor *obj, int32_t *audio,
+			      unsigned int count)
+{
+	unsigned int i, b;
+	int curGain = obj->gain[obj->pos];
+	int newGain;
+	uint32_t peak = 0;
+	unsigned int peakPos = 0;
+	int slot = (obj->pos + 1) % obj->bufsz;
+	int *clipped = obj->clipped + slot;
+	unsigned int ramp = count;
+	int delta;
+	int peakVal;
+
+	for (b = 0; b < count; b += PEAK_BLOCK)
+	{
+		unsigned int end = count - b < PEAK_BLOCK ? count : b + PEAK_BLOCK;
+		uint32_t blockPeak = 0;
+
+		for (i = b; i < end; i++)
+		{
+			uint32_t val = audio[i] < 0
+				? -(uint32_t)audio[i] : (uint32_t)audio[i];
+			blockPeak = val > blockPeak ? val : blockPeak;
+		}
+
+		if (blockPeak > peak)
+		{
+			peak = blockPeak;
+			peakPos = b;
+		}
+	}
+
+	//! Scale the peak to 16 bit, rounding up
+	peakVal = (int)((peak + 0xffff) >> 16);
+	if (peakVal < 1)
+		peakVal = 1;
+
+	newGain = Compressor_gain(obj, peakVal, peakPos, &curGain, &ramp);
+	delta = (newGain - curGain) / (int)ramp;
+
+	*clipped = 0;
+	for (i = 0; i < count; i++)
+	{
+		//! The gain ramps linearly up to sample "ramp"
+		int gain = i <= ramp ? curGain + delta * (int)i : newGain;
+		int64_t sample = (int64_t)audio[i] * gain >> 10;
+
+		if (sample < INT32_MIN)
+		{
+			*clipped += (int)((INT32_MIN - sample) >> 16);
+			sample = INT32_MIN;
+		} else if (sample > INT32_MAX)
+		{
+			*clipped += (int)((sample - INT32_MAX) >> 16);
+			sample = INT32_MAX;
+		}
+
+		audio[i] = (int32_t)sample;
+	}
+
+	obj->pos = slot;
+}
+
+void Compressor_Process_float(struct Compressor *obj, float *audio,
+			      unsigned int count)
+{
+	unsigned int i, b;
+	int curGain = obj->gain[obj->pos];
+	int newGain;
+	float peak = 0;
+	unsigned int peakPos = 0;
+	int slot = (obj->pos + 1) % obj->bufsz;
+	int *clipped = obj->clipped + slot;
+	unsigned int ramp = count;
+	int peakVal;
+	float gain, step;
+
+	for (b = 0; b < count; b += PEAK_BLOCK)
+	{
+		unsigned int end = count - b < PEAK_BLOCK ? count : b + PEAK_BLOCK;
+		float blockPeak = 0;
+
+		for (i = b; i < end; i++)
+		{
+			float val = fabsf(audio[i]);
+			blockPeak = val > blockPeak ? val : blockPeak;
+		}
+
+		if (blockPeak > peak)
+		{
+			peak = blockPeak;
+			peakPos = b;
+		}
+	}
+
+	//! Scale the peak to 16 bit, rounding up; above full scale,
+	//! the gain is 1:1 anyway
+	peakVal = peak < 1.0f ? (int)ceilf(peak * 32767) : 32768;
+	if (peakVal < 1)
+		peakVal = 1;
+
+	newGain = Compressor_gain(obj, peakVal, peakPos, &curGain, &ramp);
+	gain = curGain / 1024.0f;
+	step = (float)(newGain - curGain) / (1024.0f * ramp);
+
+	*clipped = 0;
+	for (i = 0; i < count; i++)
+	{
+		float sample = audio[i] *
+			(i < ramp ? gain + step * i : newGain / 1024.0f);
+
+		if (sample < -1.0f)
+		{
+			*clipped += (int)((-1.0f - sample) * 32767);
+			sample = -1.0f;
+		} else if (sample > 1.0f)
+		{
+			*clipped += (int)((sample - 1.0f) * 32767);
+			sample = 1.0f;
+		}
+
+		audio[i] = sample;
+	}
+
+	obj->pos = slot;
+}
@@ -37,6 +37,12 @@ getOutputAudioFormat(AudioFormat inAudioFormat)
 	return out_audio_format;
 }
 
+AudioFormat
+getConfiguredAudioFormat()
+{
+	return configured_audio_format;
+}
+
 void initAudioConfig(void)
 {
 	const struct config_param *param = config_get_param(ConfigOption::AUDIO_OUTPUT_FORMAT);
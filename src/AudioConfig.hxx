@@ -25,6 +25,13 @@ struct AudioFormat;
 AudioFormat
 getOutputAudioFormat(AudioFormat inFormat);
 
+/**
+ * Returns the "audio_output_format" setting as a mask (undefined if
+ * not configured).
+ */
+AudioFormat
+getConfiguredAudioFormat();
+
 /* make sure initPlayerData is called before this function!! */
 void
 initAudioConfig();
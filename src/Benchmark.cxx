@@ -0,0 +1,143 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Benchmark.hxx"
+#include "Partition.hxx"
+#include "PerfStats.hxx"
+#include "SongLoader.hxx"
+#include "output/Internal.hxx"
+#include "system/Clock.hxx"
+#include "util/Error.hxx"
+
+#include <stdexcept>
+
+#include <stdio.h>
+
+static void
+PrintHistogram(const char *name, const LatencyHistogram &h)
+{
+	printf("%s_p50_us: %llu\n"
+	       "%s_p99_us: %llu\n"
+	       "%s_max_us: %llu\n",
+	       name, (unsigned long long)h.GetQuantile(500),
+	       name, (unsigned long long)h.GetQuantile(990),
+	       name, (unsigned long long)h.GetMax());
+}
+
+PipelineBenchmark::PipelineBenchmark(Partition &_partition)
+	:partition(_partition),
+	 /* line 0: not a "null" ConfigBlock, which would mean
+	    auto-detection */
+	 output_block(0)
+{
+	output_block.AddBlockParam("type", "null");
+	output_block.AddBlockParam("name", "benchmark");
+
+	/* consume chunks as fast as the pipeline delivers them */
+	output_block.AddBlockParam("sync", "no");
+}
+
+void
+PipelineBenchmark::ConfigureOutputs(EventLoop &event_loop)
+{
+	partition.outputs.Configure(event_loop, partition.pc, output_block);
+}
+
+void
+PipelineBenchmark::Start(const std::vector<const char *> &uris)
+{
+	/* no database and no client: all local files are allowed */
+	const SongLoader loader(nullptr, nullptr);
+
+	Error error;
+	for (const char *uri : uris) {
+		unsigned id;
+		try {
+			id = partition.AppendURI(loader, uri, error);
+		} catch (const std::exception &e) {
+			throw std::runtime_error(std::string(uri) + ": " +
+						 e.what());
+		}
+
+		if (id == 0)
+			throw std::runtime_error(std::string(uri) + ": " +
+						 error.GetMessage());
+	}
+
+	/* only the chunks of this run shall be measured */
+	perf_stats.chunk_latency.Reset();
+
+	partition.pc.send_silence = false;
+
+	start_time = MonotonicClockUS();
+	decoder_cpu_start = perf_stats.decoder_cpu;
+	player_cpu_start = partition.pc.thread.GetCPUTime();
+
+	const MultipleOutputs &outputs = partition.outputs;
+	for (unsigned i = 0, n = outputs.Size(); i != n; ++i)
+		output_cpu_start.push_back(outputs.Get(i).thread.GetCPUTime());
+
+	if (!partition.PlayPosition(0, error))
+		throw std::runtime_error(error.GetMessage());
+}
+
+bool
+PipelineBenchmark::CheckFinished()
+{
+	if (partition.playlist.playing)
+		return false;
+
+	Report();
+	return true;
+}
+
+void
+PipelineBenchmark::Report() const
+{
+	const double seconds = (MonotonicClockUS() - start_time) / 1000000.;
+	const double audio_seconds = partition.pc.GetTotalPlayTime();
+
+	printf("songs: %u\n", partition.playlist.GetLength());
+	printf("seconds: %.3f\n", seconds);
+	printf("audio_seconds: %.3f\n", audio_seconds);
+	if (seconds > 0)
+		printf("realtime: %.1f\n", audio_seconds / seconds);
+
+	printf("chunks: %llu\n",
+	       (unsigned long long)perf_stats.chunk_latency.GetCount());
+	PrintHistogram("chunk_latency", perf_stats.chunk_latency);
+
+	printf("cpu_decoder_us: %llu\n",
+	       (unsigned long long)(perf_stats.decoder_cpu - decoder_cpu_start));
+	printf("cpu_player_us: %llu\n",
+	       (unsigned long long)(partition.pc.thread.GetCPUTime() -
+				    player_cpu_start));
+
+	/* the output thread runs the filters and the output plugin */
+	const MultipleOutputs &outputs = partition.outputs;
+	for (unsigned i = 0, n = outputs.Size(); i != n; ++i)
+		printf("cpu_output_us: %llu\n",
+		       (unsigned long long)(outputs.Get(i).thread.GetCPUTime() -
+					    output_cpu_start[i]));
+
+	printf("player_underruns: %llu\n",
+	       (unsigned long long)perf_stats.player_underruns);
+	fflush(stdout);
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_BENCHMARK_HXX
+#define MPD_BENCHMARK_HXX
+
+#include "config/Block.hxx"
+
+#include <vector>
+
+#include <stdint.h>
+
+struct Partition;
+class EventLoop;
+
+/**
+ * The "--benchmark" mode: play a list of files through the real
+ * decoder, player and output threads into a "null" output which
+ * does not pace playback, and print how fast the pipeline was and
+ * how much CPU time each stage consumed.
+ */
+class PipelineBenchmark {
+	Partition &partition;
+
+	/**
+	 * The configuration of the "null" output; it must live as
+	 * long as the output.
+	 */
+	ConfigBlock output_block;
+
+	uint64_t start_time;
+
+	uint64_t decoder_cpu_start, player_cpu_start;
+
+	std::vector<uint64_t> output_cpu_start;
+
+public:
+	explicit PipelineBenchmark(Partition &_partition);
+
+	PipelineBenchmark(const PipelineBenchmark &) = delete;
+	PipelineBenchmark &operator=(const PipelineBenchmark &) = delete;
+
+	/**
+	 * Create the "null" output instead of the configured ones.
+	 */
+	void ConfigureOutputs(EventLoop &event_loop);
+
+	/**
+	 * Add the given files (absolute paths or URLs) to the queue
+	 * and start playing them.  Throws std::runtime_error on
+	 * error.
+	 */
+	void Start(const std::vector<const char *> &uris);
+
+	/**
+	 * Check whether playback has finished, and if so, print the
+	 * report to stdout.  Call this after an #IDLE_PLAYER event.
+	 *
+	 * @return true if the benchmark has finished
+	 */
+	bool CheckFinished();
+
+private:
+	void Report() const;
+};
+
+#endif
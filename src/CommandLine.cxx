@@ -75,6 +75,8 @@
 #define USER_CONFIG_FILE_LOCATION_XDG PATH_LITERAL("mpd/mpd.conf")
 #endif
 
+static constexpr OptionDef opt_benchmark(
+	"benchmark", "play the given files as fast as possible and exit");
 static constexpr OptionDef opt_kill(
 	"kill", "kill the currently running mpd session");
 static constexpr OptionDef opt_no_config(
@@ -259,12 +261,14 @@ static void help(void)
 {
 	printf("Usage:\n"
 	       "  mpd [OPTION...] [path/to/mpd.conf]\n"
+	       "  mpd --benchmark [OPTION...] [path/to/mpd.conf] FILE...\n"
 	       "\n"
 	       "Music Player Daemon - a daemon for playing music.\n"
 	       "\n"
 	       "Options:\n");
 
 	PrintOption(opt_help);
+	PrintOption(opt_benchmark);
 	PrintOption(opt_kill);
 	PrintOption(opt_no_config);
 	PrintOption(opt_no_daemon);
@@ -310,12 +314,21 @@ parse_cmdline(int argc, char **argv, struct options *options,
 	options->daemon = true;
 	options->log_stderr = false;
 	options->verbose = false;
+	options->benchmark = false;
 
 	// First pass: handle command line options
 	OptionParser parser(argc, argv);
 	while (parser.HasEntries()) {
 		if (!parser.ParseNext())
 			continue;
+		if (parser.CheckOption(opt_benchmark)) {
+			/* the report goes to stdout, log messages
+			   to stderr */
+			options->benchmark = true;
+			options->daemon = false;
+			options->log_stderr = true;
+			continue;
+		}
 		if (parser.CheckOption(opt_kill)) {
 			options->kill = true;
 			continue;
@@ -350,25 +363,38 @@ parse_cmdline(int argc, char **argv, struct options *options,
 	   parser can use it already */
 	log_early_init(options->verbose);
 
-	if (!use_config_file) {
+	if (!use_config_file && !options->benchmark) {
 		LogDebug(cmdline_domain,
 			 "Ignoring config, using daemon defaults");
 		return true;
 	}
 
-	// Second pass: find non-option parameters (i.e. config file)
+	// Second pass: find non-option parameters (i.e. config file
+	// and the files to be benchmarked)
 	const char *config_file = nullptr;
 	for (int i = 1; i < argc; ++i) {
 		if (OptionParser::IsOption(argv[i]))
 			continue;
-		if (config_file == nullptr) {
+		if (config_file == nullptr && use_config_file) {
 			config_file = argv[i];
 			continue;
 		}
+		if (options->benchmark) {
+			options->benchmark_uris.push_back(argv[i]);
+			continue;
+		}
 		error.Set(cmdline_domain, "too many arguments");
 		return false;
 	}
 
+	if (options->benchmark && options->benchmark_uris.empty()) {
+		error.Set(cmdline_domain, "no files to benchmark");
+		return false;
+	}
+
+	if (!use_config_file)
+		return true;
+
 	if (config_file != nullptr) {
 		/* use specified configuration file */
 #ifdef _UNICODE
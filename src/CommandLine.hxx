@@ -20,6 +20,8 @@
 #ifndef MPD_COMMAND_LINE_HXX
 #define MPD_COMMAND_LINE_HXX
 
+#include <vector>
+
 class Error;
 
 struct options {
@@ -27,6 +29,12 @@ struct options {
 	bool daemon;
 	bool log_stderr;
 	bool verbose;
+
+	/**
+	 * Play #benchmark_uris and exit, see #PipelineBenchmark.
+	 */
+	bool benchmark;
+	std::vector<const char *> benchmark_uris;
 };
 
 bool
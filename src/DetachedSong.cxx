@@ -29,7 +29,14 @@ DetachedSong::DetachedSong(const LightSong &other)
 	 tag(*other.tag),
 	 mtime(other.mtime),
 	 start_time(other.start_time),
-	 end_time(other.end_time) {}
+	 end_time(other.end_time)
+{
+	if (other.mix_ramp != nullptr)
+		mix_ramp = *other.mix_ramp;
+
+	if (other.replay_gain != nullptr)
+		replay_gain = *other.replay_gain;
+}
 
 DetachedSong::~DetachedSong()
 {
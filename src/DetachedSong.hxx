@@ -22,6 +22,8 @@
 
 #include "check.h"
 #include "tag/Tag.hxx"
+#include "MixRampInfo.hxx"
+#include "ReplayGainInfo.hxx"
 #include "Chrono.hxx"
 #include "Compiler.h"
 
@@ -76,6 +78,18 @@ class DetachedSong {
 	 */
 	SongTime end_time;
 
+	/**
+	 * MixRamp data from the database.  It is used if the decoder
+	 * does not find MixRamp tags in the file.
+	 */
+	MixRampInfo mix_ramp;
+
+	/**
+	 * ReplayGain data from the database.  It is used if the
+	 * decoder does not find ReplayGain tags in the file.
+	 */
+	ReplayGainInfo replay_gain = ReplayGainInfo::Undefined();
+
 	explicit DetachedSong(const LightSong &other);
 
 public:
@@ -220,6 +234,22 @@ public:
 		end_time = _value;
 	}
 
+	const MixRampInfo &GetMixRamp() const {
+		return mix_ramp;
+	}
+
+	void SetMixRamp(MixRampInfo &&_value) {
+		mix_ramp = std::move(_value);
+	}
+
+	const ReplayGainInfo &GetReplayGain() const {
+		return replay_gain;
+	}
+
+	void SetReplayGain(const ReplayGainInfo &_value) {
+		replay_gain = _value;
+	}
+
 	gcc_pure
 	SignedSongTime GetDuration() const;
 
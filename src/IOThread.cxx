@@ -20,96 +20,158 @@
 #include "config.h"
 #include "IOThread.hxx"
 #include "thread/Mutex.hxx"
-#include "thread/Cond.hxx"
 #include "thread/Thread.hxx"
 #include "thread/Name.hxx"
 #include "event/Loop.hxx"
 #include "system/FatalError.hxx"
 #include "util/Error.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
+#include <stdio.h>
+#include <string.h>
 
-static struct {
-	Mutex mutex;
-	Cond cond;
+static constexpr unsigned MAX_IO_THREADS = unsigned(IOThreadRole::MAX);
 
+struct IOThread {
 	EventLoop *loop;
 	Thread thread;
+	char name[16];
+};
+
+static struct {
+	Mutex mutex;
+
+	void (*init_func)(const char *name);
+
+	unsigned n_threads;
+	IOThread threads[MAX_IO_THREADS];
 } io;
 
+static IOThread &
+io_thread_for_role(IOThreadRole role)
+{
+	assert(io.n_threads > 0);
+
+	return io.threads[std::min(unsigned(role), io.n_threads - 1)];
+}
+
 void
 io_thread_run(void)
 {
-	assert(io_thread_inside());
-	assert(io.loop != nullptr);
+	assert(io.n_threads == 1);
+	assert(io.threads[0].thread.IsInside());
 
-	io.loop->Run();
+	io.threads[0].loop->Run();
 }
 
 static void
-io_thread_func(gcc_unused void *arg)
+io_thread_func(void *arg)
 {
-	SetThreadName("io");
+	IOThread &t = *(IOThread *)arg;
+
+	SetThreadName(t.name);
 
 	/* lock+unlock to synchronize with io_thread_start(), to be
-	   sure that io.thread is set */
+	   sure that t.thread is set */
 	io.mutex.lock();
 	io.mutex.unlock();
 
-	io_thread_run();
+	if (io.init_func != nullptr)
+		io.init_func(t.name);
+
+	t.loop->Run();
 }
 
 void
-io_thread_init(void)
+io_thread_init(unsigned n_threads)
 {
-	assert(io.loop == nullptr);
-	assert(!io.thread.IsDefined());
-
-	io.loop = new EventLoop();
+	assert(io.n_threads == 0);
+	assert(n_threads > 0);
+
+	static constexpr const char *role_names[MAX_IO_THREADS] = {
+		"input", "output", "misc",
+	};
+
+	io.n_threads = std::min(n_threads, MAX_IO_THREADS);
+	for (unsigned i = 0; i < io.n_threads; ++i) {
+		IOThread &t = io.threads[i];
+		assert(t.loop == nullptr);
+		assert(!t.thread.IsDefined());
+
+		t.loop = new EventLoop();
+
+		if (io.n_threads == 1)
+			strcpy(t.name, "io");
+		else
+			snprintf(t.name, sizeof(t.name), "io:%s",
+				 role_names[i]);
+	}
 }
 
 void
-io_thread_start()
+io_thread_start(void (*init_func)(const char *name))
 {
-	assert(io.loop != nullptr);
-	assert(!io.thread.IsDefined());
+	assert(io.n_threads > 0);
 
 	const ScopeLock protect(io.mutex);
 
-	Error error;
-	if (!io.thread.Start(io_thread_func, nullptr, error))
-		FatalError(error);
+	io.init_func = init_func;
+
+	for (unsigned i = 0; i < io.n_threads; ++i) {
+		IOThread &t = io.threads[i];
+		assert(!t.thread.IsDefined());
+
+		Error error;
+		if (!t.thread.Start(io_thread_func, &t, error))
+			FatalError(error);
+	}
 }
 
 void
 io_thread_quit(void)
 {
-	assert(io.loop != nullptr);
+	assert(io.n_threads > 0);
 
-	io.loop->Break();
+	for (unsigned i = 0; i < io.n_threads; ++i)
+		io.threads[i].loop->Break();
 }
 
 void
 io_thread_deinit(void)
 {
-	if (io.thread.IsDefined()) {
-		io_thread_quit();
-		io.thread.Join();
+	for (unsigned i = 0; i < io.n_threads; ++i) {
+		IOThread &t = io.threads[i];
+
+		if (t.thread.IsDefined()) {
+			t.loop->Break();
+			t.thread.Join();
+		}
+
+		delete t.loop;
+		t.loop = nullptr;
 	}
 
-	delete io.loop;
+	io.n_threads = 0;
 }
 
-EventLoop &
-io_thread_get()
+void
+io_thread_for_each(const std::function<void(const char *name,
+					    EventLoop &loop)> &f)
 {
-	assert(io.loop != nullptr);
+	for (unsigned i = 0; i < io.n_threads; ++i)
+		f(io.threads[i].name, *io.threads[i].loop);
+}
 
-	return *io.loop;
+EventLoop &
+io_thread_get(IOThreadRole role)
+{
+	return *io_thread_for_role(role).loop;
 }
 
 bool
-io_thread_inside(void)
+io_thread_inside(IOThreadRole role)
 {
-	return io.thread.IsInside();
+	return io_thread_for_role(role).thread.IsInside();
 }
@@ -22,25 +22,67 @@
 
 #include "Compiler.h"
 
+#include <functional>
+
 class EventLoop;
 
+/**
+ * The subsystems which may be given their own I/O thread.  With
+ * fewer threads than roles, the remaining roles share the last
+ * thread; the order puts the latency-critical input streams first,
+ * so they are the first to get a thread on their own.
+ */
+enum class IOThreadRole {
+	/**
+	 * Input streams (CURL, ALSA input), NFS and storage
+	 * plugins.  NFS storage and NFS input streams share their
+	 * connections, so they must run in the same thread.
+	 */
+	INPUT,
+
+	/**
+	 * Network output plugins (httpd).
+	 */
+	OUTPUT,
+
+	/**
+	 * Everything else, e.g. neighbor plugins.
+	 */
+	MISC,
+
+	MAX
+};
+
+/**
+ * Create the I/O event loops.
+ *
+ * @param n_threads the number of I/O threads; values larger than
+ * the number of #IOThreadRole values are clamped
+ */
 void
-io_thread_init();
+io_thread_init(unsigned n_threads=1);
 
+/**
+ * Start the I/O threads.
+ *
+ * @param init_func an optional function which is called in each
+ * new thread with its name (see SetThreadName()) before its
+ * #EventLoop runs
+ */
 void
-io_thread_start();
+io_thread_start(void (*init_func)(const char *name)=nullptr);
 
 /**
  * Run the I/O event loop synchronously in the current thread.  This
  * can be called instead of io_thread_start().  For testing purposes
- * only.
+ * only; works only with one I/O thread.
  */
 void
 io_thread_run();
 
 /**
- * Ask the I/O thread to quit, but does not wait for it.  Usually, you
- * don't need to call this function, because io_thread_deinit()
+ * Ask the I/O threads to quit, but does not wait for them.  Usually,
+ * you don't need to call this function, because io_thread_deinit()
  * includes this.
  */
 void
@@ -49,15 +91,23 @@ io_thread_quit();
 void
 io_thread_deinit();
 
-gcc_const
+/**
+ * Invoke a function for each I/O thread's #EventLoop, passing the
+ * thread name.
+ */
+void
+io_thread_for_each(const std::function<void(const char *name,
+					    EventLoop &loop)> &f);
+
+gcc_pure
 EventLoop &
-io_thread_get();
+io_thread_get(IOThreadRole role=IOThreadRole::MISC);
 
 /**
- * Is the current thread the I/O thread?
+ * Is the current thread the I/O thread of the given role?
  */
 gcc_pure
 bool
-io_thread_inside();
+io_thread_inside(IOThreadRole role=IOThreadRole::MISC);
 
 #endif
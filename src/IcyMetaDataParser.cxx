@@ -36,10 +36,12 @@ IcyMetaDataParser::Reset()
 	if (!IsDefined())
 		return;
 
-	if (data_rest == 0 && meta_size > 0)
-		delete[] meta_data;
-
 	delete tag;
+	tag = nullptr;
+
+	/* after rewinding, the first metadata block shall be
+	   reported again */
+	last_meta.clear();
 
 	data_rest = data_size;
 	meta_size = 0;
@@ -187,10 +189,8 @@ IcyMetaDataParser::Meta(const void *data, size_t length)
 		   return value */
 		--length;
 
-		/* initialize metadata reader, allocate enough
-		   memory (+1 for the null terminator) */
+		/* initialize metadata reader */
 		meta_position = 0;
-		meta_data = new char[meta_size + 1];
 	}
 
 	assert(meta_position < meta_size);
@@ -206,12 +206,16 @@ IcyMetaDataParser::Meta(const void *data, size_t length)
 		++length;
 
 	if (meta_position == meta_size) {
-		/* parse */
+		/* parse, unless the block has not changed; the
+		   assign() call reuses the std::string's buffer */
 
-		delete tag;
+		if (last_meta.size() != meta_size ||
+		    memcmp(last_meta.data(), meta_data, meta_size) != 0) {
+			last_meta.assign(meta_data, meta_size);
 
-		tag = icy_parse_tag(meta_data, meta_data + meta_size);
-		delete[] meta_data;
+			delete tag;
+			tag = icy_parse_tag(meta_data, meta_data + meta_size);
+		}
 
 		/* change back to normal data mode */
 
@@ -20,20 +20,40 @@
 #ifndef MPD_ICY_META_DATA_PARSER_HXX
 #define MPD_ICY_META_DATA_PARSER_HXX
 
+#include <string>
+
 #include <stddef.h>
 
 struct Tag;
 
 class IcyMetaDataParser {
+	/**
+	 * The maximum size of one metadata block: the length byte
+	 * counts 16 byte units.
+	 */
+	static constexpr size_t MAX_META_SIZE = 255 * 16;
+
 	size_t data_size, data_rest;
 
 	size_t meta_size, meta_position;
-	char *meta_data;
+
+	/**
+	 * The metadata block being received (plus a null
+	 * terminator).
+	 */
+	char meta_data[MAX_META_SIZE + 1];
+
+	/**
+	 * A copy of the most recent metadata block.  Radio streams
+	 * repeat the same title in every block; those are not parsed
+	 * again, and no new #Tag is built for them.
+	 */
+	std::string last_meta;
 
 	Tag *tag;
 
 public:
-	IcyMetaDataParser():data_size(0) {}
+	IcyMetaDataParser():data_size(0), tag(nullptr) {}
 	~IcyMetaDataParser() {
 		Reset();
 	}
@@ -45,6 +65,7 @@ public:
 	void Start(size_t _data_size) {
 		data_size = data_rest = _data_size;
 		meta_size = 0;
+		last_meta.clear();
 		tag = nullptr;
 	}
 
@@ -25,6 +25,7 @@
 #include "config.h"
 #include "IdleFlags.hxx"
 #include "util/ASCII.hxx"
+#include "util/Macros.hxx"
 
 #include <assert.h>
 
@@ -45,6 +46,9 @@ static const char *const idle_names[] = {
 	nullptr
 };
 
+static_assert(ARRAY_SIZE(idle_names) == NUM_IDLE_EVENTS + 1,
+	      "NUM_IDLE_EVENTS does not match idle_names");
+
 const char*const*
 idle_get_names(void)
 {
@@ -67,6 +67,11 @@ static constexpr unsigned IDLE_NEIGHBOR = 0x800;
 /** the mount list has changed */
 static constexpr unsigned IDLE_MOUNT = 0x1000;
 
+/**
+ * The number of idle events defined above.
+ */
+static constexpr unsigned NUM_IDLE_EVENTS = 13;
+
 /**
  * Get idle names
  */
@@ -26,6 +26,7 @@
 
 #ifdef ENABLE_DATABASE
 #include "db/DatabaseError.hxx"
+#include "db/ResponseCache.hxx"
 
 #ifdef ENABLE_SQLITE
 #include "sticker/StickerDatabase.hxx"
@@ -41,9 +42,28 @@ Instance::GetDatabase(Error &error)
 	if (database == nullptr)
 		error.Set(db_domain, int(DatabaseErrorCode::DISABLED),
 			  "No database");
+	else if (IsDatabaseLoading()) {
+		error.Set(db_domain, int(DatabaseErrorCode::LOADING),
+			  "Database is being loaded");
+		return nullptr;
+	}
+
 	return database;
 }
 
+void
+Instance::OnDatabaseLoaded()
+{
+	assert(database != nullptr);
+	assert(!IsDatabaseLoading());
+
+	/* fill in the tags of the songs restored from the state
+	   file, and emit the "database" idle event */
+	OnDatabaseModified();
+
+	partition->queue_resolver.Resume();
+}
+
 void
 Instance::OnDatabaseModified()
 {
@@ -51,7 +71,9 @@ Instance::OnDatabaseModified()
 
 	/* propagate the change to all subsystems */
 
+	++database_version;
 	stats_invalidate();
+	db_response_cache_invalidate();
 	partition->DatabaseModified(*database);
 }
 
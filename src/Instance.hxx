@@ -33,6 +33,7 @@ class NeighborGlue;
 #ifdef ENABLE_DATABASE
 #include "db/DatabaseListener.hxx"
 class Database;
+class DatabaseLoader;
 class Storage;
 class UpdateService;
 #endif
@@ -72,7 +73,7 @@ struct Instance final
 #endif
 
 #ifdef ENABLE_DATABASE
-	Database *database;
+	Database *database = nullptr;
 
 	/**
 	 * This is really a #CompositeStorage.  To avoid heavy include
@@ -81,13 +82,32 @@ struct Instance final
 	Storage *storage = nullptr;
 
 	UpdateService *update = nullptr;
+
+	/**
+	 * If not nullptr, then the #database is still being loaded
+	 * in a separate thread, and must not be accessed.
+	 */
+	DatabaseLoader *database_loader = nullptr;
+
+	/**
+	 * Incremented each time the database is modified.  Used to
+	 * detect stale cursors of database listing commands.
+	 */
+	unsigned database_version = 0;
 #endif
 
 	ClientList *client_list;
 
+	/**
+	 * The one and only partition.  Several zones (rooms, streams)
+	 * are configured as outputs of this partition: they all
+	 * consume the chunks of the same #MusicPipe, so each song is
+	 * fetched and decoded only once, no matter how many outputs
+	 * play it (see "align" and "encoder_group").
+	 */
 	Partition *partition;
 
-	StateFile *state_file;
+	StateFile *state_file = nullptr;
 
 	Instance()
 		:idle_monitor(event_loop, *this, &Instance::OnIdle) {}
@@ -107,9 +127,20 @@ struct Instance final
 	/**
 	 * Returns the global #Database instance.  May return nullptr
 	 * if this MPD configuration has no database (no
-	 * music_directory was configured).
+	 * music_directory was configured) or if the database is
+	 * still being loaded.
 	 */
 	Database *GetDatabase(Error &error);
+
+	bool IsDatabaseLoading() const {
+		return database_loader != nullptr;
+	}
+
+	/**
+	 * Called after the #DatabaseLoader has finished: notify all
+	 * subsystems that the #database is available now.
+	 */
+	void OnDatabaseLoaded();
 #endif
 
 private:
@@ -23,6 +23,17 @@
 #include "util/Domain.hxx"
 #include "util/StringUtil.hxx"
 
+#ifndef ANDROID
+#include "thread/Thread.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Name.hxx"
+#include "thread/Util.hxx"
+#include "util/Error.hxx"
+
+#include <atomic>
+#endif
+
 #include <assert.h>
 #include <stdio.h>
 #include <string.h>
@@ -57,6 +68,16 @@ ToAndroidLogLevel(LogLevel log_level)
 	gcc_unreachable();
 }
 
+void
+LogStartAsync()
+{
+}
+
+void
+LogStopAsync()
+{
+}
+
 #else
 
 static LogLevel log_threshold = LogLevel::INFO;
@@ -84,11 +105,20 @@ EnableLogTimestamp()
 	enable_timestamp = true;
 }
 
-static const char *log_date(void)
+/**
+ * The time stamp for a new log message (if enabled).
+ */
+static time_t
+LogTime()
+{
+	return enable_timestamp ? time(nullptr) : 0;
+}
+
+static const char *
+log_date(time_t t)
 {
 	static constexpr size_t LOG_DATE_BUF_SIZE = 16;
 	static char buf[LOG_DATE_BUF_SIZE];
-	time_t t = time(nullptr);
 	strftime(buf, LOG_DATE_BUF_SIZE, "%b %d %H:%M : ", localtime(&t));
 	return buf;
 }
@@ -155,10 +185,10 @@ LogFinishSysLog()
 #endif
 
 static void
-FileLog(const Domain &domain, const char *message)
+FileLog(const Domain &domain, const char *message, time_t t)
 {
 	fprintf(stderr, "%s%s: %.*s\n",
-		enable_timestamp ? log_date() : "",
+		enable_timestamp ? log_date(t) : "",
 		domain.GetName(),
 		chomp_length(message), message);
 
@@ -169,6 +199,292 @@ FileLog(const Domain &domain, const char *message)
 #endif
 }
 
+static void
+WriteLog(const Domain &domain, LogLevel level, const char *message,
+	 time_t t)
+{
+#ifdef HAVE_SYSLOG
+	if (enable_syslog) {
+		SysLog(domain, level, message);
+		return;
+	}
+#else
+	(void)level;
+#endif
+
+	FileLog(domain, message, t);
+}
+
+static constexpr Domain async_log_domain("log");
+
+/**
+ * A bounded lock-free ring buffer of log records (Dmitry Vyukov's
+ * bounded queue, with a single consumer) and the low-priority thread
+ * which writes them.  Log() never blocks on it: if the ring is full,
+ * the message is dropped and counted.
+ */
+class AsyncLog {
+	static constexpr size_t N_RECORDS = 256;
+
+	/**
+	 * Longer messages are truncated.
+	 */
+	static constexpr size_t MAX_MESSAGE = 480;
+
+	struct Record {
+		/**
+		 * Equals the write position for which this record is
+		 * free, and that position plus one after the record
+		 * has been filled.
+		 */
+		std::atomic<size_t> sequence;
+
+		const Domain *domain;
+		LogLevel level;
+		time_t time;
+		char message[MAX_MESSAGE];
+	};
+
+	Record records[N_RECORDS];
+
+	std::atomic<size_t> write_position{0};
+
+	/**
+	 * Only used by the writer thread.
+	 */
+	size_t read_position = 0;
+
+	/**
+	 * The number of messages which were dropped because the ring
+	 * was full.
+	 */
+	std::atomic<unsigned> dropped{0};
+
+	/**
+	 * Set by the writer thread before it waits for #cond.  A
+	 * producer only locks #mutex if this flag is set.
+	 */
+	std::atomic<bool> sleeping{false};
+
+	Mutex mutex;
+	Cond cond;
+
+	/**
+	 * Protected by #mutex.
+	 */
+	bool quit = false;
+
+	Thread thread;
+
+public:
+	AsyncLog() {
+		for (size_t i = 0; i < N_RECORDS; ++i)
+			records[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	bool Start(Error &error) {
+		return thread.Start(Run, this, error);
+	}
+
+	/**
+	 * Stop the thread and write all pending messages in the
+	 * current thread.
+	 */
+	void Stop();
+
+	void Push(const Domain &domain, LogLevel level, const char *message);
+
+private:
+	bool IsEmpty() const {
+		const Record &r = records[read_position % N_RECORDS];
+		return r.sequence.load(std::memory_order_acquire) !=
+			read_position + 1;
+	}
+
+	void Wake();
+
+	/**
+	 * Write the next record.
+	 *
+	 * @return false if the ring was empty
+	 */
+	bool WriteNext();
+
+	void WriteAll();
+
+	void Run();
+	static void Run(void *ctx);
+};
+
+void
+AsyncLog::Push(const Domain &domain, LogLevel level, const char *message)
+{
+	size_t position = write_position.load(std::memory_order_relaxed);
+	Record *r;
+
+	while (true) {
+		r = &records[position % N_RECORDS];
+		const size_t sequence =
+			r->sequence.load(std::memory_order_acquire);
+		const intptr_t diff = intptr_t(sequence) - intptr_t(position);
+
+		if (diff == 0) {
+			/* this record is free; claim it */
+			if (write_position.compare_exchange_weak(position,
+								 position + 1,
+								 std::memory_order_relaxed))
+				break;
+		} else if (diff < 0) {
+			/* the ring is full */
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		} else
+			/* another thread has claimed it */
+			position = write_position.load(std::memory_order_relaxed);
+	}
+
+	r->domain = &domain;
+	r->level = level;
+	r->time = LogTime();
+
+	size_t length = strlen(message);
+	if (length >= MAX_MESSAGE)
+		length = MAX_MESSAGE - 1;
+	memcpy(r->message, message, length);
+	r->message[length] = 0;
+
+	r->sequence.store(position + 1, std::memory_order_release);
+
+	Wake();
+}
+
+inline void
+AsyncLog::Wake()
+{
+	/* pairs with the fence in Run(): either we see the
+	   "sleeping" flag, or the writer sees the new record */
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	if (sleeping.load(std::memory_order_relaxed)) {
+		const ScopeLock protect(mutex);
+		cond.signal();
+	}
+}
+
+bool
+AsyncLog::WriteNext()
+{
+	if (IsEmpty())
+		return false;
+
+	Record &r = records[read_position % N_RECORDS];
+	WriteLog(*r.domain, r.level, r.message, r.time);
+
+	r.sequence.store(read_position + N_RECORDS,
+			 std::memory_order_release);
+	++read_position;
+	return true;
+}
+
+void
+AsyncLog::WriteAll()
+{
+	while (WriteNext()) {}
+
+	const unsigned n = dropped.exchange(0, std::memory_order_relaxed);
+	if (n > 0) {
+		char buffer[64];
+		snprintf(buffer, sizeof(buffer),
+			 "%u log messages dropped", n);
+		WriteLog(async_log_domain, LogLevel::WARNING, buffer,
+			 LogTime());
+	}
+}
+
+inline void
+AsyncLog::Run()
+{
+	SetThreadName("log");
+	SetThreadIdlePriority();
+
+	const ScopeLock protect(mutex);
+
+	while (!quit) {
+		mutex.unlock();
+		WriteAll();
+		mutex.lock();
+
+		if (quit)
+			break;
+
+		sleeping.store(true, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (IsEmpty())
+			cond.wait(mutex);
+
+		sleeping.store(false, std::memory_order_relaxed);
+	}
+}
+
+void
+AsyncLog::Run(void *ctx)
+{
+	AsyncLog &log = *(AsyncLog *)ctx;
+	log.Run();
+}
+
+void
+AsyncLog::Stop()
+{
+	mutex.lock();
+	quit = true;
+	cond.signal();
+	mutex.unlock();
+
+	thread.Join();
+
+	WriteAll();
+}
+
+/**
+ * Never freed, because other threads may still be inside
+ * AsyncLog::Push() when LogStopAsync() is called.
+ */
+static AsyncLog *async_log;
+
+/**
+ * Is #async_log running?
+ */
+static std::atomic<bool> async_log_enabled{false};
+
+void
+LogStartAsync()
+{
+	assert(!async_log_enabled);
+
+	if (async_log == nullptr)
+		async_log = new AsyncLog();
+
+	Error error;
+	if (!async_log->Start(error)) {
+		/* keep logging synchronously */
+		Log(async_log_domain, LogLevel::ERROR, error.GetMessage());
+		return;
+	}
+
+	async_log_enabled.store(true, std::memory_order_release);
+}
+
+void
+LogStopAsync()
+{
+	if (!async_log_enabled.exchange(false))
+		return;
+
+	async_log->Stop();
+}
+
 #endif /* !ANDROID */
 
 void
@@ -182,13 +498,11 @@ Log(const Domain &domain, LogLevel level, const char *msg)
 	if (level < log_threshold)
 		return;
 
-#ifdef HAVE_SYSLOG
-	if (enable_syslog) {
-		SysLog(domain, level, msg);
+	if (async_log_enabled.load(std::memory_order_acquire)) {
+		async_log->Push(domain, level, msg);
 		return;
 	}
-#endif
 
-	FileLog(domain, msg);
+	WriteLog(domain, level, msg, LogTime());
 #endif /* !ANDROID */
 }
@@ -35,4 +35,19 @@ LogInitSysLog();
 void
 LogFinishSysLog();
 
+/**
+ * Start a thread which writes log messages from now on; Log() only
+ * copies them into a lock-free ring buffer.  Must be called after
+ * the signal handlers have been set up.
+ */
+void
+LogStartAsync();
+
+/**
+ * Stop the thread started by LogStartAsync() after it has written
+ * all pending messages.  Log() is synchronous again afterwards.
+ */
+void
+LogStopAsync();
+
 #endif /* LOG_H */
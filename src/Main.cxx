@@ -24,19 +24,25 @@
 #include "PlaylistFile.hxx"
 #include "MusicChunk.hxx"
 #include "StateFile.hxx"
+#include "Benchmark.hxx"
 #include "player/Thread.hxx"
 #include "Mapper.hxx"
 #include "Permission.hxx"
 #include "Listen.hxx"
+#include "MetricsListen.hxx"
 #include "client/Client.hxx"
 #include "client/ClientList.hxx"
+#include "client/ClientThread.hxx"
 #include "command/AllCommands.hxx"
+#include "command/CommandWorker.hxx"
 #include "Partition.hxx"
 #include "tag/TagConfig.hxx"
+#include "tag/TagPool.hxx"
 #include "ReplayGainConfig.hxx"
 #include "Idle.hxx"
 #include "Log.hxx"
 #include "LogInit.hxx"
+#include "LogBackend.hxx"
 #include "input/Init.hxx"
 #include "event/Loop.hxx"
 #include "IOThread.hxx"
@@ -50,6 +56,8 @@
 #include "unix/SignalHandlers.hxx"
 #include "system/FatalError.hxx"
 #include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "util/MemStats.hxx"
 #include "thread/Slack.hxx"
 #include "lib/icu/Init.hxx"
 #include "config/ConfigGlobal.hxx"
@@ -58,6 +66,10 @@
 #include "config/ConfigOption.hxx"
 #include "config/ConfigError.hxx"
 #include "Stats.hxx"
+#include "ThreadSettings.hxx"
+#include "StartupTasks.hxx"
+#include "system/Clock.hxx"
+#include "system/Trace.hxx"
 
 #ifdef ENABLE_DAEMON
 #include "unix/Daemon.hxx"
@@ -66,6 +78,7 @@
 #ifdef ENABLE_DATABASE
 #include "db/update/Service.hxx"
 #include "db/Configured.hxx"
+#include "db/DatabaseLoader.hxx"
 #include "db/DatabasePlugin.hxx"
 #include "db/plugins/simple/SimpleDatabasePlugin.hxx"
 #include "storage/Configured.hxx"
@@ -81,12 +94,17 @@
 
 #ifdef ENABLE_SQLITE
 #include "sticker/StickerDatabase.hxx"
+#include "util/SplitString.hxx"
 #endif
 
 #ifdef ENABLE_ARCHIVE
 #include "archive/ArchiveList.hxx"
 #endif
 
+#ifdef ENABLE_ENCODER
+#include "decoder/RenderCache.hxx"
+#endif
+
 #ifdef ANDROID
 #include "java/Global.hxx"
 #include "java/File.hxx"
@@ -101,6 +119,8 @@
 #include <systemd/sd-daemon.h>
 #endif
 
+#include <stdexcept>
+
 #include <stdlib.h>
 
 #ifdef HAVE_LOCALE_H
@@ -121,12 +141,29 @@
 static constexpr unsigned DEFAULT_BUFFER_SIZE = 4096;
 static constexpr unsigned DEFAULT_BUFFER_BEFORE_PLAY = 10;
 
+/**
+ * In the "low_memory" mode, the decoder does not buffer more than
+ * this duration of audio, no matter how large the audio buffer is.
+ */
+static constexpr SongTime LOW_MEMORY_BUFFER_TIME = SongTime::FromS(2u);
+
+/**
+ * In the "low_memory" mode, the tag pool hash tables do not grow
+ * beyond this number of buckets.
+ */
+static constexpr size_t LOW_MEMORY_TAG_POOL_BUCKETS = 4096;
+
 #ifdef ANDROID
 Context *context;
 #endif
 
 Instance *instance;
 
+/**
+ * Non-nullptr in the "--benchmark" mode.
+ */
+static PipelineBenchmark *benchmark;
+
 #ifdef ENABLE_DAEMON
 
 static bool
@@ -164,7 +201,7 @@ glue_mapper_init(Error &error)
 static bool
 InitStorage(Error &error)
 {
-	Storage *storage = CreateConfiguredStorage(io_thread_get(), error);
+	Storage *storage = CreateConfiguredStorage(io_thread_get(IOThreadRole::INPUT), error);
 	if (storage == nullptr)
 		return !error.IsDefined();
 
@@ -177,11 +214,10 @@ InitStorage(Error &error)
 }
 
 /**
- * Returns the database.  If this function returns false, this has not
- * succeeded, and the caller should create the database after the
- * process has been daemonized.
+ * Create the database.  A #SimpleDatabase is not loaded here; that
+ * happens later in a separate thread, see StartDatabaseLoader().
  */
-static bool
+static void
 glue_db_init_and_load(void)
 {
 	Error error;
@@ -192,7 +228,7 @@ glue_db_init_and_load(void)
 		if (error.IsDefined())
 			FatalError(error);
 		else
-			return true;
+			return;
 	}
 
 	if (instance->database->GetPlugin().flags & DatabasePlugin::FLAG_REQUIRE_STORAGE) {
@@ -205,7 +241,7 @@ glue_db_init_and_load(void)
 			LogDefault(config_domain,
 				   "Found database setting without "
 				   "music_directory - disabling database");
-			return true;
+			return;
 		}
 	} else {
 		if (IsStorageConfigured())
@@ -214,25 +250,98 @@ glue_db_init_and_load(void)
 				   "because the database does not need it");
 	}
 
-	instance->database->Open();
-
-	if (!instance->database->IsPlugin(simple_db_plugin))
-		return true;
+	if (!instance->database->IsPlugin(simple_db_plugin)) {
+		instance->database->Open();
+		return;
+	}
 
 	SimpleDatabase &db = *(SimpleDatabase *)instance->database;
 	instance->update = new UpdateService(instance->event_loop, db,
 					     static_cast<CompositeStorage &>(*instance->storage),
-					     *instance);
-
-	/* run database update after daemonization? */
-	return db.FileExists();
+					     *instance,
+					     &instance->partition->pc);
 }
 
-static bool
+static void
 InitDatabaseAndStorage()
 {
-	const bool create_db = !glue_db_init_and_load();
-	return create_db;
+	glue_db_init_and_load();
+}
+
+#ifdef ENABLE_INOTIFY
+/**
+ * The "auto_update" settings; they are applied by OnDatabaseLoaded().
+ */
+static bool auto_update;
+static unsigned auto_update_depth;
+static unsigned auto_update_budget;
+static bool auto_update_fanotify;
+#endif
+
+/**
+ * Called after the #SimpleDatabase has been loaded: recreate the
+ * database if there was no database file, and start watching the
+ * music directory.
+ */
+static void
+OnDatabaseLoaded()
+{
+	if (instance->database_loader != nullptr) {
+		delete instance->database_loader;
+		instance->database_loader = nullptr;
+
+		instance->OnDatabaseLoaded();
+	}
+
+	SimpleDatabase &db = *(SimpleDatabase *)instance->database;
+	if (!db.FileExists()) {
+		/* the database failed to load: recreate the
+		   database */
+		unsigned job = instance->update->Enqueue("", true);
+		if (job == 0)
+			FatalError("directory update failed");
+	}
+
+#ifdef ENABLE_INOTIFY
+	if (auto_update && instance->storage != nullptr)
+		mpd_inotify_init(instance->event_loop,
+				 *instance->storage,
+				 *instance->update,
+				 auto_update_depth,
+				 auto_update_budget,
+				 auto_update_fanotify);
+#endif
+}
+
+/**
+ * Load the #SimpleDatabase in a separate thread, so clients can
+ * connect and the restored queue can be played while it is being
+ * loaded.  Must be called after the process has been daemonized.
+ */
+static void
+StartDatabaseLoader()
+{
+	if (instance->update == nullptr)
+		/* no database, or not a SimpleDatabase (which has
+		   been opened already) */
+		return;
+
+	auto *loader = new DatabaseLoader(instance->event_loop,
+					  *instance->database,
+					  OnDatabaseLoaded);
+
+	Error error;
+	if (!loader->Start(error)) {
+		LogError(error);
+		delete loader;
+
+		/* fall back to loading it synchronously */
+		instance->database->Open();
+		OnDatabaseLoaded();
+		return;
+	}
+
+	instance->database_loader = loader;
 }
 
 #endif
@@ -252,8 +361,17 @@ glue_sticker_init(void)
 		return;
 	}
 
-	if (!sticker_global_init(std::move(sticker_file), error))
+	const char *synchronous =
+		config_get_string(ConfigOption::STICKER_SYNCHRONOUS, "normal");
+
+	if (!sticker_global_init(std::move(sticker_file), synchronous, error))
 		FatalError(error);
+
+	const char *cache = config_get_string(ConfigOption::STICKER_CACHE);
+	if (cache != nullptr)
+		for (const auto &name : SplitString(cache, ','))
+			if (!name.empty())
+				sticker_enable_cache(name.c_str());
 #endif
 }
 
@@ -280,7 +398,11 @@ glue_state_file_init(Error &error)
 		config_get_unsigned(ConfigOption::STATE_FILE_INTERVAL,
 				    StateFile::DEFAULT_INTERVAL);
 
+	const bool snapshot =
+		config_get_bool(ConfigOption::STATE_FILE_SNAPSHOT, false);
+
 	instance->state_file = new StateFile(std::move(path_fs), interval,
+					     snapshot,
 					     *instance->partition,
 					     instance->event_loop);
 	instance->state_file->Read();
@@ -329,15 +451,33 @@ initialize_decoder_and_player(void)
 
 	buffer_size *= 1024;
 
-	const unsigned buffered_chunks = buffer_size / CHUNK_SIZE;
+	const size_t chunk_size =
+		config_get_positive(ConfigOption::AUDIO_CHUNK_SIZE,
+				    CHUNK_SIZE / 1024) * size_t(1024);
+	if (chunk_size < CHUNK_SIZE || chunk_size > MAX_CHUNK_SIZE)
+		FormatFatalError("chunk size \"%lu\" is out of range",
+				 (unsigned long)chunk_size);
+
+	const unsigned buffered_chunks = buffer_size / chunk_size;
+
+	if (buffered_chunks == 0)
+		FormatFatalError("buffer size \"%lu\" is smaller than "
+				 "the chunk size",
+				 (unsigned long)buffer_size);
 
 	if (buffered_chunks >= 1 << 15)
 		FormatFatalError("buffer size \"%lu\" is too big",
 				 (unsigned long)buffer_size);
 
 	float perc;
+	bool adaptive_buffering = false;
 	param = config_get_param(ConfigOption::BUFFER_BEFORE_PLAY);
-	if (param != nullptr) {
+	if (param != nullptr && param->value == "auto") {
+		/* the static default is still used for sources which
+		   have not been measured yet */
+		adaptive_buffering = true;
+		perc = DEFAULT_BUFFER_BEFORE_PLAY;
+	} else if (param != nullptr) {
 		char *test;
 		perc = strtod(param->value.c_str(), &test);
 		if (*test != '%' || perc < 0 || perc > 100) {
@@ -353,6 +493,38 @@ initialize_decoder_and_player(void)
 	if (buffered_before_play > buffered_chunks)
 		buffered_before_play = buffered_chunks;
 
+	HugeAllocateOptions buffer_options;
+	buffer_options.huge_pages =
+		config_get_bool(ConfigOption::AUDIO_BUFFER_HUGE_PAGES, false);
+	buffer_options.lock =
+		config_get_bool(ConfigOption::AUDIO_BUFFER_LOCK, false);
+	buffer_options.prefault =
+		config_get_bool(ConfigOption::AUDIO_BUFFER_PREFAULT, false);
+
+	const unsigned history_chunks =
+		config_get_unsigned(ConfigOption::AUDIO_BUFFER_HISTORY, 0)
+		* size_t(1024) / chunk_size;
+	if (history_chunks > buffered_chunks / 2)
+		FatalError("audio_buffer_history is larger than half of "
+			   "audio_buffer_size");
+
+	const unsigned crossfade_chunks =
+		config_get_unsigned(ConfigOption::CROSSFADE_BUFFER_SIZE, 0)
+		* size_t(1024) / chunk_size;
+	if (buffered_chunks + crossfade_chunks >= 1 << 15)
+		FatalError("crossfade_buffer_size is too big");
+
+	const SongTime prefetch_time =
+		SongTime::FromS(config_get_unsigned(ConfigOption::PREFETCH_NEXT_SONG,
+						    0));
+	const unsigned prefetch_songs =
+		config_get_unsigned(ConfigOption::PREFETCH_SONGS, 0);
+
+	const SongTime max_buffer_time =
+		config_get_bool(ConfigOption::LOW_MEMORY, false)
+		? LOW_MEMORY_BUFFER_TIME
+		: SongTime::zero();
+
 	const unsigned max_length =
 		config_get_positive(ConfigOption::MAX_PLAYLIST_LENGTH,
 				    DEFAULT_PLAYLIST_MAX_LENGTH);
@@ -360,7 +532,15 @@ initialize_decoder_and_player(void)
 	instance->partition = new Partition(*instance,
 					    max_length,
 					    buffered_chunks,
-					    buffered_before_play);
+					    crossfade_chunks,
+					    chunk_size,
+					    buffer_options,
+					    buffered_before_play,
+					    adaptive_buffering,
+					    max_buffer_time,
+					    prefetch_time,
+					    prefetch_songs,
+					    history_chunks);
 }
 
 void
@@ -373,6 +553,10 @@ Instance::OnIdle(unsigned flags)
 	if (flags & (IDLE_PLAYLIST|IDLE_PLAYER|IDLE_MIXER|IDLE_OUTPUT) &&
 	    state_file != nullptr)
 		state_file->CheckModified();
+
+	if ((flags & IDLE_PLAYER) && benchmark != nullptr &&
+	    benchmark->CheckFinished())
+		Shutdown();
 }
 
 #ifndef ANDROID
@@ -390,6 +574,14 @@ int main(int argc, char *argv[])
 
 static int mpd_main_after_fork(struct options);
 
+/**
+ * The MonotonicClockMS() value when mpd_main() was entered; used to
+ * log the total startup time.
+ */
+static unsigned startup_begin_ms;
+
+static constexpr Domain startup_domain("startup");
+
 #ifdef ANDROID
 static inline
 #endif
@@ -398,6 +590,8 @@ int mpd_main(int argc, char *argv[])
 	struct options options;
 	Error error;
 
+	startup_begin_ms = MonotonicClockMS();
+
 #ifdef ENABLE_DAEMON
 	daemonize_close_stdin();
 #endif
@@ -416,7 +610,6 @@ int mpd_main(int argc, char *argv[])
 	}
 
 	winsock_init();
-	io_thread_init();
 	config_global_init();
 
 	try {
@@ -424,6 +617,8 @@ int mpd_main(int argc, char *argv[])
 		(void)argc;
 		(void)argv;
 
+		options.benchmark = false;
+
 		const auto sdcard = Environment::getExternalStorageDirectory();
 		if (!sdcard.IsNull()) {
 			const auto config_path =
@@ -457,8 +652,43 @@ int mpd_main(int argc, char *argv[])
 		return EXIT_FAILURE;
 	}
 
+	try {
+		thread_settings_global_init();
+	} catch (const std::exception &e) {
+		LogError(e);
+		return EXIT_FAILURE;
+	}
+
+	ApplyThreadSettings("main");
+
+	const bool low_memory =
+		config_get_bool(ConfigOption::LOW_MEMORY, false);
+	if (config_get_bool(ConfigOption::MEMORY_ACCOUNTING, low_memory))
+		mem_stats_enable();
+
+	if (low_memory)
+		tag_pool_set_max_buckets(LOW_MEMORY_TAG_POOL_BUCKETS);
+
+	if (config_get_param(ConfigOption::TRACE_FILE) != nullptr)
+		trace_enable(config_get_positive(ConfigOption::TRACE_BUFFER_SIZE,
+						 65536));
+
+	io_thread_init(config_get_positive(ConfigOption::IO_THREADS, 1));
+
 	instance = new Instance();
 
+	const unsigned stall_threshold =
+		config_get_unsigned(ConfigOption::EVENT_LOOP_STALL_THRESHOLD, 0);
+	if (stall_threshold > 0) {
+		instance->event_loop.EnableStallDetector("main",
+							 stall_threshold);
+		io_thread_for_each([stall_threshold](const char *name,
+						     EventLoop &loop){
+				loop.EnableStallDetector(name,
+							 stall_threshold);
+			});
+	}
+
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 	instance->neighbors = new NeighborGlue();
 	if (!instance->neighbors->Init(io_thread_get(), *instance, error)) {
@@ -478,8 +708,15 @@ int mpd_main(int argc, char *argv[])
 
 	initialize_decoder_and_player();
 
-	if (!listen_global_init(instance->event_loop, *instance->partition,
-				error)) {
+	if (options.benchmark)
+		/* no clients in the benchmark mode; this allows
+		   running it next to a MPD instance with the same
+		   configuration */
+		benchmark = new PipelineBenchmark(*instance->partition);
+	else if (!listen_global_init(instance->event_loop,
+				     *instance->partition, error) ||
+		 !metrics_listen_init(instance->event_loop, *instance,
+				      error)) {
 		LogError(error);
 		return EXIT_FAILURE;
 	}
@@ -518,38 +755,60 @@ try {
 	}
 
 	initPermissions();
-	spl_global_init();
+	spl_global_init(instance->event_loop);
+
+	/* these subsystems do not depend on each other (apart from
+	   the playlist plugins), so they are initialized
+	   concurrently; this hides the latency of slow plugin and
+	   output device probing */
+	StartupTasks startup;
+
 #ifdef ENABLE_ARCHIVE
-	archive_plugin_init_all();
+	startup.Add("archive", archive_plugin_init_all);
 #endif
 
-	if (!pcm_convert_global_init(error)) {
-		LogError(error);
-		return EXIT_FAILURE;
-	}
+	const auto pcm = startup.Add("pcm", [](){
+			Error error2;
+			if (!pcm_convert_global_init(error2))
+				throw std::runtime_error(error2.GetMessage());
+		});
 
-	decoder_plugin_init_all();
+	const auto decoder = startup.Add("decoder", decoder_plugin_init_all);
+
+#ifdef ENABLE_ENCODER
+	startup.Add("render_cache", render_cache_global_init, {decoder});
+#endif
+
+	startup.Add("output", [](){
+			initAudioConfig();
+			if (benchmark != nullptr)
+				benchmark->ConfigureOutputs(instance->event_loop);
+			else
+				instance->partition->outputs.Configure(instance->event_loop,
+								       instance->partition->pc);
+		}, {pcm});
+
+	const auto input = startup.Add("input", [](){
+			Error error2;
+			if (!input_stream_global_init(error2))
+				throw std::runtime_error(error2.GetMessage());
+		});
+
+	startup.Add("playlist", playlist_list_global_init, {decoder, input});
+
+	startup.Run();
 
 #ifdef ENABLE_DATABASE
-	const bool create_db = InitDatabaseAndStorage();
+	if (benchmark == nullptr)
+		InitDatabaseAndStorage();
 #endif
 
 	glue_sticker_init();
 
 	command_init();
-	initAudioConfig();
-	instance->partition->outputs.Configure(instance->event_loop,
-					       instance->partition->pc);
 	client_manager_init();
 	replay_gain_global_init();
 
-	if (!input_stream_global_init(error)) {
-		LogError(error);
-		return EXIT_FAILURE;
-	}
-
-	playlist_list_global_init();
-
 #ifdef ENABLE_DAEMON
 	daemonize_commit();
 #endif
@@ -560,7 +819,21 @@ try {
 	SignalHandlersInit(instance->event_loop);
 #endif
 
-	io_thread_start();
+	io_thread_start([](const char *name){
+			ApplyThreadSettings(name);
+		});
+
+	/* the worker threads must be started after
+	   SignalHandlersInit(), so they inherit the blocked signal
+	   mask */
+	if (config_get_bool(ConfigOption::LOG_ASYNC, false))
+		LogStartAsync();
+
+	command_worker_init(config_get_unsigned(ConfigOption::COMMAND_THREADS,
+						2));
+	client_threads_init(instance->event_loop,
+			    config_get_unsigned(ConfigOption::CLIENT_THREADS,
+						0));
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 	if (instance->neighbors != nullptr &&
@@ -568,50 +841,49 @@ try {
 		FatalError(error);
 #endif
 
-	ZeroconfInit(instance->event_loop);
+	if (benchmark == nullptr)
+		ZeroconfInit(instance->event_loop);
 
 	StartPlayerThread(instance->partition->pc);
 
-#ifdef ENABLE_DATABASE
-	if (create_db) {
-		/* the database failed to load: recreate the
-		   database */
-		unsigned job = instance->update->Enqueue("", true);
-		if (job == 0)
-			FatalError("directory update failed");
-	}
-#endif
-
-	if (!glue_state_file_init(error)) {
-		LogError(error);
-		return EXIT_FAILURE;
-	}
-
-	instance->partition->outputs.SetReplayGainMode(replay_gain_get_real_mode(instance->partition->playlist.queue.random));
-
 #ifdef ENABLE_DATABASE
 	if (config_get_bool(ConfigOption::AUTO_UPDATE, false)) {
 #ifdef ENABLE_INOTIFY
-		if (instance->storage != nullptr &&
-		    instance->update != nullptr)
-			mpd_inotify_init(instance->event_loop,
-					 *instance->storage,
-					 *instance->update,
-					 config_get_unsigned(ConfigOption::AUTO_UPDATE_DEPTH,
-							     INT_MAX));
+		auto_update = true;
+		auto_update_depth =
+			config_get_unsigned(ConfigOption::AUTO_UPDATE_DEPTH,
+					    INT_MAX);
+		auto_update_budget =
+			config_get_positive(ConfigOption::AUTO_UPDATE_BUDGET,
+					    16);
+		auto_update_fanotify =
+			config_get_bool(ConfigOption::AUTO_UPDATE_FANOTIFY,
+					false);
 #else
 		FormatWarning(config_domain,
 			      "inotify: auto_update was disabled. enable during compilation phase");
 #endif
 	}
+
+	StartDatabaseLoader();
 #endif
 
+	if (benchmark == nullptr && !glue_state_file_init(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	instance->partition->outputs.SetReplayGainMode(replay_gain_get_real_mode(instance->partition->playlist.queue.random));
+
 	config_global_check();
 
 	/* enable all audio outputs (if not already done by
 	   playlist_state_restore() */
 	instance->partition->pc.LockUpdateAudio();
 
+	if (benchmark != nullptr)
+		benchmark->Start(options.benchmark_uris);
+
 #ifdef WIN32
 	win32_app_started();
 #endif
@@ -624,6 +896,9 @@ try {
 	sd_notify(0, "READY=1");
 #endif
 
+	FormatInfo(startup_domain, "ready after %u ms",
+		   unsigned(MonotonicClockMS() - startup_begin_ms));
+
 	/* run the main loop */
 	instance->event_loop.Run();
 
@@ -633,6 +908,8 @@ try {
 
 	/* cleanup */
 
+	client_threads_finish();
+
 #if defined(ENABLE_DATABASE) && defined(ENABLE_INOTIFY)
 	mpd_inotify_finish();
 
@@ -645,10 +922,16 @@ try {
 		delete instance->state_file;
 	}
 
+	spl_global_finish();
+
 	instance->partition->pc.Kill();
 	ZeroconfDeinit();
-	listen_global_finish();
+	if (benchmark == nullptr) {
+		metrics_listen_finish();
+		listen_global_finish();
+	}
 	delete instance->client_list;
+	command_worker_finish();
 
 #ifdef ENABLE_NEIGHBOR_PLUGINS
 	if (instance->neighbors != nullptr) {
@@ -658,6 +941,10 @@ try {
 #endif
 
 #ifdef ENABLE_DATABASE
+	/* wait for the database loader thread (if it's still
+	   running) */
+	delete instance->database_loader;
+
 	delete instance->update;
 
 	if (instance->database != nullptr) {
@@ -682,11 +969,17 @@ try {
 	DeinitFS();
 
 	delete instance->partition;
+	delete benchmark;
+	benchmark = nullptr;
 	command_finish();
+#ifdef ENABLE_ENCODER
+	render_cache_global_finish();
+#endif
 	decoder_plugin_deinit_all();
 #ifdef ENABLE_ARCHIVE
 	archive_plugin_deinit_all();
 #endif
+	thread_settings_global_finish();
 	config_global_finish();
 	io_thread_deinit();
 #ifndef ANDROID
@@ -695,6 +988,8 @@ try {
 	delete instance;
 	instance = nullptr;
 
+	trace_finish();
+
 #ifdef ENABLE_DAEMON
 	daemonize_finish();
 #endif
@@ -705,6 +1000,7 @@ try {
 
 	IcuFinish();
 
+	LogStopAsync();
 	log_deinit();
 	return EXIT_SUCCESS;
 } catch (const std::exception &e) {
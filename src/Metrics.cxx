@@ -0,0 +1,427 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Metric names and their meaning are part of the interface and must
+ * not be changed, because monitoring systems depend on them.
+ */
+
+#include "config.h"
+#include "Metrics.hxx"
+#include "PerfStats.hxx"
+#include "Instance.hxx"
+#include "Partition.hxx"
+#include "IOThread.hxx"
+#include "client/ClientList.hxx"
+#include "event/Loop.hxx"
+#include "input/InputMetrics.hxx"
+#include "output/MultipleOutputs.hxx"
+#include "output/Internal.hxx"
+#include "util/MemStats.hxx"
+#include "system/MemInfo.hxx"
+#include "Compiler.h"
+
+#ifdef ENABLE_DATABASE
+#include "db/update/Service.hxx"
+#endif
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include <stdarg.h>
+#include <stdio.h>
+
+class MetricsWriter {
+	std::string buffer;
+
+public:
+	gcc_printf(2, 3)
+	void Format(const char *fmt, ...) {
+		char line[1024];
+
+		va_list ap;
+		va_start(ap, fmt);
+		int length = vsnprintf(line, sizeof(line), fmt, ap);
+		va_end(ap);
+
+		if (length > 0)
+			buffer.append(line,
+				      std::min(size_t(length), sizeof(line) - 1));
+	}
+
+	void Header(const char *name, const char *type, const char *help) {
+		Format("# HELP mpd_%s %s\n"
+		       "# TYPE mpd_%s %s\n",
+		       name, help, name, type);
+	}
+
+	void Value(const char *name, const char *labels, uint64_t value) {
+		Format("mpd_%s%s %llu\n", name, labels,
+		       (unsigned long long)value);
+	}
+
+	void Value(const char *name, const char *labels, double value) {
+		Format("mpd_%s%s %.6f\n", name, labels, value);
+	}
+
+	void Metric(const char *name, const char *type, const char *help,
+		    uint64_t value) {
+		Header(name, type, help);
+		Value(name, "", value);
+	}
+
+	/**
+	 * Write a #LatencyHistogram measured in microseconds as a
+	 * summary in seconds.
+	 *
+	 * @param labels a label list without the braces, may be
+	 * empty
+	 */
+	void Summary(const char *name, const std::string &labels,
+		     const LatencyHistogram &h) {
+		const char *comma = labels.empty() ? "" : ",";
+
+		Format("mpd_%s{%s%squantile=\"0.5\"} %.6f\n"
+		       "mpd_%s{%s%squantile=\"0.99\"} %.6f\n"
+		       "mpd_%s_sum%s%s%s %.6f\n"
+		       "mpd_%s_count%s%s%s %llu\n",
+		       name, labels.c_str(), comma, h.GetQuantile(500) / 1e6,
+		       name, labels.c_str(), comma, h.GetQuantile(990) / 1e6,
+		       name, labels.empty() ? "" : "{", labels.c_str(),
+		       labels.empty() ? "" : "}", h.GetSum() / 1e6,
+		       name, labels.empty() ? "" : "{", labels.c_str(),
+		       labels.empty() ? "" : "}",
+		       (unsigned long long)h.GetCount());
+	}
+
+	std::string Commit() {
+		return std::move(buffer);
+	}
+};
+
+/**
+ * Build a label list (without braces) with one label, escaping the
+ * value as required by the exposition format.
+ */
+static std::string
+MakeLabel(const char *name, const char *value)
+{
+	std::string result(name);
+	result += "=\"";
+
+	for (const char *p = value; *p != 0; ++p) {
+		switch (*p) {
+		case '\\':
+			result += "\\\\";
+			break;
+
+		case '"':
+			result += "\\\"";
+			break;
+
+		case '\n':
+			result += "\\n";
+			break;
+
+		default:
+			result.push_back(*p);
+		}
+	}
+
+	result.push_back('"');
+	return result;
+}
+
+static const char *
+ToString(PlayerState state)
+{
+	switch (state) {
+	case PlayerState::STOP:
+		break;
+
+	case PlayerState::PAUSE:
+		return "pause";
+
+	case PlayerState::PLAY:
+		return "play";
+	}
+
+	return "stop";
+}
+
+static void
+ExportPlayer(MetricsWriter &w, Partition &partition)
+{
+	const PerfStats &s = perf_stats;
+
+	const auto status = partition.pc.LockGetStatus();
+
+	w.Header("player_state", "gauge",
+		 "1 for the current state of the player.");
+	for (const auto state : {PlayerState::STOP, PlayerState::PAUSE,
+				 PlayerState::PLAY}) {
+		const std::string labels = "{" +
+			MakeLabel("state", ToString(state)) + "}";
+		w.Value("player_state", labels.c_str(),
+			uint64_t(status.state == state));
+	}
+
+	w.Header("player_elapsed_seconds", "gauge",
+		 "Position in the current song.");
+	w.Value("player_elapsed_seconds", "",
+		status.elapsed_time.ToDoubleS());
+
+	w.Header("player_play_seconds_total", "counter",
+		 "Time spent playing.");
+	w.Value("player_play_seconds_total", "",
+		partition.pc.GetTotalPlayTime());
+
+	w.Metric("queue_length", "gauge", "Number of songs in the queue.",
+		 partition.playlist.GetLength());
+
+	w.Metric("player_underruns_total", "counter",
+		 "Times the player had no decoded audio while the decoder was running.",
+		 s.player_underruns);
+
+	w.Header("player_buffering_seconds", "summary",
+		 "Duration of each wait for buffer_before_play.");
+	w.Summary("player_buffering_seconds", std::string(),
+		  s.player_buffering);
+
+	w.Header("pipe_fill_chunks", "summary",
+		 "Number of chunks in the music pipe, sampled by the player.");
+	w.Format("mpd_pipe_fill_chunks{quantile=\"0.5\"} %llu\n"
+		 "mpd_pipe_fill_chunks{quantile=\"0.99\"} %llu\n"
+		 "mpd_pipe_fill_chunks_sum %llu\n"
+		 "mpd_pipe_fill_chunks_count %llu\n",
+		 (unsigned long long)s.pipe_fill.GetQuantile(500),
+		 (unsigned long long)s.pipe_fill.GetQuantile(990),
+		 (unsigned long long)s.pipe_fill.GetSum(),
+		 (unsigned long long)s.pipe_fill.GetCount());
+
+	w.Header("chunk_latency_seconds", "summary",
+		 "Time from decoding a chunk until all outputs have played it.");
+	w.Summary("chunk_latency_seconds", std::string(), s.chunk_latency);
+
+	w.Metric("decoder_chunks_total", "counter",
+		 "Chunks submitted by the decoder.",
+		 s.decoder_chunks);
+
+	w.Header("decoder_cpu_seconds_total", "counter",
+		 "CPU time consumed by the decoder thread.");
+	w.Value("decoder_cpu_seconds_total", "", s.decoder_cpu / 1e6);
+
+	w.Header("decoder_buffer_wait_seconds", "summary",
+		 "Time the decoder waited for a free chunk.");
+	w.Summary("decoder_buffer_wait_seconds", std::string(),
+		  s.decoder_buffer_wait);
+
+	w.Metric("decoder_cache_hits_total", "counter",
+		 "Hits in the persistent decoder caches.",
+		 s.decoder_cache_hits);
+	w.Metric("decoder_cache_misses_total", "counter",
+		 "Misses in the persistent decoder caches.",
+		 s.decoder_cache_misses);
+}
+
+static void
+ExportOutputs(MetricsWriter &w, const MultipleOutputs &outputs)
+{
+	const unsigned n = outputs.Size();
+
+	/* all samples of one metric must be grouped, therefore this
+	   iterates the outputs once per metric */
+	auto each = [&outputs, n](const std::function<void(const AudioOutput &,
+							     const std::string &)> &f){
+		for (unsigned i = 0; i < n; ++i) {
+			const AudioOutput &ao = outputs.Get(i);
+			f(ao, MakeLabel("output", ao.name));
+		}
+	};
+
+	w.Header("output_enabled", "gauge", "1 if the output is enabled.");
+	each([&w](const AudioOutput &ao, const std::string &labels){
+			w.Value("output_enabled", ("{" + labels + "}").c_str(),
+				uint64_t(ao.enabled));
+		});
+
+	w.Header("output_bytes_total", "counter",
+		 "Bytes of audio consumed by the output plugin.");
+	each([&w](const AudioOutput &ao, const std::string &labels){
+			w.Value("output_bytes_total",
+				("{" + labels + "}").c_str(),
+				ao.bytes_played.load(std::memory_order_relaxed));
+		});
+
+	w.Header("output_xruns_total", "counter",
+		 "Buffer underruns reported by the device.");
+	each([&w](const AudioOutput &ao, const std::string &labels){
+			w.Value("output_xruns_total",
+				("{" + labels + "}").c_str(),
+				ao.device_xruns.load(std::memory_order_relaxed));
+		});
+
+	w.Header("output_listeners", "gauge",
+		 "Clients connected to a streaming output.");
+	each([&w](const AudioOutput &ao, const std::string &labels){
+			w.Value("output_listeners",
+				("{" + labels + "}").c_str(),
+				uint64_t(ao.listeners.load(std::memory_order_relaxed)));
+		});
+
+	w.Header("output_latency_seconds", "gauge",
+		 "Audio queued in the device which has not been heard yet.");
+	each([&w](const AudioOutput &ao, const std::string &labels){
+			w.Value("output_latency_seconds",
+				("{" + labels + "}").c_str(),
+				ao.GetCurrentLatency() / 1e6);
+		});
+
+	w.Header("output_play_seconds", "summary",
+		 "Duration of each call to the output plugin.");
+	each([&w](const AudioOutput &ao, const std::string &labels){
+			w.Summary("output_play_seconds", labels,
+				  ao.play_duration);
+		});
+}
+
+static void
+ExportInputs(MetricsWriter &w)
+{
+	const auto totals = input_metrics_totals();
+
+	w.Metric("input_streams_total", "counter",
+		 "Remote input streams which have been opened.",
+		 totals.streams);
+	w.Metric("input_open_streams", "gauge",
+		 "Remote input streams which are open.",
+		 totals.open_streams);
+	w.Metric("input_bytes_total", "counter",
+		 "Bytes received by remote input streams.",
+		 totals.bytes);
+	w.Metric("input_underruns_total", "counter",
+		 "Reads which had to wait for data from the network.",
+		 totals.underruns);
+
+	w.Header("input_underrun_seconds_total", "counter",
+		 "Time spent waiting for data from the network.");
+	w.Value("input_underrun_seconds_total", "",
+		totals.underrun_us / 1e6);
+}
+
+static void
+ExportEventLoops(MetricsWriter &w, const EventLoop &main_loop)
+{
+	std::vector<const EventLoopStats *> loops;
+
+	auto add = [&loops](const EventLoop &loop){
+		const EventLoopStats *stats = loop.GetStats();
+		if (stats != nullptr)
+			loops.push_back(stats);
+	};
+
+	add(main_loop);
+	io_thread_for_each([&add](gcc_unused const char *name,
+				  EventLoop &loop){
+			add(loop);
+		});
+
+	if (loops.empty())
+		/* event_loop_stall_threshold is not configured */
+		return;
+
+	w.Header("event_loop_stalls_total", "counter",
+		 "Handlers which exceeded event_loop_stall_threshold.");
+	for (const auto *stats : loops)
+		w.Value("event_loop_stalls_total",
+			("{" + MakeLabel("loop", stats->name) + "}").c_str(),
+			stats->stalls.load(std::memory_order_relaxed));
+
+	w.Header("event_loop_iteration_seconds", "summary",
+		 "Duration of each event loop iteration.");
+	for (const auto *stats : loops)
+		w.Summary("event_loop_iteration_seconds",
+			  MakeLabel("loop", stats->name),
+			  stats->iterations);
+}
+
+static void
+ExportMemory(MetricsWriter &w)
+{
+	const int64_t available = GetAvailableMemory();
+	if (available >= 0) {
+		w.Header("memory_available_bytes", "gauge",
+			 "Memory available to new allocations system-wide.");
+		w.Value("memory_available_bytes", "", uint64_t(available));
+	}
+
+	const double pressure = GetMemoryPressure();
+	if (pressure >= 0) {
+		w.Header("memory_pressure_ratio", "gauge",
+			 "Share of time stalled on memory (10s average).");
+		w.Value("memory_pressure_ratio", "", pressure / 100);
+	}
+
+	if (!mem_stats_enabled)
+		return;
+
+	w.Header("memory_bytes", "gauge",
+		 "Memory allocated per subsystem.");
+	for (unsigned i = 0; i < unsigned(MemStatsCategory::MAX); ++i) {
+		const auto category = MemStatsCategory(i);
+		const std::string labels = "{" +
+			MakeLabel("category", mem_stats_name(category)) + "}";
+		w.Value("memory_bytes", labels.c_str(),
+			uint64_t(mem_stats_get(category).bytes));
+	}
+}
+
+std::string
+metrics_export(Instance &instance)
+{
+	MetricsWriter w;
+
+	w.Header("info", "gauge", "Information about the MPD build.");
+	w.Value("info",
+		("{" + MakeLabel("version", VERSION) + "}").c_str(),
+		uint64_t(1));
+
+	w.Metric("clients", "gauge", "Connected clients.",
+		 instance.client_list->GetSize());
+	w.Metric("clients_max", "gauge", "The max_connections setting.",
+		 instance.client_list->GetMaxSize());
+
+#ifdef ENABLE_DATABASE
+	w.Header("update_running", "gauge",
+		 "1 while the database is being updated.");
+	w.Value("update_running", "",
+		uint64_t(instance.update != nullptr &&
+			 instance.update->GetId() != 0));
+#endif
+
+	Partition &partition = *instance.partition;
+	ExportPlayer(w, partition);
+	ExportOutputs(w, partition.outputs);
+	ExportInputs(w);
+	ExportEventLoops(w, instance.event_loop);
+	ExportMemory(w);
+
+	return w.Commit();
+}
@@ -0,0 +1,311 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "MetricsListen.hxx"
+#include "Metrics.hxx"
+#include "config/Param.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "event/ServerSocket.hxx"
+#include "event/FullyBufferedSocket.hxx"
+#include "event/TimeoutMonitor.hxx"
+#include "net/SocketAddress.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "util/DeleteDisposer.hxx"
+#include "Log.hxx"
+
+#include <boost/intrusive/list.hpp>
+
+#include <string.h>
+#include <stdio.h>
+
+static constexpr Domain metrics_domain("metrics");
+
+/**
+ * Close connections which have not sent a complete request after
+ * this number of milliseconds.
+ */
+static constexpr unsigned METRICS_TIMEOUT_MS = 10000;
+
+class MetricsListener;
+
+/**
+ * One HTTP connection to the metrics listener.  It reads one
+ * request, sends the response and closes the connection.
+ */
+class MetricsConnection final
+	: FullyBufferedSocket, TimeoutMonitor,
+	  public boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> {
+	MetricsListener &listener;
+
+	/**
+	 * Has the response been submitted?  The connection is closed
+	 * as soon as it has been sent.
+	 */
+	bool responded = false;
+
+public:
+	MetricsConnection(MetricsListener &_listener, EventLoop &_loop,
+			  int _fd)
+		:FullyBufferedSocket(_fd, _loop, 4096, 1024 * 1024),
+		 TimeoutMonitor(_loop),
+		 listener(_listener) {
+		TimeoutMonitor::Schedule(METRICS_TIMEOUT_MS);
+	}
+
+	~MetricsConnection() {
+		if (FullyBufferedSocket::IsDefined())
+			FullyBufferedSocket::Close();
+	}
+
+private:
+	/**
+	 * Remove this object from the listener and delete it.
+	 */
+	void Destroy();
+
+	/**
+	 * @return false if the connection has been closed
+	 */
+	bool SendResponse(const char *status, const std::string &body,
+			  bool head=false);
+
+	/**
+	 * Handle the request line.
+	 *
+	 * @return false if the connection has been closed
+	 */
+	bool HandleRequest(char *line);
+
+	/* virtual methods from class BufferedSocket */
+	InputResult OnSocketInput(void *data, size_t length) override;
+	void OnSocketError(Error &&error) override;
+	void OnSocketClosed() override;
+
+	/* virtual methods from class FullyBufferedSocket */
+	bool OnSocketDrained() override;
+
+	/* virtual methods from class TimeoutMonitor */
+	void OnTimeout() override {
+		Destroy();
+	}
+};
+
+class MetricsListener final : public ServerSocket {
+	Instance &instance;
+
+	typedef boost::intrusive::list<MetricsConnection,
+				       boost::intrusive::constant_time_size<false>> ConnectionList;
+
+	ConnectionList connections;
+
+public:
+	MetricsListener(EventLoop &_loop, Instance &_instance)
+		:ServerSocket(_loop), instance(_instance) {}
+
+	~MetricsListener() {
+		connections.clear_and_dispose(DeleteDisposer());
+	}
+
+	Instance &GetInstance() {
+		return instance;
+	}
+
+	void Remove(MetricsConnection &connection) {
+		connections.erase_and_dispose(connections.iterator_to(connection),
+					      DeleteDisposer());
+	}
+
+private:
+	void OnAccept(int fd, gcc_unused SocketAddress address,
+		      gcc_unused int uid) override {
+		auto *connection = new MetricsConnection(*this,
+							 GetEventLoop(), fd);
+		connections.push_front(*connection);
+	}
+};
+
+static MetricsListener *metrics_listener;
+
+void
+MetricsConnection::Destroy()
+{
+	listener.Remove(*this);
+}
+
+bool
+MetricsConnection::SendResponse(const char *status, const std::string &body,
+				bool head)
+{
+	char header[256];
+	snprintf(header, sizeof(header),
+		 "HTTP/1.0 %s\r\n"
+		 "Content-Type: text/plain; version=0.0.4\r\n"
+		 "Content-Length: %lu\r\n"
+		 "Connection: close\r\n"
+		 "\r\n",
+		 status, (unsigned long)body.length());
+
+	responded = true;
+
+	return Write(header, strlen(header)) &&
+		(head || Write(body.data(), body.length()));
+}
+
+bool
+MetricsConnection::HandleRequest(char *line)
+{
+	/* "METHOD PATH HTTP/1.x"; the headers are ignored */
+	char *path = strchr(line, ' ');
+	if (path == nullptr)
+		return SendResponse("400 Bad Request", "Bad request\n");
+
+	*path++ = 0;
+
+	char *end = strchr(path, ' ');
+	if (end != nullptr)
+		*end = 0;
+
+	const bool head = strcmp(line, "HEAD") == 0;
+	if (!head && strcmp(line, "GET") != 0)
+		return SendResponse("405 Method Not Allowed",
+				    "Method not allowed\n");
+	else if (strcmp(path, "/metrics") != 0)
+		return SendResponse("404 Not Found", "Not found\n");
+	else
+		return SendResponse("200 OK",
+				    metrics_export(listener.GetInstance()),
+				    head);
+}
+
+BufferedSocket::InputResult
+MetricsConnection::OnSocketInput(void *data, size_t length)
+{
+	if (responded) {
+		/* ignore everything after the request */
+		ConsumeInput(length);
+		return InputResult::MORE;
+	}
+
+	char *p = (char *)data;
+
+	/* wait for the end of the request header; if it does not
+	   fit into the input buffer, BufferedSocket fails */
+	if (memmem(p, length, "\r\n\r\n", 4) == nullptr)
+		return InputResult::MORE;
+
+	ConsumeInput(length);
+	TimeoutMonitor::Cancel();
+
+	*strchr(p, '\r') = 0;
+	return HandleRequest(p)
+		? InputResult::MORE
+		: InputResult::CLOSED;
+}
+
+void
+MetricsConnection::OnSocketError(Error &&error)
+{
+	FormatDebug(metrics_domain, "%s", error.GetMessage());
+	Destroy();
+}
+
+void
+MetricsConnection::OnSocketClosed()
+{
+	Destroy();
+}
+
+bool
+MetricsConnection::OnSocketDrained()
+{
+	if (!responded)
+		return true;
+
+	Destroy();
+	return false;
+}
+
+static bool
+metrics_add_config_param(unsigned port, const config_param *param,
+			 Error &error)
+{
+	if (strcmp(param->value.c_str(), "any") == 0)
+		return metrics_listener->AddPort(port, error);
+	else if (param->value[0] == '/' || param->value[0] == '~') {
+		auto path = config_parse_path(param, error);
+		return !path.IsNull() &&
+			metrics_listener->AddPath(std::move(path), error);
+	} else
+		return metrics_listener->AddHost(param->value.c_str(), port,
+						 error);
+}
+
+bool
+metrics_listen_init(EventLoop &loop, Instance &instance, Error &error)
+{
+	const unsigned port = config_get_unsigned(ConfigOption::METRICS_PORT,
+						  0);
+	if (port == 0)
+		/* disabled */
+		return true;
+
+	metrics_listener = new MetricsListener(loop, instance);
+
+	const config_param *param =
+		config_get_param(ConfigOption::METRICS_BIND_TO_ADDRESS);
+	if (param != nullptr) {
+		do {
+			if (!metrics_add_config_param(port, param, error)) {
+				metrics_listen_finish();
+				error.FormatPrefix("Failed to listen on %s (line %i): ",
+						   param->value.c_str(),
+						   param->line);
+				return false;
+			}
+		} while ((param = param->next) != nullptr);
+	} else {
+		/* the metrics reveal what is being played; by default,
+		   they are only available to the local host */
+		if (!metrics_listener->AddHost("localhost", port, error)) {
+			metrics_listen_finish();
+			error.FormatPrefix("Failed to listen on localhost:%u: ",
+					   port);
+			return false;
+		}
+	}
+
+	if (!metrics_listener->Open(error)) {
+		metrics_listen_finish();
+		return false;
+	}
+
+	FormatDebug(metrics_domain, "metrics listener on port %u", port);
+	return true;
+}
+
+void
+metrics_listen_finish()
+{
+	delete metrics_listener;
+	metrics_listener = nullptr;
+}
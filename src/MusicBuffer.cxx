@@ -21,33 +21,181 @@
 #include "MusicBuffer.hxx"
 #include "MusicChunk.hxx"
 #include "system/FatalError.hxx"
+#include "util/Domain.hxx"
+#include "util/MemStats.hxx"
+#include "Log.hxx"
+
+#include <new>
 
 #include <assert.h>
 
-MusicBuffer::MusicBuffer(unsigned num_chunks)
-	:buffer(num_chunks) {
-	if (buffer.IsOOM())
+static constexpr Domain music_buffer_domain("music_buffer");
+
+static constexpr uint64_t
+MakeHead(uint64_t old_head, uint32_t index)
+{
+	return (((old_head >> 32) + 1) << 32) | index;
+}
+
+inline size_t
+MusicBuffer::GetChunkAllocationSize() const
+{
+	return sizeof(MusicChunk) + chunk_size;
+}
+
+MusicBuffer::MusicBuffer(unsigned num_chunks, size_t _chunk_size,
+			 const HugeAllocateOptions &options)
+	:n_max(num_chunks), chunk_size(_chunk_size),
+	 resident(options.lock || options.prefault),
+	 chunks_allocation(HugeAllocate(num_chunks * sizeof(MusicChunk),
+					options)),
+	 chunks((MusicChunk *)chunks_allocation.data),
+	 data_allocation(HugeAllocate(num_chunks * chunk_size, options)),
+	 data((uint8_t *)data_allocation.data),
+	 next(new std::atomic<uint32_t>[num_chunks]),
+	 head(0), n_initialized(0), n_allocated(0), n_failures(0) {
+	assert(n_max > 0);
+	assert(chunk_size >= CHUNK_SIZE);
+	assert(chunk_size <= MAX_CHUNK_SIZE);
+
+	if (chunks == nullptr || data == nullptr)
 		FatalError("Failed to allocate buffer");
+
+	/* without "resident", the memory is only accounted for after
+	   a chunk has been touched */
+	MemStatsAllocate(MemStatsCategory::MUSIC_BUFFER,
+			 resident ? n_max * GetChunkAllocationSize() : 0);
+
+	if (options.lock && !data_allocation.locked)
+		LogWarning(music_buffer_domain,
+			   "Failed to lock the audio buffer into memory");
+
+	FormatInfo(music_buffer_domain,
+		   "audio buffer: %u chunks of %lu bytes, page size %lu%s",
+		   n_max, (unsigned long)chunk_size,
+		   (unsigned long)data_allocation.page_size,
+		   data_allocation.locked ? ", locked" : "");
+}
+
+MusicBuffer::~MusicBuffer()
+{
+	/* all chunks must be returned explicitly, and this
+	   assertion checks for leaks */
+	assert(IsEmptyUnsafe());
+
+	MemStatsFree(MemStatsCategory::MUSIC_BUFFER,
+		     (resident ? n_max : n_initialized.load()) *
+		     GetChunkAllocationSize());
+
+	delete[] next;
+	HugeFree(data_allocation);
+	HugeFree(chunks_allocation);
+}
+
+inline bool
+MusicBuffer::Pop(unsigned &i)
+{
+	uint64_t h = head.load(std::memory_order_acquire);
+	while (true) {
+		const uint32_t first = uint32_t(h);
+		if (first == 0)
+			return false;
+
+		/* if another thread pops this chunk meanwhile, the
+		   "next" value may be stale, but then the counter in
+		   the head has changed and the exchange fails */
+		const uint32_t second =
+			next[first - 1].load(std::memory_order_relaxed);
+		if (head.compare_exchange_weak(h, MakeHead(h, second),
+					       std::memory_order_acquire,
+					       std::memory_order_acquire)) {
+			i = first - 1;
+			return true;
+		}
+	}
+}
+
+inline void
+MusicBuffer::Push(unsigned i)
+{
+	assert(i < n_max);
+
+	uint64_t h = head.load(std::memory_order_relaxed);
+	do {
+		next[i].store(uint32_t(h), std::memory_order_relaxed);
+	} while (!head.compare_exchange_weak(h, MakeHead(h, i + 1),
+					     std::memory_order_release,
+					     std::memory_order_relaxed));
 }
 
 MusicChunk *
 MusicBuffer::Allocate()
 {
-	const ScopeLock protect(mutex);
-	return buffer.Allocate();
+	unsigned i;
+	if (!Pop(i)) {
+		/* the free list is empty: take a chunk which has
+		   never been used */
+		i = n_initialized.load(std::memory_order_relaxed);
+		do {
+			if (i == n_max) {
+				/* buffer is full */
+				n_failures.fetch_add(1,
+						     std::memory_order_relaxed);
+				return nullptr;
+			}
+		} while (!n_initialized.compare_exchange_weak(i, i + 1,
+							      std::memory_order_relaxed));
+
+		if (!resident)
+			MemStatsResize(MemStatsCategory::MUSIC_BUFFER,
+				       0, GetChunkAllocationSize());
+	}
+
+	n_allocated.fetch_add(1, std::memory_order_relaxed);
+
+	MusicChunk *chunk = ::new((void *)&chunks[i]) MusicChunk();
+	chunk->data = data + i * chunk_size;
+	chunk->capacity = chunk_size;
+	return chunk;
 }
 
 void
 MusicBuffer::Return(MusicChunk *chunk)
 {
 	assert(chunk != nullptr);
+	assert(chunk >= chunks && chunk < chunks + n_max);
+
+	MusicChunk *other = chunk->other;
 
-	const ScopeLock protect(mutex);
+	const unsigned i = chunk - chunks;
+	chunk->~MusicChunk();
+	Push(i);
+	n_allocated.fetch_sub(1, std::memory_order_relaxed);
 
-	if (chunk->other != nullptr) {
-		assert(chunk->other->other == nullptr);
-		buffer.Free(chunk->other);
+	if (other != nullptr) {
+		assert(other->other == nullptr);
+		Return(other);
 	}
+}
+
+void
+MusicBuffer::Discard()
+{
+	if (resident || !IsEmptyUnsafe())
+		return;
+
+	const unsigned n = n_initialized.load(std::memory_order_relaxed);
+	if (n == 0)
+		return;
+
+	HugeDiscard(data_allocation.data, data_allocation.size);
+	HugeDiscard(chunks_allocation.data, chunks_allocation.size);
+	MemStatsResize(MemStatsCategory::MUSIC_BUFFER,
+		       n * GetChunkAllocationSize(), 0);
 
-	buffer.Free(chunk);
+	/* keep the counter, so a stale head value held by another
+	   thread can never match */
+	head.store(MakeHead(head.load(std::memory_order_relaxed), 0),
+		   std::memory_order_relaxed);
+	n_initialized.store(0, std::memory_order_relaxed);
 }
@@ -20,19 +20,95 @@
 #ifndef MPD_MUSIC_BUFFER_HXX
 #define MPD_MUSIC_BUFFER_HXX
 
-#include "util/SliceBuffer.hxx"
-#include "thread/Mutex.hxx"
+#include "util/HugeAllocator.hxx"
+#include "Compiler.h"
+
+#include <atomic>
+
+#include <stdint.h>
+#include <stddef.h>
 
 struct MusicChunk;
 
 /**
  * An allocator for #MusicChunk objects.
+ *
+ * The decoder, the player and all output threads allocate and return
+ * chunks concurrently.  To avoid contention on a mutex, free chunks
+ * are kept in a lock-free stack (a "Treiber stack").  The head is a
+ * chunk index combined with a modification counter, which protects
+ * against the ABA problem without needing a double-width
+ * compare-and-swap.
  */
 class MusicBuffer {
-	/** a mutex which protects #buffer */
-	Mutex mutex;
+	/**
+	 * The maximum number of chunks in this buffer.
+	 */
+	const unsigned n_max;
+
+	/**
+	 * The capacity of each chunk's data buffer in bytes.
+	 */
+	const size_t chunk_size;
+
+	/**
+	 * Keep all memory resident, i.e. never Discard() it?  This is
+	 * set if the buffer was locked or pre-faulted.
+	 */
+	const bool resident;
+
+	/**
+	 * Storage for the #MusicChunk objects; a chunk is only
+	 * constructed while it is allocated.
+	 */
+	const HugeAllocation chunks_allocation;
+	MusicChunk *const chunks;
 
-	SliceBuffer<MusicChunk> buffer;
+	/**
+	 * The memory for MusicChunk::data, one #chunk_size region for
+	 * each chunk.
+	 */
+	const HugeAllocation data_allocation;
+	uint8_t *const data;
+
+	/**
+	 * For each free chunk: the index plus one of the next free
+	 * chunk; 0 terminates the list.
+	 */
+	std::atomic<uint32_t> *const next;
+
+	/**
+	 * The head of the free list.  The lower 32 bits are the index
+	 * plus one of the first free chunk (0 means the list is
+	 * empty), the upper 32 bits are incremented by each
+	 * modification.
+	 */
+	std::atomic<uint64_t> head;
+
+	/**
+	 * The number of chunks which have ever been allocated since
+	 * the last Discard().  Chunks beyond this index have never
+	 * been touched, so the kernel does not need to reserve
+	 * physical memory pages for them.
+	 */
+	std::atomic<unsigned> n_initialized;
+
+	/**
+	 * The number of chunks currently allocated.
+	 */
+	std::atomic<unsigned> n_allocated;
+
+	/**
+	 * The number of Allocate() calls which have failed because
+	 * the buffer was full.
+	 */
+	std::atomic<unsigned long> n_failures;
+
+	/**
+	 * The memory occupied by one chunk (for memory accounting).
+	 */
+	gcc_pure
+	size_t GetChunkAllocationSize() const;
 
 public:
 	/**
@@ -40,19 +116,23 @@ public:
 	 *
 	 * @param num_chunks the number of #MusicChunk reserved in
 	 * this buffer
+	 * @param chunk_size the capacity of each chunk in bytes
+	 * @param options options for allocating the memory
 	 */
-	MusicBuffer(unsigned num_chunks);
+	MusicBuffer(unsigned num_chunks, size_t chunk_size,
+		    const HugeAllocateOptions &options=HugeAllocateOptions());
+
+	~MusicBuffer();
+
+	MusicBuffer(const MusicBuffer &) = delete;
+	MusicBuffer &operator=(const MusicBuffer &) = delete;
 
-#ifndef NDEBUG
 	/**
-	 * Check whether the buffer is empty.  This call is not
-	 * protected with the mutex, and may only be used while this
-	 * object is inaccessible to other threads.
+	 * Check whether the buffer is empty.
 	 */
 	bool IsEmptyUnsafe() const {
-		return buffer.IsEmpty();
+		return n_allocated.load(std::memory_order_relaxed) == 0;
 	}
-#endif
 
 	/**
 	 * Returns the total number of reserved chunks in this buffer.  This
@@ -61,12 +141,28 @@ public:
 	 */
 	gcc_pure
 	unsigned GetSize() const {
-		return buffer.GetCapacity();
+		return n_max;
+	}
+
+	/**
+	 * Returns the capacity of each chunk in bytes.
+	 */
+	size_t GetChunkSize() const {
+		return chunk_size;
+	}
+
+	/**
+	 * Returns the number of Allocate() calls which have failed
+	 * because all chunks were in use.
+	 */
+	gcc_pure
+	unsigned long GetAllocationFailures() const {
+		return n_failures.load(std::memory_order_relaxed);
 	}
 
 	/**
 	 * Allocates a chunk from the buffer.  When it is not used anymore,
-	 * call Return().
+	 * call Return().  This method is lock-free.
 	 *
 	 * @return an empty chunk or nullptr if there are no chunks
 	 * available
@@ -75,9 +171,21 @@ public:
 
 	/**
 	 * Returns a chunk to the buffer.  It can be reused by
-	 * Allocate() then.
+	 * Allocate() then.  This method is lock-free.
 	 */
 	void Return(MusicChunk *chunk);
+
+	/**
+	 * Give the memory of an empty buffer back to the kernel.
+	 * This must not be called while another thread may call
+	 * Allocate().  It does nothing if chunks are still in use,
+	 * or if the buffer was locked or pre-faulted.
+	 */
+	void Discard();
+
+private:
+	bool Pop(unsigned &i);
+	void Push(unsigned i);
 };
 
 #endif
@@ -52,15 +52,16 @@ MusicChunk::Write(const AudioFormat af,
 
 		bit_rate = _bit_rate;
 		time = data_time;
+		limit = MusicChunkLimit(capacity, af);
 
 #ifndef NDEBUG
 		audio_format = af;
 #endif
 	}
 
-	const size_t frame_size = af.GetFrameSize();
-	size_t num_frames = (sizeof(data) - length) / frame_size;
-	return { data + length, num_frames * frame_size };
+	assert(length <= limit);
+
+	return { data + length, limit - length };
 }
 
 bool
@@ -68,10 +69,10 @@ MusicChunk::Expand(const AudioFormat af, size_t _length)
 {
 	const size_t frame_size = af.GetFrameSize();
 
-	assert(length + _length <= sizeof(data));
+	assert(length + _length <= limit);
 	assert(audio_format == af);
 
 	length += _length;
 
-	return length + frame_size > sizeof(data);
+	return length + frame_size > limit;
 }
@@ -22,28 +22,63 @@
 
 #include "Chrono.hxx"
 #include "ReplayGainInfo.hxx"
+#include "AudioFormat.hxx"
 #include "util/WritableBuffer.hxx"
+#include "Compiler.h"
 
-#ifndef NDEBUG
-#include "AudioFormat.hxx"
-#endif
+#include <algorithm>
 
+#include <assert.h>
 #include <stdint.h>
 #include <stddef.h>
 
+/**
+ * The default (and minimum) capacity of a #MusicChunk in bytes.
+ */
 static constexpr size_t CHUNK_SIZE = 4096;
 
-struct AudioFormat;
+/**
+ * The maximum capacity of a #MusicChunk in bytes, see
+ * #ConfigOption::AUDIO_CHUNK_SIZE.
+ */
+static constexpr size_t MAX_CHUNK_SIZE = 1024 * 1024;
+
+/**
+ * Chunks larger than #CHUNK_SIZE are only filled up to roughly this
+ * duration of audio, see MusicChunkLimit().
+ */
+static constexpr unsigned CHUNK_DURATION_MS = 25;
+
 struct Tag;
 
+/**
+ * Determine how many bytes of the given audio format will be stored
+ * in a #MusicChunk with the specified capacity.  High-rate formats
+ * fill the whole chunk, which means less per-chunk overhead in the
+ * pipe, the player and the outputs.  Lower rates are limited to
+ * #CHUNK_DURATION_MS (but never less than #CHUNK_SIZE), to keep the
+ * player's granularity fine.  The result is a multiple of the frame
+ * size.
+ */
+gcc_pure
+static inline size_t
+MusicChunkLimit(size_t capacity, const AudioFormat af)
+{
+	assert(capacity >= CHUNK_SIZE);
+	assert(af.IsValid());
+
+	size_t limit = af.GetTimeToSize() * CHUNK_DURATION_MS / 1000;
+	limit = std::min(std::max(limit, CHUNK_SIZE), capacity);
+
+	const size_t frame_size = af.GetFrameSize();
+	return limit / frame_size * frame_size;
+}
+
 /**
  * A chunk of music data.  Its format is defined by the
  * MusicPipe::Push() caller.
  */
 struct MusicChunk {
-	/** the next chunk in a linked list */
-	MusicChunk *next;
-
 	/**
 	 * An optional chunk which should be mixed into this chunk.
 	 * This is used for cross-fading.
@@ -56,8 +91,23 @@ struct MusicChunk {
 	 */
 	float mix_ratio;
 
+	/**
+	 * The mix ratio at the end of this chunk (i.e. the
+	 * #mix_ratio of the next one); the ratio is interpolated
+	 * per frame between the two.  Only valid if #mix_ratio is
+	 * non-negative.
+	 */
+	float mix_ratio_end;
+
 	/** number of bytes stored in this chunk */
-	uint16_t length;
+	uint32_t length;
+
+	/**
+	 * The maximum number of bytes for this chunk's audio format;
+	 * determined by the first Write() call.  See
+	 * MusicChunkLimit().
+	 */
+	uint32_t limit;
 
 	/** current bit rate of the source file */
 	uint16_t bit_rate;
@@ -86,8 +136,22 @@ struct MusicChunk {
 	 */
 	unsigned replay_gain_serial;
 
-	/** the data (probably PCM) */
-	uint8_t data[CHUNK_SIZE];
+	/**
+	 * The data (probably PCM).  This points into memory owned by
+	 * the #MusicBuffer, which assigns it after allocating the
+	 * chunk.
+	 */
+	uint8_t *data;
+
+	/** the size of the #data buffer in bytes */
+	size_t capacity;
+
+	/**
+	 * When the decoder submitted this chunk to the pipe
+	 * (MonotonicClockUS()); 0 if it has not been submitted yet.
+	 * Used to measure #PerfStats::chunk_latency.
+	 */
+	uint64_t submit_time;
 
 #ifndef NDEBUG
 	AudioFormat audio_format;
@@ -95,9 +159,11 @@ struct MusicChunk {
 
 	MusicChunk()
 		:other(nullptr),
-		 length(0),
+		 length(0), limit(0),
 		 tag(nullptr),
-		 replay_gain_serial(0) {}
+		 replay_gain_serial(0),
+		 data(nullptr), capacity(0),
+		 submit_time(0) {}
 
 	~MusicChunk();
 
@@ -27,10 +27,8 @@
 bool
 MusicPipe::Contains(const MusicChunk *chunk) const
 {
-	const ScopeLock protect(mutex);
-
-	for (const MusicChunk *i = head; i != nullptr; i = i->next)
-		if (i == chunk)
+	for (Position i = GetHead(), end = GetTail(); i != end; ++i)
+		if (Get(i) == chunk)
 			return true;
 
 	return false;
@@ -41,35 +39,28 @@ MusicPipe::Contains(const MusicChunk *chunk) const
 MusicChunk *
 MusicPipe::Shift()
 {
-	const ScopeLock protect(mutex);
-
-	MusicChunk *chunk = head;
-	if (chunk != nullptr) {
-		assert(!chunk->IsEmpty());
+	const Position h = head.load(std::memory_order_relaxed);
+	if (h == GetTail())
+		return nullptr;
 
-		head = chunk->next;
-		--size;
-
-		if (head == nullptr) {
-			assert(size == 0);
-			assert(tail_r == &chunk->next);
+	MusicChunk *chunk = ring[h % capacity];
+	assert(!chunk->IsEmpty());
 
-			tail_r = &head;
-		} else {
-			assert(size > 0);
-			assert(tail_r != &chunk->next);
-		}
+	head.store(h + 1, std::memory_order_release);
+	return chunk;
+}
 
-#ifndef NDEBUG
-		/* poison the "next" reference */
-		chunk->next = (MusicChunk *)(void *)0x01010101;
+void
+MusicPipe::Unshift(MusicChunk *chunk)
+{
+	assert(!chunk->IsEmpty());
 
-		if (size == 0)
-			audio_format.Clear();
-#endif
-	}
+	const Position h = head.load(std::memory_order_relaxed);
+	assert(h > 0);
+	assert(GetTail() - h < capacity);
 
-	return chunk;
+	ring[(h - 1) % capacity] = chunk;
+	head.store(h - 1, std::memory_order_release);
 }
 
 void
@@ -87,20 +78,20 @@ MusicPipe::Push(MusicChunk *chunk)
 	assert(!chunk->IsEmpty());
 	assert(chunk->length == 0 || chunk->audio_format.IsValid());
 
-	const ScopeLock protect(mutex);
+	const Position t = tail.load(std::memory_order_relaxed);
+	assert(t - head.load(std::memory_order_acquire) < capacity);
+
+#ifndef NDEBUG
+	if (IsEmpty())
+		audio_format.Clear();
 
-	assert(size > 0 || !audio_format.IsDefined());
 	assert(!audio_format.IsDefined() ||
 	       chunk->CheckFormat(audio_format));
 
-#ifndef NDEBUG
 	if (!audio_format.IsDefined() && chunk->length > 0)
 		audio_format = chunk->audio_format;
 #endif
 
-	chunk->next = nullptr;
-	*tail_r = chunk;
-	tail_r = &chunk->next;
-
-	++size;
+	ring[t % capacity] = chunk;
+	tail.store(t + 1, std::memory_order_release);
 }
@@ -20,14 +20,16 @@
 #ifndef MPD_PIPE_H
 #define MPD_PIPE_H
 
-#include "thread/Mutex.hxx"
 #include "Compiler.h"
 
 #ifndef NDEBUG
 #include "AudioFormat.hxx"
 #endif
 
+#include <atomic>
+
 #include <assert.h>
+#include <stdint.h>
 
 struct MusicChunk;
 class MusicBuffer;
@@ -35,19 +37,28 @@ class MusicBuffer;
 /**
  * A queue of #MusicChunk objects.  One party appends chunks at the
  * tail, and the other consumes them from the head.
+ *
+ * The queue is a ring buffer indexed by a monotonically increasing
+ * #Position.  Push() is wait-free; it may run concurrently with
+ * Peek(), Shift() and Get().  Any number of readers may keep their own
+ * #Position and walk the pipe with Get(), without taking a lock; the
+ * consumer must not Shift() a chunk before all readers have passed it.
  */
 class MusicPipe {
-	/** the first chunk */
-	MusicChunk *head;
+public:
+	typedef uint64_t Position;
+
+private:
+	/** the number of slots in #ring */
+	const unsigned capacity;
 
-	/** a pointer to the tail of the chunk */
-	MusicChunk **tail_r;
+	MusicChunk **const ring;
 
-	/** the current number of chunks */
-	unsigned size;
+	/** the position of the first chunk; modified by the consumer */
+	std::atomic<Position> head;
 
-	/** a mutex which protects #head and #tail_r */
-	mutable Mutex mutex;
+	/** the position after the last chunk; modified by the producer */
+	std::atomic<Position> tail;
 
 #ifndef NDEBUG
 	AudioFormat audio_format;
@@ -56,9 +67,15 @@ class MusicPipe {
 public:
 	/**
 	 * Creates a new #MusicPipe object.  It is empty.
+	 *
+	 * @param _capacity the maximum number of chunks; there can
+	 * never be more chunks than the #MusicBuffer has
 	 */
-	MusicPipe()
-		:head(nullptr), tail_r(&head), size(0) {
+	explicit MusicPipe(unsigned _capacity)
+		:capacity(_capacity), ring(new MusicChunk *[capacity]),
+		 head(0), tail(0) {
+		assert(capacity > 0);
+
 #ifndef NDEBUG
 		audio_format.Clear();
 #endif
@@ -68,10 +85,14 @@ public:
 	 * Frees the object.  It must be empty now.
 	 */
 	~MusicPipe() {
-		assert(head == nullptr);
-		assert(tail_r == &head);
+		assert(IsEmpty());
+
+		delete[] ring;
 	}
 
+	MusicPipe(const MusicPipe &) = delete;
+	MusicPipe &operator=(const MusicPipe &) = delete;
+
 #ifndef NDEBUG
 	/**
 	 * Checks if the audio format if the chunk is equal to the specified
@@ -79,7 +100,7 @@ public:
 	 */
 	gcc_pure
 	bool CheckFormat(AudioFormat other) const {
-		return !audio_format.IsDefined() ||
+		return IsEmpty() || !audio_format.IsDefined() ||
 			audio_format == other;
 	}
 
@@ -90,13 +111,43 @@ public:
 	bool Contains(const MusicChunk *chunk) const;
 #endif
 
+	/**
+	 * Returns the position of the first chunk.
+	 */
+	gcc_pure
+	Position GetHead() const {
+		return head.load(std::memory_order_acquire);
+	}
+
+	/**
+	 * Returns the position after the last chunk.
+	 */
+	gcc_pure
+	Position GetTail() const {
+		return tail.load(std::memory_order_acquire);
+	}
+
+	/**
+	 * Returns the chunk at the given position, which must be
+	 * between GetHead() (inclusive) and GetTail() (exclusive).
+	 */
+	gcc_pure
+	const MusicChunk *Get(Position position) const {
+		assert(position < GetTail());
+
+		return ring[position % capacity];
+	}
+
 	/**
 	 * Returns the first #MusicChunk from the pipe.  Returns
 	 * nullptr if the pipe is empty.
 	 */
 	gcc_pure
 	const MusicChunk *Peek() const {
-		return head;
+		const Position h = head.load(std::memory_order_relaxed);
+		return h != GetTail()
+			? ring[h % capacity]
+			: nullptr;
 	}
 
 	/**
@@ -104,6 +155,15 @@ public:
 	 */
 	MusicChunk *Shift();
 
+	/**
+	 * Puts a chunk back in front of the head, i.e. undoes a
+	 * Shift() call.  Like Shift(), this may only be called by the
+	 * consumer.  The pipe cannot overflow, because there are no
+	 * more chunks than the capacity, but GetHead() must not be
+	 * zero.
+	 */
+	void Unshift(MusicChunk *chunk);
+
 	/**
 	 * Clears the whole pipe and returns the chunks to the buffer.
 	 *
@@ -116,12 +176,20 @@ public:
 	 */
 	void Push(MusicChunk *chunk);
 
+	/**
+	 * Returns the maximum number of chunks.
+	 */
+	unsigned GetCapacity() const {
+		return capacity;
+	}
+
 	/**
 	 * Returns the number of chunks currently in this pipe.
 	 */
 	gcc_pure
 	unsigned GetSize() const {
-		return size;
+		const Position h = head.load(std::memory_order_relaxed);
+		return GetTail() - h;
 	}
 
 	gcc_pure
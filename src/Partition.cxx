@@ -27,12 +27,23 @@
 Partition::Partition(Instance &_instance,
 		     unsigned max_length,
 		     unsigned buffer_chunks,
-		     unsigned buffered_before_play)
+		     unsigned crossfade_chunks,
+		     size_t chunk_size,
+		     const HugeAllocateOptions &buffer_options,
+		     unsigned buffered_before_play,
+		     bool adaptive_buffering,
+		     SongTime max_buffer_time,
+		     SongTime prefetch_time,
+		     unsigned prefetch_songs,
+		     unsigned history_chunks)
 	:instance(_instance),
 	 global_events(instance.event_loop, *this, &Partition::OnGlobalEvent),
 	 playlist(max_length, *this),
-	 outputs(*this),
-	 pc(*this, outputs, buffer_chunks, buffered_before_play)
+	 outputs(*this, history_chunks),
+	 pc(*this, outputs, buffer_chunks, crossfade_chunks, chunk_size,
+	    buffer_options, buffered_before_play, adaptive_buffering, max_buffer_time,
+	    prefetch_time, prefetch_songs),
+	 queue_resolver(instance.event_loop, *this)
 {
 }
 
@@ -93,6 +104,12 @@ Partition::OnQueueSongStarted()
 	EmitIdle(IDLE_PLAYER);
 }
 
+void
+Partition::OnQueueResolveSong(unsigned position)
+{
+	queue_resolver.Resolve(position);
+}
+
 void
 Partition::OnPlayerSync()
 {
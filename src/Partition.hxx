@@ -27,6 +27,7 @@
 #include "mixer/Listener.hxx"
 #include "player/Control.hxx"
 #include "player/Listener.hxx"
+#include "QueueResolver.hxx"
 #include "Chrono.hxx"
 #include "Compiler.h"
 
@@ -52,10 +53,20 @@ struct Partition final : QueueListener, PlayerListener, MixerListener {
 
 	PlayerControl pc;
 
+	QueueResolver queue_resolver;
+
 	Partition(Instance &_instance,
 		  unsigned max_length,
 		  unsigned buffer_chunks,
-		  unsigned buffered_before_play);
+		  unsigned crossfade_chunks,
+		  size_t chunk_size,
+		  const HugeAllocateOptions &buffer_options,
+		  unsigned buffered_before_play,
+		  bool adaptive_buffering,
+		  SongTime max_buffer_time,
+		  SongTime prefetch_time,
+		  unsigned prefetch_songs,
+		  unsigned history_chunks);
 
 	void EmitGlobalEvent(unsigned mask) {
 		global_events.OrMask(mask);
@@ -211,6 +222,7 @@ private:
 	void OnQueueModified() override;
 	void OnQueueOptionsChanged() override;
 	void OnQueueSongStarted() override;
+	void OnQueueResolveSong(unsigned position) override;
 
 	/* virtual methods from class PlayerListener */
 	void OnPlayerSync() override;
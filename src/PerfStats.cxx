@@ -0,0 +1,130 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "PerfStats.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
+#include "IOThread.hxx"
+#include "event/Loop.hxx"
+#include "output/MultipleOutputs.hxx"
+#include "output/Internal.hxx"
+#include "client/Response.hxx"
+
+PerfStats perf_stats;
+
+void
+perf_stats_print_histogram(Response &r, const char *name, const char *unit,
+			   const LatencyHistogram &h)
+{
+	r.Format("%s_count: %llu\n"
+		 "%s_avg%s: %llu\n"
+		 "%s_p50%s: %llu\n"
+		 "%s_p99%s: %llu\n"
+		 "%s_max%s: %llu\n",
+		 name, (unsigned long long)h.GetCount(),
+		 name, unit, (unsigned long long)h.GetAverage(),
+		 name, unit, (unsigned long long)h.GetQuantile(500),
+		 name, unit, (unsigned long long)h.GetQuantile(990),
+		 name, unit, (unsigned long long)h.GetMax());
+}
+
+static void
+perf_stats_print_event_loop(Response &r, const EventLoop &loop)
+{
+	const EventLoopStats *stats = loop.GetStats();
+	if (stats == nullptr)
+		return;
+
+	r.Format("event_loop: %s\n"
+		 "event_loop_stalls: %llu\n",
+		 stats->name, (unsigned long long)stats->stalls);
+	perf_stats_print_histogram(r, "event_loop_iteration", "_us",
+				   stats->iterations);
+}
+
+void
+perf_stats_print(Response &r, const Partition &partition)
+{
+	const PerfStats &s = perf_stats;
+
+	const uint64_t chunks = s.decoder_chunks;
+
+	/* the chunk rate while the decoder was really working,
+	   i.e. not waiting for the player to free a chunk */
+	const uint64_t busy = s.decoder_busy;
+	const uint64_t wait = s.decoder_buffer_wait.GetSum();
+	const double rate = busy > wait
+		? chunks * 1e6 / double(busy - wait)
+		: 0.;
+
+	r.Format("decoder_chunks: %llu\n"
+		 "decoder_chunk_rate: %.1f\n"
+		 "decoder_cpu_us: %llu\n",
+		 (unsigned long long)chunks, rate,
+		 (unsigned long long)s.decoder_cpu);
+	perf_stats_print_histogram(r, "decoder_buffer_wait", "_us",
+				   s.decoder_buffer_wait);
+	r.Format("decoder_cache_hits: %llu\n"
+		 "decoder_cache_misses: %llu\n",
+		 (unsigned long long)s.decoder_cache_hits,
+		 (unsigned long long)s.decoder_cache_misses);
+
+	r.Format("player_underruns: %llu\n",
+		 (unsigned long long)s.player_underruns);
+	perf_stats_print_histogram(r, "player_buffering", "_us",
+				   s.player_buffering);
+	perf_stats_print_histogram(r, "pipe_fill", "", s.pipe_fill);
+	perf_stats_print_histogram(r, "chunk_latency", "_us",
+				   s.chunk_latency);
+
+	const MultipleOutputs &outputs = partition.outputs;
+	for (unsigned i = 0, n = outputs.Size(); i != n; ++i) {
+		const AudioOutput &ao = outputs.Get(i);
+
+		r.Format("outputid: %u\n"
+			 "outputname: %s\n"
+			 "output_lag: %u\n"
+			 "output_latency_us: %u\n",
+			 i, ao.name,
+			 ao.pipe_lag.load(std::memory_order_relaxed),
+			 ao.GetCurrentLatency());
+		perf_stats_print_histogram(r, "output_play", "_us",
+					   ao.play_duration);
+
+		const unsigned buffer_time =
+			ao.device_buffer_time.load(std::memory_order_relaxed);
+		if (buffer_time > 0) {
+			r.Format("output_buffer_time_us: %u\n"
+				 "output_period_time_us: %u\n"
+				 "output_xruns: %llu\n",
+				 buffer_time,
+				 ao.device_period_time.load(std::memory_order_relaxed),
+				 (unsigned long long)ao.device_xruns.load(std::memory_order_relaxed));
+			perf_stats_print_histogram(r, "output_headroom", "_us",
+						   ao.device_headroom);
+		}
+	}
+
+	perf_stats_print_event_loop(r, partition.instance.event_loop);
+	io_thread_for_each([&r](gcc_unused const char *name,
+				EventLoop &loop){
+			perf_stats_print_event_loop(r, loop);
+		});
+}
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PERF_STATS_HXX
+#define MPD_PERF_STATS_HXX
+
+#include "util/LatencyHistogram.hxx"
+
+#include <atomic>
+
+#include <stdint.h>
+
+class Response;
+struct Partition;
+
+/**
+ * Counters and latency histograms describing the health of the
+ * decoder, the player and the music pipe.  All attributes may be
+ * updated from any thread without locking; they are printed by the
+ * "perfstats" command.  Durations are in microseconds.
+ */
+struct PerfStats {
+	/**
+	 * The number of chunks the decoder has submitted to the
+	 * pipe.
+	 */
+	std::atomic<uint64_t> decoder_chunks;
+
+	/**
+	 * The total duration of all decoder runs (excluding waits
+	 * for a free chunk), used to calculate the chunk rate.
+	 */
+	std::atomic<uint64_t> decoder_busy;
+
+	/**
+	 * The CPU time consumed by the decoder thread during all
+	 * decoder runs.
+	 */
+	std::atomic<uint64_t> decoder_cpu;
+
+	/**
+	 * How long the decoder was blocked because
+	 * MusicBuffer::Allocate() had no free chunk.
+	 */
+	LatencyHistogram decoder_buffer_wait;
+
+	/**
+	 * Lookups in the persistent caches of decoder plugins (see
+	 * decoder_cache_lookup()).
+	 */
+	std::atomic<uint64_t> decoder_cache_hits, decoder_cache_misses;
+
+	/**
+	 * How often the player had nothing to play (and sent
+	 * silence) while the decoder was still running.
+	 */
+	std::atomic<uint64_t> player_underruns;
+
+	/**
+	 * The duration of each wait for "buffer_before_play".
+	 */
+	LatencyHistogram player_buffering;
+
+	/**
+	 * The number of chunks in the player's pipe, sampled by the
+	 * player thread.
+	 */
+	LatencyHistogram pipe_fill;
+
+	/**
+	 * The time from the decoder submitting a chunk to the pipe
+	 * until all outputs have finished playing it.
+	 */
+	LatencyHistogram chunk_latency;
+
+	PerfStats()
+		:decoder_chunks(0), decoder_busy(0), decoder_cpu(0),
+		 decoder_cache_hits(0), decoder_cache_misses(0),
+		 player_underruns(0) {}
+
+	PerfStats(const PerfStats &) = delete;
+	PerfStats &operator=(const PerfStats &) = delete;
+};
+
+extern PerfStats perf_stats;
+
+void
+perf_stats_print(Response &r, const Partition &partition);
+
+/**
+ * Print a histogram in the format used by the "perfstats" command.
+ *
+ * @param unit a suffix for all attributes except the count, e.g.
+ * "_us"
+ */
+void
+perf_stats_print_histogram(Response &r, const char *name, const char *unit,
+			   const LatencyHistogram &h);
+
+#endif
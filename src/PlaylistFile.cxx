@@ -33,6 +33,8 @@
 #include "config/ConfigOption.hxx"
 #include "config/ConfigDefaults.hxx"
 #include "Idle.hxx"
+#include "Log.hxx"
+#include "event/TimeoutMonitor.hxx"
 #include "fs/Limits.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/Traits.hxx"
@@ -42,20 +44,151 @@
 #include "util/Macros.hxx"
 #include "util/StringCompare.hxx"
 #include "util/UriUtil.hxx"
+#include "util/Domain.hxx"
 
+#include <map>
 #include <memory>
 
 #include <assert.h>
 #include <string.h>
 #include <errno.h>
 
+static constexpr Domain playlist_file_domain("playlist_file");
+
 static const char PLAYLIST_COMMENT = '#';
 
+/**
+ * How long to wait after a modification of a cached playlist before
+ * it is written back to disk.
+ */
+static constexpr unsigned SPL_WRITE_DELAY_MS = 1000;
+
+/**
+ * The maximum number of playlists kept in #PlaylistFileCache.
+ */
+static constexpr size_t SPL_CACHE_SIZE = 8;
+
 static unsigned playlist_max_length;
 bool playlist_saveAbsolutePaths = DEFAULT_PLAYLIST_SAVE_ABSOLUTE_PATHS;
 
+/**
+ * A stored playlist which has been parsed already.
+ */
+struct CachedPlaylistFile {
+	PlaylistFileContents contents;
+
+	/**
+	 * The modification time and size of the file after it was
+	 * last loaded or written.  If they change, the file has been
+	 * edited by somebody else, and #contents is obsolete.
+	 */
+	time_t mtime;
+	uint64_t size;
+
+	/**
+	 * The value of PlaylistFileCache::use_counter when this
+	 * playlist was last accessed; used to evict the least recently
+	 * used one.
+	 */
+	unsigned last_used;
+
+	/**
+	 * Has #contents been modified since the file was written?
+	 */
+	bool dirty = false;
+};
+
+/**
+ * Keeps recently edited stored playlists in memory, so a series of
+ * edits on a large playlist does not parse and rewrite the whole file
+ * each time.  Modifications are written back (atomically) after
+ * #SPL_WRITE_DELAY_MS, and before anybody else reads the file (see
+ * spl_flush()).
+ */
+class PlaylistFileCache final : TimeoutMonitor {
+	std::map<std::string, CachedPlaylistFile> files;
+
+	unsigned use_counter = 0;
+
+public:
+	explicit PlaylistFileCache(EventLoop &_loop)
+		:TimeoutMonitor(_loop) {
+		SetSlack(250);
+	}
+
+	/**
+	 * Look up a playlist in the cache.
+	 *
+	 * @return the cached playlist, or nullptr if it is not cached
+	 * or if the file has been modified since
+	 */
+	CachedPlaylistFile *Lookup(const char *name_utf8);
+
+	/**
+	 * Obtain the contents of a playlist, parsing the file if it is
+	 * not cached.  Throws #PlaylistError or std::system_error on
+	 * error.
+	 */
+	CachedPlaylistFile &Get(const char *name_utf8);
+
+	/**
+	 * The caller has modified the playlist; schedule writing it
+	 * back.
+	 */
+	void SetDirty(CachedPlaylistFile &file) {
+		file.dirty = true;
+
+		if (!IsActive())
+			Schedule(SPL_WRITE_DELAY_MS);
+	}
+
+	/**
+	 * Write the playlist back to disk if it has been modified.
+	 * Throws on error.
+	 */
+	void Flush(const char *name_utf8);
+
+	/**
+	 * Write all modified playlists back to disk, logging errors.
+	 */
+	void FlushAll();
+
+	/**
+	 * Discard the cached copy (and all unsaved modifications) of
+	 * the playlist, e.g. because the file is about to be replaced
+	 * or deleted.
+	 */
+	void Forget(const char *name_utf8) {
+		files.erase(name_utf8);
+	}
+
+private:
+	/**
+	 * Check whether the file has been modified since it was
+	 * cached.
+	 */
+	gcc_pure
+	static bool IsValid(const char *name_utf8,
+			    const CachedPlaylistFile &file);
+
+	void Write(const char *name_utf8, CachedPlaylistFile &file);
+
+	/**
+	 * Make room for another playlist, writing back the one which
+	 * is evicted.
+	 */
+	void Evict();
+
+	/* virtual methods from class TimeoutMonitor */
+	void OnTimeout() override {
+		FlushAll();
+	}
+};
+
+static PlaylistFileCache *spl_cache;
+
 void
-spl_global_init(void)
+spl_global_init(EventLoop &loop)
 {
 	playlist_max_length =
 		config_get_positive(ConfigOption::MAX_PLAYLIST_LENGTH,
@@ -64,6 +197,16 @@ spl_global_init(void)
 	playlist_saveAbsolutePaths =
 		config_get_bool(ConfigOption::SAVE_ABSOLUTE_PATHS,
 				DEFAULT_PLAYLIST_SAVE_ABSOLUTE_PATHS);
+
+	spl_cache = new PlaylistFileCache(loop);
+}
+
+void
+spl_global_finish()
+{
+	spl_cache->FlushAll();
+	delete spl_cache;
+	spl_cache = nullptr;
 }
 
 bool
@@ -178,6 +321,10 @@ ListPlaylistFiles()
 	const auto &parent_path_fs = spl_map();
 	assert(!parent_path_fs.IsNull());
 
+	/* write back pending modifications, so the modification
+	   times are up to date */
+	spl_cache->FlushAll();
+
 	DirectoryReader reader(parent_path_fs);
 
 	PlaylistInfo info;
@@ -210,14 +357,11 @@ SavePlaylistFile(const PlaylistFileContents &contents, const char *utf8path)
 	fos.Commit();
 }
 
-PlaylistFileContents
-LoadPlaylistFile(const char *utf8path)
+static PlaylistFileContents
+ParsePlaylistFile(Path path_fs)
 try {
 	PlaylistFileContents contents;
 
-	const auto path_fs = spl_map_to_fs(utf8path);
-	assert(!path_fs.IsNull());
-
 	TextFile file(path_fs);
 
 	char *s;
@@ -271,6 +415,166 @@ try {
 	throw;
 }
 
+bool
+PlaylistFileCache::IsValid(const char *name_utf8,
+			   const CachedPlaylistFile &file)
+{
+	FileInfo fi;
+	return GetFileInfo(spl_map_to_fs(name_utf8), fi) &&
+		fi.GetModificationTime() == file.mtime &&
+		fi.GetSize() == file.size;
+}
+
+CachedPlaylistFile *
+PlaylistFileCache::Lookup(const char *name_utf8)
+{
+	auto i = files.find(name_utf8);
+	if (i == files.end())
+		return nullptr;
+
+	CachedPlaylistFile &file = i->second;
+	if (!IsValid(name_utf8, file)) {
+		if (file.dirty)
+			FormatWarning(playlist_file_domain,
+				      "Discarding changes to playlist \"%s\" "
+				      "because the file has been modified",
+				      name_utf8);
+
+		files.erase(i);
+		return nullptr;
+	}
+
+	file.last_used = ++use_counter;
+	return &file;
+}
+
+CachedPlaylistFile &
+PlaylistFileCache::Get(const char *name_utf8)
+{
+	CachedPlaylistFile *cached = Lookup(name_utf8);
+	if (cached != nullptr)
+		return *cached;
+
+	const auto path_fs = spl_map_to_fs(name_utf8);
+	assert(!path_fs.IsNull());
+
+	/* obtain the file information before parsing it, so a
+	   modification while parsing invalidates the cache */
+	FileInfo fi;
+	if (!GetFileInfo(path_fs, fi))
+		throw PlaylistError::NoSuchList();
+
+	auto contents = ParsePlaylistFile(path_fs);
+
+	Evict();
+
+	CachedPlaylistFile &file = files[name_utf8];
+	file.contents = std::move(contents);
+	file.mtime = fi.GetModificationTime();
+	file.size = fi.GetSize();
+	file.last_used = ++use_counter;
+	file.dirty = false;
+	return file;
+}
+
+void
+PlaylistFileCache::Write(const char *name_utf8, CachedPlaylistFile &file)
+{
+	assert(file.dirty);
+
+	if (!IsValid(name_utf8, file)) {
+		FormatWarning(playlist_file_domain,
+			      "Discarding changes to playlist \"%s\" "
+			      "because the file has been modified",
+			      name_utf8);
+		files.erase(name_utf8);
+		return;
+	}
+
+	SavePlaylistFile(file.contents, name_utf8);
+	file.dirty = false;
+
+	FileInfo fi;
+	if (GetFileInfo(spl_map_to_fs(name_utf8), fi)) {
+		file.mtime = fi.GetModificationTime();
+		file.size = fi.GetSize();
+	} else
+		files.erase(name_utf8);
+}
+
+void
+PlaylistFileCache::Flush(const char *name_utf8)
+{
+	auto i = files.find(name_utf8);
+	if (i != files.end() && i->second.dirty)
+		Write(name_utf8, i->second);
+}
+
+void
+PlaylistFileCache::FlushAll()
+{
+	TimeoutMonitor::Cancel();
+
+	for (auto i = files.begin(); i != files.end();) {
+		/* Write() may erase the item */
+		auto next = std::next(i);
+
+		if (i->second.dirty) {
+			try {
+				Write(i->first.c_str(), i->second);
+			} catch (const std::exception &e) {
+				/* Write() has not erased the item if
+				   it has thrown */
+				LogError(e);
+				files.erase(i);
+			}
+		}
+
+		i = next;
+	}
+}
+
+void
+PlaylistFileCache::Evict()
+{
+	if (files.size() < SPL_CACHE_SIZE)
+		return;
+
+	auto oldest = files.begin();
+	for (auto i = files.begin(); i != files.end(); ++i)
+		if (i->second.last_used < oldest->second.last_used)
+			oldest = i;
+
+	/* copy the name, because Write() may erase the item */
+	const std::string name = oldest->first;
+
+	if (oldest->second.dirty) {
+		try {
+			Write(name.c_str(), oldest->second);
+		} catch (const std::exception &e) {
+			LogError(e);
+		}
+	}
+
+	files.erase(name);
+}
+
+void
+spl_flush(const char *name_utf8)
+{
+	try {
+		spl_cache->Flush(name_utf8);
+	} catch (const std::exception &e) {
+		LogError(e);
+	}
+}
+
+PlaylistFileContents
+LoadPlaylistFile(const char *utf8path)
+{
+	return spl_cache->Get(utf8path).contents;
+}
+
 void
 spl_move_index(const char *utf8path, unsigned src, unsigned dest)
 {
@@ -279,7 +583,8 @@ spl_move_index(const char *utf8path, unsigned src, unsigned dest)
 		   what the hell.. */
 		return;
 
-	auto contents = LoadPlaylistFile(utf8path);
+	auto &file = spl_cache->Get(utf8path);
+	auto &contents = file.contents;
 
 	if (src >= contents.size() || dest >= contents.size())
 		throw PlaylistError(PlaylistResult::BAD_RANGE, "Bad range");
@@ -291,7 +596,7 @@ spl_move_index(const char *utf8path, unsigned src, unsigned dest)
 	const auto dest_i = std::next(contents.begin(), dest);
 	contents.insert(dest_i, std::move(value));
 
-	SavePlaylistFile(contents, utf8path);
+	spl_cache->SetDirty(file);
 
 	idle_add(IDLE_STORED_PLAYLIST);
 }
@@ -302,6 +607,8 @@ spl_clear(const char *utf8path)
 	const auto path_fs = spl_map_to_fs(utf8path);
 	assert(!path_fs.IsNull());
 
+	spl_cache->Forget(utf8path);
+
 	FILE *file = FOpen(path_fs, FOpenMode::WriteText);
 	if (file == nullptr)
 		ThrowPlaylistErrno();
@@ -317,6 +624,8 @@ spl_delete(const char *name_utf8)
 	const auto path_fs = spl_map_to_fs(name_utf8);
 	assert(!path_fs.IsNull());
 
+	spl_cache->Forget(name_utf8);
+
 	if (!RemoveFile(path_fs))
 		ThrowPlaylistErrno();
 
@@ -326,20 +635,35 @@ spl_delete(const char *name_utf8)
 void
 spl_remove_index(const char *utf8path, unsigned pos)
 {
-	auto contents = LoadPlaylistFile(utf8path);
+	auto &file = spl_cache->Get(utf8path);
+	auto &contents = file.contents;
 
 	if (pos >= contents.size())
 		throw PlaylistError(PlaylistResult::BAD_RANGE, "Bad range");
 
 	contents.erase(std::next(contents.begin(), pos));
 
-	SavePlaylistFile(contents, utf8path);
+	spl_cache->SetDirty(file);
 	idle_add(IDLE_STORED_PLAYLIST);
 }
 
 void
 spl_append_song(const char *utf8path, const DetachedSong &song)
 try {
+	auto *cached = spl_cache->Lookup(utf8path);
+	if (cached != nullptr) {
+		/* the playlist is in memory already; append to it
+		   instead of writing the file twice */
+		if (cached->contents.size() >= playlist_max_length)
+			throw PlaylistError(PlaylistResult::TOO_LARGE,
+					    "Stored playlist is too large");
+
+		cached->contents.emplace_back(song.GetURI());
+		spl_cache->SetDirty(*cached);
+		idle_add(IDLE_STORED_PLAYLIST);
+		return;
+	}
+
 	const auto path_fs = spl_map_to_fs(utf8path);
 	assert(!path_fs.IsNull());
 
@@ -402,5 +726,10 @@ spl_rename(const char *utf8from, const char *utf8to)
 	const auto to_path_fs = spl_map_to_fs(utf8to);
 	assert(!to_path_fs.IsNull());
 
+	spl_cache->Flush(utf8from);
+
 	spl_rename_internal(from_path_fs, to_path_fs);
+
+	spl_cache->Forget(utf8from);
+	spl_cache->Forget(utf8to);
 }
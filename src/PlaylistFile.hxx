@@ -23,6 +23,7 @@
 #include <vector>
 #include <string>
 
+class EventLoop;
 class DetachedSong;
 class SongLoader;
 class PlaylistVector;
@@ -37,7 +38,23 @@ extern bool playlist_saveAbsolutePaths;
  * Perform some global initialization, e.g. load configuration values.
  */
 void
-spl_global_init();
+spl_global_init(EventLoop &loop);
+
+/**
+ * Write back all pending modifications of stored playlists and free
+ * the cache.
+ */
+void
+spl_global_finish();
+
+/**
+ * Write back pending modifications of the specified stored playlist.
+ * Must be called before the file is read by code which does not use
+ * LoadPlaylistFile() (e.g. the playlist plugins).  Errors are
+ * logged.
+ */
+void
+spl_flush(const char *name_utf8);
 
 /**
  * Determines whether the specified string is a valid name for a
@@ -0,0 +1,118 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "QueueResolver.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
+#include "SongLoader.hxx"
+#include "DetachedSong.hxx"
+#include "storage/StorageInterface.hxx"
+#include "PlaylistError.hxx"
+#include "system/Clock.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+/**
+ * Give control back to the #EventLoop after this duration, to keep
+ * serving clients while many items are resolved.
+ */
+static constexpr unsigned RESOLVE_SLICE_MS = 20;
+
+static SongLoader
+MakeSongLoader(Instance &instance)
+{
+#ifdef ENABLE_DATABASE
+	return SongLoader(instance.GetDatabase(IgnoreError()),
+			  instance.storage,
+			  instance.IsDatabaseLoading());
+#else
+	(void)instance;
+	return SongLoader(nullptr, nullptr);
+#endif
+}
+
+void
+QueueResolver::Resolve(unsigned position)
+{
+#ifdef ENABLE_DATABASE
+	Instance &instance = partition.instance;
+	if (instance.IsDatabaseLoading()) {
+		/* the database is not available yet; let the player
+		   open the file from the storage directly, and leave
+		   the rest to RunDeferred() after the database has
+		   been loaded */
+		DetachedSong &song = partition.playlist.queue.Get(position);
+		if (instance.storage != nullptr && song.IsInDatabase() &&
+		    !song.HasRealURI())
+			song.SetRealURI(instance.storage->MapUTF8(song.GetURI()));
+		return;
+	}
+#endif
+
+	const SongLoader loader = MakeSongLoader(partition.instance);
+
+	/* on failure, the item stays "unresolved"; the player will
+	   report the error, and RunDeferred() removes it unless it
+	   is the current song by then */
+	partition.playlist.ResolveSong(position, loader);
+}
+
+void
+QueueResolver::RunDeferred()
+{
+#ifdef ENABLE_DATABASE
+	if (partition.instance.IsDatabaseLoading())
+		/* wait for Resume() */
+		return;
+#endif
+
+	auto &playlist = partition.playlist;
+	const SongLoader loader = MakeSongLoader(partition.instance);
+	const unsigned start = MonotonicClockMS();
+
+	playlist.BeginBulk();
+
+	while (!pending.empty()) {
+		const unsigned id = pending.front();
+		pending.pop_front();
+
+		const int position = playlist.queue.IdToPosition(id);
+		if (position < 0 ||
+		    !playlist.queue.IsUnresolvedAtPosition(position))
+			continue;
+
+		if (!playlist.ResolveSong(position, loader) &&
+		    position != playlist.GetCurrentPosition()) {
+			FormatDebug(playlist_domain,
+				    "removing missing song from queue: %s",
+				    playlist.queue.Get(position).GetURI());
+			playlist.DeletePosition(partition.pc, position);
+		}
+
+		if (MonotonicClockMS() - start >= RESOLVE_SLICE_MS)
+			break;
+	}
+
+	playlist.CommitBulk(partition.pc);
+
+	if (!pending.empty())
+		DeferredMonitor::Schedule();
+}
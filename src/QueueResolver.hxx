@@ -0,0 +1,87 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_QUEUE_RESOLVER_HXX
+#define MPD_QUEUE_RESOLVER_HXX
+
+#include "check.h"
+#include "event/DeferredMonitor.hxx"
+
+#include <deque>
+
+struct Partition;
+
+/**
+ * Loads the metadata of queue items which were restored from the
+ * state file (see Queue::Item::unresolved).  Looking up every song
+ * in the database or scanning its file while reading the state file
+ * would delay startup; instead, this is done in the main thread in
+ * short slices after startup has finished.  The main thread is used
+ * because the playlist and the queue may only be accessed from
+ * there, not because of the database (some plugins may be queried
+ * from other threads, see DatabasePlugin::FLAG_THREAD_SAFE).  An
+ * item which is about to be played is resolved right away, see
+ * QueueListener::OnQueueResolveSong().
+ *
+ * Items which cannot be loaded anymore are removed from the queue,
+ * unless they are the current song.  While the database is being
+ * loaded, resolving is postponed until Resume() is called.
+ */
+class QueueResolver final : DeferredMonitor {
+	Partition &partition;
+
+	/**
+	 * The ids of items which may still be unresolved, in queue
+	 * order.  Ids of items which have been deleted or resolved
+	 * meanwhile are skipped.
+	 */
+	std::deque<unsigned> pending;
+
+public:
+	QueueResolver(EventLoop &_loop, Partition &_partition)
+		:DeferredMonitor(_loop), partition(_partition) {}
+
+	/**
+	 * Schedule the specified queue item for resolving.
+	 */
+	void Add(unsigned id) {
+		pending.push_back(id);
+		DeferredMonitor::Schedule();
+	}
+
+	/**
+	 * Continue after the database has been loaded.
+	 */
+	void Resume() {
+		if (!pending.empty())
+			DeferredMonitor::Schedule();
+	}
+
+	/**
+	 * Resolve the specified item now.
+	 */
+	void Resolve(unsigned position);
+
+private:
+	/* virtual methods from class DeferredMonitor */
+	void RunDeferred() override;
+};
+
+#endif
@@ -39,6 +39,10 @@ struct ReplayGainTuple {
 		peak = 0.0;
 	}
 
+	static constexpr ReplayGainTuple Undefined() {
+		return {-200.0f, 0.0f};
+	}
+
 	constexpr bool IsDefined() const {
 		return gain > -100;
 	}
@@ -51,6 +55,11 @@ struct ReplayGainTuple {
 struct ReplayGainInfo {
 	ReplayGainTuple tuples[2];
 
+	static constexpr ReplayGainInfo Undefined() {
+		return {{ReplayGainTuple::Undefined(),
+			 ReplayGainTuple::Undefined()}};
+	}
+
 	constexpr bool IsDefined() const {
 		return tuples[REPLAY_GAIN_ALBUM].IsDefined() ||
 			tuples[REPLAY_GAIN_TRACK].IsDefined();
@@ -25,6 +25,7 @@
 #include "util/ConstBuffer.hxx"
 #include "util/StringAPI.hxx"
 #include "util/ASCII.hxx"
+#include "util/CharUtil.hxx"
 #include "util/UriUtil.hxx"
 #include "lib/icu/Collate.hxx"
 
@@ -63,14 +64,54 @@ ImportString(const char *p, bool fold_case)
 		: AllocatedString<>::Duplicate(p);
 }
 
+gcc_pure
+static bool
+IsASCII(const char *p)
+{
+	for (; *p != 0; ++p)
+		if (!IsASCII(*p))
+			return false;
+
+	return true;
+}
+
+#ifdef HAVE_ICU
+
+/**
+ * Find the (already case-folded) needle in the ASCII haystack,
+ * ignoring the case of the haystack.  Case-folding an ASCII string
+ * with ICU is the same as converting it to lower case, so this saves
+ * the IcuCaseFold() call and its allocations.
+ */
+gcc_pure
+static bool
+StringFindFoldedASCII(const char *haystack, const char *needle)
+{
+	if (*needle == 0)
+		return true;
+
+	for (; *haystack != 0; ++haystack) {
+		size_t i = 0;
+		while (ToLowerASCII(haystack[i]) == needle[i]) {
+			if (needle[++i] == 0)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+#endif
+
 SongFilter::Item::Item(unsigned _tag, const char *_value, bool _fold_case)
 	:tag(_tag), fold_case(_fold_case),
 	 value(ImportString(_value, _fold_case))
 {
+	value_ascii = fold_case && IsASCII(value.c_str());
 }
 
 SongFilter::Item::Item(unsigned _tag, time_t _time)
-	:tag(_tag), value(nullptr), time(_time)
+	:tag(_tag), value_ascii(false), value(nullptr), time(_time)
 {
 }
 
@@ -85,14 +126,32 @@ SongFilter::Item::StringMatch(const char *s) const
 	assert(tag != LOCATE_TAG_MODIFIED_SINCE);
 
 	if (fold_case) {
+#ifdef HAVE_ICU
+		if (IsASCII(s))
+			/* a folded non-ASCII needle cannot be found in
+			   an ASCII haystack */
+			return value_ascii &&
+				StringFindFoldedASCII(s, value.c_str());
+#endif
+
 		const auto folded = IcuCaseFold(s);
 		assert(!folded.IsNull());
-		return StringFind(folded.c_str(), value.c_str()) != nullptr;
+		return FoldedStringMatch(folded.c_str());
 	} else {
 		return StringIsEqual(s, value.c_str());
 	}
 }
 
+bool
+SongFilter::Item::FoldedStringMatch(const char *folded) const
+{
+	assert(tag != LOCATE_TAG_MODIFIED_SINCE);
+
+	return fold_case
+		? StringFind(folded, value.c_str()) != nullptr
+		: StringIsEqual(folded, value.c_str());
+}
+
 bool
 SongFilter::Item::Match(const TagItem &item) const
 {
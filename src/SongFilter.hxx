@@ -50,6 +50,12 @@ public:
 
 		bool fold_case;
 
+		/**
+		 * Does #value consist only of ASCII characters?  Only
+		 * used if #fold_case is set.
+		 */
+		bool value_ascii;
+
 		AllocatedString<> value;
 
 		/**
@@ -79,9 +85,22 @@ public:
 			return value.c_str();
 		}
 
+		time_t GetTime() const {
+			return time;
+		}
+
 		gcc_pure gcc_nonnull(2)
 		bool StringMatch(const char *s) const;
 
+		/**
+		 * Like StringMatch(), but the given string has already
+		 * been passed through IcuCaseFold() if #fold_case is
+		 * set.  This allows callers to fold each distinct
+		 * value only once.
+		 */
+		gcc_pure gcc_nonnull(2)
+		bool FoldedStringMatch(const char *folded) const;
+
 		gcc_pure
 		bool Match(const TagItem &tag_item) const;
 
@@ -43,6 +43,9 @@ SongLoader::LoadFromDatabase(const char *uri) const
 #ifdef ENABLE_DATABASE
 	if (db != nullptr)
 		return DatabaseDetachSong(*db, *storage, uri);
+
+	if (db_loading)
+		return new DetachedSong(uri);
 #else
 	(void)uri;
 #endif
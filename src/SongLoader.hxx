@@ -45,6 +45,14 @@ class SongLoader {
 #ifdef ENABLE_DATABASE
 	const Database *const db;
 	const Storage *const storage;
+
+	/**
+	 * The #Database is still being loaded (and #db is nullptr).
+	 * Song URIs relative to the music directory are then accepted
+	 * without looking them up; their tags are filled in by
+	 * playlist::DatabaseModified() later.
+	 */
+	const bool db_loading = false;
 #endif
 
 public:
@@ -52,6 +60,10 @@ public:
 	explicit SongLoader(const Client &_client);
 	SongLoader(const Database *_db, const Storage *_storage)
 		:client(nullptr), db(_db), storage(_storage) {}
+	SongLoader(const Database *_db, const Storage *_storage,
+		   bool _db_loading)
+		:client(nullptr), db(_db), storage(_storage),
+		 db_loading(_db_loading) {}
 	SongLoader(const Client &_client, const Database *_db,
 		   const Storage *_storage)
 		:client(&_client), db(_db), storage(_storage) {}
@@ -27,16 +27,29 @@
 #include "TimePrint.hxx"
 #include "TagPrint.hxx"
 #include "client/Response.hxx"
+#include "client/Client.hxx"
+#include "tag/Tag.hxx"
+#include "tag/Settings.hxx"
 #include "fs/Traits.hxx"
 #include "util/UriUtil.hxx"
+#include "util/StringBuilder.hxx"
+
+#include <string>
+
+#include <time.h>
 
 #define SONG_FILE "file: "
 
-static void
-song_print_uri(Response &r, Partition &partition, const char *uri, bool base)
+/**
+ * Convert the song URI to the form which is sent to the client.
+ *
+ * @param allocated a buffer which may be used to store the return
+ * value
+ */
+static const char *
+song_export_uri(Partition &partition, const char *uri, bool base,
+		std::string &allocated)
 {
-	std::string allocated;
-
 	if (base) {
 		uri = PathTraitsUTF8::GetBase(uri);
 	} else {
@@ -56,16 +69,32 @@ song_print_uri(Response &r, Partition &partition, const char *uri, bool base)
 			uri = allocated.c_str();
 	}
 
-	r.Format(SONG_FILE "%s\n", uri);
+	return uri;
+}
+
+static void
+song_print_uri(Response &r, Partition &partition, const char *uri, bool base)
+{
+	std::string allocated;
+	uri = song_export_uri(partition, uri, base, allocated);
+	r.WriteAttribute("file", uri);
 }
 
 void
 song_print_uri(Response &r, Partition &partition,
 	       const LightSong &song, bool base)
 {
-	if (!base && song.directory != nullptr)
-		r.Format(SONG_FILE "%s/%s\n", song.directory, song.uri);
-	else
+	if (!base && song.directory != nullptr) {
+		char buffer[1024];
+		StringBuilder b(buffer);
+		b.Append(SONG_FILE).Append(song.directory).Append('/')
+			.Append(song.uri).Append('\n');
+		if (!b.IsFull())
+			r.Write(b);
+		else
+			r.Format(SONG_FILE "%s/%s\n",
+				 song.directory, song.uri);
+	} else
 		song_print_uri(r, partition, song.uri, base);
 }
 
@@ -76,25 +105,239 @@ song_print_uri(Response &r, Partition &partition,
 	song_print_uri(r, partition, song.GetURI(), base);
 }
 
+static void
+song_print_range(Response &r, SongTime start_time, SongTime end_time)
+{
+	const unsigned start_ms = start_time.ToMS();
+	const unsigned end_ms = end_time.ToMS();
+	if (start_ms == 0 && end_ms == 0)
+		return;
+
+	char buffer[64];
+	StringBuilder b(buffer);
+	b.Append("Range: ").AppendMilli(start_ms).Append('-');
+	if (end_ms > 0)
+		b.AppendMilli(end_ms);
+	b.Append('\n');
+	r.Write(b);
+}
+
+bool
+song_print_is_tabular(Response &r)
+{
+	return r.GetClient().tabular_songs;
+}
+
+void
+song_print_columns(Response &r)
+{
+	std::string line("columns: file\tLast-Modified\tRange\tduration"
+			 "\tPos\tId\tPrio");
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; i++) {
+		if (IsTagEnabled(i)) {
+			line.push_back('\t');
+			line.append(tag_item_names[i]);
+		}
+	}
+
+	line.push_back('\n');
+	r.Write(line.data(), line.length());
+}
+
+/*
+ * The following functions build a "song" row without printf(),
+ * which is a considerable part of the cost of printing large song
+ * lists in the key/value format.
+ */
+
+static void
+AppendUnsigned(std::string &s, unsigned value)
+{
+	char buffer[16];
+	char *const end = buffer + sizeof(buffer), *p = end;
+
+	do {
+		*--p = '0' + value % 10;
+		value /= 10;
+	} while (value > 0);
+
+	s.append(p, end);
+}
+
+static void
+AppendTwoDigits(std::string &s, unsigned value)
+{
+	s.push_back('0' + value / 10 % 10);
+	s.push_back('0' + value % 10);
+}
+
+/**
+ * Append a number of milliseconds as seconds with three decimal
+ * places.
+ */
+static void
+AppendMS(std::string &s, unsigned ms)
+{
+	AppendUnsigned(s, ms / 1000);
+	s.push_back('.');
+	ms %= 1000;
+	s.push_back('0' + ms / 100);
+	AppendTwoDigits(s, ms);
+}
+
+/**
+ * Append the time stamp in the same format as time_print().
+ */
+static void
+AppendTime(std::string &s, time_t t)
+{
+#ifdef WIN32
+	const struct tm *tm = gmtime(&t);
+#else
+	struct tm buffer;
+	const struct tm *tm = gmtime_r(&t, &buffer);
+#endif
+	if (tm == nullptr)
+		return;
+
+	AppendUnsigned(s, tm->tm_year + 1900);
+	s.push_back('-');
+	AppendTwoDigits(s, tm->tm_mon + 1);
+	s.push_back('-');
+	AppendTwoDigits(s, tm->tm_mday);
+	s.push_back('T');
+	AppendTwoDigits(s, tm->tm_hour);
+	s.push_back(':');
+	AppendTwoDigits(s, tm->tm_min);
+	s.push_back(':');
+	AppendTwoDigits(s, tm->tm_sec);
+	s.push_back('Z');
+}
+
+/**
+ * Append a value, replacing the characters which delimit fields and
+ * rows with spaces.
+ */
+static void
+AppendValue(std::string &s, const char *value)
+{
+	for (; *value != 0; ++value) {
+		const char ch = *value;
+		s.push_back(ch == '\t' || ch == '\n' || ch == '\x1f'
+			    ? ' ' : ch);
+	}
+}
+
+static void
+song_print_row(Response &r, const char *uri,
+	       SongTime start_time, SongTime end_time, time_t mtime,
+	       SignedSongTime duration, const Tag &tag,
+	       const SongQueueInfo *queue)
+{
+	std::string row;
+	row.reserve(256);
+
+	row.append("song: ");
+	AppendValue(row, uri);
+
+	row.push_back('\t');
+	if (mtime > 0)
+		AppendTime(row, mtime);
+
+	row.push_back('\t');
+	const unsigned start_ms = start_time.ToMS();
+	const unsigned end_ms = end_time.ToMS();
+	if (start_ms > 0 || end_ms > 0) {
+		AppendMS(row, start_ms);
+		row.push_back('-');
+		if (end_ms > 0)
+			AppendMS(row, end_ms);
+	}
+
+	row.push_back('\t');
+	if (!duration.IsNegative())
+		AppendMS(row, duration.ToMS());
+
+	row.push_back('\t');
+	if (queue != nullptr)
+		AppendUnsigned(row, queue->position);
+	row.push_back('\t');
+	if (queue != nullptr)
+		AppendUnsigned(row, queue->id);
+	row.push_back('\t');
+	if (queue != nullptr)
+		AppendUnsigned(row, queue->priority);
+
+	/* one column per enabled tag type; multiple values are
+	   separated by 0x1f ("unit separator") */
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; i++) {
+		if (!IsTagEnabled(i))
+			continue;
+
+		row.push_back('\t');
+
+		bool first = true;
+		for (const auto &item : tag) {
+			if (item.type != TagType(i))
+				continue;
+
+			if (!first)
+				row.push_back('\x1f');
+			first = false;
+
+			AppendValue(row, item.value);
+		}
+	}
+
+	row.push_back('\n');
+	r.Write(row.data(), row.length());
+}
+
+static void
+song_print_row(Response &r, Partition &partition,
+	       const LightSong &song, bool base)
+{
+	std::string allocated;
+	const char *uri;
+	if (!base && song.directory != nullptr) {
+		allocated = song.directory;
+		allocated.push_back('/');
+		allocated.append(song.uri);
+		uri = allocated.c_str();
+	} else
+		uri = song_export_uri(partition, song.uri, base, allocated);
+
+	song_print_row(r, uri, song.start_time, song.end_time, song.mtime,
+		       song.tag->duration, *song.tag, nullptr);
+}
+
+void
+song_print_row(Response &r, Partition &partition,
+	       const DetachedSong &song, bool base,
+	       const SongQueueInfo *queue)
+{
+	std::string allocated;
+	const char *uri = song_export_uri(partition, song.GetURI(), base,
+					  allocated);
+
+	song_print_row(r, uri, song.GetStartTime(), song.GetEndTime(),
+		       song.GetLastModified(), song.GetDuration(),
+		       song.GetTag(), queue);
+}
+
 void
 song_print_info(Response &r, Partition &partition,
 		const LightSong &song, bool base)
 {
+	if (song_print_is_tabular(r)) {
+		song_print_row(r, partition, song, base);
+		return;
+	}
+
 	song_print_uri(r, partition, song, base);
 
-	const unsigned start_ms = song.start_time.ToMS();
-	const unsigned end_ms = song.end_time.ToMS();
-
-	if (end_ms > 0)
-		r.Format("Range: %u.%03u-%u.%03u\n",
-			 start_ms / 1000,
-			 start_ms % 1000,
-			 end_ms / 1000,
-			 end_ms % 1000);
-	else if (start_ms > 0)
-		r.Format("Range: %u.%03u-\n",
-			 start_ms / 1000,
-			 start_ms % 1000);
+	song_print_range(r, song.start_time, song.end_time);
 
 	if (song.mtime > 0)
 		time_print(r, "Last-Modified", song.mtime);
@@ -106,31 +349,19 @@ void
 song_print_info(Response &r, Partition &partition,
 		const DetachedSong &song, bool base)
 {
-	song_print_uri(r, partition, song, base);
+	if (song_print_is_tabular(r)) {
+		song_print_row(r, partition, song, base);
+		return;
+	}
 
-	const unsigned start_ms = song.GetStartTime().ToMS();
-	const unsigned end_ms = song.GetEndTime().ToMS();
+	song_print_uri(r, partition, song, base);
 
-	if (end_ms > 0)
-		r.Format("Range: %u.%03u-%u.%03u\n",
-			 start_ms / 1000,
-			 start_ms % 1000,
-			 end_ms / 1000,
-			 end_ms % 1000);
-	else if (start_ms > 0)
-		r.Format("Range: %u.%03u-\n",
-			 start_ms / 1000,
-			 start_ms % 1000);
+	song_print_range(r, song.GetStartTime(), song.GetEndTime());
 
 	if (song.GetLastModified() > 0)
 		time_print(r, "Last-Modified", song.GetLastModified());
 
 	tag_print_values(r, song.GetTag());
 
-	const auto duration = song.GetDuration();
-	if (!duration.IsNegative())
-		r.Format("Time: %i\n"
-			 "duration: %1.3f\n",
-			 duration.RoundS(),
-			 duration.ToDoubleS());
+	tag_print_duration(r, song.GetDuration());
 }
@@ -20,11 +20,48 @@
 #ifndef MPD_SONG_PRINT_HXX
 #define MPD_SONG_PRINT_HXX
 
+#include "Compiler.h"
+
 struct LightSong;
 class DetachedSong;
 class Response;
 struct Partition;
 
+/**
+ * The queue attributes of a song printed with song_print_row().
+ */
+struct SongQueueInfo {
+	unsigned position, id, priority;
+};
+
+/**
+ * Is the client in "tabular" mode (see command "songformat")?  Then
+ * song_print_info() calls song_print_row().
+ */
+gcc_pure
+bool
+song_print_is_tabular(Response &r);
+
+/**
+ * Print the "columns" line which describes the fields of the rows
+ * printed by song_print_row().
+ */
+void
+song_print_columns(Response &r);
+
+/**
+ * Print all attributes of the song in one "song" line; the fields
+ * are separated by tabs, in the order announced by
+ * song_print_columns().
+ *
+ * @param queue the queue attributes, or nullptr if the song is not
+ * in the queue
+ */
+void
+song_print_row(Response &r, Partition &partition,
+	       const DetachedSong &song, bool base=false,
+	       const SongQueueInfo *queue=nullptr);
+
 void
 song_print_info(Response &r, Partition &partition,
 		const DetachedSong &song, bool base=false);
@@ -27,6 +27,7 @@
 #include "tag/Tag.hxx"
 #include "tag/TagBuilder.hxx"
 #include "util/StringUtil.hxx"
+#include "util/StringView.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 
@@ -35,6 +36,10 @@
 
 #define SONG_MTIME "mtime"
 #define SONG_END "song_end"
+#define SONG_MIXRAMP_START "mixramp_start"
+#define SONG_MIXRAMP_END "mixramp_end"
+#define SONG_REPLAY_GAIN_TRACK "replay_gain_track"
+#define SONG_REPLAY_GAIN_ALBUM "replay_gain_album"
 
 static constexpr Domain song_save_domain("song_save");
 
@@ -47,6 +52,40 @@ range_save(BufferedOutputStream &os, unsigned start_ms, unsigned end_ms)
 		os.Format("Range: %u-\n", start_ms);
 }
 
+static void
+mix_ramp_save(BufferedOutputStream &os, const MixRampInfo &mix_ramp)
+{
+	if (mix_ramp.GetStart() != nullptr)
+		os.Format(SONG_MIXRAMP_START ": %s\n", mix_ramp.GetStart());
+	if (mix_ramp.GetEnd() != nullptr)
+		os.Format(SONG_MIXRAMP_END ": %s\n", mix_ramp.GetEnd());
+}
+
+static void
+replay_gain_tuple_save(BufferedOutputStream &os, const char *name,
+		       const ReplayGainTuple &tuple)
+{
+	if (tuple.IsDefined())
+		os.Format("%s: %.2f %.6f\n", name, tuple.gain, tuple.peak);
+}
+
+static void
+replay_gain_save(BufferedOutputStream &os, const ReplayGainInfo &info)
+{
+	replay_gain_tuple_save(os, SONG_REPLAY_GAIN_TRACK,
+			       info.tuples[REPLAY_GAIN_TRACK]);
+	replay_gain_tuple_save(os, SONG_REPLAY_GAIN_ALBUM,
+			       info.tuples[REPLAY_GAIN_ALBUM]);
+}
+
+static void
+replay_gain_tuple_parse(ReplayGainTuple &tuple, const char *value)
+{
+	char *endptr;
+	tuple.gain = strtod(value, &endptr);
+	tuple.peak = strtod(endptr, nullptr);
+}
+
 void
 song_save(BufferedOutputStream &os, const Song &song)
 {
@@ -56,6 +95,12 @@ song_save(BufferedOutputStream &os, const Song &song)
 
 	tag_save(os, song.tag);
 
+	if (song.mix_ramp)
+		mix_ramp_save(os, *song.mix_ramp);
+
+	if (song.replay_gain)
+		replay_gain_save(os, *song.replay_gain);
+
 	os.Format(SONG_MTIME ": %li\n", (long)song.mtime);
 	os.Format(SONG_END "\n");
 }
@@ -69,6 +114,9 @@ song_save(BufferedOutputStream &os, const DetachedSong &song)
 
 	tag_save(os, song.GetTag());
 
+	mix_ramp_save(os, song.GetMixRamp());
+	replay_gain_save(os, song.GetReplayGain());
+
 	os.Format(SONG_MTIME ": %li\n", (long)song.GetLastModified());
 	os.Format(SONG_END "\n");
 }
@@ -80,50 +128,69 @@ song_load(TextFile &file, const char *uri,
 	DetachedSong *song = new DetachedSong(uri);
 
 	TagBuilder tag;
-
-	char *line;
-	while ((line = file.ReadLine()) != nullptr &&
-	       strcmp(line, SONG_END) != 0) {
-		char *colon = strchr(line, ':');
-		if (colon == nullptr || colon == line) {
+	MixRampInfo mix_ramp;
+	ReplayGainInfo replay_gain = ReplayGainInfo::Undefined();
+
+	/* the lines are parsed in place, without copying or
+	   modifying them; the length of each line is known from
+	   the reader, and the value (the rest of the line) is still
+	   null-terminated */
+	StringView line;
+	while (!(line = file.ReadLineView()).IsNull() &&
+	       !line.EqualsLiteral(SONG_END)) {
+		const char *colon = line.Find(':');
+		if (colon == nullptr || colon == line.data) {
 			delete song;
 
 			error.Format(song_save_domain,
-				     "unknown line in db: %s", line);
+				     "unknown line in db: %s", line.data);
 			return nullptr;
 		}
 
-		*colon++ = 0;
-		const char *value = StripLeft(colon);
+		const StringView name(line.data, colon);
+		StringView value(colon + 1, line.end());
+		value.StripLeft();
 
 		TagType type;
-		if ((type = tag_name_parse(line)) != TAG_NUM_OF_ITEM_TYPES) {
+		if ((type = tag_name_parse(name)) != TAG_NUM_OF_ITEM_TYPES) {
 			tag.AddItem(type, value);
-		} else if (strcmp(line, "Time") == 0) {
-			tag.SetDuration(SignedSongTime::FromS(atof(value)));
-		} else if (strcmp(line, "Playlist") == 0) {
-			tag.SetHasPlaylist(strcmp(value, "yes") == 0);
-		} else if (strcmp(line, SONG_MTIME) == 0) {
-			song->SetLastModified(atoi(value));
-		} else if (strcmp(line, "Range") == 0) {
+		} else if (name.EqualsLiteral("Time")) {
+			tag.SetDuration(SignedSongTime::FromS(atof(value.data)));
+		} else if (name.EqualsLiteral("Playlist")) {
+			tag.SetHasPlaylist(value.EqualsLiteral("yes"));
+		} else if (name.EqualsLiteral(SONG_MTIME)) {
+			song->SetLastModified(atoi(value.data));
+		} else if (name.EqualsLiteral("Range")) {
 			char *endptr;
 
-			unsigned start_ms = strtoul(value, &endptr, 10);
+			unsigned start_ms = strtoul(value.data, &endptr, 10);
 			unsigned end_ms = *endptr == '-'
 				? strtoul(endptr + 1, nullptr, 10)
 				: 0;
 
 			song->SetStartTime(SongTime::FromMS(start_ms));
 			song->SetEndTime(SongTime::FromMS(end_ms));
+		} else if (name.EqualsLiteral(SONG_MIXRAMP_START)) {
+			mix_ramp.SetStart(value.data);
+		} else if (name.EqualsLiteral(SONG_MIXRAMP_END)) {
+			mix_ramp.SetEnd(value.data);
+		} else if (name.EqualsLiteral(SONG_REPLAY_GAIN_TRACK)) {
+			replay_gain_tuple_parse(replay_gain.tuples[REPLAY_GAIN_TRACK],
+						value.data);
+		} else if (name.EqualsLiteral(SONG_REPLAY_GAIN_ALBUM)) {
+			replay_gain_tuple_parse(replay_gain.tuples[REPLAY_GAIN_ALBUM],
+						value.data);
 		} else {
 			delete song;
 
 			error.Format(song_save_domain,
-				     "unknown line in db: %s", line);
+				     "unknown line in db: %s", line.data);
 			return nullptr;
 		}
 	}
 
 	song->SetTag(tag.Commit());
+	song->SetMixRamp(std::move(mix_ramp));
+	song->SetReplayGain(replay_gain);
 	return song;
 }
@@ -21,6 +21,7 @@
 #include "DetachedSong.hxx"
 #include "db/plugins/simple/Song.hxx"
 #include "db/plugins/simple/Directory.hxx"
+#include "db/DatabaseLock.hxx"
 #include "storage/StorageInterface.hxx"
 #include "storage/FileInfo.hxx"
 #include "util/UriUtil.hxx"
@@ -130,7 +131,8 @@ Song::UpdateFileInArchive(ArchiveFile &archive)
 	if (!tag_archive_scan(archive, path_utf8.c_str(), tag_builder))
 		return false;
 
-	tag_builder.Commit(tag);
+	const ScopeDatabaseLock protect;
+	parent->CommitSongTag(*this, tag_builder);
 	return true;
 }
 
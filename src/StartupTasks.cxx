@@ -0,0 +1,147 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "StartupTasks.hxx"
+#include "thread/Name.hxx"
+#include "system/Clock.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <assert.h>
+
+static constexpr Domain startup_domain("startup");
+
+StartupTasks::Id
+StartupTasks::Add(const char *name, std::function<void()> &&f,
+		  std::initializer_list<Id> deps)
+{
+	tasks.emplace_back(*this, name, std::move(f));
+
+	Task &task = tasks.back();
+	task.deps.assign(deps.begin(), deps.end());
+	return &task;
+}
+
+bool
+StartupTasks::Task::IsReady() const
+{
+	for (const Task *dep : deps)
+		if (dep->state != State::DONE)
+			return false;
+
+	return true;
+}
+
+void
+StartupTasks::Task::Run()
+{
+	const auto start = MonotonicClockMS();
+
+	std::exception_ptr e;
+	try {
+		f();
+	} catch (...) {
+		e = std::current_exception();
+	}
+
+	const unsigned duration = MonotonicClockMS() - start;
+	FormatDebug(startup_domain, "%s: %u ms", name, duration);
+
+	const ScopeLock protect(tasks.mutex);
+	duration_ms = duration;
+	state = State::DONE;
+	if (e && !tasks.error)
+		tasks.error = std::move(e);
+	tasks.cond.broadcast();
+}
+
+void
+StartupTasks::Task::ThreadFunc(void *ctx)
+{
+	SetThreadName("startup");
+
+	Task &task = *(Task *)ctx;
+	task.Run();
+}
+
+void
+StartupTasks::Start(Task &task)
+{
+	assert(task.state == State::PENDING);
+
+	task.state = State::RUNNING;
+
+	Error thread_error;
+	if (!task.thread.Start(Task::ThreadFunc, &task, thread_error)) {
+		/* no thread; run it in this thread instead */
+		LogError(thread_error);
+
+		mutex.unlock();
+		task.Run();
+		mutex.lock();
+	}
+}
+
+void
+StartupTasks::Run()
+{
+	const auto start = MonotonicClockMS();
+
+	mutex.lock();
+
+	while (true) {
+		if (!error)
+			for (auto &task : tasks)
+				if (task.state == State::PENDING &&
+				    task.IsReady())
+					Start(task);
+
+		bool running = false;
+		for (const auto &task : tasks)
+			if (task.state == State::RUNNING)
+				running = true;
+
+		if (!running)
+			/* all done (or failed, or unreachable
+			   because a dependency has failed) */
+			break;
+
+		cond.wait(mutex);
+	}
+
+	mutex.unlock();
+
+	for (auto &task : tasks)
+		if (task.thread.IsDefined())
+			task.thread.Join();
+
+	unsigned sum = 0;
+	for (const auto &task : tasks)
+		sum += task.duration_ms;
+
+	FormatInfo(startup_domain,
+		   "initialized %u subsystems in %u ms (%u ms sequential)",
+		   unsigned(tasks.size()),
+		   unsigned(MonotonicClockMS() - start), sum);
+
+	if (error)
+		std::rethrow_exception(error);
+}
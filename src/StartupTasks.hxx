@@ -0,0 +1,122 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_STARTUP_TASKS_HXX
+#define MPD_STARTUP_TASKS_HXX
+
+#include "check.h"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "Compiler.h"
+
+#include <functional>
+#include <initializer_list>
+#include <exception>
+#include <vector>
+#include <list>
+
+/**
+ * A small dependency graph of initialization steps which are run
+ * concurrently during startup.  Each task runs in its own thread as
+ * soon as all of its dependencies have finished; the timing of each
+ * task is logged.
+ */
+class StartupTasks {
+	enum class State {
+		PENDING,
+		RUNNING,
+		DONE,
+	};
+
+	struct Task {
+		StartupTasks &tasks;
+
+		const char *const name;
+
+		std::function<void()> f;
+
+		std::vector<const Task *> deps;
+
+		Thread thread;
+
+		/**
+		 * Protected by StartupTasks::mutex.
+		 */
+		State state = State::PENDING;
+
+		unsigned duration_ms = 0;
+
+		Task(StartupTasks &_tasks, const char *_name,
+		     std::function<void()> &&_f)
+			:tasks(_tasks), name(_name), f(std::move(_f)) {}
+
+		gcc_pure
+		bool IsReady() const;
+
+		void Run();
+
+		static void ThreadFunc(void *ctx);
+	};
+
+	std::list<Task> tasks;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled by a task thread when its task is done.
+	 */
+	Cond cond;
+
+	/**
+	 * The first exception thrown by a task.  Protected by
+	 * #mutex.
+	 */
+	std::exception_ptr error;
+
+public:
+	typedef const Task *Id;
+
+	StartupTasks() = default;
+	StartupTasks(const StartupTasks &) = delete;
+	StartupTasks &operator=(const StartupTasks &) = delete;
+
+	/**
+	 * Register a new task.
+	 *
+	 * @param name a short name for the log (must be a string
+	 * literal)
+	 * @param deps tasks which must be finished before this one
+	 * may start
+	 */
+	Id Add(const char *name, std::function<void()> &&f,
+	       std::initializer_list<Id> deps={});
+
+	/**
+	 * Run all tasks and wait for them to finish.  After a task
+	 * has failed, no more tasks are started, and its exception is
+	 * rethrown after the running ones have finished.
+	 */
+	void Run();
+
+private:
+	void Start(Task &task);
+};
+
+#endif
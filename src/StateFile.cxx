@@ -21,13 +21,15 @@
 #include "StateFile.hxx"
 #include "output/OutputState.hxx"
 #include "queue/PlaylistState.hxx"
+#include "queue/Playlist.hxx"
+#include "queue/QueueSnapshot.hxx"
 #include "fs/io/TextFile.hxx"
 #include "fs/io/FileOutputStream.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
+#include "fs/Traits.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "mixer/Volume.hxx"
-#include "SongLoader.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
@@ -38,14 +40,24 @@
 static constexpr Domain state_file_domain("state_file");
 
 StateFile::StateFile(AllocatedPath &&_path, unsigned _interval,
+		     bool snapshot,
 		     Partition &_partition, EventLoop &_loop)
 	:TimeoutMonitor(_loop),
 	 path(std::move(_path)), path_utf8(path.ToUTF8()),
+	 queue_path(AllocatedPath::FromFS(PathTraitsFS::string(path.c_str()) +
+					  PATH_LITERAL(".queue"))),
+	 snapshot_path(snapshot
+		       ? AllocatedPath::FromFS(PathTraitsFS::string(path.c_str()) +
+					       PATH_LITERAL(".snapshot"))
+		       : AllocatedPath::Null()),
 	 interval(_interval),
 	 partition(_partition),
 	 prev_volume_version(0), prev_output_version(0),
-	 prev_playlist_version(0)
+	 prev_playlist_version(0),
+	 prev_queue_version(0), queue_saved(false), snapshot_saved(false)
 {
+	/* saving the state a few seconds late doesn't hurt */
+	SetSlack(5000);
 }
 
 void
@@ -71,7 +83,8 @@ StateFile::Write(BufferedOutputStream &os)
 {
 	save_sw_volume_state(os);
 	audio_output_state_save(os, partition.outputs);
-	playlist_state_save(os, partition.playlist, partition.pc);
+	playlist_state_save(os, partition.playlist, partition.pc,
+			    snapshot_saved);
 }
 
 inline void
@@ -82,12 +95,58 @@ StateFile::Write(OutputStream &os)
 	bos.Flush();
 }
 
+void
+StateFile::WriteQueue()
+{
+	const unsigned version = partition.playlist.queue.version;
+	if (queue_saved && version == prev_queue_version)
+		return;
+
+	FormatDebug(state_file_domain, "Saving queue");
+
+	try {
+		FileOutputStream fos(queue_path);
+		BufferedOutputStream bos(fos);
+		playlist_state_save_queue(bos, partition.playlist);
+		bos.Flush();
+		fos.Commit();
+	} catch (const std::exception &e) {
+		LogError(e);
+		queue_saved = false;
+		return;
+	}
+
+	prev_queue_version = version;
+	queue_saved = true;
+
+	if (!snapshot_path.IsNull())
+		snapshot_saved = WriteSnapshot();
+}
+
+bool
+StateFile::WriteSnapshot()
+try {
+	FileOutputStream fos(snapshot_path);
+	BufferedOutputStream bos(fos);
+	queue_snapshot_save(bos, partition.playlist.queue);
+	bos.Flush();
+	fos.Commit();
+	return true;
+} catch (const std::exception &e) {
+	LogError(e);
+	return false;
+}
+
 void
 StateFile::Write()
 {
 	FormatDebug(state_file_domain,
 		    "Saving state file %s", path_utf8.c_str());
 
+	/* write the queue first, because the state file refers to
+	   it */
+	WriteQueue();
+
 	try {
 		FileOutputStream fos(path);
 		Write(fos);
@@ -108,18 +167,13 @@ try {
 
 	TextFile file(path);
 
-#ifdef ENABLE_DATABASE
-	const SongLoader song_loader(partition.instance.database,
-				     partition.instance.storage);
-#else
-	const SongLoader song_loader(nullptr, nullptr);
-#endif
-
 	const char *line;
 	while ((line = file.ReadLine()) != nullptr) {
 		success = read_sw_volume_state(line, partition.outputs) ||
 			audio_output_state_read(line, partition.outputs) ||
-			playlist_state_restore(line, file, song_loader,
+			playlist_state_restore(line, file, queue_path,
+					       snapshot_path,
+					       partition.queue_resolver,
 					       partition.playlist,
 					       partition.pc);
 		if (!success)
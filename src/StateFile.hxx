@@ -34,6 +34,19 @@ class StateFile final : private TimeoutMonitor {
 	const AllocatedPath path;
 	const std::string path_utf8;
 
+	/**
+	 * The file which contains the queue; it is only rewritten
+	 * when the queue has been modified.
+	 */
+	const AllocatedPath queue_path;
+
+	/**
+	 * The binary queue snapshot (see QueueSnapshot.hxx); it is
+	 * written together with #queue_path.  "Nulled" if snapshots
+	 * are disabled.
+	 */
+	const AllocatedPath snapshot_path;
+
 	const unsigned interval;
 
 	Partition &partition;
@@ -45,10 +58,28 @@ class StateFile final : private TimeoutMonitor {
 	unsigned prev_volume_version, prev_output_version,
 		prev_playlist_version;
 
+	/**
+	 * The queue version which was last written to #queue_path.
+	 * Only valid if #queue_saved is true.
+	 */
+	unsigned prev_queue_version;
+
+	/**
+	 * Is #queue_path up to date with #prev_queue_version?  This
+	 * is false after startup, because the queue may have been
+	 * loaded from an old state file which contained it inline.
+	 */
+	bool queue_saved;
+
+	/**
+	 * Is #snapshot_path up to date with #queue_path?
+	 */
+	bool snapshot_saved;
+
 public:
 	static constexpr unsigned DEFAULT_INTERVAL = 2 * 60;
 
-	StateFile(AllocatedPath &&path, unsigned interval,
+	StateFile(AllocatedPath &&path, unsigned interval, bool snapshot,
 		  Partition &partition, EventLoop &loop);
 
 	void Read();
@@ -63,6 +94,19 @@ private:
 	void Write(OutputStream &os);
 	void Write(BufferedOutputStream &os);
 
+	/**
+	 * Write the queue to #queue_path (and #snapshot_path) if it
+	 * has been modified since the last call.
+	 */
+	void WriteQueue();
+
+	/**
+	 * Write the queue to #snapshot_path.
+	 *
+	 * @return true on success
+	 */
+	bool WriteSnapshot();
+
 	/**
 	 * Save the current state versions for use with IsModified().
 	 */
@@ -139,7 +139,7 @@ stats_print(Response &r, const Partition &partition)
 		 (unsigned long)(partition.pc.GetTotalPlayTime() + 0.5));
 
 #ifdef ENABLE_DATABASE
-	const Database *db = partition.instance.database;
+	const Database *db = partition.instance.GetDatabase(IgnoreError());
 	if (db != nullptr)
 		db_stats_print(r, *db);
 #endif
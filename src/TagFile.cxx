@@ -34,7 +34,6 @@
 
 class TagFileScan {
 	const Path path_fs;
-	const char *const suffix;
 
 	const TagHandler &handler;
 	void *handler_ctx;
@@ -44,9 +43,9 @@ class TagFileScan {
 	InputStreamPtr is;
 
 public:
-	TagFileScan(Path _path_fs, const char *_suffix,
+	TagFileScan(Path _path_fs,
 		    const TagHandler &_handler, void *_handler_ctx)
-		:path_fs(_path_fs), suffix(_suffix),
+		:path_fs(_path_fs),
 		 handler(_handler), handler_ctx(_handler_ctx) ,
 		 is(nullptr) {}
 
@@ -73,8 +72,7 @@ public:
 	}
 
 	bool Scan(const DecoderPlugin &plugin) {
-		return plugin.SupportsSuffix(suffix) &&
-			(ScanFile(plugin) || ScanStream(plugin));
+		return ScanFile(plugin) || ScanStream(plugin);
 	}
 };
 
@@ -91,10 +89,11 @@ tag_file_scan(Path path_fs, const TagHandler &handler, void *handler_ctx)
 
 	const auto suffix_utf8 = Path::FromFS(suffix).ToUTF8();
 
-	TagFileScan tfs(path_fs, suffix_utf8.c_str(), handler, handler_ctx);
-	return decoder_plugins_try([&](const DecoderPlugin &plugin){
-			return tfs.Scan(plugin);
-		});
+	TagFileScan tfs(path_fs, handler, handler_ctx);
+	return decoder_plugins_try_suffix(suffix_utf8.c_str(),
+					  [&](const DecoderPlugin &plugin){
+						  return tfs.Scan(plugin);
+					  });
 }
 
 bool
@@ -20,8 +20,10 @@
 #include "config.h"
 #include "TagPrint.hxx"
 #include "tag/Tag.hxx"
+#include "Chrono.hxx"
 #include "tag/Settings.hxx"
 #include "client/Response.hxx"
+#include "util/StringBuilder.hxx"
 
 void
 tag_print_types(Response &r)
@@ -34,24 +36,33 @@ tag_print_types(Response &r)
 void
 tag_print(Response &r, TagType type, const char *value)
 {
-	r.Format("%s: %s\n", tag_item_names[type], value);
+	r.WriteAttribute(tag_item_names[type], value);
 }
 
 void
 tag_print_values(Response &r, const Tag &tag)
 {
 	for (const auto &i : tag)
-		r.Format("%s: %s\n", tag_item_names[i.type], i.value);
+		r.WriteAttribute(tag_item_names[i.type], i.value);
 }
 
 void
-tag_print(Response &r, const Tag &tag)
+tag_print_duration(Response &r, SignedSongTime duration)
 {
-	if (!tag.duration.IsNegative())
-		r.Format("Time: %i\n"
-			 "duration: %1.3f\n",
-			 tag.duration.RoundS(),
-			 tag.duration.ToDoubleS());
+	if (duration.IsNegative())
+		return;
+
+	char buffer[64];
+	StringBuilder b(buffer);
+	b.Append("Time: ").AppendSigned(duration.RoundS())
+		.Append("\nduration: ").AppendMilli(duration.ToMS())
+		.Append('\n');
+	r.Write(b);
+}
 
+void
+tag_print(Response &r, const Tag &tag)
+{
+	tag_print_duration(r, tag.duration);
 	tag_print_values(r, tag);
 }
@@ -26,6 +26,7 @@ enum TagType : uint8_t;
 
 struct Tag;
 class Response;
+class SignedSongTime;
 
 void
 tag_print_types(Response &response);
@@ -33,6 +34,13 @@ tag_print_types(Response &response);
 void
 tag_print(Response &response, TagType type, const char *value);
 
+/**
+ * Print the "Time" and "duration" lines, unless the duration is
+ * unknown.
+ */
+void
+tag_print_duration(Response &response, SignedSongTime duration);
+
 void
 tag_print_values(Response &response, const Tag &tag);
 
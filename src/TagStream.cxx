@@ -32,18 +32,6 @@
 
 #include <assert.h>
 
-/**
- * Does the #DecoderPlugin support either the suffix or the MIME type?
- */
-gcc_pure
-static bool
-CheckDecoderPlugin(const DecoderPlugin &plugin,
-		   const char *suffix, const char *mime)
-{
-	return (mime != nullptr && plugin.SupportsMimeType(mime)) ||
-		(suffix != nullptr && plugin.SupportsSuffix(suffix));
-}
-
 bool
 tag_stream_scan(InputStream &is, const TagHandler &handler, void *ctx)
 {
@@ -56,12 +44,11 @@ tag_stream_scan(InputStream &is, const TagHandler &handler, void *ctx)
 	if (suffix == nullptr && mime == nullptr)
 		return false;
 
-	return decoder_plugins_try([suffix, mime, &is,
-				    &handler, ctx](const DecoderPlugin &plugin){
+	return decoder_plugins_try_mime_suffix(mime, suffix,
+					       [&is, &handler, ctx](const DecoderPlugin &plugin){
 			is.LockRewind(IgnoreError());
 
-			return CheckDecoderPlugin(plugin, suffix, mime) &&
-				plugin.ScanStream(is, handler, ctx);
+			return plugin.ScanStream(is, handler, ctx);
 		});
 }
 
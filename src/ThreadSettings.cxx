@@ -0,0 +1,338 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "ThreadSettings.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "config/Block.hxx"
+#include "util/RuntimeError.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <forward_list>
+#include <string>
+
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static constexpr Domain thread_settings_domain("thread_settings");
+
+struct ThreadSettings {
+	std::string name;
+
+#ifdef __linux__
+	bool has_affinity = false;
+	cpu_set_t affinity;
+#endif
+
+	/**
+	 * The scheduling policy or -1 if not configured.
+	 */
+	int policy = -1;
+
+	/**
+	 * The real-time priority (SCHED_FIFO, SCHED_RR) or the nice
+	 * value (all other policies).
+	 */
+	int priority = 0;
+	bool has_priority = false;
+
+	/**
+	 * The value for ioprio_set() or -1 if not configured.
+	 */
+	int io_priority = -1;
+
+	explicit ThreadSettings(const ConfigBlock &block);
+
+	gcc_pure
+	bool IsRealtime() const {
+#ifdef __linux__
+		return policy == SCHED_FIFO || policy == SCHED_RR;
+#else
+		return false;
+#endif
+	}
+
+	void Apply() const;
+};
+
+static std::forward_list<ThreadSettings> thread_settings;
+
+#ifdef __linux__
+
+static constexpr int IOPRIO_CLASS_SHIFT = 13;
+static constexpr int IOPRIO_CLASS_RT = 1;
+static constexpr int IOPRIO_CLASS_BE = 2;
+static constexpr int IOPRIO_CLASS_IDLE = 3;
+static constexpr int IOPRIO_WHO_PROCESS = 1;
+
+static cpu_set_t
+ParseAffinity(const char *s, int line)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+
+	while (true) {
+		char *endptr;
+		const unsigned long first = strtoul(s, &endptr, 10);
+		if (endptr == s)
+			throw FormatRuntimeError("Malformed cpu_affinity on line %i",
+						 line);
+
+		unsigned long last = first;
+		if (*endptr == '-') {
+			s = endptr + 1;
+			last = strtoul(s, &endptr, 10);
+			if (endptr == s || last < first)
+				throw FormatRuntimeError("Malformed cpu_affinity on line %i",
+							 line);
+		}
+
+		if (last >= CPU_SETSIZE)
+			throw FormatRuntimeError("CPU number too large on line %i",
+						 line);
+
+		for (unsigned long i = first; i <= last; ++i)
+			CPU_SET(i, &set);
+
+		if (*endptr == 0)
+			break;
+
+		if (*endptr != ',')
+			throw FormatRuntimeError("Malformed cpu_affinity on line %i",
+						 line);
+
+		s = endptr + 1;
+	}
+
+	return set;
+}
+
+static int
+ParsePolicy(const char *s, int line)
+{
+	if (strcmp(s, "other") == 0 || strcmp(s, "normal") == 0)
+		return SCHED_OTHER;
+#ifdef SCHED_BATCH
+	else if (strcmp(s, "batch") == 0)
+		return SCHED_BATCH;
+#endif
+#ifdef SCHED_IDLE
+	else if (strcmp(s, "idle") == 0)
+		return SCHED_IDLE;
+#endif
+	else if (strcmp(s, "fifo") == 0)
+		return SCHED_FIFO;
+	else if (strcmp(s, "rr") == 0)
+		return SCHED_RR;
+	else
+		throw FormatRuntimeError("Unknown scheduling policy \"%s\" on line %i",
+					 s, line);
+}
+
+/**
+ * Parse "idle", "best-effort[:N]" or "realtime[:N]".
+ */
+static int
+ParseIoPriority(const char *s, int line)
+{
+	int io_class;
+	const char *level = strchr(s, ':');
+	const size_t length = level != nullptr
+		? size_t(level - s)
+		: strlen(s);
+
+	if (length == 4 && memcmp(s, "idle", 4) == 0)
+		io_class = IOPRIO_CLASS_IDLE;
+	else if (length == 11 && memcmp(s, "best-effort", 11) == 0)
+		io_class = IOPRIO_CLASS_BE;
+	else if (length == 8 && memcmp(s, "realtime", 8) == 0)
+		io_class = IOPRIO_CLASS_RT;
+	else
+		throw FormatRuntimeError("Unknown I/O priority class on line %i",
+					 line);
+
+	unsigned long value = io_class == IOPRIO_CLASS_IDLE ? 7 : 4;
+	if (level != nullptr) {
+		char *endptr;
+		value = strtoul(level + 1, &endptr, 10);
+		if (endptr == level + 1 || *endptr != 0 || value > 7)
+			throw FormatRuntimeError("Malformed I/O priority level on line %i",
+						 line);
+	}
+
+	return (io_class << IOPRIO_CLASS_SHIFT) | int(value);
+}
+
+#endif
+
+ThreadSettings::ThreadSettings(const ConfigBlock &block)
+{
+	const char *_name = block.GetBlockValue("name");
+	if (_name == nullptr)
+		throw FormatRuntimeError("Missing \"name\" in threads block on line %i",
+					 block.line);
+
+	name = _name;
+
+	const char *affinity_value = block.GetBlockValue("cpu_affinity");
+	const char *policy_value = block.GetBlockValue("policy");
+	const BlockParam *priority_param = block.GetBlockParam("priority");
+	const char *io_priority_value = block.GetBlockValue("io_priority");
+
+#ifdef __linux__
+	if (affinity_value != nullptr) {
+		affinity = ParseAffinity(affinity_value, block.line);
+		has_affinity = true;
+	}
+
+	if (policy_value != nullptr)
+		policy = ParsePolicy(policy_value, block.line);
+
+	if (priority_param != nullptr) {
+		priority = priority_param->GetIntValue();
+		has_priority = true;
+
+		if (IsRealtime()
+		    ? (priority < 1 || priority > 99)
+		    : (priority < -20 || priority > 19))
+			throw FormatRuntimeError("Priority out of range on line %i",
+						 priority_param->line);
+	}
+
+	if (IsRealtime() && !has_priority)
+		throw FormatRuntimeError("Real-time policy requires a priority on line %i",
+					 block.line);
+
+	if (io_priority_value != nullptr)
+		io_priority = ParseIoPriority(io_priority_value, block.line);
+#else
+	if (affinity_value != nullptr || policy_value != nullptr ||
+	    priority_param != nullptr || io_priority_value != nullptr)
+		throw FormatRuntimeError("Thread settings are not supported on this platform (line %i)",
+					 block.line);
+#endif
+}
+
+inline void
+ThreadSettings::Apply() const
+{
+#ifdef __linux__
+	if (has_affinity &&
+	    sched_setaffinity(0, sizeof(affinity), &affinity) < 0)
+		FormatErrno(thread_settings_domain,
+			    "Failed to set the CPU affinity of thread \"%s\"",
+			    name.c_str());
+
+	if (policy >= 0) {
+		struct sched_param param;
+		memset(&param, 0, sizeof(param));
+
+		int _policy = policy;
+		if (IsRealtime()) {
+			param.sched_priority = priority;
+#ifdef SCHED_RESET_ON_FORK
+			_policy |= SCHED_RESET_ON_FORK;
+#endif
+		}
+
+		if (sched_setscheduler(0, _policy, &param) < 0)
+			FormatErrno(thread_settings_domain,
+				    "Failed to set the scheduling policy of thread \"%s\"",
+				    name.c_str());
+	}
+
+	/* on Linux, setpriority() with a thread id affects only
+	   that thread */
+	if (has_priority && !IsRealtime() &&
+	    setpriority(PRIO_PROCESS, syscall(__NR_gettid), priority) < 0)
+		FormatErrno(thread_settings_domain,
+			    "Failed to set the nice value of thread \"%s\"",
+			    name.c_str());
+
+	if (io_priority >= 0 &&
+	    syscall(__NR_ioprio_set, IOPRIO_WHO_PROCESS, 0, io_priority) < 0)
+		FormatErrno(thread_settings_domain,
+			    "Failed to set the I/O priority of thread \"%s\"",
+			    name.c_str());
+#endif
+}
+
+void
+thread_settings_global_init()
+{
+	for (const auto *block = config_get_block(ConfigBlockOption::THREADS);
+	     block != nullptr; block = block->next) {
+		thread_settings.emplace_front(*block);
+	}
+}
+
+void
+thread_settings_global_finish()
+{
+	thread_settings.clear();
+}
+
+/**
+ * Does the configured name "pattern" match the thread name?
+ */
+gcc_pure
+static bool
+MatchThreadName(const std::string &pattern, const char *name)
+{
+	const size_t length = pattern.length();
+	return strncmp(pattern.c_str(), name, length) == 0 &&
+		(name[length] == 0 || name[length] == ':');
+}
+
+bool
+ApplyThreadSettings(const char *name)
+{
+	const ThreadSettings *found = nullptr;
+
+	for (const auto &i : thread_settings) {
+		if (i.name == name) {
+			/* an exact match wins */
+			found = &i;
+			break;
+		}
+
+		if (found == nullptr && MatchThreadName(i.name, name))
+			found = &i;
+	}
+
+	if (found == nullptr)
+		return false;
+
+	FormatDebug(thread_settings_domain,
+		    "applying settings \"%s\" to thread \"%s\"",
+		    found->name.c_str(), name);
+
+	found->Apply();
+	return found->policy >= 0;
+}
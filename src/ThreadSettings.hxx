@@ -0,0 +1,56 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_THREAD_SETTINGS_HXX
+#define MPD_THREAD_SETTINGS_HXX
+
+#include "check.h"
+
+/*
+ * Configurable CPU affinity, scheduling policy and I/O priority for
+ * MPD's threads.  Each "threads" block in the configuration file
+ * applies to the threads with the given name (see SetThreadName());
+ * a name without a colon also matches all threads whose name starts
+ * with it and a colon, e.g. "output" matches "output:alsa".
+ */
+
+/**
+ * Load the "threads" blocks from the configuration.
+ *
+ * Throws std::runtime_error on error.
+ */
+void
+thread_settings_global_init();
+
+void
+thread_settings_global_finish();
+
+/**
+ * Apply the configured settings to the current thread.  Errors are
+ * logged.
+ *
+ * @param name the thread name, as passed to SetThreadName()
+ * @return true if a scheduling policy was configured, i.e. the
+ * caller shall not apply its default policy
+ */
+bool
+ApplyThreadSettings(const char *name);
+
+#endif
@@ -41,5 +41,5 @@ time_print(Response &r, const char *name, time_t t)
 		 "%FT%TZ",
 #endif
 		 tm2);
-	r.Format("%s: %s\n", name, buffer);
+	r.WriteAttribute(name, buffer);
 }
@@ -19,6 +19,12 @@
 
 /**
   * single bz2 archive handling (requires libbz2)
+  *
+  * Seeking is implemented with an index of the compressed blocks.
+  * bzip2 blocks start at arbitrary bit offsets, therefore each block
+  * is copied into a synthetic single-block stream which libbz2 can
+  * decode independently.  The index is built while reading, and it
+  * is stored in the "archive_index_cache" directory.
   */
 
 #include "config.h"
@@ -28,26 +34,100 @@
 #include "../ArchiveVisitor.hxx"
 #include "input/InputStream.hxx"
 #include "input/LocalOpen.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
 #include "thread/Cond.hxx"
 #include "util/RefCount.hxx"
+#include "util/Fnv1aHash.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
-#include "fs/Path.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/io/FileReader.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "Log.hxx"
 
 #include <bzlib.h>
 
+#include <stdexcept>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdio.h>
+
+static constexpr Domain bz2_domain("bz2");
+
+/**
+ * The directory where complete block indexes are stored; nullptr if
+ * not configured.
+ */
+static AllocatedPath *bz2_index_directory;
+
+static constexpr uint64_t BZ2_BLOCK_MAGIC = 0x314159265359ull;
+static constexpr uint64_t BZ2_EOS_MAGIC = 0x177245385090ull;
+
+/**
+ * Give up if no block boundary was found after this number of
+ * compressed bytes.  bzip2 blocks are much smaller than that.
+ */
+static constexpr size_t BZ2_MAX_BLOCK_SIZE = 8 * 1024 * 1024;
+
+/**
+ * One entry in the block index.
+ */
+struct Bzip2Block {
+	/**
+	 * The position of the block magic in the compressed file,
+	 * in bits.
+	 */
+	uint64_t bit_offset;
+
+	/**
+	 * The position of the block's first byte in the
+	 * decompressed data.
+	 */
+	uint64_t out_offset;
+};
 
 class Bzip2ArchiveFile final : public ArchiveFile {
 public:
 	RefCount ref;
 
+	const AllocatedPath archive_path;
+
 	std::string name;
 	const InputStreamPtr istream;
 
-	Bzip2ArchiveFile(Path path, InputStreamPtr &&_is)
+	/**
+	 * The blocks which are known so far; always contains at
+	 * least the first one.
+	 */
+	std::vector<Bzip2Block> blocks;
+
+	/**
+	 * Does #blocks describe the whole file?  Then #total_size is
+	 * valid.
+	 */
+	bool complete = false;
+
+	uint64_t total_size;
+
+	/**
+	 * Have blocks been added to the index since it was loaded?
+	 * Then it is stored in the cache when this object is
+	 * destroyed.
+	 */
+	bool dirty = false;
+
+	Bzip2ArchiveFile(Path _path, InputStreamPtr &&_is)
 		:ArchiveFile(bz2_archive_plugin),
-		 name(path.GetBase().c_str()),
+		 archive_path(_path),
+		 name(_path.GetBase().c_str()),
 		 istream(std::move(_is)) {
 		// remove .bz2 suffix
 		const size_t len = name.length();
@@ -55,6 +135,11 @@ public:
 			name.erase(len - 4);
 	}
 
+	~Bzip2ArchiveFile() {
+		if (dirty)
+			StoreIndex();
+	}
+
 	void Ref() {
 		ref.Increment();
 	}
@@ -66,6 +151,30 @@ public:
 		delete this;
 	}
 
+	/**
+	 * Load the block index from the cache (it may be partial),
+	 * or check the stream header and start a new index.
+	 */
+	bool Open(Error &error);
+
+	/**
+	 * Read compressed data at the given byte offset.
+	 *
+	 * @return the number of bytes read; 0 on end of file or
+	 * error
+	 */
+	size_t ReadCompressed(uint64_t position, void *dest, size_t length,
+			      Error &error);
+
+	/**
+	 * Add the block following the one which ends at the given
+	 * bit offset.  If that was the end of a stream, look for
+	 * another concatenated stream; if there is none, the index
+	 * is complete.
+	 */
+	bool AddNextBlock(uint64_t end_bit, bool eos, uint64_t out_offset,
+			  Error &error);
+
 	virtual void Close() override {
 		Unref();
 	}
@@ -77,6 +186,11 @@ public:
 	virtual InputStream *OpenStream(const char *path,
 					Mutex &mutex, Cond &cond,
 					Error &error) override;
+
+private:
+	AllocatedPath MakeIndexPath() const;
+	bool LoadIndex();
+	void StoreIndex() const;
 };
 
 class Bzip2InputStream final : public InputStream {
@@ -84,51 +198,100 @@ class Bzip2InputStream final : public InputStream {
 
 	bool eof = false;
 
-	bz_stream bzstream;
+	/**
+	 * The index of the block which is being decoded (or will be
+	 * decoded next) in Bzip2ArchiveFile::blocks.
+	 */
+	size_t current_block = 0;
+
+	/**
+	 * Is #bzstream initialized and decoding #current_block?
+	 */
+	bool decoding = false;
+
+	/**
+	 * Where does #current_block end, and is it followed by an
+	 * end-of-stream marker?
+	 */
+	uint64_t block_end_bit;
+	bool block_end_eos;
+
+	/**
+	 * The synthetic single-block stream passed to libbz2.
+	 */
+	std::vector<uint8_t> block_data;
 
-	char buffer[5000];
+	bz_stream bzstream;
 
 public:
 	Bzip2InputStream(Bzip2ArchiveFile &context, const char *uri,
 			 Mutex &mutex, Cond &cond);
 	~Bzip2InputStream();
 
-	bool Open(Error &error);
-
 	/* virtual methods from InputStream */
 	bool IsEOF() override;
 	size_t Read(void *ptr, size_t size, Error &error) override;
+	bool Seek(offset_type new_offset, Error &error) override;
 
 private:
-	bool FillBuffer(Error &error);
+	/**
+	 * Load #current_block and start decoding it.
+	 */
+	bool StartBlock(Error &error);
+	bool FinishBlock(Error &error);
+	void StopBlock();
 };
 
-static constexpr Domain bz2_domain("bz2");
+static inline unsigned
+GetBit(const uint8_t *data, uint64_t bit)
+{
+	return (data[bit >> 3] >> (7 - (bit & 7))) & 1;
+}
 
-/* single archive handling allocation helpers */
+/**
+ * Helper for building a bit stream, most significant bit first.
+ */
+class BitWriter {
+	std::vector<uint8_t> &dest;
+	unsigned n_bits = 0;
 
-inline bool
-Bzip2InputStream::Open(Error &error)
-{
-	bzstream.bzalloc = nullptr;
-	bzstream.bzfree = nullptr;
-	bzstream.opaque = nullptr;
+public:
+	explicit BitWriter(std::vector<uint8_t> &_dest):dest(_dest) {}
 
-	bzstream.next_in = (char *)buffer;
-	bzstream.avail_in = 0;
+	void Write(uint64_t value, unsigned count) {
+		while (count-- > 0) {
+			if (n_bits == 0)
+				dest.push_back(0);
 
-	int ret = BZ2_bzDecompressInit(&bzstream, 0, 0);
-	if (ret != BZ_OK) {
-		error.Set(bz2_domain, ret,
-			  "BZ2_bzDecompressInit() has failed");
-		return false;
+			if ((value >> count) & 1)
+				dest.back() |= 0x80 >> n_bits;
+
+			n_bits = (n_bits + 1) & 7;
+		}
 	}
+};
+
+/* archive open && listing routine */
+
+static bool
+bz2_init()
+{
+	Error error;
+	auto path = config_get_path(ConfigOption::ARCHIVE_INDEX_CACHE, error);
+	if (!path.IsNull())
+		bz2_index_directory = new AllocatedPath(std::move(path));
+	else if (error.IsDefined())
+		LogError(error);
 
-	SetReady();
 	return true;
 }
 
-/* archive open && listing routine */
+static void
+bz2_finish()
+{
+	delete bz2_index_directory;
+	bz2_index_directory = nullptr;
+}
 
 static ArchiveFile *
 bz2_open(Path pathname, Error &error)
@@ -139,7 +302,241 @@ bz2_open(Path pathname, Error &error)
 	if (is == nullptr)
 		return nullptr;
 
-	return new Bzip2ArchiveFile(pathname, std::move(is));
+	auto *file = new Bzip2ArchiveFile(pathname, std::move(is));
+	if (!file->Open(error)) {
+		file->Unref();
+		return nullptr;
+	}
+
+	return file;
+}
+
+size_t
+Bzip2ArchiveFile::ReadCompressed(uint64_t position, void *dest, size_t length,
+				 Error &error)
+{
+	const ScopeLock protect(istream->mutex);
+
+	if (position >= uint64_t(istream->GetSize()))
+		return 0;
+
+	if (!istream->Seek(position, error))
+		return 0;
+
+	uint8_t *p = (uint8_t *)dest;
+	size_t result = 0;
+	while (result < length && !istream->IsEOF()) {
+		size_t nbytes = istream->Read(p + result, length - result,
+					      error);
+		if (nbytes == 0)
+			break;
+
+		result += nbytes;
+	}
+
+	return result;
+}
+
+inline bool
+Bzip2ArchiveFile::Open(Error &error)
+{
+	if (LoadIndex())
+		return true;
+
+	uint8_t header[4];
+	if (ReadCompressed(0, header, sizeof(header), error) != sizeof(header) ||
+	    memcmp(header, "BZh", 3) != 0 ||
+	    header[3] < '1' || header[3] > '9') {
+		if (!error.IsDefined())
+			error.Set(bz2_domain, "Not a bzip2 file");
+		return false;
+	}
+
+	blocks.push_back({sizeof(header) * 8, 0});
+	return true;
+}
+
+bool
+Bzip2ArchiveFile::AddNextBlock(uint64_t end_bit, bool eos,
+			       uint64_t out_offset, Error &error)
+{
+	assert(!complete);
+
+	while (eos) {
+		/* skip the end-of-stream marker, its CRC and the
+		   padding; another stream may follow */
+		const uint64_t position = (end_bit + 48 + 32 + 7) / 8;
+
+		uint8_t header[4 + 6];
+		size_t nbytes = ReadCompressed(position, header,
+					       sizeof(header), error);
+		if (error.IsDefined())
+			return false;
+
+		if (nbytes < sizeof(header) ||
+		    memcmp(header, "BZh", 3) != 0) {
+			/* no: this was the last block */
+			complete = true;
+			total_size = out_offset;
+			dirty = true;
+			return true;
+		}
+
+		uint64_t magic = 0;
+		for (unsigned i = 4; i < sizeof(header); ++i)
+			magic = (magic << 8) | header[i];
+
+		end_bit = (position + 4) * 8;
+
+		if (magic == BZ2_BLOCK_MAGIC)
+			eos = false;
+		else if (magic != BZ2_EOS_MAGIC) {
+			error.Set(bz2_domain, "Malformed bzip2 stream");
+			return false;
+		}
+	}
+
+	blocks.push_back({end_bit, out_offset});
+	dirty = true;
+	return true;
+}
+
+inline AllocatedPath
+Bzip2ArchiveFile::MakeIndexPath() const
+{
+	assert(bz2_index_directory != nullptr);
+
+	char name_buffer[32];
+	snprintf(name_buffer, sizeof(name_buffer), "%016llx.bz2idx",
+		 (unsigned long long)Fnv1aHash64(archive_path.c_str()));
+
+	return AllocatedPath::Build(*bz2_index_directory, name_buffer);
+}
+
+/**
+ * The header of an index file.  It is followed by the archive path
+ * (without the null terminator) and #n_blocks #Bzip2Block structs.
+ * The file is only read by the host which wrote it, therefore all
+ * numbers are in host byte order.
+ */
+struct Bzip2IndexHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t path_length;
+	uint64_t size;
+	int64_t mtime;
+	uint32_t complete;
+	uint32_t reserved;
+	uint64_t total_size;
+	uint64_t n_blocks;
+};
+
+static constexpr char BZ2_INDEX_MAGIC[8] = "MPDBZ2I";
+static constexpr uint32_t BZ2_INDEX_VERSION = 1;
+
+static bool
+ReadIndexFile(FileReader &reader, void *data, size_t size)
+{
+	uint8_t *p = (uint8_t *)data;
+	while (size > 0) {
+		size_t nbytes = reader.Read(p, size);
+		if (nbytes == 0)
+			return false;
+
+		p += nbytes;
+		size -= nbytes;
+	}
+
+	return true;
+}
+
+bool
+Bzip2ArchiveFile::LoadIndex()
+{
+	if (bz2_index_directory == nullptr)
+		return false;
+
+	FileInfo info;
+	if (!GetFileInfo(archive_path, info))
+		return false;
+
+	const size_t path_length = strlen(archive_path.c_str());
+
+	try {
+		FileReader reader(MakeIndexPath());
+
+		Bzip2IndexHeader header;
+		if (!ReadIndexFile(reader, &header, sizeof(header)) ||
+		    memcmp(header.magic, BZ2_INDEX_MAGIC,
+			   sizeof(header.magic)) != 0 ||
+		    header.version != BZ2_INDEX_VERSION ||
+		    header.path_length != path_length ||
+		    header.size != info.GetSize() ||
+		    header.mtime != info.GetModificationTime() ||
+		    header.n_blocks == 0 ||
+		    header.n_blocks > info.GetSize())
+			return false;
+
+		std::unique_ptr<char[]> cached_path(new char[path_length]);
+		if (!ReadIndexFile(reader, cached_path.get(), path_length) ||
+		    memcmp(cached_path.get(), archive_path.c_str(), path_length) != 0)
+			/* hash collision */
+			return false;
+
+		std::vector<Bzip2Block> new_blocks(header.n_blocks);
+		if (!ReadIndexFile(reader, &new_blocks.front(),
+				   new_blocks.size() * sizeof(new_blocks.front())))
+			return false;
+
+		blocks = std::move(new_blocks);
+		complete = header.complete;
+		total_size = header.total_size;
+	} catch (const std::runtime_error &) {
+		/* no index file */
+		return false;
+	}
+
+	FormatDebug(bz2_domain, "loaded index of %s (%zu blocks)",
+		    archive_path.c_str(), blocks.size());
+	return true;
+}
+
+void
+Bzip2ArchiveFile::StoreIndex() const
+{
+	if (bz2_index_directory == nullptr)
+		return;
+
+	FileInfo info;
+	if (!GetFileInfo(archive_path, info))
+		return;
+
+	Bzip2IndexHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BZ2_INDEX_MAGIC, sizeof(header.magic));
+	header.version = BZ2_INDEX_VERSION;
+	header.path_length = strlen(archive_path.c_str());
+	header.size = info.GetSize();
+	header.mtime = info.GetModificationTime();
+	header.complete = complete;
+	if (complete)
+		header.total_size = total_size;
+	header.n_blocks = blocks.size();
+
+	try {
+		FileOutputStream file(MakeIndexPath());
+		file.Write(&header, sizeof(header));
+		file.Write(archive_path.c_str(), header.path_length);
+		file.Write(&blocks.front(),
+			   blocks.size() * sizeof(blocks.front()));
+		file.Commit();
+	} catch (const std::runtime_error &e) {
+		LogError(e);
+		return;
+	}
+
+	FormatDebug(bz2_domain, "stored index of %s (%zu blocks)",
+		    archive_path.c_str(), blocks.size());
 }
 
 /* single archive handling */
@@ -151,78 +548,261 @@ Bzip2InputStream::Bzip2InputStream(Bzip2ArchiveFile &_context,
 	 archive(&_context)
 {
 	archive->Ref();
+
+	seekable = true;
+	if (archive->complete)
+		size = archive->total_size;
+
+	SetReady();
 }
 
 Bzip2InputStream::~Bzip2InputStream()
 {
-	BZ2_bzDecompressEnd(&bzstream);
+	StopBlock();
 	archive->Unref();
 }
 
 InputStream *
 Bzip2ArchiveFile::OpenStream(const char *path,
 			     Mutex &mutex, Cond &cond,
-			     Error &error)
+			     gcc_unused Error &error)
 {
-	Bzip2InputStream *bis = new Bzip2InputStream(*this, path, mutex, cond);
-	if (!bis->Open(error)) {
-		delete bis;
-		return nullptr;
+	return new Bzip2InputStream(*this, path, mutex, cond);
+}
+
+bool
+Bzip2InputStream::StartBlock(Error &error)
+{
+	assert(!decoding);
+	assert(current_block < archive->blocks.size());
+
+	const uint64_t start_bit = archive->blocks[current_block].bit_offset;
+	const uint64_t first_byte = start_bit / 8;
+	const unsigned shift = start_bit % 8;
+
+	/* load compressed data until the next block magic or
+	   end-of-stream marker is found */
+
+	std::vector<uint8_t> compressed;
+	uint64_t end_bit = 0;
+	bool eos = false;
+
+	uint64_t reg = 0;
+	uint64_t bit = shift;
+	while (end_bit == 0) {
+		if (compressed.size() >= BZ2_MAX_BLOCK_SIZE) {
+			error.Set(bz2_domain, "bzip2 block is too large");
+			return false;
+		}
+
+		const size_t old_size = compressed.size();
+		compressed.resize(old_size + 65536);
+		size_t nbytes = archive->ReadCompressed(first_byte + old_size,
+							&compressed[old_size],
+							65536, error);
+		compressed.resize(old_size + nbytes);
+		if (nbytes == 0) {
+			if (!error.IsDefined())
+				error.Set(bz2_domain, "Truncated bzip2 file");
+			return false;
+		}
+
+		const uint64_t n_bits = compressed.size() * 8;
+		for (; bit < n_bits; ++bit) {
+			reg = (reg << 1) | GetBit(&compressed.front(), bit);
+
+			/* the magic ends at this bit; skip the block's
+			   own magic */
+			if (bit - shift < 48 * 2 - 1)
+				continue;
+
+			const uint64_t magic = reg & 0xffffffffffffull;
+			if (magic == BZ2_BLOCK_MAGIC ||
+			    magic == BZ2_EOS_MAGIC) {
+				end_bit = first_byte * 8 + bit - 47;
+				eos = magic == BZ2_EOS_MAGIC;
+				break;
+			}
+		}
 	}
 
-	return bis;
+	/* the block CRC follows the block magic; as the only block of
+	   the synthetic stream, it is also the combined CRC */
+	uint32_t crc = 0;
+	for (unsigned i = 0; i < 32; ++i)
+		crc = (crc << 1) | GetBit(&compressed.front(), shift + 48 + i);
+
+	/* copy the block to a synthetic stream */
+
+	const uint64_t n_bits = end_bit - start_bit;
+
+	block_data.clear();
+	block_data.reserve(4 + n_bits / 8 + 12);
+	block_data.push_back('B');
+	block_data.push_back('Z');
+	block_data.push_back('h');
+	block_data.push_back('9');
+
+	const uint8_t *src = &compressed.front();
+	const size_t n_whole = n_bits / 8;
+	if (shift == 0)
+		block_data.insert(block_data.end(), src, src + n_whole);
+	else
+		for (size_t i = 0; i < n_whole; ++i)
+			block_data.push_back((src[i] << shift) |
+					     (src[i + 1] >> (8 - shift)));
+
+	BitWriter writer(block_data);
+	for (uint64_t i = n_whole * 8; i < n_bits; ++i)
+		writer.Write(GetBit(src, shift + i), 1);
+	writer.Write(BZ2_EOS_MAGIC, 48);
+	writer.Write(crc, 32);
+
+	bzstream.bzalloc = nullptr;
+	bzstream.bzfree = nullptr;
+	bzstream.opaque = nullptr;
+
+	int ret = BZ2_bzDecompressInit(&bzstream, 0, 0);
+	if (ret != BZ_OK) {
+		error.Set(bz2_domain, ret,
+			  "BZ2_bzDecompressInit() has failed");
+		return false;
+	}
+
+	bzstream.next_in = (char *)&block_data.front();
+	bzstream.avail_in = block_data.size();
+
+	block_end_bit = end_bit;
+	block_end_eos = eos;
+	decoding = true;
+	return true;
 }
 
-inline bool
-Bzip2InputStream::FillBuffer(Error &error)
+void
+Bzip2InputStream::StopBlock()
 {
-	if (bzstream.avail_in > 0)
-		return true;
+	if (decoding) {
+		BZ2_bzDecompressEnd(&bzstream);
+		decoding = false;
+	}
+}
 
-	size_t count = archive->istream->Read(buffer, sizeof(buffer),
-					      error);
-	if (count == 0)
-		return false;
+bool
+Bzip2InputStream::FinishBlock(Error &error)
+{
+	assert(decoding);
+
+	const uint64_t block_size =
+		(uint64_t(bzstream.total_out_hi32) << 32) |
+		bzstream.total_out_lo32;
+	StopBlock();
+
+	const uint64_t end_offset =
+		archive->blocks[current_block].out_offset + block_size;
+	++current_block;
+
+	if (current_block == archive->blocks.size() && !archive->complete) {
+		if (!archive->AddNextBlock(block_end_bit, block_end_eos,
+					   end_offset, error))
+			return false;
+
+		if (archive->complete)
+			size = archive->total_size;
+	}
 
-	bzstream.next_in = buffer;
-	bzstream.avail_in = count;
 	return true;
 }
 
 size_t
 Bzip2InputStream::Read(void *ptr, size_t length, Error &error)
 {
-	int bz_result;
-	size_t nbytes = 0;
-
-	if (eof)
-		return 0;
+	while (!eof) {
+		if (!decoding) {
+			if (current_block == archive->blocks.size()) {
+				assert(archive->complete);
+				eof = true;
+				break;
+			}
+
+			if (!StartBlock(error))
+				return 0;
+		}
 
-	bzstream.next_out = (char *)ptr;
-	bzstream.avail_out = length;
+		bzstream.next_out = (char *)ptr;
+		bzstream.avail_out = length;
 
-	do {
-		if (!FillBuffer(error))
+		int bz_result = BZ2_bzDecompress(&bzstream);
+		if (bz_result != BZ_OK && bz_result != BZ_STREAM_END) {
+			error.Set(bz2_domain, bz_result,
+				  "BZ2_bzDecompress() has failed");
 			return 0;
+		}
 
-		bz_result = BZ2_bzDecompress(&bzstream);
+		const size_t nbytes = length - bzstream.avail_out;
 
 		if (bz_result == BZ_STREAM_END) {
-			eof = true;
-			break;
+			if (!FinishBlock(error))
+				return 0;
+		} else if (nbytes == 0 && bzstream.avail_in == 0) {
+			error.Set(bz2_domain, "Truncated bzip2 block");
+			return 0;
 		}
 
-		if (bz_result != BZ_OK) {
-			error.Set(bz2_domain, bz_result,
-				  "BZ2_bzDecompress() has failed");
-			return 0;
+		if (nbytes > 0) {
+			offset += nbytes;
+			return nbytes;
 		}
-	} while (bzstream.avail_out == length);
+	}
+
+	return 0;
+}
+
+bool
+Bzip2InputStream::Seek(offset_type new_offset, Error &error)
+{
+	if (archive->complete && uint64_t(new_offset) > archive->total_size) {
+		error.Set(bz2_domain, "Seek beyond end of file");
+		return false;
+	}
 
-	nbytes = length - bzstream.avail_out;
-	offset += nbytes;
+	/* find the last known block which begins at or before the
+	   new offset */
+	const auto &blocks = archive->blocks;
+	auto i = std::upper_bound(blocks.begin(), blocks.end(),
+				  uint64_t(new_offset),
+				  [](uint64_t o, const Bzip2Block &b){
+					  return o < b.out_offset;
+				  });
+	assert(i != blocks.begin());
+	--i;
+
+	const size_t block = std::distance(blocks.begin(), i);
+
+	if (!(decoding && block == current_block && new_offset >= offset) &&
+	    !(block + 1 == current_block && !decoding && new_offset >= offset)) {
+		/* restart at the beginning of that block */
+		StopBlock();
+		current_block = block;
+		offset = i->out_offset;
+		eof = false;
+	}
+
+	/* decode (and index) until the new offset is reached */
+	char buffer[8192];
+	while (offset < new_offset) {
+		size_t nbytes = Read(buffer,
+				     std::min<offset_type>(sizeof(buffer),
+							   new_offset - offset),
+				     error);
+		if (nbytes == 0) {
+			if (!error.IsDefined())
+				error.Set(bz2_domain,
+					  "Seek beyond end of file");
+			return false;
+		}
+	}
 
-	return nbytes;
+	return true;
 }
 
 bool
@@ -240,9 +820,8 @@ static const char *const bz2_extensions[] = {
 
 const ArchivePlugin bz2_archive_plugin = {
 	"bz2",
-	nullptr,
-	nullptr,
+	bz2_init,
+	bz2_finish,
 	bz2_open,
 	bz2_extensions,
 };
-
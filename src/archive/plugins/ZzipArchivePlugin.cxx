@@ -34,6 +34,10 @@
 
 #include <zzip/zzip.h>
 
+#include <string>
+#include <list>
+#include <utility>
+
 class ZzipArchiveFile final : public ArchiveFile {
 public:
 	RefCount ref;
@@ -94,22 +98,46 @@ ZzipArchiveFile::Visit(ArchiveVisitor &visitor)
 
 /* single archive handling */
 
+/**
+ * The maximum number of parked handles per stream.
+ */
+static constexpr size_t ZZIP_MAX_CHECKPOINTS = 3;
+
 struct ZzipInputStream final : public InputStream {
 	ZzipArchiveFile *archive;
 
+	/**
+	 * The path of this entry inside the archive.
+	 */
+	const std::string name;
+
 	ZZIP_FILE *file;
 
+	/**
+	 * Is this entry compressed?  Then zzip_seek() must inflate
+	 * everything from the start of the entry for a backward seek.
+	 */
+	bool compressed;
+
+	/**
+	 * Additional handles of this entry, left at earlier
+	 * positions.  zziplib does not expose its inflate state,
+	 * therefore keeping the handles open is the only way to
+	 * resume decoding in the middle of a compressed entry.
+	 */
+	std::list<ZZIP_FILE *> checkpoints;
+
 	ZzipInputStream(ZzipArchiveFile &_archive, const char *_uri,
 			Mutex &_mutex, Cond &_cond,
 			ZZIP_FILE *_file)
 		:InputStream(_uri, _mutex, _cond),
-		 archive(&_archive), file(_file) {
-		//we are seekable (but its not recommendent to do so)
+		 archive(&_archive), name(_uri), file(_file) {
 		seekable = true;
 
 		ZZIP_STAT z_stat;
 		zzip_file_stat(file, &z_stat);
 		size = z_stat.st_size;
+		compressed = z_stat.d_compr != 0;
 
 		SetReady();
 
@@ -117,6 +145,8 @@ struct ZzipInputStream final : public InputStream {
 	}
 
 	~ZzipInputStream() {
+		for (auto i : checkpoints)
+			zzip_file_close(i);
 		zzip_file_close(file);
 		archive->Unref();
 	}
@@ -125,6 +155,14 @@ struct ZzipInputStream final : public InputStream {
 	bool IsEOF() override;
 	size_t Read(void *ptr, size_t size, Error &error) override;
 	bool Seek(offset_type offset, Error &error) override;
+
+private:
+	/**
+	 * Switch to the handle which is closest to (but not after)
+	 * the given offset, parking the current one; opens a new
+	 * handle if there is none.
+	 */
+	void SelectHandle(offset_type new_offset);
 };
 
 InputStream *
@@ -163,9 +201,56 @@ ZzipInputStream::IsEOF()
 	return offset_type(zzip_tell(file)) == size;
 }
 
+void
+ZzipInputStream::SelectHandle(offset_type new_offset)
+{
+	auto best = checkpoints.end();
+	bool found = offset <= new_offset;
+	offset_type best_offset = offset;
+
+	for (auto i = checkpoints.begin(); i != checkpoints.end(); ++i) {
+		const offset_type position = zzip_tell(*i);
+		if (position <= new_offset &&
+		    (!found || position > best_offset)) {
+			found = true;
+			best = i;
+			best_offset = position;
+		}
+	}
+
+	if (best != checkpoints.end()) {
+		/* swap the current handle with the parked one */
+		std::swap(file, *best);
+		checkpoints.splice(checkpoints.begin(), checkpoints, best);
+		return;
+	}
+
+	if (found)
+		/* the current handle is the best one */
+		return;
+
+	/* nothing usable: open a new handle and park the current one,
+	   because a forward seek may need it later */
+	ZZIP_FILE *new_file = zzip_file_open(archive->dir, name.c_str(), 0);
+	if (new_file == nullptr)
+		/* fall back to rewinding this handle */
+		return;
+
+	checkpoints.push_front(file);
+	file = new_file;
+
+	if (checkpoints.size() > ZZIP_MAX_CHECKPOINTS) {
+		zzip_file_close(checkpoints.back());
+		checkpoints.pop_back();
+	}
+}
+
 bool
 ZzipInputStream::Seek(offset_type new_offset, Error &error)
 {
+	if (compressed)
+		SelectHandle(new_offset);
+
 	zzip_off_t ofs = zzip_seek(file, new_offset, SEEK_SET);
 	if (ofs < 0) {
 		error.Set(zzip_domain, "zzip_seek() has failed");
@@ -22,9 +22,12 @@
 
 #include "check.h"
 #include "ClientMessage.hxx"
+#include "ResponseProducer.hxx"
 #include "command/CommandListBuilder.hxx"
 #include "event/FullyBufferedSocket.hxx"
 #include "event/TimeoutMonitor.hxx"
+#include "event/MaskMonitor.hxx"
+#include "util/MemStats.hxx"
 #include "Compiler.h"
 
 #include <boost/intrusive/link_mode.hpp>
@@ -33,9 +36,12 @@
 #include <set>
 #include <string>
 #include <list>
+#include <memory>
+#include <functional>
 
 #include <stddef.h>
 #include <stdarg.h>
+#include <stdint.h>
 
 class SocketAddress;
 class EventLoop;
@@ -43,6 +49,9 @@ class Path;
 struct Partition;
 class Database;
 class Storage;
+class Response;
+class ClientThread;
+class ClientCompressor;
 
 class Client final
 	: FullyBufferedSocket, TimeoutMonitor,
@@ -71,6 +80,26 @@ public:
 	/** idle flags that the client wants to receive */
 	unsigned idle_subscriptions;
 
+	/**
+	 * The minimum number of milliseconds between two "idle"
+	 * responses; see command "idleinterval".  0 means no limit.
+	 */
+	unsigned idle_interval;
+
+	/**
+	 * The #ClientList serial up to which global idle events have
+	 * been added to #idle_flags.  Only accessed by #ClientList
+	 * in the main thread.
+	 */
+	uint64_t idle_serial;
+
+	/**
+	 * The idle events for which this client is registered in the
+	 * #ClientList.  Only accessed by #ClientList in the main
+	 * thread.
+	 */
+	unsigned idle_watch;
+
 	/**
 	 * A list of channel names this client is subscribed to.
 	 */
@@ -87,13 +116,95 @@ public:
 	 */
 	std::list<ClientMessage> messages;
 
+	/**
+	 * The maximum number of bytes of binary data (e.g. cover art)
+	 * sent in one response; see command "binarylimit".
+	 */
+	size_t binary_limit;
+
+	/**
+	 * Print song lists as tab-separated rows instead of key/value
+	 * pairs?  See command "songformat".
+	 */
+	bool tabular_songs;
+
+	/**
+	 * If not nullptr, then a command response is still being
+	 * generated; see RunProducer().
+	 */
+	std::unique_ptr<ResponseProducer> producer;
+
+	/**
+	 * The name of the command which installed #producer.  Used
+	 * to generate error messages.
+	 */
+	const char *producer_command;
+
+private:
+	/**
+	 * The I/O thread which handles this client, or nullptr if it
+	 * is handled by the main thread.  See client_threads_init().
+	 */
+	ClientThread *const thread;
+
+	/**
+	 * Output written by a command while it was executed in the
+	 * main thread on behalf of the I/O thread; it is moved to the
+	 * socket's output buffer by AfterMainCall().
+	 */
+	std::string pending_output;
+
+	/**
+	 * The size of the output buffer as last reported to
+	 * MemStatsResize().
+	 */
+	size_t output_allocated = 0;
+
+	/**
+	 * Has SetExpired() been called in the main thread?  The I/O
+	 * thread will do the real work in AfterMainCall().
+	 */
+	bool expire_pending;
+
+	/**
+	 * Receives idle events from the main thread if this client
+	 * is handled by an I/O thread.
+	 */
+	CallbackMaskMonitor<Client> idle_monitor;
+
+#ifdef ENABLE_ZLIB
+	/**
+	 * If not nullptr, then the output is compressed; see command
+	 * "compress".
+	 */
+	std::unique_ptr<ClientCompressor> compressor;
+
+	/**
+	 * Shall #compressor be created after the current command's
+	 * response has been written?
+	 */
+	bool compress_requested;
+
+	friend class ClientCompressor;
+#endif
+
+	/**
+	 * Postpones the "idle" response until #idle_interval has
+	 * elapsed.
+	 */
+	CallbackTimeoutMonitor<Client> idle_delay;
+
+	/**
+	 * The time stamp [MonotonicClockMS()] of the last "idle"
+	 * response.
+	 */
+	unsigned idle_last_notify;
+
+public:
 	Client(EventLoop &loop, Partition &partition,
-	       int fd, int uid, int num);
+	       int fd, int uid, int num, ClientThread *thread=nullptr);
 
-	~Client() {
-		if (FullyBufferedSocket::IsDefined())
-			FullyBufferedSocket::Close();
-	}
+	~Client();
 
 	bool IsConnected() const {
 		return FullyBufferedSocket::IsDefined();
@@ -101,7 +212,11 @@ public:
 
 	gcc_pure
 	bool IsExpired() const {
-		return !FullyBufferedSocket::IsDefined();
+		return !FullyBufferedSocket::IsDefined() || expire_pending;
+	}
+
+	EventLoop &GetEventLoop() {
+		return TimeoutMonitor::GetEventLoop();
 	}
 
 	void Close();
@@ -114,6 +229,67 @@ public:
 	 */
 	bool Write(const char *data);
 
+#ifdef ENABLE_ZLIB
+	bool IsCompressed() const {
+		return compressor != nullptr || compress_requested;
+	}
+
+	/**
+	 * Compress all output after the response to the current
+	 * command.
+	 */
+	void RequestCompression() {
+		compress_requested = true;
+	}
+#endif
+
+	/**
+	 * Does the output buffer contain enough data, i.e. shall a
+	 * #ResponseProducer pause now?
+	 */
+	gcc_pure
+	bool IsOutputFull() const;
+
+	/**
+	 * Generate a response with the given #ResponseProducer.  If
+	 * it does not fit into the output buffer, the producer is
+	 * kept, and it continues each time the output buffer has
+	 * been sent; meanwhile, the client's input is not processed.
+	 * Inside a command list, the whole response is generated
+	 * right away.
+	 *
+	 * @return the #CommandResult to be returned by the command
+	 * handler
+	 */
+	CommandResult RunProducer(Response &r,
+				  std::unique_ptr<ResponseProducer> &&p);
+
+	/**
+	 * Let the #producer continue now, even though the output
+	 * buffer has not been sent yet, e.g. because it has been
+	 * waiting for a worker thread.  This may destroy the
+	 * producer and even the client.
+	 */
+	void WakeProducer() {
+		OnSocketDrained();
+	}
+
+	/**
+	 * Run the function in the main thread; commands must be
+	 * executed there, because the partition and the queue are not
+	 * thread-safe.  For a client which is handled by the main
+	 * thread, this is a simple function call.
+	 */
+	template<typename F>
+	void RunInMainThread(F &&f) {
+		if (thread == nullptr)
+			f();
+		else
+			InvokeMain(std::function<void()>(std::forward<F>(f)));
+	}
+
+	void InvokeMain(const std::function<void()> &f);
+
 	/**
 	 * returns the uid of the client process, or a negative value
 	 * if the uid is unknown
@@ -145,6 +321,11 @@ public:
 	void IdleAdd(unsigned flags);
 	bool IdleWait(unsigned flags);
 
+	/**
+	 * Leave "idle" mode without a response ("noidle").
+	 */
+	void IdleCancel();
+
 	enum class SubscribeResult {
 		/** success */
 		OK,
@@ -191,11 +372,68 @@ public:
 	const Storage *GetStorage() const;
 
 private:
+	/**
+	 * Is this client handled by an I/O thread, and is the caller
+	 * running in the main thread (e.g. a command)?  Then the
+	 * socket and the timer must not be touched.
+	 */
+	gcc_pure
+	bool IsInMainCall();
+
+	/**
+	 * Apply the side effects of a main thread call which were
+	 * postponed, see #pending_output and #expire_pending.
+	 */
+	void AfterMainCall();
+
+	/**
+	 * Write to the socket, bypassing #compressor.
+	 */
+	bool WriteSocket(const void *data, size_t length);
+
+	/**
+	 * Create #compressor if it has been requested.
+	 */
+	void StartCompression();
+
+	/**
+	 * Pass all data pending in #compressor to the socket.
+	 */
+	void FlushCompressor();
+
+	/**
+	 * Send the "idle" response now, or later if #idle_interval
+	 * has not yet elapsed.
+	 */
+	void IdleCheck();
+
+	/* callback for #idle_monitor */
+	void OnIdleMonitor(unsigned flags) {
+		IdleAdd(flags);
+	}
+
+	/* callback for #idle_delay */
+	void OnIdleDelay();
+
+	/**
+	 * Update the memory accounting after the output buffer may
+	 * have been allocated or freed.
+	 */
+	void UpdateOutputMemStats() {
+		const size_t n = GetOutputAllocatedSize();
+		MemStatsResize(MemStatsCategory::CLIENT_OUTPUT,
+			       output_allocated, n);
+		output_allocated = n;
+	}
+
 	/* virtual methods from class BufferedSocket */
 	virtual InputResult OnSocketInput(void *data, size_t length) override;
 	virtual void OnSocketError(Error &&error) override;
 	virtual void OnSocketClosed() override;
 
+	/* virtual methods from class FullyBufferedSocket */
+	virtual bool OnSocketDrained() override;
+
 	/* virtual methods from class TimeoutMonitor */
 	virtual void OnTimeout() override;
 };
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ClientCompress.hxx"
+#include "ClientInternal.hxx"
+#include "Log.hxx"
+
+ClientCompressor::ClientCompressor(EventLoop &_loop, Client &_client)
+	:IdleMonitor(_loop), client(_client), gzip(*this)
+{
+}
+
+bool
+ClientCompressor::Feed(const void *data, size_t length)
+try {
+	gzip.Write(data, length);
+
+	if (!IdleMonitor::IsActive())
+		IdleMonitor::Schedule();
+
+	return !client.IsExpired();
+} catch (const std::exception &e) {
+	LogError(e);
+	client.SetExpired();
+	return false;
+}
+
+void
+ClientCompressor::Flush()
+try {
+	if (IdleMonitor::IsActive())
+		IdleMonitor::Cancel();
+
+	gzip.SyncFlush();
+} catch (const std::exception &e) {
+	LogError(e);
+	client.SetExpired();
+}
+
+void
+ClientCompressor::Write(const void *data, size_t size)
+{
+	client.WriteSocket(data, size);
+}
+
+void
+ClientCompressor::OnIdle()
+{
+	Flush();
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CLIENT_COMPRESS_HXX
+#define MPD_CLIENT_COMPRESS_HXX
+
+#include "check.h"
+#include "fs/io/OutputStream.hxx"
+#include "fs/io/GzipOutputStream.hxx"
+#include "event/IdleMonitor.hxx"
+
+class Client;
+
+/**
+ * Compresses the output of a #Client (see command "compress").  The
+ * zlib stream is flushed each time the #EventLoop becomes idle,
+ * i.e. after a command (or a part of its response) has been
+ * processed, so the client can always decode complete responses.
+ */
+class ClientCompressor final : OutputStream, IdleMonitor {
+	Client &client;
+
+	GzipOutputStream gzip;
+
+public:
+	ClientCompressor(EventLoop &_loop, Client &_client);
+
+	/**
+	 * Compress the data and pass it to the client's socket.
+	 *
+	 * @return false if the client has been closed
+	 */
+	bool Feed(const void *data, size_t length);
+
+	/**
+	 * Pass all pending data to the client's socket now.
+	 */
+	void Flush();
+
+private:
+	/* virtual methods from class OutputStream */
+	void Write(const void *data, size_t size) override;
+
+	/* virtual methods from class IdleMonitor */
+	void OnIdle() override;
+};
+
+#endif
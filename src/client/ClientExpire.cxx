@@ -27,6 +27,12 @@ Client::SetExpired()
 	if (IsExpired())
 		return;
 
+	if (IsInMainCall()) {
+		/* see AfterMainCall() */
+		expire_pending = true;
+		return;
+	}
+
 	FullyBufferedSocket::Close();
 	TimeoutMonitor::Schedule(0);
 }
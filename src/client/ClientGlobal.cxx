@@ -24,6 +24,7 @@
 #define CLIENT_TIMEOUT_DEFAULT			(60)
 #define CLIENT_MAX_COMMAND_LIST_DEFAULT		(2048*1024)
 #define CLIENT_MAX_OUTPUT_BUFFER_SIZE_DEFAULT	(8192*1024)
+#define CLIENT_MAX_OUTPUT_BUFFER_SIZE_LOW_MEMORY	(1024*1024)
 
 int client_timeout;
 size_t client_max_command_list_size;
@@ -38,8 +39,13 @@ void client_manager_init(void)
 				    CLIENT_MAX_COMMAND_LIST_DEFAULT / 1024)
 		* 1024;
 
+	const size_t default_max_output_buffer_size =
+		config_get_bool(ConfigOption::LOW_MEMORY, false)
+		? CLIENT_MAX_OUTPUT_BUFFER_SIZE_LOW_MEMORY
+		: CLIENT_MAX_OUTPUT_BUFFER_SIZE_DEFAULT;
+
 	client_max_output_buffer_size =
 		config_get_positive(ConfigOption::MAX_OUTPUT_BUFFER_SIZE,
-				    CLIENT_MAX_OUTPUT_BUFFER_SIZE_DEFAULT / 1024)
+				    default_max_output_buffer_size / 1024)
 		* 1024;
 }
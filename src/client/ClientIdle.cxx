@@ -19,7 +19,11 @@
 
 #include "config.h"
 #include "ClientInternal.hxx"
+#include "ClientList.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
 #include "Idle.hxx"
+#include "system/Clock.hxx"
 
 #include <assert.h>
 
@@ -28,6 +32,7 @@ Client::IdleNotify()
 {
 	assert(idle_waiting);
 	assert(idle_flags != 0);
+	assert(!IsInMainCall());
 
 	unsigned flags = idle_flags;
 	idle_flags = 0;
@@ -42,18 +47,55 @@ Client::IdleNotify()
 
 	client_puts(*this, "OK\n");
 
+	idle_last_notify = MonotonicClockMS();
 	TimeoutMonitor::ScheduleSeconds(client_timeout);
 }
 
+void
+Client::IdleCheck()
+{
+	assert(idle_waiting);
+	assert(!IsInMainCall());
+
+	if (idle_delay.IsActive())
+		/* already postponed */
+		return;
+
+	if (idle_interval > 0) {
+		const unsigned elapsed = MonotonicClockMS() - idle_last_notify;
+		if (elapsed < idle_interval) {
+			/* collect more events until the interval has
+			   elapsed */
+			idle_delay.Schedule(idle_interval - elapsed);
+			return;
+		}
+	}
+
+	IdleNotify();
+}
+
+void
+Client::OnIdleDelay()
+{
+	if (idle_waiting && (idle_flags & idle_subscriptions))
+		IdleNotify();
+}
+
 void
 Client::IdleAdd(unsigned flags)
 {
+	if (IsInMainCall()) {
+		/* let the I/O thread call this method again */
+		idle_monitor.OrMask(flags);
+		return;
+	}
+
 	if (IsExpired())
 		return;
 
 	idle_flags |= flags;
 	if (idle_waiting && (idle_flags & idle_subscriptions))
-		IdleNotify();
+		IdleCheck();
 }
 
 bool
@@ -64,12 +106,36 @@ Client::IdleWait(unsigned flags)
 	idle_waiting = true;
 	idle_subscriptions = flags;
 
-	if (idle_flags & idle_subscriptions) {
-		IdleNotify();
-		return true;
-	} else {
-		/* disable timeouts while in "idle" */
-		TimeoutMonitor::Cancel();
+	/* pick up the events which have occurred since the last
+	   "idle" */
+	ClientList &client_list = *partition.instance.client_list;
+	idle_flags |= client_list.IdleCollect(*this);
+
+	if (IsInMainCall()) {
+		/* the I/O thread checks idle_flags in
+		   AfterMainCall() */
+		client_list.IdleWatch(*this, flags);
 		return false;
 	}
+
+	if (idle_flags & idle_subscriptions) {
+		IdleCheck();
+		if (!idle_waiting)
+			return true;
+	}
+
+	client_list.IdleWatch(*this, flags);
+
+	/* disable timeouts while in "idle" */
+	TimeoutMonitor::Cancel();
+	return false;
+}
+
+void
+Client::IdleCancel()
+{
+	assert(idle_waiting);
+
+	idle_waiting = false;
+	partition.instance.client_list->IdleUnwatch(*this);
 }
@@ -33,7 +33,30 @@ extern int client_timeout;
 extern size_t client_max_command_list_size;
 extern size_t client_max_output_buffer_size;
 
+/**
+ * Create a #Client for a connection which has passed all checks in
+ * client_new().  Must be called in the thread of the given
+ * #EventLoop.
+ */
+Client *
+client_open(EventLoop &loop, Partition &partition,
+	    int fd, int uid, unsigned num, const char *remote,
+	    ClientThread *thread);
+
 CommandResult
 client_process_line(Client &client, char *line);
 
+/**
+ * If the input buffer begins with a complete command list (from
+ * "command_list_begin" to "command_list_end"), execute it in place,
+ * without copying the commands.  The buffer is modified.
+ *
+ * @return the number of bytes which were consumed, or 0 if the
+ * input must be processed line by line with client_process_line()
+ */
+size_t
+client_process_buffered_command_list(Client &client,
+				     char *data, size_t length,
+				     CommandResult &result_r);
+
 #endif
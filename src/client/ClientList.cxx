@@ -29,12 +29,16 @@ ClientList::Remove(Client &client)
 {
 	assert(!list.empty());
 
+	IdleUnwatch(client);
 	list.erase(list.iterator_to(client));
 }
 
 void
 ClientList::CloseAll()
 {
+	for (auto &i : idle_waiters)
+		i.clear();
+
 	list.clear_and_dispose(DeleteDisposer());
 }
 
@@ -43,6 +47,53 @@ ClientList::IdleAdd(unsigned flags)
 {
 	assert(flags != 0);
 
-	for (auto &client : list)
-		client.IdleAdd(flags);
+	++idle_serial;
+
+	for (unsigned i = 0; i < NUM_IDLE_EVENTS; ++i) {
+		if ((flags & (1u << i)) == 0)
+			continue;
+
+		idle_event_serial[i] = idle_serial;
+
+		for (Client *client : idle_waiters[i])
+			/* IdleCollect() updates the client's serial,
+			   so a client waiting for several of these
+			   events is notified only once */
+			if (client->idle_serial != idle_serial)
+				client->IdleAdd(IdleCollect(*client));
+	}
+}
+
+unsigned
+ClientList::IdleCollect(Client &client)
+{
+	unsigned flags = 0;
+	for (unsigned i = 0; i < NUM_IDLE_EVENTS; ++i)
+		if (idle_event_serial[i] > client.idle_serial)
+			flags |= 1u << i;
+
+	client.idle_serial = idle_serial;
+	return flags;
+}
+
+void
+ClientList::IdleWatch(Client &client, unsigned flags)
+{
+	IdleUnwatch(client);
+
+	for (unsigned i = 0; i < NUM_IDLE_EVENTS; ++i)
+		if (flags & (1u << i))
+			idle_waiters[i].insert(&client);
+
+	client.idle_watch = flags;
+}
+
+void
+ClientList::IdleUnwatch(Client &client)
+{
+	for (unsigned i = 0; i < NUM_IDLE_EVENTS; ++i)
+		if (client.idle_watch & (1u << i))
+			idle_waiters[i].erase(&client);
+
+	client.idle_watch = 0;
 }
@@ -21,9 +21,14 @@
 #define MPD_CLIENT_LIST_HXX
 
 #include "Client.hxx"
+#include "IdleFlags.hxx"
 
 #include <boost/intrusive/list.hpp>
 
+#include <set>
+
+#include <stdint.h>
+
 class ClientList {
 	typedef boost::intrusive::list<Client,
 				       boost::intrusive::constant_time_size<true>> List;
@@ -32,6 +37,25 @@ class ClientList {
 
 	List list;
 
+	/**
+	 * Incremented by IdleAdd().  See Client::idle_serial.
+	 */
+	uint64_t idle_serial = 0;
+
+	/**
+	 * The value of #idle_serial when the respective idle event
+	 * last occurred.
+	 */
+	uint64_t idle_event_serial[NUM_IDLE_EVENTS] = {};
+
+	/**
+	 * The clients in "idle" mode, indexed by the bit number of
+	 * the idle events they are waiting for.  This may contain
+	 * clients which have left "idle" meanwhile; they get
+	 * removed by IdleWatch(), IdleUnwatch() and Remove().
+	 */
+	std::set<Client *> idle_waiters[NUM_IDLE_EVENTS];
+
 public:
 	ClientList(unsigned _max_size)
 		:max_size(_max_size) {}
@@ -47,19 +71,50 @@ public:
 		return list.end();
 	}
 
+	unsigned GetSize() const {
+		return list.size();
+	}
+
+	unsigned GetMaxSize() const {
+		return max_size;
+	}
+
 	bool IsFull() const {
 		return list.size() >= max_size;
 	}
 
 	void Add(Client &client) {
 		list.push_front(client);
+
+		/* don't report events which have occurred before
+		   the client connected */
+		client.idle_serial = idle_serial;
 	}
 
 	void Remove(Client &client);
 
 	void CloseAll();
 
+	/**
+	 * Notify the clients which are waiting for one of the given
+	 * idle events.  The other clients pick them up with
+	 * IdleCollect() when they enter "idle" mode.
+	 */
 	void IdleAdd(unsigned flags);
+
+	/**
+	 * Return the idle events which have occurred since the last
+	 * call for this client.
+	 */
+	unsigned IdleCollect(Client &client);
+
+	/**
+	 * Register the client for the given idle events, replacing
+	 * the previous registration.
+	 */
+	void IdleWatch(Client &client, unsigned flags);
+
+	void IdleUnwatch(Client &client);
 };
 
 #endif
@@ -20,6 +20,10 @@
 #include "config.h"
 #include "ClientInternal.hxx"
 #include "ClientList.hxx"
+#include "ClientThread.hxx"
+#ifdef ENABLE_ZLIB
+#include "ClientCompress.hxx"
+#endif
 #include "Partition.hxx"
 #include "Instance.hxx"
 #include "system/fd_util.h"
@@ -42,8 +46,12 @@
 static const char GREETING[] = "OK MPD " PROTOCOL_VERSION "\n";
 
 Client::Client(EventLoop &_loop, Partition &_partition,
-	       int _fd, int _uid, int _num)
-	:FullyBufferedSocket(_fd, _loop, 16384, client_max_output_buffer_size),
+	       int _fd, int _uid, int _num, ClientThread *_thread)
+	/* busy clients send many small commands; with edge-triggered
+	   events, switching between reading and writing needs no
+	   system call */
+	:FullyBufferedSocket(_fd, _loop, 16384, client_max_output_buffer_size,
+			     true),
 	 TimeoutMonitor(_loop),
 	 partition(_partition),
 	 playlist(partition.playlist), player_control(partition.pc),
@@ -51,9 +59,32 @@ Client::Client(EventLoop &_loop, Partition &_partition,
 	 uid(_uid),
 	 num(_num),
 	 idle_waiting(false), idle_flags(0),
-	 num_subscriptions(0)
+	 idle_interval(0), idle_serial(0), idle_watch(0),
+	 num_subscriptions(0),
+	 binary_limit(8192), tabular_songs(false),
+	 producer_command(nullptr),
+	 thread(_thread), expire_pending(false),
+	 idle_monitor(_loop, *this, &Client::OnIdleMonitor),
+#ifdef ENABLE_ZLIB
+	 compress_requested(false),
+#endif
+	 idle_delay(_loop, *this, &Client::OnIdleDelay),
+	 idle_last_notify(0)
 {
+	/* the connection timeout doesn't need to be precise */
+	TimeoutMonitor::SetSlack(1000);
+
 	TimeoutMonitor::ScheduleSeconds(client_timeout);
+
+	MemStatsAllocate(MemStatsCategory::CLIENT_OUTPUT, 0);
+}
+
+Client::~Client()
+{
+	MemStatsFree(MemStatsCategory::CLIENT_OUTPUT, output_allocated);
+
+	if (FullyBufferedSocket::IsDefined())
+		FullyBufferedSocket::Close();
 }
 
 void
@@ -94,21 +125,47 @@ client_new(EventLoop &loop, Partition &partition,
 		return;
 	}
 
-	Client *client = new Client(loop, partition, fd, uid,
-				    next_client_num++);
+	const unsigned num = next_client_num++;
+
+	ClientThread *thread = client_threads_next();
+	if (thread != nullptr) {
+		client_thread_add(*thread, partition, fd, uid, num,
+				  std::string(remote));
+		return;
+	}
+
+	client_open(loop, partition, fd, uid, num, remote.c_str(), nullptr);
+}
+
+Client *
+client_open(EventLoop &loop, Partition &partition,
+	    int fd, int uid, unsigned num, const char *remote,
+	    ClientThread *thread)
+{
+	Client *client = new Client(loop, partition, fd, uid, num, thread);
 
 	(void)send(fd, GREETING, sizeof(GREETING) - 1, 0);
 
-	client_list.Add(*client);
+	ClientList &client_list = *partition.instance.client_list;
+	client->RunInMainThread([&client_list, client](){
+			client_list.Add(*client);
+		});
 
 	FormatInfo(client_domain, "[%u] opened from %s",
-		   client->num, remote.c_str());
+		   client->num, remote);
+	return client;
 }
 
 void
 Client::Close()
 {
-	partition.instance.client_list->Remove(*this);
+	ClientList &client_list = *partition.instance.client_list;
+	RunInMainThread([&client_list, this](){
+			client_list.Remove(*this);
+		});
+
+	if (thread != nullptr)
+		client_thread_remove(*thread, *this);
 
 	SetExpired();
 
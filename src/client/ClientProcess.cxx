@@ -21,8 +21,18 @@
 #include "ClientInternal.hxx"
 #include "protocol/Result.hxx"
 #include "command/AllCommands.hxx"
+#include "queue/Playlist.hxx"
+#ifdef ENABLE_SQLITE
+#include "sticker/StickerDatabase.hxx"
+#endif
 #include "Log.hxx"
+#include "util/ConstBuffer.hxx"
 #include "util/StringAPI.hxx"
+#include "util/StringUtil.hxx"
+
+#include <vector>
+
+#include <string.h>
 
 #define CLIENT_LIST_MODE_BEGIN "command_list_begin"
 #define CLIENT_LIST_OK_MODE_BEGIN "command_list_ok_begin"
@@ -30,14 +40,24 @@
 
 static CommandResult
 client_process_command_list(Client &client, bool list_ok,
-			    std::list<std::string> &&list)
+			    ConstBuffer<char *> list)
 {
 	CommandResult ret = CommandResult::OK;
 	unsigned num = 0;
 
-	for (auto &&i : list) {
-		char *cmd = &*i.begin();
+	/* apply all queue modifications in one step; this saves a
+	   version increment and an idle event per command, e.g. when
+	   adding thousands of songs with "addid" */
+	playlist &playlist = client.playlist;
+	playlist.BeginBulk();
 
+#ifdef ENABLE_SQLITE
+	/* same for the sticker database: commit all modifications in
+	   one transaction */
+	sticker_begin_batch();
+#endif
+
+	for (char *cmd : list) {
 		FormatDebug(client_domain, "process command \"%s\"", cmd);
 		ret = command_process(client, num++, cmd);
 		FormatDebug(client_domain, "command returned %i", int(ret));
@@ -47,9 +67,132 @@ client_process_command_list(Client &client, bool list_ok,
 			client_puts(client, "list_OK\n");
 	}
 
+	playlist.CommitBulk(client.player_control);
+
+#ifdef ENABLE_SQLITE
+	sticker_commit_batch();
+#endif
+
+	return ret;
+}
+
+/**
+ * Execute the command list which is currently being built, and
+ * leave list mode.  The list (which may point into the
+ * #CommandListBuilder or into the socket input buffer) must remain
+ * valid until this function returns.
+ */
+static CommandResult
+client_finish_command_list(Client &client, ConstBuffer<char *> list)
+{
+	FormatDebug(client_domain,
+		    "[%u] process command list",
+		    client.num);
+
+	CommandResult ret =
+		client_process_command_list(client,
+					    client.cmd_list.IsOKMode(),
+					    list);
+	FormatDebug(client_domain,
+		    "[%u] process command "
+		    "list returned %i", client.num, int(ret));
+
+	if (ret == CommandResult::CLOSE ||
+	    client.IsExpired())
+		return CommandResult::CLOSE;
+
+	if (ret == CommandResult::OK)
+		command_success(client);
+
+	client.cmd_list.Reset();
 	return ret;
 }
 
+/**
+ * Compare a line (which is terminated by a newline, not by a null
+ * byte) with the given string, ignoring trailing whitespace.
+ */
+gcc_pure
+static bool
+LineIsEqual(const char *line, const char *newline, const char *s)
+{
+	const char *end = StripRight(line, newline);
+	const size_t length = end - line;
+	return length == strlen(s) && memcmp(line, s, length) == 0;
+}
+
+size_t
+client_process_buffered_command_list(Client &client,
+				     char *data, size_t length,
+				     CommandResult &result_r)
+{
+	if (client.idle_waiting || client.cmd_list.IsActive())
+		return 0;
+
+	char *const end = data + length;
+	char *newline = (char *)memchr(data, '\n', length);
+	if (newline == nullptr)
+		return 0;
+
+	bool list_ok;
+	if (LineIsEqual(data, newline, CLIENT_LIST_MODE_BEGIN))
+		list_ok = false;
+	else if (LineIsEqual(data, newline, CLIENT_LIST_OK_MODE_BEGIN))
+		list_ok = true;
+	else
+		return 0;
+
+	/* first pass: check whether the whole list is in the buffer
+	   and doesn't exceed the limit, without modifying the
+	   buffer, because if it isn't, the input will be parsed
+	   line by line by client_process_line() */
+
+	size_t n_lines = 0, list_size = 0;
+	char *p = newline + 1;
+	while (true) {
+		newline = (char *)memchr(p, '\n', end - p);
+		if (newline == nullptr)
+			return 0;
+
+		if (LineIsEqual(p, newline, CLIENT_LIST_MODE_END))
+			break;
+
+		list_size += StripRight(p, newline) - p + 1;
+		if (list_size > client_max_command_list_size)
+			return 0;
+
+		++n_lines;
+		p = newline + 1;
+	}
+
+	char *const list_end = newline + 1;
+
+	/* second pass: null-terminate the lines and execute them
+	   right from the input buffer */
+
+	std::vector<char *> list;
+	list.reserve(n_lines);
+
+	for (p = (char *)memchr(data, '\n', length) + 1; p < list_end;
+	     p = newline + 1) {
+		newline = (char *)memchr(p, '\n', list_end - p);
+		*StripRight(p, newline) = 0;
+
+		/* "noidle" is never added to a command list; see
+		   client_process_line() */
+		if (!StringIsEqual(p, "noidle"))
+			list.push_back(p);
+	}
+
+	/* remove the "command_list_end" line */
+	list.pop_back();
+
+	client.cmd_list.Begin(list_ok);
+	result_r = client_finish_command_list(client,
+					      {list.data(), list.size()});
+	return list_end - data;
+}
+
 CommandResult
 client_process_line(Client &client, char *line)
 {
@@ -58,7 +201,7 @@ client_process_line(Client &client, char *line)
 	if (StringIsEqual(line, "noidle")) {
 		if (client.idle_waiting) {
 			/* send empty idle response and leave idle mode */
-			client.idle_waiting = false;
+			client.IdleCancel();
 			command_success(client);
 		}
 
@@ -78,27 +221,8 @@ client_process_line(Client &client, char *line)
 
 	if (client.cmd_list.IsActive()) {
 		if (StringIsEqual(line, CLIENT_LIST_MODE_END)) {
-			FormatDebug(client_domain,
-				    "[%u] process command list",
-				    client.num);
-
-			auto &&cmd_list = client.cmd_list.Commit();
-
-			ret = client_process_command_list(client,
-							  client.cmd_list.IsOKMode(),
-							  std::move(cmd_list));
-			FormatDebug(client_domain,
-				    "[%u] process command "
-				    "list returned %i", client.num, int(ret));
-
-			if (ret == CommandResult::CLOSE ||
-			    client.IsExpired())
-				return CommandResult::CLOSE;
-
-			if (ret == CommandResult::OK)
-				command_success(client);
-
-			client.cmd_list.Reset();
+			ret = client_finish_command_list(client,
+							 client.cmd_list.Commit());
 		} else {
 			if (!client.cmd_list.Add(line)) {
 				FormatWarning(client_domain,
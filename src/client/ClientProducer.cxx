@@ -0,0 +1,110 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ClientInternal.hxx"
+#include "ResponseProducer.hxx"
+#include "Response.hxx"
+#include "command/CommandError.hxx"
+#include "protocol/Result.hxx"
+
+#include <assert.h>
+
+/**
+ * A #ResponseProducer pauses when the output buffer contains at least
+ * this number of bytes.
+ */
+static constexpr size_t CLIENT_OUTPUT_CHUNK = 64 * 1024;
+
+bool
+Client::IsOutputFull() const
+{
+	return GetOutputSize() + pending_output.size() >= CLIENT_OUTPUT_CHUNK;
+}
+
+static CommandResult
+Produce(ResponseProducer &producer, Response &r)
+try {
+	return producer.Produce(r);
+} catch (...) {
+	PrintError(r, std::current_exception());
+	return CommandResult::ERROR;
+}
+
+CommandResult
+Client::RunProducer(Response &r, std::unique_ptr<ResponseProducer> &&p)
+{
+	assert(producer == nullptr);
+
+	CommandResult result = Produce(*p, r);
+	if (result != CommandResult::BACKGROUND)
+		return result;
+
+	if (cmd_list.IsActive()) {
+		/* the rest of the command list must not run before
+		   this response is complete, so this is the old
+		   (fully buffered) behaviour */
+		do {
+			result = Produce(*p, r);
+		} while (result == CommandResult::BACKGROUND);
+
+		return result;
+	}
+
+	producer = std::move(p);
+	producer_command = r.GetCommand();
+	return CommandResult::BACKGROUND;
+}
+
+bool
+Client::OnSocketDrained()
+{
+	/* the peak buffer has been freed */
+	UpdateOutputMemStats();
+
+	if (producer == nullptr || IsExpired())
+		return true;
+
+	/* the client is still reading, so don't let it expire */
+	TimeoutMonitor::ScheduleSeconds(client_timeout);
+
+	CommandResult result;
+	RunInMainThread([this, &result](){
+			Response r(*this, 0);
+			r.SetCommand(producer_command);
+
+			result = Produce(*producer, r);
+			if (result == CommandResult::BACKGROUND)
+				return;
+
+			producer.reset();
+
+			if (result == CommandResult::OK)
+				command_success(*this);
+		});
+
+	if (result == CommandResult::BACKGROUND)
+		return true;
+
+	if (IsExpired())
+		return false;
+
+	/* process the commands which were received meanwhile */
+	return ResumeInput();
+}
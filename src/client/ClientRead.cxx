@@ -29,6 +29,11 @@
 BufferedSocket::InputResult
 Client::OnSocketInput(void *data, size_t length)
 {
+	if (producer != nullptr)
+		/* the previous response is not yet complete; see
+		   RunProducer() */
+		return InputResult::PAUSE;
+
 	char *p = (char *)data;
 	char *newline = (char *)memchr(p, '\n', length);
 	if (newline == nullptr)
@@ -36,18 +41,36 @@ Client::OnSocketInput(void *data, size_t length)
 
 	TimeoutMonitor::ScheduleSeconds(client_timeout);
 
-	BufferedSocket::ConsumeInput(newline + 1 - p);
+	CommandResult result;
+	size_t consumed;
+	RunInMainThread([this, p, length, newline, &consumed, &result](){
+			/* if a whole command list has been received,
+			   run it right from the input buffer */
+			consumed = client_process_buffered_command_list(*this,
+									p, length,
+									result);
+			if (consumed > 0)
+				return;
+
+			consumed = newline + 1 - p;
+
+			/* skip whitespace at the end of the line */
+			char *end = StripRight(p, newline);
 
-	/* skip whitespace at the end of the line */
-	char *end = StripRight(p, newline);
+			/* terminate the string at the end of the line */
+			*end = 0;
 
-	/* terminate the string at the end of the line */
-	*end = 0;
+			result = client_process_line(*this, p);
+		});
+
+	/* the input buffer is not modified while the commands run,
+	   so it can be consumed afterwards */
+	BufferedSocket::ConsumeInput(consumed);
 
-	CommandResult result = client_process_line(*this, p);
 	switch (result) {
 	case CommandResult::OK:
 	case CommandResult::IDLE:
+	case CommandResult::BACKGROUND:
 	case CommandResult::ERROR:
 		break;
 
@@ -57,6 +80,7 @@ Client::OnSocketInput(void *data, size_t length)
 		return InputResult::CLOSED;
 
 	case CommandResult::FINISH:
+		FlushCompressor();
 		if (Flush())
 			Close();
 		return InputResult::CLOSED;
@@ -71,5 +95,7 @@ Client::OnSocketInput(void *data, size_t length)
 		return InputResult::CLOSED;
 	}
 
+	StartCompression();
+
 	return InputResult::AGAIN;
 }
@@ -0,0 +1,406 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ClientThread.hxx"
+#include "ClientInternal.hxx"
+#include "event/Loop.hxx"
+#include "event/DeferredMonitor.hxx"
+#include "event/MaskMonitor.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "ThreadSettings.hxx"
+#include "system/fd_util.h"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <list>
+#include <set>
+
+#include <assert.h>
+
+/**
+ * A thread with its own #EventLoop which handles the sockets of a
+ * subset of all clients.
+ */
+class ClientThread {
+	static constexpr unsigned NEW_CLIENTS = 0x1;
+	static constexpr unsigned QUIT = 0x2;
+
+	struct NewClient {
+		Partition &partition;
+		int fd, uid;
+		unsigned num;
+		std::string remote;
+	};
+
+	EventLoop loop;
+
+	Thread thread;
+
+	CallbackMaskMonitor<ClientThread> events;
+
+	/**
+	 * Protects #new_clients.
+	 */
+	Mutex mutex;
+
+	/**
+	 * Connections submitted by the main thread, to be picked up
+	 * by HandleEvents().
+	 */
+	std::list<NewClient> new_clients;
+
+	/**
+	 * All clients handled by this thread.  Only accessed from
+	 * within this thread.
+	 */
+	std::set<Client *> clients;
+
+public:
+	ClientThread()
+		:events(loop, *this, &ClientThread::HandleEvents) {}
+
+	~ClientThread() {
+		for (const auto &i : new_clients)
+			close_socket(i.fd);
+	}
+
+	bool Start(Error &error) {
+		return thread.Start(ThreadFunc, this, error);
+	}
+
+	void Stop() {
+		events.OrMask(QUIT);
+	}
+
+	void Join() {
+		thread.Join();
+	}
+
+	void Add(Partition &partition, int fd, int uid, unsigned num,
+		 std::string &&remote) {
+		mutex.lock();
+		new_clients.push_back({partition, fd, uid, num,
+					std::move(remote)});
+		mutex.unlock();
+
+		events.OrMask(NEW_CLIENTS);
+	}
+
+	void Remove(Client &client) {
+		assert(loop.IsInside());
+
+		clients.erase(&client);
+	}
+
+private:
+	void HandleEvents(unsigned mask);
+
+	static void ThreadFunc(void *ctx);
+};
+
+static unsigned n_client_threads;
+static ClientThread *client_threads;
+static unsigned next_client_thread;
+
+/**
+ * Executes the functions passed to client_threads_invoke_main() in
+ * the main thread.
+ */
+class MainCallQueue final : DeferredMonitor {
+	struct Call {
+		const std::function<void()> &f;
+		bool done;
+	};
+
+	Mutex mutex;
+
+	/**
+	 * Signalled when a #Call is done, when a new #Call has been
+	 * pushed after the main loop has stopped, and when an I/O
+	 * thread exits.
+	 */
+	Cond cond;
+
+	std::list<Call *> calls;
+
+	/**
+	 * The number of I/O threads which have not yet exited.
+	 */
+	unsigned n_running = 0;
+
+	/**
+	 * Has the main loop stopped?  Then client_threads_finish()
+	 * runs the calls until all I/O threads have exited.
+	 */
+	bool stopped = false;
+
+public:
+	explicit MainCallQueue(EventLoop &_loop)
+		:DeferredMonitor(_loop) {}
+
+	void ThreadStarted() {
+		const ScopeLock protect(mutex);
+		++n_running;
+	}
+
+	void ThreadExited() {
+		const ScopeLock protect(mutex);
+		assert(n_running > 0);
+		--n_running;
+		cond.broadcast();
+	}
+
+	void Invoke(const std::function<void()> &f);
+
+	/**
+	 * Called by client_threads_finish() after the main loop has
+	 * returned: run the remaining calls in this thread until all
+	 * I/O threads have exited.
+	 */
+	void Drain();
+
+private:
+	/**
+	 * Run all pending calls.  Caller must hold the mutex.
+	 */
+	void RunCalls();
+
+	/* virtual methods from class DeferredMonitor */
+	void RunDeferred() override {
+		const ScopeLock protect(mutex);
+		RunCalls();
+	}
+};
+
+static MainCallQueue *main_call_queue;
+
+void
+MainCallQueue::Invoke(const std::function<void()> &f)
+{
+	Call call{f, false};
+
+	const ScopeLock protect(mutex);
+	calls.push_back(&call);
+
+	if (stopped)
+		cond.broadcast();
+	else
+		Schedule();
+
+	while (!call.done)
+		cond.wait(mutex);
+}
+
+void
+MainCallQueue::RunCalls()
+{
+	while (!calls.empty()) {
+		Call &call = *calls.front();
+		calls.pop_front();
+
+		mutex.unlock();
+		call.f();
+		mutex.lock();
+
+		call.done = true;
+		cond.broadcast();
+	}
+}
+
+void
+MainCallQueue::Drain()
+{
+	const ScopeLock protect(mutex);
+	stopped = true;
+
+	while (true) {
+		RunCalls();
+
+		if (n_running == 0)
+			break;
+
+		cond.wait(mutex);
+	}
+
+	DeferredMonitor::Cancel();
+}
+
+void
+ClientThread::HandleEvents(unsigned mask)
+{
+	if (mask & NEW_CLIENTS) {
+		mutex.lock();
+		auto list = std::move(new_clients);
+		new_clients.clear();
+		mutex.unlock();
+
+		for (auto &i : list)
+			clients.insert(client_open(loop, i.partition,
+						   i.fd, i.uid, i.num,
+						   i.remote.c_str(), this));
+	}
+
+	if (mask & QUIT) {
+		/* Client::Close() removes the client from the set */
+		while (!clients.empty())
+			(*clients.begin())->Close();
+
+		loop.Break();
+	}
+}
+
+void
+ClientThread::ThreadFunc(void *ctx)
+{
+	SetThreadName("client");
+	ApplyThreadSettings("client");
+
+	ClientThread &t = *(ClientThread *)ctx;
+	t.loop.Run();
+
+	main_call_queue->ThreadExited();
+}
+
+void
+client_threads_init(EventLoop &main_loop, unsigned n_threads)
+{
+	assert(client_threads == nullptr);
+
+	if (n_threads == 0)
+		return;
+
+	main_call_queue = new MainCallQueue(main_loop);
+	client_threads = new ClientThread[n_threads];
+
+	for (unsigned i = 0; i < n_threads; ++i) {
+		main_call_queue->ThreadStarted();
+
+		Error error;
+		if (!client_threads[i].Start(error)) {
+			main_call_queue->ThreadExited();
+			LogError(error);
+			break;
+		}
+
+		++n_client_threads;
+	}
+}
+
+void
+client_threads_finish()
+{
+	if (client_threads == nullptr)
+		return;
+
+	for (unsigned i = 0; i < n_client_threads; ++i)
+		client_threads[i].Stop();
+
+	main_call_queue->Drain();
+
+	for (unsigned i = 0; i < n_client_threads; ++i)
+		client_threads[i].Join();
+
+	delete[] client_threads;
+	client_threads = nullptr;
+	n_client_threads = 0;
+
+	delete main_call_queue;
+	main_call_queue = nullptr;
+}
+
+ClientThread *
+client_threads_next()
+{
+	if (n_client_threads == 0)
+		return nullptr;
+
+	ClientThread &t = client_threads[next_client_thread];
+	next_client_thread = (next_client_thread + 1) % n_client_threads;
+	return &t;
+}
+
+void
+client_thread_add(ClientThread &thread, Partition &partition,
+		  int fd, int uid, unsigned num, std::string &&remote)
+{
+	thread.Add(partition, fd, uid, num, std::move(remote));
+}
+
+void
+client_thread_remove(ClientThread &thread, Client &client)
+{
+	thread.Remove(client);
+}
+
+void
+client_threads_invoke_main(const std::function<void()> &f)
+{
+	assert(main_call_queue != nullptr);
+
+	main_call_queue->Invoke(f);
+}
+
+bool
+Client::IsInMainCall()
+{
+	return thread != nullptr && !GetEventLoop().IsInside();
+}
+
+void
+Client::InvokeMain(const std::function<void()> &f)
+{
+	assert(thread != nullptr);
+	assert(!IsInMainCall());
+
+	client_threads_invoke_main(f);
+	AfterMainCall();
+}
+
+void
+Client::AfterMainCall()
+{
+	if (expire_pending) {
+		expire_pending = false;
+		pending_output.clear();
+		SetExpired();
+		return;
+	}
+
+	if (!pending_output.empty()) {
+		Write(pending_output.data(), pending_output.size());
+		pending_output.clear();
+	}
+
+	if (IsExpired())
+		return;
+
+	if (idle_waiting) {
+		/* disable timeouts while in "idle" */
+		TimeoutMonitor::Cancel();
+
+		/* IdleWait() has left this to the I/O thread */
+		if (idle_flags & idle_subscriptions)
+			IdleCheck();
+	} else
+		TimeoutMonitor::ScheduleSeconds(client_timeout);
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CLIENT_THREAD_HXX
+#define MPD_CLIENT_THREAD_HXX
+
+#include "check.h"
+
+#include <functional>
+#include <string>
+
+class EventLoop;
+class Client;
+class ClientThread;
+struct Partition;
+
+/**
+ * Start the client I/O threads.  Each one runs its own #EventLoop
+ * which does all socket I/O and timeouts of the clients assigned to
+ * it; commands are still executed in the main thread (see
+ * client_threads_invoke_main()), because the partition, the queue
+ * and everything else are not thread-safe.
+ *
+ * @param n_threads the number of threads; 0 means all clients are
+ * handled by the main thread
+ */
+void
+client_threads_init(EventLoop &main_loop, unsigned n_threads);
+
+/**
+ * Close all clients handled by I/O threads and stop the threads.
+ * Must be called in the main thread after its #EventLoop has
+ * returned.
+ */
+void
+client_threads_finish();
+
+/**
+ * Choose the I/O thread which shall handle the next connection.
+ *
+ * @return the thread, or nullptr if there are no I/O threads
+ */
+ClientThread *
+client_threads_next();
+
+/**
+ * Hand a new connection over to the specified I/O thread.  The
+ * #Client object will be created in that thread.
+ */
+void
+client_thread_add(ClientThread &thread, Partition &partition,
+		  int fd, int uid, unsigned num, std::string &&remote);
+
+/**
+ * Forget about a #Client which has been closed.  Must be called in
+ * the client's I/O thread.
+ */
+void
+client_thread_remove(ClientThread &thread, Client &client);
+
+/**
+ * Run the function in the main thread and wait for it to finish.
+ * Must be called from an I/O thread.  The main thread never waits
+ * for an I/O thread, so this cannot deadlock.
+ */
+void
+client_threads_invoke_main(const std::function<void()> &f);
+
+#endif
@@ -18,9 +18,13 @@
  */
 
 #include "config.h"
-#include "Client.hxx"
+#include "ClientInternal.hxx"
+#ifdef ENABLE_ZLIB
+#include "ClientCompress.hxx"
+#endif
 #include "util/FormatString.hxx"
 #include "util/AllocatedString.hxx"
+#include "Log.hxx"
 
 #include <string.h>
 
@@ -28,7 +32,65 @@ bool
 Client::Write(const void *data, size_t length)
 {
 	/* if the client is going to be closed, do nothing */
-	return !IsExpired() && FullyBufferedSocket::Write(data, length);
+	if (IsExpired())
+		return false;
+
+	if (IsInMainCall()) {
+		/* the socket belongs to the I/O thread; see
+		   AfterMainCall() */
+		if (GetOutputSize() + pending_output.size() + length >
+		    client_max_output_buffer_size) {
+			FormatError(client_domain,
+				    "error on client %d: Output buffer is full",
+				    num);
+			SetExpired();
+			return false;
+		}
+
+		pending_output.append((const char *)data, length);
+		return true;
+	}
+
+#ifdef ENABLE_ZLIB
+	if (compressor != nullptr)
+		return compressor->Feed(data, length);
+#endif
+
+	const bool success = FullyBufferedSocket::Write(data, length);
+	UpdateOutputMemStats();
+	return success;
+}
+
+bool
+Client::WriteSocket(const void *data, size_t length)
+{
+	if (IsExpired())
+		return false;
+
+	const bool success = FullyBufferedSocket::Write(data, length);
+	UpdateOutputMemStats();
+	return success;
+}
+
+void
+Client::StartCompression()
+{
+#ifdef ENABLE_ZLIB
+	if (compress_requested) {
+		compress_requested = false;
+		compressor.reset(new ClientCompressor(GetEventLoop(),
+						      *this));
+	}
+#endif
+}
+
+void
+Client::FlushCompressor()
+{
+#ifdef ENABLE_ZLIB
+	if (compressor != nullptr)
+		compressor->Flush();
+#endif
 }
 
 bool
@@ -46,7 +108,10 @@ client_puts(Client &client, const char *s)
 void
 client_vprintf(Client &client, const char *fmt, va_list args)
 {
-	client.Write(FormatStringV(fmt, args).c_str());
+	char buffer[1024];
+	AllocatedString<> allocated = nullptr;
+	client.Write(FormatStringV(buffer, sizeof(buffer), allocated,
+				   fmt, args));
 }
 
 void
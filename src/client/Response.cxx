@@ -22,23 +22,60 @@
 #include "Client.hxx"
 #include "util/FormatString.hxx"
 #include "util/AllocatedString.hxx"
+#include "util/StringBuilder.hxx"
+
+#include <assert.h>
+#include <string.h>
 
 bool
 Response::Write(const void *data, size_t length)
 {
+	n_written += length;
+
+	if (capture != nullptr) {
+		capture->append((const char *)data, length);
+		if (capture_only)
+			return true;
+	}
+
 	return client.Write(data, length);
 }
 
 bool
 Response::Write(const char *data)
 {
-	return client.Write(data);
+	return Write(data, strlen(data));
+}
+
+bool
+Response::Write(const StringBuilder &b)
+{
+	assert(!b.IsFull());
+
+	return Write(b.GetData(), b.GetSize());
+}
+
+bool
+Response::WriteAttribute(const char *name, const char *value)
+{
+	char buffer[1024];
+	StringBuilder b(buffer);
+	b.Append(name).Append(": ", 2).Append(value).Append('\n');
+	if (!b.IsFull())
+		return Write(b);
+
+	/* too long for the stack buffer; write it piece by piece */
+	return Write(name) && Write(": ", 2) && Write(value) &&
+		Write("\n", 1);
 }
 
 bool
 Response::FormatV(const char *fmt, va_list args)
 {
-	return Write(FormatStringV(fmt, args).c_str());
+	char buffer[1024];
+	AllocatedString<> allocated = nullptr;
+	return Write(FormatStringV(buffer, sizeof(buffer), allocated,
+				   fmt, args));
 }
 
 bool
@@ -23,10 +23,13 @@
 #include "check.h"
 #include "protocol/Ack.hxx"
 
+#include <string>
+
 #include <stddef.h>
 #include <stdarg.h>
 
 class Client;
+class StringBuilder;
 
 class Response {
 	Client &client;
@@ -42,19 +45,81 @@ class Response {
 	 */
 	const char *command;
 
+	/**
+	 * If not nullptr, then everything written to the client is
+	 * also appended to this string.  See StartCapture().
+	 */
+	std::string *capture;
+
+	/**
+	 * If true, then the output is only appended to #capture, and
+	 * not sent to the client.
+	 */
+	bool capture_only;
+
+	/**
+	 * The number of bytes written so far.  Used for the command
+	 * statistics.
+	 */
+	size_t n_written;
+
 public:
 	Response(Client &_client, unsigned _list_index)
-		:client(_client), list_index(_list_index), command("") {}
+		:client(_client), list_index(_list_index), command(""),
+		 capture(nullptr), capture_only(false), n_written(0) {}
 
 	Response(const Response &) = delete;
 	Response &operator=(const Response &) = delete;
 
+	Client &GetClient() {
+		return client;
+	}
+
 	void SetCommand(const char *_command) {
 		command = _command;
 	}
 
+	const char *GetCommand() const {
+		return command;
+	}
+
+	/**
+	 * Record a copy of all subsequent output in the given string,
+	 * until StopCapture() is called.  This is used to fill the
+	 * response cache.
+	 *
+	 * @param only if true, then the output is not sent to the
+	 * client; this allows formatting a response in a thread which
+	 * must not access the client
+	 */
+	void StartCapture(std::string &_capture, bool only=false) {
+		capture = &_capture;
+		capture_only = only;
+	}
+
+	void StopCapture() {
+		capture = nullptr;
+		capture_only = false;
+	}
+
+	size_t GetWritten() const {
+		return n_written;
+	}
+
 	bool Write(const void *data, size_t length);
 	bool Write(const char *data);
+
+	/**
+	 * Write the contents of the #StringBuilder, which must not be
+	 * full.
+	 */
+	bool Write(const StringBuilder &b);
+
+	/**
+	 * Write a "NAME: VALUE" line.  This is cheaper than Format().
+	 */
+	bool WriteAttribute(const char *name, const char *value);
+
 	bool FormatV(const char *fmt, va_list args);
 	bool Format(const char *fmt, ...);
 
@@ -0,0 +1,55 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_RESPONSE_PRODUCER_HXX
+#define MPD_RESPONSE_PRODUCER_HXX
+
+#include "check.h"
+#include "command/CommandResult.hxx"
+
+class Response;
+
+/**
+ * Generates a large response in several parts, so it does not need
+ * to be formatted into the client's output buffer all at once.  See
+ * Client::RunProducer().
+ *
+ * The object must not keep pointers into the database or the queue
+ * between two Produce() calls, because those may be modified
+ * meanwhile.
+ */
+class ResponseProducer {
+public:
+	virtual ~ResponseProducer() {}
+
+	/**
+	 * Write the next part of the response.  The method shall
+	 * return as soon as Client::IsOutputFull() becomes true.
+	 *
+	 * Exceptions are caught by the caller and reported to the
+	 * client.
+	 *
+	 * @return CommandResult::OK if the response is complete,
+	 * CommandResult::BACKGROUND if there is more, or
+	 * CommandResult::ERROR after an error has been sent
+	 */
+	virtual CommandResult Produce(Response &r) = 0;
+};
+
+#endif
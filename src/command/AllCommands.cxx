@@ -21,6 +21,7 @@
 #include "AllCommands.hxx"
 #include "CommandError.hxx"
 #include "Request.hxx"
+#include "ScratchArena.hxx"
 #include "QueueCommands.hxx"
 #include "TagCommands.hxx"
 #include "PlayerCommands.hxx"
@@ -33,14 +34,25 @@
 #include "NeighborCommands.hxx"
 #include "OtherCommands.hxx"
 #include "Permission.hxx"
+#include "PerfStats.hxx"
 #include "tag/TagType.h"
 #include "Partition.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "system/Clock.hxx"
+#include "system/Trace.hxx"
 #include "util/Macros.hxx"
 #include "util/Tokenizer.hxx"
 #include "util/Error.hxx"
+#include "util/Domain.hxx"
 #include "util/StringAPI.hxx"
+#include "Log.hxx"
+
+#ifdef ENABLE_DATABASE
+#include "db/DatabaseLock.hxx"
+#endif
 
 #ifdef ENABLE_SQLITE
 #include "StickerCommands.hxx"
@@ -74,6 +86,9 @@ handle_commands(Client &client, Request request, Response &response);
 static CommandResult
 handle_not_commands(Client &client, Request request, Response &response);
 
+static CommandResult
+handle_commandstats(Client &client, Request request, Response &response);
+
 /**
  * The command registry.
  *
@@ -83,12 +98,18 @@ static constexpr struct command commands[] = {
 	{ "add", PERMISSION_ADD, 1, 1, handle_add },
 	{ "addid", PERMISSION_ADD, 1, 2, handle_addid },
 	{ "addtagid", PERMISSION_ADD, 3, 3, handle_addtagid },
+	{ "albumart", PERMISSION_READ, 2, 2, handle_album_art },
+	{ "binarylimit", PERMISSION_NONE, 1, 1, handle_binary_limit },
 	{ "channels", PERMISSION_READ, 0, 0, handle_channels },
 	{ "clear", PERMISSION_CONTROL, 0, 0, handle_clear },
 	{ "clearerror", PERMISSION_CONTROL, 0, 0, handle_clearerror },
 	{ "cleartagid", PERMISSION_ADD, 1, 2, handle_cleartagid },
 	{ "close", PERMISSION_NONE, -1, -1, handle_close },
 	{ "commands", PERMISSION_NONE, 0, 0, handle_commands },
+	{ "commandstats", PERMISSION_READ, 0, 0, handle_commandstats },
+#ifdef ENABLE_ZLIB
+	{ "compress", PERMISSION_NONE, 1, 1, handle_compress },
+#endif
 	{ "config", PERMISSION_ADMIN, 0, 0, handle_config },
 	{ "consume", PERMISSION_CONTROL, 1, 1, handle_consume },
 #ifdef ENABLE_DATABASE
@@ -106,11 +127,13 @@ static constexpr struct command commands[] = {
 	{ "findadd", PERMISSION_ADD, 2, -1, handle_findadd},
 #endif
 	{ "idle", PERMISSION_READ, 0, -1, handle_idle },
+	{ "idleinterval", PERMISSION_NONE, 1, 1, handle_idle_interval },
+	{ "inputstats", PERMISSION_READ, 0, 0, handle_inputstats },
 	{ "kill", PERMISSION_ADMIN, -1, -1, handle_kill },
 #ifdef ENABLE_DATABASE
 	{ "list", PERMISSION_READ, 1, -1, handle_list },
-	{ "listall", PERMISSION_READ, 0, 1, handle_listall },
-	{ "listallinfo", PERMISSION_READ, 0, 1, handle_listallinfo },
+	{ "listall", PERMISSION_READ, 0, 5, handle_listall },
+	{ "listallinfo", PERMISSION_READ, 0, 5, handle_listallinfo },
 #endif
 	{ "listfiles", PERMISSION_READ, 0, 1, handle_listfiles },
 #ifdef ENABLE_DATABASE
@@ -124,6 +147,7 @@ static constexpr struct command commands[] = {
 	{ "listplaylists", PERMISSION_READ, 0, 0, handle_listplaylists },
 	{ "load", PERMISSION_ADD, 1, 2, handle_load },
 	{ "lsinfo", PERMISSION_READ, 0, 1, handle_lsinfo },
+	{ "memstats", PERMISSION_READ, 0, 0, handle_memstats },
 	{ "mixrampdb", PERMISSION_CONTROL, 1, 1, handle_mixrampdb },
 	{ "mixrampdelay", PERMISSION_CONTROL, 1, 1, handle_mixrampdelay },
 #ifdef ENABLE_DATABASE
@@ -136,6 +160,7 @@ static constexpr struct command commands[] = {
 	{ "outputs", PERMISSION_READ, 0, 0, handle_devices },
 	{ "password", PERMISSION_NONE, 1, 1, handle_password },
 	{ "pause", PERMISSION_CONTROL, 0, 1, handle_pause },
+	{ "perfstats", PERMISSION_READ, 0, 0, handle_perfstats },
 	{ "ping", PERMISSION_NONE, 0, 0, handle_ping },
 	{ "play", PERMISSION_CONTROL, 0, 1, handle_play },
 	{ "playid", PERMISSION_CONTROL, 0, 1, handle_playid },
@@ -178,6 +203,7 @@ static constexpr struct command commands[] = {
 	{ "setvol", PERMISSION_CONTROL, 1, 1, handle_setvol },
 	{ "shuffle", PERMISSION_CONTROL, 0, 1, handle_shuffle },
 	{ "single", PERMISSION_CONTROL, 1, 1, handle_single },
+	{ "songformat", PERMISSION_NONE, 1, 1, handle_song_format },
 	{ "stats", PERMISSION_READ, 0, 0, handle_stats },
 	{ "status", PERMISSION_READ, 0, 0, handle_status },
 #ifdef ENABLE_SQLITE
@@ -189,6 +215,7 @@ static constexpr struct command commands[] = {
 	{ "swapid", PERMISSION_CONTROL, 2, 2, handle_swapid },
 	{ "tagtypes", PERMISSION_READ, 0, 0, handle_tagtypes },
 	{ "toggleoutput", PERMISSION_ADMIN, 1, 1, handle_toggleoutput },
+	{ "tracedump", PERMISSION_ADMIN, 0, 0, handle_tracedump },
 #ifdef ENABLE_DATABASE
 	{ "unmount", PERMISSION_ADMIN, 1, 1, handle_unmount },
 #endif
@@ -200,6 +227,41 @@ static constexpr struct command commands[] = {
 
 static constexpr unsigned num_commands = ARRAY_SIZE(commands);
 
+static constexpr Domain command_domain("command");
+
+/**
+ * Statistics for one command, indexed like #commands.  They are only
+ * accessed from the main thread.
+ */
+struct CommandStats {
+	/**
+	 * The duration of each invocation in microseconds.  For
+	 * responses generated in the background (see
+	 * Client::RunProducer()), only the first part is measured.
+	 */
+	LatencyHistogram duration;
+
+	uint64_t errors = 0;
+
+	/**
+	 * The total size of all responses.
+	 */
+	uint64_t bytes = 0;
+
+	/**
+	 * The total time the #db_mutex was held by this command.
+	 */
+	uint64_t db_lock_us = 0;
+};
+
+static CommandStats command_stats[num_commands];
+
+/**
+ * Commands which run longer than this number of milliseconds are
+ * logged.  0 disables the log.
+ */
+static unsigned slow_command_threshold_ms;
+
 static bool
 command_available(gcc_unused const Partition &partition,
 		  gcc_unused const struct command *cmd)
@@ -269,6 +331,71 @@ handle_not_commands(Client &client, gcc_unused Request request, Response &r)
 	return PrintUnavailableCommands(r, client.GetPermission());
 }
 
+static CommandResult
+handle_commandstats(gcc_unused Client &client, gcc_unused Request request,
+		    Response &r)
+{
+	for (unsigned i = 0; i < num_commands; ++i) {
+		const CommandStats &s = command_stats[i];
+		if (s.duration.GetCount() == 0)
+			continue;
+
+		r.Format("command: %s\n", commands[i].cmd);
+		perf_stats_print_histogram(r, "duration", "_us", s.duration);
+		r.Format("errors: %llu\n"
+			 "bytes: %llu\n"
+			 "db_lock_us: %llu\n",
+			 (unsigned long long)s.errors,
+			 (unsigned long long)s.bytes,
+			 (unsigned long long)s.db_lock_us);
+	}
+
+	return CommandResult::OK;
+}
+
+/**
+ * How long has the current thread held the #db_mutex so far?
+ */
+static uint64_t
+GetDatabaseLockTime()
+{
+#ifdef ENABLE_DATABASE
+	return db_mutex_held_us;
+#else
+	return 0;
+#endif
+}
+
+/**
+ * Account one invocation of the given command in #command_stats, and
+ * log it if it was slow.
+ */
+static void
+command_record(const Client &client, const struct command &cmd,
+	       const Response &r, CommandResult result,
+	       uint64_t duration_us, uint64_t db_lock_us)
+{
+	CommandStats &s = command_stats[&cmd - commands];
+	s.duration.Add(duration_us);
+	if (gcc_unlikely(trace_enabled))
+		trace_record(cmd.cmd, MonotonicClockUS() - duration_us,
+			     duration_us);
+	if (result == CommandResult::ERROR)
+		++s.errors;
+	s.bytes += r.GetWritten();
+	s.db_lock_us += db_lock_us;
+
+	if (slow_command_threshold_ms > 0 &&
+	    duration_us >= uint64_t(slow_command_threshold_ms) * 1000)
+		FormatWarning(command_domain,
+			      "[%u] slow command \"%s\": %llu ms "
+			      "(database lock %llu ms, %zu bytes)",
+			      client.num, cmd.cmd,
+			      (unsigned long long)(duration_us / 1000),
+			      (unsigned long long)(db_lock_us / 1000),
+			      r.GetWritten());
+}
+
 void
 command_init()
 {
@@ -277,6 +404,9 @@ command_init()
 	for (unsigned i = 0; i < num_commands - 1; ++i)
 		assert(strcmp(commands[i].cmd, commands[i + 1].cmd) < 0);
 #endif
+
+	slow_command_threshold_ms =
+		config_get_unsigned(ConfigOption::SLOW_COMMAND_THRESHOLD, 0);
 }
 
 void
@@ -361,6 +491,10 @@ command_checked_lookup(Response &r, unsigned permission,
 CommandResult
 command_process(Client &client, unsigned num, char *line)
 try {
+	/* temporary allocations made by the handler are released
+	   when this function returns */
+	const ScratchArenaScope scratch_scope;
+
 	Response r(client, num);
 	Error error;
 
@@ -410,10 +544,25 @@ try {
 		command_checked_lookup(r, client.GetPermission(),
 				       cmd_name, args);
 
-	CommandResult ret = cmd
-		? cmd->handler(client, args, r)
-		: CommandResult::ERROR;
+	if (cmd == nullptr)
+		return CommandResult::ERROR;
+
+	const uint64_t start = MonotonicClockUS();
+	const uint64_t db_lock_start = GetDatabaseLockTime();
+
+	CommandResult ret;
+	try {
+		ret = cmd->handler(client, args, r);
+	} catch (...) {
+		command_record(client, *cmd, r, CommandResult::ERROR,
+			       MonotonicClockUS() - start,
+			       GetDatabaseLockTime() - db_lock_start);
+		throw;
+	}
 
+	command_record(client, *cmd, r, ret,
+		       MonotonicClockUS() - start,
+		       GetDatabaseLockTime() - db_lock_start);
 	return ret;
 } catch (const std::exception &e) {
 	Response r(client, num);
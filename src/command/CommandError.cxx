@@ -77,6 +77,9 @@ ToAck(DatabaseErrorCode code)
 
 	case DatabaseErrorCode::CONFLICT:
 		return ACK_ERROR_ARG;
+
+	case DatabaseErrorCode::LOADING:
+		return ACK_ERROR_UPDATE_ALREADY;
 	}
 
 	return ACK_ERROR_UNKNOWN;
@@ -27,6 +27,7 @@ void
 CommandListBuilder::Reset()
 {
 	list.clear();
+	arena.Reset();
 	mode = Mode::DISABLED;
 }
 
@@ -38,6 +39,8 @@ CommandListBuilder::Add(const char *cmd)
 	if (size > client_max_command_list_size)
 		return false;
 
-	list.emplace_back(cmd);
+	char *p = (char *)arena.Allocate(len, 1);
+	memcpy(p, cmd, len);
+	list.push_back(p);
 	return true;
 }
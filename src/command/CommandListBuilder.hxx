@@ -20,8 +20,10 @@
 #ifndef MPD_COMMAND_LIST_BUILDER_HXX
 #define MPD_COMMAND_LIST_BUILDER_HXX
 
-#include <list>
-#include <string>
+#include "util/Arena.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <vector>
 
 #include <assert.h>
 
@@ -47,9 +49,17 @@ class CommandListBuilder {
 	} mode;
 
 	/**
-	 * for when in list mode
+	 * The copies of the command lines in #list are allocated
+	 * here, so collecting a long list does not need one heap
+	 * allocation per command.
+	 */
+	Arena arena;
+
+	/**
+	 * for when in list mode; the (mutable) lines are parsed in
+	 * place by command_process()
 	 */
-	std::list<std::string> list;
+	std::vector<char *> list;
 
 	/**
 	 * Memory consumed by the list.
@@ -98,12 +108,13 @@ public:
 	bool Add(const char *cmd);
 
 	/**
-	 * Finishes the list and returns it.
+	 * Finishes the list and returns it.  The returned buffer
+	 * remains valid until Reset() is called.
 	 */
-	std::list<std::string> &&Commit() {
+	ConstBuffer<char *> Commit() {
 		assert(IsActive());
 
-		return std::move(list);
+		return {list.data(), list.size()};
 	}
 };
 
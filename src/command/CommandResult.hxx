@@ -41,6 +41,14 @@ enum class CommandResult {
 	 */
 	IDLE,
 
+	/**
+	 * The response is incomplete; the rest will be generated by
+	 * the client's #ResponseProducer as soon as the output buffer
+	 * has been sent, followed by "OK" or "ACK".  Until then, no
+	 * more commands are processed.
+	 */
+	BACKGROUND,
+
 	/**
 	 * There was an error.  The "ACK" response was sent to the
 	 * client.
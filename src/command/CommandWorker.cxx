@@ -0,0 +1,296 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "CommandWorker.hxx"
+#include "ScratchArena.hxx"
+#include "client/Client.hxx"
+#include "client/ResponseProducer.hxx"
+#include "event/DeferredMonitor.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "ThreadSettings.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <exception>
+#include <list>
+
+#include <assert.h>
+
+class CommandJobProducer;
+
+/**
+ * A pool of threads which run #CommandJob instances.
+ */
+class CommandWorkerPool {
+	Mutex mutex;
+
+	/**
+	 * Wakes up the worker threads when a job is pushed or when
+	 * they shall quit.
+	 */
+	Cond work_cond;
+
+	/**
+	 * Signalled when a job has finished.
+	 */
+	Cond done_cond;
+
+	std::list<CommandJobProducer *> pending;
+
+	bool quit = false;
+
+	const std::unique_ptr<Thread[]> threads;
+	unsigned n_threads = 0;
+
+public:
+	explicit CommandWorkerPool(unsigned _n_threads);
+	~CommandWorkerPool();
+
+	CommandWorkerPool(const CommandWorkerPool &) = delete;
+	CommandWorkerPool &operator=(const CommandWorkerPool &) = delete;
+
+	bool IsEmpty() const {
+		return n_threads == 0;
+	}
+
+	void Push(CommandJobProducer &p);
+
+	gcc_pure
+	bool IsDone(const CommandJobProducer &p);
+
+	/**
+	 * Make sure the job is not (and will not be) run by a worker
+	 * thread; if it is running already, wait for it to finish.
+	 */
+	void Cancel(CommandJobProducer &p);
+
+private:
+	void Work();
+	static void WorkThread(void *ctx);
+};
+
+static CommandWorkerPool *command_worker_pool;
+
+/**
+ * Submits a #CommandJob to the #CommandWorkerPool and sends its
+ * response as soon as it has finished.
+ */
+class CommandJobProducer final : public ResponseProducer, DeferredMonitor {
+	friend class CommandWorkerPool;
+
+	Client &client;
+
+	std::unique_ptr<CommandJob> job;
+
+	/**
+	 * An exception thrown by CommandJob::Run(), to be rethrown in
+	 * the main thread.
+	 */
+	std::exception_ptr error;
+
+	/**
+	 * Protected by the #CommandWorkerPool's mutex.
+	 */
+	enum class State {
+		PENDING,
+		RUNNING,
+		DONE,
+	} state = State::PENDING;
+
+public:
+	CommandJobProducer(Client &_client, std::unique_ptr<CommandJob> &&_job)
+		:DeferredMonitor(_client.GetEventLoop()),
+		 client(_client), job(std::move(_job)) {}
+
+	~CommandJobProducer() {
+		command_worker_pool->Cancel(*this);
+	}
+
+	/* virtual methods from class ResponseProducer */
+	CommandResult Produce(Response &r) override {
+		if (!command_worker_pool->IsDone(*this))
+			return CommandResult::BACKGROUND;
+
+		if (error)
+			std::rethrow_exception(error);
+
+		return job->Finish(r);
+	}
+
+private:
+	/**
+	 * Called by a worker thread.
+	 */
+	void Run() {
+		const ScratchArenaScope scratch_scope;
+
+		try {
+			job->Run();
+		} catch (...) {
+			error = std::current_exception();
+		}
+	}
+
+	/* virtual methods from class DeferredMonitor; this runs in
+	   the client's thread */
+	void RunDeferred() override {
+		/* this may destroy this object */
+		client.WakeProducer();
+	}
+};
+
+CommandWorkerPool::CommandWorkerPool(unsigned _n_threads)
+	:threads(new Thread[_n_threads])
+{
+	for (unsigned i = 0; i < _n_threads; ++i) {
+		Error error;
+		if (!threads[i].Start(WorkThread, this, error)) {
+			LogError(error);
+			break;
+		}
+
+		++n_threads;
+	}
+}
+
+CommandWorkerPool::~CommandWorkerPool()
+{
+	mutex.lock();
+	assert(pending.empty());
+	quit = true;
+	work_cond.broadcast();
+	mutex.unlock();
+
+	for (unsigned i = 0; i < n_threads; ++i)
+		threads[i].Join();
+}
+
+void
+CommandWorkerPool::Push(CommandJobProducer &p)
+{
+	assert(!IsEmpty());
+
+	const ScopeLock protect(mutex);
+	pending.push_back(&p);
+	work_cond.signal();
+}
+
+bool
+CommandWorkerPool::IsDone(const CommandJobProducer &p)
+{
+	const ScopeLock protect(mutex);
+	return p.state == CommandJobProducer::State::DONE;
+}
+
+void
+CommandWorkerPool::Cancel(CommandJobProducer &p)
+{
+	const ScopeLock protect(mutex);
+
+	switch (p.state) {
+	case CommandJobProducer::State::PENDING:
+		pending.erase(std::find(pending.begin(), pending.end(), &p));
+		p.state = CommandJobProducer::State::DONE;
+		break;
+
+	case CommandJobProducer::State::RUNNING:
+		/* the client has been closed while its job was
+		   running; this blocks the main thread, but no longer
+		   than the job would have without a worker thread */
+		while (p.state != CommandJobProducer::State::DONE)
+			done_cond.wait(mutex);
+		break;
+
+	case CommandJobProducer::State::DONE:
+		break;
+	}
+}
+
+inline void
+CommandWorkerPool::Work()
+{
+	const ScopeLock protect(mutex);
+
+	while (!quit) {
+		if (pending.empty()) {
+			work_cond.wait(mutex);
+			continue;
+		}
+
+		CommandJobProducer &p = *pending.front();
+		pending.pop_front();
+		p.state = CommandJobProducer::State::RUNNING;
+
+		mutex.unlock();
+		p.Run();
+		mutex.lock();
+
+		/* schedule the main thread before marking the job
+		   done; after that, Cancel() may destroy the
+		   producer */
+		p.DeferredMonitor::Schedule();
+		p.state = CommandJobProducer::State::DONE;
+		done_cond.broadcast();
+	}
+}
+
+void
+CommandWorkerPool::WorkThread(void *ctx)
+{
+	SetThreadName("command");
+	ApplyThreadSettings("command");
+
+	CommandWorkerPool &pool = *(CommandWorkerPool *)ctx;
+	pool.Work();
+}
+
+void
+command_worker_init(unsigned n_threads)
+{
+	assert(command_worker_pool == nullptr);
+
+	command_worker_pool = new CommandWorkerPool(n_threads);
+}
+
+void
+command_worker_finish()
+{
+	delete command_worker_pool;
+	command_worker_pool = nullptr;
+}
+
+CommandResult
+RunCommandJob(Client &client, Response &r, std::unique_ptr<CommandJob> &&job)
+{
+	if (command_worker_pool == nullptr || command_worker_pool->IsEmpty() ||
+	    client.cmd_list.IsActive()) {
+		job->Run();
+		return job->Finish(r);
+	}
+
+	CommandJobProducer *p = new CommandJobProducer(client, std::move(job));
+	std::unique_ptr<ResponseProducer> producer(p);
+	command_worker_pool->Push(*p);
+	return client.RunProducer(r, std::move(producer));
+}
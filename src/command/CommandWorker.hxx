@@ -0,0 +1,85 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_COMMAND_WORKER_HXX
+#define MPD_COMMAND_WORKER_HXX
+
+#include "check.h"
+#include "CommandResult.hxx"
+
+#include <memory>
+
+class Client;
+class Response;
+
+/**
+ * The expensive part of a command, which may be run by a worker
+ * thread, so it does not block the main thread (and all other
+ * clients).  See RunCommandJob().
+ */
+class CommandJob {
+public:
+	virtual ~CommandJob() {}
+
+	/**
+	 * Do the work.  This may be called in any thread; it must
+	 * not write to the client, and it must lock the #db_mutex
+	 * (or use a #Database method which does) before accessing
+	 * the database.  Exceptions are passed to the main thread and
+	 * reported to the client.
+	 */
+	virtual void Run() = 0;
+
+	/**
+	 * Send the response.  This is called in the main thread after
+	 * Run() has returned.
+	 */
+	virtual CommandResult Finish(Response &r) = 0;
+};
+
+/**
+ * Start the worker threads.
+ *
+ * @param n_threads the number of threads; 0 means all jobs are run
+ * in the main thread
+ */
+void
+command_worker_init(unsigned n_threads);
+
+/**
+ * Stop all worker threads.  All clients must have been closed
+ * before.
+ */
+void
+command_worker_finish();
+
+/**
+ * Run the job in a worker thread, and send the response when it has
+ * finished.  Meanwhile, the client's input is not processed (see
+ * Client::RunProducer()), which preserves the order of responses.
+ *
+ * Inside a command list, and if there are no worker threads, the job
+ * is run right away in the current thread.
+ *
+ * @return the #CommandResult to be returned by the command handler
+ */
+CommandResult
+RunCommandJob(Client &client, Response &r, std::unique_ptr<CommandJob> &&job);
+
+#endif
@@ -25,9 +25,18 @@
 #include "db/DatabasePrint.hxx"
 #include "db/Count.hxx"
 #include "db/Selection.hxx"
+#include "db/ResponseCache.hxx"
+#include "db/Interface.hxx"
+#include "db/DatabasePlugin.hxx"
 #include "CommandError.hxx"
+#include "CommandWorker.hxx"
+#include "ScratchArena.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "client/ResponseProducer.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
+#include "protocol/Ack.hxx"
 #include "tag/Tag.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/Error.hxx"
@@ -35,6 +44,336 @@
 #include "SongFilter.hxx"
 #include "BulkEdit.hxx"
 
+#include <algorithm>
+#include <memory>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Build a key for the response cache from the parsed arguments of
+ * "list" or "count".  Filter items are sorted, because their order
+ * does not affect the result.
+ */
+static std::string
+MakeResponseCacheKey(const char *command, unsigned tag,
+		     tag_mask_t group_mask, const SongFilter *filter)
+{
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "%s %u %lx",
+		 command, tag, (unsigned long)group_mask);
+	std::string key(buffer);
+
+	if (filter != nullptr) {
+		Arena &arena = GetScratchArena();
+		const ArenaAllocator<const char *> allocator(arena);
+		std::vector<const char *, ArenaAllocator<const char *>>
+			items(allocator);
+		items.reserve(filter->GetItems().size());
+
+		for (const auto &item : filter->GetItems()) {
+			const char *value = "";
+			if (item.GetTag() == LOCATE_TAG_MODIFIED_SINCE) {
+				snprintf(buffer, sizeof(buffer), "%u %lu",
+					 item.GetTag(),
+					 (unsigned long)item.GetTime());
+			} else {
+				snprintf(buffer, sizeof(buffer), "%u %d ",
+					 item.GetTag(), item.GetFoldCase());
+				value = item.GetValue();
+			}
+
+			const size_t prefix_length = strlen(buffer);
+			const size_t value_length = strlen(value);
+			char *p = (char *)arena.Allocate(prefix_length +
+							 value_length + 1, 1);
+			memcpy(p, buffer, prefix_length);
+			memcpy(p + prefix_length, value, value_length + 1);
+			items.push_back(p);
+		}
+
+		std::sort(items.begin(), items.end(),
+			  [](const char *a, const char *b){
+				  return strcmp(a, b) < 0;
+			  });
+
+		for (const char *i : items) {
+			/* use a null byte as separator, because it
+			   cannot occur in a protocol argument */
+			key.push_back(0);
+			key.append(i);
+		}
+	}
+
+	return key;
+}
+
+/**
+ * Invokes a function which prints to a #Response, possibly in a
+ * worker thread (see RunCommandJob()), and sends the captured output
+ * when it has finished.  If a cache key is given, the output is also
+ * stored in the response cache, unless the database has been
+ * modified meanwhile.
+ *
+ * The function is called with the #Response, the #SongFilter (which
+ * is owned by this object) and an #Error reference.
+ */
+template<typename F>
+class CaptureJob final : public CommandJob {
+	Client &client;
+
+	const Database &db;
+
+	std::string cache_key;
+
+	/**
+	 * The Instance::database_version when the job was created.
+	 */
+	const unsigned database_version;
+
+	const std::unique_ptr<SongFilter> filter;
+
+	F f;
+
+	std::string output;
+
+	Error error;
+
+	bool success;
+
+public:
+	CaptureJob(Client &_client, const Database &_db,
+		   std::string &&_cache_key,
+		   std::unique_ptr<SongFilter> &&_filter, F &&_f)
+		:client(_client), db(_db), cache_key(std::move(_cache_key)),
+		 database_version(client.partition.instance.database_version),
+		 filter(std::move(_filter)), f(std::move(_f)) {}
+
+	/* virtual methods from class CommandJob */
+	void Run() override {
+		Response r(client, 0);
+		r.StartCapture(output, true);
+		success = f(r, filter.get(), error);
+	}
+
+	CommandResult Finish(Response &r) override {
+		if (!success)
+			return print_error(r, error);
+
+		r.Write(output.data(), output.length());
+
+		if (!cache_key.empty() &&
+		    client.partition.instance.database_version == database_version)
+			db_response_cache_put(db, std::move(cache_key),
+					      std::move(output));
+
+		return CommandResult::OK;
+	}
+};
+
+/**
+ * Run a #CaptureJob, in a worker thread if the database plugin
+ * allows it.
+ */
+template<typename F>
+static CommandResult
+RunCaptureJob(Client &client, Response &r, const Database &db,
+	      std::string &&cache_key, std::unique_ptr<SongFilter> &&filter,
+	      F &&f)
+{
+	std::unique_ptr<CommandJob>
+		job(new CaptureJob<F>(client, db, std::move(cache_key),
+				      std::move(filter), std::move(f)));
+
+	if (!db.GetPlugin().IsThreadSafe()) {
+		job->Run();
+		return job->Finish(r);
+	}
+
+	return RunCommandJob(client, r, std::move(job));
+}
+
+/**
+ * Send a response from the cache if possible; if not, invoke the
+ * given function (see #CaptureJob) and cache its output on success.
+ */
+template<typename F>
+static CommandResult
+CachedResponse(Client &client, Response &r, std::string &&key,
+	       std::unique_ptr<SongFilter> &&filter, F &&f)
+{
+	Error error;
+	const Database *db = client.GetDatabase(error);
+	if (db == nullptr)
+		return print_error(r, error);
+
+	const std::string *cached = db_response_cache_get(*db, key);
+	if (cached != nullptr) {
+		r.Write(cached->data(), cached->length());
+		return CommandResult::OK;
+	}
+
+	return RunCaptureJob(client, r, *db, std::move(key),
+			     std::move(filter), std::move(f));
+}
+
+/**
+ * The optional "limit" and "cursor" arguments of the database
+ * listing commands.  A cursor is the database version, a colon and
+ * the URI of the last object of the previous page (see
+ * DatabaseSelection::after); clients shall treat it as an opaque
+ * string.
+ */
+struct PageArgs {
+	/**
+	 * The maximum number of objects in this page.
+	 */
+	unsigned limit = std::numeric_limits<unsigned>::max();
+
+	/**
+	 * The "cursor" argument, or nullptr.
+	 */
+	const char *cursor = nullptr;
+
+	bool IsDefined() const {
+		return limit != std::numeric_limits<unsigned>::max() ||
+			cursor != nullptr;
+	}
+
+	/**
+	 * Remove "limit" and "cursor" argument pairs from the end of
+	 * the argument list.
+	 */
+	void Parse(Request &args) {
+		while (args.size >= 2) {
+			const char *name = args[args.size - 2];
+			if (StringIsEqual(name, "limit")) {
+				limit = args.ParseUnsigned(args.size - 1);
+				if (limit == 0)
+					throw ProtocolError(ACK_ERROR_ARG,
+							    "Zero limit");
+			} else if (StringIsEqual(name, "cursor"))
+				cursor = args[args.size - 1];
+			else
+				break;
+
+			args.pop_back();
+			args.pop_back();
+		}
+	}
+};
+
+/**
+ * Generates the response of "listall", "listallinfo", "find" and
+ * "search" in parts; see Client::RunProducer().
+ */
+class DatabasePrintProducer final : public ResponseProducer {
+	Partition &partition;
+
+	const std::unique_ptr<SongFilter> filter;
+
+	DatabaseSelection selection;
+
+	/**
+	 * The number of objects which may still be printed in this
+	 * page.
+	 */
+	unsigned limit;
+
+	const bool full;
+
+public:
+	DatabasePrintProducer(Partition &_partition, const char *uri,
+			      std::unique_ptr<SongFilter> &&_filter,
+			      unsigned _limit, bool _full)
+		:partition(_partition), filter(std::move(_filter)),
+		 selection(uri, true, filter.get()),
+		 limit(_limit), full(_full) {}
+
+	/**
+	 * Resume after the given cursor.
+	 */
+	void SetCursor(const char *cursor) {
+		char *endptr;
+		const unsigned long version = strtoul(cursor, &endptr, 10);
+		if (endptr == cursor || *endptr != ':')
+			throw ProtocolError(ACK_ERROR_ARG, "Malformed cursor");
+
+		if (version != partition.instance.database_version)
+			throw ProtocolError(ACK_ERROR_NO_EXIST,
+					    "Cursor has expired");
+
+		selection.after = endptr + 1;
+	}
+
+	/* virtual methods from class ResponseProducer */
+	CommandResult Produce(Response &r) override {
+		Error error;
+		bool complete;
+		if (!db_selection_print_part(r, partition, selection,
+					     full, false, limit,
+					     complete, error))
+			return print_error(r, error);
+
+		if (complete)
+			return CommandResult::OK;
+
+		if (limit > 0)
+			return CommandResult::BACKGROUND;
+
+		/* end of this page */
+		r.Format("cursor: %u:%s\n",
+			 partition.instance.database_version,
+			 selection.after.c_str());
+		return CommandResult::OK;
+	}
+};
+
+/**
+ * Print all songs (and directories and playlists if there is no
+ * filter) below the given URI.  If the database supports it, the
+ * response is generated in parts, to avoid filling the output
+ * buffer.
+ */
+static CommandResult
+PrintSelection(Client &client, Response &r, const char *uri,
+	       std::unique_ptr<SongFilter> &&filter, bool full,
+	       const PageArgs &page)
+{
+	Error error;
+	const Database *db = client.GetDatabase(error);
+	if (db == nullptr)
+		return print_error(r, error);
+
+	if (!db->GetPlugin().CanResumeVisit()) {
+		if (page.IsDefined()) {
+			r.Error(ACK_ERROR_ARG,
+				"Database plugin does not support cursors");
+			return CommandResult::ERROR;
+		}
+
+		return db_selection_print(r, client.partition,
+					  DatabaseSelection(uri, true,
+							    filter.get()),
+					  full, false, error)
+			? CommandResult::OK
+			: print_error(r, error);
+	}
+
+	std::unique_ptr<DatabasePrintProducer>
+		producer(new DatabasePrintProducer(client.partition, uri,
+						   std::move(filter),
+						   page.limit, full));
+	if (page.cursor != nullptr)
+		producer->SetCursor(page.cursor);
+
+	return client.RunProducer(r, std::move(producer));
+}
+
 CommandResult
 handle_listfiles_db(Client &client, Response &r, const char *uri)
 {
@@ -73,20 +412,43 @@ handle_match(Client &client, Request args, Response &r, bool fold_case)
 	} else
 		window.SetAll();
 
-	SongFilter filter;
-	if (!filter.Parse(args, fold_case)) {
+	PageArgs page;
+	page.Parse(args);
+
+	std::unique_ptr<SongFilter> filter(new SongFilter());
+	if (!filter->Parse(args, fold_case)) {
 		r.Error(ACK_ERROR_ARG, "incorrect arguments");
 		return CommandResult::ERROR;
 	}
 
-	const DatabaseSelection selection("", true, &filter);
+	if (window.IsAll())
+		return PrintSelection(client, r, "", std::move(filter), true,
+				      page);
+
+	if (page.IsDefined()) {
+		r.Error(ACK_ERROR_ARG, "Cannot combine window and cursor");
+		return CommandResult::ERROR;
+	}
 
 	Error error;
-	return db_selection_print(r, client.partition,
-				  selection, true, false,
-				  window.start, window.end, error)
-		? CommandResult::OK
-		: print_error(r, error);
+	const Database *db = client.GetDatabase(error);
+	if (db == nullptr)
+		return print_error(r, error);
+
+	Partition &partition = client.partition;
+	return RunCaptureJob(client, r, *db, std::string(), std::move(filter),
+			     [&partition, window](Response &r2,
+						  const SongFilter *f,
+						  Error &error2){
+				     const DatabaseSelection selection("", true,
+								       f);
+				     return db_selection_print(r2, partition,
+							       selection,
+							       true, false,
+							       window.start,
+							       window.end,
+							       error2);
+			     });
 }
 
 CommandResult
@@ -170,30 +532,39 @@ handle_count(Client &client, Request args, Response &r)
 		args.pop_back();
 	}
 
-	SongFilter filter;
-	if (!args.IsEmpty() && !filter.Parse(args, false)) {
+	std::unique_ptr<SongFilter> filter(new SongFilter());
+	if (!args.IsEmpty() && !filter->Parse(args, false)) {
 		r.Error(ACK_ERROR_ARG, "incorrect arguments");
 		return CommandResult::ERROR;
 	}
 
-	Error error;
-	return PrintSongCount(r, client.partition, "", &filter, group, error)
-		? CommandResult::OK
-		: print_error(r, error);
+	std::string key = MakeResponseCacheKey("count", group, 0, filter.get());
+	const Partition &partition = client.partition;
+	return CachedResponse(client, r, std::move(key), std::move(filter),
+			      [&partition, group](Response &r2,
+						  const SongFilter *f,
+						  Error &error){
+				      return PrintSongCount(r2, partition,
+							    "", f, group,
+							    error);
+			      });
 }
 
 CommandResult
 handle_listall(Client &client, Request args, Response &r)
 {
+	PageArgs page;
+	page.Parse(args);
+
+	if (args.size > 1) {
+		r.Error(ACK_ERROR_ARG, "Too many arguments");
+		return CommandResult::ERROR;
+	}
+
 	/* default is root directory */
 	const auto uri = args.GetOptional(0, "");
 
-	Error error;
-	return db_selection_print(r, client.partition,
-				  DatabaseSelection(uri, true),
-				  false, false, error)
-		? CommandResult::OK
-		: print_error(r, error);
+	return PrintSelection(client, r, uri, nullptr, false, page);
 }
 
 CommandResult
@@ -209,7 +580,7 @@ handle_list(Client &client, Request args, Response &r)
 		return CommandResult::ERROR;
 	}
 
-	SongFilter *filter = nullptr;
+	std::unique_ptr<SongFilter> filter;
 	tag_mask_t group_mask = 0;
 
 	if (args.size == 1) {
@@ -221,7 +592,8 @@ handle_list(Client &client, Request args, Response &r)
 			return CommandResult::ERROR;
 		}
 
-		filter = new SongFilter((unsigned)TAG_ARTIST, args.shift());
+		filter.reset(new SongFilter((unsigned)TAG_ARTIST,
+					    args.shift()));
 	}
 
 	while (args.size >= 2 &&
@@ -241,9 +613,8 @@ handle_list(Client &client, Request args, Response &r)
 	}
 
 	if (!args.IsEmpty()) {
-		filter = new SongFilter();
+		filter.reset(new SongFilter());
 		if (!filter->Parse(args, false)) {
-			delete filter;
 			r.Error(ACK_ERROR_ARG, "not able to parse args");
 			return CommandResult::ERROR;
 		}
@@ -251,33 +622,37 @@ handle_list(Client &client, Request args, Response &r)
 
 	if (tagType < TAG_NUM_OF_ITEM_TYPES &&
 	    group_mask & (tag_mask_t(1) << tagType)) {
-		delete filter;
 		r.Error(ACK_ERROR_ARG, "Conflicting group");
 		return CommandResult::ERROR;
 	}
 
-	Error error;
-	CommandResult ret =
-		PrintUniqueTags(r, client.partition,
-				tagType, group_mask, filter, error)
-		? CommandResult::OK
-		: print_error(r, error);
-
-	delete filter;
-
-	return ret;
+	std::string key = MakeResponseCacheKey("list", tagType, group_mask,
+					       filter.get());
+	Partition &partition = client.partition;
+	return CachedResponse(client, r, std::move(key), std::move(filter),
+			      [&partition, tagType, group_mask](Response &r2,
+								const SongFilter *f,
+								Error &error){
+				      return PrintUniqueTags(r2, partition,
+							     tagType,
+							     group_mask,
+							     f, error);
+			      });
 }
 
 CommandResult
 handle_listallinfo(Client &client, Request args, Response &r)
 {
+	PageArgs page;
+	page.Parse(args);
+
+	if (args.size > 1) {
+		r.Error(ACK_ERROR_ARG, "Too many arguments");
+		return CommandResult::ERROR;
+	}
+
 	/* default is root directory */
 	const auto uri = args.GetOptional(0, "");
 
-	Error error;
-	return db_selection_print(r, client.partition,
-				  DatabaseSelection(uri, true),
-				  true, false, error)
-		? CommandResult::OK
-		: print_error(r, error);
+	return PrintSelection(client, r, uri, nullptr, true, page);
 }
@@ -37,9 +37,15 @@
 #include "fs/AllocatedPath.hxx"
 #include "fs/FileInfo.hxx"
 #include "fs/DirectoryReader.hxx"
+#include "fs/Traits.hxx"
+#include "input/InputStream.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
 #include "LocateUri.hxx"
 #include "TimePrint.hxx"
 
+#include <memory>
+
 #include <assert.h>
 #include <inttypes.h> /* for PRIu64 */
 
@@ -238,3 +244,174 @@ handle_read_comments(Client &client, Request args, Response &r)
 
 	gcc_unreachable();
 }
+
+/**
+ * The file names of cover images which are looked up in the
+ * directory of a song, in this order.
+ */
+static constexpr const char *cover_names[] = {
+	"cover.png",
+	"cover.jpg",
+	"cover.jpeg",
+	"cover.webp",
+	"folder.png",
+	"folder.jpg",
+};
+
+/**
+ * Open the first cover image found in the given directory (an
+ * absolute path or URI).
+ */
+static InputStreamPtr
+open_cover(const char *directory, Mutex &mutex, Cond &cond)
+{
+	for (const char *name : cover_names) {
+		const auto uri = PathTraitsUTF8::Build(directory, name);
+		auto is = InputStream::OpenReady(uri.c_str(), mutex, cond,
+						 IgnoreError());
+		if (is)
+			return is;
+	}
+
+	return nullptr;
+}
+
+#if defined(WIN32) && GCC_CHECK_VERSION(4,6)
+/* PRIu64 causes bogus compiler warning */
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat"
+#pragma GCC diagnostic ignored "-Wformat-extra-args"
+#endif
+
+/**
+ * Send one chunk of the image, at most Client::binary_limit bytes
+ * starting at the given offset.
+ */
+static CommandResult
+send_cover_chunk(Client &client, Response &r, InputStream &is,
+		 offset_type offset)
+{
+	if (!is.KnownSize()) {
+		r.Error(ACK_ERROR_NO_EXIST, "Cover has unknown size");
+		return CommandResult::ERROR;
+	}
+
+	const offset_type size = is.GetSize();
+	if (offset > size) {
+		r.Error(ACK_ERROR_ARG, "Offset too large");
+		return CommandResult::ERROR;
+	}
+
+	Error error;
+	if (offset > 0 && !is.LockSeek(offset, error))
+		return print_error(r, error);
+
+	const size_t limit = std::min<offset_type>(client.binary_limit,
+						   size - offset);
+	std::unique_ptr<char[]> buffer(new char[limit]);
+
+	size_t length = 0;
+	while (length < limit) {
+		size_t nbytes = is.LockRead(buffer.get() + length,
+					    limit - length, error);
+		if (nbytes == 0) {
+			if (error.IsDefined())
+				return print_error(r, error);
+			break;
+		}
+
+		length += nbytes;
+	}
+
+	r.Format("size: %" PRIu64 "\n"
+		 "binary: %u\n",
+		 uint64_t(size), unsigned(length));
+	r.Write(buffer.get(), length);
+	r.Write("\n");
+	return CommandResult::OK;
+}
+
+#if defined(WIN32) && GCC_CHECK_VERSION(4,6)
+#pragma GCC diagnostic pop
+#endif
+
+static CommandResult
+send_cover(Client &client, Response &r, const char *directory,
+	   offset_type offset)
+{
+	Mutex mutex;
+	Cond cond;
+
+	auto is = open_cover(directory, mutex, cond);
+	if (!is) {
+		r.Error(ACK_ERROR_NO_EXIST, "No file exists");
+		return CommandResult::ERROR;
+	}
+
+	return send_cover_chunk(client, r, *is, offset);
+}
+
+static CommandResult
+send_db_cover(Client &client, Response &r, const char *directory,
+	      offset_type offset)
+{
+#ifdef ENABLE_DATABASE
+	const Storage *storage = client.GetStorage();
+	if (storage == nullptr) {
+#else
+		(void)client;
+		(void)directory;
+		(void)offset;
+#endif
+		r.Error(ACK_ERROR_NO_EXIST, "No database");
+		return CommandResult::ERROR;
+#ifdef ENABLE_DATABASE
+	}
+
+	const std::string directory2 = storage->MapUTF8(directory);
+	return send_cover(client, r, directory2.c_str(), offset);
+#endif
+}
+
+CommandResult
+handle_album_art(Client &client, Request args, Response &r)
+{
+	assert(args.size == 2);
+
+	const char *const uri = args.front();
+	const offset_type offset = args.ParseUnsigned(1);
+
+	Error error;
+	const auto located_uri = LocateUri(uri, &client,
+#ifdef ENABLE_DATABASE
+					   nullptr,
+#endif
+					   error);
+	if (located_uri.type == LocatedUri::Type::UNKNOWN)
+		return print_error(r, error);
+
+	std::string directory =
+		PathTraitsUTF8::GetParent(located_uri.canonical_uri);
+
+	switch (located_uri.type) {
+	case LocatedUri::Type::UNKNOWN:
+		break;
+
+	case LocatedUri::Type::RELATIVE:
+		if (!uri_safe_local(located_uri.canonical_uri)) {
+			r.Error(ACK_ERROR_ARG, "Malformed URI");
+			return CommandResult::ERROR;
+		}
+
+		if (directory == ".")
+			directory.clear();
+
+		return send_db_cover(client, r, directory.c_str(), offset);
+
+	case LocatedUri::Type::ABSOLUTE:
+	case LocatedUri::Type::PATH:
+		return send_cover(client, r, directory.c_str(), offset);
+	}
+
+	gcc_unreachable();
+}
@@ -33,4 +33,11 @@ handle_listfiles_local(Response &response, Path path_fs);
 CommandResult
 handle_read_comments(Client &client, Request request, Response &response);
 
+/**
+ * Send a chunk of the cover image ("cover.jpg" etc.) which belongs
+ * to the given song.
+ */
+CommandResult
+handle_album_art(Client &client, Request request, Response &response);
+
 #endif
@@ -40,10 +40,19 @@
 #include "util/StringAPI.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "Stats.hxx"
+#include "PerfStats.hxx"
+#include "util/MemStats.hxx"
+#include "system/MemInfo.hxx"
+#include "input/InputMetrics.hxx"
+#include "system/Trace.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "fs/io/FileOutputStream.hxx"
 #include "Permission.hxx"
 #include "PlaylistFile.hxx"
 #include "db/PlaylistVector.hxx"
 #include "client/Client.hxx"
+#include "client/ClientInternal.hxx"
 #include "client/Response.hxx"
 #include "Partition.hxx"
 #include "Instance.hxx"
@@ -321,6 +330,11 @@ handle_update(Client &client, Request args, Response &r, bool discard)
 		}
 	}
 
+	if (client.partition.instance.IsDatabaseLoading()) {
+		r.Error(ACK_ERROR_UPDATE_ALREADY, "Database is being loaded");
+		return CommandResult::ERROR;
+	}
+
 	UpdateService *update = client.partition.instance.update;
 	if (update != nullptr)
 		return handle_update(r, *update, path, discard);
@@ -396,6 +410,130 @@ handle_stats(Client &client, gcc_unused Request args, Response &r)
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_perfstats(Client &client, gcc_unused Request args, Response &r)
+{
+	perf_stats_print(r, client.partition);
+	return CommandResult::OK;
+}
+
+CommandResult
+handle_memstats(gcc_unused Client &client, gcc_unused Request args,
+		Response &r)
+{
+	if (!mem_stats_enabled) {
+		r.Error(ACK_ERROR_UNKNOWN, "memory accounting is disabled");
+		return CommandResult::ERROR;
+	}
+
+	int64_t total = 0;
+
+	for (unsigned i = 0; i < unsigned(MemStatsCategory::MAX); ++i) {
+		const auto category = MemStatsCategory(i);
+		const char *name = mem_stats_name(category);
+		const auto value = mem_stats_get(category);
+		total += value.bytes;
+
+		r.Format("%s_bytes: %lld\n"
+			 "%s_objects: %lld\n"
+			 "%s_peak_bytes: %lld\n",
+			 name, (long long)value.bytes,
+			 name, (long long)value.objects,
+			 name, (long long)value.peak_bytes);
+	}
+
+	r.Format("total_bytes: %lld\n", (long long)total);
+
+	const int64_t available = GetAvailableMemory();
+	if (available >= 0)
+		r.Format("system_available_bytes: %lld\n",
+			 (long long)available);
+
+	const double pressure = GetMemoryPressure();
+	if (pressure >= 0)
+		r.Format("system_pressure: %.2f\n", pressure);
+
+	return CommandResult::OK;
+}
+
+static void
+print_input_metrics(Response &r, const InputMetrics &m)
+{
+	const uint64_t first_byte =
+		m.first_byte_us.load(std::memory_order_relaxed);
+	const uint64_t last_byte =
+		m.last_byte_us.load(std::memory_order_relaxed);
+	const uint64_t bytes = m.bytes.load(std::memory_order_relaxed);
+
+	/* the throughput while data was arriving */
+	const uint64_t rate = last_byte > first_byte
+		? bytes * 1000000 / (last_byte - first_byte)
+		: 0;
+
+	r.Format("stream: %s\n"
+		 "plugin: %s\n"
+		 "source: %s\n"
+		 "state: %s\n",
+		 m.uri.c_str(), m.plugin, m.source.c_str(),
+		 m.closed ? "closed" : "open");
+
+	if (m.have_connect_times.load(std::memory_order_acquire))
+		r.Format("dns_us: %llu\n"
+			 "connect_us: %llu\n"
+			 "tls_us: %llu\n",
+			 (unsigned long long)m.dns_us.load(std::memory_order_relaxed),
+			 (unsigned long long)m.connect_us.load(std::memory_order_relaxed),
+			 (unsigned long long)m.tls_us.load(std::memory_order_relaxed));
+
+	r.Format("ready_us: %llu\n"
+		 "first_byte_us: %llu\n"
+		 "bytes: %llu\n"
+		 "bytes_per_second: %llu\n"
+		 "underruns: %llu\n"
+		 "underrun_us: %llu\n",
+		 (unsigned long long)m.ready_us.load(std::memory_order_relaxed),
+		 (unsigned long long)first_byte,
+		 (unsigned long long)bytes,
+		 (unsigned long long)rate,
+		 (unsigned long long)m.underruns.load(std::memory_order_relaxed),
+		 (unsigned long long)m.underrun_us.load(std::memory_order_relaxed));
+
+	perf_stats_print_histogram(r, "seek", "_us", m.seek);
+}
+
+CommandResult
+handle_inputstats(gcc_unused Client &client, gcc_unused Request args,
+		  Response &r)
+{
+	input_metrics_visit([&r](const InputMetrics &m){
+			print_input_metrics(r, m);
+		});
+	return CommandResult::OK;
+}
+
+CommandResult
+handle_tracedump(gcc_unused Client &client, gcc_unused Request args,
+		 Response &r)
+{
+	if (!trace_enabled) {
+		r.Error(ACK_ERROR_UNKNOWN, "tracing is disabled");
+		return CommandResult::ERROR;
+	}
+
+	Error error;
+	const auto path = config_get_path(ConfigOption::TRACE_FILE, error);
+	if (path.IsNull())
+		return print_error(r, error);
+
+	const std::string json = trace_export();
+
+	FileOutputStream fos(path);
+	fos.Write(json.data(), json.length());
+	fos.Commit();
+
+	return CommandResult::OK;
+}
+
 CommandResult
 handle_ping(gcc_unused Client &client, gcc_unused Request args,
 	    gcc_unused Response &r)
@@ -403,6 +541,79 @@ handle_ping(gcc_unused Client &client, gcc_unused Request args,
 	return CommandResult::OK;
 }
 
+CommandResult
+handle_binary_limit(Client &client, Request args, Response &r)
+{
+	const unsigned value = args.ParseUnsigned(0);
+	if (value < 64) {
+		r.Error(ACK_ERROR_ARG, "Value too small");
+		return CommandResult::ERROR;
+	}
+
+	/* leave room for the other lines of the response */
+	if (value > client_max_output_buffer_size / 2) {
+		r.Error(ACK_ERROR_ARG, "Value too large");
+		return CommandResult::ERROR;
+	}
+
+	client.binary_limit = value;
+	return CommandResult::OK;
+}
+
+CommandResult
+handle_idle_interval(Client &client, Request args, Response &r)
+{
+	const unsigned value = args.ParseUnsigned(0);
+	if (value > 60000) {
+		r.Error(ACK_ERROR_ARG, "Value too large");
+		return CommandResult::ERROR;
+	}
+
+	client.idle_interval = value;
+	return CommandResult::OK;
+}
+
+CommandResult
+handle_song_format(Client &client, Request args, Response &r)
+{
+	const char *format = args.front();
+	if (StringIsEqual(format, "tabular")) {
+		client.tabular_songs = true;
+		song_print_columns(r);
+	} else if (StringIsEqual(format, "keyvalue")) {
+		client.tabular_songs = false;
+	} else {
+		r.FormatError(ACK_ERROR_ARG, "Unsupported song format: %s",
+			      format);
+		return CommandResult::ERROR;
+	}
+
+	return CommandResult::OK;
+}
+
+#ifdef ENABLE_ZLIB
+
+CommandResult
+handle_compress(Client &client, Request args, Response &r)
+{
+	if (!StringIsEqual(args.front(), "gzip")) {
+		r.FormatError(ACK_ERROR_ARG,
+			      "Unsupported compression method: %s",
+			      args.front());
+		return CommandResult::ERROR;
+	}
+
+	if (client.IsCompressed()) {
+		r.Error(ACK_ERROR_ARG, "Already compressed");
+		return CommandResult::ERROR;
+	}
+
+	client.RequestCompression();
+	return CommandResult::OK;
+}
+
+#endif
+
 CommandResult
 handle_password(Client &client, Request args, Response &r)
 {
@@ -62,9 +62,35 @@ handle_volume(Client &client, Request request, Response &response);
 CommandResult
 handle_stats(Client &client, Request request, Response &response);
 
+CommandResult
+handle_perfstats(Client &client, Request request, Response &response);
+
+CommandResult
+handle_memstats(Client &client, Request request, Response &response);
+
+CommandResult
+handle_inputstats(Client &client, Request request, Response &response);
+
+CommandResult
+handle_tracedump(Client &client, Request request, Response &response);
+
 CommandResult
 handle_ping(Client &client, Request request, Response &response);
 
+CommandResult
+handle_binary_limit(Client &client, Request request, Response &response);
+
+CommandResult
+handle_idle_interval(Client &client, Request request, Response &response);
+
+CommandResult
+handle_song_format(Client &client, Request request, Response &response);
+
+#ifdef ENABLE_ZLIB
+CommandResult
+handle_compress(Client &client, Request request, Response &response);
+#endif
+
 CommandResult
 handle_password(Client &client, Request request, Response &response);
 
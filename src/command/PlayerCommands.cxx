@@ -31,11 +31,15 @@
 #include "Idle.hxx"
 #include "AudioFormat.hxx"
 #include "ReplayGainConfig.hxx"
+#include "util/StringBuilder.hxx"
+#include "util/Error.hxx"
 
 #ifdef ENABLE_DATABASE
 #include "db/update/Service.hxx"
 #endif
 
+#include <string>
+
 #define COMMAND_STATUS_STATE            "state"
 #define COMMAND_STATUS_REPEAT           "repeat"
 #define COMMAND_STATUS_SINGLE           "single"
@@ -85,10 +89,47 @@ handle_stop(Client &client, gcc_unused Request args, gcc_unused Response &r)
 	return CommandResult::OK;
 }
 
+/**
+ * The "currentsong" response for the given queue version and
+ * position.  Polling clients receive it with a single
+ * Response::Write() call.
+ */
+static struct {
+	bool valid = false;
+	bool tabular;
+	uint32_t version;
+	int position;
+	std::string text;
+} currentsong_cache;
+
 CommandResult
 handle_currentsong(Client &client, gcc_unused Request args, Response &r)
 {
-	playlist_print_current(r, client.partition, client.playlist);
+	const playlist &playlist = client.playlist;
+
+	if (playlist.IsModificationPending()) {
+		/* the queue version is not reliable right now */
+		playlist_print_current(r, client.partition, playlist);
+		return CommandResult::OK;
+	}
+
+	auto &c = currentsong_cache;
+	const int position = playlist.GetCurrentPosition();
+	if (c.valid && c.tabular == client.tabular_songs &&
+	    c.version == playlist.GetVersion() && c.position == position) {
+		r.Write(c.text.data(), c.text.length());
+		return CommandResult::OK;
+	}
+
+	c.text.clear();
+	r.StartCapture(c.text);
+	playlist_print_current(r, client.partition, playlist);
+	r.StopCapture();
+
+	c.valid = true;
+	c.tabular = client.tabular_songs;
+	c.version = playlist.GetVersion();
+	c.position = position;
 	return CommandResult::OK;
 }
 
@@ -104,15 +145,88 @@ handle_pause(Client &client, Request args, gcc_unused Response &r)
 	return CommandResult::OK;
 }
 
-CommandResult
-handle_status(Client &client, gcc_unused Request args, Response &r)
+/**
+ * The values the "status" response is generated from, except for
+ * the ones which change all the time during playback.  Collecting
+ * them is cheap; formatting them is not.
+ */
+struct StatusKey {
+	int volume;
+	bool repeat, random, single, consume;
+	uint32_t version;
+	unsigned length;
+	float mixramp_db, cross_fade, mixramp_delay;
+	PlayerState state;
+	int song, next_song;
+	unsigned song_id, next_song_id;
+	unsigned update_id;
+
+	StatusKey() = default;
+	StatusKey(Client &client, PlayerState _state);
+
+	gcc_pure
+	bool operator==(const StatusKey &other) const {
+		return volume == other.volume &&
+			repeat == other.repeat && random == other.random &&
+			single == other.single && consume == other.consume &&
+			version == other.version && length == other.length &&
+			mixramp_db == other.mixramp_db &&
+			cross_fade == other.cross_fade &&
+			mixramp_delay == other.mixramp_delay &&
+			state == other.state &&
+			song == other.song && song_id == other.song_id &&
+			next_song == other.next_song &&
+			next_song_id == other.next_song_id &&
+			update_id == other.update_id;
+	}
+};
+
+StatusKey::StatusKey(Client &client, PlayerState _state)
+	:volume(volume_level_get(client.partition.outputs)),
+	 repeat(client.playlist.GetRepeat()),
+	 random(client.playlist.GetRandom()),
+	 single(client.playlist.GetSingle()),
+	 consume(client.playlist.GetConsume()),
+	 version(client.playlist.GetVersion()),
+	 length(client.playlist.GetLength()),
+	 mixramp_db(client.player_control.GetMixRampDb()),
+	 cross_fade(client.player_control.GetCrossFade()),
+	 mixramp_delay(client.player_control.GetMixRampDelay()),
+	 state(_state),
+	 song(client.playlist.GetCurrentPosition()),
+	 next_song(client.playlist.GetNextPosition()),
+	 song_id(song >= 0 ? client.playlist.PositionToId(song) : 0),
+	 next_song_id(next_song >= 0
+		      ? client.playlist.PositionToId(next_song)
+		      : 0)
 {
-	const char *state = nullptr;
-	int song;
-
-	const auto player_status = client.player_control.LockGetStatus();
+#ifdef ENABLE_DATABASE
+	const UpdateService *update_service = client.partition.instance.update;
+	update_id = update_service != nullptr
+		? update_service->GetId()
+		: 0;
+#else
+	update_id = 0;
+#endif
+}
 
-	switch (player_status.state) {
+/**
+ * The parts of the "status" response before and after the playback
+ * time, for the given #StatusKey.  Polling clients receive them with
+ * one Response::Write() call each; only the playback time is
+ * formatted for each call.
+ */
+static struct {
+	bool valid = false;
+	StatusKey key;
+	std::string head, tail;
+} status_cache;
+
+static void
+status_print_head(Response &r, const StatusKey &key)
+{
+	const char *state = nullptr;
+	switch (key.state) {
 	case PlayerState::STOP:
 		state = "stop";
 		break;
@@ -124,7 +238,6 @@ handle_status(Client &client, gcc_unused Request args, Response &r)
 		break;
 	}
 
-	const playlist &playlist = client.playlist;
 	r.Format("volume: %i\n"
 		 COMMAND_STATUS_REPEAT ": %i\n"
 		 COMMAND_STATUS_RANDOM ": %i\n"
@@ -134,77 +247,123 @@ handle_status(Client &client, gcc_unused Request args, Response &r)
 		 COMMAND_STATUS_PLAYLIST_LENGTH ": %i\n"
 		 COMMAND_STATUS_MIXRAMPDB ": %f\n"
 		 COMMAND_STATUS_STATE ": %s\n",
-		 volume_level_get(client.partition.outputs),
-		 playlist.GetRepeat(),
-		 playlist.GetRandom(),
-		 playlist.GetSingle(),
-		 playlist.GetConsume(),
-		 (unsigned long)playlist.GetVersion(),
-		 playlist.GetLength(),
-		 client.player_control.GetMixRampDb(),
+		 key.volume,
+		 key.repeat,
+		 key.random,
+		 key.single,
+		 key.consume,
+		 (unsigned long)key.version,
+		 key.length,
+		 key.mixramp_db,
 		 state);
 
-	if (client.player_control.GetCrossFade() > 0)
+	if (key.cross_fade > 0)
 		r.Format(COMMAND_STATUS_CROSSFADE ": %i\n",
-			 int(client.player_control.GetCrossFade() + 0.5));
+			 int(key.cross_fade + 0.5));
 
-	if (client.player_control.GetMixRampDelay() > 0)
+	if (key.mixramp_delay > 0)
 		r.Format(COMMAND_STATUS_MIXRAMPDELAY ": %f\n",
-			 client.player_control.GetMixRampDelay());
+			 key.mixramp_delay);
 
-	song = playlist.GetCurrentPosition();
-	if (song >= 0) {
+	if (key.song >= 0)
 		r.Format(COMMAND_STATUS_SONG ": %i\n"
 			 COMMAND_STATUS_SONGID ": %u\n",
-			 song, playlist.PositionToId(song));
-	}
+			 key.song, key.song_id);
+}
 
-	if (player_status.state != PlayerState::STOP) {
-		r.Format(COMMAND_STATUS_TIME ": %i:%i\n"
-			 "elapsed: %1.3f\n"
-			 COMMAND_STATUS_BITRATE ": %u\n",
-			 player_status.elapsed_time.RoundS(),
-			 player_status.total_time.IsNegative()
-			 ? 0u
-			 : unsigned(player_status.total_time.RoundS()),
-			 player_status.elapsed_time.ToDoubleS(),
-			 player_status.bit_rate);
-
-		if (!player_status.total_time.IsNegative())
-			r.Format("duration: %1.3f\n",
-				 player_status.total_time.ToDoubleS());
-
-		if (player_status.audio_format.IsDefined()) {
-			struct audio_format_string af_string;
-
-			r.Format(COMMAND_STATUS_AUDIO ": %s\n",
-				 audio_format_to_string(player_status.audio_format,
-							&af_string));
-		}
+static void
+status_print_player(Response &r, const player_status &player_status)
+{
+	if (player_status.state == PlayerState::STOP)
+		return;
+
+	char buffer[256];
+	StringBuilder b(buffer);
+
+	b.Append(COMMAND_STATUS_TIME ": ")
+		.AppendUnsigned(player_status.elapsed_time.RoundS())
+		.Append(':')
+		.AppendUnsigned(player_status.total_time.IsNegative()
+				? 0u
+				: unsigned(player_status.total_time.RoundS()))
+		.Append("\nelapsed: ")
+		.AppendMilli(player_status.elapsed_time.ToMS())
+		.Append("\n" COMMAND_STATUS_BITRATE ": ")
+		.AppendUnsigned(player_status.bit_rate)
+		.Append('\n');
+
+	if (!player_status.total_time.IsNegative())
+		b.Append("duration: ")
+			.AppendMilli(player_status.total_time.ToMS())
+			.Append('\n');
+
+	if (player_status.audio_format.IsDefined()) {
+		struct audio_format_string af_string;
+
+		b.Append(COMMAND_STATUS_AUDIO ": ")
+			.Append(audio_format_to_string(player_status.audio_format,
+						       &af_string))
+			.Append('\n');
 	}
 
-#ifdef ENABLE_DATABASE
-	const UpdateService *update_service = client.partition.instance.update;
-	unsigned updateJobId = update_service != nullptr
-		? update_service->GetId()
-		: 0;
-	if (updateJobId != 0) {
+	r.Write(b);
+}
+
+static void
+status_print_tail(Response &r, const StatusKey &key, const Error &error)
+{
+	if (key.update_id != 0)
 		r.Format(COMMAND_STATUS_UPDATING_DB ": %i\n",
-			 updateJobId);
-	}
-#endif
+			 key.update_id);
 
-	Error error = client.player_control.LockGetError();
 	if (error.IsDefined())
 		r.Format(COMMAND_STATUS_ERROR ": %s\n",
 			 error.GetMessage());
 
-	song = playlist.GetNextPosition();
-	if (song >= 0)
+	if (key.next_song >= 0)
 		r.Format(COMMAND_STATUS_NEXTSONG ": %i\n"
 			 COMMAND_STATUS_NEXTSONGID ": %u\n",
-			 song, playlist.PositionToId(song));
+			 key.next_song, key.next_song_id);
+}
+
+CommandResult
+handle_status(Client &client, gcc_unused Request args, Response &r)
+{
+	const auto player_status = client.player_control.LockGetStatus();
+	const Error error = client.player_control.LockGetError();
+	const StatusKey key(client, player_status.state);
+
+	if (error.IsDefined()) {
+		/* the error message is not part of the key; don't
+		   bother caching this rare case */
+		status_print_head(r, key);
+		status_print_player(r, player_status);
+		status_print_tail(r, key, error);
+		return CommandResult::OK;
+	}
+
+	auto &c = status_cache;
+	if (c.valid && c.key == key) {
+		r.Write(c.head.data(), c.head.length());
+		status_print_player(r, player_status);
+		r.Write(c.tail.data(), c.tail.length());
+		return CommandResult::OK;
+	}
+
+	c.head.clear();
+	r.StartCapture(c.head);
+	status_print_head(r, key);
+	r.StopCapture();
+
+	status_print_player(r, player_status);
+
+	c.tail.clear();
+	r.StartCapture(c.tail);
+	status_print_tail(r, key, error);
+	r.StopCapture();
 
+	c.valid = true;
+	c.key = key;
 	return CommandResult::OK;
 }
 
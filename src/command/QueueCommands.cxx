@@ -29,8 +29,11 @@
 #include "LocateUri.hxx"
 #include "queue/Playlist.hxx"
 #include "PlaylistPrint.hxx"
+#include "PlaylistError.hxx"
+#include "queue/QueuePrint.hxx"
 #include "client/Client.hxx"
 #include "client/Response.hxx"
+#include "client/ResponseProducer.hxx"
 #include "Partition.hxx"
 #include "BulkEdit.hxx"
 #include "util/ConstBuffer.hxx"
@@ -40,6 +43,7 @@
 
 #include <memory>
 #include <limits>
+#include <algorithm>
 
 static void
 AddUri(Client &client, const LocatedUri &uri)
@@ -240,14 +244,63 @@ handle_plchangesposid(Client &client, Request args, Response &r)
 	return CommandResult::OK;
 }
 
+/**
+ * Generates the response of "playlistinfo" in parts; see
+ * Client::RunProducer().  If the queue is modified meanwhile, the
+ * rest of the response reflects the new queue.
+ */
+class QueuePrintProducer final : public ResponseProducer {
+	Partition &partition;
+	const struct playlist &playlist;
+
+	unsigned position;
+	const unsigned end;
+
+public:
+	QueuePrintProducer(Partition &_partition,
+			   const struct playlist &_playlist,
+			   unsigned _start, unsigned _end)
+		:partition(_partition), playlist(_playlist),
+		 position(_start), end(_end) {}
+
+	/* virtual methods from class ResponseProducer */
+	CommandResult Produce(Response &r) override {
+		const Client &client = r.GetClient();
+		const Queue &queue = playlist.queue;
+		const unsigned end2 = std::min(end, queue.GetLength());
+
+		while (position < end2) {
+			queue_print_info(r, partition, queue,
+					 position, position + 1);
+			++position;
+
+			if (client.IsOutputFull())
+				return CommandResult::BACKGROUND;
+		}
+
+		return CommandResult::OK;
+	}
+};
+
 CommandResult
 handle_playlistinfo(Client &client, Request args, Response &r)
 {
 	RangeArg range = args.ParseOptional(0, RangeArg::All());
 
-	playlist_print_info(r, client.partition, client.playlist,
-			    range.start, range.end);
-	return CommandResult::OK;
+	const Queue &queue = client.playlist.queue;
+	if (range.end > queue.GetLength())
+		/* correct the "end" offset */
+		range.end = queue.GetLength();
+
+	if (range.start > range.end)
+		/* an invalid "start" offset is fatal */
+		throw PlaylistError::BadRange();
+
+	std::unique_ptr<ResponseProducer>
+		producer(new QueuePrintProducer(client.partition,
+						client.playlist,
+						range.start, range.end));
+	return client.RunProducer(r, std::move(producer));
 }
 
 CommandResult
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "ScratchArena.hxx"
+
+#include <assert.h>
+
+static thread_local Arena scratch_arena;
+static thread_local unsigned scratch_arena_depth;
+
+Arena &
+GetScratchArena()
+{
+	assert(scratch_arena_depth > 0);
+
+	return scratch_arena;
+}
+
+ScratchArenaScope::ScratchArenaScope()
+{
+	++scratch_arena_depth;
+}
+
+ScratchArenaScope::~ScratchArenaScope()
+{
+	assert(scratch_arena_depth > 0);
+
+	if (--scratch_arena_depth == 0)
+		scratch_arena.Reset();
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_SCRATCH_ARENA_HXX
+#define MPD_SCRATCH_ARENA_HXX
+
+#include "util/Arena.hxx"
+
+/**
+ * Returns the calling thread's scratch #Arena for temporary
+ * allocations made while a command runs.  It may only be used
+ * inside a #ScratchArenaScope, and nothing allocated from it may
+ * outlive that scope.
+ */
+Arena &
+GetScratchArena();
+
+/**
+ * Marks the lifetime of allocations from GetScratchArena().  Scopes
+ * may be nested; the arena is reset when the outermost one ends.
+ */
+class ScratchArenaScope {
+public:
+	ScratchArenaScope();
+	~ScratchArenaScope();
+
+	ScratchArenaScope(const ScratchArenaScope &) = delete;
+	ScratchArenaScope &operator=(const ScratchArenaScope &) = delete;
+};
+
+#endif
@@ -36,6 +36,7 @@
 #include "storage/FileInfo.hxx"
 #include "db/plugins/simple/SimpleDatabasePlugin.hxx"
 #include "db/update/Service.hxx"
+#include "db/ResponseCache.hxx"
 #include "TimePrint.hxx"
 #include "IOThread.hxx"
 #include "Idle.hxx"
@@ -124,7 +125,7 @@ CommandResult
 handle_listfiles_storage(Response &r, const char *uri)
 {
 	Error error;
-	Storage *storage = CreateStorageURI(io_thread_get(), uri, error);
+	Storage *storage = CreateStorageURI(io_thread_get(IOThreadRole::INPUT), uri, error);
 	if (storage == nullptr) {
 		if (error.IsDefined())
 			return print_error(r, error);
@@ -198,6 +199,13 @@ handle_mount(Client &client, Request args, Response &r)
 		return CommandResult::ERROR;
 	}
 
+#ifdef ENABLE_DATABASE
+	if (client.partition.instance.IsDatabaseLoading()) {
+		r.Error(ACK_ERROR_UPDATE_ALREADY, "Database is being loaded");
+		return CommandResult::ERROR;
+	}
+#endif
+
 	CompositeStorage &composite = *(CompositeStorage *)_composite;
 
 	const char *const local_uri = args[0];
@@ -219,7 +227,7 @@ handle_mount(Client &client, Request args, Response &r)
 	}
 
 	Error error;
-	Storage *storage = CreateStorageURI(io_thread_get(), remote_uri,
+	Storage *storage = CreateStorageURI(io_thread_get(IOThreadRole::INPUT), remote_uri,
 					    error);
 	if (storage == nullptr) {
 		if (error.IsDefined())
@@ -249,6 +257,8 @@ handle_mount(Client &client, Request args, Response &r)
 
 		// TODO: call Instance::OnDatabaseModified()?
 		// TODO: trigger database update?
+		++client.partition.instance.database_version;
+		db_response_cache_invalidate();
 		client.partition.EmitIdle(IDLE_DATABASE);
 	}
 #endif
@@ -265,6 +275,13 @@ handle_unmount(Client &client, Request args, Response &r)
 		return CommandResult::ERROR;
 	}
 
+#ifdef ENABLE_DATABASE
+	if (client.partition.instance.IsDatabaseLoading()) {
+		r.Error(ACK_ERROR_UPDATE_ALREADY, "Database is being loaded");
+		return CommandResult::ERROR;
+	}
+#endif
+
 	CompositeStorage &composite = *(CompositeStorage *)_composite;
 
 	const char *const local_uri = args.front();
@@ -285,9 +302,12 @@ handle_unmount(Client &client, Request args, Response &r)
 	if (_db != nullptr && _db->IsPlugin(simple_db_plugin)) {
 		SimpleDatabase &db = *(SimpleDatabase *)_db;
 
-		if (db.Unmount(local_uri))
+		if (db.Unmount(local_uri)) {
 			// TODO: call Instance::OnDatabaseModified()?
+			++client.partition.instance.database_version;
+			db_response_cache_invalidate();
 			client.partition.EmitIdle(IDLE_DATABASE);
+		}
 	}
 #endif
 
@@ -35,16 +35,22 @@ enum class ConfigOption {
 	FOLLOW_OUTSIDE_SYMLINKS,
 	DB_FILE,
 	STICKER_FILE,
+	STICKER_SYNCHRONOUS,
+	STICKER_CACHE,
 	LOG_FILE,
 	PID_FILE,
 	STATE_FILE,
 	STATE_FILE_INTERVAL,
+	STATE_FILE_SNAPSHOT,
 	RESTORE_PAUSED,
 	USER,
 	GROUP,
 	BIND_TO_ADDRESS,
 	PORT,
+	METRICS_BIND_TO_ADDRESS,
+	METRICS_PORT,
 	LOG_LEVEL,
+	LOG_ASYNC,
 	ZEROCONF_NAME,
 	ZEROCONF_ENABLED,
 	PASSWORD,
@@ -58,7 +64,15 @@ enum class ConfigOption {
 	VOLUME_NORMALIZATION,
 	SAMPLERATE_CONVERTER,
 	AUDIO_BUFFER_SIZE,
+	AUDIO_CHUNK_SIZE,
+	AUDIO_BUFFER_HUGE_PAGES,
+	AUDIO_BUFFER_LOCK,
+	AUDIO_BUFFER_PREFAULT,
+	AUDIO_BUFFER_HISTORY,
+	CROSSFADE_BUFFER_SIZE,
 	BUFFER_BEFORE_PLAY,
+	PREFETCH_NEXT_SONG,
+	PREFETCH_SONGS,
 	HTTP_PROXY_HOST,
 	HTTP_PROXY_PORT,
 	HTTP_PROXY_USER,
@@ -68,6 +82,15 @@ enum class ConfigOption {
 	MAX_PLAYLIST_LENGTH,
 	MAX_COMMAND_LIST_SIZE,
 	MAX_OUTPUT_BUFFER_SIZE,
+	SLOW_COMMAND_THRESHOLD,
+	COMMAND_THREADS,
+	CLIENT_THREADS,
+	IO_THREADS,
+	EVENT_LOOP_STALL_THRESHOLD,
+	MEMORY_ACCOUNTING,
+	LOW_MEMORY,
+	TRACE_FILE,
+	TRACE_BUFFER_SIZE,
 	FS_CHARSET,
 	ID3V1_ENCODING,
 	METADATA_TO_USE,
@@ -75,6 +98,17 @@ enum class ConfigOption {
 	GAPLESS_MP3_PLAYBACK,
 	AUTO_UPDATE,
 	AUTO_UPDATE_DEPTH,
+	AUTO_UPDATE_BUDGET,
+	AUTO_UPDATE_FANOTIFY,
+	MIXRAMP_ANALYZER,
+	LOUDNESS_ANALYZER,
+	UPDATE_SCAN_THREADS,
+	UPDATE_TRUST_DIRECTORY_MTIME,
+	UPDATE_FILES_PER_SECOND,
+	UPDATE_KBYTES_PER_SECOND,
+	UPDATE_PLAYBACK_BACKOFF,
+	ARCHIVE_INDEX_CACHE,
+	INPUT_REWIND_SIZE,
 	DESPOTIFY_USER,
 	DESPOTIFY_PASSWORD,
 	DESPOTIFY_HIGH_BITRATE,
@@ -85,11 +119,14 @@ enum class ConfigBlockOption {
 	AUDIO_OUTPUT,
 	DECODER,
 	INPUT,
+	INPUT_CACHE,
+	RENDER_CACHE,
 	PLAYLIST_PLUGIN,
 	RESAMPLER,
 	AUDIO_FILTER,
 	DATABASE,
 	NEIGHBORS,
+	THREADS,
 	MAX
 };
 
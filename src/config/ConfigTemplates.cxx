@@ -30,16 +30,22 @@ const ConfigTemplate config_param_templates[] = {
 	{ "follow_outside_symlinks" },
 	{ "db_file" },
 	{ "sticker_file" },
+	{ "sticker_synchronous" },
+	{ "sticker_cache" },
 	{ "log_file" },
 	{ "pid_file" },
 	{ "state_file" },
 	{ "state_file_interval" },
+	{ "state_file_snapshot" },
 	{ "restore_paused" },
 	{ "user" },
 	{ "group" },
 	{ "bind_to_address", true },
 	{ "port" },
+	{ "metrics_bind_to_address", true },
+	{ "metrics_port" },
 	{ "log_level" },
+	{ "log_async" },
 	{ "zeroconf_name" },
 	{ "zeroconf_enabled" },
 	{ "password", true },
@@ -53,7 +59,15 @@ const ConfigTemplate config_param_templates[] = {
 	{ "volume_normalization" },
 	{ "samplerate_converter" },
 	{ "audio_buffer_size" },
+	{ "audio_chunk_size" },
+	{ "audio_buffer_huge_pages" },
+	{ "audio_buffer_lock" },
+	{ "audio_buffer_prefault" },
+	{ "audio_buffer_history" },
+	{ "crossfade_buffer_size" },
 	{ "buffer_before_play" },
+	{ "prefetch_next_song" },
+	{ "prefetch_songs" },
 	{ "http_proxy_host", false, true },
 	{ "http_proxy_port", false, true },
 	{ "http_proxy_user", false, true },
@@ -63,6 +77,15 @@ const ConfigTemplate config_param_templates[] = {
 	{ "max_playlist_length" },
 	{ "max_command_list_size" },
 	{ "max_output_buffer_size" },
+	{ "slow_command_threshold" },
+	{ "command_threads" },
+	{ "client_threads" },
+	{ "io_threads" },
+	{ "event_loop_stall_threshold" },
+	{ "memory_accounting" },
+	{ "low_memory" },
+	{ "trace_file" },
+	{ "trace_buffer_size" },
 	{ "filesystem_charset" },
 	{ "id3v1_encoding", false, true },
 	{ "metadata_to_use" },
@@ -70,6 +93,17 @@ const ConfigTemplate config_param_templates[] = {
 	{ "gapless_mp3_playback" },
 	{ "auto_update" },
 	{ "auto_update_depth" },
+	{ "auto_update_budget" },
+	{ "auto_update_fanotify" },
+	{ "mixramp_analyzer" },
+	{ "loudness_analyzer" },
+	{ "update_scan_threads" },
+	{ "update_trust_directory_mtime" },
+	{ "update_files_per_second" },
+	{ "update_kbytes_per_second" },
+	{ "update_playback_backoff" },
+	{ "archive_index_cache" },
+	{ "input_rewind_size" },
 	{ "despotify_user", false, true },
 	{ "despotify_password", false, true },
 	{ "despotify_high_bitrate", false, true },
@@ -85,11 +119,14 @@ const ConfigTemplate config_block_templates[] = {
 	{ "audio_output", true },
 	{ "decoder", true },
 	{ "input", true },
+	{ "input_cache" },
+	{ "render_cache" },
 	{ "playlist_plugin", true },
 	{ "resampler" },
 	{ "filter", true },
 	{ "database" },
 	{ "neighbors", true },
+	{ "threads", true },
 };
 
 static constexpr unsigned n_config_block_templates =
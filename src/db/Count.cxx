@@ -25,10 +25,14 @@
 #include "client/Response.hxx"
 #include "LightSong.hxx"
 #include "tag/Tag.hxx"
+#include "command/ScratchArena.hxx"
+#include "Compiler.h"
 
 #include <functional>
 #include <map>
 
+#include <string.h>
+
 struct SearchStats {
 	unsigned n_songs;
 	std::chrono::duration<std::uint64_t, SongTime::period> total_duration;
@@ -37,7 +41,38 @@ struct SearchStats {
 		:n_songs(0), total_duration(0) {}
 };
 
-class TagCountMap : public std::map<std::string, SearchStats> {
+struct CStringLess {
+	gcc_pure
+	bool operator()(const char *a, const char *b) const {
+		return strcmp(a, b) < 0;
+	}
+};
+
+/**
+ * Maps tag values to their #SearchStats.  Keys and nodes live in the
+ * per-command scratch arena, because this map is discarded as soon
+ * as the response has been printed.
+ */
+class TagCountMap
+	: public std::map<const char *, SearchStats, CStringLess,
+			  ArenaAllocator<std::pair<const char *const,
+						   SearchStats>>> {
+	Arena &arena;
+
+public:
+	explicit TagCountMap(Arena &_arena)
+		:map(key_compare(), allocator_type(_arena)),
+		 arena(_arena) {}
+
+	SearchStats &operator[](const char *value) {
+		auto i = lower_bound(value);
+		if (i == end() || key_comp()(value, i->first))
+			/* the tag value is only valid while the
+			   database is locked; copy it */
+			i = emplace_hint(i, arena.Dup(value), SearchStats());
+
+		return i->second;
+	}
 };
 
 static void
@@ -57,7 +92,7 @@ Print(Response &r, TagType group, const TagCountMap &m)
 	assert(unsigned(group) < TAG_NUM_OF_ITEM_TYPES);
 
 	for (const auto &i : m) {
-		r.Format("%s: %s\n", tag_item_names[group], i.first.c_str());
+		r.Format("%s: %s\n", tag_item_names[group], i.first);
 		PrintSearchStats(r, i.second);
 	}
 }
@@ -80,9 +115,7 @@ CollectGroupCounts(TagCountMap &map, TagType group, const Tag &tag)
 	bool found = false;
 	for (const auto &item : tag) {
 		if (item.type == group) {
-			auto r = map.insert(std::make_pair(item.value,
-							   SearchStats()));
-			SearchStats &s = r.first->second;
+			SearchStats &s = map[item.value];
 			++s.n_songs;
 			if (!tag.duration.IsNegative())
 				s.total_duration += tag.duration;
@@ -135,7 +168,7 @@ PrintSongCount(Response &r, const Partition &partition, const char *name,
 		/* group by the specified tag: store counts in a
 		   std::map */
 
-		TagCountMap map;
+		TagCountMap map(GetScratchArena());
 
 		using namespace std::placeholders;
 		const auto f = std::bind(GroupCountVisitor, std::ref(map),
@@ -34,6 +34,11 @@ enum class DatabaseErrorCode {
 	NOT_FOUND,
 
 	CONFLICT,
+
+	/**
+	 * The database is still being loaded in the background.
+	 */
+	LOADING,
 };
 
 class DatabaseError final : public std::runtime_error {
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DatabaseLoader.hxx"
+#include "Interface.hxx"
+#include "thread/Name.hxx"
+#include "Log.hxx"
+
+#include <stdexcept>
+
+#include <assert.h>
+
+DatabaseLoader::~DatabaseLoader()
+{
+	if (thread.IsDefined())
+		thread.Join();
+}
+
+bool
+DatabaseLoader::Start(Error &error)
+{
+	assert(!thread.IsDefined());
+
+	return thread.Start(Task, this, error);
+}
+
+inline void
+DatabaseLoader::Task()
+{
+	SetThreadName("db_load");
+
+	try {
+		db.Open();
+	} catch (const std::exception &e) {
+		LogError(e);
+	}
+
+	DeferredMonitor::Schedule();
+}
+
+void
+DatabaseLoader::Task(void *ctx)
+{
+	DatabaseLoader &loader = *(DatabaseLoader *)ctx;
+	loader.Task();
+}
+
+void
+DatabaseLoader::RunDeferred()
+{
+	thread.Join();
+
+	callback();
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DATABASE_LOADER_HXX
+#define MPD_DATABASE_LOADER_HXX
+
+#include "check.h"
+#include "event/DeferredMonitor.hxx"
+#include "thread/Thread.hxx"
+
+class Database;
+class Error;
+
+/**
+ * Loads a #Database (i.e. calls Database::Open()) in a separate
+ * thread, so MPD can serve clients and play the restored queue
+ * meanwhile.  Until the callback has been invoked, nobody else may
+ * access the #Database.
+ */
+class DatabaseLoader final : DeferredMonitor {
+	Database &db;
+
+	/**
+	 * Invoked in the main thread after the #Database has been
+	 * loaded.  It may delete this object.
+	 */
+	void (*const callback)();
+
+	Thread thread;
+
+public:
+	DatabaseLoader(EventLoop &_loop, Database &_db, void (*_callback)())
+		:DeferredMonitor(_loop), db(_db), callback(_callback) {}
+
+	/**
+	 * Waits for the thread to finish (without invoking the
+	 * callback).
+	 */
+	~DatabaseLoader();
+
+	bool Start(Error &error);
+
+private:
+	void Task();
+	static void Task(void *ctx);
+
+	/* virtual methods from class DeferredMonitor */
+	void RunDeferred() override;
+};
+
+#endif
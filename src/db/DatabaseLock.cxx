@@ -22,6 +22,9 @@
 
 Mutex db_mutex;
 
+uint64_t db_mutex_since;
+thread_local uint64_t db_mutex_held_us;
+
 #ifndef NDEBUG
 ThreadId db_mutex_holder;
 #endif
@@ -28,12 +28,27 @@
 
 #include "check.h"
 #include "thread/Mutex.hxx"
+#include "system/Clock.hxx"
 #include "Compiler.h"
 
 #include <assert.h>
+#include <stdint.h>
 
 extern Mutex db_mutex;
 
+/**
+ * The MonotonicClockUS() value when the current holder obtained the
+ * #db_mutex.  Protected by the #db_mutex.
+ */
+extern uint64_t db_mutex_since;
+
+/**
+ * The total number of microseconds the current thread has held the
+ * #db_mutex.  The command dispatcher uses it to measure how long a
+ * command has blocked other threads.
+ */
+extern thread_local uint64_t db_mutex_held_us;
+
 #ifndef NDEBUG
 
 #include "thread/Id.hxx"
@@ -67,6 +82,8 @@ db_lock(void)
 #ifndef NDEBUG
 	db_mutex_holder = ThreadId::GetCurrent();
 #endif
+
+	db_mutex_since = MonotonicClockUS();
 }
 
 /**
@@ -80,6 +97,8 @@ db_unlock(void)
 	db_mutex_holder = ThreadId::Null();
 #endif
 
+	db_mutex_held_us += MonotonicClockUS() - db_mutex_since;
+
 	db_mutex.unlock();
 }
 
@@ -39,6 +39,18 @@ struct DatabasePlugin {
 	 */
 	static constexpr unsigned FLAG_REQUIRE_STORAGE = 0x1;
 
+	/**
+	 * Database::Visit() implements DatabaseSelection::after.
+	 */
+	static constexpr unsigned FLAG_RESUME_VISIT = 0x2;
+
+	/**
+	 * Database::Visit(), Database::VisitUniqueTags() and
+	 * Database::GetStats() may be called from any thread,
+	 * concurrently with the main thread.
+	 */
+	static constexpr unsigned FLAG_THREAD_SAFE = 0x4;
+
 	const char *name;
 
 	unsigned flags;
@@ -53,6 +65,14 @@ struct DatabasePlugin {
 	constexpr bool RequireStorage() const {
 		return flags & FLAG_REQUIRE_STORAGE;
 	}
+
+	constexpr bool CanResumeVisit() const {
+		return flags & FLAG_RESUME_VISIT;
+	}
+
+	constexpr bool IsThreadSafe() const {
+		return flags & FLAG_THREAD_SAFE;
+	}
 };
 
 #endif
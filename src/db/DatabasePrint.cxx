@@ -30,9 +30,14 @@
 #include "LightDirectory.hxx"
 #include "PlaylistInfo.hxx"
 #include "Interface.hxx"
+#include "DatabasePlugin.hxx"
+#include "client/Client.hxx"
 #include "fs/Traits.hxx"
 
 #include <functional>
+#include <string>
+
+#include <assert.h>
 
 static const char *
 ApplyBaseFlag(const char *uri, bool base)
@@ -196,6 +201,82 @@ db_selection_print(Response &r, Partition &partition,
 				  error);
 }
 
+bool
+db_selection_print_part(Response &r, Partition &partition,
+			DatabaseSelection &selection,
+			bool full, bool base, unsigned &limit,
+			bool &complete_r, Error &error)
+{
+	const Database *db = partition.GetDatabase(error);
+	if (db == nullptr)
+		return false;
+
+	assert(db->GetPlugin().CanResumeVisit());
+
+	const Client &client = r.GetClient();
+
+	/* the URI of the last object which was printed; it can't be
+	   written to selection.after directly, because Visit() still
+	   uses that */
+	std::string last;
+	bool paused = false;
+
+	assert(limit > 0);
+
+	const auto check_pause = [&client, &limit, &paused](){
+		--limit;
+		paused = limit == 0 || client.IsOutputFull();
+		return !paused;
+	};
+
+	VisitDirectory d;
+	if (selection.filter == nullptr)
+		d = [&](const LightDirectory &directory, Error &){
+			(full ? PrintDirectoryFull : PrintDirectoryBrief)(r, base,
+									  directory);
+			if (directory.IsRoot())
+				/* nothing was printed, and the root
+				   can't be a resume position */
+				return true;
+
+			last = directory.GetPath();
+			return check_pause();
+		};
+
+	const VisitSong s = [&](const LightSong &song, Error &){
+		(full ? PrintSongFull : PrintSongBrief)(r, partition, base,
+							song);
+		last = song.GetURI();
+		return check_pause();
+	};
+
+	VisitPlaylist p;
+	if (selection.filter == nullptr)
+		p = [&](const PlaylistInfo &playlist,
+			const LightDirectory &directory, Error &){
+			(full ? PrintPlaylistFull : PrintPlaylistBrief)(r, base,
+									playlist,
+									directory);
+			if (directory.IsRoot())
+				last = playlist.name;
+			else {
+				last = directory.GetPath();
+				last.push_back('/');
+				last.append(playlist.name);
+			}
+
+			return check_pause();
+		};
+
+	if (!db->Visit(selection, d, s, p, error) && !paused)
+		return false;
+
+	complete_r = !paused;
+	if (paused)
+		selection.after = std::move(last);
+	return true;
+}
+
 static bool
 PrintSongURIVisitor(Response &r, Partition &partition, const LightSong &song)
 {
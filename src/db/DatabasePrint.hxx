@@ -44,6 +44,27 @@ db_selection_print(Response &r, Partition &partition,
 		   unsigned window_start, unsigned window_end,
 		   Error &error);
 
+/**
+ * Like db_selection_print(), but stop as soon as the client's output
+ * buffer is full (see Client::IsOutputFull()) or after the given
+ * number of objects.  Requires a database plugin with
+ * DatabasePlugin::FLAG_RESUME_VISIT.
+ *
+ * @param selection the selection; its "after" attribute is updated
+ * to the last object which was printed, so the next call resumes
+ * there
+ * @param limit the maximum number of objects (songs, directories
+ * and playlists) to be printed; it is decremented by the number of
+ * objects which were printed
+ * @param complete_r set to true if the selection has been printed
+ * completely
+ */
+bool
+db_selection_print_part(Response &r, Partition &partition,
+			DatabaseSelection &selection,
+			bool full, bool base, unsigned &limit,
+			bool &complete_r, Error &error);
+
 bool
 PrintUniqueTags(Response &r, Partition &partition,
 		unsigned type, tag_mask_t group_mask,
@@ -28,6 +28,8 @@
 #include <time.h>
 
 struct Tag;
+class MixRampInfo;
+struct ReplayGainInfo;
 
 /**
  * A reference to a song file.  Unlike the other "Song" classes in the
@@ -75,6 +77,16 @@ struct LightSong {
 	 */
 	SongTime end_time;
 
+	/**
+	 * MixRamp data from the database; nullptr if unknown.
+	 */
+	const MixRampInfo *mix_ramp;
+
+	/**
+	 * ReplayGain data from the database; nullptr if unknown.
+	 */
+	const ReplayGainInfo *replay_gain;
+
 	gcc_pure
 	std::string GetURI() const {
 		if (directory == nullptr)
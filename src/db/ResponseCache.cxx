@@ -0,0 +1,139 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ResponseCache.hxx"
+#include "Interface.hxx"
+
+#include <iterator>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+#include <time.h>
+
+/**
+ * The maximum number of cached responses.
+ */
+static constexpr size_t RESPONSE_CACHE_MAX_ITEMS = 64;
+
+/**
+ * The maximum total size of all cached responses.
+ */
+static constexpr size_t RESPONSE_CACHE_MAX_SIZE = 8 * 1024 * 1024;
+
+/**
+ * Responses larger than this are not cached at all, because they
+ * would evict everything else.
+ */
+static constexpr size_t RESPONSE_CACHE_MAX_ITEM_SIZE =
+	RESPONSE_CACHE_MAX_SIZE / 4;
+
+typedef std::pair<std::string, std::string> ResponseCacheItem;
+
+/**
+ * All cached responses, the most recently used one first.
+ */
+static std::list<ResponseCacheItem> response_cache_lru;
+
+static std::unordered_map<std::string,
+			  std::list<ResponseCacheItem>::iterator>
+	response_cache_map;
+
+static size_t response_cache_size;
+
+/**
+ * The database and its update stamp the current entries were
+ * created for.
+ */
+static const Database *response_cache_db;
+static time_t response_cache_stamp;
+
+static void
+response_cache_erase(std::list<ResponseCacheItem>::iterator i)
+{
+	response_cache_size -= i->first.length() + i->second.length();
+	response_cache_map.erase(i->first);
+	response_cache_lru.erase(i);
+}
+
+void
+db_response_cache_invalidate()
+{
+	response_cache_map.clear();
+	response_cache_lru.clear();
+	response_cache_size = 0;
+	response_cache_db = nullptr;
+}
+
+/**
+ * Discard all entries if they were created for a different database
+ * or a different update stamp.
+ */
+static void
+response_cache_check(const Database &db)
+{
+	const time_t stamp = db.GetUpdateStamp();
+	if (&db != response_cache_db || stamp != response_cache_stamp) {
+		db_response_cache_invalidate();
+		response_cache_db = &db;
+		response_cache_stamp = stamp;
+	}
+}
+
+const std::string *
+db_response_cache_get(const Database &db, const std::string &key)
+{
+	response_cache_check(db);
+
+	auto i = response_cache_map.find(key);
+	if (i == response_cache_map.end())
+		return nullptr;
+
+	/* move to the front of the LRU list */
+	response_cache_lru.splice(response_cache_lru.begin(),
+				  response_cache_lru, i->second);
+	return &i->second->second;
+}
+
+void
+db_response_cache_put(const Database &db, std::string &&key,
+		      std::string &&value)
+{
+	const size_t size = key.length() + value.length();
+	if (size > RESPONSE_CACHE_MAX_ITEM_SIZE)
+		return;
+
+	response_cache_check(db);
+
+	auto i = response_cache_map.find(key);
+	if (i != response_cache_map.end())
+		/* replace the old entry */
+		response_cache_erase(i->second);
+
+	while (!response_cache_lru.empty() &&
+	       (response_cache_lru.size() >= RESPONSE_CACHE_MAX_ITEMS ||
+		response_cache_size + size > RESPONSE_CACHE_MAX_SIZE))
+		response_cache_erase(std::prev(response_cache_lru.end()));
+
+	response_cache_lru.emplace_front(std::move(key), std::move(value));
+	response_cache_map.emplace(response_cache_lru.front().first,
+				   response_cache_lru.begin());
+	response_cache_size += size;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DB_RESPONSE_CACHE_HXX
+#define MPD_DB_RESPONSE_CACHE_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <string>
+
+class Database;
+
+/*
+ * A bounded LRU cache of formatted responses to expensive database
+ * queries ("list", "count ... group").  The key is a normalized
+ * representation of the command and its arguments (built by the
+ * caller), and the value is the exact text which was sent to the
+ * client.
+ *
+ * All entries are discarded when the database is modified
+ * (db_response_cache_invalidate()) or when its update stamp differs
+ * from the one the entries were created with.
+ */
+
+/**
+ * Look up a cached response.
+ *
+ * @return the response text or nullptr if there is no (valid) entry;
+ * the pointer is valid until the next call to any function in this
+ * library
+ */
+gcc_pure
+const std::string *
+db_response_cache_get(const Database &db, const std::string &key);
+
+/**
+ * Store a response in the cache.  Responses which are too large are
+ * silently ignored.
+ */
+void
+db_response_cache_put(const Database &db, std::string &&key,
+		      std::string &&value);
+
+/**
+ * Discard all cached responses.
+ */
+void
+db_response_cache_invalidate();
+
+#endif
@@ -41,6 +41,18 @@ struct DatabaseSelection {
 
 	const SongFilter *filter;
 
+	/**
+	 * If not empty, then everything up to and including the
+	 * object (song, directory or playlist) with this URI is
+	 * skipped, i.e. a previous Database::Visit() call which was
+	 * interrupted after this object is resumed.  Only plugins
+	 * with DatabasePlugin::FLAG_RESUME_VISIT implement this.
+	 *
+	 * The URI of a playlist is the path of its directory plus its
+	 * name.
+	 */
+	std::string after;
+
 	DatabaseSelection(const char *_uri, bool _recursive,
 			  const SongFilter *_filter=nullptr);
 
@@ -28,6 +28,12 @@
 #include "db/LightDirectory.hxx"
 #include "db/LightSong.hxx"
 #include "db/Stats.hxx"
+#include "db/Helpers.hxx"
+#include "db/UniqueTags.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/PlaylistVector.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
 #include "SongFilter.hxx"
 #include "Compiler.h"
 #include "config/Block.hxx"
@@ -36,6 +42,7 @@
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "util/ScopeExit.hxx"
+#include "util/StringCompare.hxx"
 #include "protocol/Ack.hxx"
 #include "event/SocketMonitor.hxx"
 #include "event/IdleMonitor.hxx"
@@ -44,11 +51,17 @@
 #include <mpd/client.h>
 #include <mpd/async.h>
 
+#include <algorithm>
 #include <cassert>
 #include <string>
 #include <list>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
 
-class LibmpdclientError final : std::runtime_error {
+#include <string.h>
+
+class LibmpdclientError final : public std::runtime_error {
 	enum mpd_error code;
 
 public:
@@ -79,6 +92,32 @@ public:
 	}
 };
 
+class ProxyEntity {
+	struct mpd_entity *entity;
+
+public:
+	explicit ProxyEntity(struct mpd_entity *_entity)
+		:entity(_entity) {}
+
+	ProxyEntity(const ProxyEntity &other) = delete;
+
+	ProxyEntity(ProxyEntity &&other)
+		:entity(other.entity) {
+		other.entity = nullptr;
+	}
+
+	~ProxyEntity() {
+		if (entity != nullptr)
+			mpd_entity_free(entity);
+	}
+
+	ProxyEntity &operator=(const ProxyEntity &other) = delete;
+
+	operator const struct mpd_entity *() const {
+		return entity;
+	}
+};
+
 class ProxyDatabase final : public Database, SocketMonitor, IdleMonitor {
 	DatabaseListener &listener;
 
@@ -86,8 +125,50 @@ class ProxyDatabase final : public Database, SocketMonitor, IdleMonitor {
 	unsigned port;
 	bool keepalive;
 
+	/**
+	 * Keep the responses of the other MPD in #directory_cache?
+	 */
+	bool cache;
+
 	struct mpd_connection *connection;
 
+	/**
+	 * Cached "lsinfo" responses of the other MPD, indexed by
+	 * URI.  This is cleared as soon as the other MPD reports a
+	 * database modification, and on a new connection, because
+	 * events may have been missed while disconnected.
+	 */
+	mutable std::map<std::string, std::list<ProxyEntity>> directory_cache;
+
+	/**
+	 * Keep a full copy of the other MPD's database in
+	 * #mirror_root?
+	 */
+	bool mirror;
+
+	/**
+	 * The local copy of the other MPD's database; only used if
+	 * #mirror is enabled.  Like the tree of #SimpleDatabase, it
+	 * is protected by the global #db_mutex.
+	 */
+	Directory *mirror_root = nullptr;
+
+	/**
+	 * Has #mirror_root been synchronized at least once?  Until
+	 * then, all requests are forwarded to the other MPD.
+	 */
+	bool mirror_valid = false;
+
+	/**
+	 * A buffer for GetSong() in mirror mode.
+	 */
+	mutable LightSong mirror_light_song;
+
+	/**
+	 * The directory path #mirror_light_song points to.
+	 */
+	mutable std::string mirror_light_song_directory;
+
 	/* this is mutable because GetStats() must be "const" */
 	mutable time_t update_stamp;
 
@@ -140,6 +221,13 @@ public:
 		return update_stamp;
 	}
 
+	/**
+	 * Obtain the "lsinfo" response for the specified directory,
+	 * either from #directory_cache or from the other MPD.  The
+	 * returned reference is valid until the cache is cleared.
+	 */
+	const std::list<ProxyEntity> &ListDirectory(const char *uri) const;
+
 private:
 	bool Configure(const ConfigBlock &block, Error &error);
 
@@ -149,6 +237,18 @@ private:
 
 	void Disconnect();
 
+	/**
+	 * Download the whole database of the other MPD and apply the
+	 * differences to #mirror_root.
+	 */
+	void SyncMirror();
+
+	bool VisitMirror(const DatabaseSelection &selection,
+			 VisitDirectory visit_directory,
+			 VisitSong visit_song,
+			 VisitPlaylist visit_playlist,
+			 Error &error) const;
+
 	/* virtual methods from SocketMonitor */
 	virtual bool OnSocketReady(unsigned flags) override;
 
@@ -215,6 +315,9 @@ ProxySong::ProxySong(const mpd_song *song)
 	start_time = end_time = SongTime::zero();
 #endif
 
+	mix_ramp = nullptr;
+	replay_gain = nullptr;
+
 	TagBuilder tag_builder;
 
 	const unsigned duration = mpd_song_get_duration(song);
@@ -357,6 +460,8 @@ ProxyDatabase::Configure(const ConfigBlock &block, gcc_unused Error &error)
 	host = block.GetBlockValue("host", "");
 	port = block.GetBlockValue("port", 0u);
 	keepalive = block.GetBlockValue("keepalive", false);
+	cache = block.GetBlockValue("cache", true);
+	mirror = block.GetBlockValue("mirror", false);
 
 	return true;
 }
@@ -364,6 +469,11 @@ ProxyDatabase::Configure(const ConfigBlock &block, gcc_unused Error &error)
 void
 ProxyDatabase::Open()
 {
+	if (mirror) {
+		mirror_root = Directory::NewRoot();
+		mirror_valid = false;
+	}
+
 	Connect();
 
 	update_stamp = 0;
@@ -374,6 +484,9 @@ ProxyDatabase::Close()
 {
 	if (connection != nullptr)
 		Disconnect();
+
+	delete mirror_root;
+	mirror_root = nullptr;
 }
 
 void
@@ -400,6 +513,8 @@ ProxyDatabase::Connect()
 	idle_received = unsigned(-1);
 	is_idle = false;
 
+	directory_cache.clear();
+
 	SocketMonitor::Open(mpd_async_get_fd(mpd_connection_get_async(connection)));
 	IdleMonitor::Schedule();
 }
@@ -426,6 +541,9 @@ ProxyDatabase::CheckConnection()
 			}
 		}
 
+		if (idle & MPD_IDLE_DATABASE)
+			directory_cache.clear();
+
 		idle_received |= idle;
 		is_idle = false;
 		IdleMonitor::Schedule();
@@ -489,8 +607,17 @@ ProxyDatabase::OnIdle()
 
 	/* handle previous idle events */
 
-	if (idle_received & MPD_IDLE_DATABASE)
+	if (idle_received & MPD_IDLE_DATABASE) {
+		if (mirror) {
+			try {
+				SyncMirror();
+			} catch (const std::runtime_error &error) {
+				LogError(error);
+			}
+		}
+
 		listener.OnDatabaseModified();
+	}
 
 	idle_received = 0;
 
@@ -517,12 +644,300 @@ ProxyDatabase::OnIdle()
 	SocketMonitor::ScheduleRead();
 }
 
+static std::list<ProxyEntity>
+ReceiveEntities(struct mpd_connection *connection)
+{
+	std::list<ProxyEntity> entities;
+	struct mpd_entity *entity;
+	while ((entity = mpd_recv_entity(connection)) != nullptr)
+		entities.push_back(ProxyEntity(entity));
+
+	mpd_response_finish(connection);
+	return entities;
+}
+
+/**
+ * Keeps track of the objects found in the other MPD's database
+ * during ProxyDatabase::SyncMirror(); everything else is deleted
+ * afterwards.
+ */
+struct MirrorSync {
+	std::unordered_set<const Directory *> directories;
+	std::unordered_set<const Song *> songs;
+	std::unordered_map<const Directory *, PlaylistVector> playlists;
+
+	/**
+	 * Look up (or create) the directory with the given path and
+	 * mark it (and all of its parents) as seen.
+	 */
+	Directory &MakeDirectory(Directory &root, const char *path,
+				 size_t length);
+
+	Directory &MakeParent(Directory &root, const char *uri,
+			      const char *&name) {
+		const char *slash = strrchr(uri, '/');
+		if (slash == nullptr) {
+			name = uri;
+			return root;
+		}
+
+		name = slash + 1;
+		return MakeDirectory(root, uri, slash - uri);
+	}
+
+	void AddDirectory(Directory &root,
+			  const struct mpd_directory *directory);
+	void AddSong(Directory &root, const struct mpd_song *song);
+	void AddPlaylist(Directory &root,
+			 const struct mpd_playlist *playlist);
+
+	/**
+	 * Delete all objects which have not been seen.
+	 */
+	void Sweep(Directory &directory);
+};
+
+Directory &
+MirrorSync::MakeDirectory(Directory &root, const char *path, size_t length)
+{
+	Directory *directory = &root;
+	const char *const end = path + length;
+
+	while (path < end) {
+		const char *slash = std::find(path, end, '/');
+		const std::string name(path, slash);
+		Directory *child = directory->FindChild(name.c_str());
+		if (child == nullptr) {
+			child = directory->CreateChild(name.c_str());
+
+			/* let SortModified() sort the new child into
+			   place */
+			directory->MarkModified();
+		}
+
+		directory = child;
+		directories.insert(directory);
+
+		path = slash < end ? slash + 1 : end;
+	}
+
+	return *directory;
+}
+
+inline void
+MirrorSync::AddDirectory(Directory &root,
+			 const struct mpd_directory *_directory)
+{
+	const char *path = mpd_directory_get_path(_directory);
+	Directory &directory = MakeDirectory(root, path, strlen(path));
+#if LIBMPDCLIENT_CHECK_VERSION(2,9,0)
+	directory.mtime = mpd_directory_get_last_modified(_directory);
+#endif
+}
+
+inline void
+MirrorSync::AddSong(Directory &root, const struct mpd_song *_song)
+{
+	const ProxySong src(_song);
+
+	const char *name;
+	Directory &directory = MakeParent(root, src.uri, name);
+
+	Song *song = directory.FindSong(name);
+	if (song != nullptr) {
+		if (song->mtime == src.mtime &&
+		    song->start_time == src.start_time &&
+		    song->end_time == src.end_time) {
+			/* unmodified */
+			songs.insert(song);
+			return;
+		}
+
+		directory.RemoveSong(song);
+		song->Free();
+	}
+
+	song = Song::NewFile(name, directory);
+	song->tag = Tag(*src.tag);
+	song->mtime = src.mtime;
+	song->start_time = src.start_time;
+	song->end_time = src.end_time;
+	directory.AddSong(song);
+	songs.insert(song);
+}
+
+inline void
+MirrorSync::AddPlaylist(Directory &root, const struct mpd_playlist *playlist)
+{
+	const char *name;
+	Directory &directory =
+		MakeParent(root, mpd_playlist_get_path(playlist), name);
+
+	playlists[&directory].push_back(PlaylistInfo(name,
+						     mpd_playlist_get_last_modified(playlist)));
+}
+
+void
+MirrorSync::Sweep(Directory &directory)
+{
+	directory.ForEachChildSafe([this](Directory &child){
+			if (directories.find(&child) == directories.end())
+				child.Delete();
+			else
+				Sweep(child);
+		});
+
+	directory.ForEachSongSafe([this, &directory](Song &song){
+			if (songs.find(&song) == songs.end()) {
+				directory.RemoveSong(&song);
+				song.Free();
+			}
+		});
+
+	auto i = playlists.find(&directory);
+	if (i != playlists.end())
+		directory.playlists = std::move(i->second);
+	else
+		directory.playlists.clear();
+}
+
+void
+ProxyDatabase::SyncMirror()
+{
+	assert(mirror_root != nullptr);
+	assert(connection != nullptr);
+	assert(!is_idle);
+
+	if (!mpd_send_list_all_meta(connection, ""))
+		ThrowError(connection);
+
+	const std::list<ProxyEntity> entities(ReceiveEntities(connection));
+	CheckError(connection);
+
+	struct mpd_stats *stats = mpd_run_stats(connection);
+	if (stats == nullptr)
+		ThrowError(connection);
+
+	update_stamp = (time_t)mpd_stats_get_db_update_time(stats);
+	mpd_stats_free(stats);
+
+	MirrorSync sync;
+
+	const ScopeDatabaseLock protect;
+
+	for (const auto &entity : entities) {
+		switch (mpd_entity_get_type(entity)) {
+		case MPD_ENTITY_TYPE_UNKNOWN:
+			break;
+
+		case MPD_ENTITY_TYPE_DIRECTORY:
+			sync.AddDirectory(*mirror_root,
+					  mpd_entity_get_directory(entity));
+			break;
+
+		case MPD_ENTITY_TYPE_SONG:
+			sync.AddSong(*mirror_root,
+				     mpd_entity_get_song(entity));
+			break;
+
+		case MPD_ENTITY_TYPE_PLAYLIST:
+			sync.AddPlaylist(*mirror_root,
+					 mpd_entity_get_playlist(entity));
+			break;
+		}
+	}
+
+	sync.Sweep(*mirror_root);
+
+	mirror_root->SortModified();
+	mirror_root->ClearModified();
+	mirror_valid = true;
+
+	FormatDebug(libmpdclient_domain, "mirrored %zu songs",
+		    sync.songs.size());
+}
+
+const std::list<ProxyEntity> &
+ProxyDatabase::ListDirectory(const char *uri) const
+{
+	auto i = directory_cache.find(uri);
+	if (i != directory_cache.end())
+		return i->second;
+
+	if (!mpd_send_list_meta(connection, uri))
+		ThrowError(connection);
+
+	std::list<ProxyEntity> entities(ReceiveEntities(connection));
+	CheckError(connection);
+
+	return directory_cache.emplace(uri, std::move(entities)).first->second;
+}
+
+/**
+ * Look up a song in the cached listing of its parent directory.
+ *
+ * @return the song or nullptr if the directory does not contain it
+ */
+gcc_pure
+static const struct mpd_song *
+FindSong(const std::list<ProxyEntity> &entities, const char *uri)
+{
+	for (const auto &entity : entities)
+		if (mpd_entity_get_type(entity) == MPD_ENTITY_TYPE_SONG) {
+			const struct mpd_song *song =
+				mpd_entity_get_song(entity);
+			if (strcmp(mpd_song_get_uri(song), uri) == 0)
+				return song;
+		}
+
+	return nullptr;
+}
+
 const LightSong *
 ProxyDatabase::GetSong(const char *uri) const
 {
+	if (mirror_valid) {
+		const ScopeDatabaseLock protect;
+
+		auto r = mirror_root->LookupDirectory(uri);
+		const Song *song = r.uri != nullptr &&
+			strchr(r.uri, '/') == nullptr
+			? r.directory->FindSong(r.uri)
+			: nullptr;
+		if (song == nullptr)
+			throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
+					    "No such song");
+
+		mirror_light_song_directory = r.directory->GetPath();
+		mirror_light_song = song->Export(mirror_light_song_directory);
+		return &mirror_light_song;
+	}
+
 	// TODO: eliminate the const_cast
 	const_cast<ProxyDatabase *>(this)->EnsureConnected();
 
+	if (cache) {
+		/* fetch the whole parent directory with one round
+		   trip; the sibling songs are likely to be requested
+		   next (e.g. when a directory is added to the
+		   queue) */
+		const char *slash = strrchr(uri, '/');
+		const std::string parent = slash != nullptr
+			? std::string(uri, slash)
+			: std::string();
+
+		try {
+			const auto *song =
+				FindSong(ListDirectory(parent.c_str()), uri);
+			if (song != nullptr)
+				return new AllocatedProxySong(mpd_song_dup(song));
+		} catch (const std::runtime_error &) {
+			/* the parent directory could not be listed;
+			   fall back to asking for the song itself */
+			const_cast<ProxyDatabase *>(this)->CheckConnection();
+		}
+	}
+
 	if (!mpd_send_list_meta(connection, uri))
 		ThrowError(connection);
 
@@ -545,19 +960,22 @@ ProxyDatabase::ReturnSong(const LightSong *_song) const
 {
 	assert(_song != nullptr);
 
+	if (_song == &mirror_light_song)
+		return;
+
 	AllocatedProxySong *song = (AllocatedProxySong *)
 		const_cast<LightSong *>(_song);
 	delete song;
 }
 
 static bool
-Visit(struct mpd_connection *connection, const char *uri,
+Visit(const ProxyDatabase &db, const char *uri,
       bool recursive, const SongFilter *filter,
       VisitDirectory visit_directory, VisitSong visit_song,
       VisitPlaylist visit_playlist, Error &error);
 
 static bool
-Visit(struct mpd_connection *connection,
+Visit(const ProxyDatabase &db,
       bool recursive, const SongFilter *filter,
       const struct mpd_directory *directory,
       VisitDirectory visit_directory, VisitSong visit_song,
@@ -575,7 +993,7 @@ Visit(struct mpd_connection *connection,
 		return false;
 
 	if (recursive &&
-	    !Visit(connection, path, recursive, filter,
+	    !Visit(db, path, recursive, filter,
 		   visit_directory, visit_song, visit_playlist, error))
 		return false;
 
@@ -614,63 +1032,19 @@ Visit(const struct mpd_playlist *playlist,
 	return visit_playlist(p, LightDirectory::Root(), error);
 }
 
-class ProxyEntity {
-	struct mpd_entity *entity;
-
-public:
-	explicit ProxyEntity(struct mpd_entity *_entity)
-		:entity(_entity) {}
-
-	ProxyEntity(const ProxyEntity &other) = delete;
-
-	ProxyEntity(ProxyEntity &&other)
-		:entity(other.entity) {
-		other.entity = nullptr;
-	}
-
-	~ProxyEntity() {
-		if (entity != nullptr)
-			mpd_entity_free(entity);
-	}
-
-	ProxyEntity &operator=(const ProxyEntity &other) = delete;
-
-	operator const struct mpd_entity *() const {
-		return entity;
-	}
-};
-
-static std::list<ProxyEntity>
-ReceiveEntities(struct mpd_connection *connection)
-{
-	std::list<ProxyEntity> entities;
-	struct mpd_entity *entity;
-	while ((entity = mpd_recv_entity(connection)) != nullptr)
-		entities.push_back(ProxyEntity(entity));
-
-	mpd_response_finish(connection);
-	return entities;
-}
-
 static bool
-Visit(struct mpd_connection *connection, const char *uri,
+Visit(const ProxyDatabase &db, const char *uri,
       bool recursive, const SongFilter *filter,
       VisitDirectory visit_directory, VisitSong visit_song,
       VisitPlaylist visit_playlist, Error &error)
 {
-	if (!mpd_send_list_meta(connection, uri))
-		ThrowError(connection);
-
-	std::list<ProxyEntity> entities(ReceiveEntities(connection));
-	CheckError(connection);
-
-	for (const auto &entity : entities) {
+	for (const auto &entity : db.ListDirectory(uri)) {
 		switch (mpd_entity_get_type(entity)) {
 		case MPD_ENTITY_TYPE_UNKNOWN:
 			break;
 
 		case MPD_ENTITY_TYPE_DIRECTORY:
-			if (!Visit(connection, recursive, filter,
+			if (!Visit(db, recursive, filter,
 				   mpd_entity_get_directory(entity),
 				   visit_directory, visit_song, visit_playlist,
 				   error))
@@ -744,6 +1118,62 @@ ServerSupportsSearchBase(const struct mpd_connection *connection)
 #endif
 }
 
+bool
+ProxyDatabase::VisitMirror(const DatabaseSelection &selection,
+			   VisitDirectory visit_directory,
+			   VisitSong visit_song,
+			   VisitPlaylist visit_playlist,
+			   Error &error) const
+{
+	const ScopeDatabaseLock protect;
+
+	auto r = mirror_root->LookupDirectory(selection.uri.c_str());
+	if (r.uri == nullptr) {
+		/* it's a directory */
+
+		const char *after = nullptr;
+		if (!selection.after.empty()) {
+			/* resume an interrupted walk */
+			after = selection.after.c_str();
+			if (!selection.uri.empty()) {
+				after = StringAfterPrefix(after,
+							  selection.uri.c_str());
+				if (after == nullptr ||
+				    (*after != 0 && *after++ != '/'))
+					/* not inside this selection */
+					return true;
+			}
+		} else if (selection.recursive && visit_directory &&
+			   !visit_directory(r.directory->Export(r.directory->GetPath()),
+					    error))
+			return false;
+
+		return r.directory->Walk(selection.recursive, selection.filter,
+					 visit_directory, visit_song,
+					 visit_playlist,
+					 error, after);
+	}
+
+	if (strchr(r.uri, '/') == nullptr) {
+		if (!selection.after.empty())
+			/* the song has already been visited */
+			return true;
+
+		if (visit_song) {
+			const Song *song = r.directory->FindSong(r.uri);
+			if (song != nullptr) {
+				const std::string path = r.directory->GetPath();
+				const LightSong song2 = song->Export(path);
+				return !selection.Match(song2) ||
+					visit_song(song2, error);
+			}
+		}
+	}
+
+	throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
+			    "No such directory");
+}
+
 bool
 ProxyDatabase::Visit(const DatabaseSelection &selection,
 		     VisitDirectory visit_directory,
@@ -751,6 +1181,10 @@ ProxyDatabase::Visit(const DatabaseSelection &selection,
 		     VisitPlaylist visit_playlist,
 		     Error &error) const
 {
+	if (mirror_valid)
+		return VisitMirror(selection, visit_directory, visit_song,
+				   visit_playlist, error);
+
 	// TODO: eliminate the const_cast
 	const_cast<ProxyDatabase *>(this)->EnsureConnected();
 
@@ -763,7 +1197,12 @@ ProxyDatabase::Visit(const DatabaseSelection &selection,
 		return ::SearchSongs(connection, selection, visit_song, error);
 
 	/* fall back to recursive walk (slow!) */
-	return ::Visit(connection, selection.uri.c_str(),
+	AtScopeExit(this) {
+		if (!cache)
+			directory_cache.clear();
+	};
+
+	return ::Visit(*this, selection.uri.c_str(),
 		       selection.recursive, selection.filter,
 		       visit_directory, visit_song, visit_playlist,
 		       error);
@@ -772,10 +1211,14 @@ ProxyDatabase::Visit(const DatabaseSelection &selection,
 bool
 ProxyDatabase::VisitUniqueTags(const DatabaseSelection &selection,
 			       TagType tag_type,
-			       gcc_unused tag_mask_t group_mask,
+			       tag_mask_t group_mask,
 			       VisitTag visit_tag,
 			       Error &error) const
 {
+	if (mirror_valid)
+		return ::VisitUniqueTags(*this, selection, tag_type, group_mask,
+					 visit_tag, error);
+
 	// TODO: eliminate the const_cast
 	const_cast<ProxyDatabase *>(this)->EnsureConnected();
 
@@ -825,8 +1268,11 @@ ProxyDatabase::VisitUniqueTags(const DatabaseSelection &selection,
 
 bool
 ProxyDatabase::GetStats(const DatabaseSelection &selection,
-			DatabaseStats &stats, gcc_unused Error &error) const
+			DatabaseStats &stats, Error &error) const
 {
+	if (mirror_valid)
+		return ::GetStats(*this, selection, stats, error);
+
 	// TODO: match
 	(void)selection;
 
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_DATABASE_ALLOCATOR_HXX
+#define MPD_DATABASE_ALLOCATOR_HXX
+
+#include "thread/Mutex.hxx"
+#include "util/SlabAllocator.hxx"
+#include "Compiler.h"
+
+/**
+ * Allocates the #Song and #Directory objects of one #SimpleDatabase
+ * from a #SlabAllocator.  A database consists of millions of these
+ * small objects; pooling them avoids the malloc() overhead and heap
+ * fragmentation on load, update and unload.
+ *
+ * This class has its own mutex, because songs are created by the
+ * update thread (and its scan pool) without holding the #db_mutex.
+ */
+class DatabaseAllocator {
+	Mutex mutex;
+
+	SlabAllocator slab;
+
+	/**
+	 * Has BeginDiscard() been called?  Only accessed by the
+	 * thread which tears down the database.
+	 */
+	bool discarding = false;
+
+public:
+	gcc_malloc
+	void *Allocate(size_t size) {
+		const ScopeLock protect(mutex);
+		return slab.Allocate(size);
+	}
+
+	void Free(void *p, size_t size) {
+		if (discarding) {
+			/* no other thread uses this object anymore,
+			   see BeginDiscard() */
+			slab.Free(p, size);
+			return;
+		}
+
+		const ScopeLock protect(mutex);
+		slab.Free(p, size);
+	}
+
+	/**
+	 * The whole database is about to be destroyed: Free() does
+	 * not lock the mutex or maintain the free lists anymore, and
+	 * Clear() releases the remaining memory.  No other thread may
+	 * use this object after this call.
+	 */
+	void BeginDiscard() {
+		const ScopeLock protect(mutex);
+		slab.BeginDiscard();
+		discarding = true;
+	}
+
+	/**
+	 * Release all memory at once.  All objects must have been
+	 * freed already, unless BeginDiscard() has been called.
+	 */
+	void Clear() {
+		const ScopeLock protect(mutex);
+		slab.Clear();
+		discarding = false;
+	}
+};
+
+#endif
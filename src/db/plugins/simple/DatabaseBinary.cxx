@@ -0,0 +1,767 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DatabaseBinary.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/DatabaseError.hxx"
+#include "db/PlaylistVector.hxx"
+#include "fs/io/FileReader.hxx"
+#include "fs/io/MappedFile.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "fs/Charset.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagItem.hxx"
+#include "tag/TagPool.hxx"
+#include "tag/Settings.hxx"
+#include "util/StringView.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * The file consists of a #BinaryDbHeader followed by sections of
+ * fixed size records, each aligned to 8 bytes.  Records refer to
+ * strings by their index in the string table and to other records
+ * by their index.  All numbers are in host byte order; a database
+ * written on a different architecture is discarded.
+ */
+
+static constexpr char BINARY_DB_MAGIC[8] = "MPDBNDB";
+static constexpr uint32_t BINARY_DB_VERSION = 2;
+static constexpr uint32_t BINARY_DB_BYTE_ORDER = 0x01020304;
+
+/**
+ * A string index which means "no string".
+ */
+static constexpr uint32_t BINARY_DB_NO_STRING = ~uint32_t(0);
+
+/**
+ * A record index which means "no record".
+ */
+static constexpr uint32_t BINARY_DB_NO_RECORD = ~uint32_t(0);
+
+/**
+ * The location of a section within the file.
+ */
+struct BinaryDbSection {
+	uint64_t offset;
+	uint64_t count;
+};
+
+struct BinaryDbHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+
+	/**
+	 * The tag types which were enabled when the database was
+	 * written.
+	 */
+	uint64_t tag_mask;
+
+	/**
+	 * The index of the filesystem charset in the string table.
+	 */
+	uint32_t fs_charset;
+	uint32_t reserved;
+
+	/**
+	 * An array of uint32_t offsets into #string_data.
+	 */
+	BinaryDbSection strings;
+
+	/**
+	 * Null-terminated strings; #count is the size in bytes.
+	 */
+	BinaryDbSection string_data;
+
+	/**
+	 * #BinaryDbTagValue records; the distinct tag items of all
+	 * songs.
+	 */
+	BinaryDbSection tag_values;
+
+	/**
+	 * #BinaryDbDirectory records in pre-order, i.e. each parent
+	 * comes before its children; the first one is the root.
+	 */
+	BinaryDbSection directories;
+
+	/**
+	 * #BinaryDbSong records, grouped by directory.
+	 */
+	BinaryDbSection songs;
+
+	/**
+	 * An array of uint32_t indexes into #tag_values, grouped by
+	 * song.
+	 */
+	BinaryDbSection song_items;
+
+	/**
+	 * #BinaryDbPlaylist records, grouped by directory.
+	 */
+	BinaryDbSection playlists;
+
+	/**
+	 * #BinaryDbReplayGain records.
+	 */
+	BinaryDbSection replay_gains;
+};
+
+struct BinaryDbTagValue {
+	uint32_t type;
+	uint32_t value;
+};
+
+struct BinaryDbDirectory {
+	/**
+	 * The name within the parent directory (unused for the
+	 * root).
+	 */
+	uint32_t name;
+
+	uint32_t parent;
+	uint32_t device;
+	uint32_t first_song, n_songs;
+	uint32_t first_playlist, n_playlists;
+	uint32_t reserved;
+	int64_t mtime;
+};
+
+struct BinaryDbSong {
+	uint32_t uri;
+	uint32_t first_item, n_items;
+
+	/**
+	 * The duration in milliseconds; negative if unknown.
+	 */
+	int32_t duration_ms;
+
+	uint32_t start_ms, end_ms;
+	uint32_t mixramp_start, mixramp_end;
+	int64_t mtime;
+	uint32_t has_playlist;
+
+	/**
+	 * The index of a #BinaryDbReplayGain record or
+	 * #BINARY_DB_NO_RECORD.
+	 */
+	uint32_t replay_gain;
+};
+
+struct BinaryDbPlaylist {
+	uint32_t name;
+	uint32_t reserved;
+	int64_t mtime;
+};
+
+struct BinaryDbReplayGain {
+	float track_gain, track_peak;
+	float album_gain, album_peak;
+};
+
+static constexpr size_t
+AlignSection(size_t size)
+{
+	return (size + 7) & ~size_t(7);
+}
+
+gcc_pure
+static uint64_t
+GetEnabledTagMask()
+{
+	uint64_t mask = 0;
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+		if (IsTagEnabled(i))
+			mask |= uint64_t(1) << i;
+	return mask;
+}
+
+bool
+db_binary_check(Path path)
+{
+	try {
+		FileReader reader(path);
+
+		char magic[sizeof(BINARY_DB_MAGIC)];
+		return reader.Read(magic, sizeof(magic)) == sizeof(magic) &&
+			memcmp(magic, BINARY_DB_MAGIC, sizeof(magic)) == 0;
+	} catch (const std::runtime_error &) {
+		return false;
+	}
+}
+
+namespace {
+
+/**
+ * Collects the records of all sections in memory, because the
+ * header needs to know their sizes.
+ */
+class BinaryDbWriter {
+	std::vector<uint32_t> strings;
+	std::string string_data;
+
+	std::vector<BinaryDbTagValue> tag_values;
+
+	/**
+	 * Maps the type (as the first character) and the value of a
+	 * tag item to its index in #tag_values.
+	 */
+	std::unordered_map<std::string, uint32_t> tag_value_map;
+
+	std::vector<BinaryDbDirectory> directories;
+	std::vector<BinaryDbSong> songs;
+	std::vector<uint32_t> song_items;
+	std::vector<BinaryDbPlaylist> playlists;
+	std::vector<BinaryDbReplayGain> replay_gains;
+
+public:
+	void AddDirectory(const Directory &directory, uint32_t parent);
+
+	void Write(BufferedOutputStream &os) const;
+
+private:
+	uint32_t AddString(const char *s);
+
+	uint32_t AddOptionalString(const char *s) {
+		return s != nullptr ? AddString(s) : BINARY_DB_NO_STRING;
+	}
+
+	uint32_t AddTagValue(const TagItem &item);
+
+	uint32_t AddReplayGain(const ReplayGainInfo &info);
+
+	void AddSong(const Song &song);
+};
+
+uint32_t
+BinaryDbWriter::AddString(const char *s)
+{
+	const size_t offset = string_data.size();
+	if (offset > UINT32_MAX || strings.size() >= BINARY_DB_NO_STRING)
+		throw std::runtime_error("Database too large");
+
+	string_data.append(s);
+	string_data.push_back(0);
+
+	strings.push_back(offset);
+	return strings.size() - 1;
+}
+
+uint32_t
+BinaryDbWriter::AddTagValue(const TagItem &item)
+{
+	std::string key(1, char(item.type));
+	key.append(item.value);
+
+	auto i = tag_value_map.find(key);
+	if (i != tag_value_map.end())
+		return i->second;
+
+	const uint32_t index = tag_values.size();
+	tag_values.push_back({uint32_t(item.type), AddString(item.value)});
+	tag_value_map.emplace(std::move(key), index);
+	return index;
+}
+
+uint32_t
+BinaryDbWriter::AddReplayGain(const ReplayGainInfo &info)
+{
+	const auto &track = info.tuples[REPLAY_GAIN_TRACK];
+	const auto &album = info.tuples[REPLAY_GAIN_ALBUM];
+
+	BinaryDbReplayGain r;
+	r.track_gain = track.gain;
+	r.track_peak = track.peak;
+	r.album_gain = album.gain;
+	r.album_peak = album.peak;
+	replay_gains.push_back(r);
+	return replay_gains.size() - 1;
+}
+
+void
+BinaryDbWriter::AddSong(const Song &song)
+{
+	BinaryDbSong s;
+	memset(&s, 0, sizeof(s));
+	s.uri = AddString(song.uri);
+	s.first_item = song_items.size();
+	s.n_items = song.tag.num_items;
+	s.duration_ms = song.tag.duration.IsNegative()
+		? -1
+		: int32_t(song.tag.duration.ToMS());
+	s.start_ms = song.start_time.ToMS();
+	s.end_ms = song.end_time.ToMS();
+	if (song.mix_ramp) {
+		s.mixramp_start = AddOptionalString(song.mix_ramp->GetStart());
+		s.mixramp_end = AddOptionalString(song.mix_ramp->GetEnd());
+	} else
+		s.mixramp_start = s.mixramp_end = BINARY_DB_NO_STRING;
+	s.mtime = song.mtime;
+	s.has_playlist = song.tag.has_playlist;
+	s.replay_gain = song.replay_gain
+		? AddReplayGain(*song.replay_gain)
+		: BINARY_DB_NO_RECORD;
+
+	for (const auto &item : song.tag)
+		song_items.push_back(AddTagValue(item));
+
+	songs.push_back(s);
+}
+
+void
+BinaryDbWriter::AddDirectory(const Directory &directory, uint32_t parent)
+{
+	const uint32_t index = directories.size();
+
+	BinaryDbDirectory d;
+	memset(&d, 0, sizeof(d));
+	d.name = directory.IsRoot()
+		? BINARY_DB_NO_STRING
+		: AddString(directory.GetName());
+	d.parent = parent;
+	if (directory.device == DEVICE_INARCHIVE ||
+	    directory.device == DEVICE_CONTAINER)
+		d.device = directory.device;
+	d.mtime = directory.mtime;
+
+	d.first_song = songs.size();
+	for (const auto &song : directory.songs)
+		AddSong(song);
+	d.n_songs = songs.size() - d.first_song;
+
+	d.first_playlist = playlists.size();
+	for (const PlaylistInfo &pi : directory.playlists) {
+		BinaryDbPlaylist p;
+		memset(&p, 0, sizeof(p));
+		p.name = AddString(pi.name.c_str());
+		p.mtime = pi.mtime;
+		playlists.push_back(p);
+	}
+	d.n_playlists = playlists.size() - d.first_playlist;
+
+	directories.push_back(d);
+
+	for (const auto &child : directory.children)
+		/* mount points are restored by the storage
+		   configuration */
+		if (!child.IsMount())
+			AddDirectory(child, index);
+}
+
+template<typename T>
+static void
+WriteSection(BufferedOutputStream &os, const std::vector<T> &v)
+{
+	static constexpr uint8_t padding[8] = {};
+
+	const size_t size = v.size() * sizeof(T);
+	if (size > 0)
+		os.Write(&v.front(), size);
+	os.Write(padding, AlignSection(size) - size);
+}
+
+void
+BinaryDbWriter::Write(BufferedOutputStream &os) const
+{
+	BinaryDbHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BINARY_DB_MAGIC, sizeof(header.magic));
+	header.version = BINARY_DB_VERSION;
+	header.byte_order = BINARY_DB_BYTE_ORDER;
+	header.tag_mask = GetEnabledTagMask();
+
+	/* the charset is appended to the string table here, which
+	   is why this method works on a copy of it */
+	std::vector<uint32_t> strings2(strings);
+	std::string string_data2(string_data);
+	header.fs_charset = strings2.size();
+	strings2.push_back(string_data2.size());
+	string_data2.append(GetFSCharset());
+	string_data2.push_back(0);
+
+	uint64_t offset = AlignSection(sizeof(header));
+	auto add = [&offset](BinaryDbSection &section,
+			     size_t count, size_t record_size){
+		section.offset = offset;
+		section.count = count;
+		offset += AlignSection(count * record_size);
+	};
+
+	add(header.strings, strings2.size(), sizeof(uint32_t));
+	add(header.string_data, string_data2.size(), 1);
+	add(header.tag_values, tag_values.size(), sizeof(BinaryDbTagValue));
+	add(header.directories, directories.size(),
+	    sizeof(BinaryDbDirectory));
+	add(header.songs, songs.size(), sizeof(BinaryDbSong));
+	add(header.song_items, song_items.size(), sizeof(uint32_t));
+	add(header.playlists, playlists.size(), sizeof(BinaryDbPlaylist));
+	add(header.replay_gains, replay_gains.size(),
+	    sizeof(BinaryDbReplayGain));
+
+	static constexpr uint8_t padding[8] = {};
+	os.Write(&header, sizeof(header));
+	os.Write(padding, AlignSection(sizeof(header)) - sizeof(header));
+
+	WriteSection(os, strings2);
+	os.Write(string_data2.data(), string_data2.size());
+	os.Write(padding,
+		 AlignSection(string_data2.size()) - string_data2.size());
+	WriteSection(os, tag_values);
+	WriteSection(os, directories);
+	WriteSection(os, songs);
+	WriteSection(os, song_items);
+	WriteSection(os, playlists);
+	WriteSection(os, replay_gains);
+}
+
+class BinaryDbLoader {
+	const uint8_t *const data;
+	const size_t size;
+
+	const BinaryDbHeader &header;
+
+	const uint32_t *strings;
+	const char *string_data;
+	const BinaryDbTagValue *tag_values;
+	const BinaryDbDirectory *directories;
+	const BinaryDbSong *songs;
+	const uint32_t *song_items;
+	const BinaryDbPlaylist *playlists;
+	const BinaryDbReplayGain *replay_gains;
+
+	/**
+	 * The pooled #TagItem for each entry of #tag_values; nullptr
+	 * until it is first used.  Each one holds a reference which
+	 * is released by the destructor.
+	 */
+	std::vector<TagItem *> tag_items;
+
+public:
+	BinaryDbLoader(const uint8_t *_data, size_t _size)
+		:data(_data), size(_size),
+		 header(*(const BinaryDbHeader *)data) {}
+
+	~BinaryDbLoader();
+
+	bool Load(Directory &music_root, Error &error);
+
+private:
+	template<typename T>
+	bool CheckSection(const BinaryDbSection &section, const T *&p) const;
+
+	gcc_pure
+	const char *GetString(uint32_t i) const {
+		return i < header.strings.count
+			? string_data + strings[i]
+			: nullptr;
+	}
+
+	bool CheckHeader(Error &error);
+
+	TagItem *GetTagItem(uint32_t i);
+
+	bool LoadSong(const BinaryDbSong &s, Directory &directory);
+	bool LoadDirectory(const BinaryDbDirectory &d, Directory &directory);
+};
+
+BinaryDbLoader::~BinaryDbLoader()
+{
+	for (auto i : tag_items)
+		if (i != nullptr)
+			tag_pool_put_item(i);
+}
+
+template<typename T>
+bool
+BinaryDbLoader::CheckSection(const BinaryDbSection &section,
+			     const T *&p) const
+{
+	if (section.offset % 8 != 0 || section.offset > size ||
+	    section.count > (size - section.offset) / sizeof(T))
+		return false;
+
+	p = (const T *)(data + section.offset);
+	return true;
+}
+
+bool
+BinaryDbLoader::CheckHeader(Error &error)
+{
+	if (memcmp(header.magic, BINARY_DB_MAGIC, sizeof(header.magic)) != 0 ||
+	    header.version != BINARY_DB_VERSION ||
+	    header.byte_order != BINARY_DB_BYTE_ORDER) {
+		error.Set(db_domain,
+			  "Database format mismatch, "
+			  "discarding database file");
+		return false;
+	}
+
+	if (!CheckSection(header.strings, strings) ||
+	    !CheckSection(header.string_data, string_data) ||
+	    !CheckSection(header.tag_values, tag_values) ||
+	    !CheckSection(header.directories, directories) ||
+	    !CheckSection(header.songs, songs) ||
+	    !CheckSection(header.song_items, song_items) ||
+	    !CheckSection(header.playlists, playlists) ||
+	    !CheckSection(header.replay_gains, replay_gains) ||
+	    header.string_data.count == 0 ||
+	    string_data[header.string_data.count - 1] != 0 ||
+	    header.directories.count == 0) {
+		error.Set(db_domain, "Database corrupted");
+		return false;
+	}
+
+	/* with a null terminator at the end of the string data,
+	   all strings are properly terminated */
+	for (uint64_t i = 0; i < header.strings.count; ++i) {
+		if (strings[i] >= header.string_data.count) {
+			error.Set(db_domain, "Database corrupted");
+			return false;
+		}
+	}
+
+	const char *new_charset = GetString(header.fs_charset);
+	const char *const old_charset = GetFSCharset();
+	if (new_charset == nullptr ||
+	    (*old_charset != 0 && strcmp(new_charset, old_charset) != 0)) {
+		error.Format(db_domain,
+			     "Existing database has charset "
+			     "\"%s\" instead of \"%s\"; "
+			     "discarding database file",
+			     new_charset != nullptr ? new_charset : "",
+			     old_charset);
+		return false;
+	}
+
+	if ((GetEnabledTagMask() & ~header.tag_mask) != 0) {
+		error.Set(db_domain,
+			  "Tag list mismatch, "
+			  "discarding database file");
+		return false;
+	}
+
+	tag_items.resize(header.tag_values.count, nullptr);
+	return true;
+}
+
+TagItem *
+BinaryDbLoader::GetTagItem(uint32_t i)
+{
+	if (i >= header.tag_values.count)
+		return nullptr;
+
+	TagItem *&item = tag_items[i];
+	if (item == nullptr) {
+		const BinaryDbTagValue &v = tag_values[i];
+		const char *value = GetString(v.value);
+		if (value == nullptr || v.type >= TAG_NUM_OF_ITEM_TYPES)
+			return nullptr;
+
+		item = tag_pool_get_item(TagType(v.type), value);
+	}
+
+	return tag_pool_dup_item(item);
+}
+
+bool
+BinaryDbLoader::LoadSong(const BinaryDbSong &s, Directory &directory)
+{
+	const char *uri = GetString(s.uri);
+	if (uri == nullptr || *uri == 0 ||
+	    s.first_item > header.song_items.count ||
+	    s.n_items > header.song_items.count - s.first_item ||
+	    s.n_items > UINT16_MAX)
+		return false;
+
+	Song *song = Song::NewFile(uri, directory);
+
+	song->mtime = s.mtime;
+	song->start_time = SongTime::FromMS(s.start_ms);
+	song->end_time = SongTime::FromMS(s.end_ms);
+
+	MixRampInfo mix_ramp;
+
+	if (s.mixramp_start != BINARY_DB_NO_STRING) {
+		const char *value = GetString(s.mixramp_start);
+		if (value == nullptr) {
+			song->Free();
+			return false;
+		}
+
+		mix_ramp.SetStart(value);
+	}
+
+	if (s.mixramp_end != BINARY_DB_NO_STRING) {
+		const char *value = GetString(s.mixramp_end);
+		if (value == nullptr) {
+			song->Free();
+			return false;
+		}
+
+		mix_ramp.SetEnd(value);
+	}
+
+	song->SetMixRamp(std::move(mix_ramp));
+
+	if (s.replay_gain != BINARY_DB_NO_RECORD) {
+		if (s.replay_gain >= header.replay_gains.count) {
+			song->Free();
+			return false;
+		}
+
+		const BinaryDbReplayGain &r = replay_gains[s.replay_gain];
+		ReplayGainInfo info;
+		info.tuples[REPLAY_GAIN_TRACK].gain = r.track_gain;
+		info.tuples[REPLAY_GAIN_TRACK].peak = r.track_peak;
+		info.tuples[REPLAY_GAIN_ALBUM].gain = r.album_gain;
+		info.tuples[REPLAY_GAIN_ALBUM].peak = r.album_peak;
+		song->SetReplayGain(info);
+	}
+
+	Tag &tag = song->tag;
+	if (s.duration_ms >= 0)
+		tag.duration = SignedSongTime::FromMS(s.duration_ms);
+	tag.has_playlist = s.has_playlist != 0;
+
+	if (s.n_items > 0) {
+		tag.items = Tag::AllocItems(s.n_items);
+
+		for (uint32_t i = 0; i < s.n_items; ++i) {
+			TagItem *item =
+				GetTagItem(song_items[s.first_item + i]);
+			if (item == nullptr) {
+				song->Free();
+				return false;
+			}
+
+			tag.items[tag.num_items++] = item;
+		}
+	}
+
+	/* add it only now, because Directory::AddSong() indexes
+	   the tag */
+	directory.AddSong(song);
+	return true;
+}
+
+bool
+BinaryDbLoader::LoadDirectory(const BinaryDbDirectory &d,
+			      Directory &directory)
+{
+	directory.mtime = d.mtime;
+	directory.device = d.device;
+
+	if (d.first_song > header.songs.count ||
+	    d.n_songs > header.songs.count - d.first_song ||
+	    d.first_playlist > header.playlists.count ||
+	    d.n_playlists > header.playlists.count - d.first_playlist)
+		return false;
+
+	for (uint32_t i = 0; i < d.n_songs; ++i)
+		if (!LoadSong(songs[d.first_song + i], directory))
+			return false;
+
+	for (uint32_t i = 0; i < d.n_playlists; ++i) {
+		const BinaryDbPlaylist &p = playlists[d.first_playlist + i];
+		const char *name = GetString(p.name);
+		if (name == nullptr)
+			return false;
+
+		directory.playlists.push_back(PlaylistInfo(name, p.mtime));
+	}
+
+	return true;
+}
+
+bool
+BinaryDbLoader::Load(Directory &music_root, Error &error)
+{
+	if (!CheckHeader(error))
+		return false;
+
+	LogDebug(db_domain, "reading DB");
+
+	const ScopeDatabaseLock protect;
+
+	const size_t n_directories = header.directories.count;
+	std::unique_ptr<Directory *[]> map(new Directory *[n_directories]);
+	map[0] = &music_root;
+
+	for (size_t i = 0; i < n_directories; ++i) {
+		const BinaryDbDirectory &d = directories[i];
+
+		if (i > 0) {
+			const char *name = GetString(d.name);
+			if (d.parent >= i || name == nullptr || *name == 0) {
+				error.Set(db_domain, "Database corrupted");
+				return false;
+			}
+
+			map[i] = map[d.parent]->CreateChild(name);
+		}
+
+		if (!LoadDirectory(d, *map[i])) {
+			error.Set(db_domain, "Database corrupted");
+			return false;
+		}
+	}
+
+	return true;
+}
+
+}
+
+void
+db_save_binary(BufferedOutputStream &os, const Directory &music_root)
+{
+	BinaryDbWriter writer;
+
+	{
+		const ScopeDatabaseLock protect;
+		writer.AddDirectory(music_root, BINARY_DB_NO_STRING);
+	}
+
+	writer.Write(os);
+}
+
+bool
+db_load_binary(Path path, Directory &music_root, Error &error)
+{
+	const MappedFile file(path, true);
+	if (file.GetSize() < sizeof(BinaryDbHeader)) {
+		error.Set(db_domain, "Database corrupted");
+		return false;
+	}
+
+	BinaryDbLoader loader(file.GetData(), file.GetSize());
+	return loader.Load(music_root, error);
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_DATABASE_BINARY_HXX
+#define MPD_DATABASE_BINARY_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+struct Directory;
+class BufferedOutputStream;
+class Path;
+class Error;
+
+/**
+ * Does the file contain a database in the binary format?
+ */
+gcc_pure
+bool
+db_binary_check(Path path);
+
+/**
+ * Write the database in the binary format.  Unlike the text format,
+ * all strings are collected in one table and each song is a fixed
+ * size record, so the file can be mapped into memory and loaded
+ * without parsing.
+ *
+ * Throws std::runtime_error on error.
+ */
+void
+db_save_binary(BufferedOutputStream &os, const Directory &music_root);
+
+bool
+db_load_binary(Path path, Directory &music_root, Error &error);
+
+#endif
@@ -0,0 +1,279 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "DatabaseJournal.hxx"
+#include "DirectorySave.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "SongSave.hxx"
+#include "DetachedSong.hxx"
+#include "PlaylistDatabase.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/DatabaseError.hxx"
+#include "fs/io/TextFile.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "fs/Path.hxx"
+#include "util/StringCompare.hxx"
+#include "util/Error.hxx"
+
+#include <set>
+#include <string>
+
+#include <assert.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define JOURNAL_FORMAT_PREFIX "mpd_journal: "
+#define JOURNAL_SNAPSHOT "snapshot: "
+#define JOURNAL_BEGIN "transaction_begin"
+#define JOURNAL_END "transaction_end"
+#define JOURNAL_UPDATE "update: /"
+#define JOURNAL_UPDATE_END "update_end"
+#define JOURNAL_CHILD "child: "
+
+static constexpr unsigned JOURNAL_FORMAT = 1;
+
+void
+db_journal_begin(BufferedOutputStream &os, const char *snapshot)
+{
+	os.Format(JOURNAL_FORMAT_PREFIX "%u\n", JOURNAL_FORMAT);
+	os.Format(JOURNAL_SNAPSHOT "%s\n", snapshot);
+}
+
+static void
+journal_save_directory(BufferedOutputStream &os, const Directory &directory)
+{
+	os.Format(JOURNAL_UPDATE "%s\n", directory.GetPath().c_str());
+	directory_save_attributes(os, directory);
+
+	for (const auto &child : directory.children)
+		if (!child.IsMount())
+			os.Format(JOURNAL_CHILD "%s\n", child.GetName());
+
+	for (const auto &song : directory.songs)
+		song_save(os, song);
+
+	playlist_vector_save(os, directory.playlists);
+
+	os.Format("%s\n", JOURNAL_UPDATE_END);
+}
+
+static unsigned
+journal_save_modified(BufferedOutputStream &os, Directory &directory)
+{
+	unsigned n = 0;
+
+	if (!directory.IsMount()) {
+		if (directory.modified) {
+			journal_save_directory(os, directory);
+			++n;
+		}
+
+		if (directory.modified_below)
+			for (auto &child : directory.children)
+				n += journal_save_modified(os, child);
+	}
+
+	directory.modified = directory.modified_below = false;
+	return n;
+}
+
+unsigned
+db_journal_save(BufferedOutputStream &os, Directory &root)
+{
+	assert(holding_db_lock());
+
+	os.Format("%s\n", JOURNAL_BEGIN);
+	unsigned n = journal_save_modified(os, root);
+	os.Format("%s\n", JOURNAL_END);
+	return n;
+}
+
+/**
+ * Look up a directory by its path, and create all missing path
+ * segments.
+ */
+static Directory &
+journal_make_directory(Directory &root, const char *path)
+{
+	Directory *directory = &root;
+
+	while (*path != 0) {
+		const char *slash = strchr(path, '/');
+		const std::string name = slash != nullptr
+			? std::string(path, slash)
+			: std::string(path);
+
+		directory = directory->MakeChild(name.c_str());
+		if (slash == nullptr)
+			break;
+
+		path = slash + 1;
+	}
+
+	return *directory;
+}
+
+static bool
+journal_load_update(TextFile &file, Directory &root, const char *path,
+		    Error &error)
+{
+	Directory &directory = journal_make_directory(root, path);
+
+	/* the record replaces the previous contents */
+	directory.ClearSongs();
+	directory.playlists.clear();
+	directory.mtime = 0;
+	directory.device = 0;
+
+	std::set<std::string> children;
+
+	const char *line;
+	while ((line = file.ReadLine()) != nullptr &&
+	       strcmp(line, JOURNAL_UPDATE_END) != 0) {
+		const char *p;
+		if ((p = StringAfterPrefix(line, JOURNAL_CHILD))) {
+			children.emplace(p);
+		} else if ((p = StringAfterPrefix(line, SONG_BEGIN))) {
+			DetachedSong *song = song_load(file, p, error);
+			if (song == nullptr)
+				return false;
+
+			directory.AddSong(Song::NewFrom(std::move(*song),
+							directory));
+			delete song;
+		} else if ((p = StringAfterPrefix(line, PLAYLIST_META_BEGIN))) {
+			if (!playlist_metadata_load(file, directory.playlists,
+						    p, error))
+				return false;
+		} else if (!directory_parse_attribute(directory, line)) {
+			error.Format(db_domain,
+				     "Malformed journal line: %s", line);
+			return false;
+		}
+	}
+
+	if (line == nullptr) {
+		error.Set(db_domain, "Unexpected end of journal");
+		return false;
+	}
+
+	directory.ForEachChildSafe([&children](Directory &child){
+			if (children.find(child.GetName()) == children.end())
+				child.Delete();
+		});
+
+	for (const auto &name : children)
+		directory.MakeChild(name.c_str());
+
+	return true;
+}
+
+static bool
+journal_load_transaction(TextFile &file, Directory &root, Error &error)
+{
+	const char *line = file.ReadLine();
+	if (line == nullptr || strcmp(line, JOURNAL_BEGIN) != 0) {
+		error.Set(db_domain, "Journal corrupted");
+		return false;
+	}
+
+	while ((line = file.ReadLine()) != nullptr &&
+	       strcmp(line, JOURNAL_END) != 0) {
+		const char *p = StringAfterPrefix(line, JOURNAL_UPDATE);
+		if (p == nullptr) {
+			error.Format(db_domain,
+				     "Malformed journal line: %s", line);
+			return false;
+		}
+
+		if (!journal_load_update(file, root, p, error))
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Check the journal header.
+ *
+ * @return true if the journal belongs to the given snapshot
+ */
+static bool
+journal_load_header(TextFile &file, const char *snapshot)
+{
+	const char *line = file.ReadLine();
+	const char *p;
+	if (line == nullptr ||
+	    (p = StringAfterPrefix(line, JOURNAL_FORMAT_PREFIX)) == nullptr ||
+	    unsigned(atoi(p)) != JOURNAL_FORMAT)
+		return false;
+
+	line = file.ReadLine();
+	return line != nullptr &&
+		(p = StringAfterPrefix(line, JOURNAL_SNAPSHOT)) != nullptr &&
+		strcmp(p, snapshot) == 0;
+}
+
+bool
+db_journal_load(Path path, const char *snapshot, Directory &root,
+		bool &clean_r, Error &error)
+{
+	/* first pass: count the complete transactions; a crash while
+	   appending may have left an incomplete one at the end,
+	   which must not be applied */
+	unsigned n_complete = 0;
+
+	{
+		TextFile file(path);
+		if (!journal_load_header(file, snapshot)) {
+			clean_r = false;
+			return true;
+		}
+
+		clean_r = true;
+
+		const char *line;
+		while ((line = file.ReadLine()) != nullptr) {
+			if (strcmp(line, JOURNAL_END) == 0) {
+				++n_complete;
+				clean_r = true;
+			} else
+				clean_r = false;
+		}
+	}
+
+	if (n_complete == 0)
+		return true;
+
+	/* second pass: apply them */
+
+	TextFile file(path);
+	journal_load_header(file, snapshot);
+
+	const ScopeDatabaseLock protect;
+
+	for (unsigned i = 0; i < n_complete; ++i)
+		if (!journal_load_transaction(file, root, error))
+			return false;
+
+	root.Sort();
+	return true;
+}
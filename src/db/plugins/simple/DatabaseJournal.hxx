@@ -0,0 +1,71 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_DATABASE_JOURNAL_HXX
+#define MPD_DATABASE_JOURNAL_HXX
+
+struct Directory;
+class BufferedOutputStream;
+class Path;
+class Error;
+
+/*
+ * The journal is an append-only text file next to the database
+ * file.  Each save after a database update appends one transaction
+ * which contains a complete copy of each modified directory (but not
+ * its sub directories).  Replaying the journal on top of the
+ * database file it belongs to yields the current database.
+ */
+
+/**
+ * Write the header of a new (empty) journal.
+ *
+ * @param snapshot a string which identifies the database file this
+ * journal belongs to
+ */
+void
+db_journal_begin(BufferedOutputStream &os, const char *snapshot);
+
+/**
+ * Append one transaction with all directories which were modified
+ * since the last save, and clear their "modified" flags.
+ *
+ * Caller must lock the #db_mutex.
+ *
+ * @return the number of directories which were written
+ */
+unsigned
+db_journal_save(BufferedOutputStream &os, Directory &root);
+
+/**
+ * Apply all complete transactions from the journal file.
+ *
+ * @param snapshot identifies the database file which was loaded
+ * into #root; if the journal belongs to a different one, it is
+ * ignored
+ * @param clean_r is set to false if the journal was ignored or if
+ * it ends with an incomplete transaction; in that case, the caller
+ * must not append to it
+ * @return false on error (the #root may be partially modified then)
+ */
+bool
+db_journal_load(Path path, const char *snapshot, Directory &root,
+		bool &clean_r, Error &error);
+
+#endif
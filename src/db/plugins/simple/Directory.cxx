@@ -22,37 +22,134 @@
 #include "SongSort.hxx"
 #include "Song.hxx"
 #include "Mount.hxx"
+#include "TagIndex.hxx"
+#include "DatabaseAllocator.hxx"
 #include "db/LightDirectory.hxx"
 #include "db/LightSong.hxx"
 #include "db/Uri.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/Interface.hxx"
 #include "SongFilter.hxx"
+#include "tag/TagBuilder.hxx"
 #include "lib/icu/Collate.hxx"
-#include "fs/Traits.hxx"
 #include "util/Alloc.hxx"
-#include "util/DeleteDisposer.hxx"
 #include "util/Error.hxx"
+#include "util/MemStats.hxx"
+
+#include <algorithm>
+#include <unordered_map>
+#include <new>
 
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 
-Directory::Directory(std::string &&_path_utf8, Directory *_parent)
+/**
+ * FNV-1a hash of a null-terminated string.
+ */
+struct DirectoryNameHash {
+	gcc_pure
+	size_t operator()(const char *s) const {
+		size_t hash = 2166136261u;
+		for (; *s != 0; ++s)
+			hash = (hash ^ (unsigned char)*s) * 16777619u;
+		return hash;
+	}
+};
+
+struct DirectoryNameEqual {
+	gcc_pure
+	bool operator()(const char *a, const char *b) const {
+		return strcmp(a, b) == 0;
+	}
+};
+
+/**
+ * The keys point to the name of the child directory, i.e. into its
+ * #Directory::path attribute.
+ */
+struct Directory::ChildIndex
+	: std::unordered_map<const char *, Directory *,
+			     DirectoryNameHash, DirectoryNameEqual> {};
+
+/**
+ * The keys point to #Song::uri.
+ */
+struct Directory::SongIndex
+	: std::unordered_map<const char *, Song *,
+			     DirectoryNameHash, DirectoryNameEqual> {};
+
+Directory::Directory(std::string &&_name_utf8, Directory *_parent,
+		     TagIndex *_tag_index,
+		     DatabaseAllocator *_allocator)
 	:parent(_parent),
 	 mtime(0),
 	 inode(0), device(0),
-	 path(std::move(_path_utf8)),
-	 mounted_database(nullptr)
+	 name(std::move(_name_utf8)),
+	 mounted_database(nullptr),
+	 tag_index(_parent != nullptr ? _parent->tag_index : _tag_index),
+	 allocator(_parent != nullptr ? _parent->allocator : _allocator),
+	 modified(false), modified_below(false)
 {
+	MarkModified();
+
+	if (parent != nullptr)
+		parent->modified = true;
+
+	MemStatsAllocate(MemStatsCategory::DIRECTORY,
+			 sizeof(*this) + name.length());
 }
 
 Directory::~Directory()
 {
+	MemStatsFree(MemStatsCategory::DIRECTORY,
+		     sizeof(*this) + name.length());
+
 	delete mounted_database;
 
+	if (tag_index != nullptr)
+		for (const auto &song : songs)
+			tag_index->Remove(song);
+
 	songs.clear_and_dispose(Song::Disposer());
-	children.clear_and_dispose(DeleteDisposer());
+	children.clear_and_dispose(Disposer());
+}
+
+void
+Directory::Free()
+{
+	assert(parent != nullptr);
+
+	DatabaseAllocator *const a = allocator;
+	this->~Directory();
+
+	if (a != nullptr)
+		a->Free(this, sizeof(*this));
+	else
+		::operator delete(this);
+}
+
+void
+Directory::MarkModified()
+{
+	modified = true;
+
+	for (Directory *p = parent; p != nullptr && !p->modified_below;
+	     p = p->parent)
+		p->modified_below = true;
+}
+
+void
+Directory::ClearModified()
+{
+	if (!modified && !modified_below)
+		return;
+
+	if (modified_below)
+		for (auto &child : children)
+			child.ClearModified();
+
+	modified = modified_below = false;
 }
 
 void
@@ -61,16 +158,41 @@ Directory::Delete()
 	assert(holding_db_lock());
 	assert(parent != nullptr);
 
+	parent->MarkModified();
+
+	if (parent->child_index)
+		parent->child_index->erase(GetName());
+
 	parent->children.erase_and_dispose(parent->children.iterator_to(*this),
-					   DeleteDisposer());
+					   Disposer());
 }
 
-const char *
-Directory::GetName() const
+std::string
+Directory::GetPath() const
 {
-	assert(!IsRoot());
+	if (IsRoot())
+		return std::string();
+
+	size_t length = name.length();
+	for (const Directory *d = parent; !d->IsRoot(); d = d->parent)
+		length += d->name.length() + 1;
+
+	/* fill the string from the end; the separators are
+	   already there */
+	std::string result(length, '/');
+	char *p = &result.front() + length;
+	for (const Directory *d = this;; d = d->parent) {
+		p -= d->name.length();
+		memcpy(p, d->name.data(), d->name.length());
+
+		if (d->parent->IsRoot())
+			break;
 
-	return PathTraitsUTF8::GetBase(path.c_str());
+		--p;
+	}
+
+	assert(p == result.data());
+	return result;
 }
 
 Directory *
@@ -80,24 +202,46 @@ Directory::CreateChild(const char *name_utf8)
 	assert(name_utf8 != nullptr);
 	assert(*name_utf8 != 0);
 
-	std::string path_utf8 = IsRoot()
-		? std::string(name_utf8)
-		: PathTraitsUTF8::Build(GetPath(), name_utf8);
-
-	Directory *child = new Directory(std::move(path_utf8), this);
+	void *p = allocator != nullptr
+		? allocator->Allocate(sizeof(Directory))
+		: ::operator new(sizeof(Directory));
+	Directory *child = ::new(p) Directory(std::string(name_utf8), this);
 	children.push_back(*child);
+
+	if (child_index)
+		child_index->emplace(child->GetName(), child);
+
 	return child;
 }
 
 const Directory *
-Directory::FindChild(const char *name) const
+Directory::FindChild(const char *name_utf8) const
 {
 	assert(holding_db_lock());
 
-	for (const auto &child : children)
-		if (strcmp(child.GetName(), name) == 0)
+	if (child_index) {
+		auto i = child_index->find(name_utf8);
+		return i != child_index->end() ? i->second : nullptr;
+	}
+
+	unsigned n = 0;
+	for (const auto &child : children) {
+		if (strcmp(child.GetName(), name_utf8) == 0)
 			return &child;
 
+		++n;
+	}
+
+	if (n < INDEX_THRESHOLD)
+		return nullptr;
+
+	/* this directory is large; build an index for the next
+	   lookups */
+	child_index.reset(new ChildIndex());
+	child_index->reserve(n);
+	for (auto &child : const_cast<Directory *>(this)->children)
+		child_index->emplace(child.GetName(), &child);
+
 	return nullptr;
 }
 
@@ -110,10 +254,14 @@ Directory::PruneEmpty()
 	     child != end;) {
 		child->PruneEmpty();
 
-		if (child->IsEmpty())
+		if (child->IsEmpty()) {
+			if (child_index)
+				child_index->erase(child->GetName());
+
 			child = children.erase_and_dispose(child,
-							   DeleteDisposer());
-		else
+							   Disposer());
+			MarkModified();
+		} else
 			++child;
 	}
 }
@@ -127,18 +275,18 @@ Directory::LookupDirectory(const char *uri)
 	if (isRootDirectory(uri))
 		return { this, nullptr };
 
-	char *duplicated = xstrdup(uri), *name = duplicated;
+	char *duplicated = xstrdup(uri), *component = duplicated;
 
 	Directory *d = this;
 	while (true) {
-		char *slash = strchr(name, '/');
-		if (slash == name)
+		char *slash = strchr(component, '/');
+		if (slash == component)
 			break;
 
 		if (slash != nullptr)
 			*slash = '\0';
 
-		Directory *tmp = d->FindChild(name);
+		Directory *tmp = d->FindChild(component);
 		if (tmp == nullptr)
 			/* not found */
 			break;
@@ -147,18 +295,18 @@ Directory::LookupDirectory(const char *uri)
 
 		if (slash == nullptr) {
 			/* found everything */
-			name = nullptr;
+			component = nullptr;
 			break;
 		}
 
-		name = slash + 1;
+		component = slash + 1;
 	}
 
 	free(duplicated);
 
-	const char *rest = name == nullptr
+	const char *rest = component == nullptr
 		? nullptr
-		: uri + (name - duplicated);
+		: uri + (component - duplicated);
 
 	return { d, rest };
 }
@@ -171,6 +319,14 @@ Directory::AddSong(Song *song)
 	assert(song->parent == this);
 
 	songs.push_back(*song);
+
+	if (tag_index != nullptr)
+		tag_index->Add(*song);
+
+	if (song_index)
+		song_index->emplace(song->uri, song);
+
+	MarkModified();
 }
 
 void
@@ -180,7 +336,51 @@ Directory::RemoveSong(Song *song)
 	assert(song != nullptr);
 	assert(song->parent == this);
 
+	if (song_index)
+		song_index->erase(song->uri);
+
+	if (tag_index != nullptr)
+		tag_index->Remove(*song);
+
 	songs.erase(songs.iterator_to(*song));
+	MarkModified();
+}
+
+void
+Directory::ClearSongs()
+{
+	assert(holding_db_lock());
+
+	song_index.reset();
+
+	if (tag_index != nullptr)
+		for (const auto &song : songs)
+			tag_index->Remove(song);
+
+	songs.clear_and_dispose(Song::Disposer());
+	MarkModified();
+}
+
+void
+Directory::CommitSongTag(Song &song, TagBuilder &tag)
+{
+	assert(holding_db_lock());
+	assert(song.parent == this);
+
+	/* a new song which was not yet added is not in the index */
+	const bool linked = FindSong(song.uri) == &song;
+
+	if (linked && tag_index != nullptr)
+		tag_index->Remove(song);
+
+	tag.Commit(song.tag);
+
+	if (linked) {
+		if (tag_index != nullptr)
+			tag_index->Add(song);
+
+		MarkModified();
+	}
 }
 
 const Song *
@@ -189,13 +389,31 @@ Directory::FindSong(const char *name_utf8) const
 	assert(holding_db_lock());
 	assert(name_utf8 != nullptr);
 
+	if (song_index) {
+		auto i = song_index->find(name_utf8);
+		return i != song_index->end() ? i->second : nullptr;
+	}
+
+	unsigned n = 0;
 	for (auto &song : songs) {
 		assert(song.parent == this);
 
 		if (strcmp(song.uri, name_utf8) == 0)
 			return &song;
+
+		++n;
 	}
 
+	if (n < INDEX_THRESHOLD)
+		return nullptr;
+
+	/* this directory is large; build an index for the next
+	   lookups */
+	song_index.reset(new SongIndex());
+	song_index->reserve(n);
+	for (auto &song : const_cast<Directory *>(this)->songs)
+		song_index->emplace(song.uri, &song);
+
 	return nullptr;
 }
 
@@ -203,7 +421,9 @@ gcc_pure
 static bool
 directory_cmp(const Directory &a, const Directory &b)
 {
-	return IcuCollate(a.path.c_str(), b.path.c_str()) < 0;
+	/* all siblings have the same parent path, so comparing
+	   the names is enough */
+	return IcuCollate(a.GetName(), b.GetName()) < 0;
 }
 
 void
@@ -218,11 +438,27 @@ Directory::Sort()
 		child.Sort();
 }
 
+void
+Directory::SortModified()
+{
+	assert(holding_db_lock());
+
+	if (modified) {
+		children.sort(directory_cmp);
+		song_list_sort(songs);
+	}
+
+	if (modified_below)
+		for (auto &child : children)
+			child.SortModified();
+}
+
 bool
-Directory::Walk(bool recursive, const SongFilter *filter,
+Directory::Walk(const std::string &path,
+		bool recursive, const SongFilter *filter,
 		VisitDirectory visit_directory, VisitSong visit_song,
 		VisitPlaylist visit_playlist,
-		Error &error) const
+		Error &error, const char *after) const
 {
 	assert(!error.IsDefined());
 
@@ -233,16 +469,70 @@ Directory::Walk(bool recursive, const SongFilter *filter,
 		   because the child's SimpleDatabasePlugin::Visit()
 		   call will lock it again */
 		const ScopeDatabaseUnlock unlock;
-		return WalkMount(GetPath(), *mounted_database,
+		return WalkMount(path.c_str(), *mounted_database,
 				 recursive, filter,
 				 visit_directory, visit_song,
 				 visit_playlist,
-				 error);
+				 error, after);
+	}
+
+	auto song_i = songs.begin();
+	auto playlist_i = playlists.begin();
+	auto child_i = children.begin();
+
+	/* if not nullptr, then the "directory" of *child_i has
+	   already been visited, and this is the position inside it */
+	const char *child_after = nullptr;
+
+	if (after != nullptr && *after != 0) {
+		/* skip everything up to and including the given
+		   object; this follows the order of the loops
+		   below */
+		const char *slash = strchr(after, '/');
+		const std::string after_name = slash != nullptr
+			? std::string(after, slash)
+			: std::string(after);
+
+		const Song *song = slash == nullptr
+			? FindSong(after_name.c_str())
+			: nullptr;
+		if (song != nullptr) {
+			song_i = std::next(songs.iterator_to(*song));
+		} else {
+			song_i = songs.end();
+
+			if (slash == nullptr)
+				playlist_i = std::find_if(playlists.begin(),
+							  playlists.end(),
+							  [&after_name](const PlaylistInfo &p){
+								  return p.name == after_name;
+							  });
+			else
+				playlist_i = playlists.end();
+
+			if (playlist_i != playlists.end()) {
+				++playlist_i;
+			} else {
+				/* if the child has been deleted
+				   meanwhile, resume with the next
+				   one */
+				while (child_i != children.end() &&
+				       IcuCollate(child_i->GetName(),
+						  after_name.c_str()) < 0)
+					++child_i;
+
+				if (child_i != children.end() &&
+				    after_name == child_i->GetName())
+					child_after = slash != nullptr
+						? slash + 1
+						: "";
+			}
+		}
 	}
 
 	if (visit_song) {
-		for (auto &song : songs){
-			const LightSong song2 = song.Export();
+		for (; song_i != songs.end(); ++song_i) {
+			const LightSong song2 = song_i->Export(path);
 			if ((filter == nullptr || filter->Match(song2)) &&
 			    !visit_song(song2, error))
 				return false;
@@ -250,28 +540,42 @@ Directory::Walk(bool recursive, const SongFilter *filter,
 	}
 
 	if (visit_playlist) {
-		for (const PlaylistInfo &p : playlists)
-			if (!visit_playlist(p, Export(), error))
+		for (; playlist_i != playlists.end(); ++playlist_i)
+			if (!visit_playlist(*playlist_i, Export(path), error))
 				return false;
 	}
 
-	for (auto &child : children) {
-		if (visit_directory &&
-		    !visit_directory(child.Export(), error))
+	/* the path of the current child; the buffer is reused for
+	   all of them */
+	std::string child_path = path;
+	if (!IsRoot())
+		child_path.push_back('/');
+	const size_t child_path_length = child_path.length();
+
+	for (; child_i != children.end(); ++child_i) {
+		const Directory &child = *child_i;
+
+		child_path.resize(child_path_length);
+		child_path.append(child.name);
+
+		if (child_after == nullptr && visit_directory &&
+		    !visit_directory(child.Export(child_path), error))
 			return false;
 
 		if (recursive &&
-		    !child.Walk(recursive, filter,
+		    !child.Walk(child_path, recursive, filter,
 				visit_directory, visit_song, visit_playlist,
-				error))
+				error, child_after))
 			return false;
+
+		child_after = nullptr;
 	}
 
 	return true;
 }
 
 LightDirectory
-Directory::Export() const
+Directory::Export(const std::string &path) const
 {
-	return LightDirectory(GetPath(), mtime);
+	return LightDirectory(path.c_str(), mtime);
 }
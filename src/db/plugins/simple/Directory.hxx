@@ -28,6 +28,7 @@
 
 #include <boost/intrusive/list.hpp>
 
+#include <memory>
 #include <string>
 
 /**
@@ -46,12 +47,30 @@ static constexpr unsigned DEVICE_CONTAINER = -2;
 class SongFilter;
 class Error;
 class Database;
+class TagIndex;
+class TagBuilder;
+class DatabaseAllocator;
 
 struct Directory {
+	/**
+	 * Once a linear search in #children or #songs has to skip
+	 * this many entries, a hash index is built for it.
+	 */
+	static constexpr unsigned INDEX_THRESHOLD = 32;
+
+	struct ChildIndex;
+	struct SongIndex;
+
 	static constexpr auto link_mode = boost::intrusive::normal_link;
 	typedef boost::intrusive::link_mode<link_mode> LinkMode;
 	typedef boost::intrusive::list_member_hook<LinkMode> Hook;
 
+	struct Disposer {
+		void operator()(Directory *directory) const {
+			directory->Free();
+		}
+	};
+
 	/**
 	 * Pointers to the siblings of this directory within the
 	 * parent directory.  It is unused (undefined) in the root
@@ -89,7 +108,14 @@ struct Directory {
 	time_t mtime;
 	unsigned inode, device;
 
-	std::string path;
+	/**
+	 * The base name of this directory (empty in the root
+	 * directory).  The full path is not stored, because deep
+	 * trees would duplicate long prefixes many times; it is
+	 * derived from the #parent chain by GetPath().  Most names
+	 * are short enough for the std::string's internal buffer.
+	 */
+	std::string name;
 
 	/**
 	 * If this is not nullptr, then this directory does not really
@@ -97,22 +123,104 @@ struct Directory {
 	 */
 	Database *mounted_database;
 
+	/**
+	 * The inverted tag index of the database this directory
+	 * belongs to, or nullptr.  It is inherited from the parent
+	 * directory, and all methods which add, remove or modify songs
+	 * keep it up to date.
+	 */
+	TagIndex *const tag_index;
+
+	/**
+	 * The allocator for songs and child directories of the
+	 * database this directory belongs to, or nullptr to use the
+	 * heap.  It is inherited from the parent directory.
+	 */
+	DatabaseAllocator *const allocator;
+
+	/**
+	 * Were the attributes, the songs, the playlists or the list
+	 * of children of this directory modified since the database
+	 * was saved the last time?  This is used to write only the
+	 * modified parts to the journal.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	bool modified;
+
+	/**
+	 * Was at least one descendant of this directory modified?
+	 * This allows skipping unmodified subtrees quickly.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	bool modified_below;
+
+private:
+	/**
+	 * A hash index of #children by name, or nullptr if it has not
+	 * been built yet (see #INDEX_THRESHOLD).  It is kept up to
+	 * date by all methods which add or remove children.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	mutable std::unique_ptr<ChildIndex> child_index;
+
+	/**
+	 * A hash index of #songs by name, see #child_index.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	mutable std::unique_ptr<SongIndex> song_index;
+
 public:
-	Directory(std::string &&_path_utf8, Directory *_parent);
+	Directory(std::string &&_name_utf8, Directory *_parent,
+		  TagIndex *_tag_index=nullptr,
+		  DatabaseAllocator *_allocator=nullptr);
 	~Directory();
 
 	/**
-	 * Create a new root #Directory object.
+	 * Create a new root #Directory object.  It is allocated with
+	 * "new" and must be freed with "delete"; all other
+	 * directories are freed with Free().
+	 *
+	 * @param tag_index an optional #TagIndex which will be
+	 * updated with all songs added to this tree
+	 * @param allocator an optional #DatabaseAllocator for all
+	 * songs and sub directories of this tree
 	 */
 	gcc_malloc
-	static Directory *NewRoot() {
-		return new Directory(std::string(), nullptr);
+	static Directory *NewRoot(TagIndex *tag_index=nullptr,
+				  DatabaseAllocator *allocator=nullptr) {
+		return new Directory(std::string(), nullptr,
+				     tag_index, allocator);
 	}
 
+	/**
+	 * Destroy a #Directory created by CreateChild() and release
+	 * its memory.  This does not unlink it from its parent.
+	 */
+	void Free();
+
 	bool IsMount() const {
 		return mounted_database != nullptr;
 	}
 
+	/**
+	 * Mark this directory as modified, see #modified.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	void MarkModified();
+
+	/**
+	 * Clear the #modified and #modified_below flags of this
+	 * directory and all of its descendants.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	void ClearModified();
+
 	/**
 	 * Remove this #Directory object from its parent and free it.  This
 	 * must not be called with the root Directory.
@@ -135,12 +243,12 @@ public:
 	 * Caller must lock the #db_mutex.
 	 */
 	gcc_pure
-	const Directory *FindChild(const char *name) const;
+	const Directory *FindChild(const char *name_utf8) const;
 
 	gcc_pure
-	Directory *FindChild(const char *name) {
+	Directory *FindChild(const char *name_utf8) {
 		const Directory *cthis = this;
-		return const_cast<Directory *>(cthis->FindChild(name));
+		return const_cast<Directory *>(cthis->FindChild(name_utf8));
 	}
 
 	/**
@@ -187,16 +295,22 @@ public:
 			playlists.empty();
 	}
 
+	/**
+	 * Returns the path of this directory relative to the music
+	 * directory (empty for the root directory).  It is built from
+	 * the names of all ancestors, therefore callers which need it
+	 * for many songs should keep a copy (see #SongExporter).
+	 */
 	gcc_pure
-	const char *GetPath() const {
-		return path.c_str();
-	}
+	std::string GetPath() const;
 
 	/**
 	 * Returns the base name of the directory.
 	 */
 	gcc_pure
-	const char *GetName() const;
+	const char *GetName() const {
+		return name.c_str();
+	}
 
 	/**
 	 * Is this the root directory of the music database?
@@ -251,6 +365,22 @@ public:
 	 */
 	void RemoveSong(Song *song);
 
+	/**
+	 * Remove and free all songs of this directory.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	void ClearSongs();
+
+	/**
+	 * Replace the tag of a song with the one from the given
+	 * #TagBuilder.  If the song is in this directory, this
+	 * updates the tag index and marks the directory as modified.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	void CommitSongTag(Song &song, TagBuilder &tag);
+
 	/**
 	 * Caller must lock the #db_mutex.
 	 */
@@ -263,16 +393,47 @@ public:
 	 */
 	void Sort();
 
+	/**
+	 * Like Sort(), but only sort the directories which were
+	 * modified (see #modified), and skip unmodified subtrees.
+	 *
+	 * Caller must lock the #db_mutex.
+	 */
+	void SortModified();
+
 	/**
 	 * Caller must lock #db_mutex.
+	 *
+	 * @param after if not nullptr, then resume after this object
+	 * (relative to this directory); see DatabaseSelection::after
 	 */
 	bool Walk(bool recursive, const SongFilter *match,
 		  VisitDirectory visit_directory, VisitSong visit_song,
 		  VisitPlaylist visit_playlist,
-		  Error &error) const;
+		  Error &error, const char *after=nullptr) const {
+		return Walk(GetPath(), recursive, match,
+			    visit_directory, visit_song, visit_playlist,
+			    error, after);
+	}
 
+	/**
+	 * Create a #LightDirectory for this object.
+	 *
+	 * @param path the value of GetPath(); the returned object
+	 * points into it
+	 */
 	gcc_pure
-	LightDirectory Export() const;
+	LightDirectory Export(const std::string &path) const;
+
+private:
+	/**
+	 * @param path the value of GetPath()
+	 */
+	bool Walk(const std::string &path,
+		  bool recursive, const SongFilter *match,
+		  VisitDirectory visit_directory, VisitSong visit_song,
+		  VisitPlaylist visit_playlist,
+		  Error &error, const char *after) const;
 };
 
 #endif
@@ -69,19 +69,28 @@ ParseTypeString(const char *type)
 		return 0;
 }
 
+void
+directory_save_attributes(BufferedOutputStream &os,
+			  const Directory &directory)
+{
+	const char *type = DeviceToTypeString(directory.device);
+	if (type != nullptr)
+		os.Format(DIRECTORY_TYPE "%s\n", type);
+
+	if (directory.mtime != 0)
+		os.Format(DIRECTORY_MTIME "%lu\n",
+			  (unsigned long)directory.mtime);
+}
+
 void
 directory_save(BufferedOutputStream &os, const Directory &directory)
 {
-	if (!directory.IsRoot()) {
-		const char *type = DeviceToTypeString(directory.device);
-		if (type != nullptr)
-			os.Format(DIRECTORY_TYPE "%s\n", type);
+	const std::string path = directory.GetPath();
 
-		if (directory.mtime != 0)
-			os.Format(DIRECTORY_MTIME "%lu\n",
-				  (unsigned long)directory.mtime);
+	if (!directory.IsRoot()) {
+		directory_save_attributes(os, directory);
 
-		os.Format("%s%s\n", DIRECTORY_BEGIN, directory.GetPath());
+		os.Format("%s%s\n", DIRECTORY_BEGIN, path.c_str());
 	}
 
 	for (const auto &child : directory.children) {
@@ -97,11 +106,11 @@ directory_save(BufferedOutputStream &os, const Directory &directory)
 	playlist_vector_save(os, directory.playlists);
 
 	if (!directory.IsRoot())
-		os.Format(DIRECTORY_END "%s\n", directory.GetPath());
+		os.Format(DIRECTORY_END "%s\n", path.c_str());
 }
 
-static bool
-ParseLine(Directory &directory, const char *line)
+bool
+directory_parse_attribute(Directory &directory, const char *line)
 {
 	const char *p;
 	if ((p = StringAfterPrefix(line, DIRECTORY_MTIME))) {
@@ -139,7 +148,7 @@ directory_load_subdir(TextFile &file, Directory &parent, const char *name,
 		if (StringStartsWith(line, DIRECTORY_BEGIN))
 			break;
 
-		if (!ParseLine(*directory, line)) {
+		if (!directory_parse_attribute(*directory, line)) {
 			error.Format(directory_domain,
 				     "Malformed line: %s", line);
 			directory->Delete();
@@ -25,6 +25,22 @@ class TextFile;
 class BufferedOutputStream;
 class Error;
 
+/**
+ * Write the attributes of the directory (but not its path and its
+ * contents).
+ */
+void
+directory_save_attributes(BufferedOutputStream &os,
+			  const Directory &directory);
+
+/**
+ * Parse a line written by directory_save_attributes().
+ *
+ * @return false if the line is not a directory attribute
+ */
+bool
+directory_parse_attribute(Directory &directory, const char *line);
+
 void
 directory_save(BufferedOutputStream &os, const Directory &directory);
 
@@ -70,7 +70,7 @@ WalkMount(const char *base, const Database &db,
 	  bool recursive, const SongFilter *filter,
 	  const VisitDirectory &visit_directory, const VisitSong &visit_song,
 	  const VisitPlaylist &visit_playlist,
-	  Error &error)
+	  Error &error, const char *after)
 {
 	using namespace std::placeholders;
 
@@ -89,6 +89,9 @@ WalkMount(const char *base, const Database &db,
 		vp = std::bind(PrefixVisitPlaylist,
 			       base, std::ref(visit_playlist), _1, _2, _3);
 
-	return db.Visit(DatabaseSelection("", recursive, filter),
-			vd, vs, vp, error);
+	DatabaseSelection selection("", recursive, filter);
+	if (after != nullptr)
+		selection.after = after;
+
+	return db.Visit(selection, vd, vs, vp, error);
 }
@@ -26,11 +26,15 @@ class Database;
 class SongFilter;
 class Error;
 
+/**
+ * @param after see DatabaseSelection::after (relative to the mount
+ * point); may be nullptr
+ */
 bool
 WalkMount(const char *base, const Database &db,
 	  bool recursive, const SongFilter *filter,
 	  const VisitDirectory &visit_directory, const VisitSong &visit_song,
 	  const VisitPlaylist &visit_playlist,
-	  Error &error);
+	  Error &error, const char *after=nullptr);
 
 #endif
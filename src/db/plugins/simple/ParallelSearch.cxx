@@ -0,0 +1,162 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "ParallelSearch.hxx"
+#include "Directory.hxx"
+#include "Song.hxx"
+#include "SongFilter.hxx"
+#include "db/LightSong.hxx"
+#include "thread/Thread.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <memory>
+
+#include <assert.h>
+
+namespace {
+
+/**
+ * One contiguous range of directories, scanned by one thread.
+ */
+struct SearchPartition {
+	const Directory *const*begin, *const*end;
+
+	const SongFilter *filter;
+
+	std::vector<const Song *> result;
+
+	Thread thread;
+
+	void Run() {
+		SongExporter exporter;
+		for (auto i = begin; i != end; ++i)
+			for (const auto &song : (*i)->songs)
+				if (filter->Match(exporter.Export(song)))
+					result.push_back(&song);
+	}
+
+	static void Run(void *ctx) {
+		((SearchPartition *)ctx)->Run();
+	}
+};
+
+}
+
+gcc_pure
+static unsigned
+CountSongs(const Directory &directory)
+{
+	unsigned n = 0;
+	for (gcc_unused const auto &song : directory.songs)
+		++n;
+	return n;
+}
+
+/**
+ * Append all directories to the vector, in the order of
+ * Directory::Walk(), and count their songs.
+ */
+static unsigned
+FlattenDirectories(const Directory &directory,
+		   std::vector<const Directory *> &directories)
+{
+	assert(!directory.IsMount());
+
+	directories.push_back(&directory);
+
+	unsigned n = CountSongs(directory);
+	for (const auto &child : directory.children)
+		n += FlattenDirectories(child, directories);
+
+	return n;
+}
+
+bool
+ParallelSearch(const Directory &directory, const SongFilter &filter,
+	       unsigned n_threads, unsigned min_songs,
+	       std::vector<const Song *> &songs)
+{
+	if (n_threads < 2)
+		return false;
+
+	std::vector<const Directory *> directories;
+	const unsigned n_songs = FlattenDirectories(directory, directories);
+	if (n_songs < min_songs || directories.size() < 2)
+		return false;
+
+	if (n_threads > directories.size())
+		n_threads = directories.size();
+
+	/* split into ranges with roughly the same number of songs */
+
+	std::unique_ptr<SearchPartition[]> partitions(new SearchPartition[n_threads]);
+
+	const Directory *const*p = directories.data();
+	const Directory *const*const end = p + directories.size();
+	const unsigned songs_per_partition = n_songs / n_threads + 1;
+
+	unsigned n_partitions = 0;
+	while (p != end && n_partitions < n_threads) {
+		auto &partition = partitions[n_partitions++];
+		partition.begin = p;
+		partition.filter = &filter;
+
+		if (n_partitions == n_threads) {
+			p = end;
+		} else {
+			unsigned n = 0;
+			do {
+				n += CountSongs(**p++);
+			} while (p != end && n < songs_per_partition);
+		}
+
+		partition.end = p;
+	}
+
+	/* the calling thread scans the first range itself */
+
+	for (unsigned i = 1; i < n_partitions; ++i) {
+		auto &partition = partitions[i];
+
+		Error error;
+		if (!partition.thread.Start(SearchPartition::Run, &partition,
+					    error)) {
+			LogError(error);
+			partition.Run();
+		}
+	}
+
+	partitions[0].Run();
+
+	for (unsigned i = 1; i < n_partitions; ++i)
+		if (partitions[i].thread.IsDefined())
+			partitions[i].thread.Join();
+
+	/* merge */
+
+	for (unsigned i = 0; i < n_partitions; ++i)
+		songs.insert(songs.end(),
+			     partitions[i].result.begin(),
+			     partitions[i].result.end());
+
+	return true;
+}
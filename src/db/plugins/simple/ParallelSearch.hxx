@@ -0,0 +1,54 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PARALLEL_SEARCH_HXX
+#define MPD_PARALLEL_SEARCH_HXX
+
+#include "check.h"
+
+#include <vector>
+
+struct Directory;
+struct Song;
+class SongFilter;
+
+/**
+ * Find all songs below the given directory (recursively) which match
+ * the filter.  The directory tree is split into contiguous ranges
+ * which are scanned by several threads; the results are merged in the
+ * same order as Directory::Walk() would visit them.
+ *
+ * Caller must lock the #db_mutex; it is held during the whole
+ * operation on behalf of all worker threads, which only read.  The
+ * tree must not contain mounts.
+ *
+ * @param n_threads the maximum number of threads, including the
+ * calling thread
+ * @param min_songs don't start threads if there are fewer songs than
+ * this; return false instead
+ * @return false if the tree was too small to be worth it (nothing was
+ * done)
+ */
+bool
+ParallelSearch(const Directory &directory, const SongFilter &filter,
+	       unsigned n_threads, unsigned min_songs,
+	       std::vector<const Song *> &songs);
+
+#endif
@@ -27,51 +27,125 @@
 #include "db/LightDirectory.hxx"
 #include "Directory.hxx"
 #include "Song.hxx"
+#include "SongSort.hxx"
 #include "DatabaseSave.hxx"
+#include "DatabaseBinary.hxx"
+#include "DatabaseJournal.hxx"
+#include "ParallelSearch.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/DatabaseError.hxx"
+#include "SongFilter.hxx"
+#include "lib/icu/Collate.hxx"
 #include "fs/io/TextFile.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
 #include "fs/io/FileOutputStream.hxx"
 #include "fs/FileInfo.hxx"
 #include "config/Block.hxx"
 #include "fs/FileSystem.hxx"
+#include "fs/Traits.hxx"
 #include "util/CharUtil.hxx"
+#include "util/StringCompare.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
 #ifdef ENABLE_ZLIB
 #include "fs/io/GzipOutputStream.hxx"
+#include "fs/io/ParallelGzipOutputStream.hxx"
 #endif
 
 #include <memory>
+#include <algorithm>
+#include <unordered_map>
 
 #include <errno.h>
+#include <stdio.h>
 
 static constexpr Domain simple_db_domain("simple_db");
 
+/**
+ * Below this number of songs, starting threads for a search costs
+ * more than it saves.
+ */
+static constexpr unsigned PARALLEL_SEARCH_MIN_SONGS = 20000;
+
+#ifdef ENABLE_ZLIB
+/**
+ * The default value of "compress_threads".  Saving happens in the
+ * background, so it shouldn't occupy more than a few cores.
+ */
+static constexpr unsigned DEFAULT_COMPRESS_THREADS = 4;
+#endif
+
+/**
+ * Append a suffix to the database file name.
+ */
+static AllocatedPath
+SiblingPath(Path path, PathTraitsFS::const_pointer_type suffix)
+{
+	return AllocatedPath::FromFS(PathTraitsFS::string(path.c_str()) +
+				     suffix);
+}
+
+/**
+ * Generate a string which identifies one version of the database
+ * file.  It is stored in the journal header, so a journal is never
+ * applied to a database file it does not belong to.
+ */
+static std::string
+SnapshotId(const FileInfo &fi)
+{
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "%llu %lu %lu",
+		 (unsigned long long)fi.GetSize(),
+		 (unsigned long)fi.GetModificationTime(),
+#ifdef WIN32
+		 0ul
+#else
+		 (unsigned long)fi.GetInode()
+#endif
+		 );
+	return buffer;
+}
+
 inline SimpleDatabase::SimpleDatabase()
 	:Database(simple_db_plugin),
 	 path(AllocatedPath::Null()),
 #ifdef ENABLE_ZLIB
 	 compress(true),
+	 compress_level(Z_DEFAULT_COMPRESSION),
+	 compress_threads(DEFAULT_COMPRESS_THREADS),
 #endif
+	 binary(false),
+	 journal(false),
+	 journal_path(AllocatedPath::Null()),
+	 journal_valid(false),
+	 search_threads(1),
 	 cache_path(AllocatedPath::Null()),
+	 n_mounts(0),
 	 prefixed_light_song(nullptr) {}
 
 inline SimpleDatabase::SimpleDatabase(AllocatedPath &&_path,
 #ifndef ENABLE_ZLIB
 				      gcc_unused
 #endif
-				      bool _compress)
+				      bool _compress, bool _binary,
+				      bool _journal)
 	:Database(simple_db_plugin),
 	 path(std::move(_path)),
 	 path_utf8(path.ToUTF8()),
 #ifdef ENABLE_ZLIB
 	 compress(_compress),
+	 compress_level(Z_DEFAULT_COMPRESSION),
+	 compress_threads(DEFAULT_COMPRESS_THREADS),
 #endif
+	 binary(_binary),
+	 journal(_journal),
+	 journal_path(SiblingPath(path, PATH_LITERAL(".journal"))),
+	 journal_valid(false),
+	 search_threads(1),
 	 cache_path(AllocatedPath::Null()),
+	 n_mounts(0),
 	 prefixed_light_song(nullptr) {
 }
 
@@ -101,6 +175,7 @@ SimpleDatabase::Configure(const ConfigBlock &block, Error &error)
 	}
 
 	path_utf8 = path.ToUTF8();
+	journal_path = SiblingPath(path, PATH_LITERAL(".journal"));
 
 	cache_path = block.GetBlockPath("cache_directory", error);
 	if (path.IsNull() && error.IsDefined())
@@ -108,8 +183,37 @@ SimpleDatabase::Configure(const ConfigBlock &block, Error &error)
 
 #ifdef ENABLE_ZLIB
 	compress = block.GetBlockValue("compress", compress);
+
+	compress_level = block.GetBlockValue("compress_level",
+					     compress_level);
+	if (compress_level < Z_DEFAULT_COMPRESSION ||
+	    compress_level > Z_BEST_COMPRESSION) {
+		error.Format(simple_db_domain,
+			     "Invalid compression level: %d", compress_level);
+		return false;
+	}
+
+	compress_threads = block.GetBlockValue("compress_threads",
+					       compress_threads);
+	if (compress_threads < 1)
+		compress_threads = 1;
 #endif
 
+	const char *format = block.GetBlockValue("format", "text");
+	if (strcmp(format, "binary") == 0)
+		binary = true;
+	else if (strcmp(format, "text") != 0) {
+		error.Format(simple_db_domain,
+			     "Unsupported database format: \"%s\"", format);
+		return false;
+	}
+
+	journal = block.GetBlockValue("journal", journal);
+
+	search_threads = block.GetBlockValue("search_threads", search_threads);
+	if (search_threads < 1)
+		search_threads = 1;
+
 	return true;
 }
 
@@ -172,15 +276,47 @@ SimpleDatabase::Load(Error &error)
 	assert(!path.IsNull());
 	assert(root != nullptr);
 
-	TextFile file(path);
+	/* the format is detected from the file, so switching the
+	   "format" setting does not discard an existing database */
+	if (db_binary_check(path)) {
+		if (!db_load_binary(path, *root, error))
+			return false;
+	} else {
+		TextFile file(path);
 
-	if (!db_load_internal(file, *root, error))
-		return false;
+		if (!db_load_internal(file, *root, error))
+			return false;
+	}
+
+	journal_valid = false;
 
 	FileInfo fi;
-	if (GetFileInfo(path, fi))
+	if (GetFileInfo(path, fi)) {
 		mtime = fi.GetModificationTime();
 
+		/* apply the journal even if the "journal" setting
+		   was disabled meanwhile, or else the changes it
+		   contains would be lost */
+		FileInfo journal_info;
+		if (GetFileInfo(journal_path, journal_info)) {
+			bool clean;
+			if (!db_journal_load(journal_path,
+					     SnapshotId(fi).c_str(), *root,
+					     clean, error))
+				return false;
+
+			if (clean) {
+				journal_valid = journal;
+
+				if (journal_info.GetModificationTime() > mtime)
+					mtime = journal_info.GetModificationTime();
+			}
+		}
+	}
+
+	const ScopeDatabaseLock protect;
+	root->ClearModified();
+
 	return true;
 }
 
@@ -189,7 +325,7 @@ SimpleDatabase::Open()
 {
 	assert(prefixed_light_song == nullptr);
 
-	root = Directory::NewRoot();
+	root = Directory::NewRoot(&tag_index, &allocator);
 	mtime = 0;
 
 #ifndef NDEBUG
@@ -205,7 +341,7 @@ SimpleDatabase::Open()
 
 			Check();
 
-			root = Directory::NewRoot();
+			root = Directory::NewRoot(&tag_index, &allocator);
 		}
 	} catch (const std::exception &e) {
 		LogError(e);
@@ -214,7 +350,7 @@ SimpleDatabase::Open()
 
 		Check();
 
-		root = Directory::NewRoot();
+		root = Directory::NewRoot(&tag_index, &allocator);
 	}
 }
 
@@ -225,7 +361,16 @@ SimpleDatabase::Close()
 	assert(prefixed_light_song == nullptr);
 	assert(borrowed_song_count == 0);
 
+	/* clear the index first, so deleting the songs does not
+	   have to look them up */
+	tag_index.Clear();
+
+	/* the destructors still run (the tags hold references to
+	   the tag pool), but the memory of all songs and directories
+	   is released with the slabs */
+	allocator.BeginDiscard();
 	delete root;
+	allocator.Clear();
 }
 
 const LightSong *
@@ -249,7 +394,8 @@ SimpleDatabase::GetSong(const char *uri) const
 			return nullptr;
 
 		prefixed_light_song =
-			new PrefixedLightSong(*song, r.directory->GetPath());
+			new PrefixedLightSong(*song,
+					      r.directory->GetPath().c_str());
 		return prefixed_light_song;
 	}
 
@@ -264,12 +410,14 @@ SimpleDatabase::GetSong(const char *uri) const
 				    "No such song");
 
 	const Song *song = r.directory->FindSong(r.uri);
-	protect.unlock();
 	if (song == nullptr)
 		throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
 				    "No such song");
 
-	light_song = song->Export();
+	light_song_directory = r.directory->GetPath();
+	protect.unlock();
+
+	light_song = song->Export(light_song_directory);
 
 #ifndef NDEBUG
 	++borrowed_song_count;
@@ -295,6 +443,81 @@ SimpleDatabase::ReturnSong(gcc_unused const LightSong *song) const
 #endif
 }
 
+gcc_pure
+static bool
+IsInside(const Directory *directory, const Directory &base, bool recursive)
+{
+	if (!recursive)
+		return directory == &base;
+
+	for (; directory != nullptr; directory = directory->parent)
+		if (directory == &base)
+			return true;
+
+	return false;
+}
+
+bool
+SimpleDatabase::CollectIndexed(const Directory &directory,
+			       const DatabaseSelection &selection,
+			       std::vector<const Song *> &songs) const
+{
+	if (selection.filter == nullptr || n_mounts > 0)
+		return false;
+
+	/* use the first filter item which the index can answer; the
+	   caller checks the other items */
+	const SongFilter::Item *item = nullptr;
+	for (const auto &i : selection.filter->GetItems()) {
+		if (TagIndex::CanLookup(i)) {
+			item = &i;
+			break;
+		}
+	}
+
+	if (item == nullptr)
+		return false;
+
+	std::vector<const Song *> candidates;
+	tag_index.Lookup(*item, candidates);
+
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()),
+			 candidates.end());
+
+	/* restore the order of Directory::Walk(), which is the
+	   order established by Directory::Sort() */
+
+	std::unordered_map<const Directory *,
+			   std::vector<const Song *>> groups;
+	for (const Song *song : candidates)
+		if (IsInside(song->parent, directory, selection.recursive))
+			groups[song->parent].push_back(song);
+
+	std::vector<std::pair<std::string, const Directory *>> directories;
+	directories.reserve(groups.size());
+	for (const auto &i : groups)
+		directories.emplace_back(i.first->GetPath(), i.first);
+
+	std::sort(directories.begin(), directories.end(),
+		  [](const std::pair<std::string, const Directory *> &a,
+		     const std::pair<std::string, const Directory *> &b){
+			  return IcuCollate(a.first.c_str(),
+					    b.first.c_str()) < 0;
+		  });
+
+	for (const auto &d : directories) {
+		auto &group = groups[d.second];
+		std::sort(group.begin(), group.end(),
+			  [](const Song *a, const Song *b){
+				  return song_cmp(*a, *b);
+			  });
+		songs.insert(songs.end(), group.begin(), group.end());
+	}
+
+	return true;
+}
+
 bool
 SimpleDatabase::Visit(const DatabaseSelection &selection,
 		      VisitDirectory visit_directory,
@@ -308,10 +531,59 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 	if (r.uri == nullptr) {
 		/* it's a directory */
 
+		if (!selection.after.empty()) {
+			/* resume an interrupted walk; the index and
+			   the parallel search don't preserve the walk
+			   order, so they can't be used */
+			const char *after = selection.after.c_str();
+			if (!selection.uri.empty()) {
+				after = StringAfterPrefix(after,
+							  selection.uri.c_str());
+				if (after == nullptr ||
+				    (*after != 0 && *after++ != '/'))
+					/* not inside this selection */
+					return true;
+			}
+
+			return r.directory->Walk(selection.recursive,
+						 selection.filter,
+						 visit_directory, visit_song,
+						 visit_playlist,
+						 error, after);
+		}
+
 		if (selection.recursive && visit_directory &&
-		    !visit_directory(r.directory->Export(), error))
+		    !visit_directory(r.directory->Export(r.directory->GetPath()),
+				     error))
 			return false;
 
+		SongExporter exporter;
+		std::vector<const Song *> songs;
+		if (visit_song && !visit_directory && !visit_playlist &&
+		    CollectIndexed(*r.directory, selection, songs)) {
+			for (const Song *song : songs) {
+				const LightSong song2 = exporter.Export(*song);
+				if (selection.filter->Match(song2) &&
+				    !visit_song(song2, error))
+					return false;
+			}
+
+			return true;
+		}
+
+		if (visit_song && !visit_directory && !visit_playlist &&
+		    selection.recursive && selection.filter != nullptr &&
+		    n_mounts == 0 &&
+		    ParallelSearch(*r.directory, *selection.filter,
+				   search_threads, PARALLEL_SEARCH_MIN_SONGS,
+				   songs)) {
+			for (const Song *song : songs)
+				if (!visit_song(exporter.Export(*song), error))
+					return false;
+
+			return true;
+		}
+
 		return r.directory->Walk(selection.recursive, selection.filter,
 					 visit_directory, visit_song,
 					 visit_playlist,
@@ -319,10 +591,15 @@ SimpleDatabase::Visit(const DatabaseSelection &selection,
 	}
 
 	if (strchr(r.uri, '/') == nullptr) {
+		if (!selection.after.empty())
+			/* the song has already been visited */
+			return true;
+
 		if (visit_song) {
 			Song *song = r.directory->FindSong(r.uri);
 			if (song != nullptr) {
-				const LightSong song2 = song->Export();
+				const std::string parent_path = r.directory->GetPath();
+				const LightSong song2 = song->Export(parent_path);
 				return !selection.Match(song2) ||
 					visit_song(song2, error);
 			}
@@ -348,11 +625,63 @@ bool
 SimpleDatabase::GetStats(const DatabaseSelection &selection,
 			 DatabaseStats &stats, Error &error) const
 {
+	if (selection.uri.empty() && selection.recursive &&
+	    selection.filter == nullptr && n_mounts == 0) {
+		/* the whole database: use the counters maintained
+		   by the tag index */
+		const ScopeDatabaseLock protect;
+		tag_index.GetStats(stats);
+		return true;
+	}
+
 	return ::GetStats(*this, selection, stats, error);
 }
 
+bool
+SimpleDatabase::SaveJournal()
+{
+	/* compact the journal into a new database file as soon as it
+	   has grown larger than the database file; this limits the
+	   cost of loading it to the cost of loading the database
+	   file */
+	FileInfo db_info, journal_info;
+	if (!GetFileInfo(path, db_info) ||
+	    !GetFileInfo(journal_path, journal_info) ||
+	    journal_info.GetSize() > db_info.GetSize())
+		return false;
+
+	AppendFileOutputStream fos(journal_path);
+	BufferedOutputStream bos(fos);
+
+	unsigned n;
+
+	{
+		const ScopeDatabaseLock protect;
+
+		LogDebug(simple_db_domain, "removing empty directories from DB");
+		root->PruneEmpty();
+
+		LogDebug(simple_db_domain, "sorting DB");
+		root->SortModified();
+
+		LogDebug(simple_db_domain, "writing DB journal");
+		n = db_journal_save(bos, *root);
+	}
+
+	bos.Flush();
+	fos.Commit();
+
+	FormatDebug(simple_db_domain,
+		    "appended %u directories to the DB journal", n);
+
+	if (GetFileInfo(journal_path, journal_info))
+		mtime = journal_info.GetModificationTime();
+
+	return true;
+}
+
 void
-SimpleDatabase::Save()
+SimpleDatabase::SaveSnapshot()
 {
 	{
 		const ScopeDatabaseLock protect;
@@ -362,25 +691,47 @@ SimpleDatabase::Save()
 
 		LogDebug(simple_db_domain, "sorting DB");
 		root->Sort();
+
+		/* the journal is obsolete after this */
+		root->ClearModified();
 	}
 
+	journal_valid = false;
+
 	LogDebug(simple_db_domain, "writing DB");
 
-	FileOutputStream fos(path);
+	/* write to a temporary file and rename it, so a crash while
+	   writing does not lose the old database */
+	const auto tmp_path = SiblingPath(path, PATH_LITERAL(".tmp"));
+
+	FileOutputStream fos(tmp_path);
 
 	OutputStream *os = &fos;
 
 #ifdef ENABLE_ZLIB
 	std::unique_ptr<GzipOutputStream> gzip;
-	if (compress) {
-		gzip.reset(new GzipOutputStream(*os));
-		os = gzip.get();
+	std::unique_ptr<ParallelGzipOutputStream> parallel_gzip;
+	/* the binary format is not compressed, because it is
+	   mapped into memory when it is loaded */
+	if (compress && !binary) {
+		if (compress_threads > 1) {
+			parallel_gzip.reset(new ParallelGzipOutputStream(*os,
+									 compress_level,
+									 compress_threads));
+			os = parallel_gzip.get();
+		} else {
+			gzip.reset(new GzipOutputStream(*os, compress_level));
+			os = gzip.get();
+		}
 	}
 #endif
 
 	BufferedOutputStream bos(*os);
 
-	db_save_internal(bos, *root);
+	if (binary)
+		db_save_binary(bos, *root);
+	else
+		db_save_internal(bos, *root);
 
 	bos.Flush();
 
@@ -389,13 +740,56 @@ SimpleDatabase::Save()
 		gzip->Flush();
 		gzip.reset();
 	}
+
+	if (parallel_gzip != nullptr) {
+		parallel_gzip->Flush();
+		parallel_gzip.reset();
+	}
 #endif
 
 	fos.Commit();
 
+#ifdef WIN32
+	/* rename() does not replace existing files on Windows */
+	RemoveFile(path);
+#endif
+
+	if (!RenameFile(tmp_path, path))
+		throw FormatErrno("Failed to rename %s", tmp_path.c_str());
+
 	FileInfo fi;
-	if (GetFileInfo(path, fi))
-		mtime = fi.GetModificationTime();
+	if (!GetFileInfo(path, fi))
+		return;
+
+	mtime = fi.GetModificationTime();
+
+	if (journal) {
+		FileOutputStream journal_fos(journal_path);
+		BufferedOutputStream journal_bos(journal_fos);
+		db_journal_begin(journal_bos, SnapshotId(fi).c_str());
+		journal_bos.Flush();
+		journal_fos.Commit();
+
+		journal_valid = true;
+	} else
+		/* a stale journal must not be applied to the new
+		   database file */
+		RemoveFile(journal_path);
+}
+
+void
+SimpleDatabase::Save()
+{
+	if (journal_valid) {
+		try {
+			if (SaveJournal())
+				return;
+		} catch (const std::runtime_error &e) {
+			LogError(e);
+		}
+	}
+
+	SaveSnapshot();
 }
 
 void
@@ -421,6 +815,7 @@ SimpleDatabase::Mount(const char *uri, Database *db)
 
 	Directory *mnt = r.directory->CreateChild(r.uri);
 	mnt->mounted_database = db;
+	++n_mounts;
 }
 
 static constexpr bool
@@ -455,7 +850,7 @@ SimpleDatabase::Mount(const char *local_uri, const char *storage_uri,
 #endif
 	auto db = new SimpleDatabase(AllocatedPath::Build(cache_path,
 							  name_fs.c_str()),
-				     compress);
+				     compress, binary, journal);
 	try {
 		db->Open();
 	} catch (...) {
@@ -489,6 +884,9 @@ SimpleDatabase::LockUmountSteal(const char *uri)
 	r.directory->mounted_database = nullptr;
 	r.directory->Delete();
 
+	assert(n_mounts > 0);
+	--n_mounts;
+
 	return db;
 }
 
@@ -506,6 +904,7 @@ SimpleDatabase::Unmount(const char *uri)
 
 const DatabasePlugin simple_db_plugin = {
 	"simple",
-	DatabasePlugin::FLAG_REQUIRE_STORAGE,
+	DatabasePlugin::FLAG_REQUIRE_STORAGE|DatabasePlugin::FLAG_RESUME_VISIT|
+	DatabasePlugin::FLAG_THREAD_SAFE,
 	SimpleDatabase::Create,
 };
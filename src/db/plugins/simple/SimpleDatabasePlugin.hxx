@@ -24,12 +24,18 @@
 #include "db/Interface.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "db/LightSong.hxx"
+#include "TagIndex.hxx"
+#include "DatabaseAllocator.hxx"
 #include "Compiler.h"
 
+#include <string>
+#include <vector>
+
 #include <cassert>
 
 struct ConfigBlock;
 struct Directory;
+struct Song;
 struct DatabasePlugin;
 class EventLoop;
 class DatabaseListener;
@@ -41,15 +47,82 @@ class SimpleDatabase : public Database {
 
 #ifdef ENABLE_ZLIB
 	bool compress;
+
+	/**
+	 * The zlib compression level for the text format; -1 is
+	 * zlib's default.
+	 */
+	int compress_level;
+
+	/**
+	 * The number of threads which compress the text format on
+	 * Save().  1 compresses on the calling thread.
+	 */
+	unsigned compress_threads;
 #endif
 
+	/**
+	 * Write the database in the binary format (see
+	 * DatabaseBinary.hxx) instead of the text format?
+	 */
+	bool binary;
+
+	/**
+	 * Append the changes of each update to a journal file (see
+	 * DatabaseJournal.hxx) instead of rewriting the whole
+	 * database file?
+	 */
+	bool journal;
+
+	/**
+	 * The path of the journal file, next to the database file.
+	 */
+	AllocatedPath journal_path;
+
+	/**
+	 * Does the journal file belong to the current database file,
+	 * and is it safe to append more transactions to it?  If not,
+	 * the next Save() writes the whole database.
+	 */
+	bool journal_valid;
+
+	/**
+	 * The maximum number of threads used by Visit() to filter
+	 * songs when the #tag_index cannot be used.  1 disables
+	 * parallel searching.
+	 */
+	unsigned search_threads;
+
 	/**
 	 * The path where cache files for Mount() are located.
 	 */
 	AllocatedPath cache_path;
 
+	/**
+	 * Memory for all songs and directories below #root.  It is
+	 * released at once by Close().
+	 */
+	DatabaseAllocator allocator;
+
 	Directory *root;
 
+	/**
+	 * An inverted index of all song tags, used by Visit() to
+	 * avoid walking the whole tree.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	TagIndex tag_index;
+
+	/**
+	 * The number of databases mounted into this one.  Visit()
+	 * does not use the #tag_index while there are mounts, because
+	 * it does not contain their songs.
+	 *
+	 * This attribute is protected with the global #db_mutex.
+	 */
+	unsigned n_mounts;
+
 	time_t mtime;
 
 	/**
@@ -63,13 +136,19 @@ class SimpleDatabase : public Database {
 	 */
 	mutable LightSong light_song;
 
+	/**
+	 * The directory path #light_song points to.
+	 */
+	mutable std::string light_song_directory;
+
 #ifndef NDEBUG
 	mutable unsigned borrowed_song_count;
 #endif
 
 	SimpleDatabase();
 
-	SimpleDatabase(AllocatedPath &&_path, bool _compress);
+	SimpleDatabase(AllocatedPath &&_path, bool _compress, bool _binary,
+		       bool _journal);
 
 public:
 	static Database *Create(EventLoop &loop, DatabaseListener &listener,
@@ -139,7 +218,38 @@ private:
 
 	bool Load(Error &error);
 
+	/**
+	 * Append the modified directories to the journal.
+	 *
+	 * Throws std::runtime_error on error.
+	 *
+	 * @return false if the journal is too large and the whole
+	 * database should be written instead
+	 */
+	bool SaveJournal();
+
+	/**
+	 * Write the whole database file and start a new journal.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void SaveSnapshot();
+
 	Database *LockUmountSteal(const char *uri);
+
+	/**
+	 * Use the #tag_index to find all songs below the given
+	 * directory which may match the selection.  They are returned
+	 * in the same order as Directory::Walk() would visit them.
+	 *
+	 * Caller must lock the #db_mutex.
+	 *
+	 * @return false if the index cannot be used for this
+	 * selection
+	 */
+	bool CollectIndexed(const Directory &directory,
+			    const DatabaseSelection &selection,
+			    std::vector<const Song *> &songs) const;
 };
 
 extern const DatabasePlugin simple_db_plugin;
@@ -20,13 +20,18 @@
 #include "config.h"
 #include "Song.hxx"
 #include "Directory.hxx"
+#include "DatabaseAllocator.hxx"
 #include "tag/Tag.hxx"
-#include "util/VarSize.hxx"
+#include "util/Alloc.hxx"
+#include "util/MemStats.hxx"
 #include "DetachedSong.hxx"
 #include "db/LightSong.hxx"
 
+#include <new>
+
 #include <assert.h>
 #include <string.h>
+#include <stdlib.h>
 
 inline Song::Song(const char *_uri, size_t uri_length, Directory &_parent)
 	:parent(&_parent), mtime(0),
@@ -39,6 +44,15 @@ inline Song::~Song()
 {
 }
 
+/**
+ * The size of a #Song allocation (for memory accounting).
+ */
+static constexpr size_t
+SongAllocationSize(size_t uri_length)
+{
+	return sizeof(Song) - sizeof(Song::uri) + uri_length + 1;
+}
+
 static Song *
 song_alloc(const char *uri, Directory &parent)
 {
@@ -48,9 +62,14 @@ song_alloc(const char *uri, Directory &parent)
 	uri_length = strlen(uri);
 	assert(uri_length);
 
-	return NewVarSize<Song>(sizeof(Song::uri),
-				uri_length + 1,
-				uri, uri_length, parent);
+	const size_t size = SongAllocationSize(uri_length);
+	MemStatsAllocate(MemStatsCategory::SONG, size);
+
+	/* the URI is allocated together with the object */
+	void *p = parent.allocator != nullptr
+		? parent.allocator->Allocate(size)
+		: xalloc(size);
+	return ::new(p) Song(uri, uri_length, parent);
 }
 
 Song *
@@ -61,6 +80,8 @@ Song::NewFrom(DetachedSong &&other, Directory &parent)
 	song->mtime = other.GetLastModified();
 	song->start_time = other.GetStartTime();
 	song->end_time = other.GetEndTime();
+	song->SetMixRamp(MixRampInfo(other.GetMixRamp()));
+	song->SetReplayGain(other.GetReplayGain());
 	return song;
 }
 
@@ -73,7 +94,16 @@ Song::NewFile(const char *path, Directory &parent)
 void
 Song::Free()
 {
-	DeleteVarSize(this);
+	const size_t size = SongAllocationSize(strlen(uri));
+	MemStatsFree(MemStatsCategory::SONG, size);
+
+	DatabaseAllocator *const allocator = parent->allocator;
+	this->~Song();
+
+	if (allocator != nullptr)
+		allocator->Free(this, size);
+	else
+		free(this);
 }
 
 std::string
@@ -84,11 +114,7 @@ Song::GetURI() const
 	if (parent->IsRoot())
 		return std::string(uri);
 	else {
-		const char *path = parent->GetPath();
-
-		std::string result;
-		result.reserve(strlen(path) + 1 + strlen(uri));
-		result.assign(path);
+		std::string result = parent->GetPath();
 		result.push_back('/');
 		result.append(uri);
 		return result;
@@ -96,16 +122,29 @@ Song::GetURI() const
 }
 
 LightSong
-Song::Export() const
+Song::Export(const std::string &parent_path) const
 {
 	LightSong dest;
 	dest.directory = parent->IsRoot()
-		? nullptr : parent->GetPath();
+		? nullptr : parent_path.c_str();
 	dest.uri = uri;
 	dest.real_uri = nullptr;
 	dest.tag = &tag;
 	dest.mtime = mtime;
 	dest.start_time = start_time;
 	dest.end_time = end_time;
+	dest.mix_ramp = mix_ramp.get();
+	dest.replay_gain = replay_gain.get();
 	return dest;
 }
+
+LightSong
+SongExporter::Export(const Song &song)
+{
+	if (song.parent != directory) {
+		directory = song.parent;
+		path = directory->GetPath();
+	}
+
+	return song.Export(path);
+}
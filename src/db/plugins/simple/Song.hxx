@@ -23,13 +23,16 @@
 #include "check.h"
 #include "Chrono.hxx"
 #include "tag/Tag.hxx"
+#include "MixRampInfo.hxx"
+#include "ReplayGainInfo.hxx"
 #include "Compiler.h"
 
 #include <boost/intrusive/list.hpp>
 
 #include <string>
+#include <memory>
 
-#include <time.h>
+#include <stdint.h>
 
 struct LightSong;
 struct Directory;
@@ -70,7 +73,28 @@ struct Song {
 	 */
 	Directory *const parent;
 
-	time_t mtime;
+	/**
+	 * MixRamp data calculated during the database update (see
+	 * #ConfigOption::MIXRAMP_ANALYZER).  nullptr if unknown; it is
+	 * allocated separately because most songs have none, and an
+	 * empty #MixRampInfo would add two std::string objects to
+	 * each song.
+	 */
+	std::unique_ptr<MixRampInfo> mix_ramp;
+
+	/**
+	 * ReplayGain data measured during the database update (see
+	 * #ConfigOption::LOUDNESS_ANALYZER).  nullptr if unknown.
+	 */
+	std::unique_ptr<ReplayGainInfo> replay_gain;
+
+	/**
+	 * The modification time of the file.  This is 32 bit (unsigned,
+	 * i.e. good until 2106) instead of time_t, which allows packing
+	 * it together with the following 32 bit attributes without
+	 * padding.
+	 */
+	uint32_t mtime;
 
 	/**
 	 * Start of this sub-song within the file.
@@ -84,7 +108,9 @@ struct Song {
 	SongTime end_time;
 
 	/**
-	 * The file name.
+	 * The file name (without the directory, which is derived
+	 * from #parent).  The string is allocated together with the
+	 * object, from Directory::allocator if set.
 	 */
 	char uri[sizeof(int)];
 
@@ -109,6 +135,28 @@ struct Song {
 
 	void Free();
 
+	/**
+	 * Replace the MixRamp data; an undefined #MixRampInfo frees
+	 * it.
+	 */
+	void SetMixRamp(MixRampInfo &&_mix_ramp) {
+		if (_mix_ramp.IsDefined())
+			mix_ramp.reset(new MixRampInfo(std::move(_mix_ramp)));
+		else
+			mix_ramp.reset();
+	}
+
+	/**
+	 * Replace the ReplayGain data; an undefined #ReplayGainInfo
+	 * frees it.
+	 */
+	void SetReplayGain(const ReplayGainInfo &_replay_gain) {
+		if (_replay_gain.IsDefined())
+			replay_gain.reset(new ReplayGainInfo(_replay_gain));
+		else
+			replay_gain.reset();
+	}
+
 	bool UpdateFile(Storage &storage);
 
 #ifdef ENABLE_ARCHIVE
@@ -125,8 +173,30 @@ struct Song {
 	gcc_pure
 	std::string GetURI() const;
 
+	/**
+	 * Create a #LightSong for this object.
+	 *
+	 * @param parent_path the value of Directory::GetPath() of
+	 * #parent; the returned object points into it
+	 */
 	gcc_pure
-	LightSong Export() const;
+	LightSong Export(const std::string &parent_path) const;
+};
+
+/**
+ * Creates #LightSong objects for many songs, deriving the path of
+ * their directories only when it changes.
+ */
+class SongExporter {
+	const Directory *directory = nullptr;
+
+	std::string path;
+
+public:
+	/**
+	 * The returned object is only valid until the next call.
+	 */
+	LightSong Export(const Song &song);
 };
 
 typedef boost::intrusive::list<Song,
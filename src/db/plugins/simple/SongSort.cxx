@@ -76,8 +76,7 @@ compare_tag_item(const Tag &a, const Tag &b, TagType type)
 }
 
 /* Only used for sorting/searchin a songvec, not general purpose compares */
-gcc_pure
-static bool
+bool
 song_cmp(const Song &a, const Song &b)
 {
 	int ret;
@@ -21,6 +21,15 @@
 #define MPD_SONG_SORT_HXX
 
 #include "Song.hxx"
+#include "Compiler.h"
+
+/**
+ * The order used by song_list_sort(): by album, disc, track number
+ * and file name.
+ */
+gcc_pure
+bool
+song_cmp(const Song &a, const Song &b);
 
 void
 song_list_sort(SongList &songs);
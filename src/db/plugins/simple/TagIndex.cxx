@@ -0,0 +1,155 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "TagIndex.hxx"
+#include "Song.hxx"
+#include "db/Stats.hxx"
+#include "tag/Tag.hxx"
+#include "lib/icu/Collate.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+
+void
+TagIndex::Add(const Song &song)
+{
+	++song_count;
+	if (!song.tag.duration.IsNegative())
+		total_duration += song.tag.duration;
+
+	for (const auto &item : song.tag) {
+		auto &list = maps[item.type][item.value].songs;
+
+		/* don't add the song twice if it has the same value
+		   more than once */
+		if (list.empty() || list.back() != &song)
+			list.push_back(&song);
+	}
+}
+
+void
+TagIndex::Remove(const Song &song)
+{
+	assert(song_count > 0);
+
+	--song_count;
+	if (!song.tag.duration.IsNegative())
+		total_duration -= song.tag.duration;
+
+	for (const auto &item : song.tag) {
+		auto &map = maps[item.type];
+		auto i = map.find(item.value);
+		if (i == map.end())
+			/* already removed (duplicate value) */
+			continue;
+
+		auto &list = i->second.songs;
+		auto j = std::find(list.begin(), list.end(), &song);
+		if (j == list.end())
+			continue;
+
+		/* the order is irrelevant, so swap with the last
+		   element instead of shifting */
+		*j = list.back();
+		list.pop_back();
+
+		if (list.empty())
+			map.erase(i);
+	}
+}
+
+void
+TagIndex::Clear()
+{
+	for (auto &map : maps)
+		map.clear();
+
+	song_count = 0;
+	total_duration = total_duration.zero();
+}
+
+void
+TagIndex::GetStats(DatabaseStats &stats) const
+{
+	stats.song_count = song_count;
+	stats.total_duration = total_duration;
+	stats.artist_count = maps[TAG_ARTIST].size();
+	stats.album_count = maps[TAG_ALBUM].size();
+}
+
+bool
+TagIndex::CanLookup(const SongFilter::Item &item)
+{
+	/* an empty value matches songs which do not have the tag,
+	   and those are not in the index */
+	return (item.GetTag() < TAG_NUM_OF_ITEM_TYPES ||
+		item.GetTag() == LOCATE_TAG_ANY_TYPE) &&
+		*item.GetValue() != 0;
+}
+
+inline void
+TagIndex::Lookup(TagType type, const SongFilter::Item &item,
+		 std::vector<const Song *> &result) const
+{
+	const auto &map = maps[type];
+
+	if (item.GetFoldCase()) {
+		/* substring search: check each distinct value
+		   instead of each song, and fold it only once */
+		for (const auto &i : map) {
+			const Entry &entry = i.second;
+			if (entry.folded.IsNull())
+				entry.folded = IcuCaseFold(i.first.c_str());
+
+			if (item.FoldedStringMatch(entry.folded.c_str()))
+				result.insert(result.end(),
+					      entry.songs.begin(),
+					      entry.songs.end());
+		}
+	} else {
+		auto i = map.find(item.GetValue());
+		if (i != map.end())
+			result.insert(result.end(),
+				      i->second.songs.begin(),
+				      i->second.songs.end());
+	}
+}
+
+void
+TagIndex::Lookup(const SongFilter::Item &item,
+		 std::vector<const Song *> &result) const
+{
+	assert(CanLookup(item));
+
+	const unsigned tag = item.GetTag();
+	if (tag == LOCATE_TAG_ANY_TYPE) {
+		for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i)
+			Lookup(TagType(i), item, result);
+		return;
+	}
+
+	Lookup(TagType(tag), item, result);
+
+	if (tag == TAG_ALBUM_ARTIST)
+		/* SongFilter falls back to "artist" if there is no
+		   "album artist" */
+		Lookup(TAG_ARTIST, item, result);
+}
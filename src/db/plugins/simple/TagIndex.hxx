@@ -0,0 +1,111 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_TAG_INDEX_HXX
+#define MPD_TAG_INDEX_HXX
+
+#include "check.h"
+#include "tag/TagType.h"
+#include "SongFilter.hxx"
+#include "Chrono.hxx"
+#include "util/AllocatedString.hxx"
+#include "Compiler.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+struct Song;
+struct DatabaseStats;
+
+/**
+ * An inverted index which maps tag values to the songs which have
+ * them.  It is owned by #SimpleDatabase and kept up to date by the
+ * #Directory methods which add, remove or modify songs.
+ *
+ * Each distinct value is stored together with its case-folded form,
+ * so case-insensitive searches do not need to fold each value again.
+ *
+ * Since it sees every song, it also maintains the counters for
+ * #DatabaseStats, so "stats" does not need to walk the tree.
+ *
+ * All methods must be called with the #db_mutex locked.
+ */
+class TagIndex {
+	typedef std::vector<const Song *> PostingList;
+
+	struct Entry {
+		/**
+		 * The value passed through IcuCaseFold().  It is
+		 * calculated by the first case-insensitive Lookup()
+		 * (which is safe because the caller holds the
+		 * #db_mutex); until then, it is nullptr.  This is
+		 * not a std::string, which would add 24 bytes to each
+		 * distinct value.
+		 */
+		mutable AllocatedString<> folded = nullptr;
+
+		PostingList songs;
+	};
+
+	typedef std::unordered_map<std::string, Entry> Map;
+	typedef std::chrono::duration<std::uint64_t, SongTime::period> Duration;
+
+	Map maps[TAG_NUM_OF_ITEM_TYPES];
+
+	unsigned song_count = 0;
+
+	Duration total_duration = Duration::zero();
+
+public:
+	void Add(const Song &song);
+	void Remove(const Song &song);
+
+	void Clear();
+
+	/**
+	 * Fill the #DatabaseStats for the whole index.
+	 */
+	void GetStats(DatabaseStats &stats) const;
+
+	/**
+	 * Determine whether the given filter item can be answered
+	 * from the index: an exact match or a case-insensitive
+	 * substring match on a tag value.
+	 */
+	gcc_pure
+	static bool CanLookup(const SongFilter::Item &item);
+
+	/**
+	 * Append all songs which may match the given filter item to
+	 * the given vector.  The result is a superset of the songs
+	 * which match (and may contain duplicates); the caller must
+	 * check them with SongFilter::Item::Match().
+	 *
+	 * Must be called only if CanLookup() returned true.
+	 */
+	void Lookup(const SongFilter::Item &item,
+		    std::vector<const Song *> &result) const;
+
+private:
+	void Lookup(TagType type, const SongFilter::Item &item,
+		    std::vector<const Song *> &result) const;
+};
+
+#endif
@@ -28,9 +28,22 @@
 #include "util/RuntimeError.hxx"
 #include "util/Error.hxx"
 #include "util/ScopeExit.hxx"
+#include "thread/Thread.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <memory>
 
 #include <stdio.h>
 
+/**
+ * The maximum number of "Browse" requests which
+ * ContentDirectoryService::readDir() sends to one server at a time.
+ */
+static constexpr unsigned MAX_PARALLEL_SLICES = 4;
+
 static void
 ReadResultTag(UPnPDirContent &dirbuf, IXML_Document *response)
 {
@@ -87,6 +100,49 @@ ContentDirectoryService::readDirSlice(UpnpClient_Handle hdl,
 	ReadResultTag(dirbuf, response);
 }
 
+namespace {
+
+/**
+ * A contiguous range of a container, read by one thread.
+ */
+struct DirSliceJob {
+	const ContentDirectoryService *service;
+	UpnpClient_Handle handle;
+	const char *object_id;
+
+	unsigned offset, end, slice_size;
+
+	UPnPDirContent result;
+
+	std::exception_ptr error;
+
+	Thread thread;
+
+	void Run() {
+		try {
+			while (offset < end) {
+				unsigned count, total;
+				service->readDirSlice(handle, object_id, offset,
+						      std::min(slice_size,
+							       end - offset),
+						      result, count, total);
+				if (count == 0)
+					break;
+
+				offset += count;
+			}
+		} catch (...) {
+			error = std::current_exception();
+		}
+	}
+
+	static void Run(void *ctx) {
+		((DirSliceJob *)ctx)->Run();
+	}
+};
+
+}
+
 UPnPDirContent
 ContentDirectoryService::readDir(UpnpClient_Handle handle,
 				 const char *objectId) const
@@ -94,12 +150,77 @@ ContentDirectoryService::readDir(UpnpClient_Handle handle,
 	UPnPDirContent dirbuf;
 	unsigned offset = 0, total = -1, count;
 
-	do {
-		readDirSlice(handle, objectId, offset, m_rdreqcnt, dirbuf,
-			     count, total);
+	/* the first slice tells us how large the container is */
+	readDirSlice(handle, objectId, offset, m_rdreqcnt, dirbuf,
+		     count, total);
+	offset += count;
 
-		offset += count;
-	} while (count > 0 && offset < total);
+	if (count == 0 || offset >= total)
+		return dirbuf;
+
+	if (total == unsigned(-1)) {
+		/* the server did not report the size; read
+		   sequentially until it has nothing left */
+		do {
+			readDirSlice(handle, objectId, offset, m_rdreqcnt,
+				     dirbuf, count, total);
+			offset += count;
+		} while (count > 0 && offset < total);
+
+		return dirbuf;
+	}
+
+	/* split the rest into ranges which are read in parallel;
+	   the server may return fewer entries than requested, so
+	   use the size of the first slice */
+
+	const unsigned slice_size = count;
+	const unsigned remaining = total - offset;
+	const unsigned n_jobs =
+		std::min(MAX_PARALLEL_SLICES,
+			 (remaining + slice_size - 1) / slice_size);
+	const unsigned per_job =
+		((remaining + n_jobs - 1) / n_jobs + slice_size - 1)
+		/ slice_size * slice_size;
+
+	std::unique_ptr<DirSliceJob[]> jobs(new DirSliceJob[n_jobs]);
+	for (unsigned i = 0; i < n_jobs; ++i) {
+		auto &job = jobs[i];
+		job.service = this;
+		job.handle = handle;
+		job.object_id = objectId;
+		job.offset = std::min(offset + i * per_job, total);
+		job.end = std::min(job.offset + per_job, total);
+		job.slice_size = slice_size;
+	}
+
+	/* the calling thread reads the first range itself */
+
+	for (unsigned i = 1; i < n_jobs; ++i) {
+		auto &job = jobs[i];
+
+		Error error;
+		if (!job.thread.Start(DirSliceJob::Run, &job, error)) {
+			LogError(error);
+			job.Run();
+		}
+	}
+
+	jobs[0].Run();
+
+	for (unsigned i = 1; i < n_jobs; ++i)
+		if (jobs[i].thread.IsDefined())
+			jobs[i].thread.Join();
+
+	for (unsigned i = 0; i < n_jobs; ++i) {
+		auto &job = jobs[i];
+		if (job.error)
+			std::rethrow_exception(job.error);
+
+		dirbuf.objects.insert(dirbuf.objects.end(),
+				      std::make_move_iterator(job.result.objects.begin()),
+				      std::make_move_iterator(job.result.objects.end()));
+	}
 
 	return dirbuf;
 }
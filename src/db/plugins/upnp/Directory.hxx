@@ -41,6 +41,8 @@ public:
 
 	~UPnPDirContent();
 
+	UPnPDirContent &operator=(UPnPDirContent &&) = default;
+
 	gcc_pure
 	UPnPDirObject *FindObject(const char *name) {
 		for (auto &o : objects)
@@ -50,6 +52,15 @@ public:
 		return nullptr;
 	}
 
+	gcc_pure
+	const UPnPDirObject *FindObject(const char *name) const {
+		for (const auto &o : objects)
+			if (o.name == name)
+				return &o;
+
+		return nullptr;
+	}
+
 	/**
 	 * Parse from DIDL-Lite XML data.
 	 *
@@ -33,6 +33,9 @@
 #include "db/LightSong.hxx"
 #include "db/Stats.hxx"
 #include "config/Block.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Thread.hxx"
+#include "system/Clock.hxx"
 #include "tag/TagBuilder.hxx"
 #include "tag/TagTable.hxx"
 #include "util/Error.hxx"
@@ -44,10 +47,15 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <map>
+#include <memory>
+#include <exception>
 
 #include <assert.h>
 #include <string.h>
 
+static constexpr Domain upnp_db_domain("upnp_db");
+
 static const char *const rootid = "0";
 
 class UpnpSong : public LightSong {
@@ -66,6 +74,8 @@ public:
 		tag = &tag2;
 		mtime = 0;
 		start_time = end_time = SongTime::zero();
+		mix_ramp = nullptr;
+		replay_gain = nullptr;
 	}
 };
 
@@ -73,6 +83,56 @@ class UpnpDatabase : public Database {
 	UpnpClient_Handle handle;
 	UPnPDeviceDirectory *discovery;
 
+	/**
+	 * How many seconds may cached data of a server be used
+	 * without checking its "SystemUpdateID"?  0 disables the
+	 * cache.
+	 */
+	unsigned cache_ttl;
+
+	/**
+	 * Cached responses of one server.
+	 */
+	struct ServerCache {
+		/**
+		 * The "SystemUpdateID" of the server when the cache
+		 * was last validated.
+		 */
+		unsigned update_id = 0;
+
+		/**
+		 * When to validate the cache again (see
+		 * MonotonicClockS()).
+		 */
+		unsigned expires = 0;
+
+		/**
+		 * "Browse" results by object id.
+		 */
+		std::map<std::string,
+			 std::shared_ptr<const UPnPDirContent>> directories;
+
+		/**
+		 * The search capabilities; only valid if
+		 * #have_search_caps is set.
+		 */
+		std::list<std::string> search_caps;
+		bool have_search_caps = false;
+	};
+
+	/**
+	 * Protects #cache, which is also accessed by the threads
+	 * which search several servers in parallel.
+	 */
+	mutable Mutex cache_mutex;
+
+	/**
+	 * Indexed by ContentDirectoryService::GetURI().
+	 */
+	mutable std::map<std::string, ServerCache> cache;
+
+	struct SearchJob;
+
 public:
 	UpnpDatabase():Database(upnp_db_plugin) {}
 
@@ -107,6 +167,22 @@ protected:
 	bool Configure(const ConfigBlock &block, Error &error);
 
 private:
+	/**
+	 * Discard the cached data of the server if its TTL has
+	 * expired and its "SystemUpdateID" has changed meanwhile.
+	 */
+	void ValidateCache(const ContentDirectoryService &server) const;
+
+	/**
+	 * Read a container's children, from the cache if possible.
+	 */
+	std::shared_ptr<const UPnPDirContent>
+	ReadDir(const ContentDirectoryService &server,
+		const char *objid) const;
+
+	std::list<std::string>
+	GetSearchCapabilities(const ContentDirectoryService &server) const;
+
 	bool VisitServer(const ContentDirectoryService &server,
 			 const std::list<std::string> &vpath,
 			 const DatabaseSelection &selection,
@@ -129,6 +205,21 @@ private:
 				   const char *objid,
 				   const DatabaseSelection &selection) const;
 
+	/**
+	 * Run the same UPnP search on all servers in parallel.
+	 *
+	 * @return the results, in the order of #servers
+	 */
+	std::vector<UPnPDirContent>
+	SearchServers(const std::vector<ContentDirectoryService> &servers,
+		      const DatabaseSelection &selection) const;
+
+	bool VisitSearchResults(const ContentDirectoryService &server,
+				UPnPDirContent &&results,
+				const DatabaseSelection &selection,
+				VisitSong visit_song,
+				Error &error) const;
+
 	UPnPDirObject Namei(const ContentDirectoryService &server,
 			    const std::list<std::string> &vpath) const;
 
@@ -162,8 +253,9 @@ UpnpDatabase::Create(gcc_unused EventLoop &loop,
 }
 
 inline bool
-UpnpDatabase::Configure(const ConfigBlock &, Error &)
+UpnpDatabase::Configure(const ConfigBlock &block, Error &)
 {
+	cache_ttl = block.GetBlockValue("cache_ttl", 60u);
 	return true;
 }
 
@@ -185,10 +277,102 @@ UpnpDatabase::Open()
 void
 UpnpDatabase::Close()
 {
+	cache.clear();
+
 	delete discovery;
 	UpnpClientGlobalFinish();
 }
 
+void
+UpnpDatabase::ValidateCache(const ContentDirectoryService &server) const
+{
+	const std::string uri = server.GetURI();
+	const unsigned now = MonotonicClockS();
+
+	{
+		const ScopeLock protect(cache_mutex);
+		if (now < cache[uri].expires)
+			return;
+	}
+
+	/* ask the server whether anything has changed; this is
+	   much cheaper than browsing again */
+	unsigned update_id = 0;
+	bool have_update_id = false;
+	try {
+		update_id = server.getSystemUpdateID(handle);
+		have_update_id = true;
+	} catch (const std::runtime_error &e) {
+		/* without the "SystemUpdateID", this is just a plain
+		   TTL cache */
+		FormatDebug(upnp_db_domain, "GetSystemUpdateID failed: %s",
+			    e.what());
+	}
+
+	const ScopeLock protect(cache_mutex);
+	auto &c = cache[uri];
+	if (!have_update_id || update_id != c.update_id) {
+		c.directories.clear();
+		c.search_caps.clear();
+		c.have_search_caps = false;
+		c.update_id = update_id;
+	}
+
+	c.expires = now + cache_ttl;
+}
+
+std::shared_ptr<const UPnPDirContent>
+UpnpDatabase::ReadDir(const ContentDirectoryService &server,
+		      const char *objid) const
+{
+	if (cache_ttl == 0)
+		return std::make_shared<const UPnPDirContent>(server.readDir(handle, objid));
+
+	ValidateCache(server);
+
+	const std::string uri = server.GetURI();
+
+	{
+		const ScopeLock protect(cache_mutex);
+		const auto &directories = cache[uri].directories;
+		auto i = directories.find(objid);
+		if (i != directories.end())
+			return i->second;
+	}
+
+	auto content = std::make_shared<const UPnPDirContent>(server.readDir(handle, objid));
+
+	const ScopeLock protect(cache_mutex);
+	cache[uri].directories[objid] = content;
+	return content;
+}
+
+std::list<std::string>
+UpnpDatabase::GetSearchCapabilities(const ContentDirectoryService &server) const
+{
+	if (cache_ttl == 0)
+		return server.getSearchCapabilities(handle);
+
+	ValidateCache(server);
+
+	const std::string uri = server.GetURI();
+
+	{
+		const ScopeLock protect(cache_mutex);
+		const auto &c = cache[uri];
+		if (c.have_search_caps)
+			return c.search_caps;
+	}
+
+	auto search_caps = server.getSearchCapabilities(handle);
+
+	const ScopeLock protect(cache_mutex);
+	auto &c = cache[uri];
+	c.search_caps = search_caps;
+	c.have_search_caps = true;
+	return search_caps;
+}
+
 void
 UpnpDatabase::ReturnSong(const LightSong *_song) const
 {
@@ -255,7 +439,7 @@ UpnpDatabase::SearchSongs(const ContentDirectoryService &server,
 	if (selection.filter == nullptr)
 		return UPnPDirContent();
 
-	const auto searchcaps = server.getSearchCapabilities(handle);
+	const auto searchcaps = GetSearchCapabilities(server);
 	if (searchcaps.empty())
 		return UPnPDirContent();
 
@@ -338,6 +522,8 @@ visitSong(const UPnPDirObject &meta, const char *path,
 	song.tag = &meta.tag;
 	song.mtime = 0;
 	song.start_time = song.end_time = SongTime::zero();
+	song.mix_ramp = nullptr;
+	song.replay_gain = nullptr;
 
 	return !selection.Match(song) || visit_song(song, error);
 }
@@ -354,6 +540,79 @@ songPath(const std::string &servername,
 	return servername + "/" + rootid + "/" + objid;
 }
 
+/**
+ * Runs UpnpDatabase::SearchSongs() for one server in its own thread.
+ */
+struct UpnpDatabase::SearchJob {
+	const UpnpDatabase *db;
+	const ContentDirectoryService *server;
+	const DatabaseSelection *selection;
+
+	UPnPDirContent result;
+
+	std::exception_ptr error;
+
+	Thread thread;
+
+	void Run() {
+		try {
+			result = db->SearchSongs(*server, rootid, *selection);
+		} catch (...) {
+			error = std::current_exception();
+		}
+	}
+
+	static void Run(void *ctx) {
+		((SearchJob *)ctx)->Run();
+	}
+};
+
+std::vector<UPnPDirContent>
+UpnpDatabase::SearchServers(const std::vector<ContentDirectoryService> &servers,
+			    const DatabaseSelection &selection) const
+{
+	const size_t n = servers.size();
+	std::unique_ptr<SearchJob[]> jobs(new SearchJob[n]);
+
+	for (size_t i = 0; i < n; ++i) {
+		auto &job = jobs[i];
+		job.db = this;
+		job.server = &servers[i];
+		job.selection = &selection;
+	}
+
+	/* the calling thread searches the first server itself */
+
+	for (size_t i = 1; i < n; ++i) {
+		auto &job = jobs[i];
+
+		Error error;
+		if (!job.thread.Start(SearchJob::Run, &job, error)) {
+			LogError(error);
+			job.Run();
+		}
+	}
+
+	if (n > 0)
+		jobs[0].Run();
+
+	for (size_t i = 1; i < n; ++i)
+		if (jobs[i].thread.IsDefined())
+			jobs[i].thread.Join();
+
+	std::vector<UPnPDirContent> results;
+	results.reserve(n);
+
+	for (size_t i = 0; i < n; ++i) {
+		if (jobs[i].error)
+			std::rethrow_exception(jobs[i].error);
+
+		results.emplace_back(std::move(jobs[i].result));
+	}
+
+	return results;
+}
+
 bool
 UpnpDatabase::SearchSongs(const ContentDirectoryService &server,
 			  const char *objid,
@@ -364,7 +623,18 @@ UpnpDatabase::SearchSongs(const ContentDirectoryService &server,
 	if (!visit_song)
 		return true;
 
-	for (auto &dirent : SearchSongs(server, objid, selection).objects) {
+	return VisitSearchResults(server, SearchSongs(server, objid, selection),
+				  selection, visit_song, error);
+}
+
+bool
+UpnpDatabase::VisitSearchResults(const ContentDirectoryService &server,
+				 UPnPDirContent &&results,
+				 const DatabaseSelection &selection,
+				 VisitSong visit_song,
+				 Error &error) const
+{
+	for (auto &dirent : results.objects) {
 		if (dirent.type != UPnPDirObject::Type::ITEM ||
 		    dirent.item_class != UPnPDirObject::ItemClass::MUSIC)
 			continue;
@@ -428,6 +698,23 @@ UpnpDatabase::BuildPath(const ContentDirectoryService &server,
 				     path.c_str());
 }
 
+/**
+ * Duplicate an object which is owned by the cache.
+ */
+static UPnPDirObject
+CopyObject(const UPnPDirObject &src)
+{
+	UPnPDirObject dest;
+	dest.id = src.id;
+	dest.parent_id = src.parent_id;
+	dest.url = src.url;
+	dest.name = src.name;
+	dest.type = src.type;
+	dest.item_class = src.item_class;
+	dest.tag = Tag(src.tag);
+	return dest;
+}
+
 // Take server and internal title pathname and return objid and metadata.
 UPnPDirObject
 UpnpDatabase::Namei(const ContentDirectoryService &server,
@@ -441,22 +728,22 @@ UpnpDatabase::Namei(const ContentDirectoryService &server,
 
 	// Walk the path elements, read each directory and try to find the next one
 	for (auto i = vpath.begin(), last = std::prev(vpath.end());; ++i) {
-		auto dirbuf = server.readDir(handle, objid.c_str());
+		const auto dirbuf = ReadDir(server, objid.c_str());
 
 		// Look for the name in the sub-container list
-		UPnPDirObject *child = dirbuf.FindObject(i->c_str());
+		const UPnPDirObject *child = dirbuf->FindObject(i->c_str());
 		if (child == nullptr)
 			throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
 					    "No such object");
 
 		if (i == last)
-			return std::move(*child);
+			return CopyObject(*child);
 
 		if (child->type != UPnPDirObject::Type::CONTAINER)
 			throw DatabaseError(DatabaseErrorCode::NOT_FOUND,
 					    "Not a container");
 
-		objid = std::move(child->id);
+		objid = child->id;
 	}
 }
 
@@ -596,7 +883,8 @@ UpnpDatabase::VisitServer(const ContentDirectoryService &server,
 	/* Target was a a container. Visit it. We could read slices
 	   and loop here, but it's not useful as mpd will only return
 	   data to the client when we're done anyway. */
-	for (const auto &dirent : server.readDir(handle, tdirent.id.c_str()).objects) {
+	const auto dirbuf = ReadDir(server, tdirent.id.c_str());
+	for (const auto &dirent : dirbuf->objects) {
 		const std::string uri = PathTraitsUTF8::Build(base_uri,
 							      dirent.name.c_str());
 		if (!VisitObject(dirent, uri.c_str(),
@@ -620,17 +908,35 @@ UpnpDatabase::Visit(const DatabaseSelection &selection,
 {
 	auto vpath = stringToTokens(selection.uri, "/", true);
 	if (vpath.empty()) {
-		for (const auto &server : discovery->GetDirectories()) {
+		const auto servers = discovery->GetDirectories();
+
+		/* a recursive search on all servers: don't wait for
+		   one server after the other */
+		std::vector<UPnPDirContent> results;
+		if (selection.recursive && selection.filter != nullptr &&
+		    visit_song)
+			results = SearchServers(servers, selection);
+
+		for (size_t i = 0; i < servers.size(); ++i) {
+			const auto &server = servers[i];
+
 			if (visit_directory) {
 				const LightDirectory d(server.getFriendlyName(), 0);
 				if (!visit_directory(d, error))
 					return false;
 			}
 
-			if (selection.recursive &&
-			    !VisitServer(server, vpath, selection,
-					 visit_directory, visit_song, visit_playlist,
-					 error))
+			if (!results.empty()) {
+				if (!VisitSearchResults(server,
+							std::move(results[i]),
+							selection, visit_song,
+							error))
+					return false;
+			} else if (selection.recursive &&
+				   !VisitServer(server, vpath, selection,
+						visit_directory, visit_song,
+						visit_playlist,
+						error))
 				return false;
 		}
 
@@ -658,9 +964,8 @@ UpnpDatabase::VisitUniqueTags(const DatabaseSelection &selection,
 		return true;
 
 	std::set<std::string> values;
-	for (auto& server : discovery->GetDirectories()) {
-		const auto dirbuf = SearchSongs(server, rootid, selection);
-
+	for (const auto &dirbuf : SearchServers(discovery->GetDirectories(),
+						selection)) {
 		for (const auto &dirent : dirbuf.objects) {
 			if (dirent.type != UPnPDirObject::Type::ITEM ||
 			    dirent.item_class != UPnPDirObject::ItemClass::MUSIC)
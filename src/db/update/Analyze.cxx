@@ -0,0 +1,160 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Analyze.hxx"
+#include "UpdateDomain.hxx"
+#include "decoder/DecoderControl.hxx"
+#include "decoder/DecoderThread.hxx"
+#include "pcm/MixRampAnalyzer.hxx"
+#include "pcm/LoudnessAnalyzer.hxx"
+#include "MusicBuffer.hxx"
+#include "MusicPipe.hxx"
+#include "MusicChunk.hxx"
+#include "DetachedSong.hxx"
+#include "MixRampInfo.hxx"
+#include "ReplayGainInfo.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/FastCond.hxx"
+#include "util/ConstBuffer.hxx"
+#include "Log.hxx"
+
+#include <memory>
+
+#include <assert.h>
+
+/**
+ * The number of chunks in the private #MusicBuffer.  The chunks are
+ * consumed as soon as they arrive, so a small buffer is enough.
+ */
+static constexpr unsigned ANALYZE_BUFFER_CHUNKS = 64;
+
+bool
+AnalyzeSong(const char *uri, SongTime start_time, SongTime end_time,
+	    const volatile bool &cancel,
+	    MixRampInfo *mix_ramp, ReplayGainTuple *loudness)
+{
+	assert(mix_ramp != nullptr || loudness != nullptr);
+
+	if (loudness != nullptr)
+		loudness->Clear();
+
+	Mutex mutex;
+	FastCond cond;
+	DecoderControl dc(mutex, cond);
+	decoder_thread_start(dc);
+
+	MusicBuffer buffer(ANALYZE_BUFFER_CHUNKS, CHUNK_SIZE);
+	MusicPipe pipe(buffer.GetSize());
+
+	dc.Start(new DetachedSong(uri), start_time, end_time, buffer, pipe);
+
+	std::unique_ptr<MixRampAnalyzer> mixramp_analyzer;
+	std::unique_ptr<LoudnessAnalyzer> loudness_analyzer;
+	bool started = false, success = false;
+
+	mutex.lock();
+
+	while (!cancel) {
+		MusicChunk *chunk = pipe.Shift();
+		if (chunk == nullptr) {
+			if (dc.IsIdle()) {
+				success = dc.state == DecoderState::STOP &&
+					started;
+				break;
+			}
+
+			dc.WaitForDecoder();
+			continue;
+		}
+
+		if (!started) {
+			/* the decoder has set the format before it
+			   pushed the first chunk */
+			const AudioFormat format = dc.out_audio_format;
+			if (!MixRampAnalyzer::CanAnalyze(format) ||
+			    !LoudnessAnalyzer::CanAnalyze(format)) {
+				FormatDebug(update_domain,
+					    "cannot analyze the format of %s",
+					    uri);
+				buffer.Return(chunk);
+				break;
+			}
+
+			started = true;
+
+			if (mix_ramp != nullptr)
+				mixramp_analyzer.reset(new MixRampAnalyzer(format));
+
+			if (loudness != nullptr)
+				loudness_analyzer.reset(new LoudnessAnalyzer(format));
+		}
+
+		if (loudness_analyzer != nullptr &&
+		    chunk->replay_gain_serial != 0 &&
+		    chunk->replay_gain_info.IsDefined()) {
+			/* the file has ReplayGain tags; don't waste
+			   time measuring it */
+			loudness_analyzer.reset();
+
+			if (mixramp_analyzer == nullptr) {
+				buffer.Return(chunk);
+				success = true;
+				break;
+			}
+		}
+
+		mutex.unlock();
+
+		if (chunk->length > 0) {
+			const ConstBuffer<void> data(chunk->data,
+						     chunk->length);
+
+			if (mixramp_analyzer != nullptr)
+				mixramp_analyzer->Feed(data);
+
+			if (loudness_analyzer != nullptr)
+				loudness_analyzer->Feed(data);
+		}
+
+		buffer.Return(chunk);
+
+		mutex.lock();
+
+		/* wake up the decoder if it is waiting for a free
+		   chunk */
+		dc.Signal();
+	}
+
+	mutex.unlock();
+
+	if (success) {
+		if (mixramp_analyzer != nullptr)
+			*mix_ramp = mixramp_analyzer->Finish();
+
+		if (loudness_analyzer != nullptr)
+			*loudness = loudness_analyzer->Finish();
+	}
+
+	dc.Stop();
+	pipe.Clear(buffer);
+	dc.Quit();
+
+	return success;
+}
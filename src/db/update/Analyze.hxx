@@ -0,0 +1,53 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_UPDATE_ANALYZE_HXX
+#define MPD_UPDATE_ANALYZE_HXX
+
+#include "check.h"
+#include "Chrono.hxx"
+
+class MixRampInfo;
+struct ReplayGainTuple;
+
+/**
+ * Decode the specified song completely and calculate its MixRamp
+ * envelopes (see #MixRampAnalyzer) and/or its loudness (see
+ * #LoudnessAnalyzer).  Both analyses share one decoder pass.  This
+ * runs a private decoder thread and blocks until it has finished.
+ *
+ * @param uri the URI or the absolute path of the song file
+ * @param start_time the start of the sub-song within the file
+ * @param end_time the end of the sub-song; zero means end of file
+ * @param cancel a flag which is polled; if it becomes true, the
+ * analysis is aborted
+ * @param mix_ramp if not nullptr, the MixRamp data is stored here
+ * @param loudness if not nullptr, the track gain and peak are
+ * stored here; it remains undefined if the decoder finds ReplayGain
+ * tags in the file, because those take precedence during playback
+ * anyway
+ * @return true on success, false on error (already logged) or if
+ * the analysis was cancelled
+ */
+bool
+AnalyzeSong(const char *uri, SongTime start_time, SongTime end_time,
+	    const volatile bool &cancel,
+	    MixRampInfo *mix_ramp, ReplayGainTuple *loudness);
+
+#endif
@@ -20,6 +20,7 @@
 #include "config.h" /* must be first for large file support */
 #include "Walk.hxx"
 #include "UpdateDomain.hxx"
+#include "ScanPool.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/plugins/simple/Directory.hxx"
 #include "db/plugins/simple/Song.hxx"
@@ -60,8 +61,52 @@ LockFindSong(Directory &directory, const char *name)
 }
 
 void
-UpdateWalk::UpdateArchiveTree(ArchiveFile &archive, Directory &directory,
-			      const char *name)
+UpdateWalk::UpdateArchiveSong(ArchiveFile &archive, Path archive_path,
+			      Directory &directory, const char *name,
+			      const char *entry)
+{
+	Song *song = LockFindSong(directory, name);
+
+	if (scan_pool != nullptr) {
+		const bool is_new = song == nullptr;
+		if (is_new)
+			song = Song::NewFile(name, directory);
+
+		auto *job = new UpdateScanJob(directory, *song, is_new,
+					      archive.plugin,
+					      AllocatedPath(archive_path),
+					      entry);
+		scan_pool->Push(*job);
+		FinishScans(false);
+		return;
+	}
+
+	if (song == nullptr) {
+		song = Song::LoadFromArchive(archive, name, directory);
+		if (song != nullptr) {
+			{
+				const ScopeDatabaseLock protect;
+				directory.AddSong(song);
+			}
+
+			modified = true;
+			FormatDefault(update_domain, "added %s/%s",
+				      directory.GetPath().c_str(), name);
+		}
+	} else {
+		if (!song->UpdateFileInArchive(archive)) {
+			FormatDebug(update_domain,
+				    "deleting unrecognized file %s/%s",
+				    directory.GetPath().c_str(), name);
+			editor.LockDeleteSong(directory, song);
+		}
+	}
+}
+
+void
+UpdateWalk::UpdateArchiveTree(ArchiveFile &archive, Path archive_path,
+			      Directory &directory, const char *name,
+			      const char *entry)
 {
 	const char *tmp = strchr(name, '/');
 	if (tmp) {
@@ -72,7 +117,8 @@ UpdateWalk::UpdateArchiveTree(ArchiveFile &archive, Directory &directory,
 		subdir->device = DEVICE_INARCHIVE;
 
 		//create directories first
-		UpdateArchiveTree(archive, *subdir, tmp + 1);
+		UpdateArchiveTree(archive, archive_path, *subdir, tmp + 1,
+				  entry);
 	} else {
 		if (StringIsEmpty(name)) {
 			LogWarning(update_domain,
@@ -81,44 +127,28 @@ UpdateWalk::UpdateArchiveTree(ArchiveFile &archive, Directory &directory,
 		}
 
 		//add file
-		Song *song = LockFindSong(directory, name);
-		if (song == nullptr) {
-			song = Song::LoadFromArchive(archive, name, directory);
-			if (song != nullptr) {
-				{
-					const ScopeDatabaseLock protect;
-					directory.AddSong(song);
-				}
-
-				modified = true;
-				FormatDefault(update_domain, "added %s/%s",
-					      directory.GetPath(), name);
-			}
-		} else {
-			if (!song->UpdateFileInArchive(archive)) {
-				FormatDebug(update_domain,
-					    "deleting unrecognized file %s/%s",
-					    directory.GetPath(), name);
-				editor.LockDeleteSong(directory, song);
-			}
-		}
+		UpdateArchiveSong(archive, archive_path, directory, name,
+				  entry);
 	}
 }
 
 class UpdateArchiveVisitor final : public ArchiveVisitor {
 	UpdateWalk &walk;
 	ArchiveFile &archive;
+	const Path archive_path;
 	Directory *directory;
 
  public:
 	UpdateArchiveVisitor(UpdateWalk &_walk, ArchiveFile &_archive,
-			     Directory *_directory)
-		:walk(_walk), archive(_archive), directory(_directory) {}
+			     Path _archive_path, Directory *_directory)
+		:walk(_walk), archive(_archive),
+		 archive_path(_archive_path), directory(_directory) {}
 
 	virtual void VisitArchiveEntry(const char *path_utf8) override {
 		FormatDebug(update_domain,
 			    "adding archive file: %s", path_utf8);
-		walk.UpdateArchiveTree(archive, *directory, path_utf8);
+		walk.UpdateArchiveTree(archive, archive_path, *directory,
+				       path_utf8, path_utf8);
 	}
 };
 
@@ -143,7 +173,7 @@ UpdateWalk::UpdateArchiveFile(Directory &parent, const char *name,
 		   changed since - don't consider updating it */
 		return;
 
-	const auto path_fs = storage.MapChildFS(parent.GetPath(), name);
+	const auto path_fs = storage.MapChildFS(parent.GetPath().c_str(), name);
 	if (path_fs.IsNull())
 		/* not a local file: skip, because the archive API
 		   supports only local files */
@@ -172,9 +202,13 @@ UpdateWalk::UpdateArchiveFile(Directory &parent, const char *name,
 		directory->device = DEVICE_INARCHIVE;
 	}
 
-	directory->mtime = info.mtime;
+	if (directory->mtime != info.mtime) {
+		const ScopeDatabaseLock protect;
+		directory->mtime = info.mtime;
+		directory->MarkModified();
+	}
 
-	UpdateArchiveVisitor visitor(*this, *file, directory);
+	UpdateArchiveVisitor visitor(*this, *file, path_fs, directory);
 	file->Visit(visitor);
 	file->Close();
 }
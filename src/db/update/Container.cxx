@@ -58,20 +58,14 @@ UpdateWalk::MakeDirectoryIfModified(Directory &parent, const char *name,
 	return directory;
 }
 
-static bool
-SupportsContainerSuffix(const DecoderPlugin &plugin, const char *suffix)
-{
-	return plugin.container_scan != nullptr &&
-		plugin.SupportsSuffix(suffix);
-}
-
 bool
 UpdateWalk::UpdateContainerFile(Directory &directory,
 				const char *name, const char *suffix,
 				const StorageFileInfo &info)
 {
-	const DecoderPlugin *_plugin = decoder_plugins_find([suffix](const DecoderPlugin &plugin){
-			return SupportsContainerSuffix(plugin, suffix);
+	const DecoderPlugin *_plugin = decoder_plugins_find_suffix(suffix,
+								   [](const DecoderPlugin &plugin){
+			return plugin.container_scan != nullptr;
 		});
 	if (_plugin == nullptr)
 		return false;
@@ -88,7 +82,7 @@ UpdateWalk::UpdateContainerFile(Directory &directory,
 		contdir->device = DEVICE_CONTAINER;
 	}
 
-	const auto pathname = storage.MapFS(contdir->GetPath());
+	const auto pathname = storage.MapFS(contdir->GetPath().c_str());
 	if (pathname.IsNull()) {
 		/* not a local file: skip, because the container API
 		   supports only local files */
@@ -123,7 +117,7 @@ UpdateWalk::UpdateContainerFile(Directory &directory,
 		modified = true;
 
 		FormatDefault(update_domain, "added %s/%s",
-			      directory.GetPath(), vtrack.c_str());
+			      directory.GetPath().c_str(), vtrack.c_str());
 	}
 
 	if (tnum == 1) {
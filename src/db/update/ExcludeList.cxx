@@ -66,6 +66,89 @@ try {
 	return false;
 }
 
+#ifdef HAVE_CLASS_GLOB
+
+void
+ExcludeList::Compiled::Add(const Glob &glob)
+{
+#ifdef HAVE_FNMATCH
+	/* without flags, fnmatch() treats '/' and leading dots like
+	   all other characters, so these simple forms can be
+	   matched with string comparisons */
+	static constexpr char wildcards[] = "*?[\\";
+
+	const char *p = glob.GetPattern();
+	const char *w = strpbrk(p, wildcards);
+	if (w == nullptr) {
+		literals.emplace(p);
+		return;
+	}
+
+	if (w == p && strpbrk(p + 1, wildcards) == nullptr) {
+		suffixes.emplace_back(p + 1);
+		return;
+	}
+
+	if (w[0] == '*' && w[1] == 0) {
+		prefixes.emplace_back(p, w);
+		return;
+	}
+#endif
+
+	/* PathMatchSpec() on Windows is case insensitive, so use it
+	   for everything there */
+	globs.push_back(&glob);
+}
+
+bool
+ExcludeList::Compiled::Check(const char *name_fs) const
+{
+	if (literals.find(name_fs) != literals.end())
+		return true;
+
+	const size_t length = strlen(name_fs);
+
+	for (const auto &i : prefixes)
+		if (length >= i.length() &&
+		    memcmp(name_fs, i.data(), i.length()) == 0)
+			return true;
+
+	for (const auto &i : suffixes)
+		if (length >= i.length() &&
+		    memcmp(name_fs + length - i.length(),
+			   i.data(), i.length()) == 0)
+			return true;
+
+	for (const Glob *i : globs)
+		if (i->Check(name_fs))
+			return true;
+
+	return false;
+}
+
+const ExcludeList::Compiled &
+ExcludeList::GetCompiled() const
+{
+	if (compiled)
+		return *compiled;
+
+	if (patterns.empty() && parent != nullptr)
+		/* nothing new in this directory: share the parent's
+		   set */
+		return parent->GetCompiled();
+
+	compiled.reset(parent != nullptr
+		       ? new Compiled(parent->GetCompiled())
+		       : new Compiled());
+
+	for (const auto &i : patterns)
+		compiled->Add(i);
+
+	return *compiled;
+}
+
+#endif
+
 bool
 ExcludeList::Check(Path name_fs) const
 {
@@ -74,18 +157,10 @@ ExcludeList::Check(Path name_fs) const
 	/* XXX include full path name in check */
 
 #ifdef HAVE_CLASS_GLOB
-	if (parent != nullptr) {
-		if (parent->Check(name_fs)) {
+	try {
+		if (GetCompiled().Check(NarrowPath(name_fs).c_str()))
 			return true;
-		}
-	}
-
-	for (const auto &i : patterns) {
-		try {
-			if (i.Check(NarrowPath(name_fs).c_str()))
-				return true;
-		} catch (const std::runtime_error &) {
-		}
+	} catch (const std::runtime_error &) {
 	}
 #else
 	/* not implemented */
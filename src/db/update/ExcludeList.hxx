@@ -31,6 +31,10 @@
 
 #ifdef HAVE_CLASS_GLOB
 #include <forward_list>
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
 #endif
 
 class Path;
@@ -40,6 +44,45 @@ class ExcludeList {
 
 #ifdef HAVE_CLASS_GLOB
 	std::forward_list<Glob> patterns;
+
+	/**
+	 * The effective patterns of this directory and all of its
+	 * ancestors, sorted into buckets which are cheaper to check
+	 * than calling fnmatch() for each pattern.
+	 */
+	struct Compiled {
+		/**
+		 * Patterns without wildcards.
+		 */
+		std::unordered_set<std::string> literals;
+
+		/**
+		 * Patterns of the form "foo*".
+		 */
+		std::vector<std::string> prefixes;
+
+		/**
+		 * Patterns of the form "*foo".
+		 */
+		std::vector<std::string> suffixes;
+
+		/**
+		 * All other patterns (owned by the #ExcludeList
+		 * instances, which outlive their children).
+		 */
+		std::vector<const Glob *> globs;
+
+		void Add(const Glob &glob);
+
+		gcc_pure
+		bool Check(const char *name_fs) const;
+	};
+
+	/**
+	 * Built by GetCompiled() on the first Check() call and reused
+	 * for all entries of this directory.
+	 */
+	mutable std::unique_ptr<Compiled> compiled;
 #endif
 
 public:
@@ -69,6 +112,11 @@ public:
 	 * the specified file name.
 	 */
 	bool Check(Path name_fs) const;
+
+private:
+#ifdef HAVE_CLASS_GLOB
+	const Compiled &GetCompiled() const;
+#endif
 };
 
 
@@ -0,0 +1,75 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_FANOTIFY_SOURCE_HXX
+#define MPD_FANOTIFY_SOURCE_HXX
+
+#include "event/SocketMonitor.hxx"
+#include "Compiler.h"
+
+class Error;
+struct fanotify_event_metadata;
+
+/**
+ * @param path_fs the absolute path of the directory in which
+ * something was changed, or nullptr if the kernel has dropped events
+ * (and everything needs to be checked)
+ */
+typedef void (*mpd_fanotify_callback_t)(const char *path_fs, unsigned mask,
+					void *ctx);
+
+/**
+ * Watches a whole file system with fanotify.  Unlike inotify, this
+ * needs no watch per directory, but it requires Linux 5.9 and the
+ * capabilities CAP_SYS_ADMIN and CAP_DAC_READ_SEARCH.
+ */
+class FanotifySource final : private SocketMonitor {
+	mpd_fanotify_callback_t callback;
+	void *callback_ctx;
+
+	/**
+	 * A directory on the watched file system, used to resolve
+	 * the file handles reported by the kernel.
+	 */
+	int mount_fd;
+
+	FanotifySource(EventLoop &_loop,
+		       mpd_fanotify_callback_t callback, void *ctx,
+		       int fd, int _mount_fd);
+
+public:
+	~FanotifySource();
+
+	/**
+	 * Creates a new fanotify source for the file system which
+	 * contains the given path, and registers it in the
+	 * #EventLoop.
+	 */
+	static FanotifySource *Create(EventLoop &_loop, const char *path_fs,
+				      mpd_fanotify_callback_t callback,
+				      void *ctx,
+				      Error &error);
+
+private:
+	void HandleEvent(const struct fanotify_event_metadata &event);
+
+	virtual bool OnSocketReady(unsigned flags) override;
+};
+
+#endif
@@ -24,6 +24,11 @@
 #include "Log.hxx"
 #include "util/StringCompare.hxx"
 
+#include <algorithm>
+#include <iterator>
+
+#include <assert.h>
+
 /**
  * Wait this long after the last change before calling
  * update_enqueue().  This increases the probability that updates can
@@ -57,7 +62,8 @@ gcc_pure
 static bool
 path_in(const char *path, const char *possible_parent)
 {
-	if (StringIsEmpty(path))
+	if (StringIsEmpty(possible_parent))
+		/* everything is inside the music directory */
 		return true;
 
 	auto rest = StringAfterPrefix(path, possible_parent);
@@ -65,6 +71,78 @@ path_in(const char *path, const char *possible_parent)
 		(StringIsEmpty(rest) || rest[0] == '/');
 }
 
+/**
+ * Determine the deepest directory which contains both URIs.
+ */
+gcc_pure
+static std::string
+common_ancestor(const std::string &a, const std::string &b)
+{
+	size_t length = 0;
+
+	for (size_t i = 0;; ++i) {
+		const bool end_a = i == a.length(), end_b = i == b.length();
+		if (end_a || end_b) {
+			if ((end_a || a[i] == '/') && (end_b || b[i] == '/'))
+				length = i;
+			break;
+		}
+
+		if (a[i] != b[i])
+			break;
+
+		if (a[i] == '/')
+			length = i;
+	}
+
+	return a.substr(0, length);
+}
+
+gcc_pure
+static unsigned
+uri_depth(const std::string &uri)
+{
+	if (uri.empty())
+		return 0;
+
+	return 1 + std::count(uri.begin(), uri.end(), '/');
+}
+
+void
+InotifyQueue::Coalesce()
+{
+	while (queue.size() > budget) {
+		/* find the two paths with the deepest common
+		   ancestor */
+		std::string best;
+		unsigned best_depth = 0;
+		bool found = false;
+
+		for (auto i = queue.begin(); i != queue.end(); ++i) {
+			for (auto j = std::next(i); j != queue.end(); ++j) {
+				auto ancestor = common_ancestor(*i, *j);
+				unsigned depth = uri_depth(ancestor);
+				if (!found || depth > best_depth) {
+					best = std::move(ancestor);
+					best_depth = depth;
+					found = true;
+				}
+			}
+		}
+
+		assert(found);
+
+		/* replace all paths inside it with the ancestor */
+		queue.remove_if([&best](const std::string &uri){
+				return path_in(uri.c_str(), best.c_str());
+			});
+		queue.emplace_back(std::move(best));
+
+		FormatDebug(inotify_domain, "coalesced into '%s'",
+			    queue.back().c_str());
+	}
+}
+
 void
 InotifyQueue::Enqueue(const char *uri_utf8)
 {
@@ -87,4 +165,7 @@ InotifyQueue::Enqueue(const char *uri_utf8)
 	}
 
 	queue.emplace_back(uri_utf8);
+
+	if (queue.size() > budget)
+		Coalesce();
 }
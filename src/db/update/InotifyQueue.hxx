@@ -31,15 +31,32 @@ class UpdateService;
 class InotifyQueue final : private TimeoutMonitor {
 	UpdateService &update;
 
+	/**
+	 * The maximum number of paths in the #queue.  If there are
+	 * more, they are merged into their common ancestors, because
+	 * one update of a larger sub tree is cheaper than many small
+	 * ones (e.g. during a bulk copy).
+	 */
+	const unsigned budget;
+
 	std::list<std::string> queue;
 
 public:
-	InotifyQueue(EventLoop &_loop, UpdateService &_update)
-		:TimeoutMonitor(_loop), update(_update) {}
+	InotifyQueue(EventLoop &_loop, UpdateService &_update,
+		     unsigned _budget)
+		:TimeoutMonitor(_loop), update(_update), budget(_budget) {
+		SetSlack(1000);
+	}
 
 	void Enqueue(const char *uri_utf8);
 
 private:
+	/**
+	 * Merge queued paths until there are no more than #budget.
+	 */
+	void Coalesce();
+
+
 	virtual void OnTimeout() override;
 };
 
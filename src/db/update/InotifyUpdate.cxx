@@ -26,8 +26,13 @@
 #include "fs/AllocatedPath.hxx"
 #include "fs/FileInfo.hxx"
 #include "util/Error.hxx"
+#include "util/StringCompare.hxx"
 #include "Log.hxx"
 
+#ifdef ENABLE_FANOTIFY
+#include "FanotifySource.hxx"
+#endif
+
 #include <string>
 #include <map>
 #include <forward_list>
@@ -35,6 +40,7 @@
 #include <assert.h>
 #include <sys/inotify.h>
 #include <string.h>
+#include <stdlib.h>
 #include <dirent.h>
 
 static constexpr unsigned IN_MASK =
@@ -76,6 +82,16 @@ static unsigned inotify_max_depth;
 static WatchDirectory *inotify_root;
 static std::map<int, WatchDirectory *> inotify_directories;
 
+#ifdef ENABLE_FANOTIFY
+static FanotifySource *fanotify_source;
+
+/**
+ * The canonical path of the music directory watched by
+ * #fanotify_source.
+ */
+static std::string fanotify_root;
+#endif
+
 static void
 tree_add_watch_directory(WatchDirectory *directory)
 {
@@ -287,9 +303,88 @@ mpd_inotify_callback(int wd, unsigned mask,
 	}
 }
 
+#ifdef ENABLE_FANOTIFY
+
+static void
+mpd_fanotify_callback(const char *path_fs, gcc_unused unsigned mask,
+		      gcc_unused void *ctx)
+{
+	if (path_fs == nullptr) {
+		LogWarning(inotify_domain,
+			   "fanotify queue overflow; updating everything");
+		inotify_queue->Enqueue("");
+		return;
+	}
+
+	/* the whole file system is watched; ignore everything
+	   outside of the music directory */
+	const char *rest = StringAfterPrefix(path_fs, fanotify_root.c_str());
+	if (rest == nullptr)
+		return;
+
+	if (*rest == '/')
+		++rest;
+	else if (*rest != 0)
+		return;
+
+	/* don't go deeper than "auto_update_depth" */
+	std::string relative(rest);
+	if (inotify_max_depth == 0)
+		relative.clear();
+
+	size_t i = 0;
+	for (unsigned depth = 1; !relative.empty(); ++depth) {
+		const size_t slash = relative.find('/', i);
+		if (slash == relative.npos)
+			break;
+
+		if (depth >= inotify_max_depth) {
+			relative.erase(slash);
+			break;
+		}
+
+		i = slash + 1;
+	}
+
+	const std::string uri_utf8 =
+		AllocatedPath::FromFS(relative.c_str()).ToUTF8();
+	if (uri_utf8.empty() && !relative.empty())
+		return;
+
+	inotify_queue->Enqueue(uri_utf8.c_str());
+}
+
+static bool
+mpd_fanotify_init(EventLoop &loop, const AllocatedPath &path)
+{
+	char *real = realpath(path.c_str(), nullptr);
+	if (real == nullptr) {
+		FormatErrno(inotify_domain,
+			    "Failed to resolve %s", path.c_str());
+		return false;
+	}
+
+	fanotify_root = real;
+	free(real);
+
+	Error error;
+	fanotify_source = FanotifySource::Create(loop, fanotify_root.c_str(),
+						 mpd_fanotify_callback,
+						 nullptr, error);
+	if (fanotify_source == nullptr) {
+		LogError(error);
+		return false;
+	}
+
+	LogDebug(inotify_domain, "watching music directory with fanotify");
+	return true;
+}
+
+#endif
+
 void
 mpd_inotify_init(EventLoop &loop, Storage &storage, UpdateService &update,
-		 unsigned max_depth)
+		 unsigned max_depth, unsigned budget, bool fanotify)
 {
 	LogDebug(inotify_domain, "initializing inotify");
 
@@ -299,6 +394,24 @@ mpd_inotify_init(EventLoop &loop, Storage &storage, UpdateService &update,
 		return;
 	}
 
+	inotify_max_depth = max_depth;
+
+	if (fanotify) {
+#ifdef ENABLE_FANOTIFY
+		inotify_queue = new InotifyQueue(loop, update, budget);
+		if (mpd_fanotify_init(loop, path))
+			return;
+
+		delete inotify_queue;
+		inotify_queue = nullptr;
+		LogWarning(inotify_domain, "falling back to inotify");
+#else
+		LogWarning(inotify_domain,
+			   "fanotify support is not available; "
+			   "falling back to inotify");
+#endif
+	}
+
 	Error error;
 	inotify_source = InotifySource::Create(loop,
 					       mpd_inotify_callback, nullptr,
@@ -308,8 +421,6 @@ mpd_inotify_init(EventLoop &loop, Storage &storage, UpdateService &update,
 		return;
 	}
 
-	inotify_max_depth = max_depth;
-
 	int descriptor = inotify_source->Add(path.c_str(), IN_MASK, error);
 	if (descriptor < 0) {
 		LogError(error);
@@ -324,7 +435,7 @@ mpd_inotify_init(EventLoop &loop, Storage &storage, UpdateService &update,
 
 	recursive_watch_subdirectories(inotify_root, path, 0);
 
-	inotify_queue = new InotifyQueue(loop, update);
+	inotify_queue = new InotifyQueue(loop, update, budget);
 
 	LogDebug(inotify_domain, "watching music directory");
 }
@@ -332,6 +443,14 @@ mpd_inotify_init(EventLoop &loop, Storage &storage, UpdateService &update,
 void
 mpd_inotify_finish(void)
 {
+#ifdef ENABLE_FANOTIFY
+	if (fanotify_source != nullptr) {
+		delete inotify_queue;
+		delete fanotify_source;
+		return;
+	}
+#endif
+
 	if (inotify_source == nullptr)
 		return;
 
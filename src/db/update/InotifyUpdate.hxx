@@ -27,9 +27,16 @@ class EventLoop;
 class Storage;
 class UpdateService;
 
+/**
+ * @param budget the maximum number of pending paths; see
+ * #InotifyQueue
+ * @param fanotify watch the whole file system with fanotify instead
+ * of one inotify watch per directory (falls back to inotify if that
+ * is not possible)
+ */
 void
 mpd_inotify_init(EventLoop &loop, Storage &storage, UpdateService &update,
-		 unsigned max_depth);
+		 unsigned max_depth, unsigned budget, bool fanotify);
 
 void
 mpd_inotify_finish();
@@ -0,0 +1,294 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "ScanPool.hxx"
+#include "UpdateDomain.hxx"
+#include "Analyze.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "TagFile.hxx"
+#include "TagStream.hxx"
+#include "thread/Name.hxx"
+#include "thread/Util.hxx"
+#include "ThreadSettings.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#ifdef ENABLE_ARCHIVE
+#include "TagArchive.hxx"
+#include "archive/ArchivePlugin.hxx"
+#include "archive/ArchiveFile.hxx"
+#endif
+
+#include <assert.h>
+#include <string.h>
+
+#ifdef ENABLE_ARCHIVE
+
+/**
+ * A worker closes its archive after being idle for this long.
+ */
+static constexpr unsigned ARCHIVE_IDLE_TIMEOUT_MS = 1000;
+
+ArchiveFile *
+UpdateArchiveCache::Open(const ArchivePlugin &_plugin, Path _path,
+			 Error &error)
+{
+	if (file != nullptr && plugin == &_plugin &&
+	    strcmp(path.c_str(), _path.c_str()) == 0)
+		return file;
+
+	Close();
+
+	file = archive_file_open(&_plugin, _path, error);
+	if (file != nullptr) {
+		plugin = &_plugin;
+		path = AllocatedPath(_path);
+	}
+
+	return file;
+}
+
+void
+UpdateArchiveCache::Close()
+{
+	if (file == nullptr)
+		return;
+
+	file->Close();
+	file = nullptr;
+	plugin = nullptr;
+	path = AllocatedPath::Null();
+}
+
+#endif
+
+UpdateScanJob::UpdateScanJob(Directory &_directory, Song &_song,
+			     bool _is_new,
+			     bool _analyze_mixramp, bool _analyze_loudness,
+			     time_t _mtime,
+			     AllocatedPath &&_path_fs, std::string &&_uri)
+	:directory(_directory), song(&_song),
+	 is_new(_is_new), analyze_mixramp(_analyze_mixramp),
+	 analyze_loudness(_analyze_loudness),
+	 mtime(_mtime),
+	 start_time(_song.start_time), end_time(_song.end_time),
+	 path_fs(std::move(_path_fs)), uri(std::move(_uri)),
+	 success(false)
+#ifdef ENABLE_ARCHIVE
+	, archive_plugin(nullptr)
+#endif
+{
+	loudness.Clear();
+}
+
+#ifdef ENABLE_ARCHIVE
+
+UpdateScanJob::UpdateScanJob(Directory &_directory, Song &_song,
+			     bool _is_new,
+			     const ArchivePlugin &_archive_plugin,
+			     AllocatedPath &&_archive_path,
+			     std::string &&_entry)
+	:directory(_directory), song(&_song),
+	 is_new(_is_new), analyze_mixramp(false), analyze_loudness(false),
+	 mtime(0),
+	 start_time(_song.start_time), end_time(_song.end_time),
+	 path_fs(std::move(_archive_path)), uri(std::move(_entry)),
+	 success(false),
+	 archive_plugin(&_archive_plugin)
+{
+	loudness.Clear();
+}
+
+inline void
+UpdateScanJob::RunArchive(UpdateArchiveCache &archives)
+{
+	Error error;
+	ArchiveFile *archive = archives.Open(*archive_plugin, path_fs, error);
+	if (archive == nullptr) {
+		LogError(error);
+		return;
+	}
+
+	success = tag_archive_scan(*archive, uri.c_str(), tag);
+}
+
+#endif
+
+void
+UpdateScanJob::Run(const volatile bool &cancel,
+		   gcc_unused UpdateArchiveCache *archives)
+{
+#ifdef ENABLE_ARCHIVE
+	if (archive_plugin != nullptr) {
+		assert(archives != nullptr);
+
+		RunArchive(*archives);
+		return;
+	}
+#endif
+
+	success = path_fs.IsNull()
+		? tag_stream_scan(uri.c_str(), tag)
+		: tag_file_scan(path_fs, tag);
+
+	if (!success || (!analyze_mixramp && !analyze_loudness) ||
+	    !AnalyzeSong(uri.c_str(), start_time, end_time, cancel,
+			 analyze_mixramp ? &mix_ramp : nullptr,
+			 analyze_loudness ? &loudness : nullptr))
+		return;
+
+	if (analyze_mixramp)
+		FormatDebug(update_domain, "MixRamp of %s: %s / %s",
+			    uri.c_str(),
+			    mix_ramp.GetStart() != nullptr
+			    ? mix_ramp.GetStart() : "",
+			    mix_ramp.GetEnd() != nullptr
+			    ? mix_ramp.GetEnd() : "");
+
+	if (loudness.IsDefined())
+		FormatDebug(update_domain, "loudness of %s: gain %.2f dB, peak %f",
+			    uri.c_str(), loudness.gain, loudness.peak);
+}
+
+UpdateScanPool::UpdateScanPool(unsigned _n_threads,
+			       const volatile bool &_cancel)
+	:cancel(_cancel), running(0), max_pending(_n_threads * 2),
+	 quit(false),
+	 threads(new Thread[_n_threads]), n_threads(0)
+{
+	for (unsigned i = 0; i < _n_threads; ++i) {
+		Error error;
+		if (!threads[i].Start(WorkThread, this, error)) {
+			LogError(error);
+			break;
+		}
+
+		++n_threads;
+	}
+}
+
+UpdateScanPool::~UpdateScanPool()
+{
+	assert(pending.empty());
+	assert(finished.empty());
+	assert(running == 0);
+
+	mutex.lock();
+	quit = true;
+	work_cond.broadcast();
+	mutex.unlock();
+
+	for (unsigned i = 0; i < n_threads; ++i)
+		threads[i].Join();
+}
+
+void
+UpdateScanPool::Push(UpdateScanJob &job)
+{
+	assert(!IsEmpty());
+
+	const ScopeLock protect(mutex);
+
+	while (pending.size() >= max_pending)
+		done_cond.wait(mutex);
+
+	pending.push_back(&job);
+	work_cond.signal();
+}
+
+UpdateScanJob *
+UpdateScanPool::Pop(bool wait)
+{
+	const ScopeLock protect(mutex);
+
+	while (finished.empty()) {
+		if (!wait || (pending.empty() && running == 0))
+			return nullptr;
+
+		done_cond.wait(mutex);
+	}
+
+	UpdateScanJob *job = finished.front();
+	finished.pop_front();
+	return job;
+}
+
+inline void
+UpdateScanPool::Work()
+{
+#ifdef ENABLE_ARCHIVE
+	UpdateArchiveCache archives;
+#endif
+
+	const ScopeLock protect(mutex);
+
+	while (!quit) {
+		if (pending.empty()) {
+#ifdef ENABLE_ARCHIVE
+			if (archives.IsOpen()) {
+				/* close the archive unless more work
+				   arrives soon */
+				if (!work_cond.timed_wait(mutex,
+							  ARCHIVE_IDLE_TIMEOUT_MS) &&
+				    pending.empty()) {
+					const ScopeUnlock unlock(mutex);
+					archives.Close();
+				}
+
+				continue;
+			}
+#endif
+
+			work_cond.wait(mutex);
+			continue;
+		}
+
+		UpdateScanJob *job = pending.front();
+		pending.pop_front();
+		++running;
+
+		/* there is room in the queue now */
+		done_cond.signal();
+
+		mutex.unlock();
+#ifdef ENABLE_ARCHIVE
+		job->Run(cancel, &archives);
+#else
+		job->Run(cancel);
+#endif
+		mutex.lock();
+
+		--running;
+		finished.push_back(job);
+		done_cond.signal();
+	}
+}
+
+void
+UpdateScanPool::WorkThread(void *ctx)
+{
+	SetThreadName("update_scan");
+	if (!ApplyThreadSettings("update_scan"))
+		SetThreadIdlePriority();
+
+	UpdateScanPool &pool = *(UpdateScanPool *)ctx;
+	pool.Work();
+}
@@ -0,0 +1,290 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_UPDATE_SCAN_POOL_HXX
+#define MPD_UPDATE_SCAN_POOL_HXX
+
+#include "check.h"
+#include "Chrono.hxx"
+#include "MixRampInfo.hxx"
+#include "ReplayGainInfo.hxx"
+#include "tag/TagBuilder.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+
+#include <list>
+#include <memory>
+#include <string>
+
+#include <time.h>
+
+struct Directory;
+struct Song;
+struct ArchivePlugin;
+class ArchiveFile;
+class Error;
+class Path;
+class UpdateArchiveCache;
+
+#ifdef ENABLE_ARCHIVE
+
+/**
+ * Keeps the archive of the most recent #UpdateScanJob open, so
+ * consecutive entries of the same archive do not reopen it.  Each
+ * worker thread has its own instance, because an #ArchiveFile must
+ * not be used by more than one thread at a time.
+ */
+class UpdateArchiveCache {
+	const ArchivePlugin *plugin = nullptr;
+	AllocatedPath path = AllocatedPath::Null();
+	ArchiveFile *file = nullptr;
+
+public:
+	UpdateArchiveCache() = default;
+
+	~UpdateArchiveCache() {
+		Close();
+	}
+
+	UpdateArchiveCache(const UpdateArchiveCache &) = delete;
+	UpdateArchiveCache &operator=(const UpdateArchiveCache &) = delete;
+
+	bool IsOpen() const {
+		return file != nullptr;
+	}
+
+	/**
+	 * Returns the specified archive, opening it unless it is the
+	 * one which is already open.
+	 *
+	 * @return the archive or nullptr on error
+	 */
+	ArchiveFile *Open(const ArchivePlugin &_plugin, Path _path,
+			  Error &error);
+
+	void Close();
+};
+
+#endif
+
+/**
+ * The tag scan of one song file, which may be delegated to a
+ * #UpdateScanPool worker thread.  Run() does not touch the directory
+ * tree; the results are applied by the update thread.
+ */
+struct UpdateScanJob {
+	/**
+	 * The directory which contains the song.
+	 */
+	Directory &directory;
+
+	/**
+	 * The song object.  If #is_new is set, it has been allocated
+	 * but not yet added to #directory.
+	 */
+	Song *const song;
+
+	const bool is_new;
+
+	/**
+	 * Calculate MixRamp data after a successful scan?
+	 */
+	const bool analyze_mixramp;
+
+	/**
+	 * Measure the loudness after a successful scan?
+	 */
+	const bool analyze_loudness;
+
+	/**
+	 * The modification time of the file, to be stored in the
+	 * song.
+	 */
+	const time_t mtime;
+
+	const SongTime start_time, end_time;
+
+	/**
+	 * The local path of the file; "null" if the #Storage does not
+	 * support local paths.
+	 */
+	const AllocatedPath path_fs;
+
+	/**
+	 * The absolute URI of the file.
+	 */
+	const std::string uri;
+
+	/**
+	 * Output: true if the file was recognized by a decoder plugin.
+	 */
+	bool success;
+
+	/**
+	 * Output: the tags read from the file.
+	 */
+	TagBuilder tag;
+
+	/**
+	 * Output: the MixRamp data; empty if #analyze_mixramp was not
+	 * set or if the analysis has failed.
+	 */
+	MixRampInfo mix_ramp;
+
+	/**
+	 * Output: the track gain and peak; undefined if
+	 * #analyze_loudness was not set, if the analysis has failed
+	 * or if the file has ReplayGain tags.
+	 */
+	ReplayGainTuple loudness;
+
+#ifdef ENABLE_ARCHIVE
+	/**
+	 * If not nullptr, then the song is an entry of an archive
+	 * file: #path_fs is the local path of the archive, and #uri
+	 * is the path of the entry inside the archive.
+	 */
+	const ArchivePlugin *const archive_plugin;
+#endif
+
+	UpdateScanJob(Directory &_directory, Song &_song, bool _is_new,
+		      bool _analyze_mixramp, bool _analyze_loudness,
+		      time_t _mtime,
+		      AllocatedPath &&_path_fs, std::string &&_uri);
+
+#ifdef ENABLE_ARCHIVE
+	/**
+	 * Construct a job which scans an entry of an archive.
+	 */
+	UpdateScanJob(Directory &_directory, Song &_song, bool _is_new,
+		      const ArchivePlugin &_archive_plugin,
+		      AllocatedPath &&_archive_path,
+		      std::string &&_entry);
+#endif
+
+	/**
+	 * Scan the file.  This may be called in any thread.
+	 *
+	 * @param cancel a flag which is polled during the (slow)
+	 * MixRamp and loudness analysis
+	 * @param archives the calling thread's open archive; required
+	 * for archive entries
+	 */
+	void Run(const volatile bool &cancel,
+		 UpdateArchiveCache *archives=nullptr);
+
+private:
+#ifdef ENABLE_ARCHIVE
+	void RunArchive(UpdateArchiveCache &archives);
+#endif
+};
+
+/**
+ * A pool of threads which scan song files in parallel with the
+ * update thread.  The update thread submits jobs with Push() and
+ * collects the results with Pop().
+ */
+class UpdateScanPool {
+	const volatile bool &cancel;
+
+	Mutex mutex;
+
+	/**
+	 * Wakes up the worker threads when a job is pushed or when
+	 * they shall quit.
+	 */
+	Cond work_cond;
+
+	/**
+	 * Wakes up the update thread when a job has finished or when
+	 * there is room in #pending.
+	 */
+	Cond done_cond;
+
+	std::list<UpdateScanJob *> pending, finished;
+
+	/**
+	 * The number of jobs currently being run by a worker.
+	 */
+	unsigned running;
+
+	/**
+	 * Push() blocks while this many jobs are pending, to bound
+	 * memory usage while a slow storage keeps the workers busy.
+	 */
+	const unsigned max_pending;
+
+	bool quit;
+
+	const std::unique_ptr<Thread[]> threads;
+	unsigned n_threads;
+
+public:
+	/**
+	 * Start the worker threads.  If a thread cannot be created,
+	 * the pool runs with fewer threads (possibly none; see
+	 * IsEmpty()).
+	 *
+	 * @param _cancel a flag which is passed to
+	 * UpdateScanJob::Run()
+	 */
+	UpdateScanPool(unsigned _n_threads, const volatile bool &_cancel);
+
+	/**
+	 * Stop and join all worker threads.  All jobs must have been
+	 * collected with Pop() before.
+	 */
+	~UpdateScanPool();
+
+	UpdateScanPool(const UpdateScanPool &) = delete;
+	UpdateScanPool &operator=(const UpdateScanPool &) = delete;
+
+	/**
+	 * Are there no worker threads?  Then the caller must run
+	 * the jobs itself.
+	 */
+	bool IsEmpty() const {
+		return n_threads == 0;
+	}
+
+	/**
+	 * Submit a job.  The pool does not take ownership; the caller
+	 * must get it back with Pop().
+	 */
+	void Push(UpdateScanJob &job);
+
+	/**
+	 * Obtain a finished job.
+	 *
+	 * @param wait wait until a job finishes if none is ready yet
+	 * (unless there are no jobs at all)
+	 * @return the job, or nullptr if none is ready (or if there
+	 * are no jobs at all)
+	 */
+	UpdateScanJob *Pop(bool wait);
+
+private:
+	void Work();
+	static void WorkThread(void *ctx);
+};
+
+#endif
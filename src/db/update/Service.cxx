@@ -26,12 +26,17 @@
 #include "db/plugins/simple/SimpleDatabasePlugin.hxx"
 #include "db/plugins/simple/Directory.hxx"
 #include "storage/CompositeStorage.hxx"
+#include "tag/TagPool.hxx"
 #include "Idle.hxx"
 #include "util/Error.hxx"
 #include "Log.hxx"
 #include "system/FatalError.hxx"
 #include "thread/Thread.hxx"
 #include "thread/Util.hxx"
+#include "thread/Name.hxx"
+#include "ThreadSettings.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
 
 #ifndef NDEBUG
 #include "event/Loop.hxx"
@@ -41,12 +46,19 @@
 
 UpdateService::UpdateService(EventLoop &_loop, SimpleDatabase &_db,
 			     CompositeStorage &_storage,
-			     DatabaseListener &_listener)
+			     DatabaseListener &_listener,
+			     const PlayerControl *player)
 	:DeferredMonitor(_loop),
 	 db(_db), storage(_storage),
 	 listener(_listener),
 	 update_task_id(0),
-	 walk(nullptr)
+	 walk(nullptr),
+	 throttle(config_get_unsigned(ConfigOption::UPDATE_FILES_PER_SECOND,
+				      0),
+		  uint64_t(config_get_unsigned(ConfigOption::UPDATE_KBYTES_PER_SECOND,
+					       0)) * 1024,
+		  config_get_bool(ConfigOption::UPDATE_PLAYBACK_BACKOFF, true)
+		  ? player : nullptr)
 {
 }
 
@@ -109,18 +121,38 @@ UpdateService::CancelMount(const char *uri)
 	}
 }
 
+static void
+LogTagPoolStats()
+{
+	TagPoolStats stats;
+	tag_pool_get_stats(stats);
+
+	FormatDebug(update_domain,
+		    "tag pool: %lu items, load factor %.2f, hit rate %.1f%%",
+		    (unsigned long)stats.items,
+		    stats.buckets > 0
+		    ? double(stats.items) / stats.buckets
+		    : 0.,
+		    stats.lookups > 0
+		    ? 100. * stats.hits / stats.lookups
+		    : 0.);
+}
+
 inline void
 UpdateService::Task()
 {
 	assert(walk != nullptr);
 
+	SetThreadName("update");
+
 	if (!next.path_utf8.empty())
 		FormatDebug(update_domain, "starting: %s",
 			    next.path_utf8.c_str());
 	else
 		LogDebug(update_domain, "starting");
 
-	SetThreadIdlePriority();
+	if (!ApplyThreadSettings("update"))
+		SetThreadIdlePriority();
 
 	modified = walk->Walk(next.db->GetRoot(), next.path_utf8.c_str(),
 			      next.discard);
@@ -133,6 +165,8 @@ UpdateService::Task()
 		}
 	}
 
+	LogTagPoolStats();
+
 	if (!next.path_utf8.empty())
 		FormatDebug(update_domain, "finished: %s",
 			    next.path_utf8.c_str());
@@ -158,7 +192,8 @@ UpdateService::StartThread(UpdateQueueItem &&i)
 	modified = false;
 
 	next = std::move(i);
-	walk = new UpdateWalk(GetEventLoop(), listener, *next.storage);
+	walk = new UpdateWalk(GetEventLoop(), listener, *next.storage,
+			      throttle);
 
 	Error error;
 	if (!update_thread.Start(Task, this, error))
@@ -22,6 +22,7 @@
 
 #include "check.h"
 #include "Queue.hxx"
+#include "Throttle.hxx"
 #include "event/DeferredMonitor.hxx"
 #include "thread/Thread.hxx"
 #include "Compiler.h"
@@ -30,6 +31,7 @@ class SimpleDatabase;
 class DatabaseListener;
 class UpdateWalk;
 class CompositeStorage;
+struct PlayerControl;
 
 /**
  * This class manages the update queue and runs the update thread.
@@ -54,10 +56,23 @@ class UpdateService final : DeferredMonitor {
 
 	UpdateWalk *walk;
 
+	/**
+	 * Limits the I/O of the update thread; see
+	 * #ConfigOption::UPDATE_FILES_PER_SECOND,
+	 * #ConfigOption::UPDATE_KBYTES_PER_SECOND and
+	 * #ConfigOption::UPDATE_PLAYBACK_BACKOFF.
+	 */
+	UpdateThrottle throttle;
+
 public:
+	/**
+	 * @param player the player whose buffer is watched to back
+	 * off while it is starving; may be nullptr
+	 */
 	UpdateService(EventLoop &_loop, SimpleDatabase &_db,
 		      CompositeStorage &_storage,
-		      DatabaseListener &_listener);
+		      DatabaseListener &_listener,
+		      const PlayerControl *player);
 
 	~UpdateService();
 
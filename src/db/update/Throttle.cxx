@@ -0,0 +1,113 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "Throttle.hxx"
+#include "UpdateDomain.hxx"
+#include "player/Control.hxx"
+#include "system/Clock.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+/**
+ * After the player has noticed its pipe below the low-water mark,
+ * the update pauses for this long [us].
+ */
+static constexpr uint64_t BACKOFF_US = 2000000;
+
+/**
+ * The cancel flag is polled at least this often [us] while
+ * sleeping.
+ */
+static constexpr uint64_t MAX_SLEEP_US = 100000;
+
+static void
+SleepCancellable(uint64_t us, const volatile bool &cancel)
+{
+	while (us > 0 && !cancel) {
+		const uint64_t slice = std::min(us, MAX_SLEEP_US);
+#ifdef WIN32
+		Sleep(slice / 1000);
+#else
+		usleep(slice);
+#endif
+		us -= slice;
+	}
+}
+
+UpdateThrottle::UpdateThrottle(unsigned files_per_second,
+			       uint64_t _bytes_per_second,
+			       const PlayerControl *_player)
+	:file_interval_us(files_per_second > 0
+			  ? 1000000 / files_per_second
+			  : 0),
+	 bytes_per_second(_bytes_per_second),
+	 player(_player) {}
+
+void
+UpdateThrottle::BackOff(const volatile bool &cancel)
+{
+	if (player == nullptr)
+		return;
+
+	bool logged = false;
+	while (!cancel) {
+		const uint64_t t = player->low_water_time;
+		const uint64_t now = MonotonicClockUS();
+		if (t == 0 || now >= t + BACKOFF_US)
+			break;
+
+		if (!logged) {
+			LogDebug(update_domain,
+				 "playback is starving, pausing the update");
+			logged = true;
+		}
+
+		SleepCancellable(t + BACKOFF_US - now, cancel);
+	}
+}
+
+void
+UpdateThrottle::Wait(uint64_t size, const volatile bool &cancel)
+{
+	BackOff(cancel);
+
+	if (file_interval_us == 0 && bytes_per_second == 0)
+		return;
+
+	uint64_t now = MonotonicClockUS();
+	if (next_us > now) {
+		SleepCancellable(next_us - now, cancel);
+		now = next_us;
+	}
+
+	uint64_t cost = file_interval_us;
+	if (bytes_per_second > 0)
+		cost = std::max(cost, size * 1000000 / bytes_per_second);
+
+	next_us = now + cost;
+}
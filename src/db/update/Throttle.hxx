@@ -0,0 +1,83 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_UPDATE_THROTTLE_HXX
+#define MPD_UPDATE_THROTTLE_HXX
+
+#include "check.h"
+
+#include <stdint.h>
+
+struct PlayerControl;
+
+/**
+ * Slows down the database update, so it does not compete with
+ * playback for the bandwidth of the storage.  It enforces a limit
+ * of files and bytes per second, and it pauses the update while the
+ * player is running out of decoded data.  All methods are called
+ * by the update thread.
+ */
+class UpdateThrottle {
+	/**
+	 * The minimum time between two files [us]; zero means no
+	 * limit.
+	 */
+	const uint64_t file_interval_us;
+
+	/**
+	 * The maximum number of bytes per second; zero means no
+	 * limit.
+	 */
+	const uint64_t bytes_per_second;
+
+	/**
+	 * The player whose pipe is watched (see
+	 * PlayerControl::low_water_time); nullptr disables the
+	 * back-off.
+	 */
+	const PlayerControl *const player;
+
+	/**
+	 * The MonotonicClockUS() time when the next file may be
+	 * read.
+	 */
+	uint64_t next_us = 0;
+
+public:
+	UpdateThrottle(unsigned files_per_second, uint64_t _bytes_per_second,
+		       const PlayerControl *_player);
+
+	/**
+	 * Wait while the player is starving.  This is called before
+	 * each directory.
+	 *
+	 * @param cancel a flag which is polled; if it becomes true,
+	 * the method returns early
+	 */
+	void BackOff(const volatile bool &cancel);
+
+	/**
+	 * Wait until the next file may be read, and account for its
+	 * size.  This implies BackOff().
+	 */
+	void Wait(uint64_t size, const volatile bool &cancel);
+};
+
+#endif
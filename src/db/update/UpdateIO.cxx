@@ -54,7 +54,7 @@ bool
 DirectoryExists(Storage &storage, const Directory &directory)
 {
 	StorageFileInfo info;
-	if (!storage.GetInfo(directory.GetPath(), true, info, IgnoreError()))
+	if (!storage.GetInfo(directory.GetPath().c_str(), true, info, IgnoreError()))
 		return false;
 
 	return directory.device == DEVICE_INARCHIVE ||
@@ -67,7 +67,7 @@ static bool
 GetDirectoryChildInfo(Storage &storage, const Directory &directory,
 		      const char *name_utf8, StorageFileInfo &info, Error &error)
 {
-	const auto uri_utf8 = PathTraitsUTF8::Build(directory.GetPath(),
+	const auto uri_utf8 = PathTraitsUTF8::Build(directory.GetPath().c_str(),
 						    name_utf8);
 	return storage.GetInfo(uri_utf8.c_str(), true, info, error);
 }
@@ -94,7 +94,7 @@ directory_child_access(Storage &storage, const Directory &directory,
 	(void)mode;
 	return true;
 #else
-	const auto path = storage.MapChildFS(directory.GetPath(), name);
+	const auto path = storage.MapChildFS(directory.GetPath().c_str(), name);
 	if (path.IsNull())
 		/* does not point to local file: silently ignore the
 		   check */
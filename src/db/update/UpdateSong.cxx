@@ -21,14 +21,206 @@
 #include "Walk.hxx"
 #include "UpdateIO.hxx"
 #include "UpdateDomain.hxx"
+#include "ScanPool.hxx"
+#include "Throttle.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/plugins/simple/Directory.hxx"
 #include "db/plugins/simple/Song.hxx"
 #include "decoder/DecoderList.hxx"
+#include "storage/StorageInterface.hxx"
 #include "storage/FileInfo.hxx"
+#include "fs/AllocatedPath.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+#include <map>
+#include <string>
+
 #include <unistd.h>
+#include <math.h>
+
+void
+UpdateWalk::ScanSong(Directory &directory, Song &song, bool is_new,
+		     const StorageFileInfo &info)
+{
+	throttle.Wait(info.size, cancel);
+
+	const auto relative_uri = song.GetURI();
+
+	auto *job = new UpdateScanJob(directory, song, is_new,
+				      mixramp_analyzer, loudness_analyzer,
+				      info.mtime,
+				      storage.MapFS(relative_uri.c_str()),
+				      storage.MapUTF8(relative_uri.c_str()));
+
+	if (scan_pool == nullptr) {
+		job->Run(cancel);
+		FinishScan(*job);
+		return;
+	}
+
+	scan_pool->Push(*job);
+	FinishScans(false);
+}
+
+/**
+ * Convert the measured track loudness to a #ReplayGainInfo; the
+ * album gain is filled in later by UpdateWalk::UpdateAlbumGain().
+ */
+static ReplayGainInfo
+MakeReplayGain(const ReplayGainTuple &track)
+{
+	ReplayGainInfo info = ReplayGainInfo::Undefined();
+	info.tuples[REPLAY_GAIN_TRACK] = track;
+	return info;
+}
+
+void
+UpdateWalk::FinishScan(UpdateScanJob &job)
+{
+	Directory &directory = job.directory;
+	Song *song = job.song;
+
+	if (job.is_new) {
+		if (!job.success) {
+			FormatDebug(update_domain,
+				    "ignoring unrecognized file %s/%s",
+				    directory.GetPath().c_str(), song->uri);
+			song->Free();
+		} else {
+			{
+				const ScopeDatabaseLock protect;
+				job.tag.Commit(song->tag);
+				song->mtime = job.mtime;
+				song->SetMixRamp(std::move(job.mix_ramp));
+				song->SetReplayGain(MakeReplayGain(job.loudness));
+				directory.AddSong(song);
+			}
+
+			modified = true;
+			FormatDefault(update_domain, "added %s/%s",
+				      directory.GetPath().c_str(), song->uri);
+		}
+	} else {
+		if (!job.success) {
+			FormatDebug(update_domain,
+				    "deleting unrecognized file %s/%s",
+				    directory.GetPath().c_str(), song->uri);
+			editor.LockDeleteSong(directory, song);
+		} else {
+			/* the old MixRamp and ReplayGain data belongs
+			   to the old file */
+			const ScopeDatabaseLock protect;
+			directory.CommitSongTag(*song, job.tag);
+			song->mtime = job.mtime;
+			song->SetMixRamp(std::move(job.mix_ramp));
+			song->SetReplayGain(MakeReplayGain(job.loudness));
+		}
+
+		modified = true;
+	}
+
+	if (job.success && job.analyze_loudness)
+		loudness_directories.insert(&directory);
+
+	delete &job;
+}
+
+void
+UpdateWalk::FinishScans(bool wait)
+{
+	if (scan_pool == nullptr)
+		return;
+
+	UpdateScanJob *job;
+	while ((job = scan_pool->Pop(wait)) != nullptr)
+		FinishScan(*job);
+}
+
+/**
+ * Returns the duration of the song [s] used to weigh its loudness
+ * within the album.
+ */
+gcc_pure
+static double
+GetAlbumWeight(const Song &song)
+{
+	if (!song.end_time.IsZero())
+		return (song.end_time - song.start_time).ToDoubleS();
+
+	if (song.tag.duration.IsNegative())
+		/* unknown; count it as one second */
+		return 1;
+
+	return song.tag.duration.ToDoubleS() - song.start_time.ToDoubleS();
+}
+
+void
+UpdateWalk::UpdateAlbumGain(Directory &directory)
+{
+	struct Album {
+		/**
+		 * The duration-weighted sum of the track powers
+		 * relative to the reference loudness.
+		 */
+		double power = 0;
+
+		double duration = 0;
+
+		float peak = 0;
+
+		ReplayGainTuple ToTuple() const {
+			ReplayGainTuple t;
+			t.gain = -10 * log10(power / duration);
+			t.peak = peak;
+			return t;
+		}
+	};
+
+	/* the update thread is the only writer, so reading the
+	   directory does not need the lock */
+
+	std::map<std::string, Album> albums;
+	for (const Song &song : directory.songs) {
+		if (!song.replay_gain ||
+		    !song.replay_gain->tuples[REPLAY_GAIN_TRACK].IsDefined())
+			continue;
+
+		const char *name = song.tag.GetValue(TAG_ALBUM);
+		if (name == nullptr)
+			continue;
+
+		const auto &track = song.replay_gain->tuples[REPLAY_GAIN_TRACK];
+		const double duration = std::max(GetAlbumWeight(song), 0.001);
+
+		/* the gain is the negated loudness relative to the
+		   reference */
+		Album &album = albums[name];
+		album.power += duration * pow(10, -track.gain / 10);
+		album.duration += duration;
+		album.peak = std::max(album.peak, track.peak);
+	}
+
+	if (albums.empty())
+		return;
+
+	const ScopeDatabaseLock protect;
+
+	for (Song &song : directory.songs) {
+		if (!song.replay_gain ||
+		    !song.replay_gain->tuples[REPLAY_GAIN_TRACK].IsDefined())
+			continue;
+
+		const char *name = song.tag.GetValue(TAG_ALBUM);
+		if (name == nullptr)
+			continue;
+
+		song.replay_gain->tuples[REPLAY_GAIN_ALBUM] =
+			albums[name].ToTuple();
+	}
+
+	modified = true;
+}
 
 inline void
 UpdateWalk::UpdateSongFile2(Directory &directory,
@@ -44,7 +236,7 @@ UpdateWalk::UpdateSongFile2(Directory &directory,
 	if (!directory_child_access(storage, directory, name, R_OK)) {
 		FormatError(update_domain,
 			    "no read permissions on %s/%s",
-			    directory.GetPath(), name);
+			    directory.GetPath().c_str(), name);
 		if (song != nullptr)
 			editor.LockDeleteSong(directory, song);
 
@@ -62,34 +254,13 @@ UpdateWalk::UpdateSongFile2(Directory &directory,
 
 	if (song == nullptr) {
 		FormatDebug(update_domain, "reading %s/%s",
-			    directory.GetPath(), name);
-		song = Song::LoadFile(storage, name, directory);
-		if (song == nullptr) {
-			FormatDebug(update_domain,
-				    "ignoring unrecognized file %s/%s",
-				    directory.GetPath(), name);
-			return;
-		}
-
-		{
-			const ScopeDatabaseLock protect;
-			directory.AddSong(song);
-		}
-
-		modified = true;
-		FormatDefault(update_domain, "added %s/%s",
-			      directory.GetPath(), name);
+			    directory.GetPath().c_str(), name);
+		ScanSong(directory, *Song::NewFile(name, directory), true,
+			 info);
 	} else if (info.mtime != song->mtime || walk_discard) {
 		FormatDefault(update_domain, "updating %s/%s",
-			      directory.GetPath(), name);
-		if (!song->UpdateFile(storage)) {
-			FormatDebug(update_domain,
-				    "deleting unrecognized file %s/%s",
-				    directory.GetPath(), name);
-			editor.LockDeleteSong(directory, song);
-		}
-
-		modified = true;
+			      directory.GetPath().c_str(), name);
+		ScanSong(directory, *song, false, info);
 	}
 }
 
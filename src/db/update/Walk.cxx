@@ -21,6 +21,8 @@
 #include "Walk.hxx"
 #include "UpdateIO.hxx"
 #include "Editor.hxx"
+#include "ScanPool.hxx"
+#include "Throttle.hxx"
 #include "UpdateDomain.hxx"
 #include "db/DatabaseLock.hxx"
 #include "db/PlaylistVector.hxx"
@@ -47,12 +49,15 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <memory>
+#include <string>
+#include <vector>
 
 UpdateWalk::UpdateWalk(EventLoop &_loop, DatabaseListener &_listener,
-		       Storage &_storage)
+		       Storage &_storage, UpdateThrottle &_throttle)
 	:cancel(false),
 	 storage(_storage),
-	 editor(_loop, _listener)
+	 editor(_loop, _listener),
+	 throttle(_throttle)
 {
 #ifndef WIN32
 	follow_inside_symlinks =
@@ -63,6 +68,28 @@ UpdateWalk::UpdateWalk(EventLoop &_loop, DatabaseListener &_listener,
 		config_get_bool(ConfigOption::FOLLOW_OUTSIDE_SYMLINKS,
 				DEFAULT_FOLLOW_OUTSIDE_SYMLINKS);
 #endif
+
+	mixramp_analyzer =
+		config_get_bool(ConfigOption::MIXRAMP_ANALYZER, false);
+
+	loudness_analyzer =
+		config_get_bool(ConfigOption::LOUDNESS_ANALYZER, false);
+
+	trust_directory_mtime =
+		config_get_bool(ConfigOption::UPDATE_TRUST_DIRECTORY_MTIME,
+				false);
+
+	const unsigned scan_threads =
+		config_get_positive(ConfigOption::UPDATE_SCAN_THREADS, 1);
+	if (scan_threads > 1) {
+		scan_pool.reset(new UpdateScanPool(scan_threads, cancel));
+		if (scan_pool->IsEmpty())
+			scan_pool.reset();
+	}
+}
+
+UpdateWalk::~UpdateWalk()
+{
 }
 
 static void
@@ -127,6 +154,7 @@ UpdateWalk::PurgeDeletedFromDirectory(Directory &directory)
 						i->name.c_str())) {
 			const ScopeDatabaseLock protect;
 			i = directory.playlists.erase(i);
+			directory.MarkModified();
 		} else
 			++i;
 	}
@@ -137,7 +165,7 @@ static bool
 update_directory_stat(Storage &storage, Directory &directory)
 {
 	StorageFileInfo info;
-	if (!GetInfo(storage, directory.GetPath(), info))
+	if (!GetInfo(storage, directory.GetPath().c_str(), info))
 		return false;
 
 	directory_set_stat(directory, info);
@@ -194,8 +222,10 @@ UpdateWalk::UpdatePlaylistFile(Directory &directory,
 	PlaylistInfo pi(name, info.mtime);
 
 	const ScopeDatabaseLock protect;
-	if (directory.playlists.UpdateOrInsert(std::move(pi)))
+	if (directory.playlists.UpdateOrInsert(std::move(pi))) {
+		directory.MarkModified();
 		modified = true;
+	}
 	return true;
 }
 
@@ -258,7 +288,7 @@ UpdateWalk::SkipSymlink(const Directory *directory,
 			const char *utf8_name) const
 {
 #ifndef WIN32
-	const auto path_fs = storage.MapChildFS(directory->GetPath(),
+	const auto path_fs = storage.MapChildFS(directory->GetPath().c_str(),
 						utf8_name);
 	if (path_fs.IsNull())
 		/* not a local file: don't skip */
@@ -324,6 +354,107 @@ UpdateWalk::SkipSymlink(const Directory *directory,
 #endif
 }
 
+/**
+ * A directory entry which was read by UpdateWalk::UpdateDirectory().
+ */
+struct UpdateWalkEntry {
+	std::string name;
+
+	StorageFileInfo info;
+
+	explicit UpdateWalkEntry(const char *_name):name(_name) {}
+};
+
+bool
+UpdateWalk::IsUnchanged(const Directory &directory,
+			const StorageFileInfo &info) const
+{
+	/* entries can only have been added, removed or renamed if
+	   the directory's mtime has changed (or if it has been
+	   replaced) */
+	return trust_directory_mtime && !walk_discard &&
+		directory.mtime != 0 && directory.mtime == info.mtime &&
+		directory.inode == info.inode &&
+		directory.device == info.device;
+}
+
+size_t
+UpdateWalk::PrefetchDirectories(const Directory &directory,
+				const std::vector<UpdateWalkEntry> &entries,
+				size_t position, size_t end)
+{
+	if (end > entries.size())
+		end = entries.size();
+
+	for (; position < end; ++position) {
+		const auto &entry = entries[position];
+		if (!entry.info.IsDirectory())
+			continue;
+
+		if (trust_directory_mtime) {
+			const ScopeDatabaseLock protect;
+			const Directory *child =
+				directory.FindChild(entry.name.c_str());
+			if (child != nullptr && IsUnchanged(*child, entry.info))
+				/* won't be read */
+				continue;
+		}
+
+		storage.PrefetchDirectory(PathTraitsUTF8::Build(directory.GetPath().c_str(),
+								entry.name.c_str()).c_str());
+	}
+
+	return position;
+}
+
+inline void
+UpdateWalk::UpdateUnchangedDirectory(Directory &directory,
+				     const ExcludeList &exclude_list)
+{
+	std::vector<std::string> names;
+
+	{
+		const ScopeDatabaseLock protect;
+
+		for (const auto &child : directory.children) {
+			if (child.IsMount() ||
+			    child.device == DEVICE_INARCHIVE ||
+			    child.device == DEVICE_CONTAINER)
+				/* not a real directory */
+				++skipped;
+			else
+				names.emplace_back(child.GetName());
+		}
+
+		for (gcc_unused const auto &song : directory.songs)
+			++skipped;
+
+		for (gcc_unused const auto &playlist : directory.playlists)
+			++skipped;
+	}
+
+	for (const auto &name : names) {
+		if (cancel)
+			break;
+
+		const auto uri = PathTraitsUTF8::Build(directory.GetPath().c_str(),
+						       name.c_str());
+
+		StorageFileInfo info;
+		if (!GetInfo(storage, uri.c_str(), info) ||
+		    !info.IsDirectory()) {
+			/* this should have changed the parent's
+			   mtime, but handle it anyway */
+			modified |= editor.DeleteNameIn(directory,
+							name.c_str());
+			continue;
+		}
+
+		UpdateDirectoryChild(directory, exclude_list,
+				     name.c_str(), info);
+	}
+}
+
 bool
 UpdateWalk::UpdateDirectory(Directory &directory,
 			    const ExcludeList &exclude_list,
@@ -331,20 +462,18 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 {
 	assert(info.IsDirectory());
 
-	directory_set_stat(directory, info);
+	throttle.BackOff(cancel);
 
-	Error error;
-	const std::unique_ptr<StorageDirectoryReader> reader(storage.OpenDirectory(directory.GetPath(), error));
-	if (reader.get() == nullptr) {
-		LogError(error);
-		return false;
-	}
+	const bool unchanged = directory_depth > 0 &&
+		IsUnchanged(directory, info);
+
+	directory_set_stat(directory, info);
 
 	ExcludeList child_exclude_list(exclude_list);
 
 	{
 		const auto exclude_path_fs =
-			storage.MapChildFS(directory.GetPath(), ".mpdignore");
+			storage.MapChildFS(directory.GetPath().c_str(), ".mpdignore");
 		if (!exclude_path_fs.IsNull())
 			child_exclude_list.LoadFile(exclude_path_fs);
 	}
@@ -352,14 +481,38 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 	if (!child_exclude_list.IsEmpty())
 		RemoveExcludedFromDirectory(directory, child_exclude_list);
 
+	if (unchanged) {
+		++directory_depth;
+		UpdateUnchangedDirectory(directory, child_exclude_list);
+		--directory_depth;
+		return true;
+	}
+
+	Error error;
+	std::unique_ptr<StorageDirectoryReader> reader(storage.OpenDirectory(directory.GetPath().c_str(), error));
+	if (reader.get() == nullptr) {
+		LogError(error);
+		return false;
+	}
+
 	PurgeDeletedFromDirectory(directory);
 
+	/* collect all entries first, so the sub directories can be
+	   announced to the storage before they are visited */
+	std::vector<UpdateWalkEntry> entries;
+
 	const char *name_utf8;
 	while (!cancel && (name_utf8 = reader->Read()) != nullptr) {
 		if (skip_path(name_utf8))
 			continue;
 
-		{
+		const Path entry_fs = reader->GetNameFS();
+		if (!entry_fs.IsNull()) {
+			/* a local storage knows the original name; no
+			   need to convert it back */
+			if (child_exclude_list.Check(entry_fs))
+				continue;
+		} else {
 			const auto name_fs = AllocatedPath::FromUTF8(name_utf8);
 			if (name_fs.IsNull() || child_exclude_list.Check(name_fs))
 				continue;
@@ -370,16 +523,45 @@ UpdateWalk::UpdateDirectory(Directory &directory,
 			continue;
 		}
 
-		StorageFileInfo info2;
-		if (!GetInfo(*reader, info2)) {
+		entries.emplace_back(name_utf8);
+		if (!GetInfo(*reader, entries.back().info)) {
+			entries.pop_back();
 			modified |= editor.DeleteNameIn(directory, name_utf8);
 			continue;
 		}
+	}
+
+	/* release the reader before descending, it may hold a file
+	   descriptor */
+	reader.reset();
 
-		UpdateDirectoryChild(directory, child_exclude_list, name_utf8, info2);
+	size_t prefetch_position = 0;
+	for (size_t i = 0; !cancel && i < entries.size(); ++i) {
+		prefetch_position =
+			PrefetchDirectories(directory, entries,
+					    prefetch_position,
+					    i + PREFETCH_WINDOW);
+
+		const auto &entry = entries[i];
+
+		++directory_depth;
+		UpdateDirectoryChild(directory, child_exclude_list,
+				     entry.name.c_str(), entry.info);
+		--directory_depth;
 	}
 
-	directory.mtime = info.mtime;
+	/* all songs of this directory must be complete before the
+	   caller may continue with the next one */
+	FinishScans(true);
+
+	if (loudness_directories.erase(&directory) > 0)
+		UpdateAlbumGain(directory);
+
+	if (directory.mtime != info.mtime) {
+		const ScopeDatabaseLock protect;
+		directory.mtime = info.mtime;
+		directory.MarkModified();
+	}
 
 	return true;
 }
@@ -483,6 +665,8 @@ UpdateWalk::Walk(Directory &root, const char *path, bool discard)
 {
 	walk_discard = discard;
 	modified = false;
+	directory_depth = 0;
+	skipped = 0;
 
 	if (path != nullptr && !isRootDirectory(path)) {
 		UpdateUri(root, path);
@@ -496,5 +680,17 @@ UpdateWalk::Walk(Directory &root, const char *path, bool discard)
 		UpdateDirectory(root, exclude_list, info);
 	}
 
+	FinishScans(true);
+
+	/* songs which were updated individually by UpdateUri() */
+	for (Directory *directory : loudness_directories)
+		UpdateAlbumGain(*directory);
+	loudness_directories.clear();
+
+	if (skipped > 0)
+		FormatDebug(update_domain,
+			    "skipped %u entries in unchanged directories",
+			    skipped);
+
 	return modified;
 }
@@ -24,18 +24,34 @@
 #include "Editor.hxx"
 #include "Compiler.h"
 
+#include <memory>
+#include <set>
+#include <vector>
+
 struct StorageFileInfo;
+struct UpdateWalkEntry;
 struct Directory;
+struct Song;
 struct ArchivePlugin;
 class ArchiveFile;
+class Path;
 class Storage;
 class ExcludeList;
+struct UpdateScanJob;
+class UpdateScanPool;
+class UpdateThrottle;
 
 class UpdateWalk final {
 #ifdef ENABLE_ARCHIVE
 	friend class UpdateArchiveVisitor;
 #endif
 
+	/**
+	 * How many sub directories ahead of the current one shall be
+	 * announced to Storage::PrefetchDirectory()?
+	 */
+	static constexpr size_t PREFETCH_WINDOW = 4;
+
 #ifndef WIN32
 	static constexpr bool DEFAULT_FOLLOW_INSIDE_SYMLINKS = true;
 	static constexpr bool DEFAULT_FOLLOW_OUTSIDE_SYMLINKS = true;
@@ -44,9 +60,48 @@ class UpdateWalk final {
 	bool follow_outside_symlinks;
 #endif
 
+	/**
+	 * Calculate MixRamp data for new and modified songs?  See
+	 * #ConfigOption::MIXRAMP_ANALYZER.
+	 */
+	bool mixramp_analyzer;
+
+	/**
+	 * Measure the loudness of new and modified songs?  See
+	 * #ConfigOption::LOUDNESS_ANALYZER.
+	 */
+	bool loudness_analyzer;
+
+	/**
+	 * Directories containing songs whose loudness was measured;
+	 * their album gain is calculated by UpdateAlbumGain() when
+	 * all of their songs have been scanned.
+	 */
+	std::set<Directory *> loudness_directories;
+
+	/**
+	 * Skip the files of directories whose mtime has not changed?
+	 * See #ConfigOption::UPDATE_TRUST_DIRECTORY_MTIME.
+	 */
+	bool trust_directory_mtime;
+
 	bool walk_discard;
 	bool modified;
 
+	/**
+	 * The nesting level of UpdateDirectory() calls.  The
+	 * directory the update was started for (level 1) is always
+	 * examined completely, because the caller expects a change
+	 * there.
+	 */
+	unsigned directory_depth;
+
+	/**
+	 * The number of directory entries which were not examined
+	 * because their directory was unchanged.
+	 */
+	unsigned skipped;
+
 	/**
 	 * Set to true by the main thread when the update thread shall
 	 * cancel as quickly as possible.  Access to this flag is
@@ -58,9 +113,19 @@ class UpdateWalk final {
 
 	DatabaseEditor editor;
 
+	/**
+	 * Worker threads for scanning song files; nullptr if songs
+	 * are scanned in this thread.  See
+	 * #ConfigOption::UPDATE_SCAN_THREADS.
+	 */
+	std::unique_ptr<UpdateScanPool> scan_pool;
+
+	UpdateThrottle &throttle;
+
 public:
 	UpdateWalk(EventLoop &_loop, DatabaseListener &_listener,
-		   Storage &_storage);
+		   Storage &_storage, UpdateThrottle &_throttle);
+	~UpdateWalk();
 
 	/**
 	 * Cancel the current update and quit the Walk() method as
@@ -85,6 +150,35 @@ private:
 
 	void PurgeDeletedFromDirectory(Directory &directory);
 
+	/**
+	 * Scan the tags of the given song, either in this thread or
+	 * in the #scan_pool.  The result is applied by
+	 * FinishScan().
+	 */
+	void ScanSong(Directory &directory, Song &song, bool is_new,
+		      const StorageFileInfo &info);
+
+	/**
+	 * Apply the result of a scan to the database and free the
+	 * job.
+	 */
+	void FinishScan(UpdateScanJob &job);
+
+	/**
+	 * Apply the results of jobs which were finished by the
+	 * #scan_pool.
+	 *
+	 * @param wait wait for all pending jobs?
+	 */
+	void FinishScans(bool wait);
+
+	/**
+	 * Calculate the album gain of all songs in the directory
+	 * which have measured ReplayGain data, grouped by their
+	 * album tag.
+	 */
+	void UpdateAlbumGain(Directory &directory);
+
 	void UpdateSongFile2(Directory &directory,
 			     const char *name, const char *suffix,
 			     const StorageFileInfo &info);
@@ -99,8 +193,23 @@ private:
 
 
 #ifdef ENABLE_ARCHIVE
-	void UpdateArchiveTree(ArchiveFile &archive, Directory &parent,
-			       const char *name);
+	/**
+	 * @param archive_path the local path of the archive file
+	 * @param name the remaining part of #entry below #parent
+	 * @param entry the full path of the entry inside the archive
+	 */
+	void UpdateArchiveTree(ArchiveFile &archive, Path archive_path,
+			       Directory &parent, const char *name,
+			       const char *entry);
+
+	/**
+	 * Add or update a song inside an archive.  With a
+	 * #scan_pool, a worker thread scans it with its own handle
+	 * of the archive.
+	 */
+	void UpdateArchiveSong(ArchiveFile &archive, Path archive_path,
+			       Directory &directory, const char *name,
+			       const char *entry);
 
 	bool UpdateArchiveFile(Directory &directory,
 			       const char *name, const char *suffix,
@@ -132,6 +241,33 @@ private:
 				  const char *name,
 				  const StorageFileInfo &info);
 
+	/**
+	 * Can the files of this directory be skipped, because its
+	 * mtime says it has not been changed since the last update?
+	 * See #trust_directory_mtime.
+	 */
+	gcc_pure
+	bool IsUnchanged(const Directory &directory,
+			 const StorageFileInfo &info) const;
+
+	/**
+	 * Pass the sub directories in entries[position..end[ to
+	 * Storage::PrefetchDirectory(), except for those which will
+	 * not be read.
+	 *
+	 * @return the new position
+	 */
+	size_t PrefetchDirectories(const Directory &directory,
+				   const std::vector<UpdateWalkEntry> &entries,
+				   size_t position, size_t end);
+
+	/**
+	 * Visit only the known sub directories of a directory which
+	 * has not been changed since the last update.
+	 */
+	void UpdateUnchangedDirectory(Directory &directory,
+				      const ExcludeList &exclude_list);
+
 	bool UpdateDirectory(Directory &directory,
 			     const ExcludeList &exclude_list,
 			     const StorageFileInfo &info);
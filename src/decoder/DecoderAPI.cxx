@@ -21,6 +21,7 @@
 #include "DecoderAPI.hxx"
 #include "DecoderError.hxx"
 #include "pcm/PcmConvert.hxx"
+#include "pcm/Interleave.hxx"
 #include "AudioConfig.hxx"
 #include "ReplayGainConfig.hxx"
 #include "MusicChunk.hxx"
@@ -29,15 +30,56 @@
 #include "DecoderControl.hxx"
 #include "DecoderInternal.hxx"
 #include "DetachedSong.hxx"
+#include "PerfStats.hxx"
 #include "input/InputStream.hxx"
+#include "system/Clock.hxx"
+#include "system/Trace.hxx"
 #include "util/Error.hxx"
 #include "util/ConstBuffer.hxx"
 #include "Log.hxx"
 
+#ifdef ENABLE_ENCODER
+#include "RenderCache.hxx"
+#endif
+
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 #include <math.h>
 
+/**
+ * Convert DecoderControl::max_buffer_time to a number of chunks of
+ * the new song's audio format, and apply
+ * DecoderControl::max_pipe_chunks.
+ */
+gcc_pure
+static unsigned
+CalculatePipeLimit(const DecoderControl &dc)
+{
+	unsigned n = dc.buffer->GetSize();
+	if (dc.max_pipe_chunks > 0)
+		n = std::min(n, dc.max_pipe_chunks);
+
+	if (!dc.max_buffer_time.IsZero()) {
+		const AudioFormat format = dc.out_audio_format;
+		const size_t chunk_bytes =
+			MusicChunkLimit(dc.buffer->GetChunkSize(), format);
+		n = std::min<unsigned>(n,
+				       ceil(dc.max_buffer_time.ToDoubleS()
+					    * format.GetTimeToSize()
+					    / chunk_bytes));
+	}
+
+	if (n >= dc.buffer->GetSize())
+		/* the buffer is the limit */
+		return 0;
+
+	/* at least two, so the decoder and the player can work in
+	   parallel */
+	return std::max(n, 2u);
+}
+
 void
 decoder_initialized(Decoder &decoder,
 		    const AudioFormat audio_format,
@@ -71,20 +113,52 @@ decoder_initialized(Decoder &decoder,
 			    audio_format_to_string(dc.out_audio_format,
 						   &af_string));
 
-		decoder.convert = new PcmConvert();
-
-		Error error;
-		if (!decoder.convert->Open(dc.in_audio_format,
-					   dc.out_audio_format,
-					   error))
-			decoder.error = std::move(error);
+		/* the converter of the previous song is still open
+		   if it was the same conversion */
+		decoder.convert = decoder.cache.TakeConvert(dc.in_audio_format,
+							    dc.out_audio_format);
+		if (decoder.convert == nullptr) {
+			decoder.convert = new PcmConvert();
+
+			Error error;
+			if (!decoder.convert->Open(dc.in_audio_format,
+						   dc.out_audio_format,
+						   error))
+				decoder.error = std::move(error);
+		}
 	}
 
+#ifdef ENABLE_ENCODER
+	if (decoder.render_allowed &&
+	    RenderCache::IsSynthesized(*decoder.plugin))
+		decoder.render = render_cache->BeginWrite(dc.song->GetRealURI(),
+							  dc.song->GetLastModified(),
+							  dc.in_audio_format);
+#endif
+
 	const ScopeLock protect(dc.mutex);
+	dc.pipe_limit = CalculatePipeLimit(dc);
 	dc.state = DecoderState::DECODE;
 	dc.client_cond.signal();
 }
 
+/**
+ * Must the PCM data be copied (and not be written directly into
+ * #MusicChunk by the plugin)?  Then decoder_data() is the only code
+ * path which can handle it.
+ */
+gcc_pure
+static bool
+decoder_needs_copy(const Decoder &decoder)
+{
+#ifdef ENABLE_ENCODER
+	if (decoder.render != nullptr)
+		return true;
+#endif
+
+	return decoder.convert != nullptr;
+}
+
 /**
  * Checks if we need an "initial seek".  If so, then the initial seek
  * is prepared, and the function returns true.
@@ -203,6 +277,9 @@ decoder_command_finished(Decoder &decoder)
 
 		dc.pipe->Clear(*dc.buffer);
 
+		/* the tag chunk may have been cleared, too */
+		decoder.tag_sent = false;
+
 		decoder.timestamp = dc.seek_time.ToDoubleS();
 	}
 
@@ -224,6 +301,9 @@ decoder_seek_time(Decoder &decoder)
 
 	decoder.seeking = true;
 
+	/* the recording would have a gap */
+	decoder.CancelRender();
+
 	return dc.seek_time;
 }
 
@@ -322,6 +402,12 @@ decoder_read(Decoder *decoder,
 	if (length == 0)
 		return 0;
 
+	const ScopeTrace trace("input.Read");
+
+	const uint64_t start_time = decoder != nullptr
+		? MonotonicClockUS()
+		: 0;
+
 	ScopeLock lock(is.mutex);
 
 	while (true) {
@@ -341,12 +427,126 @@ decoder_read(Decoder *decoder,
 
 	lock.Unlock();
 
+	if (decoder != nullptr && nbytes > 0)
+		decoder->input_stats.Add(is, nbytes,
+					 start_time, MonotonicClockUS());
+
 	if (gcc_unlikely(nbytes == 0 && error.IsDefined()))
 		LogError(error);
 
 	return nbytes;
 }
 
+AudioFormat
+decoder_preferred_format(const Decoder &decoder)
+{
+	AudioFormat result = decoder.dc.preferred_format;
+
+	/* the "audio_output_format" setting wins, because the
+	   decoder converts to it anyway */
+	const AudioFormat configured = getConfiguredAudioFormat();
+	if (configured.sample_rate != 0)
+		result.sample_rate = configured.sample_rate;
+
+	if (configured.format != SampleFormat::UNDEFINED)
+		result.format = configured.format;
+
+	if (configured.channels != 0)
+		result.channels = configured.channels;
+
+	return result;
+}
+
+void *
+decoder_take_context(Decoder &decoder)
+{
+	assert(decoder.plugin != nullptr);
+
+	return decoder.cache.TakeContext(*decoder.plugin);
+}
+
+void
+decoder_keep_context(Decoder &decoder, void *context,
+		     void (*free_context)(void *context))
+{
+	assert(decoder.plugin != nullptr);
+
+	decoder.cache.KeepContext(*decoder.plugin, context, free_context);
+}
+
+void
+decoder_cache_lookup(gcc_unused Decoder &decoder, bool hit)
+{
+	if (hit)
+		++perf_stats.decoder_cache_hits;
+	else
+		++perf_stats.decoder_cache_misses;
+}
+
+ConstBuffer<void>
+decoder_read_borrow(Decoder *decoder, InputStream &is,
+		    void *buffer, size_t length)
+{
+	assert(decoder == nullptr ||
+	       decoder->dc.state == DecoderState::START ||
+	       decoder->dc.state == DecoderState::DECODE);
+	assert(buffer != nullptr);
+
+	if (length == 0)
+		return { buffer, 0 };
+
+	const uint64_t start_time = decoder != nullptr
+		? MonotonicClockUS()
+		: 0;
+
+	ConstBuffer<void> result = nullptr;
+
+	{
+		const ScopeLock protect(is.mutex);
+
+		if (decoder_check_cancel_read(decoder))
+			return { buffer, 0 };
+
+		if (is.IsAvailable())
+			result = is.ReadDirect(length);
+	}
+
+	if (result.IsNull())
+		/* not supported by this stream, or end of file:
+		   let decoder_read() sort it out */
+		return { buffer, decoder_read(decoder, is, buffer, length) };
+
+	if (decoder != nullptr)
+		decoder->input_stats.Add(is, result.size,
+					 start_time, MonotonicClockUS());
+
+	return result;
+}
+
+const void *
+decoder_read_full_borrow(Decoder *decoder, InputStream &is,
+			 void *_buffer, size_t size)
+{
+	uint8_t *buffer = (uint8_t *)_buffer;
+
+	const auto r = decoder_read_borrow(decoder, is, buffer, size);
+	if (r.IsEmpty())
+		return nullptr;
+
+	if (r.size == size)
+		return r.data;
+
+	/* a partial result: collect the rest in the caller's
+	   buffer */
+
+	if (r.data != buffer)
+		memcpy(buffer, r.data, r.size);
+
+	return decoder_read_full(decoder, is, buffer + r.size, size - r.size)
+		? buffer
+		: nullptr;
+}
+
 bool
 decoder_read_full(Decoder *decoder, InputStream &is,
 		  void *_buffer, size_t size)
@@ -416,6 +616,33 @@ do_send_tag(Decoder &decoder, const Tag &tag)
 	return DecoderCommand::NONE;
 }
 
+/**
+ * Merge two tags (like Tag::Merge()) and send the result to the music
+ * pipe, unless it equals the tag which was sent last.  This avoids
+ * allocating and flushing chunks for streams which repeat their
+ * metadata.
+ *
+ * @param base an optional tag which is complemented by #add
+ */
+static DecoderCommand
+send_merged_tag(Decoder &decoder, const Tag &add, const Tag *base)
+{
+	TagBuilder &builder = decoder.cache.tag_builder;
+	assert(builder.IsEmpty());
+
+	builder.Complement(add);
+	if (base != nullptr)
+		builder.Complement(*base);
+
+	if (!builder.CommitIfChanged(decoder.sent_tag) && decoder.tag_sent)
+		/* nothing new */
+		return DecoderCommand::NONE;
+
+	const DecoderCommand cmd = do_send_tag(decoder, decoder.sent_tag);
+	decoder.tag_sent = cmd == DecoderCommand::NONE;
+	return cmd;
+}
+
 static bool
 update_stream_tag(Decoder &decoder, InputStream *is)
 {
@@ -442,22 +669,22 @@ update_stream_tag(Decoder &decoder, InputStream *is)
 	return true;
 }
 
-DecoderCommand
-decoder_data(Decoder &decoder,
-	     InputStream *is,
-	     const void *data, size_t length,
-	     uint16_t kbit_rate)
+/**
+ * Check for pending commands and send stream tags; this is the
+ * common prologue of decoder_data() and decoder_data_planar().
+ */
+static DecoderCommand
+decoder_data_prepare(Decoder &decoder, InputStream *is, size_t n_frames)
 {
-	DecoderControl &dc = decoder.dc;
+	gcc_unused const DecoderControl &dc = decoder.dc;
 
 	assert(dc.state == DecoderState::DECODE);
 	assert(dc.pipe != nullptr);
-	assert(length % dc.in_audio_format.GetFrameSize() == 0);
 
 	DecoderCommand cmd = decoder_lock_get_virtual_command(decoder);
 
 	if (cmd == DecoderCommand::STOP || cmd == DecoderCommand::SEEK ||
-	    length == 0)
+	    n_frames == 0)
 		return cmd;
 
 	assert(!decoder.initial_seek_pending);
@@ -465,21 +692,106 @@ decoder_data(Decoder &decoder,
 
 	/* send stream tags */
 
-	if (update_stream_tag(decoder, is)) {
-		if (decoder.decoder_tag != nullptr) {
-			/* merge with tag from decoder plugin */
-			Tag *tag = Tag::Merge(*decoder.decoder_tag,
-					      *decoder.stream_tag);
-			cmd = do_send_tag(decoder, *tag);
-			delete tag;
-		} else
-			/* send only the stream tag */
-			cmd = do_send_tag(decoder, *decoder.stream_tag);
-
-		if (cmd != DecoderCommand::NONE)
-			return cmd;
+	if (update_stream_tag(decoder, is))
+		/* merge with tag from decoder plugin (if any) */
+		cmd = send_merged_tag(decoder, *decoder.stream_tag,
+				      decoder.decoder_tag);
+
+	return cmd;
+}
+
+/**
+ * Account for #nbytes of PCM data which were written to the current
+ * chunk, and flush it when it is full.
+ *
+ * @return true if the end of the song range has been reached
+ */
+static bool
+decoder_expand_chunk(Decoder &decoder, size_t nbytes)
+{
+	DecoderControl &dc = decoder.dc;
+
+	if (decoder.chunk->Expand(dc.out_audio_format, nbytes))
+		/* the chunk is full, flush it */
+		decoder.FlushChunk();
+
+	decoder.timestamp += (double)nbytes /
+		dc.out_audio_format.GetTimeToSize();
+
+	return dc.end_time.IsPositive() &&
+		decoder.timestamp >= dc.end_time.ToDoubleS();
+}
+
+/**
+ * Fill music pipe chunks with #length bytes of PCM data in the
+ * output format.
+ *
+ * @param copy a function which copies the next #nbytes to the
+ * given chunk buffer; #nbytes is always a multiple of the frame size
+ */
+template<typename F>
+static DecoderCommand
+decoder_write_chunks(Decoder &decoder, size_t length, uint16_t kbit_rate,
+		     F &&copy)
+{
+	DecoderControl &dc = decoder.dc;
+
+	while (length > 0) {
+		MusicChunk *chunk = decoder.GetChunk();
+		if (chunk == nullptr) {
+			assert(dc.command != DecoderCommand::NONE);
+			return dc.command;
+		}
+
+		const auto dest =
+			chunk->Write(dc.out_audio_format,
+				     SongTime::FromS(decoder.timestamp) -
+				     dc.song->GetStartTime(),
+				     kbit_rate);
+		if (dest.IsEmpty()) {
+			/* the chunk is full, flush it */
+			decoder.FlushChunk();
+			continue;
+		}
+
+		const size_t nbytes = std::min(dest.size, length);
+
+		/* copy the buffer */
+
+		copy(dest.data, nbytes);
+
+		length -= nbytes;
+
+		if (decoder_expand_chunk(decoder, nbytes))
+			/* the end of this range has been reached:
+			   stop decoding */
+			return DecoderCommand::STOP;
 	}
 
+	return DecoderCommand::NONE;
+}
+
+DecoderCommand
+decoder_data(Decoder &decoder,
+	     InputStream *is,
+	     const void *data, size_t length,
+	     uint16_t kbit_rate)
+{
+	gcc_unused const DecoderControl &dc = decoder.dc;
+
+	assert(length % dc.in_audio_format.GetFrameSize() == 0);
+
+	const ScopeTrace trace("decoder.SubmitData");
+
+	DecoderCommand cmd = decoder_data_prepare(decoder, is, length);
+	if (cmd != DecoderCommand::NONE || length == 0)
+		return cmd;
+
+#ifdef ENABLE_ENCODER
+	if (decoder.render != nullptr)
+		decoder.render->Write(data, length);
+#endif
+
 	if (decoder.convert != nullptr) {
 		assert(dc.in_audio_format != dc.out_audio_format);
 
@@ -500,53 +812,129 @@ decoder_data(Decoder &decoder,
 		assert(dc.in_audio_format == dc.out_audio_format);
 	}
 
-	while (length > 0) {
-		MusicChunk *chunk;
-		bool full;
+	return decoder_write_chunks(decoder, length, kbit_rate,
+				    [&data](void *dest, size_t nbytes){
+					    memcpy(dest, data, nbytes);
+					    data = (const uint8_t *)data
+						    + nbytes;
+				    });
+}
+
+DecoderCommand
+decoder_data_planar(Decoder &decoder, InputStream *is,
+		    ConstBuffer<const void *> planes, size_t n_frames,
+		    uint16_t kbit_rate)
+{
+	DecoderControl &dc = decoder.dc;
+
+	assert(planes.size == dc.in_audio_format.channels);
+
+	const ScopeTrace trace("decoder.SubmitData");
+
+	const size_t sample_size = dc.in_audio_format.GetSampleSize();
+	const size_t frame_size = dc.in_audio_format.GetFrameSize();
+
+	if (decoder_needs_copy(decoder)) {
+		/* the converter needs interleaved input; use a
+		   temporary buffer and take the generic code path */
+		void *buffer = decoder.interleave_buffer.Get(n_frames *
+							     frame_size);
+		PcmInterleave(buffer, planes, n_frames, sample_size);
+		return decoder_data(decoder, is, buffer,
+				    n_frames * frame_size, kbit_rate);
+	}
+
+	assert(dc.in_audio_format == dc.out_audio_format);
+
+	DecoderCommand cmd = decoder_data_prepare(decoder, is, n_frames);
+	if (cmd != DecoderCommand::NONE || n_frames == 0)
+		return cmd;
+
+	/* interleave directly into the music pipe chunks */
 
-		chunk = decoder.GetChunk();
+	assert(planes.size <= MAX_CHANNELS);
+	const void *p[MAX_CHANNELS];
+	std::copy(planes.begin(), planes.end(), p);
+
+	return decoder_write_chunks(decoder, n_frames * frame_size, kbit_rate,
+				    [&](void *dest, size_t nbytes){
+					    const size_t n = nbytes / frame_size;
+					    PcmInterleave(dest,
+							  {p, planes.size},
+							  n, sample_size);
+
+					    for (unsigned c = 0; c < planes.size; ++c)
+						    p[c] = (const uint8_t *)p[c]
+							    + n * sample_size;
+				    });
+}
+
+DecoderCommand
+decoder_data_begin(Decoder &decoder, InputStream *is,
+		   size_t min_size, uint16_t kbit_rate,
+		   WritableBuffer<void> &dest)
+{
+	DecoderControl &dc = decoder.dc;
+
+	assert(min_size > 0);
+	assert(min_size % dc.in_audio_format.GetFrameSize() == 0);
+
+	dest = nullptr;
+
+	DecoderCommand cmd = decoder_data_prepare(decoder, is, min_size);
+	if (cmd != DecoderCommand::NONE)
+		return cmd;
+
+	if (decoder_needs_copy(decoder))
+		/* the data must be converted or recorded; the plugin
+		   has to use decoder_data() */
+		return DecoderCommand::NONE;
+
+	while (true) {
+		MusicChunk *chunk = decoder.GetChunk();
 		if (chunk == nullptr) {
 			assert(dc.command != DecoderCommand::NONE);
 			return dc.command;
 		}
 
-		const auto dest =
+		const auto w =
 			chunk->Write(dc.out_audio_format,
 				     SongTime::FromS(decoder.timestamp) -
 				     dc.song->GetStartTime(),
 				     kbit_rate);
-		if (dest.IsEmpty()) {
-			/* the chunk is full, flush it */
-			decoder.FlushChunk();
-			continue;
+		if (w.size >= min_size) {
+			dest = w;
+			return DecoderCommand::NONE;
 		}
 
-		const size_t nbytes = std::min(dest.size, length);
-
-		/* copy the buffer */
+		if (chunk->length == 0)
+			/* even an empty chunk is too small */
+			return DecoderCommand::NONE;
 
-		memcpy(dest.data, data, nbytes);
+		/* not enough room left in this chunk; flush it
+		   early */
+		decoder.FlushChunk();
+	}
+}
 
-		/* expand the music pipe chunk */
+DecoderCommand
+decoder_data_commit(Decoder &decoder, size_t length)
+{
+	gcc_unused const DecoderControl &dc = decoder.dc;
 
-		full = chunk->Expand(dc.out_audio_format, nbytes);
-		if (full) {
-			/* the chunk is full, flush it */
-			decoder.FlushChunk();
-		}
+	assert(!decoder_needs_copy(decoder));
+	assert(decoder.chunk != nullptr);
+	assert(length % dc.out_audio_format.GetFrameSize() == 0);
 
-		data = (const uint8_t *)data + nbytes;
-		length -= nbytes;
+	if (length == 0)
+		return DecoderCommand::NONE;
 
-		decoder.timestamp += (double)nbytes /
-			dc.out_audio_format.GetTimeToSize();
+	const ScopeTrace trace("decoder.SubmitData");
 
-		if (dc.end_time.IsPositive() &&
-		    decoder.timestamp >= dc.end_time.ToDoubleS())
-			/* the end of this range has been reached:
-			   stop decoding */
-			return DecoderCommand::STOP;
-	}
+	if (decoder_expand_chunk(decoder, length))
+		/* the end of this range has been reached: stop
+		   decoding */
+		return DecoderCommand::STOP;
 
 	return DecoderCommand::NONE;
 }
@@ -556,15 +944,16 @@ decoder_tag(Decoder &decoder, InputStream *is,
 	    Tag &&tag)
 {
 	gcc_unused const DecoderControl &dc = decoder.dc;
-	DecoderCommand cmd;
 
 	assert(dc.state == DecoderState::DECODE);
 	assert(dc.pipe != nullptr);
 
 	/* save the tag */
 
-	delete decoder.decoder_tag;
-	decoder.decoder_tag = new Tag(std::move(tag));
+	if (decoder.decoder_tag != nullptr)
+		*decoder.decoder_tag = std::move(tag);
+	else
+		decoder.decoder_tag = new Tag(std::move(tag));
 
 	/* check for a new stream tag */
 
@@ -578,21 +967,11 @@ decoder_tag(Decoder &decoder, InputStream *is,
 		   function here */
 		return DecoderCommand::SEEK;
 
-	/* send tag to music pipe */
-
-	if (decoder.stream_tag != nullptr) {
-		/* merge with tag from input stream */
-		Tag *merged;
+	/* send tag to music pipe, merged with the tag from the input
+	   stream (if any) */
 
-		merged = Tag::Merge(*decoder.stream_tag,
-				    *decoder.decoder_tag);
-		cmd = do_send_tag(decoder, *merged);
-		delete merged;
-	} else
-		/* send only the decoder tag */
-		cmd = do_send_tag(decoder, *decoder.decoder_tag);
-
-	return cmd;
+	return send_merged_tag(decoder, *decoder.decoder_tag,
+			       decoder.stream_tag);
 }
 
 void
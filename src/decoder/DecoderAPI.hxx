@@ -45,6 +45,8 @@
 #include <stdint.h>
 
 class Error;
+template<typename T> struct ConstBuffer;
+template<typename T> struct WritableBuffer;
 
 /**
  * Throw an instance of this class to stop decoding the current song
@@ -127,6 +129,50 @@ decoder_seek_error(Decoder &decoder);
 InputStreamPtr
 decoder_open_uri(Decoder &decoder, const char *uri, Error &error);
 
+/**
+ * Returns the audio format which would need the fewest conversions
+ * after the decoder, as a mask: undefined attributes mean there is
+ * no preference.  Decoder plugins which can produce several sample
+ * formats may use this to pick one before calling
+ * decoder_initialized().
+ */
+gcc_pure
+AudioFormat
+decoder_preferred_format(const Decoder &decoder);
+
+/**
+ * Returns the object which this plugin has passed to
+ * decoder_keep_context() while decoding the previous song, and
+ * transfers its ownership back to the plugin.  The plugin is
+ * responsible for resetting it.
+ *
+ * @return the object or nullptr if there is none
+ */
+void *
+decoder_take_context(Decoder &decoder);
+
+/**
+ * Hand a context object (e.g. a codec instance) to the decoder
+ * thread, to be reused for the next song with
+ * decoder_take_context().  This is meant to be called at the end of
+ * the decoder method.
+ *
+ * @param free_context a function which disposes the object if it
+ * is not going to be reused
+ */
+void
+decoder_keep_context(Decoder &decoder, void *context,
+		     void (*free_context)(void *context));
+
+/**
+ * Count a lookup in a persistent cache of the plugin (e.g. a seek
+ * table); the numbers are shown by the "perfstats" command.
+ *
+ * @param hit true if a valid entry was found
+ */
+void
+decoder_cache_lookup(Decoder &decoder, bool hit);
+
 /**
  * Blocking read from the input stream.
  *
@@ -148,6 +194,32 @@ decoder_read(Decoder &decoder, InputStream &is,
 	return decoder_read(&decoder, is, buffer, length);
 }
 
+/**
+ * Like decoder_read(), but if the #InputStream supports
+ * InputStream::ReadDirect(), return a pointer into its memory instead
+ * of copying to the caller's buffer.  The returned buffer is valid
+ * until the #InputStream is closed.
+ *
+ * @param buffer the destination buffer, used only if the stream
+ * cannot lend its memory
+ * @return the data, pointing either into the stream or to #buffer;
+ * empty on end of file, error or command
+ */
+ConstBuffer<void>
+decoder_read_borrow(Decoder *decoder, InputStream &is,
+		    void *buffer, size_t length);
+
+/**
+ * Like decoder_read_full(), but borrows the data from the
+ * #InputStream if possible (see decoder_read_borrow()).
+ *
+ * @return a pointer to exactly #size bytes (either into the stream
+ * or to #buffer), or nullptr on error or command or not enough data
+ */
+const void *
+decoder_read_full_borrow(Decoder *decoder, InputStream &is,
+			 void *buffer, size_t size);
+
 /**
  * Blocking read from the input stream.  Attempts to fill the buffer
  * completely; there is no partial result.
@@ -201,6 +273,64 @@ decoder_data(Decoder &decoder, InputStream &is,
 	return decoder_data(decoder, &is, data, length, kbit_rate);
 }
 
+/**
+ * Like decoder_data(), but the data is planar (one buffer per
+ * channel).  If no conversion is needed, the samples are
+ * interleaved directly into the music pipe, saving one copy.
+ *
+ * @param planes one buffer per channel, each containing #n_frames
+ * samples in the input sample format
+ * @param n_frames the number of frames
+ * @return the current command, or DecoderCommand::NONE if there is no
+ * command pending
+ */
+DecoderCommand
+decoder_data_planar(Decoder &decoder, InputStream *is,
+		    ConstBuffer<const void *> planes, size_t n_frames,
+		    uint16_t kbit_rate);
+
+/**
+ * Obtain a buffer inside the current music pipe chunk, so the plugin
+ * can decode directly into it instead of passing its own buffer to
+ * decoder_data(), which saves one copy.  After writing, the plugin
+ * must call decoder_data_commit().
+ *
+ * This is only possible if no PCM conversion is necessary.  If it
+ * is, or if a chunk cannot hold #min_size bytes, then #dest is
+ * cleared and the plugin has to use decoder_data() instead.
+ *
+ * @param min_size the minimum number of contiguous bytes the plugin
+ * needs (e.g. one frame, or one complete packet); the current chunk
+ * is flushed early if it has less room left
+ * @param dest receives the buffer on success
+ * @return the current command, or DecoderCommand::NONE if there is no
+ * command pending; #dest is only valid for DecoderCommand::NONE
+ */
+DecoderCommand
+decoder_data_begin(Decoder &decoder, InputStream *is,
+		   size_t min_size, uint16_t kbit_rate,
+		   WritableBuffer<void> &dest);
+
+static inline DecoderCommand
+decoder_data_begin(Decoder &decoder, InputStream &is,
+		   size_t min_size, uint16_t kbit_rate,
+		   WritableBuffer<void> &dest)
+{
+	return decoder_data_begin(decoder, &is, min_size, kbit_rate, dest);
+}
+
+/**
+ * Submit PCM data which was written into the buffer returned by
+ * decoder_data_begin().
+ *
+ * @param length the number of bytes which were written; a multiple
+ * of the frame size, and not more than the buffer size
+ * @return the current command, or DecoderCommand::NONE if there is no
+ * command pending
+ */
+DecoderCommand
+decoder_data_commit(Decoder &decoder, size_t length);
+
 /**
  * This function is called by the decoder plugin when it has
  * successfully decoded a tag.
@@ -21,9 +21,73 @@
 #include "DecoderBuffer.hxx"
 #include "DecoderAPI.hxx"
 
+#include <assert.h>
+#include <string.h>
+
+void
+DecoderBuffer::CopyDirect()
+{
+	assert(buffer.IsEmpty());
+	assert(direct.size <= buffer.GetCapacity());
+
+	auto w = buffer.Write();
+	memcpy(w.data, direct.data, direct.size);
+	buffer.Append(direct.size);
+	direct = nullptr;
+}
+
 bool
 DecoderBuffer::Fill()
 {
+	if (buffer.IsEmpty()) {
+		/* try to borrow memory from the stream, limited to
+		   the buffer capacity so decoders see the same
+		   amount of data either way */
+		const size_t capacity = buffer.GetCapacity();
+		if (direct.size >= capacity)
+			/* buffer is full */
+			return false;
+
+		auto w = buffer.Write();
+		const auto r = ConstBuffer<uint8_t>::FromVoid(
+			decoder_read_borrow(decoder, is, w.data,
+					    capacity - direct.size));
+		if (r.IsEmpty())
+			/* end of file, I/O error or decoder command
+			   received */
+			return false;
+
+		if (r.data != w.data) {
+			if (direct.IsEmpty()) {
+				direct = r;
+				return true;
+			}
+
+			if (r.data == direct.end()) {
+				/* contiguous: just extend the span */
+				direct.size += r.size;
+				return true;
+			}
+		}
+
+		/* the new data is not adjacent to the borrowed
+		   span; fall back to copying both */
+		if (r.data == w.data) {
+			/* decoder_read_borrow() has copied the new
+			   data to the beginning of the buffer; move
+			   it behind the borrowed data */
+			memmove(w.data + direct.size, w.data, r.size);
+			memcpy(w.data, direct.data, direct.size);
+		} else {
+			memcpy(w.data, direct.data, direct.size);
+			memcpy(w.data + direct.size, r.data, r.size);
+		}
+
+		buffer.Append(direct.size + r.size);
+		direct = nullptr;
+		return true;
+	}
+
 	auto w = buffer.Write();
 	if (w.IsEmpty())
 		/* buffer is full */
@@ -56,6 +120,17 @@ DecoderBuffer::Need(size_t min_size)
 bool
 DecoderBuffer::Skip(size_t nbytes)
 {
+	if (!direct.IsEmpty()) {
+		if (direct.size >= nbytes) {
+			direct.skip_front(nbytes);
+			return true;
+		}
+
+		nbytes -= direct.size;
+		direct = nullptr;
+		return decoder_skip(decoder, is, nbytes);
+	}
+
 	const auto r = buffer.Read();
 	if (r.size >= nbytes) {
 		buffer.Consume(nbytes);
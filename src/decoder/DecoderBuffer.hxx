@@ -34,6 +34,10 @@ class InputStream;
  * This objects handles buffered reads in decoder plugins easily.  You
  * create a buffer object, and use its high-level methods to fill and
  * read it.  It will automatically handle shifting the buffer.
+ *
+ * If the #InputStream supports InputStream::ReadDirect(), the data
+ * is borrowed from the stream instead of being copied into the
+ * buffer.
  */
 class DecoderBuffer {
 	Decoder *const decoder;
@@ -41,6 +45,13 @@ class DecoderBuffer {
 
 	DynamicFifoBuffer<uint8_t> buffer;
 
+	/**
+	 * Data borrowed from the #InputStream.  This is only used
+	 * while #buffer is empty; if the stream stops lending
+	 * memory, the remaining data gets copied to #buffer.
+	 */
+	ConstBuffer<uint8_t> direct;
+
 public:
 	/**
 	 * Creates a new buffer.
@@ -52,7 +63,7 @@ public:
 	 */
 	DecoderBuffer(Decoder *_decoder, InputStream &_is,
 		      size_t _size)
-		:decoder(_decoder), is(_is), buffer(_size) {}
+		:decoder(_decoder), is(_is), buffer(_size), direct(nullptr) {}
 
 	const InputStream &GetStream() const {
 		return is;
@@ -60,6 +71,7 @@ public:
 
 	void Clear() {
 		buffer.Clear();
+		direct = nullptr;
 	}
 
 	/**
@@ -76,7 +88,7 @@ public:
 	 */
 	gcc_pure
 	size_t GetAvailable() const {
-		return buffer.GetAvailable();
+		return buffer.GetAvailable() + direct.size;
 	}
 
 	/**
@@ -85,6 +97,9 @@ public:
 	 * becomes invalid after a Fill() or a Consume() call.
 	 */
 	ConstBuffer<void> Read() const {
+		if (!direct.IsEmpty())
+			return direct.ToVoid();
+
 		auto r = buffer.Read();
 		return { r.data, r.size };
 	}
@@ -103,7 +118,10 @@ public:
 	 * @param nbytes the number of bytes to consume
 	 */
 	void Consume(size_t nbytes) {
-		buffer.Consume(nbytes);
+		if (!direct.IsEmpty())
+			direct.skip_front(nbytes);
+		else
+			buffer.Consume(nbytes);
 	}
 
 	/**
@@ -113,6 +131,12 @@ public:
 	 * @return true on success, false on error
 	 */
 	bool Skip(size_t nbytes);
+
+private:
+	/**
+	 * Move the borrowed data into #buffer.
+	 */
+	void CopyDirect();
 };
 
 #endif
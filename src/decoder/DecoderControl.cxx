@@ -22,14 +22,20 @@
 #include "DecoderError.hxx"
 #include "MusicPipe.hxx"
 #include "DetachedSong.hxx"
+#include "input/InputStream.hxx"
+#include "util/UriUtil.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
 
 #include <assert.h>
 
-DecoderControl::DecoderControl(Mutex &_mutex, Cond &_client_cond)
+DecoderControl::DecoderControl(Mutex &_mutex, FastCond &_client_cond)
 	:mutex(_mutex), client_cond(_client_cond),
 	 state(DecoderState::STOP),
 	 command(DecoderCommand::NONE),
 	 client_is_waiting(false),
+	 preferred_format(AudioFormat::Undefined()),
 	 song(nullptr),
 	 replay_gain_db(0), replay_gain_prev_db(0) {}
 
@@ -83,6 +89,7 @@ DecoderControl::Start(DetachedSong *_song,
 	end_time = _end_time;
 	buffer = &_buffer;
 	pipe = &_pipe;
+	pipe_limit = 0;
 
 	LockSynchronousCommand(DecoderCommand::START);
 }
@@ -150,6 +157,148 @@ DecoderControl::Quit()
 	LockAsynchronousCommand(DecoderCommand::STOP);
 
 	thread.Join();
+
+	ClearPrefetch();
+}
+
+std::list<DecoderControl::PrefetchedStream>::iterator
+DecoderControl::FindPrefetch(const char *uri)
+{
+	return std::find_if(prefetched.begin(), prefetched.end(),
+			    [uri](const PrefetchedStream &p){
+				    return p.uri == uri;
+			    });
+}
+
+InputStreamPtr
+DecoderControl::OpenPrefetch(const char *uri)
+{
+	Error error2;
+	auto is = InputStream::Open(uri, mutex, cond, error2);
+	if (is == nullptr) {
+		/* the decoder thread will try again and report the
+		   error */
+		FormatDebug(decoder_domain, "Failed to prefetch %s: %s",
+			    uri, error2.GetMessage());
+		return nullptr;
+	}
+
+	FormatDebug(decoder_domain, "prefetching %s", uri);
+	return is;
+}
+
+void
+DecoderControl::Prefetch(const DetachedSong &_song)
+{
+	const char *uri = _song.GetRealURI();
+	if (!uri_has_scheme(uri))
+		return;
+
+	{
+		const ScopeLock protect(mutex);
+		if (FindPrefetch(uri) != prefetched.end())
+			/* already prefetched by PrefetchUpcoming() */
+			return;
+	}
+
+	auto is = OpenPrefetch(uri);
+	if (is == nullptr)
+		return;
+
+	std::list<PrefetchedStream> old;
+
+	{
+		const ScopeLock protect(mutex);
+		prefetched.push_back({uri, std::move(is)});
+
+		while (prefetched.size() > prefetch_limit)
+			old.splice(old.end(), prefetched, prefetched.begin());
+	}
+
+	/* close the old streams (if any) outside of the lock */
+}
+
+void
+DecoderControl::PrefetchUpcoming(const std::vector<std::string> &uris)
+{
+	std::list<PrefetchedStream> old;
+	std::vector<const std::string *> missing;
+
+	{
+		const ScopeLock protect(mutex);
+
+		/* move streams which are no longer upcoming to "old",
+		   to be closed outside of the lock */
+		for (auto i = prefetched.begin(); i != prefetched.end();) {
+			auto next = std::next(i);
+			if (std::find(uris.begin(), uris.end(),
+				      i->uri) == uris.end())
+				old.splice(old.end(), prefetched, i);
+			i = next;
+		}
+
+		size_t n = prefetched.size();
+		for (const auto &uri : uris) {
+			if (n >= prefetch_limit)
+				break;
+
+			if (!uri_has_scheme(uri.c_str()) ||
+			    FindPrefetch(uri.c_str()) != prefetched.end())
+				continue;
+
+			missing.push_back(&uri);
+			++n;
+		}
+	}
+
+	old.clear();
+
+	for (const std::string *uri : missing) {
+		auto is = OpenPrefetch(uri->c_str());
+		if (is == nullptr)
+			continue;
+
+		const ScopeLock protect(mutex);
+		prefetched.push_back({*uri, std::move(is)});
+	}
+}
+
+void
+DecoderControl::ClearPrefetch()
+{
+	std::list<PrefetchedStream> old;
+
+	{
+		const ScopeLock protect(mutex);
+		old.swap(prefetched);
+	}
+
+	/* close the streams outside of the lock */
+}
+
+void
+DecoderControl::DiscardPrefetch(const char *uri)
+{
+	/* the returned stream is closed outside of the lock */
+	TakePrefetch(uri);
+}
+
+InputStreamPtr
+DecoderControl::TakePrefetch(const char *uri)
+{
+	InputStreamPtr is;
+
+	{
+		const ScopeLock protect(mutex);
+		auto i = FindPrefetch(uri);
+		if (i == prefetched.end())
+			return nullptr;
+
+		is = std::move(i->is);
+		prefetched.erase(i);
+	}
+
+	return is;
 }
 
 void
@@ -25,11 +25,16 @@
 #include "MixRampInfo.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
+#include "thread/FastCond.hxx"
 #include "thread/Thread.hxx"
 #include "Chrono.hxx"
+#include "input/Ptr.hxx"
 #include "util/Error.hxx"
 
+#include <list>
+#include <string>
 #include <utility>
+#include <vector>
 
 #include <assert.h>
 #include <stdint.h>
@@ -86,7 +91,7 @@ struct DecoderControl {
 	 *
 	 * This is usually a reference to PlayerControl::cond.
 	 */
-	Cond &client_cond;
+	FastCond &client_cond;
 
 	DecoderState state;
 	DecoderCommand command;
@@ -118,6 +123,13 @@ struct DecoderControl {
 	/** the format being sent to the music pipe */
 	AudioFormat out_audio_format;
 
+	/**
+	 * The format the audio outputs would like to receive (a mask,
+	 * see MultipleOutputs::GetPreferredFormat()).  This is set by
+	 * the client before the decoder thread is started.
+	 */
+	AudioFormat preferred_format;
+
 	/**
 	 * The song currently being decoded.  This attribute is set by
 	 * the player thread, when it sends the #DecoderCommand::START
@@ -160,11 +172,58 @@ struct DecoderControl {
 
 	MixRampInfo mix_ramp, previous_mix_ramp;
 
+	struct PrefetchedStream {
+		std::string uri;
+		InputStreamPtr is;
+	};
+
+	/**
+	 * Input streams which were opened in advance by the player
+	 * thread, see Prefetch() and PrefetchUpcoming().  The
+	 * decoder thread picks one up if its URI matches the song
+	 * being opened.  The oldest entry is first.
+	 *
+	 * Protected by #mutex.
+	 */
+	std::list<PrefetchedStream> prefetched;
+
+	/**
+	 * The maximum size of #prefetched.
+	 */
+	unsigned prefetch_limit = 1;
+
+	/**
+	 * If non-zero, then the decoder does not fill #pipe with more
+	 * than this duration of audio, even if the #MusicBuffer has
+	 * room for more.  This is set by the client before the
+	 * decoder thread is started (see #ConfigOption::LOW_MEMORY).
+	 */
+	SongTime max_buffer_time = SongTime::zero();
+
+	/**
+	 * If non-zero, then the decoder does not fill #pipe with more
+	 * than this number of chunks; the rest of the #MusicBuffer is
+	 * reserved for cross-fading (see
+	 * #ConfigOption::CROSSFADE_BUFFER_SIZE).  This is set by the
+	 * client before the decoder thread is started.
+	 */
+	unsigned max_pipe_chunks = 0;
+
+	/**
+	 * The maximum number of chunks in #pipe, calculated from
+	 * #max_buffer_time and #out_audio_format by the decoder
+	 * thread; 0 means no limit other than the #MusicBuffer
+	 * size.
+	 *
+	 * Protected by #mutex.
+	 */
+	unsigned pipe_limit = 0;
+
 	/**
 	 * @param _mutex see #mutex
 	 * @param _client_cond see #client_cond
 	 */
-	DecoderControl(Mutex &_mutex, Cond &_client_cond);
+	DecoderControl(Mutex &_mutex, FastCond &_client_cond);
 	~DecoderControl();
 
 	/**
@@ -373,6 +432,71 @@ public:
 
 	void Quit();
 
+	/**
+	 * Open the input stream of the specified song now, so it has
+	 * time to connect and to fill its buffer before the decoder
+	 * gets to this song.  Local files are not prefetched, because
+	 * they open quickly.
+	 *
+	 * If #prefetch_limit is exceeded, the oldest prefetched
+	 * stream is closed.
+	 *
+	 * To be called from the client thread.  Caller must not lock
+	 * the object.
+	 */
+	void Prefetch(const DetachedSong &song);
+
+	/**
+	 * Make the prefetched streams match the given list of
+	 * upcoming URIs (in playback order): close streams which are
+	 * not in the list, and open the missing ones, up to
+	 * #prefetch_limit.
+	 *
+	 * To be called from the client thread.  Caller must not lock
+	 * the object.
+	 */
+	void PrefetchUpcoming(const std::vector<std::string> &uris);
+
+	/**
+	 * Close all prefetched streams.
+	 *
+	 * Caller must not lock the object.
+	 */
+	void ClearPrefetch();
+
+	/**
+	 * Close the prefetched stream with the given URI (if any).
+	 *
+	 * Caller must not lock the object.
+	 */
+	void DiscardPrefetch(const char *uri);
+
+	/**
+	 * Remove the prefetched stream with the given URI from this
+	 * object.
+	 *
+	 * To be called from the decoder thread.  Caller must not lock
+	 * the object.
+	 *
+	 * @param uri the URI which is going to be opened
+	 * @return the prefetched stream (which may still be
+	 * connecting), or nullptr if there is none for this URI
+	 */
+	InputStreamPtr TakePrefetch(const char *uri);
+
+private:
+	gcc_pure
+	std::list<PrefetchedStream>::iterator FindPrefetch(const char *uri);
+
+	/**
+	 * Open a stream for #prefetched.  Returns nullptr on error
+	 * (which is only logged, because the decoder thread will try
+	 * again and report it).
+	 */
+	InputStreamPtr OpenPrefetch(const char *uri);
+
+public:
+
 	const char *GetMixRampStart() const {
 		return mix_ramp.GetStart();
 	}
@@ -24,10 +24,95 @@
 #include "MusicPipe.hxx"
 #include "MusicBuffer.hxx"
 #include "MusicChunk.hxx"
+#include "PerfStats.hxx"
 #include "tag/Tag.hxx"
+#include "system/Clock.hxx"
+
+#ifdef ENABLE_ENCODER
+#include "RenderCache.hxx"
+#endif
 
 #include <assert.h>
 
+void
+DecoderCache::KeepConvert(PcmConvert *_convert,
+			  AudioFormat in_format, AudioFormat out_format)
+{
+	assert(_convert != nullptr);
+
+	ClearConvert();
+
+	convert = _convert;
+	convert_in_format = in_format;
+	convert_out_format = out_format;
+}
+
+PcmConvert *
+DecoderCache::TakeConvert(AudioFormat in_format, AudioFormat out_format)
+{
+	if (convert == nullptr ||
+	    in_format != convert_in_format ||
+	    out_format != convert_out_format) {
+		ClearConvert();
+		return nullptr;
+	}
+
+	PcmConvert *result = convert;
+	convert = nullptr;
+	return result;
+}
+
+void
+DecoderCache::ClearConvert()
+{
+	if (convert != nullptr) {
+		convert->Close();
+		delete convert;
+		convert = nullptr;
+	}
+}
+
+void
+DecoderCache::KeepContext(const DecoderPlugin &_plugin, void *_context,
+			  void (*_free_context)(void *context))
+{
+	assert(_context != nullptr);
+	assert(_free_context != nullptr);
+
+	ClearContext();
+
+	plugin = &_plugin;
+	context = _context;
+	free_context = _free_context;
+}
+
+void *
+DecoderCache::TakeContext(const DecoderPlugin &_plugin)
+{
+	if (context == nullptr)
+		return nullptr;
+
+	if (plugin != &_plugin) {
+		ClearContext();
+		return nullptr;
+	}
+
+	void *result = context;
+	context = nullptr;
+	plugin = nullptr;
+	return result;
+}
+
+void
+DecoderCache::ClearContext()
+{
+	if (context != nullptr) {
+		free_context(context);
+		context = nullptr;
+		plugin = nullptr;
+	}
+}
+
 Decoder::~Decoder()
 {
 	/* caller must flush the chunk */
@@ -41,6 +126,17 @@ Decoder::~Decoder()
 	delete song_tag;
 	delete stream_tag;
 	delete decoder_tag;
+
+	CancelRender();
+}
+
+void
+Decoder::CancelRender()
+{
+#ifdef ENABLE_ENCODER
+	delete render;
+	render = nullptr;
+#endif
 }
 
 /**
@@ -71,20 +167,36 @@ Decoder::GetChunk()
 	if (chunk != nullptr)
 		return chunk;
 
+	/* the time stamp of the first failed allocation */
+	uint64_t wait_start = 0;
+
 	do {
-		chunk = dc.buffer->Allocate();
+		/* with DecoderControl::pipe_limit, the pipe may be
+		   "full" long before the buffer is (this attribute is
+		   only written by this thread, so no lock is
+		   needed) */
+		if (dc.pipe_limit == 0 || dc.pipe->GetSize() < dc.pipe_limit)
+			chunk = dc.buffer->Allocate();
+
 		if (chunk != nullptr) {
 			chunk->replay_gain_serial = replay_gain_serial;
 			if (replay_gain_serial != 0)
 				chunk->replay_gain_info = replay_gain_info;
 
-			return chunk;
+			break;
 		}
 
+		if (wait_start == 0)
+			wait_start = MonotonicClockUS();
+
 		cmd = LockNeedChunks(dc);
 	} while (cmd == DecoderCommand::NONE);
 
-	return nullptr;
+	if (wait_start != 0)
+		perf_stats.decoder_buffer_wait.Add(MonotonicClockUS() -
+						   wait_start);
+
+	return chunk;
 }
 
 void
@@ -97,8 +209,11 @@ Decoder::FlushChunk()
 
 	if (chunk->IsEmpty())
 		dc.buffer->Return(chunk);
-	else
+	else {
+		chunk->submit_time = MonotonicClockUS();
 		dc.pipe->Push(chunk);
+		++perf_stats.decoder_chunks;
+	}
 
 	chunk = nullptr;
 
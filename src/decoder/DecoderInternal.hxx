@@ -21,22 +21,116 @@
 #define MPD_DECODER_INTERNAL_HXX
 
 #include "ReplayGainInfo.hxx"
+#include "AudioFormat.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "input/InputStats.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagBuilder.hxx"
 #include "util/Error.hxx"
 
 class PcmConvert;
+class RenderCacheWriter;
 struct MusicChunk;
 struct DecoderControl;
-struct Tag;
+struct DecoderPlugin;
+
+/**
+ * Objects which outlive the #Decoder of one song, so the next song
+ * can reuse them.  This avoids setting up the converter and the
+ * codec again and again while playing an album.  It is owned by the
+ * decoder thread.
+ */
+struct DecoderCache {
+	/**
+	 * The converter of the previous song; it is still open.
+	 * nullptr if there is none.
+	 */
+	PcmConvert *convert = nullptr;
+
+	/**
+	 * The formats #convert was opened with.
+	 */
+	AudioFormat convert_in_format, convert_out_format;
+
+	/**
+	 * The plugin which has passed #context to
+	 * decoder_keep_context().
+	 */
+	const DecoderPlugin *plugin = nullptr;
+
+	void *context = nullptr;
+	void (*free_context)(void *context) = nullptr;
+
+	/**
+	 * Used to merge the stream tag and the decoder tag.  It is
+	 * kept here, so its item vector doesn't need to grow again
+	 * for each song.
+	 */
+	TagBuilder tag_builder;
+
+	DecoderCache() = default;
+	DecoderCache(const DecoderCache &) = delete;
+	DecoderCache &operator=(const DecoderCache &) = delete;
+
+	~DecoderCache() {
+		ClearConvert();
+		ClearContext();
+	}
+
+	/**
+	 * Keep an open converter for the next song.
+	 */
+	void KeepConvert(PcmConvert *_convert,
+			 AudioFormat in_format, AudioFormat out_format);
+
+	/**
+	 * Obtain the converter if it has been opened with the given
+	 * formats, and transfer its ownership to the caller.
+	 *
+	 * @return the converter or nullptr
+	 */
+	PcmConvert *TakeConvert(AudioFormat in_format,
+				AudioFormat out_format);
+
+	void ClearConvert();
+
+	void KeepContext(const DecoderPlugin &_plugin, void *_context,
+			 void (*_free_context)(void *context));
+
+	/**
+	 * Obtain the context object if it has been kept by the given
+	 * plugin, and transfer its ownership to the caller.
+	 *
+	 * @return the object or nullptr
+	 */
+	void *TakeContext(const DecoderPlugin &_plugin);
+
+	void ClearContext();
+};
 
 struct Decoder {
 	DecoderControl &dc;
 
+	DecoderCache &cache;
+
+	/**
+	 * The plugin which is currently decoding this song; nullptr
+	 * before the first plugin is tried.
+	 */
+	const DecoderPlugin *plugin;
+
 	/**
 	 * For converting input data to the configured audio format.
 	 * nullptr means no conversion necessary.
 	 */
 	PcmConvert *convert;
 
+	/**
+	 * A buffer for interleaving planar data which needs to be
+	 * passed to #convert.  See decoder_data_planar().
+	 */
+	PcmBuffer interleave_buffer;
+
 	/**
 	 * The time stamp of the next data chunk, in seconds.
 	 */
@@ -76,6 +170,19 @@ struct Decoder {
 	/** the last tag received from the decoder plugin */
 	Tag *decoder_tag;
 
+	/**
+	 * A copy of the last tag which was sent to the music pipe.
+	 * Only valid if #tag_sent is set.
+	 */
+	Tag sent_tag;
+
+	/**
+	 * Has #sent_tag been sent to the music pipe (and not been
+	 * discarded by seeking)?  If the next merged tag equals
+	 * #sent_tag, it is not sent again.
+	 */
+	bool tag_sent;
+
 	/** the chunk currently being written to */
 	MusicChunk *chunk;
 
@@ -93,14 +200,37 @@ struct Decoder {
 	 */
 	Error error;
 
-	Decoder(DecoderControl &_dc, bool _initial_seek_pending, Tag *_tag)
-		:dc(_dc),
+	/**
+	 * Measures how fast decoder_read() is served; feeds the
+	 * adaptive buffer_before_play calculation.
+	 */
+	InputStatsMeter input_stats;
+
+#ifdef ENABLE_ENCODER
+	/**
+	 * May the PCM output of this song be recorded into the
+	 * #RenderCache?  Set by the decoder thread before the plugin
+	 * is invoked.
+	 */
+	bool render_allowed = false;
+
+	/**
+	 * Records the PCM data passed to decoder_data() into the
+	 * #RenderCache.  nullptr if not recording.
+	 */
+	RenderCacheWriter *render = nullptr;
+#endif
+
+	Decoder(DecoderControl &_dc, DecoderCache &_cache,
+		bool _initial_seek_pending, Tag *_tag)
+		:dc(_dc), cache(_cache), plugin(nullptr),
 		 convert(nullptr),
 		 timestamp(0),
 		 initial_seek_pending(_initial_seek_pending),
 		 initial_seek_running(false),
 		 seeking(false),
 		 song_tag(_tag), stream_tag(nullptr), decoder_tag(nullptr),
+		 tag_sent(false),
 		 chunk(nullptr),
 		 replay_gain_serial(0) {
 	}
@@ -121,6 +251,12 @@ struct Decoder {
 	 * Caller must not lock the #DecoderControl object.
 	 */
 	void FlushChunk();
+
+	/**
+	 * Stop recording into the #RenderCache, because the output
+	 * will not be complete.
+	 */
+	void CancelRender();
 };
 
 #endif
@@ -44,6 +44,11 @@
 #include "plugins/FluidsynthDecoderPlugin.hxx"
 #include "plugins/SidplayDecoderPlugin.hxx"
 #include "util/Macros.hxx"
+#include "util/CharUtil.hxx"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
 
 #include <string.h>
 
@@ -117,6 +122,62 @@ static constexpr unsigned num_decoder_plugins =
 /** which plugins have been initialized successfully? */
 bool decoder_plugins_enabled[num_decoder_plugins];
 
+/**
+ * Maps lower-case strings to the enabled plugins supporting them, in
+ * order of priority.
+ */
+typedef std::unordered_map<std::string,
+			   std::vector<const DecoderPlugin *>> DecoderPluginIndex;
+
+static DecoderPluginIndex decoder_suffix_index, decoder_mime_type_index;
+
+gcc_pure
+static std::string
+FoldIndexKey(const char *s)
+{
+	std::string key(s);
+	for (auto &ch : key)
+		ch = ToLowerASCII(ch);
+	return key;
+}
+
+static void
+AddToIndex(DecoderPluginIndex &index, const char *const*strings,
+	   const DecoderPlugin &plugin)
+{
+	if (strings == nullptr)
+		return;
+
+	for (; *strings != nullptr; ++strings) {
+		auto &list = index[FoldIndexKey(*strings)];
+		if (list.empty() || list.back() != &plugin)
+			list.push_back(&plugin);
+	}
+}
+
+gcc_pure
+static ConstBuffer<const DecoderPlugin *>
+LookupIndex(const DecoderPluginIndex &index, const char *key)
+{
+	auto i = index.find(FoldIndexKey(key));
+	if (i == index.end())
+		return nullptr;
+
+	return {i->second.data(), i->second.size()};
+}
+
+ConstBuffer<const DecoderPlugin *>
+decoder_plugins_for_suffix(const char *suffix)
+{
+	return LookupIndex(decoder_suffix_index, suffix);
+}
+
+ConstBuffer<const DecoderPlugin *>
+decoder_plugins_for_mime_type(const char *mime_type)
+{
+	return LookupIndex(decoder_mime_type_index, mime_type);
+}
+
 const struct DecoderPlugin *
 decoder_plugin_from_name(const char *name)
 {
@@ -144,6 +205,13 @@ void decoder_plugin_init_all(void)
 		if (plugin.Init(*param))
 			decoder_plugins_enabled[i] = true;
 	}
+
+	decoder_plugins_for_each_enabled([](const DecoderPlugin &plugin){
+			AddToIndex(decoder_suffix_index, plugin.suffixes,
+				   plugin);
+			AddToIndex(decoder_mime_type_index, plugin.mime_types,
+				   plugin);
+		});
 }
 
 void decoder_plugin_deinit_all(void)
@@ -151,12 +219,13 @@ void decoder_plugin_deinit_all(void)
 	decoder_plugins_for_each_enabled([=](const DecoderPlugin &plugin){
 			plugin.Finish();
 		});
+
+	decoder_suffix_index.clear();
+	decoder_mime_type_index.clear();
 }
 
 bool
 decoder_plugins_supports_suffix(const char *suffix)
 {
-	return decoder_plugins_try([suffix](const DecoderPlugin &plugin){
-			return plugin.SupportsSuffix(suffix);
-		});
+	return !decoder_plugins_for_suffix(suffix).IsEmpty();
 }
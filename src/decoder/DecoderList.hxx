@@ -20,8 +20,11 @@
 #ifndef MPD_DECODER_LIST_HXX
 #define MPD_DECODER_LIST_HXX
 
+#include "util/ConstBuffer.hxx"
 #include "Compiler.h"
 
+#include <algorithm>
+
 struct DecoderPlugin;
 
 extern const struct DecoderPlugin *const decoder_plugins[];
@@ -80,6 +83,86 @@ decoder_plugins_for_each_enabled(F f)
 			f(*decoder_plugins[i]);
 }
 
+/**
+ * Returns the enabled plugins which support the specified file name
+ * suffix (case-insensitive), in order of priority.  This looks up an
+ * index which is built by decoder_plugin_init_all().
+ */
+gcc_pure gcc_nonnull_all
+ConstBuffer<const DecoderPlugin *>
+decoder_plugins_for_suffix(const char *suffix);
+
+/**
+ * Like decoder_plugins_for_suffix(), but look up a MIME type.
+ */
+gcc_pure gcc_nonnull_all
+ConstBuffer<const DecoderPlugin *>
+decoder_plugins_for_mime_type(const char *mime_type);
+
+template<typename F>
+static inline bool
+decoder_plugins_try_list(ConstBuffer<const DecoderPlugin *> list, F f)
+{
+	for (const DecoderPlugin *plugin : list)
+		if (f(*plugin))
+			return true;
+
+	return false;
+}
+
+/**
+ * Invoke #f for each enabled plugin which supports the specified
+ * suffix, until it returns true.
+ */
+template<typename F>
+static inline bool
+decoder_plugins_try_suffix(const char *suffix, F f)
+{
+	return decoder_plugins_try_list(decoder_plugins_for_suffix(suffix), f);
+}
+
+template<typename F>
+static inline const DecoderPlugin *
+decoder_plugins_find_suffix(const char *suffix, F f)
+{
+	for (const DecoderPlugin *plugin : decoder_plugins_for_suffix(suffix))
+		if (f(*plugin))
+			return plugin;
+
+	return nullptr;
+}
+
+/**
+ * Invoke #f for each enabled plugin which supports the MIME type or
+ * the suffix (both may be nullptr), in order of priority, until it
+ * returns true.
+ */
+template<typename F>
+static inline bool
+decoder_plugins_try_mime_suffix(const char *mime_type, const char *suffix,
+				F f)
+{
+	const auto by_mime = mime_type != nullptr
+		? decoder_plugins_for_mime_type(mime_type)
+		: nullptr;
+	const auto by_suffix = suffix != nullptr
+		? decoder_plugins_for_suffix(suffix)
+		: nullptr;
+
+	if (by_mime.IsEmpty())
+		/* the common case: no need to merge */
+		return decoder_plugins_try_list(by_suffix, f);
+
+	return decoder_plugins_try([&](const DecoderPlugin &plugin){
+			const DecoderPlugin *p = &plugin;
+			return (std::find(by_mime.begin(), by_mime.end(), p)
+				!= by_mime.end() ||
+				std::find(by_suffix.begin(), by_suffix.end(), p)
+				!= by_suffix.end()) &&
+				f(plugin);
+		});
+}
+
 /**
  * Is there at least once #DecoderPlugin that supports the specified
  * file name suffix?
@@ -25,7 +25,9 @@
 #include "DecoderPlugin.hxx"
 #include "DetachedSong.hxx"
 #include "system/FatalError.hxx"
+#include "system/Clock.hxx"
 #include "MusicPipe.hxx"
+#include "PerfStats.hxx"
 #include "fs/Traits.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "DecoderAPI.hxx"
@@ -36,9 +38,14 @@
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "thread/Name.hxx"
+#include "ThreadSettings.hxx"
 #include "tag/ApeReplayGain.hxx"
 #include "Log.hxx"
 
+#ifdef ENABLE_ENCODER
+#include "RenderCache.hxx"
+#endif
+
 #include <stdexcept>
 #include <functional>
 #include <memory>
@@ -46,8 +53,9 @@
 static constexpr Domain decoder_thread_domain("decoder_thread");
 
 /**
- * Opens the input stream with InputStream::Open(), and waits until
- * the stream gets ready.  If a decoder STOP command is received
+ * Opens the input stream with InputStream::Open() (or picks up the
+ * one opened by DecoderControl::Prefetch()), and waits until the
+ * stream gets ready.  If a decoder STOP command is received
  * during that, it cancels the operation (but does not close the
  * stream).
  *
@@ -59,9 +67,13 @@ static constexpr Domain decoder_thread_domain("decoder_thread");
 static InputStreamPtr
 decoder_input_stream_open(DecoderControl &dc, const char *uri, Error &error)
 {
-	auto is = InputStream::Open(uri, dc.mutex, dc.cond, error);
-	if (is == nullptr)
-		return nullptr;
+	/* the player thread may have opened it already */
+	auto is = dc.TakePrefetch(uri);
+	if (is == nullptr) {
+		is = InputStream::Open(uri, dc.mutex, dc.cond, error);
+		if (is == nullptr)
+			return nullptr;
+	}
 
 	/* wait for the input stream to become ready; its metadata
 	   will be available then */
@@ -120,6 +132,8 @@ decoder_stream_decode(const DecoderPlugin &plugin,
 	/* rewind the stream, so each plugin gets a fresh start */
 	input_stream.Rewind(IgnoreError());
 
+	decoder.plugin = &plugin;
+
 	{
 		const ScopeUnlock unlock(decoder.dc.mutex);
 
@@ -157,6 +171,8 @@ decoder_file_decode(const DecoderPlugin &plugin,
 	if (decoder.dc.command == DecoderCommand::STOP)
 		return true;
 
+	decoder.plugin = &plugin;
+
 	{
 		const ScopeUnlock unlock(decoder.dc.mutex);
 
@@ -173,42 +189,15 @@ decoder_file_decode(const DecoderPlugin &plugin,
 	return decoder.dc.state != DecoderState::START;
 }
 
-gcc_pure
-static bool
-decoder_check_plugin_mime(const DecoderPlugin &plugin, const InputStream &is)
-{
-	assert(plugin.stream_decode != nullptr);
-
-	const char *mime_type = is.GetMimeType();
-	return mime_type != nullptr && plugin.SupportsMimeType(mime_type);
-}
-
-gcc_pure
-static bool
-decoder_check_plugin_suffix(const DecoderPlugin &plugin, const char *suffix)
-{
-	assert(plugin.stream_decode != nullptr);
-
-	return suffix != nullptr && plugin.SupportsSuffix(suffix);
-}
-
-gcc_pure
-static bool
-decoder_check_plugin(const DecoderPlugin &plugin, const InputStream &is,
-		     const char *suffix)
-{
-	return plugin.stream_decode != nullptr &&
-		(decoder_check_plugin_mime(plugin, is) ||
-		 decoder_check_plugin_suffix(plugin, suffix));
-}
-
+/**
+ * Try the plugin, which was found by MIME type or by suffix.
+ */
 static bool
 decoder_run_stream_plugin(Decoder &decoder, InputStream &is,
-			  const char *suffix,
 			  const DecoderPlugin &plugin,
 			  bool &tried_r)
 {
-	if (!decoder_check_plugin(plugin, is, suffix))
+	if (plugin.stream_decode == nullptr)
 		return false;
 
 	decoder.error.Clear();
@@ -226,9 +215,9 @@ decoder_run_stream_locked(Decoder &decoder, InputStream &is,
 
 	using namespace std::placeholders;
 	const auto f = std::bind(decoder_run_stream_plugin,
-				 std::ref(decoder), std::ref(is), suffix,
+				 std::ref(decoder), std::ref(is),
 				 _1, std::ref(tried_r));
-	return decoder_plugins_try(f);
+	return decoder_plugins_try_mime_suffix(is.GetMimeType(), suffix, f);
 }
 
 /**
@@ -294,13 +283,10 @@ decoder_run_stream(Decoder &decoder, const char *uri)
  * DecoderControl::mutex is not locked by caller.
  */
 static bool
-TryDecoderFile(Decoder &decoder, Path path_fs, const char *suffix,
+TryDecoderFile(Decoder &decoder, Path path_fs,
 	       InputStream &input_stream,
 	       const DecoderPlugin &plugin)
 {
-	if (!plugin.SupportsSuffix(suffix))
-		return false;
-
 	decoder.error.Clear();
 
 	DecoderControl &dc = decoder.dc;
@@ -335,14 +321,13 @@ decoder_run_file(Decoder &decoder, const char *uri_utf8, Path path_fs)
 	LoadReplayGain(decoder, *input_stream);
 
 	auto &is = *input_stream;
-	return decoder_plugins_try([&decoder, path_fs, suffix,
-				    &is](const DecoderPlugin &plugin){
-					   return TryDecoderFile(decoder,
-								 path_fs,
-								 suffix,
-								 is,
-								 plugin);
-				   });
+	return decoder_plugins_try_suffix(suffix,
+					  [&decoder, path_fs, &is](const DecoderPlugin &plugin){
+						  return TryDecoderFile(decoder,
+									path_fs,
+									is,
+									plugin);
+					  });
 }
 
 /**
@@ -379,16 +364,99 @@ try {
 	return false;
 }
 
+#ifdef ENABLE_ENCODER
+
+/**
+ * Play a complete rendering of the song from the #RenderCache.
+ *
+ * DecoderControl::mutex is not locked by caller.
+ *
+ * @param success_r receives the result if the function returns true
+ * @return false if nothing has been played, and the song shall be
+ * decoded with its own plugin
+ */
+static bool
+DecoderUnlockedRunRenderCache(Decoder &decoder, Path path_fs,
+			      bool &success_r)
+try {
+	auto input_stream = decoder_input_stream_open(decoder.dc, path_fs,
+						      decoder.error);
+	if (input_stream != nullptr) {
+		success_r = TryDecoderFile(decoder, path_fs, *input_stream,
+					   render_cache->GetDecoderPlugin());
+		if (success_r)
+			return true;
+	}
+
+	/* if the cached file has been played partially, it's too
+	   late for a fallback */
+	const ScopeLock protect(decoder.dc.mutex);
+	success_r = false;
+	return decoder.dc.state != DecoderState::START;
+} catch (StopDecoder) {
+	success_r = true;
+	return true;
+} catch (const std::runtime_error &e) {
+	LogError(e);
+
+	const ScopeLock protect(decoder.dc.mutex);
+	success_r = false;
+	return decoder.dc.state != DecoderState::START;
+}
+
+#endif
+
+/**
+ * Decode a song, and use the #RenderCache if possible.
+ *
+ * DecoderControl::mutex is not locked.
+ */
+static bool
+DecoderUnlockedRunSong(Decoder &decoder, const DetachedSong &song,
+		       const char *real_uri, Path path_fs)
+{
+#ifdef ENABLE_ENCODER
+	const DecoderControl &dc = decoder.dc;
+
+	/* only complete songs are cached, and only local files
+	   which have a modification time to validate the cache
+	   item */
+	if (render_cache != nullptr && !path_fs.IsNull() &&
+	    song.GetLastModified() > 0 &&
+	    dc.start_time.IsZero() && !dc.end_time.IsPositive()) {
+		const auto cache_path =
+			render_cache->Lookup(real_uri, song.GetLastModified());
+		if (!cache_path.IsNull()) {
+			bool success;
+			if (DecoderUnlockedRunRenderCache(decoder, cache_path,
+							  success))
+				return success;
+
+			FormatWarning(decoder_thread_domain,
+				      "Discarding broken render cache item of %s",
+				      real_uri);
+			render_cache->Discard(real_uri);
+			decoder.error.Clear();
+		} else
+			decoder.render_allowed = true;
+	}
+#else
+	(void)song;
+#endif
+
+	return DecoderUnlockedRunUri(decoder, real_uri, path_fs);
+}
+
 /**
  * Decode a song addressed by a #DetachedSong.
  *
  * Caller holds DecoderControl::mutex.
  */
 static void
-decoder_run_song(DecoderControl &dc,
+decoder_run_song(DecoderControl &dc, DecoderCache &cache,
 		 const DetachedSong &song, const char *uri, Path path_fs)
 {
-	Decoder decoder(dc, dc.start_time.IsPositive(),
+	Decoder decoder(dc, cache, dc.start_time.IsPositive(),
 			/* pass the song tag only if it's
 			   authoritative, i.e. if it's a local file -
 			   tags on "stream" songs are just remembered
@@ -402,7 +470,16 @@ decoder_run_song(DecoderControl &dc,
 	{
 		const ScopeUnlock unlock(dc.mutex);
 
-		success = DecoderUnlockedRunUri(decoder, uri, path_fs);
+		/* start with the ReplayGain data from the database;
+		   ReplayGain tags found by the decoder override it */
+		if (song.GetReplayGain().IsDefined())
+			decoder_replay_gain(decoder, &song.GetReplayGain());
+
+		const uint64_t start = MonotonicClockUS();
+		const uint64_t cpu_start = dc.thread.GetCPUTime();
+		success = DecoderUnlockedRunSong(decoder, song, uri, path_fs);
+		perf_stats.decoder_busy += MonotonicClockUS() - start;
+		perf_stats.decoder_cpu += dc.thread.GetCPUTime() - cpu_start;
 
 		/* flush the last chunk */
 
@@ -410,6 +487,32 @@ decoder_run_song(DecoderControl &dc,
 			decoder.FlushChunk();
 	}
 
+	if (success && !decoder.error.IsDefined() &&
+	    decoder.convert != nullptr &&
+	    dc.command == DecoderCommand::NONE) {
+		/* the song was decoded until the end; the next one
+		   follows seamlessly and may continue with the same
+		   converter */
+		cache.KeepConvert(decoder.convert,
+				  dc.in_audio_format, dc.out_audio_format);
+		decoder.convert = nullptr;
+	}
+
+#ifdef ENABLE_ENCODER
+	if (decoder.render != nullptr) {
+		if (success && !decoder.error.IsDefined() &&
+		    dc.command == DecoderCommand::NONE) {
+			/* the song was rendered until the end */
+			RenderCacheWriter *render = decoder.render;
+			decoder.render = nullptr;
+
+			const ScopeUnlock unlock(dc.mutex);
+			render_cache->Commit(render);
+		} else
+			decoder.CancelRender();
+	}
+#endif
+
 	if (decoder.error.IsDefined()) {
 		/* copy the Error from struct Decoder to
 		   DecoderControl */
@@ -437,7 +540,7 @@ decoder_run_song(DecoderControl &dc,
  * Caller holds DecoderControl::mutex.
  */
 static void
-decoder_run(DecoderControl &dc)
+decoder_run(DecoderControl &dc, DecoderCache &cache)
 {
 	dc.ClearError();
 
@@ -459,8 +562,7 @@ decoder_run(DecoderControl &dc)
 		path_fs = path_buffer;
 	}
 
-	decoder_run_song(dc, song, uri_utf8, path_fs);
-
+	decoder_run_song(dc, cache, song, uri_utf8, path_fs);
 }
 
 static void
@@ -469,6 +571,9 @@ decoder_task(void *arg)
 	DecoderControl &dc = *(DecoderControl *)arg;
 
 	SetThreadName("decoder");
+	ApplyThreadSettings("decoder");
+
+	DecoderCache cache;
 
 	const ScopeLock protect(dc.mutex);
 
@@ -479,10 +584,16 @@ decoder_task(void *arg)
 		switch (dc.command) {
 		case DecoderCommand::START:
 			dc.CycleMixRamp();
+
+			/* start with the MixRamp data from the
+			   database; MixRamp tags found by the decoder
+			   override it */
+			dc.SetMixRamp(MixRampInfo(dc.song->GetMixRamp()));
+
 			dc.replay_gain_prev_db = dc.replay_gain_db;
 			dc.replay_gain_db = 0;
 
-			decoder_run(dc);
+			decoder_run(dc, cache);
 
 			if (dc.state == DecoderState::ERROR)
 				LogError(dc.error);
@@ -498,10 +609,17 @@ decoder_task(void *arg)
 			   aware that the decoder has finished */
 			dc.pipe->Clear(*dc.buffer);
 
-			decoder_run(dc);
+			/* the converter state belongs to the end of the
+			   song, which is not where we continue */
+			cache.ClearConvert();
+
+			decoder_run(dc, cache);
 			break;
 
 		case DecoderCommand::STOP:
+			/* playback will not continue seamlessly */
+			cache.ClearConvert();
+
 			dc.CommandFinishedLocked();
 			break;
 
@@ -0,0 +1,574 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "RenderCache.hxx"
+#include "DecoderPlugin.hxx"
+#include "DecoderList.hxx"
+#include "encoder/EncoderInterface.hxx"
+#include "encoder/EncoderPlugin.hxx"
+#include "encoder/EncoderList.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "config/Block.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/DirectoryReader.hxx"
+#include "fs/io/FileReader.hxx"
+#include "util/StringCompare.hxx"
+#include "util/Fnv1aHash.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Domain.hxx"
+#include "util/RuntimeError.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+#include <memory>
+
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+static constexpr Domain render_cache_domain("render_cache");
+
+RenderCache *render_cache;
+
+/**
+ * The header of a metadata file.  It is followed by the URI (without
+ * null terminator).  The file is only read by the host which wrote
+ * it, therefore all numbers are in host byte order.
+ */
+struct RenderCacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t uri_length;
+	int64_t mtime;
+};
+
+static constexpr char RENDER_CACHE_MAGIC[8] = "MPDRNDC";
+static constexpr uint32_t RENDER_CACHE_VERSION = 1;
+
+static constexpr char RENDER_CACHE_META_SUFFIX[] = ".meta";
+static constexpr char RENDER_CACHE_DATA_SUFFIX[] = ".flac";
+
+/**
+ * The decoder plugins whose output is cached.
+ */
+static const char *const render_cache_plugins[] = {
+	"adplug",
+	"fluidsynth",
+	"gme",
+	"mikmod",
+	"modplug",
+	"sidplay",
+	"wildmidi",
+};
+
+/**
+ * Make up the base name of a cache item from a hash of the URI.
+ */
+gcc_pure
+static std::string
+MakeItemName(const char *uri)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx",
+		 (unsigned long long)Fnv1aHash64(uri));
+	return name;
+}
+
+static void
+ReadExactly(FileReader &reader, void *data, size_t size)
+{
+	uint8_t *p = (uint8_t *)data;
+	while (size > 0) {
+		size_t nbytes = reader.Read(p, size);
+		if (nbytes == 0)
+			throw std::runtime_error("Truncated cache file");
+
+		p += nbytes;
+		size -= nbytes;
+	}
+}
+
+/**
+ * The FLAC encoder writes a stream, and cannot go back to update the
+ * STREAMINFO block when it is finished.  Fill in the total number
+ * of samples, so the FLAC decoder knows the duration.
+ */
+static void
+PatchFlacTotalSamples(Path path, uint64_t n_frames)
+{
+	if (n_frames >= uint64_t(1) << 36)
+		return;
+
+	int fd = OpenFile(path, O_RDWR, 0);
+	if (fd < 0)
+		return;
+
+	/* "fLaC", the metadata block header and the STREAMINFO
+	   block up to the 36 bit total sample count, which occupies
+	   the low nibble of byte 21 and bytes 22..25 */
+	uint8_t header[26];
+	if (pread(fd, header, sizeof(header), 0) == ssize_t(sizeof(header)) &&
+	    memcmp(header, "fLaC", 4) == 0 &&
+	    (header[4] & 0x7f) == 0 /* STREAMINFO */) {
+		header[21] = (header[21] & 0xf0) | uint8_t(n_frames >> 32);
+		header[22] = uint8_t(n_frames >> 24);
+		header[23] = uint8_t(n_frames >> 16);
+		header[24] = uint8_t(n_frames >> 8);
+		header[25] = uint8_t(n_frames);
+
+		if (pwrite(fd, header + 21, 5, 21) != 5)
+			LogErrno(render_cache_domain,
+				 "Failed to update FLAC header");
+	}
+
+	close(fd);
+}
+
+RenderCacheWriter::~RenderCacheWriter()
+{
+	if (convert_format)
+		format_converter.Close();
+
+	delete encoder;
+}
+
+void
+RenderCacheWriter::Drain()
+{
+	while (true) {
+		char buffer[32768];
+		size_t nbytes = encoder->Read(buffer, sizeof(buffer));
+		if (nbytes == 0)
+			return;
+
+		file.Write(buffer, nbytes);
+	}
+}
+
+void
+RenderCacheWriter::Write(const void *data, size_t length)
+{
+	assert(length % frame_size == 0);
+
+	if (failed)
+		return;
+
+	n_frames += length / frame_size;
+
+	Error error;
+	ConstBuffer<void> src(data, length);
+	if (convert_format) {
+		src = format_converter.Convert(src, error);
+		if (src.IsNull()) {
+			LogError(error);
+			failed = true;
+			return;
+		}
+	}
+
+	if (!encoder->Write(src.data, src.size, error)) {
+		LogError(error);
+		failed = true;
+		return;
+	}
+
+	try {
+		Drain();
+	} catch (const std::runtime_error &e) {
+		LogError(e);
+		failed = true;
+	}
+}
+
+RenderCache::~RenderCache()
+{
+	delete encoder;
+}
+
+bool
+RenderCache::IsSynthesized(const DecoderPlugin &plugin)
+{
+	for (const char *name : render_cache_plugins)
+		if (strcmp(plugin.name, name) == 0)
+			return true;
+
+	return false;
+}
+
+AllocatedPath
+RenderCache::MakePath(const std::string &name, const char *suffix) const
+{
+	const auto name_fs = AllocatedPath::FromUTF8((name + suffix).c_str());
+	if (name_fs.IsNull())
+		return AllocatedPath::Null();
+
+	return AllocatedPath::Build(directory, name_fs);
+}
+
+void
+RenderCache::Load()
+{
+	/* collect the metadata files, and sort them by their
+	   modification time to restore the LRU order */
+	std::vector<std::pair<time_t, std::string>> found;
+
+	{
+		DirectoryReader reader(directory);
+		while (reader.ReadEntry()) {
+			const std::string entry = reader.GetEntry().ToUTF8();
+			if (!StringEndsWith(entry.c_str(),
+					    RENDER_CACHE_META_SUFFIX))
+				continue;
+
+			std::string name(entry, 0, entry.length() -
+					 sizeof(RENDER_CACHE_META_SUFFIX) + 1);
+
+			struct stat st;
+			if (StatFile(MakePath(name, RENDER_CACHE_META_SUFFIX),
+				     st))
+				found.emplace_back(st.st_mtime,
+						   std::move(name));
+		}
+	}
+
+	std::sort(found.begin(), found.end(),
+		  [](const std::pair<time_t, std::string> &a,
+		     const std::pair<time_t, std::string> &b){
+			  return a.first > b.first;
+		  });
+
+	const ScopeLock protect(mutex);
+
+	for (const auto &i : found) {
+		try {
+			LoadMeta(i.second);
+		} catch (const std::runtime_error &e) {
+			FormatDebug(render_cache_domain,
+				    "Discarding cache item %s: %s",
+				    i.second.c_str(), e.what());
+			RemoveFile(MakePath(i.second,
+					    RENDER_CACHE_META_SUFFIX));
+			RemoveFile(MakePath(i.second,
+					    RENDER_CACHE_DATA_SUFFIX));
+		}
+	}
+
+	FormatDebug(render_cache_domain, "Loaded %zu items, %llu bytes",
+		    items.size(), (unsigned long long)total_size);
+
+	Shrink();
+}
+
+void
+RenderCache::LoadMeta(const std::string &name)
+{
+	struct stat st;
+	if (!StatFile(MakePath(name, RENDER_CACHE_DATA_SUFFIX), st))
+		throw std::runtime_error("No data file");
+
+	FileReader reader(MakePath(name, RENDER_CACHE_META_SUFFIX));
+
+	RenderCacheHeader header;
+	ReadExactly(reader, &header, sizeof(header));
+	if (memcmp(header.magic, RENDER_CACHE_MAGIC,
+		   sizeof(header.magic)) != 0 ||
+	    header.version != RENDER_CACHE_VERSION ||
+	    header.uri_length > 65536)
+		throw std::runtime_error("Wrong file format");
+
+	std::unique_ptr<char[]> uri(new char[header.uri_length]);
+	ReadExactly(reader, uri.get(), header.uri_length);
+
+	items.push_back(Item{name,
+			     std::string(uri.get(), header.uri_length),
+			     time_t(header.mtime), uint64_t(st.st_size)});
+	by_name.emplace(name, std::prev(items.end()));
+
+	total_size += st.st_size;
+}
+
+void
+RenderCache::SaveMeta(const Item &item) const
+{
+	RenderCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, RENDER_CACHE_MAGIC, sizeof(header.magic));
+	header.version = RENDER_CACHE_VERSION;
+	header.uri_length = item.uri.length();
+	header.mtime = item.mtime;
+
+	FileOutputStream file(MakePath(item.name, RENDER_CACHE_META_SUFFIX));
+	file.Write(&header, sizeof(header));
+	file.Write(item.uri.data(), item.uri.length());
+	file.Commit();
+}
+
+AllocatedPath
+RenderCache::Lookup(const char *uri, time_t mtime)
+{
+	const std::string name = MakeItemName(uri);
+
+	const ScopeLock protect(mutex);
+
+	auto f = by_name.find(name);
+	if (f == by_name.end())
+		return AllocatedPath::Null();
+
+	const Item &item = *f->second;
+	if (item.uri != uri || item.mtime != mtime) {
+		/* the song has been modified, or this is a hash
+		   collision */
+		FormatDebug(render_cache_domain,
+			    "Discarding stale cache item of %s",
+			    item.uri.c_str());
+		Remove(f->second);
+		return AllocatedPath::Null();
+	}
+
+	/* move to the front of the LRU list, and touch the metadata
+	   file so the order survives a restart */
+	items.splice(items.begin(), items, f->second);
+	utimes(MakePath(name, RENDER_CACHE_META_SUFFIX).c_str(), nullptr);
+
+	return MakePath(name, RENDER_CACHE_DATA_SUFFIX);
+}
+
+void
+RenderCache::Discard(const char *uri)
+{
+	const ScopeLock protect(mutex);
+
+	auto f = by_name.find(MakeItemName(uri));
+	if (f != by_name.end())
+		Remove(f->second);
+}
+
+RenderCacheWriter *
+RenderCache::BeginWrite(const char *uri, time_t mtime,
+			AudioFormat audio_format)
+{
+	assert(audio_format.IsValid());
+
+	if (audio_format.format == SampleFormat::DSD)
+		return nullptr;
+
+	std::string name = MakeItemName(uri);
+	auto path = MakePath(name, RENDER_CACHE_DATA_SUFFIX);
+	if (path.IsNull())
+		return nullptr;
+
+	std::unique_ptr<RenderCacheWriter> writer;
+
+	try {
+		writer.reset(new RenderCacheWriter(std::move(name), uri,
+						   mtime, std::move(path)));
+	} catch (const std::runtime_error &e) {
+		LogError(e);
+		return nullptr;
+	}
+
+	writer->frame_size = audio_format.GetFrameSize();
+
+	Error error;
+	AudioFormat encoder_format = audio_format;
+	writer->encoder = encoder->Open(encoder_format, error);
+	if (writer->encoder == nullptr) {
+		LogError(error);
+		return nullptr;
+	}
+
+	if (encoder_format.format != audio_format.format) {
+		if (!writer->format_converter.Open(audio_format.format,
+						   encoder_format.format,
+						   error)) {
+			LogError(error);
+			return nullptr;
+		}
+
+		writer->convert_format = true;
+	}
+
+	try {
+		/* the FLAC stream header */
+		writer->Drain();
+	} catch (const std::runtime_error &e) {
+		LogError(e);
+		return nullptr;
+	}
+
+	FormatDebug(render_cache_domain, "Recording %s", uri);
+	return writer.release();
+}
+
+void
+RenderCache::Commit(RenderCacheWriter *_writer)
+{
+	std::unique_ptr<RenderCacheWriter> writer(_writer);
+
+	if (writer->failed || writer->n_frames == 0)
+		return;
+
+	Error error;
+	if (!writer->encoder->End(error)) {
+		LogError(error);
+		return;
+	}
+
+	Item item{writer->name, writer->uri, writer->mtime, 0};
+
+	try {
+		writer->Drain();
+		item.size = writer->file.Tell();
+		writer->file.Commit();
+	} catch (const std::runtime_error &e) {
+		LogError(e);
+		return;
+	}
+
+	const auto path = MakePath(item.name, RENDER_CACHE_DATA_SUFFIX);
+	PatchFlacTotalSamples(path, writer->n_frames);
+
+	const ScopeLock protect(mutex);
+
+	/* replace the old item (if any); its data file has already
+	   been overwritten */
+	auto f = by_name.find(item.name);
+	if (f != by_name.end()) {
+		total_size -= f->second->size;
+		items.erase(f->second);
+		by_name.erase(f);
+	}
+
+	if (item.size > max_size) {
+		/* would evict everything else */
+		RemoveFile(path);
+		RemoveFile(MakePath(item.name, RENDER_CACHE_META_SUFFIX));
+		return;
+	}
+
+	try {
+		SaveMeta(item);
+	} catch (const std::runtime_error &e) {
+		LogError(e);
+		RemoveFile(path);
+		return;
+	}
+
+	FormatDebug(render_cache_domain, "Stored %s, %llu bytes",
+		    item.uri.c_str(), (unsigned long long)item.size);
+
+	total_size += item.size;
+	items.push_front(std::move(item));
+	by_name.emplace(items.front().name, items.begin());
+
+	Shrink();
+}
+
+void
+RenderCache::Shrink()
+{
+	while (total_size > max_size && !items.empty()) {
+		auto i = std::prev(items.end());
+		FormatDebug(render_cache_domain, "Evicting %s",
+			    i->uri.c_str());
+		Remove(i);
+	}
+}
+
+void
+RenderCache::Remove(ItemIterator i)
+{
+	assert(total_size >= i->size);
+
+	total_size -= i->size;
+
+	RemoveFile(MakePath(i->name, RENDER_CACHE_META_SUFFIX));
+	RemoveFile(MakePath(i->name, RENDER_CACHE_DATA_SUFFIX));
+
+	by_name.erase(i->name);
+	items.erase(i);
+}
+
+void
+render_cache_global_init()
+{
+	assert(render_cache == nullptr);
+
+	const auto *block =
+		config_get_block(ConfigBlockOption::RENDER_CACHE);
+	if (block == nullptr)
+		return;
+
+	Error error;
+	auto path = block->GetBlockPath("path", error);
+	if (path.IsNull()) {
+		if (error.IsDefined())
+			throw std::runtime_error(error.GetMessage());
+
+		throw std::runtime_error("No \"path\" in \"render_cache\" block");
+	}
+
+	if (!DirectoryExists(path))
+		throw FormatRuntimeError("Not a directory: %s",
+					 path.c_str());
+
+	const DecoderPlugin *decoder_plugin =
+		decoder_plugin_from_name("flac");
+	const EncoderPlugin *encoder_plugin = encoder_plugin_get("flac");
+	if (decoder_plugin == nullptr || encoder_plugin == nullptr)
+		throw std::runtime_error("\"render_cache\" requires FLAC support");
+
+	/* the block may contain settings for the FLAC encoder, e.g.
+	   "compression" */
+	PreparedEncoder *encoder = encoder_init(*encoder_plugin, *block,
+						error);
+	if (encoder == nullptr)
+		throw std::runtime_error(error.GetMessage());
+
+	const uint64_t max_size =
+		uint64_t(block->GetBlockValue("size", 512u)) * 1024 * 1024;
+
+	render_cache = new RenderCache(std::move(path), max_size,
+				       *decoder_plugin, encoder);
+
+	try {
+		render_cache->Load();
+	} catch (...) {
+		delete render_cache;
+		render_cache = nullptr;
+		throw;
+	}
+}
+
+void
+render_cache_global_finish()
+{
+	delete render_cache;
+	render_cache = nullptr;
+}
@@ -0,0 +1,262 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_DECODER_RENDER_CACHE_HXX
+#define MPD_DECODER_RENDER_CACHE_HXX
+
+#include "check.h"
+#include "AudioFormat.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "pcm/FormatConverter.hxx"
+#include "thread/Mutex.hxx"
+#include "Compiler.h"
+
+#include <string>
+#include <map>
+#include <list>
+
+#include <stdint.h>
+#include <time.h>
+
+class Error;
+class Encoder;
+class PreparedEncoder;
+class RenderCache;
+struct DecoderPlugin;
+
+/**
+ * Records the PCM output of one song into a new #RenderCache item.
+ * It is created by RenderCache::BeginWrite(), and
+ * RenderCache::Commit() adds it to the cache; deleting it instead
+ * discards the recording.
+ */
+class RenderCacheWriter {
+	friend class RenderCache;
+
+	const std::string name, uri;
+	const time_t mtime;
+
+	FileOutputStream file;
+
+	Encoder *encoder = nullptr;
+
+	/**
+	 * Converts the samples to the format requested by the
+	 * encoder; only used if #convert_format is set.
+	 */
+	PcmFormatConverter format_converter;
+	bool convert_format = false;
+
+	/**
+	 * The size of one frame passed to Write().
+	 */
+	size_t frame_size;
+
+	/**
+	 * The number of frames passed to Write().
+	 */
+	uint64_t n_frames = 0;
+
+	/**
+	 * Has an error occurred?  Then the recording will be
+	 * discarded.
+	 */
+	bool failed = false;
+
+	RenderCacheWriter(std::string &&_name, const char *_uri,
+			  time_t _mtime, AllocatedPath &&path)
+		:name(std::move(_name)), uri(_uri), mtime(_mtime),
+		 file(path) {}
+
+public:
+	~RenderCacheWriter();
+
+	RenderCacheWriter(const RenderCacheWriter &) = delete;
+	RenderCacheWriter &operator=(const RenderCacheWriter &) = delete;
+
+	/**
+	 * Record PCM data in the format which was passed to
+	 * RenderCache::BeginWrite().  Errors are logged and cause
+	 * the recording to be discarded.
+	 */
+	void Write(const void *data, size_t length);
+
+private:
+	/**
+	 * Copy the encoder's output to the file.
+	 */
+	void Drain();
+};
+
+/**
+ * A disk cache for the PCM output of synthesizing decoder plugins
+ * (SID, GME, MIDI, tracker modules), which need a lot of CPU, and
+ * can often only seek by rendering again from the start.  When such
+ * a song has been decoded from the start to its end, the PCM data
+ * is stored FLAC-compressed; the next time, the "flac" decoder
+ * plugin plays the cached copy instead.
+ *
+ * Each item consists of a FLAC file and a metadata file with the
+ * URI and the modification time of the song; the name is a hash of
+ * the URI.  When the cache grows beyond its size limit, the least
+ * recently used items are evicted.
+ */
+class RenderCache {
+	struct Item {
+		/**
+		 * The file name without suffix; this is a hash of
+		 * the URI.
+		 */
+		std::string name;
+
+		std::string uri;
+
+		time_t mtime;
+
+		/**
+		 * The size of the FLAC file.
+		 */
+		uint64_t size;
+	};
+
+	const AllocatedPath directory;
+
+	/**
+	 * The maximum sum of all #Item::size.
+	 */
+	const uint64_t max_size;
+
+	/**
+	 * The decoder plugin which plays the cached files.
+	 */
+	const DecoderPlugin &decoder_plugin;
+
+	PreparedEncoder *const encoder;
+
+	/**
+	 * Protects all attributes below.
+	 */
+	Mutex mutex;
+
+	uint64_t total_size = 0;
+
+	/**
+	 * All items, the most recently used one first.
+	 */
+	std::list<Item> items;
+
+	typedef std::list<Item>::iterator ItemIterator;
+
+	std::map<std::string, ItemIterator> by_name;
+
+public:
+	RenderCache(AllocatedPath &&_directory, uint64_t _max_size,
+		    const DecoderPlugin &_decoder_plugin,
+		    PreparedEncoder *_encoder)
+		:directory(std::move(_directory)), max_size(_max_size),
+		 decoder_plugin(_decoder_plugin), encoder(_encoder) {}
+
+	~RenderCache();
+
+	RenderCache(const RenderCache &) = delete;
+	RenderCache &operator=(const RenderCache &) = delete;
+
+	/**
+	 * Load the metadata files from the cache directory.
+	 */
+	void Load();
+
+	const DecoderPlugin &GetDecoderPlugin() const {
+		return decoder_plugin;
+	}
+
+	/**
+	 * Is the output of this decoder plugin worth caching?
+	 */
+	gcc_pure
+	static bool IsSynthesized(const DecoderPlugin &plugin);
+
+	/**
+	 * Look up a complete rendering of the given song and mark it
+	 * as recently used.
+	 *
+	 * @param mtime the modification time of the song; a rendering
+	 * of an older version is discarded
+	 * @return the path of the FLAC file or AllocatedPath::Null()
+	 */
+	AllocatedPath Lookup(const char *uri, time_t mtime);
+
+	/**
+	 * Remove the rendering of the given song, e.g. because the
+	 * cached file could not be decoded.
+	 */
+	void Discard(const char *uri);
+
+	/**
+	 * Start recording the given song.
+	 *
+	 * @return the writer or nullptr on error (which is logged)
+	 */
+	RenderCacheWriter *BeginWrite(const char *uri, time_t mtime,
+				      AudioFormat audio_format);
+
+	/**
+	 * Finish the recording and add it to the cache.  The writer
+	 * is deleted.
+	 */
+	void Commit(RenderCacheWriter *writer);
+
+private:
+	gcc_pure
+	AllocatedPath MakePath(const std::string &name,
+			       const char *suffix) const;
+
+	void LoadMeta(const std::string &name);
+	void SaveMeta(const Item &item) const;
+
+	/**
+	 * Evict items until #total_size fits into #max_size.  Caller
+	 * must hold the mutex.
+	 */
+	void Shrink();
+
+	/**
+	 * Delete an item and its files.  Caller must hold the mutex.
+	 */
+	void Remove(ItemIterator i);
+};
+
+/**
+ * The global instance; nullptr if the cache is disabled.
+ */
+extern RenderCache *render_cache;
+
+/**
+ * Set up the global #RenderCache according to the "render_cache"
+ * block.  Call after the decoder plugins have been initialized.
+ */
+void
+render_cache_global_init();
+
+void
+render_cache_global_finish();
+
+#endif
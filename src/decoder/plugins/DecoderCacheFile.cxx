@@ -0,0 +1,73 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "DecoderCacheFile.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/Traits.hxx"
+#include "fs/io/FileReader.hxx"
+#include "util/Fnv1aHash.hxx"
+
+#include <stdio.h>
+
+AllocatedPath
+MakeCacheFilePath(Path directory, const char *uri, const char *suffix)
+{
+	char name[64];
+	snprintf(name, sizeof(name), "%016llx.%s",
+		 (unsigned long long)Fnv1aHash64(uri), suffix);
+
+	const auto name_fs = AllocatedPath::FromUTF8(name);
+	if (name_fs.IsNull())
+		return AllocatedPath::Null();
+
+	return AllocatedPath::Build(directory, name_fs);
+}
+
+int64_t
+GetCacheModificationTime(const char *uri)
+{
+	if (!PathTraitsUTF8::IsAbsolute(uri))
+		return 0;
+
+	const auto path = AllocatedPath::FromUTF8(uri);
+	FileInfo info;
+	if (path.IsNull() || !GetFileInfo(path, info))
+		return 0;
+
+	return info.GetModificationTime();
+}
+
+bool
+ReadCacheFile(FileReader &reader, void *data, size_t size)
+{
+	uint8_t *p = (uint8_t *)data;
+	while (size > 0) {
+		size_t nbytes = reader.Read(p, size);
+		if (nbytes == 0)
+			return false;
+
+		p += nbytes;
+		size -= nbytes;
+	}
+
+	return true;
+}
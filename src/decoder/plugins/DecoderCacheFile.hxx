@@ -0,0 +1,64 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * Helpers for the cache files written by some decoder plugins, e.g.
+ * seek tables.
+ */
+
+#ifndef MPD_DECODER_CACHE_FILE_HXX
+#define MPD_DECODER_CACHE_FILE_HXX
+
+#include "check.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Path;
+class AllocatedPath;
+class FileReader;
+
+/**
+ * Make up the name of a cache file from a 64 bit FNV-1a hash of
+ * the URI.
+ *
+ * @param suffix the file name suffix, e.g. "mp3seek"
+ * @return the path or AllocatedPath::Null() on error
+ */
+AllocatedPath
+MakeCacheFilePath(Path directory, const char *uri, const char *suffix);
+
+/**
+ * Determine the modification time of a local file; returns 0 for
+ * remote files, which means that only the URI and the size are
+ * compared.
+ */
+int64_t
+GetCacheModificationTime(const char *uri);
+
+/**
+ * Read exactly the given number of bytes.
+ *
+ * @return false if the file is too short
+ */
+bool
+ReadCacheFile(FileReader &reader, void *data, size_t size);
+
+#endif
@@ -28,6 +28,8 @@
 #include "../DecoderAPI.hxx"
 #include "input/InputStream.hxx"
 #include "tag/TagId3.hxx"
+#include "config/Block.hxx"
+#include "system/FatalError.hxx"
 #include "util/Error.hxx"
 
 #include <string.h>
@@ -46,6 +48,18 @@ DsdId::Equals(const char *s) const
 	return memcmp(value, s, sizeof(value)) == 0;
 }
 
+size_t
+dsdlib_read_size(const ConfigBlock &block)
+{
+	const unsigned value = block.GetBlockValue("read_size",
+						   unsigned(DSDLIB_DEFAULT_READ_SIZE));
+	if (value == 0 || value > DSDLIB_MAX_READ_SIZE)
+		FormatFatalError("Invalid read_size %u in line %i",
+				 value, block.line);
+
+	return value;
+}
+
 /**
  * Skip the #InputStream to the specified offset.
  */
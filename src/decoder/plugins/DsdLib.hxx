@@ -24,12 +24,25 @@
 #include "input/Offset.hxx"
 #include "Compiler.h"
 
+#include <stddef.h>
 #include <stdint.h>
 
 struct Decoder;
 struct TagHandler;
+struct ConfigBlock;
 class InputStream;
 
+/**
+ * The default of the "read_size" setting: the number of bytes the
+ * DSD decoders read and transform at once.
+ */
+static constexpr size_t DSDLIB_DEFAULT_READ_SIZE = 256 * 1024;
+
+/**
+ * The upper limit of the "read_size" setting.
+ */
+static constexpr size_t DSDLIB_MAX_READ_SIZE = 16 * 1024 * 1024;
+
 struct DsdId {
 	char value[4];
 
@@ -59,6 +72,13 @@ public:
 	}
 };
 
+/**
+ * Parse the "read_size" setting of a DSD decoder plugin (in bytes).
+ * Aborts MPD if the value is invalid.
+ */
+size_t
+dsdlib_read_size(const ConfigBlock &block);
+
 bool
 dsdlib_skip_to(Decoder *decoder, InputStream &is,
 	       offset_type offset);
@@ -38,6 +38,9 @@
 #include "DsdLib.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+#include <memory>
+
 struct DsdiffHeader {
 	DsdId id;
 	DffDsdUint64 size;
@@ -71,10 +74,16 @@ struct DsdiffMetaData {
 
 static bool lsbitfirst;
 
+/**
+ * The number of bytes to read at once.  See dsdlib_read_size().
+ */
+static size_t read_size;
+
 static bool
 dsdiff_init(const ConfigBlock &block)
 {
 	lsbitfirst = block.GetBlockValue("lsbitfirst", false);
+	read_size = dsdlib_read_size(block);
 	return true;
 }
 
@@ -344,10 +353,10 @@ dsdiff_read_metadata(Decoder *decoder, InputStream &is,
 }
 
 static void
-bit_reverse_buffer(uint8_t *p, uint8_t *end)
+bit_reverse_buffer(uint8_t *dest, const uint8_t *src, const uint8_t *end)
 {
-	for (; p < end; ++p)
-		*p = bit_reverse(*p);
+	for (; src < end; ++src, ++dest)
+		*dest = bit_reverse(*src);
 }
 
 static offset_type
@@ -366,13 +375,14 @@ dsdiff_decode_chunk(Decoder &decoder, InputStream &is,
 {
 	const offset_type start_offset = is.GetOffset();
 
-	uint8_t buffer[8192];
-
-	const size_t sample_size = sizeof(buffer[0]);
+	const size_t sample_size = sizeof(uint8_t);
 	const size_t frame_size = channels * sample_size;
-	const unsigned buffer_frames = sizeof(buffer) / frame_size;
+	const size_t buffer_frames = std::max<size_t>(read_size / frame_size,
+						      1);
 	const size_t buffer_size = buffer_frames * frame_size;
 
+	const std::unique_ptr<uint8_t[]> buffer(new uint8_t[buffer_size]);
+
 	auto cmd = decoder_get_command(decoder);
 	for (offset_type remaining_bytes = total_bytes;
 	     remaining_bytes >= frame_size && cmd != DecoderCommand::STOP;) {
@@ -400,16 +410,23 @@ dsdiff_decode_chunk(Decoder &decoder, InputStream &is,
 			now_size = now_frames * frame_size;
 		}
 
-		if (!decoder_read_full(&decoder, is, buffer, now_size))
+		const auto *src = (const uint8_t *)
+			decoder_read_full_borrow(&decoder, is,
+						 buffer.get(), now_size);
+		if (src == nullptr)
 			return false;
 
 		const size_t nbytes = now_size;
 		remaining_bytes -= nbytes;
 
-		if (lsbitfirst)
-			bit_reverse_buffer(buffer, buffer + nbytes);
+		if (lsbitfirst) {
+			/* the source may be borrowed from the stream
+			   and is therefore read-only */
+			bit_reverse_buffer(buffer.get(), src, src + nbytes);
+			src = buffer.get();
+		}
 
-		cmd = decoder_data(decoder, is, buffer, nbytes,
+		cmd = decoder_data(decoder, is, src, nbytes,
 				   sample_rate / 1000);
 	}
 
@@ -39,10 +39,25 @@
 #include "tag/TagHandler.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+#include <memory>
+
 #include <string.h>
 
 static constexpr unsigned DSF_BLOCK_SIZE = 4096;
 
+/**
+ * The number of bytes to read at once.  See dsdlib_read_size().
+ */
+static size_t read_size;
+
+static bool
+dsf_init(const ConfigBlock &block)
+{
+	read_size = dsdlib_read_size(block);
+	return true;
+}
+
 struct DsfMetaData {
 	unsigned sample_rate, channels;
 	bool bitreverse;
@@ -242,6 +257,21 @@ InterleaveDsfBlock(uint8_t *gcc_restrict dest, const uint8_t *gcc_restrict src,
 		InterleaveDsfBlockGeneric(dest, src, channels);
 }
 
+/**
+ * Interleave a group of consecutive blocks.
+ */
+static void
+InterleaveDsfBlocks(uint8_t *gcc_restrict dest,
+		    const uint8_t *gcc_restrict src,
+		    size_t n_blocks, unsigned channels)
+{
+	const size_t block_size = channels * DSF_BLOCK_SIZE;
+
+	for (size_t i = 0; i < n_blocks;
+	     ++i, dest += block_size, src += block_size)
+		InterleaveDsfBlock(dest, src, channels);
+}
+
 static offset_type
 FrameToBlock(uint64_t frame)
 {
@@ -260,6 +290,16 @@ dsf_decode_chunk(Decoder &decoder, InputStream &is,
 	const size_t block_size = channels * DSF_BLOCK_SIZE;
 	const offset_type start_offset = is.GetOffset();
 
+	/* read as many whole blocks at once as fit into
+	   "read_size" */
+	const size_t group_blocks = std::max<size_t>(read_size / block_size,
+						     1);
+	const size_t group_size = group_blocks * block_size;
+
+	const std::unique_ptr<uint8_t[]> buffer(new uint8_t[group_size]);
+	const std::unique_ptr<uint8_t[]>
+		interleaved_buffer(new uint8_t[group_size]);
+
 	auto cmd = decoder_get_command(decoder);
 	for (offset_type i = 0; i < n_blocks && cmd != DecoderCommand::STOP;) {
 		if (cmd == DecoderCommand::SEEK) {
@@ -279,21 +319,30 @@ dsf_decode_chunk(Decoder &decoder, InputStream &is,
 				decoder_seek_error(decoder);
 		}
 
-		/* worst-case buffer size */
-		uint8_t buffer[MAX_CHANNELS * DSF_BLOCK_SIZE];
-		if (!decoder_read_full(&decoder, is, buffer, block_size))
+		const size_t now_blocks =
+			std::min<offset_type>(group_blocks, n_blocks - i);
+		const size_t now_size = now_blocks * block_size;
+
+		const auto *src = (const uint8_t *)
+			decoder_read_full_borrow(&decoder, is,
+						 buffer.get(), now_size);
+		if (src == nullptr)
 			return false;
 
-		if (bitreverse)
-			bit_reverse_buffer(buffer, buffer + block_size);
+		/* interleave straight from the (possibly borrowed)
+		   source blocks, and bit-reverse the result, which is
+		   our own */
+		InterleaveDsfBlocks(interleaved_buffer.get(), src,
+				    now_blocks, channels);
 
-		uint8_t interleaved_buffer[MAX_CHANNELS * DSF_BLOCK_SIZE];
-		InterleaveDsfBlock(interleaved_buffer, buffer, channels);
+		if (bitreverse)
+			bit_reverse_buffer(interleaved_buffer.get(),
+					   interleaved_buffer.get() + now_size);
 
 		cmd = decoder_data(decoder, is,
-				   interleaved_buffer, block_size,
+				   interleaved_buffer.get(), now_size,
 				   sample_rate / 1000);
-		++i;
+		i += now_blocks;
 	}
 
 	return true;
@@ -371,7 +420,7 @@ static const char *const dsf_mime_types[] = {
 
 const struct DecoderPlugin dsf_decoder_plugin = {
 	"dsf",
-	nullptr,
+	dsf_init,
 	nullptr,
 	dsf_stream_decode,
 	nullptr,
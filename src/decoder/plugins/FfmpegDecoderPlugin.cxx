@@ -27,17 +27,19 @@
 #include "lib/ffmpeg/Error.hxx"
 #include "lib/ffmpeg/LogError.hxx"
 #include "lib/ffmpeg/Init.hxx"
-#include "lib/ffmpeg/Buffer.hxx"
 #include "../DecoderAPI.hxx"
 #include "FfmpegMetaData.hxx"
 #include "FfmpegIo.hxx"
-#include "pcm/Interleave.hxx"
+#include "FfmpegStreamCache.hxx"
 #include "tag/TagBuilder.hxx"
 #include "tag/TagHandler.hxx"
 #include "tag/ReplayGain.hxx"
 #include "tag/MixRamp.hxx"
 #include "input/InputStream.hxx"
 #include "CheckAudioFormat.hxx"
+#include "config/Block.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "system/FatalError.hxx"
 #include "util/ConstBuffer.hxx"
 #include "util/Error.hxx"
 #include "LogV.hxx"
@@ -56,6 +58,12 @@ extern "C" {
 #include <assert.h>
 #include <string.h>
 
+/**
+ * The directory where the results of avformat_find_stream_info()
+ * are cached (see FfmpegStreamCache.hxx); nullptr if disabled.
+ */
+static AllocatedPath *stream_info_cache_directory;
+
 static AVFormatContext *
 FfmpegOpenInput(AVIOContext *pb,
 		const char *filename,
@@ -72,12 +80,27 @@ FfmpegOpenInput(AVIOContext *pb,
 }
 
 static bool
-ffmpeg_init(gcc_unused const ConfigBlock &block)
+ffmpeg_init(const ConfigBlock &block)
 {
 	FfmpegInit();
+
+	Error error;
+	auto path = block.GetBlockPath("stream_info_cache", error);
+	if (!path.IsNull())
+		stream_info_cache_directory =
+			new AllocatedPath(std::move(path));
+	else if (error.IsDefined())
+		FatalError(error);
+
 	return true;
 }
 
+static void
+ffmpeg_finish()
+{
+	delete stream_info_cache_directory;
+}
+
 gcc_pure
 static int
 ffmpeg_find_audio_stream(const AVFormatContext &format_context)
@@ -103,48 +126,45 @@ start_time_fallback(const AVStream &stream)
 }
 
 /**
- * Copy PCM data from a non-empty AVFrame to an interleaved buffer.
+ * Send the PCM data of a non-empty AVFrame to the decoder API,
+ * omitting the first #skip_frames frames.  Planar data is passed to
+ * decoder_data_planar(), which interleaves it straight into the
+ * music pipe.
  */
-static ConstBuffer<void>
-copy_interleave_frame(const AVCodecContext &codec_context,
-		      const AVFrame &frame,
-		      FfmpegBuffer &global_buffer,
-		      Error &error)
+static DecoderCommand
+ffmpeg_send_frame(Decoder &decoder, InputStream &is,
+		  const AVCodecContext &codec_context,
+		  const AVFrame &frame,
+		  size_t skip_frames)
 {
 	assert(frame.nb_samples > 0);
+	assert(skip_frames < (size_t)frame.nb_samples);
 
-	int plane_size;
-	const int data_size =
-		av_samples_get_buffer_size(&plane_size,
-					   codec_context.channels,
-					   frame.nb_samples,
-					   codec_context.sample_fmt, 1);
-	assert(data_size != 0);
-	if (data_size < 0) {
-		SetFfmpegError(error, data_size);
-		return 0;
-	}
+	const unsigned channels = codec_context.channels;
+	const size_t sample_size =
+		av_get_bytes_per_sample(codec_context.sample_fmt);
+	const size_t n_frames = frame.nb_samples - skip_frames;
+	const uint16_t kbit_rate = codec_context.bit_rate / 1000;
 
-	void *output_buffer;
 	if (av_sample_fmt_is_planar(codec_context.sample_fmt) &&
-	    codec_context.channels > 1) {
-		output_buffer = global_buffer.GetT<uint8_t>(data_size);
-		if (output_buffer == nullptr) {
-			/* Not enough memory - shouldn't happen */
-			error.SetErrno(ENOMEM);
-			return 0;
-		}
+	    channels > 1) {
+		assert(channels <= MAX_CHANNELS);
+
+		const void *planes[MAX_CHANNELS];
+		for (unsigned c = 0; c < channels; ++c)
+			planes[c] = frame.extended_data[c]
+				+ skip_frames * sample_size;
 
-		PcmInterleave(output_buffer,
-			      ConstBuffer<const void *>((const void *const*)frame.extended_data,
-							codec_context.channels),
-			      frame.nb_samples,
-			      av_get_bytes_per_sample(codec_context.sample_fmt));
-	} else {
-		output_buffer = frame.extended_data[0];
+		return decoder_data_planar(decoder, &is,
+					   {planes, channels},
+					   n_frames, kbit_rate);
 	}
 
-	return { output_buffer, (size_t)data_size };
+	const size_t frame_size = sample_size * channels;
+	return decoder_data(decoder, is,
+			    frame.extended_data[0] + skip_frames * frame_size,
+			    n_frames * frame_size,
+			    kbit_rate);
 }
 
 /**
@@ -189,10 +209,9 @@ ffmpeg_send_packet(Decoder &decoder, InputStream &is,
 		   AVCodecContext &codec_context,
 		   const AVStream &stream,
 		   AVFrame &frame,
-		   uint64_t min_frame, size_t pcm_frame_size,
-		   FfmpegBuffer &buffer)
+		   uint64_t min_frame)
 {
-	size_t skip_bytes = 0;
+	uint64_t skip_frames = 0;
 
 	const auto pts = StreamRelativePts(packet, stream);
 	if (pts >= 0) {
@@ -200,15 +219,13 @@ ffmpeg_send_packet(Decoder &decoder, InputStream &is,
 			auto cur_frame = PtsToPcmFrame(pts, stream,
 						       codec_context);
 			if (cur_frame < min_frame)
-				skip_bytes = pcm_frame_size * (min_frame - cur_frame);
+				skip_frames = min_frame - cur_frame;
 		} else
 			decoder_timestamp(decoder,
 					  FfmpegTimeToDouble(pts,
 							     stream.time_base));
 	}
 
-	Error error;
-
 	DecoderCommand cmd = DecoderCommand::NONE;
 	while (packet.size > 0 && cmd == DecoderCommand::NONE) {
 		int got_frame = 0;
@@ -227,31 +244,14 @@ ffmpeg_send_packet(Decoder &decoder, InputStream &is,
 		if (!got_frame || frame.nb_samples <= 0)
 			continue;
 
-		auto output_buffer =
-			copy_interleave_frame(codec_context, frame,
-					      buffer, error);
-		if (output_buffer.IsNull()) {
-			/* this must be a serious error,
-			   e.g. OOM */
-			LogError(error);
-			return DecoderCommand::STOP;
-		}
-
-		if (skip_bytes > 0) {
-			if (skip_bytes >= output_buffer.size) {
-				skip_bytes -= output_buffer.size;
-				continue;
-			}
-
-			output_buffer.data =
-				(const uint8_t *)output_buffer.data + skip_bytes;
-			output_buffer.size -= skip_bytes;
-			skip_bytes = 0;
+		if (skip_frames >= (uint64_t)frame.nb_samples) {
+			skip_frames -= frame.nb_samples;
+			continue;
 		}
 
-		cmd = decoder_data(decoder, is,
-				   output_buffer.data, output_buffer.size,
-				   codec_context.bit_rate / 1000);
+		cmd = ffmpeg_send_frame(decoder, is, codec_context, frame,
+					skip_frames);
+		skip_frames = 0;
 	}
 	return cmd;
 }
@@ -438,13 +438,117 @@ FfmpegCheckTag(Decoder &decoder, InputStream &is,
 
 #endif
 
+static FfmpegStreamInfo
+FfmpegCollectStreamInfo(const AVFormatContext &format_context,
+			int audio_stream)
+{
+	const AVStream &stream = *format_context.streams[audio_stream];
+	const AVCodecContext &codec_context = *stream.codec;
+
+	FfmpegStreamInfo info;
+	memset(&info, 0, sizeof(info));
+	info.n_streams = format_context.nb_streams;
+	info.audio_stream = audio_stream;
+	info.codec_id = codec_context.codec_id;
+	info.sample_format = codec_context.sample_fmt;
+	info.sample_rate = codec_context.sample_rate;
+	info.channels = codec_context.channels;
+	info.channel_layout = codec_context.channel_layout;
+	info.frame_size = codec_context.frame_size;
+	info.block_align = codec_context.block_align;
+	info.bit_rate = codec_context.bit_rate;
+	info.extradata_size = codec_context.extradata_size;
+	info.time_base_num = stream.time_base.num;
+	info.time_base_den = stream.time_base.den;
+	info.start_time = stream.start_time;
+	info.duration = stream.duration;
+	return info;
+}
+
+/**
+ * Fill the stream parameters from the cache into a
+ * #AVFormatContext which has been opened, but not probed yet.
+ *
+ * @return false if the container header does not match the cached
+ * parameters
+ */
+static bool
+FfmpegApplyStreamInfo(AVFormatContext &format_context,
+		      const FfmpegStreamInfo &info)
+{
+	if (format_context.nb_streams != info.n_streams ||
+	    info.audio_stream < 0 ||
+	    ffmpeg_find_audio_stream(format_context) != info.audio_stream)
+		return false;
+
+	AVStream &stream = *format_context.streams[info.audio_stream];
+	AVCodecContext &codec_context = *stream.codec;
+	if (int(codec_context.codec_id) != info.codec_id ||
+	    codec_context.extradata_size != info.extradata_size ||
+	    stream.time_base.num != info.time_base_num ||
+	    stream.time_base.den != info.time_base_den)
+		return false;
+
+	codec_context.sample_fmt = AVSampleFormat(info.sample_format);
+	codec_context.sample_rate = info.sample_rate;
+	codec_context.channels = info.channels;
+	codec_context.channel_layout = info.channel_layout;
+	codec_context.frame_size = info.frame_size;
+	codec_context.block_align = info.block_align;
+	if (codec_context.bit_rate == 0)
+		codec_context.bit_rate = info.bit_rate;
+
+	if (stream.start_time == (int64_t)AV_NOPTS_VALUE)
+		stream.start_time = info.start_time;
+	if (stream.duration == (int64_t)AV_NOPTS_VALUE)
+		stream.duration = info.duration;
+
+	return true;
+}
+
+/**
+ * A wrapper for avformat_find_stream_info() which consults the
+ * stream info cache first.
+ */
+static bool
+FfmpegFindStreamInfo(Decoder &decoder, InputStream &input,
+		     AVFormatContext &format_context)
+{
+	const bool use_cache = stream_info_cache_directory != nullptr &&
+		input.KnownSize();
+
+	if (use_cache) {
+		FfmpegStreamInfo info;
+		const bool hit =
+			ffmpeg_stream_cache_load(*stream_info_cache_directory,
+						 input, info) &&
+			FfmpegApplyStreamInfo(format_context, info);
+		decoder_cache_lookup(decoder, hit);
+		if (hit)
+			return true;
+	}
+
+	if (avformat_find_stream_info(&format_context, nullptr) < 0)
+		return false;
+
+	if (use_cache) {
+		const int audio_stream =
+			ffmpeg_find_audio_stream(format_context);
+		if (audio_stream >= 0)
+			ffmpeg_stream_cache_store(*stream_info_cache_directory,
+						  input,
+						  FfmpegCollectStreamInfo(format_context,
+									  audio_stream));
+	}
+
+	return true;
+}
+
 static void
 FfmpegDecode(Decoder &decoder, InputStream &input,
 	     AVFormatContext &format_context)
 {
-	const int find_result =
-		avformat_find_stream_info(&format_context, nullptr);
-	if (find_result < 0) {
+	if (!FfmpegFindStreamInfo(decoder, input, format_context)) {
 		LogError(ffmpeg_domain, "Couldn't find stream info");
 		return;
 	}
@@ -524,8 +628,6 @@ FfmpegDecode(Decoder &decoder, InputStream &input,
 		return;
 	}
 
-	FfmpegBuffer interleaved_buffer;
-
 	uint64_t min_frame = 0;
 
 	DecoderCommand cmd = decoder_get_command(decoder);
@@ -564,8 +666,7 @@ FfmpegDecode(Decoder &decoder, InputStream &input,
 						 codec_context,
 						 av_stream,
 						 *frame,
-						 min_frame, audio_format.GetFrameSize(),
-						 interleaved_buffer);
+						 min_frame);
 			min_frame = 0;
 		} else
 			cmd = decoder_get_command(decoder);
@@ -781,7 +882,7 @@ static const char *const ffmpeg_mime_types[] = {
 const struct DecoderPlugin ffmpeg_decoder_plugin = {
 	"ffmpeg",
 	ffmpeg_init,
-	nullptr,
+	ffmpeg_finish,
 	ffmpeg_decode,
 	nullptr,
 	nullptr,
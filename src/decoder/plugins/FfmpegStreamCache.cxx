@@ -0,0 +1,135 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "FfmpegStreamCache.hxx"
+#include "DecoderCacheFile.hxx"
+#include "lib/ffmpeg/Domain.hxx"
+#include "input/InputStream.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/io/FileReader.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "Log.hxx"
+
+#include <stdexcept>
+#include <memory>
+
+#include <string.h>
+
+/**
+ * The header of a cache file.  It is followed by the URI (without
+ * the null terminator) and one #FfmpegStreamInfo struct.  All
+ * numbers are in host byte order.
+ */
+struct FfmpegStreamCacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t uri_length;
+	uint64_t size;
+	int64_t mtime;
+};
+
+static constexpr char FFMPEG_STREAM_CACHE_MAGIC[8] = "MPDFFSI";
+static constexpr uint32_t FFMPEG_STREAM_CACHE_VERSION = 1;
+
+static bool
+LoadCacheFile(FileReader &reader, const InputStream &is,
+	      FfmpegStreamInfo &info)
+{
+	const char *uri = is.GetURI();
+	const size_t uri_length = strlen(uri);
+
+	FfmpegStreamCacheHeader header;
+	if (!ReadCacheFile(reader, &header, sizeof(header)) ||
+	    memcmp(header.magic, FFMPEG_STREAM_CACHE_MAGIC,
+		   sizeof(header.magic)) != 0 ||
+	    header.version != FFMPEG_STREAM_CACHE_VERSION ||
+	    header.uri_length != uri_length ||
+	    header.size != is.GetSize() ||
+	    header.mtime != GetCacheModificationTime(uri))
+		return false;
+
+	std::unique_ptr<char[]> cached_uri(new char[uri_length]);
+	if (!ReadCacheFile(reader, cached_uri.get(), uri_length) ||
+	    memcmp(cached_uri.get(), uri, uri_length) != 0)
+		/* hash collision */
+		return false;
+
+	return ReadCacheFile(reader, &info, sizeof(info));
+}
+
+bool
+ffmpeg_stream_cache_load(Path directory, const InputStream &is,
+			 FfmpegStreamInfo &info)
+{
+	const auto path = MakeCacheFilePath(directory, is.GetURI(),
+					    "ffstream");
+	if (path.IsNull())
+		return false;
+
+	try {
+		FileReader reader(path);
+		if (!LoadCacheFile(reader, is, info)) {
+			FormatDebug(ffmpeg_domain,
+				    "discarding stale stream info of %s",
+				    is.GetURI());
+			return false;
+		}
+	} catch (const std::runtime_error &) {
+		/* no cache file */
+		return false;
+	}
+
+	FormatDebug(ffmpeg_domain, "loaded stream info of %s",
+		    is.GetURI());
+	return true;
+}
+
+void
+ffmpeg_stream_cache_store(Path directory, const InputStream &is,
+			  const FfmpegStreamInfo &info)
+{
+	const char *uri = is.GetURI();
+
+	FfmpegStreamCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, FFMPEG_STREAM_CACHE_MAGIC, sizeof(header.magic));
+	header.version = FFMPEG_STREAM_CACHE_VERSION;
+	header.uri_length = strlen(uri);
+	header.size = is.GetSize();
+	header.mtime = GetCacheModificationTime(uri);
+
+	const auto path = MakeCacheFilePath(directory, uri, "ffstream");
+	if (path.IsNull())
+		return;
+
+	try {
+		FileOutputStream file(path);
+		file.Write(&header, sizeof(header));
+		file.Write(uri, header.uri_length);
+		file.Write(&info, sizeof(info));
+		file.Commit();
+	} catch (const std::runtime_error &e) {
+		LogError(e);
+		return;
+	}
+
+	FormatDebug(ffmpeg_domain, "stored stream info of %s", uri);
+}
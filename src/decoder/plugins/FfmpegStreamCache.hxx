@@ -0,0 +1,83 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_FFMPEG_STREAM_CACHE_HXX
+#define MPD_FFMPEG_STREAM_CACHE_HXX
+
+#include "check.h"
+
+#include <stdint.h>
+
+class Path;
+class InputStream;
+
+/**
+ * The parameters of the audio stream which were determined by
+ * avformat_find_stream_info().  With a copy of them, the decoder
+ * does not need to probe the file again the next time, which costs
+ * lots of reads on remote storage.  libavcodec/libavformat enums are
+ * stored as plain integers, which is fine for a cache which is only
+ * read by the same build.
+ */
+struct FfmpegStreamInfo {
+	uint32_t n_streams;
+	int32_t audio_stream;
+
+	int32_t codec_id;
+	int32_t sample_format;
+	int32_t sample_rate;
+	int32_t channels;
+	uint64_t channel_layout;
+	int32_t frame_size;
+	int32_t block_align;
+	int64_t bit_rate;
+
+	/**
+	 * The size of the codec's extradata after probing.  The
+	 * cache is only used if the container header provides it,
+	 * because it is not stored in the cache.
+	 */
+	int32_t extradata_size;
+
+	int32_t time_base_num, time_base_den;
+	int64_t start_time;
+	int64_t duration;
+};
+
+/**
+ * Load the stream parameters of the file served by the
+ * #InputStream from the cache directory.  The entry is only used if
+ * the URI, the file size and the modification time still match.
+ *
+ * @return false if there is no valid cache entry
+ */
+bool
+ffmpeg_stream_cache_load(Path directory, const InputStream &is,
+			 FfmpegStreamInfo &info);
+
+/**
+ * Store the stream parameters of the file served by the
+ * #InputStream in the cache directory.  Errors are logged.
+ */
+void
+ffmpeg_stream_cache_store(Path directory, const InputStream &is,
+			  const FfmpegStreamInfo &info);
+
+#endif
@@ -26,14 +26,18 @@
 #include "FlacMetadata.hxx"
 #include "FlacPcm.hxx"
 #include "CheckAudioFormat.hxx"
+#include "util/WritableBuffer.hxx"
 #include "util/Error.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 flac_data::flac_data(Decoder &_decoder,
 		     InputStream &_input_stream)
 	:FlacInput(_input_stream, &_decoder),
 	 initialized(false), unsupported(false),
 	 total_frames(0), first_frame(0), next_frame(0), position(0),
+	 skip_until(0), has_seek_table(false), seek_cache(nullptr),
 	 decoder(_decoder), input_stream(_input_stream)
 {
 }
@@ -97,6 +101,10 @@ void flac_metadata_common_cb(const FLAC__StreamMetadata * block,
 		flac_got_stream_info(data, &block->data.stream_info);
 		break;
 
+	case FLAC__METADATA_TYPE_SEEKTABLE:
+		data->has_seek_table = block->data.seek_table.num_points > 0;
+		break;
+
 	case FLAC__METADATA_TYPE_VORBIS_COMMENT:
 		if (flac_parse_replay_gain(rgi, block->data.vorbis_comment))
 			decoder_replay_gain(data->decoder, &rgi);
@@ -154,29 +162,76 @@ flac_common_write(struct flac_data *data, const FLAC__Frame * frame,
 		  const FLAC__int32 *const buf[],
 		  FLAC__uint64 nbytes)
 {
-	void *buffer;
 	unsigned bit_rate;
 
 	if (!data->initialized && !flac_got_first_frame(data, &frame->header))
 		return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
 
-	size_t buffer_size = frame->header.blocksize * data->frame_size;
-	buffer = data->buffer.Get(buffer_size);
-
-	flac_convert(buffer, frame->header.channels,
-		     data->audio_format.format, buf,
-		     0, frame->header.blocksize);
-
 	if (nbytes > 0)
 		bit_rate = nbytes * 8 * frame->header.sample_rate /
 			(1000 * frame->header.blocksize);
 	else
 		bit_rate = 0;
 
-	auto cmd = decoder_data(data->decoder, data->input_stream,
-				buffer, buffer_size,
-				bit_rate);
-	data->next_frame += frame->header.blocksize;
+	const unsigned blocksize = frame->header.blocksize;
+	unsigned position = 0;
+
+	if (data->skip_until > 0) {
+		/* libFLAC converts frame numbers to sample numbers
+		   before invoking the write callback */
+		const FLAC__uint64 sample = frame->header.number.sample_number;
+		if (sample + blocksize <= data->skip_until) {
+			data->next_frame = sample + blocksize;
+			return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+		}
+
+		if (sample < data->skip_until)
+			position = data->skip_until - sample;
+
+		data->skip_until = 0;
+		data->next_frame = sample;
+	}
+
+	DecoderCommand cmd = DecoderCommand::NONE;
+
+	while (position < blocksize) {
+		/* convert straight into the music pipe if possible */
+		WritableBuffer<void> dest;
+		cmd = decoder_data_begin(data->decoder, data->input_stream,
+					 data->frame_size, bit_rate, dest);
+		if (cmd != DecoderCommand::NONE)
+			break;
+
+		if (dest.IsEmpty()) {
+			/* PCM conversion is needed; go through our
+			   own buffer */
+			const size_t buffer_size =
+				(blocksize - position) * data->frame_size;
+			void *buffer = data->buffer.Get(buffer_size);
+
+			flac_convert(buffer, frame->header.channels,
+				     data->audio_format.format, buf,
+				     position, blocksize);
+
+			cmd = decoder_data(data->decoder, data->input_stream,
+					   buffer, buffer_size,
+					   bit_rate);
+			break;
+		}
+
+		const unsigned n = std::min<size_t>(dest.size / data->frame_size,
+						    blocksize - position);
+		flac_convert(dest.data, frame->header.channels,
+			     data->audio_format.format, buf,
+			     position, position + n);
+		position += n;
+
+		cmd = decoder_data_commit(data->decoder, n * data->frame_size);
+		if (cmd != DecoderCommand::NONE)
+			break;
+	}
+
+	data->next_frame += blocksize;
 	switch (cmd) {
 	case DecoderCommand::NONE:
 	case DecoderCommand::START:
@@ -30,6 +30,8 @@
 
 #include <FLAC/stream_decoder.h>
 
+class FlacSeekCache;
+
 struct flac_data : public FlacInput {
 	PcmBuffer buffer;
 
@@ -74,6 +76,23 @@ struct flac_data : public FlacInput {
 
 	FLAC__uint64 position;
 
+	/**
+	 * Frames before this sample are discarded.  This is used
+	 * after jumping to a point from the #seek_cache, which is
+	 * usually a bit before the seek destination.
+	 */
+	FLAC__uint64 skip_until;
+
+	/**
+	 * Does the file have a SEEKTABLE block?
+	 */
+	bool has_seek_table;
+
+	/**
+	 * Collects frame offsets for seeking; nullptr if disabled.
+	 */
+	FlacSeekCache *seek_cache;
+
 	Decoder &decoder;
 	InputStream &input_stream;
 
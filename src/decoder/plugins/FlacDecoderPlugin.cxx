@@ -22,9 +22,13 @@
 #include "FlacDomain.hxx"
 #include "FlacCommon.hxx"
 #include "FlacMetadata.hxx"
+#include "FlacSeekCache.hxx"
 #include "OggCodec.hxx"
+#include "config/Block.hxx"
 #include "fs/Path.hxx"
+#include "fs/AllocatedPath.hxx"
 #include "fs/NarrowPath.hxx"
+#include "system/FatalError.hxx"
 #include "util/Error.hxx"
 #include "Log.hxx"
 
@@ -32,6 +36,36 @@
 #error libFLAC is too old
 #endif
 
+/**
+ * The directory where seek tables for files without a SEEKTABLE
+ * block are cached (see FlacSeekCache.hxx); nullptr if disabled.
+ */
+static AllocatedPath *seek_cache_directory;
+
+/**
+ * The distance between two points in the #FlacSeekCache [seconds].
+ */
+static constexpr unsigned FLAC_SEEK_CACHE_INTERVAL = 1;
+
+static bool
+flac_init(const ConfigBlock &block)
+{
+	Error error;
+	auto path = block.GetBlockPath("seek_cache", error);
+	if (!path.IsNull())
+		seek_cache_directory = new AllocatedPath(std::move(path));
+	else if (error.IsDefined())
+		FatalError(error);
+
+	return true;
+}
+
+static void
+flac_finish()
+{
+	delete seek_cache_directory;
+}
+
 static void flacPrintErroredState(FLAC__StreamDecoderState state)
 {
 	switch (state) {
@@ -77,6 +111,16 @@ flac_write_cb(const FLAC__StreamDecoder *dec, const FLAC__Frame *frame,
 	} else
 		nbytes = 0;
 
+	if (data->seek_cache != nullptr && data->position > 0 &&
+	    data->initialized)
+		/* while in the write callback, the decode position
+		   is the start of the next frame */
+		data->seek_cache->Add(frame->header.number.sample_number +
+				      frame->header.blocksize,
+				      data->position,
+				      FLAC_SEEK_CACHE_INTERVAL *
+				      data->audio_format.sample_rate);
+
 	return flac_common_write(data, frame, buf, nbytes);
 }
 
@@ -112,13 +156,25 @@ flac_scan_stream(InputStream &is,
 	return true;
 }
 
+static void
+flac_decoder_free(void *context)
+{
+	FLAC__stream_decoder_delete((FLAC__StreamDecoder *)context);
+}
+
 /**
- * Some glue code around FLAC__stream_decoder_new().
+ * Some glue code around FLAC__stream_decoder_new().  The
+ * #FLAC__StreamDecoder of the previous song is reused if possible;
+ * it has been returned to the uninitialized state by
+ * FLAC__stream_decoder_finish(), which also resets all settings.
  */
 static FLAC__StreamDecoder *
-flac_decoder_new(void)
+flac_decoder_new(Decoder &decoder)
 {
-	FLAC__StreamDecoder *sd = FLAC__stream_decoder_new();
+	FLAC__StreamDecoder *sd =
+		(FLAC__StreamDecoder *)decoder_take_context(decoder);
+	if (sd == nullptr)
+		sd = FLAC__stream_decoder_new();
 	if (sd == nullptr) {
 		LogError(flac_domain,
 			 "FLAC__stream_decoder_new() failed");
@@ -129,6 +185,11 @@ flac_decoder_new(void)
 		LogDebug(flac_domain,
 			 "FLAC__stream_decoder_set_metadata_respond() has failed");
 
+	if (seek_cache_directory != nullptr &&
+	    !FLAC__stream_decoder_set_metadata_respond(sd, FLAC__METADATA_TYPE_SEEKTABLE))
+		LogDebug(flac_domain,
+			 "FLAC__stream_decoder_set_metadata_respond() has failed");
+
 	return sd;
 }
 
@@ -167,6 +228,41 @@ flac_decoder_initialize(struct flac_data *data, FLAC__StreamDecoder *sd,
 	return data->initialized;
 }
 
+/**
+ * Seek to a point from the #FlacSeekCache and let
+ * flac_common_write() discard the samples before the destination.
+ *
+ * @return false if there is no suitable point, which means that
+ * libFLAC has to search the stream
+ */
+static bool
+flac_seek_cached(struct flac_data *data, FLAC__StreamDecoder *flac_dec,
+		 FLAC__uint64 seek_sample)
+{
+	if (data->seek_cache == nullptr)
+		return false;
+
+	const FlacSeekPoint *point =
+		data->seek_cache->Find(seek_sample,
+				       2 * FLAC_SEEK_CACHE_INTERVAL *
+				       data->audio_format.sample_rate);
+	if (point == nullptr)
+		return false;
+
+	if (!FLAC__stream_decoder_flush(flac_dec))
+		return false;
+
+	Error error;
+	if (!data->input_stream.LockSeek(point->offset, error)) {
+		LogError(error);
+		return false;
+	}
+
+	data->next_frame = point->sample;
+	data->skip_until = seek_sample;
+	return true;
+}
+
 static void
 flac_decoder_loop(struct flac_data *data, FLAC__StreamDecoder *flac_dec,
 		  FLAC__uint64 t_start, FLAC__uint64 t_end)
@@ -189,8 +285,14 @@ flac_decoder_loop(struct flac_data *data, FLAC__StreamDecoder *flac_dec,
 				decoder_seek_where_frame(decoder);
 			if (seek_sample >= t_start &&
 			    (t_end == 0 || seek_sample <= t_end) &&
-			    FLAC__stream_decoder_seek_absolute(flac_dec, seek_sample)) {
+			    flac_seek_cached(data, flac_dec, seek_sample)) {
+				data->position = 0;
+				decoder_command_finished(decoder);
+			} else if (seek_sample >= t_start &&
+				   (t_end == 0 || seek_sample <= t_end) &&
+				   FLAC__stream_decoder_seek_absolute(flac_dec, seek_sample)) {
 				data->next_frame = seek_sample;
+				data->skip_until = 0;
 				data->position = 0;
 				decoder_command_finished(decoder);
 			} else
@@ -258,7 +360,7 @@ flac_decode_internal(Decoder &decoder,
 {
 	FLAC__StreamDecoder *flac_dec;
 
-	flac_dec = flac_decoder_new();
+	flac_dec = flac_decoder_new(decoder);
 	if (flac_dec == nullptr)
 		return;
 
@@ -275,14 +377,31 @@ flac_decode_internal(Decoder &decoder,
 
 	if (!flac_decoder_initialize(&data, flac_dec, 0)) {
 		FLAC__stream_decoder_finish(flac_dec);
-		FLAC__stream_decoder_delete(flac_dec);
+		decoder_keep_context(decoder, flac_dec, flac_decoder_free);
 		return;
 	}
 
+	/* the decode position which is needed to record frame
+	   offsets is only available for native FLAC */
+	FlacSeekCache seek_cache;
+	if (seek_cache_directory != nullptr && !is_ogg &&
+	    !data.has_seek_table &&
+	    input_stream.IsSeekable() && input_stream.KnownSize()) {
+		decoder_cache_lookup(decoder,
+				     seek_cache.Load(*seek_cache_directory,
+						     input_stream));
+		data.seek_cache = &seek_cache;
+	}
+
 	flac_decoder_loop(&data, flac_dec, 0, 0);
 
+	if (data.seek_cache != nullptr)
+		seek_cache.Store(*seek_cache_directory, input_stream);
+
 	FLAC__stream_decoder_finish(flac_dec);
-	FLAC__stream_decoder_delete(flac_dec);
+
+	/* keep the FLAC__StreamDecoder for the next song */
+	decoder_keep_context(decoder, flac_dec, flac_decoder_free);
 }
 
 static void
@@ -376,8 +495,8 @@ static const char *const flac_mime_types[] = {
 
 const struct DecoderPlugin flac_decoder_plugin = {
 	"flac",
-	nullptr,
-	nullptr,
+	flac_init,
+	flac_finish,
 	flac_decode,
 	nullptr,
 	flac_scan_file,
@@ -29,7 +29,6 @@
 #include "tag/ReplayGain.hxx"
 #include "tag/MixRamp.hxx"
 #include "ReplayGainInfo.hxx"
-#include "util/DivideString.hxx"
 
 bool
 flac_parse_replay_gain(ReplayGainInfo &rgi,
@@ -94,14 +93,8 @@ static void
 flac_scan_comment(const FLAC__StreamMetadata_VorbisComment_Entry *entry,
 		  const TagHandler &handler, void *handler_ctx)
 {
-	if (handler.pair != nullptr) {
-		const char *comment = (const char *)entry->entry;
-		const DivideString split(comment, '=');
-		if (split.IsDefined() && !split.IsEmpty())
-			tag_handler_invoke_pair(handler, handler_ctx,
-						split.GetFirst(),
-						split.GetSecond());
-	}
+	vorbis_comment_invoke_pair((const char *)entry->entry,
+				   handler, handler_ctx);
 
 	for (const struct tag_table *i = xiph_tags; i->name != nullptr; ++i)
 		if (flac_copy_comment(entry, i->name, i->type,
@@ -0,0 +1,206 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "FlacSeekCache.hxx"
+#include "FlacDomain.hxx"
+#include "DecoderCacheFile.hxx"
+#include "input/InputStream.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/io/FileReader.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "Log.hxx"
+
+#include <stdexcept>
+#include <memory>
+#include <algorithm>
+#include <iterator>
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * The header of a cache file.  It is followed by the URI (without
+ * the null terminator) and n_points #FlacSeekPoint structs.  The
+ * file is only read by the host which wrote it, therefore all
+ * numbers are in host byte order.
+ */
+struct FlacSeekCacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t uri_length;
+	uint64_t size;
+	int64_t mtime;
+	uint32_t n_points;
+	uint32_t reserved;
+};
+
+static constexpr char FLAC_SEEK_CACHE_MAGIC[8] = "MPDFLCS";
+static constexpr uint32_t FLAC_SEEK_CACHE_VERSION = 1;
+
+static bool
+LoadCacheFile(FileReader &reader, const InputStream &is,
+	      std::vector<FlacSeekPoint> &points)
+{
+	const char *uri = is.GetURI();
+	const size_t uri_length = strlen(uri);
+
+	FlacSeekCacheHeader header;
+	if (!ReadCacheFile(reader, &header, sizeof(header)) ||
+	    memcmp(header.magic, FLAC_SEEK_CACHE_MAGIC,
+		   sizeof(header.magic)) != 0 ||
+	    header.version != FLAC_SEEK_CACHE_VERSION ||
+	    header.uri_length != uri_length ||
+	    header.size != is.GetSize() ||
+	    header.mtime != GetCacheModificationTime(uri) ||
+	    header.n_points == 0)
+		return false;
+
+	std::unique_ptr<char[]> cached_uri(new char[uri_length]);
+	if (!ReadCacheFile(reader, cached_uri.get(), uri_length) ||
+	    memcmp(cached_uri.get(), uri, uri_length) != 0)
+		/* hash collision */
+		return false;
+
+	points.resize(header.n_points);
+	if (!ReadCacheFile(reader, &points.front(),
+		      points.size() * sizeof(points.front())))
+		return false;
+
+	for (size_t i = 0; i < points.size(); ++i)
+		if (points[i].offset >= header.size ||
+		    (i > 0 && (points[i].sample <= points[i - 1].sample ||
+			       points[i].offset <= points[i - 1].offset)))
+			return false;
+
+	return true;
+}
+
+bool
+FlacSeekCache::Load(Path directory, const InputStream &is)
+{
+	const auto path = MakeCacheFilePath(directory, is.GetURI(), "flacseek");
+	if (path.IsNull())
+		return false;
+
+	try {
+		FileReader reader(path);
+		if (!LoadCacheFile(reader, is, points)) {
+			points.clear();
+			FormatDebug(flac_domain,
+				    "discarding stale seek table of %s",
+				    is.GetURI());
+			return false;
+		}
+	} catch (const std::runtime_error &) {
+		/* no cache file */
+		return false;
+	}
+
+	modified = false;
+
+	FormatDebug(flac_domain,
+		    "loaded seek table of %s (%zu points)",
+		    is.GetURI(), points.size());
+	return true;
+}
+
+void
+FlacSeekCache::Store(Path directory, const InputStream &is)
+{
+	if (!modified || points.size() < FLAC_SEEK_CACHE_MIN_POINTS)
+		return;
+
+	const char *uri = is.GetURI();
+
+	FlacSeekCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, FLAC_SEEK_CACHE_MAGIC, sizeof(header.magic));
+	header.version = FLAC_SEEK_CACHE_VERSION;
+	header.uri_length = strlen(uri);
+	header.size = is.GetSize();
+	header.mtime = GetCacheModificationTime(uri);
+	header.n_points = points.size();
+
+	const auto path = MakeCacheFilePath(directory, uri, "flacseek");
+	if (path.IsNull())
+		return;
+
+	try {
+		FileOutputStream file(path);
+		file.Write(&header, sizeof(header));
+		file.Write(uri, header.uri_length);
+		file.Write(&points.front(),
+			   points.size() * sizeof(points.front()));
+		file.Commit();
+	} catch (const std::runtime_error &e) {
+		LogError(e);
+		return;
+	}
+
+	modified = false;
+
+	FormatDebug(flac_domain,
+		    "stored seek table of %s (%zu points)",
+		    uri, points.size());
+}
+
+static bool
+CompareSample(FLAC__uint64 sample, const FlacSeekPoint &point)
+{
+	return sample < point.sample;
+}
+
+void
+FlacSeekCache::Add(FLAC__uint64 sample, FLAC__uint64 offset,
+		   FLAC__uint64 min_distance)
+{
+	/* find the first point after the new one; usually, this is
+	   the end of the table */
+	auto i = std::upper_bound(points.begin(), points.end(), sample,
+				  CompareSample);
+
+	if (i != points.begin() &&
+	    (sample < std::prev(i)->sample + min_distance ||
+	     offset <= std::prev(i)->offset))
+		return;
+
+	if (i != points.end() &&
+	    (i->sample < sample + min_distance || i->offset <= offset))
+		return;
+
+	points.insert(i, FlacSeekPoint{sample, offset});
+	modified = true;
+}
+
+const FlacSeekPoint *
+FlacSeekCache::Find(FLAC__uint64 sample, FLAC__uint64 max_distance) const
+{
+	auto i = std::upper_bound(points.begin(), points.end(), sample,
+				  CompareSample);
+	if (i == points.begin())
+		return nullptr;
+
+	--i;
+	if (sample - i->sample > max_distance)
+		return nullptr;
+
+	return &*i;
+}
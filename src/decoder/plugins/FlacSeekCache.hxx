@@ -0,0 +1,111 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_FLAC_SEEK_CACHE_HXX
+#define MPD_FLAC_SEEK_CACHE_HXX
+
+#include "check.h"
+
+#include <FLAC/ordinals.h>
+
+#include <vector>
+
+#include <stddef.h>
+
+class Path;
+class InputStream;
+
+/**
+ * Only tables with at least this many points are stored; shorter
+ * files are cheap enough to search.
+ */
+static constexpr size_t FLAC_SEEK_CACHE_MIN_POINTS = 60;
+
+/**
+ * The start of a FLAC frame.
+ */
+struct FlacSeekPoint {
+	/**
+	 * The number of the first sample in the frame.
+	 */
+	FLAC__uint64 sample;
+
+	/**
+	 * The byte offset of the frame header within the stream.
+	 */
+	FLAC__uint64 offset;
+};
+
+/**
+ * A table of frame offsets for FLAC files without a SEEKTABLE
+ * block.  It is collected while the file is being decoded and
+ * stored in a cache directory, so the next time, the decoder can
+ * jump close to the seek destination instead of letting libFLAC
+ * bisect the stream, which costs lots of random reads on network
+ * storage.
+ */
+class FlacSeekCache {
+	/**
+	 * Sorted by sample number.
+	 */
+	std::vector<FlacSeekPoint> points;
+
+	/**
+	 * Have points been added since the table was loaded?
+	 */
+	bool modified = false;
+
+public:
+	/**
+	 * Load the table of the file served by the #InputStream from
+	 * the cache directory.  The entry is only used if the URI,
+	 * the file size and the modification time still match.
+	 *
+	 * @return false if there is no valid cache entry
+	 */
+	bool Load(Path directory, const InputStream &is);
+
+	/**
+	 * Store the table in the cache directory if it has been
+	 * modified.  Errors are logged.
+	 */
+	void Store(Path directory, const InputStream &is);
+
+	/**
+	 * Remember the start of a frame.  The point is ignored if
+	 * there is already a point closer than the given distance.
+	 */
+	void Add(FLAC__uint64 sample, FLAC__uint64 offset,
+		 FLAC__uint64 min_distance);
+
+	/**
+	 * Find the point where decoding should start in order to
+	 * reach the given sample.
+	 *
+	 * @param max_distance the point must not be further away
+	 * than this number of samples
+	 * @return the point or nullptr if the table has no
+	 * suitable point
+	 */
+	const FlacSeekPoint *Find(FLAC__uint64 sample,
+				  FLAC__uint64 max_distance) const;
+};
+
+#endif
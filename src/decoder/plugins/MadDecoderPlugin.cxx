@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "MadDecoderPlugin.hxx"
+#include "MadSeekCache.hxx"
 #include "../DecoderAPI.hxx"
 #include "input/InputStream.hxx"
 #include "config/ConfigGlobal.hxx"
@@ -28,7 +29,10 @@
 #include "tag/ReplayGain.hxx"
 #include "tag/MixRamp.hxx"
 #include "CheckAudioFormat.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "system/FatalError.hxx"
 #include "util/StringCompare.hxx"
+#include "util/WritableBuffer.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
@@ -39,6 +43,8 @@
 #include <id3tag.h>
 #endif
 
+#include <algorithm>
+
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -68,6 +74,12 @@ static constexpr Domain mad_domain("mad");
 
 static bool gapless_playback;
 
+/**
+ * The directory where frame tables are cached (see MadSeekCache.hxx);
+ * nullptr if disabled.
+ */
+static AllocatedPath *seek_cache_directory;
+
 gcc_const
 static SongTime
 ToSongTime(mad_timer_t t)
@@ -106,13 +118,27 @@ mad_fixed_to_24_buffer(int32_t *dest, const struct mad_synth *synth,
 }
 
 static bool
-mp3_plugin_init(gcc_unused const ConfigBlock &block)
+mp3_plugin_init(const ConfigBlock &block)
 {
 	gapless_playback = config_get_bool(ConfigOption::GAPLESS_MP3_PLAYBACK,
 					   DEFAULT_GAPLESS_MP3_PLAYBACK);
+
+	Error error;
+	auto path = block.GetBlockPath("seek_cache", error);
+	if (!path.IsNull())
+		seek_cache_directory = new AllocatedPath(std::move(path));
+	else if (error.IsDefined())
+		FatalError(error);
+
 	return true;
 }
 
+static void
+mp3_plugin_finish()
+{
+	delete seek_cache_directory;
+}
+
 struct MadDecoder {
 	static constexpr size_t READ_BUFFER_SIZE = 40960;
 	static constexpr size_t MP3_DATA_OUTPUT_BUFFER_SIZE = 2048;
@@ -132,6 +158,29 @@ struct MadDecoder {
 	unsigned long highest_frame;
 	unsigned long max_frames;
 	unsigned long current_frame;
+
+	/**
+	 * The duration of the first frame.  Used to check
+	 * #uniform_frame_duration, and stored in the seek cache.
+	 */
+	mad_timer_t first_frame_duration;
+
+	/**
+	 * Do all frames seen so far have the same duration?  Only then
+	 * can the frame table be cached.
+	 */
+	bool uniform_frame_duration;
+
+	/**
+	 * False if #max_frames was too small to record all frames.
+	 */
+	bool frame_table_complete;
+
+	/**
+	 * Was the frame table loaded from the seek cache?
+	 */
+	bool frame_table_cached;
+
 	unsigned int drop_start_frames;
 	unsigned int drop_end_frames;
 	unsigned int drop_start_samples;
@@ -178,6 +227,18 @@ struct MadDecoder {
 	gcc_pure
 	long TimeToFrame(SongTime t) const;
 
+	/**
+	 * Fill the frame table from the seek cache, if it has an entry
+	 * for this file.  Must be called after AllocateBuffers().
+	 */
+	void LoadFrameTable(Path directory);
+
+	/**
+	 * Store the frame table in the seek cache if the whole file
+	 * has been decoded.
+	 */
+	void StoreFrameTable(Path directory);
+
 	void UpdateTimerNextFrame();
 
 	/**
@@ -200,6 +261,8 @@ MadDecoder::MadDecoder(Decoder *_decoder,
 	 frame_offsets(nullptr),
 	 times(nullptr),
 	 highest_frame(0), max_frames(0), current_frame(0),
+	 uniform_frame_duration(true),
+	 frame_table_complete(true), frame_table_cached(false),
 	 drop_start_frames(0), drop_end_frames(0),
 	 drop_start_samples(0), drop_end_samples(0),
 	 found_replay_gain(false),
@@ -872,12 +935,19 @@ MadDecoder::UpdateTimerNextFrame()
 		   (for seeking) and times */
 		bit_rate = frame.header.bitrate;
 
-		if (current_frame >= max_frames)
+		if (current_frame >= max_frames) {
 			/* cap current_frame */
 			current_frame = max_frames - 1;
-		else
+			frame_table_complete = false;
+		} else
 			highest_frame++;
 
+		if (current_frame == 0)
+			first_frame_duration = frame.header.duration;
+		else if (mad_timer_compare(frame.header.duration,
+					   first_frame_duration) != 0)
+			uniform_frame_duration = false;
+
 		frame_offsets[current_frame] = ThisFrameOffset();
 
 		mad_timer_add(&timer, frame.header.duration);
@@ -890,14 +960,104 @@ MadDecoder::UpdateTimerNextFrame()
 	elapsed_time = ToSongTime(timer);
 }
 
+void
+MadDecoder::LoadFrameTable(Path directory)
+{
+	assert(highest_frame == 0);
+
+	if (!input_stream.IsSeekable() || !input_stream.KnownSize())
+		return;
+
+	MadSeekTable table;
+	const bool found = mad_seek_cache_load(directory, input_stream, table);
+	decoder_cache_lookup(*decoder, found);
+	if (!found)
+		return;
+
+	const unsigned long n = table.offsets.size();
+	if (n > max_frames) {
+		if (drop_end_samples > 0)
+			/* the LAME header has given us the exact
+			   number of frames, and it does not match */
+			return;
+
+		delete[] frame_offsets;
+		delete[] times;
+		frame_offsets = nullptr;
+		times = nullptr;
+
+		max_frames = n + FRAMES_CUSHION;
+		AllocateBuffers();
+	}
+
+	mad_timer_t t = mad_timer_zero;
+	for (unsigned long i = 0; i < n; ++i) {
+		frame_offsets[i] = table.offsets[i];
+		mad_timer_add(&t, table.frame_duration);
+		times[i] = t;
+	}
+
+	highest_frame = n;
+	first_frame_duration = table.frame_duration;
+	frame_table_cached = true;
+
+	/* now we know the exact duration */
+	total_time = ToSongTime(t);
+}
+
+void
+MadDecoder::StoreFrameTable(Path directory)
+{
+	if (frame_table_cached || !frame_table_complete ||
+	    !uniform_frame_duration ||
+	    /* decoding stopped before the end of the file */
+	    drop_end_samples > 0 ||
+	    highest_frame < MAD_SEEK_CACHE_MIN_FRAMES ||
+	    !input_stream.IsSeekable() || !input_stream.KnownSize() ||
+	    decoder_get_command(*decoder) != DecoderCommand::NONE ||
+	    !input_stream.LockIsEOF())
+		return;
+
+	mad_seek_cache_store(directory, input_stream,
+			     frame_offsets, highest_frame,
+			     first_frame_duration);
+}
+
 DecoderCommand
 MadDecoder::SendPCM(unsigned i, unsigned pcm_length)
 {
+	const unsigned channels = MAD_NCHANNELS(&frame.header);
+	const size_t frame_size = sizeof(output_buffer[0]) * channels;
 	unsigned max_samples = sizeof(output_buffer) /
-		sizeof(output_buffer[0]) /
-		MAD_NCHANNELS(&frame.header);
+		sizeof(output_buffer[0]) / channels;
 
 	while (i < pcm_length) {
+		/* convert straight into the music pipe if possible */
+		WritableBuffer<void> dest;
+		auto cmd = decoder_data_begin(*decoder, input_stream,
+					      frame_size, bit_rate / 1000,
+					      dest);
+		if (cmd != DecoderCommand::NONE)
+			return cmd;
+
+		if (!dest.IsEmpty()) {
+			const unsigned num_samples =
+				std::min<size_t>(pcm_length - i,
+						 dest.size / frame_size);
+			mad_fixed_to_24_buffer((int32_t *)dest.data, &synth,
+					       i, i + num_samples, channels);
+			i += num_samples;
+
+			cmd = decoder_data_commit(*decoder,
+						  num_samples * frame_size);
+			if (cmd != DecoderCommand::NONE)
+				return cmd;
+
+			continue;
+		}
+
+		/* PCM conversion is needed; go through our own
+		   buffer */
 		unsigned int num_samples = pcm_length - i;
 		if (num_samples > max_samples)
 			num_samples = max_samples;
@@ -905,13 +1065,12 @@ MadDecoder::SendPCM(unsigned i, unsigned pcm_length)
 		i += num_samples;
 
 		mad_fixed_to_24_buffer(output_buffer, &synth,
-				       i - num_samples, i,
-				       MAD_NCHANNELS(&frame.header));
-		num_samples *= MAD_NCHANNELS(&frame.header);
+				       i - num_samples, i, channels);
+		num_samples *= channels;
 
-		auto cmd = decoder_data(*decoder, input_stream, output_buffer,
-					sizeof(output_buffer[0]) * num_samples,
-					bit_rate / 1000);
+		cmd = decoder_data(*decoder, input_stream, output_buffer,
+				   sizeof(output_buffer[0]) * num_samples,
+				   bit_rate / 1000);
 		if (cmd != DecoderCommand::NONE)
 			return cmd;
 	}
@@ -1056,6 +1215,9 @@ mp3_decode(Decoder &decoder, InputStream &input_stream)
 
 	data.AllocateBuffers();
 
+	if (seek_cache_directory != nullptr)
+		data.LoadFrameTable(*seek_cache_directory);
+
 	Error error;
 	AudioFormat audio_format;
 	if (!audio_format_init_checked(audio_format,
@@ -1078,6 +1240,9 @@ mp3_decode(Decoder &decoder, InputStream &input_stream)
 	}
 
 	while (data.Read()) {}
+
+	if (seek_cache_directory != nullptr)
+		data.StoreFrameTable(*seek_cache_directory);
 }
 
 static bool
@@ -1100,7 +1265,7 @@ static const char *const mp3_mime_types[] = { "audio/mpeg", nullptr };
 const struct DecoderPlugin mad_decoder_plugin = {
 	"mad",
 	mp3_plugin_init,
-	nullptr,
+	mp3_plugin_finish,
 	mp3_decode,
 	nullptr,
 	nullptr,
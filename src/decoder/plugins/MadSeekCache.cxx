@@ -0,0 +1,187 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "MadSeekCache.hxx"
+#include "DecoderCacheFile.hxx"
+#include "input/InputStream.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/io/FileReader.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <stdexcept>
+#include <memory>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+static constexpr Domain mad_seek_cache_domain("mad_seek_cache");
+
+/**
+ * The header of a cache file.  It is followed by the URI (without
+ * the null terminator) and n_frames-1 32 bit offset deltas.  The
+ * file is only read by the host which wrote it, therefore all
+ * numbers are in host byte order.
+ */
+struct MadSeekCacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t uri_length;
+	uint64_t size;
+	int64_t mtime;
+	uint64_t first_offset;
+	uint32_t n_frames;
+	int32_t duration_seconds;
+	uint32_t duration_fraction;
+	uint32_t reserved;
+};
+
+static constexpr char MAD_SEEK_CACHE_MAGIC[8] = "MPDMADS";
+static constexpr uint32_t MAD_SEEK_CACHE_VERSION = 1;
+
+static bool
+LoadCacheFile(FileReader &reader, const InputStream &is,
+	      MadSeekTable &table)
+{
+	const char *uri = is.GetURI();
+	const size_t uri_length = strlen(uri);
+
+	MadSeekCacheHeader header;
+	if (!ReadCacheFile(reader, &header, sizeof(header)) ||
+	    memcmp(header.magic, MAD_SEEK_CACHE_MAGIC,
+		   sizeof(header.magic)) != 0 ||
+	    header.version != MAD_SEEK_CACHE_VERSION ||
+	    header.uri_length != uri_length ||
+	    header.size != is.GetSize() ||
+	    header.mtime != GetCacheModificationTime(uri) ||
+	    header.n_frames == 0 ||
+	    header.first_offset >= header.size)
+		return false;
+
+	std::unique_ptr<char[]> cached_uri(new char[uri_length]);
+	if (!ReadCacheFile(reader, cached_uri.get(), uri_length) ||
+	    memcmp(cached_uri.get(), uri, uri_length) != 0)
+		/* hash collision */
+		return false;
+
+	const size_t n_deltas = header.n_frames - 1;
+	std::unique_ptr<uint32_t[]> deltas(new uint32_t[n_deltas]);
+	if (!ReadCacheFile(reader, deltas.get(), n_deltas * sizeof(deltas[0])))
+		return false;
+
+	table.offsets.clear();
+	table.offsets.reserve(header.n_frames);
+
+	offset_type offset = header.first_offset;
+	table.offsets.push_back(offset);
+	for (size_t i = 0; i < n_deltas; ++i) {
+		offset += deltas[i];
+		if (offset >= header.size)
+			return false;
+
+		table.offsets.push_back(offset);
+	}
+
+	table.frame_duration.seconds = header.duration_seconds;
+	table.frame_duration.fraction = header.duration_fraction;
+	return true;
+}
+
+bool
+mad_seek_cache_load(Path directory, const InputStream &is,
+		    MadSeekTable &table)
+{
+	const auto path = MakeCacheFilePath(directory, is.GetURI(), "mp3seek");
+	if (path.IsNull())
+		return false;
+
+	try {
+		FileReader reader(path);
+		if (!LoadCacheFile(reader, is, table)) {
+			FormatDebug(mad_seek_cache_domain,
+				    "discarding stale seek table of %s",
+				    is.GetURI());
+			return false;
+		}
+	} catch (const std::runtime_error &) {
+		/* no cache file */
+		return false;
+	}
+
+	FormatDebug(mad_seek_cache_domain,
+		    "loaded seek table of %s (%zu frames)",
+		    is.GetURI(), table.offsets.size());
+	return true;
+}
+
+void
+mad_seek_cache_store(Path directory, const InputStream &is,
+		     const long *offsets, unsigned long n_frames,
+		     mad_timer_t frame_duration)
+{
+	assert(n_frames > 0);
+
+	const char *uri = is.GetURI();
+
+	MadSeekCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAD_SEEK_CACHE_MAGIC, sizeof(header.magic));
+	header.version = MAD_SEEK_CACHE_VERSION;
+	header.uri_length = strlen(uri);
+	header.size = is.GetSize();
+	header.mtime = GetCacheModificationTime(uri);
+	header.first_offset = offsets[0];
+	header.n_frames = n_frames;
+	header.duration_seconds = frame_duration.seconds;
+	header.duration_fraction = frame_duration.fraction;
+
+	const size_t n_deltas = n_frames - 1;
+	std::unique_ptr<uint32_t[]> deltas(new uint32_t[n_deltas]);
+	for (size_t i = 0; i < n_deltas; ++i) {
+		if (offsets[i + 1] <= offsets[i] ||
+		    offsets[i + 1] - offsets[i] > 0xffffffffl)
+			/* not a plain sequence of frames */
+			return;
+
+		deltas[i] = offsets[i + 1] - offsets[i];
+	}
+
+	const auto path = MakeCacheFilePath(directory, uri, "mp3seek");
+	if (path.IsNull())
+		return;
+
+	try {
+		FileOutputStream file(path);
+		file.Write(&header, sizeof(header));
+		file.Write(uri, header.uri_length);
+		file.Write(deltas.get(), n_deltas * sizeof(deltas[0]));
+		file.Commit();
+	} catch (const std::runtime_error &e) {
+		LogError(e);
+		return;
+	}
+
+	FormatDebug(mad_seek_cache_domain,
+		    "stored seek table of %s (%lu frames)",
+		    uri, n_frames);
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_MAD_SEEK_CACHE_HXX
+#define MPD_MAD_SEEK_CACHE_HXX
+
+#include "check.h"
+#include "input/Offset.hxx"
+
+#include <mad.h>
+
+#include <vector>
+
+class Path;
+class InputStream;
+
+/**
+ * Only files with at least this many frames are cached; shorter
+ * files are cheap enough to scan.
+ */
+static constexpr unsigned long MAD_SEEK_CACHE_MIN_FRAMES = 16384;
+
+/**
+ * The frame table of one MP3 file.  It is assumed that all frames
+ * have the same duration.
+ */
+struct MadSeekTable {
+	/**
+	 * The file offset of each frame.
+	 */
+	std::vector<offset_type> offsets;
+
+	mad_timer_t frame_duration;
+};
+
+/**
+ * Load the frame table of the file served by the #InputStream from
+ * the cache directory.  The entry is only used if the URI, the file
+ * size and the modification time still match.
+ *
+ * @return false if there is no valid cache entry
+ */
+bool
+mad_seek_cache_load(Path directory, const InputStream &is,
+		    MadSeekTable &table);
+
+/**
+ * Store the frame table of the file served by the #InputStream in
+ * the cache directory.  Errors are logged.
+ */
+void
+mad_seek_cache_store(Path directory, const InputStream &is,
+		     const long *offsets, unsigned long n_frames,
+		     mad_timer_t frame_duration);
+
+#endif
@@ -23,6 +23,13 @@
 #include "input/InputStream.hxx"
 #include "util/Error.hxx"
 
+OggDecoder::OggDecoder(DecoderReader &reader)
+	:OggVisitor(reader, reader.GetInputStream().GetOffset()),
+	 decoder(reader.GetDecoder()),
+	 input_stream(reader.GetInputStream())
+{
+}
+
 /**
  * Load the end-of-stream packet and restore the previous file
  * position.
@@ -72,16 +79,41 @@ OggDecoder::SeekGranulePos(ogg_int64_t where_granulepos, Error &error)
 {
 	assert(IsSeekable());
 
-	/* interpolate the file offset where we expect to find the
-	   given granule position */
+	/* look up the page in the index; if it has not been seen
+	   yet, interpolate the file offset where we expect to find
+	   the given granule position */
 	/* TODO: implement binary search */
-	offset_type offset(where_granulepos * input_stream.GetSize()
-			   / end_granulepos);
+	int64_t offset;
+	page_index.Find(where_granulepos, end_granulepos,
+			input_stream.GetSize(), offset);
 
 	if (!input_stream.LockSeek(offset, error))
 		return false;
 
-	PostSeek();
+	page_index.Interrupt();
+	PostSeek(offset);
 	return true;
 }
 
+void
+OggDecoder::OnOggPage(const ogg_page &page, int64_t offset)
+{
+	const ogg_int64_t granulepos = ogg_page_granulepos(&page);
+	if (granulepos < 0)
+		/* no packet ends on this page */
+		return;
+
+	if (offset < 0)
+		return;
+
+	const long serialno = ogg_page_serialno(&page);
+	if (serialno != page_index_serialno) {
+		/* a new chained stream: granule positions start
+		   over */
+		page_index.Clear();
+		page_index_serialno = serialno;
+	}
+
+	page_index.Add(granulepos, offset);
+}
+
@@ -22,6 +22,7 @@
 
 #include "config.h" /* must be first for large file support */
 #include "lib/xiph/OggVisitor.hxx"
+#include "lib/xiph/OggPageIndex.hxx"
 #include "decoder/Reader.hxx"
 
 class Error;
@@ -29,15 +30,23 @@ class Error;
 class OggDecoder : public OggVisitor {
 	ogg_int64_t end_granulepos;
 
+	/**
+	 * Remembers the offsets of pages which have been read, to
+	 * allow exact seeking to them later.
+	 */
+	OggPageIndex page_index;
+
+	/**
+	 * The serial number of the stream described by #page_index.
+	 */
+	long page_index_serialno = 0;
+
 protected:
 	Decoder &decoder;
 	InputStream &input_stream;
 
 public:
-	explicit OggDecoder(DecoderReader &reader)
-		:OggVisitor(reader),
-		 decoder(reader.GetDecoder()),
-		 input_stream(reader.GetInputStream()) {}
+	explicit OggDecoder(DecoderReader &reader);
 
 	bool Seek(OggSyncState &oy, uint64_t where_frame);
 
@@ -59,6 +68,9 @@ protected:
 	}
 
 	bool SeekGranulePos(ogg_int64_t where_granulepos, Error &error);
+
+	/* virtual methods from class OggVisitor */
+	void OnOggPage(const ogg_page &page, int64_t offset) override;
 };
 
 #endif
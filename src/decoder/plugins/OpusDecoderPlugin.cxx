@@ -32,6 +32,7 @@
 #include "tag/TagHandler.hxx"
 #include "tag/TagBuilder.hxx"
 #include "input/InputStream.hxx"
+#include "util/WritableBuffer.hxx"
 #include "util/Error.hxx"
 #include "util/RuntimeError.hxx"
 #include "Log.hxx"
@@ -46,8 +47,8 @@ namespace {
 static constexpr opus_int32 opus_sample_rate = 48000;
 
 /**
- * Allocate an output buffer for 16 bit PCM samples big enough to hold
- * a quarter second, larger than 120ms required by libopus.
+ * Allocate an output buffer for PCM samples big enough to hold a
+ * quarter second, larger than 120ms required by libopus.
  */
 static constexpr unsigned opus_output_buffer_frames = opus_sample_rate / 4;
 
@@ -75,7 +76,18 @@ mpd_opus_init(gcc_unused const ConfigBlock &block)
 
 class MPDOpusDecoder final : public OggDecoder {
 	OpusDecoder *opus_decoder = nullptr;
-	opus_int16 *output_buffer = nullptr;
+
+	/**
+	 * Decode with opus_decode_float() instead of opus_decode()?
+	 * This is decided by decoder_preferred_format().
+	 */
+	bool use_float = false;
+
+	/**
+	 * Holds #opus_output_buffer_frames frames of opus_int16 or
+	 * float samples (see #use_float).
+	 */
+	uint8_t *output_buffer = nullptr;
 
 	/**
 	 * If non-zero, then a previous Opus stream has been found
@@ -103,6 +115,24 @@ public:
 	bool Seek(uint64_t where_frame);
 
 private:
+	/**
+	 * Decode one packet into the given buffer.
+	 *
+	 * @return the number of frames or a negative libopus error
+	 * code
+	 */
+	int Decode(const ogg_packet &packet, void *dest, int max_frames) {
+		return use_float
+			? opus_decode_float(opus_decoder,
+					    (const unsigned char*)packet.packet,
+					    packet.bytes,
+					    (float *)dest, max_frames, 0)
+			: opus_decode(opus_decoder,
+				      (const unsigned char*)packet.packet,
+				      packet.bytes,
+				      (opus_int16 *)dest, max_frames, 0);
+	}
+
 	void HandleTags(const ogg_packet &packet);
 	void HandleAudio(const ogg_packet &packet);
 
@@ -173,15 +203,32 @@ MPDOpusDecoder::OnOggBeginning(const ogg_packet &packet)
 						      opus_sample_rate)
 		: SignedSongTime::Negative();
 
+	/* libopus works with floating point internally; decoding to
+	   16 bit is cheaper, but if the outputs want more than 16
+	   bits anyway, the float samples lose nothing */
+	switch (decoder_preferred_format(decoder).format) {
+	case SampleFormat::S24_P32:
+	case SampleFormat::S32:
+	case SampleFormat::FLOAT:
+		use_float = true;
+		break;
+
+	default:
+		use_float = false;
+		break;
+	}
+
 	previous_channels = channels;
 	const AudioFormat audio_format(opus_sample_rate,
-				       SampleFormat::S16, channels);
+				       use_float
+				       ? SampleFormat::FLOAT
+				       : SampleFormat::S16,
+				       channels);
 	decoder_initialized(decoder, audio_format,
 			    eos_granulepos > 0, duration);
 	frame_size = audio_format.GetFrameSize();
 
-	output_buffer = new opus_int16[opus_output_buffer_frames
-				       * audio_format.channels];
+	output_buffer = new uint8_t[opus_output_buffer_frames * frame_size];
 
 	auto cmd = decoder_get_command(decoder);
 	if (cmd != DecoderCommand::NONE)
@@ -228,20 +275,36 @@ MPDOpusDecoder::HandleAudio(const ogg_packet &packet)
 {
 	assert(opus_decoder != nullptr);
 
-	int nframes = opus_decode(opus_decoder,
-				  (const unsigned char*)packet.packet,
-				  packet.bytes,
-				  output_buffer, opus_output_buffer_frames,
-				  0);
+	/* libopus decodes a whole packet at once; if a music pipe
+	   chunk has room for it, decode straight into the chunk */
+	WritableBuffer<void> dest = nullptr;
+	const int packet_frames =
+		opus_packet_get_nb_samples((const unsigned char*)packet.packet,
+					   packet.bytes, opus_sample_rate);
+	if (packet_frames > 0) {
+		auto cmd = decoder_data_begin(decoder, input_stream,
+					      packet_frames * frame_size, 0,
+					      dest);
+		if (cmd != DecoderCommand::NONE)
+			throw cmd;
+	}
+
+	const bool direct = !dest.IsEmpty();
+
+	int nframes = direct
+		? Decode(packet, dest.data, dest.size / frame_size)
+		: Decode(packet, output_buffer, opus_output_buffer_frames);
 	if (nframes < 0)
 		throw FormatRuntimeError("libopus error: %s",
 					 opus_strerror(nframes));
 
 	if (nframes > 0) {
 		const size_t nbytes = nframes * frame_size;
-		auto cmd = decoder_data(decoder, input_stream,
-					output_buffer, nbytes,
-					0);
+		auto cmd = direct
+			? decoder_data_commit(decoder, nbytes)
+			: decoder_data(decoder, input_stream,
+				       output_buffer, nbytes,
+				       0);
 		if (cmd != DecoderCommand::NONE)
 			throw cmd;
 
@@ -21,8 +21,7 @@
 #define MPD_OPUS_READER_HXX
 
 #include "check.h"
-
-#include <algorithm>
+#include "util/StringView.hxx"
 
 #include <stdint.h>
 #include <string.h>
@@ -83,18 +82,21 @@ public:
 		return ReadWord(length) && Skip(length);
 	}
 
-	char *ReadString() {
+	/**
+	 * Read a string without copying it.  The result points into
+	 * the packet and is not null-terminated.
+	 */
+	bool ReadString(StringView &value_r) {
 		uint32_t length;
-		if (!ReadWord(length) || length >= 65536)
-			return nullptr;
+		if (!ReadWord(length))
+			return false;
 
 		const char *src = (const char *)Read(length);
 		if (src == nullptr)
-			return nullptr;
+			return false;
 
-		char *dest = new char[length + 1];
-		*std::copy_n(src, length, dest) = 0;
-		return dest;
+		value_r = {src, length};
+		return true;
 	}
 };
 
@@ -24,6 +24,10 @@
 #include "tag/TagHandler.hxx"
 #include "tag/Tag.hxx"
 #include "ReplayGainInfo.hxx"
+#include "util/ReusableArray.hxx"
+#include "util/StringView.hxx"
+
+#include <algorithm>
 
 #include <stdint.h>
 #include <string.h>
@@ -83,19 +87,35 @@ ScanOpusTags(const void *data, size_t size,
 	if (!r.ReadWord(n))
 		return false;
 
+	/* each comment is copied into this buffer (to null-terminate
+	   it), which is reused for all of them */
+	ReusableArray<char, 256> buffer;
+
 	while (n-- > 0) {
-		char *p = r.ReadString();
-		if (p == nullptr)
+		StringView comment;
+		if (!r.ReadString(comment))
 			return false;
 
-		char *eq = strchr(p, '=');
-		if (eq != nullptr && eq > p) {
-			*eq = 0;
+		if (comment.size >= 65536)
+			/* probably an embedded picture; we don't need
+			   it, and we won't copy it */
+			continue;
+
+		const char *eq = (const char *)
+			memchr(comment.data, '=', comment.size);
+		if (eq == nullptr || eq == comment.data)
+			continue;
+
+		const size_t name_length = eq - comment.data;
+		if (StringView(comment.data, name_length)
+		    .EqualsIgnoreCase("METADATA_BLOCK_PICTURE"))
+			continue;
 
-			ScanOneOpusTag(p, eq + 1, rgi, handler, ctx);
-		}
+		char *p = buffer.Get(comment.size + 1);
+		*std::copy_n(comment.data, comment.size, p) = 0;
+		p[name_length] = 0;
 
-		delete[] p;
+		ScanOneOpusTag(p, p + name_length + 1, rgi, handler, ctx);
 	}
 
 	return true;
@@ -23,6 +23,7 @@
 #include "input/InputStream.hxx"
 #include "util/Error.hxx"
 #include "util/ByteReverse.hxx"
+#include "util/ConstBuffer.hxx"
 #include "Log.hxx"
 
 #include <string.h>
@@ -54,21 +55,26 @@ pcm_stream_decode(Decoder &decoder, InputStream &is)
 	do {
 		char buffer[4096];
 
-		size_t nbytes = decoder_read(decoder, is,
-					     buffer, sizeof(buffer));
+		const auto src = ConstBuffer<uint8_t>::FromVoid(
+			decoder_read_borrow(&decoder, is,
+					    buffer, sizeof(buffer)));
+		const size_t nbytes = src.size;
 
 		if (nbytes == 0 && is.LockIsEOF())
 			break;
 
-		if (reverse_endian)
+		const void *data = src.data;
+		if (reverse_endian) {
 			/* make sure we deliver samples in host byte order */
 			reverse_bytes_16((uint16_t *)buffer,
-					 (uint16_t *)buffer,
-					 (uint16_t *)(buffer + nbytes));
+					 (const uint16_t *)src.begin(),
+					 (const uint16_t *)src.end());
+			data = buffer;
+		}
 
 		cmd = nbytes > 0
 			? decoder_data(decoder, is,
-				       buffer, nbytes, 0)
+				       data, nbytes, 0)
 			: decoder_get_command(decoder);
 		if (cmd == DecoderCommand::SEEK) {
 			uint64_t frame = decoder_seek_where_frame(decoder);
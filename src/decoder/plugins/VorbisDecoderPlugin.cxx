@@ -29,8 +29,8 @@
 #include "input/Reader.hxx"
 #include "OggCodec.hxx"
 #include "pcm/Interleave.hxx"
+#include "pcm/FloatConvert.hxx"
 #include "util/Error.hxx"
-#include "util/Macros.hxx"
 #include "util/ScopeExit.hxx"
 #include "CheckAudioFormat.hxx"
 #include "tag/TagHandler.hxx"
@@ -50,9 +50,16 @@ class VorbisDecoder final : public OggDecoder {
 	typedef ogg_int32_t in_sample_t;
 	typedef int16_t out_sample_t;
 #else
-	static constexpr SampleFormat sample_format = SampleFormat::FLOAT;
 	typedef float in_sample_t;
 	typedef float out_sample_t;
+
+	/**
+	 * The format which is passed to decoder_data().  libvorbis
+	 * produces float, but if the outputs want an integer format,
+	 * it is converted while interleaving, which saves a pass in
+	 * #PcmConvert.  See decoder_preferred_format().
+	 */
+	SampleFormat sample_format;
 #endif
 
 	unsigned remaining_header_packets;
@@ -147,6 +154,27 @@ VorbisDecoder::OnOggBeginning(const ogg_packet &_packet)
 	remaining_header_packets = 2;
 }
 
+#ifndef HAVE_TREMOR
+
+/**
+ * Interleave the (non-interleaved) float samples from libvorbis and
+ * convert them to the integer format #F in one pass.
+ */
+template<SampleFormat F>
+static void
+InterleaveToInteger(void *_dest, ConstBuffer<const float *> src,
+		    size_t n_frames)
+{
+	typedef FloatToIntegerSampleConvert<F> Convert;
+	auto *dest = (typename Convert::DV *)_dest;
+
+	for (size_t i = 0; i < n_frames; ++i)
+		for (const float *channel : src)
+			*dest++ = Convert::Convert(channel[i]);
+}
+
+#endif
+
 static void
 vorbis_send_comments(Decoder &decoder, InputStream &is,
 		     char **comments)
@@ -164,6 +192,20 @@ VorbisDecoder::SubmitInit()
 {
 	assert(!dsp_initialized);
 
+#ifndef HAVE_TREMOR
+	switch (decoder_preferred_format(decoder).format) {
+	case SampleFormat::S16:
+	case SampleFormat::S24_P32:
+	case SampleFormat::S32:
+		sample_format = decoder_preferred_format(decoder).format;
+		break;
+
+	default:
+		sample_format = SampleFormat::FLOAT;
+		break;
+	}
+#endif
+
 	Error error;
 	if (!audio_format_init_checked(audio_format, vi.rate, sample_format,
 				       vi.channels, error))
@@ -189,9 +231,15 @@ VorbisDecoder::SubmitSomePcm()
 	if (result <= 0)
 		return false;
 
+#ifdef HAVE_TREMOR
 	out_sample_t buffer[4096];
+#else
+	/* room for 4096 samples in any of the supported formats,
+	   none of which is larger than a float */
+	alignas(float) uint8_t buffer[4096 * sizeof(out_sample_t)];
+#endif
 	const unsigned channels = audio_format.channels;
-	size_t max_frames = ARRAY_SIZE(buffer) / channels;
+	size_t max_frames = 4096 / channels;
 	size_t n_frames = std::min(size_t(result), max_frames);
 
 #ifdef HAVE_TREMOR
@@ -205,10 +253,26 @@ VorbisDecoder::SubmitSomePcm()
 		}
 	}
 #else
-	PcmInterleaveFloat(buffer,
-			   ConstBuffer<const in_sample_t *>(pcm,
-							    channels),
-			   n_frames);
+	const ConstBuffer<const in_sample_t *> src(pcm, channels);
+
+	switch (sample_format) {
+	case SampleFormat::S16:
+		InterleaveToInteger<SampleFormat::S16>(buffer, src, n_frames);
+		break;
+
+	case SampleFormat::S24_P32:
+		InterleaveToInteger<SampleFormat::S24_P32>(buffer, src,
+							   n_frames);
+		break;
+
+	case SampleFormat::S32:
+		InterleaveToInteger<SampleFormat::S32>(buffer, src, n_frames);
+		break;
+
+	default:
+		PcmInterleaveFloat((float *)buffer, src, n_frames);
+		break;
+	}
 #endif
 
 	vorbis_synthesis_read(&dsp, n_frames);
@@ -0,0 +1,566 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "SharedEncoder.hxx"
+#include "EncoderInterface.hxx"
+#include "EncoderPlugin.hxx"
+#include "AudioFormat.hxx"
+#include "config/Block.hxx"
+#include "config/ConfigError.hxx"
+#include "thread/Mutex.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+#include "Compiler.h"
+
+#include <algorithm>
+#include <deque>
+#include <list>
+#include <string>
+#include <vector>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Encoded data which has been read by all outputs is discarded;
+ * beyond this limit, the slowest outputs lose data.
+ */
+static constexpr size_t SHARED_ENCODER_MAX_BUFFER = 1024 * 1024;
+
+static constexpr Domain shared_encoder_domain("shared_encoder");
+
+class SharedEncoderTap;
+
+/**
+ * One #Encoder instance shared by all outputs of a group which use
+ * the same audio format.  Protected by the group's mutex.
+ */
+struct SharedEncoderStream {
+	/**
+	 * The audio format requested by the outputs.
+	 */
+	const AudioFormat requested_format;
+
+	/**
+	 * The audio format accepted by the encoder.
+	 */
+	const AudioFormat format;
+
+	Encoder *const encoder;
+
+	/**
+	 * The output whose data is fed into the encoder; the others
+	 * only read the result.  nullptr after the leader has been
+	 * closed; then the next one to call Write() takes over.
+	 */
+	SharedEncoderTap *leader = nullptr;
+
+	std::list<SharedEncoderTap *> taps;
+
+	/**
+	 * Encoded data which has not yet been read by all taps.
+	 * Its first byte is at stream offset #base.
+	 */
+	std::vector<uint8_t> buffer;
+	uint64_t base = 0;
+
+	/**
+	 * The most recent header, i.e. the output right after
+	 * opening the encoder or after SendTag().  New taps read this
+	 * first.
+	 */
+	std::vector<uint8_t> header;
+
+	struct TagMark {
+		/**
+		 * The number of SendTag() calls including this one.
+		 */
+		unsigned serial;
+
+		/**
+		 * The stream offset of the header generated by this
+		 * SendTag() call.
+		 */
+		uint64_t offset;
+	};
+
+	/**
+	 * Where the leader has called SendTag(), oldest first.
+	 */
+	std::deque<TagMark> tags;
+
+	/**
+	 * The number of SendTag() calls by leaders.
+	 */
+	unsigned n_tags = 0;
+
+	SharedEncoderStream(AudioFormat _requested_format,
+			    AudioFormat _format, Encoder *_encoder)
+		:requested_format(_requested_format), format(_format),
+		 encoder(_encoder) {}
+
+	~SharedEncoderStream() {
+		assert(taps.empty());
+
+		delete encoder;
+	}
+
+	uint64_t GetEnd() const {
+		return base + buffer.size();
+	}
+
+	/**
+	 * Read all available data from the encoder into #buffer.
+	 */
+	void Drain();
+
+	/**
+	 * Discard data which is no longer needed.
+	 */
+	void Trim();
+
+	/**
+	 * Returns the stream offset of the first header which the
+	 * given tap must not read before calling SendTag() itself, or
+	 * GetEnd().
+	 */
+	gcc_pure
+	uint64_t GetReadLimit(unsigned tap_tags) const;
+};
+
+class SharedEncoderGroup {
+public:
+	const std::string name;
+
+	const EncoderPlugin &plugin;
+
+	/**
+	 * The number of #SharedPreparedEncoder instances.  Protected
+	 * by #shared_encoder_mutex.
+	 */
+	unsigned refs = 0;
+
+	/**
+	 * Protects #streams and everything inside.
+	 */
+	Mutex mutex;
+
+	std::list<SharedEncoderStream> streams;
+
+	SharedEncoderGroup(const char *_name, const EncoderPlugin &_plugin)
+		:name(_name), plugin(_plugin) {}
+};
+
+static Mutex shared_encoder_mutex;
+static std::list<SharedEncoderGroup> shared_encoder_groups;
+
+/**
+ * The #Encoder returned to each output of a group.  It forwards to
+ * the stream's #Encoder only if it is the leader, and reads the
+ * encoded data from the stream's buffer.
+ */
+class SharedEncoderTap final : public Encoder {
+	friend struct SharedEncoderStream;
+
+	SharedEncoderGroup &group;
+	SharedEncoderStream &stream;
+
+	/**
+	 * The stream offset of the next byte to be read.
+	 */
+	uint64_t position;
+
+	/**
+	 * A copy of the stream header which is read before
+	 * #position; used when joining a running stream.
+	 */
+	std::vector<uint8_t> header;
+	size_t header_position = 0;
+
+	/**
+	 * The number of stream tags this tap has passed.
+	 */
+	unsigned n_tags;
+
+public:
+	SharedEncoderTap(SharedEncoderGroup &_group,
+			 SharedEncoderStream &_stream)
+		:Encoder(_stream.encoder->ImplementsTag()),
+		 group(_group), stream(_stream),
+		 position(stream.GetEnd()),
+		 n_tags(stream.n_tags) {
+		if (stream.taps.empty()) {
+			/* the first one reads the header from the
+			   buffer */
+			position = stream.base;
+			stream.leader = this;
+		} else
+			header = stream.header;
+
+		stream.taps.push_back(this);
+	}
+
+	~SharedEncoderTap() override;
+
+	/* virtual methods from class Encoder */
+	bool End(Error &error) override;
+	bool Flush(Error &error) override;
+	bool PreTag(Error &error) override;
+	bool SendTag(const Tag &tag, Error &error) override;
+	bool Write(const void *data, size_t length, Error &error) override;
+	size_t Read(void *dest, size_t length) override;
+
+private:
+	bool IsLeader() const {
+		return stream.leader == this;
+	}
+};
+
+class SharedPreparedEncoder final : public PreparedEncoder {
+	SharedEncoderGroup &group;
+
+	/**
+	 * This output's own encoder; it is used to open the shared
+	 * #Encoder if there is none for the audio format yet.
+	 */
+	PreparedEncoder *const prepared;
+
+public:
+	SharedPreparedEncoder(SharedEncoderGroup &_group,
+			      PreparedEncoder *_prepared)
+		:group(_group), prepared(_prepared) {}
+
+	~SharedPreparedEncoder() override;
+
+	/* virtual methods from class PreparedEncoder */
+	Encoder *Open(AudioFormat &audio_format, Error &error) override;
+
+	const char *GetMimeType() const override {
+		return prepared->GetMimeType();
+	}
+};
+
+void
+SharedEncoderStream::Drain()
+{
+	while (true) {
+		const size_t old_size = buffer.size();
+		buffer.resize(old_size + 16384);
+
+		const size_t nbytes = encoder->Read(buffer.data() + old_size,
+						    16384);
+		buffer.resize(old_size + nbytes);
+		if (nbytes == 0)
+			break;
+	}
+
+	Trim();
+}
+
+void
+SharedEncoderStream::Trim()
+{
+	if (taps.empty())
+		/* keep the header for the first tap */
+		return;
+
+	uint64_t min_position = GetEnd();
+	for (const auto *tap : taps)
+		min_position = std::min(min_position, tap->position);
+
+	if (GetEnd() - min_position > SHARED_ENCODER_MAX_BUFFER)
+		/* the slowest outputs lose data */
+		min_position = GetEnd() - SHARED_ENCODER_MAX_BUFFER;
+
+	if (min_position == base)
+		return;
+
+	buffer.erase(buffer.begin(), buffer.begin() + (min_position - base));
+	base = min_position;
+
+	while (!tags.empty() && tags.front().offset < base)
+		tags.pop_front();
+}
+
+uint64_t
+SharedEncoderStream::GetReadLimit(unsigned tap_tags) const
+{
+	for (const auto &mark : tags)
+		if (mark.serial > tap_tags)
+			return mark.offset;
+
+	return GetEnd();
+}
+
+SharedEncoderTap::~SharedEncoderTap()
+{
+	const ScopeLock protect(group.mutex);
+
+	stream.taps.remove(this);
+	if (IsLeader())
+		stream.leader = nullptr;
+
+	if (stream.taps.empty()) {
+		auto i = std::find_if(group.streams.begin(),
+				      group.streams.end(),
+				      [this](const SharedEncoderStream &s){
+					      return &s == &stream;
+				      });
+		assert(i != group.streams.end());
+		group.streams.erase(i);
+	} else
+		stream.Trim();
+}
+
+bool
+SharedEncoderTap::End(Error &error)
+{
+	const ScopeLock protect(group.mutex);
+
+	/* only the last output ends the stream */
+	if (stream.taps.size() > 1)
+		return true;
+
+	if (!stream.encoder->End(error))
+		return false;
+
+	stream.Drain();
+	return true;
+}
+
+bool
+SharedEncoderTap::Flush(Error &error)
+{
+	const ScopeLock protect(group.mutex);
+
+	if (!IsLeader())
+		return true;
+
+	if (!stream.encoder->Flush(error))
+		return false;
+
+	stream.Drain();
+	return true;
+}
+
+bool
+SharedEncoderTap::PreTag(Error &error)
+{
+	const ScopeLock protect(group.mutex);
+
+	if (!IsLeader())
+		return true;
+
+	if (!stream.encoder->PreTag(error))
+		return false;
+
+	stream.Drain();
+	return true;
+}
+
+bool
+SharedEncoderTap::SendTag(const Tag &tag, Error &error)
+{
+	const ScopeLock protect(group.mutex);
+
+	if (!IsLeader()) {
+		/* the leader generates the new header; skip to it if
+		   it has already done so, or else read on until it
+		   appears in the stream */
+		++n_tags;
+
+		for (const auto &mark : stream.tags) {
+			if (mark.serial == n_tags) {
+				position = std::max(position, mark.offset);
+				break;
+			}
+		}
+
+		return true;
+	}
+
+	if (!stream.encoder->SendTag(tag, error))
+		return false;
+
+	const uint64_t offset = stream.GetEnd();
+	n_tags = ++stream.n_tags;
+	stream.tags.push_back({n_tags, offset});
+
+	stream.Drain();
+
+	if (offset >= stream.base)
+		stream.header.assign(stream.buffer.begin() + (offset - stream.base),
+				     stream.buffer.end());
+
+	return true;
+}
+
+bool
+SharedEncoderTap::Write(const void *data, size_t length, Error &error)
+{
+	const ScopeLock protect(group.mutex);
+
+	if (stream.leader == nullptr)
+		/* the previous leader has been closed; take over */
+		stream.leader = this;
+
+	if (!IsLeader())
+		/* this data has been (or will be) encoded by the
+		   leader */
+		return true;
+
+	if (!stream.encoder->Write(data, length, error))
+		return false;
+
+	stream.Drain();
+	return true;
+}
+
+size_t
+SharedEncoderTap::Read(void *_dest, size_t length)
+{
+	uint8_t *dest = (uint8_t *)_dest;
+
+	const ScopeLock protect(group.mutex);
+
+	if (header_position < header.size()) {
+		size_t nbytes = std::min(length,
+					 header.size() - header_position);
+		memcpy(dest, header.data() + header_position, nbytes);
+		header_position += nbytes;
+		return nbytes;
+	}
+
+	if (position < stream.base)
+		/* this output was too slow */
+		position = stream.base;
+
+	const uint64_t limit = stream.GetReadLimit(n_tags);
+	if (position >= limit)
+		return 0;
+
+	size_t nbytes = std::min<uint64_t>(length, limit - position);
+	memcpy(dest, stream.buffer.data() + (position - stream.base), nbytes);
+	position += nbytes;
+	return nbytes;
+}
+
+static void
+shared_encoder_group_unref(SharedEncoderGroup &group)
+{
+	const ScopeLock protect(shared_encoder_mutex);
+
+	assert(group.refs > 0);
+	if (--group.refs > 0)
+		return;
+
+	auto i = std::find_if(shared_encoder_groups.begin(),
+			      shared_encoder_groups.end(),
+			      [&group](const SharedEncoderGroup &g){
+				      return &g == &group;
+			      });
+	assert(i != shared_encoder_groups.end());
+	shared_encoder_groups.erase(i);
+}
+
+SharedPreparedEncoder::~SharedPreparedEncoder()
+{
+	delete prepared;
+
+	shared_encoder_group_unref(group);
+}
+
+Encoder *
+SharedPreparedEncoder::Open(AudioFormat &audio_format, Error &error)
+{
+	const ScopeLock protect(group.mutex);
+
+	for (auto &stream : group.streams) {
+		if (stream.requested_format == audio_format) {
+			audio_format = stream.format;
+			return new SharedEncoderTap(group, stream);
+		}
+	}
+
+	const AudioFormat requested_format = audio_format;
+	Encoder *encoder = prepared->Open(audio_format, error);
+	if (encoder == nullptr)
+		return nullptr;
+
+	struct audio_format_string af_string;
+	FormatDebug(shared_encoder_domain,
+		    "encoder group \"%s\": new stream for %s",
+		    group.name.c_str(),
+		    audio_format_to_string(requested_format, &af_string));
+
+	group.streams.emplace_back(requested_format, audio_format, encoder);
+	auto &stream = group.streams.back();
+
+	/* remember the header for outputs which are opened later */
+	stream.Drain();
+	stream.header = stream.buffer;
+
+	return new SharedEncoderTap(group, stream);
+}
+
+PreparedEncoder *
+encoder_init_shared(const EncoderPlugin &plugin, const ConfigBlock &block,
+		    Error &error)
+{
+	const char *name = block.GetBlockValue("encoder_group");
+	if (name == nullptr)
+		return encoder_init(plugin, block, error);
+
+	SharedEncoderGroup *group = nullptr;
+
+	{
+		const ScopeLock protect(shared_encoder_mutex);
+
+		for (auto &i : shared_encoder_groups) {
+			if (i.name == name) {
+				group = &i;
+				break;
+			}
+		}
+
+		if (group == nullptr) {
+			shared_encoder_groups.emplace_back(name, plugin);
+			group = &shared_encoder_groups.back();
+		} else if (&group->plugin != &plugin) {
+			error.Format(config_domain,
+				     "Encoder group \"%s\" uses the encoder \"%s\"",
+				     name, group->plugin.name);
+			return nullptr;
+		}
+
+		++group->refs;
+	}
+
+	PreparedEncoder *prepared = encoder_init(plugin, block, error);
+	if (prepared == nullptr) {
+		shared_encoder_group_unref(*group);
+		return nullptr;
+	}
+
+	return new SharedPreparedEncoder(*group, prepared);
+}
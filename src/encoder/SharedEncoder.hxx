@@ -0,0 +1,44 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_SHARED_ENCODER_HXX
+#define MPD_SHARED_ENCODER_HXX
+
+#include "check.h"
+
+struct EncoderPlugin;
+struct ConfigBlock;
+class PreparedEncoder;
+class Error;
+
+/**
+ * Like encoder_init(), but if the block has an "encoder_group"
+ * setting, all outputs with the same group name share their
+ * #Encoder instances: the data is encoded only once per audio
+ * format, and each output reads a copy of the result.  All outputs
+ * of a group must use the same encoder settings.
+ *
+ * @return an encoder object on success, nullptr on failure
+ */
+PreparedEncoder *
+encoder_init_shared(const EncoderPlugin &plugin, const ConfigBlock &block,
+		    Error &error);
+
+#endif
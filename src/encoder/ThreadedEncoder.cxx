@@ -0,0 +1,424 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "ThreadedEncoder.hxx"
+#include "EncoderInterface.hxx"
+#include "config/Block.hxx"
+#include "config/ConfigError.hxx"
+#include "tag/Tag.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "util/Error.hxx"
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+
+static constexpr size_t DEFAULT_ENCODER_QUEUE_SIZE = 512 * 1024;
+
+/**
+ * The #Encoder returned by #ThreadedPreparedEncoder.  All calls to
+ * the wrapped #Encoder (including Read()) happen in the worker
+ * thread.
+ */
+class ThreadedEncoder final : public Encoder {
+	struct Command {
+		enum class Type {
+			WRITE,
+			FLUSH,
+			PRE_TAG,
+			SEND_TAG,
+			END,
+		} type;
+
+		std::vector<uint8_t> data;
+
+		std::unique_ptr<Tag> tag;
+
+		explicit Command(Type _type):type(_type) {}
+	};
+
+	Encoder *const encoder;
+
+	const size_t queue_size;
+
+	Thread thread;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled by the worker thread after it has finished a
+	 * command, and by the caller when it has submitted a command
+	 * or when the thread shall quit.
+	 */
+	Cond cond;
+
+	std::deque<Command> queue;
+
+	/**
+	 * The number of PCM bytes in #queue.
+	 */
+	size_t queued_bytes = 0;
+
+	/**
+	 * The number of commands submitted and finished.  Used to
+	 * wait for synchronous commands.
+	 */
+	uint64_t submitted = 0, finished = 0;
+
+	/**
+	 * Encoded data which has not been read yet, starting at
+	 * #output_position.
+	 */
+	std::vector<uint8_t> output;
+	size_t output_position = 0;
+
+	/**
+	 * An error from the wrapped #Encoder, to be returned to the
+	 * caller.  After that, the worker thread discards all
+	 * commands.
+	 */
+	Error error;
+
+	bool quit = false;
+
+public:
+	ThreadedEncoder(Encoder *_encoder, size_t _queue_size)
+		:Encoder(_encoder->ImplementsTag()),
+		 encoder(_encoder), queue_size(_queue_size) {}
+
+	~ThreadedEncoder() override;
+
+	/**
+	 * Move the header which was generated by opening the encoder
+	 * to #output.  Must be called before Start().
+	 */
+	void ReadHeader() {
+		std::vector<uint8_t> result;
+		CollectOutput(result);
+		output = std::move(result);
+	}
+
+	bool Start(Error &error_r) {
+		return thread.Start(ThreadFunc, this, error_r);
+	}
+
+	/* virtual methods from class Encoder */
+	bool End(Error &error_r) override {
+		return Submit(Command(Command::Type::END), true, error_r);
+	}
+
+	bool Flush(Error &error_r) override {
+		return Submit(Command(Command::Type::FLUSH), false, error_r);
+	}
+
+	bool PreTag(Error &error_r) override {
+		return Submit(Command(Command::Type::PRE_TAG), true, error_r);
+	}
+
+	bool SendTag(const Tag &tag, Error &error_r) override {
+		Command c(Command::Type::SEND_TAG);
+		c.tag.reset(new Tag(tag));
+		return Submit(std::move(c), true, error_r);
+	}
+
+	bool Write(const void *data, size_t length, Error &error_r) override;
+	size_t Read(void *dest, size_t length) override;
+
+private:
+	/**
+	 * Append a command to the queue.
+	 *
+	 * @param wait wait until the worker thread has finished the
+	 * command
+	 */
+	bool Submit(Command &&c, bool wait, Error &error_r);
+
+	bool CheckError(Error &error_r) const {
+		if (!error.IsDefined())
+			return true;
+
+		error_r.Set(error);
+		return false;
+	}
+
+	/**
+	 * Read everything the wrapped encoder has to offer.
+	 */
+	void CollectOutput(std::vector<uint8_t> &dest);
+
+	/**
+	 * Execute a command in the worker thread and collect the
+	 * encoder's output.  The mutex must not be locked.
+	 */
+	bool Execute(const Command &c, std::vector<uint8_t> &dest,
+		     Error &error_r);
+
+	void Run();
+	static void ThreadFunc(void *ctx);
+};
+
+class ThreadedPreparedEncoder final : public PreparedEncoder {
+	PreparedEncoder *const prepared;
+
+	const size_t queue_size;
+
+public:
+	ThreadedPreparedEncoder(PreparedEncoder *_prepared,
+				size_t _queue_size)
+		:prepared(_prepared), queue_size(_queue_size) {}
+
+	~ThreadedPreparedEncoder() override {
+		delete prepared;
+	}
+
+	/* virtual methods from class PreparedEncoder */
+	Encoder *Open(AudioFormat &audio_format, Error &error) override;
+
+	const char *GetMimeType() const override {
+		return prepared->GetMimeType();
+	}
+};
+
+ThreadedEncoder::~ThreadedEncoder()
+{
+	if (thread.IsDefined()) {
+		mutex.lock();
+		quit = true;
+		cond.broadcast();
+		mutex.unlock();
+
+		thread.Join();
+	}
+
+	delete encoder;
+}
+
+bool
+ThreadedEncoder::Submit(Command &&c, bool wait, Error &error_r)
+{
+	const ScopeLock protect(mutex);
+
+	if (!CheckError(error_r))
+		return false;
+
+	queue.emplace_back(std::move(c));
+	const uint64_t serial = ++submitted;
+	cond.broadcast();
+
+	if (wait) {
+		while (finished < serial && !error.IsDefined())
+			cond.wait(mutex);
+
+		if (!CheckError(error_r))
+			return false;
+	}
+
+	return true;
+}
+
+bool
+ThreadedEncoder::Write(const void *data, size_t length, Error &error_r)
+{
+	Command c(Command::Type::WRITE);
+	c.data.assign((const uint8_t *)data, (const uint8_t *)data + length);
+
+	const ScopeLock protect(mutex);
+
+	/* block while the queue is full; a single write larger than
+	   the queue is accepted if the queue is empty */
+	while (queued_bytes > 0 && queued_bytes + length > queue_size &&
+	       !error.IsDefined())
+		cond.wait(mutex);
+
+	if (!CheckError(error_r))
+		return false;
+
+	queued_bytes += length;
+	queue.emplace_back(std::move(c));
+	++submitted;
+	cond.broadcast();
+	return true;
+}
+
+size_t
+ThreadedEncoder::Read(void *dest, size_t length)
+{
+	const ScopeLock protect(mutex);
+
+	const size_t nbytes = std::min(length,
+				       output.size() - output_position);
+	memcpy(dest, output.data() + output_position, nbytes);
+	output_position += nbytes;
+
+	if (output_position == output.size()) {
+		output.clear();
+		output_position = 0;
+	}
+
+	return nbytes;
+}
+
+void
+ThreadedEncoder::CollectOutput(std::vector<uint8_t> &dest)
+{
+	while (true) {
+		uint8_t buffer[16384];
+		const size_t nbytes = encoder->Read(buffer, sizeof(buffer));
+		if (nbytes == 0)
+			break;
+
+		dest.insert(dest.end(), buffer, buffer + nbytes);
+	}
+}
+
+bool
+ThreadedEncoder::Execute(const Command &c, std::vector<uint8_t> &dest,
+			 Error &error_r)
+{
+	bool success = true;
+	switch (c.type) {
+	case Command::Type::WRITE:
+		success = encoder->Write(c.data.data(), c.data.size(),
+					 error_r);
+		break;
+
+	case Command::Type::FLUSH:
+		success = encoder->Flush(error_r);
+		break;
+
+	case Command::Type::PRE_TAG:
+		success = encoder->PreTag(error_r);
+		break;
+
+	case Command::Type::SEND_TAG:
+		success = encoder->SendTag(*c.tag, error_r);
+		break;
+
+	case Command::Type::END:
+		success = encoder->End(error_r);
+		break;
+	}
+
+	if (!success)
+		return false;
+
+	CollectOutput(dest);
+	return true;
+}
+
+inline void
+ThreadedEncoder::Run()
+{
+	std::vector<uint8_t> result;
+
+	const ScopeLock protect(mutex);
+
+	while (!quit) {
+		if (queue.empty()) {
+			cond.wait(mutex);
+			continue;
+		}
+
+		/* the caller only appends to the queue, so the front
+		   element stays valid while the mutex is unlocked */
+		const Command &c = queue.front();
+
+		if (!error.IsDefined()) {
+			Error error2;
+			bool success;
+
+			{
+				const ScopeUnlock unlock(mutex);
+				result.clear();
+				success = Execute(c, result, error2);
+			}
+
+			if (success)
+				output.insert(output.end(),
+					      result.begin(), result.end());
+			else
+				error = std::move(error2);
+		}
+
+		queued_bytes -= c.data.size();
+		queue.pop_front();
+		++finished;
+		cond.broadcast();
+	}
+}
+
+void
+ThreadedEncoder::ThreadFunc(void *ctx)
+{
+	SetThreadName("encoder");
+
+	ThreadedEncoder &e = *(ThreadedEncoder *)ctx;
+	e.Run();
+}
+
+Encoder *
+ThreadedPreparedEncoder::Open(AudioFormat &audio_format, Error &error)
+{
+	Encoder *encoder = prepared->Open(audio_format, error);
+	if (encoder == nullptr)
+		return nullptr;
+
+	auto *e = new ThreadedEncoder(encoder, queue_size);
+
+	/* the caller expects the header to be available right
+	   away */
+	e->ReadHeader();
+
+	if (!e->Start(error)) {
+		delete e;
+		return nullptr;
+	}
+
+	return e;
+}
+
+PreparedEncoder *
+encoder_wrap_threaded(PreparedEncoder *prepared, const ConfigBlock &block,
+		      Error &error)
+{
+	if (!block.GetBlockValue("encoder_thread", false))
+		return prepared;
+
+	const size_t queue_size =
+		block.GetBlockValue("encoder_queue_size",
+				    unsigned(DEFAULT_ENCODER_QUEUE_SIZE));
+	if (queue_size == 0) {
+		delete prepared;
+		error.Set(config_domain,
+			  "encoder_queue_size must be positive");
+		return nullptr;
+	}
+
+	return new ThreadedPreparedEncoder(prepared, queue_size);
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_THREADED_ENCODER_HXX
+#define MPD_THREADED_ENCODER_HXX
+
+#include "check.h"
+
+struct ConfigBlock;
+class PreparedEncoder;
+class Error;
+
+/**
+ * If the block has the setting "encoder_thread", wrap the given
+ * #PreparedEncoder: each #Encoder it opens runs in its own thread,
+ * and Write() only copies the PCM data into a bounded queue
+ * ("encoder_queue_size", in bytes).  This way, a CPU-heavy encoder
+ * does not hold up the output thread (and with it the player's
+ * buffer) unless it is slower than real time on average.
+ *
+ * Flush() is asynchronous; End(), PreTag() and SendTag() wait until
+ * the encoder has caught up, so their results can be obtained with
+ * Read() right away.
+ *
+ * This function takes ownership of the #PreparedEncoder (also on
+ * error).
+ *
+ * @return the (wrapped) encoder object, or nullptr on error
+ */
+PreparedEncoder *
+encoder_wrap_threaded(PreparedEncoder *prepared, const ConfigBlock &block,
+		      Error &error);
+
+#endif
@@ -26,6 +26,7 @@
 #include "util/DynamicFifoBuffer.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
+#include "Log.hxx"
 
 #include <FLAC/stream_encoder.h>
 
@@ -91,6 +92,12 @@ private:
 class PreparedFlacEncoder final : public PreparedEncoder {
 	unsigned compression;
 
+	/**
+	 * The number of libFLAC worker threads which encode frames in
+	 * parallel.  1 means libFLAC encodes in the caller's thread.
+	 */
+	unsigned threads;
+
 public:
 	bool Configure(const ConfigBlock &block, Error &error);
 
@@ -105,9 +112,25 @@ public:
 static constexpr Domain flac_encoder_domain("vorbis_encoder");
 
 bool
-PreparedFlacEncoder::Configure(const ConfigBlock &block, Error &)
+PreparedFlacEncoder::Configure(const ConfigBlock &block, Error &error)
 {
 	compression = block.GetBlockValue("compression", 5u);
+
+	threads = block.GetBlockValue("threads", 1u);
+	if (threads == 0) {
+		error.Set(config_domain, "Invalid number of FLAC threads");
+		return false;
+	}
+
+#if FLAC_API_VERSION_CURRENT < 14
+	if (threads > 1) {
+		LogWarning(flac_encoder_domain,
+			   "libFLAC is too old for multithreaded encoding, "
+			   "ignoring the \"threads\" setting");
+		threads = 1;
+	}
+#endif
+
 	return true;
 }
 
@@ -128,6 +151,7 @@ flac_encoder_init(const ConfigBlock &block, Error &error)
 
 static bool
 flac_encoder_setup(FLAC__StreamEncoder *fse, unsigned compression,
+		   unsigned threads,
 		   const AudioFormat &audio_format, unsigned bits_per_sample,
 		   Error &error)
 {
@@ -160,6 +184,30 @@ flac_encoder_setup(FLAC__StreamEncoder *fse, unsigned compression,
 		return false;
 	}
 
+#if FLAC_API_VERSION_CURRENT >= 14
+	if (threads > 1) {
+		/* libFLAC encodes independent frames on a pool of
+		   worker threads and emits them in order */
+		switch (FLAC__stream_encoder_set_num_threads(fse, threads)) {
+		case FLAC__STREAM_ENCODER_SET_NUM_THREADS_OK:
+			break;
+
+		case FLAC__STREAM_ENCODER_SET_NUM_THREADS_NOT_COMPILED_WITH_MULTITHREADING_ENABLED:
+			LogWarning(flac_encoder_domain,
+				   "libFLAC was built without multithreading support");
+			break;
+
+		default:
+			error.Format(config_domain,
+				     "error setting flac threads to %u",
+				     threads);
+			return false;
+		}
+	}
+#else
+	(void)threads;
+#endif
+
 	return true;
 }
 
@@ -215,7 +263,7 @@ PreparedFlacEncoder::Open(AudioFormat &audio_format, Error &error)
 		return nullptr;
 	}
 
-	if (!flac_encoder_setup(fse, compression,
+	if (!flac_encoder_setup(fse, compression, threads,
 				audio_format, bits_per_sample, error)) {
 		FLAC__stream_encoder_delete(fse);
 		return nullptr;
@@ -57,8 +57,11 @@ public:
 		bool success = stream.PageOut(page);
 		if (!success) {
 			if (flush) {
-				flush = false;
+				/* keep flushing until the stream is
+				   empty; one flush may not fit into a
+				   single page */
 				success = stream.Flush(page);
+				flush = success;
 			}
 
 			if (!success)
@@ -30,6 +30,9 @@
 #include <opus.h>
 #include <ogg/ogg.h>
 
+#include <algorithm>
+#include <iterator>
+
 #include <assert.h>
 #include <stdlib.h>
 
@@ -52,10 +55,18 @@ class OpusEncoder final : public OggEncoder {
 
 	ogg_int64_t packetno = 0;
 
-	ogg_int64_t granulepos;
+	ogg_int64_t granulepos = 0;
+
+	/**
+	 * Flush the Ogg stream after each packet, so every packet is
+	 * available to Read() immediately instead of waiting for a
+	 * full page.
+	 */
+	const bool flush_packets;
 
 public:
-	OpusEncoder(AudioFormat &_audio_format, ::OpusEncoder *_enc);
+	OpusEncoder(AudioFormat &_audio_format, ::OpusEncoder *_enc,
+		    unsigned _buffer_frames, bool _flush_packets);
 	~OpusEncoder() override;
 
 	/* virtual methods from class Encoder */
@@ -76,6 +87,14 @@ class PreparedOpusEncoder final : public PreparedEncoder {
 	opus_int32 bitrate;
 	int complexity;
 	int signal;
+	int application;
+
+	/**
+	 * The duration of one Opus frame in units of 48 kHz samples.
+	 */
+	unsigned frame_samples;
+
+	bool flush_packets;
 
 public:
 	bool Configure(const ConfigBlock &block, Error &error);
@@ -126,6 +145,43 @@ PreparedOpusEncoder::Configure(const ConfigBlock &block, Error &error)
 		return false;
 	}
 
+	const bool low_latency = block.GetBlockValue("low_latency", false);
+	flush_packets = low_latency;
+
+	value = block.GetBlockValue("application",
+				    low_latency ? "lowdelay" : "audio");
+	if (strcmp(value, "audio") == 0)
+		application = OPUS_APPLICATION_AUDIO;
+	else if (strcmp(value, "voip") == 0)
+		application = OPUS_APPLICATION_VOIP;
+	else if (strcmp(value, "lowdelay") == 0)
+		application = OPUS_APPLICATION_RESTRICTED_LOWDELAY;
+	else {
+		error.Format(config_domain, "Invalid application");
+		return false;
+	}
+
+	/* the frame durations supported by libopus, in units of
+	   0.5 ms */
+	static constexpr unsigned valid_durations[] = {
+		5, 10, 20, 40, 80, 120,
+	};
+
+	value = block.GetBlockValue("frame_duration",
+				    low_latency ? "5" : "20");
+	char *endptr;
+	const double duration = strtod(value, &endptr);
+	const unsigned half_ms = unsigned(duration * 2);
+	if (endptr == value || *endptr != 0 || half_ms != duration * 2 ||
+	    std::find(std::begin(valid_durations), std::end(valid_durations),
+		      half_ms) == std::end(valid_durations)) {
+		error.Format(config_domain,
+			     "Invalid frame_duration: %s", value);
+		return false;
+	}
+
+	frame_samples = 48000 / 2000 * half_ms;
+
 	return true;
 }
 
@@ -144,14 +200,16 @@ opus_encoder_init(const ConfigBlock &block, Error &error)
 	return encoder;
 }
 
-OpusEncoder::OpusEncoder(AudioFormat &_audio_format, ::OpusEncoder *_enc)
+OpusEncoder::OpusEncoder(AudioFormat &_audio_format, ::OpusEncoder *_enc,
+			 unsigned _buffer_frames, bool _flush_packets)
 	:OggEncoder(false),
 	 audio_format(_audio_format),
 	 frame_size(_audio_format.GetFrameSize()),
-	 buffer_frames(_audio_format.sample_rate / 50),
+	 buffer_frames(_buffer_frames),
 	 buffer_size(frame_size * buffer_frames),
 	 buffer((unsigned char *)xalloc(buffer_size)),
-	 enc(_enc)
+	 enc(_enc),
+	 flush_packets(_flush_packets)
 {
 	opus_encoder_ctl(enc, OPUS_GET_LOOKAHEAD(&lookahead));
 }
@@ -182,7 +240,7 @@ PreparedOpusEncoder::Open(AudioFormat &audio_format, Error &error)
 	int error_code;
 	auto *enc = opus_encoder_create(audio_format.sample_rate,
 					audio_format.channels,
-					OPUS_APPLICATION_AUDIO,
+					application,
 					&error_code);
 	if (enc == nullptr) {
 		error.Set(opus_encoder_domain, error_code,
@@ -194,7 +252,8 @@ PreparedOpusEncoder::Open(AudioFormat &audio_format, Error &error)
 	opus_encoder_ctl(enc, OPUS_SET_COMPLEXITY(complexity));
 	opus_encoder_ctl(enc, OPUS_SET_SIGNAL(signal));
 
-	return new OpusEncoder(audio_format, enc);
+	return new OpusEncoder(audio_format, enc, frame_samples,
+			       flush_packets);
 }
 
 OpusEncoder::~OpusEncoder()
@@ -236,6 +295,9 @@ OpusEncoder::DoEncode(bool eos, Error &error)
 	packet.packetno = packetno++;
 	stream.PacketIn(packet);
 
+	if (flush_packets)
+		Flush();
+
 	buffer_position = 0;
 
 	return true;
@@ -22,6 +22,7 @@
 #include "OggEncoder.hxx"
 #include "lib/xiph/VorbisComment.hxx"
 #include "AudioFormat.hxx"
+#include "pcm/Interleave.hxx"
 #include "config/ConfigError.hxx"
 #include "util/StringUtil.hxx"
 #include "util/NumberParser.hxx"
@@ -277,15 +278,6 @@ VorbisEncoder::SendTag(const Tag &tag, gcc_unused Error &error)
 	return true;
 }
 
-static void
-interleaved_to_vorbis_buffer(float **dest, const float *src,
-			     unsigned num_frames, unsigned num_channels)
-{
-	for (unsigned i = 0; i < num_frames; i++)
-		for (unsigned j = 0; j < num_channels; j++)
-			dest[j][i] = *src++;
-}
-
 bool
 VorbisEncoder::Write(const void *data, size_t length, gcc_unused Error &error)
 {
@@ -293,10 +285,11 @@ VorbisEncoder::Write(const void *data, size_t length, gcc_unused Error &error)
 
 	/* this is for only 16-bit audio */
 
-	interleaved_to_vorbis_buffer(vorbis_analysis_buffer(&vd, num_frames),
-				     (const float *)data,
-				     num_frames,
-				     audio_format.channels);
+	PcmDeinterleaveFloat(ConstBuffer<float *>(vorbis_analysis_buffer(&vd,
+									 num_frames),
+						  audio_format.channels),
+			     (const float *)data,
+			     num_frames);
 
 	vorbis_analysis_wrote(&vd, num_frames);
 	BlockOut();
@@ -118,8 +118,15 @@ BufferedSocket::OnSocketReady(unsigned flags)
 	if (flags & READ) {
 		assert(!input.IsFull());
 
-		if (!ReadToBuffer() || !ResumeInput())
-			return false;
+		do {
+			if (!ReadToBuffer() || !ResumeInput())
+				return false;
+
+			/* in edge-triggered mode, there will be no new
+			   event before the socket has been drained */
+		} while (IsEdgeTriggered() && IsReady(READ) &&
+			 (GetScheduledFlags() & READ) != 0 &&
+			 !input.IsFull());
 
 		if (!input.IsFull())
 			ScheduleRead();
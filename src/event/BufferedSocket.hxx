@@ -37,8 +37,14 @@ class BufferedSocket : protected SocketMonitor {
 	StaticFifoBuffer<uint8_t, 8192> input;
 
 public:
-	BufferedSocket(int _fd, EventLoop &_loop)
+	/**
+	 * @param _edge_triggered see SocketMonitor::EnableEdgeTriggered()
+	 */
+	BufferedSocket(int _fd, EventLoop &_loop, bool _edge_triggered=false)
 		:SocketMonitor(_fd, _loop) {
+		if (_edge_triggered)
+			EnableEdgeTriggered();
+
 		ScheduleRead();
 	}
 
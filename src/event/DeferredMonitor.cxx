@@ -21,6 +21,16 @@
 #include "DeferredMonitor.hxx"
 #include "Loop.hxx"
 
+DeferredMonitor::~DeferredMonitor()
+{
+	Cancel();
+
+	if (state.load() != IDLE)
+		/* the EventLoop still has a pointer to this object;
+		   remove it before it becomes dangling */
+		loop.UnlinkDeferred(*this);
+}
+
 void
 DeferredMonitor::Cancel()
 {
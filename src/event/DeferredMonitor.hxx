@@ -22,6 +22,10 @@
 
 #include "check.h"
 
+#include <boost/intrusive/list_hook.hpp>
+
+#include <atomic>
+
 class EventLoop;
 
 /**
@@ -33,15 +37,46 @@ class DeferredMonitor {
 	EventLoop &loop;
 
 	friend class EventLoop;
-	bool pending;
+
+	enum State : unsigned {
+		/**
+		 * Not scheduled.
+		 */
+		IDLE,
+
+		/**
+		 * Scheduled, and RunDeferred() will be called.
+		 */
+		QUEUED,
+
+		/**
+		 * Still linked into the #EventLoop's queue, but
+		 * Cancel() has been called, and the #EventLoop will
+		 * skip it.
+		 */
+		CANCELLED,
+	};
+
+	std::atomic<unsigned> state;
+
+	/**
+	 * The next item in the #EventLoop's lock-free inbox.
+	 */
+	DeferredMonitor *next_deferred;
+
+	typedef boost::intrusive::list_member_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> DeferredHook;
+
+	/**
+	 * Links this object into the #EventLoop's list after it has
+	 * been removed from the inbox.
+	 */
+	DeferredHook deferred_hook;
 
 public:
 	DeferredMonitor(EventLoop &_loop)
-		:loop(_loop), pending(false) {}
+		:loop(_loop), state(IDLE) {}
 
-	~DeferredMonitor() {
-		Cancel();
-	}
+	~DeferredMonitor();
 
 	EventLoop &GetEventLoop() {
 		return loop;
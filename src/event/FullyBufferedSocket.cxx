@@ -57,7 +57,7 @@ FullyBufferedSocket::Flush()
 	if (data.IsEmpty()) {
 		IdleMonitor::Cancel();
 		CancelWrite();
-		return true;
+		return OnSocketDrained();
 	}
 
 	auto nbytes = DirectWrite(data.data, data.size);
@@ -69,6 +69,7 @@ FullyBufferedSocket::Flush()
 	if (output.IsEmpty()) {
 		IdleMonitor::Cancel();
 		CancelWrite();
+		return OnSocketDrained();
 	}
 
 	return true;
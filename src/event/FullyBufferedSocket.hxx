@@ -24,6 +24,7 @@
 #include "BufferedSocket.hxx"
 #include "IdleMonitor.hxx"
 #include "util/PeakBuffer.hxx"
+#include "Compiler.h"
 
 /**
  * A #BufferedSocket specialization that adds an output buffer.
@@ -33,8 +34,9 @@ class FullyBufferedSocket : protected BufferedSocket, private IdleMonitor {
 
 public:
 	FullyBufferedSocket(int _fd, EventLoop &_loop,
-			    size_t normal_size, size_t peak_size=0)
-		:BufferedSocket(_fd, _loop), IdleMonitor(_loop),
+			    size_t normal_size, size_t peak_size=0,
+			    bool _edge_triggered=false)
+		:BufferedSocket(_fd, _loop, _edge_triggered), IdleMonitor(_loop),
 		 output(normal_size, peak_size) {
 	}
 
@@ -61,6 +63,34 @@ protected:
 	 */
 	bool Write(const void *data, size_t length);
 
+	/**
+	 * Returns the number of bytes in the output buffer which
+	 * have not yet been sent.
+	 */
+	gcc_pure
+	size_t GetOutputSize() const {
+		return output.GetAvailable();
+	}
+
+	/**
+	 * Returns the number of bytes allocated for the output
+	 * buffer.
+	 */
+	gcc_pure
+	size_t GetOutputAllocatedSize() const {
+		return output.GetAllocatedSize();
+	}
+
+	/**
+	 * The output buffer has been sent completely.  The method may
+	 * write more data.  The default implementation does nothing.
+	 *
+	 * @return false if the socket has been closed
+	 */
+	virtual bool OnSocketDrained() {
+		return true;
+	}
+
 	virtual bool OnSocketReady(unsigned flags) override;
 	virtual void OnIdle() override;
 };
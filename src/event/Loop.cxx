@@ -25,12 +25,23 @@
 #include "SocketMonitor.hxx"
 #include "IdleMonitor.hxx"
 #include "DeferredMonitor.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
 
 #include <algorithm>
 
+#ifdef __GNUC__
+#include <cxxabi.h>
+#endif
+
+#include <stdlib.h>
+
+static constexpr Domain event_loop_domain("event_loop");
+
 EventLoop::EventLoop()
 	:SocketMonitor(*this),
-	 now_ms(::MonotonicClockMS()),
+	 now_ms(::MonotonicClockMS()), timers(now_ms),
+	 deferred_inbox(nullptr),
 	 quit(false), busy(true),
 #ifndef NDEBUG
 	 virgin(true),
@@ -44,13 +55,66 @@ EventLoop::EventLoop()
 EventLoop::~EventLoop()
 {
 	assert(idle.empty());
-	assert(timers.empty());
+	assert(timers.IsEmpty());
 
 	/* this is necessary to get a well-defined destruction
 	   order */
 	SocketMonitor::Cancel();
 }
 
+void
+EventLoop::EnableStallDetector(const char *name, unsigned threshold_ms)
+{
+	assert(virgin);
+
+	stats.reset(new EventLoopStats(name, threshold_ms * uint64_t(1000)));
+}
+
+void
+EventLoop::OnStall(const std::type_info &type, uint64_t duration_us)
+{
+	++stats->stalls;
+
+	const char *type_name = type.name();
+#ifdef __GNUC__
+	int status;
+	char *demangled = abi::__cxa_demangle(type_name, nullptr, nullptr,
+					      &status);
+	if (demangled != nullptr)
+		type_name = demangled;
+#endif
+
+	FormatWarning(event_loop_domain,
+		      "%s: %s has blocked the event loop for %llu ms",
+		      stats->name, type_name,
+		      (unsigned long long)(duration_us / 1000));
+
+#ifdef __GNUC__
+	free(demangled);
+#endif
+}
+
+template<typename M, typename F>
+inline void
+EventLoop::Dispatch(M &m, F &&f)
+{
+	if (stats == nullptr) {
+		f();
+		return;
+	}
+
+	/* determine the type now, because the handler may destroy
+	   the object */
+	const std::type_info &type = typeid(m);
+
+	const uint64_t start = ::MonotonicClockUS();
+	f();
+	const uint64_t duration = ::MonotonicClockUS() - start;
+
+	if (duration > stats->threshold_us)
+		OnStall(type, duration);
+}
+
 void
 EventLoop::Break()
 {
@@ -97,6 +161,23 @@ EventLoop::RemoveIdle(IdleMonitor &i)
 	idle.erase(it);
 }
 
+/**
+ * Delay the due time of a timer by up to #slack_ms milliseconds so it
+ * is aligned to a multiple of the largest power of two not larger
+ * than the slack.  Timers with similar slack values then fire in
+ * the same millisecond, i.e. with one wakeup.
+ */
+gcc_const
+static unsigned
+CoalesceDue(unsigned due_ms, unsigned slack_ms)
+{
+	if (slack_ms < 2)
+		return due_ms;
+
+	const unsigned granularity = 1u << (31 - __builtin_clz(slack_ms));
+	return (due_ms + slack_ms) & ~(granularity - 1);
+}
+
 void
 EventLoop::AddTimer(TimeoutMonitor &t, unsigned ms)
 {
@@ -104,7 +185,8 @@ EventLoop::AddTimer(TimeoutMonitor &t, unsigned ms)
 	   modifies the timeout during avahi_client_free() */
 	assert(IsInsideOrNull());
 
-	timers.insert(TimerRecord(t, now_ms + ms));
+	timers.Add(t, CoalesceDue(now_ms + ms,
+				  std::min(t.slack_ms, ms / 4)));
 	again = true;
 }
 
@@ -113,12 +195,7 @@ EventLoop::CancelTimer(TimeoutMonitor &t)
 {
 	assert(IsInsideOrNull());
 
-	for (auto i = timers.begin(), end = timers.end(); i != end; ++i) {
-		if (&i->timer == &t) {
-			timers.erase(i);
-			return;
-		}
-	}
+	timers.Remove(t);
 }
 
 void
@@ -136,39 +213,34 @@ EventLoop::Run()
 	assert(!quit);
 	assert(busy);
 
+	uint64_t iteration_start = stats != nullptr
+		? ::MonotonicClockUS()
+		: 0;
+
 	do {
 		now_ms = ::MonotonicClockMS();
 		again = false;
 
 		/* invoke timers */
 
-		int timeout_ms;
-		while (true) {
-			auto i = timers.begin();
-			if (i == timers.end()) {
-				timeout_ms = -1;
-				break;
-			}
-
-			timeout_ms = i->due_ms - now_ms;
-			if (timeout_ms > 0)
-				break;
-
-			TimeoutMonitor &m = i->timer;
-			timers.erase(i);
+		timers.Advance(now_ms);
 
-			m.Run();
+		TimeoutMonitor *t;
+		while ((t = timers.PopReady()) != nullptr) {
+			Dispatch(*t, [t](){ t->Run(); });
 
 			if (quit)
 				return;
 		}
 
+		const int timeout_ms = timers.GetTimeout(now_ms);
+
 		/* invoke idle */
 
 		while (!idle.empty()) {
 			IdleMonitor &m = *idle.front();
 			idle.pop_front();
-			m.Run();
+			Dispatch(m, [&m](){ m.Run(); });
 
 			if (quit)
 				return;
@@ -178,25 +250,36 @@ EventLoop::Run()
 		   overhead */
 		mutex.lock();
 		HandleDeferred();
-		busy = false;
-		const bool _again = again;
 		mutex.unlock();
 
-		if (_again)
+		busy = false;
+
+		if (again)
 			/* re-evaluate timers because one of the
 			   IdleMonitors may have added a new
 			   timeout */
 			continue;
 
+		if (deferred_inbox.load() != nullptr) {
+			/* AddDeferred() has seen #busy set and did
+			   not wake us up */
+			busy = true;
+			continue;
+		}
+
 		/* wait for new event */
 
+		if (stats != nullptr)
+			stats->iterations.Add(::MonotonicClockUS() -
+					      iteration_start);
+
 		poll_group.ReadEvents(poll_result, timeout_ms);
 
 		now_ms = ::MonotonicClockMS();
+		if (stats != nullptr)
+			iteration_start = ::MonotonicClockUS();
 
-		mutex.lock();
 		busy = true;
-		mutex.unlock();
 
 		/* invoke sockets */
 		for (int i = 0; i < poll_result.GetSize(); ++i) {
@@ -206,7 +289,15 @@ EventLoop::Run()
 					break;
 
 				auto m = (SocketMonitor *)poll_result.GetObject(i);
-				m->Dispatch(events);
+				if (m == this)
+					/* the DeferredMonitors invoked
+					   by OnSocketReady() are
+					   measured individually */
+					m->Dispatch(events);
+				else
+					Dispatch(*m, [m, events](){
+							m->Dispatch(events);
+						});
 			}
 		}
 
@@ -224,59 +315,91 @@ EventLoop::Run()
 void
 EventLoop::AddDeferred(DeferredMonitor &d)
 {
-	mutex.lock();
-	if (d.pending) {
-		mutex.unlock();
-		return;
-	}
+	unsigned state = d.state.load();
+	do {
+		if (state == DeferredMonitor::QUEUED)
+			/* already scheduled */
+			return;
+	} while (!d.state.compare_exchange_weak(state,
+						DeferredMonitor::QUEUED));
 
-	assert(std::find(deferred.begin(),
-			 deferred.end(), &d) == deferred.end());
+	if (state == DeferredMonitor::CANCELLED)
+		/* it was cancelled, but it's still in the queue:
+		   un-cancelling it is enough */
+		return;
 
-	/* we don't need to wake up the EventLoop if another
-	   DeferredMonitor has already done it */
-	const bool must_wake = !busy && deferred.empty();
+	assert(state == DeferredMonitor::IDLE);
 
-	d.pending = true;
-	deferred.push_back(&d);
-	again = true;
-	mutex.unlock();
+	DeferredMonitor *head = deferred_inbox.load(std::memory_order_relaxed);
+	do {
+		d.next_deferred = head;
+	} while (!deferred_inbox.compare_exchange_weak(head, &d));
 
-	if (must_wake)
+	/* only the first item of a batch needs to wake up the
+	   EventLoop, and only if it's not already busy; Run() checks
+	   #deferred_inbox again after clearing #busy */
+	if (head == nullptr && !busy.load())
 		wake_fd.Write();
 }
 
 void
 EventLoop::RemoveDeferred(DeferredMonitor &d)
+{
+	unsigned state = DeferredMonitor::QUEUED;
+	d.state.compare_exchange_strong(state, DeferredMonitor::CANCELLED);
+}
+
+void
+EventLoop::UnlinkDeferred(DeferredMonitor &d)
 {
 	const ScopeLock protect(mutex);
 
-	if (!d.pending) {
-		assert(std::find(deferred.begin(),
-				 deferred.end(), &d) == deferred.end());
-		return;
-	}
+	/* after this, the object is either in #deferred or it has
+	   already been removed by HandleDeferred() */
+	CollectDeferred();
 
-	d.pending = false;
+	if (d.state.load() != DeferredMonitor::IDLE) {
+		deferred.erase(deferred.iterator_to(d));
+		d.state = DeferredMonitor::IDLE;
+	}
+}
 
-	auto i = std::find(deferred.begin(), deferred.end(), &d);
-	assert(i != deferred.end());
+void
+EventLoop::CollectDeferred()
+{
+	DeferredMonitor *head = deferred_inbox.exchange(nullptr);
+	if (head == nullptr)
+		return;
 
-	deferred.erase(i);
+	/* the inbox is a stack; reverse it to restore the order of
+	   the Schedule() calls */
+	auto position = deferred.end();
+	do {
+		position = deferred.insert(position, *head);
+		head = head->next_deferred;
+	} while (head != nullptr);
 }
 
 void
 EventLoop::HandleDeferred()
 {
-	while (!deferred.empty() && !quit) {
-		DeferredMonitor &m = *deferred.front();
-		assert(m.pending);
+	while (!quit) {
+		if (deferred.empty()) {
+			CollectDeferred();
+			if (deferred.empty())
+				break;
+		}
 
+		DeferredMonitor &m = deferred.front();
 		deferred.pop_front();
-		m.pending = false;
+
+		if (m.state.exchange(DeferredMonitor::IDLE) !=
+		    DeferredMonitor::QUEUED)
+			/* cancelled */
+			continue;
 
 		mutex.unlock();
-		m.RunDeferred();
+		Dispatch(m, [&m](){ m.RunDeferred(); });
 		mutex.lock();
 	}
 }
@@ -28,13 +28,52 @@
 #include "thread/Mutex.hxx"
 #include "WakeFD.hxx"
 #include "SocketMonitor.hxx"
+#include "DeferredMonitor.hxx"
+#include "TimerWheel.hxx"
+#include "util/LatencyHistogram.hxx"
 
+#include <boost/intrusive/list.hpp>
+
+#include <atomic>
 #include <list>
-#include <set>
+#include <memory>
+#include <typeinfo>
 
 class TimeoutMonitor;
 class IdleMonitor;
-class DeferredMonitor;
+
+/**
+ * Statistics collected by an #EventLoop after
+ * EventLoop::EnableStallDetector() has been called.  They may be
+ * read from any thread.
+ */
+struct EventLoopStats {
+	/**
+	 * A name for log messages, e.g. "main" or "io".
+	 */
+	const char *const name;
+
+	/**
+	 * A handler which runs longer than this (in microseconds)
+	 * is logged and counted in #stalls.
+	 */
+	const uint64_t threshold_us;
+
+	/**
+	 * The duration of each iteration of EventLoop::Run() in
+	 * microseconds, i.e. the time between waking up and going to
+	 * sleep again.
+	 */
+	LatencyHistogram iterations;
+
+	/**
+	 * The number of handlers which have exceeded #threshold_us.
+	 */
+	std::atomic<uint64_t> stalls;
+
+	EventLoopStats(const char *_name, uint64_t _threshold_us)
+		:name(_name), threshold_us(_threshold_us), stalls(0) {}
+};
 
 #include <assert.h>
 
@@ -49,37 +88,39 @@ class DeferredMonitor;
  */
 class EventLoop final : SocketMonitor
 {
-	struct TimerRecord {
-		/**
-		 * Projected monotonic_clock_ms() value when this
-		 * timer is due.
-		 */
-		const unsigned due_ms;
-
-		TimeoutMonitor &timer;
-
-		constexpr TimerRecord(TimeoutMonitor &_timer,
-				      unsigned _due_ms)
-			:due_ms(_due_ms), timer(_timer) {}
-
-		bool operator<(const TimerRecord &other) const {
-			return due_ms < other.due_ms;
-		}
+	WakeFD wake_fd;
 
-		bool IsDue(unsigned _now_ms) const {
-			return _now_ms >= due_ms;
-		}
-	};
+	unsigned now_ms;
 
-	WakeFD wake_fd;
+	TimerWheel timers;
 
-	std::multiset<TimerRecord> timers;
 	std::list<IdleMonitor *> idle;
 
+	/**
+	 * A lock-free stack of #DeferredMonitor instances which have
+	 * been scheduled (linked with DeferredMonitor::next_deferred).
+	 * Producers push with compare-and-swap; the #EventLoop takes
+	 * the whole stack at once and moves it to #deferred.
+	 */
+	std::atomic<DeferredMonitor *> deferred_inbox;
+
+	/**
+	 * Protects #deferred.  Only the #EventLoop thread and the
+	 * destructor of a #DeferredMonitor which is still queued lock
+	 * it; AddDeferred() and RemoveDeferred() don't.
+	 */
 	Mutex mutex;
-	std::list<DeferredMonitor *> deferred;
 
-	unsigned now_ms;
+	typedef boost::intrusive::member_hook<DeferredMonitor,
+					      DeferredMonitor::DeferredHook,
+					      &DeferredMonitor::deferred_hook> DeferredHookOption;
+
+	/**
+	 * The #DeferredMonitor instances taken from #deferred_inbox,
+	 * in the order they were scheduled.
+	 */
+	boost::intrusive::list<DeferredMonitor, DeferredHookOption,
+			       boost::intrusive::constant_time_size<false>> deferred;
 
 	bool quit;
 
@@ -91,11 +132,10 @@ class EventLoop final : SocketMonitor
 
 	/**
 	 * True when handling callbacks, false when waiting for I/O or
-	 * timeout.
-	 *
-	 * Protected with #mutex.
+	 * timeout.  AddDeferred() needs to wake up the #EventLoop only
+	 * if this is false.
 	 */
-	bool busy;
+	std::atomic_bool busy;
 
 #ifndef NDEBUG
 	/**
@@ -113,6 +153,12 @@ class EventLoop final : SocketMonitor
 	 */
 	ThreadId thread;
 
+	/**
+	 * The stall detector; nullptr if it is disabled (the
+	 * default).
+	 */
+	std::unique_ptr<EventLoopStats> stats;
+
 public:
 	EventLoop();
 	~EventLoop();
@@ -171,10 +217,40 @@ public:
 	 * Cancel a pending call to DeferredMonitor::RunDeferred().
 	 * However after returning, the call may still be running.
 	 *
-	 * This method is thread-safe.
+	 * This method is thread-safe and lock-free; the
+	 * #DeferredMonitor may remain linked in the queue until the
+	 * #EventLoop skips it.
 	 */
 	void RemoveDeferred(DeferredMonitor &d);
 
+	/**
+	 * Remove a cancelled #DeferredMonitor from the queue.  Called
+	 * by its destructor.
+	 *
+	 * This method is thread-safe.
+	 */
+	void UnlinkDeferred(DeferredMonitor &d);
+
+	/**
+	 * Enable the stall detector: measure the duration of each
+	 * handler invocation and of each iteration of Run(), and log
+	 * a warning for every handler which has blocked this
+	 * #EventLoop for longer than the given threshold.  Must be
+	 * called before Run().
+	 *
+	 * @param name a name for log messages; the string is not
+	 * copied, it must remain valid
+	 */
+	void EnableStallDetector(const char *name, unsigned threshold_ms);
+
+	/**
+	 * @return the statistics or nullptr if the stall detector is
+	 * disabled
+	 */
+	const EventLoopStats *GetStats() const {
+		return stats.get();
+	}
+
 	/**
 	 * The main function of this class.  It will loop until
 	 * Break() gets called.  Can be called only once.
@@ -182,6 +258,13 @@ public:
 	void Run();
 
 private:
+	/**
+	 * Move all items from #deferred_inbox to #deferred.
+	 *
+	 * Caller must lock the mutex.
+	 */
+	void CollectDeferred();
+
 	/**
 	 * Invoke all pending DeferredMonitors.
 	 *
@@ -189,6 +272,15 @@ private:
 	 */
 	void HandleDeferred();
 
+	/**
+	 * Invoke a handler of the given monitor object, measuring
+	 * its duration if the stall detector is enabled.
+	 */
+	template<typename M, typename F>
+	void Dispatch(M &m, F &&f);
+
+	void OnStall(const std::type_info &type, uint64_t duration_us);
+
 	virtual bool OnSocketReady(unsigned flags) override;
 
 public:
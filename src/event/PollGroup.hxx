@@ -26,6 +26,12 @@ typedef PollResultEPoll PollResult;
 typedef PollGroupEPoll  PollGroup;
 #endif
 
+#ifdef USE_IO_URING
+#include "PollGroupIoUring.hxx"
+typedef PollResultGeneric PollResult;
+typedef PollGroupIoUring  PollGroup;
+#endif
+
 #ifdef USE_WINSELECT
 #include "PollGroupWinSelect.hxx"
 typedef PollResultGeneric  PollResult;
@@ -60,6 +60,7 @@ public:
 	static constexpr unsigned WRITE = EPOLLOUT;
 	static constexpr unsigned ERROR = EPOLLERR;
 	static constexpr unsigned HANGUP = EPOLLHUP;
+	static constexpr unsigned EDGE = EPOLLET;
 
 	PollGroupEPoll() = default;
 
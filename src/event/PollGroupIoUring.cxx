@@ -0,0 +1,188 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+
+#ifdef USE_IO_URING
+
+#include "PollGroupIoUring.hxx"
+#include "system/ByteOrder.hxx"
+#include "system/FatalError.hxx"
+
+#include <assert.h>
+#include <errno.h>
+
+/**
+ * The number of submission queue entries.  More registration changes
+ * than this per EventLoop iteration are submitted in several system
+ * calls.
+ */
+static constexpr unsigned IO_URING_ENTRIES = 256;
+
+PollGroupIoUring::PollGroupIoUring()
+	:ring(IO_URING_ENTRIES)
+{
+	if (!ring.HasFeature(IORING_FEAT_EXT_ARG))
+		FatalError("io_uring does not support IORING_FEAT_EXT_ARG (Linux 5.11)");
+}
+
+io_uring_sqe &
+PollGroupIoUring::GetSqe()
+{
+	io_uring_sqe *sqe = ring.GetSqe();
+	if (sqe == nullptr) {
+		ring.Submit();
+		sqe = ring.GetSqe();
+		assert(sqe != nullptr);
+	}
+
+	return *sqe;
+}
+
+void
+PollGroupIoUring::Arm(int fd, Item &item)
+{
+	assert(!item.armed);
+
+	uint32_t poll_mask = item.events;
+	if (IsBigEndian())
+		/* the kernel expects the 16 bit halves swapped */
+		poll_mask = (poll_mask << 16) | (poll_mask >> 16);
+
+	io_uring_sqe &sqe = GetSqe();
+	sqe.opcode = IORING_OP_POLL_ADD;
+	sqe.fd = fd;
+	sqe.poll32_events = poll_mask;
+	sqe.user_data = MakeUserData(fd, item.generation);
+
+	item.armed = true;
+}
+
+void
+PollGroupIoUring::Disarm(int fd, Item &item)
+{
+	assert(item.armed);
+
+	io_uring_sqe &sqe = GetSqe();
+	sqe.opcode = IORING_OP_POLL_REMOVE;
+	sqe.fd = -1;
+	sqe.addr = MakeUserData(fd, item.generation);
+	sqe.user_data = IGNORE_COMPLETION;
+
+	item.armed = false;
+}
+
+bool
+PollGroupIoUring::Add(int fd, unsigned events, void *obj)
+{
+	auto result = items.emplace(fd, Item{obj, events, next_generation++,
+					     false});
+	if (!result.second)
+		return false;
+
+	to_arm.push_back(fd);
+	return true;
+}
+
+bool
+PollGroupIoUring::Modify(int fd, unsigned events, void *obj)
+{
+	auto i = items.find(fd);
+	if (i == items.end())
+		return false;
+
+	Item &item = i->second;
+	if (item.armed && events == item.events && obj == item.obj)
+		return true;
+
+	if (item.armed)
+		Disarm(fd, item);
+
+	item.obj = obj;
+	item.events = events;
+	item.generation = next_generation++;
+
+	to_arm.push_back(fd);
+	return true;
+}
+
+bool
+PollGroupIoUring::Remove(int fd)
+{
+	auto i = items.find(fd);
+	if (i == items.end())
+		return false;
+
+	if (i->second.armed)
+		Disarm(fd, i->second);
+
+	items.erase(i);
+	return true;
+}
+
+void
+PollGroupIoUring::ReadEvents(PollResultGeneric &result, int timeout_ms)
+{
+	for (int fd : to_arm) {
+		auto i = items.find(fd);
+		if (i != items.end() && !i->second.armed &&
+		    i->second.events != 0)
+			Arm(fd, i->second);
+	}
+
+	to_arm.clear();
+
+	/* submit the queued requests and wait in one system call;
+	   errors (-ETIME, -EINTR) are not interesting, because
+	   completions are collected below anyway */
+	ring.Submit(timeout_ms != 0 ? 1 : 0, timeout_ms);
+
+	io_uring_cqe *cqe;
+	while ((cqe = ring.PeekCqe()) != nullptr) {
+		const uint64_t user_data = cqe->user_data;
+		const int res = cqe->res;
+		ring.SeenCqe();
+
+		if (user_data == IGNORE_COMPLETION)
+			continue;
+
+		const int fd = user_data >> 32;
+		auto i = items.find(fd);
+		if (i == items.end() ||
+		    i->second.generation != uint32_t(user_data))
+			/* a stale completion of a registration which
+			   has been modified or removed */
+			continue;
+
+		Item &item = i->second;
+		item.armed = false;
+
+		/* one-shot: poll again in the next iteration (if
+		   the registration is still there) */
+		to_arm.push_back(fd);
+
+		if (res == -ECANCELED)
+			continue;
+
+		result.Add(res >= 0 ? unsigned(res) : ERROR, item.obj);
+	}
+}
+
+#endif /* USE_IO_URING */
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_EVENT_POLLGROUP_IO_URING_HXX
+#define MPD_EVENT_POLLGROUP_IO_URING_HXX
+
+#include "check.h"
+#include "PollResultGeneric.hxx"
+#include "system/IoUring.hxx"
+
+#include <vector>
+#include <unordered_map>
+
+#include <stdint.h>
+#include <sys/poll.h>
+
+/**
+ * A #PollGroup implementation which submits one-shot
+ * #IORING_OP_POLL_ADD requests to an io_uring.  All registration
+ * changes are queued and submitted together with the next wait, so
+ * each EventLoop iteration costs only one system call.
+ */
+class PollGroupIoUring
+{
+	struct Item
+	{
+		void *obj;
+		unsigned events;
+
+		/**
+		 * Distinguishes this registration from earlier ones
+		 * on the same file descriptor, whose completions may
+		 * still be in the queue.
+		 */
+		uint32_t generation;
+
+		/**
+		 * Is a #IORING_OP_POLL_ADD request pending?
+		 */
+		bool armed;
+	};
+
+	/**
+	 * The "user_data" value of requests whose completion is not
+	 * interesting.
+	 */
+	static constexpr uint64_t IGNORE_COMPLETION = ~uint64_t(0);
+
+	IoUring ring;
+
+	std::unordered_map<int, Item> items;
+
+	/**
+	 * File descriptors which need a new #IORING_OP_POLL_ADD
+	 * request.
+	 */
+	std::vector<int> to_arm;
+
+	uint32_t next_generation = 0;
+
+	PollGroupIoUring(PollGroupIoUring &) = delete;
+	PollGroupIoUring &operator=(PollGroupIoUring &) = delete;
+public:
+	static constexpr unsigned READ = POLLIN;
+	static constexpr unsigned WRITE = POLLOUT;
+	static constexpr unsigned ERROR = POLLERR;
+	static constexpr unsigned HANGUP = POLLHUP;
+	static constexpr unsigned EDGE = 0;
+
+	PollGroupIoUring();
+
+	void ReadEvents(PollResultGeneric &result, int timeout_ms);
+	bool Add(int fd, unsigned events, void *obj);
+	bool Modify(int fd, unsigned events, void *obj);
+	bool Remove(int fd);
+
+	bool Abandon(int fd) {
+		/* the pending poll request holds a reference to the
+		   file, so it needs to be cancelled even though the
+		   descriptor has been closed */
+		return Remove(fd);
+	}
+
+private:
+	static constexpr uint64_t MakeUserData(int fd, uint32_t generation) {
+		return (uint64_t(fd) << 32) | generation;
+	}
+
+	/**
+	 * Obtain a submission queue entry, flushing the queue if it
+	 * is full.
+	 */
+	io_uring_sqe &GetSqe();
+
+	void Arm(int fd, Item &item);
+
+	/**
+	 * Cancel the pending #IORING_OP_POLL_ADD request.
+	 */
+	void Disarm(int fd, Item &item);
+};
+
+#endif
@@ -47,6 +47,7 @@ public:
 	static constexpr unsigned WRITE = POLLOUT;
 	static constexpr unsigned ERROR = POLLERR;
 	static constexpr unsigned HANGUP = POLLHUP;
+	static constexpr unsigned EDGE = 0;
 
 	PollGroupPoll();
 	~PollGroupPoll();
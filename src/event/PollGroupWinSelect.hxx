@@ -97,6 +97,7 @@ public:
 	static constexpr unsigned WRITE = 2;
 	static constexpr unsigned ERROR = 0;
 	static constexpr unsigned HANGUP = 0;
+	static constexpr unsigned EDGE = 0;
 
 	PollGroupWinSelect();
 	~PollGroupWinSelect();
@@ -23,6 +23,7 @@
 #include "system/fd_util.h"
 
 #include <assert.h>
+#include <string.h>
 
 #ifdef WIN32
 #include <winsock2.h>
@@ -30,9 +31,20 @@
 #include <sys/socket.h>
 #endif
 
+/**
+ * In edge-triggered mode, the socket is always registered with these
+ * flags.
+ */
+static constexpr unsigned EDGE_FLAGS = SocketMonitor::READ |
+	SocketMonitor::WRITE | SocketMonitor::ERROR | SocketMonitor::HANGUP |
+	SocketMonitor::EDGE;
+
 void
 SocketMonitor::Dispatch(unsigned flags)
 {
+	if (edge_triggered)
+		ready_flags |= flags;
+
 	flags &= GetScheduledFlags();
 
 	if (flags != 0 && !OnSocketReady(flags) && IsDefined())
@@ -83,6 +95,22 @@ SocketMonitor::Close()
 	close_socket(Steal());
 }
 
+void
+SocketMonitor::EnableEdgeTriggered()
+{
+	if (EDGE == 0 || edge_triggered)
+		return;
+
+	edge_triggered = true;
+
+	if (IsDefined() && scheduled_flags != 0) {
+		/* re-register; the kernel will report all events
+		   which are currently pending */
+		loop.ModifyFD(fd, EDGE_FLAGS, *this);
+		ready_flags = 0;
+	}
+}
+
 void
 SocketMonitor::Schedule(unsigned flags)
 {
@@ -91,6 +119,22 @@ SocketMonitor::Schedule(unsigned flags)
 	if (flags == GetScheduledFlags())
 		return;
 
+	if (edge_triggered && flags != 0) {
+		if (scheduled_flags == 0) {
+			loop.AddFD(fd, EDGE_FLAGS, *this);
+			ready_flags = 0;
+		} else if (flags & ~scheduled_flags & ready_flags) {
+			/* an event we're now interested in has been
+			   reported earlier and may still be pending;
+			   re-arm to have it reported again */
+			loop.ModifyFD(fd, EDGE_FLAGS, *this);
+			ready_flags &= ~flags;
+		}
+
+		scheduled_flags = flags;
+		return;
+	}
+
 	if (scheduled_flags == 0)
 		loop.AddFD(fd, flags, *this);
 	else if (flags == 0)
@@ -111,7 +155,14 @@ SocketMonitor::Read(void *data, size_t length)
 	flags |= MSG_DONTWAIT;
 #endif
 
-	return recv(Get(), (char *)data, length, flags);
+	const auto nbytes = recv(Get(), (char *)data, length, flags);
+	if (edge_triggered && (nbytes < 0 || size_t(nbytes) < length))
+		/* a short read means the socket buffer is empty; new
+		   data will trigger another event (errors are
+		   reported as events anyway) */
+		ready_flags &= ~READ;
+
+	return nbytes;
 }
 
 SocketMonitor::ssize_t
@@ -127,5 +178,47 @@ SocketMonitor::Write(const void *data, size_t length)
 	flags |= MSG_DONTWAIT;
 #endif
 
-	return send(Get(), (const char *)data, length, flags);
+	const auto nbytes = send(Get(), (const char *)data, length, flags);
+	if (edge_triggered && (nbytes < 0 || size_t(nbytes) < length))
+		/* the socket buffer is full; there will be another
+		   event when space becomes available */
+		ready_flags &= ~WRITE;
+
+	return nbytes;
+}
+
+SocketMonitor::ssize_t
+SocketMonitor::WriteV(const struct iovec *iov, size_t n)
+{
+	assert(IsDefined());
+	assert(n > 0);
+
+#ifdef WIN32
+	return Write(iov[0].iov_base, iov[0].iov_len);
+#else
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = const_cast<struct iovec *>(iov);
+	msg.msg_iovlen = n;
+
+	int flags = 0;
+#ifdef MSG_NOSIGNAL
+	flags |= MSG_NOSIGNAL;
+#endif
+#ifdef MSG_DONTWAIT
+	flags |= MSG_DONTWAIT;
+#endif
+
+	const auto nbytes = sendmsg(Get(), &msg, flags);
+	if (edge_triggered) {
+		size_t length = 0;
+		for (size_t i = 0; i < n; ++i)
+			length += iov[i].iov_len;
+
+		if (nbytes < 0 || size_t(nbytes) < length)
+			ready_flags &= ~WRITE;
+	}
+
+	return nbytes;
+#endif
 }
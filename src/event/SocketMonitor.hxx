@@ -28,6 +28,15 @@
 #include <assert.h>
 #include <stddef.h>
 
+#ifdef WIN32
+struct iovec {
+	void *iov_base;
+	size_t iov_len;
+};
+#else
+#include <sys/uio.h>
+#endif
+
 #ifdef WIN32
 /* ERROR is a WIN32 macro that poisons our namespace; this is a kludge
    to allow us to use it anyway */
@@ -60,11 +69,27 @@ class SocketMonitor {
 	 */
 	unsigned scheduled_flags;
 
+	/**
+	 * In edge-triggered mode, the socket is registered for all
+	 * events once, and #scheduled_flags only filters what is
+	 * passed to OnSocketReady().
+	 */
+	bool edge_triggered = false;
+
+	/**
+	 * In edge-triggered mode: the events which have been reported
+	 * but not yet consumed, i.e. Read() or Write() has not yet
+	 * hit the end of the socket buffer.  The kernel will not
+	 * report them again until that happens.
+	 */
+	unsigned ready_flags = 0;
+
 public:
 	static constexpr unsigned READ = PollGroup::READ;
 	static constexpr unsigned WRITE = PollGroup::WRITE;
 	static constexpr unsigned ERROR = PollGroup::ERROR;
 	static constexpr unsigned HANGUP = PollGroup::HANGUP;
+	static constexpr unsigned EDGE = PollGroup::EDGE;
 
 	typedef std::make_signed<size_t>::type ssize_t;
 
@@ -111,6 +136,29 @@ public:
 		return scheduled_flags;
 	}
 
+	/**
+	 * Switch to edge-triggered mode if the #PollGroup supports
+	 * it.  This saves one system call each time the scheduled
+	 * flags change, but OnSocketReady() must then consume all
+	 * data until the socket buffer is empty (or full, for
+	 * writing), or else it will not be called again; see
+	 * IsReady().
+	 */
+	void EnableEdgeTriggered();
+
+	bool IsEdgeTriggered() const {
+		return edge_triggered;
+	}
+
+	/**
+	 * In edge-triggered mode: may the given event still be
+	 * pending because it was not consumed yet?  Always true in
+	 * level-triggered mode.
+	 */
+	bool IsReady(unsigned flags) const {
+		return !edge_triggered || (ready_flags & flags) != 0;
+	}
+
 	void Schedule(unsigned flags);
 
 	void Cancel() {
@@ -136,6 +184,12 @@ public:
 	ssize_t Read(void *data, size_t length);
 	ssize_t Write(const void *data, size_t length);
 
+	/**
+	 * Write several buffers with one system call.  On WIN32, only
+	 * the first buffer is written.
+	 */
+	ssize_t WriteV(const struct iovec *iov, size_t n);
+
 protected:
 	/**
 	 * @return false if the socket has been closed
@@ -21,6 +21,9 @@
 #define MPD_SOCKET_TIMEOUT_MONITOR_HXX
 
 #include "check.h"
+#include "util/BoundMethod.hxx"
+
+#include <boost/intrusive/list_hook.hpp>
 
 class EventLoop;
 
@@ -34,9 +37,34 @@ class EventLoop;
  */
 class TimeoutMonitor {
 	friend class EventLoop;
+	friend class TimerWheel;
+
+	typedef boost::intrusive::list_member_hook<boost::intrusive::link_mode<boost::intrusive::normal_link>> TimerHook;
+
+	/**
+	 * Links this object into a slot of the #TimerWheel.
+	 */
+	TimerHook timer_hook;
 
 	EventLoop &loop;
 
+	/**
+	 * Projected MonotonicClockMS() value when this timer is due.
+	 * Managed by the #TimerWheel.
+	 */
+	unsigned due_ms;
+
+	/**
+	 * The #TimerWheel slot which contains this object.
+	 */
+	unsigned timer_slot;
+
+	/**
+	 * How much later (in milliseconds) this timer may fire; see
+	 * SetSlack().
+	 */
+	unsigned slack_ms = 0;
+
 	bool active;
 
 public:
@@ -56,6 +84,20 @@ public:
 		return active;
 	}
 
+	/**
+	 * Allow the #EventLoop to fire this timer up to the given
+	 * number of milliseconds late, so it can be coalesced with
+	 * other timers into fewer wakeups.  The slack applied to a
+	 * timeout is limited to a quarter of its duration, so short
+	 * timeouts of the same monitor remain accurate.  The default
+	 * is 0 (precise), and it should remain so for anything
+	 * related to audio.  Takes effect at the next Schedule()
+	 * call.
+	 */
+	void SetSlack(unsigned ms) {
+		slack_ms = ms;
+	}
+
 	void Schedule(unsigned ms);
 	void ScheduleSeconds(unsigned s);
 	void Cancel();
@@ -67,4 +109,22 @@ private:
 	void Run();
 };
 
+/**
+ * A variant of #TimeoutMonitor which invokes a bound method.
+ */
+template<typename T>
+class CallbackTimeoutMonitor final : public TimeoutMonitor {
+	BoundMethod<T, void> callback;
+
+public:
+	template<typename... Args>
+	explicit CallbackTimeoutMonitor(EventLoop &_loop, Args&&... args)
+		:TimeoutMonitor(_loop), callback(std::forward<Args>(args)...) {}
+
+protected:
+	void OnTimeout() override {
+		callback();
+	}
+};
+
 #endif /* MAIN_NOTIFY_H */
@@ -0,0 +1,281 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "TimerWheel.hxx"
+
+#include <limits.h>
+#include <string.h>
+#include <assert.h>
+
+/**
+ * Rotate the bits of the 64 bit integer to the right.
+ */
+static constexpr uint64_t
+RotateRight(uint64_t value, unsigned n)
+{
+	return n == 0
+		? value
+		: (value >> n) | (value << (64 - n));
+}
+
+TimerWheel::TimerWheel(unsigned now_ms)
+	:current_ms(now_ms)
+{
+	memset(used, 0, sizeof(used));
+}
+
+TimerWheel::~TimerWheel()
+{
+	assert(IsEmpty());
+}
+
+unsigned
+TimerWheel::FindSlot(unsigned due_ms) const
+{
+	const unsigned delta = due_ms - current_ms;
+	assert(int(delta) >= 0);
+
+	if (delta < LEVEL0_SIZE)
+		return due_ms % LEVEL0_SIZE;
+
+	for (unsigned level = 1; level < N_UPPER_LEVELS; ++level) {
+		const unsigned shift = GetLevelShift(level);
+		if (delta < (1u << (shift + LEVEL_BITS)))
+			return GetLevelOffset(level) +
+				((due_ms >> shift) % LEVEL_SIZE);
+	}
+
+	/* the top level covers the rest of the 32 bit range */
+	return GetLevelOffset(N_UPPER_LEVELS) +
+		((due_ms >> GetLevelShift(N_UPPER_LEVELS)) % LEVEL_SIZE);
+}
+
+void
+TimerWheel::Insert(TimeoutMonitor &t)
+{
+	if (int(t.due_ms - current_ms) < 0) {
+		/* this time has already been processed by Advance() */
+		t.timer_slot = READY;
+		ready.push_back(t);
+		return;
+	}
+
+	const unsigned slot = FindSlot(t.due_ms);
+	t.timer_slot = slot;
+	slots[slot].push_back(t);
+	SetUsed(slot);
+	++n_timers;
+}
+
+void
+TimerWheel::Add(TimeoutMonitor &t, unsigned due_ms)
+{
+	t.due_ms = due_ms;
+	Insert(t);
+}
+
+void
+TimerWheel::Remove(TimeoutMonitor &t)
+{
+	const unsigned slot = t.timer_slot;
+	if (slot == READY) {
+		ready.erase(ready.iterator_to(t));
+		return;
+	}
+
+	assert(slot < N_SLOTS);
+	assert(n_timers > 0);
+
+	TimerList &list = slots[slot];
+	list.erase(list.iterator_to(t));
+	if (list.empty())
+		ClearUsed(slot);
+	--n_timers;
+}
+
+void
+TimerWheel::Cascade()
+{
+	assert(current_ms % LEVEL0_SIZE == 0);
+
+	for (unsigned level = 1; level <= N_UPPER_LEVELS; ++level) {
+		const unsigned shift = GetLevelShift(level);
+		const unsigned index = (current_ms >> shift) % LEVEL_SIZE;
+		const unsigned slot = GetLevelOffset(level) + index;
+
+		if (IsUsed(slot)) {
+			TimerList list;
+			list.swap(slots[slot]);
+			ClearUsed(slot);
+
+			while (!list.empty()) {
+				TimeoutMonitor &t = list.front();
+				list.pop_front();
+				--n_timers;
+				Insert(t);
+			}
+		}
+
+		if (index != 0)
+			/* this level has not wrapped around, so the
+			   upper levels don't need to cascade */
+			break;
+	}
+}
+
+void
+TimerWheel::Advance(unsigned now_ms)
+{
+	while (int(now_ms - current_ms) >= 0) {
+		if (n_timers == 0) {
+			/* nothing to cascade, skip the rest */
+			current_ms = now_ms + 1;
+			break;
+		}
+
+		const unsigned index = current_ms % LEVEL0_SIZE;
+		if (index == 0)
+			Cascade();
+
+		if (IsUsed(index)) {
+			TimerList &list = slots[index];
+			while (!list.empty()) {
+				TimeoutMonitor &t = list.front();
+				list.pop_front();
+				t.timer_slot = READY;
+				ready.push_back(t);
+				--n_timers;
+			}
+
+			ClearUsed(index);
+		}
+
+		++current_ms;
+
+		if (FindNextLevel0() < 0) {
+			/* level 0 is empty: skip to the next cascade
+			   (or to the end) */
+			const unsigned next_cascade =
+				(current_ms | (LEVEL0_SIZE - 1)) + 1;
+			if (current_ms % LEVEL0_SIZE != 0)
+				current_ms = int(next_cascade - now_ms) > 0
+					? now_ms + 1
+					: next_cascade;
+		}
+	}
+}
+
+TimeoutMonitor *
+TimerWheel::PopReady()
+{
+	if (ready.empty())
+		return nullptr;
+
+	TimeoutMonitor &t = ready.front();
+	ready.pop_front();
+	return &t;
+}
+
+int
+TimerWheel::FindNextLevel0() const
+{
+	const unsigned start = current_ms % LEVEL0_SIZE;
+	constexpr unsigned n_words = LEVEL0_SIZE / 64;
+
+	/* scan the word containing "start" twice: first the bits
+	   from "start" on, and after wrapping around the bits
+	   before it */
+	for (unsigned i = 0; i <= n_words; ++i) {
+		const unsigned word = (start / 64 + i) % n_words;
+		uint64_t bits = used[word];
+		if (i == 0)
+			bits &= ~uint64_t(0) << (start % 64);
+		else if (i == n_words)
+			bits &= (uint64_t(1) << (start % 64)) - 1;
+
+		if (bits != 0) {
+			const unsigned slot = word * 64 + __builtin_ctzll(bits);
+			return (slot - start) % LEVEL0_SIZE;
+		}
+	}
+
+	return -1;
+}
+
+int
+TimerWheel::GetTimeout(unsigned now_ms) const
+{
+	if (!ready.empty())
+		return 0;
+
+	if (n_timers == 0)
+		return -1;
+
+	/* the distance from #current_ms to the next interesting
+	   point in time */
+	uint64_t delta = UINT64_MAX;
+
+	const int level0 = FindNextLevel0();
+	if (level0 >= 0)
+		delta = level0;
+
+	/* for the upper levels, wake up when the slot needs to be
+	   cascaded */
+	for (unsigned level = 1; level <= N_UPPER_LEVELS; ++level) {
+		static_assert(LEVEL_SIZE == 64, "Wrong level size");
+		uint64_t bits = used[GetLevelOffset(level) / 64];
+		if (bits == 0)
+			continue;
+
+		const unsigned shift = GetLevelShift(level);
+		const unsigned index = (current_ms >> shift) % LEVEL_SIZE;
+		const unsigned remainder = current_ms & ((1u << shift) - 1);
+
+		/* bit n is now the slot "n" steps from the current
+		   one */
+		bits = RotateRight(bits, index);
+
+		unsigned steps;
+		if (remainder == 0)
+			steps = __builtin_ctzll(bits);
+		else if ((bits & ~uint64_t(1)) != 0)
+			/* the current slot will be cascaded only after
+			   a full round */
+			steps = __builtin_ctzll(bits & ~uint64_t(1));
+		else
+			steps = LEVEL_SIZE;
+
+		const uint64_t cascade_delta =
+			(uint64_t(steps) << shift) - remainder;
+		if (cascade_delta < delta)
+			delta = cascade_delta;
+	}
+
+	assert(delta != UINT64_MAX);
+
+	const int64_t timeout = int64_t(delta) + int(current_ms - now_ms);
+	if (timeout <= 0)
+		return 0;
+
+	return timeout < INT_MAX
+		? int(timeout)
+		: INT_MAX;
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_EVENT_TIMER_WHEEL_HXX
+#define MPD_EVENT_TIMER_WHEEL_HXX
+
+#include "check.h"
+#include "TimeoutMonitor.hxx"
+#include "Compiler.h"
+
+#include <boost/intrusive/list.hpp>
+
+#include <stdint.h>
+
+/**
+ * A hierarchical timing wheel which manages the #TimeoutMonitor
+ * instances of an #EventLoop.  The timers are linked into the slots
+ * with an intrusive hook, therefore scheduling and cancelling is O(1)
+ * and does not allocate memory.
+ *
+ * The first level has one slot per millisecond; the four upper
+ * levels have 64 slots each and are "cascaded" to the next lower
+ * level whenever the lower one wraps around.
+ *
+ * This class is not thread-safe.
+ */
+class TimerWheel {
+	static constexpr unsigned LEVEL0_BITS = 8;
+	static constexpr unsigned LEVEL0_SIZE = 1u << LEVEL0_BITS;
+	static constexpr unsigned LEVEL_BITS = 6;
+	static constexpr unsigned LEVEL_SIZE = 1u << LEVEL_BITS;
+	static constexpr unsigned N_UPPER_LEVELS = 4;
+
+	static constexpr unsigned N_SLOTS =
+		LEVEL0_SIZE + N_UPPER_LEVELS * LEVEL_SIZE;
+
+	/**
+	 * The "slot" number of timers in the #ready list.
+	 */
+	static constexpr unsigned READY = N_SLOTS;
+
+	typedef boost::intrusive::member_hook<TimeoutMonitor,
+					      TimeoutMonitor::TimerHook,
+					      &TimeoutMonitor::timer_hook> TimerHookOption;
+
+	typedef boost::intrusive::list<TimeoutMonitor, TimerHookOption,
+				       boost::intrusive::constant_time_size<false>> TimerList;
+
+	/**
+	 * The next millisecond which has not yet been processed by
+	 * Advance().
+	 */
+	unsigned current_ms;
+
+	/**
+	 * The number of timers in #slots (excluding #ready).
+	 */
+	unsigned n_timers = 0;
+
+	/**
+	 * Timers which are due, to be consumed by PopReady().
+	 */
+	TimerList ready;
+
+	TimerList slots[N_SLOTS];
+
+	/**
+	 * One bit for each non-empty element of #slots.
+	 */
+	uint64_t used[N_SLOTS / 64];
+
+public:
+	explicit TimerWheel(unsigned now_ms);
+	~TimerWheel();
+
+	TimerWheel(const TimerWheel &) = delete;
+	TimerWheel &operator=(const TimerWheel &) = delete;
+
+	bool IsEmpty() const {
+		return n_timers == 0 && ready.empty();
+	}
+
+	/**
+	 * Add a timer which is not yet registered.
+	 *
+	 * @param due_ms the monotonic clock value when the timer
+	 * shall fire
+	 */
+	void Add(TimeoutMonitor &t, unsigned due_ms);
+
+	/**
+	 * Remove a registered timer.
+	 */
+	void Remove(TimeoutMonitor &t);
+
+	/**
+	 * Move all timers which are due at the given time to the
+	 * "ready" list.  Timers which get added after this call with
+	 * a due time not later than #now_ms will be ready
+	 * immediately.
+	 */
+	void Advance(unsigned now_ms);
+
+	/**
+	 * Remove the first ready timer from the wheel and return it.
+	 *
+	 * @return the timer or nullptr if no timer is ready
+	 */
+	TimeoutMonitor *PopReady();
+
+	/**
+	 * Determine how long to wait for the next timer.  The result
+	 * may be too short (the wheel needs to cascade its upper
+	 * levels), but never too long.  Call Advance() first.
+	 *
+	 * @return the timeout in milliseconds, 0 if there are ready
+	 * timers or -1 if there are no timers at all
+	 */
+	gcc_pure
+	int GetTimeout(unsigned now_ms) const;
+
+private:
+	static constexpr unsigned GetLevelShift(unsigned level) {
+		return LEVEL0_BITS + (level - 1) * LEVEL_BITS;
+	}
+
+	static constexpr unsigned GetLevelOffset(unsigned level) {
+		return LEVEL0_SIZE + (level - 1) * LEVEL_SIZE;
+	}
+
+	bool IsUsed(unsigned slot) const {
+		return (used[slot / 64] >> (slot % 64)) & 1;
+	}
+
+	void SetUsed(unsigned slot) {
+		used[slot / 64] |= uint64_t(1) << (slot % 64);
+	}
+
+	void ClearUsed(unsigned slot) {
+		used[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+	}
+
+	/**
+	 * Determine the slot for a timer which is due at the given
+	 * time, relative to #current_ms.
+	 */
+	gcc_pure
+	unsigned FindSlot(unsigned due_ms) const;
+
+	void Insert(TimeoutMonitor &t);
+
+	/**
+	 * Move all timers of the current slot of upper levels to the
+	 * lower levels.  Called when level 0 wraps around.
+	 */
+	void Cascade();
+
+	/**
+	 * Find the first non-empty level 0 slot, starting at the
+	 * slot of #current_ms.
+	 *
+	 * @return the number of milliseconds from #current_ms to
+	 * that slot, or -1 if level 0 is empty
+	 */
+	gcc_pure
+	int FindNextLevel0() const;
+};
+
+#endif
@@ -25,6 +25,10 @@
 #ifndef MPD_FILTER_INTERNAL_HXX
 #define MPD_FILTER_INTERNAL_HXX
 
+#include "util/WritableBuffer.hxx"
+#include "Compiler.h"
+
+#include <assert.h>
 #include <stddef.h>
 
 struct AudioFormat;
@@ -62,6 +66,34 @@ public:
 	 * error
 	 */
 	virtual ConstBuffer<void> FilterPCM(ConstBuffer<void> src, Error &error) = 0;
+
+	/**
+	 * Can this filter currently modify PCM data in place (see
+	 * FilterInPlace())?  This may change while the filter is
+	 * open, so the caller must ask for each block.
+	 *
+	 * The output of such a filter has the same size as its input,
+	 * and FilterPCM() returns either the input buffer or a buffer
+	 * owned by the filter, which the caller may modify until the
+	 * next FilterPCM() call.
+	 */
+	virtual bool IsInPlace() const {
+		return false;
+	}
+
+	/**
+	 * Filters a block of PCM data in place.  May only be called
+	 * if IsInPlace() returns true.
+	 *
+	 * @param data the buffer to be modified
+	 * @param error location to store the error occurring
+	 * @return true on success, false on error
+	 */
+	virtual bool FilterInPlace(gcc_unused WritableBuffer<void> data,
+				   gcc_unused Error &error) {
+		assert(false);
+		gcc_unreachable();
+	}
 };
 
 #endif
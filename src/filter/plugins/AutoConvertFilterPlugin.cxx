@@ -51,6 +51,17 @@ public:
 	virtual void Close() override;
 	virtual ConstBuffer<void> FilterPCM(ConstBuffer<void> src,
 					    Error &error) override;
+
+	bool IsInPlace() const override {
+		return convert == nullptr && filter->IsInPlace();
+	}
+
+	bool FilterInPlace(WritableBuffer<void> data,
+			   Error &error) override {
+		assert(convert == nullptr);
+
+		return filter->FilterInPlace(data, error);
+	}
 };
 
 AudioFormat
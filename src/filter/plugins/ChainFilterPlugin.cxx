@@ -53,6 +53,10 @@ public:
 		children.emplace_back(name, filter);
 	}
 
+	bool IsEmpty() const {
+		return children.empty();
+	}
+
 	/* virtual methods from class Filter */
 	AudioFormat Open(AudioFormat &af, Error &error) override;
 	void Close() override;
@@ -148,12 +152,36 @@ ChainFilter::Close()
 ConstBuffer<void>
 ChainFilter::FilterPCM(ConstBuffer<void> src, Error &error)
 {
+	/* may #src be modified by in-place filters?  Not our input,
+	   which is shared with other consumers */
+	bool writable = false;
+
 	for (auto &child : children) {
+		Filter &filter = *child.filter;
+		const bool in_place = filter.IsInPlace();
+
+		if (writable && in_place) {
+			/* modify the previous in-place filter's buffer
+			   instead of filling yet another one */
+			WritableBuffer<void> data(const_cast<void *>(src.data),
+						  src.size);
+			if (!filter.FilterInPlace(data, error))
+				return nullptr;
+
+			continue;
+		}
+
 		/* feed the output of the previous filter as input
 		   into the current one */
-		src = child.filter->FilterPCM(src, error);
-		if (src.IsNull())
+		const auto dest = filter.FilterPCM(src, error);
+		if (dest.IsNull())
 			return nullptr;
+
+		/* an in-place filter returns either its input or a
+		   buffer of its own, which the following in-place
+		   filters may modify */
+		writable = in_place && dest.data != src.data;
+		src = dest;
 	}
 
 	/* return the output of the last filter */
@@ -178,3 +206,11 @@ filter_chain_append(Filter &_chain, const char *name, Filter *filter)
 
 	chain.Append(name, filter);
 }
+
+bool
+filter_chain_is_empty(const Filter &_chain)
+{
+	const ChainFilter &chain = (const ChainFilter &)_chain;
+
+	return chain.IsEmpty();
+}
@@ -23,11 +23,12 @@
 #include "filter/FilterInternal.hxx"
 #include "filter/FilterRegistry.hxx"
 #include "pcm/PcmConvert.hxx"
-#include "util/Manual.hxx"
 #include "util/ConstBuffer.hxx"
 #include "AudioFormat.hxx"
 #include "poison.h"
 
+#include <list>
+
 #include <assert.h>
 
 class ConvertFilter final : public Filter {
@@ -47,15 +48,50 @@ class ConvertFilter final : public Filter {
 	 */
 	AudioFormat out_audio_format;
 
-	Manual<PcmConvert> state;
+	/**
+	 * An open #PcmConvert instance together with the formats it
+	 * was opened with.
+	 */
+	struct Converter {
+		AudioFormat in_audio_format, out_audio_format;
+
+		PcmConvert state;
+	};
+
+	/**
+	 * The maximum number of #Converter instances kept in
+	 * #converters.
+	 */
+	static constexpr size_t MAX_CONVERTERS = 4;
+
+	/**
+	 * Open #PcmConvert instances, the most recently used one
+	 * first.  If #out_audio_format is valid, then the first one
+	 * is the one in use.  The others are kept open after a song
+	 * (or the output) has switched to another format, so
+	 * switching back does not need to set up a new resampler.
+	 */
+	std::list<Converter> converters;
 
 public:
+	~ConvertFilter();
+
 	bool Set(const AudioFormat &_out_audio_format, Error &error);
 
 	virtual AudioFormat Open(AudioFormat &af, Error &error) override;
 	virtual void Close() override;
 	virtual ConstBuffer<void> FilterPCM(ConstBuffer<void> src,
 					    Error &error) override;
+
+	bool IsInPlace() const override {
+		/* only if no conversion is necessary */
+		return !out_audio_format.IsValid();
+	}
+
+	bool FilterInPlace(WritableBuffer<void>, Error &) override {
+		assert(!out_audio_format.IsValid());
+		return true;
+	}
 };
 
 static Filter *
@@ -65,6 +101,12 @@ convert_filter_init(gcc_unused const ConfigBlock &block,
 	return new ConvertFilter();
 }
 
+ConvertFilter::~ConvertFilter()
+{
+	for (auto &i : converters)
+		i.state.Close();
+}
+
 bool
 ConvertFilter::Set(const AudioFormat &_out_audio_format, Error &error)
 {
@@ -75,19 +117,44 @@ ConvertFilter::Set(const AudioFormat &_out_audio_format, Error &error)
 		/* no change */
 		return true;
 
-	if (out_audio_format.IsValid()) {
-		out_audio_format.Clear();
-		state->Close();
-	}
+	/* the converter which was in use (if any) stays open at the
+	   front of the list */
+	out_audio_format.Clear();
 
 	if (_out_audio_format == in_audio_format)
 		/* optimized special case: no-op */
 		return true;
 
-	if (!state->Open(in_audio_format, _out_audio_format, error))
+	for (auto i = converters.begin(), end = converters.end();
+	     i != end; ++i) {
+		if (i->in_audio_format == in_audio_format &&
+		    i->out_audio_format == _out_audio_format) {
+			/* reuse this one, but forget the previous
+			   stream */
+			i->state.Reset();
+			converters.splice(converters.begin(), converters, i);
+			out_audio_format = _out_audio_format;
+			return true;
+		}
+	}
+
+	converters.emplace_front();
+
+	Converter &c = converters.front();
+	if (!c.state.Open(in_audio_format, _out_audio_format, error)) {
+		converters.pop_front();
 		return false;
+	}
 
+	c.in_audio_format = in_audio_format;
+	c.out_audio_format = _out_audio_format;
 	out_audio_format = _out_audio_format;
+
+	while (converters.size() > MAX_CONVERTERS) {
+		converters.back().state.Close();
+		converters.pop_back();
+	}
+
 	return true;
 }
 
@@ -99,8 +166,6 @@ ConvertFilter::Open(AudioFormat &audio_format, gcc_unused Error &error)
 	in_audio_format = audio_format;
 	out_audio_format.Clear();
 
-	state.Construct();
-
 	return in_audio_format;
 }
 
@@ -109,11 +174,6 @@ ConvertFilter::Close()
 {
 	assert(in_audio_format.IsValid());
 
-	if (out_audio_format.IsValid())
-		state->Close();
-
-	state.Destruct();
-
 	poison_undefined(&in_audio_format, sizeof(in_audio_format));
 	poison_undefined(&out_audio_format, sizeof(out_audio_format));
 }
@@ -127,7 +187,7 @@ ConvertFilter::FilterPCM(ConstBuffer<void> src, Error &error)
 		/* optimized special case: no-op */
 		return src;
 
-	return state->Convert(src, error);
+	return converters.front().state.Convert(src, error);
 }
 
 const struct filter_plugin convert_filter_plugin = {
@@ -26,6 +26,7 @@
 #include "AudioCompress/compress.h"
 #include "util/ConstBuffer.hxx"
 
+#include <assert.h>
 #include <string.h>
 
 class NormalizeFilter final : public Filter {
@@ -33,12 +34,26 @@ class NormalizeFilter final : public Filter {
 
 	PcmBuffer buffer;
 
+	SampleFormat format;
+
 public:
 	/* virtual methods from class Filter */
 	AudioFormat Open(AudioFormat &af, Error &error) override;
 	void Close() override;
 	ConstBuffer<void> FilterPCM(ConstBuffer<void> src,
 				    Error &error) override;
+
+	bool IsInPlace() const override {
+		return true;
+	}
+
+	bool FilterInPlace(WritableBuffer<void> data, Error &) override {
+		Process(data.data, data.size);
+		return true;
+	}
+
+private:
+	void Process(void *data, size_t size);
 };
 
 static Filter *
@@ -51,8 +66,23 @@ normalize_filter_init(gcc_unused const ConfigBlock &block,
 AudioFormat
 NormalizeFilter::Open(AudioFormat &audio_format, gcc_unused Error &error)
 {
-	audio_format.format = SampleFormat::S16;
+	/* process float and 24/32 bit samples natively, to avoid
+	   losing precision in a conversion to 16 bit */
+	switch (audio_format.format) {
+	case SampleFormat::FLOAT:
+		break;
+
+	case SampleFormat::S24_P32:
+	case SampleFormat::S32:
+		audio_format.format = SampleFormat::S32;
+		break;
+
+	default:
+		audio_format.format = SampleFormat::S16;
+		break;
+	}
 
+	format = audio_format.format;
 	compressor = Compressor_new(0);
 
 	return audio_format;
@@ -65,13 +95,35 @@ NormalizeFilter::Close()
 	Compressor_delete(compressor);
 }
 
+inline void
+NormalizeFilter::Process(void *data, size_t size)
+{
+	switch (format) {
+	case SampleFormat::FLOAT:
+		Compressor_Process_float(compressor, (float *)data,
+					 size / sizeof(float));
+		break;
+
+	case SampleFormat::S32:
+		Compressor_Process_int32(compressor, (int32_t *)data,
+					 size / sizeof(int32_t));
+		break;
+
+	default:
+		assert(format == SampleFormat::S16);
+		Compressor_Process_int16(compressor, (int16_t *)data,
+					 size / sizeof(int16_t));
+		break;
+	}
+}
+
 ConstBuffer<void>
 NormalizeFilter::FilterPCM(ConstBuffer<void> src, gcc_unused Error &error)
 {
-	int16_t *dest = (int16_t *)buffer.Get(src.size);
+	void *dest = buffer.Get(src.size);
 	memcpy(dest, src.data, src.size);
 
-	Compressor_Process_int16(compressor, dest, src.size / 2);
+	Process(dest, src.size);
 	return { (const void *)dest, src.size };
 }
 
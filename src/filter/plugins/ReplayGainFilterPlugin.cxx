@@ -105,6 +105,10 @@ public:
 		Update();
 	}
 
+	unsigned GetVolume() const {
+		return pv.GetVolume();
+	}
+
 	/**
 	 * Recalculates the new volume after a property was changed.
 	 */
@@ -115,6 +119,15 @@ public:
 	void Close() override;
 	ConstBuffer<void> FilterPCM(ConstBuffer<void> src,
 				    Error &error) override;
+
+	bool IsInPlace() const override {
+		return true;
+	}
+
+	bool FilterInPlace(WritableBuffer<void> data, Error &) override {
+		pv.ApplyInPlace(data);
+		return true;
+	}
 };
 
 void
@@ -204,3 +217,11 @@ replay_gain_filter_set_mode(Filter *_filter, ReplayGainMode mode)
 
 	filter->SetMode(mode);
 }
+
+unsigned
+replay_gain_filter_get_volume(const Filter *_filter)
+{
+	const ReplayGainFilter *filter = (const ReplayGainFilter *)_filter;
+
+	return filter->GetVolume();
+}
@@ -53,6 +53,7 @@
 
 #include <algorithm>
 
+#include <assert.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -107,6 +108,41 @@ class RouteFilter final : public Filter {
 	 */
 	PcmBuffer output_buffer;
 
+	/**
+	 * How the frames are routed; chosen by Open() from #sources
+	 * and the input format.
+	 */
+	enum class Plan {
+		/**
+		 * Each output channel gets the input channel with the
+		 * same number; the data is passed as-is.
+		 */
+		IDENTITY,
+
+		/**
+		 * No output channel has a source; fill with zeroes.
+		 */
+		SILENCE,
+
+		/**
+		 * All output channels get the same input channel,
+		 * e.g. mono to many.
+		 */
+		DUPLICATE,
+
+		/**
+		 * Any other combination of permutation, duplication
+		 * and silence, see #plan_sources.
+		 */
+		GENERIC,
+	} plan;
+
+	/**
+	 * A copy of #sources with all input channels which are not
+	 * present in the input format replaced with -1.
+	 */
+	int8_t plan_sources[MAX_CHANNELS];
+
 public:
 	/**
 	 * Parse the "routes" section, a string on the form
@@ -124,6 +160,28 @@ public:
 	void Close() override;
 	ConstBuffer<void> FilterPCM(ConstBuffer<void> src,
 				    Error &error) override;
+
+	bool IsInPlace() const override {
+		/* possible only if the frame size doesn't change */
+		return input_frame_size == output_frame_size;
+	}
+
+	bool FilterInPlace(WritableBuffer<void> data, Error &error) override;
+
+private:
+	/**
+	 * Choose the #plan for the current input format.
+	 */
+	void MakePlan();
+
+	/**
+	 * Route frames from #src to #dest using the #plan.  The
+	 * buffers must not overlap unless they are the same.
+	 */
+	template<typename T>
+	void Route(T *dest, const T *src, size_t n_frames) const;
+
+	void Route(void *dest, const void *src, size_t n_frames) const;
 };
 
 bool
@@ -230,66 +288,146 @@ RouteFilter::Open(AudioFormat &audio_format, gcc_unused Error &error)
 	// Precalculate this simple value, to speed up allocation later
 	output_frame_size = output_format.GetFrameSize();
 
+	MakePlan();
+
 	return output_format;
 }
 
+void
+RouteFilter::MakePlan()
+{
+	bool identity = min_output_channels == input_format.channels;
+	bool silence = true, duplicate = true;
+
+	for (unsigned c = 0; c < min_output_channels; ++c) {
+		int8_t source = sources[c];
+		if (source >= 0 && (unsigned)source >= input_format.channels)
+			source = -1;
+
+		plan_sources[c] = source;
+
+		if (source != (int8_t)c)
+			identity = false;
+		if (source >= 0)
+			silence = false;
+		if (source < 0 || source != plan_sources[0])
+			duplicate = false;
+	}
+
+	if (identity)
+		plan = Plan::IDENTITY;
+	else if (silence)
+		plan = Plan::SILENCE;
+	else if (duplicate)
+		plan = Plan::DUPLICATE;
+	else
+		plan = Plan::GENERIC;
+}
+
 void
 RouteFilter::Close()
 {
 	output_buffer.Clear();
 }
 
-ConstBuffer<void>
-RouteFilter::FilterPCM(ConstBuffer<void> src, gcc_unused Error &error)
+template<typename T>
+inline void
+RouteFilter::Route(T *dest, const T *src, size_t n_frames) const
 {
-	size_t number_of_frames = src.size / input_frame_size;
+	const unsigned in_channels = input_format.channels;
+	const unsigned out_channels = min_output_channels;
+
+	switch (plan) {
+	case Plan::IDENTITY:
+		if (dest != src)
+			std::copy_n(src, n_frames * out_channels, dest);
+		break;
+
+	case Plan::SILENCE:
+		std::fill_n(dest, n_frames * out_channels, T(0));
+		break;
+
+	case Plan::DUPLICATE:
+		for (size_t i = 0; i < n_frames; ++i) {
+			const T value = src[plan_sources[0]];
+			std::fill_n(dest, out_channels, value);
+			src += in_channels;
+			dest += out_channels;
+		}
 
-	const size_t bytes_per_frame_per_channel = input_format.GetSampleSize();
+		break;
 
-	// A moving pointer that always refers to channel 0 in the input, at the currently handled frame
-	const uint8_t *base_source = (const uint8_t *)src.data;
+	case Plan::GENERIC:
+		for (size_t i = 0; i < n_frames; ++i) {
+			/* copy the frame first, because it may be
+			   overwritten if the filter runs in place */
+			T frame[MAX_CHANNELS];
+			std::copy_n(src, in_channels, frame);
 
-	// Grow our reusable buffer, if needed, and set the moving pointer
-	const size_t result_size = number_of_frames * output_frame_size;
-	void *const result = output_buffer.Get(result_size);
+			for (unsigned c = 0; c < out_channels; ++c)
+				dest[c] = plan_sources[c] >= 0
+					? frame[plan_sources[c]]
+					: T(0);
 
-	// A moving pointer that always refers to the currently filled channel of the currently handled frame, in the output
-	uint8_t *chan_destination = (uint8_t *)result;
-
-	// Perform our copy operations, with N input channels and M output channels
-	for (unsigned int s=0; s<number_of_frames; ++s) {
-
-		// Need to perform one copy per output channel
-		for (unsigned int c=0; c<min_output_channels; ++c) {
-			if (sources[c] == -1 ||
-			    (unsigned)sources[c] >= input_format.channels) {
-				// No source for this destination output,
-				// give it zeroes as input
-				memset(chan_destination,
-					0x00,
-					bytes_per_frame_per_channel);
-			} else {
-				// Get the data from channel sources[c]
-				// and copy it to the output
-				const uint8_t *data = base_source +
-					(sources[c] * bytes_per_frame_per_channel);
-				memcpy(chan_destination,
-					  data,
-					  bytes_per_frame_per_channel);
-			}
-			// Move on to the next output channel
-			chan_destination += bytes_per_frame_per_channel;
+			src += in_channels;
+			dest += out_channels;
 		}
 
+		break;
+	}
+}
 
-		// Go on to the next N input samples
-		base_source += input_frame_size;
+void
+RouteFilter::Route(void *dest, const void *src, size_t n_frames) const
+{
+	switch (input_format.GetSampleSize()) {
+	case 1:
+		Route((uint8_t *)dest, (const uint8_t *)src, n_frames);
+		break;
+
+	case 2:
+		Route((uint16_t *)dest, (const uint16_t *)src, n_frames);
+		break;
+
+	case 4:
+		Route((uint32_t *)dest, (const uint32_t *)src, n_frames);
+		break;
+
+	default:
+		assert(false);
+		gcc_unreachable();
 	}
+}
+
+ConstBuffer<void>
+RouteFilter::FilterPCM(ConstBuffer<void> src, gcc_unused Error &error)
+{
+	if (plan == Plan::IDENTITY)
+		return src;
+
+	const size_t number_of_frames = src.size / input_frame_size;
+
+	// Grow our reusable buffer, if needed
+	const size_t result_size = number_of_frames * output_frame_size;
+	void *const result = output_buffer.Get(result_size);
+
+	Route(result, src.data, number_of_frames);
 
 	// Here it is, ladies and gentlemen! Rerouted data!
 	return { result, result_size };
 }
 
+bool
+RouteFilter::FilterInPlace(WritableBuffer<void> data, gcc_unused Error &error)
+{
+	assert(input_frame_size == output_frame_size);
+
+	/* the DUPLICATE and GENERIC plans read each input frame
+	   before writing the output frame at the same position */
+	Route(data.data, data.data, data.size / input_frame_size);
+	return true;
+}
+
 const struct filter_plugin route_filter_plugin = {
 	"route",
 	route_filter_init,
@@ -26,16 +26,34 @@
 #include "AudioFormat.hxx"
 #include "util/ConstBuffer.hxx"
 
+#include <stdint.h>
+
 class VolumeFilter final : public Filter {
 	PcmVolume pv;
 
+	/**
+	 * The volume set by the mixer.
+	 */
+	unsigned volume = PCM_VOLUME_1;
+
+	/**
+	 * An additional gain factor (#PCM_VOLUME_1 is unity),
+	 * e.g. replay gain, which is merged into the same pass.
+	 * This is only modified by the output thread.
+	 */
+	unsigned gain = PCM_VOLUME_1;
+
 public:
 	unsigned GetVolume() const {
-		return pv.GetVolume();
+		return volume;
 	}
 
 	void SetVolume(unsigned _volume) {
-		pv.SetVolume(_volume);
+		volume = _volume;
+	}
+
+	void SetGain(unsigned _gain) {
+		gain = _gain;
 	}
 
 	/* virtual methods from class Filter */
@@ -43,6 +61,28 @@ public:
 	void Close() override;
 	ConstBuffer<void> FilterPCM(ConstBuffer<void> src,
 				    Error &error) override;
+
+	bool IsInPlace() const override {
+		return true;
+	}
+
+	bool FilterInPlace(WritableBuffer<void> data, Error &) override {
+		Update();
+		pv.ApplyInPlace(data);
+		return true;
+	}
+
+private:
+	/**
+	 * Apply the current #volume and #gain to the #PcmVolume.
+	 * This is done right before filtering because #volume is
+	 * set by another thread.
+	 */
+	void Update() {
+		pv.SetVolume(gain == PCM_VOLUME_1
+			     ? volume
+			     : (uint64_t)volume * gain / PCM_VOLUME_1);
+	}
 };
 
 static Filter *
@@ -70,6 +110,7 @@ VolumeFilter::Close()
 ConstBuffer<void>
 VolumeFilter::FilterPCM(ConstBuffer<void> src, gcc_unused Error &error)
 {
+	Update();
 	return pv.Apply(src);
 }
 
@@ -95,3 +136,11 @@ volume_filter_set(Filter *_filter, unsigned volume)
 	filter->SetVolume(volume);
 }
 
+
+void
+volume_filter_set_gain(Filter *_filter, unsigned gain)
+{
+	VolumeFilter *filter = (VolumeFilter *)_filter;
+
+	filter->SetGain(gain);
+}
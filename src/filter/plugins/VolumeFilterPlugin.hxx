@@ -28,4 +28,12 @@ volume_filter_get(const Filter *filter);
 void
 volume_filter_set(Filter *filter, unsigned volume);
 
+/**
+ * Set an additional gain factor which is multiplied with the volume
+ * (#PCM_VOLUME_1 is unity).  This allows applying replay gain in
+ * the same pass as the software volume.
+ */
+void
+volume_filter_set_gain(Filter *filter, unsigned gain);
+
 #endif
@@ -23,6 +23,13 @@
 #include "Log.hxx"
 #include "lib/icu/Converter.hxx"
 #include "util/AllocatedString.hxx"
+#include "util/ASCII.hxx"
+
+#ifdef HAVE_FS_CHARSET
+#include "thread/Mutex.hxx"
+
+#include <list>
+#endif
 
 #ifdef WIN32
 #include "lib/icu/Win32.hxx"
@@ -41,17 +48,112 @@ static std::string fs_charset;
 
 static IcuConverter *fs_converter;
 
+/**
+ * A bounded cache of converted directory names.  The updater converts
+ * the paths of a directory's entries one after another, so most
+ * conversions share their directory part with the previous one, and
+ * only the last segment needs to be converted.
+ *
+ * This assumes that the separator is encoded as itself and that the
+ * charset has no shift states, which is true for all charsets which
+ * are usable for POSIX file names.
+ */
+class CharsetDirectoryCache {
+	static constexpr size_t MAX_ITEMS = 64;
+
+	struct Item {
+		std::string from, to;
+	};
+
+	Mutex mutex;
+
+	/**
+	 * The most recently used item comes first.
+	 */
+	std::list<Item> items;
+
+public:
+	bool Lookup(const std::string &from, std::string &to) {
+		const ScopeLock protect(mutex);
+
+		for (auto i = items.begin(); i != items.end(); ++i) {
+			if (i->from == from) {
+				items.splice(items.begin(), items, i);
+				to = i->to;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void Add(std::string &&from, const std::string &to) {
+		const ScopeLock protect(mutex);
+
+		items.push_front({std::move(from), to});
+		if (items.size() > MAX_ITEMS)
+			items.pop_back();
+	}
+
+	void Clear() {
+		const ScopeLock protect(mutex);
+		items.clear();
+	}
+};
+
+static CharsetDirectoryCache to_utf8_cache, from_utf8_cache;
+
+/**
+ * Convert a path with the given function, looking up the directory
+ * part in the cache.
+ */
+template<typename F>
+static std::string
+ConvertPathCached(CharsetDirectoryCache &cache, const char *path,
+		  F &&convert)
+{
+	const char *slash = strrchr(path, '/');
+	if (slash == nullptr || slash == path)
+		return convert(path);
+
+	std::string directory(path, slash);
+	std::string result;
+	if (!cache.Lookup(directory, result)) {
+		result = convert(directory.c_str());
+		cache.Add(std::move(directory), result);
+	}
+
+	result.push_back('/');
+	if (slash[1] != 0)
+		result.append(convert(slash + 1));
+	return result;
+}
+
+gcc_pure
+static bool
+IsUTF8Charset(const char *charset)
+{
+	return StringEqualsCaseASCII(charset, "UTF-8") ||
+		StringEqualsCaseASCII(charset, "UTF8");
+}
+
 void
 SetFSCharset(const char *charset)
 {
 	assert(charset != nullptr);
 	assert(fs_converter == nullptr);
 
+	if (IsUTF8Charset(charset)) {
+		/* no converter: paths are passed through as-is */
+		LogDebug(path_domain, "SetFSCharset: fs charset is UTF-8");
+		return;
+	}
+
 	fs_converter = IcuConverter::Create(charset);
 	assert(fs_converter != nullptr);
 
 	FormatDebug(path_domain,
-		    "SetFSCharset: fs charset is: %s", fs_charset.c_str());
+		    "SetFSCharset: fs charset is: %s", charset);
 }
 
 #endif
@@ -63,6 +165,11 @@ DeinitFSCharset()
 	delete fs_converter;
 	fs_converter = nullptr;
 #endif
+
+#ifdef HAVE_FS_CHARSET
+	to_utf8_cache.Clear();
+	from_utf8_cache.Clear();
+#endif
 }
 
 const char *
@@ -110,8 +217,10 @@ PathToUTF8(PathTraitsFS::const_pointer_type path_fs)
 		return FixSeparators(path_fs);
 #ifdef HAVE_FS_CHARSET
 
-	const auto buffer = fs_converter->ToUTF8(path_fs);
-	return FixSeparators(PathTraitsUTF8::string(buffer.c_str()));
+	return ConvertPathCached(to_utf8_cache, path_fs, [](const char *s){
+			const auto buffer = fs_converter->ToUTF8(s);
+			return std::string(buffer.c_str());
+		});
 #endif
 #endif
 }
@@ -133,8 +242,11 @@ PathFromUTF8(PathTraitsUTF8::const_pointer_type path_utf8)
 	if (fs_converter == nullptr)
 		return path_utf8;
 
-	const auto buffer = fs_converter->FromUTF8(path_utf8);
-	return PathTraitsFS::string(buffer.c_str());
+	return ConvertPathCached(from_utf8_cache, path_utf8,
+				 [](const char *s){
+			const auto buffer = fs_converter->FromUTF8(s);
+			return std::string(buffer.c_str());
+		});
 #endif
 }
 
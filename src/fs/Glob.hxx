@@ -51,6 +51,10 @@ public:
 
 	Glob(Glob &&other)
 		:pattern(std::move(other.pattern)) {}
+
+	const char *GetPattern() const {
+		return pattern.c_str();
+	}
 #endif
 
 	gcc_pure
@@ -49,10 +49,10 @@ BufferedReader::Fill(bool need_more)
 }
 
 char *
-BufferedReader::ReadLine()
+BufferedReader::ReadLine(size_t &length_r)
 {
 	do {
-		char *line = ReadBufferedLine(buffer);
+		char *line = ReadBufferedLine(buffer, length_r);
 		if (line != nullptr) {
 			++line_number;
 			return line;
@@ -72,7 +72,9 @@ BufferedReader::ReadLine()
 	/* terminate the last line */
 	w[0] = 0;
 
-	char *line = buffer.Read().data;
+	auto r = buffer.Read();
+	char *line = r.data;
+	length_r = r.size;
 	buffer.Clear();
 	++line_number;
 	return line;
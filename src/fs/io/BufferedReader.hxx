@@ -23,12 +23,20 @@
 #include "check.h"
 #include "Compiler.h"
 #include "util/DynamicFifoBuffer.hxx"
+#include "util/StringView.hxx"
 
 #include <stddef.h>
 
 class Reader;
 
 class BufferedReader {
+	/**
+	 * The initial buffer size.  Many lines fit into one read
+	 * window, so the (possibly decompressing) #Reader is called
+	 * rarely.
+	 */
+	static constexpr size_t INITIAL_SIZE = 64 * 1024;
+
 	static constexpr size_t MAX_SIZE = 512 * 1024;
 
 	Reader &reader;
@@ -41,7 +49,7 @@ class BufferedReader {
 
 public:
 	BufferedReader(Reader &_reader)
-		:reader(_reader), buffer(4096), eof(false),
+		:reader(_reader), buffer(INITIAL_SIZE), eof(false),
 		 line_number(0) {}
 
 	bool Fill(bool need_more);
@@ -55,11 +63,39 @@ public:
 		buffer.Consume(n);
 	}
 
-	char *ReadLine();
+	/**
+	 * Read one line (without the line terminator).  It is
+	 * null-terminated in place and remains valid until the next
+	 * call.
+	 *
+	 * @return the line, or nullptr at the end of the file
+	 */
+	char *ReadLine() {
+		size_t length;
+		return ReadLine(length);
+	}
+
+	/**
+	 * Like ReadLine(), but returns a #StringView, which saves the
+	 * caller a strlen() call.  The line is still null-terminated.
+	 *
+	 * @return the line, or a "nulled" #StringView at the end of
+	 * the file
+	 */
+	StringView ReadLineView() {
+		size_t length;
+		const char *line = ReadLine(length);
+		return line != nullptr
+			? StringView(line, length)
+			: StringView(nullptr);
+	}
 
 	unsigned GetLineNumber() const {
 		return line_number;
 	}
+
+private:
+	char *ReadLine(size_t &length_r);
 };
 
 #endif
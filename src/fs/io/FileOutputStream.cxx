@@ -62,6 +62,12 @@ BaseFileOutputStream::Write(const void *data, size_t size)
 				      GetPath().c_str());
 }
 
+void
+FileOutputStream::Preallocate(gcc_unused uint64_t size)
+{
+	assert(IsDefined());
+}
+
 void
 FileOutputStream::Commit()
 {
@@ -146,11 +152,30 @@ BaseFileOutputStream::Write(const void *data, size_t size)
 				  GetPath().c_str());
 }
 
+void
+FileOutputStream::Preallocate(gcc_unused uint64_t size)
+{
+	assert(IsDefined());
+
+#ifdef __linux__
+	if (fallocate(GetFD().Get(), FALLOC_FL_KEEP_SIZE, 0, size) == 0)
+		preallocated = true;
+#endif
+}
+
 void
 FileOutputStream::Commit()
 {
 	assert(IsDefined());
 
+#ifdef __linux__
+	if (preallocated &&
+	    ftruncate(GetFD().Get(), GetFD().Tell()) < 0) {
+		/* not fatal: the reserved space beyond the end of
+		   the file remains allocated */
+	}
+#endif
+
 #if HAVE_LINKAT
 	if (is_tmpfile) {
 		RemoveFile(GetPath());
@@ -131,6 +131,14 @@ class FileOutputStream final : public BaseFileOutputStream {
 	bool is_tmpfile;
 #endif
 
+#ifdef __linux__
+	/**
+	 * Was Preallocate() successful?  Then Commit() needs to
+	 * release the space which was not used.
+	 */
+	bool preallocated = false;
+#endif
+
 public:
 	FileOutputStream(Path _path);
 
@@ -139,6 +147,14 @@ public:
 			Cancel();
 	}
 
+	/**
+	 * Reserve disk space for the given number of bytes without
+	 * changing the file size.  This is only a hint which reduces
+	 * fragmentation and the allocation overhead of the following
+	 * writes; errors are ignored.
+	 */
+	void Preallocate(uint64_t size);
+
 	void Commit();
 	void Cancel();
 };
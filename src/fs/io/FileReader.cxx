@@ -22,6 +22,10 @@
 #include "fs/FileInfo.hxx"
 #include "system/Error.hxx"
 
+#ifdef USE_IO_URING
+#include <atomic>
+#endif
+
 #ifdef WIN32
 
 FileReader::FileReader(Path _path)
@@ -107,15 +111,56 @@ FileReader::GetFileInfo() const
 	return info;
 }
 
+#ifdef USE_IO_URING
+
+/**
+ * Switch to io_uring after this number of bytes has been read
+ * sequentially.
+ */
+static constexpr uint64_t URING_THRESHOLD = 256 * 1024;
+
+/**
+ * Set after io_uring has failed once (e.g. because the kernel is too
+ * old or because it has been disabled by a seccomp filter), to
+ * avoid trying again for each file.
+ */
+static std::atomic_bool uring_failed;
+
+inline void
+FileReader::StartReadAhead()
+{
+	if (uring_failed.load(std::memory_order_relaxed))
+		return;
+
+	try {
+		read_ahead.reset(new UringReadAhead(fd.Get(), fd.Tell()));
+	} catch (const std::system_error &) {
+		uring_failed = true;
+	}
+}
+
+#endif
+
 size_t
 FileReader::Read(void *data, size_t size)
 {
 	assert(IsDefined());
 
+#ifdef USE_IO_URING
+	if (read_ahead != nullptr)
+		return read_ahead->Read(data, size);
+#endif
+
 	ssize_t nbytes = fd.Read(data, size);
 	if (nbytes < 0)
 		throw FormatErrno("Failed to read from %s", path.ToUTF8().c_str());
 
+#ifdef USE_IO_URING
+	sequential += nbytes;
+	if (sequential >= URING_THRESHOLD)
+		StartReadAhead();
+#endif
+
 	return nbytes;
 }
 
@@ -124,6 +169,15 @@ FileReader::Seek(off_t offset)
 {
 	assert(IsDefined());
 
+#ifdef USE_IO_URING
+	if (read_ahead != nullptr) {
+		read_ahead->Seek(offset);
+		return;
+	}
+
+	sequential = 0;
+#endif
+
 	auto result = fd.Seek(offset);
 	const bool success = result >= 0;
 	if (!success)
@@ -135,6 +189,13 @@ FileReader::Skip(off_t offset)
 {
 	assert(IsDefined());
 
+#ifdef USE_IO_URING
+	if (read_ahead != nullptr) {
+		read_ahead->Seek(read_ahead->GetOffset() + offset);
+		return;
+	}
+#endif
+
 	auto result = fd.Skip(offset);
 	const bool success = result >= 0;
 	if (!success)
@@ -146,6 +207,10 @@ FileReader::Close()
 {
 	assert(IsDefined());
 
+#ifdef USE_IO_URING
+	read_ahead.reset();
+#endif
+
 	fd.Close();
 }
 
@@ -29,6 +29,12 @@
 #include "system/FileDescriptor.hxx"
 #endif
 
+#ifdef USE_IO_URING
+#include "UringReadAhead.hxx"
+
+#include <memory>
+#endif
+
 #ifdef WIN32
 #include <windows.h>
 #endif
@@ -45,6 +51,21 @@ class FileReader final : public Reader {
 	FileDescriptor fd;
 #endif
 
+#ifdef USE_IO_URING
+	/**
+	 * Reads ahead with io_uring.  It is created after the file
+	 * has been read sequentially for a while, so short reads
+	 * (e.g. scanning tags) don't pay for setting it up.
+	 */
+	std::unique_ptr<UringReadAhead> read_ahead;
+
+	/**
+	 * The number of bytes read with read() since the file was
+	 * opened or since the last seek.
+	 */
+	uint64_t sequential = 0;
+#endif
+
 public:
 	FileReader(Path _path);
 
@@ -57,7 +78,12 @@ public:
 #else
 	FileReader(FileReader &&other)
 		:path(std::move(other.path)),
-		 fd(other.fd) {
+		 fd(other.fd)
+#ifdef USE_IO_URING
+		, read_ahead(std::move(other.read_ahead)),
+		 sequential(other.sequential)
+#endif
+	{
 		other.fd.SetUndefined();
 	}
 #endif
@@ -94,6 +120,11 @@ public:
 
 	/* virtual methods from class Reader */
 	size_t Read(void *data, size_t size) override;
+
+#ifdef USE_IO_URING
+private:
+	void StartReadAhead();
+#endif
 };
 
 #endif
@@ -21,7 +21,8 @@
 #include "GzipOutputStream.hxx"
 #include "lib/zlib/Error.hxx"
 
-GzipOutputStream::GzipOutputStream(OutputStream &_next) throw(ZlibError)
+GzipOutputStream::GzipOutputStream(OutputStream &_next,
+				   int level) throw(ZlibError)
 	:next(_next)
 {
 	z.next_in = nullptr;
@@ -33,7 +34,7 @@ GzipOutputStream::GzipOutputStream(OutputStream &_next) throw(ZlibError)
 	constexpr int windowBits = 15;
 	constexpr int gzip_encoding = 16;
 
-	int result = deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+	int result = deflateInit2(&z, level, Z_DEFLATED,
 				  windowBits | gzip_encoding,
 				  8, Z_DEFAULT_STRATEGY);
 	if (result != Z_OK)
@@ -68,6 +69,32 @@ GzipOutputStream::Flush()
 	}
 }
 
+void
+GzipOutputStream::SyncFlush()
+{
+	/* no more input */
+	z.next_in = nullptr;
+	z.avail_in = 0;
+
+	while (true) {
+		Bytef output[4096];
+		z.next_out = output;
+		z.avail_out = sizeof(output);
+
+		int result = deflate(&z, Z_SYNC_FLUSH);
+		if (result != Z_OK && result != Z_BUF_ERROR)
+			throw ZlibError(result);
+
+		if (z.next_out > output)
+			next.Write(output, z.next_out - output);
+
+		/* if there was room left in the output buffer, zlib
+		   has flushed everything */
+		if (z.avail_out > 0)
+			break;
+	}
+}
+
 void
 GzipOutputStream::Write(const void *_data, size_t size)
 {
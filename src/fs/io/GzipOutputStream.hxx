@@ -41,8 +41,11 @@ class GzipOutputStream final : public OutputStream {
 public:
 	/**
 	 * Construct the filter.
+	 *
+	 * @param level the zlib compression level (0..9)
 	 */
-	GzipOutputStream(OutputStream &_next) throw(ZlibError);
+	GzipOutputStream(OutputStream &_next,
+			 int level=Z_DEFAULT_COMPRESSION) throw(ZlibError);
 	~GzipOutputStream();
 
 	/**
@@ -51,6 +54,13 @@ public:
 	 */
 	void Flush();
 
+	/**
+	 * Write all data remaining in zlib's output buffer, without
+	 * finishing the stream, so the receiver can decode everything
+	 * which has been written so far.
+	 */
+	void SyncFlush();
+
 	/* virtual methods from class OutputStream */
 	void Write(const void *data, size_t size) override;
 };
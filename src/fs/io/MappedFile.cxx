@@ -0,0 +1,82 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "MappedFile.hxx"
+#include "FileReader.hxx"
+#include "fs/FileInfo.hxx"
+#include "system/Error.hxx"
+
+#include <stdexcept>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
+
+MappedFile::MappedFile(Path path, bool sequential)
+	:data(nullptr), size(0)
+{
+	FileReader reader(path);
+
+	const uint64_t file_size = reader.GetFileInfo().GetSize();
+	if (file_size > SIZE_MAX)
+		throw std::runtime_error("File is too large");
+
+	if (file_size == 0)
+		return;
+
+#ifdef WIN32
+	(void)sequential;
+
+	buffer.reset(new uint8_t[file_size]);
+	for (size_t position = 0; position < file_size;) {
+		size_t nbytes = reader.Read(buffer.get() + position,
+					    file_size - position);
+		if (nbytes == 0)
+			throw std::runtime_error("Unexpected end of file");
+		position += nbytes;
+	}
+
+	data = buffer.get();
+#else
+	void *p = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE,
+		       reader.GetFD().Get(), 0);
+	if (p == MAP_FAILED)
+		throw MakeErrno("Failed to map file");
+
+#ifdef MADV_SEQUENTIAL
+	if (sequential)
+		madvise(p, file_size, MADV_SEQUENTIAL);
+#else
+	(void)sequential;
+#endif
+
+	data = (const uint8_t *)p;
+#endif
+
+	size = file_size;
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef WIN32
+	if (size > 0)
+		munmap(const_cast<uint8_t *>(data), size);
+#endif
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_MAPPED_FILE_HXX
+#define MPD_MAPPED_FILE_HXX
+
+#include "check.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef WIN32
+#include <memory>
+#endif
+
+class Path;
+
+/**
+ * A read-only file mapped into memory (or, on Windows, read into a
+ * buffer).
+ */
+class MappedFile {
+	const uint8_t *data;
+	size_t size;
+
+#ifdef WIN32
+	std::unique_ptr<uint8_t[]> buffer;
+#endif
+
+public:
+	/**
+	 * Throws std::runtime_error on error.
+	 *
+	 * @param sequential hint that the whole file will be read
+	 * from start to end
+	 */
+	explicit MappedFile(Path path, bool sequential=false);
+
+	~MappedFile();
+
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	const uint8_t *GetData() const {
+		return data;
+	}
+
+	size_t GetSize() const {
+		return size;
+	}
+};
+
+#endif
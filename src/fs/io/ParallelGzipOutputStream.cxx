@@ -0,0 +1,334 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "ParallelGzipOutputStream.hxx"
+#include "lib/zlib/Error.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Name.hxx"
+#include "util/ScopeExit.hxx"
+#include "util/Error.hxx"
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include <zlib.h>
+#include <assert.h>
+#include <string.h>
+
+/**
+ * The size of the deflate window; this much of the previous block is
+ * used as preset dictionary.
+ */
+static constexpr size_t DICTIONARY_SIZE = 32768;
+
+/**
+ * The amount of uncompressed data per block.
+ */
+static constexpr size_t BLOCK_SIZE = 256 * 1024;
+
+struct ParallelGzipOutputStream::Job {
+	std::unique_ptr<Bytef[]> input;
+	size_t input_size = 0;
+
+	Bytef dictionary[DICTIONARY_SIZE];
+	size_t dictionary_size = 0;
+
+	std::unique_ptr<Bytef[]> output;
+	size_t output_size;
+
+	uint32_t crc;
+
+	enum class State {
+		QUEUED,
+		RUNNING,
+		DONE,
+	} state = State::QUEUED;
+
+	/**
+	 * Is this the last block?  Only the last block is
+	 * terminated with Z_FINISH; all others end with an empty
+	 * stored block (Z_SYNC_FLUSH), so they can be concatenated.
+	 */
+	bool last = false;
+
+	std::exception_ptr error;
+
+	explicit Job(size_t block_size)
+		:input(new Bytef[block_size]) {}
+
+	/**
+	 * Throws #ZlibError on error.
+	 */
+	void Run(int level);
+};
+
+void
+ParallelGzipOutputStream::Job::Run(int level)
+{
+	crc = crc32(0, input.get(), input_size);
+
+	z_stream z;
+	z.zalloc = Z_NULL;
+	z.zfree = Z_NULL;
+	z.opaque = Z_NULL;
+
+	/* raw deflate; the gzip header and trailer are written by
+	   the caller */
+	constexpr int windowBits = -15;
+
+	int result = deflateInit2(&z, level, Z_DEFLATED, windowBits,
+				  8, Z_DEFAULT_STRATEGY);
+	if (result != Z_OK)
+		throw ZlibError(result);
+
+	AtScopeExit(&z) { deflateEnd(&z); };
+
+	if (dictionary_size > 0) {
+		result = deflateSetDictionary(&z, dictionary,
+					      dictionary_size);
+		if (result != Z_OK)
+			throw ZlibError(result);
+	}
+
+	/* reserve a few more bytes for the empty stored block
+	   emitted by Z_SYNC_FLUSH */
+	const size_t max_size = deflateBound(&z, input_size) + 16;
+	output.reset(new Bytef[max_size]);
+
+	z.next_in = input.get();
+	z.avail_in = input_size;
+	z.next_out = output.get();
+	z.avail_out = max_size;
+
+	result = deflate(&z, last ? Z_FINISH : Z_SYNC_FLUSH);
+	if (result != (last ? Z_STREAM_END : Z_OK))
+		throw ZlibError(result);
+
+	if (z.avail_in > 0 || z.avail_out == 0)
+		/* should not happen, deflateBound() promises enough
+		   room */
+		throw ZlibError(Z_BUF_ERROR);
+
+	output_size = z.next_out - output.get();
+
+	/* the input is not needed anymore */
+	input.reset();
+}
+
+ParallelGzipOutputStream::ParallelGzipOutputStream(OutputStream &_next,
+						   int _level,
+						   unsigned _n_threads)
+	:next(_next), level(_level), block_size(BLOCK_SIZE),
+	 max_jobs(_n_threads * 2),
+	 n_threads(_n_threads), threads(new Thread[_n_threads]),
+	 crc(crc32(0, Z_NULL, 0))
+{
+	assert(n_threads > 0);
+
+	/* the gzip header: no file name, no time stamp, OS=Unix */
+	static constexpr uint8_t header[10] = {
+		0x1f, 0x8b, Z_DEFLATED, 0, 0, 0, 0, 0, 0, 3,
+	};
+
+	next.Write(header, sizeof(header));
+
+	for (unsigned i = 0; i < n_threads; ++i) {
+		Error error;
+		if (!threads[i].Start(ThreadFunc, this, error)) {
+			mutex.lock();
+			quit = true;
+			cond.broadcast();
+			mutex.unlock();
+
+			for (unsigned j = 0; j < i; ++j)
+				threads[j].Join();
+
+			throw std::runtime_error(error.GetMessage());
+		}
+	}
+}
+
+ParallelGzipOutputStream::~ParallelGzipOutputStream()
+{
+	mutex.lock();
+	quit = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	for (unsigned i = 0; i < n_threads; ++i)
+		threads[i].Join();
+
+	for (Job *job : jobs)
+		delete job;
+
+	delete current;
+}
+
+inline ParallelGzipOutputStream::Job *
+ParallelGzipOutputStream::FindQueued()
+{
+	for (Job *job : jobs)
+		if (job->state == Job::State::QUEUED)
+			return job;
+
+	return nullptr;
+}
+
+void
+ParallelGzipOutputStream::Submit(bool last)
+{
+	assert(current != nullptr);
+
+	Job *job = current;
+	job->last = last;
+
+	if (last)
+		current = nullptr;
+	else {
+		/* the new block gets the end of this one as
+		   dictionary; copy it now, because the worker
+		   thread frees the input buffer when it is done */
+		current = new Job(block_size);
+		current->dictionary_size = std::min(job->input_size,
+						    DICTIONARY_SIZE);
+		memcpy(current->dictionary,
+		       job->input.get() + job->input_size
+		       - current->dictionary_size,
+		       current->dictionary_size);
+	}
+
+	const ScopeLock protect(mutex);
+	jobs.push_back(job);
+	cond.broadcast();
+}
+
+void
+ParallelGzipOutputStream::WriteFinished(size_t keep)
+{
+	const ScopeLock protect(mutex);
+
+	while (!jobs.empty()) {
+		Job *job = jobs.front();
+		if (job->state != Job::State::DONE) {
+			if (jobs.size() <= keep)
+				break;
+
+			cond.wait(mutex);
+			continue;
+		}
+
+		jobs.pop_front();
+
+		const ScopeUnlock unlock(mutex);
+		std::unique_ptr<Job> holder(job);
+
+		if (job->error)
+			std::rethrow_exception(job->error);
+
+		next.Write(job->output.get(), job->output_size);
+
+		crc = crc32_combine(crc, job->crc, job->input_size);
+		total_size += job->input_size;
+	}
+}
+
+void
+ParallelGzipOutputStream::Flush()
+{
+	if (current == nullptr)
+		current = new Job(block_size);
+
+	Submit(true);
+	WriteFinished(0);
+
+	/* the gzip trailer: CRC32 and ISIZE, little-endian */
+	const uint8_t trailer[8] = {
+		uint8_t(crc), uint8_t(crc >> 8),
+		uint8_t(crc >> 16), uint8_t(crc >> 24),
+		uint8_t(total_size), uint8_t(total_size >> 8),
+		uint8_t(total_size >> 16), uint8_t(total_size >> 24),
+	};
+
+	next.Write(trailer, sizeof(trailer));
+}
+
+void
+ParallelGzipOutputStream::Write(const void *_data, size_t size)
+{
+	const uint8_t *data = (const uint8_t *)_data;
+
+	while (size > 0) {
+		if (current == nullptr)
+			current = new Job(block_size);
+
+		const size_t nbytes = std::min(block_size - current->input_size,
+					       size);
+		memcpy(current->input.get() + current->input_size,
+		       data, nbytes);
+		current->input_size += nbytes;
+		data += nbytes;
+		size -= nbytes;
+
+		if (current->input_size == block_size) {
+			Submit(false);
+			WriteFinished(max_jobs);
+		}
+	}
+}
+
+inline void
+ParallelGzipOutputStream::Run()
+{
+	const ScopeLock protect(mutex);
+
+	while (!quit) {
+		Job *job = FindQueued();
+		if (job == nullptr) {
+			cond.wait(mutex);
+			continue;
+		}
+
+		job->state = Job::State::RUNNING;
+
+		{
+			const ScopeUnlock unlock(mutex);
+
+			try {
+				job->Run(level);
+			} catch (...) {
+				job->error = std::current_exception();
+			}
+		}
+
+		job->state = Job::State::DONE;
+		cond.broadcast();
+	}
+}
+
+void
+ParallelGzipOutputStream::ThreadFunc(void *ctx)
+{
+	SetThreadName("gzip");
+
+	ParallelGzipOutputStream &s = *(ParallelGzipOutputStream *)ctx;
+	s.Run();
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PARALLEL_GZIP_OUTPUT_STREAM_HXX
+#define MPD_PARALLEL_GZIP_OUTPUT_STREAM_HXX
+
+#include "check.h"
+#include "OutputStream.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+
+#include <deque>
+#include <memory>
+
+#include <stdint.h>
+
+class Thread;
+
+/**
+ * A replacement for #GzipOutputStream which compresses on several
+ * threads.  The input is split into blocks which are deflated
+ * independently (each with the end of its predecessor as preset
+ * dictionary, like pigz does), and the results are concatenated to
+ * one regular gzip stream; the output can be decoded by
+ * #GunzipReader and by any other gzip implementation.
+ */
+class ParallelGzipOutputStream final : public OutputStream {
+	struct Job;
+
+	OutputStream &next;
+
+	const int level;
+
+	const size_t block_size;
+
+	/**
+	 * The maximum number of submitted blocks which have not been
+	 * written to #next yet.  Write() blocks when this limit is
+	 * reached.
+	 */
+	const size_t max_jobs;
+
+	const unsigned n_threads;
+	std::unique_ptr<Thread[]> threads;
+
+	Mutex mutex;
+
+	/**
+	 * Signalled by the caller when it submits a block or when the
+	 * threads shall quit, and by a worker thread when it has
+	 * finished a block.
+	 */
+	Cond cond;
+
+	/**
+	 * Submitted blocks in stream order; protected by #mutex.
+	 */
+	std::deque<Job *> jobs;
+
+	/**
+	 * The block which is being filled by Write().
+	 */
+	Job *current = nullptr;
+
+	/**
+	 * The CRC32 and the length of all data which has been written
+	 * to #next; needed for the gzip trailer.
+	 */
+	uint32_t crc, total_size = 0;
+
+	bool quit = false;
+
+public:
+	/**
+	 * Throws std::exception on error.
+	 *
+	 * @param level the zlib compression level (0..9)
+	 * @param n_threads the number of worker threads (at least 1)
+	 */
+	ParallelGzipOutputStream(OutputStream &_next, int level,
+				 unsigned n_threads);
+
+	~ParallelGzipOutputStream();
+
+	/**
+	 * Finish the file: compress all data which has been passed
+	 * to Write() and write it, followed by the gzip trailer.
+	 *
+	 * Throws std::exception on error.
+	 */
+	void Flush();
+
+	/* virtual methods from class OutputStream */
+	void Write(const void *data, size_t size) override;
+
+private:
+	/**
+	 * Pass #current to the worker threads.
+	 *
+	 * @param last is this the last block of the stream?
+	 */
+	void Submit(bool last);
+
+	/**
+	 * Write all finished blocks at the head of the queue to
+	 * #next, and wait until at most #keep blocks are left.
+	 */
+	void WriteFinished(size_t keep);
+
+	/**
+	 * Find the oldest block which has not been picked up by a
+	 * worker thread yet.  Caller must lock the mutex.
+	 */
+	Job *FindQueued();
+
+	void Run();
+	static void ThreadFunc(void *ctx);
+};
+
+#endif
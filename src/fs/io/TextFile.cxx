@@ -57,3 +57,11 @@ TextFile::ReadLine()
 
 	return buffered_reader->ReadLine();
 }
+
+StringView
+TextFile::ReadLineView()
+{
+	assert(buffered_reader != nullptr);
+
+	return buffered_reader->ReadLineView();
+}
@@ -23,6 +23,7 @@
 #include "check.h"
 #include "Compiler.h"
 
+struct StringView;
 class Path;
 class FileReader;
 class AutoGunzipReader;
@@ -52,6 +53,14 @@ public:
 	 * @return a pointer to the line, or nullptr on end-of-file
 	 */
 	char *ReadLine();
+
+	/**
+	 * Like ReadLine(), but returns a #StringView which knows the
+	 * length of the line (it is still null-terminated).
+	 *
+	 * @return the line, or a "nulled" #StringView on end-of-file
+	 */
+	StringView ReadLineView();
 };
 
 #endif
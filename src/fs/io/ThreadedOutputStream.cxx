@@ -0,0 +1,169 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "ThreadedOutputStream.hxx"
+#include "thread/Name.hxx"
+#include "util/HugeAllocator.hxx"
+#include "util/Error.hxx"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <assert.h>
+#include <string.h>
+
+static uint8_t *
+AllocateBuffer(size_t size)
+{
+	void *p = HugeAllocate(size);
+	if (p == nullptr)
+		throw std::bad_alloc();
+
+	return (uint8_t *)p;
+}
+
+ThreadedOutputStream::ThreadedOutputStream(OutputStream &_next,
+					   size_t _buffer_size,
+					   Policy _policy)
+	:next(_next), policy(_policy), buffer_size(_buffer_size),
+	 buffer(AllocateBuffer(_buffer_size), _buffer_size)
+{
+	Error thread_error;
+	if (!thread.Start(ThreadFunc, this, thread_error)) {
+		HugeFree(buffer.Write().data, buffer_size);
+		throw std::runtime_error(thread_error.GetMessage());
+	}
+}
+
+ThreadedOutputStream::~ThreadedOutputStream()
+{
+	mutex.lock();
+	quit = true;
+	cond.broadcast();
+	mutex.unlock();
+
+	thread.Join();
+
+	buffer.Clear();
+	HugeFree(buffer.Write().data, buffer_size);
+}
+
+void
+ThreadedOutputStream::Flush()
+{
+	const ScopeLock protect(mutex);
+
+	while (!buffer.IsEmpty() && !error)
+		cond.wait(mutex);
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+void
+ThreadedOutputStream::Write(const void *_data, size_t size)
+{
+	const uint8_t *data = (const uint8_t *)_data;
+
+	const ScopeLock protect(mutex);
+
+	if (error)
+		std::rethrow_exception(error);
+
+	if (policy == Policy::DROP && buffer.GetSpace() < size) {
+		/* never write a fraction of a block; the
+		   destination is more likely to recover from a gap
+		   than from a truncated block */
+		dropped += size;
+		return;
+	}
+
+	while (size > 0) {
+		auto w = buffer.Write();
+		if (w.IsEmpty()) {
+			cond.wait(mutex);
+
+			if (error)
+				std::rethrow_exception(error);
+
+			continue;
+		}
+
+		const size_t nbytes = std::min(w.size, size);
+
+		{
+			/* the writer thread never touches the free
+			   part of the buffer */
+			const ScopeUnlock unlock(mutex);
+			memcpy(w.data, data, nbytes);
+		}
+
+		if (error)
+			/* the writer thread has failed and cleared
+			   the buffer meanwhile */
+			std::rethrow_exception(error);
+
+		buffer.Append(nbytes);
+		cond.broadcast();
+
+		data += nbytes;
+		size -= nbytes;
+	}
+}
+
+inline void
+ThreadedOutputStream::Run()
+{
+	const ScopeLock protect(mutex);
+
+	while (!quit) {
+		auto r = buffer.Read();
+		if (r.IsEmpty() || error) {
+			cond.wait(mutex);
+			continue;
+		}
+
+		try {
+			const ScopeUnlock unlock(mutex);
+			next.Write(r.data, r.size);
+		} catch (...) {
+			error = std::current_exception();
+
+			/* discard everything; the caller will see
+			   the error in its next call */
+			buffer.Clear();
+			cond.broadcast();
+			continue;
+		}
+
+		buffer.Consume(r.size);
+		cond.broadcast();
+	}
+}
+
+void
+ThreadedOutputStream::ThreadFunc(void *ctx)
+{
+	SetThreadName("writer");
+
+	ThreadedOutputStream &s = *(ThreadedOutputStream *)ctx;
+	s.Run();
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_THREADED_OUTPUT_STREAM_HXX
+#define MPD_THREADED_OUTPUT_STREAM_HXX
+
+#include "check.h"
+#include "OutputStream.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "thread/Thread.hxx"
+#include "util/CircularBuffer.hxx"
+
+#include <exception>
+
+#include <stdint.h>
+
+/**
+ * An #OutputStream which copies all data into a bounded buffer and
+ * lets a separate thread write it to another #OutputStream.  This
+ * decouples the caller from a slow destination (e.g. a network file
+ * system).
+ */
+class ThreadedOutputStream final : public OutputStream {
+public:
+	/**
+	 * What Write() does when the buffer is full.
+	 */
+	enum class Policy {
+		/**
+		 * Wait until the writer thread has made room.
+		 */
+		BLOCK,
+
+		/**
+		 * Discard the data passed to this Write() call.
+		 */
+		DROP,
+	};
+
+private:
+	OutputStream &next;
+
+	const Policy policy;
+
+	const size_t buffer_size;
+
+	Thread thread;
+
+	mutable Mutex mutex;
+
+	/**
+	 * Signalled by the writer thread when it has consumed data,
+	 * and by the caller when it has appended data or when the
+	 * thread shall quit.
+	 */
+	Cond cond;
+
+	CircularBuffer<uint8_t> buffer;
+
+	/**
+	 * An error thrown by #next, to be rethrown to the caller.
+	 * After that, the writer thread discards all data.
+	 */
+	std::exception_ptr error;
+
+	/**
+	 * The number of bytes which were discarded because of
+	 * Policy::DROP.
+	 */
+	uint64_t dropped = 0;
+
+	bool quit = false;
+
+public:
+	/**
+	 * Throws std::exception on error.
+	 */
+	ThreadedOutputStream(OutputStream &_next, size_t _buffer_size,
+			     Policy _policy);
+
+	/**
+	 * Stops the writer thread.  Data which has not been written
+	 * yet is discarded; call Flush() before to avoid that.
+	 */
+	~ThreadedOutputStream();
+
+	/**
+	 * Wait until all buffered data has been written to the
+	 * underlying #OutputStream.
+	 *
+	 * Throws std::exception on error.
+	 */
+	void Flush();
+
+	uint64_t GetDropped() const {
+		const ScopeLock protect(mutex);
+		return dropped;
+	}
+
+	/* virtual methods from class OutputStream */
+	void Write(const void *data, size_t size) override;
+
+private:
+	void Run();
+	static void ThreadFunc(void *ctx);
+};
+
+#endif
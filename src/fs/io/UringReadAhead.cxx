@@ -0,0 +1,138 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#ifdef USE_IO_URING
+#include "UringReadAhead.hxx"
+#include "system/Error.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <errno.h>
+#include <string.h>
+
+UringReadAhead::UringReadAhead(int _fd, off_t offset)
+	:ring(2), fd(_fd),
+	 current_offset(offset), next_offset(offset)
+{
+	buffers[0].reset(new uint8_t[CHUNK_SIZE]);
+	buffers[1].reset(new uint8_t[CHUNK_SIZE]);
+}
+
+UringReadAhead::~UringReadAhead()
+{
+	/* the kernel may still be writing to the buffer */
+	if (pending)
+		WaitRead();
+}
+
+void
+UringReadAhead::StartRead()
+{
+	assert(!pending);
+
+	iov.iov_base = buffers[current ^ 1].get();
+	iov.iov_len = CHUNK_SIZE;
+
+	io_uring_sqe *sqe = ring.GetSqe();
+	assert(sqe != nullptr);
+
+	/* IORING_OP_READV works with all io_uring kernels (Linux
+	   5.1), IORING_OP_READ would require 5.6 */
+	sqe->opcode = IORING_OP_READV;
+	sqe->fd = fd;
+	sqe->off = next_offset;
+	sqe->addr = (uintptr_t)&iov;
+	sqe->len = 1;
+
+	ring.Submit();
+
+	pending = true;
+}
+
+int
+UringReadAhead::WaitRead()
+{
+	assert(pending);
+
+	io_uring_cqe *cqe;
+	while ((cqe = ring.PeekCqe()) == nullptr) {
+		int result = ring.Submit(1);
+		if (result < 0 && result != -EINTR)
+			return result;
+	}
+
+	const int result = cqe->res;
+	ring.SeenCqe();
+	pending = false;
+
+	current ^= 1;
+	current_offset = next_offset;
+	position = 0;
+	end = std::max(result, 0);
+	next_offset += end;
+
+	return result;
+}
+
+size_t
+UringReadAhead::Read(void *data, size_t size)
+{
+	if (position == end) {
+		if (eof)
+			return 0;
+
+		if (!pending)
+			StartRead();
+
+		const int result = WaitRead();
+		if (result < 0)
+			throw MakeErrno(-result, "Failed to read");
+
+		if (result == 0) {
+			eof = true;
+			return 0;
+		}
+
+		/* read the next chunk while the caller consumes this
+		   one */
+		StartRead();
+	}
+
+	const size_t nbytes = std::min(size, end - position);
+	memcpy(data, buffers[current].get() + position, nbytes);
+	position += nbytes;
+	return nbytes;
+}
+
+void
+UringReadAhead::Seek(off_t offset)
+{
+	if (pending)
+		/* discard the read-ahead */
+		WaitRead();
+
+	current_offset = next_offset = offset;
+	position = end = 0;
+	eof = false;
+}
+
+#endif /* USE_IO_URING */
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_URING_READ_AHEAD_HXX
+#define MPD_URING_READ_AHEAD_HXX
+
+#include "check.h"
+#include "system/IoUring.hxx"
+
+#include <memory>
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/**
+ * Reads a file sequentially with io_uring, keeping one read of
+ * #CHUNK_SIZE bytes in flight while the caller consumes the
+ * previous one.  This overlaps disk I/O with decoding and needs far
+ * fewer system calls than a read() for each small request.
+ *
+ * Each instance has its own (small) io_uring, so it can be used by
+ * any thread, but only by one at a time.
+ */
+class UringReadAhead {
+	static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+	IoUring ring;
+
+	const int fd;
+
+	std::unique_ptr<uint8_t[]> buffers[2];
+
+	/**
+	 * The index of the buffer which is being consumed; the other
+	 * one may be the target of the pending read.
+	 */
+	unsigned current = 0;
+
+	/**
+	 * The portion of the current buffer which has not yet been
+	 * consumed.
+	 */
+	size_t position = 0, end = 0;
+
+	/**
+	 * The file offset of the current buffer.
+	 */
+	off_t current_offset;
+
+	/**
+	 * The file offset of the next read request.
+	 */
+	off_t next_offset;
+
+	/**
+	 * The destination of the pending read.
+	 */
+	struct iovec iov;
+
+	/**
+	 * Is a read into the other buffer pending?
+	 */
+	bool pending = false;
+
+	bool eof = false;
+
+public:
+	/**
+	 * Throws std::system_error if io_uring is not available.
+	 *
+	 * @param offset the current file offset
+	 */
+	UringReadAhead(int _fd, off_t offset);
+
+	~UringReadAhead();
+
+	UringReadAhead(const UringReadAhead &) = delete;
+	UringReadAhead &operator=(const UringReadAhead &) = delete;
+
+	/**
+	 * The file offset of the next byte returned by Read().
+	 */
+	off_t GetOffset() const {
+		return current_offset + position;
+	}
+
+	/**
+	 * Throws std::system_error on error.
+	 */
+	size_t Read(void *data, size_t size);
+
+	void Seek(off_t offset);
+
+private:
+	/**
+	 * Submit a read of the next chunk into the other buffer.
+	 */
+	void StartRead();
+
+	/**
+	 * Wait for the pending read and make its buffer the current
+	 * one.
+	 *
+	 * @return the number of bytes or a negative errno value
+	 */
+	int WaitRead();
+};
+
+#endif
@@ -20,10 +20,13 @@
 #include "config.h"
 #include "AsyncInputStream.hxx"
 #include "Domain.hxx"
+#include "InputMetrics.hxx"
 #include "tag/Tag.hxx"
 #include "thread/Cond.hxx"
 #include "IOThread.hxx"
+#include "system/Clock.hxx"
 #include "util/HugeAllocator.hxx"
+#include "util/MemStats.hxx"
 
 #include <assert.h>
 #include <string.h>
@@ -32,19 +35,23 @@ AsyncInputStream::AsyncInputStream(const char *_url,
 				   Mutex &_mutex, Cond &_cond,
 				   void *_buffer, size_t _buffer_size,
 				   size_t _resume_at)
-	:InputStream(_url, _mutex, _cond), DeferredMonitor(io_thread_get()),
+	:InputStream(_url, _mutex, _cond), DeferredMonitor(io_thread_get(IOThreadRole::INPUT)),
 	 buffer((uint8_t *)_buffer, _buffer_size),
 	 resume_at(_resume_at),
 	 open(true),
 	 paused(false),
 	 seek_state(SeekState::NONE),
-	 tag(nullptr) {}
+	 tag(nullptr)
+{
+	MemStatsAllocate(MemStatsCategory::INPUT_BUFFER, _buffer_size);
+}
 
 AsyncInputStream::~AsyncInputStream()
 {
 	delete tag;
 
 	buffer.Clear();
+	MemStatsFree(MemStatsCategory::INPUT_BUFFER, buffer.GetCapacity());
 	HugeFree(buffer.Write().data, buffer.GetCapacity());
 }
 
@@ -58,7 +65,7 @@ AsyncInputStream::SetTag(Tag *_tag)
 void
 AsyncInputStream::Pause()
 {
-	assert(io_thread_inside());
+	assert(io_thread_inside(IOThreadRole::INPUT));
 
 	paused = true;
 }
@@ -66,7 +73,7 @@ AsyncInputStream::Pause()
 void
 AsyncInputStream::PostponeError(Error &&error)
 {
-	assert(io_thread_inside());
+	assert(io_thread_inside(IOThreadRole::INPUT));
 
 	seek_state = SeekState::NONE;
 	postponed_error = std::move(error);
@@ -76,7 +83,7 @@ AsyncInputStream::PostponeError(Error &&error)
 inline void
 AsyncInputStream::Resume()
 {
-	assert(io_thread_inside());
+	assert(io_thread_inside(IOThreadRole::INPUT));
 
 	if (paused) {
 		paused = false;
@@ -134,8 +141,14 @@ AsyncInputStream::Seek(offset_type new_offset, Error &error)
 		offset += nbytes;
 	}
 
-	if (new_offset == offset)
+	if (new_offset == offset) {
+		/* fast-forwarding may have drained the buffer of a
+		   paused stream; nobody else would resume it */
+		if (paused && buffer.GetSize() < resume_at)
+			DeferredMonitor::Schedule();
+
 		return true;
+	}
 
 	/* no: ask the implementation to seek */
 
@@ -144,9 +157,14 @@ AsyncInputStream::Seek(offset_type new_offset, Error &error)
 
 	DeferredMonitor::Schedule();
 
+	const uint64_t start_time = metrics != nullptr ? MonotonicClockUS() : 0;
+
 	while (seek_state != SeekState::NONE)
 		cond.wait(mutex);
 
+	if (metrics != nullptr)
+		metrics->seek.Add(MonotonicClockUS() - start_time);
+
 	if (!Check(error))
 		return false;
 
@@ -156,7 +174,7 @@ AsyncInputStream::Seek(offset_type new_offset, Error &error)
 void
 AsyncInputStream::SeekDone()
 {
-	assert(io_thread_inside());
+	assert(io_thread_inside(IOThreadRole::INPUT));
 	assert(IsSeekPending());
 
 	/* we may have reached end-of-file previously, and the
@@ -187,10 +205,11 @@ AsyncInputStream::IsAvailable()
 size_t
 AsyncInputStream::Read(void *ptr, size_t read_size, Error &error)
 {
-	assert(!io_thread_inside());
+	assert(!io_thread_inside(IOThreadRole::INPUT));
 
 	/* wait for data */
 	CircularBuffer<uint8_t>::Range r;
+	uint64_t wait_start = 0;
 	while (true) {
 		if (!Check(error))
 			return 0;
@@ -199,9 +218,18 @@ AsyncInputStream::Read(void *ptr, size_t read_size, Error &error)
 		if (!r.IsEmpty() || IsEOF())
 			break;
 
+		if (wait_start == 0 && metrics != nullptr &&
+		    metrics->first_byte_us.load(std::memory_order_relaxed) > 0)
+			/* the buffer has run empty after data had
+			   been flowing */
+			wait_start = MonotonicClockUS();
+
 		cond.wait(mutex);
 	}
 
+	if (wait_start > 0)
+		metrics->Underrun(MonotonicClockUS() - wait_start);
+
 	const size_t nbytes = std::min(read_size, r.size);
 	memcpy(ptr, r.data, nbytes);
 	buffer.Consume(nbytes);
@@ -234,6 +262,25 @@ AsyncInputStream::AppendToBuffer(const void *data, size_t append_size)
 		buffer.Append(remaining);
 	}
 
+	if (metrics != nullptr)
+		metrics->Received(append_size);
+
+	if (!IsReady())
+		SetReady();
+	else
+		cond.broadcast();
+}
+
+void
+AsyncInputStream::CommitWriteBuffer(size_t nbytes)
+{
+	assert(nbytes > 0);
+
+	buffer.Append(nbytes);
+
+	if (metrics != nullptr)
+		metrics->Received(nbytes);
+
 	if (!IsReady())
 		SetReady();
 	else
@@ -133,6 +133,20 @@ protected:
 	 */
 	void AppendToBuffer(const void *data, size_t append_size);
 
+	/**
+	 * Obtain the contiguous free space at the end of the buffer,
+	 * to be filled directly by the caller (e.g. with read()).
+	 * After that, call CommitWriteBuffer().
+	 */
+	CircularBuffer<uint8_t>::Range PrepareWriteBuffer() {
+		return buffer.Write();
+	}
+
+	/**
+	 * Mark data obtained by PrepareWriteBuffer() as filled.
+	 */
+	void CommitWriteBuffer(size_t nbytes);
+
 	/**
 	 * Implement code here that will resume the stream after it
 	 * has been paused due to full input buffer.
@@ -0,0 +1,240 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "CacheInputStream.hxx"
+#include "InputCache.hxx"
+#include "InputStream.hxx"
+#include "Ptr.hxx"
+#include "thread/Mutex.hxx"
+#include "util/Error.hxx"
+
+#include <assert.h>
+
+/**
+ * Like #ProxyInputStream, but the underlying stream may be closed
+ * early: if the #InputCache has a complete copy of the resource,
+ * it is only needed to obtain the validator.
+ */
+class CacheInputStream final : public InputStream {
+	/**
+	 * The remote stream; nullptr if everything is served from
+	 * the cache.
+	 */
+	InputStreamPtr input;
+
+	/**
+	 * The cache item, or nullptr if this resource is not being
+	 * cached.  Only defined after the stream has become ready.
+	 */
+	InputCacheItem *item = nullptr;
+
+public:
+	explicit CacheInputStream(InputStream *_input)
+		:InputStream(_input->GetURI(), _input->mutex, _input->cond),
+		 input(_input) {}
+
+	~CacheInputStream() {
+		if (item != nullptr)
+			input_cache->Release(*item);
+	}
+
+	/* virtual methods from InputStream */
+	bool Check(Error &error) override;
+	void Update() override;
+	bool Seek(offset_type new_offset, Error &error) override;
+	bool IsEOF() override;
+	Tag *ReadTag() override;
+	bool IsAvailable() override;
+	size_t Read(void *ptr, size_t read_size, Error &error) override;
+
+private:
+	/**
+	 * Copy the attributes from the underlying stream as soon as
+	 * it is ready, and attach to the cache.
+	 */
+	void CopyAttributes();
+
+	size_t ReadRemote(void *ptr, size_t read_size, Error &error);
+};
+
+void
+CacheInputStream::CopyAttributes()
+{
+	if (!IsReady()) {
+		if (!input->IsReady())
+			return;
+
+		if (input->HasMimeType())
+			SetMimeType(input->GetMimeType());
+
+		size = input->KnownSize()
+			? input->GetSize()
+			: UNKNOWN_SIZE;
+		seekable = input->IsSeekable();
+
+		if (input->HasValidator() && input->KnownSize() &&
+		    size > 0 && seekable && input->GetOffset() == 0)
+			item = input_cache->Acquire(GetURI(),
+						    input->GetValidator(),
+						    size);
+
+		SetReady();
+
+		if (item != nullptr && item->IsComplete()) {
+			/* the remote stream is not needed anymore;
+			   its destructor must be called without the
+			   mutex */
+			const ScopeUnlock unlock(mutex);
+			input.reset();
+		}
+	}
+
+	if (item == nullptr)
+		offset = input->GetOffset();
+}
+
+bool
+CacheInputStream::Check(Error &error)
+{
+	/* errors of the remote stream (e.g. a timeout while it was
+	   not needed) are only relevant when reading from it; then
+	   Read() reports them */
+	return item != nullptr || input->Check(error);
+}
+
+void
+CacheInputStream::Update()
+{
+	if (input != nullptr) {
+		input->Update();
+		CopyAttributes();
+	}
+}
+
+bool
+CacheInputStream::Seek(offset_type new_offset, Error &error)
+{
+	if (item == nullptr) {
+		bool success = input->Seek(new_offset, error);
+		CopyAttributes();
+		return success;
+	}
+
+	/* the remote stream is only moved when data is missing in
+	   the cache; see ReadRemote() */
+	offset = new_offset;
+	return true;
+}
+
+bool
+CacheInputStream::IsEOF()
+{
+	if (item != nullptr)
+		return offset >= size;
+
+	return input->IsEOF();
+}
+
+Tag *
+CacheInputStream::ReadTag()
+{
+	return input != nullptr
+		? input->ReadTag()
+		: nullptr;
+}
+
+bool
+CacheInputStream::IsAvailable()
+{
+	if (item == nullptr)
+		return input->IsAvailable();
+
+	if (offset >= size || item->GetCachedSize(offset) > 0)
+		return true;
+
+	/* if the remote stream needs to seek first, Read() will
+	   block anyway */
+	return input->GetOffset() != offset || input->IsAvailable();
+}
+
+inline size_t
+CacheInputStream::ReadRemote(void *ptr, size_t read_size, Error &error)
+{
+	assert(input != nullptr);
+
+	if (input->GetOffset() != offset &&
+	    !input->Seek(offset, error))
+		return 0;
+
+	size_t nbytes = input->Read(ptr, read_size, error);
+	if (nbytes > 0) {
+		item->Write(offset, ptr, nbytes);
+		offset += nbytes;
+	}
+
+	return nbytes;
+}
+
+size_t
+CacheInputStream::Read(void *ptr, size_t read_size, Error &error)
+{
+	if (item == nullptr) {
+		size_t nbytes = input->Read(ptr, read_size, error);
+		CopyAttributes();
+		return nbytes;
+	}
+
+	if (offset >= size)
+		return 0;
+
+	const offset_type cached = item->GetCachedSize(offset);
+	if (cached > 0) {
+		if (offset_type(read_size) > cached)
+			read_size = cached;
+
+		size_t nbytes = item->Read(offset, ptr, read_size, error);
+		offset += nbytes;
+		return nbytes;
+	}
+
+	return ReadRemote(ptr, read_size, error);
+}
+
+InputStream *
+input_cache_open(InputStream *is)
+{
+	assert(is != nullptr);
+
+	if (input_cache == nullptr ||
+	    (is->IsReady() && !is->HasValidator()))
+		/* the cache is disabled, or this resource cannot be
+		   validated */
+		return is;
+
+	CacheInputStream *c = new CacheInputStream(is);
+
+	/* the stream may be ready already; attach to the cache
+	   right now */
+	const ScopeLock protect(c->mutex);
+	c->Update();
+
+	return c;
+}
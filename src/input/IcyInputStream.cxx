@@ -56,7 +56,13 @@ IcyInputStream::ReadTag()
 	}
 
 	Tag *new_icy_tag = parser.ReadTag();
-	if (new_icy_tag != nullptr) {
+	if (new_icy_tag != nullptr && icy_tag != nullptr &&
+	    new_icy_tag->Equals(*icy_tag)) {
+		/* many servers repeat the same metadata block over
+		   and over; ignore it */
+		delete new_icy_tag;
+		new_icy_tag = nullptr;
+	} else if (new_icy_tag != nullptr) {
 		delete icy_tag;
 		icy_tag = new_icy_tag;
 	}
@@ -21,6 +21,8 @@
 #include "Init.hxx"
 #include "Registry.hxx"
 #include "InputPlugin.hxx"
+#include "InputCache.hxx"
+#include "plugins/RewindInputPlugin.hxx"
 #include "util/Error.hxx"
 #include "config/ConfigGlobal.hxx"
 #include "config/ConfigOption.hxx"
@@ -76,11 +78,22 @@ input_stream_global_init(Error &error)
 		}
 	}
 
+	input_rewind_init(config_get_positive(ConfigOption::INPUT_REWIND_SIZE,
+					      1024) * size_t(1024));
+
+	const auto *cache_block =
+		config_get_block(ConfigBlockOption::INPUT_CACHE);
+	if (cache_block != nullptr &&
+	    !input_cache_init(*cache_block, error))
+		return false;
+
 	return true;
 }
 
 void input_stream_global_finish(void)
 {
+	input_cache_finish();
+
 	input_plugins_for_each_enabled(plugin)
 		if (plugin->finish != nullptr)
 			plugin->finish();
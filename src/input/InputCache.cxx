@@ -0,0 +1,521 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "InputCache.hxx"
+#include "config/Block.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/DirectoryReader.hxx"
+#include "fs/io/FileReader.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "util/StringCompare.hxx"
+#include "util/Fnv1aHash.hxx"
+#include "util/Domain.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <stdexcept>
+#include <algorithm>
+#include <vector>
+#include <memory>
+
+#include <assert.h>
+#include <string.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+static constexpr Domain input_cache_domain("input_cache");
+
+InputCache *input_cache;
+
+/**
+ * The header of a metadata file.  It is followed by the URI and the
+ * validator (without null terminators) and #n_ranges pairs of 64 bit
+ * start/end offsets.  The file is only read by the host which wrote
+ * it, therefore all numbers are in host byte order.
+ */
+struct InputCacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t uri_length;
+	uint32_t validator_length;
+	uint32_t n_ranges;
+	uint64_t size;
+};
+
+static constexpr char INPUT_CACHE_MAGIC[8] = "MPDINPC";
+static constexpr uint32_t INPUT_CACHE_VERSION = 1;
+
+static constexpr char INPUT_CACHE_META_SUFFIX[] = ".meta";
+static constexpr char INPUT_CACHE_DATA_SUFFIX[] = ".data";
+
+/**
+ * Make up the base name of a cache item from a hash of the URI.
+ */
+gcc_pure
+static std::string
+MakeItemName(const char *uri)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx",
+		 (unsigned long long)Fnv1aHash64(uri));
+	return name;
+}
+
+static void
+ReadExactly(FileReader &reader, void *data, size_t size)
+{
+	uint8_t *p = (uint8_t *)data;
+	while (size > 0) {
+		size_t nbytes = reader.Read(p, size);
+		if (nbytes == 0)
+			throw std::runtime_error("Truncated cache file");
+
+		p += nbytes;
+		size -= nbytes;
+	}
+}
+
+static std::string
+ReadString(FileReader &reader, size_t length)
+{
+	std::unique_ptr<char[]> buffer(new char[length]);
+	ReadExactly(reader, buffer.get(), length);
+	return std::string(buffer.get(), length);
+}
+
+offset_type
+InputCacheItem::GetCachedSize(offset_type offset) const
+{
+	auto i = ranges.upper_bound(offset);
+	if (i == ranges.begin())
+		return 0;
+
+	--i;
+	return i->second > offset
+		? i->second - offset
+		: 0;
+}
+
+size_t
+InputCacheItem::Read(offset_type offset, void *dest, size_t length,
+		     Error &error)
+{
+	assert(in_use);
+	assert(fd >= 0);
+	assert(GetCachedSize(offset) >= offset_type(length));
+
+	ssize_t nbytes = pread(fd, dest, length, offset);
+	if (nbytes < 0) {
+		error.SetErrno("Failed to read from cache file");
+		return 0;
+	}
+
+	if (nbytes == 0) {
+		error.Set(input_cache_domain, "Cache file is truncated");
+		return 0;
+	}
+
+	return nbytes;
+}
+
+void
+InputCacheItem::Write(offset_type offset, const void *src, size_t length)
+{
+	assert(in_use);
+
+	if (fd < 0)
+		/* disabled after a write error */
+		return;
+
+	const uint8_t *p = (const uint8_t *)src;
+	size_t position = 0;
+	while (position < length) {
+		ssize_t nbytes = pwrite(fd, p + position, length - position,
+					offset + position);
+		if (nbytes <= 0) {
+			LogErrno(input_cache_domain,
+				 "Failed to write to cache file");
+
+			/* keep the ranges which are complete, but
+			   don't write any more */
+			close(fd);
+			fd = -1;
+			break;
+		}
+
+		position += nbytes;
+	}
+
+	if (position > 0)
+		AddRange(offset, offset + position);
+}
+
+void
+InputCacheItem::AddRange(offset_type start, offset_type end)
+{
+	assert(start < end);
+
+	offset_type removed = 0;
+
+	auto i = ranges.upper_bound(start);
+	if (i != ranges.begin()) {
+		auto prev = std::prev(i);
+		if (prev->second >= start)
+			i = prev;
+	}
+
+	while (i != ranges.end() && i->first <= end) {
+		start = std::min(start, i->first);
+		end = std::max(end, i->second);
+		removed += i->second - i->first;
+		i = ranges.erase(i);
+	}
+
+	ranges.emplace(start, end);
+
+	const offset_type delta = end - start - removed;
+	stored += delta;
+
+	const ScopeLock protect(cache.mutex);
+	cache.Commit(delta);
+}
+
+InputCache::~InputCache()
+{
+#ifndef NDEBUG
+	for (const auto &i : items)
+		assert(!i.in_use);
+#endif
+}
+
+AllocatedPath
+InputCache::MakePath(const std::string &name, const char *suffix) const
+{
+	const auto name_fs = AllocatedPath::FromUTF8((name + suffix).c_str());
+	if (name_fs.IsNull())
+		return AllocatedPath::Null();
+
+	return AllocatedPath::Build(directory, name_fs);
+}
+
+void
+InputCache::Load()
+{
+	/* collect the metadata files, and sort them by their
+	   modification time to restore the LRU order */
+	std::vector<std::pair<time_t, std::string>> found;
+
+	{
+		DirectoryReader reader(directory);
+		while (reader.ReadEntry()) {
+			const std::string entry = reader.GetEntry().ToUTF8();
+			if (!StringEndsWith(entry.c_str(),
+					    INPUT_CACHE_META_SUFFIX))
+				continue;
+
+			std::string name(entry, 0, entry.length() -
+					 sizeof(INPUT_CACHE_META_SUFFIX) + 1);
+
+			struct stat st;
+			if (StatFile(MakePath(name, INPUT_CACHE_META_SUFFIX),
+				     st))
+				found.emplace_back(st.st_mtime,
+						   std::move(name));
+		}
+	}
+
+	std::sort(found.begin(), found.end(),
+		  [](const std::pair<time_t, std::string> &a,
+		     const std::pair<time_t, std::string> &b){
+			  return a.first > b.first;
+		  });
+
+	const ScopeLock protect(mutex);
+
+	for (const auto &i : found) {
+		try {
+			LoadMeta(i.second);
+		} catch (const std::runtime_error &e) {
+			FormatDebug(input_cache_domain,
+				    "Discarding cache item %s: %s",
+				    i.second.c_str(), e.what());
+			RemoveFile(MakePath(i.second, INPUT_CACHE_META_SUFFIX));
+			RemoveFile(MakePath(i.second, INPUT_CACHE_DATA_SUFFIX));
+		}
+	}
+
+	FormatDebug(input_cache_domain, "Loaded %zu items, %llu bytes",
+		    items.size(), (unsigned long long)total_size);
+
+	Commit(0);
+}
+
+void
+InputCache::LoadMeta(const std::string &name)
+{
+	if (!FileExists(MakePath(name, INPUT_CACHE_DATA_SUFFIX)))
+		throw std::runtime_error("No data file");
+
+	FileReader reader(MakePath(name, INPUT_CACHE_META_SUFFIX));
+
+	InputCacheHeader header;
+	ReadExactly(reader, &header, sizeof(header));
+	if (memcmp(header.magic, INPUT_CACHE_MAGIC,
+		   sizeof(header.magic)) != 0 ||
+	    header.version != INPUT_CACHE_VERSION ||
+	    header.uri_length > 65536 || header.validator_length > 65536)
+		throw std::runtime_error("Wrong file format");
+
+	items.emplace_back(*this, std::string(name));
+	auto i = std::prev(items.end());
+	by_name.emplace(name, i);
+
+	auto &item = *i;
+	item.uri = ReadString(reader, header.uri_length);
+	item.validator = ReadString(reader, header.validator_length);
+	item.size = header.size;
+
+	try {
+		offset_type previous_end = 0;
+		for (uint32_t j = 0; j < header.n_ranges; ++j) {
+			uint64_t range[2];
+			ReadExactly(reader, range, sizeof(range));
+			if (range[0] < previous_end || range[0] >= range[1] ||
+			    range[1] > header.size)
+				throw std::runtime_error("Malformed range");
+
+			item.ranges.emplace(range[0], range[1]);
+			item.stored += range[1] - range[0];
+			previous_end = range[1];
+		}
+	} catch (...) {
+		by_name.erase(name);
+		items.erase(i);
+		throw;
+	}
+
+	total_size += item.stored;
+}
+
+void
+InputCache::SaveMeta(const InputCacheItem &item) const
+{
+	InputCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, INPUT_CACHE_MAGIC, sizeof(header.magic));
+	header.version = INPUT_CACHE_VERSION;
+	header.uri_length = item.uri.length();
+	header.validator_length = item.validator.length();
+	header.n_ranges = item.ranges.size();
+	header.size = item.size;
+
+	try {
+		FileOutputStream file(MakePath(item.name,
+					       INPUT_CACHE_META_SUFFIX));
+		file.Write(&header, sizeof(header));
+		file.Write(item.uri.data(), item.uri.length());
+		file.Write(item.validator.data(), item.validator.length());
+
+		for (const auto &i : item.ranges) {
+			const uint64_t range[2] = { uint64_t(i.first),
+						    uint64_t(i.second) };
+			file.Write(range, sizeof(range));
+		}
+
+		file.Commit();
+	} catch (const std::runtime_error &e) {
+		LogError(e);
+	}
+}
+
+InputCacheItem *
+InputCache::Acquire(const char *uri, const char *validator,
+		    offset_type size)
+{
+	if (uint64_t(size) > max_size)
+		/* would evict everything else */
+		return nullptr;
+
+	std::string name = MakeItemName(uri);
+
+	const ScopeLock protect(mutex);
+
+	bool fresh = true;
+
+	auto f = by_name.find(name);
+	if (f != by_name.end()) {
+		InputCacheItem &item = *f->second;
+		if (item.in_use)
+			return nullptr;
+
+		if (item.uri == uri && item.validator == validator &&
+		    item.size == size) {
+			/* move to the front of the LRU list */
+			items.splice(items.begin(), items, f->second);
+			fresh = false;
+		} else {
+			/* the resource has been modified, or this is
+			   a hash collision */
+			FormatDebug(input_cache_domain,
+				    "Discarding stale cache item of %s",
+				    item.uri.c_str());
+			Remove(f->second);
+		}
+	}
+
+	if (fresh) {
+		items.emplace_front(*this, std::string(name));
+		by_name.emplace(std::move(name), items.begin());
+
+		auto &item = items.front();
+		item.uri = uri;
+		item.validator = validator;
+		item.size = size;
+	}
+
+	auto i = items.begin();
+	InputCacheItem &item = *i;
+
+	const auto path = MakePath(item.name, INPUT_CACHE_DATA_SUFFIX);
+	item.fd = OpenFile(path, O_RDWR|O_CREAT, 0666);
+	if (item.fd < 0) {
+		FormatErrno(input_cache_domain, "Failed to open %s",
+			    path.c_str());
+		Remove(i);
+		return nullptr;
+	}
+
+	if (fresh && ftruncate(item.fd, 0) < 0) {
+		/* clear the contents of an orphaned data file */
+		close(item.fd);
+		item.fd = -1;
+		Remove(i);
+		return nullptr;
+	}
+
+	item.in_use = true;
+	return &item;
+}
+
+void
+InputCache::Release(InputCacheItem &item)
+{
+	const ScopeLock protect(mutex);
+
+	assert(item.in_use);
+
+	if (item.fd >= 0) {
+		close(item.fd);
+		item.fd = -1;
+	}
+
+	item.in_use = false;
+
+	auto i = by_name.find(item.name);
+	assert(i != by_name.end());
+
+	if (item.stored == 0)
+		Remove(i->second);
+	else {
+		SaveMeta(item);
+
+		/* this item can be evicted now */
+		Commit(0);
+	}
+}
+
+void
+InputCache::Commit(offset_type delta)
+{
+	total_size += delta;
+
+	auto i = items.end();
+	while (total_size > max_size && i != items.begin()) {
+		--i;
+		if (!i->in_use) {
+			FormatDebug(input_cache_domain, "Evicting %s",
+				    i->uri.c_str());
+			i = std::next(i);
+			Remove(std::prev(i));
+		}
+	}
+}
+
+void
+InputCache::Remove(ItemIterator i)
+{
+	assert(!i->in_use);
+	assert(total_size >= uint64_t(i->stored));
+
+	total_size -= i->stored;
+
+	RemoveFile(MakePath(i->name, INPUT_CACHE_META_SUFFIX));
+	RemoveFile(MakePath(i->name, INPUT_CACHE_DATA_SUFFIX));
+
+	by_name.erase(i->name);
+	items.erase(i);
+}
+
+bool
+input_cache_init(const ConfigBlock &block, Error &error)
+{
+	assert(input_cache == nullptr);
+
+	auto path = block.GetBlockPath("path", error);
+	if (path.IsNull()) {
+		if (!error.IsDefined())
+			error.Set(input_cache_domain,
+				  "No \"path\" in \"input_cache\" block");
+		return false;
+	}
+
+	if (!DirectoryExists(path)) {
+		error.Format(input_cache_domain, "Not a directory: %s",
+			     path.c_str());
+		return false;
+	}
+
+	const uint64_t max_size =
+		uint64_t(block.GetBlockValue("size", 1024u)) * 1024 * 1024;
+
+	input_cache = new InputCache(std::move(path), max_size);
+
+	try {
+		input_cache->Load();
+	} catch (const std::runtime_error &e) {
+		delete input_cache;
+		input_cache = nullptr;
+
+		error.Set(input_cache_domain, e.what());
+		return false;
+	}
+
+	return true;
+}
+
+void
+input_cache_finish()
+{
+	delete input_cache;
+	input_cache = nullptr;
+}
@@ -0,0 +1,215 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_INPUT_CACHE_HXX
+#define MPD_INPUT_CACHE_HXX
+
+#include "check.h"
+#include "Offset.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "thread/Mutex.hxx"
+#include "Compiler.h"
+
+#include <string>
+#include <map>
+#include <list>
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Error;
+class InputCache;
+struct ConfigBlock;
+
+/**
+ * The cached portions of one remote resource.  It is stored in a
+ * sparse data file and a metadata file which lists the ranges that
+ * have been fetched already.
+ *
+ * While an #InputStream uses an item (see InputCache::Acquire()), it
+ * is owned exclusively by that stream and will not be evicted.
+ */
+class InputCacheItem {
+	friend class InputCache;
+
+	InputCache &cache;
+
+	/**
+	 * The file name without suffix; this is a hash of the URI.
+	 */
+	const std::string name;
+
+	std::string uri, validator;
+
+	offset_type size;
+
+	/**
+	 * The ranges which have been fetched already, mapping the
+	 * start offset to the end offset.  Adjacent and overlapping
+	 * ranges are merged.
+	 */
+	std::map<offset_type, offset_type> ranges;
+
+	/**
+	 * The sum of all #ranges.
+	 */
+	offset_type stored = 0;
+
+	bool in_use = false;
+
+	/**
+	 * The data file; only open while #in_use is set.
+	 */
+	int fd = -1;
+
+public:
+	InputCacheItem(InputCache &_cache, std::string &&_name)
+		:cache(_cache), name(std::move(_name)) {}
+
+	InputCacheItem(const InputCacheItem &) = delete;
+	InputCacheItem &operator=(const InputCacheItem &) = delete;
+
+	bool IsComplete() const {
+		return stored == size;
+	}
+
+	/**
+	 * Returns the number of bytes which can be read from the
+	 * cache at the given offset.
+	 */
+	gcc_pure
+	offset_type GetCachedSize(offset_type offset) const;
+
+	/**
+	 * Read data from the cache.  The range must be covered by
+	 * GetCachedSize().
+	 *
+	 * @return the number of bytes read, or 0 on error
+	 */
+	size_t Read(offset_type offset, void *dest, size_t length,
+		    Error &error);
+
+	/**
+	 * Store data which has been fetched from the remote
+	 * resource.  Errors are logged and disable further writes to
+	 * this item.
+	 */
+	void Write(offset_type offset, const void *src, size_t length);
+
+private:
+	void AddRange(offset_type start, offset_type end);
+};
+
+class InputCache {
+	friend class InputCacheItem;
+
+	const AllocatedPath directory;
+
+	/**
+	 * The maximum sum of all #InputCacheItem::stored.
+	 */
+	const uint64_t max_size;
+
+	/**
+	 * Protects all attributes below, and #InputCacheItem::in_use
+	 * and #InputCacheItem::ranges of items which are not in use.
+	 */
+	Mutex mutex;
+
+	uint64_t total_size = 0;
+
+	/**
+	 * All items, the most recently used one first.
+	 */
+	std::list<InputCacheItem> items;
+
+	typedef std::list<InputCacheItem>::iterator ItemIterator;
+
+	std::map<std::string, ItemIterator> by_name;
+
+public:
+	InputCache(AllocatedPath &&_directory, uint64_t _max_size)
+		:directory(std::move(_directory)), max_size(_max_size) {}
+
+	~InputCache();
+
+	InputCache(const InputCache &) = delete;
+	InputCache &operator=(const InputCache &) = delete;
+
+	/**
+	 * Load the metadata files from the cache directory.
+	 */
+	void Load();
+
+	/**
+	 * Obtain exclusive access to the cache item of the given
+	 * resource, creating it if necessary.  A stale item (with
+	 * different validator or size) is discarded.  Call Release()
+	 * when done.
+	 *
+	 * @return the item or nullptr if it is already in use or on
+	 * error
+	 */
+	InputCacheItem *Acquire(const char *uri, const char *validator,
+				offset_type size);
+
+	/**
+	 * Save the metadata of an item obtained by Acquire() and
+	 * allow it to be evicted.
+	 */
+	void Release(InputCacheItem &item);
+
+private:
+	gcc_pure
+	AllocatedPath MakePath(const std::string &name,
+			       const char *suffix) const;
+
+	void LoadMeta(const std::string &name);
+	void SaveMeta(const InputCacheItem &item) const;
+
+	/**
+	 * Add the given number of bytes to #total_size and evict
+	 * items until it fits into #max_size again.  Caller must hold
+	 * the mutex.
+	 */
+	void Commit(offset_type delta);
+
+	/**
+	 * Delete an item and its files.  Caller must hold the mutex.
+	 */
+	void Remove(ItemIterator i);
+};
+
+/**
+ * The global instance; nullptr if the cache is disabled.
+ */
+extern InputCache *input_cache;
+
+/**
+ * Set up the global #InputCache according to the "input_cache"
+ * block.
+ */
+bool
+input_cache_init(const ConfigBlock &block, Error &error);
+
+void
+input_cache_finish();
+
+#endif
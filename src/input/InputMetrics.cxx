@@ -0,0 +1,169 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "InputMetrics.hxx"
+#include "InputStats.hxx"
+#include "thread/Mutex.hxx"
+#include "system/Clock.hxx"
+#include "util/UriUtil.hxx"
+
+#include <list>
+
+/**
+ * The number of closed streams which are remembered.
+ */
+static constexpr unsigned INPUT_METRICS_RECENT = 16;
+
+static Mutex input_metrics_mutex;
+
+/**
+ * All open and recently closed streams, the most recent first.
+ * Protected by #input_metrics_mutex.
+ */
+static std::list<InputMetrics> input_metrics_list;
+
+/**
+ * The sum of all streams which were removed from
+ * #input_metrics_list.  Protected by #input_metrics_mutex.
+ */
+static InputMetricsTotals input_metrics_forgotten;
+
+static std::string
+RemoveAuth(const char *uri)
+{
+	std::string result = uri_remove_auth(uri);
+	if (result.empty())
+		/* there were no credentials */
+		result = uri;
+	return result;
+}
+
+InputMetrics::InputMetrics(const char *_uri, const char *_plugin,
+			   uint64_t _open_time)
+	:uri(RemoveAuth(_uri)), source(InputStatsKey(_uri)),
+	 plugin(_plugin), open_time(_open_time),
+	 dns_us(0), connect_us(0), tls_us(0), have_connect_times(false),
+	 ready_us(0), first_byte_us(0), last_byte_us(0),
+	 bytes(0), underruns(0), underrun_us(0),
+	 closed(false)
+{
+}
+
+uint64_t
+InputMetrics::Elapsed() const
+{
+	const uint64_t now = MonotonicClockUS();
+	/* never return 0, which means "not yet" */
+	return now > open_time ? now - open_time : 1;
+}
+
+void
+InputMetrics::MarkOnce(std::atomic<uint64_t> &attribute) const
+{
+	uint64_t expected = 0;
+	attribute.compare_exchange_strong(expected, Elapsed(),
+					  std::memory_order_relaxed);
+}
+
+void
+InputMetrics::Received(size_t nbytes)
+{
+	const uint64_t now = Elapsed();
+
+	uint64_t expected = 0;
+	first_byte_us.compare_exchange_strong(expected, now,
+					      std::memory_order_relaxed);
+	last_byte_us.store(now, std::memory_order_relaxed);
+	bytes.fetch_add(nbytes, std::memory_order_relaxed);
+}
+
+void
+InputMetrics::SetConnectTimes(uint64_t dns, uint64_t connect, uint64_t tls)
+{
+	if (have_connect_times.load(std::memory_order_relaxed))
+		/* only the first connection is interesting */
+		return;
+
+	dns_us.store(dns, std::memory_order_relaxed);
+	connect_us.store(connect, std::memory_order_relaxed);
+	tls_us.store(tls, std::memory_order_relaxed);
+	have_connect_times.store(true, std::memory_order_release);
+}
+
+InputMetrics *
+input_metrics_new(const char *uri, const char *plugin, uint64_t open_time)
+{
+	const ScopeLock protect(input_metrics_mutex);
+	input_metrics_list.emplace_front(uri, plugin, open_time);
+	return &input_metrics_list.front();
+}
+
+void
+input_metrics_close(InputMetrics *metrics)
+{
+	const ScopeLock protect(input_metrics_mutex);
+
+	metrics->closed = true;
+
+	/* forget the oldest closed streams */
+	unsigned n_closed = 0;
+	for (auto i = input_metrics_list.begin();
+	     i != input_metrics_list.end();) {
+		if (i->closed && ++n_closed > INPUT_METRICS_RECENT) {
+			input_metrics_forgotten.Add(*i);
+			i = input_metrics_list.erase(i);
+		} else
+			++i;
+	}
+}
+
+void
+input_metrics_visit(const std::function<void(const InputMetrics &)> &f)
+{
+	const ScopeLock protect(input_metrics_mutex);
+
+	for (const auto &i : input_metrics_list)
+		f(i);
+}
+
+void
+InputMetricsTotals::Add(const InputMetrics &m)
+{
+	++streams;
+	bytes += m.bytes.load(std::memory_order_relaxed);
+	underruns += m.underruns.load(std::memory_order_relaxed);
+	underrun_us += m.underrun_us.load(std::memory_order_relaxed);
+}
+
+InputMetricsTotals
+input_metrics_totals()
+{
+	const ScopeLock protect(input_metrics_mutex);
+
+	InputMetricsTotals result = input_metrics_forgotten;
+	for (const auto &i : input_metrics_list) {
+		if (!i.closed)
+			++result.open_streams;
+		result.Add(i);
+	}
+
+	return result;
+}
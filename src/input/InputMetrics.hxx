@@ -0,0 +1,174 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_INPUT_METRICS_HXX
+#define MPD_INPUT_METRICS_HXX
+
+#include "check.h"
+#include "util/LatencyHistogram.hxx"
+
+#include <atomic>
+#include <functional>
+#include <string>
+
+#include <stdint.h>
+
+/**
+ * Timing and throughput measurements of one remote #InputStream,
+ * for diagnosing slow starts and stalls.  All durations are in
+ * microseconds, relative to the time the stream was opened (0 means
+ * "not yet").  The attributes may be updated from any thread without
+ * holding a lock.
+ */
+struct InputMetrics {
+	/**
+	 * The URI without credentials.
+	 */
+	const std::string uri;
+
+	/**
+	 * The source key, see InputStatsKey().
+	 */
+	const std::string source;
+
+	const char *const plugin;
+
+	/**
+	 * The MonotonicClockUS() value when the stream was opened.
+	 */
+	const uint64_t open_time;
+
+	/**
+	 * Connection phases reported by the plugin (if it knows
+	 * them): name resolution, TCP connect, TLS handshake.  They
+	 * are only valid if #have_connect_times is set.
+	 */
+	std::atomic<uint64_t> dns_us, connect_us, tls_us;
+	std::atomic<bool> have_connect_times;
+
+	/**
+	 * When did the stream become ready, and when did the first
+	 * and the most recent data arrive?
+	 */
+	std::atomic<uint64_t> ready_us, first_byte_us, last_byte_us;
+
+	/**
+	 * The number of bytes received from the source.
+	 */
+	std::atomic<uint64_t> bytes;
+
+	/**
+	 * The number of reads which had to wait for data because the
+	 * buffer was empty, and the total time spent waiting.
+	 */
+	std::atomic<uint64_t> underruns, underrun_us;
+
+	/**
+	 * The duration of seeks which were passed to the source.
+	 */
+	LatencyHistogram seek;
+
+	/**
+	 * Has the #InputStream been closed?  Protected by the
+	 * registry's mutex.
+	 */
+	bool closed;
+
+	InputMetrics(const char *_uri, const char *_plugin,
+		     uint64_t _open_time);
+
+	InputMetrics(const InputMetrics &) = delete;
+	InputMetrics &operator=(const InputMetrics &) = delete;
+
+	uint64_t Elapsed() const;
+
+	/**
+	 * Set the given attribute to "now" unless it has been set
+	 * already.
+	 */
+	void MarkOnce(std::atomic<uint64_t> &attribute) const;
+
+	void SetReady() {
+		MarkOnce(ready_us);
+	}
+
+	void Received(size_t nbytes);
+
+	void Underrun(uint64_t duration_us) {
+		underruns.fetch_add(1, std::memory_order_relaxed);
+		underrun_us.fetch_add(duration_us, std::memory_order_relaxed);
+	}
+
+	/**
+	 * Report the connection phases; the values are durations
+	 * since the request was started.  Only the first call has an
+	 * effect.
+	 */
+	void SetConnectTimes(uint64_t dns, uint64_t connect, uint64_t tls);
+};
+
+/**
+ * The sums of the #InputMetrics of all streams since MPD was
+ * started.
+ */
+struct InputMetricsTotals {
+	/**
+	 * The number of streams which have been opened, and the
+	 * number of streams which are open right now.
+	 */
+	uint64_t streams = 0, open_streams = 0;
+
+	uint64_t bytes = 0, underruns = 0, underrun_us = 0;
+
+	void Add(const InputMetrics &m);
+};
+
+/**
+ * Create a new #InputMetrics object in the global registry.  This
+ * function is thread-safe.
+ *
+ * @param open_time the MonotonicClockUS() value when opening began
+ */
+InputMetrics *
+input_metrics_new(const char *uri, const char *plugin, uint64_t open_time);
+
+/**
+ * The #InputStream has been closed.  The object is kept for a while
+ * to be shown in the list of recent streams.  This function is
+ * thread-safe.
+ */
+void
+input_metrics_close(InputMetrics *metrics);
+
+/**
+ * Invoke a function for all open and recently closed streams, the
+ * most recent first.  A global lock is held while this runs.
+ */
+void
+input_metrics_visit(const std::function<void(const InputMetrics &)> &f);
+
+/**
+ * Calculate the sums of all streams since MPD was started.  This
+ * function is thread-safe.
+ */
+InputMetricsTotals
+input_metrics_totals();
+
+#endif
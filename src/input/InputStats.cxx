@@ -0,0 +1,142 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "InputStats.hxx"
+#include "InputStream.hxx"
+#include "thread/Mutex.hxx"
+
+#include <map>
+#include <algorithm>
+
+#include <string.h>
+
+/**
+ * Commit the measurements of one #InputStatsMeter at least this
+ * often [us].
+ */
+static constexpr uint64_t INPUT_STATS_COMMIT_INTERVAL = 1000000;
+
+/**
+ * The weight of the previous value in the moving averages.
+ */
+static constexpr double INPUT_STATS_DECAY = 0.75;
+
+/**
+ * Forget everything when there are more sources than this.  This
+ * only prevents unbounded growth; normal setups use a handful.
+ */
+static constexpr size_t INPUT_STATS_MAX_SOURCES = 256;
+
+static Mutex input_stats_mutex;
+static std::map<std::string, InputSourceStats> input_stats;
+
+std::string
+InputStatsKey(const char *uri)
+{
+	const char *p = strstr(uri, "://");
+	if (p == nullptr || strncmp(uri, "file://", 7) == 0)
+		return "file";
+
+	const char *host = p + 3;
+	const char *end = host + strcspn(host, "/?#");
+
+	/* strip the credentials */
+	const char *at = (const char *)memchr(host, '@', end - host);
+	if (at != nullptr)
+		host = at + 1;
+
+	std::string key(uri, p + 3);
+	key.append(host, end);
+	return key;
+}
+
+void
+InputStatsCommit(const char *uri, uint64_t bytes, uint64_t duration_us,
+		 uint64_t max_stall_us)
+{
+	if (duration_us == 0)
+		return;
+
+	const double throughput = bytes * 1000000. / duration_us;
+	const double stall = max_stall_us / 1000000.;
+
+	auto key = InputStatsKey(uri);
+
+	const ScopeLock protect(input_stats_mutex);
+
+	if (input_stats.size() >= INPUT_STATS_MAX_SOURCES)
+		input_stats.clear();
+
+	auto i = input_stats.emplace(std::move(key),
+				     InputSourceStats{throughput, stall});
+	if (!i.second) {
+		InputSourceStats &s = i.first->second;
+		s.throughput = s.throughput * INPUT_STATS_DECAY
+			+ throughput * (1 - INPUT_STATS_DECAY);
+		s.stall = std::max(s.stall * INPUT_STATS_DECAY, stall);
+	}
+}
+
+bool
+InputStatsLookup(const char *uri, InputSourceStats &result)
+{
+	const auto key = InputStatsKey(uri);
+
+	const ScopeLock protect(input_stats_mutex);
+
+	auto i = input_stats.find(key);
+	if (i == input_stats.end())
+		return false;
+
+	result = i->second;
+	return true;
+}
+
+void
+InputStatsMeter::Add(const InputStream &is, size_t nbytes,
+		     uint64_t start_us, uint64_t end_us)
+{
+	if (&is != stream) {
+		Commit();
+		stream = &is;
+		uri = is.GetURI();
+		last_commit = start_us;
+	}
+
+	const uint64_t d = end_us - start_us;
+	bytes += nbytes;
+	duration += d;
+	max_stall = std::max(max_stall, d);
+
+	if (end_us - last_commit >= INPUT_STATS_COMMIT_INTERVAL) {
+		Commit();
+		last_commit = end_us;
+	}
+}
+
+void
+InputStatsMeter::Commit()
+{
+	if (duration > 0) {
+		InputStatsCommit(uri.c_str(), bytes, duration, max_stall);
+		bytes = duration = max_stall = 0;
+	}
+}
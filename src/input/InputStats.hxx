@@ -0,0 +1,129 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_INPUT_STATS_HXX
+#define MPD_INPUT_STATS_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <string>
+
+#include <stddef.h>
+#include <stdint.h>
+
+class InputStream;
+
+/**
+ * Statistics about how fast reads from one source complete.  A
+ * "source" is one remote host ("scheme://host") or the local file
+ * system.  They are collected by the decoder and used by the player
+ * to decide how much to buffer before playback starts (see
+ * #ConfigOption::BUFFER_BEFORE_PLAY).
+ */
+struct InputSourceStats {
+	/**
+	 * A moving average of the read throughput in bytes per
+	 * second, including the time spent waiting for data.
+	 */
+	double throughput;
+
+	/**
+	 * The longest time one read has blocked recently [s].  This
+	 * value decays slowly when the stalls get shorter.
+	 */
+	double stall;
+};
+
+/**
+ * Determine the name of the source which serves the specified URI.
+ */
+gcc_pure
+std::string
+InputStatsKey(const char *uri);
+
+/**
+ * Merge a number of measurements into the statistics of the source
+ * serving the specified URI.  This function is thread-safe.
+ */
+void
+InputStatsCommit(const char *uri, uint64_t bytes, uint64_t duration_us,
+		 uint64_t max_stall_us);
+
+/**
+ * Look up the statistics of the source serving the specified URI.
+ * This function is thread-safe.
+ *
+ * @return false if nothing is known about this source yet
+ */
+bool
+InputStatsLookup(const char *uri, InputSourceStats &result);
+
+/**
+ * Accumulates measurements of one reader (i.e. one decoder) locally
+ * and commits them from time to time, to keep the global lock out of
+ * the read path.
+ */
+class InputStatsMeter {
+	/**
+	 * The stream which was measured last.  Only used for
+	 * comparing pointers; it may have been freed already.
+	 */
+	const InputStream *stream;
+
+	std::string uri;
+
+	uint64_t bytes, duration, max_stall;
+
+	/**
+	 * When were the measurements committed last?  A
+	 * MonotonicClockUS() value.
+	 */
+	uint64_t last_commit;
+
+public:
+	InputStatsMeter()
+		:stream(nullptr), bytes(0), duration(0), max_stall(0),
+		 last_commit(0) {}
+
+	~InputStatsMeter() {
+		Commit();
+	}
+
+	InputStatsMeter(const InputStatsMeter &) = delete;
+	InputStatsMeter &operator=(const InputStatsMeter &) = delete;
+
+	/**
+	 * Record one read.
+	 *
+	 * @param start_us the MonotonicClockUS() value before the read
+	 * began (including the wait for data)
+	 * @param end_us the MonotonicClockUS() value after the read
+	 */
+	void Add(const InputStream &is, size_t nbytes,
+		 uint64_t start_us, uint64_t end_us);
+
+	/**
+	 * Commit all pending measurements.
+	 */
+	void Commit();
+};
+
+#endif
@@ -19,13 +19,18 @@
 
 #include "config.h"
 #include "InputStream.hxx"
+#include "InputMetrics.hxx"
 #include "thread/Cond.hxx"
+#include "system/Trace.hxx"
 #include "util/StringCompare.hxx"
+#include "util/ConstBuffer.hxx"
 
 #include <assert.h>
 
 InputStream::~InputStream()
 {
+	if (metrics != nullptr)
+		input_metrics_close(metrics);
 }
 
 bool
@@ -46,6 +51,23 @@ InputStream::SetReady()
 
 	ready = true;
 	cond.broadcast();
+
+	if (metrics != nullptr)
+		metrics->SetReady();
+}
+
+void
+InputStream::EnableMetrics(const char *plugin, uint64_t open_time)
+{
+	assert(metrics == nullptr);
+
+	auto *m = input_metrics_new(uri.c_str(), plugin, open_time);
+
+	const ScopeLock protect(mutex);
+	metrics = m;
+	if (ready)
+		/* the plugin has opened the stream synchronously */
+		metrics->SetReady();
 }
 
 void
@@ -126,6 +148,12 @@ InputStream::IsAvailable()
 	return true;
 }
 
+ConstBuffer<void>
+InputStream::ReadDirect(gcc_unused size_t _size)
+{
+	return nullptr;
+}
+
 size_t
 InputStream::LockRead(void *ptr, size_t _size, Error &error)
 {
@@ -135,6 +163,8 @@ InputStream::LockRead(void *ptr, size_t _size, Error &error)
 #endif
 	assert(_size > 0);
 
+	const ScopeTrace trace("input.Read");
+
 	const ScopeLock protect(mutex);
 	return Read(ptr, _size, error);
 }
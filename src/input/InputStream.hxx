@@ -31,8 +31,10 @@
 #include <assert.h>
 
 class Cond;
+struct InputMetrics;
 class Error;
 struct Tag;
+template<typename T> struct ConstBuffer;
 
 class InputStream {
 public:
@@ -95,12 +97,27 @@ private:
 	 */
 	std::string mime;
 
+	/**
+	 * An opaque string which changes whenever the resource is
+	 * modified (e.g. the HTTP "ETag" or the modification time),
+	 * or empty if unknown.  It is used by the #InputCache.
+	 */
+	std::string validator;
+
+protected:
+	/**
+	 * Timing measurements, see EnableMetrics().  nullptr if
+	 * disabled.
+	 */
+	InputMetrics *metrics;
+
 public:
 	InputStream(const char *_uri, Mutex &_mutex, Cond &_cond)
 		:uri(_uri),
 		 mutex(_mutex), cond(_cond),
 		 ready(false), seekable(false),
-		 size(UNKNOWN_SIZE), offset(0) {
+		 size(UNKNOWN_SIZE), offset(0),
+		 metrics(nullptr) {
 		assert(_uri != nullptr);
 	}
 
@@ -167,6 +184,18 @@ public:
 
 	void SetReady();
 
+	/**
+	 * Start collecting #InputMetrics for this stream.  This is
+	 * done for streams opened by an input plugin.  Wrappers pass
+	 * this call to the stream which talks to the source.
+	 *
+	 * The caller must not lock the mutex.
+	 *
+	 * @param open_time the MonotonicClockUS() value when opening
+	 * began
+	 */
+	virtual void EnableMetrics(const char *plugin, uint64_t open_time);
+
 	/**
 	 * Return whether the stream is ready for reading and whether
 	 * the other attributes in this struct are valid.
@@ -216,6 +245,28 @@ public:
 		mime = std::move(_mime);
 	}
 
+	gcc_pure
+	bool HasValidator() const {
+		assert(ready);
+
+		return !validator.empty();
+	}
+
+	gcc_pure
+	const char *GetValidator() const {
+		assert(ready);
+
+		return validator.c_str();
+	}
+
+	void SetValidator(std::string &&_validator) {
+		validator = std::move(_validator);
+	}
+
+	void ClearValidator() {
+		validator.clear();
+	}
+
 	gcc_pure
 	bool KnownSize() const {
 		assert(ready);
@@ -358,6 +409,20 @@ public:
 	gcc_nonnull_all
 	virtual size_t Read(void *ptr, size_t size, Error &error) = 0;
 
+	/**
+	 * Like Read(), but return a pointer to data which is already
+	 * in memory (e.g. a memory-mapped file) instead of copying
+	 * it.  The pointer remains valid as long as this object
+	 * exists.  The default implementation returns nullptr, which
+	 * means the caller shall use Read() instead; this is also
+	 * what implementations do at the end of the stream.
+	 *
+	 * The caller must lock the mutex.
+	 *
+	 * @param size the maximum number of bytes to return
+	 */
+	virtual ConstBuffer<void> ReadDirect(size_t size);
+
 	/**
 	 * Wrapper for Read() which locks and unlocks the mutex;
 	 * the caller must not be holding it already.
@@ -22,7 +22,9 @@
 #include "Registry.hxx"
 #include "InputPlugin.hxx"
 #include "LocalOpen.hxx"
+#include "CacheInputStream.hxx"
 #include "Domain.hxx"
+#include "system/Clock.hxx"
 #include "plugins/RewindInputPlugin.hxx"
 #include "fs/Traits.hxx"
 #include "fs/AllocatedPath.hxx"
@@ -42,11 +44,16 @@ InputStream::Open(const char *url,
 					    mutex, cond, error);
 	}
 
+	const uint64_t open_time = MonotonicClockUS();
+
 	input_plugins_for_each_enabled(plugin) {
 		InputStream *is;
 
 		is = plugin->open(url, mutex, cond, error);
 		if (is != nullptr) {
+			is->EnableMetrics(plugin->name, open_time);
+
+			is = input_cache_open(is);
 			is = input_rewind_open(is);
 
 			return InputStreamPtr(is);
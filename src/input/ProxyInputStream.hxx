@@ -45,6 +45,9 @@ public:
 	/* virtual methods from InputStream */
 	bool Check(Error &error) override;
 	void Update() override;
+	void EnableMetrics(const char *plugin, uint64_t open_time) override {
+		input.EnableMetrics(plugin, open_time);
+	}
 	bool Seek(offset_type new_offset, Error &error) override;
 	bool IsEOF() override;
 	Tag *ReadTag() override;
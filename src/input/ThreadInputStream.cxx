@@ -22,6 +22,10 @@
 #include "thread/Name.hxx"
 #include "util/CircularBuffer.hxx"
 #include "util/HugeAllocator.hxx"
+#include "util/MemStats.hxx"
+#include "Domain.hxx"
+#include "InputMetrics.hxx"
+#include "system/Clock.hxx"
 
 #include <assert.h>
 #include <string.h>
@@ -39,6 +43,7 @@ ThreadInputStream::~ThreadInputStream()
 
 	if (buffer != nullptr) {
 		buffer->Clear();
+		MemStatsFree(MemStatsCategory::INPUT_BUFFER, buffer_size);
 		HugeFree(buffer->Write().data, buffer_size);
 		delete buffer;
 	}
@@ -56,6 +61,7 @@ ThreadInputStream::Start(Error &error)
 	}
 
 	buffer = new CircularBuffer<uint8_t>((uint8_t *)p, buffer_size);
+	MemStatsAllocate(MemStatsCategory::INPUT_BUFFER, buffer_size);
 
 	if (!thread.Start(ThreadFunc, this, error))
 		return nullptr;
@@ -79,27 +85,72 @@ ThreadInputStream::ThreadFunc()
 	SetReady();
 
 	while (!close) {
-		assert(!postponed_error.IsDefined());
+		if (seek_pending) {
+			const offset_type new_offset = seek_offset;
+			Unlock();
+
+			Error error;
+			bool success = ThreadSeek(new_offset, error);
+
+			Lock();
+
+			buffer->Clear();
+			full = false;
+			seek_pending = false;
+			cond.broadcast();
+
+			if (success) {
+				/* a seek recovers from a failed read */
+				postponed_error.Clear();
+				offset = new_offset;
+				eof = false;
+			} else {
+				postponed_error = std::move(error);
+				eof = true;
+			}
+
+			continue;
+		}
+
+		if (full && buffer->GetSize() <= low_watermark)
+			full = false;
 
 		auto w = buffer->Write();
-		if (w.IsEmpty()) {
+		if (w.IsEmpty())
+			full = true;
+
+		if (eof || full) {
 			wake_cond.wait(mutex);
 		} else {
+			if (max_read > 0 && w.size > max_read)
+				w.size = max_read;
+
 			Unlock();
 
 			Error error;
 			size_t nbytes = ThreadRead(w.data, w.size, error);
 
 			Lock();
+
+			if (seek_pending)
+				/* Seek() has been called meanwhile;
+				   this data is obsolete */
+				continue;
+
 			cond.broadcast();
 
 			if (nbytes == 0) {
+				/* keep running after the end of the
+				   stream: Seek() may still be called */
 				eof = true;
 				postponed_error = std::move(error);
-				break;
+				continue;
 			}
 
 			buffer->Append(nbytes);
+
+			if (metrics != nullptr)
+				metrics->Received(nbytes);
 		}
 	}
 
@@ -141,6 +192,8 @@ ThreadInputStream::Read(void *ptr, size_t read_size, Error &error)
 {
 	assert(!thread.IsInside());
 
+	uint64_t wait_start = 0;
+
 	while (true) {
 		if (postponed_error.IsDefined()) {
 			error = std::move(postponed_error);
@@ -149,6 +202,9 @@ ThreadInputStream::Read(void *ptr, size_t read_size, Error &error)
 
 		auto r = buffer->Read();
 		if (!r.IsEmpty()) {
+			if (wait_start > 0)
+				metrics->Underrun(MonotonicClockUS() - wait_start);
+
 			size_t nbytes = std::min(read_size, r.size);
 			memcpy(ptr, r.data, nbytes);
 			buffer->Consume(nbytes);
@@ -160,14 +216,72 @@ ThreadInputStream::Read(void *ptr, size_t read_size, Error &error)
 		if (eof)
 			return 0;
 
+		if (wait_start == 0 && metrics != nullptr &&
+		    metrics->first_byte_us.load(std::memory_order_relaxed) > 0)
+			/* the buffer has run empty after data had
+			   been flowing */
+			wait_start = MonotonicClockUS();
+
 		cond.wait(mutex);
 	}
 }
 
+bool
+ThreadInputStream::ThreadSeek(gcc_unused offset_type new_offset,
+			      Error &error)
+{
+	/* unreachable unless a plugin sets the "seekable" flag
+	   without implementing this method */
+	assert(false);
+
+	error.Set(input_domain, "Seeking is not implemented");
+	return false;
+}
+
+bool
+ThreadInputStream::Seek(offset_type new_offset, Error &error)
+{
+	assert(!thread.IsInside());
+
+	if (!IsSeekable() || !IsReady())
+		return InputStream::Seek(new_offset, error);
+
+	if (new_offset >= offset && !postponed_error.IsDefined() &&
+	    new_offset - offset <= buffer->GetSize()) {
+		/* the new offset is inside the buffer: skip the data
+		   in between */
+		size_t skip = new_offset - offset;
+		while (skip > 0) {
+			auto r = buffer->Read();
+			size_t nbytes = std::min(skip, r.size);
+			buffer->Consume(nbytes);
+			skip -= nbytes;
+		}
+
+		offset = new_offset;
+		wake_cond.signal();
+		return true;
+	}
+
+	seek_offset = new_offset;
+	seek_pending = true;
+	wake_cond.signal();
+
+	const uint64_t start_time = metrics != nullptr ? MonotonicClockUS() : 0;
+
+	while (seek_pending)
+		cond.wait(mutex);
+
+	if (metrics != nullptr)
+		metrics->seek.Add(MonotonicClockUS() - start_time);
+
+	return Check(error);
+}
+
 bool
 ThreadInputStream::IsEOF()
 {
 	assert(!thread.IsInside());
 
-	return eof;
+	return eof && buffer->IsEmpty();
 }
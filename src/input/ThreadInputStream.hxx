@@ -26,6 +26,8 @@
 #include "thread/Cond.hxx"
 #include "util/Error.hxx"
 
+#include <algorithm>
+
 #include <stdint.h>
 
 template<typename T> class CircularBuffer;
@@ -37,7 +39,9 @@ template<typename T> class CircularBuffer;
  * another thread using the regular #InputStream API.  This class
  * manages the thread and the buffer.
  *
- * This works only for "streams": unknown length, no seeking, no tags.
+ * By default, this works only for "streams": unknown length, no
+ * seeking, no tags.  Plugins which implement ThreadSeek() and set the
+ * #seekable flag can be seeked; the buffer is discarded then.
  */
 class ThreadInputStream : public InputStream {
 	const char *const plugin;
@@ -56,6 +60,25 @@ class ThreadInputStream : public InputStream {
 	const size_t buffer_size;
 	CircularBuffer<uint8_t> *buffer;
 
+	/**
+	 * The maximum size passed to ThreadRead(); 0 means no limit.
+	 */
+	const size_t max_read;
+
+	/**
+	 * After the buffer has become full, the thread does not read
+	 * again until it has been drained to this number of bytes.
+	 * This avoids many small reads when the consumer is slower
+	 * than the source.
+	 */
+	const size_t low_watermark;
+
+	/**
+	 * The new offset requested by Seek(); only valid if
+	 * #seek_pending is set.
+	 */
+	offset_type seek_offset;
+
 	/**
 	 * Shall the stream be closed?
 	 */
@@ -66,15 +89,35 @@ class ThreadInputStream : public InputStream {
 	 */
 	bool eof;
 
+	/**
+	 * Is the buffer full, waiting to drain to #low_watermark?
+	 */
+	bool full;
+
+	/**
+	 * Has Seek() been called?  The thread clears this flag after
+	 * ThreadSeek() has finished.
+	 */
+	bool seek_pending;
+
 public:
+	/**
+	 * @param _max_read the maximum size of one ThreadRead()
+	 * call; 0 means no limit
+	 * @param _low_watermark see #low_watermark
+	 */
 	ThreadInputStream(const char *_plugin,
 			  const char *_uri, Mutex &_mutex, Cond &_cond,
-			  size_t _buffer_size)
+			  size_t _buffer_size,
+			  size_t _max_read=0, size_t _low_watermark=0)
 		:InputStream(_uri, _mutex, _cond),
 		 plugin(_plugin),
 		 buffer_size(_buffer_size),
 		 buffer(nullptr),
-		 close(false), eof(false) {}
+		 max_read(_max_read),
+		 low_watermark(std::min(_low_watermark, _buffer_size - 1)),
+		 close(false), eof(false), full(false),
+		 seek_pending(false) {}
 
 	virtual ~ThreadInputStream();
 
@@ -90,6 +133,7 @@ public:
 	bool IsEOF() override final;
 	bool IsAvailable() override final;
 	size_t Read(void *ptr, size_t size, Error &error) override final;
+	bool Seek(offset_type offset, Error &error) override final;
 
 protected:
 	void SetMimeType(const char *_mime) {
@@ -121,6 +165,14 @@ protected:
 	 */
 	virtual size_t ThreadRead(void *ptr, size_t size, Error &error) = 0;
 
+	/**
+	 * Seek the stream.  Only called if the #seekable flag is set.
+	 *
+	 * The #InputStream is not locked.
+	 */
+	virtual bool ThreadSeek(offset_type new_offset,
+				Error &error);
+
 	/**
 	 * Optional deinitialization before leaving the thread.
 	 *
@@ -20,6 +20,7 @@
 #include "config.h"
 #include "CurlInputPlugin.hxx"
 #include "../AsyncInputStream.hxx"
+#include "../InputMetrics.hxx"
 #include "../IcyInputStream.hxx"
 #include "../InputPlugin.hxx"
 #include "config/ConfigGlobal.hxx"
@@ -29,16 +30,29 @@
 #include "event/TimeoutMonitor.hxx"
 #include "event/Call.hxx"
 #include "IOThread.hxx"
+#include "thread/Mutex.hxx"
 #include "util/ASCII.hxx"
 #include "util/StringUtil.hxx"
 #include "util/NumberParser.hxx"
 #include "util/HugeAllocator.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
+#include "fs/AllocatedPath.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+#include <string>
+#include <list>
+
 #include <assert.h>
+#include <errno.h>
 #include <string.h>
+#include <stdlib.h>
+
+#ifndef WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include <curl/curl.h>
 
@@ -47,18 +61,152 @@
 #endif
 
 /**
- * Do not buffer more than this number of bytes.  It should be a
- * reasonable limit that doesn't make low-end machines suffer too
- * much, but doesn't cause stuttering on high-latency lines.
+ * Do not buffer more than this number of bytes by default.  It
+ * should be a reasonable limit that doesn't make low-end machines
+ * suffer too much, but doesn't cause stuttering on high-latency
+ * lines.
+ */
+static constexpr size_t CURL_DEFAULT_BUFFER_SIZE = 512 * 1024;
+
+/**
+ * The default maximum size of a stream which may be spilled to disk.
+ */
+static constexpr unsigned CURL_DEFAULT_SPILL_MAX_SIZE = 256 * 1024 * 1024;
+
+/**
+ * The configured size of the in-memory buffer.
+ */
+static size_t curl_buffer_size = CURL_DEFAULT_BUFFER_SIZE;
+
+/**
+ * Resume the stream at this number of bytes after it has been
+ * paused; this is 3/4 of #curl_buffer_size.
+ */
+static size_t curl_resume_at = CURL_DEFAULT_BUFFER_SIZE / 4 * 3;
+
+#ifndef WIN32
+
+/**
+ * If not empty, then streams with a known size are downloaded into
+ * an anonymous file in this directory at full speed, and seeks
+ * within the downloaded part are served from there.
+ */
+static std::string curl_spill_directory;
+
+/**
+ * Streams larger than this are not spilled to disk.
+ */
+static uint64_t curl_spill_max_size;
+
+/**
+ * The default minimum size of a stream which is downloaded over
+ * several connections.
+ */
+static constexpr unsigned CURL_DEFAULT_PARALLEL_MIN_SIZE = 16 * 1024 * 1024;
+
+/**
+ * Spilled streams are downloaded over this number of connections,
+ * each fetching one range of the file.  1 disables this.
+ */
+static unsigned curl_parallel_connections;
+
+/**
+ * Smaller streams are downloaded over one connection.
+ */
+static uint64_t curl_parallel_min_size;
+
+#endif
+
+/**
+ * Receives the completion of a request; the CURLOPT_PRIVATE pointer
+ * of each "libcurl easy" handle points to one.
  */
-static const size_t CURL_MAX_BUFFERED = 512 * 1024;
+class CurlRequestHandler {
+public:
+	/**
+	 * A HTTP request is finished.
+	 *
+	 * Runs in the I/O thread.  The caller must not hold locks.
+	 */
+	virtual void RequestDone(CURLcode result, long status) = 0;
+};
+
+struct CurlInputStream;
+
+#ifndef WIN32
 
 /**
- * Resume the stream at this number of bytes after it has been paused.
+ * Fetches one range of a spilled stream over a separate connection,
+ * and writes it to the spill file.  See #curl_parallel_connections.
  */
-static const size_t CURL_RESUME_AT = 384 * 1024;
+class CurlRangeFetcher final : public CurlRequestHandler, DeferredMonitor {
+	CurlInputStream &parent;
+
+	CURL *easy = nullptr;
+	struct curl_slist *request_headers = nullptr;
+
+	char range[48];
+	char error_buffer[CURL_ERROR_SIZE];
+
+public:
+	/**
+	 * The range in the spill file (relative to
+	 * CurlInputStream::spill_base).
+	 */
+	const offset_type start, end;
+
+	/**
+	 * The number of bytes written to the spill file.
+	 */
+	offset_type written = 0;
+
+	/**
+	 * Has the server ignored the range request?
+	 */
+	bool range_ignored = false;
+
+	CurlRangeFetcher(CurlInputStream &_parent,
+			 offset_type _start, offset_type _end)
+		:DeferredMonitor(io_thread_get(IOThreadRole::INPUT)),
+		 parent(_parent), start(_start), end(_end) {}
+
+	~CurlRangeFetcher() {
+		FreeEasy();
+	}
 
-struct CurlInputStream final : public AsyncInputStream {
+	CurlRangeFetcher(const CurlRangeFetcher &) = delete;
+	CurlRangeFetcher &operator=(const CurlRangeFetcher &) = delete;
+
+	bool IsComplete() const {
+		return written == end - start;
+	}
+
+	/**
+	 * Start the request as soon as the I/O thread gets to it;
+	 * libcurl does not allow adding handles from its callbacks.
+	 */
+	using DeferredMonitor::Schedule;
+
+	const char *GetErrorMessage() const {
+		return error_buffer;
+	}
+
+	size_t DataReceived(const void *ptr, size_t size);
+
+	/* virtual methods from CurlRequestHandler */
+	void RequestDone(CURLcode result, long status) override;
+
+private:
+	bool Start(Error &error);
+	void FreeEasy();
+
+	/* virtual methods from DeferredMonitor */
+	void RunDeferred() override;
+};
+
+#endif
+
+struct CurlInputStream final : public AsyncInputStream, CurlRequestHandler {
 	/* some buffers which were passed to libcurl, which we have
 	   too free */
 	char range[32];
@@ -73,11 +221,70 @@ struct CurlInputStream final : public AsyncInputStream {
 	/** parser for icy-metadata */
 	IcyInputStream *icy;
 
+	/**
+	 * Has the response contained an "ETag" header?  It is
+	 * preferred over "Last-Modified" as the validator.
+	 */
+	bool have_etag = false;
+
+#ifndef WIN32
+	/**
+	 * The anonymous file all received data is written to, or -1
+	 * if spilling is disabled for this stream.  The memory buffer
+	 * is then refilled from this file, and seeking within the
+	 * downloaded range does not need a new HTTP request.
+	 */
+	int spill_fd = -1;
+
+	/**
+	 * The stream offset of the first byte in the spill file.
+	 */
+	offset_type spill_base;
+
+	/**
+	 * The number of bytes written to the spill file.
+	 */
+	offset_type spill_end;
+
+	/**
+	 * The spill file position of the next byte to be copied to
+	 * the memory buffer.
+	 */
+	offset_type spill_fill;
+
+	/**
+	 * Has CheckSpill() already been called for this stream?
+	 */
+	bool spill_checked = false;
+
+	/**
+	 * Writing to the spill file has failed while it still had
+	 * data for the memory buffer.  The transfer is paused until
+	 * that data has been consumed; then the spill file is closed
+	 * and the stream continues with the memory buffer only.
+	 */
+	bool spill_stalled = false;
+
+	/**
+	 * The requests fetching the rest of the stream in parallel,
+	 * sorted by their start offset.  While this is not empty,
+	 * this request only fetches the spill file range before the
+	 * first one.
+	 */
+	std::list<CurlRangeFetcher> fetchers;
+
+	/**
+	 * This request has been aborted after it had received its
+	 * range; the resulting CURLE_WRITE_ERROR is not an error.
+	 */
+	bool truncated = false;
+#endif
+
 	CurlInputStream(const char *_url, Mutex &_mutex, Cond &_cond,
 			void *_buffer)
 		:AsyncInputStream(_url, _mutex, _cond,
-				  _buffer, CURL_MAX_BUFFERED,
-				  CURL_RESUME_AT),
+				  _buffer, curl_buffer_size,
+				  curl_resume_at),
 		 request_headers(nullptr),
 		 icy(new IcyInputStream(this)) {}
 
@@ -118,12 +325,83 @@ struct CurlInputStream final : public AsyncInputStream {
 
 	size_t DataReceived(const void *ptr, size_t size);
 
+#ifndef WIN32
 	/**
-	 * A HTTP request is finished.
+	 * Create the spill file if spilling is configured and this
+	 * stream qualifies.  Caller must hold the mutex.
+	 */
+	void CheckSpill();
+
+	/**
+	 * Write received data to the spill file and copy as much as
+	 * possible to the memory buffer.  Caller must hold the mutex.
 	 *
-	 * Runs in the I/O thread.  The caller must not hold locks.
+	 * @return false on I/O error; then the spill file has either
+	 * been closed (and the caller shall fall back to the memory
+	 * buffer) or #spill_stalled has been set (and the caller
+	 * shall pause the transfer)
+	 */
+	bool SpillReceived(const void *ptr, size_t size);
+
+	/**
+	 * Split the rest of the stream into ranges which are fetched
+	 * in parallel; this request fetches only the first one.
+	 * Caller must hold the mutex.
+	 */
+	void StartFetchers();
+
+	/**
+	 * Stop and delete all #fetchers.  Runs in the I/O thread, but
+	 * not in a libcurl callback.
+	 */
+	void CancelFetchers();
+
+	/**
+	 * Advance #spill_end over the ranges which have been fetched.
+	 * Caller must hold the mutex.
+	 */
+	void UpdateSpillEnd();
+
+	/**
+	 * Has the whole stream been written to the spill file (or
+	 * will this request deliver the rest)?
+	 */
+	gcc_pure
+	bool AreFetchersComplete() const;
+
+	/**
+	 * Data for one range has been received.  Caller must not
+	 * hold the mutex.
+	 */
+	size_t RangeReceived(CurlRangeFetcher &fetcher,
+			     const void *ptr, size_t size);
+
+	/**
+	 * The request of one range is finished.  Caller must not
+	 * hold the mutex.
+	 */
+	void RangeDone(CurlRangeFetcher &fetcher, CURLcode result);
+
+	/**
+	 * A range request has failed.  Caller must hold the mutex.
 	 */
-	void RequestDone(CURLcode result, long status);
+	void RangeError(Error &&error) {
+		if (!postponed_error.IsDefined())
+			PostponeError(std::move(error));
+	}
+
+	/**
+	 * Copy data from the spill file to the memory buffer.  If not
+	 * everything fits, the stream is marked "paused", so
+	 * DoResume() gets called when the buffer drains.
+	 */
+	void FillFromSpill();
+
+	void CloseSpill();
+#endif
+
+	/* virtual methods from CurlRequestHandler */
+	void RequestDone(CURLcode result, long status) override;
 
 	/* virtual methods from AsyncInputStream */
 	virtual void DoResume() override;
@@ -195,15 +473,33 @@ private:
 class CurlMulti final : private TimeoutMonitor {
 	CURLM *const multi;
 
+	/**
+	 * Shares the DNS cache, TLS sessions and (with libcurl 7.57
+	 * or newer) connections among all easy handles, so
+	 * consecutive streams from the same server can skip those
+	 * handshakes.
+	 */
+	CURLSH *const share;
+
+	/**
+	 * One mutex for each kind of data protected by #share.
+	 */
+	Mutex share_mutexes[CURL_LOCK_DATA_LAST];
+
 public:
-	CurlMulti(EventLoop &_loop, CURLM *_multi);
+	CurlMulti(EventLoop &_loop, CURLM *_multi, CURLSH *_share);
 
 	~CurlMulti() {
 		curl_multi_cleanup(multi);
+		curl_share_cleanup(share);
 	}
 
-	bool Add(CurlInputStream *c, Error &error);
-	void Remove(CurlInputStream *c);
+	CURLSH *GetShare() {
+		return share;
+	}
+
+	bool Add(CURL *easy, Error &error);
+	void Remove(CURL *easy);
 
 	/**
 	 * Check for finished HTTP responses.
@@ -235,6 +531,16 @@ public:
 private:
 	static int TimerFunction(CURLM *multi, long timeout_ms, void *userp);
 
+	/**
+	 * Callbacks for CURLSHOPT_LOCKFUNC and CURLSHOPT_UNLOCKFUNC.
+	 * Easy handles are created (and attached to the share) in
+	 * the client thread, while the I/O thread runs transfers.
+	 */
+	static void LockFunction(CURL *easy, curl_lock_data data,
+				 curl_lock_access access, void *userp);
+	static void UnlockFunction(CURL *easy, curl_lock_data data,
+				   void *userp);
+
 	virtual void OnTimeout() override;
 };
 
@@ -252,14 +558,19 @@ static unsigned proxy_port;
 
 static bool verify_peer, verify_host;
 
+/**
+ * Negotiate HTTP/2 with servers which support it?
+ */
+static bool http2;
+
 static CurlMulti *curl_multi;
 
 static constexpr Domain http_domain("http");
 static constexpr Domain curl_domain("curl");
 static constexpr Domain curlm_domain("curlm");
 
-CurlMulti::CurlMulti(EventLoop &_loop, CURLM *_multi)
-	:TimeoutMonitor(_loop), multi(_multi)
+CurlMulti::CurlMulti(EventLoop &_loop, CURLM *_multi, CURLSH *_share)
+	:TimeoutMonitor(_loop), multi(_multi), share(_share)
 {
 	curl_multi_setopt(multi, CURLMOPT_SOCKETFUNCTION,
 			  CurlSocket::SocketFunction);
@@ -267,6 +578,43 @@ CurlMulti::CurlMulti(EventLoop &_loop, CURLM *_multi)
 
 	curl_multi_setopt(multi, CURLMOPT_TIMERFUNCTION, TimerFunction);
 	curl_multi_setopt(multi, CURLMOPT_TIMERDATA, this);
+
+#if LIBCURL_VERSION_NUM >= 0x072b00
+	if (http2)
+		/* run concurrent requests to the same HTTP/2 server
+		   over one connection */
+		curl_multi_setopt(multi, CURLMOPT_PIPELINING,
+				  CURLPIPE_MULTIPLEX);
+#endif
+
+	curl_share_setopt(share, CURLSHOPT_LOCKFUNC, LockFunction);
+	curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, UnlockFunction);
+	curl_share_setopt(share, CURLSHOPT_USERDATA, this);
+	curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+#if LIBCURL_VERSION_NUM >= 0x073900
+	curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+#endif
+}
+
+void
+CurlMulti::LockFunction(gcc_unused CURL *easy, curl_lock_data data,
+			gcc_unused curl_lock_access access, void *userp)
+{
+	CurlMulti &m = *(CurlMulti *)userp;
+	assert(unsigned(data) < CURL_LOCK_DATA_LAST);
+
+	m.share_mutexes[data].lock();
+}
+
+void
+CurlMulti::UnlockFunction(gcc_unused CURL *easy, curl_lock_data data,
+			  void *userp)
+{
+	CurlMulti &m = *(CurlMulti *)userp;
+	assert(unsigned(data) < CURL_LOCK_DATA_LAST);
+
+	m.share_mutexes[data].unlock();
 }
 
 /**
@@ -275,23 +623,34 @@ CurlMulti::CurlMulti(EventLoop &_loop, CURLM *_multi)
  * Runs in the I/O thread.  No lock needed.
  */
 gcc_pure
-static CurlInputStream *
+static CurlRequestHandler *
 input_curl_find_request(CURL *easy)
 {
-	assert(io_thread_inside());
+	assert(io_thread_inside(IOThreadRole::INPUT));
 
 	void *p;
 	CURLcode code = curl_easy_getinfo(easy, CURLINFO_PRIVATE, &p);
 	if (code != CURLE_OK)
 		return nullptr;
 
-	return (CurlInputStream *)p;
+	return (CurlRequestHandler *)p;
 }
 
 void
 CurlInputStream::DoResume()
 {
-	assert(io_thread_inside());
+	assert(io_thread_inside(IOThreadRole::INPUT));
+
+#ifndef WIN32
+	if (spill_fd >= 0) {
+		FillFromSpill();
+		if (!spill_stalled || spill_fill < spill_end)
+			/* the transfer was never paused */
+			return;
+
+		CloseSpill();
+	}
+#endif
 
 	mutex.unlock();
 
@@ -315,7 +674,7 @@ CurlSocket::SocketFunction(gcc_unused CURL *easy,
 	CurlMulti &multi = *(CurlMulti *)userp;
 	CurlSocket *cs = (CurlSocket *)socketp;
 
-	assert(io_thread_inside());
+	assert(io_thread_inside(IOThreadRole::INPUT));
 
 	if (action == CURL_POLL_REMOVE) {
 		delete cs;
@@ -323,7 +682,7 @@ CurlSocket::SocketFunction(gcc_unused CURL *easy,
 	}
 
 	if (cs == nullptr) {
-		cs = new CurlSocket(multi, io_thread_get(), s);
+		cs = new CurlSocket(multi, io_thread_get(IOThreadRole::INPUT), s);
 		multi.Assign(s, *cs);
 	} else {
 #ifdef USE_EPOLL
@@ -348,7 +707,7 @@ CurlSocket::SocketFunction(gcc_unused CURL *easy,
 bool
 CurlSocket::OnSocketReady(unsigned flags)
 {
-	assert(io_thread_inside());
+	assert(io_thread_inside(IOThreadRole::INPUT));
 
 	multi.SocketAction(Get(), FlagsToCurlCSelect(flags));
 	return true;
@@ -358,13 +717,12 @@ CurlSocket::OnSocketReady(unsigned flags)
  * Runs in the I/O thread.  No lock needed.
  */
 inline bool
-CurlMulti::Add(CurlInputStream *c, Error &error)
+CurlMulti::Add(CURL *easy, Error &error)
 {
-	assert(io_thread_inside());
-	assert(c != nullptr);
-	assert(c->easy != nullptr);
+	assert(io_thread_inside(IOThreadRole::INPUT));
+	assert(easy != nullptr);
 
-	CURLMcode mcode = curl_multi_add_handle(multi, c->easy);
+	CURLMcode mcode = curl_multi_add_handle(multi, easy);
 	if (mcode != CURLM_OK) {
 		error.Format(curlm_domain, mcode,
 			     "curl_multi_add_handle() failed: %s",
@@ -387,27 +745,27 @@ input_curl_easy_add_indirect(CurlInputStream *c, Error &error)
 	assert(c->easy != nullptr);
 
 	bool result;
-	BlockingCall(io_thread_get(), [c, &error, &result](){
-			result = curl_multi->Add(c, error);
+	BlockingCall(io_thread_get(IOThreadRole::INPUT), [c, &error, &result](){
+			result = curl_multi->Add(c->easy, error);
 		});
 	return result;
 }
 
 inline void
-CurlMulti::Remove(CurlInputStream *c)
+CurlMulti::Remove(CURL *easy)
 {
-	curl_multi_remove_handle(multi, c->easy);
+	curl_multi_remove_handle(multi, easy);
 }
 
 void
 CurlInputStream::FreeEasy()
 {
-	assert(io_thread_inside());
+	assert(io_thread_inside(IOThreadRole::INPUT));
 
 	if (easy == nullptr)
 		return;
 
-	curl_multi->Remove(this);
+	curl_multi->Remove(easy);
 
 	curl_easy_cleanup(easy);
 	easy = nullptr;
@@ -419,26 +777,43 @@ CurlInputStream::FreeEasy()
 void
 CurlInputStream::FreeEasyIndirect()
 {
-	BlockingCall(io_thread_get(), [this](){
+	BlockingCall(io_thread_get(IOThreadRole::INPUT), [this](){
 			FreeEasy();
+#ifndef WIN32
+			CancelFetchers();
+#endif
 			curl_multi->InvalidateSockets();
 		});
 
 	assert(easy == nullptr);
 }
 
-inline void
+void
 CurlInputStream::RequestDone(CURLcode result, long status)
 {
-	assert(io_thread_inside());
-	assert(!postponed_error.IsDefined());
+	assert(io_thread_inside(IOThreadRole::INPUT));
 
 	FreeEasy();
-	AsyncInputStream::SetClosed();
 
 	const ScopeLock protect(mutex);
 
-	if (result != CURLE_OK) {
+#ifndef WIN32
+	if (truncated && result == CURLE_WRITE_ERROR)
+		/* DataReceived() has aborted the transfer at the
+		   first range fetched by another request */
+		result = CURLE_OK;
+
+	/* with a spill file, the stream is declared closed only after
+	   its last byte has been copied to the memory buffer; see
+	   FillFromSpill() */
+	if (spill_fd < 0 ||
+	    (spill_fill == spill_end && AreFetchersComplete()))
+#endif
+		AsyncInputStream::SetClosed();
+
+	if (postponed_error.IsDefined()) {
+		/* a range request has failed already */
+	} else if (result != CURLE_OK) {
 		postponed_error.Format(curl_domain, result,
 				       "curl failed: %s", error_buffer);
 	} else if (status < 200 || status >= 300) {
@@ -458,7 +833,7 @@ CurlInputStream::RequestDone(CURLcode result, long status)
 static void
 input_curl_handle_done(CURL *easy_handle, CURLcode result)
 {
-	CurlInputStream *c = input_curl_find_request(easy_handle);
+	CurlRequestHandler *c = input_curl_find_request(easy_handle);
 	assert(c != nullptr);
 
 	long status = 0;
@@ -489,7 +864,7 @@ CurlMulti::SocketAction(curl_socket_t fd, int ev_bitmask)
 inline void
 CurlMulti::ReadInfo()
 {
-	assert(io_thread_inside());
+	assert(io_thread_inside(IOThreadRole::INPUT));
 
 	CURLMsg *msg;
 	int msgs_in_queue;
@@ -537,6 +912,40 @@ CurlMulti::OnTimeout()
 static InputPlugin::InitResult
 input_curl_init(const ConfigBlock &block, Error &error)
 {
+	curl_buffer_size = block.GetBlockValue("buffer_size",
+					       unsigned(CURL_DEFAULT_BUFFER_SIZE));
+	if (curl_buffer_size < 16384) {
+		error.Set(curl_domain, "buffer_size is too small");
+		return InputPlugin::InitResult::ERROR;
+	}
+
+	curl_resume_at = curl_buffer_size / 4 * 3;
+
+#ifndef WIN32
+	AllocatedPath spill_directory =
+		block.GetBlockPath("spill_directory", error);
+	if (error.IsDefined())
+		return InputPlugin::InitResult::ERROR;
+
+	if (!spill_directory.IsNull())
+		curl_spill_directory = spill_directory.c_str();
+
+	curl_spill_max_size = block.GetBlockValue("spill_max_size",
+						  CURL_DEFAULT_SPILL_MAX_SIZE);
+
+	curl_parallel_connections =
+		block.GetBlockValue("parallel_connections", 1u);
+	if (curl_parallel_connections < 1 ||
+	    curl_parallel_connections > 16) {
+		error.Set(curl_domain, "parallel_connections must be 1..16");
+		return InputPlugin::InitResult::ERROR;
+	}
+
+	curl_parallel_min_size =
+		block.GetBlockValue("parallel_min_size",
+				    CURL_DEFAULT_PARALLEL_MIN_SIZE);
+#endif
+
 	CURLcode code = curl_global_init(CURL_GLOBAL_ALL);
 	if (code != CURLE_OK) {
 		error.Format(curl_domain, code,
@@ -573,6 +982,8 @@ input_curl_init(const ConfigBlock &block, Error &error)
 
 	verify_peer = block.GetBlockValue("verify_peer", true);
 	verify_host = block.GetBlockValue("verify_host", true);
+	http2 = block.GetBlockValue("http2", true);
+
 
 	CURLM *multi = curl_multi_init();
 	if (multi == nullptr) {
@@ -582,14 +993,24 @@ input_curl_init(const ConfigBlock &block, Error &error)
 		return InputPlugin::InitResult::UNAVAILABLE;
 	}
 
-	curl_multi = new CurlMulti(io_thread_get(), multi);
+	CURLSH *share = curl_share_init();
+	if (share == nullptr) {
+		curl_multi_cleanup(multi);
+		curl_slist_free_all(http_200_aliases);
+		curl_global_cleanup();
+		error.Set(curl_domain, 0, "curl_share_init() failed");
+		return InputPlugin::InitResult::UNAVAILABLE;
+	}
+
+	curl_multi = new CurlMulti(io_thread_get(IOThreadRole::INPUT),
+				   multi, share);
 	return InputPlugin::InitResult::SUCCESS;
 }
 
 static void
 input_curl_finish(void)
 {
-	BlockingCall(io_thread_get(), [](){
+	BlockingCall(io_thread_get(IOThreadRole::INPUT), [](){
 			delete curl_multi;
 		});
 
@@ -602,6 +1023,10 @@ input_curl_finish(void)
 CurlInputStream::~CurlInputStream()
 {
 	FreeEasyIndirect();
+
+#ifndef WIN32
+	CloseSpill();
+#endif
 }
 
 inline void
@@ -610,6 +1035,15 @@ CurlInputStream::ResponseBoundary()
 	/* undo all effects of HeaderReceived() because the previous
 	   response was not applicable for this stream */
 
+	if (metrics != nullptr) {
+		/* the connection has been established now */
+		double dns = 0, connect = 0, tls = 0;
+		curl_easy_getinfo(easy, CURLINFO_NAMELOOKUP_TIME, &dns);
+		curl_easy_getinfo(easy, CURLINFO_CONNECT_TIME, &connect);
+		curl_easy_getinfo(easy, CURLINFO_APPCONNECT_TIME, &tls);
+		metrics->SetConnectTimes(dns * 1e6, connect * 1e6, tls * 1e6);
+	}
+
 	if (IsSeekPending())
 		/* don't update metadata while seeking */
 		return;
@@ -617,6 +1051,8 @@ CurlInputStream::ResponseBoundary()
 	seekable = false;
 	size = UNKNOWN_SIZE;
 	ClearMimeType();
+	ClearValidator();
+	have_etag = false;
 	ClearTag();
 
 	// TODO: reset the IcyInputStream?
@@ -637,6 +1073,12 @@ CurlInputStream::HeaderReceived(const char *name, std::string &&value)
 		size = offset + ParseUint64(value.c_str());
 	} else if (StringEqualsCaseASCII(name, "content-type")) {
 		SetMimeType(std::move(value));
+	} else if (StringEqualsCaseASCII(name, "etag")) {
+		SetValidator(std::move(value));
+		have_etag = true;
+	} else if (StringEqualsCaseASCII(name, "last-modified")) {
+		if (!have_etag)
+			SetValidator(std::move(value));
 	} else if (StringEqualsCaseASCII(name, "icy-name") ||
 		   StringEqualsCaseASCII(name, "ice-name") ||
 		   StringEqualsCaseASCII(name, "x-audiocast-name")) {
@@ -712,6 +1154,47 @@ CurlInputStream::DataReceived(const void *ptr, size_t received_size)
 	if (IsSeekPending())
 		SeekDone();
 
+#ifndef WIN32
+	CheckSpill();
+
+	if (spill_fd >= 0 && !fetchers.empty()) {
+		/* write only up to the first range fetched by
+		   another request */
+		const offset_type limit = fetchers.front().start;
+		assert(spill_end < limit);
+
+		const size_t n = std::min(offset_type(received_size),
+					  limit - spill_end);
+		const bool done = n == limit - spill_end;
+		if (!SpillReceived(ptr, n)) {
+			/* the other ranges are in the spill file; no
+			   way to continue without it */
+			Error error;
+			error.Set(curl_domain, "Failed to write spill file");
+			PostponeError(std::move(error));
+			return 0;
+		}
+
+		if (done) {
+			/* abort this request; see RequestDone() */
+			truncated = true;
+			return 0;
+		}
+
+		return received_size;
+	}
+
+	if (spill_fd >= 0) {
+		if (SpillReceived(ptr, received_size))
+			return received_size;
+
+		if (spill_stalled) {
+			AsyncInputStream::Pause();
+			return CURL_WRITEFUNC_PAUSE;
+		}
+	}
+#endif
+
 	if (received_size > GetBufferSpace()) {
 		AsyncInputStream::Pause();
 		return CURL_WRITEFUNC_PAUSE;
@@ -721,6 +1204,271 @@ CurlInputStream::DataReceived(const void *ptr, size_t received_size)
 	return received_size;
 }
 
+#ifndef WIN32
+
+#ifndef O_TMPFILE
+/* supported since Linux 3.11 */
+#define __O_TMPFILE 020000000
+#define O_TMPFILE (__O_TMPFILE | O_DIRECTORY)
+#endif
+
+/**
+ * Create an anonymous file in the given directory.
+ *
+ * @return the file descriptor or -1 on error (with errno set)
+ */
+static int
+OpenAnonymousFile(const char *directory)
+{
+#ifdef __linux__
+	int fd = open(directory, O_TMPFILE|O_RDWR|O_CLOEXEC, 0600);
+	if (fd >= 0 || (errno != EOPNOTSUPP && errno != EISDIR &&
+			errno != EINVAL))
+		return fd;
+#endif
+
+	std::string path(directory);
+	path += "/mpd-curl-XXXXXX";
+
+	int fd2 = mkstemp(&path.front());
+	if (fd2 < 0)
+		return -1;
+
+	unlink(path.c_str());
+	fcntl(fd2, F_SETFD, FD_CLOEXEC);
+	return fd2;
+}
+
+void
+CurlInputStream::CheckSpill()
+{
+	if (spill_checked || curl_spill_directory.empty())
+		return;
+
+	spill_checked = true;
+
+	/* only a stream with a known size can be downloaded
+	   completely; a stream with icy-metadata is a radio station
+	   which never ends */
+	if (!KnownSize() || icy->IsEnabled() ||
+	    uint64_t(size - offset) > curl_spill_max_size)
+		return;
+
+	spill_fd = OpenAnonymousFile(curl_spill_directory.c_str());
+	if (spill_fd < 0) {
+		FormatErrno(curl_domain,
+			    "Failed to create spill file in %s",
+			    curl_spill_directory.c_str());
+		return;
+	}
+
+	spill_base = offset;
+	spill_end = spill_fill = 0;
+
+	if (curl_parallel_connections > 1 && seekable &&
+	    uint64_t(size - offset) >= curl_parallel_min_size)
+		StartFetchers();
+}
+
+void
+CurlInputStream::StartFetchers()
+{
+	assert(spill_fd >= 0);
+	assert(fetchers.empty());
+
+	const offset_type total = size - spill_base;
+
+	/* round the ranges up to 64 kB */
+	const unsigned n = curl_parallel_connections;
+	offset_type range_size = (total + n - 1) / n;
+	range_size = (range_size + 0xffff) & ~offset_type(0xffff);
+
+	for (offset_type start = range_size; start < total;
+	     start += range_size) {
+		fetchers.emplace_back(*this, start,
+				      std::min(start + range_size, total));
+		fetchers.back().Schedule();
+	}
+
+	FormatDebug(curl_domain, "Fetching %s in %u ranges",
+		    GetURI(), unsigned(fetchers.size() + 1));
+}
+
+void
+CurlInputStream::CancelFetchers()
+{
+	assert(io_thread_inside(IOThreadRole::INPUT));
+
+	fetchers.clear();
+	truncated = false;
+}
+
+void
+CurlInputStream::UpdateSpillEnd()
+{
+	for (const auto &f : fetchers) {
+		if (spill_end < f.start)
+			break;
+
+		spill_end = std::max(spill_end, f.start + f.written);
+		if (!f.IsComplete())
+			break;
+	}
+}
+
+bool
+CurlInputStream::AreFetchersComplete() const
+{
+	return std::all_of(fetchers.begin(), fetchers.end(),
+			   [](const CurlRangeFetcher &f){
+				   return f.IsComplete();
+			   });
+}
+
+size_t
+CurlInputStream::RangeReceived(CurlRangeFetcher &f,
+			       const void *ptr, size_t received_size)
+{
+	const ScopeLock protect(mutex);
+
+	if (spill_fd < 0 || spill_stalled)
+		return 0;
+
+	const size_t n = std::min(offset_type(received_size),
+				  f.end - f.start - f.written);
+	ssize_t nbytes = pwrite(spill_fd, ptr, n, f.start + f.written);
+	if (nbytes != (ssize_t)n) {
+		if (nbytes >= 0)
+			errno = ENOSPC;
+		FormatErrno(curl_domain, "Failed to write spill file");
+		return 0;
+	}
+
+	f.written += n;
+
+	UpdateSpillEnd();
+	FillFromSpill();
+	return received_size;
+}
+
+void
+CurlInputStream::RangeDone(CurlRangeFetcher &f, CURLcode result)
+{
+	const ScopeLock protect(mutex);
+
+	if (!f.IsComplete()) {
+		Error error;
+		if (f.range_ignored)
+			error.Set(curl_domain,
+				  "Server does not support range requests");
+		else if (result != CURLE_OK)
+			error.Format(curl_domain, result,
+				     "curl failed: %s", f.GetErrorMessage());
+		else
+			error.Set(curl_domain, "Range request was truncated");
+		RangeError(std::move(error));
+		return;
+	}
+
+	if (AreFetchersComplete())
+		FormatDebug(curl_domain, "All ranges of %s fetched",
+			    GetURI());
+
+	FillFromSpill();
+	cond.broadcast();
+}
+
+bool
+CurlInputStream::SpillReceived(const void *ptr, size_t received_size)
+{
+	assert(spill_fd >= 0);
+	assert(!spill_stalled);
+
+	ssize_t nbytes = pwrite(spill_fd, ptr, received_size, spill_end);
+	if (nbytes != (ssize_t)received_size) {
+		if (nbytes >= 0)
+			errno = ENOSPC;
+		FormatErrno(curl_domain, "Failed to write spill file");
+
+		if (spill_fill == spill_end)
+			/* nothing lost: continue without it */
+			CloseSpill();
+		else
+			spill_stalled = true;
+
+		return false;
+	}
+
+	if (spill_fill == spill_end) {
+		/* the memory buffer is up to date: copy from the
+		   received data directly instead of reading it back
+		   from the file */
+		size_t n = std::min(GetBufferSpace(), received_size);
+		if (n > 0) {
+			AppendToBuffer(ptr, n);
+			spill_fill += n;
+		}
+	}
+
+	spill_end += received_size;
+	UpdateSpillEnd();
+	FillFromSpill();
+	return true;
+}
+
+void
+CurlInputStream::FillFromSpill()
+{
+	assert(spill_fd >= 0);
+
+	while (spill_fill < spill_end) {
+		auto w = PrepareWriteBuffer();
+		if (w.IsEmpty()) {
+			/* let AsyncInputStream::Read() call DoResume()
+			   when the buffer has drained */
+			AsyncInputStream::Pause();
+			return;
+		}
+
+		size_t n = w.size;
+		if (offset_type(n) > spill_end - spill_fill)
+			n = spill_end - spill_fill;
+
+		ssize_t nbytes = pread(spill_fd, w.data, n, spill_fill);
+		if (nbytes <= 0) {
+			Error error;
+			if (nbytes < 0)
+				error.SetErrno("Failed to read spill file");
+			else
+				error.Set(curl_domain,
+					  "Spill file is truncated");
+			PostponeError(std::move(error));
+			return;
+		}
+
+		spill_fill += nbytes;
+		CommitWriteBuffer(nbytes);
+	}
+
+	if (easy == nullptr && AreFetchersComplete())
+		/* the transfer has finished and this was the last
+		   chunk */
+		AsyncInputStream::SetClosed();
+}
+
+void
+CurlInputStream::CloseSpill()
+{
+	if (spill_fd < 0)
+		return;
+
+	close(spill_fd);
+	spill_fd = -1;
+	spill_stalled = false;
+}
+
+#endif
+
 /** called by curl when new data is available */
 static size_t
 input_curl_writefunction(void *ptr, size_t size, size_t nmemb, void *stream)
@@ -734,24 +1482,25 @@ input_curl_writefunction(void *ptr, size_t size, size_t nmemb, void *stream)
 	return c.DataReceived(ptr, size);
 }
 
-bool
-CurlInputStream::InitEasy(Error &error)
+/**
+ * Create a "libcurl easy" handle with the options common to all
+ * requests.
+ *
+ * @param handler receives the completion of the request
+ */
+static CURL *
+input_curl_easy_new(const char *url, CurlRequestHandler &handler,
+		    char *error_buffer, Error &error)
 {
-	easy = curl_easy_init();
+	CURL *easy = curl_easy_init();
 	if (easy == nullptr) {
 		error.Set(curl_domain, "curl_easy_init() failed");
-		return false;
+		return nullptr;
 	}
 
-	curl_easy_setopt(easy, CURLOPT_PRIVATE, (void *)this);
+	curl_easy_setopt(easy, CURLOPT_PRIVATE, (void *)&handler);
 	curl_easy_setopt(easy, CURLOPT_USERAGENT,
 			 "Music Player Daemon " VERSION);
-	curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION,
-			 input_curl_headerfunction);
-	curl_easy_setopt(easy, CURLOPT_WRITEHEADER, this);
-	curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION,
-			 input_curl_writefunction);
-	curl_easy_setopt(easy, CURLOPT_WRITEDATA, this);
 	curl_easy_setopt(easy, CURLOPT_HTTP200ALIASES, http_200_aliases);
 	curl_easy_setopt(easy, CURLOPT_FOLLOWLOCATION, 1l);
 	curl_easy_setopt(easy, CURLOPT_NETRC, 1l);
@@ -761,6 +1510,21 @@ CurlInputStream::InitEasy(Error &error)
 	curl_easy_setopt(easy, CURLOPT_NOPROGRESS, 1l);
 	curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1l);
 	curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT, 10l);
+	curl_easy_setopt(easy, CURLOPT_SHARE, curl_multi->GetShare());
+
+#if LIBCURL_VERSION_NUM >= 0x072f00
+	if (http2) {
+		/* HTTP/2 over TLS only, because servers rarely
+		   support cleartext HTTP/2 upgrades */
+		curl_easy_setopt(easy, CURLOPT_HTTP_VERSION,
+				 (long)CURL_HTTP_VERSION_2TLS);
+
+		/* note: no CURLOPT_PIPEWAIT, because a request
+		   waiting for a multiplexable connection stays
+		   pending while another transfer to the same
+		   HTTP/1.1 server is paused (buffer full) */
+	}
+#endif
 
 	if (proxy != nullptr)
 		curl_easy_setopt(easy, CURLOPT_PROXY, proxy);
@@ -779,14 +1543,32 @@ CurlInputStream::InitEasy(Error &error)
 	curl_easy_setopt(easy, CURLOPT_SSL_VERIFYPEER, verify_peer ? 1l : 0l);
 	curl_easy_setopt(easy, CURLOPT_SSL_VERIFYHOST, verify_host ? 2l : 0l);
 
-	CURLcode code = curl_easy_setopt(easy, CURLOPT_URL, GetURI());
+	CURLcode code = curl_easy_setopt(easy, CURLOPT_URL, url);
 	if (code != CURLE_OK) {
 		error.Format(curl_domain, code,
 			     "curl_easy_setopt() failed: %s",
 			     curl_easy_strerror(code));
-		return false;
+		curl_easy_cleanup(easy);
+		return nullptr;
 	}
 
+	return easy;
+}
+
+bool
+CurlInputStream::InitEasy(Error &error)
+{
+	easy = input_curl_easy_new(GetURI(), *this, error_buffer, error);
+	if (easy == nullptr)
+		return false;
+
+	curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION,
+			 input_curl_headerfunction);
+	curl_easy_setopt(easy, CURLOPT_WRITEHEADER, this);
+	curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION,
+			 input_curl_writefunction);
+	curl_easy_setopt(easy, CURLOPT_WRITEDATA, this);
+
 	request_headers = nullptr;
 	request_headers = curl_slist_append(request_headers,
 					       "Icy-Metadata: 1");
@@ -795,11 +1577,151 @@ CurlInputStream::InitEasy(Error &error)
 	return true;
 }
 
+#ifndef WIN32
+
+/** called by curl when new data for a range is available */
+static size_t
+input_curl_range_writefunction(void *ptr, size_t size, size_t nmemb,
+			       void *userp)
+{
+	CurlRangeFetcher &f = *(CurlRangeFetcher *)userp;
+
+	size *= nmemb;
+	if (size == 0)
+		return 0;
+
+	return f.DataReceived(ptr, size);
+}
+
+inline bool
+CurlRangeFetcher::Start(Error &error)
+{
+	assert(easy == nullptr);
+
+	easy = input_curl_easy_new(parent.GetURI(), *this, error_buffer,
+				   error);
+	if (easy == nullptr)
+		return false;
+
+	curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION,
+			 input_curl_range_writefunction);
+	curl_easy_setopt(easy, CURLOPT_WRITEDATA, this);
+
+	/* the point is to use several TCP connections; don't reuse
+	   one, and don't multiplex over HTTP/2 */
+	curl_easy_setopt(easy, CURLOPT_FRESH_CONNECT, 1l);
+	curl_easy_setopt(easy, CURLOPT_HTTP_VERSION,
+			 (long)CURL_HTTP_VERSION_1_1);
+
+	sprintf(range, "%lld-%lld",
+		(long long)(parent.spill_base + start),
+		(long long)(parent.spill_base + end - 1));
+	curl_easy_setopt(easy, CURLOPT_RANGE, range);
+
+	if (parent.HasValidator()) {
+		/* make sure all ranges come from the same version of
+		   the resource; else the server responds with "200
+		   OK", see DataReceived() */
+		const std::string header = std::string("If-Range: ") +
+			parent.GetValidator();
+		request_headers = curl_slist_append(request_headers,
+						    header.c_str());
+		curl_easy_setopt(easy, CURLOPT_HTTPHEADER, request_headers);
+	}
+
+	return curl_multi->Add(easy, error);
+}
+
+void
+CurlRangeFetcher::FreeEasy()
+{
+	assert(io_thread_inside(IOThreadRole::INPUT));
+
+	if (easy == nullptr)
+		return;
+
+	curl_multi->Remove(easy);
+
+	curl_easy_cleanup(easy);
+	easy = nullptr;
+
+	curl_slist_free_all(request_headers);
+	request_headers = nullptr;
+}
+
+void
+CurlRangeFetcher::RunDeferred()
+{
+	Error error;
+	if (!Start(error)) {
+		FreeEasy();
+
+		const ScopeLock protect(parent.mutex);
+		parent.RangeError(std::move(error));
+	}
+}
+
+size_t
+CurlRangeFetcher::DataReceived(const void *ptr, size_t size)
+{
+	if (written == 0) {
+		long status = 0;
+		curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+		if (status != 206) {
+			/* the server has ignored the "Range" header
+			   (or the resource has been modified) */
+			range_ignored = true;
+			return 0;
+		}
+	}
+
+	return parent.RangeReceived(*this, ptr, size);
+}
+
+void
+CurlRangeFetcher::RequestDone(CURLcode result, gcc_unused long status)
+{
+	assert(io_thread_inside(IOThreadRole::INPUT));
+
+	FreeEasy();
+
+	parent.RangeDone(*this, result);
+}
+
+#endif
+
 void
 CurlInputStream::DoSeek(offset_type new_offset)
 {
 	assert(IsReady());
 
+#ifndef WIN32
+	if (spill_fd >= 0 && !spill_stalled &&
+	    new_offset >= spill_base &&
+	    new_offset - spill_base <= spill_end) {
+		/* the new position has already been downloaded: serve
+		   it from the spill file, and let the transfer
+		   continue */
+		offset = new_offset;
+		spill_fill = new_offset - spill_base;
+		SeekDone();
+		FillFromSpill();
+		return;
+	}
+
+	if (spill_fd >= 0) {
+		/* start over with a new spill file for the new
+		   request; if we were stalled, then the transfer
+		   has been paused, and the new request starts in
+		   memory */
+		if (spill_stalled || ftruncate(spill_fd, 0) < 0)
+			CloseSpill();
+
+		spill_base = new_offset;
+		spill_end = spill_fill = 0;
+	}
+#endif
+
 	/* close the old connection and open a new one */
 
 	mutex.unlock();
@@ -844,7 +1766,7 @@ inline InputStream *
 CurlInputStream::Open(const char *url, Mutex &mutex, Cond &cond,
 		      Error &error)
 {
-	void *buffer = HugeAllocate(CURL_MAX_BUFFERED);
+	void *buffer = HugeAllocate(curl_buffer_size);
 	if (buffer == nullptr) {
 		error.Set(curl_domain, "Out of memory");
 		return nullptr;
@@ -21,31 +21,106 @@
 #include "FileInputPlugin.hxx"
 #include "../InputStream.hxx"
 #include "../InputPlugin.hxx"
+#include "config/Block.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
+#include "util/ConstBuffer.hxx"
 #include "fs/Path.hxx"
 #include "fs/FileInfo.hxx"
 #include "fs/io/FileReader.hxx"
 #include "system/FileDescriptor.hxx"
 
+#include <algorithm>
+
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 static constexpr Domain file_domain("file");
 
+/**
+ * Map regular files into memory instead of reading them?  See the
+ * "mmap" setting.
+ */
+static bool file_mmap;
+
+/**
+ * Ask the kernel to keep this many bytes ahead of the current offset
+ * in the page cache; 0 disables this.  See the "read_ahead" setting.
+ */
+static size_t file_read_ahead = 1024 * 1024;
+
+/**
+ * Evict the data which has been consumed from the page cache?  See
+ * the "drop_behind" setting.
+ */
+static bool file_drop_behind;
+
+/**
+ * Evict consumed data in portions of this size, to avoid one system
+ * call per Read().
+ */
+static constexpr size_t FILE_DROP_BEHIND_CHUNK = 1024 * 1024;
+
+#ifndef WIN32
+
+/**
+ * Do not map files larger than this; on 32 bit machines, that would
+ * exhaust the address space.
+ */
+static constexpr uint64_t FILE_MMAP_MAX = sizeof(size_t) > 4
+	? uint64_t(1) << 40
+	: 256 * 1024 * 1024;
+
+#endif
+
 class FileInputStream final : public InputStream {
 	FileReader reader;
 
+	/**
+	 * The whole file mapped into memory, or nullptr if it is
+	 * being read with read().
+	 */
+	const uint8_t *const map;
+
+	/**
+	 * The end of the region for which read-ahead has been
+	 * requested already.
+	 */
+	offset_type read_ahead_end;
+
+	/**
+	 * The beginning of the consumed region which has not yet been
+	 * evicted from the page cache.  Only used if #file_drop_behind
+	 * is enabled.
+	 */
+	offset_type drop_behind_begin;
+
 public:
 	FileInputStream(const char *path, FileReader &&_reader, off_t _size,
+			const void *_map,
 			Mutex &_mutex, Cond &_cond)
 		:InputStream(path, _mutex, _cond),
-		 reader(std::move(_reader)) {
+		 reader(std::move(_reader)),
+		 map((const uint8_t *)_map),
+		 read_ahead_end(0), drop_behind_begin(0) {
 		size = _size;
 		seekable = true;
 		SetReady();
 	}
 
+#ifndef WIN32
+	~FileInputStream() {
+		if (map != nullptr)
+			munmap(const_cast<uint8_t *>(map), size);
+	}
+#endif
+
 	/* virtual methods from InputStream */
 
 	bool IsEOF() override {
@@ -53,9 +128,53 @@ public:
 	}
 
 	size_t Read(void *ptr, size_t size, Error &error) override;
+	ConstBuffer<void> ReadDirect(size_t size) override;
 	bool Seek(offset_type offset, Error &error) override;
+
+private:
+	/**
+	 * Ask the kernel to read the pages ahead of the current
+	 * offset.
+	 */
+	void ReadAhead();
+
+	/**
+	 * Evict the pages before the current offset from the page
+	 * cache.
+	 */
+	void DropBehind();
+
+	/**
+	 * Called after the offset has been advanced by reading.
+	 */
+	void Advanced() {
+		ReadAhead();
+		DropBehind();
+	}
 };
 
+#ifndef WIN32
+
+static const void *
+MapFile(const FileReader &reader, uint64_t size)
+{
+	if (size == 0 || size > FILE_MMAP_MAX)
+		return nullptr;
+
+	void *p = mmap(nullptr, size, PROT_READ, MAP_SHARED,
+		       reader.GetFD().Get(), 0);
+	if (p == MAP_FAILED)
+		return nullptr;
+
+#ifdef MADV_SEQUENTIAL
+	madvise(p, size, MADV_SEQUENTIAL);
+#endif
+
+	return p;
+}
+
+#endif
+
 InputStream *
 OpenFileInputStream(Path path,
 		    Mutex &mutex, Cond &cond,
@@ -71,19 +190,38 @@ try {
 		return nullptr;
 	}
 
+	const void *map = nullptr;
+#ifndef WIN32
+	if (file_mmap)
+		map = MapFile(reader, info.GetSize());
+#endif
+
 #ifdef POSIX_FADV_SEQUENTIAL
-	posix_fadvise(reader.GetFD().Get(), (off_t)0, info.GetSize(),
-		      POSIX_FADV_SEQUENTIAL);
+	if (map == nullptr)
+		posix_fadvise(reader.GetFD().Get(), (off_t)0, info.GetSize(),
+			      POSIX_FADV_SEQUENTIAL);
 #endif
 
 	return new FileInputStream(path.ToUTF8().c_str(),
 				   std::move(reader), info.GetSize(),
+				   map,
 				   mutex, cond);
 } catch (const std::exception &e) {
 	error.Set(std::current_exception());
 	return nullptr;
 }
 
+static InputPlugin::InitResult
+input_file_init(const ConfigBlock &block, gcc_unused Error &error)
+{
+	file_mmap = block.GetBlockValue("mmap", false);
+	file_read_ahead = block.GetBlockValue("read_ahead",
+					      unsigned(file_read_ahead / 1024))
+		* size_t(1024);
+	file_drop_behind = block.GetBlockValue("drop_behind", false);
+	return InputPlugin::InitResult::SUCCESS;
+}
+
 static InputStream *
 input_file_open(gcc_unused const char *filename,
 		gcc_unused Mutex &mutex, gcc_unused Cond &cond,
@@ -94,11 +232,80 @@ input_file_open(gcc_unused const char *filename,
 	return nullptr;
 }
 
+inline void
+FileInputStream::ReadAhead()
+{
+#ifndef WIN32
+	if (file_read_ahead == 0 ||
+	    offset + file_read_ahead / 2 < read_ahead_end ||
+	    read_ahead_end >= size)
+		return;
+
+	static const long page_size = sysconf(_SC_PAGESIZE);
+
+	offset_type begin = std::max(offset, read_ahead_end);
+	if (page_size > 0)
+		begin -= begin % page_size;
+
+	const offset_type end = std::min<offset_type>(offset + file_read_ahead,
+						      size);
+	if (begin < end) {
+		if (map != nullptr) {
+#ifdef MADV_WILLNEED
+			madvise(const_cast<uint8_t *>(map + begin),
+				end - begin, MADV_WILLNEED);
+#endif
+		} else {
+#ifdef POSIX_FADV_WILLNEED
+			posix_fadvise(reader.GetFD().Get(), begin,
+				      end - begin, POSIX_FADV_WILLNEED);
+#endif
+		}
+	}
+
+	read_ahead_end = end;
+#endif
+}
+
+inline void
+FileInputStream::DropBehind()
+{
+#ifdef POSIX_FADV_DONTNEED
+	if (!file_drop_behind ||
+	    offset < drop_behind_begin + FILE_DROP_BEHIND_CHUNK)
+		return;
+
+	/* this works for mapped files, too: pages which are not
+	   dirty are dropped even if they are still mapped */
+	posix_fadvise(reader.GetFD().Get(), drop_behind_begin,
+		      offset - drop_behind_begin, POSIX_FADV_DONTNEED);
+	drop_behind_begin = offset;
+#endif
+}
+
+ConstBuffer<void>
+FileInputStream::ReadDirect(size_t max_size)
+{
+	if (map == nullptr || offset >= size)
+		return nullptr;
+
+	const size_t nbytes = std::min<offset_type>(max_size, size - offset);
+	const ConstBuffer<void> result(map + offset, nbytes);
+	offset += nbytes;
+
+	Advanced();
+	return result;
+}
+
 bool
 FileInputStream::Seek(offset_type new_offset, Error &error)
 try {
-	reader.Seek((off_t)new_offset);
+	if (map == nullptr)
+		reader.Seek((off_t)new_offset);
+
 	offset = new_offset;
+	read_ahead_end = new_offset;
+	drop_behind_begin = new_offset;
 	return true;
 } catch (const std::exception &e) {
 	error.Set(std::current_exception());
@@ -108,8 +315,17 @@ try {
 size_t
 FileInputStream::Read(void *ptr, size_t read_size, Error &error)
 try {
+	if (map != nullptr) {
+		const auto r = ReadDirect(read_size);
+		if (!r.IsEmpty())
+			memcpy(ptr, r.data, r.size);
+		return r.size;
+	}
+
 	size_t nbytes = reader.Read(ptr, read_size);
 	offset += nbytes;
+
+	Advanced();
 	return nbytes;
 } catch (const std::exception &e) {
 	error.Set(std::current_exception());
@@ -118,7 +334,7 @@ try {
 
 const InputPlugin input_plugin_file = {
 	"file",
-	nullptr,
+	input_file_init,
 	nullptr,
 	input_file_open,
 };
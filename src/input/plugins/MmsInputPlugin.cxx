@@ -21,13 +21,24 @@
 #include "MmsInputPlugin.hxx"
 #include "input/ThreadInputStream.hxx"
 #include "input/InputPlugin.hxx"
+#include "config/Block.hxx"
 #include "util/StringCompare.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 
 #include <libmms/mmsx.h>
 
-static constexpr size_t MMS_BUFFER_SIZE = 256 * 1024;
+/**
+ * See the "buffer_size" setting.
+ */
+static size_t mms_buffer_size = 256 * 1024;
+
+/**
+ * Unfortunately, mmsx_read() blocks until the whole buffer has been
+ * filled; to avoid big latencies, limit the size of each chunk we
+ * read to a reasonable size.
+ */
+static constexpr size_t MMS_MAX_READ = 16384;
 
 class MmsInputStream final : public ThreadInputStream {
 	mmsx_t *mms;
@@ -35,7 +46,7 @@ class MmsInputStream final : public ThreadInputStream {
 public:
 	MmsInputStream(const char *_uri, Mutex &_mutex, Cond &_cond)
 		:ThreadInputStream(input_plugin_mms.name, _uri, _mutex, _cond,
-				   MMS_BUFFER_SIZE) {
+				   mms_buffer_size, MMS_MAX_READ) {
 	}
 
 protected:
@@ -50,6 +61,22 @@ protected:
 
 static constexpr Domain mms_domain("mms");
 
+static InputPlugin::InitResult
+input_mms_init(const ConfigBlock &block, Error &error)
+{
+	mms_buffer_size =
+		block.GetBlockValue("buffer_size",
+				    unsigned(mms_buffer_size / 1024))
+		* size_t(1024);
+	if (mms_buffer_size < 2 * MMS_MAX_READ) {
+		error.Format(mms_domain, "buffer_size is too small: %u KB",
+			     unsigned(mms_buffer_size / 1024));
+		return InputPlugin::InitResult::ERROR;
+	}
+
+	return InputPlugin::InitResult::SUCCESS;
+}
+
 bool
 MmsInputStream::Open(Error &error)
 {
@@ -92,13 +119,6 @@ input_mms_open(const char *url,
 size_t
 MmsInputStream::ThreadRead(void *ptr, size_t read_size, Error &error)
 {
-	/* unfortunately, mmsx_read() blocks until the whole buffer
-	   has been filled; to avoid big latencies, limit the size of
-	   each chunk we read to a reasonable size */
-	constexpr size_t MAX_CHUNK = 16384;
-	if (read_size > MAX_CHUNK)
-		read_size = MAX_CHUNK;
-
 	int nbytes = mmsx_read(nullptr, mms, (char *)ptr, read_size);
 	if (nbytes <= 0) {
 		if (nbytes < 0)
@@ -111,7 +131,7 @@ MmsInputStream::ThreadRead(void *ptr, size_t read_size, Error &error)
 
 const InputPlugin input_plugin_mms = {
 	"mms",
-	nullptr,
+	input_mms_init,
 	nullptr,
 	input_mms_open,
 };
@@ -21,6 +21,7 @@
 #include "NfsInputPlugin.hxx"
 #include "../AsyncInputStream.hxx"
 #include "../InputPlugin.hxx"
+#include "config/Block.hxx"
 #include "lib/nfs/Domain.hxx"
 #include "lib/nfs/Glue.hxx"
 #include "lib/nfs/FileReader.hxx"
@@ -42,6 +43,18 @@ static const size_t NFS_MAX_BUFFERED = 512 * 1024;
  */
 static const size_t NFS_RESUME_AT = 384 * 1024;
 
+/**
+ * The size of each nfs_pread_async() call.  Configurable with
+ * "read_size".
+ */
+static size_t nfs_read_size = 32768;
+
+/**
+ * The maximum number of read requests in flight.  Configurable with
+ * "read_depth".
+ */
+static unsigned nfs_read_depth = 4;
+
 class NfsInputStream final : public AsyncInputStream, NfsFileReader {
 	uint64_t next_offset;
 
@@ -76,7 +89,7 @@ protected:
 
 private:
 	/* virtual methods from NfsFileReader */
-	void OnNfsFileOpen(uint64_t size) override;
+	void OnNfsFileOpen(uint64_t size, time_t mtime) override;
 	void OnNfsFileRead(const void *data, size_t size) override;
 	void OnNfsFileError(Error &&error) override;
 };
@@ -84,29 +97,37 @@ private:
 bool
 NfsInputStream::DoRead()
 {
-	assert(NfsFileReader::IsIdle());
-
-	int64_t remaining = size - next_offset;
-	if (remaining <= 0)
-		return true;
-
-	const size_t buffer_space = GetBufferSpace();
-	if (buffer_space == 0) {
-		Pause();
-		return true;
-	}
+	/* keep up to nfs_read_depth requests in flight; the buffer
+	   must have room for all of them */
+	while (NfsFileReader::GetPendingReads() < nfs_read_depth) {
+		const size_t pending = NfsFileReader::GetPendingReadSize();
+		const uint64_t read_offset = next_offset + pending;
+
+		int64_t remaining = size - read_offset;
+		if (remaining <= 0)
+			break;
+
+		const size_t buffer_space = GetBufferSpace();
+		if (buffer_space <= pending) {
+			if (pending == 0)
+				Pause();
+			break;
+		}
 
-	size_t nbytes = std::min<size_t>(std::min<uint64_t>(remaining, 32768),
-					 buffer_space);
+		size_t nbytes = std::min<size_t>(std::min<uint64_t>(remaining,
+								    nfs_read_size),
+						 buffer_space - pending);
 
-	mutex.unlock();
-	Error error;
-	bool success = NfsFileReader::Read(next_offset, nbytes, error);
-	mutex.lock();
+		mutex.unlock();
+		Error error;
+		bool success = NfsFileReader::Read(read_offset, nbytes, error);
+		mutex.lock();
 
-	if (!success) {
-		PostponeError(std::move(error));
-		return false;
+		if (!success) {
+			NfsFileReader::CancelRead();
+			PostponeError(std::move(error));
+			return false;
+		}
 	}
 
 	return true;
@@ -137,8 +158,6 @@ NfsInputStream::DoResume()
 		return;
 	}
 
-	assert(NfsFileReader::IsIdle());
-
 	DoRead();
 }
 
@@ -155,7 +174,7 @@ NfsInputStream::DoSeek(offset_type new_offset)
 }
 
 void
-NfsInputStream::OnNfsFileOpen(uint64_t _size)
+NfsInputStream::OnNfsFileOpen(uint64_t _size, time_t mtime)
 {
 	const ScopeLock protect(mutex);
 
@@ -169,6 +188,7 @@ NfsInputStream::OnNfsFileOpen(uint64_t _size)
 
 	size = _size;
 	seekable = true;
+	SetValidator(std::to_string((long long)mtime));
 	next_offset = 0;
 	SetReady();
 	DoRead();
@@ -219,8 +239,20 @@ NfsInputStream::OnNfsFileError(Error &&error)
  */
 
 static InputPlugin::InitResult
-input_nfs_init(const ConfigBlock &, Error &)
+input_nfs_init(const ConfigBlock &block, Error &error)
 {
+	nfs_read_size = block.GetBlockValue("read_size", 32768u);
+	if (nfs_read_size < 4096 || nfs_read_size > NFS_MAX_BUFFERED / 2) {
+		error.Set(nfs_domain, "Invalid read_size");
+		return InputPlugin::InitResult::ERROR;
+	}
+
+	nfs_read_depth = block.GetBlockValue("read_depth", 4u);
+	if (nfs_read_depth < 1) {
+		error.Set(nfs_domain, "Invalid read_depth");
+		return InputPlugin::InitResult::ERROR;
+	}
+
 	nfs_init();
 	return InputPlugin::InitResult::SUCCESS;
 }
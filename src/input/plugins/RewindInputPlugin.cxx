@@ -20,36 +20,46 @@
 #include "config.h"
 #include "RewindInputPlugin.hxx"
 #include "../ProxyInputStream.hxx"
+#include "../Domain.hxx"
+#include "util/Error.hxx"
+
+#include <algorithm>
+#include <memory>
 
 #include <assert.h>
+#include <stdint.h>
 #include <string.h>
 
-class RewindInputStream final : public ProxyInputStream {
-	/**
-	 * The read position within the buffer.  Undefined as long as
-	 * ReadingFromBuffer() returns false.
-	 */
-	size_t head;
+/**
+ * The size of the history buffer.  See input_rewind_init().
+ */
+static size_t input_rewind_size = 1024 * 1024;
 
+class RewindInputStream final : public ProxyInputStream {
 	/**
-	 * The write/append position within the buffer.
+	 * The most recent bytes read from the underlying stream.  Its
+	 * size is the maximum number of bytes which can be rewinded
+	 * cheaply without passing the "seek" call to the underlying
+	 * stream.
+	 *
+	 * This is a ring buffer: the byte at stream offset "x" is
+	 * stored at index "x % capacity".
 	 */
-	size_t tail;
+	const size_t capacity;
+	const std::unique_ptr<uint8_t[]> buffer;
 
 	/**
-	 * The size of this buffer is the maximum number of bytes
-	 * which can be rewinded cheaply without passing the "seek"
-	 * call to CURL.
-	 *
-	 * The origin of this buffer is always the beginning of the
-	 * stream (offset 0).
+	 * The number of valid bytes in the buffer; they end at the
+	 * offset of the underlying stream.
 	 */
-	char buffer[64 * 1024];
+	size_t fill;
 
 public:
 	RewindInputStream(InputStream *_input)
 		:ProxyInputStream(_input),
-		 tail(0) {
+		 capacity(input_rewind_size),
+		 buffer(new uint8_t[capacity]),
+		 fill(0) {
 	}
 
 	/* virtual methods from InputStream */
@@ -72,43 +82,75 @@ private:
 	 * buffer contain more data for the next read operation?
 	 */
 	bool ReadingFromBuffer() const {
-		return tail > 0 && offset < input.GetOffset();
+		return offset < input.GetOffset();
 	}
+
+	/**
+	 * Is the given offset within the buffered range?
+	 */
+	bool IsBuffered(offset_type position) const {
+		const offset_type end = input.GetOffset();
+		return position <= end && position + fill >= end;
+	}
+
+	/**
+	 * Copy data which was just read from the underlying stream
+	 * at the given offset to the buffer.
+	 */
+	void Append(offset_type position, const uint8_t *data, size_t length);
 };
 
+void
+RewindInputStream::Append(offset_type position,
+			  const uint8_t *data, size_t length)
+{
+	fill = std::min(fill + length, capacity);
+
+	if (length > capacity) {
+		/* only the end fits */
+		position += length - capacity;
+		data += length - capacity;
+		length = capacity;
+	}
+
+	while (length > 0) {
+		const size_t i = position % capacity;
+		const size_t nbytes = std::min(length, capacity - i);
+		memcpy(buffer.get() + i, data, nbytes);
+		position += nbytes;
+		data += nbytes;
+		length -= nbytes;
+	}
+}
+
 size_t
 RewindInputStream::Read(void *ptr, size_t read_size, Error &error)
 {
 	if (ReadingFromBuffer()) {
 		/* buffered read */
 
-		assert(head == (size_t)offset);
-		assert(tail == (size_t)input.GetOffset());
+		assert(IsBuffered(offset));
 
-		if (read_size > tail - head)
-			read_size = tail - head;
+		const size_t i = offset % capacity;
+		read_size = std::min<offset_type>(read_size,
+						  input.GetOffset() - offset);
+		read_size = std::min(read_size, capacity - i);
 
-		memcpy(ptr, buffer + head, read_size);
-		head += read_size;
+		memcpy(ptr, buffer.get() + i, read_size);
 		offset += read_size;
 
 		return read_size;
 	} else {
 		/* pass method call to underlying stream */
 
+		const offset_type position = input.GetOffset();
 		size_t nbytes = input.Read(ptr, read_size, error);
 
-		if (input.GetOffset() > (offset_type)sizeof(buffer))
-			/* disable buffering */
-			tail = 0;
-		else if (tail == (size_t)offset) {
-			/* append to buffer */
-
-			memcpy(buffer + tail, ptr, nbytes);
-			tail += nbytes;
-
-			assert(tail == (size_t)input.GetOffset());
-		}
+		if (input.GetOffset() == position + nbytes)
+			Append(position, (const uint8_t *)ptr, nbytes);
+		else
+			/* should not happen; be safe */
+			fill = 0;
 
 		CopyAttributes();
 
@@ -122,24 +164,49 @@ RewindInputStream::Seek(offset_type new_offset,
 {
 	assert(IsReady());
 
-	if (tail > 0 && new_offset <= (offset_type)tail) {
+	if (IsBuffered(new_offset)) {
 		/* buffered seek */
 
-		assert(!ReadingFromBuffer() ||
-		       head == (size_t)offset);
-		assert(tail == (size_t)input.GetOffset());
-
-		head = (size_t)new_offset;
 		offset = new_offset;
-
 		return true;
-	} else {
-		/* disable the buffer, because input has left the
-		   buffered range now */
-		tail = 0;
+	}
 
-		return ProxyInputStream::Seek(new_offset, error);
+	if (new_offset > input.GetOffset() && !input.IsSeekable()) {
+		/* skip forward by reading (and buffering) the data in
+		   between */
+
+		offset = input.GetOffset();
+
+		uint8_t discard[16384];
+		while (offset < new_offset) {
+			size_t nbytes = Read(discard,
+					     std::min<offset_type>(sizeof(discard),
+								   new_offset - offset),
+					     error);
+			if (nbytes == 0) {
+				if (!error.IsDefined())
+					error.Set(input_domain,
+						  "Seek beyond end of stream");
+				return false;
+			}
+		}
+
+		return true;
 	}
+
+	/* discard the buffer, because input leaves the buffered
+	   range now */
+	fill = 0;
+
+	return ProxyInputStream::Seek(new_offset, error);
+}
+
+void
+input_rewind_init(size_t size)
+{
+	assert(size > 0);
+
+	input_rewind_size = size;
 }
 
 InputStream *
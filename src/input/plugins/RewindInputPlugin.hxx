@@ -29,8 +29,17 @@
 
 #include "check.h"
 
+#include <stddef.h>
+
 class InputStream;
 
+/**
+ * Set the size of the history buffer which allows rewinding and
+ * seeking backwards.
+ */
+void
+input_rewind_init(size_t size);
+
 InputStream *
 input_rewind_open(InputStream *is);
 
@@ -21,43 +21,65 @@
 #include "SmbclientInputPlugin.hxx"
 #include "lib/smbclient/Init.hxx"
 #include "lib/smbclient/Mutex.hxx"
-#include "../InputStream.hxx"
+#include "lib/smbclient/Domain.hxx"
+#include "../ThreadInputStream.hxx"
 #include "../InputPlugin.hxx"
+#include "config/Block.hxx"
 #include "util/StringCompare.hxx"
 #include "util/Error.hxx"
 
 #include <libsmbclient.h>
 
-class SmbclientInputStream final : public InputStream {
+/**
+ * The size of the buffer filled by the I/O thread.  See the
+ * "buffer_size" setting.
+ */
+static size_t smbclient_buffer_size = 1024 * 1024;
+
+/**
+ * The maximum size of one smbc_read() call.  libsmbclient splits
+ * large reads into several SMB requests which are in flight at the
+ * same time.  See the "read_size" setting.
+ */
+static size_t smbclient_read_size = 128 * 1024;
+
+/**
+ * See ThreadInputStream::low_watermark and the "low_watermark"
+ * setting.
+ */
+static size_t smbclient_low_watermark;
+
+class SmbclientInputStream final : public ThreadInputStream {
 	SMBCCTX *ctx;
 	int fd;
 
 public:
 	SmbclientInputStream(const char *_uri,
-			     Mutex &_mutex, Cond &_cond,
-			     SMBCCTX *_ctx, int _fd, const struct stat &st)
-		:InputStream(_uri, _mutex, _cond),
-		 ctx(_ctx), fd(_fd) {
-		seekable = true;
-		size = st.st_size;
-		SetReady();
-	}
-
-	~SmbclientInputStream() {
-		smbclient_mutex.lock();
+			     Mutex &_mutex, Cond &_cond)
+		:ThreadInputStream(input_plugin_smbclient.name,
+				   _uri, _mutex, _cond,
+				   smbclient_buffer_size,
+				   smbclient_read_size,
+				   smbclient_low_watermark) {}
+
+protected:
+	/* virtual methods from ThreadInputStream */
+	bool Open(Error &error) override;
+	size_t ThreadRead(void *ptr, size_t size, Error &error) override;
+	bool ThreadSeek(offset_type offset, Error &error) override;
+
+	void Close() override {
+		const ScopeLock protect(smbclient_mutex);
 		smbc_close(fd);
 		smbc_free_context(ctx, 1);
-		smbclient_mutex.unlock();
-	}
-
-	/* virtual methods from InputStream */
-
-	bool IsEOF() override {
-		return offset >= size;
 	}
 
-	size_t Read(void *ptr, size_t size, Error &error) override;
-	bool Seek(offset_type offset, Error &error) override;
+private:
+	/**
+	 * Open the file and obtain its attributes.  On error, all
+	 * resources have been freed.
+	 */
+	bool OpenFile(struct stat &st, Error &error);
 };
 
 /*
@@ -66,7 +88,7 @@ public:
  */
 
 static InputPlugin::InitResult
-input_smbclient_init(gcc_unused const ConfigBlock &block, Error &error)
+input_smbclient_init(const ConfigBlock &block, Error &error)
 {
 	if (!SmbclientInit(error))
 		return InputPlugin::InitResult::UNAVAILABLE;
@@ -75,54 +97,106 @@ input_smbclient_init(gcc_unused const ConfigBlock &block, Error &error)
 
 	// TODO: evaluate ConfigBlock, call smbc_setOption*()
 
+	smbclient_buffer_size =
+		block.GetBlockValue("buffer_size",
+				    unsigned(smbclient_buffer_size / 1024))
+		* size_t(1024);
+	if (smbclient_buffer_size < 64 * 1024) {
+		error.Format(smbclient_domain,
+			     "buffer_size is too small: %u KB",
+			     unsigned(smbclient_buffer_size / 1024));
+		return InputPlugin::InitResult::ERROR;
+	}
+
+	smbclient_read_size =
+		block.GetBlockValue("read_size",
+				    unsigned(smbclient_read_size / 1024))
+		* size_t(1024);
+	if (smbclient_read_size == 0 ||
+	    smbclient_read_size > smbclient_buffer_size)
+		smbclient_read_size = smbclient_buffer_size;
+
+	smbclient_low_watermark =
+		block.GetBlockValue("low_watermark",
+				    unsigned((smbclient_buffer_size -
+					      smbclient_read_size) / 1024))
+		* size_t(1024);
+
 	return InputPlugin::InitResult::SUCCESS;
 }
 
-static InputStream *
-input_smbclient_open(const char *uri,
-		     Mutex &mutex, Cond &cond,
-		     Error &error)
+inline bool
+SmbclientInputStream::OpenFile(struct stat &st, Error &error)
 {
-	if (!StringStartsWith(uri, "smb://"))
-		return nullptr;
-
 	const ScopeLock protect(smbclient_mutex);
 
-	SMBCCTX *ctx = smbc_new_context();
+	ctx = smbc_new_context();
 	if (ctx == nullptr) {
 		error.SetErrno("smbc_new_context() failed");
-		return nullptr;
+		return false;
 	}
 
 	SMBCCTX *ctx2 = smbc_init_context(ctx);
 	if (ctx2 == nullptr) {
 		error.SetErrno("smbc_init_context() failed");
 		smbc_free_context(ctx, 1);
-		return nullptr;
+		return false;
 	}
 
 	ctx = ctx2;
 
-	int fd = smbc_open(uri, O_RDONLY, 0);
+	fd = smbc_open(GetURI(), O_RDONLY, 0);
 	if (fd < 0) {
 		error.SetErrno("smbc_open() failed");
 		smbc_free_context(ctx, 1);
-		return nullptr;
+		return false;
 	}
 
-	struct stat st;
 	if (smbc_fstat(fd, &st) < 0) {
 		error.SetErrno("smbc_fstat() failed");
 		smbc_close(fd);
 		smbc_free_context(ctx, 1);
-		return nullptr;
+		return false;
+	}
+
+	return true;
+}
+
+bool
+SmbclientInputStream::Open(Error &error)
+{
+	struct stat st;
+
+	{
+		const ScopeUnlock unlock(mutex);
+		if (!OpenFile(st, error))
+			return false;
 	}
 
-	return new SmbclientInputStream(uri, mutex, cond, ctx, fd, st);
+	seekable = true;
+	size = st.st_size;
+	SetValidator(std::to_string((long long)st.st_mtime));
+	return true;
+}
+
+static InputStream *
+input_smbclient_open(const char *uri,
+		     Mutex &mutex, Cond &cond,
+		     Error &error)
+{
+	if (!StringStartsWith(uri, "smb://"))
+		return nullptr;
+
+	auto s = new SmbclientInputStream(uri, mutex, cond);
+	auto is = s->Start(error);
+	if (is == nullptr)
+		delete s;
+
+	return is;
 }
 
 size_t
-SmbclientInputStream::Read(void *ptr, size_t read_size, Error &error)
+SmbclientInputStream::ThreadRead(void *ptr, size_t read_size, Error &error)
 {
 	smbclient_mutex.lock();
 	ssize_t nbytes = smbc_read(fd, ptr, read_size);
@@ -132,12 +206,11 @@ SmbclientInputStream::Read(void *ptr, size_t read_size, Error &error)
 		nbytes = 0;
 	}
 
-	offset += nbytes;
 	return nbytes;
 }
 
 bool
-SmbclientInputStream::Seek(offset_type new_offset, Error &error)
+SmbclientInputStream::ThreadSeek(offset_type new_offset, Error &error)
 {
 	smbclient_mutex.lock();
 	off_t result = smbc_lseek(fd, new_offset, SEEK_SET);
@@ -147,7 +220,6 @@ SmbclientInputStream::Seek(offset_type new_offset, Error &error)
 		return false;
 	}
 
-	offset = result;
 	return true;
 }
 
@@ -23,14 +23,26 @@
 #include "config.h"
 #include "Init.hxx"
 #include "LogCallback.hxx"
+#include "thread/Mutex.hxx"
 
 extern "C" {
 #include <libavformat/avformat.h>
 }
 
+static Mutex ffmpeg_init_mutex;
+static bool ffmpeg_initialized;
+
 void
 FfmpegInit()
 {
+	/* called by both the decoder and the input plugin, possibly
+	   from different startup threads */
+	const ScopeLock protect(ffmpeg_init_mutex);
+	if (ffmpeg_initialized)
+		return;
+
+	ffmpeg_initialized = true;
+
 	av_log_set_callback(FfmpegLogCallback);
 
 	av_register_all();
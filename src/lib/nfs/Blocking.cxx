@@ -24,14 +24,18 @@
 #include "event/Call.hxx"
 #include "util/Error.hxx"
 
-bool
-BlockingNfsOperation::Run(Error &_error)
+void
+BlockingNfsOperation::Begin()
 {
 	/* subscribe to the connection, which will invoke either
 	   OnNfsConnectionReady() or OnNfsConnectionFailed() */
 	BlockingCall(connection.GetEventLoop(),
 		    [this](){ connection.AddLease(*this); });
+}
 
+bool
+BlockingNfsOperation::Wait(Error &_error)
+{
 	/* wait for completion */
 	if (!LockWaitFinished()) {
 		_error.Set(nfs_domain, 0, "Timeout");
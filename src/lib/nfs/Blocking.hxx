@@ -51,7 +51,22 @@ public:
 	BlockingNfsOperation(NfsConnection &_connection)
 		:finished(false), connection(_connection) {}
 
-	bool Run(Error &error);
+	/**
+	 * Submit the operation and return immediately.  Wait() must
+	 * be called before this object is destroyed.
+	 */
+	void Begin();
+
+	/**
+	 * Wait for completion of an operation submitted with
+	 * Begin().
+	 */
+	bool Wait(Error &error);
+
+	bool Run(Error &error) {
+		Begin();
+		return Wait(error);
+	}
 
 private:
 	bool LockWaitFinished() {
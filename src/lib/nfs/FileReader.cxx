@@ -36,13 +36,14 @@
 #include <sys/stat.h>
 
 NfsFileReader::NfsFileReader()
-	:DeferredMonitor(io_thread_get()), state(State::INITIAL)
+	:DeferredMonitor(io_thread_get(IOThreadRole::INPUT)), state(State::INITIAL)
 {
 }
 
 NfsFileReader::~NfsFileReader()
 {
 	assert(state == State::INITIAL);
+	assert(reads.empty());
 }
 
 void
@@ -69,11 +70,28 @@ NfsFileReader::CancelOrClose()
 	assert(state != State::INITIAL &&
 	       state != State::DEFER);
 
-	if (state == State::IDLE)
-		/* no async operation in progress: can close
-		   immediately */
-		connection->Close(fh);
-	else if (state > State::OPEN)
+	if (state == State::IDLE) {
+		/* find one read request still in flight to defer the
+		   nfs_close_async() call to; cancel all others */
+		ReadRequest *last = nullptr;
+		for (auto &r : reads) {
+			if (r.done)
+				continue;
+
+			if (last != nullptr)
+				connection->Cancel(*last);
+			last = &r;
+		}
+
+		if (last != nullptr)
+			connection->CancelAndClose(fh, *last);
+		else
+			/* no async operation in progress: can close
+			   immediately */
+			connection->Close(fh);
+
+		reads.clear();
+	} else if (state > State::OPEN)
 		/* one async operation in progress: cancel it and
 		   defer the nfs_close_async() call */
 		connection->CancelAndClose(fh, *this);
@@ -88,7 +106,7 @@ NfsFileReader::CancelOrClose()
 void
 NfsFileReader::DeferClose()
 {
-	BlockingCall(io_thread_get(), [this](){ Close(); });
+	BlockingCall(io_thread_get(IOThreadRole::INPUT), [this](){ Close(); });
 }
 
 bool
@@ -140,20 +158,32 @@ NfsFileReader::Read(uint64_t offset, size_t size, Error &error)
 {
 	assert(state == State::IDLE);
 
-	if (!connection->Read(fh, offset, size, *this, error))
+	reads.emplace_back(*this, size);
+	if (!connection->Read(fh, offset, size, reads.back(), error)) {
+		reads.pop_back();
 		return false;
+	}
 
-	state = State::READ;
 	return true;
 }
 
 void
 NfsFileReader::CancelRead()
 {
-	if (state == State::READ) {
-		connection->Cancel(*this);
-		state = State::IDLE;
-	}
+	for (auto &r : reads)
+		if (!r.done)
+			connection->Cancel(r);
+
+	reads.clear();
+}
+
+size_t
+NfsFileReader::GetPendingReadSize() const
+{
+	size_t result = 0;
+	for (const auto &r : reads)
+		result += r.size;
+	return result;
 }
 
 void
@@ -227,11 +257,85 @@ NfsFileReader::StatCallback(const struct stat *st)
 
 	state = State::IDLE;
 
-	OnNfsFileOpen(st->st_size);
+	OnNfsFileOpen(st->st_size, st->st_mtime);
+}
+
+void
+NfsFileReader::FlushReads()
+{
+	while (!reads.empty() && reads.front().done) {
+		ReadRequest &r = reads.front();
+		const std::unique_ptr<uint8_t[]> data(std::move(r.data));
+		const size_t size = r.data_size;
+		const bool eof = size < r.size;
+		reads.pop_front();
+
+		if (eof)
+			/* the following requests were based on a
+			   wrong file size */
+			CancelRead();
+
+		OnNfsFileRead(data.get(), size);
+	}
+}
+
+inline void
+NfsFileReader::ReadCallback(ReadRequest &r, const void *data, size_t size)
+{
+	assert(state == State::IDLE);
+	assert(!reads.empty());
+	assert(!r.done);
+
+	if (&r != &reads.front()) {
+		/* arrived out of order: keep a copy until the
+		   preceding requests have finished */
+		r.data.reset(new uint8_t[size]);
+		memcpy(r.data.get(), data, size);
+		r.data_size = size;
+		r.done = true;
+		return;
+	}
+
+	const bool eof = size < r.size;
+	reads.pop_front();
+
+	if (eof)
+		CancelRead();
+
+	OnNfsFileRead(data, size);
+	FlushReads();
+}
+
+inline void
+NfsFileReader::ReadError(ReadRequest &r, Error &&error)
+{
+	assert(state == State::IDLE);
+
+	for (auto i = reads.begin(); i != reads.end(); ++i) {
+		if (&*i == &r) {
+			reads.erase(i);
+			break;
+		}
+	}
+
+	CancelRead();
+	OnNfsFileError(std::move(error));
 }
 
 void
-NfsFileReader::OnNfsCallback(unsigned status, void *data)
+NfsFileReader::ReadRequest::OnNfsCallback(unsigned status, void *_data)
+{
+	reader.ReadCallback(*this, _data, status);
+}
+
+void
+NfsFileReader::ReadRequest::OnNfsError(Error &&error)
+{
+	reader.ReadError(*this, std::move(error));
+}
+
+void
+NfsFileReader::OnNfsCallback(gcc_unused unsigned status, void *data)
 {
 	switch (state) {
 	case State::INITIAL:
@@ -248,11 +352,6 @@ NfsFileReader::OnNfsCallback(unsigned status, void *data)
 	case State::STAT:
 		StatCallback((const struct stat *)data);
 		break;
-
-	case State::READ:
-		state = State::IDLE;
-		OnNfsFileRead(data, status);
-		break;
 	}
 }
 
@@ -277,10 +376,6 @@ NfsFileReader::OnNfsError(Error &&error)
 		connection->Close(fh);
 		state = State::INITIAL;
 		break;
-
-	case State::READ:
-		state = State::IDLE;
-		break;
 	}
 
 	OnNfsFileError(std::move(error));
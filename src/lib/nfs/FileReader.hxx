@@ -27,13 +27,21 @@
 #include "Compiler.h"
 
 #include <string>
+#include <list>
+#include <memory>
 
 #include <stdint.h>
 #include <stddef.h>
+#include <time.h>
 
 struct nfsfh;
 class NfsConnection;
 
+/**
+ * Reads a file from a NFS server.  Several read requests may be in
+ * flight at the same time; their results are passed to
+ * OnNfsFileRead() in the order in which they were submitted.
+ */
 class NfsFileReader : NfsLease, NfsCallback, DeferredMonitor {
 	enum class State {
 		INITIAL,
@@ -41,12 +49,45 @@ class NfsFileReader : NfsLease, NfsCallback, DeferredMonitor {
 		MOUNT,
 		OPEN,
 		STAT,
-		READ,
 		IDLE,
 	};
 
 	State state;
 
+	/**
+	 * One nfs_pread_async() call.  Each one needs its own
+	 * #NfsCallback instance, because #NfsConnection identifies
+	 * pending operations by their callback.
+	 */
+	struct ReadRequest final : NfsCallback {
+		NfsFileReader &reader;
+
+		const size_t size;
+
+		/**
+		 * Has the response arrived already?  This means it
+		 * was received out of order, and it waits in #data
+		 * for the preceding requests to finish.
+		 */
+		bool done = false;
+
+		std::unique_ptr<uint8_t[]> data;
+		size_t data_size;
+
+		ReadRequest(NfsFileReader &_reader, size_t _size)
+			:reader(_reader), size(_size) {}
+
+		/* virtual methods from NfsCallback */
+		void OnNfsCallback(unsigned status, void *data) override;
+		void OnNfsError(Error &&error) override;
+	};
+
+	/**
+	 * The read requests which have not yet been passed to
+	 * OnNfsFileRead(), in the order they were submitted.
+	 */
+	std::list<ReadRequest> reads;
+
 	std::string server, export_name;
 	const char *path;
 
@@ -62,15 +103,44 @@ public:
 	void DeferClose();
 
 	bool Open(const char *uri, Error &error);
+
+	/**
+	 * Submit a read request.  This may be called again before
+	 * the previous request has finished.  If a response is
+	 * shorter than requested (i.e. end of file), all following
+	 * requests are cancelled.
+	 */
 	bool Read(uint64_t offset, size_t size, Error &error);
+
+	/**
+	 * Cancel all pending read requests.
+	 */
 	void CancelRead();
 
+	/**
+	 * Has the file been opened, and is there no pending read
+	 * request?
+	 */
 	bool IsIdle() const {
-		return state == State::IDLE;
+		return state == State::IDLE && reads.empty();
+	}
+
+	/**
+	 * Returns the number of read requests which have not yet
+	 * been passed to OnNfsFileRead().
+	 */
+	unsigned GetPendingReads() const {
+		return reads.size();
 	}
 
+	/**
+	 * Returns the sum of the sizes of all pending read requests.
+	 */
+	gcc_pure
+	size_t GetPendingReadSize() const;
+
 protected:
-	virtual void OnNfsFileOpen(uint64_t size) = 0;
+	virtual void OnNfsFileOpen(uint64_t size, time_t mtime) = 0;
 	virtual void OnNfsFileRead(const void *data, size_t size) = 0;
 	virtual void OnNfsFileError(Error &&error) = 0;
 
@@ -84,6 +154,15 @@ private:
 	void OpenCallback(nfsfh *_fh);
 	void StatCallback(const struct stat *st);
 
+	void ReadCallback(ReadRequest &r, const void *data, size_t size);
+	void ReadError(ReadRequest &r, Error &&error);
+
+	/**
+	 * Pass all finished requests at the head of #reads to
+	 * OnNfsFileRead().
+	 */
+	void FlushReads();
+
 	/* virtual methods from NfsLease */
 	void OnNfsConnectionReady() final;
 	void OnNfsConnectionFailed(const Error &error) final;
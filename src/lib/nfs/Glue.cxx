@@ -35,7 +35,7 @@ nfs_init()
 	if (in_use++ > 0)
 		return;
 
-	nfs_glue.Construct(io_thread_get());
+	nfs_glue.Construct(io_thread_get(IOThreadRole::INPUT));
 }
 
 void
@@ -46,14 +46,14 @@ nfs_finish()
 	if (--in_use > 0)
 		return;
 
-	BlockingCall(io_thread_get(), [](){ nfs_glue.Destruct(); });
+	BlockingCall(io_thread_get(IOThreadRole::INPUT), [](){ nfs_glue.Destruct(); });
 }
 
 NfsConnection &
 nfs_get_connection(const char *server, const char *export_name)
 {
 	assert(in_use > 0);
-	assert(io_thread_inside());
+	assert(io_thread_inside(IOThreadRole::INPUT));
 
 	return nfs_glue->GetConnection(server, export_name);
 }
@@ -25,6 +25,7 @@
 #include "Util.hxx"
 #include "Action.hxx"
 #include "util/UriUtil.hxx"
+#include "util/NumberParser.hxx"
 #include "util/RuntimeError.hxx"
 
 ContentDirectoryService::ContentDirectoryService(const UPnPDevice &device,
@@ -80,3 +81,30 @@ ContentDirectoryService::getSearchCapabilities(UpnpClient_Handle hdl) const
 
 	return result;
 }
+
+unsigned
+ContentDirectoryService::getSystemUpdateID(UpnpClient_Handle hdl) const
+{
+	UniqueIxmlDocument request(UpnpMakeAction("GetSystemUpdateID",
+						  m_serviceType.c_str(),
+						  0,
+						  nullptr, nullptr));
+	if (!request)
+		throw std::runtime_error("UpnpMakeAction() failed");
+
+	IXML_Document *_response;
+	auto code = UpnpSendAction(hdl, m_actionURL.c_str(),
+				   m_serviceType.c_str(),
+				   0 /*devUDN*/, request.get(), &_response);
+	if (code != UPNP_E_SUCCESS)
+		throw FormatRuntimeError("UpnpSendAction() failed: %s",
+					 UpnpGetErrorMessage(code));
+
+	UniqueIxmlDocument response(_response);
+
+	const char *s = ixmlwrap::getFirstElementValue(response.get(), "Id");
+	if (s == nullptr || *s == 0)
+		throw std::runtime_error("Bad response");
+
+	return ParseUnsigned(s);
+}
@@ -73,6 +73,9 @@ public:
 	~ContentDirectoryService();
 
 	/** Read a container's children list into dirbuf.
+	 *
+	 * After the first slice has revealed the size of the
+	 * container, the remaining slices are requested in parallel.
 	 *
 	 * @param objectId the UPnP object Id for the container. Root has Id "0"
 	 */
@@ -113,6 +116,13 @@ public:
 	 */
 	std::list<std::string> getSearchCapabilities(UpnpClient_Handle handle) const;
 
+	/** Retrieve the "SystemUpdateID" of the server, which changes
+	 * whenever anything in the content directory is modified.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	unsigned getSystemUpdateID(UpnpClient_Handle handle) const;
+
 	gcc_pure
 	std::string GetURI() const {
 		return "upnp://" + m_deviceId + "/" + m_serviceType;
@@ -0,0 +1,112 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "OggPageIndex.hxx"
+
+#include <algorithm>
+#include <iterator>
+
+#include <assert.h>
+
+inline std::vector<OggPageIndex::Entry>::const_iterator
+OggPageIndex::LowerBound(ogg_int64_t granulepos) const
+{
+	return std::lower_bound(entries.begin(), entries.end(), granulepos,
+				[](const Entry &a, ogg_int64_t b){
+					return a.granulepos < b;
+				});
+}
+
+inline std::vector<OggPageIndex::Entry>::iterator
+OggPageIndex::LowerBound(ogg_int64_t granulepos)
+{
+	return std::lower_bound(entries.begin(), entries.end(), granulepos,
+				[](const Entry &a, ogg_int64_t b){
+					return a.granulepos < b;
+				});
+}
+
+void
+OggPageIndex::Add(ogg_int64_t granulepos, int64_t offset)
+{
+	assert(granulepos >= 0);
+	assert(offset >= 0);
+
+	const auto i = LowerBound(granulepos);
+
+	const bool linked = i != entries.begin() &&
+		last_granulepos >= 0 &&
+		std::prev(i)->granulepos == last_granulepos;
+
+	last_granulepos = granulepos;
+
+	if (i != entries.end() && i->granulepos == granulepos) {
+		/* already known; but now we may have learned that it
+		   follows its predecessor */
+		if (linked)
+			i->linked = true;
+		return;
+	}
+
+	entries.insert(i, Entry{granulepos, offset, linked});
+}
+
+bool
+OggPageIndex::Find(ogg_int64_t where_granulepos,
+		   ogg_int64_t end_granulepos, int64_t size,
+		   int64_t &offset_r) const
+{
+	const auto i = LowerBound(where_granulepos);
+
+	if (i != entries.end() && i->linked) {
+		/* the page containing the given granule position is
+		   known; seek to its predecessor, because the first
+		   packet may begin there */
+		offset_r = std::prev(i)->offset;
+		return true;
+	}
+
+	/* interpolate between the closest known positions */
+
+	ogg_int64_t low_granulepos = 0, high_granulepos = end_granulepos;
+	int64_t low_offset = 0, high_offset = size;
+
+	if (i != entries.begin()) {
+		low_granulepos = std::prev(i)->granulepos;
+		low_offset = std::prev(i)->offset;
+	}
+
+	if (i != entries.end()) {
+		high_granulepos = i->granulepos;
+		high_offset = i->offset;
+	}
+
+	if (high_granulepos <= low_granulepos ||
+	    high_offset <= low_offset) {
+		offset_r = low_offset;
+		return false;
+	}
+
+	offset_r = low_offset + (where_granulepos - low_granulepos)
+		* (high_offset - low_offset)
+		/ (high_granulepos - low_granulepos);
+	return false;
+}
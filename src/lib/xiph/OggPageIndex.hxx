@@ -0,0 +1,120 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_OGG_PAGE_INDEX_HXX
+#define MPD_OGG_PAGE_INDEX_HXX
+
+#include "check.h"
+#include "Compiler.h"
+
+#include <ogg/ogg.h>
+
+#include <vector>
+
+#include <stdint.h>
+
+/**
+ * A table mapping granule positions to the file offsets of the Ogg
+ * pages which contain them.  It is filled while the stream is being
+ * read, and allows seeking to a position which has already been
+ * seen without guessing.
+ */
+class OggPageIndex {
+	struct Entry {
+		ogg_int64_t granulepos;
+
+		int64_t offset;
+
+		/**
+		 * Was this page read right after the previous entry
+		 * (in granule position order), without seeking in
+		 * between?  Only then is it known that no page lies
+		 * between the two.
+		 */
+		bool linked;
+	};
+
+	/**
+	 * Sorted by granule position.
+	 */
+	std::vector<Entry> entries;
+
+	/**
+	 * The granule position of the page most recently passed to
+	 * Add(), or -1 after Clear() and Interrupt().
+	 */
+	ogg_int64_t last_granulepos = -1;
+
+public:
+	gcc_pure
+	bool empty() const {
+		return entries.empty();
+	}
+
+	void Clear() {
+		entries.clear();
+		last_granulepos = -1;
+	}
+
+	/**
+	 * The next page passed to Add() does not follow the previous
+	 * one, e.g. because the stream has been seeked.
+	 */
+	void Interrupt() {
+		last_granulepos = -1;
+	}
+
+	/**
+	 * Remember the offset of a page.
+	 *
+	 * @param granulepos the granule position of the page; must
+	 * not be negative
+	 * @param offset the file offset of the page
+	 */
+	void Add(ogg_int64_t granulepos, int64_t offset);
+
+	/**
+	 * Determine the file offset to seek to for the given granule
+	 * position.  If the page containing it has been indexed, its
+	 * offset is returned (or rather: the offset of its
+	 * predecessor, which completes the first packet).  Otherwise,
+	 * the offset is interpolated between the closest known
+	 * pages, falling back to the start and the end of the file.
+	 *
+	 * @param end_granulepos the granule position at the end of
+	 * the file
+	 * @param size the size of the file
+	 * @param offset_r the file offset is returned here
+	 * @return true if the offset was found in the index, false
+	 * if it is just a guess
+	 */
+	bool Find(ogg_int64_t where_granulepos,
+		  ogg_int64_t end_granulepos, int64_t size,
+		  int64_t &offset_r) const;
+
+private:
+	gcc_pure
+	std::vector<Entry>::const_iterator LowerBound(ogg_int64_t granulepos) const;
+
+	gcc_pure
+	std::vector<Entry>::iterator LowerBound(ogg_int64_t granulepos);
+};
+
+#endif
@@ -33,16 +33,38 @@ OggSyncState::Feed(size_t size)
 			return false;
 
 		ogg_sync_wrote(&oy, nbytes);
+		if (offset >= 0)
+			offset += nbytes;
 		return true;
 }
 
+inline void
+OggSyncState::UpdatePageOffset(const ogg_page &page)
+{
+	if (offset < 0) {
+		page_offset = -1;
+		return;
+	}
+
+	/* everything up to oy.returned has been consumed, and the
+	   page ends right there */
+	const size_t unconsumed = oy.fill - oy.returned;
+	page_offset = offset - int64_t(unconsumed)
+		- page.header_len - page.body_len;
+}
+
 bool
 OggSyncState::ExpectPage(ogg_page &page)
 {
 	while (true) {
 		int r = ogg_sync_pageout(&oy, &page);
-		if (r != 0)
-			return r > 0;
+		if (r > 0) {
+			UpdatePageOffset(page);
+			return true;
+		}
+
+		if (r < 0)
+			return false;
 
 		if (!Feed(1024))
 			return false;
@@ -67,8 +89,10 @@ OggSyncState::ExpectPageSeek(ogg_page &page)
 
 	while (true) {
 		int r = ogg_sync_pageseek(&oy, &page);
-		if (r > 0)
+		if (r > 0) {
+			UpdatePageOffset(page);
 			return true;
+		}
 
 		if (r < 0) {
 			/* skipped -r bytes */
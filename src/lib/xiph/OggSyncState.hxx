@@ -25,6 +25,7 @@
 #include <ogg/ogg.h>
 
 #include <stddef.h>
+#include <stdint.h>
 
 class Reader;
 
@@ -36,9 +37,24 @@ class OggSyncState {
 
 	Reader &reader;
 
+	/**
+	 * The #Reader offset of the next byte to be fed into the
+	 * #ogg_sync_state, or -1 if unknown.
+	 */
+	int64_t offset = -1;
+
+	/**
+	 * The #Reader offset of the page most recently returned by
+	 * ExpectPage() or ExpectPageSeek(), or -1 if unknown.
+	 */
+	int64_t page_offset = -1;
+
 public:
-	explicit OggSyncState(Reader &_reader)
-		:reader(_reader) {
+	/**
+	 * @param _offset the current #Reader offset, or -1 if unknown
+	 */
+	explicit OggSyncState(Reader &_reader, int64_t _offset=-1)
+		:reader(_reader), offset(_offset) {
 		ogg_sync_init(&oy);
 	}
 
@@ -49,8 +65,24 @@ public:
 	OggSyncState(const OggSyncState &) = delete;
 	OggSyncState &operator=(const OggSyncState &) = delete;
 
-	void Reset() {
+	/**
+	 * Discard all buffered data.
+	 *
+	 * @param _offset the current #Reader offset, or -1 if unknown
+	 */
+	void Reset(int64_t _offset=-1) {
 		ogg_sync_reset(&oy);
+		offset = _offset;
+		page_offset = -1;
+	}
+
+	/**
+	 * Returns the #Reader offset of the page most recently
+	 * returned by ExpectPage() or ExpectPageSeek(), or -1 if
+	 * unknown.
+	 */
+	int64_t GetPageOffset() const {
+		return page_offset;
 	}
 
 	bool Feed(size_t size);
@@ -62,6 +94,9 @@ public:
 	bool ExpectPageSeek(ogg_page &page);
 
 	bool ExpectPageSeekIn(ogg_stream_state &os);
+
+private:
+	void UpdatePageOffset(const ogg_page &page);
 };
 
 #endif
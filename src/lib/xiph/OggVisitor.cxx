@@ -46,6 +46,7 @@ OggVisitor::ReadNextPage()
 	}
 
 	stream.PageIn(page);
+	OnOggPage(page, sync.GetPageOffset());
 	return true;
 }
 
@@ -88,14 +89,20 @@ OggVisitor::Visit()
 }
 
 void
-OggVisitor::PostSeek()
+OggVisitor::PostSeek(int64_t offset)
 {
-	sync.Reset();
+	sync.Reset(offset);
 
 	/* reset the stream to clear any previous partial packet
 	   data */
 	stream.Reset();
 
 	/* find the next Ogg page and feed it into the stream */
-	sync.ExpectPageSeekIn(stream);
+	ogg_page page;
+	if (!sync.ExpectPageSeek(page))
+		return;
+
+	stream.PageIn(page);
+	if (ogg_page_serialno(&page) == stream.GetSerialNo())
+		OnOggPage(page, sync.GetPageOffset());
 }
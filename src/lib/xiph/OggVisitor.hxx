@@ -23,10 +23,12 @@
 #include "check.h"
 #include "OggSyncState.hxx"
 #include "OggStreamState.hxx"
+#include "Compiler.h"
 
 #include <ogg/ogg.h>
 
 #include <stddef.h>
+#include <stdint.h>
 
 class Reader;
 
@@ -41,8 +43,11 @@ class OggVisitor {
 	bool has_stream = false;
 
 public:
-	explicit OggVisitor(Reader &reader)
-		:sync(reader), stream(0) {}
+	/**
+	 * @param offset the current #Reader offset, or -1 if unknown
+	 */
+	explicit OggVisitor(Reader &reader, int64_t offset=-1)
+		:sync(reader, offset), stream(0) {}
 
 	long GetSerialNo() const {
 		return stream.GetSerialNo();
@@ -52,8 +57,10 @@ public:
 
 	/**
 	 * Call this method after seeking the #Reader.
+	 *
+	 * @param offset the new #Reader offset, or -1 if unknown
 	 */
-	void PostSeek();
+	void PostSeek(int64_t offset=-1);
 
 private:
 	void EndStream();
@@ -65,6 +72,16 @@ protected:
 	virtual void OnOggBeginning(const ogg_packet &packet) = 0;
 	virtual void OnOggPacket(const ogg_packet &packet) = 0;
 	virtual void OnOggEnd() = 0;
+
+	/**
+	 * A page of the current stream has been fed into the
+	 * #OggStreamState.
+	 *
+	 * @param offset the #Reader offset of the page, or -1 if
+	 * unknown
+	 */
+	virtual void OnOggPage(gcc_unused const ogg_page &page,
+			       gcc_unused int64_t offset) {}
 };
 
 #endif
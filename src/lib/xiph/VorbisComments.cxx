@@ -26,7 +26,6 @@
 #include "tag/VorbisComment.hxx"
 #include "tag/ReplayGain.hxx"
 #include "ReplayGainInfo.hxx"
-#include "util/DivideString.hxx"
 
 bool
 vorbis_comments_to_replay_gain(ReplayGainInfo &rgi, char **comments)
@@ -69,13 +68,7 @@ static void
 vorbis_scan_comment(const char *comment,
 		    const TagHandler &handler, void *handler_ctx)
 {
-	if (handler.pair != nullptr) {
-		const DivideString split(comment, '=');
-		if (split.IsDefined() && !split.IsEmpty())
-			tag_handler_invoke_pair(handler, handler_ctx,
-						split.GetFirst(),
-						split.GetSecond());
-	}
+	vorbis_comment_invoke_pair(comment, handler, handler_ctx);
 
 	for (const struct tag_table *i = xiph_tags; i->name != nullptr; ++i)
 		if (vorbis_copy_comment(comment, i->name, i->type,
@@ -26,15 +26,27 @@
 #include "neighbor/Explorer.hxx"
 #include "neighbor/Listener.hxx"
 #include "neighbor/Info.hxx"
+#include "config/Block.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 #include "thread/Thread.hxx"
 #include "thread/Name.hxx"
+#include "system/Clock.hxx"
+#include "util/Error.hxx"
 #include "Log.hxx"
 
 #include <libsmbclient.h>
 
 #include <algorithm>
+#include <list>
+#include <map>
+#include <set>
+
+/**
+ * The maximum delay between two attempts to enumerate an
+ * unreachable workgroup [seconds].
+ */
+static constexpr unsigned MAX_BACKOFF = 3600;
 
 class SmbclientNeighborExplorer final : public NeighborExplorer {
 	struct Server {
@@ -58,6 +70,37 @@ class SmbclientNeighborExplorer final : public NeighborExplorer {
 		}
 	};
 
+	/**
+	 * Failure statistics of one URI which gets enumerated (the
+	 * network or a workgroup).  Only accessed by the thread.
+	 */
+	struct Backoff {
+		unsigned failures = 0;
+
+		/**
+		 * Do not try again before this time (see
+		 * MonotonicClockS()).
+		 */
+		unsigned next_attempt = 0;
+	};
+
+	/**
+	 * The time limit for each libsmbclient request
+	 * [milliseconds].
+	 */
+	const unsigned timeout_ms;
+
+	/**
+	 * The time between two scans [seconds].
+	 */
+	const unsigned interval;
+
+	/**
+	 * A libsmbclient context used only by this object, with a
+	 * short timeout.  Protected by #smbclient_mutex.
+	 */
+	SMBCCTX *ctx;
+
 	Thread thread;
 
 	mutable Mutex mutex;
@@ -67,9 +110,22 @@ class SmbclientNeighborExplorer final : public NeighborExplorer {
 
 	bool quit;
 
+	/**
+	 * Only accessed by the thread.
+	 */
+	std::map<std::string, Backoff> backoff;
+
+	/**
+	 * The URI of the workgroup each server in #list was found in.
+	 * Only accessed by the thread.
+	 */
+	std::map<std::string, std::string> origins;
+
 public:
-	SmbclientNeighborExplorer(NeighborListener &_listener)
-		:NeighborExplorer(_listener) {}
+	SmbclientNeighborExplorer(NeighborListener &_listener,
+				  unsigned _timeout_ms, unsigned _interval)
+		:NeighborExplorer(_listener),
+		 timeout_ms(_timeout_ms), interval(_interval) {}
 
 	/* virtual methods from class NeighborExplorer */
 	virtual bool Open(Error &error) override;
@@ -77,6 +133,33 @@ public:
 	virtual List GetList() const override;
 
 private:
+	/**
+	 * May this URI be enumerated now, or is it still backing
+	 * off after a failure?
+	 */
+	bool IsDue(const std::string &uri, unsigned now) const {
+		auto i = backoff.find(uri);
+		return i == backoff.end() || now >= i->second.next_attempt;
+	}
+
+	void Succeeded(const std::string &uri) {
+		backoff.erase(uri);
+	}
+
+	void Failed(const std::string &uri, unsigned now);
+
+	/**
+	 * Enumerate one URI.  Servers are reported to the listener
+	 * as soon as they are found.  Workgroups are appended to the
+	 * given list.
+	 *
+	 * @return false if the URI could not be enumerated
+	 */
+	bool Read(const std::string &uri, std::list<std::string> &workgroups,
+		  std::set<std::string> &seen);
+
+	void Found(const std::string &workgroup, const smbc_dirent &e);
+
 	void Run();
 	void ThreadFunc();
 	static void ThreadFunc(void *ctx);
@@ -85,8 +168,33 @@ private:
 bool
 SmbclientNeighborExplorer::Open(Error &error)
 {
+	{
+		const ScopeLock protect(smbclient_mutex);
+
+		SMBCCTX *ctx0 = smbc_new_context();
+		if (ctx0 == nullptr) {
+			error.SetErrno("smbc_new_context() failed");
+			return false;
+		}
+
+		ctx = smbc_init_context(ctx0);
+		if (ctx == nullptr) {
+			error.SetErrno("smbc_init_context() failed");
+			smbc_free_context(ctx0, 1);
+			return false;
+		}
+
+		smbc_setTimeout(ctx, timeout_ms);
+	}
+
 	quit = false;
-	return thread.Start(ThreadFunc, this, error);
+	if (!thread.Start(ThreadFunc, this, error)) {
+		const ScopeLock protect(smbclient_mutex);
+		smbc_free_context(ctx, 1);
+		return false;
+	}
+
+	return true;
 }
 
 void
@@ -98,6 +206,9 @@ SmbclientNeighborExplorer::Close()
 	mutex.unlock();
 
 	thread.Join();
+
+	const ScopeLock protect(smbclient_mutex);
+	smbc_free_context(ctx, 1);
 }
 
 NeighborExplorer::List
@@ -112,128 +223,156 @@ SmbclientNeighborExplorer::GetList() const
 	return list;
 }
 
-static void
-ReadServer(NeighborExplorer::List &list, const smbc_dirent &e)
+void
+SmbclientNeighborExplorer::Failed(const std::string &uri, unsigned now)
 {
-	const std::string name(e.name, e.namelen);
-	const std::string comment(e.comment, e.commentlen);
+	auto &b = backoff[uri];
+	++b.failures;
 
-	list.emplace_front("smb://" + name, name + " (" + comment + ")");
-}
+	/* double the delay after each failure */
+	unsigned delay = interval;
+	for (unsigned i = 1; i < b.failures && delay < MAX_BACKOFF; ++i)
+		delay *= 2;
 
-static void
-ReadServers(NeighborExplorer::List &list, const char *uri);
+	b.next_attempt = now + std::min(delay, MAX_BACKOFF);
+}
 
-static void
-ReadWorkgroup(NeighborExplorer::List &list, const std::string &name)
+void
+SmbclientNeighborExplorer::Found(const std::string &workgroup,
+				 const smbc_dirent &e)
 {
+	const std::string name(e.name, e.namelen);
+	const std::string comment(e.comment, e.commentlen);
 	std::string uri = "smb://" + name;
-	ReadServers(list, uri.c_str());
-}
 
-static void
-ReadEntry(NeighborExplorer::List &list, const smbc_dirent &e)
-{
-	switch (e.smbc_type) {
-	case SMBC_WORKGROUP:
-		ReadWorkgroup(list, std::string(e.name, e.namelen));
-		break;
-
-	case SMBC_SERVER:
-		ReadServer(list, e);
-		break;
+	origins[uri] = workgroup;
+
+	mutex.lock();
+	for (const auto &i : list) {
+		if (i.uri == uri) {
+			/* already known */
+			mutex.unlock();
+			return;
+		}
 	}
-}
 
-static void
-ReadServers(NeighborExplorer::List &list, int fd)
-{
-	smbc_dirent *e;
-	while ((e = smbc_readdir(fd)) != nullptr)
-		ReadEntry(list, *e);
+	list.emplace_front(std::move(uri), name + " (" + comment + ")");
+	const NeighborInfo info = list.front();
+	mutex.unlock();
 
-	smbc_closedir(fd);
+	/* report it right away, don't wait for the scan to
+	   finish */
+	listener.FoundNeighbor(info);
 }
 
-static void
-ReadServers(NeighborExplorer::List &list, const char *uri)
+bool
+SmbclientNeighborExplorer::Read(const std::string &uri,
+				std::list<std::string> &workgroups,
+				std::set<std::string> &seen)
 {
-	int fd = smbc_opendir(uri);
-	if (fd >= 0) {
-		ReadServers(list, fd);
-		smbc_closedir(fd);
-	} else
+	/* lock the libsmbclient mutex only for one URI at a time,
+	   to let other libsmbclient users in between */
+	const ScopeLock protect(smbclient_mutex);
+
+	SMBCFILE *dir = smbc_getFunctionOpendir(ctx)(ctx, uri.c_str());
+	if (dir == nullptr) {
 		FormatErrno(smbclient_domain, "smbc_opendir('%s') failed",
-			    uri);
-}
+			    uri.c_str());
+		return false;
+	}
 
-gcc_pure
-static NeighborExplorer::List
-DetectServers()
-{
-	NeighborExplorer::List list;
-	const ScopeLock protect(smbclient_mutex);
-	ReadServers(list, "smb://");
-	return list;
-}
+	const auto readdir = smbc_getFunctionReaddir(ctx);
+	const smbc_dirent *e;
+	while ((e = readdir(ctx, dir)) != nullptr) {
+		switch (e->smbc_type) {
+		case SMBC_WORKGROUP:
+			workgroups.emplace_back("smb://" +
+						std::string(e->name,
+							    e->namelen));
+			break;
 
-gcc_pure
-static NeighborExplorer::List::const_iterator
-FindBeforeServerByURI(NeighborExplorer::List::const_iterator prev,
-		      NeighborExplorer::List::const_iterator end,
-		      const std::string &uri)
-{
-	for (auto i = std::next(prev); i != end; prev = i, i = std::next(prev))
-		if (i->uri == uri)
-			return prev;
+		case SMBC_SERVER:
+			seen.emplace("smb://" + std::string(e->name,
+							    e->namelen));
+			Found(uri, *e);
+			break;
+		}
+	}
 
-	return end;
+	smbc_getFunctionClosedir(ctx)(ctx, dir);
+	return true;
 }
 
 inline void
 SmbclientNeighborExplorer::Run()
 {
-	List found = DetectServers(), lost;
+	const unsigned now = MonotonicClockS();
 
-	mutex.lock();
+	/* URIs which have been enumerated successfully; only their
+	   servers may be considered lost */
+	std::set<std::string> checked;
+
+	/* the servers found during this scan */
+	std::set<std::string> seen;
+
+	std::list<std::string> workgroups;
+
+	const std::string root("smb://");
+	if (IsDue(root, now)) {
+		if (Read(root, workgroups, seen)) {
+			Succeeded(root);
+			checked.insert(root);
+		} else
+			Failed(root, now);
+	}
+
+	for (const auto &workgroup : workgroups) {
+		mutex.lock();
+		const bool _quit = quit;
+		mutex.unlock();
+		if (_quit)
+			return;
+
+		if (!IsDue(workgroup, now))
+			/* still unreachable; keep its servers */
+			continue;
+
+		/* workgroups don't contain workgroups; ignore
+		   them */
+		std::list<std::string> nested;
+		if (Read(workgroup, nested, seen)) {
+			Succeeded(workgroup);
+			checked.insert(workgroup);
+		} else
+			Failed(workgroup, now);
+	}
+
+	/* remove the servers which have vanished from a workgroup
+	   which could be enumerated */
 
-	const auto found_before_begin = found.before_begin();
-	const auto found_end = found.end();
+	List lost;
+
+	mutex.lock();
 
 	for (auto prev = list.before_begin(), i = std::next(prev), end = list.end();
 	     i != end; i = std::next(prev)) {
-		auto f = FindBeforeServerByURI(found_before_begin, found_end,
-					       i->uri);
-		if (f != found_end) {
-			/* still visible: remove from "found" so we
-			   don't believe it's a new one */
-			*i = std::move(*std::next(f));
-			found.erase_after(f);
+		auto o = origins.find(i->uri);
+		if (seen.find(i->uri) != seen.end() ||
+		    o == origins.end() ||
+		    checked.find(o->second) == checked.end()) {
 			prev = i;
-		} else {
-			/* can't see it anymore: move to "lost" */
-#if CLANG_OR_GCC_VERSION(4,7)
-			lost.splice_after(lost.before_begin(), list, prev);
-#else
-			/* the forward_list::splice_after() lvalue
-			   reference overload is missing in gcc 4.6 */
-			lost.emplace_front(std::move(*i));
-			list.erase_after(prev);
-#endif
+			continue;
 		}
-	}
 
-	for (auto prev = found_before_begin, i = std::next(prev);
-	     i != found_end; prev = i, i = std::next(prev))
-		list.push_front(*i);
+		origins.erase(o);
+		lost.emplace_front(std::move(*i));
+		list.erase_after(prev);
+	}
 
 	mutex.unlock();
 
 	for (auto &i : lost)
 		listener.LostNeighbor(i);
-
-	for (auto &i : found)
-		listener.FoundNeighbor(i);
 }
 
 inline void
@@ -250,8 +389,7 @@ SmbclientNeighborExplorer::ThreadFunc()
 		if (quit)
 			break;
 
-		// TODO: sleep for how long?
-		cond.timed_wait(mutex, 10000);
+		cond.timed_wait(mutex, interval * 1000);
 	}
 
 	mutex.unlock();
@@ -269,13 +407,19 @@ SmbclientNeighborExplorer::ThreadFunc(void *ctx)
 static NeighborExplorer *
 smbclient_neighbor_create(gcc_unused EventLoop &loop,
 			  NeighborListener &listener,
-			  gcc_unused const ConfigBlock &block,
-			  gcc_unused Error &error)
+			  const ConfigBlock &block,
+			  Error &error)
 {
 	if (!SmbclientInit(error))
 		return nullptr;
 
-	return new SmbclientNeighborExplorer(listener);
+	const unsigned timeout = block.GetBlockValue("timeout", 5u);
+	unsigned interval = block.GetBlockValue("interval", 10u);
+	if (interval < 1)
+		interval = 1;
+
+	return new SmbclientNeighborExplorer(listener, timeout * 1000,
+					     interval);
 }
 
 const NeighborPlugin smbclient_neighbor_plugin = {
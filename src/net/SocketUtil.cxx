@@ -23,6 +23,13 @@
 #include "SocketError.hxx"
 #include "system/fd_util.h"
 
+#ifdef WIN32
+#include <ws2tcpip.h>
+#else
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
 int
 socket_bind_listen(int domain, int type, int protocol,
 		   SocketAddress address,
@@ -79,3 +86,12 @@ socket_keepalive(int fd)
 	return setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE,
 			  (const char *)&reuse, sizeof(reuse));
 }
+
+int
+socket_set_nodelay(int fd, bool value)
+{
+	const int nodelay = value;
+
+	return setsockopt(fd, IPPROTO_TCP, TCP_NODELAY,
+			  (const char *)&nodelay, sizeof(nodelay));
+}
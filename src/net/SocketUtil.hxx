@@ -51,4 +51,13 @@ socket_bind_listen(int domain, int type, int protocol,
 int
 socket_keepalive(int fd);
 
+/**
+ * Enable or disable Nagle's algorithm on a TCP socket (TCP_NODELAY).
+ * Fails on non-TCP sockets.
+ *
+ * @return 0 on success, -1 on error (with errno set)
+ */
+int
+socket_set_nodelay(int fd, bool value);
+
 #endif
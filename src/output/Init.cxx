@@ -56,10 +56,19 @@ AudioOutput::AudioOutput(const AudioOutputPlugin &_plugin)
 	 allow_play(true),
 	 in_playback_loop(false),
 	 woken_for_play(false),
+	 play_batch_size(0),
 	 filter(nullptr),
 	 replay_gain_filter(nullptr),
 	 other_replay_gain_filter(nullptr),
-	 command(Command::NONE)
+	 volume_filter(nullptr),
+	 shared_filter(nullptr), shared_filter_bound(false),
+	 command(Command::NONE),
+	 pipe_position(INACTIVE_POSITION),
+	 pipe_lag(0),
+	 bytes_played(0), listeners(0),
+	 device_buffer_time(0), device_period_time(0),
+	 device_xruns(0),
+	 latency(0), latency_clock(0), played_time(UNKNOWN_TIME), align_reference(UNKNOWN_TIME)
 {
 	assert(plugin.finish != nullptr);
 	assert(plugin.open != nullptr);
@@ -122,6 +131,7 @@ audio_output_load_mixer(EventLoop &event_loop, AudioOutput &ao,
 			Error &error)
 {
 	Mixer *mixer;
+	Filter *volume_filter;
 
 	switch (audio_output_mixer_type(block)) {
 	case MixerType::NONE:
@@ -146,8 +156,15 @@ audio_output_load_mixer(EventLoop &event_loop, AudioOutput &ao,
 				  IgnoreError());
 		assert(mixer != nullptr);
 
+		volume_filter = software_mixer_get_filter(mixer);
+
+		/* replay gain can be merged into the volume filter
+		   only if no other filter runs in between */
+		if (filter_chain_is_empty(filter_chain))
+			ao.volume_filter = volume_filter;
+
 		filter_chain_append(filter_chain, "software_mixer",
-				    software_mixer_get_filter(mixer));
+				    volume_filter);
 		return mixer;
 	}
 
@@ -183,6 +200,7 @@ AudioOutput::Configure(const ConfigBlock &block, Error &error)
 
 	tags = block.GetBlockValue("tags", true);
 	always_on = block.GetBlockValue("always_on", false);
+	align = block.GetBlockValue("align", false);
 	enabled = block.GetBlockValue("enabled", true);
 
 	/* set up the filter chain */
@@ -278,6 +296,9 @@ audio_output_setup(EventLoop &event_loop, AudioOutput &ao,
 		return false;
 	}
 
+	if (strcmp(replay_gain_handler, "software") != 0)
+		ao.volume_filter = nullptr;
+
 	/* the "convert" filter must be the last one in the chain */
 
 	ao.convert_filter = filter_new(&convert_filter_plugin, ConfigBlock(),
@@ -289,6 +310,26 @@ audio_output_setup(EventLoop &event_loop, AudioOutput &ao,
 	return true;
 }
 
+std::string
+audio_output_shared_filter_key(const ConfigBlock &block)
+{
+	/* the software mixer filter and the "mixer" replay gain
+	   handler act on this output only */
+	if (audio_output_mixer_type(block) == MixerType::SOFTWARE)
+		return std::string();
+
+	const char *replay_gain_handler =
+		block.GetBlockValue("replay_gain_handler", "software");
+	if (strcmp(replay_gain_handler, "software") != 0 &&
+	    strcmp(replay_gain_handler, "none") != 0)
+		return std::string();
+
+	std::string key(replay_gain_handler);
+	key.push_back('\n');
+	key.append(block.GetBlockValue(AUDIO_FILTERS, ""));
+	return key;
+}
+
 AudioOutput *
 audio_output_new(EventLoop &event_loop, const ConfigBlock &block,
 		 MixerListener &mixer_listener,
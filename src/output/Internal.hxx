@@ -21,17 +21,24 @@
 #define MPD_OUTPUT_INTERNAL_HXX
 
 #include "AudioFormat.hxx"
+#include "MusicPipe.hxx"
 #include "pcm/PcmBuffer.hxx"
 #include "pcm/PcmDither.hxx"
 #include "ReplayGainInfo.hxx"
 #include "thread/Mutex.hxx"
-#include "thread/Cond.hxx"
+#include "thread/FastCond.hxx"
 #include "thread/Thread.hxx"
 #include "system/PeriodClock.hxx"
+#include "util/LatencyHistogram.hxx"
+#include "Compiler.h"
+
+#include <limits>
+#include <string>
+#include <vector>
 
 class Error;
 class Filter;
-class MusicPipe;
+struct SharedFilter;
 class EventLoop;
 class Mixer;
 class MixerListener;
@@ -39,6 +46,7 @@ struct MusicChunk;
 struct ConfigBlock;
 struct PlayerControl;
 struct AudioOutputPlugin;
+template<typename T> struct ConstBuffer;
 
 struct AudioOutput {
 	enum class Command {
@@ -96,6 +104,13 @@ struct AudioOutput {
 	 */
 	bool always_on;
 
+	/**
+	 * Shall this output be aligned with the other outputs which
+	 * have this flag?  If it is ahead of them, it is padded with
+	 * silence.
+	 */
+	bool align;
+
 	/**
 	 * Has the user enabled this device?
 	 */
@@ -173,6 +188,22 @@ struct AudioOutput {
 	 */
 	AudioFormat out_audio_format;
 
+	/**
+	 * If non-zero, then the output thread gathers consecutive
+	 * chunks until at least this number of bytes (in
+	 * #out_audio_format) is available, and submits them to the
+	 * plugin's play() method in one call.  This may be set by
+	 * the plugin's open() method; it is reset to zero before
+	 * each open() call.
+	 */
+	size_t play_batch_size;
+
+	/**
+	 * The buffer which collects the filtered chunks for
+	 * #play_batch_size.
+	 */
+	std::vector<char> play_batch;
+
 	/**
 	 * The buffer used to allocate the cross-fading result.
 	 */
@@ -214,6 +245,14 @@ struct AudioOutput {
 	 */
 	unsigned other_replay_gain_serial;
 
+	/**
+	 * The software mixer's volume filter, if it is the first item
+	 * in the filter chain and replay gain is applied in software.
+	 * Then #replay_gain_filter only calculates the gain, and this
+	 * filter applies both in one pass (unless cross-fading).
+	 */
+	Filter *volume_filter;
+
 	/**
 	 * The convert_filter_plugin instance of this audio output.
 	 * It is the last item in the filter chain, and is responsible
@@ -222,6 +261,20 @@ struct AudioOutput {
 	 */
 	Filter *convert_filter;
 
+	/**
+	 * The filter chain shared with other outputs which have the
+	 * same filter settings; nullptr if this output has no
+	 * partners.  Owned by #MultipleOutputs.
+	 */
+	SharedFilter *shared_filter;
+
+	/**
+	 * Does this output currently use #shared_filter instead of its
+	 * own filters?  See SharedFilter::Bind().  Only accessed by
+	 * the output thread.
+	 */
+	bool shared_filter_bound;
+
 	/**
 	 * The thread handle, or nullptr if the output thread isn't
 	 * running.
@@ -239,8 +292,7 @@ struct AudioOutput {
 	const MusicPipe *pipe;
 
 	/**
-	 * This mutex protects #open, #fail_timer, #current_chunk and
-	 * #current_chunk_finished.
+	 * This mutex protects #open and #fail_timer.
 	 */
 	Mutex mutex;
 
@@ -248,7 +300,7 @@ struct AudioOutput {
 	 * This condition object wakes up the output thread after
 	 * #command has been set.
 	 */
-	Cond cond;
+	FastCond cond;
 
 	/**
 	 * The PlayerControl object which "owns" this output.  This
@@ -257,23 +309,119 @@ struct AudioOutput {
 	PlayerControl *player_control;
 
 	/**
-	 * The #MusicChunk which is currently being played.  All
+	 * The position of the next chunk in #pipe to be played.  All
 	 * chunks before this one may be returned to the
-	 * #music_buffer, because they are not going to be used by
-	 * this output anymore.
+	 * #MusicBuffer, because they are not going to be used by
+	 * this output anymore.  A value below MusicPipe::GetHead()
+	 * means "start at the head".  #INACTIVE_POSITION means the
+	 * output is not open and does not hold any chunks.
+	 *
+	 * This is only modified by the output thread while it is
+	 * open and by the player thread while the output thread is
+	 * idle; MultipleOutputs::Check() reads it without locking.
+	 */
+	std::atomic<MusicPipe::Position> pipe_position;
+
+	static constexpr MusicPipe::Position INACTIVE_POSITION =
+		~MusicPipe::Position(0);
+
+	/**
+	 * The number of chunks between #pipe_position and the tail of
+	 * the pipe, sampled by the output thread after each chunk.
+	 * For the "perfstats" command.
+	 */
+	std::atomic<unsigned> pipe_lag;
+
+	/**
+	 * The duration of each ao_plugin_play() call in microseconds.
+	 * For the "perfstats" command.
 	 */
-	const MusicChunk *current_chunk;
+	LatencyHistogram play_duration;
 
 	/**
-	 * Has the output finished playing #current_chunk?
+	 * The number of bytes the plugin has consumed.  For the
+	 * metrics listener.
 	 */
-	bool current_chunk_finished;
+	std::atomic<uint64_t> bytes_played;
+
+	/**
+	 * The number of clients connected to a streaming output
+	 * (e.g. "httpd"), maintained by the plugin.  Always zero for
+	 * other plugins.  For the metrics listener.
+	 */
+	std::atomic<unsigned> listeners;
+
+	/**
+	 * The buffer and period time of the device in microseconds,
+	 * as reported by the plugin after opening it.  Zero if the
+	 * plugin does not report device statistics.  For the
+	 * "perfstats" command.
+	 */
+	std::atomic<unsigned> device_buffer_time, device_period_time;
+
+	/**
+	 * The number of buffer underruns reported by the device.
+	 * For the "perfstats" command.
+	 */
+	std::atomic<uint64_t> device_xruns;
+
+	/**
+	 * The amount of audio (in microseconds) which was still
+	 * queued in the device when the plugin was about to write
+	 * more; the lower bound of this is a measure of the
+	 * scheduling jitter.  For the "perfstats" command.
+	 */
+	LatencyHistogram device_headroom;
+
+	/**
+	 * How much audio (in microseconds) passed to the plugin has
+	 * not been heard yet, as reported by ao_plugin_latency()
+	 * after the most recent chunk.  Zero while the output is not
+	 * playing.
+	 */
+	std::atomic<unsigned> latency;
+
+	/**
+	 * The MonotonicClockUS() value when #latency was sampled.
+	 */
+	std::atomic<uint64_t> latency_clock;
+
+	static constexpr int64_t UNKNOWN_TIME =
+		std::numeric_limits<int64_t>::min();
+
+	/**
+	 * The song time stamp (in microseconds) at the end of the
+	 * most recent chunk passed to the plugin, or #UNKNOWN_TIME.
+	 */
+	std::atomic<int64_t> played_time;
+
+	/**
+	 * The earliest GetHeardTime() minus MonotonicClockUS() of
+	 * all outputs this one is aligned with (see #align), or
+	 * #UNKNOWN_TIME.  Updated by MultipleOutputs::Check().
+	 */
+	std::atomic<int64_t> align_reference;
 
 	AudioOutput(const AudioOutputPlugin &_plugin);
 	~AudioOutput();
 
 	bool Configure(const ConfigBlock &block, Error &error);
 
+	/**
+	 * Returns how much audio (in microseconds) is still queued
+	 * in the device right now, extrapolated from the most recent
+	 * #latency sample.  Thread-safe.
+	 */
+	gcc_pure
+	unsigned GetCurrentLatency() const;
+
+	/**
+	 * Returns the song time stamp (in microseconds) which can be
+	 * heard right now, or #UNKNOWN_TIME.  Thread-safe.
+	 */
+	gcc_pure
+	int64_t GetHeardTime() const;
+
 	void StartThread();
 	void StopThread();
 
@@ -325,6 +473,26 @@ struct AudioOutput {
 	 */
 	void LockDisableWait();
 
+	/**
+	 * Like LockEnableWait(), but don't wait for the output thread
+	 * to finish; call LockWaitForCommand() later.
+	 */
+	void LockEnableAsync();
+
+	/**
+	 * Like LockDisableWait(), but don't wait for the output thread
+	 * to finish; call LockWaitForCommand() later.
+	 */
+	void LockDisableAsync();
+
+	/**
+	 * Wait for the current command (if any) to finish.
+	 */
+	void LockWaitForCommand() {
+		const ScopeLock protect(mutex);
+		WaitForCommand();
+	}
+
 	void LockPauseAsync();
 
 	/**
@@ -398,6 +566,17 @@ private:
 
 	void ReopenFilter();
 
+	/**
+	 * Switch to #shared_filter if possible.  Call this after the
+	 * own filters have been opened successfully.
+	 */
+	void BindSharedFilter();
+
+	/**
+	 * Mutex must not be locked.
+	 */
+	void UnbindSharedFilter();
+
 	/**
 	 * Wait until the output's delay reaches zero.
 	 *
@@ -406,15 +585,60 @@ private:
 	 */
 	bool WaitForDelay();
 
-	gcc_pure
-	const MusicChunk *GetNextChunk() const;
+	/**
+	 * Send the chunk's tag (if any) to the plugin and filter the
+	 * chunk.  On error, the output is closed.
+	 *
+	 * @return the filtered data or nullptr on error
+	 */
+	ConstBuffer<void> FilterChunk(MusicPipe::Position position);
+
+	/**
+	 * Submit the data to the plugin until it is consumed
+	 * completely or until a command is received.  On error, the
+	 * output is closed.
+	 */
+	bool PlayData(ConstBuffer<char> data);
+
+	bool PlayChunk(MusicPipe::Position position);
+
+	/**
+	 * Query the plugin's latency and remember the time stamp at
+	 * the end of this chunk, which has just been played.
+	 */
+	void UpdatePlayedTime(const MusicChunk &chunk);
+
+	/**
+	 * Query the plugin's latency and update #latency.
+	 */
+	void SampleLatency();
+
+	/**
+	 * Forget all latency information because the device buffer
+	 * was flushed or drained.
+	 */
+	void ResetLatency();
 
-	bool PlayChunk(const MusicChunk *chunk);
+	/**
+	 * If this output is ahead of the outputs it is aligned with
+	 * (see #align), delay it by playing silence.
+	 *
+	 * @return false on error (the output has been closed)
+	 */
+	bool Align();
+
+	/**
+	 * Filter consecutive chunks up to #play_batch_size and play
+	 * them in one go.
+	 *
+	 * @return the number of chunks consumed, 0 on error
+	 */
+	unsigned PlayBatch(MusicPipe::Position position);
 
 	/**
 	 * Plays all remaining chunks, until the tail of the pipe has
 	 * been reached (and no more chunks are queued), or until a
-	 * command is received.
+	 * command is received.  The pipe is read without a lock.
 	 *
 	 * @return true if at least one chunk has been available,
 	 * false if the tail of the pipe was already reached
@@ -445,4 +669,15 @@ audio_output_new(EventLoop &event_loop, const ConfigBlock &block,
 void
 audio_output_free(AudioOutput *ao);
 
+/**
+ * Describes the filter settings of an "audio_output" block.  Outputs
+ * with the same (non-empty) key may share one #SharedFilter.
+ *
+ * @return the key, or an empty string if the filters of this output
+ * cannot be shared (e.g. because it uses the software mixer)
+ */
+gcc_pure
+std::string
+audio_output_shared_filter_key(const ConfigBlock &block);
+
 #endif
@@ -21,22 +21,30 @@
 #include "MultipleOutputs.hxx"
 #include "player/Control.hxx"
 #include "Internal.hxx"
+#include "SharedFilter.hxx"
 #include "Domain.hxx"
+#include "Log.hxx"
 #include "MusicBuffer.hxx"
 #include "MusicPipe.hxx"
 #include "MusicChunk.hxx"
+#include "PerfStats.hxx"
 #include "system/FatalError.hxx"
+#include "system/Clock.hxx"
 #include "util/Error.hxx"
 #include "config/Block.hxx"
 #include "config/ConfigGlobal.hxx"
 #include "config/ConfigOption.hxx"
 #include "notify.hxx"
 
+#include <algorithm>
+#include <string>
+
 #include <assert.h>
 #include <string.h>
 
-MultipleOutputs::MultipleOutputs(MixerListener &_mixer_listener)
-	:mixer_listener(_mixer_listener)
+MultipleOutputs::MultipleOutputs(MixerListener &_mixer_listener,
+				 unsigned _history_size)
+	:mixer_listener(_mixer_listener), history_size(_history_size)
 {
 }
 
@@ -46,6 +54,9 @@ MultipleOutputs::~MultipleOutputs()
 		i->LockDisableWait();
 		i->Finish();
 	}
+
+	for (auto i : shared_filters)
+		delete i;
 }
 
 static AudioOutput *
@@ -68,9 +79,50 @@ LoadOutput(EventLoop &event_loop, MixerListener &mixer_listener,
 	return output;
 }
 
+/**
+ * Assign a #SharedFilter to all outputs which have the same filter
+ * settings as the given one and don't have one yet.
+ */
+static SharedFilter *
+ShareFilters(const std::vector<AudioOutput *> &outputs,
+	     const std::vector<const ConfigBlock *> &blocks,
+	     const std::vector<std::string> &keys, size_t first)
+{
+	const std::string &key = keys[first];
+
+	SharedFilter *sf = nullptr;
+	for (size_t i = first + 1; i < outputs.size(); ++i) {
+		if (keys[i] != key || outputs[i]->shared_filter != nullptr)
+			continue;
+
+		if (sf == nullptr) {
+			const ConfigBlock &block = *blocks[first];
+			const char *replay_gain_handler =
+				block.GetBlockValue("replay_gain_handler",
+						    "software");
+			sf = new SharedFilter(key,
+					      block.GetBlockValue("filters",
+								  ""),
+					      strcmp(replay_gain_handler,
+						     "none") != 0);
+			outputs[first]->shared_filter = sf;
+		}
+
+		outputs[i]->shared_filter = sf;
+		FormatDebug(output_domain,
+			    "output \"%s\" shares filters with \"%s\"",
+			    outputs[i]->name, outputs[first]->name);
+	}
+
+	return sf;
+}
+
 void
 MultipleOutputs::Configure(EventLoop &event_loop, PlayerControl &pc)
 {
+	std::vector<const ConfigBlock *> blocks;
+	std::vector<std::string> keys;
+
 	for (const auto *param = config_get_block(ConfigBlockOption::AUDIO_OUTPUT);
 	     param != nullptr; param = param->next) {
 		auto output = LoadOutput(event_loop, mixer_listener,
@@ -80,6 +132,17 @@ MultipleOutputs::Configure(EventLoop &event_loop, PlayerControl &pc)
 					 "names: %s", output->name);
 
 		outputs.push_back(output);
+		blocks.push_back(param);
+		keys.push_back(audio_output_shared_filter_key(*param));
+	}
+
+	for (size_t i = 0; i < outputs.size(); ++i) {
+		if (keys[i].empty() || outputs[i]->shared_filter != nullptr)
+			continue;
+
+		SharedFilter *sf = ShareFilters(outputs, blocks, keys, i);
+		if (sf != nullptr)
+			shared_filters.push_back(sf);
 	}
 
 	if (outputs.empty()) {
@@ -91,6 +154,14 @@ MultipleOutputs::Configure(EventLoop &event_loop, PlayerControl &pc)
 	}
 }
 
+void
+MultipleOutputs::Configure(EventLoop &event_loop, PlayerControl &pc,
+			   const ConfigBlock &block)
+{
+	outputs.push_back(LoadOutput(event_loop, mixer_listener,
+				     pc, block));
+}
+
 AudioOutput *
 MultipleOutputs::FindByName(const char *name) const
 {
@@ -101,9 +172,34 @@ MultipleOutputs::FindByName(const char *name) const
 	return nullptr;
 }
 
+AudioFormat
+MultipleOutputs::GetPreferredFormat() const
+{
+	if (outputs.empty())
+		return AudioFormat::Undefined();
+
+	AudioFormat result = outputs.front()->config_audio_format;
+	for (const auto ao : outputs) {
+		const AudioFormat &f = ao->config_audio_format;
+
+		if (f.sample_rate != result.sample_rate)
+			result.sample_rate = 0;
+
+		if (f.format != result.format)
+			result.format = SampleFormat::UNDEFINED;
+
+		if (f.channels != result.channels)
+			result.channels = 0;
+	}
+
+	return result;
+}
+
 void
 MultipleOutputs::EnableDisable()
 {
+	/* send all commands first, so slow devices are enabled in
+	   parallel by their output threads */
 	for (auto ao : outputs) {
 		bool enabled;
 
@@ -113,11 +209,14 @@ MultipleOutputs::EnableDisable()
 
 		if (ao->enabled != enabled) {
 			if (ao->enabled)
-				ao->LockEnableWait();
+				ao->LockEnableAsync();
 			else
-				ao->LockDisableWait();
+				ao->LockDisableAsync();
 		}
 	}
+
+	for (auto ao : outputs)
+		ao->LockWaitForCommand();
 }
 
 bool
@@ -181,6 +280,9 @@ MultipleOutputs::SetReplayGainMode(ReplayGainMode mode)
 {
 	for (auto ao : outputs)
 		ao->SetReplayGainMode(mode);
+
+	for (auto sf : shared_filters)
+		sf->SetReplayGainMode(mode);
 }
 
 bool
@@ -222,7 +324,7 @@ MultipleOutputs::Open(const AudioFormat audio_format,
 	assert(pipe == nullptr || pipe->CheckFormat(audio_format));
 
 	if (pipe == nullptr)
-		pipe = new MusicPipe();
+		pipe = new MusicPipe(_buffer.GetSize());
 	else
 		/* if the pipe hasn't been cleared, the the audio
 		   format must not have changed */
@@ -255,85 +357,74 @@ MultipleOutputs::Open(const AudioFormat audio_format,
 	return ret;
 }
 
-/**
- * Has the specified audio output already consumed this chunk?
- */
-gcc_pure
-static bool
-chunk_is_consumed_in(const AudioOutput *ao,
-		     gcc_unused const MusicPipe *pipe,
-		     const MusicChunk *chunk)
-{
-	if (!ao->open)
-		return true;
-
-	if (ao->current_chunk == nullptr)
-		return false;
-
-	assert(chunk == ao->current_chunk ||
-	       pipe->Contains(ao->current_chunk));
-
-	if (chunk != ao->current_chunk) {
-		assert(chunk->next != nullptr);
-		return true;
-	}
-
-	return ao->current_chunk_finished && chunk->next == nullptr;
-}
-
 bool
-MultipleOutputs::IsChunkConsumed(const MusicChunk *chunk) const
+MultipleOutputs::IsChunkConsumed(MusicPipe::Position position) const
 {
-	for (auto ao : outputs) {
-		const ScopeLock protect(ao->mutex);
-		if (!chunk_is_consumed_in(ao, pipe, chunk))
+	/* the acquire load pairs with the release store in
+	   AudioOutput::Play(); after it, the output does not touch
+	   the chunk anymore */
+	for (auto ao : outputs)
+		if (ao->pipe_position.load(std::memory_order_acquire) <= position)
 			return false;
-	}
 
 	return true;
 }
 
-inline void
-MultipleOutputs::ClearTailChunk(gcc_unused const MusicChunk *chunk,
-				bool *locked)
+unsigned
+MultipleOutputs::GetLatency() const
 {
-	assert(chunk->next == nullptr);
-	assert(pipe->Contains(chunk));
+	unsigned result = 0;
+	for (auto ao : outputs)
+		result = std::max(result, ao->GetCurrentLatency());
+	return result;
+}
 
-	for (unsigned i = 0, n = outputs.size(); i != n; ++i) {
-		AudioOutput *ao = outputs[i];
+void
+MultipleOutputs::UpdateAlignment()
+{
+	/* compare the heard time stamps relative to the same clock
+	   value, so the reference remains valid while the outputs
+	   keep playing */
+	const int64_t now = MonotonicClockUS();
 
-		/* this mutex will be unlocked by the caller when it's
-		   ready */
-		ao->mutex.lock();
-		locked[i] = ao->open;
+	int64_t reference = AudioOutput::UNKNOWN_TIME;
+	unsigned n = 0;
+	for (auto ao : outputs) {
+		if (!ao->align)
+			continue;
 
-		if (!locked[i]) {
-			ao->mutex.unlock();
+		const int64_t heard = ao->GetHeardTime();
+		if (heard == AudioOutput::UNKNOWN_TIME)
 			continue;
-		}
 
-		assert(ao->current_chunk == chunk);
-		assert(ao->current_chunk_finished);
-		ao->current_chunk = nullptr;
+		if (n++ == 0 || heard - now < reference)
+			reference = heard - now;
 	}
+
+	if (n < 2)
+		/* nothing to align with */
+		reference = AudioOutput::UNKNOWN_TIME;
+
+	for (auto ao : outputs)
+		if (ao->align)
+			ao->align_reference.store(reference,
+						  std::memory_order_relaxed);
 }
 
 unsigned
 MultipleOutputs::Check()
 {
 	const MusicChunk *chunk;
-	bool is_tail;
-	MusicChunk *shifted;
-	bool locked[outputs.size()];
 
 	assert(buffer != nullptr);
 	assert(pipe != nullptr);
 
+	UpdateAlignment();
+
 	while ((chunk = pipe->Peek()) != nullptr) {
 		assert(!pipe->IsEmpty());
 
-		if (!IsChunkConsumed(chunk))
+		if (!IsChunkConsumed(pipe->GetHead()))
 			/* at least one output is not finished playing
 			   this chunk */
 			return pipe->GetSize();
@@ -343,30 +434,65 @@ MultipleOutputs::Check()
 			   provides a defined value */
 			elapsed_time = chunk->time;
 
-		is_tail = chunk->next == nullptr;
-		if (is_tail)
-			/* this is the tail of the pipe - clear the
-			   chunk reference in all outputs */
-			ClearTailChunk(chunk, locked);
+		if (chunk->submit_time > 0)
+			perf_stats.chunk_latency.Add(MonotonicClockUS() -
+						     chunk->submit_time);
+
+		const MusicPipe::Position position = pipe->GetHead();
 
 		/* remove the chunk from the pipe */
-		shifted = pipe->Shift();
+		MusicChunk *shifted = pipe->Shift();
 		assert(shifted == chunk);
 
-		if (is_tail)
-			/* unlock all audio outputs which were locked
-			   by clear_tail_chunk() */
-			for (unsigned i = 0, n = outputs.size(); i != n; ++i)
-				if (locked[i])
-					outputs[i]->mutex.unlock();
-
-		/* return the chunk to the buffer */
-		buffer->Return(shifted);
+		/* keep the chunk for Rewind() or return it to the
+		   buffer */
+		if (position >= history_start)
+			AddHistory(shifted);
+		else
+			buffer->Return(shifted);
 	}
 
 	return 0;
 }
 
+void
+MultipleOutputs::AddHistory(MusicChunk *chunk)
+{
+	if (chunk->length == 0) {
+		/* a tag without data: nothing to play again */
+		buffer->Return(chunk);
+		return;
+	}
+
+	if (history_size == 0 || chunk->other != nullptr ||
+	    chunk->time.IsNegative()) {
+		/* cross-faded chunks and chunks without a time stamp
+		   cannot be played again; this also interrupts the
+		   history */
+		ClearHistory();
+		buffer->Return(chunk);
+		return;
+	}
+
+	if (!history.empty() && chunk->time < history.back()->time)
+		ClearHistory();
+
+	history.push_back(chunk);
+
+	if (history.size() > history_size) {
+		buffer->Return(history.front());
+		history.pop_front();
+	}
+}
+
+void
+MultipleOutputs::ClearHistory()
+{
+	for (auto chunk : history)
+		buffer->Return(chunk);
+	history.clear();
+}
+
 bool
 MultipleOutputs::Wait(PlayerControl &pc, unsigned threshold)
 {
@@ -418,6 +544,8 @@ MultipleOutputs::Cancel()
 	if (pipe != nullptr)
 		pipe->Clear(*buffer);
 
+	ClearHistory();
+
 	/* the audio outputs are now waiting for a signal, to
 	   synchronize the cleared music pipe */
 
@@ -428,6 +556,77 @@ MultipleOutputs::Cancel()
 	elapsed_time = SignedSongTime::Negative();
 }
 
+bool
+MultipleOutputs::Rewind(SongTime t, MusicPipe &dest)
+{
+	if (pipe == nullptr || history.empty() ||
+	    pipe->GetHead() < history_start)
+		return false;
+
+	const SignedSongTime where(t);
+	if (where < history.front()->time || where > history.back()->time)
+		return false;
+
+	/* find the last chunk which begins before the given time */
+	auto i = history.end();
+	while ((*--i)->time > where) {}
+
+	/* verify that the remaining chunks of the current song
+	   follow the history seamlessly */
+
+	SignedSongTime last = history.back()->time;
+	unsigned n = history.end() - i;
+
+	for (auto p = pipe->GetHead(), end = pipe->GetTail(); p != end; ++p) {
+		const MusicChunk &chunk = *pipe->Get(p);
+		if (chunk.other != nullptr)
+			return false;
+
+		if (chunk.length > 0) {
+			if (chunk.time < last)
+				return false;
+
+			last = chunk.time;
+		}
+
+		++n;
+	}
+
+	const MusicChunk *next = dest.Peek();
+	if ((next != nullptr && next->length > 0 && next->time < last) ||
+	    /* there must be room in front of the head */
+	    n > dest.GetHead())
+		return false;
+
+	for (auto ao : outputs)
+		ao->LockCancelAsync();
+
+	WaitAll();
+
+	/* move the unfinished chunks back to the destination pipe,
+	   followed by the history; newest first */
+
+	std::vector<MusicChunk *> unfinished;
+	unfinished.reserve(pipe->GetSize());
+
+	MusicChunk *chunk;
+	while ((chunk = pipe->Shift()) != nullptr)
+		unfinished.push_back(chunk);
+
+	for (auto j = unfinished.rbegin(); j != unfinished.rend(); ++j)
+		dest.Unshift(*j);
+
+	while (history.end() != i) {
+		dest.Unshift(history.back());
+		history.pop_back();
+	}
+
+	AllowPlay();
+
+	elapsed_time = SignedSongTime::Negative();
+	return true;
+}
+
 void
 MultipleOutputs::Close()
 {
@@ -440,8 +639,14 @@ MultipleOutputs::Close()
 		pipe->Clear(*buffer);
 		delete pipe;
 		pipe = nullptr;
+
+		for (auto sf : shared_filters)
+			sf->Reset();
 	}
 
+	ClearHistory();
+	history_start = 0;
+
 	buffer = nullptr;
 
 	input_audio_format.Clear();
@@ -461,8 +666,14 @@ MultipleOutputs::Release()
 		pipe->Clear(*buffer);
 		delete pipe;
 		pipe = nullptr;
+
+		for (auto sf : shared_filters)
+			sf->Reset();
 	}
 
+	ClearHistory();
+	history_start = 0;
+
 	buffer = nullptr;
 
 	input_audio_format.Clear();
@@ -476,4 +687,10 @@ MultipleOutputs::SongBorder()
 	/* clear the elapsed_time pointer at the beginning of a new
 	   song */
 	elapsed_time = SignedSongTime::zero();
+
+	/* all chunks which are in the pipe now belong to the
+	   previous song */
+	ClearHistory();
+	if (pipe != nullptr)
+		history_start = pipe->GetTail();
 }
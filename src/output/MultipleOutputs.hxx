@@ -29,19 +29,22 @@
 #include "AudioFormat.hxx"
 #include "ReplayGainInfo.hxx"
 #include "Chrono.hxx"
+#include "MusicPipe.hxx"
 #include "Compiler.h"
 
 #include <vector>
+#include <deque>
 
 #include <assert.h>
 
 class MusicBuffer;
-class MusicPipe;
 class EventLoop;
 class MixerListener;
 struct MusicChunk;
 struct PlayerControl;
 struct AudioOutput;
+struct SharedFilter;
+struct ConfigBlock;
 class Error;
 
 class MultipleOutputs {
@@ -49,6 +52,12 @@ class MultipleOutputs {
 
 	std::vector<AudioOutput *> outputs;
 
+	/**
+	 * Filter chains shared by outputs with identical filter
+	 * settings, see audio_output_shared_filter_key().
+	 */
+	std::vector<SharedFilter *> shared_filters;
+
 	AudioFormat input_audio_format = AudioFormat::Undefined();
 
 	/**
@@ -68,16 +77,49 @@ class MultipleOutputs {
 	 */
 	SignedSongTime elapsed_time = SignedSongTime::Negative();
 
+	/**
+	 * The maximum number of chunks in #history.  Zero disables
+	 * the history.
+	 */
+	const unsigned history_size;
+
+	/**
+	 * Chunks which have been played already, oldest first.  They
+	 * are kept for a while, so a backward seek can be served from
+	 * memory, see Rewind().  All of them belong to the current
+	 * song, and they are contiguous.  They are not available to
+	 * the decoder until they are returned to the #buffer.
+	 */
+	std::deque<MusicChunk *> history;
+
+	/**
+	 * Chunks in #pipe before this position belong to the previous
+	 * song; they are not added to the #history.
+	 */
+	MusicPipe::Position history_start = 0;
+
 public:
 	/**
 	 * Load audio outputs from the configuration file and
 	 * initialize them.
+	 *
+	 * @param _history_size the maximum number of played chunks
+	 * to keep for Rewind()
 	 */
-	MultipleOutputs(MixerListener &_mixer_listener);
+	MultipleOutputs(MixerListener &_mixer_listener,
+			unsigned _history_size=0);
 	~MultipleOutputs();
 
 	void Configure(EventLoop &event_loop, PlayerControl &pc);
 
+	/**
+	 * Load only the one output described by the given block,
+	 * ignoring the "audio_output" settings.  The block must
+	 * outlive this object.
+	 */
+	void Configure(EventLoop &event_loop, PlayerControl &pc,
+		       const ConfigBlock &block);
+
 	/**
 	 * Returns the total number of audio output devices, including
 	 * those which are disabled right now.
@@ -109,6 +151,16 @@ public:
 	gcc_pure
 	AudioOutput *FindByName(const char *name) const;
 
+	/**
+	 * Determine the attributes of the "format" setting on which
+	 * all outputs agree.  The result is a mask; attributes
+	 * without consensus are undefined.  Decoder plugins which
+	 * can produce several sample formats use this hint to avoid
+	 * conversions (see decoder_preferred_format()).
+	 */
+	gcc_pure
+	AudioFormat GetPreferredFormat() const;
+
 	/**
 	 * Checks the "enabled" flag of all audio outputs, and if one has
 	 * changed, commit the change.
@@ -183,6 +235,21 @@ public:
 	 */
 	void Cancel();
 
+	/**
+	 * Cancel playback like Cancel(), but move the played chunks
+	 * from the specified time on and all chunks which have not
+	 * been played completely back to the head of the given pipe,
+	 * so they will be played again.  This implements a backward
+	 * seek without restarting (or even seeking) the decoder.
+	 *
+	 * @param t the time within the current song
+	 * @param dest the pipe which contains the chunks following
+	 * the ones in #pipe
+	 * @return false if the data is not available; nothing has
+	 * been changed then
+	 */
+	bool Rewind(SongTime t, MusicPipe &dest);
+
 	/**
 	 * Indicate that a new song will begin now.
 	 */
@@ -198,6 +265,15 @@ public:
 		return elapsed_time;
 	}
 
+	/**
+	 * Returns the largest amount of audio (in microseconds) which
+	 * has been passed to an output, but has not been heard yet.
+	 * This is the lag of GetElapsedTime() behind what can be
+	 * heard.
+	 */
+	gcc_pure
+	unsigned GetLatency() const;
+
 	/**
 	 * Returns the average volume of all available mixers (range
 	 * 0..100).  Returns -1 if no mixer can be queried.
@@ -260,16 +336,28 @@ private:
 	bool Update();
 
 	/**
-	 * Has this chunk been consumed by all audio outputs?
+	 * Has the chunk at this position of #pipe been consumed by
+	 * all audio outputs?  This does not lock the outputs.
+	 */
+	gcc_pure
+	bool IsChunkConsumed(MusicPipe::Position position) const;
+
+	/**
+	 * Publish the earliest time stamp heard on any output with
+	 * the "align" flag to those outputs.
+	 */
+	void UpdateAlignment();
+
+	/**
+	 * Add a chunk which has been played by all outputs to the
+	 * #history, or return it to the #buffer.
 	 */
-	bool IsChunkConsumed(const MusicChunk *chunk) const;
+	void AddHistory(MusicChunk *chunk);
 
 	/**
-	 * There's only one chunk left in the pipe (#pipe), and all
-	 * audio outputs have consumed it already.  Clear the
-	 * reference.
+	 * Return all chunks in the #history to the #buffer.
 	 */
-	void ClearTailChunk(const MusicChunk *chunk, bool *locked);
+	void ClearHistory();
 };
 
 #endif
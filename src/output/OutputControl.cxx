@@ -24,6 +24,7 @@
 #include "mixer/MixerControl.hxx"
 #include "notify.hxx"
 #include "filter/plugins/ReplayGainFilterPlugin.hxx"
+#include "system/Clock.hxx"
 #include "util/Error.hxx"
 #include "Log.hxx"
 
@@ -35,6 +36,31 @@ static constexpr unsigned REOPEN_AFTER = 10;
 
 struct notify audio_output_client_notify;
 
+unsigned
+AudioOutput::GetCurrentLatency() const
+{
+	const unsigned l = latency.load(std::memory_order_relaxed);
+	if (l == 0)
+		return 0;
+
+	/* the device has been playing since the sample was taken */
+	const uint64_t elapsed = MonotonicClockUS() -
+		latency_clock.load(std::memory_order_relaxed);
+	return elapsed < l
+		? l - unsigned(elapsed)
+		: 0;
+}
+
+int64_t
+AudioOutput::GetHeardTime() const
+{
+	const int64_t t = played_time.load(std::memory_order_relaxed);
+	if (t == UNKNOWN_TIME)
+		return UNKNOWN_TIME;
+
+	return t - GetCurrentLatency();
+}
+
 void
 AudioOutput::WaitForCommand()
 {
@@ -78,7 +104,7 @@ AudioOutput::SetReplayGainMode(ReplayGainMode mode)
 }
 
 void
-AudioOutput::LockEnableWait()
+AudioOutput::LockEnableAsync()
 {
 	if (!thread.IsDefined()) {
 		if (plugin.enable == nullptr) {
@@ -92,11 +118,19 @@ AudioOutput::LockEnableWait()
 		StartThread();
 	}
 
-	LockCommandWait(Command::ENABLE);
+	const ScopeLock protect(mutex);
+	CommandAsync(Command::ENABLE);
 }
 
 void
-AudioOutput::LockDisableWait()
+AudioOutput::LockEnableWait()
+{
+	LockEnableAsync();
+	LockWaitForCommand();
+}
+
+void
+AudioOutput::LockDisableAsync()
 {
 	if (!thread.IsDefined()) {
 		if (plugin.disable == nullptr)
@@ -109,7 +143,15 @@ AudioOutput::LockDisableWait()
 		return;
 	}
 
-	LockCommandWait(Command::DISABLE);
+	const ScopeLock protect(mutex);
+	CommandAsync(Command::DISABLE);
+}
+
+void
+AudioOutput::LockDisableWait()
+{
+	LockDisableAsync();
+	LockWaitForCommand();
 }
 
 inline bool
@@ -124,8 +166,8 @@ AudioOutput::Open(const AudioFormat audio_format, const MusicPipe &mp)
 		assert(pipe == &mp || (always_on && pause));
 
 		if (pause) {
-			current_chunk = nullptr;
 			pipe = &mp;
+			pipe_position = mp.GetHead();
 
 			/* unpause with the CANCEL command; this is a
 			   hack, but suits well for forcing the thread
@@ -141,9 +183,9 @@ AudioOutput::Open(const AudioFormat audio_format, const MusicPipe &mp)
 	}
 
 	in_audio_format = audio_format;
-	current_chunk = nullptr;
 
 	pipe = &mp;
+	pipe_position = mp.GetHead();
 
 	if (!thread.IsDefined())
 		StartThread();
@@ -152,6 +194,10 @@ AudioOutput::Open(const AudioFormat audio_format, const MusicPipe &mp)
 		    ? Command::REOPEN
 		    : Command::OPEN);
 	const bool open2 = open;
+	if (!open2)
+		/* don't let a failed output hold back the
+		   music pipe */
+		pipe_position = INACTIVE_POSITION;
 
 	if (open2 && mixer != nullptr) {
 		Error error;
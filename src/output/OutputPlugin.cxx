@@ -102,6 +102,14 @@ ao_plugin_cancel(AudioOutput *ao)
 		ao->plugin.cancel(ao);
 }
 
+unsigned
+ao_plugin_latency(AudioOutput *ao)
+{
+	return ao->plugin.latency != nullptr
+		? ao->plugin.latency(ao)
+		: 0;
+}
+
 bool
 ao_plugin_pause(AudioOutput *ao)
 {
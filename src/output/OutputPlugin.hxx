@@ -141,6 +141,16 @@ struct AudioOutputPlugin {
 	 */
 	bool (*pause)(AudioOutput *data);
 
+	/**
+	 * Returns how much audio which was passed to play() has not
+	 * been heard yet, because it is still queued in the device's
+	 * (or the network's) buffer.  Optional method; it is called
+	 * by the output thread right after play().
+	 *
+	 * @return the latency in microseconds
+	 */
+	unsigned (*latency)(AudioOutput *data);
+
 	/**
 	 * The mixer plugin associated with this output plugin.  This
 	 * may be nullptr if no mixer plugin is implemented.  When
@@ -197,6 +207,10 @@ ao_plugin_drain(AudioOutput *ao);
 void
 ao_plugin_cancel(AudioOutput *ao);
 
+gcc_pure
+unsigned
+ao_plugin_latency(AudioOutput *ao);
+
 bool
 ao_plugin_pause(AudioOutput *ao);
 
@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "Internal.hxx"
+#include "SharedFilter.hxx"
 #include "OutputAPI.hxx"
 #include "Domain.hxx"
 #include "pcm/PcmMix.hxx"
@@ -27,18 +28,26 @@
 #include "filter/FilterInternal.hxx"
 #include "filter/plugins/ConvertFilterPlugin.hxx"
 #include "filter/plugins/ReplayGainFilterPlugin.hxx"
+#include "filter/plugins/VolumeFilterPlugin.hxx"
+#include "pcm/Volume.hxx"
 #include "player/Control.hxx"
 #include "MusicPipe.hxx"
 #include "MusicChunk.hxx"
 #include "thread/Util.hxx"
 #include "thread/Slack.hxx"
 #include "thread/Name.hxx"
+#include "ThreadSettings.hxx"
+#include "system/Clock.hxx"
+#include "system/Trace.hxx"
 #include "system/FatalError.hxx"
 #include "util/Error.hxx"
 #include "util/ConstBuffer.hxx"
 #include "Log.hxx"
 #include "Compiler.h"
 
+#include <algorithm>
+#include <string>
+
 #include <assert.h>
 #include <string.h>
 
@@ -128,6 +137,31 @@ AudioOutput::CloseFilter()
 	filter->Close();
 }
 
+void
+AudioOutput::BindSharedFilter()
+{
+	assert(!shared_filter_bound);
+
+	if (shared_filter == nullptr)
+		return;
+
+	shared_filter_bound = shared_filter->Bind(in_audio_format,
+						  out_audio_format);
+	if (shared_filter_bound)
+		FormatDebug(output_domain,
+			    "\"%s\" [%s] uses shared filters",
+			    name, plugin.name);
+}
+
+void
+AudioOutput::UnbindSharedFilter()
+{
+	if (shared_filter_bound) {
+		shared_filter_bound = false;
+		shared_filter->Unbind();
+	}
+}
+
 inline void
 AudioOutput::Open()
 {
@@ -137,7 +171,6 @@ AudioOutput::Open()
 
 	assert(!open);
 	assert(pipe != nullptr);
-	assert(current_chunk == nullptr);
 	assert(in_audio_format.IsValid());
 
 	fail_timer.Reset();
@@ -170,6 +203,7 @@ AudioOutput::Open()
 	const AudioFormat retry_audio_format = out_audio_format;
 
  retry_without_dsd:
+	play_batch_size = 0;
 	success = ao_plugin_open(this, out_audio_format, error);
 	mutex.lock();
 
@@ -228,6 +262,8 @@ AudioOutput::Open()
 
 	open = true;
 
+	BindSharedFilter();
+
 	FormatDebug(output_domain,
 		    "opened plugin=%s name=\"%s\" audio_format=%s",
 		    plugin.name, name,
@@ -246,12 +282,13 @@ AudioOutput::Close(bool drain)
 
 	pipe = nullptr;
 
-	current_chunk = nullptr;
+	pipe_position = INACTIVE_POSITION;
 	open = false;
 
 	mutex.unlock();
 
 	CloseOutput(drain);
+	UnbindSharedFilter();
 	CloseFilter();
 
 	mutex.lock();
@@ -269,6 +306,7 @@ AudioOutput::CloseOutput(bool drain)
 		ao_plugin_cancel(this);
 
 	ao_plugin_close(this);
+	ResetLatency();
 }
 
 void
@@ -277,6 +315,7 @@ AudioOutput::ReopenFilter()
 	Error error;
 
 	mutex.unlock();
+	UnbindSharedFilter();
 	CloseFilter();
 	mutex.lock();
 
@@ -295,7 +334,7 @@ AudioOutput::ReopenFilter()
 
 		pipe = nullptr;
 
-		current_chunk = nullptr;
+		pipe_position = INACTIVE_POSITION;
 		open = false;
 		fail_timer.Update();
 
@@ -305,6 +344,8 @@ AudioOutput::ReopenFilter()
 
 		return;
 	}
+
+	BindSharedFilter();
 }
 
 void
@@ -353,20 +394,29 @@ AudioOutput::WaitForDelay()
 	}
 }
 
+/**
+ * @param f the object which owns the filters: either the
+ * #AudioOutput itself or its #SharedFilter
+ * @param volume_filter if not nullptr, then replay gain is not
+ * applied here, but passed to this volume filter which is applied
+ * later by the filter chain
+ */
+template<typename F>
 static ConstBuffer<void>
-ao_chunk_data(AudioOutput *ao, const MusicChunk *chunk,
+ao_chunk_data(const AudioOutput &ao, const F &f, const MusicChunk *chunk,
 	      Filter *replay_gain_filter,
-	      unsigned *replay_gain_serial_p)
+	      unsigned *replay_gain_serial_p,
+	      Filter *volume_filter=nullptr)
 {
 	assert(chunk != nullptr);
 	assert(!chunk->IsEmpty());
-	assert(chunk->CheckFormat(ao->in_audio_format));
+	assert(chunk->CheckFormat(f.in_audio_format));
 
 	ConstBuffer<void> data(chunk->data, chunk->length);
 
-	(void)ao;
+	(void)f;
 
-	assert(data.size % ao->in_audio_format.GetFrameSize() == 0);
+	assert(data.size % f.in_audio_format.GetFrameSize() == 0);
 
 	if (!data.IsEmpty() && replay_gain_filter != nullptr) {
 		if (chunk->replay_gain_serial != *replay_gain_serial_p) {
@@ -377,22 +427,40 @@ ao_chunk_data(AudioOutput *ao, const MusicChunk *chunk,
 			*replay_gain_serial_p = chunk->replay_gain_serial;
 		}
 
+		if (volume_filter != nullptr) {
+			volume_filter_set_gain(volume_filter,
+					       replay_gain_filter_get_volume(replay_gain_filter));
+			return data;
+		}
+
 		Error error;
 		data = replay_gain_filter->FilterPCM(data, error);
 		if (data.IsNull())
 			FormatError(error, "\"%s\" [%s] failed to filter",
-				    ao->name, ao->plugin.name);
+				    ao.name, ao.plugin.name);
 	}
 
 	return data;
 }
 
+template<typename F>
 static ConstBuffer<void>
-ao_filter_chunk(AudioOutput *ao, const MusicChunk *chunk)
+ao_filter_chunk(const AudioOutput &ao, F &f, const MusicChunk *chunk)
 {
+	/* without cross-fading, the volume filter applies replay
+	   gain, which saves one pass over the buffer and one
+	   rounding/dithering step */
+	Filter *volume_filter = nullptr;
+	if (f.volume_filter != nullptr) {
+		if (chunk->other == nullptr)
+			volume_filter = f.volume_filter;
+		else
+			volume_filter_set_gain(f.volume_filter, PCM_VOLUME_1);
+	}
+
 	ConstBuffer<void> data =
-		ao_chunk_data(ao, chunk, ao->replay_gain_filter,
-			      &ao->replay_gain_serial);
+		ao_chunk_data(ao, f, chunk, f.replay_gain_filter,
+			      &f.replay_gain_serial, volume_filter);
 	if (data.IsEmpty())
 		return data;
 
@@ -400,9 +468,9 @@ ao_filter_chunk(AudioOutput *ao, const MusicChunk *chunk)
 
 	if (chunk->other != nullptr) {
 		ConstBuffer<void> other_data =
-			ao_chunk_data(ao, chunk->other,
-				      ao->other_replay_gain_filter,
-				      &ao->other_replay_gain_serial);
+			ao_chunk_data(ao, f, chunk->other,
+				      f.other_replay_gain_filter,
+				      &f.other_replay_gain_serial);
 		if (other_data.IsNull())
 			return nullptr;
 
@@ -418,22 +486,31 @@ ao_filter_chunk(AudioOutput *ao, const MusicChunk *chunk)
 			data.size = other_data.size;
 
 		float mix_ratio = chunk->mix_ratio;
-		if (mix_ratio >= 0)
+		float mix_ratio_end = mix_ratio;
+		if (mix_ratio >= 0) {
 			/* reverse the mix ratio (because the
-			   arguments to pcm_mix() are reversed), but
-			   only if the mix ratio is non-negative; a
-			   negative mix ratio is a MixRamp special
+			   arguments to pcm_mix_ramp() are reversed),
+			   but only if the mix ratio is non-negative;
+			   a negative mix ratio is a MixRamp special
 			   case */
 			mix_ratio = 1.0 - mix_ratio;
 
-		void *dest = ao->cross_fade_buffer.Get(other_data.size);
+			/* the ramp ends where the chunk's data ends;
+			   if it's shorter than the "other" chunk,
+			   cross-fading ends here anyway */
+			mix_ratio_end = 1.0 - chunk->mix_ratio_end;
+		}
+
+		void *dest = f.cross_fade_buffer.Get(other_data.size);
 		memcpy(dest, other_data.data, other_data.size);
-		if (!pcm_mix(ao->cross_fade_dither, dest, data.data, data.size,
-			     ao->in_audio_format.format,
-			     mix_ratio)) {
+		if (!pcm_mix_ramp(f.cross_fade_dither, dest, data.data,
+				  data.size,
+				  f.in_audio_format.format,
+				  f.in_audio_format.channels,
+				  mix_ratio, mix_ratio_end)) {
 			FormatError(output_domain,
 				    "Cannot cross-fade format %s",
-				    sample_format_to_string(ao->in_audio_format.format));
+				    sample_format_to_string(f.in_audio_format.format));
 			return nullptr;
 		}
 
@@ -444,19 +521,65 @@ ao_filter_chunk(AudioOutput *ao, const MusicChunk *chunk)
 	/* apply filter chain */
 
 	Error error;
-	data = ao->filter->FilterPCM(data, error);
+	data = f.filter->FilterPCM(data, error);
 	if (data.IsNull()) {
 		FormatError(error, "\"%s\" [%s] failed to filter",
-			    ao->name, ao->plugin.name);
+			    ao.name, ao.plugin.name);
 		return nullptr;
 	}
 
 	return data;
 }
 
-inline bool
-AudioOutput::PlayChunk(const MusicChunk *chunk)
+ConstBuffer<void>
+SharedFilter::FilterChunk(const AudioOutput &ao, const MusicPipe &mp,
+			  MusicPipe::Position position)
 {
+	const ScopeLock protect(mutex);
+
+	assert(n_bound > 0);
+
+	if (&mp != pipe) {
+		/* a new pipe (or a new session): the cached results
+		   are stale */
+		if (n_slots != mp.GetCapacity()) {
+			delete[] slots;
+			n_slots = mp.GetCapacity();
+			slots = new Slot[n_slots];
+		} else
+			for (unsigned i = 0; i < n_slots; ++i)
+				slots[i].position = ~MusicPipe::Position(0);
+
+		pipe = &mp;
+	}
+
+	Slot &slot = slots[position % n_slots];
+	if (slot.position == position)
+		/* another output has already filtered this chunk */
+		return slot.data;
+
+	/* the filters reuse their buffers in the next call, but the
+	   other outputs will need this result later */
+
+	const auto data = ao_filter_chunk(ao, *this, mp.Get(position));
+	if (data.IsNull())
+		return nullptr;
+
+	void *dest = slot.buffer.Get(data.size);
+	memcpy(dest, data.data, data.size);
+
+	slot.position = position;
+	slot.data = { dest, data.size };
+	return slot.data;
+}
+
+inline ConstBuffer<void>
+AudioOutput::FilterChunk(MusicPipe::Position position)
+{
+	const ScopeTrace trace("output.Filter");
+
+	const MusicChunk *chunk = pipe->Get(position);
+
 	assert(filter != nullptr);
 
 	if (tags && gcc_unlikely(chunk->tag != nullptr)) {
@@ -465,16 +588,23 @@ AudioOutput::PlayChunk(const MusicChunk *chunk)
 		mutex.lock();
 	}
 
-	auto data = ConstBuffer<char>::FromVoid(ao_filter_chunk(this, chunk));
+	auto data = shared_filter_bound
+		? shared_filter->FilterChunk(*this, *pipe, position)
+		: ao_filter_chunk(*this, *this, chunk);
 	if (data.IsNull()) {
 		Close(false);
 
 		/* don't automatically reopen this device for 10
 		   seconds */
 		fail_timer.Update();
-		return false;
 	}
 
+	return data;
+}
+
+inline bool
+AudioOutput::PlayData(ConstBuffer<char> data)
+{
 	Error error;
 
 	while (!data.IsEmpty() && command == Command::NONE) {
@@ -482,8 +612,13 @@ AudioOutput::PlayChunk(const MusicChunk *chunk)
 			break;
 
 		mutex.unlock();
+		const uint64_t start = MonotonicClockUS();
 		size_t nbytes = ao_plugin_play(this, data.data, data.size,
 					       error);
+		const uint64_t duration = MonotonicClockUS() - start;
+		play_duration.Add(duration);
+		if (gcc_unlikely(trace_enabled))
+			trace_record("output.Play", start, duration);
 		mutex.lock();
 		if (nbytes == 0) {
 			/* play()==0 means failure */
@@ -503,6 +638,8 @@ AudioOutput::PlayChunk(const MusicChunk *chunk)
 		assert(nbytes <= data.size);
 		assert(nbytes % out_audio_format.GetFrameSize() == 0);
 
+		bytes_played.fetch_add(nbytes, std::memory_order_relaxed);
+
 		data.data += nbytes;
 		data.size -= nbytes;
 	}
@@ -510,14 +647,136 @@ AudioOutput::PlayChunk(const MusicChunk *chunk)
 	return true;
 }
 
-inline const MusicChunk *
-AudioOutput::GetNextChunk() const
+void
+AudioOutput::SampleLatency()
+{
+	mutex.unlock();
+	const unsigned l = ao_plugin_latency(this);
+	mutex.lock();
+
+	latency_clock.store(MonotonicClockUS(), std::memory_order_relaxed);
+	latency.store(l, std::memory_order_relaxed);
+}
+
+void
+AudioOutput::ResetLatency()
 {
-	return current_chunk != nullptr
-		/* continue the previous play() call */
-		? current_chunk->next
-		/* get the first chunk from the pipe */
-		: pipe->Peek();
+	latency.store(0, std::memory_order_relaxed);
+	played_time.store(UNKNOWN_TIME, std::memory_order_relaxed);
+}
+
+inline void
+AudioOutput::UpdatePlayedTime(const MusicChunk &chunk)
+{
+	int64_t t = UNKNOWN_TIME;
+	if (!chunk.time.IsNegative()) {
+		const uint64_t byte_rate = in_audio_format.sample_rate *
+			in_audio_format.GetFrameSize();
+		t = int64_t(chunk.time.ToMS()) * 1000 +
+			int64_t(uint64_t(chunk.length) * 1000000 / byte_rate);
+	}
+
+	played_time.store(t, std::memory_order_relaxed);
+	SampleLatency();
+}
+
+/**
+ * Don't bother to align outputs which are less than this apart [us].
+ */
+static constexpr int64_t ALIGN_TOLERANCE_US = 5000;
+
+/**
+ * A larger offset is not a real offset, but means the outputs are
+ * playing different songs (or one has just seeked) [us].
+ */
+static constexpr int64_t ALIGN_MAX_OFFSET_US = 10000000;
+
+/**
+ * Pad at most this much silence at a time, to be able to react to
+ * commands [us].
+ */
+static constexpr int64_t ALIGN_MAX_STEP_US = 100000;
+
+inline bool
+AudioOutput::Align()
+{
+	const int64_t reference =
+		align_reference.load(std::memory_order_relaxed);
+	const int64_t heard = GetHeardTime();
+	if (reference == UNKNOWN_TIME || heard == UNKNOWN_TIME)
+		return true;
+
+	const int64_t offset = heard - int64_t(MonotonicClockUS()) - reference;
+	if (offset < ALIGN_TOLERANCE_US || offset > ALIGN_MAX_OFFSET_US)
+		return true;
+
+	if (out_audio_format.format == SampleFormat::DSD)
+		/* DSD silence is not all-zero; don't bother */
+		return true;
+
+	const size_t n_frames = uint64_t(std::min(offset, ALIGN_MAX_STEP_US))
+		* out_audio_format.sample_rate / 1000000;
+	if (n_frames == 0)
+		return true;
+
+	FormatDebug(output_domain,
+		    "padding \"%s\" [%s] with %u ms of silence",
+		    name, plugin.name,
+		    unsigned(n_frames * 1000 / out_audio_format.sample_rate));
+
+	/* all-zero is silence for all non-DSD sample formats */
+	play_batch.assign(n_frames * out_audio_format.GetFrameSize(), 0);
+	if (!PlayData({play_batch.data(), play_batch.size()}))
+		return false;
+
+	SampleLatency();
+	return true;
+}
+
+inline bool
+AudioOutput::PlayChunk(MusicPipe::Position position)
+{
+	const auto data = FilterChunk(position);
+	if (data.IsNull() || !PlayData(ConstBuffer<char>::FromVoid(data)))
+		return false;
+
+	UpdatePlayedTime(*pipe->Get(position));
+	return true;
+}
+
+inline unsigned
+AudioOutput::PlayBatch(MusicPipe::Position position)
+{
+	assert(play_batch_size > 0);
+
+	const MusicPipe &mp = *pipe;
+	const MusicPipe::Position tail = mp.GetTail();
+
+	play_batch.clear();
+
+	MusicPipe::Position end = position;
+	do {
+		if (end != position && tags && mp.Get(end)->tag != nullptr)
+			/* the tag must be sent right before the chunk
+			   it belongs to; start a new batch */
+			break;
+
+		/* the filters reuse their buffers in the next call,
+		   so the result needs to be copied */
+		const auto data = ConstBuffer<char>::FromVoid(FilterChunk(end));
+		if (data.IsNull())
+			return 0;
+
+		play_batch.insert(play_batch.end(), data.begin(), data.end());
+		++end;
+	} while (end != tail && play_batch.size() < play_batch_size &&
+		 command == Command::NONE);
+
+	if (!PlayData({play_batch.data(), play_batch.size()}))
+		return 0;
+
+	UpdatePlayedTime(*mp.Get(end - 1));
+	return end - position;
 }
 
 inline bool
@@ -525,35 +784,44 @@ AudioOutput::Play()
 {
 	assert(pipe != nullptr);
 
-	const MusicChunk *chunk = GetNextChunk();
-	if (chunk == nullptr)
+	const MusicPipe &mp = *pipe;
+
+	/* the pipe may have been cleared since the last call */
+	MusicPipe::Position position =
+		std::max(pipe_position.load(std::memory_order_relaxed),
+			 mp.GetHead());
+	assert(position != INACTIVE_POSITION);
+
+	if (position == mp.GetTail())
 		/* no chunk available */
 		return false;
 
-	current_chunk_finished = false;
-
 	assert(!in_playback_loop);
 	in_playback_loop = true;
 
-	while (chunk != nullptr && command == Command::NONE) {
-		assert(!current_chunk_finished);
-
-		current_chunk = chunk;
+	do {
+		if (align && !Align())
+			break;
 
-		if (!PlayChunk(chunk)) {
-			assert(current_chunk == nullptr);
+		const unsigned n = play_batch_size > 0
+			? PlayBatch(position)
+			: unsigned(PlayChunk(position));
+		if (n == 0) {
+			assert(pipe_position == INACTIVE_POSITION);
 			break;
 		}
 
-		assert(current_chunk == chunk);
-		chunk = chunk->next;
-	}
+		/* publish the new position; this allows the player
+		   thread to return the chunks to the buffer */
+		position += n;
+		pipe_position.store(position, std::memory_order_release);
+		pipe_lag.store(mp.GetTail() - position,
+			       std::memory_order_relaxed);
+	} while (position != mp.GetTail() && command == Command::NONE);
 
 	assert(in_playback_loop);
 	in_playback_loop = false;
 
-	current_chunk_finished = true;
-
 	mutex.unlock();
 	player_control->LockSignal();
 	mutex.lock();
@@ -567,6 +835,7 @@ AudioOutput::Pause()
 	mutex.unlock();
 	ao_plugin_cancel(this);
 	mutex.lock();
+	ResetLatency();
 
 	pause = true;
 	CommandFinished();
@@ -594,7 +863,8 @@ AudioOutput::Task()
 	FormatThreadName("output:%s", name);
 
 	Error error;
-	if(!SetThreadRealtime(error)) {
+	if (!ApplyThreadSettings(("output:" + std::string(name)).c_str()) &&
+	    !SetThreadRealtime(error)) {
 		LogError(error);
 		LogWarning(output_domain,
 			"OutputThread could not get realtime scheduling, continuing anyway");
@@ -655,31 +925,33 @@ AudioOutput::Task()
 
 		case Command::DRAIN:
 			if (open) {
-				assert(current_chunk == nullptr);
-				assert(pipe->Peek() == nullptr);
+				assert(pipe->IsEmpty());
 
 				mutex.unlock();
 				ao_plugin_drain(this);
 				mutex.lock();
+				ResetLatency();
 			}
 
 			CommandFinished();
 			continue;
 
 		case Command::CANCEL:
-			current_chunk = nullptr;
+			/* the player clears the pipe after this
+			   command has finished; Play() will then skip
+			   to the new head */
 
 			if (open) {
 				mutex.unlock();
 				ao_plugin_cancel(this);
 				mutex.lock();
+				ResetLatency();
 			}
 
 			CommandFinished();
 			continue;
 
 		case Command::KILL:
-			current_chunk = nullptr;
 			CommandFinished();
 			mutex.unlock();
 			return;
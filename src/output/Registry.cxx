@@ -33,6 +33,7 @@
 #include "plugins/PipeOutputPlugin.hxx"
 #include "plugins/PulseOutputPlugin.hxx"
 #include "plugins/RecorderOutputPlugin.hxx"
+#include "plugins/HlsOutputPlugin.hxx"
 #include "plugins/RoarOutputPlugin.hxx"
 #include "plugins/ShoutOutputPlugin.hxx"
 #include "plugins/sles/SlesOutputPlugin.hxx"
@@ -91,6 +92,9 @@ const AudioOutputPlugin *const audio_output_plugins[] = {
 #ifdef ENABLE_RECORDER_OUTPUT
 	&recorder_output_plugin,
 #endif
+#ifdef ENABLE_HLS_OUTPUT
+	&hls_output_plugin,
+#endif
 #ifdef ENABLE_WINMM_OUTPUT
 	&winmm_output_plugin,
 #endif
@@ -0,0 +1,186 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "SharedFilter.hxx"
+#include "filter/FilterConfig.hxx"
+#include "filter/FilterPlugin.hxx"
+#include "filter/FilterInternal.hxx"
+#include "filter/FilterRegistry.hxx"
+#include "filter/plugins/AutoConvertFilterPlugin.hxx"
+#include "filter/plugins/ChainFilterPlugin.hxx"
+#include "filter/plugins/ConvertFilterPlugin.hxx"
+#include "filter/plugins/ReplayGainFilterPlugin.hxx"
+#include "config/Block.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <assert.h>
+
+SharedFilter::SharedFilter(const std::string &_key,
+			   const char *filters, bool replay_gain)
+	:key(_key), n_bound(0),
+	 replay_gain_filter(nullptr), replay_gain_serial(0),
+	 other_replay_gain_filter(nullptr), other_replay_gain_serial(0),
+	 volume_filter(nullptr),
+	 pipe(nullptr), slots(nullptr), n_slots(0)
+{
+	/* this must be the same setup as in Init.cxx; the software
+	   mixer and the "mixer" replay gain handler are output
+	   specific, and outputs using them are never shared */
+
+	if (replay_gain) {
+		replay_gain_filter = filter_new(&replay_gain_filter_plugin,
+						ConfigBlock(), IgnoreError());
+		assert(replay_gain_filter != nullptr);
+
+		other_replay_gain_filter =
+			filter_new(&replay_gain_filter_plugin,
+				   ConfigBlock(), IgnoreError());
+		assert(other_replay_gain_filter != nullptr);
+	}
+
+	filter = filter_chain_new();
+	assert(filter != nullptr);
+
+	if (config_get_bool(ConfigOption::VOLUME_NORMALIZATION, false)) {
+		Filter *normalize_filter =
+			filter_new(&normalize_filter_plugin, ConfigBlock(),
+				   IgnoreError());
+		assert(normalize_filter != nullptr);
+
+		filter_chain_append(*filter, "normalize",
+				    autoconvert_filter_new(normalize_filter));
+	}
+
+	/* errors have already been logged by the outputs */
+	filter_chain_parse(*filter, filters, IgnoreError());
+
+	convert_filter = filter_new(&convert_filter_plugin, ConfigBlock(),
+				    IgnoreError());
+	assert(convert_filter != nullptr);
+
+	filter_chain_append(*filter, "convert", convert_filter);
+}
+
+SharedFilter::~SharedFilter()
+{
+	assert(n_bound == 0);
+
+	delete[] slots;
+	delete replay_gain_filter;
+	delete other_replay_gain_filter;
+	delete filter;
+}
+
+void
+SharedFilter::SetReplayGainMode(ReplayGainMode mode)
+{
+	const ScopeLock protect(mutex);
+
+	if (replay_gain_filter != nullptr)
+		replay_gain_filter_set_mode(replay_gain_filter, mode);
+	if (other_replay_gain_filter != nullptr)
+		replay_gain_filter_set_mode(other_replay_gain_filter, mode);
+}
+
+inline bool
+SharedFilter::OpenFilter(Error &error)
+{
+	AudioFormat format = in_audio_format;
+
+	if (replay_gain_filter != nullptr &&
+	    !replay_gain_filter->Open(format, error).IsDefined())
+		return false;
+
+	if (other_replay_gain_filter != nullptr &&
+	    !other_replay_gain_filter->Open(format, error).IsDefined()) {
+		if (replay_gain_filter != nullptr)
+			replay_gain_filter->Close();
+		return false;
+	}
+
+	if (!filter->Open(format, error).IsDefined()) {
+		if (replay_gain_filter != nullptr)
+			replay_gain_filter->Close();
+		if (other_replay_gain_filter != nullptr)
+			other_replay_gain_filter->Close();
+		return false;
+	}
+
+	if (!convert_filter_set(convert_filter, out_audio_format, error)) {
+		CloseFilter();
+		return false;
+	}
+
+	return true;
+}
+
+inline void
+SharedFilter::CloseFilter()
+{
+	if (replay_gain_filter != nullptr)
+		replay_gain_filter->Close();
+	if (other_replay_gain_filter != nullptr)
+		other_replay_gain_filter->Close();
+
+	filter->Close();
+}
+
+bool
+SharedFilter::Bind(AudioFormat in, AudioFormat out)
+{
+	const ScopeLock protect(mutex);
+
+	if (n_bound > 0) {
+		if (in != in_audio_format || out != out_audio_format)
+			return false;
+
+		++n_bound;
+		return true;
+	}
+
+	in_audio_format = in;
+	out_audio_format = out;
+
+	Error error;
+	if (!OpenFilter(error)) {
+		LogError(error);
+		return false;
+	}
+
+	/* forget results from an earlier session */
+	pipe = nullptr;
+
+	++n_bound;
+	return true;
+}
+
+void
+SharedFilter::Unbind()
+{
+	const ScopeLock protect(mutex);
+
+	assert(n_bound > 0);
+
+	if (--n_bound == 0)
+		CloseFilter();
+}
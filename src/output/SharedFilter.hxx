@@ -0,0 +1,175 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_OUTPUT_SHARED_FILTER_HXX
+#define MPD_OUTPUT_SHARED_FILTER_HXX
+
+#include "AudioFormat.hxx"
+#include "MusicPipe.hxx"
+#include "ReplayGainInfo.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "pcm/PcmDither.hxx"
+#include "thread/Mutex.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <string>
+
+class Error;
+class Filter;
+struct AudioOutput;
+
+/**
+ * A filter chain shared by several #AudioOutput instances which have
+ * identical filter settings (see audio_output_shared_filter_key()).
+ * The first output which plays a chunk runs it through this chain,
+ * and the others reuse the result.  The chain sees each chunk
+ * exactly once, in pipe order, so stateful filters (e.g. the
+ * resampler) behave just like in a private chain.
+ *
+ * An output "binds" to this object after it has been opened; this
+ * only succeeds if its audio formats match those of the outputs which
+ * are already bound.  Unbound outputs use their own filters.
+ */
+struct SharedFilter {
+	/**
+	 * The value returned by audio_output_shared_filter_key() for
+	 * all member outputs.
+	 */
+	const std::string key;
+
+	/**
+	 * Protects all attributes below.  The output thread holds
+	 * its own AudioOutput::mutex while locking this one.
+	 */
+	Mutex mutex;
+
+	/**
+	 * The input and output format of the filter chain; only
+	 * valid while #n_bound is non-zero.
+	 */
+	AudioFormat in_audio_format, out_audio_format;
+
+	/**
+	 * The number of outputs which are currently bound.  The
+	 * filters are open while this is non-zero.
+	 */
+	unsigned n_bound;
+
+	/**
+	 * These attributes have the same meaning as the ones in
+	 * #AudioOutput.
+	 */
+	PcmBuffer cross_fade_buffer;
+	PcmDither cross_fade_dither;
+	Filter *filter;
+	Filter *replay_gain_filter;
+	unsigned replay_gain_serial;
+	Filter *other_replay_gain_filter;
+	unsigned other_replay_gain_serial;
+	Filter *convert_filter;
+
+	/**
+	 * Always nullptr: outputs with a software mixer are never
+	 * shared.
+	 */
+	Filter *const volume_filter;
+
+	/**
+	 * The pipe the cached results belong to.
+	 */
+	const MusicPipe *pipe;
+
+	/**
+	 * A filtered chunk.  All chunks which are still referenced by
+	 * at least one output are inside one pipe capacity, so
+	 * positions modulo the capacity do not collide.
+	 */
+	struct Slot {
+		MusicPipe::Position position;
+		PcmBuffer buffer;
+		ConstBuffer<void> data;
+
+		Slot():position(~MusicPipe::Position(0)), data(nullptr) {}
+	};
+
+	/**
+	 * An array of MusicPipe::GetCapacity() slots, allocated
+	 * when the first chunk of a #pipe is filtered.
+	 */
+	Slot *slots;
+	unsigned n_slots;
+
+	/**
+	 * @param filters the "filters" setting of the outputs
+	 * @param replay_gain create replay gain filters?
+	 */
+	SharedFilter(const std::string &_key,
+		     const char *filters, bool replay_gain);
+	~SharedFilter();
+
+	SharedFilter(const SharedFilter &) = delete;
+	SharedFilter &operator=(const SharedFilter &) = delete;
+
+	void SetReplayGainMode(ReplayGainMode mode);
+
+	/**
+	 * Attempt to bind an output which has been opened with the
+	 * specified formats.
+	 *
+	 * @return true if the output shall use this object for
+	 * filtering
+	 */
+	bool Bind(AudioFormat in, AudioFormat out);
+
+	/**
+	 * Undo a successful Bind() call.
+	 */
+	void Unbind();
+
+	/**
+	 * Forget all cached results.  Must be called after the
+	 * #MusicPipe has been destroyed, because a new one may be
+	 * allocated at the same address.
+	 */
+	void Reset() {
+		const ScopeLock protect(mutex);
+		pipe = nullptr;
+	}
+
+	/**
+	 * Obtain the filtered data of the chunk at the specified pipe
+	 * position, either from the cache or by running it through
+	 * the filters.  The returned buffer remains valid until the
+	 * chunk has been returned to the #MusicBuffer.
+	 *
+	 * Implemented in OutputThread.cxx.
+	 *
+	 * @param ao the calling output, used for log messages
+	 * @return the filtered data, nullptr on error
+	 */
+	ConstBuffer<void> FilterChunk(const AudioOutput &ao,
+				      const MusicPipe &mp,
+				      MusicPipe::Position position);
+
+private:
+	bool OpenFilter(Error &error);
+	void CloseFilter();
+};
+
+#endif
@@ -25,38 +25,65 @@
 #include <limits>
 
 #include <assert.h>
+#include <errno.h>
+#include <time.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+/**
+ * SleepRemainder() never sleeps longer than this [ns]; the output
+ * thread waits for everything beyond that in a way that can be
+ * interrupted by commands.
+ */
+static constexpr uint64_t MAX_REMAINDER_NS = 5000000;
 
 Timer::Timer(const AudioFormat af)
-	: time(0),
-	  started(false),
+	:start_time(0), seconds(0), remainder(0),
+	 started(false),
 	 rate(af.sample_rate * af.GetFrameSize())
 {
 }
 
 void Timer::Start()
 {
-	time = MonotonicClockUS();
+	start_time = MonotonicClockNS();
+	seconds = remainder = 0;
 	started = true;
 }
 
 void Timer::Reset()
 {
-	time = 0;
+	start_time = 0;
+	seconds = remainder = 0;
 	started = false;
 }
 
 void Timer::Add(int size)
 {
 	assert(started);
+	assert(size >= 0);
+
+	remainder += size;
+	seconds += remainder / rate;
+	remainder %= rate;
+}
 
-	// (size samples) / (rate samples per second) = duration seconds
-	// duration seconds * 1000000 = duration us
-	time += ((uint64_t)size * 1000000) / rate;
+inline uint64_t
+Timer::GetDeadline() const
+{
+	// (size bytes) / (rate bytes per second) = duration seconds
+	return start_time + seconds * 1000000000 +
+		remainder * 1000000000 / rate;
 }
 
 unsigned Timer::GetDelay() const
 {
-	int64_t delay = (int64_t)(time - MonotonicClockUS()) / 1000;
+	int64_t delay = (int64_t)(GetDeadline() - MonotonicClockNS())
+		/ 1000000;
 	if (delay < 0)
 		return 0;
 
@@ -65,3 +92,43 @@ unsigned Timer::GetDelay() const
 
 	return delay;
 }
+
+unsigned Timer::GetLatency() const
+{
+	if (!started)
+		return 0;
+
+	const uint64_t deadline = GetDeadline();
+	const uint64_t now = MonotonicClockNS();
+	if (deadline <= now)
+		return 0;
+
+	const uint64_t latency = (deadline - now) / 1000;
+	return latency < std::numeric_limits<unsigned>::max()
+		? unsigned(latency)
+		: std::numeric_limits<unsigned>::max();
+}
+
+void Timer::SleepRemainder() const
+{
+	if (!started)
+		return;
+
+	const uint64_t deadline = GetDeadline();
+	const uint64_t now = MonotonicClockNS();
+	if (deadline <= now || deadline - now > MAX_REMAINDER_NS)
+		return;
+
+#if !defined(WIN32) && !defined(__APPLE__) && defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	ts.tv_sec = deadline / 1000000000;
+	ts.tv_nsec = deadline % 1000000000;
+
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+			       &ts, nullptr) == EINTR) {}
+#elif defined(WIN32)
+	Sleep((deadline - now) / 1000000);
+#else
+	usleep((deadline - now) / 1000);
+#endif
+}
@@ -20,14 +20,35 @@
 #ifndef MPD_TIMER_HXX
 #define MPD_TIMER_HXX
 
+#include "Compiler.h"
+
 #include <stdint.h>
 
 struct AudioFormat;
 
+/**
+ * Paces an output which has no hardware clock (e.g. a network
+ * stream) to the nominal playback rate.
+ *
+ * All times are measured in nanoseconds from a monotonic clock, and
+ * the deadline is calculated from the total number of bytes since
+ * Start(), so rounding errors do not accumulate over long streams.
+ */
 class Timer {
-	uint64_t time;
+	/**
+	 * The monotonic clock value of Start() [ns].
+	 */
+	uint64_t start_time;
+
+	/**
+	 * The number of bytes passed to Add() since Start(), split
+	 * into whole seconds and a remainder (always smaller than
+	 * #rate) to avoid overflow.
+	 */
+	uint64_t seconds, remainder;
+
 	bool started;
-	const int rate;
+	const unsigned rate;
 public:
 	explicit Timer(AudioFormat af);
 
@@ -39,9 +60,37 @@ public:
 	void Add(int size);
 
 	/**
-	 * Returns the number of milliseconds to sleep to get back to sync.
+	 * Returns the number of milliseconds to sleep to get back to
+	 * sync.  The fraction of a millisecond is not included; it is
+	 * left to SleepRemainder().
 	 */
+	gcc_pure
 	unsigned GetDelay() const;
+
+	/**
+	 * Sleep until the deadline of all data passed to Add(), with
+	 * nanosecond precision (clock_nanosleep() with an absolute
+	 * deadline where available).  This is meant to be called by
+	 * the output's play() method to cover the sub-millisecond rest
+	 * of GetDelay(); it does not sleep longer than a few
+	 * milliseconds, so it does not block commands.
+	 */
+	void SleepRemainder() const;
+
+	/**
+	 * Returns how much of the data passed to Add() has not been
+	 * "played" yet according to the nominal rate [us].
+	 */
+	gcc_pure
+	unsigned GetLatency() const;
+
+private:
+	/**
+	 * Returns the monotonic clock value at which all data passed
+	 * to Add() will have been played [ns].
+	 */
+	gcc_pure
+	uint64_t GetDeadline() const;
 };
 
 #endif
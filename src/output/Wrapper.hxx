@@ -96,6 +96,12 @@ struct AudioOutputWrapper {
 		T &t = Cast(*ao);
 		return t.Pause();
 	}
+
+	gcc_pure
+	static unsigned Latency(AudioOutput *ao) {
+		T &t = Cast(*ao);
+		return t.Latency();
+	}
 };
 
 #endif
@@ -33,6 +33,7 @@
 
 #include <alsa/asoundlib.h>
 
+#include <algorithm>
 #include <string>
 
 #if SND_LIB_VERSION >= 0x1001c
@@ -51,6 +52,18 @@ static constexpr unsigned MPD_ALSA_BUFFER_TIME_US = 500000;
 
 static constexpr unsigned MPD_ALSA_RETRY_NR = 5;
 
+/**
+ * The buffer time (in microseconds) the "auto_buffer" mode starts
+ * with, and the lower limit when shrinking the buffer.
+ */
+static constexpr unsigned MPD_ALSA_AUTO_BUFFER_TIME_MIN_US = 40000;
+
+/**
+ * The "auto_buffer" mode shrinks the buffer only after playing this
+ * many seconds without getting close to an underrun.
+ */
+static constexpr unsigned MPD_ALSA_AUTO_SHRINK_S = 60;
+
 struct AlsaOutput {
 	AudioOutput base;
 
@@ -77,9 +90,35 @@ struct AlsaOutput {
 	/** libasound's period_time setting (in microseconds) */
 	unsigned int period_time;
 
+	/**
+	 * Choose the buffer and period time automatically, depending
+	 * on the underruns and the scheduling jitter observed while
+	 * playing?  #buffer_time is the upper limit then.
+	 */
+	bool auto_buffer;
+
+	/**
+	 * The buffer time (in microseconds) chosen by the
+	 * "auto_buffer" mode for the next Open() call.
+	 */
+	unsigned auto_buffer_time;
+
 	/** the mode flags passed to snd_pcm_open */
 	int mode;
 
+	/**
+	 * Was mmap access configured?  Then MPD exports the samples
+	 * straight into the device's ring buffer, saving one copy.
+	 */
+	bool mmap;
+
+	/**
+	 * Is the device currently opened with mmap access?  This is
+	 * false if #mmap is not set or if the device doesn't support
+	 * it.
+	 */
+	bool use_mmap;
+
 	/** the libasound PCM device handle */
 	snd_pcm_t *pcm;
 
@@ -103,6 +142,26 @@ struct AlsaOutput {
 	 */
 	snd_pcm_uframes_t period_position;
 
+	/**
+	 * The size of the device buffer, in number of frames.
+	 */
+	snd_pcm_uframes_t buffer_frames;
+
+	/**
+	 * The sample rate of the device.
+	 */
+	unsigned device_rate;
+
+	/**
+	 * The following attributes describe the current session (since
+	 * Open()), evaluated by AutoTune() in Close(): the lowest
+	 * number of frames queued in the device before a write, the
+	 * number of underruns and the number of frames played.
+	 */
+	snd_pcm_uframes_t min_headroom;
+	unsigned session_xruns;
+	uint64_t session_frames;
+
 	/**
 	 * Do we need to call snd_pcm_prepare() before the next write?
 	 * It means that we put the device to SND_PCM_STATE_SETUP by
@@ -137,6 +196,11 @@ struct AlsaOutput {
 		return device.empty() ? default_device : device.c_str();
 	}
 
+	gcc_pure
+	unsigned FramesToMicroseconds(snd_pcm_uframes_t frames) const {
+		return uint64_t(frames) * 1000000 / device_rate;
+	}
+
 	bool Configure(const ConfigBlock &block, Error &error);
 	static AlsaOutput *Create(const ConfigBlock &block, Error &error);
 
@@ -150,7 +214,25 @@ struct AlsaOutput {
 	void Drain();
 	void Cancel();
 
+	/**
+	 * Returns the number of frames queued in the device
+	 * (snd_pcm_delay()) in microseconds.
+	 */
+	gcc_pure
+	unsigned Latency() {
+		snd_pcm_sframes_t frames;
+		return snd_pcm_delay(pcm, &frames) == 0 && frames > 0
+			? FramesToMicroseconds(frames)
+			: 0;
+	}
+
 private:
+	/**
+	 * The mmap implementation of Play(): export the samples
+	 * directly into the area returned by snd_pcm_mmap_begin().
+	 */
+	size_t PlayMmap(const void *chunk, size_t size, Error &error);
+
 #ifdef ENABLE_DSD
 	bool SetupDop(AudioFormat audio_format,
 		      PcmExport::Params &params,
@@ -162,11 +244,26 @@ private:
 
 	int Recover(int err);
 
+	/**
+	 * Sample the amount of audio still queued in the device; for
+	 * the "auto_buffer" mode and the "perfstats" command.
+	 */
+	void SampleHeadroom();
+
+	/**
+	 * Evaluate the session which is about to end and choose the
+	 * buffer time for the next Open() call.
+	 */
+	void AutoTune();
+
 	/**
 	 * Write silence to the ALSA device.
 	 */
 	void WriteSilence(snd_pcm_uframes_t nframes) {
-		snd_pcm_writei(pcm, silence, nframes);
+		if (use_mmap)
+			snd_pcm_mmap_writei(pcm, silence, nframes);
+		else
+			snd_pcm_writei(pcm, silence, nframes);
 	}
 
 };
@@ -190,6 +287,17 @@ AlsaOutput::Configure(const ConfigBlock &block, Error &error)
 	buffer_time = block.GetBlockValue("buffer_time",
 					  MPD_ALSA_BUFFER_TIME_US);
 	period_time = block.GetBlockValue("period_time", 0u);
+	mmap = block.GetBlockValue("mmap", false);
+
+	auto_buffer = block.GetBlockValue("auto_buffer", false);
+	if (auto_buffer) {
+		if (buffer_time == 0)
+			buffer_time = MPD_ALSA_BUFFER_TIME_US;
+		else if (buffer_time < MPD_ALSA_AUTO_BUFFER_TIME_MIN_US)
+			buffer_time = MPD_ALSA_AUTO_BUFFER_TIME_MIN_US;
+
+		auto_buffer_time = MPD_ALSA_AUTO_BUFFER_TIME_MIN_US;
+	}
 
 #ifdef SND_PCM_NO_AUTO_RESAMPLE
 	if (!block.GetBlockValue("auto_resample", true))
@@ -498,7 +606,15 @@ AlsaSetup(AlsaOutput *ad, AudioFormat &audio_format,
 	unsigned int period_time, period_time_ro;
 	unsigned int buffer_time;
 
-	period_time_ro = period_time = ad->period_time;
+	const unsigned wanted_buffer_time = ad->auto_buffer
+		? ad->auto_buffer_time
+		: ad->buffer_time;
+
+	/* in "auto_buffer" mode, the period time is derived from the
+	   buffer time below */
+	period_time_ro = period_time = ad->auto_buffer
+		? 0
+		: ad->period_time;
 configure_hw:
 	/* configure HW params */
 	snd_pcm_hw_params_t *hwparams;
@@ -508,11 +624,21 @@ configure_hw:
 	if (err < 0)
 		goto error;
 
-	cmd = "snd_pcm_hw_params_set_access";
-	err = snd_pcm_hw_params_set_access(ad->pcm, hwparams,
-					   SND_PCM_ACCESS_RW_INTERLEAVED);
-	if (err < 0)
-		goto error;
+	ad->use_mmap = ad->mmap &&
+		snd_pcm_hw_params_set_access(ad->pcm, hwparams,
+					     SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0;
+	if (ad->mmap && !ad->use_mmap)
+		FormatWarning(alsa_output_domain,
+			      "ALSA device \"%s\" does not support mmap access",
+			      ad->GetDevice());
+
+	if (!ad->use_mmap) {
+		cmd = "snd_pcm_hw_params_set_access";
+		err = snd_pcm_hw_params_set_access(ad->pcm, hwparams,
+						   SND_PCM_ACCESS_RW_INTERLEAVED);
+		if (err < 0)
+			goto error;
+	}
 
 	err = AlsaSetupFormat(ad->pcm, hwparams, audio_format, params);
 	if (err < 0) {
@@ -571,8 +697,8 @@ configure_hw:
 		    (unsigned)period_size_min, (unsigned)period_size_max,
 		    period_time_min, period_time_max);
 
-	if (ad->buffer_time > 0) {
-		buffer_time = ad->buffer_time;
+	if (wanted_buffer_time > 0) {
+		buffer_time = wanted_buffer_time;
 		cmd = "snd_pcm_hw_params_set_buffer_time_near";
 		err = snd_pcm_hw_params_set_buffer_time_near(ad->pcm, hwparams,
 							     &buffer_time, nullptr);
@@ -667,6 +793,17 @@ configure_hw:
 	ad->period_frames = alsa_period_size;
 	ad->period_position = 0;
 
+	ad->buffer_frames = alsa_buffer_size;
+	ad->device_rate = sample_rate;
+	ad->min_headroom = alsa_buffer_size;
+	ad->session_xruns = 0;
+	ad->session_frames = 0;
+
+	ad->base.device_buffer_time =
+		ad->FramesToMicroseconds(alsa_buffer_size);
+	ad->base.device_period_time =
+		ad->FramesToMicroseconds(alsa_period_size);
+
 	ad->silence = new uint8_t[snd_pcm_frames_to_bytes(ad->pcm,
 							  alsa_period_size)];
 	snd_pcm_format_set_silence(format, ad->silence,
@@ -783,6 +920,11 @@ AlsaOutput::Open(AudioFormat &audio_format, Error &error)
 	in_frame_size = audio_format.GetFrameSize();
 	out_frame_size = pcm_export->GetFrameSize(audio_format);
 
+	/* let the output thread submit one period per Play() call,
+	   instead of one chunk */
+	base.play_batch_size =
+		pcm_export->CalcSourceSize(period_frames * out_frame_size);
+
 	must_prepare = false;
 
 	return true;
@@ -795,6 +937,9 @@ AlsaOutput::Recover(int err)
 		FormatDebug(alsa_output_domain,
 			    "Underrun on ALSA device \"%s\"",
 			    GetDevice());
+
+		++session_xruns;
+		++base.device_xruns;
 	} else if (err == -ESTRPIPE) {
 		FormatDebug(alsa_output_domain,
 			    "ALSA device \"%s\" was suspended",
@@ -857,9 +1002,62 @@ AlsaOutput::Cancel()
 	snd_pcm_drop(pcm);
 }
 
+inline void
+AlsaOutput::SampleHeadroom()
+{
+	if (snd_pcm_state(pcm) != SND_PCM_STATE_RUNNING)
+		return;
+
+	const snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm);
+	if (avail < 0)
+		return;
+
+	const snd_pcm_uframes_t headroom =
+		snd_pcm_uframes_t(avail) < buffer_frames
+		? buffer_frames - avail
+		: 0;
+
+	if (headroom < min_headroom)
+		min_headroom = headroom;
+
+	base.device_headroom.Add(FramesToMicroseconds(headroom));
+}
+
+inline void
+AlsaOutput::AutoTune()
+{
+	if (!auto_buffer)
+		return;
+
+	const unsigned old_buffer_time = auto_buffer_time;
+
+	if (session_xruns > 0 || min_headroom < period_frames) {
+		/* we came too close to an underrun (or had one):
+		   double the buffer */
+		auto_buffer_time = std::min(auto_buffer_time * 2,
+					    buffer_time);
+	} else if (session_frames >= uint64_t(device_rate) * MPD_ALSA_AUTO_SHRINK_S &&
+		   min_headroom >= buffer_frames / 2) {
+		/* half of the buffer was never used; shrink it
+		   carefully */
+		auto_buffer_time = std::max(auto_buffer_time * 3 / 4,
+					    MPD_ALSA_AUTO_BUFFER_TIME_MIN_US);
+	}
+
+	if (auto_buffer_time != old_buffer_time)
+		FormatInfo(alsa_output_domain,
+			   "ALSA device \"%s\": xruns=%u min_headroom=%uus; "
+			   "changing buffer_time from %uus to %uus",
+			   GetDevice(), session_xruns,
+			   FramesToMicroseconds(min_headroom),
+			   old_buffer_time, auto_buffer_time);
+}
+
 inline void
 AlsaOutput::Close()
 {
+	AutoTune();
+
 	snd_pcm_close(pcm);
 	delete[] silence;
 }
@@ -880,6 +1078,12 @@ AlsaOutput::Play(const void *chunk, size_t size, Error &error)
 		}
 	}
 
+	if (auto_buffer)
+		SampleHeadroom();
+
+	if (use_mmap)
+		return PlayMmap(chunk, size, error);
+
 	const auto e = pcm_export->Export({chunk, size});
 	if (e.size == 0)
 		/* the DoP (DSD over PCM) filter converts two frames
@@ -903,6 +1107,7 @@ AlsaOutput::Play(const void *chunk, size_t size, Error &error)
 		if (ret > 0) {
 			period_position = (period_position + ret)
 				% period_frames;
+			session_frames += ret;
 
 			size_t bytes_written = ret * out_frame_size;
 			return pcm_export->CalcSourceSize(bytes_written);
@@ -916,6 +1121,94 @@ AlsaOutput::Play(const void *chunk, size_t size, Error &error)
 	}
 }
 
+inline size_t
+AlsaOutput::PlayMmap(const void *chunk, size_t size, Error &error)
+{
+	snd_pcm_uframes_t nframes =
+		pcm_export->CalcDestSize(size) / out_frame_size;
+	if (nframes == 0)
+		/* see Play() */
+		return size;
+
+	while (true) {
+		snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm);
+		if (avail == 0) {
+			if (snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED)
+				/* the buffer is full, but it has not
+				   yet reached the start threshold */
+				avail = snd_pcm_start(pcm);
+			else
+				avail = snd_pcm_wait(pcm, -1);
+			if (avail >= 0)
+				continue;
+		}
+
+		if (avail < 0) {
+			if (avail != -EAGAIN && avail != -EINTR &&
+			    Recover(avail) < 0) {
+				error.Set(alsa_output_domain, avail,
+					  snd_strerror(-avail));
+				return 0;
+			}
+
+			continue;
+		}
+
+		const snd_pcm_channel_area_t *areas;
+		snd_pcm_uframes_t offset;
+		snd_pcm_uframes_t frames = std::min<snd_pcm_uframes_t>(avail,
+								     nframes);
+		int err = snd_pcm_mmap_begin(pcm, &areas, &offset, &frames);
+		if (err < 0) {
+			if (Recover(err) < 0) {
+				error.Set(alsa_output_domain, err,
+					  snd_strerror(-err));
+				return 0;
+			}
+
+			continue;
+		}
+
+		/* with interleaved access, all channels share one
+		   area, and the frames are contiguous */
+		uint8_t *dest = (uint8_t *)areas[0].addr +
+			(areas[0].first + offset * areas[0].step) / 8;
+		const size_t src_size =
+			pcm_export->CalcSourceSize(frames * out_frame_size);
+		pcm_export->ExportTo(dest, {chunk, src_size});
+
+		snd_pcm_sframes_t ret =
+			snd_pcm_mmap_commit(pcm, offset, frames);
+		if (ret < 0 || snd_pcm_uframes_t(ret) != frames) {
+			if (ret >= 0)
+				ret = -EPIPE;
+
+			if (Recover(ret) < 0) {
+				error.Set(alsa_output_domain, ret,
+					  snd_strerror(-ret));
+				return 0;
+			}
+
+			continue;
+		}
+
+		period_position = (period_position + frames) % period_frames;
+		session_frames += frames;
+
+		/* mmap transfers do not trigger the start threshold
+		   by themselves; emulate it: the threshold is the
+		   buffer size minus one period */
+		if (snd_pcm_state(pcm) == SND_PCM_STATE_PREPARED) {
+			avail = snd_pcm_avail_update(pcm);
+			if (avail >= 0 &&
+			    snd_pcm_uframes_t(avail) <= period_frames)
+				snd_pcm_start(pcm);
+		}
+
+		return src_size;
+	}
+}
+
 typedef AudioOutputWrapper<AlsaOutput> Wrapper;
 
 const struct AudioOutputPlugin alsa_output_plugin = {
@@ -933,6 +1226,7 @@ const struct AudioOutputPlugin alsa_output_plugin = {
 	&Wrapper::Drain,
 	&Wrapper::Cancel,
 	nullptr,
+	&Wrapper::Latency,
 
 	&alsa_mixer_plugin,
 };
@@ -29,9 +29,11 @@
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
+#include "system/fd_util.h"
 #include "open.h"
 
 #include <sys/stat.h>
+#include <sys/ioctl.h>
 #include <errno.h>
 #include <unistd.h>
 
@@ -48,6 +50,23 @@ class FifoOutput {
 	bool created;
 	Timer *timer;
 
+	/**
+	 * The configured kernel pipe buffer size ("pipe_size"); 0
+	 * means the kernel default.
+	 */
+	unsigned pipe_size = 0;
+
+	/**
+	 * The actual kernel pipe buffer size after applying
+	 * #pipe_size, or 0 if it was not changed.
+	 */
+	size_t pipe_capacity = 0;
+
+	/**
+	 * The number of bytes per second of the current audio format.
+	 */
+	unsigned byte_rate;
+
 public:
 	FifoOutput()
 		:base(fifo_output_plugin),
@@ -59,6 +78,7 @@ public:
 	}
 
 	bool Initialize(const ConfigBlock &block, Error &error) {
+		pipe_size = block.GetBlockValue("pipe_size", 0u);
 		return base.Configure(block, error);
 	}
 
@@ -77,6 +97,7 @@ public:
 	unsigned Delay() const;
 	size_t Play(const void *chunk, size_t size, Error &error);
 	void Cancel();
+	unsigned Latency() const;
 };
 
 static constexpr Domain fifo_output_domain("fifo_output");
@@ -175,6 +196,16 @@ FifoOutput::OpenFifo(Error &error)
 		return false;
 	}
 
+	if (pipe_size > 0) {
+		int result = pipe_set_size(output, pipe_size);
+		if (result < 0)
+			FormatErrno(fifo_output_domain,
+				    "Failed to resize FIFO \"%s\"",
+				    path_utf8.c_str());
+		else
+			pipe_capacity = result;
+	}
+
 	return true;
 }
 
@@ -212,6 +243,11 @@ bool
 FifoOutput::Open(AudioFormat &audio_format, gcc_unused Error &error)
 {
 	timer = new Timer(audio_format);
+	byte_rate = audio_format.sample_rate * audio_format.GetFrameSize();
+
+	/* with a large pipe buffer, pass several chunks per write()
+	   to save system calls and reader wakeups */
+	base.play_batch_size = pipe_capacity / 4;
 	return true;
 }
 
@@ -247,17 +283,32 @@ FifoOutput::Delay() const
 		: 0;
 }
 
+inline unsigned
+FifoOutput::Latency() const
+{
+	/* the data which the reader has not consumed yet */
+	int n;
+	if (ioctl(input, FIONREAD, &n) < 0 || n <= 0)
+		return 0;
+
+	return uint64_t(n) * 1000000 / byte_rate;
+}
+
 inline size_t
 FifoOutput::Play(const void *chunk, size_t size, Error &error)
 {
-	if (!timer->IsStarted())
-		timer->Start();
-	timer->Add(size);
+	timer->SleepRemainder();
 
 	while (true) {
 		ssize_t bytes = write(output, chunk, size);
-		if (bytes > 0)
+		if (bytes > 0) {
+			/* account only what was actually written, the
+			   rest will be submitted again */
+			if (!timer->IsStarted())
+				timer->Start();
+			timer->Add(bytes);
 			return (size_t)bytes;
+		}
 
 		if (bytes < 0) {
 			switch (errno) {
@@ -293,5 +344,6 @@ const struct AudioOutputPlugin fifo_output_plugin = {
 	nullptr,
 	&Wrapper::Cancel,
 	nullptr,
+	&Wrapper::Latency,
 	nullptr,
 };
@@ -527,6 +527,7 @@ const struct AudioOutputPlugin haiku_output_plugin = {
 	nullptr,
 	nullptr,
 	nullptr,
+	nullptr,
 
 	&haiku_mixer_plugin,
 };
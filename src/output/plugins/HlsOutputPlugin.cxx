@@ -0,0 +1,552 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/** \file
+ *
+ * An output plugin which writes the encoded stream as rolling HTTP
+ * Live Streaming (HLS) segments and a playlist into a directory,
+ * from where a web server or CDN distributes them.
+ */
+
+#include "config.h"
+#include "HlsOutputPlugin.hxx"
+#include "../OutputAPI.hxx"
+#include "../Wrapper.hxx"
+#include "../Timer.hxx"
+#include "encoder/ToOutputStream.hxx"
+#include "encoder/EncoderInterface.hxx"
+#include "encoder/EncoderPlugin.hxx"
+#include "encoder/EncoderList.hxx"
+#include "encoder/SharedEncoder.hxx"
+#include "config/ConfigError.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "util/Error.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <deque>
+#include <string>
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+static constexpr Domain hls_output_domain("hls_output");
+
+/**
+ * The number of obsolete segments which are kept after they have
+ * been removed from the playlist, for clients which have loaded an
+ * older version of it.
+ */
+static constexpr unsigned HLS_KEEP_OBSOLETE = 3;
+
+class HlsOutput {
+	friend struct AudioOutputWrapper<HlsOutput>;
+
+	AudioOutput base;
+
+	/**
+	 * The configured encoder plugin.
+	 */
+	PreparedEncoder *prepared_encoder = nullptr;
+	Encoder *encoder;
+
+	/**
+	 * The directory where the playlist and the segments are
+	 * written.
+	 */
+	AllocatedPath directory = AllocatedPath::Null();
+
+	std::string playlist_name;
+
+	/**
+	 * The file name suffix of the segments, derived from the
+	 * encoder's MIME type.
+	 */
+	const char *suffix;
+
+	/**
+	 * Start each segment with an ID3 timestamp, as required by
+	 * the HLS specification for "packed audio" (MP3, AAC).
+	 */
+	bool id3_timestamps;
+
+	/**
+	 * The configured segment duration [s] and the number of
+	 * segments in the playlist.
+	 */
+	unsigned segment_duration, playlist_size;
+
+	Timer *timer;
+
+	/**
+	 * The PCM size of one segment.
+	 */
+	uint64_t segment_size;
+
+	double time_to_size;
+
+	struct Segment {
+		uint64_t sequence;
+		double duration;
+
+		/**
+		 * Is there a gap before this segment, e.g. because
+		 * the output has been reopened?
+		 */
+		bool discontinuity;
+	};
+
+	/**
+	 * The segments listed in the playlist, oldest first.
+	 */
+	std::deque<Segment> segments;
+
+	/**
+	 * The number of discontinuities which have been removed from
+	 * the playlist.
+	 */
+	unsigned discontinuity_sequence = 0;
+
+	/**
+	 * The segments which have been removed from the playlist but
+	 * not yet deleted.
+	 */
+	std::deque<uint64_t> obsolete;
+
+	/**
+	 * The segment file currently being written.
+	 */
+	FileOutputStream *file = nullptr;
+
+	/**
+	 * The sequence number of the next segment.  It starts with
+	 * the current time, so it continues to increase after a
+	 * restart.
+	 */
+	uint64_t next_sequence;
+
+	/**
+	 * The PCM size written into the current segment.
+	 */
+	uint64_t current_size;
+
+	/**
+	 * The PCM size of the stream before the current segment; used
+	 * for the ID3 timestamps.
+	 */
+	uint64_t stream_size = 0;
+
+	/**
+	 * Is the next segment the first one after Open()?
+	 */
+	bool discontinuity = false;
+
+	HlsOutput()
+		:base(hls_output_plugin),
+		 next_sequence(time(nullptr)) {}
+
+	~HlsOutput() {
+		delete prepared_encoder;
+	}
+
+	bool Initialize(const ConfigBlock &block, Error &error_r) {
+		return base.Configure(block, error_r);
+	}
+
+	static HlsOutput *Create(const ConfigBlock &block, Error &error);
+
+	bool Configure(const ConfigBlock &block, Error &error);
+
+	bool Open(AudioFormat &audio_format, Error &error);
+	void Close();
+
+	unsigned Delay() const {
+		return timer->IsStarted()
+			? timer->GetDelay()
+			: 0;
+	}
+
+	size_t Play(const void *chunk, size_t size, Error &error);
+
+	bool Pause();
+
+private:
+	AllocatedPath MakeSegmentPath(uint64_t sequence) const;
+
+	/**
+	 * Throws std::runtime_error on error.
+	 */
+	void StartSegment();
+
+	/**
+	 * Commit the current segment and update the playlist.
+	 *
+	 * Throws std::runtime_error on error.
+	 */
+	void FinishSegment();
+
+	/**
+	 * Throws std::runtime_error on error.
+	 */
+	void WritePlaylist();
+};
+
+inline bool
+HlsOutput::Configure(const ConfigBlock &block, Error &error)
+{
+	const char *encoder_name = block.GetBlockValue("encoder", "lame");
+	const auto encoder_plugin = encoder_plugin_get(encoder_name);
+	if (encoder_plugin == nullptr) {
+		error.Format(config_domain,
+			     "No such encoder: %s", encoder_name);
+		return false;
+	}
+
+	directory = block.GetBlockPath("directory", error);
+	if (directory.IsNull()) {
+		if (!error.IsDefined())
+			error.Set(config_domain, "'directory' not configured");
+		return false;
+	}
+
+	playlist_name = block.GetBlockValue("playlist", "index.m3u8");
+
+	segment_duration = block.GetBlockValue("segment_duration", 6u);
+	playlist_size = block.GetBlockValue("playlist_size", 5u);
+	if (segment_duration == 0 || playlist_size == 0) {
+		error.Set(config_domain,
+			  "segment_duration and playlist_size must be positive");
+		return false;
+	}
+
+	prepared_encoder = encoder_init_shared(*encoder_plugin, block, error);
+	if (prepared_encoder == nullptr)
+		return false;
+
+	const char *mime_type = prepared_encoder->GetMimeType();
+	if (mime_type == nullptr)
+		mime_type = "";
+
+	id3_timestamps = false;
+	if (strcmp(mime_type, "audio/mpeg") == 0) {
+		suffix = "mp3";
+		id3_timestamps = true;
+	} else if (strcmp(mime_type, "audio/aac") == 0) {
+		suffix = "aac";
+		id3_timestamps = true;
+	} else if (strcmp(mime_type, "audio/ogg") == 0) {
+		suffix = "ogg";
+		FormatWarning(hls_output_domain,
+			      "HLS clients usually don't support Ogg segments");
+	} else {
+		suffix = "bin";
+		FormatWarning(hls_output_domain,
+			      "Encoder \"%s\" is not suitable for HLS",
+			      encoder_name);
+	}
+
+	return true;
+}
+
+HlsOutput *
+HlsOutput::Create(const ConfigBlock &block, Error &error)
+{
+	HlsOutput *hls = new HlsOutput();
+
+	if (!hls->Initialize(block, error) ||
+	    !hls->Configure(block, error)) {
+		delete hls;
+		return nullptr;
+	}
+
+	return hls;
+}
+
+AllocatedPath
+HlsOutput::MakeSegmentPath(uint64_t sequence) const
+{
+	char name[64];
+	snprintf(name, sizeof(name), "segment-%llu.%s",
+		 (unsigned long long)sequence, suffix);
+	return AllocatedPath::Build(directory, AllocatedPath::FromUTF8(name));
+}
+
+/**
+ * Write an ID3v2.4 tag with a "PRIV" frame containing the MPEG-2
+ * transport stream timestamp (90 kHz) of the first sample, see RFC
+ * 8216 3.4.
+ */
+static void
+WriteId3Timestamp(OutputStream &os, uint64_t pts)
+{
+	static constexpr char owner[] =
+		"com.apple.streaming.transportStreamTimestamp";
+	static constexpr size_t frame_size = sizeof(owner) + 8;
+	static constexpr size_t tag_size = 10 + frame_size;
+
+	uint8_t buffer[10 + tag_size];
+	uint8_t *p = buffer;
+
+	/* tag header; the sizes are below 128, so "syncsafe"
+	   integers need no special treatment */
+	*p++ = 'I'; *p++ = 'D'; *p++ = '3';
+	*p++ = 4; *p++ = 0; *p++ = 0;
+	*p++ = 0; *p++ = 0; *p++ = 0; *p++ = tag_size;
+
+	/* frame header */
+	memcpy(p, "PRIV", 4);
+	p += 4;
+	*p++ = 0; *p++ = 0; *p++ = 0; *p++ = frame_size;
+	*p++ = 0; *p++ = 0;
+
+	memcpy(p, owner, sizeof(owner));
+	p += sizeof(owner);
+
+	pts &= (uint64_t(1) << 33) - 1;
+	for (int i = 7; i >= 0; --i)
+		*p++ = uint8_t(pts >> (i * 8));
+
+	assert(p == buffer + sizeof(buffer));
+
+	os.Write(buffer, sizeof(buffer));
+}
+
+void
+HlsOutput::StartSegment()
+{
+	assert(file == nullptr);
+
+	file = new FileOutputStream(MakeSegmentPath(next_sequence));
+	current_size = 0;
+
+	try {
+		if (id3_timestamps)
+			WriteId3Timestamp(*file,
+					  uint64_t(stream_size / time_to_size
+						   * 90000));
+	} catch (...) {
+		delete file;
+		file = nullptr;
+		throw;
+	}
+}
+
+void
+HlsOutput::FinishSegment()
+{
+	assert(file != nullptr);
+
+	FileOutputStream *f = file;
+	file = nullptr;
+
+	try {
+		f->Commit();
+	} catch (...) {
+		delete f;
+		throw;
+	}
+
+	delete f;
+
+	segments.push_back({next_sequence++, current_size / time_to_size,
+			    discontinuity});
+	discontinuity = false;
+	stream_size += current_size;
+
+	while (segments.size() > playlist_size) {
+		if (segments.front().discontinuity)
+			++discontinuity_sequence;
+
+		obsolete.push_back(segments.front().sequence);
+		segments.pop_front();
+	}
+
+	WritePlaylist();
+
+	while (obsolete.size() > HLS_KEEP_OBSOLETE) {
+		RemoveFile(MakeSegmentPath(obsolete.front()));
+		obsolete.pop_front();
+	}
+}
+
+void
+HlsOutput::WritePlaylist()
+{
+	unsigned target_duration = segment_duration;
+	for (const auto &s : segments)
+		target_duration = std::max(target_duration,
+					   unsigned(lround(s.duration)));
+
+	std::string playlist = "#EXTM3U\n#EXT-X-VERSION:3\n";
+
+	char buffer[128];
+	snprintf(buffer, sizeof(buffer),
+		 "#EXT-X-TARGETDURATION:%u\n"
+		 "#EXT-X-MEDIA-SEQUENCE:%llu\n",
+		 target_duration,
+		 (unsigned long long)segments.front().sequence);
+	playlist += buffer;
+
+	if (discontinuity_sequence > 0) {
+		snprintf(buffer, sizeof(buffer),
+			 "#EXT-X-DISCONTINUITY-SEQUENCE:%u\n",
+			 discontinuity_sequence);
+		playlist += buffer;
+	}
+
+	for (const auto &s : segments) {
+		if (s.discontinuity)
+			playlist += "#EXT-X-DISCONTINUITY\n";
+
+		snprintf(buffer, sizeof(buffer),
+			 "#EXTINF:%.3f,\nsegment-%llu.%s\n",
+			 s.duration, (unsigned long long)s.sequence,
+			 suffix);
+		playlist += buffer;
+	}
+
+	FileOutputStream os(AllocatedPath::Build(directory,
+						 AllocatedPath::FromUTF8(playlist_name.c_str())));
+	os.Write(playlist.data(), playlist.size());
+	os.Commit();
+}
+
+inline bool
+HlsOutput::Open(AudioFormat &audio_format, Error &error)
+{
+	encoder = prepared_encoder->Open(audio_format, error);
+	if (encoder == nullptr)
+		return false;
+
+	time_to_size = audio_format.GetTimeToSize();
+	segment_size = uint64_t(segment_duration * time_to_size);
+
+	try {
+		StartSegment();
+		EncoderToOutputStream(*file, *encoder);
+	} catch (const std::exception &e) {
+		delete file;
+		file = nullptr;
+		delete encoder;
+		error.Set(hls_output_domain, e.what());
+		return false;
+	}
+
+	timer = new Timer(audio_format);
+	discontinuity = !segments.empty();
+
+	return true;
+}
+
+inline void
+HlsOutput::Close()
+{
+	delete timer;
+
+	try {
+		Error error;
+		if (!encoder->End(error))
+			LogError(error);
+		else if (file != nullptr)
+			EncoderToOutputStream(*file, *encoder);
+
+		if (file != nullptr)
+			FinishSegment();
+	} catch (const std::exception &e) {
+		LogError(e);
+	}
+
+	delete file;
+	file = nullptr;
+
+	delete encoder;
+}
+
+inline size_t
+HlsOutput::Play(const void *chunk, size_t size, Error &error)
+{
+	timer->SleepRemainder();
+
+	if (!timer->IsStarted())
+		timer->Start();
+	timer->Add(size);
+
+	if (!encoder->Write(chunk, size, error))
+		return 0;
+
+	try {
+		if (file == nullptr)
+			/* the previous attempt has failed */
+			StartSegment();
+
+		EncoderToOutputStream(*file, *encoder);
+
+		current_size += size;
+		if (current_size >= segment_size) {
+			FinishSegment();
+			StartSegment();
+		}
+	} catch (const std::exception &e) {
+		/* don't stop playback; the next segment will be
+		   tried again */
+		LogError(e);
+		delete file;
+		file = nullptr;
+		discontinuity = true;
+	}
+
+	return size;
+}
+
+inline bool
+HlsOutput::Pause()
+{
+	/* keep the stream going with silence, or else the clients
+	   would run out of segments */
+	static const char silence[1020] = { 0 };
+	return Play(silence, sizeof(silence), IgnoreError()) > 0;
+}
+
+typedef AudioOutputWrapper<HlsOutput> Wrapper;
+
+const struct AudioOutputPlugin hls_output_plugin = {
+	"hls",
+	nullptr,
+	&Wrapper::Init,
+	&Wrapper::Finish,
+	nullptr,
+	nullptr,
+	&Wrapper::Open,
+	&Wrapper::Close,
+	&Wrapper::Delay,
+	nullptr,
+	&Wrapper::Play,
+	nullptr,
+	nullptr,
+	&Wrapper::Pause,
+	nullptr,
+	nullptr,
+};
@@ -36,6 +36,7 @@
 
 #include <unistd.h> /* for usleep() */
 #include <stdlib.h>
+#include <string.h>
 
 static constexpr unsigned MAX_PORTS = 16;
 
@@ -71,6 +72,23 @@ struct JackOutput {
 	jack_client_t *client;
 	jack_ringbuffer_t *ringbuffer[MAX_PORTS];
 
+	/**
+	 * The JACK period size (in frames) at the time playback was
+	 * started.  WriteSamples() commits only whole periods to the
+	 * ring buffers, so Process() can copy one period per port
+	 * without checking each buffer.  0 if the ring buffer size
+	 * is not a multiple of the period size; then the ring buffers
+	 * are filled frame by frame.
+	 */
+	jack_nframes_t period;
+
+	/**
+	 * The number of frames of the current period which have been
+	 * written to the ring buffers, but not committed yet.  Only
+	 * used if #period is non-zero.
+	 */
+	jack_nframes_t pending;
+
 	bool shutdown;
 
 	/**
@@ -121,6 +139,11 @@ struct JackOutput {
 	 */
 	size_t WriteSamples(const float *src, size_t n_frames);
 
+	/**
+	 * Like WriteSamples(), but commit only whole periods.
+	 */
+	size_t WritePeriods(const float *src, size_t n_frames);
+
 	unsigned Delay() const {
 		return base.pause && pause && !shutdown
 			? 1000
@@ -215,21 +238,47 @@ Copy(jack_port_t &dest, jack_nframes_t nframes,
 	std::fill(out + available, out + nframes, 0.0);
 }
 
+/**
+ * Copy one period from the buffer to the port.  The caller has
+ * checked that the buffer contains enough data.
+ */
+static void
+CopyPeriod(jack_port_t &dest, jack_nframes_t nframes,
+	   jack_ringbuffer_t &src)
+{
+	jack_default_audio_sample_t *out =
+		(jack_default_audio_sample_t *)
+		jack_port_get_buffer(&dest, nframes);
+	if (out == nullptr)
+		/* workaround for libjack1 bug, see Copy() */
+		return;
+
+	const size_t size = nframes * jack_sample_size;
+
+	/* the period is contiguous unless the generic code path
+	   has broken the alignment */
+	jack_ringbuffer_data_t d[2];
+	jack_ringbuffer_get_read_vector(&src, d);
+	const size_t first = std::min(d[0].len, size);
+	memcpy(out, d[0].buf, first);
+	memcpy((char *)out + first, d[1].buf, size - first);
+
+	jack_ringbuffer_read_advance(&src, size);
+}
+
 inline void
 JackOutput::Process(jack_nframes_t nframes)
 {
 	if (nframes <= 0)
 		return;
 
-	jack_nframes_t available = GetAvailable();
-
 	const unsigned n_channels = audio_format.channels;
 
 	if (pause) {
 		/* empty the ring buffers */
 
 		MultiReadAdvance({ringbuffer, n_channels},
-				 available * jack_sample_size);
+				 GetAvailable() * jack_sample_size);
 
 		/* generate silence while MPD is paused */
 
@@ -238,11 +287,29 @@ JackOutput::Process(jack_nframes_t nframes)
 		return;
 	}
 
-	if (available > nframes)
-		available = nframes;
+	if (nframes == period) {
+		/* WritePeriods() commits whole periods, and the last
+		   channel last: if that one has a period, all others
+		   have it, too */
+		if (jack_ringbuffer_read_space(ringbuffer[n_channels - 1])
+		    >= nframes * jack_sample_size) {
+			for (unsigned i = 0; i < n_channels; ++i)
+				CopyPeriod(*ports[i], nframes,
+					   *ringbuffer[i]);
+		} else
+			/* ringbuffer underrun; don't play a partial
+			   period */
+			MultiWriteSilence({ports, n_channels}, nframes);
+	} else {
+		/* the JACK buffer size has changed since playback
+		   was started; fall back to the generic code path */
+		jack_nframes_t available = GetAvailable();
+		if (available > nframes)
+			available = nframes;
 
-	for (unsigned i = 0; i < n_channels; ++i)
-		Copy(*ports[i], nframes, *ringbuffer[i], available);
+		for (unsigned i = 0; i < n_channels; ++i)
+			Copy(*ports[i], nframes, *ringbuffer[i], available);
+	}
 
 	/* generate silence for the unused source ports */
 
@@ -517,6 +584,22 @@ JackOutput::Start(Error &error)
 		jack_ringbuffer_reset(ringbuffer[i]);
 	}
 
+	/* align the ring buffers to the JACK period if a whole
+	   number of periods (at least two) fits into them */
+	const jack_nframes_t buffer_size = jack_get_buffer_size(client);
+	const size_t period_size = buffer_size * jack_sample_size;
+	period = period_size > 0 &&
+		ringbuffer[0]->size % period_size == 0 &&
+		ringbuffer[0]->size >= 2 * period_size
+		? buffer_size
+		: 0;
+	pending = 0;
+
+	if (period == 0)
+		FormatDebug(jack_output_domain,
+			    "ringbuffer_size is not a multiple of the JACK buffer size (%u frames)",
+			    (unsigned)buffer_size);
+
 	if ( jack_activate(client) ) {
 		error.Set(jack_output_domain, "cannot activate client");
 		Stop();
@@ -677,6 +760,55 @@ JackOutput::WriteSamples(const float *src, size_t n_frames)
 	return result;
 }
 
+inline size_t
+JackOutput::WritePeriods(const float *src, size_t n_frames)
+{
+	assert(n_frames > 0);
+	assert(period > 0);
+	assert(pending < period);
+
+	const unsigned n_channels = audio_format.channels;
+	const size_t period_size = period * jack_sample_size;
+
+	size_t result = 0;
+	while (n_frames > 0) {
+		/* the whole period must fit into the contiguous
+		   area after the write pointer; since the write
+		   pointer moves by whole periods and the buffer size
+		   is a multiple of the period, it never wraps inside
+		   a period */
+		float *dest[MAX_CHANNELS];
+		for (unsigned i = 0; i < n_channels; ++i) {
+			jack_ringbuffer_data_t d[2];
+			jack_ringbuffer_get_write_vector(ringbuffer[i], d);
+			if (d[0].len < period_size)
+				return result;
+
+			dest[i] = (float *)d[0].buf + pending;
+		}
+
+		const size_t n = std::min(n_frames, size_t(period - pending));
+		for (size_t j = 0; j < n; ++j)
+			for (unsigned i = 0; i < n_channels; ++i)
+				*dest[i]++ = *src++;
+
+		result += n;
+		n_frames -= n;
+		pending += n;
+
+		if (pending == period) {
+			/* commit the period; the last channel last,
+			   see Process() */
+			for (unsigned i = 0; i < n_channels; ++i)
+				jack_ringbuffer_write_advance(ringbuffer[i],
+							      period_size);
+			pending = 0;
+		}
+	}
+
+	return result;
+}
+
 inline size_t
 JackOutput::Play(const void *chunk, size_t size, Error &error)
 {
@@ -694,8 +826,9 @@ JackOutput::Play(const void *chunk, size_t size, Error &error)
 			return 0;
 		}
 
-		size_t frames_written =
-			WriteSamples((const float *)chunk, size);
+		size_t frames_written = period > 0
+			? WritePeriods((const float *)chunk, size)
+			: WriteSamples((const float *)chunk, size);
 		if (frames_written > 0)
 			return frames_written * frame_size;
 
@@ -713,6 +846,10 @@ JackOutput::Pause()
 
 	pause = true;
 
+	/* the ring buffers are being emptied; drop the partial
+	   period, too */
+	pending = 0;
+
 	return true;
 }
 
@@ -734,4 +871,5 @@ const struct AudioOutputPlugin jack_output_plugin = {
 	nullptr,
 	&Wrapper::Pause,
 	nullptr,
+	nullptr,
 };
@@ -63,6 +63,8 @@ public:
 	size_t Play(gcc_unused const void *chunk, size_t size,
 		    gcc_unused Error &error) {
 		if (sync) {
+			timer->SleepRemainder();
+
 			if (!timer->IsStarted())
 				timer->Start();
 			timer->Add(size);
@@ -75,6 +77,12 @@ public:
 		if (sync)
 			timer->Reset();
 	}
+
+	unsigned Latency() const {
+		return sync
+			? timer->GetLatency()
+			: 0;
+	}
 };
 
 inline NullOutput *
@@ -109,5 +117,6 @@ const struct AudioOutputPlugin null_output_plugin = {
 	nullptr,
 	&Wrapper::Cancel,
 	nullptr,
+	&Wrapper::Latency,
 	nullptr,
 };
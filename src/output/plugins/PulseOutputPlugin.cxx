@@ -29,6 +29,8 @@
 #include "util/Error.hxx"
 #include "Log.hxx"
 
+#include <limits>
+
 #include <pulse/thread-mainloop.h>
 #include <pulse/context.h>
 #include <pulse/stream.h>
@@ -111,6 +113,7 @@ public:
 	size_t Play(const void *chunk, size_t size, Error &error);
 	void Cancel();
 	bool Pause();
+	unsigned Latency();
 
 private:
 	/**
@@ -695,10 +698,13 @@ PulseOutput::Open(AudioFormat &audio_format, Error &error)
 		return false;
 	}
 
-	/* .. and connect it (asynchronously) */
+	/* .. and connect it (asynchronously); automatic timing
+	   updates make pa_stream_get_latency() work for Latency() */
 
 	if (pa_stream_connect_playback(stream, sink,
-				       nullptr, pa_stream_flags_t(0),
+				       nullptr,
+				       pa_stream_flags_t(PA_STREAM_INTERPOLATE_TIMING|
+							 PA_STREAM_AUTO_TIMING_UPDATE),
 				       nullptr, nullptr) < 0) {
 		DeleteStream();
 
@@ -801,6 +807,27 @@ PulseOutput::Delay()
 	return result;
 }
 
+inline unsigned
+PulseOutput::Latency()
+{
+	pa_threaded_mainloop_lock(mainloop);
+
+	pa_usec_t usec;
+	int negative;
+	unsigned result = 0;
+	/* without timing information (-PA_ERR_NODATA), report 0 */
+	if (stream != nullptr &&
+	    pa_stream_get_latency(stream, &usec, &negative) == 0 &&
+	    !negative)
+		result = usec < std::numeric_limits<unsigned>::max()
+			? unsigned(usec)
+			: std::numeric_limits<unsigned>::max();
+
+	pa_threaded_mainloop_unlock(mainloop);
+
+	return result;
+}
+
 inline size_t
 PulseOutput::Play(const void *chunk, size_t size, Error &error)
 {
@@ -959,6 +986,7 @@ const struct AudioOutputPlugin pulse_output_plugin = {
 	nullptr,
 	&Wrapper::Cancel,
 	&Wrapper::Pause,
+	&Wrapper::Latency,
 
 	&pulse_mixer_plugin,
 };
@@ -26,16 +26,20 @@
 #include "encoder/EncoderInterface.hxx"
 #include "encoder/EncoderPlugin.hxx"
 #include "encoder/EncoderList.hxx"
+#include "encoder/SharedEncoder.hxx"
+#include "encoder/ThreadedEncoder.hxx"
 #include "config/ConfigError.hxx"
 #include "config/ConfigPath.hxx"
 #include "Log.hxx"
 #include "fs/AllocatedPath.hxx"
 #include "fs/io/FileOutputStream.hxx"
+#include "fs/io/ThreadedOutputStream.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 static constexpr Domain recorder_domain("recorder");
 
@@ -67,11 +71,32 @@ class RecorderOutput {
 	 */
 	AudioFormat effective_audio_format;
 
+	/**
+	 * The size of the buffer between the encoder and the file.
+	 * If this is zero, then the output thread writes to the file
+	 * directly.
+	 */
+	size_t write_buffer_size;
+
+	ThreadedOutputStream::Policy write_buffer_policy;
+
+	/**
+	 * The number of bytes to reserve on the disk for each new
+	 * file.  Zero disables this.
+	 */
+	uint64_t preallocate_size;
+
 	/**
 	 * The destination file.
 	 */
 	FileOutputStream *file;
 
+	/**
+	 * Writes to #file in a separate thread.  This is nullptr if
+	 * #write_buffer_size is zero.
+	 */
+	ThreadedOutputStream *writer = nullptr;
+
 	RecorderOutput()
 		:base(recorder_output_plugin) {}
 
@@ -105,6 +130,24 @@ private:
 		return !format_path.empty();
 	}
 
+	/**
+	 * Create #file and #writer.
+	 *
+	 * Throws std::exception on error.
+	 */
+	void CreateOutputFile(Path path);
+
+	/**
+	 * Delete #writer and #file without committing the file.
+	 */
+	void DestroyOutputFile();
+
+	OutputStream &GetOutputStream() {
+		return writer != nullptr
+			? (OutputStream &)*writer
+			: (OutputStream &)*file;
+	}
+
 	/**
 	 * Finish the encoder and commit the file.
 	 */
@@ -146,9 +189,31 @@ RecorderOutput::Configure(const ConfigBlock &block, Error &error)
 		return false;
 	}
 
+	write_buffer_size = block.GetBlockValue("write_buffer", 0u);
+
+	const char *overflow =
+		block.GetBlockValue("write_buffer_overflow", "block");
+	if (strcmp(overflow, "block") == 0)
+		write_buffer_policy = ThreadedOutputStream::Policy::BLOCK;
+	else if (strcmp(overflow, "drop") == 0)
+		write_buffer_policy = ThreadedOutputStream::Policy::DROP;
+	else {
+		error.Format(config_domain,
+			     "Invalid write_buffer_overflow setting: %s",
+			     overflow);
+		return false;
+	}
+
+	preallocate_size = block.GetBlockValue("preallocate", 0u);
+
 	/* initialize encoder */
 
-	prepared_encoder = encoder_init(*encoder_plugin, block, error);
+	prepared_encoder = encoder_init_shared(*encoder_plugin, block, error);
+	if (prepared_encoder == nullptr)
+		return false;
+
+	prepared_encoder = encoder_wrap_threaded(prepared_encoder, block,
+						 error);
 	if (prepared_encoder == nullptr)
 		return false;
 
@@ -173,12 +238,46 @@ RecorderOutput::Create(const ConfigBlock &block, Error &error)
 	return recorder;
 }
 
+void
+RecorderOutput::CreateOutputFile(Path _path)
+{
+	assert(file == nullptr);
+	assert(writer == nullptr);
+
+	file = new FileOutputStream(_path);
+
+	if (preallocate_size > 0)
+		file->Preallocate(preallocate_size);
+
+	if (write_buffer_size > 0) {
+		try {
+			writer = new ThreadedOutputStream(*file,
+							  write_buffer_size,
+							  write_buffer_policy);
+		} catch (...) {
+			delete file;
+			file = nullptr;
+			throw;
+		}
+	}
+}
+
+void
+RecorderOutput::DestroyOutputFile()
+{
+	delete writer;
+	writer = nullptr;
+
+	delete file;
+	file = nullptr;
+}
+
 inline void
 RecorderOutput::EncoderToFile()
 {
 	assert(file != nullptr);
 
-	EncoderToOutputStream(*file, *encoder);
+	EncoderToOutputStream(GetOutputStream(), *encoder);
 }
 
 inline bool
@@ -186,11 +285,13 @@ RecorderOutput::Open(AudioFormat &audio_format, Error &error)
 {
 	/* create the output file */
 
+	file = nullptr;
+
 	if (!HasDynamicPath()) {
 		assert(!path.IsNull());
 
 		try {
-			file = new FileOutputStream(path);
+			CreateOutputFile(path);
 		} catch (const std::exception &e) {
 			error.Set(recorder_domain, e.what());
 			return false;
@@ -199,15 +300,13 @@ RecorderOutput::Open(AudioFormat &audio_format, Error &error)
 		/* don't open the file just yet; wait until we have
 		   a tag that we can use to build the path */
 		assert(path.IsNull());
-
-		file = nullptr;
 	}
 
 	/* open the encoder */
 
 	encoder = prepared_encoder->Open(audio_format, error);
 	if (encoder == nullptr) {
-		delete file;
+		DestroyOutputFile();
 		return false;
 	}
 
@@ -216,6 +315,7 @@ RecorderOutput::Open(AudioFormat &audio_format, Error &error)
 			EncoderToFile();
 		} catch (const std::exception &e) {
 			delete encoder;
+			DestroyOutputFile();
 			error.Set(recorder_domain, e.what());
 			return false;
 		}
@@ -242,8 +342,13 @@ RecorderOutput::Commit(Error &error)
 	if (success) {
 		try {
 			EncoderToFile();
+
+			if (writer != nullptr)
+				/* wait for the writer thread */
+				writer->Flush();
 		} catch (...) {
 			delete encoder;
+			DestroyOutputFile();
 			throw;
 		}
 	}
@@ -252,6 +357,18 @@ RecorderOutput::Commit(Error &error)
 
 	delete encoder;
 
+	if (writer != nullptr) {
+		const uint64_t dropped = writer->GetDropped();
+		if (dropped > 0)
+			FormatWarning(recorder_domain,
+				      "Dropped %llu bytes while recording to \"%s\"",
+				      (unsigned long long)dropped,
+				      path.ToUTF8().c_str());
+
+		delete writer;
+		writer = nullptr;
+	}
+
 	if (success) {
 		try {
 			file->Commit();
@@ -318,9 +435,8 @@ RecorderOutput::ReopenFormat(AllocatedPath &&new_path, Error &error)
 	assert(path.IsNull());
 	assert(file == nullptr);
 
-	FileOutputStream *new_file;
 	try {
-		new_file = new FileOutputStream(path);
+		CreateOutputFile(new_path);
 	} catch (const std::exception &e) {
 		error.Set(recorder_domain, e.what());
 		return false;
@@ -329,7 +445,7 @@ RecorderOutput::ReopenFormat(AllocatedPath &&new_path, Error &error)
 	AudioFormat new_audio_format = effective_audio_format;
 	encoder = prepared_encoder->Open(new_audio_format, error);
 	if (encoder == nullptr) {
-		delete new_file;
+		DestroyOutputFile();
 		return false;
 	}
 
@@ -338,16 +454,15 @@ RecorderOutput::ReopenFormat(AllocatedPath &&new_path, Error &error)
 	assert(new_audio_format == effective_audio_format);
 
 	try {
-		EncoderToOutputStream(*new_file, *encoder);
+		EncoderToFile();
 	} catch (const std::exception &e) {
 		delete encoder;
-		delete new_file;
+		DestroyOutputFile();
 		error.Set(recorder_domain, e.what());
 		return false;
 	}
 
 	path = std::move(new_path);
-	file = new_file;
 
 	FormatDebug(recorder_domain, "Recording to \"%s\"",
 		    path.ToUTF8().c_str());
@@ -446,4 +561,5 @@ const struct AudioOutputPlugin recorder_output_plugin = {
 	nullptr,
 	nullptr,
 	nullptr,
+	nullptr,
 };
@@ -24,6 +24,8 @@
 #include "encoder/EncoderInterface.hxx"
 #include "encoder/EncoderPlugin.hxx"
 #include "encoder/EncoderList.hxx"
+#include "encoder/SharedEncoder.hxx"
+#include "encoder/ThreadedEncoder.hxx"
 #include "config/ConfigError.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
@@ -192,7 +194,12 @@ ShoutOutput::Configure(const ConfigBlock &block, Error &error)
 		return false;
 	}
 
-	prepared_encoder = encoder_init(*encoder_plugin, block, error);
+	prepared_encoder = encoder_init_shared(*encoder_plugin, block, error);
+	if (prepared_encoder == nullptr)
+		return false;
+
+	prepared_encoder = encoder_wrap_threaded(prepared_encoder, block,
+						 error);
 	if (prepared_encoder == nullptr)
 		return false;
 
@@ -521,4 +528,5 @@ const struct AudioOutputPlugin shout_output_plugin = {
 	&Wrapper::Cancel,
 	&Wrapper::Pause,
 	nullptr,
+	nullptr,
 };
@@ -195,4 +195,5 @@ const struct AudioOutputPlugin solaris_output_plugin = {
 	solaris_output_cancel,
 	nullptr,
 	nullptr,
+	nullptr,
 };
@@ -22,27 +22,67 @@
 #include "HttpdInternal.hxx"
 #include "util/ASCII.hxx"
 #include "util/AllocatedString.hxx"
+#include "util/Macros.hxx"
 #include "Page.hxx"
 #include "IcyMetaDataServer.hxx"
 #include "net/SocketError.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
 
+/**
+ * The maximum number of buffers passed to one WriteV() call; this is
+ * the minimum IOV_MAX guaranteed by POSIX.
+ */
+static constexpr size_t MAX_CHUNKS = 16;
+
+/**
+ * Describes one #iovec prepared by HttpdClient::PrepareWrite().
+ */
+struct HttpdClient::Chunk {
+	enum class Type : uint8_t {
+		/**
+		 * Data from #current_page.
+		 */
+		CURRENT,
+
+		/**
+		 * Data from a page of the ring; the #page
+		 * attribute holds a reference.
+		 */
+		RING,
+
+		/**
+		 * The #metadata page.
+		 */
+		METADATA,
+
+		/**
+		 * An empty metadata block (one null byte).
+		 */
+		EMPTY_METADATA,
+	} type;
+
+	Page *page;
+};
+
+static constexpr char empty_metadata = 0;
+
 HttpdClient::~HttpdClient()
 {
-	if (state == RESPONSE) {
-		if (current_page != nullptr)
-			current_page->Unref();
-
-		ClearQueue();
-	}
+	if (state == RESPONSE && current_page != nullptr)
+		current_page->Unref();
 
 	if (metadata)
 		metadata->Unref();
 
+	if (pending_metadata != nullptr)
+		pending_metadata->Unref();
+
 	if (IsDefined())
 		BufferedSocket::Close();
 }
@@ -68,6 +108,9 @@ HttpdClient::BeginResponse()
 	state = RESPONSE;
 	current_page = nullptr;
 
+	const ScopeLock protect(httpd.mutex);
+	next_page = httpd.pages.GetEnd();
+
 	if (!head_method)
 		httpd.SendHeader(*this);
 }
@@ -188,218 +231,267 @@ HttpdClient::SendResponse()
 		FormatWarning(httpd_output_domain,
 			      "failed to write to client: %s",
 			      (const char *)msg);
-		Close();
+		LockClose();
 		return false;
 	}
 
 	return true;
 }
 
-HttpdClient::HttpdClient(HttpdOutput &_httpd, int _fd, EventLoop &_loop,
+HttpdClient::HttpdClient(HttpdOutput &_httpd, HttpdClientGroup &_group,
+			 int _fd, EventLoop &_loop,
 			 bool _metadata_supported)
 	:BufferedSocket(_fd, _loop),
-	 httpd(_httpd),
+	 httpd(_httpd), group(_group),
 	 state(REQUEST),
-	 queue_size(0),
 	 head_method(false),
 	 dlna_streaming_requested(false),
 	 metadata_supported(_metadata_supported),
 	 metadata_requested(false), metadata_sent(true),
 	 metaint(8192), /*TODO: just a std value */
-	 metadata(nullptr),
+	 metadata(nullptr), pending_metadata(nullptr),
+	 cancel_pending(false),
 	 metadata_current_position(0), metadata_fill(0)
 {
 }
 
 void
-HttpdClient::ClearQueue()
+HttpdClient::CancelQueue()
 {
-	assert(state == RESPONSE);
+	if (state != RESPONSE)
+		return;
+
+	/* the pages are skipped by TryWrite(), in this client's
+	   thread */
+	cancel_pending = true;
+}
+
+size_t
+HttpdClient::PrepareWrite(struct iovec *v, Chunk *chunks,
+			  size_t max_n) const
+{
+	const PageRing &ring = httpd.pages;
+
+	const Page *page = current_page;
+	size_t position = current_position;
+	Chunk::Type type = Chunk::Type::CURRENT;
+	uint64_t seq = next_page;
+
+	unsigned fill = metadata_fill;
+	bool meta_sent = metadata_sent;
+
+	size_t n = 0;
+	while (n < max_n) {
+		if (page == nullptr || position == page->size) {
+			if (seq == ring.GetEnd())
+				break;
+
+			page = &ring.Get(seq++);
+			position = 0;
+			type = Chunk::Type::RING;
+			continue;
+		}
+
+		if (metadata_requested && fill == metaint) {
+			/* interleave a metadata block */
+
+			if (!meta_sent) {
+				v[n].iov_base = metadata->data +
+					metadata_current_position;
+				v[n].iov_len = metadata->size -
+					metadata_current_position;
+				chunks[n] = {Chunk::Type::METADATA, nullptr};
+				meta_sent = true;
+			} else {
+				v[n].iov_base = const_cast<char *>(&empty_metadata);
+				v[n].iov_len = 1;
+				chunks[n] = {Chunk::Type::EMPTY_METADATA,
+					     nullptr};
+			}
+
+			++n;
+			fill = 0;
+			continue;
+		}
 
-	while (!pages.empty()) {
-		Page *page = pages.front();
-		pages.pop();
+		size_t length = page->size - position;
+		if (metadata_requested)
+			length = std::min<size_t>(length, metaint - fill);
 
-#ifndef NDEBUG
-		assert(queue_size >= page->size);
-		queue_size -= page->size;
-#endif
+		v[n].iov_base = const_cast<unsigned char *>(page->data +
+							    position);
+		v[n].iov_len = length;
+		chunks[n] = {type, const_cast<Page *>(page)};
+		if (type == Chunk::Type::RING)
+			chunks[n].page->Ref();
+		++n;
 
-		page->Unref();
+		position += length;
+		if (metadata_requested)
+			fill += length;
 	}
 
-	assert(queue_size == 0);
+	return n;
 }
 
 void
-HttpdClient::CancelQueue()
+HttpdClient::ConsumeWrite(const struct iovec *v, Chunk *chunks, size_t n,
+			  size_t nbytes)
 {
-	if (state != RESPONSE)
-		return;
+	for (size_t i = 0; i < n; ++i) {
+		Chunk &chunk = chunks[i];
+		const size_t length = std::min(v[i].iov_len, nbytes);
+		nbytes -= length;
+
+		switch (chunk.type) {
+		case Chunk::Type::CURRENT:
+		case Chunk::Type::RING:
+			if (length == 0)
+				break;
+
+			if (chunk.page != current_page) {
+				/* the previous page is finished; the
+				   next one from the ring becomes the
+				   current page, taking over the
+				   chunk's reference */
+				assert(chunk.type == Chunk::Type::RING);
+
+				if (current_page != nullptr)
+					current_page->Unref();
+
+				current_page = chunk.page;
+				chunk.page = nullptr;
+				++next_page;
+			}
 
-	ClearQueue();
+			current_position = (const unsigned char *)v[i].iov_base
+				- current_page->data + length;
+			assert(current_position <= current_page->size);
 
-	if (current_page == nullptr)
-		CancelWrite();
-}
+			if (metadata_requested)
+				metadata_fill += length;
 
-ssize_t
-HttpdClient::TryWritePage(const Page &page, size_t position)
-{
-	assert(position < page.size);
+			if (current_position == current_page->size) {
+				current_page->Unref();
+				current_page = nullptr;
+			}
 
-	return Write(page.data + position, page.size - position);
-}
+			break;
 
-ssize_t
-HttpdClient::TryWritePageN(const Page &page, size_t position, ssize_t n)
-{
-	return n >= 0
-		? Write(page.data + position, n)
-		: TryWritePage(page, position);
-}
+		case Chunk::Type::METADATA:
+			metadata_current_position += length;
+			if (metadata_current_position == metadata->size) {
+				metadata_fill = 0;
+				metadata_current_position = 0;
+				metadata_sent = true;
+			}
 
-ssize_t
-HttpdClient::GetBytesTillMetaData() const
-{
-	if (metadata_requested &&
-	    current_page->size - current_position > metaint - metadata_fill)
-		return metaint - metadata_fill;
+			break;
+
+		case Chunk::Type::EMPTY_METADATA:
+			if (length > 0) {
+				metadata_fill = 0;
+				metadata_current_position = 0;
+			}
+
+			break;
+		}
 
-	return -1;
+		if (chunk.type == Chunk::Type::RING && chunk.page != nullptr)
+			chunk.page->Unref();
+	}
 }
 
 inline bool
 HttpdClient::TryWrite()
 {
-	const ScopeLock protect(httpd.mutex);
-
 	assert(state == RESPONSE);
 
-	if (current_page == nullptr) {
-		if (pages.empty()) {
-			/* another thread has removed the event source
-			   while this thread was waiting for
-			   httpd.mutex */
-			CancelWrite();
-			return true;
+	struct iovec v[MAX_CHUNKS];
+	Chunk chunks[MAX_CHUNKS];
+	size_t n;
+
+	{
+		const ScopeLock protect(httpd.mutex);
+
+		if (cancel_pending) {
+			cancel_pending = false;
+			next_page = httpd.pages.GetEnd();
+		} else if (next_page < httpd.pages.GetBegin()) {
+			FormatDebug(httpd_output_domain,
+				    "client is too slow, flushing its queue");
+			next_page = httpd.pages.GetEnd();
 		}
 
-		current_page = pages.front();
-		pages.pop();
-		current_position = 0;
+		if (pending_metadata != nullptr &&
+		    metadata_current_position == 0) {
+			/* don't replace the metadata in the middle of
+			   a metadata block */
+			if (metadata != nullptr)
+				metadata->Unref();
 
-		assert(queue_size >= current_page->size);
-		queue_size -= current_page->size;
-	}
+			metadata = pending_metadata;
+			pending_metadata = nullptr;
+			metadata_sent = false;
+		}
 
-	const ssize_t bytes_to_write = GetBytesTillMetaData();
-	if (bytes_to_write == 0) {
-		if (!metadata_sent) {
-			ssize_t nbytes = TryWritePage(*metadata,
-						      metadata_current_position);
-			if (nbytes < 0) {
-				auto e = GetSocketError();
-				if (IsSocketErrorAgain(e))
-					return true;
-
-				if (!IsSocketErrorClosed(e)) {
-					SocketErrorMessage msg(e);
-					FormatWarning(httpd_output_domain,
-						      "failed to write to client: %s",
-						      (const char *)msg);
-				}
-
-				Close();
-				return false;
-			}
+		n = PrepareWrite(v, chunks, ARRAY_SIZE(v));
+	}
 
-			metadata_current_position += nbytes;
+	if (n == 0) {
+		/* all pages are sent: remove the event source; Wake()
+		   will schedule it again */
+		CancelWrite();
+		return true;
+	}
 
-			if (metadata->size - metadata_current_position == 0) {
-				metadata_fill = 0;
-				metadata_current_position = 0;
-				metadata_sent = true;
-			}
-		} else {
-			char empty_data = 0;
-
-			ssize_t nbytes = Write(&empty_data, 1);
-			if (nbytes < 0) {
-				auto e = GetSocketError();
-				if (IsSocketErrorAgain(e))
-					return true;
-
-				if (!IsSocketErrorClosed(e)) {
-					SocketErrorMessage msg(e);
-					FormatWarning(httpd_output_domain,
-						      "failed to write to client: %s",
-						      (const char *)msg);
-				}
-
-				Close();
-				return false;
-			}
+	/* send without holding the mutex, so the output thread and
+	   other client threads are not blocked */
+	ssize_t nbytes = WriteV(v, n);
+	if (nbytes < 0) {
+		ConsumeWrite(v, chunks, n, 0);
 
-			metadata_fill = 0;
-			metadata_current_position = 0;
-		}
-	} else {
-		ssize_t nbytes =
-			TryWritePageN(*current_page, current_position,
-				      bytes_to_write);
-		if (nbytes < 0) {
-			auto e = GetSocketError();
-			if (IsSocketErrorAgain(e))
-				return true;
-
-			if (!IsSocketErrorClosed(e)) {
-				SocketErrorMessage msg(e);
-				FormatWarning(httpd_output_domain,
-					      "failed to write to client: %s",
-					      (const char *)msg);
-			}
+		auto e = GetSocketError();
+		if (IsSocketErrorAgain(e))
+			return true;
 
-			Close();
-			return false;
+		if (!IsSocketErrorClosed(e)) {
+			SocketErrorMessage msg(e);
+			FormatWarning(httpd_output_domain,
+				      "failed to write to client: %s",
+				      (const char *)msg);
 		}
 
-		current_position += nbytes;
-		assert(current_position <= current_page->size);
+		LockClose();
+		return false;
+	}
 
-		if (metadata_requested)
-			metadata_fill += nbytes;
+	ConsumeWrite(v, chunks, n, nbytes);
 
-		if (current_position >= current_page->size) {
-			current_page->Unref();
-			current_page = nullptr;
+	if (n < ARRAY_SIZE(v) && current_page == nullptr) {
+		size_t total = 0;
+		for (size_t i = 0; i < n; ++i)
+			total += v[i].iov_len;
 
-			if (pages.empty())
-				/* all pages are sent: remove the
-				   event source */
-				CancelWrite();
-		}
+		if (size_t(nbytes) == total)
+			/* everything which was available has been
+			   sent: remove the event source; Wake() will
+			   schedule it again */
+			CancelWrite();
 	}
 
 	return true;
 }
 
 void
-HttpdClient::PushPage(Page *page)
+HttpdClient::PushHeader(Page &page)
 {
-	if (state != RESPONSE)
-		/* the client is still writing the HTTP request */
-		return;
-
-	if (queue_size > 256 * 1024) {
-		FormatDebug(httpd_output_domain,
-			    "client is too slow, flushing its queue");
-		ClearQueue();
-	}
+	assert(state == RESPONSE);
+	assert(current_page == nullptr);
 
-	page->Ref();
-	pages.push(page);
-	queue_size += page->size;
+	page.Ref();
+	current_page = &page;
+	current_position = 0;
 
 	ScheduleWrite();
 }
@@ -409,14 +501,18 @@ HttpdClient::PushMetaData(Page *page)
 {
 	assert(page != nullptr);
 
-	if (metadata) {
-		metadata->Unref();
-		metadata = nullptr;
-	}
+	if (pending_metadata != nullptr)
+		pending_metadata->Unref();
 
 	page->Ref();
-	metadata = page;
-	metadata_sent = false;
+	pending_metadata = page;
+}
+
+void
+HttpdClient::Wake()
+{
+	if (state == RESPONSE)
+		ScheduleWrite();
 }
 
 bool
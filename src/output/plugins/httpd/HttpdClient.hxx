@@ -26,13 +26,13 @@
 #include <boost/intrusive/link_mode.hpp>
 #include <boost/intrusive/list_hook.hpp>
 
-#include <queue>
-#include <list>
-
 #include <stddef.h>
+#include <stdint.h>
 
 class HttpdOutput;
+class HttpdClientGroup;
 class Page;
+struct iovec;
 
 class HttpdClient final
 	: BufferedSocket,
@@ -42,6 +42,11 @@ class HttpdClient final
 	 */
 	HttpdOutput &httpd;
 
+	/**
+	 * The group this client belongs to.
+	 */
+	HttpdClientGroup &group;
+
 	/**
 	 * The current state of the client.
 	 */
@@ -57,17 +62,15 @@ class HttpdClient final
 	} state;
 
 	/**
-	 * A queue of #Page objects to be sent to the client.
-	 */
-	std::queue<Page *, std::list<Page *>> pages;
-
-	/**
-	 * The sum of all page sizes in #pages.
+	 * The sequence number of the next page in HttpdOutput::pages
+	 * to be sent to the client.
 	 */
-	size_t queue_size;
+	uint64_t next_page;
 
 	/**
-	 * The #page which is currently being sent to the client.
+	 * The #page which is currently being sent to the client; it
+	 * holds a reference, because the page ring may drop it
+	 * before it is finished.
 	 */
 	Page *current_page;
 
@@ -115,6 +118,19 @@ class HttpdClient final
 	 */
 	Page *metadata;
 
+	/**
+	 * New metadata submitted by PushMetaData(), to replace
+	 * #metadata as soon as the current metadata block is
+	 * complete.  Protected by the httpd mutex.
+	 */
+	Page *pending_metadata;
+
+	/**
+	 * Shall the client skip all pages which have not been sent
+	 * yet?  See CancelQueue().  Protected by the httpd mutex.
+	 */
+	bool cancel_pending;
+
 	/*
 	 * The amount of bytes which were already sent from the metadata.
 	 */
@@ -131,9 +147,14 @@ public:
 	 * @param httpd the HTTP output device
 	 * @param _fd the socket file descriptor
 	 */
-	HttpdClient(HttpdOutput &httpd, int _fd, EventLoop &_loop,
+	HttpdClient(HttpdOutput &httpd, HttpdClientGroup &_group,
+		    int _fd, EventLoop &_loop,
 		    bool _metadata_supported);
 
+	HttpdClientGroup &GetGroup() {
+		return group;
+	}
+
 	/**
 	 * Note: this does not remove the client from the
 	 * #HttpdOutput object.
@@ -148,7 +169,8 @@ public:
 	void LockClose();
 
 	/**
-	 * Clears the page queue.
+	 * Skips all pages which have not been sent yet.  Caller must
+	 * lock the mutex.
 	 */
 	void CancelQueue();
 
@@ -167,26 +189,47 @@ public:
 	 */
 	bool SendResponse();
 
-	gcc_pure
-	ssize_t GetBytesTillMetaData() const;
-
-	ssize_t TryWritePage(const Page &page, size_t position);
-	ssize_t TryWritePageN(const Page &page, size_t position, ssize_t n);
-
 	bool TryWrite();
 
 	/**
-	 * Appends a page to the client's queue.
+	 * Sends the given page before all others; called after the
+	 * response headers.
+	 */
+	void PushHeader(Page &page);
+
+	/**
+	 * New pages have been added to the ring.  Called from within
+	 * the client's #EventLoop.
 	 */
-	void PushPage(Page *page);
+	void Wake();
 
 	/**
-	 * Sends the passed metadata.
+	 * Sends the passed metadata.  Caller must lock the mutex.
 	 */
 	void PushMetaData(Page *page);
 
 private:
-	void ClearQueue();
+	struct Chunk;
+
+	/**
+	 * Fill the arrays with the data which is ready to be sent:
+	 * the rest of the current page and the following pages from
+	 * the ring, interleaved with ICY metadata.  Pages from the
+	 * ring are referenced, so they can be sent without holding
+	 * the mutex.  Caller must lock the mutex.
+	 *
+	 * @return the number of items
+	 */
+	size_t PrepareWrite(struct iovec *v, Chunk *chunks,
+			    size_t max_n) const;
+
+	/**
+	 * Advance after data prepared by PrepareWrite() has been
+	 * sent, and release the references.  This accesses only
+	 * attributes which are owned by this client's thread.
+	 */
+	void ConsumeWrite(const struct iovec *v, Chunk *chunks, size_t n,
+			  size_t nbytes);
 
 protected:
 	virtual bool OnSocketReady(unsigned flags) override;
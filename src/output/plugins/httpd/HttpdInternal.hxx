@@ -26,9 +26,12 @@
 #define MPD_OUTPUT_HTTPD_INTERNAL_H
 
 #include "HttpdClient.hxx"
+#include "PageRing.hxx"
 #include "output/Internal.hxx"
 #include "output/Timer.hxx"
 #include "thread/Mutex.hxx"
+#include "thread/Thread.hxx"
+#include "event/Loop.hxx"
 #include "event/ServerSocket.hxx"
 #include "event/DeferredMonitor.hxx"
 #include "util/Cast.hxx"
@@ -36,8 +39,8 @@
 
 #include <boost/intrusive/list.hpp>
 
-#include <queue>
 #include <list>
+#include <vector>
 
 struct ConfigBlock;
 class Error;
@@ -49,7 +52,93 @@ class PreparedEncoder;
 class Encoder;
 struct Tag;
 
-class HttpdOutput final : ServerSocket, DeferredMonitor {
+class HttpdOutput;
+
+/**
+ * The clients of one #HttpdOutput which are handled by one
+ * #EventLoop.  All its attributes are protected by the output's
+ * mutex.
+ */
+class HttpdClientGroup final : DeferredMonitor {
+	HttpdOutput &httpd;
+
+	/**
+	 * Sockets accepted by the listener, to be picked up by
+	 * RunDeferred().
+	 */
+	std::vector<int> new_clients;
+
+public:
+	typedef boost::intrusive::list<HttpdClient,
+				       boost::intrusive::constant_time_size<true>> ClientList;
+
+	/**
+	 * Modified only within the #EventLoop (with the mutex
+	 * locked), so that thread may traverse it without the lock.
+	 */
+	ClientList clients;
+
+	HttpdClientGroup(HttpdOutput &_httpd, EventLoop &_loop)
+		:DeferredMonitor(_loop), httpd(_httpd) {}
+
+	~HttpdClientGroup() {
+		assert(new_clients.empty());
+		assert(clients.empty());
+	}
+
+	using DeferredMonitor::GetEventLoop;
+
+	/**
+	 * Submit a new connection.  Caller must lock the mutex.
+	 */
+	void Add(int fd) {
+		new_clients.push_back(fd);
+		DeferredMonitor::Schedule();
+	}
+
+	/**
+	 * Let all clients check for new pages.  This method is
+	 * thread-safe.
+	 */
+	void Wake() {
+		DeferredMonitor::Schedule();
+	}
+
+	/**
+	 * Disconnect all clients.  Must be called from within the
+	 * #EventLoop, with the mutex locked.
+	 *
+	 * @return the number of clients
+	 */
+	unsigned Clear();
+
+private:
+	/* virtual methods from class DeferredMonitor */
+	void RunDeferred() override;
+};
+
+/**
+ * A thread with its own #EventLoop for one #HttpdClientGroup (see
+ * setting "io_threads").
+ */
+class HttpdThread {
+	EventLoop loop;
+
+	Thread thread;
+
+public:
+	EventLoop &GetEventLoop() {
+		return loop;
+	}
+
+	bool Start(Error &error);
+	void Stop();
+
+private:
+	static void ThreadFunc(void *ctx);
+};
+
+class HttpdOutput final : ServerSocket {
 	AudioOutput base;
 
 	/**
@@ -72,6 +161,13 @@ class HttpdOutput final : ServerSocket, DeferredMonitor {
 	 */
 	size_t unflushed_input;
 
+	/**
+	 * Flush the encoder after every chunk and disable Nagle's
+	 * algorithm on client sockets, trading bandwidth efficiency
+	 * for latency.  Configured with "low_latency".
+	 */
+	bool low_latency;
+
 public:
 	/**
 	 * The MIME type produced by the #encoder.
@@ -79,17 +175,11 @@ public:
 	const char *content_type;
 
 	/**
-	 * This mutex protects the listener socket and the client
-	 * list.
+	 * This mutex protects the listener socket, the client lists
+	 * and the page ring.
 	 */
 	mutable Mutex mutex;
 
-	/**
-	 * This condition gets signalled when an item is removed from
-	 * #pages.
-	 */
-	Cond cond;
-
 private:
 	/**
 	 * A #Timer object to synchronize this output with the
@@ -107,13 +197,12 @@ private:
 	 */
 	Page *metadata;
 
+public:
 	/**
-	 * The page queue, i.e. pages from the encoder to be
-	 * broadcasted to all clients.  This container is necessary to
-	 * pass pages from the OutputThread to the IOThread.  It is
-	 * protected by #mutex, and removing signals #cond.
+	 * The most recent pages from the encoder, to be sent to all
+	 * clients.  Each client keeps a cursor into this ring.
 	 */
-	std::queue<Page *, std::list<Page *>> pages;
+	PageRing pages;
 
  public:
 	/**
@@ -131,11 +220,23 @@ private:
 
 private:
 	/**
-	 * A linked list containing all clients which are currently
-	 * connected.
+	 * The threads configured with "io_threads".  The list is empty
+	 * if the clients are handled by the I/O thread which listens.
+	 */
+	std::list<HttpdThread> threads;
+
+	/**
+	 * One group of clients per #EventLoop.  New connections are
+	 * distributed round-robin.
+	 */
+	std::list<HttpdClientGroup> groups;
+	std::list<HttpdClientGroup>::iterator next_group;
+
+	/**
+	 * The number of clients, including those which have been
+	 * accepted but not yet picked up by their group.
 	 */
-	boost::intrusive::list<HttpdClient,
-			       boost::intrusive::constant_time_size<true>> clients;
+	unsigned n_clients = 0;
 
 	/**
 	 * A temporary buffer for the httpd_output_read_page()
@@ -160,7 +261,7 @@ public:
 		return &ContainerCast(*ao, &HttpdOutput::base);
 	}
 
-	using DeferredMonitor::GetEventLoop;
+	using ServerSocket::GetEventLoop;
 
 	bool Init(const ConfigBlock &block, Error &error);
 
@@ -202,7 +303,7 @@ public:
 	 */
 	gcc_pure
 	bool HasClients() const {
-		return !clients.empty();
+		return n_clients > 0;
 	}
 
 	/**
@@ -214,22 +315,38 @@ public:
 		return HasClients();
 	}
 
-	void AddClient(int fd);
+	/**
+	 * Creates a new #HttpdClient object in the given group.  Called
+	 * from within the group's #EventLoop, with the mutex locked.
+	 */
+	void AddClient(HttpdClientGroup &group, int fd);
 
 	/**
-	 * Removes a client from the httpd_output.clients linked list.
+	 * Removes a client from its group and deletes it.  Caller
+	 * must lock the mutex.
 	 */
 	void RemoveClient(HttpdClient &client);
 
 	/**
 	 * Sends the encoder header to the client.  This is called
-	 * right after the response headers have been sent.
+	 * right after the response headers have been sent.  Caller
+	 * must lock the mutex.
 	 */
 	void SendHeader(HttpdClient &client) const;
 
 	gcc_pure
 	unsigned Delay() const;
 
+	/**
+	 * Returns how far the stream is ahead of real time, i.e. how
+	 * much audio has been passed to the clients but should not
+	 * have been heard yet [us].
+	 */
+	gcc_pure
+	unsigned Latency() const {
+		return timer->GetLatency();
+	}
+
 	/**
 	 * Reads data from the encoder (as much as available) and
 	 * returns it as a new #page object.
@@ -237,14 +354,14 @@ public:
 	Page *ReadPage();
 
 	/**
-	 * Broadcasts a page struct to all clients.
-	 *
-	 * Mutext must not be locked.
+	 * Wake up all client groups after pages have been added.
 	 */
-	void BroadcastPage(Page *page);
+	void WakeClients();
 
 	/**
 	 * Broadcasts data from the encoder to all clients.
+	 *
+	 * Mutex must not be locked.
 	 */
 	void BroadcastFromEncoder();
 
@@ -257,8 +374,6 @@ public:
 	void CancelAllClients();
 
 private:
-	virtual void RunDeferred() override;
-
 	void OnAccept(int fd, SocketAddress address, int uid) override;
 };
 
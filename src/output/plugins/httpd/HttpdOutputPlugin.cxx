@@ -25,12 +25,17 @@
 #include "encoder/EncoderInterface.hxx"
 #include "encoder/EncoderPlugin.hxx"
 #include "encoder/EncoderList.hxx"
+#include "encoder/SharedEncoder.hxx"
+#include "encoder/ThreadedEncoder.hxx"
 #include "net/SocketAddress.hxx"
+#include "net/SocketUtil.hxx"
 #include "net/ToString.hxx"
 #include "Page.hxx"
 #include "IcyMetaDataServer.hxx"
 #include "system/fd_util.h"
 #include "IOThread.hxx"
+#include "ThreadSettings.hxx"
+#include "thread/Name.hxx"
 #include "event/Call.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
@@ -49,17 +54,84 @@
 
 const Domain httpd_output_domain("httpd_output");
 
+bool
+HttpdThread::Start(Error &error)
+{
+	return thread.Start(ThreadFunc, this, error);
+}
+
+void
+HttpdThread::Stop()
+{
+	if (!thread.IsDefined())
+		return;
+
+	BlockingCall(loop, [this](){
+			loop.Break();
+		});
+
+	thread.Join();
+}
+
+void
+HttpdThread::ThreadFunc(void *ctx)
+{
+	SetThreadName("httpd");
+	ApplyThreadSettings("httpd");
+
+	HttpdThread &t = *(HttpdThread *)ctx;
+	t.loop.Run();
+}
+
+unsigned
+HttpdClientGroup::Clear()
+{
+	unsigned n = new_clients.size() + clients.size();
+
+	for (int fd : new_clients)
+		close_socket(fd);
+	new_clients.clear();
+
+	clients.clear_and_dispose(DeleteDisposer());
+
+	return n;
+}
+
+void
+HttpdClientGroup::RunDeferred()
+{
+	/* this method runs in the group's EventLoop; it creates the
+	   new clients and lets all clients check for new pages */
+
+	if (!new_clients.empty()) {
+		const ScopeLock protect(httpd.mutex);
+
+		for (int fd : new_clients)
+			httpd.AddClient(*this, fd);
+		new_clients.clear();
+	}
+
+	/* the list is modified only in this thread, so it can be
+	   traversed without holding the mutex */
+	for (auto &client : clients)
+		client.Wake();
+}
+
 inline
 HttpdOutput::HttpdOutput(EventLoop &_loop)
-	:ServerSocket(_loop), DeferredMonitor(_loop),
+	:ServerSocket(_loop),
 	 base(httpd_output_plugin),
 	 encoder(nullptr), unflushed_input(0),
-	 metadata(nullptr)
+	 metadata(nullptr),
+	 pages(256 * 1024)
 {
 }
 
 HttpdOutput::~HttpdOutput()
 {
+	for (auto &thread : threads)
+		thread.Stop();
+
 	if (metadata != nullptr)
 		metadata->Unref();
 
@@ -109,6 +181,26 @@ HttpdOutput::Configure(const ConfigBlock &block, Error &error)
 
 	clients_max = block.GetBlockValue("max_clients", 0u);
 
+	low_latency = block.GetBlockValue("low_latency", false);
+
+	/* set up the client groups */
+
+	const unsigned n_threads = block.GetBlockValue("io_threads", 0u);
+	for (unsigned i = 0; i < n_threads; ++i) {
+		threads.emplace_back();
+		if (!threads.back().Start(error))
+			return false;
+
+		groups.emplace_back(*this, threads.back().GetEventLoop());
+	}
+
+	if (groups.empty())
+		/* handle the clients in the I/O thread which
+		   listens */
+		groups.emplace_back(*this, GetEventLoop());
+
+	next_group = groups.begin();
+
 	/* set up bind_to_address */
 
 	const char *bind_to_address = block.GetBlockValue("bind_to_address");
@@ -121,7 +213,12 @@ HttpdOutput::Configure(const ConfigBlock &block, Error &error)
 
 	/* initialize encoder */
 
-	prepared_encoder = encoder_init(*encoder_plugin, block, error);
+	prepared_encoder = encoder_init_shared(*encoder_plugin, block, error);
+	if (prepared_encoder == nullptr)
+		return false;
+
+	prepared_encoder = encoder_wrap_threaded(prepared_encoder, block,
+						 error);
 	if (prepared_encoder == nullptr)
 		return false;
 
@@ -142,7 +239,7 @@ HttpdOutput::Init(const ConfigBlock &block, Error &error)
 static AudioOutput *
 httpd_output_init(const ConfigBlock &block, Error &error)
 {
-	HttpdOutput *httpd = new HttpdOutput(io_thread_get());
+	HttpdOutput *httpd = new HttpdOutput(io_thread_get(IOThreadRole::OUTPUT));
 
 	AudioOutput *result = httpd->InitAndConfigure(block, error);
 	if (result == nullptr)
@@ -159,43 +256,17 @@ httpd_output_finish(AudioOutput *ao)
 	delete httpd;
 }
 
-/**
- * Creates a new #HttpdClient object and adds it into the
- * HttpdOutput.clients linked list.
- */
-inline void
-HttpdOutput::AddClient(int fd)
+void
+HttpdOutput::AddClient(HttpdClientGroup &group, int fd)
 {
-	auto *client = new HttpdClient(*this, fd, GetEventLoop(),
+	auto *client = new HttpdClient(*this, group, fd,
+				       group.GetEventLoop(),
 				       !encoder->ImplementsTag());
-	clients.push_front(*client);
+	group.clients.push_front(*client);
 
 	/* pass metadata to client */
 	if (metadata != nullptr)
-		clients.front().PushMetaData(metadata);
-}
-
-void
-HttpdOutput::RunDeferred()
-{
-	/* this method runs in the IOThread; it broadcasts pages from
-	   our own queue to all clients */
-
-	const ScopeLock protect(mutex);
-
-	while (!pages.empty()) {
-		Page *page = pages.front();
-		pages.pop();
-
-		for (auto &client : clients)
-			client.PushPage(page);
-
-		page->Unref();
-	}
-
-	/* wake up the client that may be waiting for the queue to be
-	   flushed */
-	cond.broadcast();
+		client->PushMetaData(metadata);
 }
 
 void
@@ -232,9 +303,24 @@ HttpdOutput::OnAccept(int fd, SocketAddress address, gcc_unused int uid)
 
 	if (fd >= 0) {
 		/* can we allow additional client */
-		if (open && (clients_max == 0 || clients.size() < clients_max))
-			AddClient(fd);
-		else
+		if (open && (clients_max == 0 || n_clients < clients_max)) {
+			/* the client is created by its group, in the
+			   group's thread */
+			++n_clients;
+			base.listeners.store(n_clients,
+					     std::memory_order_relaxed);
+
+			if (low_latency)
+				/* don't let the kernel hold back small
+				   pages; this fails harmlessly on
+				   local sockets */
+				socket_set_nodelay(fd, true);
+
+			next_group->Add(fd);
+
+			if (++next_group == groups.end())
+				next_group = groups.begin();
+		} else
 			close_socket(fd);
 	} else if (fd < 0 && errno != EINTR) {
 		LogErrno(httpd_output_domain, "accept() failed");
@@ -307,7 +393,7 @@ inline bool
 HttpdOutput::Open(AudioFormat &audio_format, Error &error)
 {
 	assert(!open);
-	assert(clients.empty());
+	assert(n_clients == 0);
 
 	/* open the encoder */
 
@@ -338,13 +424,28 @@ HttpdOutput::Close()
 {
 	assert(open);
 
+	mutex.lock();
 	open = false;
+	mutex.unlock();
 
 	delete timer;
 
-	BlockingCall(GetEventLoop(), [this](){
-			clients.clear_and_dispose(DeleteDisposer());
-		});
+	/* each group disconnects its clients in its own thread; the
+	   mutex must not be held while waiting for them */
+	for (auto &group : groups) {
+		BlockingCall(group.GetEventLoop(), [this, &group](){
+				const ScopeLock protect(mutex);
+				n_clients -= group.Clear();
+				base.listeners.store(n_clients,
+						     std::memory_order_relaxed);
+			});
+	}
+
+	assert(n_clients == 0);
+
+	mutex.lock();
+	pages.Clear();
+	mutex.unlock();
 
 	if (header != nullptr)
 		header->Unref();
@@ -357,24 +458,27 @@ httpd_output_close(AudioOutput *ao)
 {
 	HttpdOutput *httpd = HttpdOutput::Cast(ao);
 
-	const ScopeLock protect(httpd->mutex);
 	httpd->Close();
 }
 
 void
 HttpdOutput::RemoveClient(HttpdClient &client)
 {
-	assert(!clients.empty());
+	auto &group = client.GetGroup();
+
+	assert(n_clients > 0);
+	--n_clients;
+	base.listeners.store(n_clients, std::memory_order_relaxed);
 
-	clients.erase_and_dispose(clients.iterator_to(client),
-				  DeleteDisposer());
+	group.clients.erase_and_dispose(group.clients.iterator_to(client),
+					DeleteDisposer());
 }
 
 void
 HttpdOutput::SendHeader(HttpdClient &client) const
 {
 	if (header != nullptr)
-		client.PushPage(header);
+		client.PushHeader(*header);
 }
 
 inline unsigned
@@ -406,34 +510,37 @@ httpd_output_delay(AudioOutput *ao)
 	return httpd->Delay();
 }
 
-void
-HttpdOutput::BroadcastPage(Page *page)
+static unsigned
+httpd_output_latency(AudioOutput *ao)
 {
-	assert(page != nullptr);
+	HttpdOutput *httpd = HttpdOutput::Cast(ao);
 
-	mutex.lock();
-	pages.push(page);
-	page->Ref();
-	mutex.unlock();
+	return httpd->Latency();
+}
 
-	DeferredMonitor::Schedule();
+void
+HttpdOutput::WakeClients()
+{
+	for (auto &group : groups)
+		group.Wake();
 }
 
 void
 HttpdOutput::BroadcastFromEncoder()
 {
-	/* synchronize with the IOThread */
-	mutex.lock();
-	while (!pages.empty())
-		cond.wait(mutex);
+	Page *page = ReadPage();
+	if (page == nullptr)
+		return;
 
-	Page *page;
-	while ((page = ReadPage()) != nullptr)
-		pages.push(page);
+	do {
+		mutex.lock();
+		pages.Push(*page);
+		mutex.unlock();
 
-	mutex.unlock();
+		page->Unref();
+	} while ((page = ReadPage()) != nullptr);
 
-	DeferredMonitor::Schedule();
+	WakeClients();
 }
 
 inline bool
@@ -444,6 +551,13 @@ HttpdOutput::EncodeAndPlay(const void *chunk, size_t size, Error &error)
 
 	unflushed_input += size;
 
+	if (low_latency) {
+		/* don't wait for the encoder to fill a whole page;
+		   emit what it has right now */
+		encoder->Flush(IgnoreError());
+		unflushed_input = 0;
+	}
+
 	BroadcastFromEncoder();
 	return true;
 }
@@ -451,6 +565,10 @@ HttpdOutput::EncodeAndPlay(const void *chunk, size_t size, Error &error)
 inline size_t
 HttpdOutput::Play(const void *chunk, size_t size, Error &error)
 {
+	/* deliver the data exactly on time, not up to a millisecond
+	   early */
+	timer->SleepRemainder();
+
 	if (LockHasClients()) {
 		if (!EncodeAndPlay(chunk, size, error))
 			return 0;
@@ -508,28 +626,51 @@ HttpdOutput::SendTag(const Tag &tag)
 
 		Page *page = ReadPage();
 		if (page != nullptr) {
+			/* replace the header and broadcast it
+			   atomically, so a new client gets it exactly
+			   once */
+			mutex.lock();
 			if (header != nullptr)
 				header->Unref();
 			header = page;
-			BroadcastPage(page);
+			pages.Push(*page);
+			mutex.unlock();
+
+			WakeClients();
 		}
 	} else {
 		/* use Icy-Metadata */
 
-		if (metadata != nullptr)
-			metadata->Unref();
-
 		static constexpr TagType types[] = {
 			TAG_ALBUM, TAG_ARTIST, TAG_TITLE,
 			TAG_NUM_OF_ITEM_TYPES
 		};
 
-		metadata = icy_server_metadata_page(tag, &types[0]);
-		if (metadata != nullptr) {
-			const ScopeLock protect(mutex);
-			for (auto &client : clients)
-				client.PushMetaData(metadata);
-		}
+		char icy_buffer[ICY_METADATA_MAX_SIZE];
+		const size_t size =
+			icy_server_metadata_format(icy_buffer, tag, &types[0]);
+
+		/* relayed radio streams repeat the same title in
+		   every metadata block; don't bother the clients with
+		   it */
+		if (metadata != nullptr && size == metadata->size &&
+		    memcmp(metadata->data, icy_buffer, size) == 0)
+			return;
+
+		Page *page = size > 0
+			? Page::Copy(icy_buffer, size)
+			: nullptr;
+
+		const ScopeLock protect(mutex);
+
+		if (metadata != nullptr)
+			metadata->Unref();
+
+		metadata = page;
+		if (metadata != nullptr)
+			for (auto &group : groups)
+				for (auto &client : group.clients)
+					client.PushMetaData(metadata);
 	}
 }
 
@@ -546,16 +687,11 @@ HttpdOutput::CancelAllClients()
 {
 	const ScopeLock protect(mutex);
 
-	while (!pages.empty()) {
-		Page *page = pages.front();
-		pages.pop();
-		page->Unref();
-	}
-
-	for (auto &client : clients)
-		client.CancelQueue();
+	pages.Clear();
 
-	cond.broadcast();
+	for (auto &group : groups)
+		for (auto &client : group.clients)
+			client.CancelQueue();
 }
 
 static void
@@ -563,9 +699,7 @@ httpd_output_cancel(AudioOutput *ao)
 {
 	HttpdOutput *httpd = HttpdOutput::Cast(ao);
 
-	BlockingCall(io_thread_get(), [httpd](){
-			httpd->CancelAllClients();
-		});
+	httpd->CancelAllClients();
 }
 
 const struct AudioOutputPlugin httpd_output_plugin = {
@@ -583,5 +717,6 @@ const struct AudioOutputPlugin httpd_output_plugin = {
 	nullptr,
 	httpd_output_cancel,
 	httpd_output_pause,
+	httpd_output_latency,
 	nullptr,
 };
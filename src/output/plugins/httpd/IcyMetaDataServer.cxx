@@ -19,13 +19,13 @@
 
 #include "config.h"
 #include "IcyMetaDataServer.hxx"
-#include "Page.hxx"
 #include "tag/Tag.hxx"
 #include "util/FormatString.hxx"
 #include "util/AllocatedString.hxx"
 #include "util/StringUtil.hxx"
 #include "util/Macros.hxx"
 
+#include <stdio.h>
 #include <string.h>
 
 AllocatedString<>
@@ -55,31 +55,9 @@ icy_server_metadata_header(const char *name,
 			    content_type);
 }
 
-static AllocatedString<>
-icy_server_metadata_string(const char *stream_title, const char* stream_url)
-{
-	// The leading n is a placeholder for the length information
-	auto icy_metadata = FormatString("nStreamTitle='%s';"
-					 "StreamUrl='%s';",
-					 stream_title,
-					 stream_url);
-
-	size_t meta_length = strlen(icy_metadata.c_str());
-
-	meta_length--; // subtract placeholder
-
-	meta_length = ((int)meta_length / 16) + 1;
-
-	icy_metadata[0] = meta_length;
-
-	if (meta_length > 255)
-		return nullptr;
-
-	return icy_metadata;
-}
-
-Page *
-icy_server_metadata_page(const Tag &tag, const TagType *types)
+size_t
+icy_server_metadata_format(char *buffer, const Tag &tag,
+			   const TagType *types)
 {
 	const char *tag_items[TAG_NUM_OF_ITEM_TYPES];
 
@@ -104,10 +82,19 @@ icy_server_metadata_page(const Tag &tag, const TagType *types)
 			p = CopyString(p, " - ", end - p);
 	}
 
-	const auto icy_string = icy_server_metadata_string(stream_title, "");
+	/* the first byte is the number of 16 byte blocks which
+	   follow */
+	const int length = snprintf(buffer + 1, ICY_METADATA_MAX_SIZE - 1,
+				    "StreamTitle='%s';StreamUrl='%s';",
+				    stream_title, "");
+	if (length <= 0 || size_t(length) >= ICY_METADATA_MAX_SIZE - 1)
+		return 0;
+
+	const size_t n_blocks = (length + 15) / 16;
 
-	if (icy_string.IsNull())
-		return nullptr;
+	/* pad the last block with null bytes */
+	memset(buffer + 1 + length, 0, n_blocks * 16 - length);
 
-	return Page::Copy(icy_string.c_str(), (icy_string[0] * 16) + 1);
+	buffer[0] = n_blocks;
+	return 1 + n_blocks * 16;
 }
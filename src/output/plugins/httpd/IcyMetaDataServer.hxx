@@ -22,8 +22,9 @@
 
 #include "tag/TagType.h"
 
+#include <stddef.h>
+
 struct Tag;
-class Page;
 template<typename T> class AllocatedString;
 
 AllocatedString<char>
@@ -31,7 +32,21 @@ icy_server_metadata_header(const char *name,
 			   const char *genre, const char *url,
 			   const char *content_type, int metaint);
 
-Page *
-icy_server_metadata_page(const Tag &tag, const TagType *types);
+/**
+ * The maximum size of an ICY metadata block: one length byte and up
+ * to 255 blocks of 16 bytes.
+ */
+static constexpr size_t ICY_METADATA_MAX_SIZE = 1 + 255 * 16;
+
+/**
+ * Format an ICY metadata block (including the length byte and the
+ * padding) into the given buffer, which must be at least
+ * #ICY_METADATA_MAX_SIZE bytes large.
+ *
+ * @return the size of the block, or 0 on error
+ */
+size_t
+icy_server_metadata_format(char *buffer, const Tag &tag,
+			   const TagType *types);
 
 #endif
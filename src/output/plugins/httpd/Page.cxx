@@ -20,6 +20,7 @@
 #include "config.h"
 #include "Page.hxx"
 #include "util/Alloc.hxx"
+#include "util/MemStats.hxx"
 
 #include <new>
 
@@ -27,11 +28,21 @@
 #include <string.h>
 #include <stdlib.h>
 
+/**
+ * The size of a #Page allocation (for memory accounting).
+ */
+static constexpr size_t
+GetAllocationSize(size_t size)
+{
+	return sizeof(Page) + size - sizeof(Page::data);
+}
+
 Page *
 Page::Create(size_t size)
 {
-	void *p = xalloc(sizeof(Page) + size -
-			 sizeof(Page::data));
+	const size_t allocation_size = GetAllocationSize(size);
+	void *p = xalloc(allocation_size);
+	MemStatsAllocate(MemStatsCategory::HTTPD_PAGE, allocation_size);
 	return ::new(p) Page(size);
 }
 
@@ -62,6 +73,8 @@ Page::Unref()
 	bool unused = ref.Decrement();
 
 	if (unused) {
+		MemStatsFree(MemStatsCategory::HTTPD_PAGE,
+			     GetAllocationSize(size));
 		this->Page::~Page();
 		free(this);
 	}
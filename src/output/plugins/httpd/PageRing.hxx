@@ -0,0 +1,119 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_OUTPUT_HTTPD_PAGE_RING_HXX
+#define MPD_OUTPUT_HTTPD_PAGE_RING_HXX
+
+#include "Compiler.h"
+
+#include <array>
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+class Page;
+
+/**
+ * A ring of the most recent #Page objects produced by the encoder,
+ * shared by all clients of one httpd output.  Each client keeps its
+ * own cursor, i.e. the sequence number of the next page to be sent;
+ * this replaces a per-client page queue.
+ *
+ * Pages are numbered consecutively from the start; the oldest ones
+ * are dropped as soon as the ring exceeds its byte limit (or its
+ * capacity).  A client whose cursor falls behind GetBegin() is too
+ * slow to keep up.
+ *
+ * This class is not thread-safe; the httpd output protects it with
+ * its mutex.
+ */
+class PageRing {
+	static constexpr size_t CAPACITY = 256;
+
+	struct Item {
+		Page *page;
+
+		/**
+		 * The stream position of this page's first byte.
+		 */
+		uint64_t offset;
+	};
+
+	std::array<Item, CAPACITY> items;
+
+	/**
+	 * The sequence numbers of the oldest page and of the next
+	 * page to be pushed.
+	 */
+	uint64_t begin = 0, end = 0;
+
+	/**
+	 * The stream position after the most recent page.
+	 */
+	uint64_t end_offset = 0;
+
+	/**
+	 * The ring drops old pages as soon as they are no longer
+	 * needed to keep this many bytes.
+	 */
+	const size_t max_bytes;
+
+public:
+	explicit PageRing(size_t _max_bytes):max_bytes(_max_bytes) {}
+
+	~PageRing() {
+		Clear();
+	}
+
+	PageRing(const PageRing &) = delete;
+	PageRing &operator=(const PageRing &) = delete;
+
+	uint64_t GetBegin() const {
+		return begin;
+	}
+
+	uint64_t GetEnd() const {
+		return end;
+	}
+
+	Page &Get(uint64_t seq) const {
+		assert(seq >= begin);
+		assert(seq < end);
+
+		return *items[seq % CAPACITY].page;
+	}
+
+	/**
+	 * Append a page; the ring adds a reference.
+	 */
+	void Push(Page &page);
+
+	/**
+	 * Drop all pages.  The sequence numbers continue, i.e. all
+	 * cursors now point before GetBegin().
+	 */
+	void Clear();
+
+private:
+	void PopFront();
+};
+
+#endif
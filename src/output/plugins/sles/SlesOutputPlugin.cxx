@@ -478,4 +478,5 @@ const struct AudioOutputPlugin sles_output_plugin = {
 	&Wrapper::Cancel,
 	&Wrapper::Pause,
 	nullptr,
+	nullptr,
 };
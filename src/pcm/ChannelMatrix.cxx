@@ -0,0 +1,336 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "ChannelMatrix.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <math.h>
+
+namespace {
+
+enum class Speaker : unsigned char {
+	FRONT_LEFT,
+	FRONT_RIGHT,
+	FRONT_CENTER,
+	LFE,
+	BACK_LEFT,
+	BACK_RIGHT,
+	BACK_CENTER,
+	SIDE_LEFT,
+	SIDE_RIGHT,
+	NONE,
+};
+
+/**
+ * The default speaker layout for each channel count (FLAC/WAVE
+ * order).
+ */
+static constexpr Speaker layouts[MAX_CHANNELS][MAX_CHANNELS] = {
+	{ Speaker::FRONT_CENTER,
+	  Speaker::NONE, Speaker::NONE, Speaker::NONE,
+	  Speaker::NONE, Speaker::NONE, Speaker::NONE, Speaker::NONE },
+
+	{ Speaker::FRONT_LEFT, Speaker::FRONT_RIGHT,
+	  Speaker::NONE, Speaker::NONE,
+	  Speaker::NONE, Speaker::NONE, Speaker::NONE, Speaker::NONE },
+
+	{ Speaker::FRONT_LEFT, Speaker::FRONT_RIGHT, Speaker::FRONT_CENTER,
+	  Speaker::NONE,
+	  Speaker::NONE, Speaker::NONE, Speaker::NONE, Speaker::NONE },
+
+	{ Speaker::FRONT_LEFT, Speaker::FRONT_RIGHT,
+	  Speaker::BACK_LEFT, Speaker::BACK_RIGHT,
+	  Speaker::NONE, Speaker::NONE, Speaker::NONE, Speaker::NONE },
+
+	{ Speaker::FRONT_LEFT, Speaker::FRONT_RIGHT, Speaker::FRONT_CENTER,
+	  Speaker::BACK_LEFT, Speaker::BACK_RIGHT,
+	  Speaker::NONE, Speaker::NONE, Speaker::NONE },
+
+	{ Speaker::FRONT_LEFT, Speaker::FRONT_RIGHT, Speaker::FRONT_CENTER,
+	  Speaker::LFE, Speaker::BACK_LEFT, Speaker::BACK_RIGHT,
+	  Speaker::NONE, Speaker::NONE },
+
+	{ Speaker::FRONT_LEFT, Speaker::FRONT_RIGHT, Speaker::FRONT_CENTER,
+	  Speaker::LFE, Speaker::BACK_CENTER,
+	  Speaker::SIDE_LEFT, Speaker::SIDE_RIGHT,
+	  Speaker::NONE },
+
+	{ Speaker::FRONT_LEFT, Speaker::FRONT_RIGHT, Speaker::FRONT_CENTER,
+	  Speaker::LFE, Speaker::BACK_LEFT, Speaker::BACK_RIGHT,
+	  Speaker::SIDE_LEFT, Speaker::SIDE_RIGHT },
+};
+
+class LayoutMatrix {
+	PcmChannelMatrix &m;
+	const Speaker *const dest_layout;
+	unsigned src;
+
+public:
+	LayoutMatrix(PcmChannelMatrix &_m)
+		:m(_m), dest_layout(layouts[m.dest_channels - 1]) {}
+
+	void SetSource(unsigned _src) {
+		src = _src;
+	}
+
+	/**
+	 * Route the current source channel to the given speaker.
+	 *
+	 * @return false if the output layout does not have this
+	 * speaker
+	 */
+	bool Add(Speaker speaker, float gain) {
+		for (unsigned d = 0; d < m.dest_channels; ++d) {
+			if (dest_layout[d] == speaker) {
+				m.coefficients[d][src] += gain;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	bool Has(Speaker speaker) const {
+		return std::find(dest_layout, dest_layout + m.dest_channels,
+				 speaker) != dest_layout + m.dest_channels;
+	}
+
+	bool AddPair(Speaker left, Speaker right, float gain) {
+		if (!Has(left) || !Has(right))
+			return false;
+
+		Add(left, gain);
+		Add(right, gain);
+		return true;
+	}
+};
+
+}
+
+void
+PcmChannelMatrix::Setup(unsigned _src_channels, unsigned _dest_channels)
+{
+	assert(audio_valid_channel_count(_src_channels));
+	assert(audio_valid_channel_count(_dest_channels));
+
+	src_channels = _src_channels;
+	dest_channels = _dest_channels;
+
+	for (auto &row : coefficients)
+		std::fill_n(row, MAX_CHANNELS, 0);
+
+	if (src_channels == 1) {
+		for (unsigned d = 0; d < dest_channels; ++d)
+			coefficients[d][0] = 1;
+		return;
+	}
+
+	constexpr float HALF = M_SQRT1_2;
+
+	LayoutMatrix lm(*this);
+	const Speaker *const src_layout = layouts[src_channels - 1];
+
+	for (unsigned s = 0; s < src_channels; ++s) {
+		const Speaker speaker = src_layout[s];
+		lm.SetSource(s);
+
+		if (lm.Add(speaker, 1))
+			continue;
+
+		switch (speaker) {
+		case Speaker::FRONT_LEFT:
+		case Speaker::FRONT_RIGHT:
+			lm.Add(Speaker::FRONT_CENTER, HALF);
+			break;
+
+		case Speaker::FRONT_CENTER:
+			lm.AddPair(Speaker::FRONT_LEFT, Speaker::FRONT_RIGHT,
+				   HALF);
+			break;
+
+		case Speaker::LFE:
+		case Speaker::NONE:
+			break;
+
+		case Speaker::BACK_LEFT:
+			lm.Add(Speaker::SIDE_LEFT, 1) ||
+				lm.Add(Speaker::FRONT_LEFT, HALF) ||
+				lm.Add(Speaker::FRONT_CENTER, 0.5);
+			break;
+
+		case Speaker::BACK_RIGHT:
+			lm.Add(Speaker::SIDE_RIGHT, 1) ||
+				lm.Add(Speaker::FRONT_RIGHT, HALF) ||
+				lm.Add(Speaker::FRONT_CENTER, 0.5);
+			break;
+
+		case Speaker::SIDE_LEFT:
+			lm.Add(Speaker::BACK_LEFT, 1) ||
+				lm.Add(Speaker::FRONT_LEFT, HALF) ||
+				lm.Add(Speaker::FRONT_CENTER, 0.5);
+			break;
+
+		case Speaker::SIDE_RIGHT:
+			lm.Add(Speaker::BACK_RIGHT, 1) ||
+				lm.Add(Speaker::FRONT_RIGHT, HALF) ||
+				lm.Add(Speaker::FRONT_CENTER, 0.5);
+			break;
+
+		case Speaker::BACK_CENTER:
+			lm.AddPair(Speaker::BACK_LEFT, Speaker::BACK_RIGHT,
+				   HALF) ||
+				lm.AddPair(Speaker::SIDE_LEFT,
+					   Speaker::SIDE_RIGHT, HALF) ||
+				lm.AddPair(Speaker::FRONT_LEFT,
+					   Speaker::FRONT_RIGHT, 0.5) ||
+				lm.Add(Speaker::FRONT_CENTER, 0.5);
+			break;
+		}
+	}
+
+	/* scale all channels by the same factor to avoid clipping
+	   without changing the balance */
+	float max_sum = 0;
+	for (unsigned d = 0; d < dest_channels; ++d) {
+		float sum = 0;
+		for (unsigned s = 0; s < src_channels; ++s)
+			sum += coefficients[d][s];
+		max_sum = std::max(max_sum, sum);
+	}
+
+	if (max_sum > 1)
+		for (unsigned d = 0; d < dest_channels; ++d)
+			for (unsigned s = 0; s < src_channels; ++s)
+				coefficients[d][s] /= max_sum;
+}
+
+/**
+ * The type used for calculations: float is exact enough for up to 24
+ * bits.
+ */
+template<SampleFormat F>
+struct MatrixAccumulator {
+	typedef float type;
+};
+
+template<>
+struct MatrixAccumulator<SampleFormat::S32> {
+	typedef double type;
+};
+
+template<SampleFormat F, class Traits>
+static inline typename Traits::value_type
+FromAccumulator(typename MatrixAccumulator<F>::type value)
+{
+	typedef typename MatrixAccumulator<F>::type A;
+
+	if (F == SampleFormat::FLOAT)
+		return value;
+
+	value += value < 0 ? A(-0.5) : A(0.5);
+	value = std::min(std::max(value, A(Traits::MIN)), A(Traits::MAX));
+	return typename Traits::value_type(value);
+}
+
+template<SampleFormat F, class Traits>
+void
+PcmChannelMatrix::Apply(typename Traits::pointer_type dest,
+			typename Traits::const_pointer_type src,
+			size_t n_frames) const
+{
+	typedef typename MatrixAccumulator<F>::type A;
+
+	/* the frames are processed in small blocks, converted to
+	   one array per channel, so the compiler can vectorize the
+	   multiply-add loops */
+	constexpr size_t BLOCK_SIZE = 64;
+	A in[MAX_CHANNELS][BLOCK_SIZE] = {}, out[BLOCK_SIZE];
+
+	while (n_frames > 0) {
+		const size_t n = std::min(n_frames, BLOCK_SIZE);
+
+		for (size_t f = 0; f < n; ++f)
+			for (unsigned s = 0; s < src_channels; ++s)
+				in[s][f] = src[f * src_channels + s];
+
+		for (unsigned d = 0; d < dest_channels; ++d) {
+			/* always the whole block: a constant trip
+			   count is easier to vectorize */
+			std::fill_n(out, BLOCK_SIZE, A(0));
+
+			for (unsigned s = 0; s < src_channels; ++s) {
+				const A c = coefficients[d][s];
+				if (c == 0)
+					continue;
+
+				for (size_t f = 0; f < BLOCK_SIZE; ++f)
+					out[f] += c * in[s][f];
+			}
+
+			for (size_t f = 0; f < n; ++f)
+				dest[f * dest_channels + d] =
+					FromAccumulator<F, Traits>(out[f]);
+		}
+
+		src += n * src_channels;
+		dest += n * dest_channels;
+		n_frames -= n;
+	}
+}
+
+template void
+PcmChannelMatrix::Apply<SampleFormat::S16>(int16_t *dest, const int16_t *src,
+					    size_t n_frames) const;
+
+template void
+PcmChannelMatrix::Apply<SampleFormat::S24_P32>(int32_t *dest,
+						const int32_t *src,
+						size_t n_frames) const;
+
+template void
+PcmChannelMatrix::Apply<SampleFormat::S32>(int32_t *dest, const int32_t *src,
+					    size_t n_frames) const;
+
+template void
+PcmChannelMatrix::Apply<SampleFormat::FLOAT>(float *dest, const float *src,
+					      size_t n_frames) const;
+
+struct ChannelMatrixTable {
+	PcmChannelMatrix matrices[MAX_CHANNELS][MAX_CHANNELS];
+
+	ChannelMatrixTable() {
+		for (unsigned s = 0; s < MAX_CHANNELS; ++s)
+			for (unsigned d = 0; d < MAX_CHANNELS; ++d)
+				matrices[s][d].Setup(s + 1, d + 1);
+	}
+};
+
+static const ChannelMatrixTable channel_matrix_table;
+
+const PcmChannelMatrix &
+GetChannelMatrix(unsigned src_channels, unsigned dest_channels)
+{
+	assert(audio_valid_channel_count(src_channels));
+	assert(audio_valid_channel_count(dest_channels));
+
+	return channel_matrix_table.matrices[src_channels - 1][dest_channels - 1];
+}
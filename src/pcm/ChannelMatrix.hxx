@@ -0,0 +1,71 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_CHANNEL_MATRIX_HXX
+#define MPD_PCM_CHANNEL_MATRIX_HXX
+
+#include "check.h"
+#include "AudioFormat.hxx"
+#include "Traits.hxx"
+#include "Compiler.h"
+
+#include <stddef.h>
+
+/**
+ * A matrix which describes how each output channel is mixed from the
+ * input channels.  Channels are in FLAC/WAVE order
+ * (https://xiph.org/flac/format.html).
+ */
+struct PcmChannelMatrix {
+	unsigned src_channels, dest_channels;
+
+	/**
+	 * The gain of each input channel (second index) in each
+	 * output channel (first index).
+	 */
+	float coefficients[MAX_CHANNELS][MAX_CHANNELS];
+
+	/**
+	 * Build the matrix for converting between the default
+	 * speaker layouts of the given channel counts: channels
+	 * which exist in both layouts are copied, the others are
+	 * folded into their neighbours (-3 dB) and LFE is dropped;
+	 * mono is copied to all output channels.  The result is
+	 * scaled down if an output channel could clip.
+	 */
+	void Setup(unsigned src_channels, unsigned dest_channels);
+
+	/**
+	 * Mix the given number of frames.
+	 */
+	template<SampleFormat F, class Traits=SampleTraits<F>>
+	void Apply(typename Traits::pointer_type dest,
+		   typename Traits::const_pointer_type src,
+		   size_t n_frames) const;
+};
+
+/**
+ * Returns the (precomputed) matrix for converting between the default
+ * layouts of the given channel counts.
+ */
+gcc_const
+const PcmChannelMatrix &
+GetChannelMatrix(unsigned src_channels, unsigned dest_channels);
+
+#endif
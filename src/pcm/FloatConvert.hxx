@@ -21,6 +21,7 @@
 #define MPD_PCM_FLOAT_CONVERT_HXX
 
 #include "Traits.hxx"
+#include "PcmUtils.hxx"
 
 /**
  * Convert from float to an integer sample format.
@@ -34,7 +35,7 @@ struct FloatToIntegerSampleConvert {
 	typedef typename SrcTraits::long_type SL;
 	typedef typename DstTraits::value_type DV;
 
-	static constexpr SV factor = 1 << (DstTraits::BITS - 1);
+	static constexpr SV factor = uintmax_t(1) << (DstTraits::BITS - 1);
 
 	gcc_const
 	static DV Convert(SV src) {
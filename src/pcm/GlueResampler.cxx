@@ -70,6 +70,12 @@ GluePcmResampler::Close()
 	resampler->Close();
 }
 
+void
+GluePcmResampler::Reset()
+{
+	resampler->Reset();
+}
+
 ConstBuffer<void>
 GluePcmResampler::Resample(ConstBuffer<void> src, Error &error)
 {
@@ -53,6 +53,11 @@ public:
 		  Error &error);
 	void Close();
 
+	/**
+	 * @see PcmResampler::Reset()
+	 */
+	void Reset();
+
 	SampleFormat GetOutputSampleFormat() const {
 		return output_sample_format;
 	}
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "HalfbandDecimator.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <math.h>
+
+/**
+ * The filter coefficients.  All taps with an even distance from the
+ * center (except the center itself) of a halfband filter are zero,
+ * and the filter is symmetric, so only the odd distances are stored.
+ */
+struct HalfbandCoefficients {
+	static constexpr unsigned CENTER = HalfbandDecimator::TAPS / 2;
+	static constexpr unsigned N_PAIRS = (CENTER + 1) / 2;
+
+	float center;
+
+	/**
+	 * The coefficient for the distance 1, 3, 5, ...
+	 */
+	float pairs[N_PAIRS];
+
+	HalfbandCoefficients();
+};
+
+HalfbandCoefficients::HalfbandCoefficients()
+{
+	constexpr unsigned N = HalfbandDecimator::TAPS;
+
+	/* Blackman window */
+	const auto window = [](unsigned n) {
+		return 0.42 - 0.5 * cos(2 * M_PI * n / (N - 1))
+			+ 0.08 * cos(4 * M_PI * n / (N - 1));
+	};
+
+	double sum = 0.5;
+	double p[N_PAIRS];
+	for (unsigned i = 0; i < N_PAIRS; ++i) {
+		const unsigned d = 2 * i + 1;
+		p[i] = sin(M_PI_2 * d) / (M_PI * d) * window(CENTER + d);
+		sum += 2 * p[i];
+	}
+
+	/* normalize to unity gain at DC */
+	center = 0.5 / sum;
+	for (unsigned i = 0; i < N_PAIRS; ++i)
+		pairs[i] = p[i] / sum;
+}
+
+static const HalfbandCoefficients coefficients;
+
+void
+HalfbandDecimator::Reset()
+{
+	history.fill(0);
+	phase = 0;
+}
+
+ConstBuffer<float>
+HalfbandDecimator::Process(unsigned channels, ConstBuffer<float> src)
+{
+	assert(channels > 0);
+	assert(channels <= MAX_CHANNELS);
+	assert(src.size % channels == 0);
+
+	constexpr unsigned CENTER = HalfbandCoefficients::CENTER;
+
+	const size_t n_frames = src.size / channels;
+	const size_t total = HISTORY + n_frames;
+
+	float *const work = work_buffer.GetT<float>(total * channels);
+	std::copy_n(history.begin(), HISTORY * channels, work);
+	std::copy_n(src.data, src.size, work + HISTORY * channels);
+
+	const size_t max_out = n_frames / 2 + 1;
+	float *const dest = output_buffer.GetT<float>(max_out * channels);
+	float *d = dest;
+
+	size_t t = phase;
+	for (; t + TAPS <= total; t += 2, d += channels) {
+		const float *x = work + (t + CENTER) * channels;
+
+		for (unsigned c = 0; c < channels; ++c)
+			d[c] = coefficients.center * x[c];
+
+		for (unsigned i = 0; i < HalfbandCoefficients::N_PAIRS; ++i) {
+			const size_t offset = (2 * i + 1) * channels;
+			const float *a = x - offset, *b = x + offset;
+			const float k = coefficients.pairs[i];
+
+			for (unsigned c = 0; c < channels; ++c)
+				d[c] += k * (a[c] + b[c]);
+		}
+	}
+
+	/* the last #HISTORY frames become the new history */
+	assert(t >= n_frames);
+	phase = t - n_frames;
+	assert(phase <= 1);
+	std::copy_n(work + n_frames * channels, HISTORY * channels,
+		    history.begin());
+
+	return { dest, size_t(d - dest) };
+}
@@ -0,0 +1,80 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_HALFBAND_DECIMATOR_HXX
+#define MPD_PCM_HALFBAND_DECIMATOR_HXX
+
+#include "check.h"
+#include "PcmBuffer.hxx"
+#include "AudioFormat.hxx"
+
+#include <array>
+
+template<typename T> struct ConstBuffer;
+
+/**
+ * Halve the sample rate of interleaved floating point samples with a
+ * windowed-sinc halfband low-pass filter.  Several instances may be
+ * chained to decimate by 4, 8, ...
+ *
+ * The inner loop runs over all channels of a frame at once, which
+ * allows the compiler to vectorize it.
+ */
+class HalfbandDecimator {
+public:
+	/**
+	 * The number of filter taps; it must be odd.
+	 */
+	static constexpr unsigned TAPS = 47;
+
+private:
+	static constexpr unsigned HISTORY = TAPS - 1;
+
+	PcmBuffer work_buffer, output_buffer;
+
+	/**
+	 * The last #HISTORY input frames of the previous Process()
+	 * call.
+	 */
+	std::array<float, HISTORY * MAX_CHANNELS> history;
+
+	/**
+	 * The offset of the next output frame relative to the start
+	 * of #history (0 or 1).
+	 */
+	unsigned phase;
+
+public:
+	HalfbandDecimator() {
+		Reset();
+	}
+
+	/**
+	 * Forget all previous input, e.g. after seeking.
+	 */
+	void Reset();
+
+	/**
+	 * Decimate a block of interleaved samples.  The returned
+	 * buffer is valid until the next call.
+	 */
+	ConstBuffer<float> Process(unsigned channels, ConstBuffer<float> src);
+};
+
+#endif
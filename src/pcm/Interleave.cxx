@@ -20,8 +20,26 @@
 #include "config.h"
 #include "Interleave.hxx"
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include <string.h>
 
+static void
+GenericPcmDeinterleave(ConstBuffer<uint8_t *> dest,
+		       const uint8_t *gcc_restrict src,
+		       size_t n_frames, size_t sample_size)
+{
+	for (size_t frame = 0; frame < n_frames; ++frame) {
+		for (size_t channel = 0; channel < dest.size; ++channel) {
+			memcpy(dest[channel] + frame * sample_size, src,
+			       sample_size);
+			src += sample_size;
+		}
+	}
+}
+
 static void
 GenericPcmInterleave(uint8_t *gcc_restrict dest,
 		     ConstBuffer<const uint8_t *> src,
@@ -36,17 +54,266 @@ GenericPcmInterleave(uint8_t *gcc_restrict dest,
 	}
 }
 
-template<typename T>
-static void
-PcmInterleaveStereo(T *gcc_restrict dest,
-		    const T *gcc_restrict src1,
-		    const T *gcc_restrict src2,
-		    size_t n_frames)
-{
-	for (size_t i = 0; i != n_frames; ++i) {
-		*dest++ = *src1++;
-		*dest++ = *src2++;
+#ifdef __SSE2__
+
+/**
+ * Transpose a 4x4 matrix of 32 bit values.
+ */
+static inline void
+Transpose4x4(__m128i &a, __m128i &b, __m128i &c, __m128i &d)
+{
+	const __m128i t0 = _mm_unpacklo_epi32(a, b);
+	const __m128i t1 = _mm_unpacklo_epi32(c, d);
+	const __m128i t2 = _mm_unpackhi_epi32(a, b);
+	const __m128i t3 = _mm_unpackhi_epi32(c, d);
+
+	a = _mm_unpacklo_epi64(t0, t1);
+	b = _mm_unpackhi_epi64(t0, t1);
+	c = _mm_unpacklo_epi64(t2, t3);
+	d = _mm_unpackhi_epi64(t2, t3);
+}
+
+/**
+ * Transpose an 8x8 matrix of 16 bit values.
+ */
+static inline void
+Transpose8x8(__m128i r[8])
+{
+	const __m128i s0 = _mm_unpacklo_epi16(r[0], r[1]);
+	const __m128i s1 = _mm_unpackhi_epi16(r[0], r[1]);
+	const __m128i s2 = _mm_unpacklo_epi16(r[2], r[3]);
+	const __m128i s3 = _mm_unpackhi_epi16(r[2], r[3]);
+	const __m128i s4 = _mm_unpacklo_epi16(r[4], r[5]);
+	const __m128i s5 = _mm_unpackhi_epi16(r[4], r[5]);
+	const __m128i s6 = _mm_unpacklo_epi16(r[6], r[7]);
+	const __m128i s7 = _mm_unpackhi_epi16(r[6], r[7]);
+
+	const __m128i t0 = _mm_unpacklo_epi32(s0, s2);
+	const __m128i t1 = _mm_unpackhi_epi32(s0, s2);
+	const __m128i t2 = _mm_unpacklo_epi32(s1, s3);
+	const __m128i t3 = _mm_unpackhi_epi32(s1, s3);
+	const __m128i t4 = _mm_unpacklo_epi32(s4, s6);
+	const __m128i t5 = _mm_unpackhi_epi32(s4, s6);
+	const __m128i t6 = _mm_unpacklo_epi32(s5, s7);
+	const __m128i t7 = _mm_unpackhi_epi32(s5, s7);
+
+	r[0] = _mm_unpacklo_epi64(t0, t4);
+	r[1] = _mm_unpackhi_epi64(t0, t4);
+	r[2] = _mm_unpacklo_epi64(t1, t5);
+	r[3] = _mm_unpackhi_epi64(t1, t5);
+	r[4] = _mm_unpacklo_epi64(t2, t6);
+	r[5] = _mm_unpackhi_epi64(t2, t6);
+	r[6] = _mm_unpacklo_epi64(t3, t7);
+	r[7] = _mm_unpackhi_epi64(t3, t7);
+}
+
+static inline __m128i
+LoadU(const void *p)
+{
+	return _mm_loadu_si128((const __m128i *)p);
+}
+
+static inline void
+StoreU(void *p, __m128i v)
+{
+	_mm_storeu_si128((__m128i *)p, v);
+}
+
+/**
+ * Interleave as many frames as possible with SSE2.
+ *
+ * @return the number of frames which were interleaved
+ */
+static size_t
+InterleaveSse2(int16_t *gcc_restrict dest, const int16_t *const*src,
+	       unsigned channels, size_t n_frames)
+{
+	size_t i = 0;
+
+	switch (channels) {
+	case 2:
+		for (; i + 8 <= n_frames; i += 8, dest += 16) {
+			const __m128i l = LoadU(src[0] + i);
+			const __m128i r = LoadU(src[1] + i);
+			StoreU(dest, _mm_unpacklo_epi16(l, r));
+			StoreU(dest + 8, _mm_unpackhi_epi16(l, r));
+		}
+		break;
+
+	case 8:
+		for (; i + 8 <= n_frames; i += 8, dest += 64) {
+			__m128i r[8];
+			for (unsigned c = 0; c < 8; ++c)
+				r[c] = LoadU(src[c] + i);
+
+			Transpose8x8(r);
+
+			for (unsigned c = 0; c < 8; ++c)
+				StoreU(dest + 8 * c, r[c]);
+		}
+		break;
+	}
+
+	return i;
+}
+
+static size_t
+InterleaveSse2(int32_t *gcc_restrict dest, const int32_t *const*src,
+	       unsigned channels, size_t n_frames)
+{
+	size_t i = 0;
+
+	switch (channels) {
+	case 2:
+		for (; i + 4 <= n_frames; i += 4, dest += 8) {
+			const __m128i l = LoadU(src[0] + i);
+			const __m128i r = LoadU(src[1] + i);
+			StoreU(dest, _mm_unpacklo_epi32(l, r));
+			StoreU(dest + 4, _mm_unpackhi_epi32(l, r));
+		}
+		break;
+
+	case 8:
+		for (; i + 4 <= n_frames; i += 4, dest += 32) {
+			__m128i a = LoadU(src[0] + i), b = LoadU(src[1] + i);
+			__m128i c = LoadU(src[2] + i), d = LoadU(src[3] + i);
+			__m128i e = LoadU(src[4] + i), f = LoadU(src[5] + i);
+			__m128i g = LoadU(src[6] + i), h = LoadU(src[7] + i);
+
+			Transpose4x4(a, b, c, d);
+			Transpose4x4(e, f, g, h);
+
+			StoreU(dest, a);
+			StoreU(dest + 4, e);
+			StoreU(dest + 8, b);
+			StoreU(dest + 12, f);
+			StoreU(dest + 16, c);
+			StoreU(dest + 20, g);
+			StoreU(dest + 24, d);
+			StoreU(dest + 28, h);
+		}
+		break;
+	}
+
+	return i;
+}
+
+/**
+ * Deinterleave as many frames as possible with SSE2.
+ *
+ * @return the number of frames which were deinterleaved
+ */
+static size_t
+DeinterleaveSse2(int16_t *const*dest, const int16_t *gcc_restrict src,
+		 unsigned channels, size_t n_frames)
+{
+	size_t i = 0;
+
+	switch (channels) {
+	case 2:
+		for (; i + 8 <= n_frames; i += 8, src += 16) {
+			const __m128i a = LoadU(src), b = LoadU(src + 8);
+
+			/* sign-extend the even and the odd
+			   samples to 32 bit, then pack them (the
+			   values fit, so there is no saturation) */
+			const __m128i l = _mm_packs_epi32(
+				_mm_srai_epi32(_mm_slli_epi32(a, 16), 16),
+				_mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+			const __m128i r = _mm_packs_epi32(
+				_mm_srai_epi32(a, 16),
+				_mm_srai_epi32(b, 16));
+
+			StoreU(dest[0] + i, l);
+			StoreU(dest[1] + i, r);
+		}
+		break;
+
+	case 8:
+		for (; i + 8 <= n_frames; i += 8, src += 64) {
+			__m128i r[8];
+			for (unsigned c = 0; c < 8; ++c)
+				r[c] = LoadU(src + 8 * c);
+
+			Transpose8x8(r);
+
+			for (unsigned c = 0; c < 8; ++c)
+				StoreU(dest[c] + i, r[c]);
+		}
+		break;
 	}
+
+	return i;
+}
+
+static size_t
+DeinterleaveSse2(int32_t *const*dest, const int32_t *gcc_restrict src,
+		 unsigned channels, size_t n_frames)
+{
+	size_t i = 0;
+
+	switch (channels) {
+	case 2:
+		for (; i + 4 <= n_frames; i += 4, src += 8) {
+			const __m128 a = _mm_castsi128_ps(LoadU(src));
+			const __m128 b = _mm_castsi128_ps(LoadU(src + 4));
+
+			StoreU(dest[0] + i, _mm_castps_si128(
+				       _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0))));
+			StoreU(dest[1] + i, _mm_castps_si128(
+				       _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1))));
+		}
+		break;
+
+	case 8:
+		for (; i + 4 <= n_frames; i += 4, src += 32) {
+			__m128i a = LoadU(src), e = LoadU(src + 4);
+			__m128i b = LoadU(src + 8), f = LoadU(src + 12);
+			__m128i c = LoadU(src + 16), g = LoadU(src + 20);
+			__m128i d = LoadU(src + 24), h = LoadU(src + 28);
+
+			Transpose4x4(a, b, c, d);
+			Transpose4x4(e, f, g, h);
+
+			StoreU(dest[0] + i, a);
+			StoreU(dest[1] + i, b);
+			StoreU(dest[2] + i, c);
+			StoreU(dest[3] + i, d);
+			StoreU(dest[4] + i, e);
+			StoreU(dest[5] + i, f);
+			StoreU(dest[6] + i, g);
+			StoreU(dest[7] + i, h);
+		}
+		break;
+	}
+
+	return i;
+}
+
+#endif
+
+/**
+ * Interleave a fixed number of channels; the compiler unrolls the
+ * inner loop.
+ */
+template<unsigned N, typename T>
+static void
+PcmInterleaveN(T *gcc_restrict dest, const T *const*src,
+	       size_t i, size_t n_frames)
+{
+	for (dest += i * N; i != n_frames; ++i)
+		for (unsigned c = 0; c != N; ++c)
+			*dest++ = src[c][i];
+}
+
+template<unsigned N, typename T>
+static void
+PcmDeinterleaveN(T *const*dest, const T *gcc_restrict src,
+		 size_t i, size_t n_frames)
+{
+	for (src += i * N; i != n_frames; ++i)
+		for (unsigned c = 0; c != N; ++c)
+			dest[c][i] = *src++;
 }
 
 template<typename T>
@@ -55,9 +322,22 @@ PcmInterleaveT(T *gcc_restrict dest,
 	       const ConstBuffer<const T *> src,
 	       size_t n_frames)
 {
+	size_t i = 0;
+#ifdef __SSE2__
+	i = InterleaveSse2(dest, src.data, src.size, n_frames);
+#endif
+
 	switch (src.size) {
 	case 2:
-		PcmInterleaveStereo(dest, src[0], src[1], n_frames);
+		PcmInterleaveN<2>(dest, src.data, i, n_frames);
+		return;
+
+	case 6:
+		PcmInterleaveN<6>(dest, src.data, i, n_frames);
+		return;
+
+	case 8:
+		PcmInterleaveN<8>(dest, src.data, i, n_frames);
 		return;
 	}
 
@@ -70,6 +350,40 @@ PcmInterleaveT(T *gcc_restrict dest,
 	}
 }
 
+template<typename T>
+static void
+PcmDeinterleaveT(const ConstBuffer<T *> dest,
+		 const T *gcc_restrict src,
+		 size_t n_frames)
+{
+	size_t i = 0;
+#ifdef __SSE2__
+	i = DeinterleaveSse2(dest.data, src, dest.size, n_frames);
+#endif
+
+	switch (dest.size) {
+	case 2:
+		PcmDeinterleaveN<2>(dest.data, src, i, n_frames);
+		return;
+
+	case 6:
+		PcmDeinterleaveN<6>(dest.data, src, i, n_frames);
+		return;
+
+	case 8:
+		PcmDeinterleaveN<8>(dest.data, src, i, n_frames);
+		return;
+	}
+
+	for (auto *d : dest) {
+		const auto *s = src++;
+
+		for (auto *const d_end = d + n_frames;
+		     d != d_end; ++d, s += dest.size)
+			*d = *s;
+	}
+}
+
 static void
 PcmInterleave16(int16_t *gcc_restrict dest,
 		const ConstBuffer<const int16_t *> src,
@@ -113,3 +427,35 @@ PcmInterleave(void *gcc_restrict dest,
 				     n_frames, sample_size);
 	}
 }
+
+void
+PcmDeinterleave32(ConstBuffer<int32_t *> dest,
+		  const int32_t *gcc_restrict src, size_t n_frames)
+{
+	PcmDeinterleaveT(dest, src, n_frames);
+}
+
+void
+PcmDeinterleave(ConstBuffer<void *> dest, const void *gcc_restrict src,
+		size_t n_frames, size_t sample_size)
+{
+	switch (sample_size) {
+	case 2:
+		PcmDeinterleaveT(ConstBuffer<int16_t *>((int16_t *const*)dest.data,
+							dest.size),
+				 (const int16_t *)src, n_frames);
+		break;
+
+	case 4:
+		PcmDeinterleave32(ConstBuffer<int32_t *>((int32_t *const*)dest.data,
+							 dest.size),
+				  (const int32_t *)src, n_frames);
+		break;
+
+	default:
+		GenericPcmDeinterleave(ConstBuffer<uint8_t *>((uint8_t *const*)dest.data,
+							      dest.size),
+				       (const uint8_t *)src,
+				       n_frames, sample_size);
+	}
+}
@@ -51,4 +51,28 @@ PcmInterleaveFloat(float *gcc_restrict dest, ConstBuffer<const float *> src,
 			n_frames);
 }
 
+/**
+ * Deinterleave PCM samples from #src to the planar buffers #dest.
+ */
+void
+PcmDeinterleave(ConstBuffer<void *> dest, const void *gcc_restrict src,
+		size_t n_frames, size_t sample_size);
+
+/**
+ * A variant of PcmDeinterleave() that assumes 32 bit samples (4
+ * bytes per sample).
+ */
+void
+PcmDeinterleave32(ConstBuffer<int32_t *> dest,
+		  const int32_t *gcc_restrict src, size_t n_frames);
+
+static inline void
+PcmDeinterleaveFloat(ConstBuffer<float *> dest,
+		     const float *gcc_restrict src, size_t n_frames)
+{
+	PcmDeinterleave32(ConstBuffer<int32_t *>((int32_t *const*)dest.data,
+						 dest.size),
+			  (const int32_t *)src, n_frames);
+}
+
 #endif
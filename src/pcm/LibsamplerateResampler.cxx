@@ -19,20 +19,49 @@
 
 #include "config.h"
 #include "LibsamplerateResampler.hxx"
+#include "ResamplerLoad.hxx"
 #include "config/Block.hxx"
+#include "thread/Mutex.hxx"
 #include "util/ASCII.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
+#include <map>
+#include <memory>
+#include <tuple>
+
 #include <assert.h>
 #include <stdlib.h>
 #include <string.h>
 
 static constexpr Domain libsamplerate_domain("libsamplerate");
 
+/**
+ * Special value for "choose the best converter which fits into the
+ * CPU budget".
+ */
+static constexpr int LSR_AUTO_CONVERTER = -1;
+
 static int lsr_converter = SRC_SINC_FASTEST;
 
+/**
+ * The CPU budget for #LSR_AUTO_CONVERTER, a fraction of one core.
+ */
+static double lsr_cpu_budget;
+
+/**
+ * The converters tried by LsrAutoConverter(), best quality first.
+ * The "ZOH" converter is omitted because the linear one is just as
+ * cheap and sounds better.
+ */
+static constexpr int lsr_auto_converters[] = {
+	SRC_SINC_BEST_QUALITY,
+	SRC_SINC_MEDIUM_QUALITY,
+	SRC_SINC_FASTEST,
+	SRC_LINEAR,
+};
+
 static bool
 lsr_parse_converter(const char *s)
 {
@@ -41,6 +70,11 @@ lsr_parse_converter(const char *s)
 	if (*s == 0)
 		return true;
 
+	if (strcmp(s, "auto") == 0) {
+		lsr_converter = LSR_AUTO_CONVERTER;
+		return true;
+	}
+
 	char *endptr;
 	long l = strtol(s, &endptr, 10);
 	if (*endptr == 0 && src_get_name(l) != nullptr) {
@@ -73,6 +107,17 @@ pcm_resample_lsr_global_init(const ConfigBlock &block, Error &error)
 		return false;
 	}
 
+	if (lsr_converter == LSR_AUTO_CONVERTER) {
+		lsr_cpu_budget = ParseResamplerCpuBudget(block, error);
+		if (lsr_cpu_budget < 0)
+			return false;
+
+		FormatDebug(libsamplerate_domain,
+			    "libsamplerate converter 'auto' with %.0f%% CPU budget",
+			    lsr_cpu_budget * 100);
+		return true;
+	}
+
 	FormatDebug(libsamplerate_domain,
 		    "libsamplerate converter '%s'",
 		    src_get_name(lsr_converter));
@@ -80,6 +125,91 @@ pcm_resample_lsr_global_init(const ConfigBlock &block, Error &error)
 	return true;
 }
 
+/**
+ * Measure the CPU load of the given libsamplerate converter.
+ *
+ * @return the load or a negative value on error
+ */
+static double
+LsrMeasureLoad(int converter,
+	       unsigned src_rate, unsigned dest_rate, unsigned channels)
+{
+	int src_error;
+	SRC_STATE *state = src_new(converter, channels, &src_error);
+	if (state == nullptr)
+		return -1;
+
+	SRC_DATA data;
+	memset(&data, 0, sizeof(data));
+	data.src_ratio = double(dest_rate) / double(src_rate);
+
+	std::unique_ptr<float[]> output;
+	long output_size = 0;
+
+	const double load = MeasureResamplerLoad(src_rate, channels,
+						 [&](const float *src,
+						     size_t n_frames){
+			const long o_frames =
+				long(n_frames * data.src_ratio) + 1;
+			if (o_frames > output_size) {
+				output.reset(new float[o_frames * channels]);
+				output_size = o_frames;
+			}
+
+			data.data_in = const_cast<float *>(src);
+			data.data_out = output.get();
+			data.input_frames = n_frames;
+			data.output_frames = o_frames;
+			return src_process(state, &data) == 0;
+		});
+
+	src_delete(state);
+	return load;
+}
+
+/**
+ * Choose the best converter which fits into #lsr_cpu_budget for the
+ * given conversion.  The result is remembered, so each combination
+ * is measured only once.
+ */
+static int
+LsrAutoConverter(unsigned src_rate, unsigned dest_rate, unsigned channels)
+{
+	typedef std::tuple<unsigned, unsigned, unsigned> Key;
+
+	static Mutex mutex;
+	static std::map<Key, int> cache;
+
+	/* hold the lock while measuring, so concurrent measurements
+	   by several outputs do not distort each other */
+	const ScopeLock protect(mutex);
+
+	const Key key(src_rate, dest_rate, channels);
+	auto i = cache.find(key);
+	if (i != cache.end())
+		return i->second;
+
+	int converter = SRC_LINEAR;
+	double load = -1;
+
+	for (int c : lsr_auto_converters) {
+		/* if nothing fits, the cheapest one (the last one)
+		   is used */
+		converter = c;
+		load = LsrMeasureLoad(c, src_rate, dest_rate, channels);
+		if (load >= 0 && load <= lsr_cpu_budget)
+			break;
+	}
+
+	FormatInfo(libsamplerate_domain,
+		   "%u Hz to %u Hz, %u channels: chose converter '%s', load %.1f%%",
+		   src_rate, dest_rate, channels,
+		   src_get_name(converter), load * 100);
+
+	cache.emplace(key, converter);
+	return converter;
+}
+
 AudioFormat
 LibsampleratePcmResampler::Open(AudioFormat &af, unsigned new_sample_rate,
 				Error &error)
@@ -95,7 +225,11 @@ LibsampleratePcmResampler::Open(AudioFormat &af, unsigned new_sample_rate,
 	af.format = SampleFormat::FLOAT;
 
 	int src_error;
-	state = src_new(lsr_converter, channels, &src_error);
+	const int converter = lsr_converter == LSR_AUTO_CONVERTER
+		? LsrAutoConverter(src_rate, dest_rate, channels)
+		: lsr_converter;
+
+	state = src_new(converter, channels, &src_error);
 	if (!state) {
 		error.Format(libsamplerate_domain, src_error,
 			     "libsamplerate initialization has failed: %s",
@@ -122,6 +256,12 @@ LibsampleratePcmResampler::Close()
 	state = src_delete(state);
 }
 
+void
+LibsampleratePcmResampler::Reset()
+{
+	src_reset(state);
+}
+
 static bool
 src_process(SRC_STATE *state, SRC_DATA *data, Error &error)
 {
@@ -0,0 +1,240 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "LoudnessAnalyzer.hxx"
+#include "Traits.hxx"
+#include "ReplayGainInfo.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <math.h>
+
+/**
+ * The absolute gate [LUFS].
+ */
+static constexpr double ABSOLUTE_GATE = -70;
+
+/**
+ * The relative gate [LU below the ungated loudness].
+ */
+static constexpr double RELATIVE_GATE = -10;
+
+gcc_const
+static double
+MeanSquareToLoudness(double z)
+{
+	return -0.691 + 10 * log10(z);
+}
+
+gcc_const
+static double
+LoudnessToMeanSquare(double lufs)
+{
+	return pow(10, (lufs + 0.691) / 10);
+}
+
+/**
+ * The channel weights from ITU-R BS.1770.  The channel order is the
+ * one used by FLAC and WAVE, i.e. the LFE channel of 5.1 is the
+ * fourth one, followed by the surround channels.
+ */
+gcc_const
+static double
+ChannelWeight(unsigned channels, unsigned i)
+{
+	switch (channels) {
+	case 5:
+		return i >= 3 ? 1.41 : 1.0;
+
+	case 6:
+		if (i == 3)
+			/* LFE */
+			return 0;
+		return i >= 4 ? 1.41 : 1.0;
+
+	default:
+		return 1.0;
+	}
+}
+
+LoudnessAnalyzer::LoudnessAnalyzer(AudioFormat _format)
+	:format(_format),
+	 sub_block_frames(format.sample_rate / 10),
+	 n_frames(0), channel(0), sum(0), n_sub_blocks(0),
+	 peak(0)
+{
+	assert(CanAnalyze(format));
+
+	/* the K-weighting filter coefficients for 48 kHz from
+	   BS.1770 converted to the actual sample rate, see
+	   https://github.com/jiixyj/libebur128 */
+
+	const double rate = format.sample_rate;
+
+	double f0 = 1681.974450955533;
+	const double G = 3.999843853973347;
+	double Q = 0.7071752369554196;
+
+	double K = tan(M_PI * f0 / rate);
+	const double Vh = pow(10.0, G / 20.0);
+	const double Vb = pow(Vh, 0.4996667741545416);
+
+	double a0 = 1.0 + K / Q + K * K;
+	shelf.b0 = (Vh + Vb * K / Q + K * K) / a0;
+	shelf.b1 = 2.0 * (K * K - Vh) / a0;
+	shelf.b2 = (Vh - Vb * K / Q + K * K) / a0;
+	shelf.a1 = 2.0 * (K * K - 1.0) / a0;
+	shelf.a2 = (1.0 - K / Q + K * K) / a0;
+
+	f0 = 38.13547087602444;
+	Q = 0.5003270373238773;
+	K = tan(M_PI * f0 / rate);
+
+	a0 = 1.0 + K / Q + K * K;
+	highpass.b0 = 1.0;
+	highpass.b1 = -2.0;
+	highpass.b2 = 1.0;
+	highpass.a1 = 2.0 * (K * K - 1.0) / a0;
+	highpass.a2 = (1.0 - K / Q + K * K) / a0;
+
+	for (unsigned i = 0; i < format.channels; ++i) {
+		auto &c = channels[i];
+		std::fill_n(&c.z[0][0], 4, 0.0);
+		c.weight = ChannelWeight(format.channels, i);
+	}
+}
+
+template<SampleFormat F>
+inline void
+LoudnessAnalyzer::FeedT(ConstBuffer<void> _src)
+{
+	typedef SampleTraits<F> Traits;
+
+	const auto src =
+		ConstBuffer<typename Traits::value_type>::FromVoid(_src);
+	const double scale = 1.0 / double(Traits::MAX);
+
+	for (const auto i : src) {
+		const double x = double(i) * scale;
+		peak = std::max(peak, fabs(x));
+
+		auto &c = channels[channel];
+		const double y = highpass.Apply(c.z[1],
+						shelf.Apply(c.z[0], x));
+		sum += c.weight * y * y;
+
+		if (++channel == format.channels) {
+			channel = 0;
+
+			if (++n_frames == sub_block_frames)
+				FinishSubBlock();
+		}
+	}
+}
+
+void
+LoudnessAnalyzer::Feed(ConstBuffer<void> src)
+{
+	switch (format.format) {
+	case SampleFormat::UNDEFINED:
+	case SampleFormat::DSD:
+		assert(false);
+		gcc_unreachable();
+
+	case SampleFormat::S8:
+		FeedT<SampleFormat::S8>(src);
+		break;
+
+	case SampleFormat::S16:
+		FeedT<SampleFormat::S16>(src);
+		break;
+
+	case SampleFormat::S24_P32:
+		FeedT<SampleFormat::S24_P32>(src);
+		break;
+
+	case SampleFormat::S32:
+		FeedT<SampleFormat::S32>(src);
+		break;
+
+	case SampleFormat::FLOAT:
+		FeedT<SampleFormat::FLOAT>(src);
+		break;
+	}
+}
+
+void
+LoudnessAnalyzer::FinishSubBlock()
+{
+	sub_blocks[n_sub_blocks++ % SUB_BLOCKS] = sum / n_frames;
+	n_frames = 0;
+	sum = 0;
+
+	if (n_sub_blocks < SUB_BLOCKS)
+		return;
+
+	double z = 0;
+	for (const double i : sub_blocks)
+		z += i;
+	z /= SUB_BLOCKS;
+
+	if (z > 0 && MeanSquareToLoudness(z) > ABSOLUTE_GATE)
+		blocks.push_back(z);
+}
+
+ReplayGainTuple
+LoudnessAnalyzer::Finish()
+{
+	/* an incomplete trailing sub-block is ignored, just like an
+	   incomplete gating block */
+
+	ReplayGainTuple result;
+	result.Clear();
+
+	if (blocks.empty())
+		return result;
+
+	double z = 0;
+	for (const double i : blocks)
+		z += i;
+	z /= blocks.size();
+
+	const double threshold =
+		LoudnessToMeanSquare(MeanSquareToLoudness(z) + RELATIVE_GATE);
+
+	double gated = 0;
+	size_t n_gated = 0;
+	for (const double i : blocks) {
+		if (i > threshold) {
+			gated += i;
+			++n_gated;
+		}
+	}
+
+	if (n_gated == 0)
+		return result;
+
+	const double lufs = MeanSquareToLoudness(gated / n_gated);
+	result.gain = REFERENCE_LUFS - lufs;
+	result.peak = peak;
+	return result;
+}
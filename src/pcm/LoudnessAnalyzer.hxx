@@ -0,0 +1,158 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_LOUDNESS_ANALYZER_HXX
+#define MPD_PCM_LOUDNESS_ANALYZER_HXX
+
+#include "check.h"
+#include "AudioFormat.hxx"
+#include "Compiler.h"
+
+#include <vector>
+
+template<typename T> struct ConstBuffer;
+struct ReplayGainTuple;
+
+/**
+ * Measures the integrated loudness of a song according to EBU R128
+ * (ITU-R BS.1770): the signal is K-weighted, the mean square is
+ * calculated over overlapping 400 ms blocks, and the blocks are
+ * gated at -70 LUFS and 10 LU below the ungated loudness.  The
+ * result is a ReplayGain 2.0 compatible gain relative to -18 LUFS
+ * and the sample peak.
+ */
+class LoudnessAnalyzer {
+public:
+	/**
+	 * The loudness which is the target of the calculated gain
+	 * [LUFS].
+	 */
+	static constexpr double REFERENCE_LUFS = -18;
+
+	/**
+	 * The length of a gating block is this many sub-blocks of
+	 * 100 ms; consecutive blocks overlap by all but one
+	 * sub-block (75%).
+	 */
+	static constexpr unsigned SUB_BLOCKS = 4;
+
+private:
+	/**
+	 * A second order IIR filter (transposed direct form II).
+	 */
+	struct Biquad {
+		double b0, b1, b2, a1, a2;
+
+		double Apply(double (&z)[2], double x) const {
+			const double y = b0 * x + z[0];
+			z[0] = b1 * x - a1 * y + z[1];
+			z[1] = b2 * x - a2 * y;
+			return y;
+		}
+	};
+
+	struct ChannelState {
+		/**
+		 * The state of the two K-weighting filter stages.
+		 */
+		double z[2][2];
+
+		double weight;
+	};
+
+	const AudioFormat format;
+
+	Biquad shelf, highpass;
+
+	ChannelState channels[MAX_CHANNELS];
+
+	/**
+	 * The number of frames per 100 ms sub-block.
+	 */
+	const unsigned sub_block_frames;
+
+	/**
+	 * The number of frames in the current sub-block so far.
+	 */
+	unsigned n_frames;
+
+	/**
+	 * The channel of the next sample.
+	 */
+	unsigned channel;
+
+	/**
+	 * The weighted sum of squares of the current sub-block.
+	 */
+	double sum;
+
+	/**
+	 * The mean square of the most recent sub-blocks (a ring
+	 * buffer indexed by #n_sub_blocks).
+	 */
+	double sub_blocks[SUB_BLOCKS];
+
+	unsigned n_sub_blocks;
+
+	/**
+	 * The mean square of all gating blocks above the absolute
+	 * threshold.
+	 */
+	std::vector<double> blocks;
+
+	/**
+	 * The highest absolute sample value, normalized to 1.0 being
+	 * full scale.
+	 */
+	double peak;
+
+public:
+	/**
+	 * @param _format the audio format; must be supported
+	 * according to CanAnalyze()
+	 */
+	explicit LoudnessAnalyzer(AudioFormat _format);
+
+	gcc_const
+	static bool CanAnalyze(AudioFormat format) {
+		return format.IsValid() &&
+			format.format != SampleFormat::DSD;
+	}
+
+	/**
+	 * Analyze a block of PCM data.  It must consist of whole
+	 * samples.
+	 */
+	void Feed(ConstBuffer<void> src);
+
+	/**
+	 * Finish the analysis and return the gain and peak.  The
+	 * tuple is undefined if the song is too short or silent.
+	 * After that, the object must not be used anymore.
+	 */
+	ReplayGainTuple Finish();
+
+private:
+	template<SampleFormat F>
+	void FeedT(ConstBuffer<void> src);
+
+	void FinishSubBlock();
+};
+
+#endif
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "MixRampAnalyzer.hxx"
+#include "Traits.hxx"
+#include "MixRampInfo.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+
+const float MixRampAnalyzer::levels[N_LEVELS] = {
+	-90, -60, -40, -30, -24, -20, -16, -12, -9, -6, -3,
+};
+
+MixRampAnalyzer::MixRampAnalyzer(AudioFormat _format)
+	:format(_format),
+	 window_samples(format.sample_rate * WINDOW_MS / 1000 *
+			format.channels),
+	 n_samples(0), sum(0), position(0)
+{
+	assert(CanAnalyze(format));
+
+	for (auto &i : first)
+		i = NONE;
+}
+
+template<SampleFormat F>
+inline void
+MixRampAnalyzer::FeedT(ConstBuffer<void> _src)
+{
+	typedef SampleTraits<F> Traits;
+
+	const auto src =
+		ConstBuffer<typename Traits::value_type>::FromVoid(_src);
+	const double scale = 1.0 / double(Traits::MAX);
+
+	for (const auto i : src) {
+		const double sample = double(i) * scale;
+		sum += sample * sample;
+
+		if (++n_samples == window_samples)
+			FinishWindow();
+	}
+}
+
+void
+MixRampAnalyzer::Feed(ConstBuffer<void> src)
+{
+	switch (format.format) {
+	case SampleFormat::UNDEFINED:
+	case SampleFormat::DSD:
+		assert(false);
+		gcc_unreachable();
+
+	case SampleFormat::S8:
+		FeedT<SampleFormat::S8>(src);
+		break;
+
+	case SampleFormat::S16:
+		FeedT<SampleFormat::S16>(src);
+		break;
+
+	case SampleFormat::S24_P32:
+		FeedT<SampleFormat::S24_P32>(src);
+		break;
+
+	case SampleFormat::S32:
+		FeedT<SampleFormat::S32>(src);
+		break;
+
+	case SampleFormat::FLOAT:
+		FeedT<SampleFormat::FLOAT>(src);
+		break;
+	}
+}
+
+void
+MixRampAnalyzer::FinishWindow()
+{
+	assert(n_samples > 0);
+
+	/* the RMS level in dBFS; silence yields -inf, which is
+	   below all levels */
+	const float db = 10 * log10(sum / n_samples);
+
+	const uint64_t end = position + n_samples;
+	for (unsigned i = 0; i < N_LEVELS && db >= levels[i]; ++i) {
+		if (first[i] == NONE)
+			first[i] = position;
+		last[i] = end;
+	}
+
+	position = end;
+	n_samples = 0;
+	sum = 0;
+}
+
+static void
+AppendRamp(std::string &dest, float db, double seconds)
+{
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.2f %.2f", db, seconds);
+
+	if (!dest.empty())
+		dest.push_back(';');
+	dest.append(buffer);
+}
+
+std::string
+MixRampAnalyzer::FormatStart() const
+{
+	const double samples_per_second =
+		double(format.sample_rate) * format.channels;
+
+	std::string result;
+	for (unsigned i = 0; i < N_LEVELS && first[i] != NONE; ++i)
+		AppendRamp(result, levels[i], first[i] / samples_per_second);
+
+	return result;
+}
+
+std::string
+MixRampAnalyzer::FormatEnd() const
+{
+	const double samples_per_second =
+		double(format.sample_rate) * format.channels;
+
+	std::string result;
+	for (unsigned i = 0; i < N_LEVELS && first[i] != NONE; ++i)
+		AppendRamp(result, levels[i],
+			   (position - last[i]) / samples_per_second);
+
+	return result;
+}
+
+MixRampInfo
+MixRampAnalyzer::Finish()
+{
+	if (n_samples > 0)
+		FinishWindow();
+
+	MixRampInfo info;
+	info.SetStart(FormatStart());
+	info.SetEnd(FormatEnd());
+	return info;
+}
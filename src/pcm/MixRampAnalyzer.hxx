@@ -0,0 +1,129 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_MIXRAMP_ANALYZER_HXX
+#define MPD_PCM_MIXRAMP_ANALYZER_HXX
+
+#include "check.h"
+#include "AudioFormat.hxx"
+#include "Compiler.h"
+
+#include <string>
+
+#include <stdint.h>
+
+template<typename T> struct ConstBuffer;
+class MixRampInfo;
+
+/**
+ * Calculates the MixRamp envelopes of a song, i.e. the data which is
+ * usually found in the MIXRAMP_START and MIXRAMP_END tags.  The
+ * loudness is measured as the RMS level of short windows.  For each
+ * of a number of fixed levels, the start ramp contains the time from
+ * the beginning of the song when this level is first reached, and the
+ * end ramp contains the time from the last window at this level
+ * until the end of the song.
+ */
+class MixRampAnalyzer {
+public:
+	/**
+	 * The levels [dBFS] which will be included in the result.
+	 */
+	static constexpr unsigned N_LEVELS = 11;
+	static const float levels[N_LEVELS];
+
+	/**
+	 * The length of one analysis window in milliseconds.
+	 */
+	static constexpr unsigned WINDOW_MS = 100;
+
+private:
+	const AudioFormat format;
+
+	/**
+	 * The number of samples (not frames) per window.
+	 */
+	const unsigned window_samples;
+
+	/**
+	 * The number of samples in the current window so far.
+	 */
+	unsigned n_samples;
+
+	/**
+	 * The sum of squares of all samples in the current window,
+	 * normalized to 1.0 being full scale.
+	 */
+	double sum;
+
+	/**
+	 * The position of the current window in samples.
+	 */
+	uint64_t position;
+
+	/**
+	 * The start position of the first window which reached each
+	 * level, or #NONE.
+	 */
+	uint64_t first[N_LEVELS];
+
+	/**
+	 * The end position of the last window which reached each
+	 * level (only valid if #first is set).
+	 */
+	uint64_t last[N_LEVELS];
+
+	static constexpr uint64_t NONE = ~uint64_t(0);
+
+public:
+	/**
+	 * @param _format the audio format; must be supported
+	 * according to CanAnalyze()
+	 */
+	explicit MixRampAnalyzer(AudioFormat _format);
+
+	gcc_const
+	static bool CanAnalyze(AudioFormat format) {
+		return format.IsValid() &&
+			format.format != SampleFormat::DSD;
+	}
+
+	/**
+	 * Analyze a block of PCM data.  It must consist of whole
+	 * samples.
+	 */
+	void Feed(ConstBuffer<void> src);
+
+	/**
+	 * Finish the analysis and generate the MixRamp strings.
+	 * After that, the object must not be used anymore.
+	 */
+	MixRampInfo Finish();
+
+private:
+	template<SampleFormat F>
+	void FeedT(ConstBuffer<void> src);
+
+	void FinishWindow();
+
+	std::string FormatStart() const;
+	std::string FormatEnd() const;
+};
+
+#endif
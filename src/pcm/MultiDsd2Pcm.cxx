@@ -0,0 +1,107 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "MultiDsd2Pcm.hxx"
+#include "dsd2pcm/dsd2pcm.h"
+#include "util/bit_reverse.h"
+
+#include <assert.h>
+
+/**
+ * The number of "8 MACs" lookup tables of the dsd2pcm filter.
+ */
+static constexpr unsigned CTABLES = 6;
+
+struct Dsd2PcmTables {
+	/**
+	 * The dsd2pcm tables, for the most recent #CTABLES bytes.
+	 */
+	float forward[CTABLES][256];
+
+	/**
+	 * The same tables indexed with the bit-reversed byte, for the
+	 * older half of the symmetric filter.
+	 */
+	float reversed[CTABLES][256];
+
+	Dsd2PcmTables();
+};
+
+Dsd2PcmTables::Dsd2PcmTables()
+{
+	unsigned n;
+	const auto ctables = dsd2pcm_get_ctables(&n);
+	assert(n == CTABLES);
+	(void)n;
+
+	for (unsigned i = 0; i < CTABLES; ++i) {
+		for (unsigned e = 0; e < 256; ++e) {
+			forward[i][e] = ctables[i][e];
+			reversed[i][e] = ctables[i][bit_reverse(e)];
+		}
+	}
+}
+
+static const Dsd2PcmTables tables;
+
+void
+MultiDsd2Pcm::Reset()
+{
+	/* the dsd2pcm silence pattern */
+	for (auto &i : fifo)
+		i.fill(0x69);
+
+	fifo_pos = 0;
+}
+
+void
+MultiDsd2Pcm::Translate(unsigned channels, size_t n_frames,
+			const uint8_t *src, float *dest)
+{
+	assert(channels > 0);
+	assert(channels <= MAX_CHANNELS);
+
+	unsigned pos = fifo_pos;
+
+	for (size_t f = 0; f < n_frames; ++f) {
+		auto &current = fifo[pos];
+		for (unsigned c = 0; c < channels; ++c)
+			current[c] = *src++;
+
+		for (unsigned c = 0; c < channels; ++c)
+			dest[c] = 0;
+
+		for (unsigned i = 0; i < CTABLES; ++i) {
+			const auto &recent = fifo[(pos - i) & FIFO_MASK];
+			const auto &old =
+				fifo[(pos - (CTABLES * 2 - 1) + i) & FIFO_MASK];
+			const float *fwd = tables.forward[i];
+			const float *rev = tables.reversed[i];
+
+			for (unsigned c = 0; c < channels; ++c)
+				dest[c] += fwd[recent[c]] + rev[old[c]];
+		}
+
+		dest += channels;
+		pos = (pos + 1) & FIFO_MASK;
+	}
+
+	fifo_pos = pos;
+}
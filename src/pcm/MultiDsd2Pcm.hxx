@@ -0,0 +1,68 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_MULTI_DSD2PCM_HXX
+#define MPD_PCM_MULTI_DSD2PCM_HXX
+
+#include "check.h"
+#include "AudioFormat.hxx"
+
+#include <array>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A DSD to PCM converter (8:1 decimation) which processes all
+ * channels of interleaved DSD_U8 data in one pass.  It uses the same
+ * filter as the dsd2pcm library, but all channels share one FIFO
+ * position, and the bit-reversed half of the symmetric filter is
+ * looked up in a second set of tables instead of reversing the FIFO
+ * contents in place.
+ */
+class MultiDsd2Pcm {
+	static constexpr unsigned FIFO_SIZE = 16;
+	static constexpr unsigned FIFO_MASK = FIFO_SIZE - 1;
+
+	/**
+	 * The most recent input bytes of each channel.
+	 */
+	std::array<std::array<uint8_t, MAX_CHANNELS>, FIFO_SIZE> fifo;
+
+	unsigned fifo_pos;
+
+public:
+	MultiDsd2Pcm() {
+		Reset();
+	}
+
+	/**
+	 * Forget all previous input, e.g. after seeking.
+	 */
+	void Reset();
+
+	/**
+	 * Convert interleaved DSD_U8 frames (MSB first) to
+	 * interleaved floating point samples.
+	 */
+	void Translate(unsigned channels, size_t n_frames,
+		       const uint8_t *src, float *dest);
+};
+
+#endif
@@ -88,7 +88,7 @@ static inline ConstBuffer<V>
 ToAlsaChannelOrder71(PcmBuffer &buffer, ConstBuffer<V> src)
 {
 	auto dest = buffer.GetT<V>(src.size);
-	ToAlsaChannelOrder71(dest, src.data, src.size / 6);
+	ToAlsaChannelOrder71(dest, src.data, src.size / 8);
 	return { dest, src.size };
 }
 
@@ -133,3 +133,18 @@ ToAlsaChannelOrder(PcmBuffer &buffer, ConstBuffer<void> src,
 
 	gcc_unreachable();
 }
+
+const uint8_t *
+GetAlsaChannelOrder(unsigned channels)
+{
+	static constexpr uint8_t order71[] = { 0, 1, 4, 5, 2, 3, 6, 7 };
+
+	switch (channels) {
+	case 6: // 5.1
+	case 8: // 7.1
+		return order71;
+
+	default:
+		return nullptr;
+	}
+}
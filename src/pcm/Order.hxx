@@ -23,6 +23,8 @@
 #include "check.h"
 #include "AudioFormat.hxx"
 
+#include <stdint.h>
+
 class PcmBuffer;
 template<typename T> struct ConstBuffer;
 
@@ -34,4 +36,13 @@ ConstBuffer<void>
 ToAlsaChannelOrder(PcmBuffer &buffer, ConstBuffer<void> src,
 		   SampleFormat sample_format, unsigned channels);
 
+/**
+ * Returns the channel permutation which is applied by
+ * ToAlsaChannelOrder(): output channel i is copied from input channel
+ * order[i].  Returns nullptr if the channel order is unchanged.
+ */
+gcc_const
+const uint8_t *
+GetAlsaChannelOrder(unsigned channels);
+
 #endif
@@ -24,6 +24,9 @@
 #include "AudioFormat.hxx"
 #include "util/Error.hxx"
 #include "util/ConstBuffer.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
 
 #include <assert.h>
 
@@ -47,6 +50,159 @@ PcmConvert::~PcmConvert()
 	assert(!dest_format.IsValid());
 }
 
+/*
+ * The estimated relative cost of processing one sample in each
+ * stage; only used to compare plans.
+ */
+static constexpr unsigned RESAMPLER_COST = 16;
+static constexpr unsigned FORMAT_COST = 2;
+static constexpr unsigned CHANNELS_COST = 1;
+
+gcc_const
+static bool
+CanConvertChannels(SampleFormat format)
+{
+	switch (format) {
+	case SampleFormat::S16:
+	case SampleFormat::S24_P32:
+	case SampleFormat::S32:
+	case SampleFormat::FLOAT:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+/**
+ * Estimate the cost of the given plan and store it in
+ * #PcmConvert::Plan::cost.
+ *
+ * @return false if the stage order is not possible
+ */
+static bool
+EstimateCost(PcmConvert::Plan &plan, AudioFormat format,
+	     const AudioFormat dest_format)
+{
+	plan.cost = 0;
+
+	for (unsigned i = 0; i < plan.n_stages; ++i) {
+		const unsigned long samples =
+			(unsigned long)format.sample_rate * format.channels;
+
+		switch (plan.stages[i]) {
+		case PcmConvert::Stage::RESAMPLER:
+			plan.cost += samples * RESAMPLER_COST;
+			format.sample_rate = dest_format.sample_rate;
+
+			/* assume that the resampler keeps the sample
+			   format (it does not have to be known yet;
+			   the FORMAT stage takes care of whatever it
+			   emits) */
+			if (!CanConvertChannels(format.format))
+				format.format = SampleFormat::FLOAT;
+			break;
+
+		case PcmConvert::Stage::FORMAT:
+			if (format.format != dest_format.format)
+				plan.cost += samples * FORMAT_COST;
+			format.format = dest_format.format;
+			break;
+
+		case PcmConvert::Stage::CHANNELS:
+			if (!CanConvertChannels(format.format))
+				return false;
+
+			plan.cost += samples * CHANNELS_COST;
+			format.channels = dest_format.channels;
+			break;
+		}
+	}
+
+	return true;
+}
+
+PcmConvert::Plan
+PcmConvert::MakePlan(const AudioFormat src_format,
+		     const AudioFormat dest_format)
+{
+	assert(src_format.format != SampleFormat::DSD);
+
+	Plan candidate;
+
+	const bool enable_resampler =
+		src_format.sample_rate != dest_format.sample_rate;
+	if (enable_resampler)
+		candidate.stages[candidate.n_stages++] = Stage::RESAMPLER;
+
+	/* the resampler may change the sample format, therefore
+	   the FORMAT stage is always planned after it */
+	if (enable_resampler || src_format.format != dest_format.format)
+		candidate.stages[candidate.n_stages++] = Stage::FORMAT;
+
+	if (src_format.channels != dest_format.channels)
+		candidate.stages[candidate.n_stages++] = Stage::CHANNELS;
+
+	const auto begin = candidate.stages.begin();
+	const auto end = begin + candidate.n_stages;
+
+	/* the candidates are enumerated in lexicographic order,
+	   starting with resampler,format,channels; on a tie, the
+	   first one wins */
+	Plan best;
+	bool found = false;
+
+	do {
+		if (enable_resampler &&
+		    std::find(begin, end, Stage::FORMAT) <
+		    std::find(begin, end, Stage::RESAMPLER))
+			continue;
+
+		if (EstimateCost(candidate, src_format, dest_format) &&
+		    (!found || candidate.cost < best.cost)) {
+			best = candidate;
+			found = true;
+		}
+	} while (std::next_permutation(begin, end));
+
+	if (!found)
+		/* no order works; return the default one, and let
+		   Open() report the error */
+		std::sort(begin, end);
+
+	return found ? best : candidate;
+}
+
+std::string
+PcmConvert::Plan::ToString() const
+{
+	std::string result;
+
+	for (unsigned i = 0; i < n_stages; ++i) {
+		if (i > 0)
+			result.push_back(',');
+
+		switch (stages[i]) {
+		case Stage::RESAMPLER:
+			result.append("resampler");
+			break;
+
+		case Stage::FORMAT:
+			result.append("format");
+			break;
+
+		case Stage::CHANNELS:
+			result.append("channels");
+			break;
+		}
+	}
+
+	if (result.empty())
+		result = "none";
+
+	return result;
+}
+
 bool
 PcmConvert::Open(const AudioFormat _src_format, const AudioFormat _dest_format,
 		 Error &error)
@@ -57,55 +213,107 @@ PcmConvert::Open(const AudioFormat _src_format, const AudioFormat _dest_format,
 	assert(_dest_format.IsValid());
 
 	AudioFormat format = _src_format;
-	if (format.format == SampleFormat::DSD)
+	if (format.format == SampleFormat::DSD) {
 		format.format = SampleFormat::FLOAT;
 
-	enable_resampler = format.sample_rate != _dest_format.sample_rate;
-	if (enable_resampler) {
-		if (!resampler.Open(format, _dest_format.sample_rate, error))
-			return false;
+#ifdef ENABLE_DSD
+		/* let the halfband decimators do as much of the
+		   sample rate reduction as possible, e.g. DSD128 to
+		   88.2 kHz, instead of the (slower) resampler */
+		unsigned factor = 1;
+		while (factor < PcmDsd::MAX_DECIMATION &&
+		       format.sample_rate % (factor * 2) == 0 &&
+		       format.sample_rate / (factor * 2) >=
+		       _dest_format.sample_rate)
+			factor *= 2;
 
-		format.format = resampler.GetOutputSampleFormat();
-		format.sample_rate = _dest_format.sample_rate;
+		dsd.SetDecimation(factor);
+		format.sample_rate /= factor;
+#endif
 	}
 
-	enable_format = format.format != _dest_format.format;
-	if (enable_format &&
-	    !format_converter.Open(format.format, _dest_format.format,
-				   error)) {
-		if (enable_resampler)
-			resampler.Close();
-		return false;
-	}
+	plan = MakePlan(format, _dest_format);
 
-	format.format = _dest_format.format;
+	/* open the stages, dropping those which turn out to be
+	   unnecessary */
+	unsigned n = 0;
+	for (unsigned i = 0; i < plan.n_stages; ++i) {
+		const Stage stage = plan.stages[i];
+		bool success = true;
 
-	enable_channels = format.channels != _dest_format.channels;
-	if (enable_channels &&
-	    !channels_converter.Open(format.format, format.channels,
-				     _dest_format.channels, error)) {
-		if (enable_format)
-			format_converter.Close();
-		if (enable_resampler)
-			resampler.Close();
-		return false;
+		switch (stage) {
+		case Stage::RESAMPLER:
+			success = resampler.Open(format,
+						 _dest_format.sample_rate,
+						 error);
+			format.format = resampler.GetOutputSampleFormat();
+			format.sample_rate = _dest_format.sample_rate;
+			break;
+
+		case Stage::FORMAT:
+			if (format.format == _dest_format.format)
+				continue;
+
+			success = format_converter.Open(format.format,
+							_dest_format.format,
+							error);
+			format.format = _dest_format.format;
+			break;
+
+		case Stage::CHANNELS:
+			success = channels_converter.Open(format.format,
+							  format.channels,
+							  _dest_format.channels,
+							  error);
+			format.channels = _dest_format.channels;
+			break;
+		}
+
+		if (!success) {
+			CloseStages(n);
+			return false;
+		}
+
+		plan.stages[n++] = stage;
 	}
 
+	plan.n_stages = n;
+
+	FormatDebug(pcm_domain, "conversion plan: %s",
+		    plan.ToString().c_str());
+
 	src_format = _src_format;
 	dest_format = _dest_format;
 
 	return true;
 }
 
+void
+PcmConvert::CloseStages(unsigned n)
+{
+	assert(n <= plan.n_stages);
+
+	while (n-- > 0) {
+		switch (plan.stages[n]) {
+		case Stage::RESAMPLER:
+			resampler.Close();
+			break;
+
+		case Stage::FORMAT:
+			format_converter.Close();
+			break;
+
+		case Stage::CHANNELS:
+			channels_converter.Close();
+			break;
+		}
+	}
+}
+
 void
 PcmConvert::Close()
 {
-	if (enable_channels)
-		channels_converter.Close();
-	if (enable_format)
-		format_converter.Close();
-	if (enable_resampler)
-		resampler.Close();
+	CloseStages(plan.n_stages);
 
 #ifdef ENABLE_DSD
 	dsd.Reset();
@@ -117,6 +325,18 @@ PcmConvert::Close()
 #endif
 }
 
+void
+PcmConvert::Reset()
+{
+	for (unsigned i = 0; i < plan.n_stages; ++i)
+		if (plan.stages[i] == Stage::RESAMPLER)
+			resampler.Reset();
+
+#ifdef ENABLE_DSD
+	dsd.Reset();
+#endif
+}
+
 ConstBuffer<void>
 PcmConvert::Convert(ConstBuffer<void> buffer, Error &error)
 {
@@ -134,20 +354,21 @@ PcmConvert::Convert(ConstBuffer<void> buffer, Error &error)
 	}
 #endif
 
-	if (enable_resampler) {
-		buffer = resampler.Resample(buffer, error);
-		if (buffer.IsNull())
-			return nullptr;
-	}
+	for (unsigned i = 0; i < plan.n_stages; ++i) {
+		switch (plan.stages[i]) {
+		case Stage::RESAMPLER:
+			buffer = resampler.Resample(buffer, error);
+			break;
 
-	if (enable_format) {
-		buffer = format_converter.Convert(buffer, error);
-		if (buffer.IsNull())
-			return nullptr;
-	}
+		case Stage::FORMAT:
+			buffer = format_converter.Convert(buffer, error);
+			break;
+
+		case Stage::CHANNELS:
+			buffer = channels_converter.Convert(buffer, error);
+			break;
+		}
 
-	if (enable_channels) {
-		buffer = channels_converter.Convert(buffer, error);
 		if (buffer.IsNull())
 			return nullptr;
 	}
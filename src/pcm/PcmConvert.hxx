@@ -26,6 +26,9 @@
 #include "GlueResampler.hxx"
 #include "AudioFormat.hxx"
 
+#include <array>
+#include <string>
+
 #ifdef ENABLE_DSD
 #include "PcmDsd.hxx"
 #endif
@@ -49,7 +52,37 @@ class PcmConvert {
 
 	AudioFormat src_format, dest_format;
 
-	bool enable_resampler, enable_format, enable_channels;
+public:
+	enum class Stage : uint8_t {
+		RESAMPLER,
+		FORMAT,
+		CHANNELS,
+	};
+
+	/**
+	 * The conversion stages in the order they are applied
+	 * (after the DSD to PCM conversion), as chosen by Open().
+	 */
+	struct Plan {
+		std::array<Stage, 3> stages;
+		unsigned n_stages = 0;
+
+		/**
+		 * The estimated cost per second of audio; see
+		 * EstimateCost().
+		 */
+		unsigned long cost = 0;
+
+		/**
+		 * Describe the plan for debugging,
+		 * e.g. "channels,resampler,format".
+		 */
+		gcc_pure
+		std::string ToString() const;
+	};
+
+private:
+	Plan plan;
 
 public:
 	PcmConvert();
@@ -67,6 +100,13 @@ public:
 	 */
 	void Close();
 
+	/**
+	 * Discard the state of the previous stream (resampler
+	 * history, DSD filters), but keep the object open with the
+	 * same formats.  This is cheaper than Close() and Open().
+	 */
+	void Reset();
+
 	/**
 	 * Converts PCM data between two audio formats.
 	 *
@@ -75,6 +115,24 @@ public:
 	 * @return the destination buffer, or nullptr on error
 	 */
 	ConstBuffer<void> Convert(ConstBuffer<void> src, Error &error);
+
+	/**
+	 * Returns the plan chosen by Open().
+	 */
+	const Plan &GetPlan() const {
+		return plan;
+	}
+
+	/**
+	 * Choose the cheapest order of conversion stages for the
+	 * given formats.  The source format must not be DSD (pass
+	 * the format after the DSD to PCM conversion instead).
+	 */
+	gcc_pure
+	static Plan MakePlan(AudioFormat src_format, AudioFormat dest_format);
+
+private:
+	void CloseStages(unsigned n);
 };
 
 bool
@@ -22,6 +22,8 @@
 #include "PcmPrng.hxx"
 #include "Traits.hxx"
 
+#include <algorithm>
+
 template<typename T, T MIN, T MAX, unsigned scale_bits>
 inline T
 PcmDither::Dither(T sample)
@@ -62,6 +64,88 @@ PcmDither::Dither(T sample)
 	return output >> scale_bits;
 }
 
+/**
+ * Store the next #n states of pcm_prng() in the buffer.  After the
+ * first few, each state is calculated from the one #LANES positions
+ * earlier, which allows the compiler to vectorize the loop.
+ */
+static inline void
+pcm_prng_block(uint32_t *dest, uint32_t state, size_t n)
+{
+	constexpr unsigned LANES = 8;
+	constexpr uint32_t multiplier = pcm_prng_multiplier(LANES);
+	constexpr uint32_t increment = pcm_prng_increment(LANES);
+
+	size_t i = 0;
+	for (; i < n && i < LANES; ++i)
+		dest[i] = state = pcm_prng(state);
+
+	for (; i < n; ++i)
+		dest[i] = multiplier * dest[i - LANES] + increment;
+}
+
+template<typename T, T MIN, T MAX, unsigned scale_bits,
+	 typename DT, typename ST>
+inline void
+PcmDither::DitherBlock(DT *dest, const ST *src, size_t n)
+{
+	constexpr T round = 1 << (scale_bits - 1);
+	constexpr T mask = (1 << scale_bits) - 1;
+
+	constexpr size_t BLOCK_SIZE = 256;
+
+	/* rnd[0] is the previous state, rnd[i+1] the one for
+	   sample i */
+	uint32_t rnd[BLOCK_SIZE + 1];
+	T noise[BLOCK_SIZE];
+
+	while (n > 0) {
+		const size_t chunk = std::min(n, BLOCK_SIZE);
+
+		rnd[0] = random;
+		pcm_prng_block(rnd + 1, rnd[0], chunk);
+
+		for (size_t i = 0; i != chunk; ++i)
+			noise[i] = round + T(rnd[i + 1] & mask)
+				- T(rnd[i] & mask);
+
+		for (size_t i = 0; i != chunk; ++i) {
+			T sample = src[i];
+			sample += error[0] - error[1] + error[2];
+
+			error[2] = error[1];
+			error[1] = error[0] / 2;
+
+			T output = sample + noise[i];
+
+			/* clip */
+			if (output > MAX) {
+				output = MAX;
+
+				if (sample > MAX)
+					sample = MAX;
+			} else if (output < MIN) {
+				output = MIN;
+
+				if (sample < MIN)
+					sample = MIN;
+			}
+
+			output &= ~mask;
+
+			error[0] = sample - output;
+
+			dest[i] = output >> scale_bits;
+		}
+
+		random = rnd[chunk];
+
+		dest += chunk;
+		src += chunk;
+		n -= chunk;
+	}
+}
+
 template<typename ST, unsigned SBITS, unsigned DBITS>
 inline ST
 PcmDither::DitherShift(ST sample)
@@ -75,17 +159,17 @@ PcmDither::DitherShift(ST sample)
 	return Dither<ST, MIN, MAX, SBITS - DBITS>(sample);
 }
 
-template<typename ST, typename DT>
-inline typename DT::value_type
-PcmDither::DitherConvert(typename ST::value_type sample)
+template<typename ST, unsigned SBITS, unsigned DBITS, typename DT>
+inline void
+PcmDither::DitherShiftBlock(DT *dest, const ST *src, size_t n)
 {
-	static_assert(ST::BITS > DT::BITS,
-		      "Sample formats cannot be dithered");
+	static_assert(sizeof(ST) * 8 > SBITS, "Source type too small");
+	static_assert(SBITS > DBITS, "Non-positive scale_bits");
 
-	constexpr unsigned scale_bits = ST::BITS - DT::BITS;
+	static constexpr ST MIN = -(ST(1) << (SBITS - 1));
+	static constexpr ST MAX = (ST(1) << (SBITS - 1)) - 1;
 
-	return Dither<typename ST::sum_type, ST::MIN, ST::MAX,
-		      scale_bits>(sample);
+	DitherBlock<ST, MIN, MAX, SBITS - DBITS>(dest, src, n);
 }
 
 template<typename ST, typename DT>
@@ -94,8 +178,13 @@ PcmDither::DitherConvert(typename DT::pointer_type dest,
 			 typename ST::const_pointer_type src,
 			 typename ST::const_pointer_type src_end)
 {
-	while (src < src_end)
-		*dest++ = DitherConvert<ST, DT>(*src++);
+	static_assert(ST::BITS > DT::BITS,
+		      "Sample formats cannot be dithered");
+
+	constexpr unsigned scale_bits = ST::BITS - DT::BITS;
+
+	DitherBlock<typename ST::sum_type, ST::MIN, ST::MAX,
+		    scale_bits>(dest, src, src_end - src);
 }
 
 inline void
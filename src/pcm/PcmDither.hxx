@@ -20,6 +20,7 @@
 #ifndef MPD_PCM_DITHER_HXX
 #define MPD_PCM_DITHER_HXX
 
+#include <stddef.h>
 #include <stdint.h>
 
 enum class SampleFormat : uint8_t;
@@ -44,6 +45,17 @@ public:
 	template<typename ST, unsigned SBITS, unsigned DBITS>
 	ST DitherShift(ST sample);
 
+	/**
+	 * Apply DitherShift() to a buffer.  The random values are
+	 * generated in batches with a vectorizable loop, and only
+	 * the error feedback remains sequential; the result is the
+	 * same as calling DitherShift() for each sample.
+	 *
+	 * @tparam DT the output sample type
+	 */
+	template<typename ST, unsigned SBITS, unsigned DBITS, typename DT>
+	void DitherShiftBlock(DT *dest, const ST *src, size_t n);
+
 	void Dither24To16(int16_t *dest, const int32_t *src,
 			  const int32_t *src_end);
 
@@ -65,15 +77,11 @@ private:
 	T Dither(T sample);
 
 	/**
-	 * Convert the given sample from one sample format to another,
-	 * discarding bits.
-	 *
-	 * @param ST the input #SampleTraits class
-	 * @param ST the output #SampleTraits class
-	 * @param sample the input sample value
+	 * The block version of Dither().
 	 */
-	template<typename ST, typename DT>
-	typename DT::value_type DitherConvert(typename ST::value_type sample);
+	template<typename T, T MIN, T MAX, unsigned scale_bits,
+		 typename DT, typename ST>
+	void DitherBlock(DT *dest, const ST *src, size_t n);
 
 	template<typename ST, typename DT>
 	void DitherConvert(typename DT::pointer_type dest,
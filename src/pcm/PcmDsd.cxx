@@ -19,29 +19,33 @@
 
 #include "config.h"
 #include "PcmDsd.hxx"
-#include "dsd2pcm/dsd2pcm.h"
 #include "util/ConstBuffer.hxx"
 
 #include <assert.h>
 
-PcmDsd::PcmDsd()
+void
+PcmDsd::Reset()
 {
-	dsd2pcm.fill(nullptr);
-}
+	dsd2pcm.Reset();
 
-PcmDsd::~PcmDsd()
-{
-	for (auto i : dsd2pcm)
-		if (i != nullptr)
-			dsd2pcm_destroy(i);
+	for (auto &i : decimators)
+		i.Reset();
 }
 
 void
-PcmDsd::Reset()
+PcmDsd::SetDecimation(unsigned factor)
 {
-	for (auto i : dsd2pcm)
-		if (i != nullptr)
-			dsd2pcm_reset(i);
+	assert(factor > 0);
+	assert(factor <= MAX_DECIMATION);
+	assert((factor & (factor - 1)) == 0);
+
+	n_decimators = 0;
+	while (factor > 1) {
+		factor /= 2;
+		++n_decimators;
+	}
+
+	assert(n_decimators <= decimators.size());
 }
 
 ConstBuffer<float>
@@ -50,26 +54,19 @@ PcmDsd::ToFloat(unsigned channels, ConstBuffer<uint8_t> src)
 	assert(!src.IsNull());
 	assert(!src.IsEmpty());
 	assert(src.size % channels == 0);
-	assert(channels <= dsd2pcm.max_size());
+	assert(channels <= MAX_CHANNELS);
 
-	const unsigned num_samples = src.size;
-	const unsigned num_frames = src.size / channels;
+	const size_t num_samples = src.size;
+	const size_t num_frames = src.size / channels;
 
 	float *dest = buffer.GetT<float>(num_samples);
+	dsd2pcm.Translate(channels, num_frames, src.data, dest);
 
-	for (unsigned c = 0; c < channels; ++c) {
-		if (dsd2pcm[c] == nullptr) {
-			dsd2pcm[c] = dsd2pcm_init();
-			if (dsd2pcm[c] == nullptr)
-				return nullptr;
-		}
-
-		dsd2pcm_translate(dsd2pcm[c], num_frames,
-				  src.data + c, channels,
-				  false, dest + c, channels);
-	}
+	ConstBuffer<float> result(dest, num_samples);
+	for (unsigned i = 0; i < n_decimators; ++i)
+		result = decimators[i].Process(channels, result);
 
-	return { dest, num_samples };
+	return result;
 }
 
 /**
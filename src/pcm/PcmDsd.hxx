@@ -22,6 +22,8 @@
 
 #include "check.h"
 #include "PcmBuffer.hxx"
+#include "MultiDsd2Pcm.hxx"
+#include "HalfbandDecimator.hxx"
 #include "AudioFormat.hxx"
 
 #include <array>
@@ -31,19 +33,39 @@
 template<typename T> struct ConstBuffer;
 
 /**
- * Wrapper for the dsd2pcm library.
+ * Convert DSD_U8 to floating point samples, using the dsd2pcm filter
+ * and optionally a chain of #HalfbandDecimator stages.
  */
 class PcmDsd {
+public:
+	/**
+	 * The maximum value for SetDecimation().
+	 */
+	static constexpr unsigned MAX_DECIMATION = 16;
+
+private:
 	PcmBuffer buffer;
 
-	std::array<struct dsd2pcm_ctx_s *, MAX_CHANNELS> dsd2pcm;
+	MultiDsd2Pcm dsd2pcm;
 
-public:
-	PcmDsd();
-	~PcmDsd();
+	std::array<HalfbandDecimator, 4> decimators;
 
+	/**
+	 * The number of #decimators in use.
+	 */
+	unsigned n_decimators = 0;
+
+public:
 	void Reset();
 
+	/**
+	 * Decimate the output further by the given factor, which
+	 * must be a power of two not larger than #MAX_DECIMATION.
+	 * The output sample rate is then the DSD byte rate divided
+	 * by this factor.
+	 */
+	void SetDecimation(unsigned factor);
+
 	ConstBuffer<float> ToFloat(unsigned channels,
 				   ConstBuffer<uint8_t> src);
 };
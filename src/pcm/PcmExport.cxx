@@ -20,15 +20,276 @@
 #include "config.h"
 #include "PcmExport.hxx"
 #include "Order.hxx"
-#include "PcmPack.hxx"
-#include "util/ByteReverse.hxx"
+#include "system/ByteOrder.hxx"
 #include "util/ConstBuffer.hxx"
 
+#include <string.h>
+
 #ifdef ENABLE_DSD
 #include "PcmDsd.hxx"
-#include "PcmDop.hxx"
 #endif
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * Store a sample unmodified.
+ */
+template<typename T>
+struct CopyStore {
+	typedef T value_type;
+	static constexpr size_t SIZE = sizeof(T);
+
+	static void Store(uint8_t *dest, T value) {
+		memcpy(dest, &value, sizeof(value));
+	}
+};
+
+template<typename T>
+struct ReverseStore {
+	typedef T value_type;
+	static constexpr size_t SIZE = sizeof(T);
+
+	static void Store(uint8_t *dest, T value) {
+		value = ByteSwap(value);
+		memcpy(dest, &value, sizeof(value));
+	}
+
+private:
+	static uint16_t ByteSwap(uint16_t value) {
+		return ByteSwap16(value);
+	}
+
+	static uint32_t ByteSwap(uint32_t value) {
+		return ByteSwap32(value);
+	}
+};
+
+/**
+ * Convert padded 24 bit samples to 32 bit.
+ */
+template<typename Next>
+struct Shift8Store {
+	typedef uint32_t value_type;
+	static constexpr size_t SIZE = 4;
+
+	static void Store(uint8_t *dest, uint32_t value) {
+		Next::Store(dest, value << 8);
+	}
+};
+
+/**
+ * Store the lower 24 bits of a sample in 3 bytes.
+ */
+template<bool big_endian>
+struct Pack24Store {
+	typedef uint32_t value_type;
+	static constexpr size_t SIZE = 3;
+
+	static void Store(uint8_t *dest, uint32_t value) {
+		if (big_endian) {
+			dest[0] = value >> 16;
+			dest[1] = value >> 8;
+			dest[2] = value;
+		} else {
+			dest[0] = value;
+			dest[1] = value >> 8;
+			dest[2] = value >> 16;
+		}
+	}
+};
+
+template<typename S, bool reorder>
+static void
+ExportKernel(void *_dest, ConstBuffer<void> _src, unsigned channels)
+{
+	typedef typename S::value_type value_type;
+
+	const auto src = ConstBuffer<value_type>::FromVoid(_src);
+	const uint8_t *const order = GetAlsaChannelOrder(channels);
+	assert(!reorder || order != nullptr);
+
+	uint8_t *dest = (uint8_t *)_dest;
+
+	if (reorder) {
+		const size_t n_frames = src.size / channels;
+		const value_type *p = src.data;
+		for (size_t i = 0; i < n_frames; ++i, p += channels)
+			for (unsigned c = 0; c < channels; ++c, dest += S::SIZE)
+				S::Store(dest, p[order[c]]);
+	} else {
+		for (auto i : src) {
+			S::Store(dest, i);
+			dest += S::SIZE;
+		}
+	}
+}
+
+#ifdef ENABLE_DSD
+
+/**
+ * The DoP marker of even frames; followed by 16 DSD bits.
+ */
+static constexpr uint32_t DOP_MARKER1 = 0xff050000;
+
+/**
+ * The DoP marker of odd frames; followed by 16 DSD bits.
+ */
+static constexpr uint32_t DOP_MARKER2 = 0xfffa0000;
+
+/**
+ * Describes whether a #Store can be applied to four DoP samples in
+ * a SSE2 register.  Only the 32 bit stores without byte swapping
+ * are implemented; all others use the portable code.
+ */
+template<typename S>
+struct DopVectorStore {
+	static constexpr bool enabled = false;
+
+#ifdef __SSE2__
+	/* never called, but needed to instantiate the kernel */
+	static __m128i Apply(__m128i value) {
+		return value;
+	}
+#endif
+};
+
+template<>
+struct DopVectorStore<CopyStore<uint32_t>> {
+	static constexpr bool enabled = true;
+
+#ifdef __SSE2__
+	static __m128i Apply(__m128i value) {
+		return value;
+	}
+#endif
+};
+
+template<>
+struct DopVectorStore<Shift8Store<CopyStore<uint32_t>>> {
+	static constexpr bool enabled = true;
+
+#ifdef __SSE2__
+	static __m128i Apply(__m128i value) {
+		return _mm_slli_epi32(value, 8);
+	}
+#endif
+};
+
+#ifdef __SSE2__
+
+/**
+ * Pack 16 bytes of stereo DSD (8 frames) into 4 DoP frames.
+ */
+template<typename V>
+static inline void
+DopStereoSse2(uint8_t *dest, const uint8_t *src)
+{
+	/* each 32 bit lane contains two DSD frames: L0 R0 L1 R1 */
+	const __m128i x = _mm_loadu_si128((const __m128i *)src);
+
+	const __m128i mask_lo = _mm_set1_epi32(0x00ff00ff);
+	const __m128i mask_ff00 = _mm_set1_epi32(0x0000ff00);
+	const __m128i markers = _mm_set_epi32(DOP_MARKER2, DOP_MARKER1,
+					      DOP_MARKER2, DOP_MARKER1);
+
+	/* split the channels: 0 X1 0 X0 */
+	const __m128i l = _mm_and_si128(x, mask_lo);
+	const __m128i r = _mm_and_si128(_mm_srli_epi32(x, 8), mask_lo);
+
+	/* move them to the DoP payload: X0 << 8 | X1 */
+	const __m128i dl =
+		_mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_slli_epi32(l, 8),
+							mask_ff00),
+					  _mm_srli_epi32(l, 16)),
+			     markers);
+	const __m128i dr =
+		_mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_slli_epi32(r, 8),
+							mask_ff00),
+					  _mm_srli_epi32(r, 16)),
+			     markers);
+
+	_mm_storeu_si128((__m128i *)dest,
+			 V::Apply(_mm_unpacklo_epi32(dl, dr)));
+	_mm_storeu_si128((__m128i *)(dest + 16),
+			 V::Apply(_mm_unpackhi_epi32(dl, dr)));
+}
+
+#endif
+
+/**
+ * Convert DSD to DoP and pass each DoP sample to the #Store, all in
+ * one pass.  Four DSD bytes per channel make two DoP frames; a
+ * trailing incomplete block is discarded.
+ */
+template<typename S, bool reorder>
+static void
+DopKernel(void *_dest, ConstBuffer<void> _src, unsigned channels)
+{
+	const auto src = ConstBuffer<uint8_t>::FromVoid(_src);
+	const uint8_t *const order = GetAlsaChannelOrder(channels);
+	assert(!reorder || order != nullptr);
+
+	uint8_t *dest = (uint8_t *)_dest;
+	const uint8_t *p = src.data;
+	const size_t n_blocks = src.size / (4 * channels);
+	size_t i = 0;
+
+#ifdef __SSE2__
+	if (DopVectorStore<S>::enabled && !reorder && channels == 2) {
+		for (; i + 2 <= n_blocks; i += 2, p += 16, dest += 32)
+			DopStereoSse2<DopVectorStore<S>>(dest, p);
+	}
+#endif
+
+	for (; i < n_blocks; ++i, p += 4 * channels) {
+		for (unsigned c = 0; c < channels; ++c, dest += S::SIZE) {
+			const unsigned sc = reorder ? order[c] : c;
+			S::Store(dest, DOP_MARKER1 | (p[sc] << 8) |
+				 p[channels + sc]);
+		}
+
+		for (unsigned c = 0; c < channels; ++c, dest += S::SIZE) {
+			const unsigned sc = reorder ? order[c] : c;
+			S::Store(dest, DOP_MARKER2 | (p[2 * channels + sc] << 8) |
+				 p[3 * channels + sc]);
+		}
+	}
+}
+
+template<typename S>
+static PcmExport::Kernel
+SelectDopKernel(bool reorder)
+{
+	return reorder
+		? DopKernel<S, true>
+		: DopKernel<S, false>;
+}
+
+#endif
+
+template<typename S>
+static PcmExport::Kernel
+SelectKernel(bool reorder)
+{
+	return reorder
+		? ExportKernel<S, true>
+		: ExportKernel<S, false>;
+}
+
+template<typename T>
+static PcmExport::Kernel
+SelectKernel(bool reorder, bool reverse)
+{
+	if (reverse)
+		return SelectKernel<ReverseStore<T>>(reorder);
+	else if (reorder)
+		return SelectKernel<CopyStore<T>>(reorder);
+	else
+		return nullptr;
+}
+
 void
 PcmExport::Open(SampleFormat sample_format, unsigned _channels,
 		Params params)
@@ -74,6 +335,50 @@ PcmExport::Open(SampleFormat sample_format, unsigned _channels,
 		if (sample_size > 1)
 			reverse_endian = sample_size;
 	}
+
+	/* DSD is reordered after the conversion to DoP/DSD_U32
+	   (where it is disguised as 32 bit PCM) only */
+	const bool reorder =
+		alsa_channel_order != SampleFormat::UNDEFINED &&
+		alsa_channel_order != SampleFormat::S8 &&
+		alsa_channel_order != SampleFormat::DSD &&
+		GetAlsaChannelOrder(channels) != nullptr;
+	const bool reverse = reverse_endian > 0;
+
+#ifdef ENABLE_DSD
+	if (dop) {
+		/* the DoP conversion is merged into the export
+		   kernel */
+		if (pack24)
+			kernel = reverse == IsBigEndian()
+				? SelectDopKernel<Pack24Store<false>>(reorder)
+				: SelectDopKernel<Pack24Store<true>>(reorder);
+		else if (shift8)
+			kernel = reverse
+				? SelectDopKernel<Shift8Store<ReverseStore<uint32_t>>>(reorder)
+				: SelectDopKernel<Shift8Store<CopyStore<uint32_t>>>(reorder);
+		else
+			kernel = reverse
+				? SelectDopKernel<ReverseStore<uint32_t>>(reorder)
+				: SelectDopKernel<CopyStore<uint32_t>>(reorder);
+		return;
+	}
+#endif
+
+	if (pack24)
+		kernel = reverse == IsBigEndian()
+			? SelectKernel<Pack24Store<false>>(reorder)
+			: SelectKernel<Pack24Store<true>>(reorder);
+	else if (shift8)
+		kernel = reverse
+			? SelectKernel<Shift8Store<ReverseStore<uint32_t>>>(reorder)
+			: SelectKernel<Shift8Store<CopyStore<uint32_t>>>(reorder);
+	else if (sample_format_size(sample_format) == 2)
+		kernel = SelectKernel<uint16_t>(reorder, reverse);
+	else if (sample_format_size(sample_format) == 4)
+		kernel = SelectKernel<uint32_t>(reorder, reverse);
+	else
+		kernel = nullptr;
 }
 
 size_t
@@ -98,59 +403,85 @@ PcmExport::GetFrameSize(const AudioFormat &audio_format) const
 	return audio_format.GetFrameSize();
 }
 
-ConstBuffer<void>
-PcmExport::Export(ConstBuffer<void> data)
+/**
+ * Apply the DSD conversions which cannot be done in one pass by the
+ * export kernel.
+ */
+inline ConstBuffer<void>
+PcmExport::ConvertDsd(ConstBuffer<void> data)
 {
-	if (alsa_channel_order != SampleFormat::UNDEFINED)
-		data = ToAlsaChannelOrder(order_buffer, data,
-					  alsa_channel_order, channels);
-
 #ifdef ENABLE_DSD
 	if (dsd_u32)
 		data = Dsd8To32(dop_buffer, channels,
 				ConstBuffer<uint8_t>::FromVoid(data))
 			.ToVoid();
+#endif
+
+	return data;
+}
 
+inline size_t
+PcmExport::GetKernelDestSize(size_t src_size) const
+{
+#ifdef ENABLE_DSD
 	if (dop)
-		data = pcm_dsd_to_dop(dop_buffer, channels,
-				      ConstBuffer<uint8_t>::FromVoid(data))
-			.ToVoid();
+		/* each block of 4 DSD bytes per channel becomes two
+		   DoP frames of 32 bit samples */
+		src_size = src_size / (4 * channels) * (2 * channels) * 4;
 #endif
 
-	if (pack24) {
-		const auto src = ConstBuffer<int32_t>::FromVoid(data);
-		const size_t num_samples = src.size;
-		const size_t dest_size = num_samples * 3;
-		uint8_t *dest = (uint8_t *)pack_buffer.Get(dest_size);
+	return pack24
+		? src_size / 4 * 3
+		: src_size;
+}
+
+ConstBuffer<void>
+PcmExport::Export(ConstBuffer<void> data)
+{
+	data = ConvertDsd(data);
+
+	if (kernel != nullptr) {
+		const size_t dest_size = GetKernelDestSize(data.size);
+		void *dest = buffer.Get(dest_size);
 		assert(dest != nullptr);
 
-		pcm_pack_24(dest, src.begin(), src.end());
+		kernel(dest, data, channels);
 
 		data.data = dest;
 		data.size = dest_size;
-	} else if (shift8) {
-		const auto src = ConstBuffer<int32_t>::FromVoid(data);
+	}
 
-		uint32_t *dest = (uint32_t *)pack_buffer.Get(data.size);
-		data.data = dest;
+	return data;
+}
 
-		for (auto i : src)
-			*dest++ = i << 8;
-	}
+size_t
+PcmExport::ExportTo(void *dest, ConstBuffer<void> data)
+{
+	data = ConvertDsd(data);
 
-	if (reverse_endian > 0) {
-		assert(reverse_endian >= 2);
+	if (kernel != nullptr) {
+		kernel(dest, data, channels);
+		return GetKernelDestSize(data.size);
+	}
 
-		const auto src = ConstBuffer<uint8_t>::FromVoid(data);
+	memcpy(dest, data.data, data.size);
+	return data.size;
+}
 
-		uint8_t *dest = (uint8_t *)reverse_buffer.Get(data.size);
-		assert(dest != nullptr);
-		data.data = dest;
+size_t
+PcmExport::CalcDestSize(size_t size) const
+{
+#ifdef ENABLE_DSD
+	if (dop)
+		/* DoP doubles the transport size */
+		size *= 2;
+#endif
 
-		reverse_bytes(dest, src.begin(), src.end(), reverse_endian);
-	}
+	if (pack24)
+		/* 32 bit to 24 bit conversion (4 to 3 bytes) */
+		size = size / 4 * 3;
 
-	return data;
+	return size;
 }
 
 size_t
@@ -43,36 +43,35 @@ struct PcmExport {
 		bool reverse_endian = false;
 	};
 
-	/**
-	 * This buffer is used to reorder channels.
-	 *
-	 * @see #alsa_channel_order
-	 */
-	PcmBuffer order_buffer;
-
 #ifdef ENABLE_DSD
 	/**
 	 * The buffer is used to convert DSD samples to the
-	 * DoP format.
+	 * DSD_U32 format.
 	 *
-	 * @see #dop
+	 * @see #dsd_u32
 	 */
 	PcmBuffer dop_buffer;
 #endif
 
 	/**
-	 * The buffer is used to pack samples, removing padding.
-	 *
-	 * @see #pack24
+	 * The destination buffer of #kernel.
 	 */
-	PcmBuffer pack_buffer;
+	PcmBuffer buffer;
 
 	/**
-	 * The buffer is used to reverse the byte order.
-	 *
-	 * @see #reverse_endian
+	 * A function which performs the DoP conversion, channel
+	 * reordering, 24 bit packing, shifting and byte reversal in
+	 * one pass from "src" to "dest".
 	 */
-	PcmBuffer reverse_buffer;
+	typedef void (*Kernel)(void *dest, ConstBuffer<void> src,
+			       unsigned channels);
+
+	/**
+	 * The kernel for the combination of options chosen by
+	 * Open(), or nullptr if the samples are passed through
+	 * unmodified (after the DSD conversion).
+	 */
+	Kernel kernel;
 
 	/**
 	 * The number of channels.
@@ -148,6 +147,26 @@ struct PcmExport {
 	 */
 	ConstBuffer<void> Export(ConstBuffer<void> src);
 
+	/**
+	 * Like Export(), but write the result to the given buffer
+	 * instead of an internal one.  This allows exporting
+	 * straight into a device's DMA buffer.
+	 *
+	 * @param dest the destination buffer; it must be large
+	 * enough for CalcDestSize(src.size) bytes
+	 * @return the number of bytes written to the destination
+	 * buffer
+	 */
+	size_t ExportTo(void *dest, ConstBuffer<void> src);
+
+	/**
+	 * Converts the number of bytes in the pcm_export() source
+	 * buffer to the according number of bytes in the destination
+	 * buffer.  This is the reverse of CalcSourceSize().
+	 */
+	gcc_pure
+	size_t CalcDestSize(size_t src_size) const;
+
 	/**
 	 * Converts the number of consumed bytes from the pcm_export()
 	 * destination buffer to the according number of bytes from the
@@ -155,6 +174,16 @@ struct PcmExport {
 	 */
 	gcc_pure
 	size_t CalcSourceSize(size_t dest_size) const;
+
+private:
+	ConstBuffer<void> ConvertDsd(ConstBuffer<void> src);
+
+	/**
+	 * Calculate the size of the #kernel output for the given
+	 * input size (after ConvertDsd()).
+	 */
+	gcc_pure
+	size_t GetKernelDestSize(size_t src_size) const;
 };
 
 #endif
@@ -25,6 +25,7 @@
 #include "FloatConvert.hxx"
 #include "ShiftConvert.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/CpuFeatures.hxx"
 
 #include "PcmDither.cxx" // including the .cxx file to get inlined templates
 
@@ -106,6 +107,31 @@ public:
 	}
 };
 
+/**
+ * Like #GlueOptimizedConvert, but checks at runtime whether the CPU
+ * supports the "optimized" algorithm; if not, the "fallback" (which
+ * may be another #GlueRuntimeOptimizedConvert) converts the whole
+ * buffer.
+ */
+template<typename Optimized, typename Fallback>
+class GlueRuntimeOptimizedConvert {
+	GlueOptimizedConvert<Optimized, Fallback> optimized;
+	Fallback fallback;
+
+public:
+	typedef typename Fallback::SrcTraits SrcTraits;
+	typedef typename Fallback::DstTraits DstTraits;
+
+	void Convert(typename DstTraits::pointer_type out,
+		     typename SrcTraits::const_pointer_type in,
+		     size_t n) const {
+		if (Optimized::IsSupported())
+			optimized.Convert(out, in, n);
+		else
+			fallback.Convert(out, in, n);
+	}
+};
+
 #ifdef __ARM_NEON__
 #include "Neon.hxx"
 
@@ -116,6 +142,68 @@ struct FloatToInteger<SampleFormat::S16, SampleTraits<SampleFormat::S16>>
 
 #endif
 
+template<SampleFormat F, class Traits=SampleTraits<F>>
+struct PortableIntegerToFloat
+	: PerSampleConvert<IntegerToFloatSampleConvert<F, Traits>> {};
+
+template<SampleFormat F, class Traits=SampleTraits<F>>
+struct IntegerToFloat : PortableIntegerToFloat<F, Traits> {};
+
+#ifdef HAVE_X86_DISPATCH
+#include "X86Format.hxx"
+
+/**
+ * Try AVX first, then SSE, then the portable code.
+ */
+template<template<SampleFormat, class> class Avx,
+	 template<SampleFormat, class> class Sse,
+	 typename Portable,
+	 SampleFormat F, class Traits=SampleTraits<F>>
+using X86OptimizedConvert =
+	GlueRuntimeOptimizedConvert<Avx<F, Traits>,
+				    GlueRuntimeOptimizedConvert<Sse<F, Traits>,
+								Portable>>;
+
+template<>
+struct FloatToInteger<SampleFormat::S16, SampleTraits<SampleFormat::S16>>
+	: X86OptimizedConvert<AvxFloatToInteger, SseFloatToInteger,
+			      PortableFloatToInteger<SampleFormat::S16>,
+			      SampleFormat::S16> {};
+
+template<>
+struct FloatToInteger<SampleFormat::S24_P32,
+		      SampleTraits<SampleFormat::S24_P32>>
+	: X86OptimizedConvert<AvxFloatToInteger, SseFloatToInteger,
+			      PortableFloatToInteger<SampleFormat::S24_P32>,
+			      SampleFormat::S24_P32> {};
+
+template<>
+struct FloatToInteger<SampleFormat::S32, SampleTraits<SampleFormat::S32>>
+	: X86OptimizedConvert<AvxFloatToInteger, SseFloatToInteger,
+			      PortableFloatToInteger<SampleFormat::S32>,
+			      SampleFormat::S32> {};
+
+template<>
+struct IntegerToFloat<SampleFormat::S16, SampleTraits<SampleFormat::S16>>
+	: X86OptimizedConvert<AvxIntegerToFloat, SseIntegerToFloat,
+			      PortableIntegerToFloat<SampleFormat::S16>,
+			      SampleFormat::S16> {};
+
+template<>
+struct IntegerToFloat<SampleFormat::S24_P32,
+		      SampleTraits<SampleFormat::S24_P32>>
+	: X86OptimizedConvert<AvxIntegerToFloat, SseIntegerToFloat,
+			      PortableIntegerToFloat<SampleFormat::S24_P32>,
+			      SampleFormat::S24_P32> {};
+
+template<>
+struct IntegerToFloat<SampleFormat::S32, SampleTraits<SampleFormat::S32>>
+	: X86OptimizedConvert<AvxIntegerToFloat, SseIntegerToFloat,
+			      PortableIntegerToFloat<SampleFormat::S32>,
+			      SampleFormat::S32> {};
+
+#endif
+
 template<class C>
 static ConstBuffer<typename C::DstTraits::value_type>
 AllocateConvert(PcmBuffer &buffer, C convert,
@@ -330,14 +418,11 @@ pcm_convert_to_32(PcmBuffer &buffer,
 struct Convert8ToFloat
 	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S8>> {};
 
-struct Convert16ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S16>> {};
+struct Convert16ToFloat : IntegerToFloat<SampleFormat::S16> {};
 
-struct Convert24ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S24_P32>> {};
+struct Convert24ToFloat : IntegerToFloat<SampleFormat::S24_P32> {};
 
-struct Convert32ToFloat
-	: PerSampleConvert<IntegerToFloatSampleConvert<SampleFormat::S32>> {};
+struct Convert32ToFloat : IntegerToFloat<SampleFormat::S32> {};
 
 static ConstBuffer<float>
 pcm_allocate_8_to_float(PcmBuffer &buffer, ConstBuffer<int8_t> src)
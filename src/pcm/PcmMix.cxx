@@ -24,9 +24,17 @@
 #include "AudioFormat.hxx"
 #include "Traits.hxx"
 #include "util/Clamp.hxx"
+#include "util/CpuFeatures.hxx"
 
 #include "PcmDither.cxx" // including the .cxx file to get inlined templates
 
+#ifdef HAVE_X86_DISPATCH
+#include "X86Mix.hxx"
+#endif
+
+#include <algorithm>
+#include <type_traits>
+
 #include <assert.h>
 #include <math.h>
 
@@ -56,6 +64,47 @@ PcmAddVolume(PcmDither &dither,
 					       volume1, volume2);
 }
 
+#ifdef HAVE_X86_DISPATCH
+
+/**
+ * Mix with a SIMD kernel which calculates one block at a time into a
+ * widened temporary buffer.  The dithering step carries state from
+ * one sample to the next, so it remains scalar; this keeps the
+ * output bit-identical to the portable PcmAddVolume().
+ *
+ * @return false if the CPU has no suitable SIMD kernel
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>, typename K>
+static bool
+PcmAddVolumeSimd(PcmDither &dither,
+		 typename Traits::pointer_type a,
+		 typename Traits::const_pointer_type b,
+		 size_t n, int volume1, int volume2, K kernel)
+{
+	typedef typename Traits::long_type long_type;
+
+	constexpr size_t BLOCK_SIZE = 256;
+	long_type block[BLOCK_SIZE];
+
+	while (n > 0) {
+		const size_t chunk = std::min(n, BLOCK_SIZE);
+		if (!kernel(block, a, b, chunk, volume1, volume2))
+			return false;
+
+		dither.DitherShiftBlock<long_type,
+					Traits::BITS + PCM_VOLUME_BITS,
+					Traits::BITS>(a, block, chunk);
+
+		a += chunk;
+		b += chunk;
+		n -= chunk;
+	}
+
+	return true;
+}
+
+#endif
+
 template<SampleFormat F, class Traits=SampleTraits<F>>
 static void
 PcmAddVolumeVoid(PcmDither &dither,
@@ -103,24 +152,62 @@ pcm_add_vol(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
 		return true;
 
 	case SampleFormat::S16:
+#ifdef HAVE_X86_DISPATCH
+		if (PcmAddVolumeSimd<SampleFormat::S16>(dither,
+							(int16_t *)buffer1,
+							(const int16_t *)buffer2,
+							size / sizeof(int16_t),
+							vol1, vol2,
+							X86MixScale16))
+			return true;
+#endif
+
 		PcmAddVolumeVoid<SampleFormat::S16>(dither,
 						    buffer1, buffer2, size,
 						    vol1, vol2);
 		return true;
 
 	case SampleFormat::S24_P32:
+#ifdef HAVE_X86_DISPATCH
+		if (PcmAddVolumeSimd<SampleFormat::S24_P32>(dither,
+							    (int32_t *)buffer1,
+							    (const int32_t *)buffer2,
+							    size / sizeof(int32_t),
+							    vol1, vol2,
+							    X86MixScale32))
+			return true;
+#endif
+
 		PcmAddVolumeVoid<SampleFormat::S24_P32>(dither,
 							buffer1, buffer2, size,
 							vol1, vol2);
 		return true;
 
 	case SampleFormat::S32:
+#ifdef HAVE_X86_DISPATCH
+		if (PcmAddVolumeSimd<SampleFormat::S32>(dither,
+							(int32_t *)buffer1,
+							(const int32_t *)buffer2,
+							size / sizeof(int32_t),
+							vol1, vol2,
+							X86MixScale32))
+			return true;
+#endif
+
 		PcmAddVolumeVoid<SampleFormat::S32>(dither,
 						    buffer1, buffer2, size,
 						    vol1, vol2);
 		return true;
 
 	case SampleFormat::FLOAT:
+#ifdef HAVE_X86_DISPATCH
+		if (X86MixFloat((float *)buffer1, (const float *)buffer2,
+				size / sizeof(float),
+				pcm_volume_to_float(vol1),
+				pcm_volume_to_float(vol2)))
+			return true;
+#endif
+
 		pcm_add_vol_float((float *)buffer1, (const float *)buffer2,
 				  size / 4,
 				  pcm_volume_to_float(vol1),
@@ -189,18 +276,42 @@ pcm_add(void *buffer1, const void *buffer2, size_t size,
 		return true;
 
 	case SampleFormat::S16:
+#ifdef HAVE_X86_DISPATCH
+		if (X86Add16((int16_t *)buffer1, (const int16_t *)buffer2,
+			     size / sizeof(int16_t)))
+			return true;
+#endif
+
 		PcmAddVoid<SampleFormat::S16>(buffer1, buffer2, size);
 		return true;
 
 	case SampleFormat::S24_P32:
+#ifdef HAVE_X86_DISPATCH
+		if (X86Add24((int32_t *)buffer1, (const int32_t *)buffer2,
+			     size / sizeof(int32_t)))
+			return true;
+#endif
+
 		PcmAddVoid<SampleFormat::S24_P32>(buffer1, buffer2, size);
 		return true;
 
 	case SampleFormat::S32:
+#ifdef HAVE_X86_DISPATCH
+		if (X86Add32((int32_t *)buffer1, (const int32_t *)buffer2,
+			     size / sizeof(int32_t)))
+			return true;
+#endif
+
 		PcmAddVoid<SampleFormat::S32>(buffer1, buffer2, size);
 		return true;
 
 	case SampleFormat::FLOAT:
+#ifdef HAVE_X86_DISPATCH
+		if (X86AddFloat((float *)buffer1, (const float *)buffer2,
+				size / sizeof(float)))
+			return true;
+#endif
+
 		pcm_add_float((float *)buffer1, (const float *)buffer2,
 			      size / 4);
 		return true;
@@ -210,19 +321,28 @@ pcm_add(void *buffer1, const void *buffer2, size_t size,
 	gcc_unreachable();
 }
 
+/**
+ * Convert a cross-fade portion (0.0 to 1.0) to the gain of the first
+ * buffer; the curve keeps the total power roughly constant.
+ */
+gcc_const
+static double
+CrossFadeGain(float portion)
+{
+	const double s = sin(M_PI_2 * portion);
+	return s * s;
+}
+
 bool
 pcm_mix(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
 	SampleFormat format, float portion1)
 {
-	float s;
-
 	/* portion1 is between 0.0 and 1.0 for crossfading, MixRamp uses -1
 	 * to signal mixing rather than fading */
 	if (portion1 < 0)
 		return pcm_add(buffer1, buffer2, size, format);
 
-	s = sin(M_PI_2 * portion1);
-	s *= s;
+	const float s = CrossFadeGain(portion1);
 
 	int vol1 = s * PCM_VOLUME_1S + 0.5;
 	vol1 = Clamp<int>(vol1, 0, PCM_VOLUME_1S);
@@ -230,3 +350,171 @@ pcm_mix(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
 	return pcm_add_vol(dither, buffer1, buffer2, size,
 			   vol1, PCM_VOLUME_1S - vol1, format);
 }
+
+/**
+ * The number of frames processed in one block by the ramp mixers;
+ * the gains and the intermediate results live on the stack.
+ */
+static constexpr size_t RAMP_BLOCK_FRAMES = 64;
+
+/**
+ * Fill a block with one gain per sample: linearly interpolated per
+ * frame, the same for all channels of a frame.
+ */
+template<typename T>
+static void
+FillGainRamp(T *gain, size_t n_frames, unsigned channels,
+	     double start, double step)
+{
+	for (size_t i = 0; i < n_frames; ++i) {
+		const T g = start + i * step;
+		for (unsigned c = 0; c < channels; ++c)
+			*gain++ = g;
+	}
+}
+
+/**
+ * Mix integer samples with a gain ramp in floating point.  The
+ * result is scaled to #PCM_VOLUME_BITS more than the sample format
+ * (like PcmAddVolume()) and then dithered down, so there is only one
+ * rounding step.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static void
+PcmMixRamp(PcmDither &dither,
+	   typename Traits::pointer_type a,
+	   typename Traits::const_pointer_type b,
+	   size_t n_frames, unsigned channels, double gain, double step)
+{
+	typedef typename Traits::long_type long_type;
+
+	/* float represents 24 bit samples exactly, 32 bit needs
+	   double */
+	typedef typename std::conditional<Traits::BITS <= 24,
+					  float, double>::type mix_type;
+	constexpr mix_type scale = 1 << PCM_VOLUME_BITS;
+
+	mix_type gains[RAMP_BLOCK_FRAMES * MAX_CHANNELS];
+	long_type block[RAMP_BLOCK_FRAMES * MAX_CHANNELS];
+
+	while (n_frames > 0) {
+		const size_t chunk = std::min(n_frames, RAMP_BLOCK_FRAMES);
+		const size_t n = chunk * channels;
+
+		FillGainRamp(gains, chunk, channels, gain, step);
+
+		/* no dependencies between the samples; the
+		   compiler vectorizes this loop */
+		for (size_t i = 0; i != n; ++i) {
+			const mix_type x = a[i], y = b[i];
+			block[i] = long_type((y + (x - y) * gains[i]) * scale);
+		}
+
+		dither.DitherShiftBlock<long_type,
+					Traits::BITS + PCM_VOLUME_BITS,
+					Traits::BITS>(a, block, n);
+
+		a += n;
+		b += n;
+		n_frames -= chunk;
+		gain += chunk * step;
+	}
+}
+
+template<SampleFormat F, class Traits=SampleTraits<F>>
+static void
+PcmMixRampVoid(PcmDither &dither, void *a, const void *b,
+	       size_t n_frames, unsigned channels, double gain, double step)
+{
+	PcmMixRamp<F, Traits>(dither,
+			      typename Traits::pointer_type(a),
+			      typename Traits::const_pointer_type(b),
+			      n_frames, channels, gain, step);
+}
+
+static void
+pcm_mix_ramp_float(float *a, const float *b,
+		   size_t n_frames, unsigned channels,
+		   double gain, double step)
+{
+	float gains[RAMP_BLOCK_FRAMES * MAX_CHANNELS];
+
+	while (n_frames > 0) {
+		const size_t chunk = std::min(n_frames, RAMP_BLOCK_FRAMES);
+		const size_t n = chunk * channels;
+
+		FillGainRamp(gains, chunk, channels, gain, step);
+
+		for (size_t i = 0; i != n; ++i)
+			a[i] = b[i] + (a[i] - b[i]) * gains[i];
+
+		a += n;
+		b += n;
+		n_frames -= chunk;
+		gain += chunk * step;
+	}
+}
+
+bool
+pcm_mix_ramp(PcmDither &dither, void *buffer1, const void *buffer2,
+	     size_t size, SampleFormat format, unsigned channels,
+	     float portion_start, float portion_end)
+{
+	assert(channels > 0 && channels <= MAX_CHANNELS);
+
+	if (portion_start < 0)
+		/* MixRamp: no fading */
+		return pcm_add(buffer1, buffer2, size, format);
+
+	const size_t frame_size = sample_format_size(format) * channels;
+	if (frame_size == 0)
+		return false;
+
+	assert(size % frame_size == 0);
+	const size_t n_frames = size / frame_size;
+	if (n_frames == 0)
+		return true;
+
+	const double gain = CrossFadeGain(portion_start);
+	const double step = (CrossFadeGain(portion_end) - gain) / n_frames;
+
+	switch (format) {
+	case SampleFormat::UNDEFINED:
+	case SampleFormat::DSD:
+		/* not implemented */
+		return false;
+
+	case SampleFormat::S8:
+		PcmMixRampVoid<SampleFormat::S8>(dither, buffer1, buffer2,
+						 n_frames, channels,
+						 gain, step);
+		return true;
+
+	case SampleFormat::S16:
+		PcmMixRampVoid<SampleFormat::S16>(dither, buffer1, buffer2,
+						  n_frames, channels,
+						  gain, step);
+		return true;
+
+	case SampleFormat::S24_P32:
+		PcmMixRampVoid<SampleFormat::S24_P32>(dither,
+						      buffer1, buffer2,
+						      n_frames, channels,
+						      gain, step);
+		return true;
+
+	case SampleFormat::S32:
+		PcmMixRampVoid<SampleFormat::S32>(dither, buffer1, buffer2,
+						  n_frames, channels,
+						  gain, step);
+		return true;
+
+	case SampleFormat::FLOAT:
+		pcm_mix_ramp_float((float *)buffer1, (const float *)buffer2,
+				   n_frames, channels, gain, step);
+		return true;
+	}
+
+	assert(false);
+	gcc_unreachable();
+}
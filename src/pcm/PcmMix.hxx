@@ -49,4 +49,25 @@ bool
 pcm_mix(PcmDither &dither, void *buffer1, const void *buffer2, size_t size,
 	SampleFormat format, float portion1);
 
+/**
+ * Like pcm_mix(), but the portion of the first buffer moves from
+ * portion_start (at the first frame) to portion_end (after the last
+ * frame), interpolated per frame, so consecutive calls produce a
+ * smooth fade instead of one step per call.  The mix is calculated
+ * in floating point; integer samples are dithered once when
+ * converting back.
+ *
+ * @param channels the number of channels (interleaved)
+ * @param portion_start the portion of the first buffer at the
+ * beginning; negative values request simple addition (MixRamp)
+ * @param portion_end the portion of the first buffer at the end
+ *
+ * @return true on success, false if the format is not supported
+ */
+gcc_warn_unused_result
+bool
+pcm_mix_ramp(PcmDither &dither, void *buffer1, const void *buffer2,
+	     size_t size, SampleFormat format, unsigned channels,
+	     float portion_start, float portion_end);
+
 #endif
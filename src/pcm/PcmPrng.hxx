@@ -20,6 +20,8 @@
 #ifndef MPD_PCM_PRNG_HXX
 #define MPD_PCM_PRNG_HXX
 
+#include <stdint.h>
+
 /**
  * A very simple linear congruential PRNG.  It's good enough for PCM
  * dithering.
@@ -30,4 +32,31 @@ pcm_prng(unsigned long state)
 	return (state * 0x0019660dL + 0x3c6ef35fL) & 0xffffffffL;
 }
 
+/**
+ * The multiplier which advances the pcm_prng() state by #n steps at
+ * once (together with pcm_prng_increment()).
+ */
+constexpr static inline uint32_t
+pcm_prng_multiplier(unsigned n)
+{
+	return n > 0
+		? uint32_t(0x0019660d) * pcm_prng_multiplier(n - 1)
+		: 1;
+}
+
+/**
+ * The increment which advances the pcm_prng() state by #n steps at
+ * once: pcm_prng() applied #n times to "state" equals
+ * (pcm_prng_multiplier(n) * state + pcm_prng_increment(n)) modulo
+ * 2^32.
+ */
+constexpr static inline uint32_t
+pcm_prng_increment(unsigned n)
+{
+	return n > 0
+		? uint32_t(0x0019660d) * pcm_prng_increment(n - 1)
+		+ uint32_t(0x3c6ef35f)
+		: 0;
+}
+
 #endif
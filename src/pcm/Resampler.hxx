@@ -54,6 +54,13 @@ public:
 	 */
 	virtual void Close() = 0;
 
+	/**
+	 * Discard all buffered data and filter history, as if the
+	 * resampler had just been opened.  This allows reusing an
+	 * open resampler for an unrelated stream.
+	 */
+	virtual void Reset() {}
+
 	/**
 	 * Resamples a block of PCM data.
 	 *
@@ -0,0 +1,100 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "ResamplerLoad.hxx"
+#include "config/Block.hxx"
+#include "config/ConfigError.hxx"
+#include "util/Error.hxx"
+
+#include <chrono>
+#include <memory>
+
+#include <assert.h>
+#include <math.h>
+
+/**
+ * The length of each block passed to the resampler [ms].
+ */
+static constexpr unsigned BLOCK_MS = 20;
+
+/**
+ * The number of blocks which fill the resampler's delay line before
+ * the measurement starts.
+ */
+static constexpr unsigned WARMUP_BLOCKS = 5;
+
+/**
+ * The number of blocks which are measured (a quarter of a second).
+ */
+static constexpr unsigned MEASURE_BLOCKS = 12;
+
+double
+ParseResamplerCpuBudget(const ConfigBlock &block, Error &error)
+{
+	const unsigned percent =
+		block.GetBlockValue("cpu_budget",
+				    DEFAULT_RESAMPLER_CPU_BUDGET);
+	if (percent == 0) {
+		error.Format(config_domain,
+			     "Invalid 'cpu_budget' in line %d", block.line);
+		return -1;
+	}
+
+	return percent / 100.;
+}
+
+double
+MeasureResamplerLoad(unsigned sample_rate, unsigned channels,
+		     const ResamplerLoadFunction &process)
+{
+	assert(sample_rate > 0);
+	assert(channels > 0);
+
+	const size_t n_frames = sample_rate * BLOCK_MS / 1000;
+	const size_t n_samples = n_frames * channels;
+
+	/* a 997 Hz sine; the resampler's cost does not depend on the
+	   signal, but silence might take shortcuts */
+	std::unique_ptr<float[]> block(new float[n_samples]);
+	for (size_t i = 0; i < n_frames; ++i) {
+		const float value =
+			0.5f * sinf(float(2 * M_PI * 997 * i / sample_rate));
+		for (unsigned c = 0; c < channels; ++c)
+			block[i * channels + c] = value;
+	}
+
+	for (unsigned i = 0; i < WARMUP_BLOCKS; ++i)
+		if (!process(block.get(), n_frames))
+			return -1;
+
+	const auto start = std::chrono::steady_clock::now();
+
+	for (unsigned i = 0; i < MEASURE_BLOCKS; ++i)
+		if (!process(block.get(), n_frames))
+			return -1;
+
+	const std::chrono::duration<double> elapsed =
+		std::chrono::steady_clock::now() - start;
+
+	const double duration = double(MEASURE_BLOCKS * n_frames)
+		/ sample_rate;
+	return elapsed.count() / duration;
+}
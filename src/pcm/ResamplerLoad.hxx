@@ -0,0 +1,66 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_PCM_RESAMPLER_LOAD_HXX
+#define MPD_PCM_RESAMPLER_LOAD_HXX
+
+#include <functional>
+
+#include <stddef.h>
+
+struct ConfigBlock;
+class Error;
+
+/**
+ * The default value of the "cpu_budget" setting: a quarter of one
+ * CPU core per resampler.
+ */
+static constexpr unsigned DEFAULT_RESAMPLER_CPU_BUDGET = 25;
+
+/**
+ * Parse the "cpu_budget" setting of a "resampler" block, which is
+ * the percentage of one CPU core a resampler may occupy when the
+ * quality is chosen automatically.
+ *
+ * @return the budget as a fraction (e.g. 0.25) or a negative value
+ * on error
+ */
+double
+ParseResamplerCpuBudget(const ConfigBlock &block, Error &error);
+
+/**
+ * Resample the given number of interleaved floating point frames,
+ * discarding the result.  Returns false on error.
+ */
+typedef std::function<bool(const float *src, size_t n_frames)> ResamplerLoadFunction;
+
+/**
+ * Feed a resampler with a test signal and measure how long it takes
+ * (wall-clock time), relative to the duration of the signal.  A
+ * result of 0.1 means that resampling in real time occupies 10% of
+ * one CPU core.
+ *
+ * @return the load or a negative value on error
+ */
+double
+MeasureResamplerLoad(unsigned sample_rate, unsigned channels,
+		     const ResamplerLoadFunction &process);
+
+#endif
@@ -19,14 +19,21 @@
 
 #include "config.h"
 #include "SoxrResampler.hxx"
+#include "ResamplerLoad.hxx"
 #include "AudioFormat.hxx"
 #include "config/Block.hxx"
+#include "thread/Mutex.hxx"
 #include "util/Error.hxx"
 #include "util/Domain.hxx"
 #include "Log.hxx"
 
 #include <soxr.h>
 
+#include <map>
+#include <memory>
+#include <thread>
+#include <tuple>
+
 #include <assert.h>
 #include <string.h>
 
@@ -39,9 +46,31 @@ static constexpr unsigned long SOXR_DEFAULT_RECIPE = SOXR_HQ;
  */
 static constexpr unsigned long SOXR_INVALID_RECIPE = -1;
 
+/**
+ * Special value for "choose the best quality which fits into the CPU
+ * budget".
+ */
+static constexpr unsigned long SOXR_AUTO_RECIPE = -2;
+
 static soxr_quality_spec_t soxr_quality;
 static soxr_runtime_spec_t soxr_runtime;
 
+/**
+ * Is the quality chosen by SoxrAutoQuality()?
+ */
+static bool soxr_auto_quality;
+
+/**
+ * The CPU budget for #soxr_auto_quality, a fraction of one core.
+ */
+static double soxr_cpu_budget;
+
+/**
+ * May SoxrAutoQuality() enable multi-threading?  This is only the
+ * case if the "threads" setting was not specified.
+ */
+static bool soxr_auto_threads;
+
 static constexpr struct {
 	unsigned long recipe;
 	const char *name;
@@ -73,6 +102,9 @@ soxr_parse_quality(const char *quality)
 	if (quality == nullptr)
 		return SOXR_DEFAULT_RECIPE;
 
+	if (strcmp(quality, "auto") == 0)
+		return SOXR_AUTO_RECIPE;
+
 	for (const auto *i = soxr_quality_table; i->name != nullptr; ++i)
 		if (strcmp(i->name, quality) == 0)
 			return i->recipe;
@@ -94,11 +126,24 @@ pcm_resample_soxr_global_init(const ConfigBlock &block, Error &error)
 		return false;
 	}
 
-	soxr_quality = soxr_quality_spec(recipe, 0);
+	soxr_auto_quality = recipe == SOXR_AUTO_RECIPE;
+	if (soxr_auto_quality) {
+		soxr_cpu_budget = ParseResamplerCpuBudget(block, error);
+		if (soxr_cpu_budget < 0)
+			return false;
+
+		FormatDebug(soxr_domain,
+			    "soxr converter 'auto' with %.0f%% CPU budget",
+			    soxr_cpu_budget * 100);
+	} else {
+		soxr_quality = soxr_quality_spec(recipe, 0);
+
+		FormatDebug(soxr_domain,
+			    "soxr converter '%s'",
+			    soxr_quality_name(recipe));
+	}
 
-	FormatDebug(soxr_domain,
-		    "soxr converter '%s'",
-		    soxr_quality_name(recipe));
+	soxr_auto_threads = block.GetBlockParam("threads") == nullptr;
 
 	const unsigned n_threads = block.GetBlockValue("threads", 1);
 	soxr_runtime = soxr_runtime_spec(n_threads);
@@ -106,6 +151,112 @@ pcm_resample_soxr_global_init(const ConfigBlock &block, Error &error)
 	return true;
 }
 
+struct SoxrSettings {
+	unsigned long recipe;
+	soxr_quality_spec_t quality;
+	soxr_runtime_spec_t runtime;
+};
+
+/**
+ * Measure the CPU load of a soxr instance with the given settings.
+ *
+ * @return the load or a negative value on error
+ */
+static double
+SoxrMeasureLoad(const SoxrSettings &settings,
+		unsigned src_rate, unsigned dest_rate, unsigned channels)
+{
+	soxr_error_t e;
+	soxr_t soxr = soxr_create(src_rate, dest_rate, channels, &e,
+				  nullptr,
+				  &settings.quality, &settings.runtime);
+	if (soxr == nullptr)
+		return -1;
+
+	const double ratio = double(dest_rate) / double(src_rate);
+	std::unique_ptr<float[]> output;
+	size_t output_size = 0;
+
+	const double load = MeasureResamplerLoad(src_rate, channels,
+						 [&](const float *src,
+						     size_t n_frames){
+			const size_t o_frames = size_t(n_frames * ratio) + 1;
+			if (o_frames > output_size) {
+				output.reset(new float[o_frames * channels]);
+				output_size = o_frames;
+			}
+
+			size_t i_done, o_done;
+			return soxr_process(soxr, src, n_frames, &i_done,
+					    output.get(), o_frames,
+					    &o_done) == nullptr;
+		});
+
+	soxr_delete(soxr);
+	return load;
+}
+
+/**
+ * Choose the best quality which fits into #soxr_cpu_budget for the
+ * given conversion.  The result is remembered, so each combination
+ * is measured only once.
+ */
+static SoxrSettings
+SoxrAutoQuality(unsigned src_rate, unsigned dest_rate, unsigned channels)
+{
+	typedef std::tuple<unsigned, unsigned, unsigned> Key;
+
+	static Mutex mutex;
+	static std::map<Key, SoxrSettings> cache;
+
+	/* hold the lock while measuring, so concurrent measurements
+	   by several outputs do not distort each other */
+	const ScopeLock protect(mutex);
+
+	const Key key(src_rate, dest_rate, channels);
+	auto i = cache.find(key);
+	if (i != cache.end())
+		return i->second;
+
+	const unsigned n_cores = std::thread::hardware_concurrency();
+
+	SoxrSettings settings;
+	double load = -1;
+
+	for (const auto *q = soxr_quality_table; q->name != nullptr; ++q) {
+		settings.recipe = q->recipe;
+		settings.quality = soxr_quality_spec(q->recipe, 0);
+		settings.runtime = soxr_runtime;
+
+		load = SoxrMeasureLoad(settings,
+				       src_rate, dest_rate, channels);
+		if (load >= 0 && load <= soxr_cpu_budget)
+			break;
+
+		if (soxr_auto_threads && n_cores > 1) {
+			/* too slow for one thread; try to spread the
+			   work over all cores */
+			settings.runtime = soxr_runtime_spec(n_cores);
+			load = SoxrMeasureLoad(settings,
+					       src_rate, dest_rate, channels);
+			if (load >= 0 && load <= soxr_cpu_budget)
+				break;
+		}
+
+		/* if nothing fits, the cheapest one (the last one
+		   tried) is used */
+	}
+
+	FormatInfo(soxr_domain,
+		   "%u Hz to %u Hz, %u channels: chose quality '%s' with %u thread(s), load %.1f%%",
+		   src_rate, dest_rate, channels,
+		   soxr_quality_name(settings.recipe),
+		   settings.runtime.num_threads, load * 100);
+
+	cache.emplace(key, settings);
+	return settings;
+}
+
 AudioFormat
 SoxrPcmResampler::Open(AudioFormat &af, unsigned new_sample_rate,
 		       Error &error)
@@ -113,10 +264,19 @@ SoxrPcmResampler::Open(AudioFormat &af, unsigned new_sample_rate,
 	assert(af.IsValid());
 	assert(audio_valid_sample_rate(new_sample_rate));
 
+	SoxrSettings settings;
+	if (soxr_auto_quality)
+		settings = SoxrAutoQuality(af.sample_rate, new_sample_rate,
+					   af.channels);
+	else {
+		settings.quality = soxr_quality;
+		settings.runtime = soxr_runtime;
+	}
+
 	soxr_error_t e;
 	soxr = soxr_create(af.sample_rate, new_sample_rate,
 			   af.channels, &e,
-			   nullptr, &soxr_quality, &soxr_runtime);
+			   nullptr, &settings.quality, &settings.runtime);
 	if (soxr == nullptr) {
 		error.Format(soxr_domain,
 			     "soxr initialization has failed: %s", e);
@@ -146,6 +306,12 @@ SoxrPcmResampler::Close()
 	soxr_delete(soxr);
 }
 
+void
+SoxrPcmResampler::Reset()
+{
+	soxr_clear(soxr);
+}
+
 ConstBuffer<void>
 SoxrPcmResampler::Resample(ConstBuffer<void> src, Error &error)
 {
@@ -22,10 +22,18 @@
 #include "Domain.hxx"
 #include "Traits.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
 #include "util/Error.hxx"
+#include "util/CpuFeatures.hxx"
 
 #include "PcmDither.cxx" // including the .cxx file to get inlined templates
 
+#ifdef HAVE_X86_DISPATCH
+#include "X86Volume.hxx"
+#endif
+
+#include <algorithm>
+
 #include <stdint.h>
 #include <string.h>
 
@@ -54,6 +62,48 @@ pcm_volume_change(PcmDither &dither,
 		dest[i] = pcm_volume_sample<F, Traits>(dither, src[i], volume);
 }
 
+#ifdef HAVE_X86_DISPATCH
+
+/**
+ * Apply the volume with a SIMD kernel which multiplies one block at a
+ * time into a widened temporary buffer.  The dithering step carries
+ * state from one sample to the next, so it remains scalar; this
+ * keeps the output bit-identical to pcm_volume_change().
+ *
+ * @return false if the CPU has no suitable SIMD kernel
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>, typename K>
+static bool
+pcm_volume_change_simd(PcmDither &dither,
+		       typename Traits::pointer_type dest,
+		       typename Traits::const_pointer_type src,
+		       size_t n,
+		       int volume, K kernel)
+{
+	typedef typename Traits::long_type long_type;
+
+	constexpr size_t BLOCK_SIZE = 256;
+	long_type block[BLOCK_SIZE];
+
+	while (n > 0) {
+		const size_t chunk = std::min(n, BLOCK_SIZE);
+		if (!kernel(block, src, chunk, volume))
+			return false;
+
+		dither.DitherShiftBlock<long_type,
+					Traits::BITS + PCM_VOLUME_BITS,
+					Traits::BITS>(dest, block, chunk);
+
+		dest += chunk;
+		src += chunk;
+		n -= chunk;
+	}
+
+	return true;
+}
+
+#endif
+
 static void
 pcm_volume_change_8(PcmDither &dither,
 		    int8_t *dest, const int8_t *src, size_t n,
@@ -67,6 +117,13 @@ pcm_volume_change_16(PcmDither &dither,
 		     int16_t *dest, const int16_t *src, size_t n,
 		     int volume)
 {
+#ifdef HAVE_X86_DISPATCH
+	if (pcm_volume_change_simd<SampleFormat::S16>(dither, dest, src, n,
+						      volume,
+						      X86VolumeScale16))
+		return;
+#endif
+
 	pcm_volume_change<SampleFormat::S16>(dither, dest, src, n, volume);
 }
 
@@ -75,6 +132,13 @@ pcm_volume_change_24(PcmDither &dither,
 		     int32_t *dest, const int32_t *src, size_t n,
 		     int volume)
 {
+#ifdef HAVE_X86_DISPATCH
+	if (pcm_volume_change_simd<SampleFormat::S24_P32>(dither, dest, src,
+							  n, volume,
+							  X86VolumeScale32))
+		return;
+#endif
+
 	pcm_volume_change<SampleFormat::S24_P32>(dither, dest, src, n,
 						 volume);
 }
@@ -84,6 +148,13 @@ pcm_volume_change_32(PcmDither &dither,
 		     int32_t *dest, const int32_t *src, size_t n,
 		     int volume)
 {
+#ifdef HAVE_X86_DISPATCH
+	if (pcm_volume_change_simd<SampleFormat::S32>(dither, dest, src, n,
+						      volume,
+						      X86VolumeScale32))
+		return;
+#endif
+
 	pcm_volume_change<SampleFormat::S32>(dither, dest, src, n, volume);
 }
 
@@ -91,6 +162,11 @@ static void
 pcm_volume_change_float(float *dest, const float *src, size_t n,
 			float volume)
 {
+#ifdef HAVE_X86_DISPATCH
+	if (X86VolumeFloat(dest, src, n, volume))
+		return;
+#endif
+
 	for (size_t i = 0; i != n; ++i)
 		dest[i] = src[i] * volume;
 }
@@ -123,20 +199,15 @@ PcmVolume::Open(SampleFormat _format, Error &error)
 	return true;
 }
 
-ConstBuffer<void>
-PcmVolume::Apply(ConstBuffer<void> src)
+bool
+PcmVolume::Change(void *data, const void *src, size_t size)
 {
-	if (volume == PCM_VOLUME_1)
-		return src;
-
-	void *data = buffer.Get(src.size);
-
 	if (volume == 0) {
 		/* optimized special case: 0% volume = memset(0) */
 		/* TODO: is this valid for all sample formats? What
 		   about floating point? */
-		memset(data, 0, src.size);
-		return { data, src.size };
+		memset(data, 0, size);
+		return true;
 	}
 
 	switch (format) {
@@ -146,43 +217,65 @@ PcmVolume::Apply(ConstBuffer<void> src)
 
 	case SampleFormat::S8:
 		pcm_volume_change_8(dither, (int8_t *)data,
-				    (const int8_t *)src.data,
-				    src.size / sizeof(int8_t),
+				    (const int8_t *)src,
+				    size / sizeof(int8_t),
 				    volume);
 		break;
 
 	case SampleFormat::S16:
 		pcm_volume_change_16(dither, (int16_t *)data,
-				     (const int16_t *)src.data,
-				     src.size / sizeof(int16_t),
+				     (const int16_t *)src,
+				     size / sizeof(int16_t),
 				     volume);
 		break;
 
 	case SampleFormat::S24_P32:
 		pcm_volume_change_24(dither, (int32_t *)data,
-				     (const int32_t *)src.data,
-				     src.size / sizeof(int32_t),
+				     (const int32_t *)src,
+				     size / sizeof(int32_t),
 				     volume);
 		break;
 
 	case SampleFormat::S32:
 		pcm_volume_change_32(dither, (int32_t *)data,
-				     (const int32_t *)src.data,
-				     src.size / sizeof(int32_t),
+				     (const int32_t *)src,
+				     size / sizeof(int32_t),
 				     volume);
 		break;
 
 	case SampleFormat::FLOAT:
 		pcm_volume_change_float((float *)data,
-					(const float *)src.data,
-					src.size / sizeof(float),
+					(const float *)src,
+					size / sizeof(float),
 					pcm_volume_to_float(volume));
 		break;
 
 	case SampleFormat::DSD:
 		// TODO: implement this; currently, it's a no-op
-		return src;
+		return false;
 	}
 
+	return true;
+}
+
+ConstBuffer<void>
+PcmVolume::Apply(ConstBuffer<void> src)
+{
+	if (volume == PCM_VOLUME_1)
+		return src;
+
+	void *data = buffer.Get(src.size);
+	if (!Change(data, src.data, src.size))
+		return src;
+
 	return { data, src.size };
 }
+
+void
+PcmVolume::ApplyInPlace(WritableBuffer<void> data)
+{
+	if (volume == PCM_VOLUME_1)
+		return;
+
+	Change(data.data, data.data, data.size);
+}
@@ -30,6 +30,7 @@
 
 class Error;
 template<typename T> struct ConstBuffer;
+template<typename T> struct WritableBuffer;
 
 /**
  * Number of fractional bits for a fixed-point volume value.
@@ -120,6 +121,21 @@ public:
 	 */
 	gcc_pure
 	ConstBuffer<void> Apply(ConstBuffer<void> src);
+
+	/**
+	 * Apply the volume level, overwriting the given buffer.
+	 */
+	void ApplyInPlace(WritableBuffer<void> data);
+
+private:
+	/**
+	 * Write the scaled samples from #src to #dest, which may be
+	 * the same buffer.
+	 *
+	 * @return false if the sample format doesn't support volume
+	 * changes (DSD) and nothing was written
+	 */
+	bool Change(void *dest, const void *src, size_t size);
 };
 
 #endif
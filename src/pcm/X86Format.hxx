@@ -0,0 +1,272 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_X86_FORMAT_HXX
+#define MPD_PCM_X86_FORMAT_HXX
+
+#include "Traits.hxx"
+#include "util/CpuFeatures.hxx"
+
+#include <immintrin.h>
+#include <stdint.h>
+
+/*
+ * x86 counterparts to the NEON converters in Neon.hxx.  The SIMD code
+ * is compiled with "__attribute__((target))", so each class has an
+ * IsSupported() method which checks at runtime whether this CPU can
+ * execute it.  All of them produce exactly the same output as the
+ * portable per-sample code.
+ */
+
+/**
+ * Scale four floating point samples to the range of the destination
+ * format, clamp them and truncate to 32 bit integer (like the
+ * portable FloatToIntegerSampleConvert does).
+ */
+template<class DstTraits>
+__attribute__((target("sse2")))
+static inline __m128i
+SseFloatToInt32(__m128 value)
+{
+	constexpr float factor = uintmax_t(1) << (DstTraits::BITS - 1);
+
+	value = _mm_mul_ps(value, _mm_set1_ps(factor));
+	value = _mm_max_ps(value, _mm_set1_ps(DstTraits::MIN));
+	value = _mm_min_ps(value, _mm_set1_ps(DstTraits::MAX));
+
+	__m128i result = _mm_cvttps_epi32(value);
+
+	if (DstTraits::BITS == 32) {
+		/* INT32_MAX is not representable as float and
+		   appears as 2^31 after clamping, which converts to
+		   0x80000000; flip those lanes to 0x7fffffff */
+		const __m128 overflow =
+			_mm_cmpge_ps(value, _mm_set1_ps(2147483648.f));
+		result = _mm_xor_si128(result, _mm_castps_si128(overflow));
+	}
+
+	return result;
+}
+
+/**
+ * The AVX version of SseFloatToInt32().
+ */
+template<class DstTraits>
+__attribute__((target("avx")))
+static inline __m256i
+AvxFloatToInt32(__m256 value)
+{
+	constexpr float factor = uintmax_t(1) << (DstTraits::BITS - 1);
+
+	value = _mm256_mul_ps(value, _mm256_set1_ps(factor));
+	value = _mm256_max_ps(value, _mm256_set1_ps(DstTraits::MIN));
+	value = _mm256_min_ps(value, _mm256_set1_ps(DstTraits::MAX));
+
+	__m256i result = _mm256_cvttps_epi32(value);
+
+	if (DstTraits::BITS == 32) {
+		const __m256 overflow =
+			_mm256_cmp_ps(value, _mm256_set1_ps(2147483648.f),
+				      _CMP_GE_OQ);
+		result = _mm256_castps_si256(_mm256_xor_ps(_mm256_castsi256_ps(result),
+							   overflow));
+	}
+
+	return result;
+}
+
+/**
+ * Convert floating point samples to 16 bit, S24_P32 or 32 bit signed
+ * integer using SSE2.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+struct SseFloatToInteger {
+	static constexpr SampleFormat src_format = SampleFormat::FLOAT;
+	static constexpr SampleFormat dst_format = F;
+	typedef SampleTraits<src_format> SrcTraits;
+	typedef Traits DstTraits;
+
+	typedef typename SrcTraits::value_type SV;
+	typedef typename DstTraits::value_type DV;
+
+	static constexpr size_t BLOCK_SIZE = 8;
+
+	static bool IsSupported() {
+		return CpuHasSSE2();
+	}
+
+	__attribute__((target("sse2")))
+	void Convert(DV *dst, const SV *src, const size_t n) const {
+		for (size_t i = 0; i < n / BLOCK_SIZE;
+		     ++i, src += BLOCK_SIZE, dst += BLOCK_SIZE) {
+			const __m128i a =
+				SseFloatToInt32<DstTraits>(_mm_loadu_ps(src));
+			const __m128i b =
+				SseFloatToInt32<DstTraits>(_mm_loadu_ps(src + 4));
+
+			if (sizeof(DV) == 2) {
+				/* the values are already clamped, so
+				   the saturation doesn't modify them */
+				_mm_storeu_si128((__m128i *)dst,
+						 _mm_packs_epi32(a, b));
+			} else {
+				_mm_storeu_si128((__m128i *)dst, a);
+				_mm_storeu_si128((__m128i *)(dst + 4), b);
+			}
+		}
+	}
+};
+
+/**
+ * Convert floating point samples to 16 bit, S24_P32 or 32 bit signed
+ * integer using AVX.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+struct AvxFloatToInteger {
+	static constexpr SampleFormat src_format = SampleFormat::FLOAT;
+	static constexpr SampleFormat dst_format = F;
+	typedef SampleTraits<src_format> SrcTraits;
+	typedef Traits DstTraits;
+
+	typedef typename SrcTraits::value_type SV;
+	typedef typename DstTraits::value_type DV;
+
+	static constexpr size_t BLOCK_SIZE = 16;
+
+	static bool IsSupported() {
+		return CpuHasAVX();
+	}
+
+	__attribute__((target("avx")))
+	void Convert(DV *dst, const SV *src, const size_t n) const {
+		for (size_t i = 0; i < n / BLOCK_SIZE;
+		     ++i, src += BLOCK_SIZE, dst += BLOCK_SIZE) {
+			const __m256i a =
+				AvxFloatToInt32<DstTraits>(_mm256_loadu_ps(src));
+			const __m256i b =
+				AvxFloatToInt32<DstTraits>(_mm256_loadu_ps(src + 8));
+
+			if (sizeof(DV) == 2) {
+				/* AVX has no 256 bit integer pack;
+				   use the SSE2 instruction on both
+				   halves */
+				_mm_storeu_si128((__m128i *)dst,
+						 _mm_packs_epi32(_mm256_castsi256_si128(a),
+								 _mm256_extractf128_si256(a, 1)));
+				_mm_storeu_si128((__m128i *)(dst + 8),
+						 _mm_packs_epi32(_mm256_castsi256_si128(b),
+								 _mm256_extractf128_si256(b, 1)));
+			} else {
+				_mm256_storeu_si256((__m256i *)dst, a);
+				_mm256_storeu_si256((__m256i *)(dst + 8), b);
+			}
+		}
+	}
+};
+
+/**
+ * Convert 16 bit, S24_P32 or 32 bit signed integer samples to
+ * floating point using SSE4.1.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+struct SseIntegerToFloat {
+	static constexpr SampleFormat src_format = F;
+	static constexpr SampleFormat dst_format = SampleFormat::FLOAT;
+	typedef Traits SrcTraits;
+	typedef SampleTraits<dst_format> DstTraits;
+
+	typedef typename SrcTraits::value_type SV;
+	typedef typename DstTraits::value_type DV;
+
+	static constexpr size_t BLOCK_SIZE = 8;
+
+	static bool IsSupported() {
+		return CpuHasSSE41();
+	}
+
+	__attribute__((target("sse4.1")))
+	void Convert(DV *dst, const SV *src, const size_t n) const {
+		constexpr DV factor = 0.5 / (1 << (SrcTraits::BITS - 2));
+		const __m128 f = _mm_set1_ps(factor);
+
+		for (size_t i = 0; i < n / BLOCK_SIZE;
+		     ++i, src += BLOCK_SIZE, dst += BLOCK_SIZE) {
+			__m128i a, b;
+			if (sizeof(SV) == 2) {
+				const __m128i s =
+					_mm_loadu_si128((const __m128i *)src);
+				a = _mm_cvtepi16_epi32(s);
+				b = _mm_cvtepi16_epi32(_mm_srli_si128(s, 8));
+			} else {
+				a = _mm_loadu_si128((const __m128i *)src);
+				b = _mm_loadu_si128((const __m128i *)(src + 4));
+			}
+
+			_mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(a), f));
+			_mm_storeu_ps(dst + 4,
+				      _mm_mul_ps(_mm_cvtepi32_ps(b), f));
+		}
+	}
+};
+
+/**
+ * Convert 16 bit, S24_P32 or 32 bit signed integer samples to
+ * floating point using AVX2.
+ */
+template<SampleFormat F, class Traits=SampleTraits<F>>
+struct AvxIntegerToFloat {
+	static constexpr SampleFormat src_format = F;
+	static constexpr SampleFormat dst_format = SampleFormat::FLOAT;
+	typedef Traits SrcTraits;
+	typedef SampleTraits<dst_format> DstTraits;
+
+	typedef typename SrcTraits::value_type SV;
+	typedef typename DstTraits::value_type DV;
+
+	static constexpr size_t BLOCK_SIZE = 16;
+
+	static bool IsSupported() {
+		return CpuHasAVX2();
+	}
+
+	__attribute__((target("avx2")))
+	void Convert(DV *dst, const SV *src, const size_t n) const {
+		constexpr DV factor = 0.5 / (1 << (SrcTraits::BITS - 2));
+		const __m256 f = _mm256_set1_ps(factor);
+
+		for (size_t i = 0; i < n / BLOCK_SIZE;
+		     ++i, src += BLOCK_SIZE, dst += BLOCK_SIZE) {
+			__m256i a, b;
+			if (sizeof(SV) == 2) {
+				a = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)src));
+				b = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + 8)));
+			} else {
+				a = _mm256_loadu_si256((const __m256i *)src);
+				b = _mm256_loadu_si256((const __m256i *)(src + 8));
+			}
+
+			_mm256_storeu_ps(dst,
+					 _mm256_mul_ps(_mm256_cvtepi32_ps(a), f));
+			_mm256_storeu_ps(dst + 8,
+					 _mm256_mul_ps(_mm256_cvtepi32_ps(b), f));
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,382 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "X86Mix.hxx"
+
+#ifdef HAVE_X86_DISPATCH
+
+#include <immintrin.h>
+
+/*
+ * The scalar tail loops are copies of the portable code in
+ * PcmMix.cxx; they must produce exactly the same values.
+ */
+
+static inline int16_t
+Add16(int16_t a, int16_t b)
+{
+	const int32_t c = int32_t(a) + int32_t(b);
+	return c < -32768 ? -32768 : (c > 32767 ? 32767 : c);
+}
+
+static inline int32_t
+Add24(int32_t a, int32_t b)
+{
+	const int32_t c = a + b;
+	return c < -0x800000 ? -0x800000 : (c > 0x7fffff ? 0x7fffff : c);
+}
+
+static inline int32_t
+Add32(int32_t a, int32_t b)
+{
+	const int64_t c = int64_t(a) + int64_t(b);
+	return c < INT32_MIN ? INT32_MIN : (c > INT32_MAX ? INT32_MAX : c);
+}
+
+__attribute__((target("sse4.1")))
+static void
+MixScale16_SSE41(int32_t *dest, const int16_t *a, const int16_t *b, size_t n,
+		 int volume1, int volume2)
+{
+	const __m128i v1 = _mm_set1_epi32(volume1);
+	const __m128i v2 = _mm_set1_epi32(volume2);
+
+	for (; n >= 4; n -= 4, a += 4, b += 4, dest += 4) {
+		__m128i x = _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *)a));
+		__m128i y = _mm_cvtepi16_epi32(_mm_loadl_epi64((const __m128i *)b));
+		_mm_storeu_si128((__m128i *)dest,
+				 _mm_add_epi32(_mm_mullo_epi32(x, v1),
+					       _mm_mullo_epi32(y, v2)));
+	}
+
+	for (; n > 0; --n)
+		*dest++ = int32_t(*a++) * volume1 + int32_t(*b++) * volume2;
+}
+
+__attribute__((target("avx2")))
+static void
+MixScale16_AVX2(int32_t *dest, const int16_t *a, const int16_t *b, size_t n,
+		int volume1, int volume2)
+{
+	const __m256i v1 = _mm256_set1_epi32(volume1);
+	const __m256i v2 = _mm256_set1_epi32(volume2);
+
+	for (; n >= 8; n -= 8, a += 8, b += 8, dest += 8) {
+		__m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)a));
+		__m256i y = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)b));
+		_mm256_storeu_si256((__m256i *)dest,
+				    _mm256_add_epi32(_mm256_mullo_epi32(x, v1),
+						     _mm256_mullo_epi32(y, v2)));
+	}
+
+	for (; n > 0; --n)
+		*dest++ = int32_t(*a++) * volume1 + int32_t(*b++) * volume2;
+}
+
+__attribute__((target("sse4.1")))
+static void
+MixScale32_SSE41(int64_t *dest, const int32_t *a, const int32_t *b, size_t n,
+		 int volume1, int volume2)
+{
+	const __m128i v1 = _mm_set1_epi64x(volume1);
+	const __m128i v2 = _mm_set1_epi64x(volume2);
+
+	for (; n >= 2; n -= 2, a += 2, b += 2, dest += 2) {
+		__m128i x = _mm_cvtepi32_epi64(_mm_loadl_epi64((const __m128i *)a));
+		__m128i y = _mm_cvtepi32_epi64(_mm_loadl_epi64((const __m128i *)b));
+		_mm_storeu_si128((__m128i *)dest,
+				 _mm_add_epi64(_mm_mul_epi32(x, v1),
+					       _mm_mul_epi32(y, v2)));
+	}
+
+	for (; n > 0; --n)
+		*dest++ = int64_t(*a++) * volume1 + int64_t(*b++) * volume2;
+}
+
+__attribute__((target("avx2")))
+static void
+MixScale32_AVX2(int64_t *dest, const int32_t *a, const int32_t *b, size_t n,
+		int volume1, int volume2)
+{
+	const __m256i v1 = _mm256_set1_epi64x(volume1);
+	const __m256i v2 = _mm256_set1_epi64x(volume2);
+
+	for (; n >= 4; n -= 4, a += 4, b += 4, dest += 4) {
+		__m256i x = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)a));
+		__m256i y = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i *)b));
+		_mm256_storeu_si256((__m256i *)dest,
+				    _mm256_add_epi64(_mm256_mul_epi32(x, v1),
+						     _mm256_mul_epi32(y, v2)));
+	}
+
+	for (; n > 0; --n)
+		*dest++ = int64_t(*a++) * volume1 + int64_t(*b++) * volume2;
+}
+
+/* no FMA here: the portable code rounds after each multiplication */
+
+__attribute__((target("avx")))
+static void
+MixFloat_AVX(float *a, const float *b, size_t n, float volume1, float volume2)
+{
+	const __m256 v1 = _mm256_set1_ps(volume1);
+	const __m256 v2 = _mm256_set1_ps(volume2);
+
+	for (; n >= 8; n -= 8, a += 8, b += 8)
+		_mm256_storeu_ps(a, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(a), v1),
+						  _mm256_mul_ps(_mm256_loadu_ps(b), v2)));
+
+	for (; n > 0; --n, ++a)
+		*a = *a * volume1 + *b++ * volume2;
+}
+
+__attribute__((target("sse4.1")))
+static void
+Add16_SSE41(int16_t *a, const int16_t *b, size_t n)
+{
+	for (; n >= 8; n -= 8, a += 8, b += 8)
+		_mm_storeu_si128((__m128i *)a,
+				 _mm_adds_epi16(_mm_loadu_si128((const __m128i *)a),
+						_mm_loadu_si128((const __m128i *)b)));
+
+	for (; n > 0; --n, ++a)
+		*a = Add16(*a, *b++);
+}
+
+__attribute__((target("avx2")))
+static void
+Add16_AVX2(int16_t *a, const int16_t *b, size_t n)
+{
+	for (; n >= 16; n -= 16, a += 16, b += 16)
+		_mm256_storeu_si256((__m256i *)a,
+				    _mm256_adds_epi16(_mm256_loadu_si256((const __m256i *)a),
+						      _mm256_loadu_si256((const __m256i *)b)));
+
+	for (; n > 0; --n, ++a)
+		*a = Add16(*a, *b++);
+}
+
+__attribute__((target("sse4.1")))
+static void
+Add24_SSE41(int32_t *a, const int32_t *b, size_t n)
+{
+	/* two 24 bit values cannot overflow a 32 bit integer */
+	const __m128i min = _mm_set1_epi32(-0x800000);
+	const __m128i max = _mm_set1_epi32(0x7fffff);
+
+	for (; n >= 4; n -= 4, a += 4, b += 4) {
+		__m128i c = _mm_add_epi32(_mm_loadu_si128((const __m128i *)a),
+					  _mm_loadu_si128((const __m128i *)b));
+		c = _mm_min_epi32(_mm_max_epi32(c, min), max);
+		_mm_storeu_si128((__m128i *)a, c);
+	}
+
+	for (; n > 0; --n, ++a)
+		*a = Add24(*a, *b++);
+}
+
+__attribute__((target("avx2")))
+static void
+Add24_AVX2(int32_t *a, const int32_t *b, size_t n)
+{
+	const __m256i min = _mm256_set1_epi32(-0x800000);
+	const __m256i max = _mm256_set1_epi32(0x7fffff);
+
+	for (; n >= 8; n -= 8, a += 8, b += 8) {
+		__m256i c = _mm256_add_epi32(_mm256_loadu_si256((const __m256i *)a),
+					     _mm256_loadu_si256((const __m256i *)b));
+		c = _mm256_min_epi32(_mm256_max_epi32(c, min), max);
+		_mm256_storeu_si256((__m256i *)a, c);
+	}
+
+	for (; n > 0; --n, ++a)
+		*a = Add24(*a, *b++);
+}
+
+__attribute__((target("sse4.1")))
+static void
+Add32_SSE41(int32_t *a, const int32_t *b, size_t n)
+{
+	const __m128i max = _mm_set1_epi32(INT32_MAX);
+
+	for (; n >= 4; n -= 4, a += 4, b += 4) {
+		const __m128i x = _mm_loadu_si128((const __m128i *)a);
+		const __m128i y = _mm_loadu_si128((const __m128i *)b);
+		const __m128i sum = _mm_add_epi32(x, y);
+
+		/* the sum overflows if both operands have the same
+		   sign, and the sign of the sum is different; the
+		   saturated value is INT32_MAX for positive and
+		   INT32_MIN for negative operands */
+		const __m128i overflow =
+			_mm_andnot_si128(_mm_xor_si128(x, y),
+					 _mm_xor_si128(x, sum));
+		const __m128i saturated =
+			_mm_xor_si128(_mm_srai_epi32(x, 31), max);
+		_mm_storeu_si128((__m128i *)a,
+				 _mm_castps_si128(_mm_blendv_ps(_mm_castsi128_ps(sum),
+								_mm_castsi128_ps(saturated),
+								_mm_castsi128_ps(overflow))));
+	}
+
+	for (; n > 0; --n, ++a)
+		*a = Add32(*a, *b++);
+}
+
+__attribute__((target("avx2")))
+static void
+Add32_AVX2(int32_t *a, const int32_t *b, size_t n)
+{
+	const __m256i max = _mm256_set1_epi32(INT32_MAX);
+
+	for (; n >= 8; n -= 8, a += 8, b += 8) {
+		const __m256i x = _mm256_loadu_si256((const __m256i *)a);
+		const __m256i y = _mm256_loadu_si256((const __m256i *)b);
+		const __m256i sum = _mm256_add_epi32(x, y);
+		const __m256i overflow =
+			_mm256_andnot_si256(_mm256_xor_si256(x, y),
+					    _mm256_xor_si256(x, sum));
+		const __m256i saturated =
+			_mm256_xor_si256(_mm256_srai_epi32(x, 31), max);
+		_mm256_storeu_si256((__m256i *)a,
+				    _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(sum),
+									 _mm256_castsi256_ps(saturated),
+									 _mm256_castsi256_ps(overflow))));
+	}
+
+	for (; n > 0; --n, ++a)
+		*a = Add32(*a, *b++);
+}
+
+__attribute__((target("avx")))
+static void
+AddFloat_AVX(float *a, const float *b, size_t n)
+{
+	for (; n >= 8; n -= 8, a += 8, b += 8)
+		_mm256_storeu_ps(a, _mm256_add_ps(_mm256_loadu_ps(a),
+						  _mm256_loadu_ps(b)));
+
+	for (; n > 0; --n)
+		*a++ += *b++;
+}
+
+template<typename F>
+static F
+Choose(F avx2, F sse41)
+{
+	if (CpuHasAVX2())
+		return avx2;
+	if (CpuHasSSE41())
+		return sse41;
+	return nullptr;
+}
+
+template<typename F>
+static F
+ChooseAvx(F avx)
+{
+	return CpuHasAVX() ? avx : nullptr;
+}
+
+/* the SSE versions of the floating point functions are omitted: the
+   compiler auto-vectorizes the portable loops with the x86_64
+   baseline instruction set */
+
+static const auto mix_scale16 = Choose(MixScale16_AVX2, MixScale16_SSE41);
+static const auto mix_scale32 = Choose(MixScale32_AVX2, MixScale32_SSE41);
+static const auto mix_float = ChooseAvx(MixFloat_AVX);
+static const auto add16 = Choose(Add16_AVX2, Add16_SSE41);
+static const auto add24 = Choose(Add24_AVX2, Add24_SSE41);
+static const auto add32 = Choose(Add32_AVX2, Add32_SSE41);
+static const auto add_float = ChooseAvx(AddFloat_AVX);
+
+bool
+X86MixScale16(int32_t *dest, const int16_t *a, const int16_t *b, size_t n,
+	      int volume1, int volume2)
+{
+	if (mix_scale16 == nullptr)
+		return false;
+
+	mix_scale16(dest, a, b, n, volume1, volume2);
+	return true;
+}
+
+bool
+X86MixScale32(int64_t *dest, const int32_t *a, const int32_t *b, size_t n,
+	      int volume1, int volume2)
+{
+	if (mix_scale32 == nullptr)
+		return false;
+
+	mix_scale32(dest, a, b, n, volume1, volume2);
+	return true;
+}
+
+bool
+X86MixFloat(float *a, const float *b, size_t n, float volume1, float volume2)
+{
+	if (mix_float == nullptr)
+		return false;
+
+	mix_float(a, b, n, volume1, volume2);
+	return true;
+}
+
+bool
+X86Add16(int16_t *a, const int16_t *b, size_t n)
+{
+	if (add16 == nullptr)
+		return false;
+
+	add16(a, b, n);
+	return true;
+}
+
+bool
+X86Add24(int32_t *a, const int32_t *b, size_t n)
+{
+	if (add24 == nullptr)
+		return false;
+
+	add24(a, b, n);
+	return true;
+}
+
+bool
+X86Add32(int32_t *a, const int32_t *b, size_t n)
+{
+	if (add32 == nullptr)
+		return false;
+
+	add32(a, b, n);
+	return true;
+}
+
+bool
+X86AddFloat(float *a, const float *b, size_t n)
+{
+	if (add_float == nullptr)
+		return false;
+
+	add_float(a, b, n);
+	return true;
+}
+
+#endif
@@ -0,0 +1,87 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_X86_MIX_HXX
+#define MPD_PCM_X86_MIX_HXX
+
+#include "util/CpuFeatures.hxx"
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef HAVE_X86_DISPATCH
+
+/*
+ * SIMD kernels for pcm_mix().  Like the ones in X86Volume.hxx, they
+ * are chosen once at startup, and each function returns false (and
+ * doesn't touch its output) if this CPU has no suitable instruction
+ * set extension.
+ */
+
+/**
+ * Calculate a*volume1+b*volume2 for 16 bit samples, widening them to
+ * 32 bit.  The result still needs to be shifted (and dithered) by
+ * #PCM_VOLUME_BITS.
+ */
+bool
+X86MixScale16(int32_t *dest, const int16_t *a, const int16_t *b, size_t n,
+	      int volume1, int volume2);
+
+/**
+ * Calculate a*volume1+b*volume2 for 32 bit samples (S24_P32 or S32),
+ * widening them to 64 bit.
+ */
+bool
+X86MixScale32(int64_t *dest, const int32_t *a, const int32_t *b, size_t n,
+	      int volume1, int volume2);
+
+/**
+ * Calculate a=a*volume1+b*volume2 for floating point samples.
+ */
+bool
+X86MixFloat(float *a, const float *b, size_t n,
+	    float volume1, float volume2);
+
+/**
+ * Add the samples of #b to #a, with saturation.
+ */
+bool
+X86Add16(int16_t *a, const int16_t *b, size_t n);
+
+/**
+ * Add the samples of #b to #a, clamping to the 24 bit range.
+ */
+bool
+X86Add24(int32_t *a, const int32_t *b, size_t n);
+
+/**
+ * Add the samples of #b to #a, with saturation.
+ */
+bool
+X86Add32(int32_t *a, const int32_t *b, size_t n);
+
+/**
+ * Add the samples of #b to #a.
+ */
+bool
+X86AddFloat(float *a, const float *b, size_t n);
+
+#endif
+
+#endif
@@ -0,0 +1,198 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "X86Volume.hxx"
+
+#ifdef HAVE_X86_DISPATCH
+
+#include <immintrin.h>
+
+__attribute__((target("sse4.1")))
+static void
+Scale16_SSE41(int32_t *dest, const int16_t *src, size_t n, int volume)
+{
+	const __m128i v = _mm_set1_epi32(volume);
+
+	for (; n >= 4; n -= 4, src += 4, dest += 4) {
+		__m128i s = _mm_loadl_epi64((const __m128i *)src);
+		s = _mm_cvtepi16_epi32(s);
+		_mm_storeu_si128((__m128i *)dest, _mm_mullo_epi32(s, v));
+	}
+
+	for (; n > 0; --n)
+		*dest++ = int32_t(*src++) * volume;
+}
+
+__attribute__((target("avx2")))
+static void
+Scale16_AVX2(int32_t *dest, const int16_t *src, size_t n, int volume)
+{
+	const __m256i v = _mm256_set1_epi32(volume);
+
+	for (; n >= 8; n -= 8, src += 8, dest += 8) {
+		__m128i s = _mm_loadu_si128((const __m128i *)src);
+		__m256i w = _mm256_cvtepi16_epi32(s);
+		_mm256_storeu_si256((__m256i *)dest,
+				    _mm256_mullo_epi32(w, v));
+	}
+
+	for (; n > 0; --n)
+		*dest++ = int32_t(*src++) * volume;
+}
+
+__attribute__((target("sse4.1")))
+static void
+Scale32_SSE41(int64_t *dest, const int32_t *src, size_t n, int volume)
+{
+	/* _mm_mul_epi32() multiplies the lower signed 32 bits of
+	   each 64 bit lane */
+	const __m128i v = _mm_set1_epi64x(volume);
+
+	for (; n >= 2; n -= 2, src += 2, dest += 2) {
+		__m128i s = _mm_loadl_epi64((const __m128i *)src);
+		s = _mm_cvtepi32_epi64(s);
+		_mm_storeu_si128((__m128i *)dest, _mm_mul_epi32(s, v));
+	}
+
+	for (; n > 0; --n)
+		*dest++ = int64_t(*src++) * volume;
+}
+
+__attribute__((target("avx2")))
+static void
+Scale32_AVX2(int64_t *dest, const int32_t *src, size_t n, int volume)
+{
+	const __m256i v = _mm256_set1_epi64x(volume);
+
+	for (; n >= 4; n -= 4, src += 4, dest += 4) {
+		__m128i s = _mm_loadu_si128((const __m128i *)src);
+		__m256i w = _mm256_cvtepi32_epi64(s);
+		_mm256_storeu_si256((__m256i *)dest, _mm256_mul_epi32(w, v));
+	}
+
+	for (; n > 0; --n)
+		*dest++ = int64_t(*src++) * volume;
+}
+
+#ifdef __SSE__
+
+/* SSE is part of the x86_64 baseline; on i386, it is only used if
+   the compiler was told to do so */
+static void
+Float_SSE(float *dest, const float *src, size_t n, float volume)
+{
+	const __m128 v = _mm_set1_ps(volume);
+
+	for (; n >= 4; n -= 4, src += 4, dest += 4)
+		_mm_storeu_ps(dest, _mm_mul_ps(_mm_loadu_ps(src), v));
+
+	for (; n > 0; --n)
+		*dest++ = *src++ * volume;
+}
+
+#endif
+
+__attribute__((target("avx")))
+static void
+Float_AVX(float *dest, const float *src, size_t n, float volume)
+{
+	const __m256 v = _mm256_set1_ps(volume);
+
+	for (; n >= 8; n -= 8, src += 8, dest += 8)
+		_mm256_storeu_ps(dest, _mm256_mul_ps(_mm256_loadu_ps(src), v));
+
+	for (; n > 0; --n)
+		*dest++ = *src++ * volume;
+}
+
+typedef void (*Scale16Function)(int32_t *dest, const int16_t *src,
+				size_t n, int volume);
+typedef void (*Scale32Function)(int64_t *dest, const int32_t *src,
+				size_t n, int volume);
+typedef void (*FloatFunction)(float *dest, const float *src,
+			      size_t n, float volume);
+
+static Scale16Function
+ChooseScale16()
+{
+	if (CpuHasAVX2())
+		return Scale16_AVX2;
+	if (CpuHasSSE41())
+		return Scale16_SSE41;
+	return nullptr;
+}
+
+static Scale32Function
+ChooseScale32()
+{
+	if (CpuHasAVX2())
+		return Scale32_AVX2;
+	if (CpuHasSSE41())
+		return Scale32_SSE41;
+	return nullptr;
+}
+
+static FloatFunction
+ChooseFloat()
+{
+	if (CpuHasAVX())
+		return Float_AVX;
+#ifdef __SSE__
+	return Float_SSE;
+#else
+	return nullptr;
+#endif
+}
+
+static const Scale16Function scale16 = ChooseScale16();
+static const Scale32Function scale32 = ChooseScale32();
+static const FloatFunction scale_float = ChooseFloat();
+
+bool
+X86VolumeScale16(int32_t *dest, const int16_t *src, size_t n, int volume)
+{
+	if (scale16 == nullptr)
+		return false;
+
+	scale16(dest, src, n, volume);
+	return true;
+}
+
+bool
+X86VolumeScale32(int64_t *dest, const int32_t *src, size_t n, int volume)
+{
+	if (scale32 == nullptr)
+		return false;
+
+	scale32(dest, src, n, volume);
+	return true;
+}
+
+bool
+X86VolumeFloat(float *dest, const float *src, size_t n, float volume)
+{
+	if (scale_float == nullptr)
+		return false;
+
+	scale_float(dest, src, n, volume);
+	return true;
+}
+
+#endif
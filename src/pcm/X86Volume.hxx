@@ -0,0 +1,62 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_PCM_X86_VOLUME_HXX
+#define MPD_PCM_X86_VOLUME_HXX
+
+#include "util/CpuFeatures.hxx"
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef HAVE_X86_DISPATCH
+
+/*
+ * SIMD kernels for #PcmVolume.  The implementation is chosen once at
+ * startup according to the CPU's capabilities.  Each function returns
+ * false (and doesn't touch #dest) if this CPU has no suitable
+ * instruction set extension; the caller must then use the portable
+ * code.
+ */
+
+/**
+ * Multiply 16 bit samples with a fixed-point volume value, widening
+ * them to 32 bit.  The result still needs to be shifted (and
+ * dithered) by #PCM_VOLUME_BITS.
+ */
+bool
+X86VolumeScale16(int32_t *dest, const int16_t *src, size_t n, int volume);
+
+/**
+ * Multiply 32 bit samples (S24_P32 or S32) with a fixed-point volume
+ * value, widening them to 64 bit.  The result still needs to be
+ * shifted (and dithered) by #PCM_VOLUME_BITS.
+ */
+bool
+X86VolumeScale32(int64_t *dest, const int32_t *src, size_t n, int volume);
+
+/**
+ * Multiply floating point samples with a volume factor.
+ */
+bool
+X86VolumeFloat(float *dest, const float *src, size_t n, float volume);
+
+#endif
+
+#endif
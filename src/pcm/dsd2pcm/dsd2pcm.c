@@ -212,3 +212,10 @@ extern void dsd2pcm_translate(
 	ptr->fifopos = ffp;
 }
 
+
+extern const float (*dsd2pcm_get_ctables(unsigned *n_tables_r))[256]
+{
+	if (!precalculated) precalc();
+	*n_tables_r = CTABLES;
+	return (const float (*)[256])ctables;
+}
@@ -86,6 +86,14 @@ extern void dsd2pcm_translate(dsd2pcm_ctx *ctx,
 	int lsbitfirst,
 	float *dst, ptrdiff_t dst_stride);
 
+/**
+ * returns the "8 MACs" lookup tables which are used by
+ * dsd2pcm_translate(); this allows other implementations to share
+ * the filter (precomputes the tables, see dsd2pcm_init())
+ * @param n_tables_r -- receives the number of tables
+ */
+extern const float (*dsd2pcm_get_ctables(unsigned *n_tables_r))[256];
+
 #ifdef __cplusplus
 } /* extern "C" */
 #endif
@@ -29,17 +29,33 @@
 PlayerControl::PlayerControl(PlayerListener &_listener,
 			     MultipleOutputs &_outputs,
 			     unsigned _buffer_chunks,
-			     unsigned _buffered_before_play)
+			     unsigned _crossfade_chunks,
+			     size_t _chunk_size,
+			     const HugeAllocateOptions &_buffer_options,
+			     unsigned _buffered_before_play,
+			     bool _adaptive_buffering,
+			     SongTime _max_buffer_time,
+			     SongTime _prefetch_time,
+			     unsigned _prefetch_songs)
 	:listener(_listener), outputs(_outputs),
 	 buffer_chunks(_buffer_chunks),
+	 crossfade_chunks(_crossfade_chunks),
+	 chunk_size(_chunk_size),
+	 buffer_options(_buffer_options),
 	 buffered_before_play(_buffered_before_play),
+	 adaptive_buffering(_adaptive_buffering),
+	 max_buffer_time(_max_buffer_time),
+	 prefetch_time(_prefetch_time),
+	 prefetch_songs(_prefetch_songs),
 	 command(PlayerCommand::NONE),
 	 state(PlayerState::STOP),
 	 error_type(PlayerError::NONE),
 	 tagged_song(nullptr),
 	 next_song(nullptr),
 	 total_play_time(0),
-	 border_pause(false)
+	 border_pause(false),
+	 send_silence(true),
+	 low_water_time(0)
 {
 }
 
@@ -72,6 +88,18 @@ PlayerControl::LockCancel()
 	assert(next_song == nullptr);
 }
 
+void
+PlayerControl::LockSetUpcoming(std::vector<std::string> &&uris)
+{
+	const ScopeLock protect(mutex);
+	if (uris == upcoming)
+		return;
+
+	upcoming = std::move(uris);
+	upcoming_modified = true;
+	Signal();
+}
+
 void
 PlayerControl::LockStop()
 {
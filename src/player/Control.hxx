@@ -23,10 +23,16 @@
 #include "AudioFormat.hxx"
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
+#include "thread/FastCond.hxx"
 #include "thread/Thread.hxx"
 #include "util/Error.hxx"
 #include "CrossFade.hxx"
 #include "Chrono.hxx"
+#include "util/HugeAllocator.hxx"
+
+#include <string>
+#include <vector>
+#include <atomic>
 
 #include <stdint.h>
 
@@ -100,8 +106,71 @@ struct PlayerControl {
 
 	const unsigned buffer_chunks;
 
+	/**
+	 * Additional #MusicBuffer chunks which are reserved for the
+	 * next song's decoder while cross-fading; the decoder pipes
+	 * never hold more than #buffer_chunks (see
+	 * #ConfigOption::CROSSFADE_BUFFER_SIZE).
+	 */
+	const unsigned crossfade_chunks;
+
+	/**
+	 * The capacity of each #MusicChunk in bytes.
+	 */
+	const size_t chunk_size;
+
+	/**
+	 * How to allocate the #MusicBuffer memory.
+	 */
+	const HugeAllocateOptions buffer_options;
+
 	const unsigned buffered_before_play;
 
+	/**
+	 * Calculate the amount to buffer before playback from the
+	 * measured latency of the song's source (see #InputSourceStats),
+	 * instead of always using #buffered_before_play.  The latter
+	 * is still used for sources which are not known yet.
+	 */
+	const bool adaptive_buffering;
+
+	/**
+	 * See DecoderControl::max_buffer_time.
+	 */
+	const SongTime max_buffer_time;
+
+	/**
+	 * Open the next song's input stream when the decoder is this
+	 * close to the end of the current song; zero disables this.
+	 * See #ConfigOption::PREFETCH_NEXT_SONG.
+	 */
+	const SongTime prefetch_time;
+
+	/**
+	 * The number of upcoming songs in the queue whose input
+	 * streams are opened in advance; zero disables this.  See
+	 * #ConfigOption::PREFETCH_SONGS.
+	 */
+	const unsigned prefetch_songs;
+
+	/**
+	 * The URIs of the songs following the current one (in
+	 * playback order), submitted by the playlist with
+	 * LockSetUpcoming().  The player thread passes them to
+	 * DecoderControl::PrefetchUpcoming().
+	 *
+	 * Protected by #mutex.
+	 */
+	std::vector<std::string> upcoming;
+
+	/**
+	 * Has #upcoming been modified since the player thread has
+	 * last seen it?
+	 *
+	 * Protected by #mutex.
+	 */
+	bool upcoming_modified = false;
+
 	/**
 	 * The handle of the player thread.
 	 */
@@ -114,8 +183,9 @@ struct PlayerControl {
 
 	/**
 	 * Trigger this object after you have modified #command.
+	 * The decoder and the outputs signal it for every chunk.
 	 */
-	Cond cond;
+	FastCond cond;
 
 	/**
 	 * This object gets signalled when the player thread has
@@ -177,10 +247,36 @@ struct PlayerControl {
 	 */
 	bool border_pause;
 
+	/**
+	 * Send silence to the outputs while the decoder is too slow?
+	 * This keeps real-time devices from running dry; it is
+	 * disabled by the benchmark mode, where the outputs are not
+	 * paced and silence would only add work.
+	 */
+	bool send_silence;
+
+	/**
+	 * The MonotonicClockUS() time when the player thread has
+	 * last seen its pipe below the low-water mark
+	 * (#buffered_before_play) while the decoder was still working
+	 * on the current song, i.e. when playback was about to
+	 * starve; zero if never.  Written by the player thread and
+	 * read without a lock by the database update, which backs
+	 * off for a while (see #UpdateThrottle).
+	 */
+	std::atomic<uint64_t> low_water_time;
+
 	PlayerControl(PlayerListener &_listener,
 		      MultipleOutputs &_outputs,
 		      unsigned buffer_chunks,
-		      unsigned buffered_before_play);
+		      unsigned crossfade_chunks,
+		      size_t chunk_size,
+		      const HugeAllocateOptions &buffer_options,
+		      unsigned buffered_before_play,
+		      bool adaptive_buffering,
+		      SongTime max_buffer_time,
+		      SongTime prefetch_time,
+		      unsigned prefetch_songs);
 	~PlayerControl();
 
 	/**
@@ -318,6 +414,11 @@ public:
 	 */
 	void LockCancel();
 
+	/**
+	 * Submit the URIs of the upcoming songs, see #upcoming.
+	 */
+	void LockSetUpcoming(std::vector<std::string> &&uris);
+
 	void LockSetPause(bool pause_flag);
 
 private:
@@ -32,14 +32,35 @@
 #include "output/MultipleOutputs.hxx"
 #include "tag/Tag.hxx"
 #include "Idle.hxx"
+#include "PerfStats.hxx"
+#include "input/InputStats.hxx"
 #include "util/Domain.hxx"
 #include "thread/Name.hxx"
+#include "ThreadSettings.hxx"
+#include "system/Clock.hxx"
+#include "system/Trace.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include <string.h>
+#include <math.h>
 
 static constexpr Domain player_domain("player");
 
+/**
+ * With adaptive buffering, buffer enough audio to bridge the longest
+ * recent stall of the song's source this many times...
+ */
+static constexpr double ADAPTIVE_BUFFER_STALL_FACTOR = 2;
+
+/**
+ * ... plus this duration [s], to absorb decoder jitter.
+ */
+static constexpr double ADAPTIVE_BUFFER_BASE = 0.1;
+
 class Player {
 	PlayerControl &pc;
 
@@ -54,6 +75,19 @@ class Player {
 	 */
 	bool buffering;
 
+	/**
+	 * When did #buffering begin?  A MonotonicClockUS() value, for
+	 * #PerfStats::player_buffering.
+	 */
+	uint64_t buffering_since;
+
+	/**
+	 * The number of chunks which must be in the #pipe before
+	 * #buffering is finished; zero if it has not been determined
+	 * yet.  See GetBufferThreshold().
+	 */
+	unsigned buffer_threshold;
+
 	/**
 	 * true if the decoder is starting and did not provide data
 	 * yet
@@ -76,6 +110,12 @@ class Player {
 	 */
 	bool queued;
 
+	/**
+	 * Has the input stream of the queued song been opened in
+	 * advance?  See CheckPrefetch().
+	 */
+	bool prefetched;
+
 	/**
 	 * Was any audio output opened successfully?  It might have
 	 * failed meanwhile, but was not explicitly closed by the
@@ -148,11 +188,13 @@ public:
 	Player(PlayerControl &_pc, DecoderControl &_dc,
 	       MusicBuffer &_buffer)
 		:pc(_pc), dc(_dc), buffer(_buffer),
-		 buffering(true),
+		 buffering(true), buffering_since(MonotonicClockUS()),
+		 buffer_threshold(0),
 		 decoder_starting(false),
 		 decoder_woken(false),
 		 paused(false),
 		 queued(true),
+		 prefetched(false),
 		 output_open(false),
 		 song(nullptr),
 		 xfade_state(CrossFadeState::UNKNOWN),
@@ -263,6 +305,18 @@ private:
 	 */
 	bool SeekDecoder();
 
+	/**
+	 * Attempt to serve #PlayerCommand::SEEK from the chunks which
+	 * were played recently, see MultipleOutputs::Rewind().  This
+	 * is only possible while the decoder is still at the current
+	 * song.
+	 *
+	 * The player lock is not held.
+	 *
+	 * @return true if the command has been finished
+	 */
+	bool SeekHistory();
+
 	/**
 	 * Check if the decoder has reported an error, and forward it
 	 * to PlayerControl::SetError().
@@ -271,6 +325,23 @@ private:
 	 */
 	bool ForwardDecoderError();
 
+	/**
+	 * If the decoder is close to the end of the current song,
+	 * let it prefetch the input stream of the queued song, see
+	 * PlayerControl::prefetch_time.
+	 *
+	 * Player lock is not held.
+	 */
+	void CheckPrefetch();
+
+	/**
+	 * Pass PlayerControl::upcoming to the #DecoderControl if it
+	 * has been modified.
+	 *
+	 * The player lock must be held, but is released temporarily.
+	 */
+	void UpdateUpcoming();
+
 	/**
 	 * After the decoder has been started asynchronously, activate
 	 * it for playback.  That is, make the currently decoded song
@@ -311,6 +382,71 @@ private:
 	 */
 	bool SendSilence();
 
+	/**
+	 * Returns the number of chunks which must be buffered before
+	 * playback starts.  With adaptive buffering, this is
+	 * calculated from the #InputSourceStats of the current song
+	 * as soon as the decoder has delivered the first chunk (and
+	 * thus the audio format is known).
+	 *
+	 * The player lock is not held.
+	 */
+	unsigned GetBufferThreshold();
+
+	gcc_pure
+	unsigned CalculateBufferThreshold(AudioFormat format,
+					  unsigned buffered_before_play,
+					  unsigned capacity) const;
+
+	/**
+	 * The maximum number of chunks the decoder puts into its
+	 * pipe: DecoderControl::pipe_limit or
+	 * PlayerControl::buffer_chunks.
+	 *
+	 * Player lock must be held before calling.
+	 */
+	gcc_pure
+	unsigned GetPipeCapacity() const {
+		return dc.pipe_limit > 0 ? dc.pipe_limit : pc.buffer_chunks;
+	}
+
+	/**
+	 * Returns PlayerControl::buffered_before_play, but no more
+	 * than half of DecoderControl::pipe_limit (if set), because
+	 * the pipe would never grow that large.
+	 *
+	 * Player lock must be held before calling.
+	 */
+	gcc_pure
+	unsigned GetBufferedBeforePlay() const {
+		return dc.pipe_limit > 0 && dc.pipe_limit < pc.buffer_chunks
+			? std::min(pc.buffered_before_play, dc.pipe_limit / 2)
+			: pc.buffered_before_play;
+	}
+
+	/**
+	 * The maximum number of chunks for cross-fading: the next
+	 * song's decoder needs room for buffered_before_play chunks
+	 * while the old pipe is still full, which is taken from
+	 * PlayerControl::crossfade_chunks first.
+	 *
+	 * Player lock must be held before calling.
+	 */
+	gcc_pure
+	unsigned GetCrossFadeCapacity() const {
+		const unsigned capacity = GetPipeCapacity();
+		const unsigned reserve = pc.crossfade_chunks;
+		const unsigned needed = GetBufferedBeforePlay();
+		return needed > reserve
+			? capacity - std::min(capacity, needed - reserve)
+			: capacity;
+	}
+
+	unsigned LockGetBufferedBeforePlay() const {
+		const ScopeLock protect(pc.mutex);
+		return GetBufferedBeforePlay();
+	}
+
 	/**
 	 * Player lock must be held before calling.
 	 */
@@ -381,6 +517,50 @@ Player::ForwardDecoderError()
 	return true;
 }
 
+inline void
+Player::CheckPrefetch()
+{
+	assert(queued);
+	assert(!prefetched);
+	assert(pc.next_song != nullptr);
+
+	if (!IsDecoderAtCurrentSong() || pipe->IsEmpty())
+		return;
+
+	/* the newest chunk tells how far the decoder has come */
+
+	const MusicChunk &last = *pipe->Get(pipe->GetTail() - 1);
+	if (last.time.IsNegative())
+		return;
+
+	pc.Lock();
+	const SignedSongTime end = dc.end_time.IsPositive()
+		? SignedSongTime(dc.end_time)
+		: dc.total_time;
+	pc.Unlock();
+
+	if (end.IsNegative() ||
+	    end - last.time > SignedSongTime(pc.prefetch_time))
+		return;
+
+	prefetched = true;
+	dc.Prefetch(*pc.next_song);
+}
+
+inline void
+Player::UpdateUpcoming()
+{
+	if (!pc.upcoming_modified)
+		return;
+
+	pc.upcoming_modified = false;
+	const std::vector<std::string> uris = pc.upcoming;
+
+	pc.Unlock();
+	dc.PrefetchUpcoming(uris);
+	pc.Lock();
+}
+
 void
 Player::ActivateDecoder()
 {
@@ -544,7 +724,8 @@ Player::SendSilence()
 	const size_t frame_size = play_audio_format.GetFrameSize();
 	/* this formula ensures that we don't send
 	   partial frames */
-	unsigned num_frames = sizeof(chunk->data) / frame_size;
+	unsigned num_frames = MusicChunkLimit(chunk->capacity,
+					      play_audio_format) / frame_size;
 
 	chunk->time = SignedSongTime::Negative(); /* undefined time stamp */
 	chunk->length = num_frames * frame_size;
@@ -560,11 +741,95 @@ Player::SendSilence()
 	return true;
 }
 
+inline bool
+Player::SeekHistory()
+{
+	assert(pc.next_song != nullptr);
+
+	if (!IsDecoderAtCurrentSong() || !song->IsSame(*pc.next_song))
+		return false;
+
+	SongTime where = pc.seek_time;
+	if (!pc.total_time.IsNegative()) {
+		const SongTime total_time(pc.total_time);
+		if (where > total_time)
+			where = total_time;
+	}
+
+	if (!pc.outputs.Rewind(where, *pipe))
+		return false;
+
+	FormatDebug(player_domain, "seeking within the history");
+
+	delete pc.next_song;
+	pc.next_song = nullptr;
+	queued = false;
+
+	elapsed_time = where;
+
+	pc.LockCommandFinished();
+
+	buffering = true;
+	buffering_since = MonotonicClockUS();
+	buffer_threshold = 0;
+
+	return true;
+}
+
+unsigned
+Player::CalculateBufferThreshold(AudioFormat format,
+				 unsigned buffered_before_play,
+				 unsigned capacity) const
+{
+	InputSourceStats stats;
+	if (!InputStatsLookup(song->GetRealURI(), stats))
+		return buffered_before_play;
+
+	const double chunks_per_second = format.GetTimeToSize() /
+		MusicChunkLimit(buffer.GetChunkSize(), format);
+	const double seconds = stats.stall * ADAPTIVE_BUFFER_STALL_FACTOR
+		+ ADAPTIVE_BUFFER_BASE;
+
+	const unsigned n = ceil(seconds * chunks_per_second);
+	return std::min(std::max(n, 1u), capacity / 2);
+}
+
+unsigned
+Player::GetBufferThreshold()
+{
+	if (!pc.adaptive_buffering)
+		return LockGetBufferedBeforePlay();
+
+	if (buffer_threshold > 0)
+		return buffer_threshold;
+
+	/* the decoder sets the audio format before it pushes the
+	   first chunk; until then, any threshold will do */
+	if (pipe->IsEmpty())
+		return 1;
+
+	pc.Lock();
+	const AudioFormat format = dc.out_audio_format;
+	const unsigned buffered_before_play = GetBufferedBeforePlay();
+	const unsigned capacity = GetPipeCapacity();
+	pc.Unlock();
+
+	buffer_threshold = CalculateBufferThreshold(format,
+						    buffered_before_play,
+						    capacity);
+	FormatDebug(player_domain, "buffering %u chunks before playback",
+		    buffer_threshold);
+	return buffer_threshold;
+}
+
 inline bool
 Player::SeekDecoder()
 {
 	assert(pc.next_song != nullptr);
 
+	if (SeekHistory())
+		return true;
+
 	const SongTime start_time = pc.next_song->GetStartTime();
 
 	if (!dc.LockIsCurrentSong(*pc.next_song)) {
@@ -627,6 +892,8 @@ Player::SeekDecoder()
 
 	/* re-fill the buffer after seeking */
 	buffering = true;
+	buffering_since = MonotonicClockUS();
+	buffer_threshold = 0;
 
 	pc.outputs.Cancel();
 
@@ -656,11 +923,12 @@ Player::ProcessCommand()
 		assert(!IsDecoderAtNextSong());
 
 		queued = true;
+		prefetched = false;
 		pc.CommandFinished();
 
 		pc.Unlock();
 		if (dc.LockIsIdle())
-			StartDecoder(*new MusicPipe());
+			StartDecoder(*new MusicPipe(buffer.GetSize()));
 		pc.Lock();
 
 		break;
@@ -712,9 +980,17 @@ Player::ProcessCommand()
 			pc.Lock();
 		}
 
+		if (prefetched) {
+			const std::string uri(pc.next_song->GetRealURI());
+			pc.Unlock();
+			dc.DiscardPrefetch(uri.c_str());
+			pc.Lock();
+		}
+
 		delete pc.next_song;
 		pc.next_song = nullptr;
 		queued = false;
+
 		pc.CommandFinished();
 		break;
 
@@ -725,9 +1001,17 @@ Player::ProcessCommand()
 			pc.Lock();
 		}
 
-		pc.elapsed_time = !pc.outputs.GetElapsedTime().IsNegative()
-			? SongTime(pc.outputs.GetElapsedTime())
-			: elapsed_time;
+		if (!pc.outputs.GetElapsedTime().IsNegative()) {
+			/* the outputs are still playing what they have
+			   queued in their device buffers */
+			const SongTime latency =
+				SongTime::FromMS(pc.outputs.GetLatency() / 1000);
+			const SongTime e(pc.outputs.GetElapsedTime());
+			pc.elapsed_time = e > latency
+				? e - latency
+				: SongTime::zero();
+		} else
+			pc.elapsed_time = elapsed_time;
 
 		pc.CommandFinished();
 		break;
@@ -801,6 +1085,17 @@ Player::PlayNextChunk()
 		   another chunk */
 		return true;
 
+	const ScopeTrace trace("player.PlayNextChunk");
+
+	perf_stats.pipe_fill.Add(pipe->GetSize());
+
+	if (IsDecoderAtCurrentSong() &&
+	    pipe->GetSize() < LockGetBufferedBeforePlay() &&
+	    !dc.LockIsIdle())
+		/* the decoder cannot keep up; tell the database
+		   update to back off */
+		pc.low_water_time = MonotonicClockUS();
+
 	/* activate cross-fading? */
 	if (xfade_state == CrossFadeState::ENABLED &&
 	    IsDecoderAtNextSong() &&
@@ -838,6 +1133,9 @@ Player::PlayNextChunk()
 			if (pc.cross_fade.mixramp_delay <= 0) {
 				chunk->mix_ratio = ((float)cross_fade_position)
 					     / cross_fade_chunks;
+				chunk->mix_ratio_end =
+					((float)cross_fade_position - 1)
+					/ cross_fade_chunks;
 			} else {
 				chunk->mix_ratio = -1;
 			}
@@ -918,8 +1216,8 @@ Player::PlayNextChunk()
 	   larger block at a time */
 	pc.Lock();
 	if (!dc.IsIdle() &&
-	    dc.pipe->GetSize() <= (pc.buffered_before_play +
-				   buffer.GetSize() * 3) / 4) {
+	    dc.pipe->GetSize() <= (GetBufferedBeforePlay() +
+				   GetPipeCapacity() * 3) / 4) {
 		if (!decoder_woken) {
 			decoder_woken = true;
 			dc.Signal();
@@ -959,7 +1257,7 @@ Player::SongBorder()
 inline void
 Player::Run()
 {
-	pipe = new MusicPipe();
+	pipe = new MusicPipe(buffer.GetSize());
 
 	StartDecoder(*pipe);
 	ActivateDecoder();
@@ -979,6 +1277,8 @@ Player::Run()
 			break;
 		}
 
+		UpdateUpcoming();
+
 		pc.Unlock();
 
 		if (buffering) {
@@ -986,14 +1286,17 @@ Player::Run()
 			   until the buffer is large enough, to
 			   prevent stuttering on slow machines */
 
-			if (pipe->GetSize() < pc.buffered_before_play &&
+			if (pipe->GetSize() < GetBufferThreshold() &&
 			    !dc.LockIsIdle()) {
 				/* not enough decoded buffer space yet */
 
 				if (!paused && output_open &&
-				    pc.outputs.Check() < 4 &&
-				    !SendSilence())
-					break;
+				    pc.outputs.Check() < 4) {
+					pc.low_water_time = MonotonicClockUS();
+
+					if (!SendSilence())
+						break;
+				}
 
 				pc.Lock();
 				/* XXX race condition: check decoder again */
@@ -1002,6 +1305,8 @@ Player::Run()
 			} else {
 				/* buffering is complete */
 				buffering = false;
+				perf_stats.player_buffering.Add(MonotonicClockUS() -
+								buffering_since);
 			}
 		}
 
@@ -1029,8 +1334,10 @@ Player::Run()
 
 			assert(dc.pipe == nullptr || dc.pipe == pipe);
 
-			StartDecoder(*new MusicPipe());
-		}
+			StartDecoder(*new MusicPipe(buffer.GetSize()));
+		} else if (queued && !prefetched &&
+			   pc.prefetch_time.IsPositive())
+			CheckPrefetch();
 
 		if (/* no cross-fading if MPD is going to pause at the
 		       end of the current song */
@@ -1049,8 +1356,8 @@ Player::Run()
 							dc.GetMixRampPreviousEnd(),
 							dc.out_audio_format,
 							play_audio_format,
-							buffer.GetSize() -
-							pc.buffered_before_play);
+							buffer.GetChunkSize(),
+							GetCrossFadeCapacity());
 			if (cross_fade_chunks > 0)
 				xfade_state = CrossFadeState::ENABLED;
 			else
@@ -1101,6 +1408,15 @@ Player::Run()
 			/* the decoder is too busy and hasn't provided
 			   new PCM data in time: send silence (if the
 			   output pipe is empty) */
+			++perf_stats.player_underruns;
+
+			if (!pc.send_silence) {
+				/* wait for the decoder instead */
+				pc.Lock();
+				dc.WaitForDecoder();
+				continue;
+			}
+
 			if (!SendSilence())
 				break;
 		}
@@ -1109,6 +1425,13 @@ Player::Run()
 	}
 
 	StopDecoder();
+	dc.ClearPrefetch();
+
+	pc.Lock();
+	/* the playlist submits a new list when playback resumes */
+	pc.upcoming.clear();
+	pc.upcoming_modified = false;
+	pc.Unlock();
 
 	ClearAndDeletePipe();
 
@@ -1138,8 +1461,13 @@ static void
 do_play(PlayerControl &pc, DecoderControl &dc,
 	MusicBuffer &buffer)
 {
+	const unsigned long failures = buffer.GetAllocationFailures();
+
 	Player player(pc, dc, buffer);
 	player.Run();
+
+	FormatDebug(player_domain, "music buffer was full %lu times",
+		    buffer.GetAllocationFailures() - failures);
 }
 
 static void
@@ -1148,11 +1476,18 @@ player_task(void *arg)
 	PlayerControl &pc = *(PlayerControl *)arg;
 
 	SetThreadName("player");
+	ApplyThreadSettings("player");
 
 	DecoderControl dc(pc.mutex, pc.cond);
+	dc.prefetch_limit = std::max(pc.prefetch_songs, 1u);
+	dc.max_buffer_time = pc.max_buffer_time;
+	if (pc.crossfade_chunks > 0)
+		dc.max_pipe_chunks = pc.buffer_chunks;
+	dc.preferred_format = pc.outputs.GetPreferredFormat();
 	decoder_thread_start(dc);
 
-	MusicBuffer buffer(pc.buffer_chunks);
+	MusicBuffer buffer(pc.buffer_chunks + pc.crossfade_chunks,
+			   pc.chunk_size, pc.buffer_options);
 
 	pc.Lock();
 
@@ -1171,6 +1506,7 @@ player_task(void *arg)
 		case PlayerCommand::STOP:
 			pc.Unlock();
 			pc.outputs.Cancel();
+			buffer.Discard();
 			pc.Lock();
 
 			/* fall through */
@@ -1187,11 +1523,12 @@ player_task(void *arg)
 
 			pc.outputs.Release();
 
+			assert(buffer.IsEmptyUnsafe());
+			buffer.Discard();
+
 			pc.Lock();
 			pc.CommandFinished();
 
-			assert(buffer.IsEmptyUnsafe());
-
 			break;
 
 		case PlayerCommand::UPDATE_AUDIO:
@@ -36,6 +36,8 @@ playlist_open_in_playlist_dir(const char *uri, Mutex &mutex, Cond &cond)
 {
 	assert(spl_valid_name(uri));
 
+	spl_flush(uri);
+
 	const auto path_fs = map_spl_utf8_to_fs(uri);
 	if (path_fs.IsNull())
 		return nullptr;
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "XmlSongEnumerator.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <exception>
+
+#include <assert.h>
+
+bool
+XmlSongEnumerator::ReadChunk()
+{
+	assert(!eof);
+
+	char buffer[4096];
+	Error error;
+	size_t nbytes = is->LockRead(buffer, sizeof(buffer), error);
+	if (nbytes == 0) {
+		eof = true;
+
+		if (error.IsDefined()) {
+			LogError(error);
+			return false;
+		}
+
+		Parse("", 0, true);
+		return true;
+	}
+
+	Parse(buffer, nbytes, false);
+	return true;
+}
+
+bool
+XmlSongEnumerator::Fill()
+{
+	try {
+		while (songs.empty() && !eof)
+			if (!ReadChunk())
+				return false;
+	} catch (const std::exception &e) {
+		LogError(e);
+		eof = true;
+		return false;
+	}
+
+	return true;
+}
+
+std::unique_ptr<DetachedSong>
+XmlSongEnumerator::NextSong()
+{
+	if (songs.empty())
+		Fill();
+
+	if (songs.empty())
+		return nullptr;
+
+	std::unique_ptr<DetachedSong> result(new DetachedSong(std::move(songs.front())));
+	songs.pop_front();
+	return result;
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_XML_SONG_ENUMERATOR_HXX
+#define MPD_XML_SONG_ENUMERATOR_HXX
+
+#include "SongEnumerator.hxx"
+#include "DetachedSong.hxx"
+#include "input/InputStream.hxx"
+#include "lib/expat/ExpatParser.hxx"
+
+#include <list>
+#include <utility>
+
+/**
+ * A #SongEnumerator which parses an XML document incrementally: the
+ * input is read in small chunks on demand, and each song is returned
+ * as soon as its element has been closed.  Subclasses implement the
+ * #CommonExpatParser callbacks and call AddSong().
+ */
+class XmlSongEnumerator : public SongEnumerator, protected CommonExpatParser {
+	InputStreamPtr is;
+
+	/**
+	 * Songs which have been parsed, but not yet returned by
+	 * NextSong().  This contains only the songs from the most
+	 * recent chunk.
+	 */
+	std::list<DetachedSong> songs;
+
+	/**
+	 * Has the end of the document been reached (or an error
+	 * occurred)?
+	 */
+	bool eof = false;
+
+protected:
+	explicit XmlSongEnumerator(InputStreamPtr &&_is)
+		:is(std::move(_is)) {}
+
+	template<typename... Args>
+	void AddSong(Args&&... args) {
+		songs.emplace_back(std::forward<Args>(args)...);
+	}
+
+public:
+	/**
+	 * Parse the beginning of the document, up to the first song.
+	 * Errors are logged.
+	 *
+	 * @return false if the document could not be parsed before
+	 * the first song was found
+	 */
+	bool Open() {
+		return Fill() || !songs.empty();
+	}
+
+	/* virtual methods from class SongEnumerator */
+	std::unique_ptr<DetachedSong> NextSong() override;
+
+private:
+	/**
+	 * Read and parse the next chunk of the input.  Throws
+	 * #ExpatError if the document is malformed.
+	 *
+	 * @return false on I/O error (which has been logged)
+	 */
+	bool ReadChunk();
+
+	/**
+	 * Parse until at least one song is available or the end of
+	 * the document is reached.  Errors are logged and end the
+	 * document.
+	 *
+	 * @return false if an error has occurred
+	 */
+	bool Fill();
+};
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "CueCache.hxx"
+#include "fs/Path.hxx"
+#include "fs/FileInfo.hxx"
+#include "thread/Mutex.hxx"
+
+#include <list>
+#include <string>
+
+/**
+ * The maximum number of CUE sheets in the cache.
+ */
+static constexpr size_t CUE_CACHE_SIZE = 32;
+
+struct CueCacheEntry {
+	/**
+	 * The path of the file containing the CUE sheet, in file
+	 * system encoding.
+	 */
+	const std::string path;
+
+	/**
+	 * The modification time and size of the file when it was
+	 * parsed.
+	 */
+	const time_t mtime;
+	const uint64_t size;
+
+	const std::forward_list<DetachedSong> songs;
+
+	CueCacheEntry(Path _path, const FileInfo &fi,
+		      const std::forward_list<DetachedSong> &_songs)
+		:path(_path.c_str()),
+		 mtime(fi.GetModificationTime()), size(fi.GetSize()),
+		 songs(_songs) {}
+
+	gcc_pure
+	bool Matches(const FileInfo &fi) const {
+		return fi.GetModificationTime() == mtime &&
+			fi.GetSize() == size;
+	}
+};
+
+static Mutex cue_cache_mutex;
+
+/**
+ * The cached entries, the most recently used one first.
+ */
+static std::list<CueCacheEntry> cue_cache;
+
+gcc_pure
+static std::list<CueCacheEntry>::iterator
+cue_cache_find(Path path)
+{
+	for (auto i = cue_cache.begin(); i != cue_cache.end(); ++i)
+		if (i->path == path.c_str())
+			return i;
+
+	return cue_cache.end();
+}
+
+bool
+cue_cache_get(Path path, const FileInfo &fi,
+	      std::forward_list<DetachedSong> &songs)
+{
+	const ScopeLock protect(cue_cache_mutex);
+
+	auto i = cue_cache_find(path);
+	if (i == cue_cache.end())
+		return false;
+
+	if (!i->Matches(fi)) {
+		/* the file has been modified */
+		cue_cache.erase(i);
+		return false;
+	}
+
+	/* move to the front of the LRU list */
+	cue_cache.splice(cue_cache.begin(), cue_cache, i);
+
+	songs = i->songs;
+	return true;
+}
+
+void
+cue_cache_put(Path path, const FileInfo &fi,
+	      const std::forward_list<DetachedSong> &songs)
+{
+	const ScopeLock protect(cue_cache_mutex);
+
+	auto i = cue_cache_find(path);
+	if (i != cue_cache.end())
+		cue_cache.erase(i);
+	else if (cue_cache.size() >= CUE_CACHE_SIZE)
+		cue_cache.pop_back();
+
+	cue_cache.emplace_front(path, fi, songs);
+}
+
+void
+cue_cache_clear()
+{
+	const ScopeLock protect(cue_cache_mutex);
+	cue_cache.clear();
+}
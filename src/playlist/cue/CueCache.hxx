@@ -0,0 +1,67 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_CUE_CACHE_HXX
+#define MPD_CUE_CACHE_HXX
+
+#include "check.h"
+#include "DetachedSong.hxx"
+
+#include <forward_list>
+
+class Path;
+class FileInfo;
+
+/*
+ * A cache of parsed CUE sheets, keyed by the path of the file which
+ * contains them (a ".cue" file or a song file with an embedded
+ * sheet).  All functions are thread-safe.
+ */
+
+/**
+ * Look up a CUE sheet.  The entry is only used if the file's
+ * modification time and size are still the same as when it was
+ * stored.
+ *
+ * @param fi the current information about the file
+ * @return true if the sheet was found in the cache, and its songs
+ * have been copied to #songs
+ */
+bool
+cue_cache_get(Path path, const FileInfo &fi,
+	      std::forward_list<DetachedSong> &songs);
+
+/**
+ * Store a parsed CUE sheet in the cache.
+ *
+ * @param fi the information about the file, obtained before it was
+ * parsed
+ */
+void
+cue_cache_put(Path path, const FileInfo &fi,
+	      const std::forward_list<DetachedSong> &songs);
+
+/**
+ * Free all cached CUE sheets.
+ */
+void
+cue_cache_clear();
+
+#endif
@@ -20,24 +20,15 @@
 #include "config.h"
 #include "AsxPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../XmlSongEnumerator.hxx"
 #include "tag/TagBuilder.hxx"
 #include "util/ASCII.hxx"
-#include "util/Error.hxx"
 #include "util/StringView.hxx"
-#include "lib/expat/ExpatParser.hxx"
-#include "Log.hxx"
 
 /**
  * This is the state object for our XML parser.
  */
-struct AsxParser {
-	/**
-	 * The list of songs (in reverse order because that's faster
-	 * while adding).
-	 */
-	std::forward_list<DetachedSong> songs;
-
+class AsxParser final : public XmlSongEnumerator {
 	/**
 	 * The current position in the XML file.
 	 */
@@ -59,80 +50,81 @@ struct AsxParser {
 
 	TagBuilder tag_builder;
 
-	AsxParser()
-		:state(ROOT) {}
+public:
+	explicit AsxParser(InputStreamPtr &&_is)
+		:XmlSongEnumerator(std::move(_is)), state(ROOT) {}
 
+protected:
+	/* virtual methods from class CommonExpatParser */
+	void StartElement(const XML_Char *name,
+			  const XML_Char **atts) override;
+	void EndElement(const XML_Char *name) override;
+	void CharacterData(const XML_Char *s, int len) override;
 };
 
-static void XMLCALL
-asx_start_element(void *user_data, const XML_Char *element_name,
-		  const XML_Char **atts)
+void
+AsxParser::StartElement(const XML_Char *element_name,
+			const XML_Char **atts)
 {
-	AsxParser *parser = (AsxParser *)user_data;
-
-	switch (parser->state) {
-	case AsxParser::ROOT:
+	switch (state) {
+	case ROOT:
 		if (StringEqualsCaseASCII(element_name, "entry")) {
-			parser->state = AsxParser::ENTRY;
-			parser->location.clear();
-			parser->tag_type = TAG_NUM_OF_ITEM_TYPES;
+			state = ENTRY;
+			location.clear();
+			tag_type = TAG_NUM_OF_ITEM_TYPES;
 		}
 
 		break;
 
-	case AsxParser::ENTRY:
+	case ENTRY:
 		if (StringEqualsCaseASCII(element_name, "ref")) {
 			const char *href =
 				ExpatParser::GetAttributeCase(atts, "href");
 			if (href != nullptr)
-				parser->location = href;
+				location = href;
 		} else if (StringEqualsCaseASCII(element_name, "author"))
 			/* is that correct?  or should it be COMPOSER
 			   or PERFORMER? */
-			parser->tag_type = TAG_ARTIST;
+			tag_type = TAG_ARTIST;
 		else if (StringEqualsCaseASCII(element_name, "title"))
-			parser->tag_type = TAG_TITLE;
+			tag_type = TAG_TITLE;
 
 		break;
 	}
 }
 
-static void XMLCALL
-asx_end_element(void *user_data, const XML_Char *element_name)
+void
+AsxParser::EndElement(const XML_Char *element_name)
 {
-	AsxParser *parser = (AsxParser *)user_data;
-
-	switch (parser->state) {
-	case AsxParser::ROOT:
+	switch (state) {
+	case ROOT:
 		break;
 
-	case AsxParser::ENTRY:
+	case ENTRY:
 		if (StringEqualsCaseASCII(element_name, "entry")) {
-			if (!parser->location.empty())
-				parser->songs.emplace_front(std::move(parser->location),
-							    parser->tag_builder.Commit());
+			if (!location.empty())
+				AddSong(std::move(location),
+					tag_builder.Commit());
 
-			parser->state = AsxParser::ROOT;
+			state = ROOT;
 		} else
-			parser->tag_type = TAG_NUM_OF_ITEM_TYPES;
+			tag_type = TAG_NUM_OF_ITEM_TYPES;
 
 		break;
 	}
 }
 
-static void XMLCALL
-asx_char_data(void *user_data, const XML_Char *s, int len)
+void
+AsxParser::CharacterData(const XML_Char *s, int len)
 {
-	AsxParser *parser = (AsxParser *)user_data;
-
-	switch (parser->state) {
-	case AsxParser::ROOT:
+	switch (state) {
+	case ROOT:
 		break;
 
-	case AsxParser::ENTRY:
-		if (parser->tag_type != TAG_NUM_OF_ITEM_TYPES)
-			parser->tag_builder.AddItem(parser->tag_type,
-						    StringView(s, len));
+	case ENTRY:
+		if (tag_type != TAG_NUM_OF_ITEM_TYPES)
+			tag_builder.AddItem(tag_type,
+					    StringView(s, len));
 
 		break;
 	}
@@ -146,22 +138,11 @@ asx_char_data(void *user_data, const XML_Char *s, int len)
 static SongEnumerator *
 asx_open_stream(InputStreamPtr &&is)
 {
-	AsxParser parser;
-
-	{
-		ExpatParser expat(&parser);
-		expat.SetElementHandler(asx_start_element, asx_end_element);
-		expat.SetCharacterDataHandler(asx_char_data);
-
-		Error error;
-		if (!expat.Parse(*is, error)) {
-			LogError(error);
-			return nullptr;
-		}
-	}
+	std::unique_ptr<AsxParser> parser(new AsxParser(std::move(is)));
+	if (!parser->Open())
+		return nullptr;
 
-	parser.songs.reverse();
-	return new MemorySongEnumerator(std::move(parser.songs));
+	return parser.release();
 }
 
 static const char *const asx_suffixes[] = {
@@ -21,8 +21,14 @@
 #include "CuePlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
 #include "../SongEnumerator.hxx"
+#include "../MemorySongEnumerator.hxx"
 #include "../cue/CueParser.hxx"
+#include "../cue/CueCache.hxx"
 #include "input/TextInputStream.hxx"
+#include "input/InputStream.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
+#include "fs/Traits.hxx"
 
 class CuePlaylist final : public SongEnumerator {
 	TextInputStream tis;
@@ -36,10 +42,39 @@ class CuePlaylist final : public SongEnumerator {
 	virtual std::unique_ptr<DetachedSong> NextSong() override;
 };
 
+static void
+cue_playlist_finish()
+{
+	cue_cache_clear();
+}
+
 static SongEnumerator *
 cue_playlist_open_stream(InputStreamPtr &&is)
 {
-	return new CuePlaylist(std::move(is));
+	/* local files are parsed completely and cached, because the
+	   same CUE sheet is usually opened once for each of its
+	   tracks */
+	const char *uri = is->GetURI();
+	const auto path = PathTraitsUTF8::IsAbsolute(uri)
+		? AllocatedPath::FromUTF8(uri)
+		: AllocatedPath::Null();
+	FileInfo fi;
+	if (path.IsNull() || !GetFileInfo(path, fi))
+		return new CuePlaylist(std::move(is));
+
+	std::forward_list<DetachedSong> songs;
+	if (!cue_cache_get(path, fi, songs)) {
+		CuePlaylist playlist(std::move(is));
+
+		auto i = songs.before_begin();
+		std::unique_ptr<DetachedSong> song;
+		while ((song = playlist.NextSong()) != nullptr)
+			i = songs.emplace_after(i, std::move(*song));
+
+		cue_cache_put(path, fi, songs);
+	}
+
+	return new MemorySongEnumerator(std::move(songs));
 }
 
 std::unique_ptr<DetachedSong>
@@ -75,7 +110,7 @@ const struct playlist_plugin cue_playlist_plugin = {
 	"cue",
 
 	nullptr,
-	nullptr,
+	cue_playlist_finish,
 	nullptr,
 	cue_playlist_open_stream,
 
@@ -27,13 +27,16 @@
 #include "EmbeddedCuePlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
 #include "../SongEnumerator.hxx"
+#include "../MemorySongEnumerator.hxx"
 #include "../cue/CueParser.hxx"
+#include "../cue/CueCache.hxx"
 #include "tag/TagHandler.hxx"
 #include "tag/Generic.hxx"
 #include "DetachedSong.hxx"
 #include "TagFile.hxx"
 #include "fs/Traits.hxx"
 #include "fs/AllocatedPath.hxx"
+#include "fs/FileInfo.hxx"
 #include "util/ASCII.hxx"
 
 #include <string.h>
@@ -87,6 +90,12 @@ static constexpr TagHandler embcue_tag_handler = {
 	embcue_tag_pair,
 };
 
+static void
+embcue_playlist_finish()
+{
+	cue_cache_clear();
+}
+
 static SongEnumerator *
 embcue_playlist_open_uri(const char *uri,
 			 gcc_unused Mutex &mutex,
@@ -98,24 +107,39 @@ embcue_playlist_open_uri(const char *uri,
 
 	const auto path_fs = AllocatedPath::FromUTF8Throw(uri);
 
-	const auto playlist = new EmbeddedCuePlaylist();
+	FileInfo fi;
+	if (!GetFileInfo(path_fs, fi))
+		return nullptr;
+
+	/* the same sheet is usually opened once for each of its
+	   tracks; scanning the tags and parsing it each time would
+	   be expensive */
+	std::forward_list<DetachedSong> songs;
+	if (cue_cache_get(path_fs, fi, songs))
+		return new MemorySongEnumerator(std::move(songs));
+
+	EmbeddedCuePlaylist playlist;
 
-	tag_file_scan(path_fs, embcue_tag_handler, playlist);
-	if (playlist->cuesheet.empty())
-		ScanGenericTags(path_fs, embcue_tag_handler, playlist);
+	tag_file_scan(path_fs, embcue_tag_handler, &playlist);
+	if (playlist.cuesheet.empty())
+		ScanGenericTags(path_fs, embcue_tag_handler, &playlist);
 
-	if (playlist->cuesheet.empty()) {
+	if (playlist.cuesheet.empty())
 		/* no "CUESHEET" tag found */
-		delete playlist;
 		return nullptr;
-	}
 
-	playlist->filename = PathTraitsUTF8::GetBase(uri);
+	playlist.filename = PathTraitsUTF8::GetBase(uri);
 
-	playlist->next = &playlist->cuesheet[0];
-	playlist->parser = new CueParser();
+	playlist.next = &playlist.cuesheet[0];
+	playlist.parser = new CueParser();
 
-	return playlist;
+	auto i = songs.before_begin();
+	std::unique_ptr<DetachedSong> song;
+	while ((song = playlist.NextSong()) != nullptr)
+		i = songs.emplace_after(i, std::move(*song));
+
+	cue_cache_put(path_fs, fi, songs);
+	return new MemorySongEnumerator(std::move(songs));
 }
 
 std::unique_ptr<DetachedSong>
@@ -170,7 +194,7 @@ const struct playlist_plugin embcue_playlist_plugin = {
 	"embcue",
 
 	nullptr,
-	nullptr,
+	embcue_playlist_finish,
 	embcue_playlist_open_uri,
 	nullptr,
 
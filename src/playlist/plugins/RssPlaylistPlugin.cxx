@@ -20,24 +20,15 @@
 #include "config.h"
 #include "RssPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../XmlSongEnumerator.hxx"
 #include "tag/TagBuilder.hxx"
 #include "util/ASCII.hxx"
-#include "util/Error.hxx"
 #include "util/StringView.hxx"
-#include "lib/expat/ExpatParser.hxx"
-#include "Log.hxx"
 
 /**
  * This is the state object for the our XML parser.
  */
-struct RssParser {
-	/**
-	 * The list of songs (in reverse order because that's faster
-	 * while adding).
-	 */
-	std::forward_list<DetachedSong> songs;
-
+class RssParser final : public XmlSongEnumerator {
 	/**
 	 * The current position in the XML file.
 	 */
@@ -60,77 +51,79 @@ struct RssParser {
 
 	TagBuilder tag_builder;
 
-	RssParser()
-		:state(ROOT) {}
+public:
+	explicit RssParser(InputStreamPtr &&_is)
+		:XmlSongEnumerator(std::move(_is)), state(ROOT) {}
+
+protected:
+	/* virtual methods from class CommonExpatParser */
+	void StartElement(const XML_Char *name,
+			  const XML_Char **atts) override;
+	void EndElement(const XML_Char *name) override;
+	void CharacterData(const XML_Char *s, int len) override;
 };
 
-static void XMLCALL
-rss_start_element(void *user_data, const XML_Char *element_name,
-		  const XML_Char **atts)
+void
+RssParser::StartElement(const XML_Char *element_name,
+			const XML_Char **atts)
 {
-	RssParser *parser = (RssParser *)user_data;
-
-	switch (parser->state) {
-	case RssParser::ROOT:
+	switch (state) {
+	case ROOT:
 		if (StringEqualsCaseASCII(element_name, "item")) {
-			parser->state = RssParser::ITEM;
-			parser->location.clear();
-			parser->tag_type = TAG_NUM_OF_ITEM_TYPES;
+			state = ITEM;
+			location.clear();
+			tag_type = TAG_NUM_OF_ITEM_TYPES;
 		}
 
 		break;
 
-	case RssParser::ITEM:
+	case ITEM:
 		if (StringEqualsCaseASCII(element_name, "enclosure")) {
 			const char *href =
 				ExpatParser::GetAttributeCase(atts, "url");
 			if (href != nullptr)
-				parser->location = href;
+				location = href;
 		} else if (StringEqualsCaseASCII(element_name, "title"))
-			parser->tag_type = TAG_TITLE;
+			tag_type = TAG_TITLE;
 		else if (StringEqualsCaseASCII(element_name, "itunes:author"))
-			parser->tag_type = TAG_ARTIST;
+			tag_type = TAG_ARTIST;
 
 		break;
 	}
 }
 
-static void XMLCALL
-rss_end_element(void *user_data, const XML_Char *element_name)
+void
+RssParser::EndElement(const XML_Char *element_name)
 {
-	RssParser *parser = (RssParser *)user_data;
-
-	switch (parser->state) {
-	case RssParser::ROOT:
+	switch (state) {
+	case ROOT:
 		break;
 
-	case RssParser::ITEM:
+	case ITEM:
 		if (StringEqualsCaseASCII(element_name, "item")) {
-			if (!parser->location.empty())
-				parser->songs.emplace_front(std::move(parser->location),
-							    parser->tag_builder.Commit());
+			if (!location.empty())
+				AddSong(std::move(location),
+					tag_builder.Commit());
 
-			parser->state = RssParser::ROOT;
+			state = ROOT;
 		} else
-			parser->tag_type = TAG_NUM_OF_ITEM_TYPES;
+			tag_type = TAG_NUM_OF_ITEM_TYPES;
 
 		break;
 	}
 }
 
-static void XMLCALL
-rss_char_data(void *user_data, const XML_Char *s, int len)
+void
+RssParser::CharacterData(const XML_Char *s, int len)
 {
-	RssParser *parser = (RssParser *)user_data;
-
-	switch (parser->state) {
-	case RssParser::ROOT:
+	switch (state) {
+	case ROOT:
 		break;
 
-	case RssParser::ITEM:
-		if (parser->tag_type != TAG_NUM_OF_ITEM_TYPES)
-			parser->tag_builder.AddItem(parser->tag_type,
-						    StringView(s, len));
+	case ITEM:
+		if (tag_type != TAG_NUM_OF_ITEM_TYPES)
+			tag_builder.AddItem(tag_type,
+					    StringView(s, len));
 
 		break;
 	}
@@ -144,22 +137,11 @@ rss_char_data(void *user_data, const XML_Char *s, int len)
 static SongEnumerator *
 rss_open_stream(InputStreamPtr &&is)
 {
-	RssParser parser;
-
-	{
-		ExpatParser expat(&parser);
-		expat.SetElementHandler(rss_start_element, rss_end_element);
-		expat.SetCharacterDataHandler(rss_char_data);
-
-		Error error;
-		if (!expat.Parse(*is, error)) {
-			LogError(error);
-			return nullptr;
-		}
-	}
+	std::unique_ptr<RssParser> parser(new RssParser(std::move(is)));
+	if (!parser->Open())
+		return nullptr;
 
-	parser.songs.reverse();
-	return new MemorySongEnumerator(std::move(parser.songs));
+	return parser.release();
 }
 
 static const char *const rss_suffixes[] = {
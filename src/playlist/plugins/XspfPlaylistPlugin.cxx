@@ -20,27 +20,18 @@
 #include "config.h"
 #include "XspfPlaylistPlugin.hxx"
 #include "../PlaylistPlugin.hxx"
-#include "../MemorySongEnumerator.hxx"
+#include "../XmlSongEnumerator.hxx"
 #include "DetachedSong.hxx"
 #include "input/InputStream.hxx"
 #include "tag/TagBuilder.hxx"
-#include "util/Error.hxx"
 #include "util/StringView.hxx"
-#include "lib/expat/ExpatParser.hxx"
-#include "Log.hxx"
 
 #include <string.h>
 
 /**
  * This is the state object for our XML parser.
  */
-struct XspfParser {
-	/**
-	 * The list of songs (in reverse order because that's faster
-	 * while adding).
-	 */
-	std::forward_list<DetachedSong> songs;
-
+class XspfParser final : public XmlSongEnumerator {
 	/**
 	 * The current position in the XML file.
 	 */
@@ -63,121 +54,123 @@ struct XspfParser {
 
 	TagBuilder tag_builder;
 
-	XspfParser()
-		:state(ROOT) {}
+public:
+	explicit XspfParser(InputStreamPtr &&_is)
+		:XmlSongEnumerator(std::move(_is)), state(ROOT) {}
+
+protected:
+	/* virtual methods from class CommonExpatParser */
+	void StartElement(const XML_Char *name,
+			  const XML_Char **atts) override;
+	void EndElement(const XML_Char *name) override;
+	void CharacterData(const XML_Char *s, int len) override;
 };
 
-static void XMLCALL
-xspf_start_element(void *user_data, const XML_Char *element_name,
-		   gcc_unused const XML_Char **atts)
+void
+XspfParser::StartElement(const XML_Char *element_name,
+			 gcc_unused const XML_Char **atts)
 {
-	XspfParser *parser = (XspfParser *)user_data;
-
-	switch (parser->state) {
-	case XspfParser::ROOT:
+	switch (state) {
+	case ROOT:
 		if (strcmp(element_name, "playlist") == 0)
-			parser->state = XspfParser::PLAYLIST;
+			state = PLAYLIST;
 
 		break;
 
-	case XspfParser::PLAYLIST:
+	case PLAYLIST:
 		if (strcmp(element_name, "trackList") == 0)
-			parser->state = XspfParser::TRACKLIST;
+			state = TRACKLIST;
 
 		break;
 
-	case XspfParser::TRACKLIST:
+	case TRACKLIST:
 		if (strcmp(element_name, "track") == 0) {
-			parser->state = XspfParser::TRACK;
-			parser->location.clear();
-			parser->tag_type = TAG_NUM_OF_ITEM_TYPES;
+			state = TRACK;
+			location.clear();
+			tag_type = TAG_NUM_OF_ITEM_TYPES;
 		}
 
 		break;
 
-	case XspfParser::TRACK:
+	case TRACK:
 		if (strcmp(element_name, "location") == 0)
-			parser->state = XspfParser::LOCATION;
+			state = LOCATION;
 		else if (strcmp(element_name, "title") == 0)
-			parser->tag_type = TAG_TITLE;
+			tag_type = TAG_TITLE;
 		else if (strcmp(element_name, "creator") == 0)
 			/* TAG_COMPOSER would be more correct
 			   according to the XSPF spec */
-			parser->tag_type = TAG_ARTIST;
+			tag_type = TAG_ARTIST;
 		else if (strcmp(element_name, "annotation") == 0)
-			parser->tag_type = TAG_COMMENT;
+			tag_type = TAG_COMMENT;
 		else if (strcmp(element_name, "album") == 0)
-			parser->tag_type = TAG_ALBUM;
+			tag_type = TAG_ALBUM;
 		else if (strcmp(element_name, "trackNum") == 0)
-			parser->tag_type = TAG_TRACK;
+			tag_type = TAG_TRACK;
 
 		break;
 
-	case XspfParser::LOCATION:
+	case LOCATION:
 		break;
 	}
 }
 
-static void XMLCALL
-xspf_end_element(void *user_data, const XML_Char *element_name)
+void
+XspfParser::EndElement(const XML_Char *element_name)
 {
-	XspfParser *parser = (XspfParser *)user_data;
-
-	switch (parser->state) {
-	case XspfParser::ROOT:
+	switch (state) {
+	case ROOT:
 		break;
 
-	case XspfParser::PLAYLIST:
+	case PLAYLIST:
 		if (strcmp(element_name, "playlist") == 0)
-			parser->state = XspfParser::ROOT;
+			state = ROOT;
 
 		break;
 
-	case XspfParser::TRACKLIST:
+	case TRACKLIST:
 		if (strcmp(element_name, "tracklist") == 0)
-			parser->state = XspfParser::PLAYLIST;
+			state = PLAYLIST;
 
 		break;
 
-	case XspfParser::TRACK:
+	case TRACK:
 		if (strcmp(element_name, "track") == 0) {
-			if (!parser->location.empty())
-				parser->songs.emplace_front(std::move(parser->location),
-							    parser->tag_builder.Commit());
+			if (!location.empty())
+				AddSong(std::move(location),
+					tag_builder.Commit());
 
-			parser->state = XspfParser::TRACKLIST;
+			state = TRACKLIST;
 		} else
-			parser->tag_type = TAG_NUM_OF_ITEM_TYPES;
+			tag_type = TAG_NUM_OF_ITEM_TYPES;
 
 		break;
 
-	case XspfParser::LOCATION:
-		parser->state = XspfParser::TRACK;
+	case LOCATION:
+		state = TRACK;
 		break;
 	}
 }
 
-static void XMLCALL
-xspf_char_data(void *user_data, const XML_Char *s, int len)
+void
+XspfParser::CharacterData(const XML_Char *s, int len)
 {
-	XspfParser *parser = (XspfParser *)user_data;
-
-	switch (parser->state) {
-	case XspfParser::ROOT:
-	case XspfParser::PLAYLIST:
-	case XspfParser::TRACKLIST:
+	switch (state) {
+	case ROOT:
+	case PLAYLIST:
+	case TRACKLIST:
 		break;
 
-	case XspfParser::TRACK:
-		if (!parser->location.empty() &&
-		    parser->tag_type != TAG_NUM_OF_ITEM_TYPES)
-			parser->tag_builder.AddItem(parser->tag_type,
-						    StringView(s, len));
+	case TRACK:
+		if (!location.empty() &&
+		    tag_type != TAG_NUM_OF_ITEM_TYPES)
+			tag_builder.AddItem(tag_type,
+					    StringView(s, len));
 
 		break;
 
-	case XspfParser::LOCATION:
-		parser->location.assign(s, len);
+	case LOCATION:
+		location.assign(s, len);
 
 		break;
 	}
@@ -191,22 +184,11 @@ xspf_char_data(void *user_data, const XML_Char *s, int len)
 static SongEnumerator *
 xspf_open_stream(InputStreamPtr &&is)
 {
-	XspfParser parser;
-
-	{
-		ExpatParser expat(&parser);
-		expat.SetElementHandler(xspf_start_element, xspf_end_element);
-		expat.SetCharacterDataHandler(xspf_char_data);
-
-		Error error;
-		if (!expat.Parse(*is, error)) {
-			LogError(error);
-			return nullptr;
-		}
-	}
+	std::unique_ptr<XspfParser> parser(new XspfParser(std::move(is)));
+	if (!parser->Open())
+		return nullptr;
 
-	parser.songs.reverse();
-	return new MemorySongEnumerator(std::move(parser.songs));
+	return parser.release();
 }
 
 static const char *const xspf_suffixes[] = {
@@ -53,6 +53,11 @@ struct RangeArg {
 	static constexpr RangeArg All() {
 		return { 0, std::numeric_limits<unsigned>::max() };
 	}
+
+	constexpr bool IsAll() const {
+		return start == 0 &&
+			end == std::numeric_limits<unsigned>::max();
+	}
 };
 
 gcc_pure
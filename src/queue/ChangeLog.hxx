@@ -0,0 +1,133 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_QUEUE_CHANGE_LOG_HXX
+#define MPD_QUEUE_CHANGE_LOG_HXX
+
+#include <array>
+
+#include <assert.h>
+#include <stdint.h>
+
+/**
+ * A bounded log of the queue positions which have been modified,
+ * together with the queue version of each modification.  It allows
+ * answering "plchanges" without looking at every queue item, as long
+ * as the client's version is not older than the log.
+ */
+class QueueChangeLog {
+	static constexpr unsigned CAPACITY = 4096;
+
+	struct Entry {
+		uint32_t version;
+		unsigned position;
+	};
+
+	std::array<Entry, CAPACITY> entries;
+
+	/**
+	 * The index of the oldest entry.
+	 */
+	unsigned head = 0;
+
+	/**
+	 * The number of valid entries.
+	 */
+	unsigned n = 0;
+
+	/**
+	 * All modifications with this version or newer are in the
+	 * log.
+	 */
+	uint32_t min_version = 0;
+
+public:
+	/**
+	 * Forget all entries.  Call this when the queue has become
+	 * empty: all items added later will be logged.
+	 */
+	void Reset() {
+		head = n = 0;
+		min_version = 0;
+	}
+
+	/**
+	 * Disable the log until the next Reset().  This is necessary
+	 * when the queue version wraps around.
+	 */
+	void Disable() {
+		head = n = 0;
+		min_version = UINT32_MAX;
+	}
+
+	/**
+	 * Can the changes since the specified version be obtained from
+	 * this log?
+	 */
+	bool Covers(uint32_t version) const {
+		return version >= min_version;
+	}
+
+	void Add(uint32_t version, unsigned position) {
+		if (min_version == UINT32_MAX)
+			/* disabled */
+			return;
+
+		if (n > 0) {
+			const Entry &last = entries[(head + n - 1) % CAPACITY];
+			if (last.version == version &&
+			    last.position == position)
+				/* duplicate */
+				return;
+		}
+
+		if (n == CAPACITY) {
+			/* evict the oldest entry; its version is no
+			   longer covered completely */
+			min_version = entries[head].version + 1;
+			head = (head + 1) % CAPACITY;
+			--n;
+		}
+
+		entries[(head + n) % CAPACITY] = {version, position};
+		++n;
+	}
+
+	/**
+	 * Invoke the function for the position of each entry with the
+	 * specified version or newer.  Positions may be repeated, and
+	 * they may be out of range.
+	 */
+	template<typename F>
+	void ForEachSince(uint32_t version, F &&f) const {
+		assert(Covers(version));
+
+		/* the versions are ascending; walk backwards until
+		   an older one is found */
+		for (unsigned i = n; i > 0; --i) {
+			const Entry &e = entries[(head + i - 1) % CAPACITY];
+			if (e.version < version)
+				break;
+
+			f(e.position);
+		}
+	}
+};
+
+#endif
@@ -28,23 +28,48 @@
 
 /**
  * A table that maps id numbers to position numbers.
+ *
+ * The table is allocated on demand and grows with the number of ids
+ * in use, so that at most a quarter of it is occupied; this keeps
+ * GenerateId() fast.
  */
 class IdTable {
+	/**
+	 * The minimum number of elements allocated by Grow().
+	 */
+	static constexpr unsigned MIN_SIZE = 64;
+
+	/**
+	 * The size limit of #data; all id numbers are smaller.
+	 */
+	const unsigned max_size;
+
+	/**
+	 * The number of allocated elements in #data.
+	 */
 	unsigned size;
 
+	/**
+	 * The number of ids currently in use.
+	 */
+	unsigned count;
+
 	unsigned next;
 
 	int *data;
 
 public:
-	IdTable(unsigned _size):size(_size), next(1), data(new int[size]) {
-		std::fill_n(data, size, -1);
-	}
+	explicit IdTable(unsigned _max_size)
+		:max_size(_max_size), size(0), count(0), next(1),
+		 data(nullptr) {}
 
 	~IdTable() {
 		delete[] data;
 	}
 
+	IdTable(const IdTable &) = delete;
+	IdTable &operator=(const IdTable &) = delete;
+
 	int IdToPosition(unsigned id) const {
 		return id < size
 			? data[id]
@@ -52,8 +77,12 @@ public:
 	}
 
 	unsigned GenerateId() {
+		if (count >= size / 4 && size < max_size)
+			Grow();
+
 		assert(next > 0);
 		assert(next < size);
+		assert(count < size - 1);
 
 		while (true) {
 			unsigned id = next;
@@ -70,6 +99,7 @@ public:
 	unsigned Insert(unsigned position) {
 		unsigned id = GenerateId();
 		data[id] = position;
+		++count;
 		return id;
 	}
 
@@ -83,8 +113,26 @@ public:
 	void Erase(unsigned id) {
 		assert(id < size);
 		assert(data[id] >= 0);
+		assert(count > 0);
 
 		data[id] = -1;
+		--count;
+	}
+
+private:
+	void Grow() {
+		const unsigned new_size =
+			std::min(std::max(size * 2, unsigned(MIN_SIZE)),
+				 max_size);
+		assert(new_size > size);
+
+		int *new_data = new int[new_size];
+		std::copy_n(data, size, new_data);
+		std::fill(new_data + size, new_data + new_size, -1);
+
+		delete[] data;
+		data = new_data;
+		size = new_size;
 	}
 };
 
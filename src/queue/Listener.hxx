@@ -38,6 +38,13 @@ public:
 	 * been notified by the player thread.
 	 */
 	virtual void OnQueueSongStarted() = 0;
+
+	/**
+	 * Called before an "unresolved" item (see
+	 * Queue::Item::unresolved) is passed to the player; the
+	 * listener shall load its metadata now.
+	 */
+	virtual void OnQueueResolveSong(unsigned position) = 0;
 };
 
 #endif
@@ -25,6 +25,10 @@
 #include "DetachedSong.hxx"
 #include "Log.hxx"
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 #include <assert.h>
 
 void
@@ -43,6 +47,14 @@ playlist::TagModified(DetachedSong &&song)
 	OnModified();
 }
 
+void
+playlist::ResolveOrder(unsigned order)
+{
+	const unsigned position = queue.OrderToPosition(order);
+	if (queue.IsUnresolvedAtPosition(position))
+		listener.OnQueueResolveSong(position);
+}
+
 inline void
 playlist::QueueSongOrder(PlayerControl &pc, unsigned order)
 
@@ -50,6 +62,7 @@ playlist::QueueSongOrder(PlayerControl &pc, unsigned order)
 	assert(queue.IsValidOrder(order));
 
 	queued = order;
+	ResolveOrder(order);
 
 	const DetachedSong &song = queue.GetOrder(order);
 
@@ -149,6 +162,28 @@ playlist::UpdateQueuedSong(PlayerControl &pc, const DetachedSong *prev)
 		else
 			queued = next_order;
 	}
+
+	if (pc.prefetch_songs > 0)
+		UpdateUpcoming(pc, next_order);
+}
+
+void
+playlist::UpdateUpcoming(PlayerControl &pc, int next_order) const
+{
+	std::vector<std::string> uris;
+
+	for (int order = next_order;
+	     order >= 0 && uris.size() < pc.prefetch_songs;) {
+		const char *uri = queue.GetOrder(order).GetRealURI();
+		if (std::find(uris.begin(), uris.end(), uri) != uris.end())
+			/* wrapped around (repeat mode) */
+			break;
+
+		uris.emplace_back(uri);
+		order = queue.GetNextOrder(order);
+	}
+
+	pc.LockSetUpcoming(std::move(uris));
 }
 
 bool
@@ -157,6 +192,7 @@ playlist::PlayOrder(PlayerControl &pc, unsigned order, Error &error)
 	playing = true;
 	queued = -1;
 
+	ResolveOrder(order);
 	const DetachedSong &song = queue.GetOrder(order);
 
 	FormatDebug(playlist_domain, "play %u:\"%s\"", order, song.GetURI());
@@ -54,11 +54,13 @@ struct playlist {
 	bool stop_on_error;
 
 	/**
-	 * If true, then a bulk edit has been initiated by
+	 * If non-zero, then a bulk edit has been initiated by
 	 * BeginBulk(), and UpdateQueuedSong() and OnModified() will
-	 * be postponed until CommitBulk()
+	 * be postponed until CommitBulk().  This is a counter because
+	 * bulk edits may be nested, e.g. "findadd" within a command
+	 * list; only the outermost CommitBulk() applies the changes.
 	 */
-	bool bulk_edit;
+	unsigned bulk_edit;
 
 	/**
 	 * Has the queue been modified during bulk edit mode?
@@ -94,7 +96,7 @@ struct playlist {
 		:queue(max_length),
 		 listener(_listener),
 		 playing(false),
-		 bulk_edit(false),
+		 bulk_edit(0),
 		 current(-1), queued(-1) {
 	}
 
@@ -105,6 +107,14 @@ struct playlist {
 		return queue.version;
 	}
 
+	/**
+	 * Has the queue been modified in bulk edit mode?  Then
+	 * GetVersion() does not reflect these modifications yet.
+	 */
+	bool IsModificationPending() const {
+		return bulk_edit > 0 && bulk_modified;
+	}
+
 	unsigned GetLength() const {
 		return queue.GetLength();
 	}
@@ -163,6 +173,22 @@ protected:
 	 */
 	void UpdateQueuedSong(PlayerControl &pc, const DetachedSong *prev);
 
+	/**
+	 * Submit the URIs of the songs following the current one to
+	 * the player, so their input streams can be opened in
+	 * advance.  See PlayerControl::prefetch_songs.
+	 *
+	 * @param next_order the order number of the next song or -1
+	 */
+	void UpdateUpcoming(PlayerControl &pc, int next_order) const;
+
+	/**
+	 * If the specified item is "unresolved", ask the
+	 * #QueueListener to load its metadata now, before it is
+	 * passed to the player.
+	 */
+	void ResolveOrder(unsigned order);
+
 	/**
 	 * Queue a song, addressed by its order number.
 	 */
@@ -208,6 +234,15 @@ public:
 	 */
 	unsigned AppendSong(PlayerControl &pc, DetachedSong &&song);
 
+	/**
+	 * Load the metadata of an "unresolved" queue item (see
+	 * Queue::Item::unresolved) and clear the flag.
+	 *
+	 * @return false if the song could not be loaded; the item is
+	 * left unchanged then
+	 */
+	bool ResolveSong(unsigned position, const SongLoader &loader);
+
 	/**
 	 * @return the new song id or 0 on error
 	 */
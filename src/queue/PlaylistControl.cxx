@@ -221,6 +221,7 @@ playlist::SeekSongOrder(PlayerControl &pc, unsigned i, SongTime seek_time,
 
 	queued = -1;
 
+	ResolveOrder(i);
 	if (!pc.LockSeek(new DetachedSong(queue.GetOrder(i)), seek_time, error)) {
 		UpdateQueuedSong(pc, queued_song);
 		return false;
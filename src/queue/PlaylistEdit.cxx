@@ -31,6 +31,7 @@
 #include "util/Error.hxx"
 #include "DetachedSong.hxx"
 #include "SongLoader.hxx"
+#include "playlist/PlaylistSong.hxx"
 
 #include <memory>
 
@@ -64,28 +65,25 @@ playlist::Clear(PlayerControl &pc)
 void
 playlist::BeginBulk()
 {
-	assert(!bulk_edit);
-
-	bulk_edit = true;
-	bulk_modified = false;
+	if (bulk_edit++ == 0)
+		bulk_modified = false;
 }
 
 void
 playlist::CommitBulk(PlayerControl &pc)
 {
-	assert(bulk_edit);
+	assert(bulk_edit > 0);
 
-	bulk_edit = false;
-	if (!bulk_modified)
+	if (--bulk_edit > 0 || !bulk_modified)
 		return;
 
-	if (queued < 0)
-		/* if no song was queued, UpdateQueuedSong() is being
-		   ignored in "bulk" edit mode; now that we have
-		   shuffled all new songs, we can pick a random one
-		   (instead of always picking the first one that was
-		   added) */
-		UpdateQueuedSong(pc, nullptr);
+	/* AppendSong() does not call UpdateQueuedSong() in "bulk"
+	   edit mode; now that we have shuffled all new songs, we can
+	   pick a random one (instead of always picking the first one
+	   that was added), or check whether the appended songs
+	   changed the successor of the queued song (e.g. in "repeat"
+	   mode) */
+	UpdateQueuedSong(pc, GetQueuedSong());
 
 	OnModified();
 }
@@ -99,7 +97,11 @@ playlist::AppendSong(PlayerControl &pc, DetachedSong &&song)
 		throw PlaylistError(PlaylistResult::TOO_LARGE,
 				    "Playlist is too large");
 
-	const DetachedSong *const queued_song = GetQueuedSong();
+	/* in "bulk" edit mode, the queued song is checked only once
+	   by CommitBulk() */
+	const DetachedSong *const queued_song = bulk_edit
+		? nullptr
+		: GetQueuedSong();
 
 	id = queue.Append(std::move(song), 0);
 
@@ -134,6 +136,21 @@ playlist::AppendURI(PlayerControl &pc, const SongLoader &loader,
 	return AppendSong(pc, std::move(*song));
 }
 
+bool
+playlist::ResolveSong(unsigned position, const SongLoader &loader)
+{
+	assert(queue.IsUnresolvedAtPosition(position));
+
+	if (!playlist_check_translate_song(queue.Get(position), nullptr,
+					  loader))
+		return false;
+
+	queue.SetUnresolvedAtPosition(position, false);
+	queue.ModifyAtPosition(position);
+	OnModified();
+	return true;
+}
+
 void
 playlist::SwapPositions(PlayerControl &pc, unsigned song1, unsigned song2)
 {
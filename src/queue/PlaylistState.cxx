@@ -27,7 +27,10 @@
 #include "PlaylistError.hxx"
 #include "Playlist.hxx"
 #include "queue/QueueSave.hxx"
+#include "queue/QueueSnapshot.hxx"
+#include "QueueResolver.hxx"
 #include "fs/io/TextFile.hxx"
+#include "fs/Path.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
 #include "player/Control.hxx"
 #include "config/ConfigGlobal.hxx"
@@ -37,6 +40,8 @@
 #include "util/StringCompare.hxx"
 #include "Log.hxx"
 
+#include <exception>
+
 #include <string.h>
 #include <stdlib.h>
 
@@ -52,6 +57,8 @@
 #define PLAYLIST_STATE_FILE_MIXRAMPDELAY	"mixrampdelay: "
 #define PLAYLIST_STATE_FILE_PLAYLIST_BEGIN	"playlist_begin"
 #define PLAYLIST_STATE_FILE_PLAYLIST_END	"playlist_end"
+#define PLAYLIST_STATE_FILE_PLAYLIST_FILE	"playlist_file"
+#define PLAYLIST_STATE_FILE_PLAYLIST_SNAPSHOT	"playlist_snapshot"
 
 #define PLAYLIST_STATE_FILE_STATE_PLAY		"play"
 #define PLAYLIST_STATE_FILE_STATE_PAUSE		"pause"
@@ -59,7 +66,7 @@
 
 void
 playlist_state_save(BufferedOutputStream &os, const struct playlist &playlist,
-		    PlayerControl &pc)
+		    PlayerControl &pc, bool snapshot)
 {
 	const auto player_status = pc.LockGetStatus();
 
@@ -94,13 +101,23 @@ playlist_state_save(BufferedOutputStream &os, const struct playlist &playlist,
 	os.Format(PLAYLIST_STATE_FILE_MIXRAMPDB "%f\n", pc.GetMixRampDb());
 	os.Format(PLAYLIST_STATE_FILE_MIXRAMPDELAY "%f\n",
 		  pc.GetMixRampDelay());
-	os.Write(PLAYLIST_STATE_FILE_PLAYLIST_BEGIN "\n");
+
+	/* the snapshot must come first, because it replaces the
+	   text file */
+	if (snapshot)
+		os.Write(PLAYLIST_STATE_FILE_PLAYLIST_SNAPSHOT "\n");
+	os.Write(PLAYLIST_STATE_FILE_PLAYLIST_FILE "\n");
+}
+
+void
+playlist_state_save_queue(BufferedOutputStream &os, const playlist &playlist)
+{
 	queue_save(os, playlist.queue);
 	os.Write(PLAYLIST_STATE_FILE_PLAYLIST_END "\n");
 }
 
 static void
-playlist_state_load(TextFile &file, const SongLoader &song_loader,
+playlist_state_load(TextFile &file, QueueResolver &resolver,
 		    struct playlist &playlist)
 {
 	const char *line = file.ReadLine();
@@ -110,7 +127,9 @@ playlist_state_load(TextFile &file, const SongLoader &song_loader,
 	}
 
 	while (!StringStartsWith(line, PLAYLIST_STATE_FILE_PLAYLIST_END)) {
-		queue_load_song(file, song_loader, line, playlist.queue);
+		int id = queue_load_song(file, line, playlist.queue);
+		if (id >= 0)
+			resolver.Add(id);
 
 		line = file.ReadLine();
 		if (line == nullptr) {
@@ -124,12 +143,46 @@ playlist_state_load(TextFile &file, const SongLoader &song_loader,
 	playlist.queue.IncrementVersion();
 }
 
+/**
+ * Load the queue from the file written by
+ * playlist_state_save_queue().
+ */
+static void
+playlist_state_load_file(Path path, QueueResolver &resolver,
+			 struct playlist &playlist)
+try {
+	TextFile file(path);
+	playlist_state_load(file, resolver, playlist);
+} catch (const std::exception &e) {
+	LogError(e);
+}
+
+/**
+ * Load the queue from the file written by queue_snapshot_save().
+ *
+ * @return true on success
+ */
+static bool
+playlist_state_load_snapshot(Path path, struct playlist &playlist)
+try {
+	if (!queue_snapshot_load(path, playlist.queue))
+		return false;
+
+	playlist.queue.IncrementVersion();
+	return true;
+} catch (const std::exception &e) {
+	LogError(e);
+	return false;
+}
+
 bool
-playlist_state_restore(const char *line, TextFile &file,
-		       const SongLoader &song_loader,
+playlist_state_restore(const char *line, TextFile &file, Path queue_path,
+		       Path snapshot_path,
+		       QueueResolver &resolver,
 		       struct playlist &playlist, PlayerControl &pc)
 {
 	int current = -1;
+	bool snapshot_loaded = false;
 	SongTime seek_time = SongTime::zero();
 	bool random_mode = false;
 
@@ -170,7 +223,19 @@ playlist_state_restore(const char *line, TextFile &file,
 			current = atoi(p);
 		} else if (StringStartsWith(line,
 					    PLAYLIST_STATE_FILE_PLAYLIST_BEGIN)) {
-			playlist_state_load(file, song_loader, playlist);
+			playlist_state_load(file, resolver, playlist);
+		} else if (StringIsEqual(line,
+					 PLAYLIST_STATE_FILE_PLAYLIST_SNAPSHOT)) {
+			if (!snapshot_path.IsNull())
+				snapshot_loaded =
+					playlist_state_load_snapshot(snapshot_path,
+								     playlist);
+		} else if (StringIsEqual(line,
+					 PLAYLIST_STATE_FILE_PLAYLIST_FILE)) {
+			if (!snapshot_loaded)
+				playlist_state_load_file(queue_path,
+							 resolver,
+							 playlist);
 		}
 	}
 
@@ -29,15 +29,41 @@ struct playlist;
 struct PlayerControl;
 class TextFile;
 class BufferedOutputStream;
-class SongLoader;
+class QueueResolver;
+class Path;
 
+/**
+ * Save the player state and the playback options.  The queue is not
+ * included; it is saved separately by playlist_state_save_queue(),
+ * and this only writes a reference to it.
+ *
+ * @param snapshot refer to the snapshot written by
+ * queue_snapshot_save() as well
+ */
 void
 playlist_state_save(BufferedOutputStream &os, const playlist &playlist,
-		    PlayerControl &pc);
+		    PlayerControl &pc, bool snapshot=false);
 
+/**
+ * Save the contents of the queue.
+ */
+void
+playlist_state_save_queue(BufferedOutputStream &os, const playlist &playlist);
+
+/**
+ * @param queue_path the file written by playlist_state_save_queue(),
+ * loaded if the state file refers to it; state files written by
+ * older MPD versions contain the queue inline
+ * @param snapshot_path the file written by queue_snapshot_save(); if
+ * the state file refers to it, it is preferred over #queue_path;
+ * may be "nulled" if snapshots are disabled
+ * @param resolver loads the metadata of the restored queue items
+ * later
+ */
 bool
-playlist_state_restore(const char *line, TextFile &file,
-		       const SongLoader &song_loader,
+playlist_state_restore(const char *line, TextFile &file, Path queue_path,
+		       Path snapshot_path,
+		       QueueResolver &resolver,
 		       playlist &playlist, PlayerControl &pc);
 
 /**
@@ -20,12 +20,15 @@
 #include "config.h"
 #include "Queue.hxx"
 #include "DetachedSong.hxx"
+#include "util/MemStats.hxx"
+
+#include <algorithm>
+#include <vector>
 
 Queue::Queue(unsigned _max_length)
-	:max_length(_max_length), length(0),
+	:max_length(_max_length), capacity(0), length(0),
 	 version(1),
-	 items(new Item[max_length]),
-	 order(new unsigned[max_length]),
+	 items(nullptr), order(nullptr),
 	 id_table(max_length * HASH_MULT),
 	 repeat(false),
 	 single(false),
@@ -37,9 +40,39 @@ Queue::Queue(unsigned _max_length)
 Queue::~Queue()
 {
 	Clear();
+}
 
-	delete[] items;
-	delete[] order;
+bool
+Queue::CollectChanges(uint32_t _version, unsigned start, unsigned end,
+		      std::vector<unsigned> &positions) const
+{
+	if (_version > version || !change_log.Covers(_version))
+		return false;
+
+	if (end > length)
+		end = length;
+
+	const size_t old_size = positions.size();
+	change_log.ForEachSince(_version, [&](unsigned position){
+			if (position >= start && position < end)
+				positions.push_back(position);
+		});
+
+	std::sort(positions.begin() + old_size, positions.end());
+	positions.erase(std::unique(positions.begin() + old_size,
+				    positions.end()),
+			positions.end());
+
+	/* double-check with the item versions; this is cheap, and
+	   guarantees the same result as checking all items */
+	positions.erase(std::remove_if(positions.begin() + old_size,
+				       positions.end(),
+				       [this, _version](unsigned position){
+					       return !IsNewerAtPosition(position,
+									 _version);
+				       }),
+			positions.end());
+	return true;
 }
 
 int
@@ -71,6 +104,10 @@ Queue::IncrementVersion()
 			items[i].version = 0;
 
 		version = 1;
+
+		/* all items are "newer" now, which the change log
+		   cannot express */
+		change_log.Disable();
 	}
 }
 
@@ -83,21 +120,65 @@ Queue::ModifyAtOrder(unsigned _order)
 	ModifyAtPosition(position);
 }
 
+/**
+ * The number of bytes allocated for the #items and #order arrays
+ * (for memory accounting).
+ */
+static constexpr size_t
+GetArraySize(unsigned capacity)
+{
+	return capacity * (sizeof(Queue::Item) + sizeof(unsigned));
+}
+
+void
+Queue::Grow()
+{
+	/* the minimum number of elements allocated by the first
+	   Append() */
+	static constexpr unsigned MIN_CAPACITY = 64;
+
+	assert(length == capacity);
+	assert(capacity < max_length);
+
+	const unsigned new_capacity =
+		std::min(std::max(capacity * 2, MIN_CAPACITY), max_length);
+
+	Item *const new_items = new Item[new_capacity];
+	std::copy_n(items, length, new_items);
+	delete[] items;
+	items = new_items;
+
+	unsigned *const new_order = new unsigned[new_capacity];
+	std::copy_n(order, length, new_order);
+	delete[] order;
+	order = new_order;
+
+	MemStatsResize(MemStatsCategory::QUEUE,
+		       GetArraySize(capacity), GetArraySize(new_capacity));
+
+	capacity = new_capacity;
+}
+
 unsigned
 Queue::Append(DetachedSong &&song, uint8_t priority)
 {
 	assert(!IsFull());
 
+	if (length == capacity)
+		Grow();
+
 	const unsigned position = length++;
 	const unsigned id = id_table.Insert(position);
 
 	auto &item = items[position];
 	item.song = new DetachedSong(std::move(song));
+	MemStatsAllocate(MemStatsCategory::QUEUE, sizeof(DetachedSong));
 	item.id = id;
-	item.version = version;
 	item.priority = priority;
+	item.unresolved = false;
+	ModifyAtPosition(position);
 
-	order[position] = position;
+	SetOrder(position, position);
 
 	return id;
 }
@@ -110,89 +191,57 @@ Queue::SwapPositions(unsigned position1, unsigned position2)
 
 	std::swap(items[position1], items[position2]);
 
-	items[position1].version = version;
-	items[position2].version = version;
+	/* the order numbers stay with the positions, not with the
+	   songs */
+	std::swap(items[position1].order, items[position2].order);
+
+	ModifyAtPosition(position1);
+	ModifyAtPosition(position2);
 
 	id_table.Move(id1, position2);
 	id_table.Move(id2, position1);
 }
 
 void
-Queue::MovePostion(unsigned from, unsigned to)
+Queue::RotateItems(unsigned start, unsigned middle, unsigned end)
 {
-	const Item tmp = items[from];
-
-	/* move songs to one less in from->to */
-
-	for (unsigned i = from; i < to; i++)
-		MoveItemTo(i + 1, i);
-
-	/* move songs to one more in to->from */
-
-	for (unsigned i = from; i > to; i--)
-		MoveItemTo(i - 1, i);
-
-	/* put song at _to_ */
+	assert(start <= middle);
+	assert(middle <= end);
+	assert(end <= length);
 
-	id_table.Move(tmp.id, to);
-	items[to] = tmp;
-	items[to].version = version;
+	std::rotate(items + start, items + middle, items + end);
 
-	/* now deal with order */
+	/* one pass over the affected range to update the versions,
+	   the id table and the order array */
+	for (unsigned i = start; i < end; ++i) {
+		ModifyAtPosition(i);
+		id_table.Move(items[i].id, i);
 
-	if (random) {
-		for (unsigned i = 0; i < length; i++) {
-			if (order[i] > from && order[i] <= to)
-				order[i]--;
-			else if (order[i] < from &&
-				 order[i] >= to)
-				order[i]++;
-			else if (from == order[i])
-				order[i] = to;
-		}
+		if (random)
+			order[items[i].order] = i;
+		else
+			SetOrder(i, i);
 	}
 }
 
 void
-Queue::MoveRange(unsigned start, unsigned end, unsigned to)
+Queue::MovePostion(unsigned from, unsigned to)
 {
-	Item tmp[end - start];
-	// Copy the original block [start,end-1]
-	for (unsigned i = start; i < end; i++)
-		tmp[i - start] = items[i];
-
-	// If to > start, we need to move to-start items to start, starting from end
-	for (unsigned i = end; i < end + to - start; i++)
-		MoveItemTo(i, start + i - end);
-
-	// If to < start, we need to move start-to items to newend (= end + to - start), starting from to
-	// This is the same as moving items from start-1 to to (decreasing), with start-1 going to end-1
-	// We have to iterate in this order to avoid writing over something we haven't yet moved
-	for (int i = start - 1; i >= int(to); i--)
-		MoveItemTo(i, i + end - start);
-
-	// Copy the original block back in, starting at to.
-	for (unsigned i = start; i< end; i++)
-	{
-		id_table.Move(tmp[i - start].id, to + i - start);
-		items[to + i - start] = tmp[i-start];
-		items[to + i - start].version = version;
-	}
+	if (from < to)
+		RotateItems(from, from + 1, to + 1);
+	else
+		RotateItems(to, from, from + 1);
+}
 
-	if (random) {
-		// Update the positions in the queue.
-		// Note that the ranges for these cases are the same as the ranges of
-		// the loops above.
-		for (unsigned i = 0; i < length; i++) {
-			if (order[i] >= end && order[i] < to + end - start)
-				order[i] -= end - start;
-			else if (order[i] < start &&
-				 order[i] >= to)
-				order[i] += end - start;
-			else if (start <= order[i] && order[i] < end)
-				order[i] += to - start;
-		}
-	}
+void
+Queue::MoveRange(unsigned start, unsigned end, unsigned to)
+{
+	if (to > start)
+		/* the items after the block move to the front */
+		RotateItems(start, end, end + to - start);
+	else
+		/* the items before the block move to the back */
+		RotateItems(to, start, end);
 }
 
 void
@@ -212,6 +261,9 @@ Queue::MoveOrder(unsigned from_order, unsigned to_order)
 	}
 
 	order[to_order] = from_position;
+
+	UpdateItemOrders(std::min(from_order, to_order),
+			 std::max(from_order, to_order) + 1);
 }
 
 void
@@ -220,6 +272,7 @@ Queue::DeletePosition(unsigned position)
 	assert(position < length);
 
 	delete items[position].song;
+	MemStatsFree(MemStatsCategory::QUEUE, sizeof(DetachedSong));
 
 	const unsigned id = PositionToId(position);
 	const unsigned _order = PositionToOrder(position);
@@ -230,21 +283,23 @@ Queue::DeletePosition(unsigned position)
 
 	id_table.Erase(id);
 
+	/* delete the entry from the order array; the following
+	   items move to the previous order number */
+
+	for (unsigned i = _order; i < length; i++)
+		order[i] = order[i + 1];
+
+	UpdateItemOrders(_order, length);
+
 	/* delete song from songs array */
 
 	for (unsigned i = position; i < length; i++)
 		MoveItemTo(i + 1, i);
 
-	/* delete the entry from the order array */
+	/* readjust the positions of the moved items in the order
+	   array */
 
-	for (unsigned i = _order; i < length; i++)
-		order[i] = order[i + 1];
-
-	/* readjust values in the order array */
-
-	for (unsigned i = 0; i < length; i++)
-		if (order[i] > position)
-			--order[i];
+	UpdateMovedOrders(position, length);
 }
 
 void
@@ -254,11 +309,22 @@ Queue::Clear()
 		Item *item = &items[i];
 
 		delete item->song;
+		MemStatsFree(MemStatsCategory::QUEUE, sizeof(DetachedSong));
 
 		id_table.Erase(item->id);
 	}
 
 	length = 0;
+	change_log.Reset();
+
+	/* give the memory back; a huge queue may have been
+	   replaced by a small one */
+	MemStatsResize(MemStatsCategory::QUEUE, GetArraySize(capacity), 0);
+	delete[] items;
+	items = nullptr;
+	delete[] order;
+	order = nullptr;
+	capacity = 0;
 }
 
 static void
@@ -277,6 +343,9 @@ queue_sort_order_by_priority(Queue *queue, unsigned start, unsigned end)
 	};
 
 	std::stable_sort(queue->order + start, queue->order + end, cmp);
+
+	/* Item::order is updated by ShuffleOrderRange(), which is
+	   called for every priority group afterwards */
 }
 
 void
@@ -288,6 +357,7 @@ Queue::ShuffleOrderRange(unsigned start, unsigned end)
 
 	rand.AutoCreate();
 	std::shuffle(order + start, order + end, rand);
+	UpdateItemOrders(start, end);
 }
 
 /**
@@ -358,13 +428,24 @@ Queue::ShuffleRange(unsigned start, unsigned end)
 	assert(start <= end);
 	assert(end <= length);
 
+	if (start == end)
+		return;
+
 	rand.AutoCreate();
 
-	for (unsigned i = start; i < end; i++) {
-		std::uniform_int_distribution<unsigned> distribution(start,
-								     end - 1);
-		unsigned ri = distribution(rand);
-		SwapPositions(i, ri);
+	/* Fisher-Yates shuffle; the order numbers stay with the
+	   positions (like in SwapPositions()), so the order array
+	   remains valid */
+	for (unsigned i = end - 1; i > start; --i) {
+		std::uniform_int_distribution<unsigned> distribution(start, i);
+		const unsigned j = distribution(rand);
+		std::swap(items[i], items[j]);
+		std::swap(items[i].order, items[j].order);
+	}
+
+	for (unsigned i = start; i < end; ++i) {
+		ModifyAtPosition(i);
+		id_table.Move(items[i].id, i);
 	}
 }
 
@@ -401,6 +482,32 @@ Queue::CountSamePriority(unsigned start_order, uint8_t priority) const
 	return length - start_order;
 }
 
+bool
+Queue::MustReorder(unsigned _order, uint8_t old_priority, uint8_t priority,
+		   int after_order) const
+{
+	if (after_order < 0)
+		return true;
+
+	if (_order == (unsigned)after_order)
+		/* don't reorder the current song */
+		return false;
+
+	if (_order < (unsigned)after_order) {
+		/* the specified song has been played already -
+		   enqueue it only if its priority has just become
+		   bigger than the current one's */
+
+		const uint8_t after_priority = GetOrderPriority(after_order);
+		if (old_priority > after_priority ||
+		    priority <= after_priority)
+			/* priority hasn't become bigger */
+			return false;
+	}
+
+	return true;
+}
+
 bool
 Queue::SetPriority(unsigned position, uint8_t priority, int after_order,
 		   bool reorder)
@@ -412,34 +519,16 @@ Queue::SetPriority(unsigned position, uint8_t priority, int after_order,
 	if (old_priority == priority)
 		return false;
 
-	item->version = version;
 	item->priority = priority;
+	ModifyAtPosition(position);
 
 	if (!random || !reorder)
 		/* don't reorder if not in random mode */
 		return true;
 
-	unsigned _order = PositionToOrder(position);
-	if (after_order >= 0) {
-		if (_order == (unsigned)after_order)
-			/* don't reorder the current song */
-			return true;
-
-		if (_order < (unsigned)after_order) {
-			/* the specified song has been played already
-			   - enqueue it only if its priority has just
-			   become bigger than the current one's */
-
-			const unsigned after_position =
-				OrderToPosition(after_order);
-			const Item *after_item =
-				&items[after_position];
-			if (old_priority > after_item->priority ||
-			    priority <= after_item->priority)
-				/* priority hasn't become bigger */
-				return true;
-		}
-	}
+	const unsigned _order = PositionToOrder(position);
+	if (!MustReorder(_order, old_priority, priority, after_order))
+		return true;
 
 	/* move the item to the beginning of the priority group (or
 	   create a new priority group) */
@@ -467,17 +556,70 @@ Queue::SetPriorityRange(unsigned start_position, unsigned end_position,
 	assert(start_position <= end_position);
 	assert(end_position <= length);
 
+	/* first apply the new priority, and collect the items which
+	   need to be moved in the "order" list */
+
+	std::vector<unsigned> reorder;
+	unsigned n_before_after = 0;
 	bool modified = false;
-	int after_position = after_order >= 0
-		? (int)OrderToPosition(after_order)
-		: -1;
-	for (unsigned i = start_position; i < end_position; ++i) {
-		after_order = after_position >= 0
-			? (int)PositionToOrder(after_position)
-			: -1;
 
-		modified |= SetPriority(i, priority, after_order);
+	for (unsigned i = start_position; i < end_position; ++i) {
+		Item &item = items[i];
+		const uint8_t old_priority = item.priority;
+		if (old_priority == priority)
+			continue;
+
+		item.priority = priority;
+		ModifyAtPosition(i);
+		modified = true;
+
+		if (!random)
+			continue;
+
+		const unsigned _order = item.order;
+		if (MustReorder(_order, old_priority, priority, after_order)) {
+			reorder.push_back(i);
+			if (after_order >= 0 && _order < (unsigned)after_order)
+				++n_before_after;
+		}
 	}
 
+	if (reorder.empty())
+		return modified;
+
+	/* remove these items from the "order" list */
+
+	for (unsigned position : reorder)
+		order[items[position].order] = length;
+
+	const unsigned n_remaining = std::remove(order, order + length, length)
+		- order;
+	assert(n_remaining + reorder.size() == length);
+
+	if (after_order >= 0)
+		after_order -= n_before_after;
+
+	/* insert them at the beginning of the priority group (or
+	   create a new priority group) after the current song */
+
+	unsigned before_order = after_order + 1;
+	while (before_order < n_remaining &&
+	       items[order[before_order]].priority > priority)
+		++before_order;
+
+	std::copy_backward(order + before_order, order + n_remaining,
+			   order + length);
+	std::copy(reorder.begin(), reorder.end(), order + before_order);
+
+	/* shuffle the songs within that priority group */
+
+	unsigned group_end = before_order + reorder.size();
+	while (group_end < length &&
+	       items[order[group_end]].priority == priority)
+		++group_end;
+
+	UpdateItemOrders(0, length);
+	ShuffleOrderRange(before_order, group_end);
+
 	return modified;
 }
@@ -22,9 +22,11 @@
 
 #include "Compiler.h"
 #include "IdTable.hxx"
+#include "ChangeLog.hxx"
 #include "util/LazyRandomEngine.hxx"
 
 #include <algorithm>
+#include <vector>
 
 #include <assert.h>
 #include <stdint.h>
@@ -67,11 +69,31 @@ struct Queue {
 		 * "random" mode.
 		 */
 		uint8_t priority;
+
+		/**
+		 * Was this item restored from the state file without
+		 * loading its metadata?  See #QueueResolver.
+		 */
+		bool unresolved;
+
+		/**
+		 * The order number of this item, i.e. the inverse
+		 * of Queue::order.  This allows PositionToOrder()
+		 * without a linear search.
+		 */
+		unsigned order;
 	};
 
 	/** configured maximum length of the queue */
 	unsigned max_length;
 
+	/**
+	 * The number of elements allocated in #items and #order.
+	 * This grows on demand (up to #max_length), and is reset by
+	 * Clear().
+	 */
+	unsigned capacity;
+
 	/** number of songs in the queue */
 	unsigned length;
 
@@ -81,12 +103,18 @@ struct Queue {
 	/** all songs in "position" order */
 	Item *items;
 
-	/** map order numbers to positions */
+	/**
+	 * Map order numbers to positions.  Item::order is the inverse
+	 * mapping; both are updated together.
+	 */
 	unsigned *order;
 
 	/** map song ids to positions */
 	IdTable id_table;
 
+	/** the recently modified positions, for CollectChanges() */
+	QueueChangeLog change_log;
+
 	/** repeat playback when the end of the queue has been
 	    reached? */
 	bool repeat;
@@ -171,13 +199,9 @@ struct Queue {
 	gcc_pure
 	unsigned PositionToOrder(unsigned position) const {
 		assert(position < length);
+		assert(order[items[position].order] == position);
 
-		for (unsigned i = 0;; ++i) {
-			assert(i < length);
-
-			if (order[i] == position)
-				return i;
-		}
+		return items[position].order;
 	}
 
 	gcc_pure
@@ -187,6 +211,18 @@ struct Queue {
 		return items[position].priority;
 	}
 
+	bool IsUnresolvedAtPosition(unsigned position) const {
+		assert(position < length);
+
+		return items[position].unresolved;
+	}
+
+	void SetUnresolvedAtPosition(unsigned position, bool value) {
+		assert(position < length);
+
+		items[position].unresolved = value;
+	}
+
 	const Item &GetOrderItem(unsigned i) const {
 		assert(IsValidOrder(i));
 
@@ -225,6 +261,18 @@ struct Queue {
 			items[position].version == 0;
 	}
 
+	/**
+	 * Determine the positions in the specified range which are
+	 * newer than the specified version (see IsNewerAtPosition())
+	 * from the change log, without looking at all items.
+	 *
+	 * @param positions the sorted positions are appended here
+	 * @return false if the change log does not reach back to that
+	 * version; the caller must check all items then
+	 */
+	bool CollectChanges(uint32_t version, unsigned start, unsigned end,
+			    std::vector<unsigned> &positions) const;
+
 	/**
 	 * Returns the order number following the specified one.  This takes
 	 * end of queue and "repeat" mode into account.
@@ -249,6 +297,7 @@ struct Queue {
 		assert(position < length);
 
 		items[position].version = version;
+		change_log.Add(version, position);
 	}
 
 	/**
@@ -280,6 +329,8 @@ struct Queue {
 	 */
 	void SwapOrders(unsigned order1, unsigned order2) {
 		std::swap(order[order1], order[order2]);
+		items[order[order1]].order = order1;
+		items[order[order2]].order = order2;
 	}
 
 	/**
@@ -307,7 +358,7 @@ struct Queue {
 	 */
 	void RestoreOrder() {
 		for (unsigned i = 0; i < length; ++i)
-			order[i] = i;
+			SetOrder(i, i);
 	}
 
 	/**
@@ -350,19 +401,72 @@ struct Queue {
 			      uint8_t priority, int after_order);
 
 private:
+	void SetOrder(unsigned _order, unsigned position) {
+		order[_order] = position;
+		items[position].order = _order;
+	}
+
+	/**
+	 * Update Item::order after the "order" array has been
+	 * modified in the specified (order) range.
+	 */
+	void UpdateItemOrders(unsigned start_order, unsigned end_order) {
+		for (unsigned i = start_order; i < end_order; ++i)
+			items[order[i]].order = i;
+	}
+
+	/**
+	 * Update the "order" array after the items in the specified
+	 * (position) range have been moved.  In random mode, the
+	 * items keep their order numbers; else the order equals the
+	 * position.
+	 */
+	void UpdateMovedOrders(unsigned start, unsigned end) {
+		for (unsigned i = start; i < end; ++i) {
+			if (random)
+				order[items[i].order] = i;
+			else
+				SetOrder(i, i);
+		}
+	}
+
+	/**
+	 * Enlarge #items and #order.  Called by Append() when they
+	 * are full.
+	 */
+	void Grow();
+
 	/**
 	 * Moves a song to a new position in the "order" list.
 	 */
 	void MoveOrder(unsigned from_order, unsigned to_order);
 
+	/**
+	 * Rotate the items in the range [start, end), so the item at
+	 * "middle" becomes the first one, and update the id table,
+	 * the versions and the order array in one pass.
+	 */
+	void RotateItems(unsigned start, unsigned middle, unsigned end);
+
 	void MoveItemTo(unsigned from, unsigned to) {
 		unsigned from_id = items[from].id;
 
 		items[to] = items[from];
-		items[to].version = version;
+		ModifyAtPosition(to);
 		id_table.Move(from_id, to);
 	}
 
+	/**
+	 * Does the item at the specified order number need to be
+	 * moved after its priority has been changed?
+	 *
+	 * @param after_order the order number of the current song,
+	 * or -1 if there is none
+	 */
+	gcc_pure
+	bool MustReorder(unsigned order, uint8_t old_priority,
+			 uint8_t priority, int after_order) const;
+
 	/**
 	 * Find the first item that has this specified priority or
 	 * higher.
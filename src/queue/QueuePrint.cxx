@@ -23,6 +23,9 @@
 #include "SongFilter.hxx"
 #include "SongPrint.hxx"
 #include "client/Response.hxx"
+#include "util/StringBuilder.hxx"
+
+#include <vector>
 
 /**
  * Send detailed information about a range of songs in the queue to a
@@ -36,13 +39,30 @@ static void
 queue_print_song_info(Response &r, Partition &partition, const Queue &queue,
 		      unsigned position)
 {
+	if (song_print_is_tabular(r)) {
+		const SongQueueInfo info{
+			position,
+			unsigned(queue.PositionToId(position)),
+			queue.GetPriorityAtPosition(position),
+		};
+
+		song_print_row(r, partition, queue.Get(position), false, &info);
+		return;
+	}
+
 	song_print_info(r, partition, queue.Get(position));
-	r.Format("Pos: %u\nId: %u\n",
-		 position, queue.PositionToId(position));
+
+	char buffer[64];
+	StringBuilder b(buffer);
+	b.Append("Pos: ").AppendUnsigned(position)
+		.Append("\nId: ").AppendUnsigned(queue.PositionToId(position))
+		.Append('\n');
 
 	uint8_t priority = queue.GetPriorityAtPosition(position);
 	if (priority != 0)
-		r.Format("Prio: %u\n", priority);
+		b.Append("Prio: ").AppendUnsigned(priority).Append('\n');
+
+	r.Write(b);
 }
 
 void
@@ -82,6 +102,13 @@ queue_print_changes_info(Response &r, Partition &partition, const Queue &queue,
 	if (end > queue.GetLength())
 		end = queue.GetLength();
 
+	std::vector<unsigned> positions;
+	if (queue.CollectChanges(version, start, end, positions)) {
+		for (unsigned i : positions)
+			queue_print_song_info(r, partition, queue, i);
+		return;
+	}
+
 	for (unsigned i = start; i < end; i++)
 		if (queue.IsNewerAtPosition(i, version))
 			queue_print_song_info(r, partition, queue, i);
@@ -100,6 +127,14 @@ queue_print_changes_position(Response &r, const Queue &queue,
 	if (end > queue.GetLength())
 		end = queue.GetLength();
 
+	std::vector<unsigned> positions;
+	if (queue.CollectChanges(version, start, end, positions)) {
+		for (unsigned i : positions)
+			r.Format("cpos: %i\nId: %i\n",
+				 i, queue.PositionToId(i));
+		return;
+	}
+
 	for (unsigned i = start; i < end; i++)
 		if (queue.IsNewerAtPosition(i, version))
 			r.Format("cpos: %i\nId: %i\n",
@@ -23,7 +23,6 @@
 #include "PlaylistError.hxx"
 #include "DetachedSong.hxx"
 #include "SongSave.hxx"
-#include "playlist/PlaylistSong.hxx"
 #include "fs/io/TextFile.hxx"
 #include "fs/io/BufferedOutputStream.hxx"
 #include "util/StringCompare.hxx"
@@ -73,12 +72,11 @@ queue_save(BufferedOutputStream &os, const Queue &queue)
 	}
 }
 
-void
-queue_load_song(TextFile &file, const SongLoader &loader,
-		const char *line, Queue &queue)
+int
+queue_load_song(TextFile &file, const char *line, Queue &queue)
 {
 	if (queue.IsFull())
-		return;
+		return -1;
 
 	uint8_t priority = 0;
 	const char *p;
@@ -87,7 +85,7 @@ queue_load_song(TextFile &file, const SongLoader &loader,
 
 		line = file.ReadLine();
 		if (line == nullptr)
-			return;
+			return -1;
 	}
 
 	DetachedSong *song;
@@ -99,7 +97,7 @@ queue_load_song(TextFile &file, const SongLoader &loader,
 		song = song_load(file, uri, error);
 		if (song == nullptr) {
 			LogError(error);
-			return;
+			return -1;
 		}
 	} else {
 		char *endptr;
@@ -107,7 +105,7 @@ queue_load_song(TextFile &file, const SongLoader &loader,
 		if (ret < 0 || *endptr != ':' || endptr[1] == 0) {
 			LogError(playlist_domain,
 				 "Malformed playlist line in state file");
-			return;
+			return -1;
 		}
 
 		const char *uri = endptr + 1;
@@ -115,11 +113,9 @@ queue_load_song(TextFile &file, const SongLoader &loader,
 		song = new DetachedSong(uri);
 	}
 
-	if (!playlist_check_translate_song(*song, nullptr, loader)) {
-		delete song;
-		return;
-	}
-
-	queue.Append(std::move(*song), priority);
+	const unsigned id = queue.Append(std::move(*song), priority);
 	delete song;
+
+	queue.SetUnresolvedAtPosition(queue.IdToPosition(id), true);
+	return id;
 }
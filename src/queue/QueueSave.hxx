@@ -28,16 +28,19 @@
 struct Queue;
 class BufferedOutputStream;
 class TextFile;
-class SongLoader;
 
 void
 queue_save(BufferedOutputStream &os, const Queue &queue);
 
 /**
  * Loads one song from the state file and appends it to the queue.
+ * Only the URI and the saved tags are restored; the new item is
+ * marked "unresolved", and the caller is responsible for loading
+ * its metadata later (see #QueueResolver).
+ *
+ * @return the id of the new queue item or -1 if no item was added
  */
-void
-queue_load_song(TextFile &file, const SongLoader &loader,
-		const char *line, Queue &queue);
+int
+queue_load_song(TextFile &file, const char *line, Queue &queue);
 
 #endif
@@ -0,0 +1,378 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "QueueSnapshot.hxx"
+#include "Queue.hxx"
+#include "DetachedSong.hxx"
+#include "fs/Path.hxx"
+#include "fs/io/MappedFile.hxx"
+#include "fs/io/BufferedOutputStream.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagBuilder.hxx"
+#include "util/Domain.hxx"
+#include "Log.hxx"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * The file consists of a #QueueSnapshotHeader followed by sections
+ * of fixed size records, each aligned to 8 bytes, just like the
+ * binary database format.  Records refer to strings by their offset
+ * in the string data.  All numbers are in host byte order.
+ */
+
+static constexpr Domain queue_snapshot_domain("queue_snapshot");
+
+static constexpr char QUEUE_SNAPSHOT_MAGIC[8] = "MPDQSNP";
+static constexpr uint32_t QUEUE_SNAPSHOT_VERSION = 1;
+static constexpr uint32_t QUEUE_SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+/**
+ * A string offset which means "no string".
+ */
+static constexpr uint32_t QUEUE_SNAPSHOT_NO_STRING = ~uint32_t(0);
+
+struct QueueSnapshotSection {
+	uint64_t offset;
+	uint64_t count;
+};
+
+struct QueueSnapshotHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+
+	/**
+	 * Null-terminated strings; #count is the size in bytes.
+	 */
+	QueueSnapshotSection string_data;
+
+	/**
+	 * #QueueSnapshotSong records in queue order.
+	 */
+	QueueSnapshotSection songs;
+
+	/**
+	 * #QueueSnapshotItem records, grouped by song.
+	 */
+	QueueSnapshotSection items;
+};
+
+struct QueueSnapshotSong {
+	uint32_t uri, real_uri;
+	uint32_t first_item, n_items;
+
+	/**
+	 * The duration in milliseconds; negative if unknown.
+	 */
+	int32_t duration_ms;
+
+	uint32_t start_ms, end_ms;
+	uint32_t mixramp_start, mixramp_end;
+	uint8_t priority;
+	uint8_t has_playlist;
+	uint16_t reserved;
+	int64_t mtime;
+};
+
+struct QueueSnapshotItem {
+	uint32_t type;
+	uint32_t value;
+};
+
+static constexpr size_t
+AlignSection(size_t size)
+{
+	return (size + 7) & ~size_t(7);
+}
+
+static uint32_t
+AddString(std::string &string_data, const char *s)
+{
+	const size_t offset = string_data.size();
+	if (offset >= QUEUE_SNAPSHOT_NO_STRING)
+		throw std::runtime_error("Queue too large");
+
+	string_data.append(s);
+	string_data.push_back(0);
+	return offset;
+}
+
+static uint32_t
+AddOptionalString(std::string &string_data, const char *s)
+{
+	return s != nullptr
+		? AddString(string_data, s)
+		: QUEUE_SNAPSHOT_NO_STRING;
+}
+
+template<typename T>
+static void
+WriteSection(BufferedOutputStream &os, const T *p, size_t count)
+{
+	static constexpr uint8_t padding[8] = {};
+
+	const size_t size = count * sizeof(T);
+	if (size > 0)
+		os.Write(p, size);
+	os.Write(padding, AlignSection(size) - size);
+}
+
+void
+queue_snapshot_save(BufferedOutputStream &os, const Queue &queue)
+{
+	std::string string_data;
+	std::vector<QueueSnapshotSong> songs;
+	std::vector<QueueSnapshotItem> items;
+
+	songs.reserve(queue.GetLength());
+
+	for (unsigned i = 0; i < queue.GetLength(); ++i) {
+		const DetachedSong &song = queue.Get(i);
+		const Tag &tag = song.GetTag();
+
+		QueueSnapshotSong s;
+		memset(&s, 0, sizeof(s));
+		s.uri = AddString(string_data, song.GetURI());
+		s.real_uri = song.HasRealURI()
+			? AddString(string_data, song.GetRealURI())
+			: QUEUE_SNAPSHOT_NO_STRING;
+		s.first_item = items.size();
+		s.n_items = tag.num_items;
+		s.duration_ms = tag.duration.IsNegative()
+			? -1
+			: int32_t(tag.duration.ToMS());
+		s.start_ms = song.GetStartTime().ToMS();
+		s.end_ms = song.GetEndTime().ToMS();
+		s.mixramp_start = AddOptionalString(string_data,
+						    song.GetMixRamp().GetStart());
+		s.mixramp_end = AddOptionalString(string_data,
+						  song.GetMixRamp().GetEnd());
+		s.priority = queue.GetPriorityAtPosition(i);
+		s.has_playlist = tag.has_playlist;
+		s.mtime = song.GetLastModified();
+
+		for (const auto &item : tag)
+			items.push_back({uint32_t(item.type),
+					 AddString(string_data, item.value)});
+
+		songs.push_back(s);
+	}
+
+	QueueSnapshotHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, QUEUE_SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = QUEUE_SNAPSHOT_VERSION;
+	header.byte_order = QUEUE_SNAPSHOT_BYTE_ORDER;
+
+	uint64_t offset = AlignSection(sizeof(header));
+	auto add = [&offset](QueueSnapshotSection &section,
+			     size_t count, size_t record_size){
+		section.offset = offset;
+		section.count = count;
+		offset += AlignSection(count * record_size);
+	};
+
+	add(header.string_data, string_data.size(), 1);
+	add(header.songs, songs.size(), sizeof(QueueSnapshotSong));
+	add(header.items, items.size(), sizeof(QueueSnapshotItem));
+
+	WriteSection(os, &header, 1);
+	WriteSection(os, string_data.data(), string_data.size());
+	WriteSection(os, songs.data(), songs.size());
+	WriteSection(os, items.data(), items.size());
+}
+
+namespace {
+
+class QueueSnapshotLoader {
+	const uint8_t *const data;
+	const size_t size;
+
+	const QueueSnapshotHeader &header;
+
+	const char *string_data;
+	const QueueSnapshotSong *songs;
+	const QueueSnapshotItem *items;
+
+public:
+	QueueSnapshotLoader(const uint8_t *_data, size_t _size)
+		:data(_data), size(_size),
+		 header(*(const QueueSnapshotHeader *)data) {}
+
+	bool CheckHeader();
+
+	bool Load(Queue &queue) const;
+
+private:
+	template<typename T>
+	bool CheckSection(const QueueSnapshotSection &section,
+			  const T *&p) const {
+		if (section.offset % 8 != 0 || section.offset > size ||
+		    section.count > (size - section.offset) / sizeof(T))
+			return false;
+
+		p = (const T *)(data + section.offset);
+		return true;
+	}
+
+	gcc_pure
+	const char *GetString(uint32_t offset) const {
+		return offset < header.string_data.count
+			? string_data + offset
+			: nullptr;
+	}
+
+	bool GetOptionalString(uint32_t offset, const char *&value) const {
+		if (offset == QUEUE_SNAPSHOT_NO_STRING) {
+			value = nullptr;
+			return true;
+		}
+
+		value = GetString(offset);
+		return value != nullptr;
+	}
+
+	bool LoadSong(const QueueSnapshotSong &s, DetachedSong &song) const;
+};
+
+bool
+QueueSnapshotLoader::CheckHeader()
+{
+	if (memcmp(header.magic, QUEUE_SNAPSHOT_MAGIC,
+		   sizeof(header.magic)) != 0 ||
+	    header.version != QUEUE_SNAPSHOT_VERSION ||
+	    header.byte_order != QUEUE_SNAPSHOT_BYTE_ORDER) {
+		LogWarning(queue_snapshot_domain,
+			   "Snapshot format mismatch, discarding it");
+		return false;
+	}
+
+	/* with a null terminator at the end of the string data, all
+	   strings are properly terminated */
+	if (!CheckSection(header.string_data, string_data) ||
+	    !CheckSection(header.songs, songs) ||
+	    !CheckSection(header.items, items) ||
+	    (header.string_data.count > 0 &&
+	     string_data[header.string_data.count - 1] != 0)) {
+		LogWarning(queue_snapshot_domain,
+			   "Snapshot corrupted, discarding it");
+		return false;
+	}
+
+	return true;
+}
+
+inline bool
+QueueSnapshotLoader::LoadSong(const QueueSnapshotSong &s,
+			      DetachedSong &song) const
+{
+	const char *uri = GetString(s.uri);
+	const char *real_uri, *mixramp_start, *mixramp_end;
+	if (uri == nullptr || *uri == 0 ||
+	    !GetOptionalString(s.real_uri, real_uri) ||
+	    !GetOptionalString(s.mixramp_start, mixramp_start) ||
+	    !GetOptionalString(s.mixramp_end, mixramp_end) ||
+	    s.first_item > header.items.count ||
+	    s.n_items > header.items.count - s.first_item)
+		return false;
+
+	TagBuilder tag;
+	tag.Reserve(s.n_items);
+
+	for (uint32_t i = 0; i < s.n_items; ++i) {
+		const QueueSnapshotItem &item = items[s.first_item + i];
+		const char *value = GetString(item.value);
+		if (value == nullptr || item.type >= TAG_NUM_OF_ITEM_TYPES)
+			return false;
+
+		/* TagBuilder ignores types which have been disabled
+		   in the meantime */
+		tag.AddItem(TagType(item.type), value);
+	}
+
+	if (s.duration_ms >= 0)
+		tag.SetDuration(SignedSongTime::FromMS(s.duration_ms));
+	tag.SetHasPlaylist(s.has_playlist != 0);
+
+	song.SetURI(uri);
+	if (real_uri != nullptr)
+		song.SetRealURI(real_uri);
+	song.SetTag(tag.Commit());
+	song.SetLastModified(s.mtime);
+	song.SetStartTime(SongTime::FromMS(s.start_ms));
+	song.SetEndTime(SongTime::FromMS(s.end_ms));
+
+	MixRampInfo mix_ramp;
+	if (mixramp_start != nullptr)
+		mix_ramp.SetStart(mixramp_start);
+	if (mixramp_end != nullptr)
+		mix_ramp.SetEnd(mixramp_end);
+	song.SetMixRamp(std::move(mix_ramp));
+	return true;
+}
+
+bool
+QueueSnapshotLoader::Load(Queue &queue) const
+{
+	/* load all songs before touching the queue, so a corrupt
+	   snapshot doesn't leave a partial queue behind */
+	std::vector<DetachedSong> list;
+	list.reserve(header.songs.count);
+
+	for (uint64_t i = 0; i < header.songs.count; ++i) {
+		list.emplace_back("");
+		if (!LoadSong(songs[i], list.back())) {
+			LogWarning(queue_snapshot_domain,
+				   "Snapshot corrupted, discarding it");
+			return false;
+		}
+	}
+
+	for (uint64_t i = 0; i < header.songs.count; ++i) {
+		if (queue.IsFull())
+			break;
+
+		queue.Append(std::move(list[i]), songs[i].priority);
+	}
+
+	return true;
+}
+
+}
+
+bool
+queue_snapshot_load(Path path, Queue &queue)
+{
+	const MappedFile file(path, true);
+	if (file.GetSize() < sizeof(QueueSnapshotHeader)) {
+		LogWarning(queue_snapshot_domain,
+			   "Snapshot corrupted, discarding it");
+		return false;
+	}
+
+	QueueSnapshotLoader loader(file.GetData(), file.GetSize());
+	return loader.CheckHeader() && loader.Load(queue);
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * A binary image of the queue, including the metadata of all songs.
+ * It is mapped into memory on startup and restores the queue
+ * without consulting the database, which may still be loading.
+ */
+
+#ifndef MPD_QUEUE_SNAPSHOT_HXX
+#define MPD_QUEUE_SNAPSHOT_HXX
+
+struct Queue;
+class BufferedOutputStream;
+class Path;
+
+/**
+ * Throws std::runtime_error on error.
+ */
+void
+queue_snapshot_save(BufferedOutputStream &os, const Queue &queue);
+
+/**
+ * Appends all songs from the snapshot file to the queue.
+ *
+ * Throws std::runtime_error on I/O error.
+ *
+ * @return false if the file is malformed or was written by an
+ * incompatible MPD version (nothing has been appended then)
+ */
+bool
+queue_snapshot_load(Path path, Queue &queue);
+
+#endif
@@ -26,11 +26,14 @@
 #include "util/Error.hxx"
 #include "util/Macros.hxx"
 #include "util/StringCompare.hxx"
+#include "Log.hxx"
 
 #include <string>
 #include <map>
+#include <unordered_map>
 
 #include <assert.h>
+#include <string.h>
 
 struct Sticker {
 	std::map<std::string, std::string> table;
@@ -47,6 +50,9 @@ enum sticker_sql {
 	STICKER_SQL_FIND_VALUE,
 	STICKER_SQL_FIND_LT,
 	STICKER_SQL_FIND_GT,
+	STICKER_SQL_BEGIN,
+	STICKER_SQL_COMMIT,
+	STICKER_SQL_ROLLBACK,
 };
 
 static const char *const sticker_sql[] = {
@@ -63,16 +69,25 @@ static const char *const sticker_sql[] = {
 	//[STICKER_SQL_DELETE_VALUE] =
 	"DELETE FROM sticker WHERE type=? AND uri=? AND name=?",
 	//[STICKER_SQL_FIND] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=?",
+	"SELECT uri,value FROM sticker WHERE type=? AND name=? AND uri>=? AND uri<?",
 
 	//[STICKER_SQL_FIND_VALUE] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=? AND value=?",
+	"SELECT uri,value FROM sticker WHERE type=? AND name=? AND uri>=? AND uri<? AND value=?",
 
 	//[STICKER_SQL_FIND_LT] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=? AND value<?",
+	"SELECT uri,value FROM sticker WHERE type=? AND name=? AND uri>=? AND uri<? AND value<?",
 
 	//[STICKER_SQL_FIND_GT] =
-	"SELECT uri,value FROM sticker WHERE type=? AND uri LIKE (? || '%') AND name=? AND value>?",
+	"SELECT uri,value FROM sticker WHERE type=? AND name=? AND uri>=? AND uri<? AND value>?",
+
+	//[STICKER_SQL_BEGIN] =
+	"BEGIN",
+
+	//[STICKER_SQL_COMMIT] =
+	"COMMIT",
+
+	//[STICKER_SQL_ROLLBACK] =
+	"ROLLBACK",
 };
 
 static const char sticker_sql_create[] =
@@ -84,11 +99,49 @@ static const char sticker_sql_create[] =
 	");"
 	"CREATE UNIQUE INDEX IF NOT EXISTS"
 	" sticker_value ON sticker(type, uri, name);"
+	/* for sticker_find(); added in MPD 0.20, this is created in
+	   existing databases, too */
+	"CREATE INDEX IF NOT EXISTS"
+	" sticker_name ON sticker(type, name, uri);"
 	"";
 
 static sqlite3 *sticker_db;
 static sqlite3_stmt *sticker_stmt[ARRAY_SIZE(sticker_sql)];
 
+/**
+ * All values of one sticker name and type, see sticker_cache.
+ */
+struct StickerCacheEntry {
+	/**
+	 * Have the values been loaded from the database?
+	 */
+	bool loaded = false;
+
+	/**
+	 * URI to value.
+	 */
+	std::unordered_map<std::string, std::string> values;
+};
+
+/**
+ * A write-through cache for the sticker names configured with
+ * "sticker_cache".  The key is the sticker name, the value maps the
+ * object type to its entry, which is loaded on the first access.
+ */
+static std::map<std::string,
+		std::map<std::string, StickerCacheEntry>> sticker_cache;
+
+/**
+ * The nesting level of sticker_begin_batch() calls.
+ */
+static unsigned sticker_batch_depth;
+
+/**
+ * Has a transaction been started for the current batch?  This
+ * happens lazily, on the first modification.
+ */
+static bool sticker_in_transaction;
+
 static sqlite3_stmt *
 sticker_prepare(const char *sql, Error &error)
 {
@@ -104,8 +157,45 @@ sticker_prepare(const char *sql, Error &error)
 	return stmt;
 }
 
+static bool
+sticker_exec(const char *sql, Error &error)
+{
+	int ret = sqlite3_exec(sticker_db, sql, nullptr, nullptr, nullptr);
+	if (ret != SQLITE_OK) {
+		error.Format(sqlite_domain, ret,
+			     "Failed to execute \"%s\": %s",
+			     sql, sqlite3_errmsg(sticker_db));
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Apply the "sticker_synchronous" setting.
+ */
+static bool
+sticker_set_synchronous(const char *synchronous, Error &error)
+{
+	static const char *const levels[] = {
+		"off", "normal", "full", "extra",
+	};
+
+	for (const char *level : levels) {
+		if (strcmp(synchronous, level) == 0) {
+			std::string sql("PRAGMA synchronous=");
+			sql.append(level);
+			return sticker_exec(sql.c_str(), error);
+		}
+	}
+
+	error.Format(sqlite_domain,
+		     "Invalid sticker_synchronous value: %s", synchronous);
+	return false;
+}
+
 bool
-sticker_global_init(Path path, Error &error)
+sticker_global_init(Path path, const char *synchronous, Error &error)
 {
 	assert(!path.IsNull());
 
@@ -122,6 +212,18 @@ sticker_global_init(Path path, Error &error)
 		return false;
 	}
 
+	/* with write-ahead logging, a commit is a sequential append,
+	   and with synchronous=NORMAL it does not need an fsync();
+	   this may fail on file systems without shared memory
+	   support, but the database works anyway */
+
+	Error wal_error;
+	if (!sticker_exec("PRAGMA journal_mode=WAL", wal_error))
+		LogError(wal_error);
+
+	if (!sticker_set_synchronous(synchronous, error))
+		return false;
+
 	/* create the table and index */
 
 	ret = sqlite3_exec(sticker_db, sticker_sql_create,
@@ -153,6 +255,9 @@ sticker_global_finish()
 		/* not configured */
 		return;
 
+	assert(sticker_batch_depth == 0);
+	assert(!sticker_in_transaction);
+
 	for (unsigned i = 0; i < ARRAY_SIZE(sticker_stmt); ++i) {
 		assert(sticker_stmt[i] != nullptr);
 
@@ -160,6 +265,86 @@ sticker_global_finish()
 	}
 
 	sqlite3_close(sticker_db);
+
+	sticker_cache.clear();
+}
+
+void
+sticker_enable_cache(const char *name)
+{
+	assert(sticker_enabled());
+	assert(name != nullptr);
+
+	sticker_cache[name];
+}
+
+static void
+sticker_cache_load_cb(const char *uri, const char *value, void *user_data)
+{
+	StickerCacheEntry &entry = *(StickerCacheEntry *)user_data;
+
+	entry.values.emplace(uri, value);
+}
+
+/**
+ * Look up the cache entry for the specified sticker name, and load
+ * it from the database if necessary.
+ *
+ * @return the entry or nullptr if the name is not cached (or if
+ * loading has failed)
+ */
+static const StickerCacheEntry *
+sticker_cache_get(const char *type, const char *name)
+{
+	auto i = sticker_cache.find(name);
+	if (i == sticker_cache.end())
+		return nullptr;
+
+	StickerCacheEntry &entry = i->second[type];
+	if (!entry.loaded) {
+		Error error;
+		if (!sticker_find(type, nullptr, name,
+				  StickerOperator::EXISTS, nullptr,
+				  sticker_cache_load_cb, &entry, error)) {
+			LogError(error);
+			entry.values.clear();
+			return nullptr;
+		}
+
+		entry.loaded = true;
+	}
+
+	return &entry;
+}
+
+/**
+ * Look up the cache entry for the specified sticker name, but only
+ * if it has been loaded already; used to update it after a
+ * modification.
+ */
+static StickerCacheEntry *
+sticker_cache_lookup_loaded(const char *type, const char *name)
+{
+	auto i = sticker_cache.find(name);
+	if (i == sticker_cache.end())
+		return nullptr;
+
+	auto j = i->second.find(type);
+	if (j == i->second.end() || !j->second.loaded)
+		return nullptr;
+
+	return &j->second;
+}
+
+/**
+ * Discard all cached values; they will be reloaded on the next
+ * access.
+ */
+static void
+sticker_cache_invalidate()
+{
+	for (auto &i : sticker_cache)
+		i.second.clear();
 }
 
 bool
@@ -168,6 +353,70 @@ sticker_enabled()
 	return sticker_db != nullptr;
 }
 
+static bool
+sticker_step(enum sticker_sql sql, Error &error)
+{
+	sqlite3_stmt *const stmt = sticker_stmt[sql];
+
+	bool success = ExecuteCommand(stmt, error);
+	sqlite3_reset(stmt);
+	return success;
+}
+
+/**
+ * Called before each modification: if a batch is active, start its
+ * transaction now.
+ */
+static bool
+sticker_prepare_write(Error &error)
+{
+	if (sticker_batch_depth == 0 || sticker_in_transaction)
+		return true;
+
+	if (!sticker_step(STICKER_SQL_BEGIN, error))
+		return false;
+
+	sticker_in_transaction = true;
+	return true;
+}
+
+void
+sticker_begin_batch()
+{
+	if (!sticker_enabled())
+		return;
+
+	++sticker_batch_depth;
+}
+
+void
+sticker_commit_batch()
+{
+	if (!sticker_enabled())
+		return;
+
+	assert(sticker_batch_depth > 0);
+
+	if (--sticker_batch_depth > 0 || !sticker_in_transaction)
+		return;
+
+	sticker_in_transaction = false;
+
+	Error error;
+	if (!sticker_step(STICKER_SQL_COMMIT, error)) {
+		LogError(error);
+
+		/* don't leave the transaction open */
+		Error rollback_error;
+		if (!sticker_step(STICKER_SQL_ROLLBACK, rollback_error))
+			LogError(rollback_error);
+
+		/* the cache may contain values which have been rolled
+		   back */
+		sticker_cache_invalidate();
+	}
+}
+
 std::string
 sticker_load_value(const char *type, const char *uri, const char *name,
 		   Error &error)
@@ -182,6 +431,14 @@ sticker_load_value(const char *type, const char *uri, const char *name,
 	if (StringIsEmpty(name))
 		return std::string();
 
+	const StickerCacheEntry *entry = sticker_cache_get(type, name);
+	if (entry != nullptr) {
+		auto i = entry->values.find(uri);
+		return i != entry->values.end()
+			? i->second
+			: std::string();
+	}
+
 	if (!BindAll(error, stmt, type, uri, name))
 		return std::string();
 
@@ -291,8 +548,18 @@ sticker_store_value(const char *type, const char *uri,
 	if (StringIsEmpty(name))
 		return false;
 
-	return sticker_update_value(type, uri, name, value, error) ||
-		sticker_insert_value(type, uri, name, value, error);
+	if (!sticker_prepare_write(error))
+		return false;
+
+	if (!sticker_update_value(type, uri, name, value, error) &&
+	    !sticker_insert_value(type, uri, name, value, error))
+		return false;
+
+	StickerCacheEntry *entry = sticker_cache_lookup_loaded(type, name);
+	if (entry != nullptr)
+		entry->values[uri] = value;
+
+	return true;
 }
 
 bool
@@ -304,6 +571,9 @@ sticker_delete(const char *type, const char *uri, Error &error)
 	assert(type != nullptr);
 	assert(uri != nullptr);
 
+	if (!sticker_prepare_write(error))
+		return false;
+
 	if (!BindAll(error, stmt, type, uri))
 		return false;
 
@@ -312,6 +582,13 @@ sticker_delete(const char *type, const char *uri, Error &error)
 	sqlite3_reset(stmt);
 	sqlite3_clear_bindings(stmt);
 
+	if (modified)
+		for (auto &c : sticker_cache) {
+			auto e = c.second.find(type);
+			if (e != c.second.end())
+				e->second.values.erase(uri);
+		}
+
 	if (modified)
 		idle_add(IDLE_STICKER);
 	return modified;
@@ -327,6 +604,9 @@ sticker_delete_value(const char *type, const char *uri, const char *name,
 	assert(type != nullptr);
 	assert(uri != nullptr);
 
+	if (!sticker_prepare_write(error))
+		return false;
+
 	if (!BindAll(error, stmt, type, uri, name))
 		return false;
 
@@ -335,6 +615,13 @@ sticker_delete_value(const char *type, const char *uri, const char *name,
 	sqlite3_reset(stmt);
 	sqlite3_clear_bindings(stmt);
 
+	if (modified) {
+		StickerCacheEntry *entry =
+			sticker_cache_lookup_loaded(type, name);
+		if (entry != nullptr)
+			entry->values.erase(uri);
+	}
+
 	if (modified)
 		idle_add(IDLE_STICKER);
 	return modified;
@@ -381,36 +668,56 @@ sticker_load(const char *type, const char *uri, Error &error)
 	return new Sticker(std::move(s));
 }
 
+/**
+ * Calculate the smallest string which is larger than all strings
+ * beginning with the given prefix, for a range query.  This relies
+ * on the URIs being valid UTF-8, which never contains 0xff.
+ */
+static std::string
+PrefixUpperBound(const char *prefix)
+{
+	std::string result(prefix);
+	while (!result.empty() && (unsigned char)result.back() == 0xff)
+		result.pop_back();
+
+	if (result.empty())
+		/* larger than all UTF-8 strings */
+		return "\xff";
+
+	++result.back();
+	return result;
+}
+
 static sqlite3_stmt *
-BindFind(const char *type, const char *base_uri, const char *name,
+BindFind(const char *type, const char *base_uri, const char *upper_uri,
+	 const char *name,
 	 StickerOperator op, const char *value,
 	 Error &error)
 {
 	assert(type != nullptr);
+	assert(base_uri != nullptr);
+	assert(upper_uri != nullptr);
 	assert(name != nullptr);
 
-	if (base_uri == nullptr)
-		base_uri = "";
-
 	switch (op) {
 	case StickerOperator::EXISTS:
 		return BindAllOrNull(error, sticker_stmt[STICKER_SQL_FIND],
-				     type, base_uri, name);
+				     type, name, base_uri, upper_uri);
 
 	case StickerOperator::EQUALS:
 		return BindAllOrNull(error,
 				     sticker_stmt[STICKER_SQL_FIND_VALUE],
-				     type, base_uri, name, value);
+				     type, name, base_uri, upper_uri, value);
 
 	case StickerOperator::LESS_THAN:
 		return BindAllOrNull(error,
 				     sticker_stmt[STICKER_SQL_FIND_LT],
-				     type, base_uri, name, value);
+				     type, name, base_uri, upper_uri, value);
 
 	case StickerOperator::GREATER_THAN:
 		return BindAllOrNull(error,
 				     sticker_stmt[STICKER_SQL_FIND_GT],
-				     type, base_uri, name, value);
+				     type, name, base_uri, upper_uri, value);
 	}
 
 	assert(false);
@@ -428,8 +735,16 @@ sticker_find(const char *type, const char *base_uri, const char *name,
 	assert(func != nullptr);
 	assert(sticker_enabled());
 
-	sqlite3_stmt *const stmt = BindFind(type, base_uri, name, op, value,
-					    error);
+	if (base_uri == nullptr)
+		base_uri = "";
+
+	/* a range instead of "LIKE", which allows using the
+	   "sticker_name" index; the string must live until the
+	   statement has been reset */
+	const std::string upper_uri = PrefixUpperBound(base_uri);
+
+	sqlite3_stmt *const stmt = BindFind(type, base_uri, upper_uri.c_str(),
+					    name, op, value, error);
 	if (stmt == nullptr)
 		return false;
 
@@ -54,10 +54,12 @@ struct Sticker;
 /**
  * Opens the sticker database.
  *
+ * @param synchronous the SQLite "synchronous" level: "off",
+ * "normal", "full" or "extra"
  * @return true on success, false on error
  */
 bool
-sticker_global_init(Path path, Error &error);
+sticker_global_init(Path path, const char *synchronous, Error &error);
 
 /**
  * Close the sticker database.
@@ -65,6 +67,16 @@ sticker_global_init(Path path, Error &error);
 void
 sticker_global_finish();
 
+/**
+ * Keep all values of the specified sticker name in memory.  They
+ * are loaded from the database on the first access, and modified
+ * values are written through to the database.  This speeds up
+ * sticker_load_value() for names which are queried for many
+ * objects, e.g. a song rating shown in a song list.
+ */
+void
+sticker_enable_cache(const char *name);
+
 /**
  * Returns true if the sticker database is configured and available.
  */
@@ -72,6 +84,23 @@ gcc_const
 bool
 sticker_enabled();
 
+/**
+ * Begin a batch of modifications, e.g. of one command list.  All
+ * modifications until the matching sticker_commit_batch() call are
+ * committed in one transaction, which avoids one fsync() per
+ * modification.  Calls may be nested.  Does nothing if the sticker
+ * database is not enabled.
+ */
+void
+sticker_begin_batch();
+
+/**
+ * Finish a batch started with sticker_begin_batch().  Errors are
+ * logged.
+ */
+void
+sticker_commit_batch();
+
 /**
  * Returns one value from an object's sticker record.  Returns an
  * empty string if the value doesn't exist.
@@ -25,6 +25,7 @@
 #include "util/Domain.hxx"
 #include "util/StringCompare.hxx"
 
+#include <algorithm>
 #include <set>
 
 #include <string.h>
@@ -235,6 +236,8 @@ CompositeStorage::Mount(const char *uri, Storage *storage)
 	if (directory.storage != nullptr)
 		delete directory.storage;
 	directory.storage = storage;
+
+	UpdateMounts();
 }
 
 bool
@@ -242,28 +245,65 @@ CompositeStorage::Unmount(const char *uri)
 {
 	const ScopeLock protect(mutex);
 
-	return root.Unmount(uri);
+	if (!root.Unmount(uri))
+		return false;
+
+	UpdateMounts();
+	return true;
 }
 
-CompositeStorage::FindResult
-CompositeStorage::FindStorage(const char *uri) const
+void
+CompositeStorage::CollectMounts(std::string &uri, const Directory &directory)
 {
-	FindResult result{&root, uri};
+	if (directory.storage != nullptr && &directory != &root)
+		mounts.push_back(MountPoint{uri, &directory});
 
-	const Directory *directory = &root;
-	while (*uri != 0) {
-		const std::string name = NextSegment(uri);
+	if (!uri.empty())
+		uri.push_back('/');
 
-		auto i = directory->children.find(name);
-		if (i == directory->children.end())
-			break;
+	const size_t uri_length = uri.length();
 
-		directory = &i->second;
-		if (directory->storage != nullptr)
-			result = FindResult{directory, uri};
+	for (const auto &i : directory.children) {
+		uri.resize(uri_length);
+		uri.append(i.first);
+
+		CollectMounts(uri, i.second);
 	}
+}
 
-	return result;
+void
+CompositeStorage::UpdateMounts()
+{
+	mounts.clear();
+
+	std::string uri;
+	CollectMounts(uri, root);
+
+	std::stable_sort(mounts.begin(), mounts.end(),
+			 [](const MountPoint &a, const MountPoint &b){
+				 return a.uri.length() > b.uri.length();
+			 });
+}
+
+CompositeStorage::FindResult
+CompositeStorage::FindStorage(const char *uri) const
+{
+	for (const auto &i : mounts) {
+		const char *rest = StringAfterPrefix(uri, i.uri.c_str());
+		if (rest == nullptr)
+			continue;
+
+		if (*rest == '/')
+			++rest;
+		else if (*rest != 0)
+			/* the mount point name is only a prefix of
+			   this URI's segment */
+			continue;
+
+		return FindResult{i.directory, rest};
+	}
+
+	return FindResult{&root, uri};
 }
 
 CompositeStorage::FindResult
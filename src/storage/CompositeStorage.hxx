@@ -27,6 +27,7 @@
 
 #include <string>
 #include <map>
+#include <vector>
 
 class Error;
 
@@ -79,6 +80,14 @@ class CompositeStorage final : public Storage {
 		const char *uri;
 	};
 
+	/**
+	 * An item in #mounts.
+	 */
+	struct MountPoint {
+		std::string uri;
+		const Directory *directory;
+	};
+
 	/**
 	 * Protects the virtual #Directory tree.
 	 *
@@ -88,6 +97,16 @@ class CompositeStorage final : public Storage {
 
 	Directory root;
 
+	/**
+	 * All #Directory instances below #root which have a
+	 * #Storage, sorted by descending URI length, so the first
+	 * match is the longest one.  This allows FindStorage() to
+	 * look up a URI without walking the tree and without
+	 * allocating a std::string for each segment.  Rebuilt by
+	 * Mount() and Unmount().
+	 */
+	std::vector<MountPoint> mounts;
+
 	mutable std::string relative_buffer;
 
 public:
@@ -154,6 +173,13 @@ private:
 		}
 	}
 
+	/**
+	 * Rebuild #mounts from the #Directory tree.
+	 */
+	void UpdateMounts();
+
+	void CollectMounts(std::string &uri, const Directory &directory);
+
 	gcc_pure
 	FindResult FindStorage(const char *uri) const;
 	FindResult FindStorage(const char *uri, Error &error) const;
@@ -21,6 +21,7 @@
 #define MPD_STORAGE_INTERFACE_HXX
 
 #include "check.h"
+#include "fs/Path.hxx"
 #include "Compiler.h"
 
 #include <string>
@@ -38,6 +39,17 @@ public:
 	virtual const char *Read() = 0;
 	virtual bool GetInfo(bool follow, StorageFileInfo &info,
 			     Error &error) = 0;
+
+	/**
+	 * Returns the name of the entry returned by the last Read()
+	 * call in the file system charset, so callers don't need to
+	 * convert it back from UTF-8.  Returns a "nulled" instance if
+	 * this storage is not a local file system.
+	 */
+	gcc_pure
+	virtual Path GetNameFS() const {
+		return Path::Null();
+	}
 };
 
 class Storage {
@@ -53,6 +65,15 @@ public:
 	virtual StorageDirectoryReader *OpenDirectory(const char *uri_utf8,
 						      Error &error) = 0;
 
+	/**
+	 * A hint that OpenDirectory() will soon be called with the
+	 * given URI.  A storage with a high latency may start
+	 * listing the directory in the background, so several
+	 * directories can be in flight at the same time.  It may
+	 * ignore the hint, e.g. when too many are pending already.
+	 */
+	virtual void PrefetchDirectory(gcc_unused const char *uri_utf8) {}
+
 	/**
 	 * Map the given relative URI to an absolute URI.
 	 */
@@ -45,6 +45,10 @@ public:
 	const char *Read() override;
 	bool GetInfo(bool follow, StorageFileInfo &info,
 		     Error &error) override;
+
+	Path GetNameFS() const override {
+		return reader.GetEntry();
+	}
 };
 
 class LocalStorage final : public Storage {
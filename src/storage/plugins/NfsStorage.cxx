@@ -45,14 +45,26 @@ extern "C" {
 }
 
 #include <string>
+#include <list>
+#include <algorithm>
 
 #include <assert.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 
+struct NfsPrefetchedDirectory;
+
 class NfsStorage final
 	: public Storage, NfsLease, DeferredMonitor, TimeoutMonitor {
 
+	/**
+	 * The maximum number of directory listings requested by
+	 * PrefetchDirectory() which may be pending at a time.  If
+	 * more are requested, the oldest one is discarded; it was
+	 * probably never claimed.
+	 */
+	static constexpr size_t MAX_PREFETCH = 32;
+
 	enum class State {
 		INITIAL, CONNECTING, READY, DELAY,
 	};
@@ -68,6 +80,17 @@ class NfsStorage final
 	State state;
 	Error last_error;
 
+	/**
+	 * Protects #prefetched.
+	 */
+	Mutex prefetch_mutex;
+
+	/**
+	 * Directory listings requested by PrefetchDirectory() which
+	 * have not yet been claimed by OpenDirectory().
+	 */
+	std::list<NfsPrefetchedDirectory *> prefetched;
+
 public:
 	NfsStorage(EventLoop &_loop, const char *_base,
 		   std::string &&_server, std::string &&_export_name)
@@ -80,6 +103,7 @@ public:
 	}
 
 	~NfsStorage() {
+		ClearPrefetched();
 		BlockingCall(GetEventLoop(), [this](){ Disconnect(); });
 		nfs_finish();
 	}
@@ -91,6 +115,8 @@ public:
 	StorageDirectoryReader *OpenDirectory(const char *uri_utf8,
 					      Error &error) override;
 
+	void PrefetchDirectory(const char *uri_utf8) override;
+
 	std::string MapUTF8(const char *uri_utf8) const override;
 
 	const char *MapToRelativeUTF8(const char *uri_utf8) const override;
@@ -130,6 +156,25 @@ public:
 	}
 
 private:
+	/**
+	 * Remove the prefetched listing of the given directory from
+	 * #prefetched and return it.  Returns nullptr if it was not
+	 * prefetched.
+	 */
+	NfsPrefetchedDirectory *TakePrefetched(const char *uri_utf8);
+
+	/**
+	 * Wait for all pending prefetch operations and discard their
+	 * results.
+	 */
+	void ClearPrefetched();
+
+	/**
+	 * Make room for a new prefetch operation by discarding the
+	 * oldest one if #MAX_PREFETCH has been reached.
+	 */
+	void ShrinkPrefetched();
+
 	EventLoop &GetEventLoop() {
 		return DeferredMonitor::GetEventLoop();
 	}
@@ -379,9 +424,103 @@ NfsListDirectoryOperation::CollectEntries(struct nfsdir *dir)
 	}
 }
 
+/**
+ * A directory listing which was requested by
+ * NfsStorage::PrefetchDirectory().
+ */
+struct NfsPrefetchedDirectory {
+	const std::string uri;
+
+	const std::string path;
+
+	NfsListDirectoryOperation operation;
+
+	NfsPrefetchedDirectory(NfsConnection &_connection,
+			       const char *_uri, std::string &&_path)
+		:uri(_uri), path(std::move(_path)),
+		 operation(_connection, path.c_str()) {}
+};
+
+NfsPrefetchedDirectory *
+NfsStorage::TakePrefetched(const char *uri_utf8)
+{
+	const ScopeLock protect(prefetch_mutex);
+
+	auto i = std::find_if(prefetched.begin(), prefetched.end(),
+			      [uri_utf8](const NfsPrefetchedDirectory *p){
+				      return p->uri == uri_utf8;
+			      });
+	if (i == prefetched.end())
+		return nullptr;
+
+	NfsPrefetchedDirectory *p = *i;
+	prefetched.erase(i);
+	return p;
+}
+
+void
+NfsStorage::ClearPrefetched()
+{
+	for (NfsPrefetchedDirectory *p : prefetched) {
+		Error error;
+		p->operation.Wait(error);
+		delete p;
+	}
+
+	prefetched.clear();
+}
+
+void
+NfsStorage::ShrinkPrefetched()
+{
+	NfsPrefetchedDirectory *oldest;
+
+	{
+		const ScopeLock protect(prefetch_mutex);
+		if (prefetched.size() < MAX_PREFETCH)
+			return;
+
+		oldest = prefetched.front();
+		prefetched.pop_front();
+	}
+
+	Error error;
+	oldest->operation.Wait(error);
+	delete oldest;
+}
+
+void
+NfsStorage::PrefetchDirectory(const char *uri_utf8)
+{
+	ShrinkPrefetched();
+
+	Error error;
+	std::string path = UriToNfsPath(uri_utf8, error);
+	if (path.empty() || !WaitConnected(error))
+		return;
+
+	auto *p = new NfsPrefetchedDirectory(*connection, uri_utf8,
+					     std::move(path));
+	p->operation.Begin();
+
+	const ScopeLock protect(prefetch_mutex);
+	prefetched.push_back(p);
+}
+
 StorageDirectoryReader *
 NfsStorage::OpenDirectory(const char *uri_utf8, Error &error)
 {
+	NfsPrefetchedDirectory *p = TakePrefetched(uri_utf8);
+	if (p != nullptr) {
+		/* the request is already in flight (or even
+		   finished) */
+		StorageDirectoryReader *reader = p->operation.Wait(error)
+			? p->operation.ToReader()
+			: nullptr;
+		delete p;
+		return reader;
+	}
+
 	const std::string path = UriToNfsPath(uri_utf8, error);
 	if (path.empty())
 		return nullptr;
@@ -22,6 +22,7 @@
 #include "storage/StoragePlugin.hxx"
 #include "storage/StorageInterface.hxx"
 #include "storage/FileInfo.hxx"
+#include "storage/MemoryDirectoryReader.hxx"
 #include "lib/smbclient/Init.hxx"
 #include "lib/smbclient/Mutex.hxx"
 #include "fs/Traits.hxx"
@@ -93,18 +94,9 @@ SmbclientStorage::MapToRelativeUTF8(const char *uri_utf8) const
 	return PathTraitsUTF8::Relative(base.c_str(), uri_utf8);
 }
 
-static bool
-GetInfo(const char *path, StorageFileInfo &info, Error &error)
+static void
+Copy(StorageFileInfo &info, const struct stat &st)
 {
-	struct stat st;
-	smbclient_mutex.lock();
-	bool success = smbc_stat(path, &st) == 0;
-	smbclient_mutex.unlock();
-	if (!success) {
-		error.SetErrno();
-		return false;
-	}
-
 	if (S_ISREG(st.st_mode))
 		info.type = StorageFileInfo::Type::REGULAR;
 	else if (S_ISDIR(st.st_mode))
@@ -116,9 +108,33 @@ GetInfo(const char *path, StorageFileInfo &info, Error &error)
 	info.mtime = st.st_mtime;
 	info.device = st.st_dev;
 	info.inode = st.st_ino;
+}
+
+static bool
+GetInfo(const char *path, StorageFileInfo &info, Error &error)
+{
+	struct stat st;
+	smbclient_mutex.lock();
+	bool success = smbc_stat(path, &st) == 0;
+	smbclient_mutex.unlock();
+	if (!success) {
+		error.SetErrno();
+		return false;
+	}
+
+	Copy(info, st);
 	return true;
 }
 
+gcc_pure
+static bool
+SkipNameFS(const char *name)
+{
+	return name[0] == '.' &&
+		(name[1] == 0 ||
+		 (name[1] == '.' && name[2] == 0));
+}
+
 bool
 SmbclientStorage::GetInfo(const char *uri_utf8, gcc_unused bool follow,
 			  StorageFileInfo &info, Error &error)
@@ -139,16 +155,30 @@ SmbclientStorage::OpenDirectory(const char *uri_utf8, Error &error)
 		return nullptr;
 	}
 
-	return new SmbclientDirectoryReader(std::move(mapped.c_str()), handle);
-}
+#ifdef HAVE_SMBC_READDIRPLUS2
+	/* read all entries with their attributes in one go, instead
+	   of one smbc_stat() round trip per entry */
+	MemoryStorageDirectoryReader::List entries;
 
-gcc_pure
-static bool
-SkipNameFS(const char *name)
-{
-	return name[0] == '.' &&
-		(name[1] == 0 ||
-		 (name[1] == '.' && name[2] == 0));
+	smbclient_mutex.lock();
+
+	const struct libsmb_file_info *e;
+	struct stat st;
+	while ((e = smbc_readdirplus2(handle, &st)) != nullptr) {
+		if (SkipNameFS(e->name))
+			continue;
+
+		entries.emplace_front(e->name);
+		Copy(entries.front().info, st);
+	}
+
+	smbc_closedir(handle);
+	smbclient_mutex.unlock();
+
+	return new MemoryStorageDirectoryReader(std::move(entries));
+#else
+	return new SmbclientDirectoryReader(std::move(mapped.c_str()), handle);
+#endif
 }
 
 SmbclientDirectoryReader::~SmbclientDirectoryReader()
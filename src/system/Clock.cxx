@@ -118,6 +118,18 @@ MonotonicClockUS(void)
 #endif
 }
 
+uint64_t
+MonotonicClockNS(void)
+{
+#if !defined(WIN32) && !defined(__APPLE__) && defined(CLOCK_MONOTONIC)
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+#else
+	return MonotonicClockUS() * 1000;
+#endif
+}
+
 #ifdef WIN32
 
 gcc_const
@@ -45,6 +45,15 @@ gcc_pure
 uint64_t
 MonotonicClockUS();
 
+/**
+ * Returns the value of a monotonic clock in nanoseconds.  On
+ * platforms without a nanosecond clock, this has only microsecond
+ * resolution.
+ */
+gcc_pure
+uint64_t
+MonotonicClockNS();
+
 #ifdef WIN32
 
 /**
@@ -0,0 +1,177 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#ifdef USE_IO_URING
+#include "IoUring.hxx"
+#include "Error.hxx"
+
+#include <algorithm>
+
+#include <stdint.h>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+static void *
+MapRing(int fd, size_t size, off_t offset)
+{
+	void *p = mmap(nullptr, size, PROT_READ|PROT_WRITE,
+		       MAP_SHARED|MAP_POPULATE, fd, offset);
+	return p != MAP_FAILED
+		? p
+		: nullptr;
+}
+
+IoUring::IoUring(unsigned entries)
+	:sq_ring(nullptr), cq_ring(nullptr), sqes(nullptr)
+{
+	io_uring_params params;
+	memset(&params, 0, sizeof(params));
+
+	fd = syscall(__NR_io_uring_setup, entries, &params);
+	if (fd < 0)
+		throw MakeErrno("io_uring_setup() failed");
+
+	features = params.features;
+
+	sq_ring_size = params.sq_off.array +
+		params.sq_entries * sizeof(unsigned);
+	cq_ring_size = params.cq_off.cqes +
+		params.cq_entries * sizeof(io_uring_cqe);
+	sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+	if (HasFeature(IORING_FEAT_SINGLE_MMAP))
+		sq_ring_size = cq_ring_size =
+			std::max(sq_ring_size, cq_ring_size);
+
+	sq_ring = MapRing(fd, sq_ring_size, IORING_OFF_SQ_RING);
+	cq_ring = HasFeature(IORING_FEAT_SINGLE_MMAP)
+		? sq_ring
+		: MapRing(fd, cq_ring_size, IORING_OFF_CQ_RING);
+	sqes = (io_uring_sqe *)MapRing(fd, sqes_size, IORING_OFF_SQES);
+
+	if (sq_ring == nullptr || cq_ring == nullptr || sqes == nullptr) {
+		const int e = errno;
+		Unmap();
+		close(fd);
+		throw MakeErrno(e, "Failed to map io_uring");
+	}
+
+	uint8_t *const sq = (uint8_t *)sq_ring;
+	sq_head = (unsigned *)(sq + params.sq_off.head);
+	sq_tail = (unsigned *)(sq + params.sq_off.tail);
+	sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+	sq_entries = params.sq_entries;
+	sqe_tail = *sq_tail;
+
+	/* the entries are always submitted in the order of the
+	   #sqes array, so the indirection array can be initialized
+	   once */
+	unsigned *const sq_array = (unsigned *)(sq + params.sq_off.array);
+	for (unsigned i = 0; i < sq_entries; ++i)
+		sq_array[i] = i;
+
+	uint8_t *const cq = (uint8_t *)cq_ring;
+	cq_head = (unsigned *)(cq + params.cq_off.head);
+	cq_tail = (unsigned *)(cq + params.cq_off.tail);
+	cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+	cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+}
+
+IoUring::~IoUring()
+{
+	Unmap();
+	close(fd);
+}
+
+void
+IoUring::Unmap()
+{
+	if (sqes != nullptr)
+		munmap(sqes, sqes_size);
+
+	if (cq_ring != nullptr && cq_ring != sq_ring)
+		munmap(cq_ring, cq_ring_size);
+
+	if (sq_ring != nullptr)
+		munmap(sq_ring, sq_ring_size);
+}
+
+io_uring_sqe *
+IoUring::GetSqe()
+{
+	const unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+	if (sqe_tail - head >= sq_entries)
+		return nullptr;
+
+	io_uring_sqe *sqe = &sqes[sqe_tail & sq_mask];
+	++sqe_tail;
+
+	memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+int
+IoUring::Submit(unsigned wait_nr, int timeout_ms)
+{
+	const unsigned to_submit = sqe_tail - *sq_tail;
+	if (to_submit > 0)
+		__atomic_store_n(sq_tail, sqe_tail, __ATOMIC_RELEASE);
+
+	if (to_submit == 0 && wait_nr == 0)
+		return 0;
+
+	unsigned flags = 0;
+	const void *arg = nullptr;
+	size_t arg_size = 0;
+
+	__kernel_timespec ts;
+	io_uring_getevents_arg ext_arg;
+
+	if (wait_nr > 0) {
+		flags |= IORING_ENTER_GETEVENTS;
+
+		if (timeout_ms >= 0) {
+			ts.tv_sec = timeout_ms / 1000;
+			ts.tv_nsec = (timeout_ms % 1000) * 1000000L;
+
+			memset(&ext_arg, 0, sizeof(ext_arg));
+			ext_arg.sigmask_sz = _NSIG / 8;
+			ext_arg.ts = (uintptr_t)&ts;
+
+			flags |= IORING_ENTER_EXT_ARG;
+			arg = &ext_arg;
+			arg_size = sizeof(ext_arg);
+		}
+	}
+
+	int result = syscall(__NR_io_uring_enter, fd, to_submit, wait_nr,
+			     flags, arg, arg_size);
+	return result >= 0
+		? result
+		: -errno;
+}
+
+#endif /* USE_IO_URING */
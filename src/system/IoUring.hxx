@@ -0,0 +1,122 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_IO_URING_HXX
+#define MPD_IO_URING_HXX
+
+#include "check.h"
+
+#include <linux/io_uring.h>
+
+#include <stddef.h>
+
+/**
+ * A thin wrapper for a Linux io_uring instance.  It uses the raw
+ * system calls, liburing is not needed.
+ *
+ * This class is not thread-safe.
+ */
+class IoUring {
+	int fd;
+
+	unsigned features;
+
+	void *sq_ring, *cq_ring;
+	size_t sq_ring_size, cq_ring_size;
+
+	io_uring_sqe *sqes;
+	size_t sqes_size;
+
+	unsigned *sq_head, *sq_tail;
+	unsigned sq_mask, sq_entries;
+
+	/**
+	 * The tail of the submission queue including entries which
+	 * were returned by GetSqe(), but not yet published by
+	 * Submit().
+	 */
+	unsigned sqe_tail;
+
+	unsigned *cq_head, *cq_tail;
+	unsigned cq_mask;
+	io_uring_cqe *cqes;
+
+public:
+	/**
+	 * Throws std::system_error on error (e.g. if the kernel does
+	 * not support io_uring).
+	 */
+	explicit IoUring(unsigned entries);
+
+	~IoUring();
+
+	IoUring(const IoUring &) = delete;
+	IoUring &operator=(const IoUring &) = delete;
+
+	bool HasFeature(unsigned feature) const {
+		return (features & feature) != 0;
+	}
+
+	/**
+	 * Obtain a zero-initialized submission queue entry.  It will
+	 * be passed to the kernel by the next Submit() call.
+	 *
+	 * @return the entry or nullptr if the submission queue is
+	 * full (call Submit() and try again)
+	 */
+	io_uring_sqe *GetSqe();
+
+	/**
+	 * Pass all prepared submission queue entries to the kernel,
+	 * and optionally wait for completions.
+	 *
+	 * @param wait_nr the number of completions to wait for
+	 * @param timeout_ms the maximum time to wait (only if
+	 * #wait_nr is not zero); -1 means no limit; other values
+	 * require #IORING_FEAT_EXT_ARG
+	 * @return the number of submitted entries or a negative
+	 * errno value (e.g. -ETIME on timeout or -EINTR)
+	 */
+	int Submit(unsigned wait_nr=0, int timeout_ms=-1);
+
+	/**
+	 * @return the oldest completion queue entry or nullptr if
+	 * there is none; call SeenCqe() after handling it
+	 */
+	io_uring_cqe *PeekCqe() {
+		const unsigned head = *cq_head;
+		if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE))
+			return nullptr;
+
+		return &cqes[head & cq_mask];
+	}
+
+	/**
+	 * Release the entry returned by PeekCqe().
+	 */
+	void SeenCqe() {
+		__atomic_store_n(cq_head, *cq_head + 1, __ATOMIC_RELEASE);
+	}
+
+private:
+	void Unmap();
+};
+
+#endif
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "MemInfo.hxx"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int64_t
+GetAvailableMemory()
+{
+#ifdef __linux__
+	FILE *file = fopen("/proc/meminfo", "r");
+	if (file == nullptr)
+		return -1;
+
+	int64_t result = -1;
+	char line[256];
+	while (fgets(line, sizeof(line), file) != nullptr) {
+		static constexpr char prefix[] = "MemAvailable:";
+		if (memcmp(line, prefix, sizeof(prefix) - 1) == 0) {
+			/* the value is in kB */
+			result = strtoll(line + sizeof(prefix) - 1,
+					 nullptr, 10) * 1024;
+			break;
+		}
+	}
+
+	fclose(file);
+	return result;
+#else
+	return -1;
+#endif
+}
+
+double
+GetMemoryPressure()
+{
+#ifdef __linux__
+	FILE *file = fopen("/proc/pressure/memory", "r");
+	if (file == nullptr)
+		return -1;
+
+	double result = -1;
+	char line[256];
+	if (fgets(line, sizeof(line), file) != nullptr) {
+		/* "some avg10=0.00 avg60=0.00 avg300=0.00 total=0" */
+		const char *p = strstr(line, "avg10=");
+		if (memcmp(line, "some ", 5) == 0 && p != nullptr)
+			result = strtod(p + 6, nullptr);
+	}
+
+	fclose(file);
+	return result;
+#else
+	return -1;
+#endif
+}
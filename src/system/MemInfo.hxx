@@ -0,0 +1,43 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_MEM_INFO_HXX
+#define MPD_MEM_INFO_HXX
+
+#include <stdint.h>
+
+/**
+ * Returns the amount of memory which is available for new
+ * allocations without swapping ("MemAvailable" in /proc/meminfo), or
+ * -1 if that is unknown on this system.
+ */
+int64_t
+GetAvailableMemory();
+
+/**
+ * Returns the share of time [%] in which at least one task was
+ * stalled on memory during the last 10 seconds ("some avg10" in
+ * /proc/pressure/memory), or a negative value if the kernel does not
+ * provide this information.
+ */
+double
+GetMemoryPressure();
+
+#endif
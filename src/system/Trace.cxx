@@ -0,0 +1,195 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "Trace.hxx"
+#include "thread/Mutex.hxx"
+
+#include <list>
+#include <memory>
+#include <vector>
+
+#include <stdio.h>
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+bool trace_enabled;
+
+static unsigned trace_buffer_size;
+
+struct TraceSpan {
+	const char *name;
+	uint64_t start;
+	uint64_t duration;
+};
+
+/**
+ * The spans of one thread.  Only this thread writes; the mutex is
+ * only contended while trace_export() copies the buffer.
+ */
+struct TraceBuffer {
+	const unsigned tid;
+
+	/**
+	 * The name of the thread at the time of its first span.
+	 */
+	char thread_name[32];
+
+	Mutex mutex;
+
+	std::unique_ptr<TraceSpan[]> spans;
+
+	/**
+	 * The total number of spans recorded; the most recent one is
+	 * at (#n - 1) % #trace_buffer_size.
+	 */
+	uint64_t n = 0;
+
+	explicit TraceBuffer(unsigned _tid)
+		:tid(_tid), spans(new TraceSpan[trace_buffer_size]) {
+		thread_name[0] = 0;
+#if defined(__linux__) && defined(PR_GET_NAME)
+		/* the buffer must have at least 16 bytes */
+		prctl(PR_GET_NAME, (unsigned long)thread_name, 0, 0, 0);
+		thread_name[sizeof(thread_name) - 1] = 0;
+#endif
+		if (thread_name[0] == 0)
+			snprintf(thread_name, sizeof(thread_name),
+				 "thread %u", tid);
+	}
+};
+
+/**
+ * All buffers which have ever been created; buffers of threads
+ * which have exited are kept, because their spans are still
+ * interesting.  Protected by #trace_mutex.
+ */
+static std::list<TraceBuffer> trace_buffers;
+static Mutex trace_mutex;
+
+static thread_local TraceBuffer *trace_thread_buffer;
+
+void
+trace_enable(unsigned buffer_size)
+{
+	trace_buffer_size = buffer_size;
+	trace_enabled = buffer_size > 0;
+}
+
+void
+trace_finish()
+{
+	trace_enabled = false;
+	trace_buffers.clear();
+}
+
+static TraceBuffer &
+GetThreadBuffer()
+{
+	TraceBuffer *buffer = trace_thread_buffer;
+	if (gcc_likely(buffer != nullptr))
+		return *buffer;
+
+	const ScopeLock protect(trace_mutex);
+	trace_buffers.emplace_back(trace_buffers.size() + 1);
+	return *(trace_thread_buffer = &trace_buffers.back());
+}
+
+void
+trace_record(const char *name, uint64_t start_us, uint64_t duration_us)
+{
+	TraceBuffer &buffer = GetThreadBuffer();
+
+	const ScopeLock protect(buffer.mutex);
+	buffer.spans[buffer.n++ % trace_buffer_size] =
+		TraceSpan{name, start_us, duration_us};
+}
+
+/**
+ * Append a string which contains only printable ASCII characters
+ * (and may therefore be embedded into JSON after escaping quotes and
+ * backslashes).
+ */
+static void
+AppendJsonString(std::string &dest, const char *s)
+{
+	dest.push_back('"');
+	for (; *s != 0; ++s) {
+		if (*s == '"' || *s == '\\')
+			dest.push_back('\\');
+		dest.push_back((unsigned char)*s >= 0x20 ? *s : '?');
+	}
+	dest.push_back('"');
+}
+
+std::string
+trace_export()
+{
+	std::string result = "{\"traceEvents\":[\n";
+	bool first = true;
+
+	std::vector<TraceSpan> spans;
+	spans.reserve(trace_buffer_size);
+
+	const ScopeLock protect(trace_mutex);
+
+	for (TraceBuffer &buffer : trace_buffers) {
+		char line[128];
+
+		spans.clear();
+
+		{
+			const ScopeLock buffer_protect(buffer.mutex);
+			const uint64_t n = buffer.n;
+			const uint64_t begin = n > trace_buffer_size
+				? n - trace_buffer_size
+				: 0;
+			for (uint64_t i = begin; i < n; ++i)
+				spans.push_back(buffer.spans[i % trace_buffer_size]);
+		}
+
+		if (!first)
+			result += ",\n";
+		first = false;
+
+		snprintf(line, sizeof(line),
+			 "{\"ph\":\"M\",\"name\":\"thread_name\","
+			 "\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+			 buffer.tid);
+		result += line;
+		AppendJsonString(result, buffer.thread_name);
+		result += "}}";
+
+		for (const auto &span : spans) {
+			result += ",\n{\"ph\":\"X\",\"name\":";
+			AppendJsonString(result, span.name);
+			snprintf(line, sizeof(line),
+				 ",\"pid\":1,\"tid\":%u,\"ts\":%llu,\"dur\":%llu}",
+				 buffer.tid,
+				 (unsigned long long)span.start,
+				 (unsigned long long)span.duration);
+			result += line;
+		}
+	}
+
+	result += "\n],\"displayTimeUnit\":\"ms\"}\n";
+	return result;
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_TRACE_HXX
+#define MPD_TRACE_HXX
+
+#include "Clock.hxx"
+#include "Compiler.h"
+
+#include <string>
+
+#include <stdint.h>
+
+/**
+ * Is tracing enabled?  Do not modify this variable; call
+ * trace_enable().
+ */
+extern bool trace_enabled;
+
+/**
+ * Enable tracing.  Call this at startup, before any other thread
+ * has been started.
+ *
+ * @param buffer_size the number of spans kept per thread; when the
+ * buffer is full, the oldest spans are overwritten
+ */
+void
+trace_enable(unsigned buffer_size);
+
+/**
+ * Free all trace buffers.  Call this after all other threads have
+ * exited.
+ */
+void
+trace_finish();
+
+/**
+ * Record a span in the buffer of the current thread.  Call this only
+ * if #trace_enabled is set.
+ *
+ * @param name the name of the span; it is not copied, and must
+ * therefore be a string literal or otherwise live forever
+ * @param start_us the MonotonicClockUS() value when the span began
+ */
+void
+trace_record(const char *name, uint64_t start_us, uint64_t duration_us);
+
+/**
+ * Export the spans of all threads as a JSON document in the Chrome
+ * trace event format, which can be loaded into Perfetto or
+ * chrome://tracing.  This function is thread-safe.
+ */
+std::string
+trace_export();
+
+/**
+ * Records the lifetime of this object as a span, if tracing is
+ * enabled.
+ */
+class ScopeTrace {
+	const char *const name;
+
+	/**
+	 * The MonotonicClockUS() value at construction, or 0 if
+	 * tracing is disabled.
+	 */
+	uint64_t start;
+
+public:
+	explicit ScopeTrace(const char *_name)
+		:name(_name),
+		 start(gcc_unlikely(trace_enabled) ? MonotonicClockUS() : 0) {}
+
+	~ScopeTrace() {
+		if (gcc_unlikely(start != 0))
+			trace_record(name, start, MonotonicClockUS() - start);
+	}
+
+	ScopeTrace(const ScopeTrace &) = delete;
+	ScopeTrace &operator=(const ScopeTrace &) = delete;
+};
+
+#endif
@@ -196,6 +196,20 @@ accept_cloexec_nonblock(int fd, struct sockaddr *address,
 	return ret;
 }
 
+int
+pipe_set_size(int fd, unsigned size)
+{
+#ifdef F_SETPIPE_SZ
+	return fcntl(fd, F_SETPIPE_SZ, (int)size);
+#else
+	(void)fd;
+	(void)size;
+
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
 int
 close_socket(int fd)
 {
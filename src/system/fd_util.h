@@ -91,6 +91,16 @@ int
 accept_cloexec_nonblock(int fd, struct sockaddr *address,
 			size_t *address_length_r);
 
+/**
+ * Resize the kernel buffer of a pipe (Linux F_SETPIPE_SZ).  The
+ * kernel rounds the size up to a power of two pages.
+ *
+ * @return the new buffer size in bytes, or -1 on error (errno set;
+ * ENOSYS if the operating system does not support this)
+ */
+int
+pipe_set_size(int fd, unsigned size);
+
 /**
  * Portable wrapper for close(); use closesocket() on WIN32/WinSock.
  */
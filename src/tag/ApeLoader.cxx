@@ -22,9 +22,10 @@
 #include "system/ByteOrder.hxx"
 #include "input/InputStream.hxx"
 #include "util/StringView.hxx"
+#include "util/ReusableArray.hxx"
 #include "util/Error.hxx"
 
-#include <memory>
+#include <algorithm>
 
 #include <stdint.h>
 #include <assert.h>
@@ -39,6 +40,22 @@ struct ApeFooter {
 	unsigned char reserved[8];
 };
 
+/**
+ * APE keys are at most 255 ASCII characters long.
+ */
+static constexpr size_t APE_MAX_KEY_LENGTH = 255;
+
+/**
+ * Text values larger than this are skipped.
+ */
+static constexpr size_t APE_MAX_VALUE_SIZE = 64 * 1024;
+
+/**
+ * The item flags which specify the value type; 0 means UTF-8 text,
+ * anything else is binary data or an external reference.
+ */
+static constexpr unsigned long APE_ITEM_TYPE_MASK = 0x3 << 1;
+
 bool
 tag_ape_scan(InputStream &is, ApeTagCallback callback)
 {
@@ -56,50 +73,74 @@ tag_ape_scan(InputStream &is, ApeTagCallback callback)
 		return false;
 
 	/* find beginning of ape tag */
-	size_t remaining = FromLE32(footer.length);
+	offset_type remaining = FromLE32(footer.length);
 	if (remaining <= sizeof(footer) + 10 ||
-	    /* refuse to load more than one megabyte of tag data */
-	    remaining > 1024 * 1024 ||
+	    remaining > is.GetSize() ||
 	    !is.Seek(is.GetSize() - remaining, IgnoreError()))
 		return false;
 
-	/* read tag into buffer */
 	remaining -= sizeof(footer);
 	assert(remaining > 10);
 
-	std::unique_ptr<char[]> buffer(new char[remaining]);
-	if (!is.ReadFull(buffer.get(), remaining, IgnoreError()))
-		return false;
+	/* read the items one by one into a buffer which is only as
+	   large as the largest text item; binary items (e.g. cover
+	   art) are skipped without reading them */
+	ReusableArray<char, 1024> buffer;
 
-	/* read tags */
 	unsigned n = FromLE32(footer.count);
-	const char *p = buffer.get();
 	while (n-- && remaining > 10) {
-		size_t size = FromLE32(*(const uint32_t *)p);
-		p += 4;
-		remaining -= 4;
-		unsigned long flags = FromLE32(*(const uint32_t *)p);
-		p += 4;
-		remaining -= 4;
+		const offset_type item_offset = is.GetOffset();
+
+		uint32_t header[2];
+		if (!is.ReadFull(header, sizeof(header), IgnoreError()))
+			break;
+
+		remaining -= sizeof(header);
+
+		const size_t size = FromLE32(header[0]);
+		const unsigned long flags = FromLE32(header[1]);
+		const bool wanted = (flags & APE_ITEM_TYPE_MASK) == 0 &&
+			size <= APE_MAX_VALUE_SIZE;
+
+		/* read the key, and the value if we want it; the
+		   key's length is unknown, so read as much as it may
+		   be (if we read too much, we'll seek back) */
+		const size_t max_length = std::min<offset_type>(remaining,
+								APE_MAX_KEY_LENGTH + 1 +
+								(wanted ? size : 0));
+		char *const p = buffer.Get(max_length + 1);
+		if (!is.ReadFull(p, max_length, IgnoreError()))
+			break;
 
 		/* get the key */
-		const char *key = p;
-		const char *key_end = (const char *)memchr(p, '\0', remaining);
+		const char *key_end = (const char *)memchr(p, '\0',
+							   max_length);
 		if (key_end == nullptr)
 			break;
 
-		p = key_end + 1;
-		remaining -= p - key;
+		const size_t key_size = key_end + 1 - p;
 
 		/* get the value */
-		if (remaining < size)
+		if (remaining - key_size < size)
 			break;
 
-		if (!callback(flags, key, {p, size}))
-			break;
+		remaining -= key_size + size;
 
-		p += size;
-		remaining -= size;
+		if (wanted) {
+			char *value = p + key_size;
+
+			/* null-terminate it for the callback's
+			   convenience */
+			value[size] = 0;
+
+			if (!callback(flags, p, {value, size}))
+				break;
+		}
+
+		const offset_type next = item_offset + sizeof(header) +
+			key_size + size;
+		if (next != is.GetOffset() && !is.Seek(next, IgnoreError()))
+			break;
 	}
 
 	return true;
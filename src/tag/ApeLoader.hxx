@@ -31,7 +31,10 @@ typedef std::function<bool(unsigned long flags, const char *key,
 			   StringView value)> ApeTagCallback;
 
 /**
- * Scans the APE tag values from a file.
+ * Scans the APE tag values from a file.  The items are read one by
+ * one; only UTF-8 text items are passed to the callback, binary items
+ * (e.g. cover art) are skipped.  The value passed to the callback is
+ * followed by a null byte (which is not included in its size).
  *
  * @return false if the file could not be opened or if no APE tag is
  * present
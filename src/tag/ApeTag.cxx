@@ -25,8 +25,7 @@
 #include "TagHandler.hxx"
 #include "util/StringView.hxx"
 
-#include <string>
-
+#include <assert.h>
 #include <string.h>
 
 const struct tag_table ape_tags[] = {
@@ -46,28 +45,23 @@ tag_ape_name_parse(const char *name)
 
 /**
  * Invoke the given callback for each string inside the given range.
- * The strings are separated by null bytes, but the last one may not
- * be terminated.
+ * The strings are separated by null bytes; the range itself is
+ * followed by a null byte (see tag_ape_scan()), so the last one is
+ * terminated, too.
  */
 template<typename C>
 static void
 ForEachValue(const char *value, const char *end, C &&callback)
 {
-	while (true) {
-		const char *n = (const char *)memchr(value, 0, end - value);
-		if (n == nullptr)
-			break;
+	assert(*end == 0);
 
+	while (value < end) {
+		const char *n = value + strlen(value);
 		if (n > value)
 			callback(value);
 
 		value = n + 1;
 	}
-
-	if (value < end) {
-		const std::string value2(value, end);
-		callback(value2.c_str());
-	}
 }
 
 /**
@@ -29,11 +29,30 @@
 #include <id3tag.h>
 
 #include <algorithm>
+#include <vector>
+
+#include <string.h>
 
 static constexpr Domain id3_domain("id3");
 
 static constexpr size_t ID3V1_SIZE = 128;
 
+static constexpr size_t ID3V2_HEADER_SIZE = 10;
+static constexpr size_t ID3V2_FRAME_HEADER_SIZE = 10;
+
+/**
+ * ID3v2 tags larger than this are read frame by frame, skipping the
+ * frames we don't need (see ReadFilteredId3Tag()).  Smaller tags are
+ * read in one piece.
+ */
+static constexpr size_t ID3V2_FILTER_THRESHOLD = 16 * 1024;
+
+enum {
+	ID3V2_FLAG_UNSYNCHRONISATION = 0x80,
+	ID3V2_FLAG_EXTENDED_HEADER = 0x40,
+	ID3V2_FLAG_FOOTER = 0x10,
+};
+
 gcc_pure
 static inline bool
 tag_is_id3v1(struct id3_tag *tag)
@@ -54,6 +73,131 @@ get_id3v2_footer_size(InputStream &is, offset_type offset)
 	return id3_tag_query(buf, sizeof(buf));
 }
 
+static constexpr size_t
+ParseSyncSafe(const id3_byte_t *p)
+{
+	return (size_t(p[0] & 0x7f) << 21) | (size_t(p[1] & 0x7f) << 14) |
+		(size_t(p[2] & 0x7f) << 7) | size_t(p[3] & 0x7f);
+}
+
+static constexpr size_t
+ParseUint32BE(const id3_byte_t *p)
+{
+	return (size_t(p[0]) << 24) | (size_t(p[1]) << 16) |
+		(size_t(p[2]) << 8) | size_t(p[3]);
+}
+
+static void
+WriteSyncSafe(id3_byte_t *p, size_t value)
+{
+	p[0] = (value >> 21) & 0x7f;
+	p[1] = (value >> 14) & 0x7f;
+	p[2] = (value >> 7) & 0x7f;
+	p[3] = value & 0x7f;
+}
+
+/**
+ * Is this a frame which none of our ID3 parsers looks at, and which
+ * may be big (pictures, embedded files, private data)?
+ */
+gcc_pure
+static bool
+IsUnwantedId3Frame(const id3_byte_t *id)
+{
+	return memcmp(id, "APIC", 4) == 0 || memcmp(id, "GEOB", 4) == 0 ||
+		memcmp(id, "PRIV", 4) == 0;
+}
+
+/**
+ * Can ReadFilteredId3Tag() handle the tag with this header?  This is
+ * the case for ID3v2.3 and ID3v2.4 tags without an extended header;
+ * an ID3v2.3 tag must not be unsynchronised (in ID3v2.4, the frame
+ * headers are never unsynchronised).
+ */
+gcc_pure
+static bool
+CanFilterId3Tag(const id3_byte_t *header)
+{
+	if (memcmp(header, "ID3", 3) != 0)
+		return false;
+
+	const unsigned version = header[3], flags = header[5];
+	return (version == 3 || version == 4) &&
+		(flags & ID3V2_FLAG_EXTENDED_HEADER) == 0 &&
+		(version == 4 || (flags & ID3V2_FLAG_UNSYNCHRONISATION) == 0);
+}
+
+/**
+ * Read an ID3v2 tag frame by frame, seeking past the frames which
+ * IsUnwantedId3Frame() rejects, so a big embedded picture never gets
+ * loaded into memory.  The remaining frames are passed to libid3tag
+ * together with a patched header.  Afterwards, the stream is
+ * positioned after the tag, just like after reading it in one piece.
+ *
+ * The caller must check CanFilterId3Tag() first.
+ *
+ * @param header the tag header, which has already been read
+ * @param tag_size the total size of the tag as returned by
+ * id3_tag_query()
+ */
+static UniqueId3Tag
+ReadFilteredId3Tag(InputStream &is, const id3_byte_t *header,
+		   size_t tag_size)
+{
+	const bool syncsafe_frame_size = header[3] >= 4;
+	const size_t body_size = ParseSyncSafe(header + 6);
+	const offset_type end = is.GetOffset() - ID3V2_HEADER_SIZE + tag_size;
+
+	std::vector<id3_byte_t> buffer(header, header + ID3V2_HEADER_SIZE);
+
+	size_t position = 0;
+	while (body_size - position >= ID3V2_FRAME_HEADER_SIZE) {
+		id3_byte_t frame_header[ID3V2_FRAME_HEADER_SIZE];
+		if (!is.ReadFull(frame_header, sizeof(frame_header),
+				 IgnoreError()))
+			return nullptr;
+
+		if (frame_header[0] == 0)
+			/* padding */
+			break;
+
+		position += sizeof(frame_header);
+
+		const size_t frame_size = syncsafe_frame_size
+			? ParseSyncSafe(frame_header + 4)
+			: ParseUint32BE(frame_header + 4);
+		if (frame_size > body_size - position)
+			/* malformed; let libid3tag parse what we have */
+			break;
+
+		position += frame_size;
+
+		if (IsUnwantedId3Frame(frame_header)) {
+			if (!is.Skip(frame_size, IgnoreError()))
+				return nullptr;
+			continue;
+		}
+
+		const size_t offset = buffer.size();
+		buffer.resize(offset + sizeof(frame_header) + frame_size);
+		std::copy_n(frame_header, sizeof(frame_header),
+			    &buffer[offset]);
+		if (!is.ReadFull(&buffer[offset + sizeof(frame_header)],
+				 frame_size, IgnoreError()))
+			return nullptr;
+	}
+
+	/* skip the padding and the footer */
+	if (!is.Seek(end, IgnoreError()))
+		return nullptr;
+
+	/* the new tag has no footer, and its size has changed */
+	buffer[5] &= ~ID3V2_FLAG_FOOTER;
+	WriteSyncSafe(&buffer[6], buffer.size() - ID3V2_HEADER_SIZE);
+
+	return UniqueId3Tag(id3_tag_parse(&buffer.front(), buffer.size()));
+}
+
 static UniqueId3Tag
 ReadId3Tag(InputStream &is)
 {
@@ -70,6 +214,10 @@ ReadId3Tag(InputStream &is)
 		/* we have enough data already */
 		return UniqueId3Tag(id3_tag_parse(query_buffer, tag_size));
 
+	if (size_t(tag_size) > ID3V2_FILTER_THRESHOLD &&
+	    is.CheapSeeking() && CanFilterId3Tag(query_buffer))
+		return ReadFilteredId3Tag(is, query_buffer, tag_size);
+
 	std::unique_ptr<id3_byte_t[]> tag_buffer(new id3_byte_t[tag_size]);
 
 	/* copy the start of the tag we already have to the allocated
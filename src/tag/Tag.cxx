@@ -22,10 +22,69 @@
 #include "TagPool.hxx"
 #include "TagBuilder.hxx"
 #include "util/ASCII.hxx"
+#include "util/StringView.hxx"
+#include "util/MemStats.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <new>
 
 #include <assert.h>
 #include <string.h>
 
+/**
+ * The header which precedes each Tag::items array.  The array is
+ * shared by all copies of a #Tag and is freed (releasing the items)
+ * by the last one.
+ */
+struct alignas(TagItem *) TagItemArrayHeader {
+	std::atomic_uint ref;
+
+	/**
+	 * The number of allocated items (for memory accounting).
+	 */
+	unsigned capacity;
+
+	explicit TagItemArrayHeader(unsigned _capacity)
+		:ref(1), capacity(_capacity) {}
+
+	static constexpr size_t GetAllocationSize(unsigned n) {
+		return sizeof(TagItemArrayHeader) + n * sizeof(TagItem *);
+	}
+};
+
+static TagItemArrayHeader &
+GetItemArrayHeader(TagItem **items)
+{
+	return ((TagItemArrayHeader *)items)[-1];
+}
+
+static void
+FreeItemArray(TagItem **items)
+{
+	TagItemArrayHeader *header = &GetItemArrayHeader(items);
+	MemStatsFree(MemStatsCategory::TAG,
+		     TagItemArrayHeader::GetAllocationSize(header->capacity));
+	header->~TagItemArrayHeader();
+	operator delete(header);
+}
+
+/**
+ * Release a reference to the array.  If it was the last one, release
+ * the items and free the array.
+ */
+static void
+ReleaseItemArray(TagItem **items, unsigned n)
+{
+	if (GetItemArrayHeader(items).ref.fetch_sub(1) != 1)
+		return;
+
+	for (unsigned i = 0; i < n; ++i)
+		tag_pool_put_item(items[i]);
+
+	FreeItemArray(items);
+}
+
 TagType
 tag_name_parse(const char *name)
 {
@@ -41,6 +100,27 @@ tag_name_parse(const char *name)
 	return TAG_NUM_OF_ITEM_TYPES;
 }
 
+TagType
+tag_name_parse(StringView name)
+{
+	if (name.IsEmpty())
+		return TAG_NUM_OF_ITEM_TYPES;
+
+	for (unsigned i = 0; i < TAG_NUM_OF_ITEM_TYPES; ++i) {
+		const char *const item = tag_item_names[i];
+		assert(item != nullptr);
+
+		/* compare the first character inline; it rules out
+		   almost all candidates */
+		if (*item == name.front() &&
+		    strncmp(item, name.data, name.size) == 0 &&
+		    item[name.size] == 0)
+			return (TagType)i;
+	}
+
+	return TAG_NUM_OF_ITEM_TYPES;
+}
+
 TagType
 tag_name_parse_i(const char *name)
 {
@@ -62,29 +142,65 @@ Tag::Clear()
 	duration = SignedSongTime::Negative();
 	has_playlist = false;
 
-	tag_pool_lock.lock();
-	for (unsigned i = 0; i < num_items; ++i)
-		tag_pool_put_item(items[i]);
-	tag_pool_lock.unlock();
+	if (items != nullptr) {
+		ReleaseItemArray(items, num_items);
+		items = nullptr;
+	}
 
-	delete[] items;
-	items = nullptr;
 	num_items = 0;
 }
 
 Tag::Tag(const Tag &other)
 	:duration(other.duration), has_playlist(other.has_playlist),
 	 num_items(other.num_items),
-	 items(nullptr)
+	 items(other.items)
+{
+	if (items != nullptr)
+		++GetItemArrayHeader(items).ref;
+}
+
+TagItem **
+Tag::AllocItems(unsigned n)
+{
+	const size_t size = TagItemArrayHeader::GetAllocationSize(n);
+	void *p = operator new(size);
+	TagItemArrayHeader *header = new(p) TagItemArrayHeader(n);
+	MemStatsAllocate(MemStatsCategory::TAG, size);
+	return (TagItem **)(header + 1);
+}
+
+void
+Tag::TakeItems(TagItem **dest)
 {
-	if (num_items > 0) {
-		items = new TagItem *[num_items];
+	if (items == nullptr) {
+		assert(num_items == 0);
+		return;
+	}
+
+	if (GetItemArrayHeader(items).ref.load() == 1) {
+		/* this is the only reference: move the item
+		   references without contacting the tag pool */
+		std::copy_n(items, num_items, dest);
+		FreeItemArray(items);
+	} else {
+		for (unsigned i = 0; i < num_items; ++i)
+			dest[i] = tag_pool_dup_item(items[i]);
 
-		tag_pool_lock.lock();
-		for (unsigned i = 0; i < num_items; i++)
-			items[i] = tag_pool_dup_item(other.items[i]);
-		tag_pool_lock.unlock();
+		ReleaseItemArray(items, num_items);
 	}
+
+	items = nullptr;
+	num_items = 0;
+}
+
+bool
+Tag::Equals(const Tag &other) const
+{
+	return duration == other.duration &&
+		has_playlist == other.has_playlist &&
+		num_items == other.num_items &&
+		std::equal(items, items + num_items, other.items,
+			   tag_pool_item_equals);
 }
 
 Tag *
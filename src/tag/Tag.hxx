@@ -27,6 +27,8 @@
 
 #include <algorithm>
 
+struct StringView;
+
 /**
  * The meta information about a song file.  It is a MPD specific
  * subset of tags (e.g. from ID3, vorbis comments, ...).
@@ -47,7 +49,12 @@ struct Tag {
 	/** the total number of tag items in the #items array */
 	unsigned short num_items;
 
-	/** an array of tag items */
+	/**
+	 * An array of tag items, allocated with AllocItems().  Copies
+	 * of a #Tag share this array (see the copy constructor), and
+	 * therefore it must not be modified once it has been copied;
+	 * the #TagBuilder always allocates a new one.
+	 */
 	TagItem **items;
 
 	/**
@@ -56,6 +63,10 @@ struct Tag {
 	Tag():duration(SignedSongTime::Negative()), has_playlist(false),
 	      num_items(0), items(nullptr) {}
 
+	/**
+	 * Copy the tag.  This only adds a reference to the #items
+	 * array, and does not need to access the #TagPool.
+	 */
 	Tag(const Tag &other);
 
 	Tag(Tag &&other)
@@ -81,6 +92,21 @@ struct Tag {
 		return *this;
 	}
 
+	/**
+	 * Allocate a new (unshared) #items array for the specified
+	 * number of items.
+	 */
+	gcc_malloc
+	static TagItem **AllocItems(unsigned n);
+
+	/**
+	 * Move the references to all items to the specified array
+	 * (which must have room for #num_items pointers), and clear
+	 * the item list of this object.  The caller is responsible
+	 * for releasing them with tag_pool_put_item().
+	 */
+	void TakeItems(TagItem **dest);
+
 	/**
 	 * Similar to the move operator, but move only the #TagItem
 	 * array.
@@ -110,6 +136,13 @@ struct Tag {
 	 */
 	void Clear();
 
+	/**
+	 * Does this object contain the same attributes and items (in
+	 * the same order) as the other one?
+	 */
+	gcc_pure
+	bool Equals(const Tag &other) const;
+
 	/**
 	 * Merges the data from two tags.  If both tags share data for the
 	 * same TagType, only data from "add" is used.
@@ -204,6 +237,14 @@ gcc_pure
 TagType
 tag_name_parse(const char *name);
 
+/**
+ * Like tag_name_parse(), but the name does not need to be
+ * null-terminated.
+ */
+gcc_pure
+TagType
+tag_name_parse(StringView name);
+
 /**
  * Parse the string, and convert it into a #TagType.  Returns
  * #TAG_NUM_OF_ITEM_TYPES if the string could not be recognized.
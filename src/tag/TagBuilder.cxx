@@ -36,25 +36,18 @@ TagBuilder::TagBuilder(const Tag &other)
 {
 	items.reserve(other.num_items);
 
-	tag_pool_lock.lock();
 	for (unsigned i = 0, n = other.num_items; i != n; ++i)
 		items.push_back(tag_pool_dup_item(other.items[i]));
-	tag_pool_lock.unlock();
 }
 
 TagBuilder::TagBuilder(Tag &&other)
 	:duration(other.duration), has_playlist(other.has_playlist)
 {
-	/* move all TagItem pointers from the Tag object; we don't
-	   need to contact the tag pool, because all we do is move
-	   references */
-	items.reserve(other.num_items);
-	std::copy_n(other.items, other.num_items, std::back_inserter(items));
-
-	/* discard the pointers from the Tag object */
-	other.num_items = 0;
-	delete[] other.items;
-	other.items = nullptr;
+	/* move all TagItem pointers from the Tag object; unless its
+	   item array is shared, we don't need to contact the tag
+	   pool, because all we do is move references */
+	items.resize(other.num_items);
+	other.TakeItems(items.data());
 }
 
 TagBuilder &
@@ -66,10 +59,8 @@ TagBuilder::operator=(const TagBuilder &other)
 	items = other.items;
 
 	/* increment the tag pool refcounters */
-	tag_pool_lock.lock();
 	for (auto i : items)
 		tag_pool_dup_item(i);
-	tag_pool_lock.unlock();
 
 	return *this;
 }
@@ -90,17 +81,11 @@ TagBuilder::operator=(Tag &&other)
 	duration = other.duration;
 	has_playlist = other.has_playlist;
 
-	/* move all TagItem pointers from the Tag object; we don't
-	   need to contact the tag pool, because all we do is move
-	   references */
-	items.clear();
-	items.reserve(other.num_items);
-	std::copy_n(other.items, other.num_items, std::back_inserter(items));
-
-	/* discard the pointers from the Tag object */
-	other.num_items = 0;
-	delete[] other.items;
-	other.items = nullptr;
+	/* move all TagItem pointers from the Tag object (see
+	   above) */
+	RemoveAll();
+	items.resize(other.num_items);
+	other.TakeItems(items.data());
 
 	return *this;
 }
@@ -113,29 +98,56 @@ TagBuilder::Clear()
 	RemoveAll();
 }
 
+bool
+TagBuilder::Equals(const Tag &other) const
+{
+	return duration == other.duration &&
+		has_playlist == other.has_playlist &&
+		items.size() == other.num_items &&
+		std::equal(items.begin(), items.end(), other.items,
+			   tag_pool_item_equals);
+}
+
 void
 TagBuilder::Commit(Tag &tag)
 {
+	/* the old item array may be shared with copies of the Tag,
+	   so always allocate a new one */
 	tag.Clear();
 
 	tag.duration = duration;
 	tag.has_playlist = has_playlist;
 
-	/* move all TagItem pointers to the new Tag object without
-	   touching the TagPool reference counters; the
-	   vector::clear() call is important to detach them from this
-	   object */
 	const unsigned n_items = items.size();
-	tag.num_items = n_items;
-	tag.items = new TagItem *[n_items];
-	std::copy_n(items.begin(), n_items, tag.items);
-	items.clear();
+	if (n_items > 0) {
+		tag.items = Tag::AllocItems(n_items);
+		tag.num_items = n_items;
+
+		/* move all TagItem pointers to the new Tag object
+		   without touching the TagPool reference counters;
+		   the vector::clear() call is important to detach
+		   them from this object */
+		std::copy_n(items.begin(), n_items, tag.items);
+		items.clear();
+	}
 
 	/* now ensure that this object is fresh (will not delete any
 	   items because we've already moved them out) */
 	Clear();
 }
 
+bool
+TagBuilder::CommitIfChanged(Tag &tag)
+{
+	if (Equals(tag)) {
+		Clear();
+		return false;
+	}
+
+	Commit(tag);
+	return true;
+}
+
 Tag
 TagBuilder::Commit()
 {
@@ -179,13 +191,11 @@ TagBuilder::Complement(const Tag &other)
 
 	items.reserve(items.size() + other.num_items);
 
-	tag_pool_lock.lock();
 	for (unsigned i = 0, n = other.num_items; i != n; ++i) {
 		TagItem *item = other.items[i];
 		if (!present[item->type])
 			items.push_back(tag_pool_dup_item(item));
 	}
-	tag_pool_lock.unlock();
 }
 
 inline void
@@ -197,9 +207,7 @@ TagBuilder::AddItemInternal(TagType type, StringView value)
 	if (!f.IsNull())
 		value = { f.data, f.size };
 
-	tag_pool_lock.lock();
 	auto i = tag_pool_get_item(type, value);
-	tag_pool_lock.unlock();
 
 	free(f.data);
 
@@ -229,9 +237,7 @@ TagBuilder::AddItem(TagType type, const char *value)
 void
 TagBuilder::AddEmptyItem(TagType type)
 {
-	tag_pool_lock.lock();
 	auto i = tag_pool_get_item(type, StringView::Empty());
-	tag_pool_lock.unlock();
 
 	items.push_back(i);
 }
@@ -239,10 +245,8 @@ TagBuilder::AddEmptyItem(TagType type)
 void
 TagBuilder::RemoveAll()
 {
-	tag_pool_lock.lock();
 	for (auto i : items)
 		tag_pool_put_item(i);
-	tag_pool_lock.unlock();
 
 	items.clear();
 }
@@ -88,12 +88,31 @@ public:
 
 	void Clear();
 
+	/**
+	 * Does this object contain the same attributes and items (in
+	 * the same order) as the given #Tag?
+	 */
+	gcc_pure
+	bool Equals(const Tag &other) const;
+
 	/**
 	 * Move this object to the given #Tag instance.  This object
-	 * is empty afterwards.
+	 * is empty afterwards, but keeps its capacity, so it can be
+	 * reused for the next tag without allocating memory.  The
+	 * #TagItem array of the #Tag is reused if it has the right
+	 * size.
 	 */
 	void Commit(Tag &tag);
 
+	/**
+	 * Like Commit(Tag &), but leave the #Tag alone if it is
+	 * already equal to this object.  This object is empty
+	 * afterwards in both cases.
+	 *
+	 * @return true if the #Tag has been modified
+	 */
+	bool CommitIfChanged(Tag &tag);
+
 	/**
 	 * Create a new #Tag instance from data in this object.  This
 	 * object is empty afterwards.
@@ -20,51 +20,120 @@
 #include "config.h"
 #include "TagPool.hxx"
 #include "TagItem.hxx"
+#include "thread/Mutex.hxx"
 #include "util/Cast.hxx"
 #include "util/VarSize.hxx"
 #include "util/StringView.hxx"
+#include "util/MemStats.hxx"
 
+#include <algorithm>
 #include <limits>
 
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
 
-Mutex tag_pool_lock;
+/**
+ * The pool is split into this many independent hash tables, each
+ * with its own lock, so threads working on different values rarely
+ * contend.  Must be a power of two.
+ */
+static constexpr unsigned NUM_SHARDS = 16;
+
+/**
+ * The number of buckets of a new shard.  Must be a power of two.
+ */
+static constexpr size_t INITIAL_BUCKETS = 256;
 
-static constexpr size_t NUM_SLOTS = 4093;
+/**
+ * A shard doubles its number of buckets when it contains more than
+ * this many items per bucket on average.
+ */
+static constexpr size_t MAX_LOAD_FACTOR = 2;
+
+/**
+ * A shard does not grow beyond this number of buckets.  Must be a
+ * power of two.  See tag_pool_set_max_buckets().
+ */
+static size_t max_shard_buckets = std::numeric_limits<size_t>::max() / 2 + 1;
 
 struct TagPoolSlot {
 	TagPoolSlot *next;
+	unsigned hash;
 	unsigned char ref;
 	TagItem item;
 
 	static constexpr unsigned MAX_REF = std::numeric_limits<decltype(ref)>::max();
 
-	TagPoolSlot(TagPoolSlot *_next, TagType type,
+	TagPoolSlot(TagPoolSlot *_next, unsigned _hash, TagType type,
 		    StringView value)
-		:next(_next), ref(1) {
+		:next(_next), hash(_hash), ref(1) {
 		item.type = type;
 		memcpy(item.value, value.data, value.size);
 		item.value[value.size] = 0;
 	}
 
-	static TagPoolSlot *Create(TagPoolSlot *_next, TagType type,
-				   StringView value);
+	static constexpr size_t GetAllocationSize(size_t value_length) {
+		return sizeof(TagPoolSlot) - sizeof(item.value) +
+			value_length + 1;
+	}
+
+	static TagPoolSlot *Create(TagPoolSlot *_next, unsigned _hash,
+				   TagType type, StringView value);
 } gcc_packed;
 
 TagPoolSlot *
-TagPoolSlot::Create(TagPoolSlot *_next, TagType type,
+TagPoolSlot::Create(TagPoolSlot *_next, unsigned _hash, TagType type,
 		    StringView value)
 {
+	MemStatsAllocate(MemStatsCategory::TAG_POOL,
+			 GetAllocationSize(value.size));
+
 	TagPoolSlot *dummy;
 	return NewVarSize<TagPoolSlot>(sizeof(dummy->item.value),
 				       value.size + 1,
-				       _next, type,
+				       _next, _hash, type,
 				       value);
 }
 
-static TagPoolSlot *slots[NUM_SLOTS];
+/**
+ * One hash table of the pool.  All attributes are protected by
+ * #mutex.
+ */
+struct TagPoolShard {
+	Mutex mutex;
+
+	/**
+	 * The hash table; allocated on the first insertion.  It is
+	 * never freed, because #Tag objects with static storage
+	 * duration may still release their items after the static
+	 * destructors have run.
+	 */
+	TagPoolSlot **buckets = nullptr;
+
+	size_t n_buckets = 0;
+
+	size_t n_items = 0;
+
+	uint64_t lookups = 0, hits = 0;
+
+	TagPoolSlot **GetBucket(unsigned hash) {
+		assert(n_buckets > 0);
+
+		/* the lower bits have already been used to select
+		   the shard */
+		return &buckets[(hash / NUM_SHARDS) & (n_buckets - 1)];
+	}
+
+	TagItem *GetItem(unsigned hash, TagType type, StringView value);
+
+	void Remove(TagPoolSlot *slot);
+
+private:
+	void Resize(size_t new_n_buckets);
+};
+
+static TagPoolShard shards[NUM_SHARDS];
 
 static inline unsigned
 calc_hash(TagType type, StringView p)
@@ -77,17 +146,10 @@ calc_hash(TagType type, StringView p)
 	return hash ^ type;
 }
 
-static inline unsigned
-calc_hash(TagType type, const char *p)
+static inline TagPoolShard &
+GetShard(unsigned hash)
 {
-	unsigned hash = 5381;
-
-	assert(p != nullptr);
-
-	while (*p != 0)
-		hash = (hash << 5) + hash + *p++;
-
-	return hash ^ type;
+	return shards[hash % NUM_SHARDS];
 }
 
 #if CLANG_OR_GCC_VERSION(4,7)
@@ -99,41 +161,111 @@ tag_item_to_slot(TagItem *item)
 	return &ContainerCast(*item, &TagPoolSlot::item);
 }
 
-static inline TagPoolSlot **
-tag_value_slot_p(TagType type, StringView value)
+#if CLANG_OR_GCC_VERSION(4,7)
+	constexpr
+#endif
+static inline const TagPoolSlot *
+tag_item_to_slot(const TagItem *item)
 {
-	return &slots[calc_hash(type, value) % NUM_SLOTS];
+	return &ContainerCast(*item, &TagPoolSlot::item);
 }
 
-static inline TagPoolSlot **
-tag_value_slot_p(TagType type, const char *value)
+void
+TagPoolShard::Resize(size_t new_n_buckets)
 {
-	return &slots[calc_hash(type, value) % NUM_SLOTS];
+	TagPoolSlot **const old_buckets = buckets;
+	const size_t old_n_buckets = n_buckets;
+
+	buckets = new TagPoolSlot *[new_n_buckets]();
+	n_buckets = new_n_buckets;
+
+	if (old_buckets == nullptr)
+		MemStatsAllocate(MemStatsCategory::TAG_POOL,
+				 new_n_buckets * sizeof(*buckets));
+	else
+		MemStatsResize(MemStatsCategory::TAG_POOL,
+			       old_n_buckets * sizeof(*buckets),
+			       new_n_buckets * sizeof(*buckets));
+
+	for (size_t i = 0; i < old_n_buckets; ++i) {
+		TagPoolSlot *slot = old_buckets[i];
+		while (slot != nullptr) {
+			TagPoolSlot *next = slot->next;
+			auto bucket = GetBucket(slot->hash);
+			slot->next = *bucket;
+			*bucket = slot;
+			slot = next;
+		}
+	}
+
+	delete[] old_buckets;
 }
 
 TagItem *
-tag_pool_get_item(TagType type, StringView value)
+TagPoolShard::GetItem(unsigned hash, TagType type, StringView value)
 {
-	auto slot_p = tag_value_slot_p(type, value);
-	for (auto slot = *slot_p; slot != nullptr; slot = slot->next) {
-		if (slot->item.type == type &&
+	++lookups;
+
+	if (buckets == nullptr)
+		Resize(std::min(INITIAL_BUCKETS, max_shard_buckets));
+
+	auto bucket = GetBucket(hash);
+	for (auto slot = *bucket; slot != nullptr; slot = slot->next) {
+		if (slot->hash == hash &&
+		    slot->item.type == type &&
 		    value.Equals(slot->item.value) &&
 		    slot->ref < TagPoolSlot::MAX_REF) {
 			assert(slot->ref > 0);
 			++slot->ref;
+			++hits;
 			return &slot->item;
 		}
 	}
 
-	auto slot = TagPoolSlot::Create(*slot_p, type, value);
-	*slot_p = slot;
+	auto slot = TagPoolSlot::Create(*bucket, hash, type, value);
+	*bucket = slot;
+
+	if (++n_items > n_buckets * MAX_LOAD_FACTOR &&
+	    n_buckets < max_shard_buckets)
+		Resize(n_buckets * 2);
+
 	return &slot->item;
 }
 
+void
+TagPoolShard::Remove(TagPoolSlot *slot)
+{
+	assert(slot->ref == 0);
+	assert(n_items > 0);
+
+	TagPoolSlot **slot_p;
+	for (slot_p = GetBucket(slot->hash);
+	     *slot_p != slot;
+	     slot_p = &(*slot_p)->next) {
+		assert(*slot_p != nullptr);
+	}
+
+	*slot_p = slot->next;
+	--n_items;
+}
+
+TagItem *
+tag_pool_get_item(TagType type, StringView value)
+{
+	const unsigned hash = calc_hash(type, value);
+	auto &shard = GetShard(hash);
+
+	const ScopeLock protect(shard.mutex);
+	return shard.GetItem(hash, type, value);
+}
+
 TagItem *
 tag_pool_dup_item(TagItem *item)
 {
 	TagPoolSlot *slot = tag_item_to_slot(item);
+	auto &shard = GetShard(slot->hash);
+
+	const ScopeLock protect(shard.mutex);
 
 	assert(slot->ref > 0);
 
@@ -144,28 +276,67 @@ tag_pool_dup_item(TagItem *item)
 		/* the reference counter overflows above MAX_REF;
 		   obtain a reference to a different TagPoolSlot which
 		   isn't yet "full" */
-		return tag_pool_get_item(item->type, item->value);
+		return shard.GetItem(slot->hash, item->type, item->value);
 	}
 }
 
 void
 tag_pool_put_item(TagItem *item)
 {
-	TagPoolSlot **slot_p, *slot;
+	TagPoolSlot *slot = tag_item_to_slot(item);
+	auto &shard = GetShard(slot->hash);
 
-	slot = tag_item_to_slot(item);
-	assert(slot->ref > 0);
-	--slot->ref;
+	{
+		const ScopeLock protect(shard.mutex);
 
-	if (slot->ref > 0)
-		return;
+		assert(slot->ref > 0);
+		--slot->ref;
 
-	for (slot_p = tag_value_slot_p(item->type, item->value);
-	     *slot_p != slot;
-	     slot_p = &(*slot_p)->next) {
-		assert(*slot_p != nullptr);
+		if (slot->ref > 0)
+			return;
+
+		shard.Remove(slot);
 	}
 
-	*slot_p = slot->next;
+	MemStatsFree(MemStatsCategory::TAG_POOL,
+		     TagPoolSlot::GetAllocationSize(strlen(slot->item.value)));
 	DeleteVarSize(slot);
 }
+
+bool
+tag_pool_item_equals(const TagItem *a, const TagItem *b)
+{
+	if (a == b)
+		return true;
+
+	/* the same value may live in more than one slot after a
+	   reference counter overflow; the hash (which is immutable
+	   and may be read without a lock) rules out most other
+	   items without comparing the strings */
+	return tag_item_to_slot(a)->hash == tag_item_to_slot(b)->hash &&
+		a->type == b->type && strcmp(a->value, b->value) == 0;
+}
+
+void
+tag_pool_set_max_buckets(size_t max_buckets)
+{
+	size_t n = 1;
+	while (n * 2 <= max_buckets / NUM_SHARDS)
+		n *= 2;
+
+	max_shard_buckets = n;
+}
+
+void
+tag_pool_get_stats(TagPoolStats &stats)
+{
+	stats = TagPoolStats();
+
+	for (auto &shard : shards) {
+		const ScopeLock protect(shard.mutex);
+		stats.items += shard.n_items;
+		stats.buckets += shard.n_buckets;
+		stats.lookups += shard.lookups;
+		stats.hits += shard.hits;
+	}
+}
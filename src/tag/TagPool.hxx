@@ -21,13 +21,39 @@
 #define MPD_TAG_POOL_HXX
 
 #include "TagType.h"
-#include "thread/Mutex.hxx"
+#include "Compiler.h"
 
-extern Mutex tag_pool_lock;
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * The tag pool interns #TagItem instances, so identical values are
+ * stored only once.  It is split into independently locked shards;
+ * all functions are thread-safe and may be called without any lock.
+ */
 
 struct TagItem;
 struct StringView;
 
+struct TagPoolStats {
+	/**
+	 * The number of distinct items in the pool.
+	 */
+	size_t items = 0;
+
+	/**
+	 * The number of hash buckets; items/buckets is the load
+	 * factor.
+	 */
+	size_t buckets = 0;
+
+	/**
+	 * The number of tag_pool_get_item() calls, and how many of
+	 * them found an existing item.
+	 */
+	uint64_t lookups = 0, hits = 0;
+};
+
 TagItem *
 tag_pool_get_item(TagType type, StringView value);
 
@@ -37,4 +63,23 @@ tag_pool_dup_item(TagItem *item);
 void
 tag_pool_put_item(TagItem *item);
 
+/**
+ * Compare two items from the pool.  Equal values are usually shared,
+ * so this is mostly a pointer comparison.
+ */
+gcc_pure
+bool
+tag_pool_item_equals(const TagItem *a, const TagItem *b);
+
+/**
+ * Limit the total number of hash buckets.  The pool keeps accepting
+ * new items beyond that, but lookups become slower.  Must be called
+ * before the first item is added.
+ */
+void
+tag_pool_set_max_buckets(size_t max_buckets);
+
+void
+tag_pool_get_stats(TagPoolStats &stats);
+
 #endif
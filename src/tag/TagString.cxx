@@ -31,7 +31,12 @@ gcc_pure
 static const char *
 FindInvalidUTF8(const char *p, const char *const end)
 {
-	while (p < end) {
+	while (true) {
+		/* skip the ASCII parts quickly */
+		p = FindNonASCII(p, end);
+		if (p == end)
+			break;
+
 		const size_t s = SequenceLengthUTF8(*p);
 		if (p + s > end)
 			/* partial sequence at end of string */
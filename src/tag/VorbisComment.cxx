@@ -19,8 +19,11 @@
 
 #include "config.h"
 #include "VorbisComment.hxx"
+#include "TagHandler.hxx"
 #include "util/ASCII.hxx"
 
+#include <algorithm>
+
 #include <assert.h>
 #include <string.h>
 
@@ -39,3 +42,25 @@ vorbis_comment_value(const char *entry, const char *name)
 
 	return nullptr;
 }
+
+void
+vorbis_comment_invoke_pair(const char *entry,
+			   const TagHandler &handler, void *handler_ctx)
+{
+	assert(entry != nullptr);
+
+	if (handler.pair == nullptr)
+		return;
+
+	const char *eq = strchr(entry, '=');
+	if (eq == nullptr || eq == entry)
+		return;
+
+	char name[256];
+	const size_t length = eq - entry;
+	if (length >= sizeof(name))
+		return;
+
+	*std::copy_n(entry, length, name) = 0;
+	tag_handler_invoke_pair(handler, handler_ctx, name, eq + 1);
+}
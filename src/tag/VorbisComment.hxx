@@ -23,6 +23,8 @@
 #include "check.h"
 #include "Compiler.h"
 
+struct TagHandler;
+
 /**
  * Checks if the specified name matches the entry's name, and if yes,
  * returns the comment value.
@@ -31,4 +33,14 @@ gcc_pure
 const char *
 vorbis_comment_value(const char *entry, const char *name);
 
+/**
+ * Split the entry at the '=' and pass name and value to
+ * TagHandler::pair.  The name is copied to the stack, so this does
+ * not allocate memory; entries with an empty or overlong name are
+ * ignored.
+ */
+void
+vorbis_comment_invoke_pair(const char *entry,
+			   const TagHandler &handler, void *handler_ctx);
+
 #endif
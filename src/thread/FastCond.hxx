@@ -0,0 +1,144 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_THREAD_FAST_COND_HXX
+#define MPD_THREAD_FAST_COND_HXX
+
+#include "Mutex.hxx"
+#include "Cond.hxx"
+
+#include <atomic>
+
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+/**
+ * A wrapper for #Cond optimized for hand-offs between two busy
+ * threads.  signal() and broadcast() skip the system call if no
+ * thread is blocked in wait(), and on SMP machines, wait() polls
+ * for a signal for a short while before blocking.  Like with #Cond,
+ * spurious wakeups are possible.
+ *
+ * Unlike #Cond, the mutex must be held while calling signal() or
+ * broadcast(), or else a wakeup may get lost.
+ */
+class FastCond {
+	/**
+	 * How many times wait() polls for a signal before it
+	 * blocks.
+	 */
+	static constexpr unsigned SPIN_COUNT = 100;
+
+	Cond cond;
+
+	/**
+	 * Incremented by each signal() and broadcast().  wait()
+	 * polls it without holding the mutex.
+	 */
+	std::atomic<unsigned> generation;
+
+	/**
+	 * The number of threads blocked in Cond::wait().  Protected
+	 * by the mutex.
+	 */
+	unsigned sleepers = 0;
+
+public:
+	FastCond():generation(0) {}
+
+	FastCond(const FastCond &other) = delete;
+	FastCond &operator=(const FastCond &other) = delete;
+
+	void signal() {
+		generation.fetch_add(1, std::memory_order_release);
+		if (sleepers > 0)
+			cond.signal();
+	}
+
+	void broadcast() {
+		generation.fetch_add(1, std::memory_order_release);
+		if (sleepers > 0)
+			cond.broadcast();
+	}
+
+	void wait(Mutex &mutex) {
+		const unsigned g = generation.load(std::memory_order_relaxed);
+		if (Spin(mutex, g))
+			return;
+
+		++sleepers;
+		cond.wait(mutex);
+		--sleepers;
+	}
+
+	bool timed_wait(Mutex &mutex, unsigned timeout_ms) {
+		++sleepers;
+		const bool result = cond.timed_wait(mutex, timeout_ms);
+		--sleepers;
+		return result;
+	}
+
+private:
+	static bool IsMultiProcessor() {
+#ifdef WIN32
+		return false;
+#else
+		static const bool smp = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+		return smp;
+#endif
+	}
+
+	static void CpuRelax() {
+#if defined(__i386__) || defined(__x86_64__)
+		__builtin_ia32_pause();
+#elif defined(__aarch64__) || (defined(__ARM_ARCH) && __ARM_ARCH >= 7)
+		asm volatile("yield");
+#endif
+	}
+
+	/**
+	 * Release the mutex and poll for a signal for a short while.
+	 * Returns with the mutex locked.
+	 *
+	 * @return true if a signal has been received since
+	 * #generation had the given value
+	 */
+	bool Spin(Mutex &mutex, unsigned g) {
+		if (IsMultiProcessor()) {
+			mutex.unlock();
+
+			for (unsigned i = 0; i < SPIN_COUNT; ++i) {
+				if (generation.load(std::memory_order_acquire) != g) {
+					mutex.lock();
+					return true;
+				}
+
+				CpuRelax();
+			}
+
+			mutex.lock();
+		}
+
+		return generation.load(std::memory_order_relaxed) != g;
+	}
+};
+
+#endif
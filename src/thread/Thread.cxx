@@ -25,6 +25,11 @@
 #include "java/Global.hxx"
 #endif
 
+#ifndef WIN32
+#include <time.h>
+#include <unistd.h>
+#endif
+
 bool
 Thread::Start(void (*_f)(void *ctx), void *_ctx, Error &error)
 {
@@ -79,6 +84,38 @@ Thread::Join()
 #endif
 }
 
+uint64_t
+Thread::GetCPUTime() const
+{
+	if (!IsDefined())
+		return 0;
+
+#ifdef WIN32
+	FILETIME creation_time, exit_time, kernel_time, user_time;
+	if (!::GetThreadTimes(handle, &creation_time, &exit_time,
+			      &kernel_time, &user_time))
+		return 0;
+
+	/* FILETIME counts 100 nanosecond intervals */
+	const auto to_us = [](const FILETIME &t){
+		return ((uint64_t(t.dwHighDateTime) << 32) |
+			t.dwLowDateTime) / 10;
+	};
+
+	return to_us(kernel_time) + to_us(user_time);
+#elif defined(_POSIX_THREAD_CPUTIME) && _POSIX_THREAD_CPUTIME >= 0
+	clockid_t clock_id;
+	struct timespec ts;
+	if (pthread_getcpuclockid(handle, &clock_id) != 0 ||
+	    clock_gettime(clock_id, &ts) != 0)
+		return 0;
+
+	return uint64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#else
+	return 0;
+#endif
+}
+
 #ifdef WIN32
 
 DWORD WINAPI
@@ -30,6 +30,7 @@
 #endif
 
 #include <assert.h>
+#include <stdint.h>
 
 class Error;
 
@@ -102,6 +103,14 @@ public:
 	bool Start(void (*f)(void *ctx), void *ctx, Error &error);
 	void Join();
 
+	/**
+	 * Returns the CPU time consumed by this thread so far in
+	 * microseconds, or 0 if the thread is not running or if the
+	 * operating system does not provide this information.
+	 */
+	gcc_pure
+	uint64_t GetCPUTime() const;
+
 private:
 #ifdef WIN32
 	static DWORD WINAPI ThreadProc(LPVOID ctx);
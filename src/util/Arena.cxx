@@ -0,0 +1,90 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "Arena.hxx"
+#include "Alloc.hxx"
+
+#include <stdlib.h>
+#include <string.h>
+
+Arena::~Arena()
+{
+	while (head != nullptr) {
+		Block *next = head->next;
+		free(head);
+		head = next;
+	}
+}
+
+void *
+Arena::AllocateSlow(size_t size, size_t)
+{
+	/* the start of a block is aligned for any type; oversized
+	   requests get a block of their own */
+	size_t block_size = size > DEFAULT_BLOCK_SIZE
+		? size
+		: DEFAULT_BLOCK_SIZE;
+
+	Block *block = (Block *)xalloc(sizeof(*block) + block_size);
+	block->next = head;
+	block->size = block_size;
+	block->used = 0;
+	head = block;
+
+	block->used = size;
+	return block->Data();
+}
+
+const char *
+Arena::Dup(const char *s, size_t length)
+{
+	char *p = (char *)Allocate(length + 1, 1);
+	memcpy(p, s, length);
+	p[length] = 0;
+	return p;
+}
+
+const char *
+Arena::Dup(const char *s)
+{
+	return Dup(s, strlen(s));
+}
+
+void
+Arena::Reset()
+{
+	Block *keep = nullptr;
+
+	while (head != nullptr) {
+		Block *next = head->next;
+		if (keep == nullptr && head->size == DEFAULT_BLOCK_SIZE)
+			keep = head;
+		else
+			free(head);
+		head = next;
+	}
+
+	if (keep != nullptr) {
+		keep->next = nullptr;
+		keep->used = 0;
+		head = keep;
+	}
+}
@@ -0,0 +1,146 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_ARENA_HXX
+#define MPD_ARENA_HXX
+
+#include "Compiler.h"
+
+#include <new>
+
+#include <stddef.h>
+
+/**
+ * A simple bump allocator: memory is carved from a chain of blocks
+ * and is never freed individually; Reset() releases everything at
+ * once.  This is meant for short-lived scratch data whose lifetime
+ * is bounded by a well-defined scope (e.g. one command).
+ *
+ * This class is not thread-safe.
+ */
+class Arena {
+	/**
+	 * The header of a block; it is padded so the data following
+	 * it (allocated by malloc()) is suitably aligned for any
+	 * type.
+	 */
+	struct alignas(max_align_t) Block {
+		Block *next;
+		size_t size, used;
+
+		char *Data() {
+			return reinterpret_cast<char *>(this + 1);
+		}
+	};
+
+	static constexpr size_t DEFAULT_BLOCK_SIZE = 16384;
+
+	/**
+	 * The block which is currently being filled; its "next"
+	 * pointer links to older (full) blocks.
+	 */
+	Block *head = nullptr;
+
+public:
+	Arena() = default;
+	~Arena();
+
+	Arena(const Arena &) = delete;
+	Arena &operator=(const Arena &) = delete;
+
+	/**
+	 * Allocate memory.  This never fails; in out-of-memory
+	 * situations, it aborts the process.
+	 *
+	 * @param align a power of two not larger than
+	 * alignof(max_align_t)
+	 */
+	gcc_malloc
+	void *Allocate(size_t size, size_t align=alignof(max_align_t)) {
+		if (head != nullptr) {
+			size_t offset = (head->used + align - 1) & ~(align - 1);
+			if (offset + size <= head->size) {
+				head->used = offset + size;
+				return head->Data() + offset;
+			}
+		}
+
+		return AllocateSlow(size, align);
+	}
+
+	/**
+	 * Copy a string (which need not be null-terminated) into the
+	 * arena and null-terminate it.
+	 */
+	gcc_nonnull_all
+	const char *Dup(const char *s, size_t length);
+
+	gcc_nonnull_all
+	const char *Dup(const char *s);
+
+	/**
+	 * Release all allocations.  One regular-sized block is kept
+	 * for the next round, all others are freed.
+	 */
+	void Reset();
+
+private:
+	gcc_malloc
+	void *AllocateSlow(size_t size, size_t align);
+};
+
+/**
+ * An allocator for standard containers which obtains memory from an
+ * #Arena.  Deallocation is a no-op; the memory is released by
+ * Arena::Reset().
+ */
+template<typename T>
+class ArenaAllocator {
+	template<typename U> friend class ArenaAllocator;
+
+	Arena *arena;
+
+public:
+	typedef T value_type;
+
+	explicit ArenaAllocator(Arena &_arena):arena(&_arena) {}
+
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U> &src):arena(src.arena) {}
+
+	T *allocate(size_t n) {
+		return static_cast<T *>(arena->Allocate(n * sizeof(T),
+							alignof(T)));
+	}
+
+	void deallocate(T *, size_t) {}
+
+	template<typename U>
+	bool operator==(const ArenaAllocator<U> &other) const {
+		return arena == other.arena;
+	}
+
+	template<typename U>
+	bool operator!=(const ArenaAllocator<U> &other) const {
+		return arena != other.arena;
+	}
+};
+
+#endif
@@ -0,0 +1,63 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "CpuFeatures.hxx"
+
+#ifdef HAVE_X86_DISPATCH
+
+/*
+ * __builtin_cpu_init() is usually called by a libgcc constructor;
+ * calling it again is cheap, and it makes these functions usable
+ * from other static initializers.
+ */
+
+bool
+CpuHasSSE2()
+{
+#ifdef __x86_64__
+	return true;
+#else
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse2");
+#endif
+}
+
+bool
+CpuHasSSE41()
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("sse4.1");
+}
+
+bool
+CpuHasAVX()
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx");
+}
+
+bool
+CpuHasAVX2()
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+}
+
+#endif
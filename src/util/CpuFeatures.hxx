@@ -0,0 +1,67 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_CPU_FEATURES_HXX
+#define MPD_CPU_FEATURES_HXX
+
+#include "Compiler.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && \
+	(GCC_CHECK_VERSION(4,9) || CLANG_CHECK_VERSION(3,8))
+/**
+ * Defined if the compiler can build x86 SIMD code with
+ * "__attribute__((target))" and pick it at runtime, without
+ * compiling the whole program with "-msse4.1" or "-mavx2".
+ */
+#define HAVE_X86_DISPATCH
+#endif
+
+#ifdef HAVE_X86_DISPATCH
+
+/**
+ * Does this CPU support SSE2?  This is always true on x86_64.
+ */
+gcc_const
+bool
+CpuHasSSE2();
+
+/**
+ * Does this CPU support SSE4.1?
+ */
+gcc_const
+bool
+CpuHasSSE41();
+
+/**
+ * Does this CPU (and the operating system) support AVX?
+ */
+gcc_const
+bool
+CpuHasAVX();
+
+/**
+ * Does this CPU (and the operating system) support AVX2?
+ */
+gcc_const
+bool
+CpuHasAVX2();
+
+#endif
+
+#endif
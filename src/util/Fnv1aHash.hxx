@@ -0,0 +1,45 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_FNV1A_HASH_HXX
+#define MPD_FNV1A_HASH_HXX
+
+#include "Compiler.h"
+
+#include <stdint.h>
+
+/**
+ * Calculate the 64 bit FNV-1a hash of a null-terminated string.
+ * This is used to make up the names of cache files.
+ */
+gcc_pure
+static inline uint64_t
+Fnv1aHash64(const char *s)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (; *s != 0; ++s) {
+		hash ^= (unsigned char)*s;
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+#endif
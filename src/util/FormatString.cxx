@@ -70,3 +70,25 @@ FormatString(const char *fmt, ...)
 	va_end(args);
 	return p;
 }
+
+const char *
+FormatStringV(char *buffer, size_t size, AllocatedString<> &allocated,
+	      const char *fmt, va_list args)
+{
+#ifndef WIN32
+	va_list tmp;
+	va_copy(tmp, args);
+	const int length = vsnprintf(buffer, size, fmt, tmp);
+	va_end(tmp);
+
+	if (length >= 0 && size_t(length) < size)
+		return buffer;
+#else
+	/* see above */
+	(void)buffer;
+	(void)size;
+#endif
+
+	allocated = FormatStringV(fmt, args);
+	return allocated.c_str();
+}
@@ -23,6 +23,7 @@
 #include "Compiler.h"
 
 #include <stdarg.h>
+#include <stddef.h>
 
 template<typename T> class AllocatedString;
 
@@ -42,4 +43,17 @@ gcc_nonnull(1) gcc_printf(1,2)
 AllocatedString<char>
 FormatString(const char *fmt, ...);
 
+/**
+ * Format into the given buffer if the result fits; otherwise into a
+ * newly allocated string which is stored in #allocated.  This avoids
+ * the heap allocation for the (common) short strings.
+ *
+ * @return the formatted string, pointing into either #buffer or
+ * #allocated
+ */
+gcc_nonnull_all
+const char *
+FormatStringV(char *buffer, size_t size, AllocatedString<char> &allocated,
+	      const char *fmt, va_list args);
+
 #endif
@@ -32,6 +32,7 @@
 #ifdef __linux__
 #include <sys/mman.h>
 #include <unistd.h>
+#include <stdio.h>
 #else
 #include <stdlib.h>
 #endif
@@ -94,4 +95,104 @@ HugeDiscard(void *p, size_t size)
 #endif
 }
 
+/**
+ * Determine the default size of explicit huge pages from
+ * /proc/meminfo.
+ *
+ * @return the size in bytes, or 0 if unknown
+ */
+gcc_pure
+static size_t
+GetHugePageSize()
+{
+	FILE *file = fopen("/proc/meminfo", "r");
+	if (file == nullptr)
+		return 0;
+
+	size_t result = 0;
+	char line[128];
+	unsigned long kb;
+	while (fgets(line, sizeof(line), file) != nullptr) {
+		if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1) {
+			result = size_t(kb) * 1024;
+			break;
+		}
+	}
+
+	fclose(file);
+	return result;
+}
+
+static size_t
+AlignTo(size_t size, size_t alignment)
+{
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+HugeAllocation
+HugeAllocate(size_t size, const HugeAllocateOptions &options)
+{
+	HugeAllocation a;
+
+#ifdef MAP_HUGETLB
+	if (options.huge_pages) {
+		const size_t huge_page_size = GetHugePageSize();
+		if (huge_page_size > 0) {
+			const size_t huge_size = AlignTo(size, huge_page_size);
+			/* no MAP_NORESERVE here: we want mmap() to
+			   fail if not enough huge pages are
+			   available, instead of SIGBUS on access */
+			constexpr int flags = MAP_ANONYMOUS|MAP_PRIVATE|
+				MAP_HUGETLB;
+			void *p = mmap(nullptr, huge_size,
+				       PROT_READ|PROT_WRITE, flags,
+				       -1, 0);
+			if (p != (void *)-1) {
+#ifdef MADV_DONTFORK
+				madvise(p, huge_size, MADV_DONTFORK);
+#endif
+
+				a.data = p;
+				a.size = huge_size;
+				a.page_size = huge_page_size;
+			}
+		}
+	}
+#endif
+
+	if (a.data == nullptr) {
+		/* no explicit huge pages: fall back to the normal
+		   allocation */
+		a.data = HugeAllocate(size);
+		if (a.data == nullptr)
+			return a;
+
+		a.size = AlignToPageSize(size);
+		a.page_size = sysconf(_SC_PAGESIZE);
+	}
+
+	if (options.lock)
+		/* mlock() faults in all pages */
+		a.locked = mlock(a.data, a.size) == 0;
+
+	if (options.prefault && !a.locked && a.page_size > 0) {
+		/* write to each page, so the kernel has to allocate
+		   it now */
+		volatile char *p = (volatile char *)a.data;
+		for (size_t i = 0; i < a.size; i += a.page_size)
+			p[i] = 0;
+	}
+
+	return a;
+}
+
+void
+HugeFree(const HugeAllocation &allocation)
+{
+	if (allocation.locked)
+		munlock(allocation.data, allocation.size);
+
+	munmap(allocation.data, allocation.size);
+}
+
 #endif
@@ -34,6 +34,55 @@
 
 #include <stddef.h>
 
+/**
+ * Options for HugeAllocate(size_t, const HugeAllocateOptions &).
+ */
+struct HugeAllocateOptions {
+	/**
+	 * Try to back the allocation with explicit huge pages
+	 * (MAP_HUGETLB) and fall back to normal pages.
+	 */
+	bool huge_pages = false;
+
+	/**
+	 * Lock the allocation into RAM with mlock().
+	 */
+	bool lock = false;
+
+	/**
+	 * Touch all pages right away, to avoid page faults later.
+	 */
+	bool prefault = false;
+};
+
+/**
+ * An allocation returned by HugeAllocate(size_t, const
+ * HugeAllocateOptions &).
+ */
+struct HugeAllocation {
+	void *data = nullptr;
+
+	/**
+	 * The size of the allocation, rounded up to #page_size.
+	 */
+	size_t size = 0;
+
+	/**
+	 * The size of the pages backing this allocation; 0 if
+	 * unknown.
+	 */
+	size_t page_size = 0;
+
+	/**
+	 * Was mlock() successful?
+	 */
+	bool locked = false;
+
+	bool IsNull() const {
+		return data == nullptr;
+	}
+};
+
 #ifdef __linux__
 
 /**
@@ -63,6 +112,23 @@ HugeFree(void *p, size_t size);
 void
 HugeDiscard(void *p, size_t size);
 
+/**
+ * Allocate a huge amount of memory with the given options.  Huge
+ * pages and locking are only attempted; check the returned object to
+ * find out whether they succeeded.
+ *
+ * @return the allocation; its #data is nullptr on error
+ */
+HugeAllocation
+HugeAllocate(size_t size, const HugeAllocateOptions &options);
+
+/**
+ * Free an allocation returned by HugeAllocate(size_t, const
+ * HugeAllocateOptions &).
+ */
+void
+HugeFree(const HugeAllocation &allocation);
+
 #elif defined(WIN32)
 #include <windows.h>
 
@@ -114,4 +180,34 @@ HugeDiscard(void *, size_t)
 
 #endif
 
+#ifndef __linux__
+
+#include <string.h>
+
+/* huge pages and locking are not implemented on this platform; only
+   prefaulting is supported */
+
+static inline HugeAllocation
+HugeAllocate(size_t size, const HugeAllocateOptions &options)
+{
+	HugeAllocation a;
+	a.data = HugeAllocate(size);
+	if (a.data != nullptr) {
+		a.size = size;
+
+		if (options.prefault)
+			memset(a.data, 0, size);
+	}
+
+	return a;
+}
+
+static inline void
+HugeFree(const HugeAllocation &allocation)
+{
+	HugeFree(allocation.data, allocation.size);
+}
+
+#endif
+
 #endif
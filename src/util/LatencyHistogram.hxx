@@ -0,0 +1,142 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_LATENCY_HISTOGRAM_HXX
+#define MPD_LATENCY_HISTOGRAM_HXX
+
+#include "Compiler.h"
+
+#include <atomic>
+
+#include <stdint.h>
+
+/**
+ * A histogram of durations (or any other non-negative quantity) with
+ * power-of-two buckets.  Add() is lock-free and may be called from
+ * any thread; readers get a snapshot which is good enough for
+ * monitoring, but not necessarily consistent across attributes.
+ */
+class LatencyHistogram {
+public:
+	/**
+	 * Bucket 0 counts zero values, bucket i (i > 0) counts values
+	 * in the range [2^(i-1), 2^i).  The last bucket also counts
+	 * all larger values.
+	 */
+	static constexpr unsigned N_BUCKETS = 40;
+
+private:
+	std::atomic<uint64_t> buckets[N_BUCKETS];
+	std::atomic<uint64_t> count, sum, max;
+
+public:
+	LatencyHistogram() {
+		Reset();
+	}
+
+	LatencyHistogram(const LatencyHistogram &) = delete;
+	LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+	void Reset() {
+		for (auto &i : buckets)
+			i.store(0, std::memory_order_relaxed);
+		count.store(0, std::memory_order_relaxed);
+		sum.store(0, std::memory_order_relaxed);
+		max.store(0, std::memory_order_relaxed);
+	}
+
+	gcc_const
+	static unsigned BucketIndex(uint64_t value) {
+		if (value == 0)
+			return 0;
+
+		const unsigned i = 64 - __builtin_clzll(value);
+		return i < N_BUCKETS ? i : N_BUCKETS - 1;
+	}
+
+	/**
+	 * The largest value counted in the given bucket.
+	 */
+	gcc_const
+	static uint64_t BucketLimit(unsigned i) {
+		return i == 0 ? 0 : (uint64_t(1) << i) - 1;
+	}
+
+	void Add(uint64_t value) {
+		buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+		count.fetch_add(1, std::memory_order_relaxed);
+		sum.fetch_add(value, std::memory_order_relaxed);
+
+		uint64_t old = max.load(std::memory_order_relaxed);
+		while (value > old &&
+		       !max.compare_exchange_weak(old, value,
+						  std::memory_order_relaxed)) {}
+	}
+
+	uint64_t GetCount() const {
+		return count.load(std::memory_order_relaxed);
+	}
+
+	uint64_t GetSum() const {
+		return sum.load(std::memory_order_relaxed);
+	}
+
+	uint64_t GetMax() const {
+		return max.load(std::memory_order_relaxed);
+	}
+
+	uint64_t GetAverage() const {
+		const uint64_t n = GetCount();
+		return n > 0 ? GetSum() / n : 0;
+	}
+
+	uint64_t GetBucket(unsigned i) const {
+		return buckets[i].load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * Estimate a quantile.  The result is the upper limit of the
+	 * bucket containing it, but never more than the maximum.
+	 *
+	 * @param q the quantile in per mille, e.g. 500 for the median
+	 */
+	gcc_pure
+	uint64_t GetQuantile(unsigned q) const {
+		const uint64_t n = GetCount();
+		if (n == 0)
+			return 0;
+
+		/* the rank of the requested value, rounded up */
+		const uint64_t rank = (n * q + 999) / 1000;
+
+		uint64_t seen = 0;
+		for (unsigned i = 0; i < N_BUCKETS; ++i) {
+			seen += GetBucket(i);
+			if (seen >= rank && seen > 0) {
+				const uint64_t limit = BucketLimit(i);
+				const uint64_t m = GetMax();
+				return limit < m ? limit : m;
+			}
+		}
+
+		return GetMax();
+	}
+};
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "MemStats.hxx"
+
+#include <atomic>
+
+bool mem_stats_enabled;
+
+/**
+ * The atomic counterpart of #MemStatsValue.
+ */
+struct MemStatsCounter {
+	std::atomic<int64_t> bytes, objects, peak_bytes;
+
+	void UpdatePeak(int64_t value) {
+		int64_t peak = peak_bytes.load(std::memory_order_relaxed);
+		while (value > peak &&
+		       !peak_bytes.compare_exchange_weak(peak, value,
+							 std::memory_order_relaxed)) {}
+	}
+};
+
+static MemStatsCounter mem_stats[unsigned(MemStatsCategory::MAX)];
+
+static constexpr const char *mem_stats_names[] = {
+	"db_song",
+	"db_directory",
+	"tag",
+	"tag_pool",
+	"queue",
+	"music_buffer",
+	"client_output",
+	"input_buffer",
+	"httpd_page",
+};
+
+static_assert(sizeof(mem_stats_names) / sizeof(mem_stats_names[0]) ==
+	      unsigned(MemStatsCategory::MAX),
+	      "Wrong number of category names");
+
+static inline MemStatsCounter &
+GetCounter(MemStatsCategory category)
+{
+	return mem_stats[unsigned(category)];
+}
+
+void
+mem_stats_enable()
+{
+	mem_stats_enabled = true;
+}
+
+void
+mem_stats_allocate(MemStatsCategory category, size_t size)
+{
+	auto &c = GetCounter(category);
+	c.objects.fetch_add(1, std::memory_order_relaxed);
+	c.UpdatePeak(c.bytes.fetch_add(size, std::memory_order_relaxed)
+		     + size);
+}
+
+void
+mem_stats_free(MemStatsCategory category, size_t size)
+{
+	auto &c = GetCounter(category);
+	c.objects.fetch_sub(1, std::memory_order_relaxed);
+	c.bytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+void
+mem_stats_resize(MemStatsCategory category,
+		 size_t old_size, size_t new_size)
+{
+	auto &c = GetCounter(category);
+	const int64_t delta = int64_t(new_size) - int64_t(old_size);
+	c.UpdatePeak(c.bytes.fetch_add(delta, std::memory_order_relaxed)
+		     + delta);
+}
+
+const char *
+mem_stats_name(MemStatsCategory category)
+{
+	return mem_stats_names[unsigned(category)];
+}
+
+MemStatsValue
+mem_stats_get(MemStatsCategory category)
+{
+	const auto &c = GetCounter(category);
+
+	MemStatsValue value;
+	value.bytes = c.bytes.load(std::memory_order_relaxed);
+	value.objects = c.objects.load(std::memory_order_relaxed);
+	value.peak_bytes = c.peak_bytes.load(std::memory_order_relaxed);
+	return value;
+}
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPD_MEM_STATS_HXX
+#define MPD_MEM_STATS_HXX
+
+#include "Compiler.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The subsystems whose heap usage is tracked by the "memstats"
+ * command.
+ */
+enum class MemStatsCategory {
+	/**
+	 * #Song objects of the "simple" database.
+	 */
+	SONG,
+
+	/**
+	 * #Directory objects of the "simple" database.
+	 */
+	DIRECTORY,
+
+	/**
+	 * The item arrays of all #Tag objects.
+	 */
+	TAG,
+
+	/**
+	 * The items and hash tables of the tag pool.
+	 */
+	TAG_POOL,
+
+	/**
+	 * The arrays and songs of all queues.
+	 */
+	QUEUE,
+
+	/**
+	 * The chunks of the #MusicBuffer which have been touched
+	 * (i.e. which are backed by physical memory).
+	 */
+	MUSIC_BUFFER,
+
+	/**
+	 * The output buffers of all clients.
+	 */
+	CLIENT_OUTPUT,
+
+	/**
+	 * The buffers of all open input streams.
+	 */
+	INPUT_BUFFER,
+
+	/**
+	 * #Page objects of the "httpd" output plugin.
+	 */
+	HTTPD_PAGE,
+
+	MAX
+};
+
+/**
+ * Is memory accounting enabled?  This is set once during startup and
+ * never changes afterwards.
+ */
+extern bool mem_stats_enabled;
+
+/**
+ * Enable memory accounting.  Must be called before any of the
+ * tracked objects are allocated.
+ */
+void
+mem_stats_enable();
+
+void
+mem_stats_allocate(MemStatsCategory category, size_t size);
+
+void
+mem_stats_free(MemStatsCategory category, size_t size);
+
+void
+mem_stats_resize(MemStatsCategory category,
+		 size_t old_size, size_t new_size);
+
+/**
+ * Account for a new allocation.  This is cheap if memory accounting
+ * is disabled, and it may be called from any thread.
+ */
+static inline void
+MemStatsAllocate(MemStatsCategory category, size_t size)
+{
+	if (gcc_unlikely(mem_stats_enabled))
+		mem_stats_allocate(category, size);
+}
+
+/**
+ * Account for freeing an allocation which was passed to
+ * MemStatsAllocate() before.
+ */
+static inline void
+MemStatsFree(MemStatsCategory category, size_t size)
+{
+	if (gcc_unlikely(mem_stats_enabled))
+		mem_stats_free(category, size);
+}
+
+/**
+ * An existing allocation has changed its size.
+ */
+static inline void
+MemStatsResize(MemStatsCategory category, size_t old_size, size_t new_size)
+{
+	if (gcc_unlikely(mem_stats_enabled) && new_size != old_size)
+		mem_stats_resize(category, old_size, new_size);
+}
+
+struct MemStatsValue {
+	/**
+	 * The number of bytes currently allocated.
+	 */
+	int64_t bytes;
+
+	/**
+	 * The number of live allocations.
+	 */
+	int64_t objects;
+
+	/**
+	 * The highest value #bytes has ever had.
+	 */
+	int64_t peak_bytes;
+};
+
+/**
+ * Returns the name of the category as printed by the "memstats"
+ * command.
+ */
+gcc_const
+const char *
+mem_stats_name(MemStatsCategory category);
+
+gcc_pure
+MemStatsValue
+mem_stats_get(MemStatsCategory category);
+
+#endif
@@ -38,6 +38,28 @@ PeakBuffer::IsEmpty() const
 		(peak_buffer == nullptr || peak_buffer->IsEmpty());
 }
 
+size_t
+PeakBuffer::GetAvailable() const
+{
+	size_t result = 0;
+	if (normal_buffer != nullptr)
+		result += normal_buffer->GetAvailable();
+	if (peak_buffer != nullptr)
+		result += peak_buffer->GetAvailable();
+	return result;
+}
+
+size_t
+PeakBuffer::GetAllocatedSize() const
+{
+	size_t result = 0;
+	if (normal_buffer != nullptr)
+		result += normal_size;
+	if (peak_buffer != nullptr)
+		result += peak_size;
+	return result;
+}
+
 WritableBuffer<void>
 PeakBuffer::Read() const
 {
@@ -59,6 +59,20 @@ public:
 	gcc_pure
 	bool IsEmpty() const;
 
+	/**
+	 * Returns the number of bytes which are waiting to be
+	 * consumed.
+	 */
+	gcc_pure
+	size_t GetAvailable() const;
+
+	/**
+	 * Returns the number of bytes currently allocated for the
+	 * buffers.
+	 */
+	gcc_pure
+	size_t GetAllocatedSize() const;
+
 	gcc_pure
 	WritableBuffer<void> Read() const;
 
@@ -0,0 +1,77 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#include "config.h"
+#include "SlabAllocator.hxx"
+#include "Alloc.hxx"
+
+#include <stdlib.h>
+
+void
+SlabAllocator::Clear()
+{
+	/* all objects must be freed explicitly (unless discarding),
+	   and this assertion checks for leaks */
+	assert(n_allocated == 0 || discarding);
+
+	while (slabs != nullptr) {
+		Slab *next = slabs->next;
+		free(slabs);
+		slabs = next;
+	}
+
+	position = end = nullptr;
+
+	for (auto &i : free_lists)
+		i = nullptr;
+
+	n_allocated = 0;
+	discarding = false;
+}
+
+void *
+SlabAllocator::AllocateSlow(size_t rounded)
+{
+	/* the remainder of the current slab is abandoned; it is
+	   smaller than #MAX_SIZE */
+	Slab *slab = (Slab *)xalloc(SLAB_SIZE);
+	slab->next = slabs;
+	slabs = slab;
+
+	position = (char *)(slab + 1);
+	end = (char *)slab + SLAB_SIZE;
+
+	void *p = position;
+	position += rounded;
+	++n_allocated;
+	return p;
+}
+
+void *
+SlabAllocator::AllocateLarge(size_t size)
+{
+	return xalloc(size);
+}
+
+void
+SlabAllocator::FreeLarge(void *p)
+{
+	free(p);
+}
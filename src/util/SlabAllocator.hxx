@@ -0,0 +1,181 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_SLAB_ALLOCATOR_HXX
+#define MPD_SLAB_ALLOCATOR_HXX
+
+#include "Compiler.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+/**
+ * An allocator for many small objects of varying size which are
+ * freed individually.  Memory is carved from big slabs, and freed
+ * slots are kept in one free list per size class, so allocating
+ * and freeing is just a pointer operation.  Unlike #SliceBuffer,
+ * the number of objects is not limited; the slabs are allocated on
+ * demand.  Requests larger than #MAX_SIZE are passed to malloc().
+ *
+ * Slabs are never returned to the heap individually; Clear()
+ * releases all of them at once after all objects have been freed,
+ * or after BeginDiscard().
+ *
+ * This class is not thread-safe.
+ */
+class SlabAllocator {
+	static constexpr size_t GRANULARITY = alignof(max_align_t);
+	static constexpr size_t MAX_SIZE = 512;
+	static constexpr size_t N_CLASSES = MAX_SIZE / GRANULARITY;
+	static constexpr size_t SLAB_SIZE = 256 * 1024;
+
+	struct FreeSlot {
+		FreeSlot *next;
+	};
+
+	/**
+	 * The header of a slab; it is padded so the slots following
+	 * it are suitably aligned for any type.
+	 */
+	struct alignas(max_align_t) Slab {
+		Slab *next;
+	};
+
+	/**
+	 * A linked list of all slabs.
+	 */
+	Slab *slabs = nullptr;
+
+	/**
+	 * The unused remainder of the most recent slab.
+	 */
+	char *position = nullptr, *end = nullptr;
+
+	FreeSlot *free_lists[N_CLASSES] = {};
+
+	/**
+	 * The number of objects currently allocated from slabs.
+	 */
+	size_t n_allocated = 0;
+
+	/**
+	 * Has BeginDiscard() been called?
+	 */
+	bool discarding = false;
+
+public:
+	SlabAllocator() = default;
+
+	~SlabAllocator() {
+		Clear();
+	}
+
+	SlabAllocator(const SlabAllocator &) = delete;
+	SlabAllocator &operator=(const SlabAllocator &) = delete;
+
+	/**
+	 * Allocate memory suitably aligned for any type.  This never
+	 * fails; in out-of-memory situations, it aborts the process.
+	 */
+	gcc_malloc
+	void *Allocate(size_t size) {
+		assert(size > 0);
+
+		if (size > MAX_SIZE)
+			return AllocateLarge(size);
+
+		const size_t i = SizeClass(size);
+		FreeSlot *slot = free_lists[i];
+		if (slot != nullptr) {
+			free_lists[i] = slot->next;
+			++n_allocated;
+			return slot;
+		}
+
+		const size_t rounded = (i + 1) * GRANULARITY;
+		if (size_t(end - position) >= rounded) {
+			void *p = position;
+			position += rounded;
+			++n_allocated;
+			return p;
+		}
+
+		return AllocateSlow(rounded);
+	}
+
+	/**
+	 * Free memory obtained from Allocate().
+	 *
+	 * @param size the size which was passed to Allocate()
+	 */
+	void Free(void *p, size_t size) {
+		assert(p != nullptr);
+		assert(size > 0);
+
+		if (size > MAX_SIZE) {
+			FreeLarge(p);
+			return;
+		}
+
+		if (discarding)
+			/* Clear() will release the slab */
+			return;
+
+		assert(n_allocated > 0);
+		--n_allocated;
+
+		const size_t i = SizeClass(size);
+		FreeSlot *slot = (FreeSlot *)p;
+		slot->next = free_lists[i];
+		free_lists[i] = slot;
+	}
+
+	/**
+	 * Prepare for destroying all objects at once: from now on,
+	 * Free() releases only objects larger than #MAX_SIZE and
+	 * leaves the slabs alone, and Clear() may be called while
+	 * objects are still allocated.  This saves the free list
+	 * bookkeeping when a big set of objects is torn down.
+	 */
+	void BeginDiscard() {
+		discarding = true;
+	}
+
+	/**
+	 * Release all slabs.  All objects must have been freed
+	 * already, unless BeginDiscard() has been called.
+	 */
+	void Clear();
+
+private:
+	static constexpr size_t SizeClass(size_t size) {
+		return (size - 1) / GRANULARITY;
+	}
+
+	gcc_malloc
+	void *AllocateSlow(size_t rounded);
+
+	gcc_malloc
+	static void *AllocateLarge(size_t size);
+
+	static void FreeLarge(void *p);
+};
+
+#endif
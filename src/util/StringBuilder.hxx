@@ -0,0 +1,128 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef MPD_STRING_BUILDER_HXX
+#define MPD_STRING_BUILDER_HXX
+
+#include "Compiler.h"
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Fills a buffer provided by the caller with strings and numbers,
+ * without printf() and without heap allocation.  When the buffer is
+ * full, further input is discarded and IsFull() returns true; the
+ * caller is then expected to fall back to a slower method.
+ */
+class StringBuilder {
+	char *const start, *p, *const end;
+
+	bool full = false;
+
+public:
+	StringBuilder(char *_buffer, size_t _size)
+		:start(_buffer), p(_buffer), end(_buffer + _size) {}
+
+	template<size_t size>
+	explicit StringBuilder(char (&_buffer)[size])
+		:StringBuilder(_buffer, size) {}
+
+	StringBuilder(const StringBuilder &) = delete;
+	StringBuilder &operator=(const StringBuilder &) = delete;
+
+	const char *GetData() const {
+		return start;
+	}
+
+	size_t GetSize() const {
+		return p - start;
+	}
+
+	bool IsFull() const {
+		return full;
+	}
+
+	StringBuilder &Append(const char *s, size_t length) {
+		if (length > size_t(end - p)) {
+			full = true;
+			return *this;
+		}
+
+		memcpy(p, s, length);
+		p += length;
+		return *this;
+	}
+
+	StringBuilder &Append(const char *s) {
+		return Append(s, strlen(s));
+	}
+
+	StringBuilder &Append(char ch) {
+		if (p == end)
+			full = true;
+		else
+			*p++ = ch;
+		return *this;
+	}
+
+	StringBuilder &AppendUnsigned(uintmax_t value) {
+		char buffer[24];
+		char *const buffer_end = buffer + sizeof(buffer);
+		char *q = buffer_end;
+
+		do {
+			*--q = '0' + value % 10;
+			value /= 10;
+		} while (value > 0);
+
+		return Append(q, buffer_end - q);
+	}
+
+	StringBuilder &AppendSigned(intmax_t value) {
+		if (value < 0) {
+			Append('-');
+			return AppendUnsigned(-uintmax_t(value));
+		}
+
+		return AppendUnsigned(value);
+	}
+
+	/**
+	 * Append a number of thousandths with three decimal places,
+	 * e.g. 1234 becomes "1.234".  This is equivalent to "%1.3f"
+	 * for values which are known in milliseconds.
+	 */
+	StringBuilder &AppendMilli(uintmax_t value) {
+		AppendUnsigned(value / 1000);
+		value %= 1000;
+
+		const char buffer[4] = {
+			'.',
+			char('0' + value / 100),
+			char('0' + value / 10 % 10),
+			char('0' + value % 10),
+		};
+
+		return Append(buffer, sizeof(buffer));
+	}
+};
+
+#endif
@@ -32,9 +32,20 @@
 
 #include <string.h>
 
+#include <stddef.h>
+
+/**
+ * Extract the first line from the buffer and null-terminate it in
+ * place.
+ *
+ * @param length_r receives the length of the line (not including the
+ * line terminator)
+ * @return the line, or nullptr if the buffer does not contain a
+ * complete line
+ */
 template<typename B>
 char *
-ReadBufferedLine(B &buffer)
+ReadBufferedLine(B &buffer, size_t &length_r)
 {
 	auto r = buffer.Read();
 	char *newline = reinterpret_cast<char*>(memchr(r.data, '\n', r.size));
@@ -46,7 +57,16 @@ ReadBufferedLine(B &buffer)
 	if (newline > r.data && newline[-1] == '\r')
 		--newline;
 	*newline = 0;
+	length_r = newline - r.data;
 	return r.data;
 }
 
+template<typename B>
+char *
+ReadBufferedLine(B &buffer)
+{
+	size_t length;
+	return ReadBufferedLine(buffer, length);
+}
+
 #endif
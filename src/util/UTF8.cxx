@@ -33,6 +33,40 @@
 
 #include <algorithm>
 
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#ifndef __SSE2__
+
+/*
+ * Without SIMD instructions, blocks are examined one 64 bit word at a
+ * time.
+ */
+
+/**
+ * A 64 bit word with the most significant bit of each byte set.
+ */
+static constexpr uint64_t WORD_HIGH_BITS = 0x8080808080808080ull;
+
+gcc_pure
+static uint64_t
+LoadWord(const char *p)
+{
+	uint64_t word;
+	memcpy(&word, p, sizeof(word));
+	return word;
+}
+
+#endif
+
 /**
  * Is this a leading byte that is followed by 1 continuation byte?
  */
@@ -123,47 +157,64 @@ MakeContinuation(unsigned char value)
 	return 0x80 | (value & 0x3f);
 }
 
+const char *
+FindNonASCII(const char *p, const char *const end)
+{
+#ifdef __AVX2__
+	while (end - p >= 32) {
+		const __m256i v = _mm256_loadu_si256((const __m256i *)p);
+		const unsigned mask = _mm256_movemask_epi8(v);
+		if (mask != 0)
+			return p + __builtin_ctz(mask);
+
+		p += 32;
+	}
+#endif
+
+#ifdef __SSE2__
+	while (end - p >= 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)p);
+		const unsigned mask = _mm_movemask_epi8(v);
+		if (mask != 0)
+			return p + __builtin_ctz(mask);
+
+		p += 16;
+	}
+#else
+	while (end - p >= 8 && (LoadWord(p) & WORD_HIGH_BITS) == 0)
+		p += 8;
+#endif
+
+	while (p < end && IsASCII(*p))
+		++p;
+
+	return p;
+}
+
 bool
 ValidateUTF8(const char *p)
 {
-	for (; *p != 0; ++p) {
-		unsigned char ch = *p;
-		if (IsASCII(ch))
-			continue;
+	return ValidateUTF8(p, strlen(p));
+}
 
-		if (IsContinuation(ch))
-			/* continuation without a prefix */
-			return false;
+bool
+ValidateUTF8(const char *p, size_t length)
+{
+	const char *const end = p + length;
 
-		if (IsLeading1(ch)) {
-			/* 1 continuation */
-			if (!IsContinuation(*++p))
-				return false;
-		} else if (IsLeading2(ch)) {
-			/* 2 continuations */
-			if (!IsContinuation(*++p) || !IsContinuation(*++p))
-				return false;
-		} else if (IsLeading3(ch)) {
-			/* 3 continuations */
-			if (!IsContinuation(*++p) || !IsContinuation(*++p) ||
-			    !IsContinuation(*++p))
-				return false;
-		} else if (IsLeading4(ch)) {
-			/* 4 continuations */
-			if (!IsContinuation(*++p) || !IsContinuation(*++p) ||
-			    !IsContinuation(*++p) || !IsContinuation(*++p))
-				return false;
-		} else if (IsLeading5(ch)) {
-			/* 5 continuations */
-			if (!IsContinuation(*++p) || !IsContinuation(*++p) ||
-			    !IsContinuation(*++p) || !IsContinuation(*++p) ||
-			    !IsContinuation(*++p))
-				return false;
-		} else
+	while (true) {
+		/* only the non-ASCII parts need to be decoded */
+		p = FindNonASCII(p, end);
+		if (p == end)
+			return true;
+
+		const size_t s = SequenceLengthUTF8(*p);
+		if (s == 0 || size_t(end - p) < s ||
+		    SequenceLengthUTF8(p) == 0)
 			return false;
-	}
 
-	return true;
+		p += s;
+	}
 }
 
 size_t
@@ -246,47 +297,41 @@ SequenceLengthUTF8(const char *p)
 		return 0;
 }
 
-static const char *
-FindNonASCIIOrZero(const char *p)
-{
-  while (*p != 0 && IsASCII(*p))
-    ++p;
-  return p;
-}
-
 const char *
 Latin1ToUTF8(const char *gcc_restrict src, char *gcc_restrict buffer,
 	     size_t buffer_size)
 {
-	const char *p = FindNonASCIIOrZero(src);
-	if (*p == 0)
+	const char *const src_end = src + strlen(src);
+	const char *p = FindNonASCII(src, src_end);
+	if (p == src_end)
 		/* everything is plain ASCII, we don't need to convert anything */
 		return src;
 
-	if ((size_t)(p - src) >= buffer_size)
-		/* buffer too small */
-		return nullptr;
-
 	const char *const end = buffer + buffer_size;
-	char *q = std::copy(src, p, buffer);
+	char *q = buffer;
+
+	while (true) {
+		/* copy the ASCII run before the next non-ASCII
+		   character (or the end) */
+		if (size_t(p - src) >= size_t(end - q))
+			/* buffer too small */
+			return nullptr;
+
+		q = std::copy(src, p, q);
 
-	while (*p != 0) {
-		unsigned char ch = *p++;
+		if (p == src_end)
+			break;
 
-		if (IsASCII(ch)) {
-			*q++ = ch;
+		const unsigned char ch = *p++;
+		if (q + 2 >= end)
+			/* buffer too small */
+			return nullptr;
 
-			if (q >= end)
-				/* buffer too small */
-				return nullptr;
-		} else {
-			if (q + 2 >= end)
-				/* buffer too small */
-				return nullptr;
+		*q++ = MakeLeading1(ch >> 6);
+		*q++ = MakeContinuation(ch);
 
-			*q++ = MakeLeading1(ch >> 6);
-			*q++ = MakeContinuation(ch);
-		}
+		src = p;
+		p = FindNonASCII(p, src_end);
 	}
 
 	*q = 0;
@@ -332,14 +377,41 @@ UnicodeToUTF8(unsigned ch, char *q)
 
 size_t
 LengthUTF8(const char *p)
+{
+	return LengthUTF8(p, strlen(p));
+}
+
+size_t
+LengthUTF8(const char *p, size_t length)
 {
 	/* this is a very naive implementation: it does not do any
 	   verification, it just counts the bytes that are not a UTF-8
 	   continuation */
 
-	size_t n = 0;
-	for (; *p != 0; ++p)
-		if (!IsContinuation(*p))
-			++n;
+	size_t n = length;
+
+#ifdef __SSE2__
+	/* continuation bytes (0x80..0xbf) are the signed values
+	   below -64 */
+	const __m128i threshold = _mm_set1_epi8(-64);
+	for (; length >= 16; p += 16, length -= 16) {
+		const __m128i v = _mm_loadu_si128((const __m128i *)p);
+		const unsigned mask =
+			_mm_movemask_epi8(_mm_cmplt_epi8(v, threshold));
+		n -= __builtin_popcount(mask);
+	}
+#else
+	for (; length >= 8; p += 8, length -= 8) {
+		/* bit 7 set and bit 6 clear */
+		const uint64_t word = LoadWord(p);
+		n -= __builtin_popcountll(word & ~(word << 1) &
+					  WORD_HIGH_BITS);
+	}
+#endif
+
+	for (; length > 0; ++p, --length)
+		if (IsContinuation(*p))
+			--n;
+
 	return n;
 }
@@ -35,6 +35,18 @@
 
 #include <stddef.h>
 
+/**
+ * Find the first byte which is not ASCII.  Blocks of ASCII
+ * characters are skipped with SIMD instructions (or one machine word
+ * at a time if there are none).
+ *
+ * @return a pointer to the first non-ASCII byte, or #end if there is
+ * none
+ */
+gcc_pure gcc_nonnull_all
+const char *
+FindNonASCII(const char *p, const char *end);
+
 /**
  * Is this a valid UTF-8 string?
  */
@@ -42,6 +54,14 @@ gcc_pure gcc_nonnull_all
 bool
 ValidateUTF8(const char *p);
 
+/**
+ * Like ValidateUTF8(const char *), but the string does not need to be
+ * null-terminated.
+ */
+gcc_pure gcc_nonnull_all
+bool
+ValidateUTF8(const char *p, size_t length);
+
 /**
  * @return the number of the sequence beginning with the given
  * character, or 0 if the character is not a valid start byte
@@ -87,4 +107,12 @@ gcc_pure gcc_nonnull_all
 size_t
 LengthUTF8(const char *p);
 
+/**
+ * Like LengthUTF8(const char *), but the string does not need to be
+ * null-terminated.
+ */
+gcc_pure gcc_nonnull_all
+size_t
+LengthUTF8(const char *p, size_t length);
+
 #endif
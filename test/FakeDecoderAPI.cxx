@@ -22,9 +22,13 @@
 #include "decoder/DecoderAPI.hxx"
 #include "input/InputStream.hxx"
 #include "util/Error.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
 #include "Compiler.h"
 
+#include <assert.h>
 #include <unistd.h>
+#include <string.h>
 
 void
 decoder_initialized(Decoder &decoder,
@@ -104,6 +108,66 @@ decoder_read_full(Decoder *decoder, InputStream &is,
 	return true;
 }
 
+AudioFormat
+decoder_preferred_format(gcc_unused const Decoder &decoder)
+{
+	return AudioFormat::Undefined();
+}
+
+void *
+decoder_take_context(gcc_unused Decoder &decoder)
+{
+	return nullptr;
+}
+
+void
+decoder_keep_context(gcc_unused Decoder &decoder, void *context,
+		     void (*free_context)(void *context))
+{
+	/* there is no next song */
+	free_context(context);
+}
+
+void
+decoder_cache_lookup(gcc_unused Decoder &decoder, gcc_unused bool hit)
+{
+}
+
+ConstBuffer<void>
+decoder_read_borrow(Decoder *decoder, InputStream &is,
+		    void *buffer, size_t length)
+{
+	{
+		const ScopeLock protect(is.mutex);
+		const auto r = is.ReadDirect(length);
+		if (!r.IsNull())
+			return r;
+	}
+
+	return { buffer, decoder_read(decoder, is, buffer, length) };
+}
+
+const void *
+decoder_read_full_borrow(Decoder *decoder, InputStream &is,
+			 void *_buffer, size_t size)
+{
+	uint8_t *buffer = (uint8_t *)_buffer;
+
+	const auto r = decoder_read_borrow(decoder, is, buffer, size);
+	if (r.IsEmpty())
+		return nullptr;
+
+	if (r.size == size)
+		return r.data;
+
+	if (r.data != buffer)
+		memcpy(buffer, r.data, r.size);
+
+	return decoder_read_full(decoder, is, buffer + r.size, size - r.size)
+		? buffer
+		: nullptr;
+}
+
 bool
 decoder_skip(Decoder *decoder, InputStream &is, size_t size)
 {
@@ -127,7 +191,7 @@ decoder_timestamp(gcc_unused Decoder &decoder,
 }
 
 DecoderCommand
-decoder_data(gcc_unused Decoder &decoder,
+decoder_data(Decoder &decoder,
 	     gcc_unused InputStream *is,
 	     const void *data, size_t datalen,
 	     gcc_unused uint16_t kbit_rate)
@@ -138,10 +202,34 @@ decoder_data(gcc_unused Decoder &decoder,
 		fprintf(stderr, "%u kbit/s\n", kbit_rate);
 	}
 
+	decoder.data_bytes += datalen;
+
 	gcc_unused ssize_t nbytes = write(1, data, datalen);
 	return DecoderCommand::NONE;
 }
 
+DecoderCommand
+decoder_data_begin(gcc_unused Decoder &decoder,
+		   gcc_unused InputStream *is,
+		   gcc_unused size_t min_size,
+		   gcc_unused uint16_t kbit_rate,
+		   WritableBuffer<void> &dest)
+{
+	/* there are no chunks here; let the plugin fall back to
+	   decoder_data() */
+	dest = nullptr;
+	return DecoderCommand::NONE;
+}
+
+DecoderCommand
+decoder_data_commit(gcc_unused Decoder &decoder,
+		    gcc_unused size_t length)
+{
+	/* decoder_data_begin() never returns a buffer */
+	assert(false);
+	gcc_unreachable();
+}
+
 DecoderCommand
 decoder_tag(gcc_unused Decoder &decoder,
 	    gcc_unused InputStream *is,
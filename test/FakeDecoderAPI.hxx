@@ -24,14 +24,21 @@
 #include "thread/Mutex.hxx"
 #include "thread/Cond.hxx"
 
+#include <stdint.h>
+
 struct Decoder {
 	Mutex mutex;
 	Cond cond;
 
 	bool initialized;
 
+	/**
+	 * The number of bytes passed to decoder_data().
+	 */
+	uint64_t data_bytes;
+
 	Decoder()
-		:initialized(false) {}
+		:initialized(false), data_bytes(0) {}
 };
 
 #endif
@@ -0,0 +1,65 @@
+/*
+ * Unit tests for class LatencyHistogram.
+ */
+
+#include "check.h"
+#include "util/LatencyHistogram.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+class TestLatencyHistogram : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TestLatencyHistogram);
+	CPPUNIT_TEST(TestBuckets);
+	CPPUNIT_TEST(TestStatistics);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestBuckets() {
+		CPPUNIT_ASSERT_EQUAL(0u, LatencyHistogram::BucketIndex(0));
+		CPPUNIT_ASSERT_EQUAL(1u, LatencyHistogram::BucketIndex(1));
+		CPPUNIT_ASSERT_EQUAL(2u, LatencyHistogram::BucketIndex(2));
+		CPPUNIT_ASSERT_EQUAL(2u, LatencyHistogram::BucketIndex(3));
+		CPPUNIT_ASSERT_EQUAL(3u, LatencyHistogram::BucketIndex(4));
+		CPPUNIT_ASSERT_EQUAL(11u, LatencyHistogram::BucketIndex(1024));
+		CPPUNIT_ASSERT_EQUAL(LatencyHistogram::N_BUCKETS - 1,
+				     LatencyHistogram::BucketIndex(~uint64_t(0)));
+
+		CPPUNIT_ASSERT_EQUAL(uint64_t(0), LatencyHistogram::BucketLimit(0));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(1), LatencyHistogram::BucketLimit(1));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(3), LatencyHistogram::BucketLimit(2));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(2047),
+				     LatencyHistogram::BucketLimit(11));
+	}
+
+	void TestStatistics() {
+		LatencyHistogram h;
+		CPPUNIT_ASSERT_EQUAL(uint64_t(0), h.GetCount());
+		CPPUNIT_ASSERT_EQUAL(uint64_t(0), h.GetAverage());
+		CPPUNIT_ASSERT_EQUAL(uint64_t(0), h.GetQuantile(500));
+
+		/* 98 small values and two large ones */
+		for (unsigned i = 0; i < 98; ++i)
+			h.Add(10);
+		h.Add(1000);
+		h.Add(5000);
+
+		CPPUNIT_ASSERT_EQUAL(uint64_t(100), h.GetCount());
+		CPPUNIT_ASSERT_EQUAL(uint64_t(98 * 10 + 1000 + 5000),
+				     h.GetSum());
+		CPPUNIT_ASSERT_EQUAL(uint64_t(5000), h.GetMax());
+		CPPUNIT_ASSERT_EQUAL(uint64_t(69), h.GetAverage());
+
+		/* 10 is in bucket [8, 16) */
+		CPPUNIT_ASSERT_EQUAL(uint64_t(15), h.GetQuantile(500));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(15), h.GetQuantile(980));
+		CPPUNIT_ASSERT_EQUAL(uint64_t(1023), h.GetQuantile(990));
+
+		/* the quantile is clamped to the maximum */
+		CPPUNIT_ASSERT_EQUAL(uint64_t(5000), h.GetQuantile(1000));
+
+		h.Reset();
+		CPPUNIT_ASSERT_EQUAL(uint64_t(0), h.GetCount());
+		CPPUNIT_ASSERT_EQUAL(uint64_t(0), h.GetMax());
+	}
+};
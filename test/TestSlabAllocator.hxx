@@ -0,0 +1,147 @@
+/*
+ * Unit tests for class SlabAllocator.
+ */
+
+#include "check.h"
+#include "util/SlabAllocator.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <vector>
+
+#include <stdint.h>
+#include <string.h>
+
+class TestSlabAllocator : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TestSlabAllocator);
+	CPPUNIT_TEST(TestSizeClasses);
+	CPPUNIT_TEST(TestLarge);
+	CPPUNIT_TEST(TestClear);
+	CPPUNIT_TEST(TestDiscard);
+	CPPUNIT_TEST_SUITE_END();
+
+	static bool IsAligned(const void *p) {
+		return uintptr_t(p) % alignof(max_align_t) == 0;
+	}
+
+public:
+	void TestSizeClasses() {
+		SlabAllocator a;
+
+		void *p = a.Allocate(20);
+		void *q = a.Allocate(20);
+		CPPUNIT_ASSERT(IsAligned(p));
+		CPPUNIT_ASSERT(IsAligned(q));
+		CPPUNIT_ASSERT(p != q);
+		memset(p, 0xaa, 20);
+		memset(q, 0xbb, 20);
+		CPPUNIT_ASSERT_EQUAL(0xaa, int(*((unsigned char *)p + 19)));
+
+		/* a freed slot is reused for another size of the same
+		   class, last in first out */
+		a.Free(p, 20);
+		a.Free(q, 20);
+		CPPUNIT_ASSERT(a.Allocate(alignof(max_align_t) * 2) == q);
+		CPPUNIT_ASSERT(a.Allocate(alignof(max_align_t) + 1) == p);
+
+		/* ... but not for a different class */
+		void *r = a.Allocate(1);
+		a.Free(r, 1);
+		void *s = a.Allocate(alignof(max_align_t) * 3);
+		CPPUNIT_ASSERT(s != r);
+		CPPUNIT_ASSERT(a.Allocate(alignof(max_align_t)) == r);
+
+		a.Free(p, 20);
+		a.Free(q, 20);
+		a.Free(r, 1);
+		a.Free(s, alignof(max_align_t) * 3);
+		a.Clear();
+	}
+
+	/**
+	 * Requests above the maximum size class are passed to the
+	 * heap.
+	 */
+	void TestLarge() {
+		SlabAllocator a;
+
+		void *small = a.Allocate(512);
+		void *large = a.Allocate(513);
+		void *huge = a.Allocate(1024 * 1024);
+		CPPUNIT_ASSERT(IsAligned(large));
+		CPPUNIT_ASSERT(IsAligned(huge));
+		memset(large, 0, 513);
+		memset(huge, 0, 1024 * 1024);
+
+		/* a freed large block does not enter a free list */
+		a.Free(large, 513);
+		void *small2 = a.Allocate(512);
+		CPPUNIT_ASSERT(small2 != small);
+		CPPUNIT_ASSERT(small2 != large);
+
+		a.Free(huge, 1024 * 1024);
+		a.Free(small, 512);
+		a.Free(small2, 512);
+		a.Clear();
+	}
+
+	/**
+	 * Fill several slabs, free everything and release the slabs.
+	 * The allocator is usable again after Clear().
+	 */
+	void TestClear() {
+		SlabAllocator a;
+
+		for (unsigned round = 0; round < 2; ++round) {
+			std::vector<void *> v;
+			for (unsigned i = 0; i < 20000; ++i) {
+				void *p = a.Allocate(48);
+				memset(p, i, 48);
+				v.push_back(p);
+			}
+
+			/* no two slots overlap */
+			for (unsigned i = 0; i < v.size(); ++i)
+				CPPUNIT_ASSERT_EQUAL(int((unsigned char)i),
+						     int(*(unsigned char *)v[i]));
+
+			for (void *p : v)
+				a.Free(p, 48);
+
+			a.Clear();
+		}
+	}
+
+	/**
+	 * After BeginDiscard(), Clear() releases objects which are
+	 * still allocated.  Large objects are still freed one by
+	 * one.
+	 */
+	void TestDiscard() {
+		SlabAllocator a;
+
+		std::vector<void *> v;
+		for (unsigned i = 0; i < 20000; ++i)
+			v.push_back(a.Allocate(1 + i % 500));
+
+		void *large = a.Allocate(4096);
+
+		a.BeginDiscard();
+
+		/* this is a no-op for small objects */
+		for (unsigned i = 0; i < v.size(); i += 2)
+			a.Free(v[i], 1 + i % 500);
+
+		a.Free(large, 4096);
+
+		a.Clear();
+
+		/* back to normal operation */
+		void *p = a.Allocate(64);
+		a.Free(p, 64);
+		CPPUNIT_ASSERT(a.Allocate(64) == p);
+		a.Free(p, 64);
+		a.Clear();
+	}
+};
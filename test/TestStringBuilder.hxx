@@ -0,0 +1,62 @@
+/*
+ * Unit tests for class StringBuilder.
+ */
+
+#include "check.h"
+#include "util/StringBuilder.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+#include <stdint.h>
+
+class TestStringBuilder : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TestStringBuilder);
+	CPPUNIT_TEST(TestNumbers);
+	CPPUNIT_TEST(TestFull);
+	CPPUNIT_TEST_SUITE_END();
+
+	static std::string ToString(const StringBuilder &b) {
+		return std::string(b.GetData(), b.GetSize());
+	}
+
+public:
+	void TestNumbers() {
+		char buffer[256];
+		StringBuilder b(buffer);
+		b.AppendUnsigned(0).Append(' ')
+			.AppendUnsigned(1234567890).Append(' ')
+			.AppendUnsigned(UINT64_MAX).Append(' ')
+			.AppendSigned(-42).Append(' ')
+			.AppendSigned(INT64_MIN).Append(' ')
+			.AppendMilli(0).Append(' ')
+			.AppendMilli(1005).Append(' ')
+			.AppendMilli(123456);
+
+		CPPUNIT_ASSERT(!b.IsFull());
+		CPPUNIT_ASSERT_EQUAL(std::string("0 1234567890 "
+						 "18446744073709551615 "
+						 "-42 -9223372036854775808 "
+						 "0.000 1.005 123.456"),
+				     ToString(b));
+	}
+
+	void TestFull() {
+		char buffer[8];
+		StringBuilder b(buffer);
+		b.Append("file: ");
+		CPPUNIT_ASSERT(!b.IsFull());
+
+		b.Append("abc");
+		CPPUNIT_ASSERT(b.IsFull());
+
+		/* the rejected string has not been copied partially */
+		CPPUNIT_ASSERT_EQUAL(std::string("file: "), ToString(b));
+
+		/* smaller strings which still fit are accepted */
+		b.Append('x').Append('y').Append('z');
+		CPPUNIT_ASSERT_EQUAL(std::string("file: xy"), ToString(b));
+	}
+};
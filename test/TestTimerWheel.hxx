@@ -0,0 +1,262 @@
+/*
+ * Unit tests for class TimerWheel.
+ */
+
+#include "check.h"
+#include "event/TimerWheel.hxx"
+#include "event/Loop.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <vector>
+
+class TestTimerWheel : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TestTimerWheel);
+	CPPUNIT_TEST(TestLevel0);
+	CPPUNIT_TEST(TestCascade);
+	CPPUNIT_TEST(TestWrap);
+	CPPUNIT_TEST(TestCancel);
+	CPPUNIT_TEST(TestOrder);
+	CPPUNIT_TEST_SUITE_END();
+
+	/**
+	 * A timer which is only managed by the #TimerWheel under
+	 * test; it is never scheduled on the #EventLoop.
+	 */
+	struct Timer final : TimeoutMonitor {
+		unsigned due_ms;
+
+		Timer(EventLoop &_loop, unsigned _due_ms)
+			:TimeoutMonitor(_loop), due_ms(_due_ms) {}
+
+	protected:
+		void OnTimeout() override {}
+	};
+
+	EventLoop loop;
+
+	static std::vector<Timer *> PopAll(TimerWheel &wheel) {
+		std::vector<Timer *> result;
+		TimeoutMonitor *t;
+		while ((t = wheel.PopReady()) != nullptr)
+			result.push_back(static_cast<Timer *>(t));
+		return result;
+	}
+
+	/**
+	 * Advance to one millisecond before the timer is due and
+	 * check that it has not fired yet, then advance to its due
+	 * time and check that it fires (alone).  Also verify that
+	 * GetTimeout() never overshoots.
+	 */
+	static void CheckFiresAt(TimerWheel &wheel, Timer &timer,
+				 unsigned now_ms) {
+		const int timeout = wheel.GetTimeout(now_ms);
+		CPPUNIT_ASSERT(timeout >= 0);
+		CPPUNIT_ASSERT(unsigned(timeout) <= timer.due_ms - now_ms);
+
+		wheel.Advance(timer.due_ms - 1);
+		CPPUNIT_ASSERT(wheel.PopReady() == nullptr);
+
+		wheel.Advance(timer.due_ms);
+		CPPUNIT_ASSERT(wheel.PopReady() == &timer);
+		CPPUNIT_ASSERT(wheel.PopReady() == nullptr);
+	}
+
+public:
+	void TestLevel0() {
+		TimerWheel wheel(1000);
+		Timer a(loop, 1005), b(loop, 1002), c(loop, 1200);
+		wheel.Add(a, a.due_ms);
+		wheel.Add(b, b.due_ms);
+		wheel.Add(c, c.due_ms);
+		CPPUNIT_ASSERT_EQUAL(2, wheel.GetTimeout(1000));
+
+		wheel.Advance(1001);
+		CPPUNIT_ASSERT(wheel.PopReady() == nullptr);
+
+		wheel.Advance(1002);
+		CPPUNIT_ASSERT(wheel.PopReady() == &b);
+		CPPUNIT_ASSERT(wheel.PopReady() == nullptr);
+
+		wheel.Advance(1300);
+		const auto fired = PopAll(wheel);
+		CPPUNIT_ASSERT_EQUAL(size_t(2), fired.size());
+		CPPUNIT_ASSERT(fired[0] == &a);
+		CPPUNIT_ASSERT(fired[1] == &c);
+		CPPUNIT_ASSERT(wheel.IsEmpty());
+
+		/* a timer which is already due is ready immediately */
+		Timer d(loop, 1300);
+		wheel.Add(d, d.due_ms);
+		CPPUNIT_ASSERT_EQUAL(0, wheel.GetTimeout(1300));
+		CPPUNIT_ASSERT(wheel.PopReady() == &d);
+		CPPUNIT_ASSERT(wheel.IsEmpty());
+	}
+
+	/**
+	 * Timers on each upper level must be cascaded down and fire
+	 * at exactly their due time.
+	 */
+	void TestCascade() {
+		const unsigned start = 100;
+		TimerWheel wheel(start);
+
+		/* one timer per level, each one not aligned to the
+		   level's slot size */
+		Timer t1(loop, start + 300);
+		Timer t2(loop, start + 20000 + 7);
+		Timer t3(loop, start + 2000000 + 33);
+		Timer t4(loop, start + 100000000 + 555);
+		Timer *const timers[] = { &t1, &t2, &t3, &t4 };
+
+		/* add in reverse order */
+		for (unsigned i = 4; i-- > 0;)
+			wheel.Add(*timers[i], timers[i]->due_ms);
+
+		unsigned now = start;
+		for (auto *t : timers) {
+			CheckFiresAt(wheel, *t, now);
+			now = t->due_ms;
+		}
+
+		CPPUNIT_ASSERT(wheel.IsEmpty());
+		CPPUNIT_ASSERT_EQUAL(-1, wheel.GetTimeout(now));
+	}
+
+	/**
+	 * Due times past the end of the 32 bit clock, and slot
+	 * indices of the top level which wrap around.
+	 */
+	void TestWrap() {
+		{
+			const unsigned start = 0xffffff00;
+			TimerWheel wheel(start);
+
+			Timer a(loop, start + 0x80);
+			Timer b(loop, start + 0x180);
+			Timer c(loop, start + 0x5000);
+			wheel.Add(c, c.due_ms);
+			wheel.Add(b, b.due_ms);
+			wheel.Add(a, a.due_ms);
+
+			CheckFiresAt(wheel, a, start);
+			CheckFiresAt(wheel, b, a.due_ms);
+			CheckFiresAt(wheel, c, b.due_ms);
+			CPPUNIT_ASSERT(wheel.IsEmpty());
+		}
+
+		{
+			/* top level slot 60; the timer lands in slot 4
+			   after the clock wraps */
+			const unsigned start = 0xf0000010;
+			TimerWheel wheel(start);
+
+			Timer a(loop, start + 0x20000000);
+			Timer b(loop, start + 0x08000000);
+			wheel.Add(a, a.due_ms);
+			wheel.Add(b, b.due_ms);
+
+			CheckFiresAt(wheel, b, start);
+			CheckFiresAt(wheel, a, b.due_ms);
+			CPPUNIT_ASSERT(wheel.IsEmpty());
+		}
+	}
+
+	void TestCancel() {
+		const unsigned start = 0;
+		TimerWheel wheel(start);
+
+		Timer a(loop, 50);
+		Timer b(loop, 20000 + 100);
+		Timer c(loop, 20000 + 200);
+		Timer d(loop, 3000000);
+		wheel.Add(a, a.due_ms);
+		wheel.Add(b, b.due_ms);
+		wheel.Add(c, c.due_ms);
+		wheel.Add(d, d.due_ms);
+
+		/* cancel a timer on level 0 */
+		wheel.Remove(a);
+
+		/* b and c are on level 2; advance to the slot
+		   boundary, which cascades them down to level 0 */
+		wheel.Advance(20000);
+		CPPUNIT_ASSERT(wheel.PopReady() == nullptr);
+
+		/* cancel a timer after the cascade */
+		wheel.Remove(b);
+
+		/* cancel a timer which is still on an upper level */
+		wheel.Remove(d);
+
+		wheel.Advance(c.due_ms);
+		const auto fired = PopAll(wheel);
+		CPPUNIT_ASSERT_EQUAL(size_t(1), fired.size());
+		CPPUNIT_ASSERT(fired[0] == &c);
+
+		/* cancel a timer which is already in the "ready"
+		   list */
+		Timer e(loop, c.due_ms + 10);
+		wheel.Add(e, e.due_ms);
+		wheel.Advance(e.due_ms);
+		wheel.Remove(e);
+		CPPUNIT_ASSERT(wheel.PopReady() == nullptr);
+
+		wheel.Advance(d.due_ms + 1);
+		CPPUNIT_ASSERT(wheel.PopReady() == nullptr);
+		CPPUNIT_ASSERT(wheel.IsEmpty());
+	}
+
+	/**
+	 * Many timers spread over all levels must fire in the order
+	 * of their due times, and never early.
+	 */
+	void TestOrder() {
+		const unsigned start = 12345;
+		TimerWheel wheel(start);
+
+		std::vector<Timer> timers;
+		timers.reserve(2000);
+
+		unsigned seed = 1;
+		for (unsigned i = 0; i < 2000; ++i) {
+			seed = seed * 1103515245 + 12345;
+			const unsigned shift = (seed >> 8) % 24;
+			seed = seed * 1103515245 + 12345;
+			const unsigned delta = (seed >> 4) & ((2u << shift) - 1);
+			timers.emplace_back(loop, start + delta);
+		}
+
+		for (auto &t : timers)
+			wheel.Add(t, t.due_ms);
+
+		unsigned now = start - 1, last_due = start, n_fired = 0;
+		while (!wheel.IsEmpty()) {
+			int timeout = wheel.GetTimeout(now);
+			CPPUNIT_ASSERT(timeout > 0);
+
+			/* sometimes wake up earlier than necessary, to
+			   check that this doesn't fire anything
+			   early */
+			if (timeout > 2 && timeout % 3 == 1)
+				timeout /= 2;
+
+			const unsigned previous = now;
+			now += timeout;
+			wheel.Advance(now);
+
+			for (auto *t : PopAll(wheel)) {
+				/* not early, not late, and in order */
+				CPPUNIT_ASSERT(t->due_ms <= now);
+				CPPUNIT_ASSERT(t->due_ms > previous);
+				CPPUNIT_ASSERT(t->due_ms >= last_due);
+				last_due = t->due_ms;
+				++n_fired;
+			}
+		}
+
+		CPPUNIT_ASSERT_EQUAL(2000u, n_fired);
+	}
+};
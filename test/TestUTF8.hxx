@@ -0,0 +1,84 @@
+/*
+ * Unit tests for src/util/UTF8.cxx
+ */
+
+#include "check.h"
+#include "util/UTF8.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string>
+
+#include <string.h>
+
+class TestUTF8 : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TestUTF8);
+	CPPUNIT_TEST(TestFindNonASCII);
+	CPPUNIT_TEST(TestValidate);
+	CPPUNIT_TEST(TestLength);
+	CPPUNIT_TEST(TestLatin1);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestFindNonASCII() {
+		/* long enough to cover the SIMD blocks and the tail */
+		std::string s(100, 'a');
+		CPPUNIT_ASSERT(FindNonASCII(s.data(), s.data() + s.size()) ==
+			       s.data() + s.size());
+
+		for (size_t i : {0, 7, 15, 16, 31, 32, 63, 99}) {
+			std::string t = s;
+			t[i] = '\xe4';
+			CPPUNIT_ASSERT(FindNonASCII(t.data(),
+						    t.data() + t.size()) ==
+				       t.data() + i);
+		}
+	}
+
+	void TestValidate() {
+		CPPUNIT_ASSERT(ValidateUTF8(""));
+		CPPUNIT_ASSERT(ValidateUTF8("hello world"));
+		CPPUNIT_ASSERT(ValidateUTF8("K\xc3\xb6nig \xe2\x82\xac"));
+		CPPUNIT_ASSERT(!ValidateUTF8("K\xf6nig"));
+		CPPUNIT_ASSERT(!ValidateUTF8("\x80"));
+
+		/* truncated sequence after a long ASCII prefix */
+		std::string s(40, 'x');
+		s += "\xe2\x82";
+		CPPUNIT_ASSERT(!ValidateUTF8(s.c_str()));
+		s += "\xac";
+		CPPUNIT_ASSERT(ValidateUTF8(s.c_str()));
+		CPPUNIT_ASSERT(!ValidateUTF8(s.data(), s.size() - 1));
+	}
+
+	void TestLength() {
+		CPPUNIT_ASSERT_EQUAL(size_t(0), LengthUTF8(""));
+		CPPUNIT_ASSERT_EQUAL(size_t(5), LengthUTF8("K\xc3\xb6nig"));
+
+		std::string s;
+		for (unsigned i = 0; i < 20; ++i)
+			s += "a\xe2\x82\xac";
+		CPPUNIT_ASSERT_EQUAL(size_t(40), LengthUTF8(s.c_str()));
+	}
+
+	void TestLatin1() {
+		char buffer[64];
+
+		const char *ascii = "plain ASCII";
+		CPPUNIT_ASSERT(Latin1ToUTF8(ascii, buffer, sizeof(buffer)) ==
+			       ascii);
+
+		const char *result = Latin1ToUTF8("K\xf6nig \xe4", buffer,
+						  sizeof(buffer));
+		CPPUNIT_ASSERT(result != nullptr);
+		CPPUNIT_ASSERT_EQUAL(0, strcmp(result,
+					       "K\xc3\xb6nig \xc3\xa4"));
+
+		/* the result needs 9 bytes plus the null terminator */
+		CPPUNIT_ASSERT(Latin1ToUTF8("K\xf6nig \xe4", buffer, 9) ==
+			       nullptr);
+		CPPUNIT_ASSERT(Latin1ToUTF8("K\xf6nig \xe4", buffer, 10) ==
+			       buffer);
+	}
+};
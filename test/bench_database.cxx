@@ -0,0 +1,428 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Benchmark for the #SimpleDatabase with large libraries.  Unless the
+ * database file configured in the "database" block exists already,
+ * it generates a synthetic library (no music files are needed) and
+ * saves it.  Then it loads the file and measures typical queries and
+ * an incremental update.  Each line of output is one measurement:
+ *
+ *   OPERATION MILLISECONDS PEAK_RSS_KB
+ *
+ * MILLISECONDS is the average duration of one iteration; on Linux,
+ * the peak RSS is reset before each operation.
+ */
+
+#include "config.h"
+#include "db/plugins/simple/SimpleDatabasePlugin.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/Song.hxx"
+#include "db/DatabasePlugin.hxx"
+#include "db/DatabaseListener.hxx"
+#include "db/DatabaseLock.hxx"
+#include "db/Selection.hxx"
+#include "db/LightSong.hxx"
+#include "db/Stats.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/ConfigOption.hxx"
+#include "config/Block.hxx"
+#include "tag/TagConfig.hxx"
+#include "tag/TagBuilder.hxx"
+#include "tag/Tag.hxx"
+#include "event/Loop.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileSystem.hxx"
+#include "lib/icu/Init.hxx"
+#include "system/Clock.hxx"
+#include "SongFilter.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <algorithm>
+#include <memory>
+#include <stdexcept>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+static constexpr unsigned FILES_PER_ALBUM = 12;
+
+/**
+ * How often each query is repeated.
+ */
+static constexpr unsigned QUERY_ITERATIONS = 10;
+
+static unsigned n_songs = 100000, n_artists = 5000, n_genres = 50;
+
+class NullDatabaseListener final : public DatabaseListener {
+public:
+	void OnDatabaseModified() override {}
+	void OnDatabaseSongRemoved(const char *) override {}
+};
+
+/**
+ * Reset the peak resident set size ("VmHWM"), so the next
+ * GetPeakRSS() call covers only the following operation.  This is
+ * Linux specific.
+ */
+static void
+ResetPeakRSS()
+{
+#ifdef __GLIBC__
+	/* give freed memory back to the kernel, so it does not count
+	   for the next operation */
+	malloc_trim(0);
+#endif
+
+	FILE *file = fopen("/proc/self/clear_refs", "w");
+	if (file != nullptr) {
+		fputs("5", file);
+		fclose(file);
+	}
+}
+
+static long
+GetPeakRSS()
+{
+	FILE *file = fopen("/proc/self/status", "r");
+	if (file != nullptr) {
+		long result = -1;
+		char line[128];
+		while (fgets(line, sizeof(line), file) != nullptr)
+			if (strncmp(line, "VmHWM:", 6) == 0)
+				result = strtol(line + 6, nullptr, 10);
+
+		fclose(file);
+
+		if (result >= 0)
+			return result;
+	}
+
+	struct rusage usage;
+	return getrusage(RUSAGE_SELF, &usage) == 0
+		? usage.ru_maxrss
+		: 0;
+}
+
+template<typename F>
+static void
+Measure(const char *name, unsigned n, F &&f)
+{
+	ResetPeakRSS();
+
+	const auto start = MonotonicClockUS();
+	for (unsigned i = 0; i < n; ++i)
+		f(i);
+	const auto duration_us = MonotonicClockUS() - start;
+
+	printf("%s %.3f %ld\n", name, duration_us / 1000. / n, GetPeakRSS());
+	fflush(stdout);
+}
+
+static void
+AddSong(Directory &directory, unsigned i, unsigned album, unsigned artist)
+{
+	char buffer[64];
+
+	snprintf(buffer, sizeof(buffer), "%02u - Title %u.flac",
+		 i % FILES_PER_ALBUM + 1, i);
+	Song *song = Song::NewFile(buffer, directory);
+	song->mtime = 1000000000 + i;
+
+	TagBuilder tag;
+
+	snprintf(buffer, sizeof(buffer), "Artist %u", artist);
+	tag.AddItem(TAG_ARTIST, buffer);
+	tag.AddItem(TAG_ALBUM_ARTIST, buffer);
+
+	snprintf(buffer, sizeof(buffer), "Album %u", album);
+	tag.AddItem(TAG_ALBUM, buffer);
+
+	snprintf(buffer, sizeof(buffer), "Title %u", i);
+	tag.AddItem(TAG_TITLE, buffer);
+
+	snprintf(buffer, sizeof(buffer), "Genre %u", album % n_genres);
+	tag.AddItem(TAG_GENRE, buffer);
+
+	snprintf(buffer, sizeof(buffer), "%u", i % FILES_PER_ALBUM + 1);
+	tag.AddItem(TAG_TRACK, buffer);
+
+	snprintf(buffer, sizeof(buffer), "%u", 1970 + album % 50);
+	tag.AddItem(TAG_DATE, buffer);
+
+	tag.SetDuration(SignedSongTime::FromS(120 + i % 300));
+	tag.Commit(song->tag);
+
+	directory.AddSong(song);
+}
+
+/**
+ * Look up (or create) the directory of the given album.
+ */
+static Directory &
+MakeAlbumDirectory(Directory &root, unsigned album, unsigned artist)
+{
+	char buffer[64];
+
+	snprintf(buffer, sizeof(buffer), "Artist %u", artist);
+	Directory &artist_directory = *root.MakeChild(buffer);
+
+	snprintf(buffer, sizeof(buffer), "Album %u", album);
+	return *artist_directory.MakeChild(buffer);
+}
+
+static void
+Generate(Directory &root)
+{
+	const ScopeDatabaseLock protect;
+
+	for (unsigned i = 0; i < n_songs; ++i) {
+		const unsigned album = i / FILES_PER_ALBUM;
+		const unsigned artist = album % n_artists;
+		AddSong(MakeAlbumDirectory(root, album, artist),
+			i, album, artist);
+	}
+}
+
+/**
+ * Simulate an update which has found a small number of new, modified
+ * and deleted files.
+ */
+static void
+UpdateDelta(Directory &root, unsigned n)
+{
+	const ScopeDatabaseLock protect;
+
+	const unsigned n_albums =
+		(n_songs + FILES_PER_ALBUM - 1) / FILES_PER_ALBUM;
+
+	for (unsigned i = 0; i < n; ++i) {
+		const unsigned album = (i * 7919) % n_albums;
+		const unsigned artist = album % n_artists;
+		Directory &directory = MakeAlbumDirectory(root, album, artist);
+
+		/* a deleted file */
+		if (directory.songs.size() > 1) {
+			Song &deleted = directory.songs.back();
+			directory.RemoveSong(&deleted);
+			deleted.Free();
+		}
+
+		/* a modified file */
+		Song &modified = directory.songs.front();
+		TagBuilder tag(modified.tag);
+		tag.AddItem(TAG_COMMENT, "modified");
+		directory.CommitSongTag(modified, tag);
+
+		/* a new file */
+		AddSong(directory, n_songs + i, album, artist);
+	}
+}
+
+static unsigned
+CountSongs(const Database &db, const SongFilter &filter)
+{
+	const DatabaseSelection selection("", true, &filter);
+
+	unsigned n = 0;
+	Error error;
+	if (!db.Visit(selection,
+		      [&n](const LightSong &, Error &){
+			      ++n;
+			      return true;
+		      },
+		      error))
+		throw std::runtime_error(error.GetMessage());
+
+	return n;
+}
+
+static unsigned
+CountUniqueTags(const Database &db, TagType tag_type)
+{
+	const DatabaseSelection selection("", true);
+
+	unsigned n = 0;
+	Error error;
+	if (!db.VisitUniqueTags(selection, tag_type, 0,
+				[&n](const Tag &, Error &){
+					++n;
+					return true;
+				},
+				error))
+		throw std::runtime_error(error.GetMessage());
+
+	return n;
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 2 || argc > 5) {
+		fprintf(stderr,
+			"Usage: bench_database CONFIG [SONGS [ARTISTS [GENRES]]]\n");
+		return EXIT_FAILURE;
+	}
+
+	const Path config_path = Path::FromFS(argv[1]);
+	if (argc > 2)
+		n_songs = strtoul(argv[2], nullptr, 10);
+	if (argc > 3)
+		n_artists = strtoul(argv[3], nullptr, 10);
+	if (argc > 4)
+		n_genres = strtoul(argv[4], nullptr, 10);
+
+	if (n_songs == 0 || n_artists == 0 || n_genres == 0) {
+		fprintf(stderr, "Invalid library size\n");
+		return EXIT_FAILURE;
+	}
+
+	/* initialize MPD */
+
+	Error error;
+	if (!IcuInit(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	config_global_init();
+	ReadConfigFile(config_path);
+	TagLoadConfig();
+
+	const ConfigBlock *block =
+		config_get_block(ConfigBlockOption::DATABASE);
+	if (block == nullptr ||
+	    strcmp(block->GetBlockValue("plugin", "simple"), "simple") != 0) {
+		fprintf(stderr, "No \"simple\" database configured\n");
+		return EXIT_FAILURE;
+	}
+
+	const auto path = block->GetBlockPath("path", error);
+	if (path.IsNull()) {
+		fprintf(stderr, "No database path configured\n");
+		return EXIT_FAILURE;
+	}
+
+	EventLoop event_loop;
+	NullDatabaseListener listener;
+
+	auto open = [&](){
+		Database *db = simple_db_plugin.create(event_loop, listener,
+						       *block, error);
+		if (db == nullptr)
+			throw std::runtime_error(error.GetMessage());
+
+		db->Open();
+		return std::unique_ptr<SimpleDatabase>((SimpleDatabase *)db);
+	};
+
+	std::unique_ptr<SimpleDatabase> db;
+
+	/* generate the library */
+
+	if (!FileExists(path)) {
+		db = open();
+
+		Measure("generate", 1, [&db](unsigned){
+				Generate(db->GetRoot());
+			});
+
+		Measure("save", 1, [&db](unsigned){
+				db->Save();
+			});
+
+		db->Close();
+		db.reset();
+	}
+
+	/* load it */
+
+	Measure("load", 1, [&db, &open](unsigned){
+			db = open();
+		});
+
+	DatabaseStats stats;
+	if (!db->GetStats(DatabaseSelection("", true), stats, error))
+		throw std::runtime_error(error.GetMessage());
+
+	fprintf(stderr, "songs=%u artists=%u albums=%u\n",
+		stats.song_count, stats.artist_count, stats.album_count);
+
+	/* queries */
+
+	Measure("find", QUERY_ITERATIONS, [&db](unsigned i){
+			char buffer[64];
+			snprintf(buffer, sizeof(buffer), "Artist %u",
+				 (i * 7919) % n_artists);
+			CountSongs(*db, SongFilter(TAG_ARTIST, buffer));
+		});
+
+	Measure("search", QUERY_ITERATIONS, [&db](unsigned i){
+			char buffer[64];
+			snprintf(buffer, sizeof(buffer), "title %u",
+				 (i * 7919) % n_songs);
+			CountSongs(*db, SongFilter(LOCATE_TAG_ANY_TYPE,
+						   buffer, true));
+		});
+
+	Measure("list", QUERY_ITERATIONS, [&db](unsigned i){
+			CountUniqueTags(*db, i % 2 == 0 ? TAG_ALBUM : TAG_ARTIST);
+		});
+
+	Measure("count", QUERY_ITERATIONS, [&db](unsigned i){
+			char buffer[64];
+			snprintf(buffer, sizeof(buffer), "Genre %u",
+				 i % n_genres);
+			const SongFilter filter(TAG_GENRE, buffer);
+			DatabaseStats count_stats;
+			Error error2;
+			if (!db->GetStats(DatabaseSelection("", true, &filter),
+					  count_stats, error2))
+				throw std::runtime_error(error2.GetMessage());
+		});
+
+	/* an incremental update touching 0.1% of all songs */
+
+	const unsigned n_delta = std::max(n_songs / 1000, 1u);
+
+	Measure("update_delta", 1, [&db, n_delta](unsigned){
+			UpdateDelta(db->GetRoot(), n_delta);
+		});
+
+	Measure("save_delta", 1, [&db](unsigned){
+			db->Save();
+		});
+
+	db->Close();
+	db.reset();
+
+	config_global_finish();
+	IcuFinish();
+	return EXIT_SUCCESS;
+} catch (const std::exception &e) {
+	LogError(e);
+	return EXIT_FAILURE;
+}
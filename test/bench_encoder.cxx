@@ -0,0 +1,462 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * This program measures the performance of the encoder plugins.
+ * Each line of output is one measurement:
+ *
+ *   ENCODER FORMAT realtime=FACTOR in=BYTES out=BYTES \
+ *     write_us=P50/P99/MAX read_us=P50/P99/MAX \
+ *     allocs=COUNT alloc_bytes=BYTES
+ *
+ * FORMAT is the audio format after the encoder has been opened (some
+ * encoders change it).  The realtime factor is the duration of the
+ * audio data divided by the time it took to encode it.  Latencies
+ * are per call of Encoder::Write() and Encoder::Read(), with
+ * power-of-two resolution.  Allocations are counted only with glibc.
+ *
+ * By default, all encoder plugins are measured with synthetic audio
+ * data in several formats.  Options:
+ *
+ *   -f FORMAT   measure only this audio format
+ *   -i FILE     encode raw PCM data from this file (in the format
+ *               given with "-f", default 44100:16:2)
+ *   -d SECONDS  the duration of synthetic audio data (default 10)
+ *   -c BYTES    the size of each Write() call (default 4096, the
+ *               size of a MPD music chunk)
+ *   -s NAME=VALUE  an encoder setting, e.g. "-s compression=8"
+ */
+
+#include "config.h"
+#include "encoder/EncoderList.hxx"
+#include "encoder/EncoderPlugin.hxx"
+#include "encoder/EncoderInterface.hxx"
+#include "AudioFormat.hxx"
+#include "AudioParser.hxx"
+#include "config/Block.hxx"
+#include "util/LatencyHistogram.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef std::chrono::steady_clock Clock;
+
+#ifdef __GLIBC__
+
+/*
+ * Count all heap allocations (including those of the codec
+ * libraries) by interposing glibc's malloc() entry points.
+ */
+
+extern "C" {
+	void *__libc_malloc(size_t size);
+	void *__libc_calloc(size_t n, size_t size);
+	void *__libc_realloc(void *p, size_t size);
+}
+
+static std::atomic<bool> count_allocations(false);
+static std::atomic<uint64_t> n_allocations, allocated_bytes;
+
+static inline void
+CountAllocation(size_t size)
+{
+	if (count_allocations.load(std::memory_order_relaxed)) {
+		n_allocations.fetch_add(1, std::memory_order_relaxed);
+		allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+	}
+}
+
+void *
+malloc(size_t size) noexcept
+{
+	CountAllocation(size);
+	return __libc_malloc(size);
+}
+
+void *
+calloc(size_t n, size_t size) noexcept
+{
+	CountAllocation(n * size);
+	return __libc_calloc(n, size);
+}
+
+void *
+realloc(void *p, size_t size) noexcept
+{
+	CountAllocation(size);
+	return __libc_realloc(p, size);
+}
+
+#endif
+
+/**
+ * Generate audio data which resembles music more than white noise
+ * does, so the encoders can't take shortcuts but also don't degrade
+ * to their worst case: two tones plus a little noise.
+ */
+static std::vector<uint8_t>
+GenerateSynthetic(AudioFormat format, unsigned seconds)
+{
+	const size_t n_frames = size_t(format.sample_rate) * seconds;
+	const size_t n_samples = n_frames * format.channels;
+	std::vector<uint8_t> data(n_samples * format.GetSampleSize());
+
+	std::minstd_rand engine;
+	std::uniform_real_distribution<float> noise(-0.01, 0.01);
+
+	for (size_t i = 0; i < n_samples; ++i) {
+		const unsigned channel = i % format.channels;
+		const double t = double(i / format.channels) /
+			format.sample_rate;
+		const float value = 0.4 * sin(2 * M_PI * 440 * t) +
+			0.2 * sin(2 * M_PI * 1000.5 * t + channel) +
+			noise(engine);
+
+		switch (format.format) {
+		case SampleFormat::S8:
+			((int8_t *)data.data())[i] = int8_t(value * 0x7f);
+			break;
+
+		case SampleFormat::S16:
+			((int16_t *)data.data())[i] = int16_t(value * 0x7fff);
+			break;
+
+		case SampleFormat::S24_P32:
+			((int32_t *)data.data())[i] = int32_t(value * 0x7fffff);
+			break;
+
+		case SampleFormat::S32:
+			((int32_t *)data.data())[i] = int32_t(value * 0x7fffffff);
+			break;
+
+		case SampleFormat::FLOAT:
+			((float *)data.data())[i] = value;
+			break;
+
+		case SampleFormat::UNDEFINED:
+		case SampleFormat::DSD:
+			abort();
+		}
+	}
+
+	return data;
+}
+
+static std::vector<uint8_t>
+LoadFile(const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	if (file == nullptr) {
+		perror(path);
+		exit(EXIT_FAILURE);
+	}
+
+	std::vector<uint8_t> data;
+	uint8_t buffer[65536];
+	size_t nbytes;
+	while ((nbytes = fread(buffer, 1, sizeof(buffer), file)) > 0)
+		data.insert(data.end(), buffer, buffer + nbytes);
+
+	fclose(file);
+	return data;
+}
+
+static uint64_t
+ToNS(Clock::duration d)
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(d).count();
+}
+
+static void
+PrintLatency(const char *name, const LatencyHistogram &h)
+{
+	printf(" %s=%.1f/%.1f/%.1f", name,
+	       h.GetQuantile(500) / 1000., h.GetQuantile(990) / 1000.,
+	       h.GetMax() / 1000.);
+}
+
+/**
+ * Drain the encoder's output, timing each Read() call.
+ */
+static uint64_t
+ReadAll(Encoder &encoder, LatencyHistogram &read_latency)
+{
+	static uint8_t buffer[32768];
+	uint64_t total = 0;
+
+	while (true) {
+		const auto start = Clock::now();
+		const size_t nbytes = encoder.Read(buffer, sizeof(buffer));
+		read_latency.Add(ToNS(Clock::now() - start));
+
+		if (nbytes == 0)
+			return total;
+
+		total += nbytes;
+	}
+}
+
+static void
+Fail(const char *encoder_name, const char *what, const Error &error)
+{
+	fprintf(stderr, "%s: %s: %s\n", encoder_name, what,
+		error.GetMessage());
+}
+
+/**
+ * @param input raw PCM data in the requested format, or nullptr to
+ * generate synthetic data
+ */
+static void
+Bench(const EncoderPlugin &plugin, const ConfigBlock &block,
+      AudioFormat format, const std::vector<uint8_t> *input,
+      unsigned seconds, size_t chunk_size)
+{
+	Error error;
+	std::unique_ptr<PreparedEncoder> prepared(encoder_init(plugin, block,
+							       error));
+	if (prepared == nullptr) {
+		Fail(plugin.name, "failed to initialize encoder", error);
+		return;
+	}
+
+	const AudioFormat requested = format;
+	std::unique_ptr<Encoder> encoder(prepared->Open(format, error));
+	if (encoder == nullptr) {
+		Fail(plugin.name, "failed to open encoder", error);
+		return;
+	}
+
+	struct audio_format_string af_string;
+	const char *af = audio_format_to_string(format, &af_string);
+
+	if (input != nullptr && format != requested) {
+		/* we can't convert the file contents here */
+		fprintf(stderr, "%s: does not support %s\n",
+			plugin.name, af);
+		return;
+	}
+
+	const std::vector<uint8_t> synthetic = input == nullptr
+		? GenerateSynthetic(format, seconds)
+		: std::vector<uint8_t>();
+	const std::vector<uint8_t> &data = input != nullptr
+		? *input
+		: synthetic;
+
+	const size_t frame_size = format.GetFrameSize();
+	chunk_size -= chunk_size % frame_size;
+	if (chunk_size == 0)
+		chunk_size = frame_size;
+
+	const size_t total_in = data.size() - data.size() % frame_size;
+
+	LatencyHistogram write_latency, read_latency;
+	uint64_t total_out = 0;
+
+#ifdef __GLIBC__
+	n_allocations = 0;
+	allocated_bytes = 0;
+	count_allocations = true;
+#endif
+
+	const auto start = Clock::now();
+
+	for (size_t position = 0; position < total_in;) {
+		const size_t nbytes = std::min(chunk_size,
+					       total_in - position);
+
+		const auto write_start = Clock::now();
+		if (!encoder->Write(data.data() + position, nbytes, error)) {
+			Fail(plugin.name, "Write() failed", error);
+			return;
+		}
+		write_latency.Add(ToNS(Clock::now() - write_start));
+
+		position += nbytes;
+		total_out += ReadAll(*encoder, read_latency);
+	}
+
+	if (!encoder->End(error)) {
+		Fail(plugin.name, "End() failed", error);
+		return;
+	}
+
+	total_out += ReadAll(*encoder, read_latency);
+
+	const std::chrono::duration<double> duration = Clock::now() - start;
+
+#ifdef __GLIBC__
+	count_allocations = false;
+#endif
+
+	const double audio_seconds = double(total_in) /
+		format.GetTimeToSize();
+
+	printf("%s %s realtime=%.1f in=%zu out=%llu",
+	       plugin.name, af, audio_seconds / duration.count(),
+	       total_in, (unsigned long long)total_out);
+	PrintLatency("write_us", write_latency);
+	PrintLatency("read_us", read_latency);
+#ifdef __GLIBC__
+	printf(" allocs=%llu alloc_bytes=%llu",
+	       (unsigned long long)n_allocations.load(),
+	       (unsigned long long)allocated_bytes.load());
+#endif
+	printf("\n");
+	fflush(stdout);
+}
+
+static void
+Usage()
+{
+	fprintf(stderr,
+		"Usage: bench_encoder [-f FORMAT] [-i FILE] [-d SECONDS]"
+		" [-c BYTES] [-s NAME=VALUE]... [ENCODER]...\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *format_string = nullptr, *input_path = nullptr;
+	unsigned seconds = 10;
+	size_t chunk_size = 4096;
+	std::vector<const char *> encoder_names;
+
+	ConfigBlock block;
+	bool have_quality = false;
+
+	for (int i = 1; i < argc; ++i) {
+		const char *arg = argv[i];
+		if (arg[0] != '-') {
+			encoder_names.push_back(arg);
+			continue;
+		}
+
+		if (arg[1] == 0 || arg[2] != 0 || i + 1 >= argc)
+			Usage();
+
+		const char *value = argv[++i];
+
+		switch (arg[1]) {
+		case 'f':
+			format_string = value;
+			break;
+
+		case 'i':
+			input_path = value;
+			break;
+
+		case 'd':
+			seconds = strtoul(value, nullptr, 10);
+			if (seconds == 0)
+				Usage();
+			break;
+
+		case 'c':
+			chunk_size = strtoul(value, nullptr, 10);
+			if (chunk_size == 0)
+				Usage();
+			break;
+
+		case 's':
+			{
+				const char *eq = strchr(value, '=');
+				if (eq == nullptr)
+					Usage();
+
+				const std::string name(value, eq);
+				if (name == "quality" || name == "bitrate")
+					have_quality = true;
+
+				block.AddBlockParam(name.c_str(), eq + 1);
+			}
+			break;
+
+		default:
+			Usage();
+		}
+	}
+
+	if (!have_quality)
+		/* some encoders require "quality" or "bitrate" */
+		block.AddBlockParam("quality", "5.0");
+
+	std::vector<AudioFormat> formats;
+	if (format_string != nullptr) {
+		AudioFormat format;
+		Error error;
+		if (!audio_format_parse(format, format_string, false, error)) {
+			LogError(error, "Failed to parse audio format");
+			return EXIT_FAILURE;
+		}
+
+		formats.push_back(format);
+	} else if (input_path != nullptr) {
+		formats.emplace_back(44100, SampleFormat::S16, 2);
+	} else {
+		formats.emplace_back(44100, SampleFormat::S16, 2);
+		formats.emplace_back(48000, SampleFormat::S24_P32, 2);
+		formats.emplace_back(48000, SampleFormat::FLOAT, 2);
+		formats.emplace_back(96000, SampleFormat::S24_P32, 2);
+		formats.emplace_back(192000, SampleFormat::S24_P32, 2);
+	}
+
+	std::vector<uint8_t> file_data;
+	if (input_path != nullptr)
+		file_data = LoadFile(input_path);
+
+	std::vector<const EncoderPlugin *> plugins;
+	if (encoder_names.empty()) {
+		encoder_plugins_for_each(plugin)
+			plugins.push_back(plugin);
+	} else {
+		for (const char *name : encoder_names) {
+			const auto plugin = encoder_plugin_get(name);
+			if (plugin == nullptr) {
+				fprintf(stderr, "No such encoder: %s\n", name);
+				return EXIT_FAILURE;
+			}
+
+			plugins.push_back(plugin);
+		}
+	}
+
+	for (const auto *plugin : plugins)
+		for (const auto &format : formats)
+			Bench(*plugin, block, format,
+			      input_path != nullptr ? &file_data : nullptr,
+			      seconds, chunk_size);
+
+	return EXIT_SUCCESS;
+}
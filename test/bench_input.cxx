@@ -0,0 +1,430 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * Benchmark for input plugins.  It opens each URI (with any input
+ * plugin: file, curl, nfs, smb, archive, ...), reads it and performs
+ * random seeks, optionally in several concurrent streams, and prints
+ * the open latency, the sustained throughput, the seek latency and
+ * the CPU time per megabyte.
+ *
+ * The input plugins can be configured with a configuration file, so
+ * buffer sizes and other settings can be compared against the same
+ * backend.
+ */
+
+#include "config.h"
+#include "ScopeIOThread.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "input/InputStream.hxx"
+#include "input/Init.hxx"
+#include "thread/Thread.hxx"
+#include "thread/Mutex.hxx"
+#include "thread/Cond.hxx"
+#include "system/Clock.hxx"
+#include "fs/Path.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+
+#ifdef ENABLE_ARCHIVE
+#include "archive/ArchiveList.hxx"
+#endif
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+struct BenchOptions {
+	/**
+	 * The number of concurrent streams per URI.
+	 */
+	unsigned streams = 1;
+
+	/**
+	 * How often each stream opens each URI; opening the same
+	 * URI again shows the effect of connection reuse.
+	 */
+	unsigned repeat = 1;
+
+	/**
+	 * The number of random seeks after reading.
+	 */
+	unsigned seeks = 16;
+
+	/**
+	 * The size of each Read() call.
+	 */
+	size_t block_size = 64 * 1024;
+
+	/**
+	 * Stop reading after this many bytes; 0 means read until the
+	 * end of the stream.
+	 */
+	uint64_t limit = 0;
+};
+
+/**
+ * Collects latencies (in microseconds).
+ */
+struct LatencyStats {
+	unsigned n = 0;
+	uint64_t total = 0, max = 0;
+
+	void Add(uint64_t us) {
+		++n;
+		total += us;
+		max = std::max(max, us);
+	}
+
+	void Add(const LatencyStats &other) {
+		n += other.n;
+		total += other.total;
+		max = std::max(max, other.max);
+	}
+
+	void Print(const char *name) const {
+		if (n == 0)
+			return;
+
+		printf("%s_ms: avg=%.3f max=%.3f n=%u\n", name,
+		       total / 1000. / n, max / 1000., n);
+	}
+};
+
+struct UriStats {
+	LatencyStats open, seek;
+
+	/**
+	 * The number of bytes read sequentially, and the time it
+	 * took (not including Open() and the seeks).
+	 */
+	uint64_t bytes = 0, read_us = 0;
+
+	unsigned errors = 0;
+
+	void Add(const UriStats &other) {
+		open.Add(other.open);
+		seek.Add(other.seek);
+		bytes += other.bytes;
+		read_us += other.read_us;
+		errors += other.errors;
+	}
+};
+
+/**
+ * A simple deterministic PRNG (xorshift) for the seek offsets, so
+ * runs with different settings seek to the same positions.
+ */
+class SeekRandom {
+	uint64_t state;
+
+public:
+	explicit SeekRandom(uint64_t seed):state(seed * 2654435761u + 1) {}
+
+	uint64_t Next() {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+		return state;
+	}
+};
+
+static bool
+ReadStream(InputStream &is, const BenchOptions &options,
+	   void *buffer, UriStats &stats, Error &error)
+{
+	const auto start = MonotonicClockUS();
+
+	uint64_t bytes = 0;
+	while (options.limit == 0 || bytes < options.limit) {
+		size_t nbytes = is.LockRead(buffer, options.block_size,
+					    error);
+		if (nbytes == 0) {
+			if (error.IsDefined())
+				return false;
+			break;
+		}
+
+		bytes += nbytes;
+	}
+
+	stats.bytes += bytes;
+	stats.read_us += MonotonicClockUS() - start;
+	return true;
+}
+
+/**
+ * Seek to random positions and measure how long it takes until the
+ * first block is available there.
+ */
+static bool
+SeekStream(InputStream &is, const BenchOptions &options,
+	   SeekRandom &random, void *buffer, UriStats &stats, Error &error)
+{
+	is.Lock();
+	const bool seekable = is.IsSeekable() && is.KnownSize();
+	const auto size = seekable ? is.GetSize() : 0;
+	is.Unlock();
+
+	if (!seekable || size == 0)
+		return true;
+
+	for (unsigned i = 0; i < options.seeks; ++i) {
+		const InputStream::offset_type offset =
+			random.Next() % uint64_t(size);
+
+		const auto start = MonotonicClockUS();
+		if (!is.LockSeek(offset, error))
+			return false;
+
+		if (is.LockRead(buffer, options.block_size, error) == 0 &&
+		    error.IsDefined())
+			return false;
+
+		stats.seek.Add(MonotonicClockUS() - start);
+	}
+
+	return true;
+}
+
+static void
+BenchUri(const char *uri, const BenchOptions &options,
+	 SeekRandom &random, void *buffer, UriStats &stats)
+{
+	Mutex mutex;
+	Cond cond;
+	Error error;
+
+	const auto start = MonotonicClockUS();
+	auto is = InputStream::OpenReady(uri, mutex, cond, error);
+	if (!is) {
+		if (error.IsDefined())
+			LogError(error);
+		else
+			fprintf(stderr, "Failed to open %s\n", uri);
+		++stats.errors;
+		return;
+	}
+
+	stats.open.Add(MonotonicClockUS() - start);
+
+	if (!ReadStream(*is, options, buffer, stats, error) ||
+	    !SeekStream(*is, options, random, buffer, stats, error)) {
+		LogError(error);
+		++stats.errors;
+	}
+}
+
+struct StreamContext {
+	const BenchOptions *options;
+	const std::vector<const char *> *uris;
+	unsigned index;
+
+	/**
+	 * One entry per URI.
+	 */
+	std::vector<UriStats> stats;
+
+	Thread thread;
+};
+
+static void
+StreamThread(void *_ctx)
+{
+	StreamContext &ctx = *(StreamContext *)_ctx;
+	const BenchOptions &options = *ctx.options;
+
+	std::unique_ptr<char[]> buffer(new char[options.block_size]);
+	SeekRandom random(ctx.index);
+
+	for (unsigned r = 0; r < options.repeat; ++r)
+		for (size_t i = 0; i < ctx.uris->size(); ++i)
+			BenchUri((*ctx.uris)[i], options, random,
+				 buffer.get(), ctx.stats[i]);
+}
+
+static uint64_t
+GetCpuTimeUS()
+{
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) < 0)
+		return 0;
+
+	return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000ull +
+		usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+static void
+PrintUsage()
+{
+	fprintf(stderr,
+		"Usage: bench_input [--config=FILE] [--streams=N] [--repeat=N]\n"
+		"                   [--seeks=N] [--block=BYTES] [--limit=BYTES]\n"
+		"                   URI...\n");
+}
+
+static unsigned long long
+ParseOptionValue(const char *value)
+{
+	char *endptr;
+	unsigned long long result = strtoull(value, &endptr, 10);
+	if (endptr == value || *endptr != 0)
+		throw std::runtime_error(std::string("Not a number: ") + value);
+	return result;
+}
+
+int
+main(int argc, char **argv)
+try {
+	BenchOptions options;
+	const char *config_file = nullptr;
+	std::vector<const char *> uris;
+
+	for (int i = 1; i < argc; ++i) {
+		const char *arg = argv[i];
+		if (strncmp(arg, "--config=", 9) == 0)
+			config_file = arg + 9;
+		else if (strncmp(arg, "--streams=", 10) == 0)
+			options.streams = ParseOptionValue(arg + 10);
+		else if (strncmp(arg, "--repeat=", 9) == 0)
+			options.repeat = ParseOptionValue(arg + 9);
+		else if (strncmp(arg, "--seeks=", 8) == 0)
+			options.seeks = ParseOptionValue(arg + 8);
+		else if (strncmp(arg, "--block=", 8) == 0)
+			options.block_size = ParseOptionValue(arg + 8);
+		else if (strncmp(arg, "--limit=", 8) == 0)
+			options.limit = ParseOptionValue(arg + 8);
+		else if (arg[0] == '-') {
+			PrintUsage();
+			return EXIT_FAILURE;
+		} else
+			uris.push_back(arg);
+	}
+
+	if (uris.empty() || options.streams == 0 || options.block_size == 0) {
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	/* initialize MPD */
+
+	config_global_init();
+	if (config_file != nullptr)
+		ReadConfigFile(Path::FromFS(config_file));
+
+	const ScopeIOThread io_thread;
+
+#ifdef ENABLE_ARCHIVE
+	archive_plugin_init_all();
+#endif
+
+	Error error;
+	if (!input_stream_global_init(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	/* run all streams concurrently */
+
+	std::vector<StreamContext> streams(options.streams);
+	for (unsigned i = 0; i < options.streams; ++i) {
+		StreamContext &ctx = streams[i];
+		ctx.options = &options;
+		ctx.uris = &uris;
+		ctx.index = i;
+		ctx.stats.resize(uris.size());
+	}
+
+	const auto cpu_before = GetCpuTimeUS();
+	const auto start = MonotonicClockUS();
+
+	for (auto &ctx : streams) {
+		if (!ctx.thread.Start(StreamThread, &ctx, error)) {
+			LogError(error);
+			return EXIT_FAILURE;
+		}
+	}
+
+	for (auto &ctx : streams)
+		ctx.thread.Join();
+
+	const auto duration_us = MonotonicClockUS() - start;
+	const auto cpu_us = GetCpuTimeUS() - cpu_before;
+
+	/* report */
+
+	UriStats total;
+	for (size_t i = 0; i < uris.size(); ++i) {
+		UriStats stats;
+		for (const auto &ctx : streams)
+			stats.Add(ctx.stats[i]);
+
+		printf("uri: %s\n", uris[i]);
+		stats.open.Print("open");
+		printf("bytes: %llu\n", (unsigned long long)stats.bytes);
+		if (stats.read_us > 0)
+			/* average per stream, because the streams
+			   overlap */
+			printf("stream_mb_per_second: %.2f\n",
+			       stats.bytes / (double)stats.read_us);
+		stats.seek.Print("seek");
+		if (stats.errors > 0)
+			printf("errors: %u\n", stats.errors);
+
+		total.Add(stats);
+	}
+
+	const double seconds = duration_us / 1000000.;
+	printf("streams: %u\n", options.streams);
+	printf("seconds: %.3f\n", seconds);
+	if (seconds > 0)
+		printf("total_mb_per_second: %.2f\n",
+		       total.bytes / 1000000. / seconds);
+
+	/* the CPU time includes the I/O thread and all threads
+	   created by the input plugins */
+	printf("cpu_seconds: %.3f\n", cpu_us / 1000000.);
+	if (total.bytes > 0)
+		printf("cpu_ms_per_mb: %.3f\n",
+		       cpu_us / 1000. / (total.bytes / 1000000.));
+
+	/* deinitialize everything */
+
+	input_stream_global_finish();
+
+#ifdef ENABLE_ARCHIVE
+	archive_plugin_deinit_all();
+#endif
+
+	config_global_finish();
+
+	return total.errors > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+} catch (const std::exception &e) {
+	LogError(e);
+	return EXIT_FAILURE;
+}
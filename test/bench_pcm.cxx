@@ -0,0 +1,547 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * This program measures the throughput of the PCM library kernels.
+ * Each line of output is one measurement:
+ *
+ *   KERNEL VARIANT SAMPLES_PER_SECOND
+ *
+ * "Samples" are input samples (frames multiplied by channels).  Pass
+ * a kernel name to run only the measurements of that kernel.
+ */
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "pcm/PcmConvert.hxx"
+#include "pcm/Volume.hxx"
+#include "pcm/PcmMix.hxx"
+#include "pcm/PcmDither.hxx"
+#include "pcm/PcmFormat.hxx"
+#include "pcm/PcmExport.hxx"
+#include "pcm/PcmChannels.hxx"
+#include "pcm/PcmBuffer.hxx"
+#include "pcm/FallbackResampler.hxx"
+#include "AudioFormat.hxx"
+#include "util/ConstBuffer.hxx"
+#include "util/Error.hxx"
+#include "test_pcm_util.hxx"
+
+#ifdef ENABLE_DSD
+#include "pcm/PcmDsd.hxx"
+#endif
+
+#ifdef ENABLE_LIBSAMPLERATE
+#include "pcm/LibsamplerateResampler.hxx"
+#endif
+
+#ifdef ENABLE_SOXR
+#include "pcm/SoxrResampler.hxx"
+#endif
+
+#if defined(ENABLE_LIBSAMPLERATE) || defined(ENABLE_SOXR)
+#include "config/Block.hxx"
+#endif
+
+#include <chrono>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * The number of samples passed to each kernel invocation.
+ */
+static constexpr size_t N_SAMPLES = 8192;
+
+/**
+ * Each measurement runs at least this long.
+ */
+static constexpr std::chrono::milliseconds MIN_DURATION(200);
+
+static const char *kernel_filter;
+
+static const TestDataBuffer<uint8_t, N_SAMPLES> src_u8;
+static const TestDataBuffer<int8_t, N_SAMPLES> src_s8;
+static const TestDataBuffer<int16_t, N_SAMPLES> src_s16;
+static const TestDataBuffer<int32_t, N_SAMPLES> src_s24{RandomInt24()};
+static const TestDataBuffer<int32_t, N_SAMPLES> src_s32;
+static const TestDataBuffer<float, N_SAMPLES> src_float{RandomFloat()};
+
+static ConstBuffer<void>
+GetSource(SampleFormat format)
+{
+	switch (format) {
+	case SampleFormat::UNDEFINED:
+		break;
+
+	case SampleFormat::S8:
+		return src_s8;
+
+	case SampleFormat::S16:
+		return src_s16;
+
+	case SampleFormat::S24_P32:
+		return src_s24;
+
+	case SampleFormat::S32:
+		return src_s32;
+
+	case SampleFormat::FLOAT:
+		return src_float;
+
+	case SampleFormat::DSD:
+		return src_u8;
+	}
+
+	abort();
+}
+
+/**
+ * Pretend to use the result of a kernel, so the compiler doesn't
+ * optimize away calls to functions which are declared "pure".
+ */
+template<typename T>
+static inline void
+Consume(ConstBuffer<T> result)
+{
+	asm volatile("" : : "r"(result.data), "r"(result.size) : "memory");
+}
+
+/**
+ * Invoke the given function repeatedly and print the number of
+ * samples processed per second.
+ */
+template<typename F>
+static void
+Bench(const char *kernel, const char *variant, size_t n_samples, F &&f)
+{
+	if (kernel_filter != nullptr && strcmp(kernel_filter, kernel) != 0)
+		return;
+
+	typedef std::chrono::steady_clock Clock;
+
+	/* warm up caches and lazily allocated buffers */
+	f();
+
+	unsigned long n_iterations = 0;
+	const auto start = Clock::now();
+	Clock::duration duration;
+
+	do {
+		for (unsigned i = 0; i < 16; ++i)
+			f();
+		n_iterations += 16;
+		duration = Clock::now() - start;
+	} while (duration < MIN_DURATION);
+
+	const std::chrono::duration<double> seconds = duration;
+	printf("%s %s %.0f\n", kernel, variant,
+	       n_samples * n_iterations / seconds.count());
+	fflush(stdout);
+}
+
+static void
+Fail(const char *kernel, const char *variant, const Error &error)
+{
+	fprintf(stderr, "%s %s: %s\n", kernel, variant, error.GetMessage());
+	exit(EXIT_FAILURE);
+}
+
+static void
+BenchConvert(AudioFormat src_format, AudioFormat dest_format)
+{
+	auto src = GetSource(src_format.format);
+	src.size -= src.size % src_format.GetFrameSize();
+
+	char variant[64];
+	snprintf(variant, sizeof(variant), "%u:%s:%u->%u:%s:%u",
+		 src_format.sample_rate,
+		 sample_format_to_string(src_format.format),
+		 src_format.channels,
+		 dest_format.sample_rate,
+		 sample_format_to_string(dest_format.format),
+		 dest_format.channels);
+
+	Error error;
+	PcmConvert convert;
+	if (!convert.Open(src_format, dest_format, error))
+		Fail("pcm_convert", variant, error);
+
+	const size_t n_samples = src.size / src_format.GetSampleSize();
+	Bench("pcm_convert", variant, n_samples, [&](){
+			const auto dest = convert.Convert(src, error);
+			if (dest.IsNull())
+				Fail("pcm_convert", variant, error);
+			Consume(dest);
+		});
+
+	convert.Close();
+}
+
+static void
+BenchConvert()
+{
+	static constexpr AudioFormat s16_44(44100, SampleFormat::S16, 2);
+
+	BenchConvert(s16_44, {44100, SampleFormat::FLOAT, 2});
+	BenchConvert(s16_44, {44100, SampleFormat::S24_P32, 2});
+	BenchConvert({44100, SampleFormat::S24_P32, 2}, s16_44);
+	BenchConvert({44100, SampleFormat::S32, 2}, s16_44);
+	BenchConvert({44100, SampleFormat::FLOAT, 2}, s16_44);
+	BenchConvert({44100, SampleFormat::S16, 6}, s16_44);
+	BenchConvert(s16_44, {48000, SampleFormat::S16, 2});
+	BenchConvert({96000, SampleFormat::S24_P32, 2},
+		     {48000, SampleFormat::S16, 2});
+#ifdef ENABLE_DSD
+	BenchConvert({352800, SampleFormat::DSD, 2}, s16_44);
+	BenchConvert({352800, SampleFormat::DSD, 2},
+		     {176400, SampleFormat::S24_P32, 2});
+#endif
+}
+
+static void
+BenchVolume(SampleFormat format)
+{
+	const char *variant = sample_format_to_string(format);
+
+	Error error;
+	PcmVolume volume;
+	if (!volume.Open(format, error))
+		Fail("PcmVolume", variant, error);
+
+	volume.SetVolume(PCM_VOLUME_1 / 2);
+
+	const auto src = GetSource(format);
+	Bench("PcmVolume", variant, src.size / sample_format_size(format),
+	      [&](){ Consume(volume.Apply(src)); });
+
+	volume.Close();
+}
+
+static void
+BenchVolume()
+{
+	BenchVolume(SampleFormat::S8);
+	BenchVolume(SampleFormat::S16);
+	BenchVolume(SampleFormat::S24_P32);
+	BenchVolume(SampleFormat::S32);
+	BenchVolume(SampleFormat::FLOAT);
+}
+
+static void
+BenchMix(SampleFormat format, float portion1, const char *mode)
+{
+	char variant[32];
+	snprintf(variant, sizeof(variant), "%s-%s",
+		 sample_format_to_string(format), mode);
+
+	const auto src = GetSource(format);
+	PcmBuffer buffer;
+	void *dest = buffer.Get(src.size);
+	PcmDither dither;
+
+	Bench("PcmMix", variant, src.size / sample_format_size(format),
+	      [&](){
+		      /* start from the same data each time to avoid
+			 saturating the mix */
+		      memcpy(dest, src.data, src.size);
+		      if (!pcm_mix(dither, dest, src.data, src.size,
+				   format, portion1))
+			      abort();
+	      });
+}
+
+static void
+BenchMix()
+{
+	static constexpr SampleFormat formats[] = {
+		SampleFormat::S8,
+		SampleFormat::S16,
+		SampleFormat::S24_P32,
+		SampleFormat::S32,
+		SampleFormat::FLOAT,
+	};
+
+	for (auto format : formats)
+		BenchMix(format, 0.5, "fade");
+
+	for (auto format : formats)
+		BenchMix(format, -1, "add");
+}
+
+/**
+ * PcmDither's methods are inline in PcmDither.cxx; measure them
+ * through pcm_convert_to_16(), which uses them for 24 and 32 bit
+ * input.
+ */
+static void
+BenchDither(SampleFormat format)
+{
+	char variant[32];
+	snprintf(variant, sizeof(variant), "%s->16",
+		 sample_format_to_string(format));
+
+	const auto src = GetSource(format);
+	PcmBuffer buffer;
+	PcmDither dither;
+
+	Bench("PcmDither", variant, src.size / sample_format_size(format),
+	      [&](){
+		      Consume(pcm_convert_to_16(buffer, dither,
+						format, src));
+	      });
+}
+
+static void
+BenchDither()
+{
+	BenchDither(SampleFormat::S24_P32);
+	BenchDither(SampleFormat::S32);
+}
+
+static void
+BenchExport(const char *variant, SampleFormat format, unsigned channels,
+	    PcmExport::Params params)
+{
+	const auto src = GetSource(format);
+	const size_t sample_size = sample_format_size(format);
+
+	/* whole frames only */
+	const size_t frame_size = sample_size * channels * 4;
+	const ConstBuffer<void> data(src.data,
+				     src.size / frame_size * frame_size);
+
+	PcmExport e;
+	e.Open(format, channels, params);
+
+	Bench("PcmExport", variant, data.size / sample_size,
+	      [&](){ Consume(e.Export(data)); });
+}
+
+static void
+BenchExport()
+{
+	PcmExport::Params params;
+	params.pack24 = true;
+	BenchExport("24-pack24", SampleFormat::S24_P32, 2, params);
+	params.reverse_endian = true;
+	BenchExport("24-pack24-reverse", SampleFormat::S24_P32, 2,
+		    params);
+	params.alsa_channel_order = true;
+	BenchExport("24-pack24-reverse-order", SampleFormat::S24_P32, 6,
+		    params);
+
+	params = PcmExport::Params();
+	params.shift8 = true;
+	BenchExport("24-shift8", SampleFormat::S24_P32, 2, params);
+
+	params = PcmExport::Params();
+	params.reverse_endian = true;
+	BenchExport("16-reverse", SampleFormat::S16, 2, params);
+	BenchExport("32-reverse", SampleFormat::S32, 2, params);
+
+	params = PcmExport::Params();
+	params.alsa_channel_order = true;
+	BenchExport("16-order", SampleFormat::S16, 6, params);
+	BenchExport("32-order", SampleFormat::S32, 8, params);
+
+#ifdef ENABLE_DSD
+	params = PcmExport::Params();
+	params.dsd_u32 = true;
+	BenchExport("dsd-dsd_u32", SampleFormat::DSD, 2, params);
+
+	params = PcmExport::Params();
+	params.dop = true;
+	BenchExport("dsd-dop", SampleFormat::DSD, 2, params);
+#endif
+}
+
+template<typename T, typename F>
+static void
+BenchChannels(const char *format, unsigned src_channels,
+	      unsigned dest_channels, ConstBuffer<T> src, F f)
+{
+	char variant[32];
+	snprintf(variant, sizeof(variant), "%s:%u->%u",
+		 format, src_channels, dest_channels);
+
+	src.size -= src.size % src_channels;
+
+	PcmBuffer buffer;
+	Bench("PcmChannels", variant, src.size, [&](){
+			Consume(f(buffer, dest_channels, src_channels, src));
+		});
+}
+
+template<typename T, typename F>
+static void
+BenchChannels(const char *format, ConstBuffer<T> src, F f)
+{
+	BenchChannels(format, 1, 2, src, f);
+	BenchChannels(format, 2, 1, src, f);
+	BenchChannels(format, 6, 2, src, f);
+}
+
+static void
+BenchChannels()
+{
+	BenchChannels("16", ConstBuffer<int16_t>(src_s16),
+		      pcm_convert_channels_16);
+	BenchChannels("24", ConstBuffer<int32_t>(src_s24),
+		      pcm_convert_channels_24);
+	BenchChannels("32", ConstBuffer<int32_t>(src_s32),
+		      pcm_convert_channels_32);
+	BenchChannels("f", ConstBuffer<float>(src_float),
+		      pcm_convert_channels_float);
+}
+
+#ifdef ENABLE_DSD
+
+static void
+BenchDsd(unsigned channels, unsigned decimation)
+{
+	char variant[32];
+	snprintf(variant, sizeof(variant), "dsd:%u/%u", channels, decimation);
+
+	ConstBuffer<uint8_t> src = src_u8;
+	src.size -= src.size % (channels * decimation);
+
+	PcmDsd dsd;
+	dsd.SetDecimation(decimation);
+
+	Bench("PcmDsd", variant, src.size, [&](){
+			Consume(dsd.ToFloat(channels, src));
+		});
+}
+
+static void
+BenchDsd()
+{
+	BenchDsd(2, 1);
+	BenchDsd(6, 1);
+	BenchDsd(2, 8);
+	BenchDsd(6, 8);
+}
+
+#endif
+
+static void
+BenchResampler(const char *name, PcmResampler &resampler,
+	       AudioFormat format, unsigned new_sample_rate)
+{
+	char variant[64];
+	snprintf(variant, sizeof(variant), "%s:%s:%u->%u",
+		 name, sample_format_to_string(format.format),
+		 format.sample_rate, new_sample_rate);
+
+	const auto requested = format.format;
+
+	Error error;
+	if (!resampler.Open(format, new_sample_rate, error).IsValid())
+		Fail("resampler", variant, error);
+
+	if (format.format != requested) {
+		/* the plugin doesn't support this sample format */
+		resampler.Close();
+		return;
+	}
+
+	auto src = GetSource(format.format);
+	src.size -= src.size % format.GetFrameSize();
+
+	Bench("resampler", variant, src.size / format.GetSampleSize(), [&](){
+			const auto dest = resampler.Resample(src, error);
+			if (dest.IsNull())
+				Fail("resampler", variant, error);
+			Consume(dest);
+		});
+
+	resampler.Close();
+}
+
+static void
+BenchResampler(const char *name, PcmResampler &resampler)
+{
+	static constexpr SampleFormat formats[] = {
+		SampleFormat::S16,
+		SampleFormat::S24_P32,
+		SampleFormat::S32,
+		SampleFormat::FLOAT,
+	};
+
+	for (auto format : formats) {
+		BenchResampler(name, resampler, {44100, format, 2}, 48000);
+		BenchResampler(name, resampler, {48000, format, 2}, 44100);
+		BenchResampler(name, resampler, {96000, format, 2}, 44100);
+	}
+}
+
+static void
+BenchResampler()
+{
+	FallbackPcmResampler fallback;
+	BenchResampler("internal", fallback);
+
+#if defined(ENABLE_LIBSAMPLERATE) || defined(ENABLE_SOXR)
+	const ConfigBlock empty;
+	Error error;
+#endif
+
+#ifdef ENABLE_LIBSAMPLERATE
+	if (!pcm_resample_lsr_global_init(empty, error))
+		Fail("resampler", "libsamplerate", error);
+
+	LibsampleratePcmResampler lsr;
+	BenchResampler("libsamplerate", lsr);
+#endif
+
+#ifdef ENABLE_SOXR
+	if (!pcm_resample_soxr_global_init(empty, error))
+		Fail("resampler", "soxr", error);
+
+	SoxrPcmResampler soxr;
+	BenchResampler("soxr", soxr);
+#endif
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc > 2) {
+		fprintf(stderr, "Usage: bench_pcm [KERNEL]\n");
+		return EXIT_FAILURE;
+	}
+
+	if (argc > 1)
+		kernel_filter = argv[1];
+
+	BenchConvert();
+	BenchVolume();
+	BenchMix();
+	BenchDither();
+	BenchExport();
+	BenchChannels();
+#ifdef ENABLE_DSD
+	BenchDsd();
+#endif
+	BenchResampler();
+
+	return EXIT_SUCCESS;
+}
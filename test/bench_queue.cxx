@@ -0,0 +1,238 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+/*
+ * This program measures the queue operations which touch large
+ * ranges of items.  Each line of output is one measurement:
+ *
+ *   OPERATION QUEUE_LENGTH MICROSECONDS
+ *
+ * The optional argument is the queue length (default 500000).
+ *
+ * The "findadd" measurements append songs with tags to a #playlist
+ * in one bulk edit, the way "findadd" and "searchadd" do for each
+ * song visited in the database.
+ */
+
+#include "config.h"
+#include "queue/Queue.hxx"
+#include "queue/Playlist.hxx"
+#include "queue/Listener.hxx"
+#include "player/Control.hxx"
+#include "player/Listener.hxx"
+#include "output/MultipleOutputs.hxx"
+#include "mixer/Listener.hxx"
+#include "playlist/PlaylistSong.hxx"
+#include "tag/TagBuilder.hxx"
+#include "tag/Tag.hxx"
+#include "DetachedSong.hxx"
+#include "SongLoader.hxx"
+#include "Idle.hxx"
+#include "Log.hxx"
+#include "system/Clock.hxx"
+
+#include <utility>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+void
+idle_add(gcc_unused unsigned flags)
+{
+}
+
+void
+FormatDebug(gcc_unused const Domain &domain, gcc_unused const char *fmt, ...)
+{
+}
+
+DetachedSong *
+SongLoader::LoadSong(gcc_unused const char *uri_utf8,
+		     gcc_unused Error &error) const
+{
+	return nullptr;
+}
+
+bool
+playlist_check_translate_song(gcc_unused DetachedSong &song,
+			      gcc_unused const char *base_uri,
+			      gcc_unused const SongLoader &loader)
+{
+	return false;
+}
+
+/* the player is not started, and it doesn't use any audio output */
+
+MultipleOutputs::MultipleOutputs(MixerListener &_mixer_listener,
+				 unsigned _history_size)
+	:mixer_listener(_mixer_listener), history_size(_history_size) {}
+
+MultipleOutputs::~MultipleOutputs() {}
+
+class NullListener final
+	: public MixerListener, public PlayerListener, public QueueListener {
+public:
+	void OnMixerVolumeChanged(gcc_unused Mixer &mixer,
+				  gcc_unused int volume) override {}
+
+	void OnPlayerSync() override {}
+	void OnPlayerTagModified() override {}
+
+	void OnQueueModified() override {}
+	void OnQueueOptionsChanged() override {}
+	void OnQueueSongStarted() override {}
+	void OnQueueResolveSong(gcc_unused unsigned position) override {}
+};
+
+/**
+ * The number of songs added by the "findadd" measurements.
+ */
+static constexpr unsigned FINDADD_SONGS = 200000;
+
+static unsigned queue_length = 500000;
+
+template<typename F>
+static void
+Measure(const char *name, unsigned length, F &&f)
+{
+	const auto start = MonotonicClockUS();
+	f();
+	const auto duration_us = MonotonicClockUS() - start;
+
+	printf("%s %u %lu\n", name, length, (unsigned long)duration_us);
+}
+
+template<typename F>
+static void
+Measure(const char *name, F &&f)
+{
+	Measure(name, queue_length, std::forward<F>(f));
+}
+
+/**
+ * Append #FINDADD_SONGS songs to the playlist in one bulk edit.
+ * Each one is copied from a template song with a few tags, like
+ * DatabaseDetachSong() copies the song from the database.
+ */
+static void
+FindAdd(playlist &playlist, PlayerControl &pc, const DetachedSong &song)
+{
+	playlist.BeginBulk();
+
+	for (unsigned i = 0; i < FINDADD_SONGS; ++i)
+		playlist.AppendSong(pc, DetachedSong(song));
+
+	playlist.CommitBulk(pc);
+}
+
+static void
+MeasureFindAdd()
+{
+	TagBuilder tag;
+	tag.AddItem(TAG_ARTIST, "Some Artist");
+	tag.AddItem(TAG_ALBUM, "Some Album");
+	tag.AddItem(TAG_TITLE, "Some Title");
+	tag.AddItem(TAG_TRACK, "7");
+	tag.AddItem(TAG_GENRE, "Rock");
+	tag.AddItem(TAG_DATE, "1999");
+
+	DetachedSong song("Some Artist/Some Album/07 - Some Title.flac");
+	song.SetTag(tag.Commit());
+
+	NullListener listener;
+	MultipleOutputs outputs(listener);
+	PlayerControl pc(listener, outputs, 64, 0, 4096,
+			 HugeAllocateOptions(), 16, false,
+			 SongTime::zero(), SongTime::zero(), 1);
+	playlist playlist(FINDADD_SONGS, listener);
+
+	Measure("findadd", FINDADD_SONGS, [&](){
+			FindAdd(playlist, pc, song);
+		});
+
+	playlist.Clear(pc);
+	playlist.SetRandom(pc, true);
+
+	Measure("findadd_random", FINDADD_SONGS, [&](){
+			FindAdd(playlist, pc, song);
+		});
+
+	playlist.Clear(pc);
+}
+
+int
+main(int argc, char **argv)
+{
+	if (argc > 2) {
+		fprintf(stderr, "Usage: bench_queue [LENGTH]\n");
+		return EXIT_FAILURE;
+	}
+
+	if (argc > 1)
+		queue_length = strtoul(argv[1], nullptr, 10);
+
+	if (queue_length < 20000) {
+		fprintf(stderr, "The queue must have at least 20000 items\n");
+		return EXIT_FAILURE;
+	}
+
+	Queue queue(queue_length);
+
+	Measure("append", [&queue](){
+			for (unsigned i = 0; i < queue_length; ++i)
+				queue.Append(DetachedSong("x"), 0);
+			queue.IncrementVersion();
+		});
+
+	/* move a block of 10000 items from the front to the back */
+	Measure("move_range", [&queue](){
+			queue.MoveRange(0, 10000, queue_length - 10000);
+			queue.IncrementVersion();
+		});
+
+	Measure("move_position", [&queue](){
+			queue.MovePostion(queue_length - 1, 0);
+			queue.IncrementVersion();
+		});
+
+	Measure("shuffle_range", [&queue](){
+			queue.ShuffleRange(0, queue_length);
+			queue.IncrementVersion();
+		});
+
+	queue.random = true;
+
+	Measure("shuffle_order", [&queue](){
+			queue.ShuffleOrder();
+		});
+
+	Measure("move_range_random", [&queue](){
+			queue.MoveRange(10000, 20000, 0);
+			queue.IncrementVersion();
+		});
+
+	Measure("clear", [&queue](){
+			queue.Clear();
+		});
+
+	MeasureFindAdd();
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,395 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Benchmark for the database update.  It generates a synthetic music
+ * directory (unless the given directory exists already), runs a full
+ * #UpdateWalk over it and prints the throughput, the number of bytes
+ * read per file and the peak RSS.
+ *
+ * The files are generated by an encoder plugin; if the encoder does
+ * not embed tags, an APEv2 tag (with a fake cover art item, which the
+ * scanner must skip) is appended.
+ */
+
+#include "config.h"
+#include "ScopeIOThread.hxx"
+#include "config/ConfigGlobal.hxx"
+#include "config/Block.hxx"
+#include "decoder/DecoderList.hxx"
+#include "input/Init.hxx"
+#include "encoder/EncoderList.hxx"
+#include "encoder/EncoderPlugin.hxx"
+#include "encoder/EncoderInterface.hxx"
+#include "encoder/ToOutputStream.hxx"
+#include "db/update/Walk.hxx"
+#include "db/update/Throttle.hxx"
+#include "db/DatabaseListener.hxx"
+#include "db/Stats.hxx"
+#include "db/plugins/simple/Directory.hxx"
+#include "db/plugins/simple/TagIndex.hxx"
+#include "db/plugins/simple/DatabaseAllocator.hxx"
+#include "storage/StorageInterface.hxx"
+#include "storage/plugins/LocalStorage.hxx"
+#include "event/Loop.hxx"
+#include "tag/Tag.hxx"
+#include "tag/TagBuilder.hxx"
+#include "tag/TagPool.hxx"
+#include "fs/AllocatedPath.hxx"
+#include "fs/FileSystem.hxx"
+#include "fs/io/FileOutputStream.hxx"
+#include "system/ByteOrder.hxx"
+#include "system/Clock.hxx"
+#include "AudioFormat.hxx"
+#include "util/Error.hxx"
+#include "Log.hxx"
+#include "LogBackend.hxx"
+
+#include <memory>
+#include <string>
+#include <stdexcept>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+static constexpr unsigned FILES_PER_ALBUM = 12;
+static constexpr unsigned ALBUMS_PER_ARTIST = 5;
+
+/**
+ * Size of the binary "cover art" item in the APE tag.
+ */
+static constexpr size_t FAKE_COVER_SIZE = 64 * 1024;
+
+class NullDatabaseListener final : public DatabaseListener {
+public:
+	void OnDatabaseModified() override {}
+	void OnDatabaseSongRemoved(const char *) override {}
+};
+
+static const char *
+GetSuffix(const PreparedEncoder &encoder)
+{
+	const char *mime = encoder.GetMimeType();
+	if (mime == nullptr)
+		return "raw";
+
+	static constexpr struct {
+		const char *mime, *suffix;
+	} suffixes[] = {
+		{ "audio/wav", "wav" },
+		{ "audio/ogg", "ogg" },
+		{ "audio/flac", "flac" },
+		{ "audio/mpeg", "mp3" },
+		{ "audio/aac", "aac" },
+	};
+
+	for (const auto &i : suffixes)
+		if (strcmp(mime, i.mime) == 0)
+			return i.suffix;
+
+	return "raw";
+}
+
+static void
+AppendApeItem(std::string &dest, const char *key, const void *value,
+	      size_t size, uint32_t flags=0)
+{
+	const uint32_t header[2] = { ToLE32(size), ToLE32(flags) };
+	dest.append((const char *)header, sizeof(header));
+	dest.append(key, strlen(key) + 1);
+	dest.append((const char *)value, size);
+}
+
+static void
+AppendApeItem(std::string &dest, const char *key, const char *value)
+{
+	AppendApeItem(dest, key, value, strlen(value));
+}
+
+/**
+ * Generate an APEv2 tag (without header, just items and footer).
+ */
+static std::string
+MakeApeTag(const Tag &tag)
+{
+	std::string items;
+	unsigned n = 0;
+
+	for (const auto &i : tag) {
+		AppendApeItem(items, tag_item_names[i.type], i.value);
+		++n;
+	}
+
+	const std::string cover(FAKE_COVER_SIZE, 'x');
+	AppendApeItem(items, "Cover Art (Front)", cover.data(), cover.size(),
+		      1 << 1);
+	++n;
+
+	struct {
+		char id[8];
+		uint32_t version, length, count;
+		unsigned char flags[4], reserved[8];
+	} footer;
+
+	static_assert(sizeof(footer) == 32, "Wrong APE footer size");
+
+	memcpy(footer.id, "APETAGEX", sizeof(footer.id));
+	footer.version = ToLE32(2000);
+	footer.length = ToLE32(items.size() + sizeof(footer));
+	footer.count = ToLE32(n);
+	memset(footer.flags, 0, sizeof(footer.flags));
+	memset(footer.reserved, 0, sizeof(footer.reserved));
+
+	items.append((const char *)&footer, sizeof(footer));
+	return items;
+}
+
+static void
+GenerateFile(PreparedEncoder &prepared, Path path, const Tag &tag)
+{
+	Error error;
+
+	AudioFormat audio_format(44100, SampleFormat::S16, 2);
+	std::unique_ptr<Encoder> encoder(prepared.Open(audio_format, error));
+	if (encoder == nullptr)
+		throw std::runtime_error(error.GetMessage());
+
+	FileOutputStream os(path);
+
+	if (encoder->ImplementsTag() &&
+	    (!encoder->PreTag(error) || !encoder->SendTag(tag, error)))
+		throw std::runtime_error(error.GetMessage());
+
+	/* one second of silence */
+	static const int16_t silence[4410 * 2] = {};
+	for (unsigned i = 0; i < 10; ++i) {
+		if (!encoder->Write(silence, sizeof(silence), error))
+			throw std::runtime_error(error.GetMessage());
+
+		EncoderToOutputStream(os, *encoder);
+	}
+
+	if (!encoder->End(error))
+		throw std::runtime_error(error.GetMessage());
+
+	EncoderToOutputStream(os, *encoder);
+
+	if (!encoder->ImplementsTag()) {
+		const auto ape = MakeApeTag(tag);
+		os.Write(ape.data(), ape.size());
+	}
+
+	os.Commit();
+}
+
+static void
+MakeDirectory(Path path)
+{
+	if (mkdir(path.c_str(), 0777) < 0 && errno != EEXIST)
+		throw std::runtime_error(std::string("Failed to create ") +
+					 path.c_str());
+}
+
+static void
+GenerateTree(Path base, unsigned n_files, const char *encoder_name)
+{
+	const auto plugin = encoder_plugin_get(encoder_name);
+	if (plugin == nullptr)
+		throw std::runtime_error(std::string("No such encoder: ") +
+					 encoder_name);
+
+	ConfigBlock block;
+	block.AddBlockParam("quality", "5.0", -1);
+
+	Error error;
+	std::unique_ptr<PreparedEncoder> prepared(encoder_init(*plugin, block,
+							       error));
+	if (prepared == nullptr)
+		throw std::runtime_error(error.GetMessage());
+
+	const char *suffix = GetSuffix(*prepared);
+
+	MakeDirectory(base);
+
+	for (unsigned i = 0; i < n_files; ++i) {
+		const unsigned track = i % FILES_PER_ALBUM + 1;
+		const unsigned album = i / FILES_PER_ALBUM;
+		const unsigned artist = album / ALBUMS_PER_ARTIST;
+
+		char artist_name[32], album_name[32], title[32], buffer[64];
+		snprintf(artist_name, sizeof(artist_name), "Artist %u", artist);
+		snprintf(album_name, sizeof(album_name), "Album %u", album);
+		snprintf(title, sizeof(title), "Title %u", i);
+
+		const auto artist_fs = AllocatedPath::Build(base,
+							    AllocatedPath::FromFS(artist_name));
+		const auto album_fs = AllocatedPath::Build(artist_fs,
+							   AllocatedPath::FromFS(album_name));
+		if (track == 1) {
+			MakeDirectory(artist_fs);
+			MakeDirectory(album_fs);
+		}
+
+		TagBuilder tag;
+		tag.AddItem(TAG_ARTIST, artist_name);
+		tag.AddItem(TAG_ALBUM, album_name);
+		tag.AddItem(TAG_TITLE, title);
+		snprintf(buffer, sizeof(buffer), "%u", track);
+		tag.AddItem(TAG_TRACK, buffer);
+		snprintf(buffer, sizeof(buffer), "%u", 1970 + album % 50);
+		tag.AddItem(TAG_DATE, buffer);
+		tag.AddItem(TAG_GENRE, album % 2 ? "Rock" : "Jazz");
+
+		snprintf(buffer, sizeof(buffer), "%02u - %s.%s",
+			 track, title, suffix);
+		GenerateFile(*prepared,
+			     AllocatedPath::Build(album_fs,
+						  AllocatedPath::FromFS(buffer)),
+			     tag.Commit());
+	}
+}
+
+/**
+ * Returns the number of bytes this process has read so far (with
+ * read() and similar system calls), or 0 if unknown.
+ */
+static uint64_t
+GetBytesRead()
+{
+	FILE *file = fopen("/proc/self/io", "r");
+	if (file == nullptr)
+		return 0;
+
+	uint64_t result = 0;
+	char line[128];
+	while (fgets(line, sizeof(line), file) != nullptr)
+		if (strncmp(line, "rchar: ", 7) == 0)
+			result = strtoull(line + 7, nullptr, 10);
+
+	fclose(file);
+	return result;
+}
+
+int
+main(int argc, char **argv)
+try {
+	if (argc < 3 || argc > 5) {
+		fprintf(stderr,
+			"Usage: bench_update CONFIG DIRECTORY [COUNT [ENCODER]]\n");
+		return EXIT_FAILURE;
+	}
+
+	const Path config_path = Path::FromFS(argv[1]);
+	const Path base = Path::FromFS(argv[2]);
+	const unsigned n_files = argc > 3 ? strtoul(argv[3], nullptr, 10) : 1000;
+	const char *const encoder_name = argc > 4 ? argv[4] : "wave";
+
+	/* initialize MPD */
+
+	config_global_init();
+	ReadConfigFile(config_path);
+
+	/* don't log each new song */
+	SetLogThreshold(LogLevel::WARNING);
+
+	const ScopeIOThread io_thread;
+
+	Error error;
+	if (!input_stream_global_init(error)) {
+		LogError(error);
+		return EXIT_FAILURE;
+	}
+
+	decoder_plugin_init_all();
+
+	/* generate the music directory */
+
+	if (!DirectoryExists(base)) {
+		printf("generating %u files with encoder '%s'\n",
+		       n_files, encoder_name);
+		GenerateTree(base, n_files, encoder_name);
+	}
+
+	/* run the update */
+
+	std::unique_ptr<Storage> storage(CreateLocalStorage(base));
+
+	EventLoop loop;
+	NullDatabaseListener listener;
+	TagIndex tag_index;
+	DatabaseAllocator allocator;
+	std::unique_ptr<Directory> root(Directory::NewRoot(&tag_index,
+							   &allocator));
+
+	TagPoolStats pool_before;
+	tag_pool_get_stats(pool_before);
+
+	const uint64_t bytes_before = GetBytesRead();
+	const auto start = MonotonicClockUS();
+
+	{
+		UpdateThrottle throttle(0, 0, nullptr);
+		UpdateWalk walk(loop, listener, *storage, throttle);
+		walk.Walk(*root, "", false);
+	}
+
+	const auto duration_us = MonotonicClockUS() - start;
+	const uint64_t bytes_read = GetBytesRead() - bytes_before;
+
+	/* report */
+
+	DatabaseStats stats;
+	tag_index.GetStats(stats);
+
+	const double seconds = duration_us / 1000000.;
+	printf("songs: %u\n", stats.song_count);
+	printf("artists: %u\n", stats.artist_count);
+	printf("albums: %u\n", stats.album_count);
+	printf("seconds: %.3f\n", seconds);
+	if (stats.song_count > 0) {
+		printf("files_per_second: %.1f\n",
+		       stats.song_count / seconds);
+		printf("bytes_read_per_file: %llu\n",
+		       (unsigned long long)(bytes_read / stats.song_count));
+	}
+
+	TagPoolStats pool;
+	tag_pool_get_stats(pool);
+	printf("tag_pool_items: %zu\n", pool.items);
+	printf("tag_pool_hits: %llu/%llu\n",
+	       (unsigned long long)(pool.hits - pool_before.hits),
+	       (unsigned long long)(pool.lookups - pool_before.lookups));
+
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0)
+		printf("peak_rss_kb: %ld\n", usage.ru_maxrss);
+
+	decoder_plugin_deinit_all();
+	input_stream_global_finish();
+	config_global_finish();
+	return EXIT_SUCCESS;
+} catch (const std::exception &e) {
+	LogError(e);
+	return EXIT_FAILURE;
+}
@@ -24,20 +24,54 @@
 #include "FakeDecoderAPI.hxx"
 #include "input/Init.hxx"
 #include "input/InputStream.hxx"
+#include "config/ConfigGlobal.hxx"
 #include "fs/Path.hxx"
+#include "system/Clock.hxx"
 #include "AudioFormat.hxx"
 #include "util/Error.hxx"
 #include "Log.hxx"
 
+#include <stdexcept>
+
 #include <assert.h>
 #include <unistd.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
-int main(int argc, char **argv)
+static void
+usage()
 {
+	fprintf(stderr, "Usage: run_decoder [--config CONFIG] [--benchmark]"
+		" DECODER URI >OUT\n"
+		"\n"
+		"With --benchmark, the decoding time and throughput are\n"
+		"printed to stderr; redirect OUT to /dev/null to measure\n"
+		"only the decoder and the input.\n");
+}
+
+int main(int argc, char **argv)
+try {
+	const char *config_path = nullptr;
+	bool benchmark = false;
+
+	while (argc > 1 && argv[1][0] == '-') {
+		if (strcmp(argv[1], "--config") == 0 && argc > 2) {
+			config_path = argv[2];
+			argc -= 2;
+			argv += 2;
+		} else if (strcmp(argv[1], "--benchmark") == 0) {
+			benchmark = true;
+			--argc;
+			++argv;
+		} else {
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
 	if (argc != 3) {
-		fprintf(stderr, "Usage: run_decoder DECODER URI >OUT\n");
+		usage();
 		return EXIT_FAILURE;
 	}
 
@@ -45,6 +79,10 @@ int main(int argc, char **argv)
 	const char *const decoder_name = argv[1];
 	const char *const uri = argv[2];
 
+	config_global_init();
+	if (config_path != nullptr)
+		ReadConfigFile(Path::FromFS(config_path));
+
 	const ScopeIOThread io_thread;
 
 	Error error;
@@ -61,6 +99,8 @@ int main(int argc, char **argv)
 		return EXIT_FAILURE;
 	}
 
+	const uint64_t start_time = MonotonicClockUS();
+
 	if (plugin->file_decode != nullptr) {
 		plugin->FileDecode(decoder, Path::FromFS(uri));
 	} else if (plugin->stream_decode != nullptr) {
@@ -81,13 +121,28 @@ int main(int argc, char **argv)
 		return EXIT_FAILURE;
 	}
 
+	const uint64_t duration_us = MonotonicClockUS() - start_time;
+
 	decoder_plugin_deinit_all();
 	input_stream_global_finish();
+	config_global_finish();
 
 	if (!decoder.initialized) {
 		fprintf(stderr, "Decoding failed\n");
 		return EXIT_FAILURE;
 	}
 
+	if (benchmark) {
+		const double seconds = duration_us / 1e6;
+		fprintf(stderr, "%llu bytes in %.3f s (%.1f MB/s)\n",
+			(unsigned long long)decoder.data_bytes, seconds,
+			seconds > 0
+			? decoder.data_bytes / seconds / (1024 * 1024)
+			: 0.);
+	}
+
 	return 0;
+} catch (const std::exception &e) {
+	LogError(e);
+	return EXIT_FAILURE;
 }
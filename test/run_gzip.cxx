@@ -19,6 +19,7 @@
 
 #include "config.h"
 #include "fs/io/GzipOutputStream.hxx"
+#include "fs/io/ParallelGzipOutputStream.hxx"
 #include "fs/io/StdioOutputStream.hxx"
 #include "Log.hxx"
 #include "util/Error.hxx"
@@ -46,9 +47,19 @@ Copy(OutputStream &dest, int src, Error &error)
 }
 
 static bool
-CopyGzip(OutputStream &_dest, int src, Error &error)
+CopyGzip(OutputStream &_dest, int src, int level, unsigned n_threads,
+	 Error &error)
 {
-	GzipOutputStream dest(_dest);
+	if (n_threads > 1) {
+		ParallelGzipOutputStream dest(_dest, level, n_threads);
+		if (!Copy(dest, src, error))
+			return false;
+
+		dest.Flush();
+		return true;
+	}
+
+	GzipOutputStream dest(_dest, level);
 	if (!Copy(dest, src, error))
 		return false;
 
@@ -57,23 +68,31 @@ CopyGzip(OutputStream &_dest, int src, Error &error)
 }
 
 static bool
-CopyGzip(FILE *_dest, int src, Error &error)
+CopyGzip(FILE *_dest, int src, int level, unsigned n_threads,
+	 Error &error)
 {
 	StdioOutputStream dest(_dest);
-	return CopyGzip(dest, src, error);
+	return CopyGzip(dest, src, level, n_threads, error);
 }
 
 int
-main(int argc, gcc_unused char **argv)
+main(int argc, char **argv)
 {
-	if (argc != 1) {
-		fprintf(stderr, "Usage: run_gzip\n");
+	if (argc > 3) {
+		fprintf(stderr, "Usage: run_gzip [LEVEL [THREADS]]\n");
 		return EXIT_FAILURE;
 	}
 
+	const int level = argc > 1
+		? atoi(argv[1])
+		: Z_DEFAULT_COMPRESSION;
+	const unsigned n_threads = argc > 2
+		? strtoul(argv[2], nullptr, 10)
+		: 1;
+
 	try {
 		Error error;
-		if (!CopyGzip(stdout, STDIN_FILENO, error)) {
+		if (!CopyGzip(stdout, STDIN_FILENO, level, n_threads, error)) {
 			fprintf(stderr, "%s\n", error.GetMessage());
 			return EXIT_FAILURE;
 		}
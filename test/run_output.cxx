@@ -51,10 +51,24 @@ filter_plugin_by_name(gcc_unused const char *name)
 PlayerControl::PlayerControl(PlayerListener &_listener,
 			     MultipleOutputs &_outputs,
 			     unsigned _buffer_chunks,
-			     unsigned _buffered_before_play)
+			     unsigned _crossfade_chunks,
+			     size_t _chunk_size,
+			     const HugeAllocateOptions &_buffer_options,
+			     unsigned _buffered_before_play,
+			     bool _adaptive_buffering,
+			     SongTime _max_buffer_time,
+			     SongTime _prefetch_time,
+			     unsigned _prefetch_songs)
 	:listener(_listener), outputs(_outputs),
 	 buffer_chunks(_buffer_chunks),
-	 buffered_before_play(_buffered_before_play) {}
+	 crossfade_chunks(_crossfade_chunks),
+	 chunk_size(_chunk_size),
+	 buffer_options(_buffer_options),
+	 buffered_before_play(_buffered_before_play),
+	 adaptive_buffering(_adaptive_buffering),
+	 max_buffer_time(_max_buffer_time),
+	 prefetch_time(_prefetch_time),
+	 prefetch_songs(_prefetch_songs) {}
 PlayerControl::~PlayerControl() {}
 
 static AudioOutput *
@@ -69,7 +83,10 @@ load_audio_output(EventLoop &event_loop, const char *name)
 
 	static struct PlayerControl dummy_player_control(*(PlayerListener *)nullptr,
 							 *(MultipleOutputs *)nullptr,
-							 32, 4);
+							 32, 0, 4096,
+							 HugeAllocateOptions(),
+							 4, false, SongTime::zero(),
+							 SongTime::zero(), 0);
 
 	Error error;
 	AudioOutput *ao =
@@ -35,7 +35,7 @@ static Storage *
 MakeStorage(const char *uri)
 {
 	Error error;
-	Storage *storage = CreateStorageURI(io_thread_get(), uri, error);
+	Storage *storage = CreateStorageURI(io_thread_get(IOThreadRole::INPUT), uri, error);
 	if (storage == nullptr) {
 		fprintf(stderr, "%s\n", error.GetMessage());
 		exit(EXIT_FAILURE);
@@ -54,6 +54,7 @@ TestIcyParserEmpty(const char *input)
 class IcyTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(IcyTest);
 	CPPUNIT_TEST(TestIcyMetadataParser);
+	CPPUNIT_TEST(TestIcyMetadataRepeat);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -71,6 +72,58 @@ public:
 		TestIcyParserTitle("a='b'c';StreamTitle='foo'bar'", "foo'bar");
 		TestIcyParserTitle("StreamTitle='fo'o'b'ar';a='b'c'd'", "fo'o'b'ar");
 	}
+
+	void TestIcyMetadataRepeat() {
+		IcyMetaDataParser parser;
+		parser.Start(4);
+
+		/* the first block is reported */
+		CPPUNIT_ASSERT_EQUAL(size_t(4), ParseMeta(parser, "foo"));
+		Tag *tag = parser.ReadTag();
+		CPPUNIT_ASSERT(tag != nullptr);
+		CompareTagTitle(*tag, "foo");
+		delete tag;
+
+		/* an identical block is skipped */
+		CPPUNIT_ASSERT_EQUAL(size_t(4), ParseMeta(parser, "foo"));
+		CPPUNIT_ASSERT(parser.ReadTag() == nullptr);
+
+		/* a different block is reported */
+		CPPUNIT_ASSERT_EQUAL(size_t(4), ParseMeta(parser, "bar"));
+		tag = parser.ReadTag();
+		CPPUNIT_ASSERT(tag != nullptr);
+		CompareTagTitle(*tag, "bar");
+		delete tag;
+
+		/* after rewinding, the title is reported again */
+		parser.Reset();
+		CPPUNIT_ASSERT_EQUAL(size_t(4), ParseMeta(parser, "bar"));
+		tag = parser.ReadTag();
+		CPPUNIT_ASSERT(tag != nullptr);
+		CompareTagTitle(*tag, "bar");
+		delete tag;
+	}
+
+private:
+	/**
+	 * Feed four data bytes and one metadata block with the given
+	 * title into the parser.
+	 *
+	 * @return the number of data bytes remaining in the buffer
+	 */
+	static size_t ParseMeta(IcyMetaDataParser &parser,
+				const char *title) {
+		std::string meta = std::string("StreamTitle='") + title + "';";
+		meta.resize((meta.length() + 15) / 16 * 16, '\0');
+
+		std::string data = "abcd";
+		data.push_back(char(meta.length() / 16));
+		data += meta;
+
+		size_t length = parser.ParseInPlace(&data[0], data.length());
+		CPPUNIT_ASSERT(memcmp(data.data(), "abcd", 4) == 0);
+		return length;
+	}
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(IcyTest);
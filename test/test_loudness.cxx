@@ -0,0 +1,91 @@
+/*
+ * Unit tests for class LoudnessAnalyzer
+ */
+
+#include "config.h"
+#include "pcm/LoudnessAnalyzer.hxx"
+#include "ReplayGainInfo.hxx"
+#include "util/ConstBuffer.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <math.h>
+
+class LoudnessTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(LoudnessTest);
+	CPPUNIT_TEST(TestSine);
+	CPPUNIT_TEST(TestGate);
+	CPPUNIT_TEST(TestSilence);
+	CPPUNIT_TEST_SUITE_END();
+
+	/**
+	 * Feed a stereo 1 kHz sine wave at 48 kHz.
+	 */
+	static void FeedSine(LoudnessAnalyzer &analyzer, double dbfs,
+			     unsigned seconds) {
+		const float amplitude = pow(10, dbfs / 20);
+
+		float buffer[480 * 2];
+		for (unsigned i = 0; i < seconds * 100; ++i) {
+			for (unsigned j = 0; j < 480; ++j)
+				buffer[j * 2] = buffer[j * 2 + 1] =
+					amplitude * sin(2 * M_PI * j / 48);
+
+			analyzer.Feed({buffer, sizeof(buffer)});
+		}
+	}
+
+public:
+	void TestSine() {
+		/* EBU Tech 3341 test case 1: a stereo 1 kHz sine at
+		   -23 dBFS measures -23 LUFS */
+		LoudnessAnalyzer analyzer(AudioFormat(48000,
+						      SampleFormat::FLOAT, 2));
+		FeedSine(analyzer, -23, 20);
+
+		const ReplayGainTuple result = analyzer.Finish();
+		CPPUNIT_ASSERT(result.IsDefined());
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(5.0, result.gain, 0.1);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(pow(10, -23. / 20),
+					     result.peak, 0.001);
+	}
+
+	void TestGate() {
+		/* EBU Tech 3341 test case 3: the quiet part is below
+		   the relative gate */
+		LoudnessAnalyzer analyzer(AudioFormat(48000,
+						      SampleFormat::FLOAT, 2));
+		FeedSine(analyzer, -36, 10);
+		FeedSine(analyzer, -23, 60);
+		FeedSine(analyzer, -36, 10);
+
+		const ReplayGainTuple result = analyzer.Finish();
+		CPPUNIT_ASSERT(result.IsDefined());
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(5.0, result.gain, 0.1);
+	}
+
+	void TestSilence() {
+		LoudnessAnalyzer analyzer(AudioFormat(48000,
+						      SampleFormat::S16, 1));
+
+		int16_t buffer[4800] = {};
+		for (unsigned i = 0; i < 20; ++i)
+			analyzer.Feed({buffer, sizeof(buffer)});
+
+		CPPUNIT_ASSERT(!analyzer.Finish().IsDefined());
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(LoudnessTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
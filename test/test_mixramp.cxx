@@ -1,20 +1,27 @@
 /*
- * Unit tests for mixramp_interpolate()
+ * Unit tests for mixramp_interpolate() and class MixRampAnalyzer
  */
 
 #include "config.h"
 #include "player/CrossFade.cxx"
+#include "pcm/MixRampAnalyzer.hxx"
+#include "MixRampInfo.hxx"
+#include "util/ConstBuffer.hxx"
 
 #include <cppunit/TestFixture.h>
 #include <cppunit/extensions/TestFactoryRegistry.h>
 #include <cppunit/ui/text/TestRunner.h>
 #include <cppunit/extensions/HelperMacros.h>
 
+#include <algorithm>
+
 #include <string.h>
 
 class MixRampTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(MixRampTest);
 	CPPUNIT_TEST(TestInterpolate);
+	CPPUNIT_TEST(TestAnalyze);
+	CPPUNIT_TEST(TestAnalyzeSilence);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -73,6 +80,60 @@ public:
 					     0.05);
 		free(foo);
 	}
+
+	static void Feed(MixRampAnalyzer &analyzer, int16_t value,
+			 unsigned n) {
+		int16_t buffer[250];
+		std::fill_n(buffer, n, value);
+		analyzer.Feed({buffer, n * sizeof(buffer[0])});
+	}
+
+	void TestAnalyze() {
+		/* 1000 Hz mono: one window is 100 samples */
+		MixRampAnalyzer analyzer(AudioFormat(1000, SampleFormat::S16,
+						     1));
+
+		/* 1s silence, 1s full scale, 0.5s at -26 dB, 0.5s
+		   silence */
+		for (unsigned i = 0; i < 4; ++i)
+			Feed(analyzer, 0, 250);
+		for (unsigned i = 0; i < 4; ++i)
+			Feed(analyzer, 32767, 250);
+		for (unsigned i = 0; i < 2; ++i)
+			Feed(analyzer, 1638, 250);
+		for (unsigned i = 0; i < 2; ++i)
+			Feed(analyzer, 0, 250);
+
+		const MixRampInfo info = analyzer.Finish();
+		CPPUNIT_ASSERT(info.GetStart() != nullptr);
+		CPPUNIT_ASSERT(info.GetEnd() != nullptr);
+
+		CPPUNIT_ASSERT_EQUAL(std::string("-90.00 1.00;-60.00 1.00;"
+						 "-40.00 1.00;-30.00 1.00;"
+						 "-24.00 1.00;-20.00 1.00;"
+						 "-16.00 1.00;-12.00 1.00;"
+						 "-9.00 1.00;-6.00 1.00;"
+						 "-3.00 1.00"),
+				     std::string(info.GetStart()));
+
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(0.5,
+					     mixramp_interpolate(info.GetEnd(),
+								 -30),
+					     0.005);
+		CPPUNIT_ASSERT_DOUBLES_EQUAL(1.0,
+					     mixramp_interpolate(info.GetEnd(),
+								 -24),
+					     0.005);
+	}
+
+	void TestAnalyzeSilence() {
+		MixRampAnalyzer analyzer(AudioFormat(1000, SampleFormat::S16,
+						     1));
+		Feed(analyzer, 0, 250);
+
+		const MixRampInfo info = analyzer.Finish();
+		CPPUNIT_ASSERT(!info.IsDefined());
+	}
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(MixRampTest);
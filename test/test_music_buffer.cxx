@@ -0,0 +1,330 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "MusicBuffer.hxx"
+#include "MusicChunk.hxx"
+#include "MusicPipe.hxx"
+#include "tag/Tag.hxx"
+#include "thread/Thread.hxx"
+#include "util/Error.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <set>
+
+#include <stdlib.h>
+#include <string.h>
+
+void Tag::Clear() {}
+
+class MusicBufferTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(MusicBufferTest);
+	CPPUNIT_TEST(TestAllocate);
+	CPPUNIT_TEST(TestOther);
+	CPPUNIT_TEST(TestOptions);
+	CPPUNIT_TEST(TestThreads);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestAllocate();
+	void TestOther();
+	void TestOptions();
+	void TestThreads();
+};
+
+void
+MusicBufferTest::TestAllocate()
+{
+	static constexpr unsigned N = 16;
+	MusicBuffer buffer(N, CHUNK_SIZE * 2);
+
+	CPPUNIT_ASSERT_EQUAL(N, buffer.GetSize());
+	CPPUNIT_ASSERT_EQUAL(CHUNK_SIZE * 2, buffer.GetChunkSize());
+	CPPUNIT_ASSERT(buffer.IsEmptyUnsafe());
+
+	MusicChunk *chunks[N];
+	std::set<const uint8_t *> data;
+	for (auto &i : chunks) {
+		i = buffer.Allocate();
+		CPPUNIT_ASSERT(i != nullptr);
+		CPPUNIT_ASSERT(i->IsEmpty());
+		CPPUNIT_ASSERT_EQUAL(CHUNK_SIZE * 2, i->capacity);
+		CPPUNIT_ASSERT(data.insert(i->data).second);
+		memset(i->data, 0xab, i->capacity);
+	}
+
+	/* the buffer is full */
+	CPPUNIT_ASSERT_EQUAL(0ul, buffer.GetAllocationFailures());
+	CPPUNIT_ASSERT(buffer.Allocate() == nullptr);
+	CPPUNIT_ASSERT(buffer.Allocate() == nullptr);
+	CPPUNIT_ASSERT_EQUAL(2ul, buffer.GetAllocationFailures());
+
+	/* a returned chunk is reused */
+	buffer.Return(chunks[5]);
+	chunks[5] = buffer.Allocate();
+	CPPUNIT_ASSERT(chunks[5] != nullptr);
+	CPPUNIT_ASSERT(buffer.Allocate() == nullptr);
+
+	/* discarding is refused while chunks are in use */
+	buffer.Discard();
+	CPPUNIT_ASSERT_EQUAL(uint8_t(0xab), chunks[0]->data[0]);
+
+	for (auto *i : chunks)
+		buffer.Return(i);
+
+	CPPUNIT_ASSERT(buffer.IsEmptyUnsafe());
+	buffer.Discard();
+
+	/* all chunks can be allocated again after Discard() */
+	for (auto &i : chunks) {
+		i = buffer.Allocate();
+		CPPUNIT_ASSERT(i != nullptr);
+	}
+	CPPUNIT_ASSERT(buffer.Allocate() == nullptr);
+
+	for (auto *i : chunks)
+		buffer.Return(i);
+}
+
+void
+MusicBufferTest::TestOther()
+{
+	MusicBuffer buffer(2, CHUNK_SIZE);
+
+	MusicChunk *a = buffer.Allocate();
+	MusicChunk *b = buffer.Allocate();
+	CPPUNIT_ASSERT(a != nullptr);
+	CPPUNIT_ASSERT(b != nullptr);
+	a->other = b;
+
+	/* returning a chunk returns its "other" chunk, too */
+	buffer.Return(a);
+	CPPUNIT_ASSERT(buffer.IsEmptyUnsafe());
+}
+
+void
+MusicBufferTest::TestOptions()
+{
+	/* huge pages and locking may not be available here; the
+	   buffer must work anyway */
+	HugeAllocateOptions options;
+	options.huge_pages = true;
+	options.lock = true;
+	options.prefault = true;
+
+	static constexpr unsigned N = 8;
+	MusicBuffer buffer(N, CHUNK_SIZE, options);
+
+	MusicChunk *chunks[N];
+	for (auto &i : chunks) {
+		i = buffer.Allocate();
+		CPPUNIT_ASSERT(i != nullptr);
+		memset(i->data, 0x55, i->capacity);
+	}
+
+	for (auto *i : chunks)
+		buffer.Return(i);
+
+	/* a resident buffer keeps its memory */
+	buffer.Discard();
+	MusicChunk *chunk = buffer.Allocate();
+	CPPUNIT_ASSERT(chunk != nullptr);
+	buffer.Return(chunk);
+}
+
+struct StressContext {
+	MusicBuffer *buffer;
+	unsigned id;
+	bool ok;
+};
+
+static void
+StressThread(void *_ctx)
+{
+	StressContext &ctx = *(StressContext *)_ctx;
+	ctx.ok = true;
+
+	for (unsigned i = 0; i < 100000; ++i) {
+		MusicChunk *chunk = ctx.buffer->Allocate();
+		if (chunk == nullptr)
+			continue;
+
+		/* fill the chunk and verify that no other thread
+		   has touched it meanwhile */
+		chunk->bit_rate = ctx.id;
+		chunk->data[0] = ctx.id;
+		if (chunk->bit_rate != ctx.id || chunk->data[0] != ctx.id)
+			ctx.ok = false;
+
+		ctx.buffer->Return(chunk);
+	}
+}
+
+void
+MusicBufferTest::TestThreads()
+{
+	static constexpr unsigned N = 4;
+	MusicBuffer buffer(3, CHUNK_SIZE);
+
+	Thread threads[N];
+	StressContext contexts[N];
+
+	for (unsigned i = 0; i < N; ++i) {
+		contexts[i].buffer = &buffer;
+		contexts[i].id = i + 1;
+
+		Error error;
+		CPPUNIT_ASSERT(threads[i].Start(StressThread, &contexts[i],
+						error));
+	}
+
+	for (unsigned i = 0; i < N; ++i) {
+		threads[i].Join();
+		CPPUNIT_ASSERT(contexts[i].ok);
+	}
+
+	CPPUNIT_ASSERT(buffer.IsEmptyUnsafe());
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(MusicBufferTest);
+
+class MusicPipeTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(MusicPipeTest);
+	CPPUNIT_TEST(TestRing);
+	CPPUNIT_TEST(TestUnshift);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestRing();
+	void TestUnshift();
+};
+
+static MusicChunk *
+MakeChunk(MusicBuffer &buffer, const AudioFormat af)
+{
+	MusicChunk *chunk = buffer.Allocate();
+	CPPUNIT_ASSERT(chunk != nullptr);
+
+	auto w = chunk->Write(af, SongTime::zero(), 0);
+	CPPUNIT_ASSERT(!w.IsEmpty());
+	chunk->Expand(af, af.GetFrameSize());
+	return chunk;
+}
+
+void
+MusicPipeTest::TestRing()
+{
+	static constexpr unsigned N = 4;
+	const AudioFormat af(44100, SampleFormat::S16, 2);
+
+	MusicBuffer buffer(N, CHUNK_SIZE);
+	MusicPipe pipe(buffer.GetSize());
+
+	CPPUNIT_ASSERT(pipe.IsEmpty());
+	CPPUNIT_ASSERT(pipe.Peek() == nullptr);
+
+	/* run through the ring several times, with a reader
+	   following the producer */
+	MusicPipe::Position reader = pipe.GetHead();
+	for (unsigned i = 0; i < N * 5; ++i) {
+		while (pipe.GetSize() < N)
+			pipe.Push(MakeChunk(buffer, af));
+
+		CPPUNIT_ASSERT_EQUAL(N, pipe.GetSize());
+		CPPUNIT_ASSERT_EQUAL(pipe.GetHead() + N, pipe.GetTail());
+
+		/* the reader consumes two chunks */
+		CPPUNIT_ASSERT(reader < pipe.GetTail());
+		CPPUNIT_ASSERT(pipe.Get(reader) == pipe.Peek());
+		reader += 2;
+
+		/* reclaim everything the reader has passed */
+		while (pipe.GetHead() < reader) {
+			const MusicChunk *peek = pipe.Peek();
+			MusicChunk *chunk = pipe.Shift();
+			CPPUNIT_ASSERT(chunk == peek);
+			buffer.Return(chunk);
+		}
+
+		CPPUNIT_ASSERT_EQUAL(N - 2, pipe.GetSize());
+	}
+
+	pipe.Clear(buffer);
+	CPPUNIT_ASSERT(pipe.IsEmpty());
+	CPPUNIT_ASSERT(buffer.IsEmptyUnsafe());
+}
+
+void
+MusicPipeTest::TestUnshift()
+{
+	static constexpr unsigned N = 4;
+	const AudioFormat af(44100, SampleFormat::S16, 2);
+
+	MusicBuffer buffer(N, CHUNK_SIZE);
+	MusicPipe pipe(buffer.GetSize());
+
+	MusicChunk *chunks[N];
+	for (auto &i : chunks)
+		pipe.Push(i = MakeChunk(buffer, af));
+
+	/* take three chunks, and put two of them back */
+	MusicChunk *a = pipe.Shift(), *b = pipe.Shift(), *c = pipe.Shift();
+	CPPUNIT_ASSERT(a == chunks[0]);
+	CPPUNIT_ASSERT(b == chunks[1]);
+	CPPUNIT_ASSERT(c == chunks[2]);
+	CPPUNIT_ASSERT_EQUAL(1u, pipe.GetSize());
+
+	pipe.Unshift(c);
+	pipe.Unshift(b);
+	CPPUNIT_ASSERT_EQUAL(3u, pipe.GetSize());
+	CPPUNIT_ASSERT_EQUAL(MusicPipe::Position(1), pipe.GetHead());
+	CPPUNIT_ASSERT(pipe.Peek() == b);
+
+	/* the producer may continue while the ring is full */
+	buffer.Return(a);
+	pipe.Push(chunks[0] = MakeChunk(buffer, af));
+	CPPUNIT_ASSERT_EQUAL(N, pipe.GetSize());
+
+	CPPUNIT_ASSERT(pipe.Shift() == b);
+	CPPUNIT_ASSERT(pipe.Shift() == c);
+	CPPUNIT_ASSERT(pipe.Shift() == chunks[3]);
+	CPPUNIT_ASSERT(pipe.Shift() == chunks[0]);
+	CPPUNIT_ASSERT(pipe.IsEmpty());
+
+	buffer.Return(b);
+	buffer.Return(c);
+	buffer.Return(chunks[3]);
+	buffer.Return(chunks[0]);
+	CPPUNIT_ASSERT(buffer.IsEmptyUnsafe());
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(MusicPipeTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -27,11 +27,13 @@ class PcmDitherTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(PcmDitherTest);
 	CPPUNIT_TEST(TestDither24);
 	CPPUNIT_TEST(TestDither32);
+	CPPUNIT_TEST(TestDitherBlock);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
 	void TestDither24();
 	void TestDither32();
+	void TestDitherBlock();
 };
 
 class PcmPackTest : public CppUnit::TestFixture {
@@ -49,11 +51,13 @@ class PcmChannelsTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(PcmChannelsTest);
 	CPPUNIT_TEST(TestChannels16);
 	CPPUNIT_TEST(TestChannels32);
+	CPPUNIT_TEST(TestChannelsMatrix);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
 	void TestChannels16();
 	void TestChannels32();
+	void TestChannelsMatrix();
 };
 
 class PcmVolumeTest : public CppUnit::TestFixture {
@@ -79,6 +83,8 @@ class PcmFormatTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(TestFormat16to24);
 	CPPUNIT_TEST(TestFormat16to32);
 	CPPUNIT_TEST(TestFormatFloat);
+	CPPUNIT_TEST(TestFormatFloat24);
+	CPPUNIT_TEST(TestFormatFloat32);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -86,6 +92,8 @@ public:
 	void TestFormat16to24();
 	void TestFormat16to32();
 	void TestFormatFloat();
+	void TestFormatFloat24();
+	void TestFormatFloat32();
 };
 
 class PcmMixTest : public CppUnit::TestFixture {
@@ -94,6 +102,9 @@ class PcmMixTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(TestMix16);
 	CPPUNIT_TEST(TestMix24);
 	CPPUNIT_TEST(TestMix32);
+	CPPUNIT_TEST(TestMixFloat);
+	CPPUNIT_TEST(TestMixRamp16);
+	CPPUNIT_TEST(TestMixRamp32);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -101,6 +112,9 @@ public:
 	void TestMix16();
 	void TestMix24();
 	void TestMix32();
+	void TestMixFloat();
+	void TestMixRamp16();
+	void TestMixRamp32();
 };
 
 class PcmInterleaveTest : public CppUnit::TestFixture {
@@ -110,6 +124,8 @@ class PcmInterleaveTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(TestInterleave24);
 	CPPUNIT_TEST(TestInterleave32);
 	CPPUNIT_TEST(TestInterleave64);
+	CPPUNIT_TEST(TestInterleaveChannels);
+	CPPUNIT_TEST(TestDeinterleave);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -118,6 +134,8 @@ public:
 	void TestInterleave24();
 	void TestInterleave32();
 	void TestInterleave64();
+	void TestInterleaveChannels();
+	void TestDeinterleave();
 };
 
 class PcmExportTest : public CppUnit::TestFixture {
@@ -125,9 +143,11 @@ class PcmExportTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST(TestShift8);
 	CPPUNIT_TEST(TestPack24);
 	CPPUNIT_TEST(TestReverseEndian);
+	CPPUNIT_TEST(TestCombined);
 #ifdef ENABLE_DSD
 	CPPUNIT_TEST(TestDsdU32);
 	CPPUNIT_TEST(TestDop);
+	CPPUNIT_TEST(TestDopCombined);
 #endif
 	CPPUNIT_TEST(TestAlsaChannelOrder);
 	CPPUNIT_TEST_SUITE_END();
@@ -136,11 +156,26 @@ public:
 	void TestShift8();
 	void TestPack24();
 	void TestReverseEndian();
+	void TestCombined();
 #ifdef ENABLE_DSD
 	void TestDsdU32();
 	void TestDop();
+	void TestDopCombined();
 #endif
 	void TestAlsaChannelOrder();
 };
 
+#ifdef ENABLE_DSD
+class PcmDsdTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PcmDsdTest);
+	CPPUNIT_TEST(TestToFloat);
+	CPPUNIT_TEST(TestDecimation);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestToFloat();
+	void TestDecimation();
+};
+#endif
+
 #endif
@@ -23,6 +23,11 @@
 #include "pcm/PcmChannels.hxx"
 #include "pcm/PcmBuffer.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/Macros.hxx"
+
+#include <algorithm>
+
+#include <math.h>
 
 void
 PcmChannelsTest::TestChannels16()
@@ -79,3 +84,60 @@ PcmChannelsTest::TestChannels32()
 		CPPUNIT_ASSERT_EQUAL(src[i], dest[i * 2 + 1]);
 	}
 }
+
+void
+PcmChannelsTest::TestChannelsMatrix()
+{
+	PcmBuffer buffer;
+
+	/* 5.1 to stereo: center and surround at -3 dB, no LFE,
+	   scaled to avoid clipping */
+
+	static constexpr float src51[] = {
+		1, 0, 0, 0, 0, 0,
+		0, 0, 1, 0, 0, 0,
+		0, 0, 0, 1, 0, 0,
+		0, 0, 0, 0, 0, 1,
+	};
+
+	const float scale = 1 / (1 + 2 * M_SQRT1_2);
+
+	auto dest = pcm_convert_channels_float(buffer, 2, 6,
+					       { src51, ARRAY_SIZE(src51) });
+	CPPUNIT_ASSERT_EQUAL(size_t(8), dest.size);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(scale, dest[0], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0, dest[1], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(M_SQRT1_2 * scale, dest[2], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(M_SQRT1_2 * scale, dest[3], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0, dest[4], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0, dest[5], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(0, dest[6], 1e-6);
+	CPPUNIT_ASSERT_DOUBLES_EQUAL(M_SQRT1_2 * scale, dest[7], 1e-6);
+
+	/* a full scale 7.1 signal must not clip */
+
+	constexpr size_t N = 100;
+	int16_t src71[N * 8];
+	std::fill_n(src71, N * 8, 32767);
+
+	auto dest16 = pcm_convert_channels_16(buffer, 2, 8, { src71, N * 8 });
+	CPPUNIT_ASSERT_EQUAL(N * 2, dest16.size);
+	for (auto i : dest16) {
+		CPPUNIT_ASSERT(i > 32000);
+		CPPUNIT_ASSERT(i <= 32767);
+	}
+
+	/* stereo to 5.1: front channels only */
+
+	static constexpr int32_t src2[] = { 100, -200, 300, -400 };
+	static constexpr int32_t expected51[] = {
+		100, -200, 0, 0, 0, 0,
+		300, -400, 0, 0, 0, 0,
+	};
+
+	auto dest32 = pcm_convert_channels_32(buffer, 6, 2,
+					      { src2, ARRAY_SIZE(src2) });
+	CPPUNIT_ASSERT_EQUAL(ARRAY_SIZE(expected51), dest32.size);
+	for (unsigned i = 0; i < dest32.size; ++i)
+		CPPUNIT_ASSERT_EQUAL(expected51[i], dest32[i]);
+}
@@ -21,6 +21,8 @@
 #include "test_pcm_util.hxx"
 #include "pcm/PcmDither.cxx"
 
+#include <algorithm>
+
 void
 PcmDitherTest::TestDither24()
 {
@@ -52,3 +54,51 @@ PcmDitherTest::TestDither32()
 		CPPUNIT_ASSERT(dest[i] < (src[i] >> 16) + 8);
 	}
 }
+
+/**
+ * Compare the block implementation with the per-sample reference
+ * PcmDither::DitherShift().
+ */
+template<typename ST, unsigned SBITS, typename G>
+static void
+CheckDitherBlock(G g)
+{
+	constexpr unsigned N = 1021;
+	auto src = TestDataBuffer<int32_t, N>(g);
+
+	/* include samples which get clipped */
+	constexpr int32_t max = (ST(1) << (SBITS - 1)) - 1;
+	constexpr int32_t min = -max - 1;
+	for (unsigned i = 0; i < N; i += 97) {
+		src[i] = max;
+		src[i + 1] = min;
+	}
+
+	ST wide[N];
+	std::copy(src.begin(), src.end(), wide);
+
+	int16_t dest[N], expected[N];
+
+	PcmDither a, b;
+	a.DitherShiftBlock<ST, SBITS, 16>(dest, wide, N);
+	for (unsigned i = 0; i < N; ++i)
+		expected[i] = b.DitherShift<ST, SBITS, 16>(src[i]);
+
+	for (unsigned i = 0; i < N; ++i)
+		CPPUNIT_ASSERT_EQUAL(expected[i], dest[i]);
+
+	/* the state must be carried over to the next call */
+	a.DitherShiftBlock<ST, SBITS, 16>(dest, wide, N);
+	for (unsigned i = 0; i < N; ++i)
+		expected[i] = b.DitherShift<ST, SBITS, 16>(src[i]);
+
+	for (unsigned i = 0; i < N; ++i)
+		CPPUNIT_ASSERT_EQUAL(expected[i], dest[i]);
+}
+
+void
+PcmDitherTest::TestDitherBlock()
+{
+	CheckDitherBlock<int32_t, 24>(RandomInt24());
+	CheckDitherBlock<int64_t, 32>(RandomInt<int32_t>());
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright 2003-2016 The Music Player Daemon Project
+ * http://www.musicpd.org
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+#include "test_pcm_all.hxx"
+#include "test_pcm_util.hxx"
+#include "pcm/PcmDsd.hxx"
+#include "pcm/dsd2pcm/dsd2pcm.h"
+#include "util/ConstBuffer.hxx"
+
+#include <memory>
+
+void
+PcmDsdTest::TestToFloat()
+{
+	constexpr unsigned channels = 6;
+	constexpr size_t n_frames = 1024;
+	const TestDataBuffer<uint8_t, channels * n_frames> src;
+
+	PcmDsd dsd;
+	auto dest = dsd.ToFloat(channels, src);
+	CPPUNIT_ASSERT_EQUAL(size_t(channels * n_frames), dest.size);
+
+	/* compare with the reference implementation; skip the first
+	   frames, which differ after a reset because dsd2pcm
+	   bit-reverses its FIFO in place */
+	constexpr size_t skip = 16;
+
+	for (unsigned c = 0; c < channels; ++c) {
+		std::unique_ptr<dsd2pcm_ctx, decltype(&dsd2pcm_destroy)>
+			ctx(dsd2pcm_init(), dsd2pcm_destroy);
+
+		float expected[n_frames];
+		dsd2pcm_translate(ctx.get(), n_frames, src + c, channels,
+				  false, expected, 1);
+
+		for (size_t i = skip; i < n_frames; ++i)
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(expected[i],
+						     dest[i * channels + c],
+						     1e-5);
+	}
+}
+
+void
+PcmDsdTest::TestDecimation()
+{
+	constexpr unsigned channels = 2;
+	constexpr size_t n_frames = 4096;
+
+	/* a constant bit pattern with a DC component: 6 of 8 bits
+	   set, i.e. +0.5 */
+	std::array<uint8_t, channels * n_frames> src;
+	src.fill(0xee);
+
+	PcmDsd dsd;
+	const auto full = dsd.ToFloat(channels, {src.begin(), src.size()});
+	const float level = full[full.size - 1];
+
+	for (unsigned factor = 2; factor <= PcmDsd::MAX_DECIMATION;
+	     factor *= 2) {
+		dsd.Reset();
+		dsd.SetDecimation(factor);
+
+		/* feed in two chunks to check the filter history */
+		const ConstBuffer<uint8_t> a(src.begin(), src.size() / 2);
+		const ConstBuffer<uint8_t> b(src.begin() + a.size,
+					     src.size() - a.size);
+		size_t total = dsd.ToFloat(channels, a).size;
+		const auto dest = dsd.ToFloat(channels, b);
+		total += dest.size;
+
+		CPPUNIT_ASSERT_EQUAL(size_t(channels * n_frames / factor),
+				     total);
+
+		/* the halfband filters have unity gain at DC */
+		for (size_t i = dest.size / 2; i < dest.size; ++i)
+			CPPUNIT_ASSERT_DOUBLES_EQUAL(level, dest[i], 1e-3);
+	}
+}
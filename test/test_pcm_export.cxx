@@ -115,6 +115,58 @@ PcmExportTest::TestReverseEndian()
 	CPPUNIT_ASSERT(memcmp(dest.data, expected4, dest.size) == 0);
 }
 
+void
+PcmExportTest::TestCombined()
+{
+	static constexpr int32_t src[] = {
+		0x000001, 0x000102, 0x010203, 0x020304, 0x030405, 0x040506,
+	};
+
+	static constexpr uint8_t expected_be[] = {
+		0x00, 0x00, 0x01,
+		0x00, 0x01, 0x02,
+		0x03, 0x04, 0x05,
+		0x04, 0x05, 0x06,
+		0x01, 0x02, 0x03,
+		0x02, 0x03, 0x04,
+	};
+
+	static constexpr uint8_t expected_le[] = {
+		0x01, 0x00, 0x00,
+		0x02, 0x01, 0x00,
+		0x05, 0x04, 0x03,
+		0x06, 0x05, 0x04,
+		0x03, 0x02, 0x01,
+		0x04, 0x03, 0x02,
+	};
+
+	static constexpr size_t expected_size = sizeof(expected_be);
+
+	/* reverse_endian produces the opposite of the host byte
+	   order */
+	static const uint8_t *const expected = IsBigEndian()
+		? expected_le : expected_be;
+
+	PcmExport::Params params;
+	params.alsa_channel_order = true;
+	params.pack24 = true;
+	params.reverse_endian = true;
+
+	PcmExport e;
+	e.Open(SampleFormat::S24_P32, 6, params);
+
+	auto dest = e.Export({src, sizeof(src)});
+	CPPUNIT_ASSERT_EQUAL(expected_size, dest.size);
+	CPPUNIT_ASSERT(memcmp(dest.data, expected, dest.size) == 0);
+	CPPUNIT_ASSERT_EQUAL(sizeof(src), e.CalcSourceSize(dest.size));
+
+	uint8_t buffer[expected_size];
+	CPPUNIT_ASSERT_EQUAL(expected_size, e.CalcDestSize(sizeof(src)));
+	CPPUNIT_ASSERT_EQUAL(expected_size,
+			     e.ExportTo(buffer, {src, sizeof(src)}));
+	CPPUNIT_ASSERT(memcmp(buffer, expected, expected_size) == 0);
+}
+
 #ifdef ENABLE_DSD
 
 void
@@ -171,6 +223,66 @@ PcmExportTest::TestDop()
 	CPPUNIT_ASSERT(memcmp(dest.data, expected, dest.size) == 0);
 }
 
+void
+PcmExportTest::TestDopCombined()
+{
+	/* long enough to cover the vectorized code path plus a
+	   remainder, and a trailing incomplete block */
+	uint8_t src[44];
+	for (size_t i = 0; i < sizeof(src); ++i)
+		src[i] = i * 37 + 11;
+
+	uint32_t dop[20];
+	for (size_t i = 0; i < 10; ++i) {
+		const uint8_t *p = src + (i / 2) * 8 + (i % 2) * 4;
+		const uint32_t marker = i % 2 == 0 ? 0xff050000 : 0xfffa0000;
+		dop[i * 2] = marker | (p[0] << 8) | p[2];
+		dop[i * 2 + 1] = marker | (p[1] << 8) | p[3];
+	}
+
+	PcmExport::Params params;
+	params.dop = true;
+
+	PcmExport e;
+	e.Open(SampleFormat::DSD, 2, params);
+
+	auto dest = e.Export({src, sizeof(src)});
+	CPPUNIT_ASSERT_EQUAL(sizeof(dop), dest.size);
+	CPPUNIT_ASSERT(memcmp(dest.data, dop, dest.size) == 0);
+
+	params.shift8 = true;
+	e.Open(SampleFormat::DSD, 2, params);
+
+	uint32_t shifted[20];
+	for (size_t i = 0; i < 20; ++i)
+		shifted[i] = dop[i] << 8;
+
+	dest = e.Export({src, sizeof(src)});
+	CPPUNIT_ASSERT_EQUAL(sizeof(shifted), dest.size);
+	CPPUNIT_ASSERT(memcmp(dest.data, shifted, dest.size) == 0);
+
+	params.shift8 = false;
+	params.pack24 = true;
+	e.Open(SampleFormat::DSD, 2, params);
+
+	uint8_t packed[60];
+	for (size_t i = 0; i < 20; ++i) {
+		if (IsBigEndian()) {
+			packed[i * 3] = dop[i] >> 16;
+			packed[i * 3 + 1] = dop[i] >> 8;
+			packed[i * 3 + 2] = dop[i];
+		} else {
+			packed[i * 3] = dop[i];
+			packed[i * 3 + 1] = dop[i] >> 8;
+			packed[i * 3 + 2] = dop[i] >> 16;
+		}
+	}
+
+	dest = e.Export({src, sizeof(src)});
+	CPPUNIT_ASSERT_EQUAL(sizeof(packed), dest.size);
+	CPPUNIT_ASSERT(memcmp(dest.data, packed, dest.size) == 0);
+}
+
 #endif
 
 template<SampleFormat F, class Traits=SampleTraits<F>>
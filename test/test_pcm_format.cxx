@@ -118,3 +118,77 @@ PcmFormatTest::TestFormatFloat()
 	for (size_t i = 4; i < N; ++i)
 		CPPUNIT_ASSERT_EQUAL(src[i], d[i]);
 }
+
+void
+PcmFormatTest::TestFormatFloat24()
+{
+	constexpr size_t N = 509;
+	const auto src = TestDataBuffer<int32_t, N>(RandomInt24());
+
+	PcmBuffer buffer1, buffer2;
+
+	auto f = pcm_convert_to_float(buffer1, SampleFormat::S24_P32, src);
+	CPPUNIT_ASSERT_EQUAL(N, f.size);
+
+	for (size_t i = 0; i != f.size; ++i) {
+		CPPUNIT_ASSERT(f[i] >= -1.);
+		CPPUNIT_ASSERT(f[i] <= 1.);
+	}
+
+	/* 24 bit fit into the float mantissa, so the round trip is
+	   lossless */
+	auto d = pcm_convert_to_24(buffer2, SampleFormat::FLOAT, f.ToVoid());
+	CPPUNIT_ASSERT_EQUAL(N, d.size);
+
+	for (size_t i = 0; i < N; ++i)
+		CPPUNIT_ASSERT_EQUAL(src[i], d[i]);
+
+	/* check if clamping works */
+	float *writable = const_cast<float *>(f.data);
+	writable[0] = 1.01;
+	writable[1] = -1.01;
+
+	d = pcm_convert_to_24(buffer2, SampleFormat::FLOAT, f.ToVoid());
+	CPPUNIT_ASSERT_EQUAL(0x7fffff, int(d[0]));
+	CPPUNIT_ASSERT_EQUAL(-0x800000, int(d[1]));
+}
+
+void
+PcmFormatTest::TestFormatFloat32()
+{
+	constexpr size_t N = 509;
+	const auto src = TestDataBuffer<int32_t, N>();
+
+	PcmBuffer buffer1, buffer2;
+
+	auto f = pcm_convert_to_float(buffer1, SampleFormat::S32, src);
+	CPPUNIT_ASSERT_EQUAL(N, f.size);
+
+	for (size_t i = 0; i != f.size; ++i) {
+		CPPUNIT_ASSERT(f[i] >= -1.);
+		CPPUNIT_ASSERT(f[i] <= 1.);
+	}
+
+	/* the float mantissa has only 24 bits, so the lowest 8 bits
+	   are lost */
+	auto d = pcm_convert_to_32(buffer2, SampleFormat::FLOAT, f.ToVoid());
+	CPPUNIT_ASSERT_EQUAL(N, d.size);
+
+	for (size_t i = 0; i < N; ++i) {
+		CPPUNIT_ASSERT(int64_t(d[i]) >= int64_t(src[i]) - 256);
+		CPPUNIT_ASSERT(int64_t(d[i]) <= int64_t(src[i]) + 256);
+	}
+
+	/* check if clamping works */
+	float *writable = const_cast<float *>(f.data);
+	writable[0] = 1.01;
+	writable[1] = 10;
+	writable[2] = -1.01;
+	writable[3] = -1;
+
+	d = pcm_convert_to_32(buffer2, SampleFormat::FLOAT, f.ToVoid());
+	CPPUNIT_ASSERT_EQUAL(0x7fffffff, int(d[0]));
+	CPPUNIT_ASSERT_EQUAL(0x7fffffff, int(d[1]));
+	CPPUNIT_ASSERT_EQUAL(-0x7fffffff - 1, int(d[2]));
+	CPPUNIT_ASSERT_EQUAL(-0x7fffffff - 1, int(d[3]));
+}
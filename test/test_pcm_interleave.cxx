@@ -20,6 +20,7 @@
 #include "config.h"
 #include "test_pcm_all.hxx"
 #include "pcm/Interleave.hxx"
+#include "AudioFormat.hxx"
 #include "util/Macros.hxx"
 
 #include <algorithm>
@@ -124,3 +125,69 @@ PcmInterleaveTest::TestInterleave64()
 {
 	TestInterleaveN<uint64_t>();
 }
+
+/**
+ * Interleave and deinterleave a buffer with an odd number of frames,
+ * to cover both the optimized kernels and their tails.
+ */
+template<typename T>
+static void
+TestRoundTrip(unsigned channels)
+{
+	static constexpr size_t n_frames = 37;
+
+	T planes[MAX_CHANNELS][n_frames];
+	const void *src[MAX_CHANNELS];
+	for (unsigned c = 0; c < channels; ++c) {
+		for (size_t i = 0; i < n_frames; ++i)
+			planes[c][i] = T(int(c * 1000 + i) - 3000);
+		src[c] = planes[c];
+	}
+
+	static constexpr T poison = T(0xdeadbeef);
+	T dest[n_frames * MAX_CHANNELS + 1];
+	std::fill_n(dest, ARRAY_SIZE(dest), poison);
+
+	PcmInterleave(dest, {src, channels}, n_frames, sizeof(T));
+
+	for (size_t i = 0; i < n_frames; ++i)
+		for (unsigned c = 0; c < channels; ++c)
+			CPPUNIT_ASSERT_EQUAL(planes[c][i],
+					     dest[i * channels + c]);
+	CPPUNIT_ASSERT_EQUAL(poison, dest[n_frames * channels]);
+
+	T result[MAX_CHANNELS][n_frames + 1];
+	void *dest_planes[MAX_CHANNELS];
+	for (unsigned c = 0; c < channels; ++c) {
+		std::fill_n(result[c], n_frames + 1, poison);
+		dest_planes[c] = result[c];
+	}
+
+	PcmDeinterleave({dest_planes, channels}, dest, n_frames, sizeof(T));
+
+	for (unsigned c = 0; c < channels; ++c) {
+		for (size_t i = 0; i < n_frames; ++i)
+			CPPUNIT_ASSERT_EQUAL(planes[c][i], result[c][i]);
+		CPPUNIT_ASSERT_EQUAL(poison, result[c][n_frames]);
+	}
+}
+
+void
+PcmInterleaveTest::TestInterleaveChannels()
+{
+	for (unsigned channels : {2, 6, 8}) {
+		TestRoundTrip<int16_t>(channels);
+		TestRoundTrip<int32_t>(channels);
+	}
+}
+
+void
+PcmInterleaveTest::TestDeinterleave()
+{
+	for (unsigned channels = 1; channels <= MAX_CHANNELS; ++channels) {
+		TestRoundTrip<uint8_t>(channels);
+		TestRoundTrip<int16_t>(channels);
+		TestRoundTrip<int32_t>(channels);
+		TestRoundTrip<uint64_t>(channels);
+	}
+}
@@ -22,6 +22,15 @@
 #include "test_pcm_util.hxx"
 #include "pcm/PcmMix.hxx"
 #include "pcm/PcmDither.hxx"
+#include "pcm/Traits.hxx"
+#include "pcm/Volume.hxx"
+#include "util/Clamp.hxx"
+
+#include "pcm/PcmDither.cxx"
+
+#include <type_traits>
+
+#include <math.h>
 
 template<typename T, SampleFormat format, typename G=RandomInt<T>>
 static void
@@ -59,6 +68,46 @@ TestPcmMix(G g=G())
 		expected[i] = (int64_t(src1[i]) + int64_t(src2[i])) / 2;
 
 	AssertEqualWithTolerance(result, expected, 3);
+
+	/* the (possibly SIMD) implementation must be bit-identical to
+	   the portable per-sample code */
+	typedef SampleTraits<format> Traits;
+	typedef typename Traits::long_type long_type;
+
+	float s = sin(M_PI_2 * 0.5);
+	s *= s;
+	const int vol1 = s * PCM_VOLUME_1S + 0.5;
+	const int vol2 = PCM_VOLUME_1S - vol1;
+
+	PcmDither dither2;
+	for (unsigned i = 0; i < N; ++i)
+		expected[i] = dither2.DitherShift<long_type,
+						  Traits::BITS + PCM_VOLUME_BITS,
+						  Traits::BITS>(long_type(src1[i]) * vol1 +
+								long_type(src2[i]) * vol2);
+
+	dither = PcmDither();
+	result = src1;
+	success = pcm_mix(dither, result.begin(), src2.begin(), sizeof(result),
+			  format, 0.5);
+	CPPUNIT_ASSERT(success);
+	for (unsigned i = 0; i < N; ++i)
+		CPPUNIT_ASSERT_EQUAL(expected[i], result[i]);
+
+	/* portion1<0: add with saturation */
+	result = src1;
+	success = pcm_mix(dither, result.begin(), src2.begin(), sizeof(result),
+			  format, -1);
+	CPPUNIT_ASSERT(success);
+
+	for (unsigned i = 0; i < N; ++i) {
+		int64_t sum = int64_t(src1[i]) + int64_t(src2[i]);
+		if (sum < Traits::MIN)
+			sum = Traits::MIN;
+		else if (sum > Traits::MAX)
+			sum = Traits::MAX;
+		CPPUNIT_ASSERT_EQUAL(T(sum), result[i]);
+	}
 }
 
 void
@@ -84,3 +133,155 @@ PcmMixTest::TestMix32()
 {
 	TestPcmMix<int32_t, SampleFormat::S32>();
 }
+
+void
+PcmMixTest::TestMixFloat()
+{
+	constexpr unsigned N = 509;
+	const auto src1 = TestDataBuffer<float, N>(RandomFloat());
+	const auto src2 = TestDataBuffer<float, N>(RandomFloat());
+
+	PcmDither dither;
+
+	auto result = src1;
+	bool success = pcm_mix(dither,
+			       result.begin(), src2.begin(), sizeof(result),
+			       SampleFormat::FLOAT, 0.5);
+	CPPUNIT_ASSERT(success);
+
+	float s = sin(M_PI_2 * 0.5);
+	s *= s;
+	const int vol1 = s * PCM_VOLUME_1S + 0.5;
+	const float v1 = pcm_volume_to_float(vol1);
+	const float v2 = pcm_volume_to_float(PCM_VOLUME_1S - vol1);
+
+	for (unsigned i = 0; i < N; ++i) {
+		const float expected = src1[i] * v1 + src2[i] * v2;
+		CPPUNIT_ASSERT_EQUAL(expected, result[i]);
+	}
+
+	result = src1;
+	success = pcm_mix(dither, result.begin(), src2.begin(), sizeof(result),
+			  SampleFormat::FLOAT, -1);
+	CPPUNIT_ASSERT(success);
+
+	for (unsigned i = 0; i < N; ++i)
+		CPPUNIT_ASSERT_EQUAL(src1[i] + src2[i], result[i]);
+}
+
+/**
+ * A portable implementation of pcm_mix_ramp() for integer samples:
+ * mix in floating point with the gain stepped the same way (per
+ * block of 64 frames), then dither each sample with DitherShift().
+ */
+template<SampleFormat format, typename B>
+static B
+MixRampReference(const B &src1, const B &src2, unsigned channels,
+		 float portion_start, float portion_end)
+{
+	typedef SampleTraits<format> Traits;
+	typedef typename Traits::long_type long_type;
+	typedef typename std::conditional<Traits::BITS <= 24,
+					  float, double>::type mix_type;
+	constexpr mix_type scale = 1 << PCM_VOLUME_BITS;
+	constexpr size_t BLOCK_FRAMES = 64;
+
+	double gain = sin(M_PI_2 * portion_start);
+	gain *= gain;
+	double gain_end = sin(M_PI_2 * portion_end);
+	gain_end *= gain_end;
+
+	const size_t n_frames = src1.size() / channels;
+	const double step = (gain_end - gain) / n_frames;
+
+	PcmDither dither;
+	B result = src1;
+	for (size_t frame = 0; frame < n_frames; ++frame) {
+		const size_t i_block = frame % BLOCK_FRAMES;
+		if (frame > 0 && i_block == 0)
+			gain += BLOCK_FRAMES * step;
+
+		const mix_type g = gain + i_block * step;
+		for (unsigned c = 0; c < channels; ++c) {
+			const size_t i = frame * channels + c;
+			const mix_type x = src1[i], y = src2[i];
+			const long_type v((y + (x - y) * g) * scale);
+			result[i] = dither.DitherShift<long_type,
+						       Traits::BITS + PCM_VOLUME_BITS,
+						       Traits::BITS>(v);
+		}
+	}
+
+	return result;
+}
+
+template<typename T, SampleFormat format, typename G=RandomInt<T>>
+static void
+TestPcmMixRamp(G g=G())
+{
+	constexpr unsigned CHANNELS = 2;
+	constexpr unsigned N_FRAMES = 509;
+	constexpr unsigned N = N_FRAMES * CHANNELS;
+	const auto src1 = TestDataBuffer<T, N>(g);
+	const auto src2 = TestDataBuffer<T, N>(g);
+
+	PcmDither dither;
+
+	/* a constant ramp */
+	auto result = src1;
+	bool success = pcm_mix_ramp(dither, result.begin(), src2.begin(),
+				    sizeof(result), format, CHANNELS,
+				    0.5, 0.5);
+	CPPUNIT_ASSERT(success);
+
+	auto expected = MixRampReference<format>(src1, src2, CHANNELS,
+						 0.5, 0.5);
+	for (unsigned i = 0; i < N; ++i)
+		CPPUNIT_ASSERT_EQUAL(expected[i], result[i]);
+
+	/* fade from src1 to src2; the gain is interpolated linearly
+	   between the two end points, and both channels of a frame
+	   get the same gain */
+	dither = PcmDither();
+	result = src1;
+	success = pcm_mix_ramp(dither, result.begin(), src2.begin(),
+			       sizeof(result), format, CHANNELS,
+			       1.0, 0.0);
+	CPPUNIT_ASSERT(success);
+
+	expected = MixRampReference<format>(src1, src2, CHANNELS, 1.0, 0.0);
+	for (unsigned i = 0; i < N; ++i)
+		CPPUNIT_ASSERT_EQUAL(expected[i], result[i]);
+
+	/* ... which is close to the ideal linear fade */
+	for (unsigned i = 0; i < N; ++i) {
+		const unsigned frame = i / CHANNELS;
+		const double s = 1.0 - double(frame) / N_FRAMES;
+		expected[i] = llround(src2[i] + (double(src1[i]) - src2[i]) * s);
+	}
+
+	/* the dither's noise shaping moves a sample by up to 4 */
+	AssertEqualWithTolerance(result, expected, 4);
+
+	/* MixRamp: add */
+	result = src1;
+	success = pcm_mix_ramp(dither, result.begin(), src2.begin(),
+			       sizeof(result), format, CHANNELS, -1, -1);
+	CPPUNIT_ASSERT(success);
+	CPPUNIT_ASSERT_EQUAL(T(Clamp<int64_t>(int64_t(src1[0]) + src2[0],
+					      SampleTraits<format>::MIN,
+					      SampleTraits<format>::MAX)),
+			     result[0]);
+}
+
+void
+PcmMixTest::TestMixRamp16()
+{
+	TestPcmMixRamp<int16_t, SampleFormat::S16>();
+}
+
+void
+PcmMixTest::TestMixRamp32()
+{
+	TestPcmMixRamp<int32_t, SampleFormat::S32>();
+}
@@ -22,8 +22,10 @@
 #include "pcm/Volume.hxx"
 #include "pcm/Traits.hxx"
 #include "util/ConstBuffer.hxx"
+#include "util/WritableBuffer.hxx"
 #include "util/Error.hxx"
 #include "test_pcm_util.hxx"
+#include "pcm/PcmDither.cxx"
 
 #include <algorithm>
 
@@ -65,6 +67,30 @@ TestVolume(G g=G())
 		CPPUNIT_ASSERT(_dest[i] <= expected + 4);
 	}
 
+	/* the (possibly SIMD) implementation must be bit-identical to
+	   the portable per-sample code */
+	typedef typename Traits::long_type long_type;
+	PcmDither dither;
+	for (unsigned i = 0; i < N; ++i) {
+		const long_type sample = long_type(_src[i]) * (PCM_VOLUME_1S / 2);
+		const value_type expected =
+			dither.DitherShift<long_type,
+					   Traits::BITS + PCM_VOLUME_BITS,
+					   Traits::BITS>(sample);
+		CPPUNIT_ASSERT_EQUAL(expected, _dest[i]);
+	}
+
+	/* ApplyInPlace() must yield the same result as Apply() */
+	PcmVolume pv2;
+	CPPUNIT_ASSERT(pv2.Open(F, IgnoreError()));
+	pv2.SetVolume(PCM_VOLUME_1 / 2);
+
+	value_type in_place[N];
+	std::copy_n(&_src[0], N, in_place);
+	pv2.ApplyInPlace({in_place, sizeof(in_place)});
+	CPPUNIT_ASSERT_EQUAL(0, memcmp(in_place, dest.data, dest.size));
+	pv2.Close();
+
 	pv.Close();
 }
 
@@ -0,0 +1,197 @@
+/*
+ * Unit tests for playlist::BeginBulk() and playlist::CommitBulk().
+ */
+
+#include "config.h"
+#include "queue/Playlist.hxx"
+#include "queue/Listener.hxx"
+#include "player/Control.hxx"
+#include "player/Listener.hxx"
+#include "output/MultipleOutputs.hxx"
+#include "mixer/Listener.hxx"
+#include "DetachedSong.hxx"
+#include "SongLoader.hxx"
+#include "playlist/PlaylistSong.hxx"
+#include "Idle.hxx"
+#include "Log.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <stdlib.h>
+
+Tag::Tag(const Tag &) {}
+void Tag::Clear() {}
+
+void
+idle_add(gcc_unused unsigned flags)
+{
+}
+
+void
+FormatDebug(gcc_unused const Domain &domain, gcc_unused const char *fmt, ...)
+{
+}
+
+DetachedSong *
+SongLoader::LoadSong(gcc_unused const char *uri_utf8,
+		     gcc_unused Error &error) const
+{
+	return nullptr;
+}
+
+bool
+playlist_check_translate_song(gcc_unused DetachedSong &song,
+			      gcc_unused const char *base_uri,
+			      gcc_unused const SongLoader &loader)
+{
+	return false;
+}
+
+/* the player is never started in this test, and it doesn't use any
+   audio output */
+
+MultipleOutputs::MultipleOutputs(MixerListener &_mixer_listener,
+				 unsigned _history_size)
+	:mixer_listener(_mixer_listener), history_size(_history_size) {}
+
+MultipleOutputs::~MultipleOutputs() {}
+
+class NullMixerListener final : public MixerListener {
+public:
+	void OnMixerVolumeChanged(gcc_unused Mixer &mixer,
+				  gcc_unused int volume) override {}
+};
+
+class NullPlayerListener final : public PlayerListener {
+public:
+	void OnPlayerSync() override {}
+	void OnPlayerTagModified() override {}
+};
+
+class CountingQueueListener final : public QueueListener {
+public:
+	unsigned n_modified = 0;
+
+	void OnQueueModified() override {
+		++n_modified;
+	}
+
+	void OnQueueOptionsChanged() override {}
+	void OnQueueSongStarted() override {}
+	void OnQueueResolveSong(gcc_unused unsigned position) override {}
+};
+
+class PlaylistBulkTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(PlaylistBulkTest);
+	CPPUNIT_TEST(TestSingle);
+	CPPUNIT_TEST(TestNested);
+	CPPUNIT_TEST(TestNestedUnmodified);
+	CPPUNIT_TEST_SUITE_END();
+
+	NullMixerListener mixer_listener;
+	MultipleOutputs outputs{mixer_listener};
+	NullPlayerListener player_listener;
+	PlayerControl pc{player_listener, outputs, 64, 0, 4096,
+			 HugeAllocateOptions(), 16, false,
+			 SongTime::zero(), SongTime::zero(), 1};
+	CountingQueueListener listener;
+	playlist pl{16, listener};
+
+public:
+	void TestSingle();
+	void TestNested();
+	void TestNestedUnmodified();
+};
+
+void
+PlaylistBulkTest::TestSingle()
+{
+	const auto version = pl.GetVersion();
+
+	pl.BeginBulk();
+	pl.AppendSong(pc, DetachedSong("a.ogg"));
+	pl.AppendSong(pc, DetachedSong("b.ogg"));
+	CPPUNIT_ASSERT_EQUAL(0u, listener.n_modified);
+	CPPUNIT_ASSERT_EQUAL(version, pl.GetVersion());
+
+	pl.CommitBulk(pc);
+	CPPUNIT_ASSERT_EQUAL(1u, listener.n_modified);
+	CPPUNIT_ASSERT_EQUAL(version + 1, pl.GetVersion());
+	CPPUNIT_ASSERT_EQUAL(2u, pl.GetLength());
+
+	/* outside of a bulk edit, each modification is applied
+	   right away */
+	pl.AppendSong(pc, DetachedSong("c.ogg"));
+	CPPUNIT_ASSERT_EQUAL(2u, listener.n_modified);
+	CPPUNIT_ASSERT_EQUAL(version + 2, pl.GetVersion());
+}
+
+/**
+ * A bulk edit within another one, e.g. "findadd" in a command list:
+ * only the outermost CommitBulk() applies the modifications.
+ */
+void
+PlaylistBulkTest::TestNested()
+{
+	const auto version = pl.GetVersion();
+
+	pl.BeginBulk();
+	pl.AppendSong(pc, DetachedSong("a.ogg"));
+
+	pl.BeginBulk();
+	pl.AppendSong(pc, DetachedSong("b.ogg"));
+	pl.CommitBulk(pc);
+
+	CPPUNIT_ASSERT_EQUAL(0u, listener.n_modified);
+	CPPUNIT_ASSERT_EQUAL(version, pl.GetVersion());
+
+	/* still in bulk edit mode */
+	pl.AppendSong(pc, DetachedSong("c.ogg"));
+	CPPUNIT_ASSERT_EQUAL(0u, listener.n_modified);
+
+	pl.CommitBulk(pc);
+	CPPUNIT_ASSERT_EQUAL(1u, listener.n_modified);
+	CPPUNIT_ASSERT_EQUAL(version + 1, pl.GetVersion());
+	CPPUNIT_ASSERT_EQUAL(3u, pl.GetLength());
+	CPPUNIT_ASSERT_EQUAL(0u, pl.bulk_edit);
+}
+
+/**
+ * The inner bulk edit modifies the queue, the outer one doesn't:
+ * the modification must not get lost.
+ */
+void
+PlaylistBulkTest::TestNestedUnmodified()
+{
+	const auto version = pl.GetVersion();
+
+	pl.BeginBulk();
+
+	pl.BeginBulk();
+	pl.AppendSong(pc, DetachedSong("a.ogg"));
+	pl.CommitBulk(pc);
+
+	pl.BeginBulk();
+	pl.CommitBulk(pc);
+
+	CPPUNIT_ASSERT_EQUAL(0u, listener.n_modified);
+
+	pl.CommitBulk(pc);
+	CPPUNIT_ASSERT_EQUAL(1u, listener.n_modified);
+	CPPUNIT_ASSERT_EQUAL(version + 1, pl.GetVersion());
+	CPPUNIT_ASSERT_EQUAL(0u, pl.bulk_edit);
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(PlaylistBulkTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
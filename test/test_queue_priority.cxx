@@ -8,6 +8,10 @@
 #include <cppunit/ui/text/TestRunner.h>
 #include <cppunit/extensions/HelperMacros.h>
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
 Tag::Tag(const Tag &) {}
 void Tag::Clear() {}
 
@@ -27,13 +31,43 @@ check_descending_priority(const Queue *queue,
 	}
 }
 
+/**
+ * Check that Queue::PositionToOrder() is the inverse of
+ * Queue::OrderToPosition().
+ */
+static void
+check_order(const Queue &queue)
+{
+	for (unsigned position = 0; position < queue.GetLength(); ++position)
+		CPPUNIT_ASSERT_EQUAL(position,
+				     queue.OrderToPosition(queue.PositionToOrder(position)));
+}
+
+/**
+ * Return the URIs of all songs, in playback order.
+ */
+static std::vector<std::string>
+get_order_uris(const Queue &queue)
+{
+	std::vector<std::string> result;
+	for (unsigned i = 0; i < queue.GetLength(); ++i)
+		result.emplace_back(queue.GetOrder(i).GetURI());
+	return result;
+}
+
 class QueuePriorityTest : public CppUnit::TestFixture {
 	CPPUNIT_TEST_SUITE(QueuePriorityTest);
 	CPPUNIT_TEST(TestPriority);
+	CPPUNIT_TEST(TestMoveDelete);
+	CPPUNIT_TEST(TestPriorityRange);
+	CPPUNIT_TEST(TestChanges);
 	CPPUNIT_TEST_SUITE_END();
 
 public:
 	void TestPriority();
+	void TestMoveDelete();
+	void TestPriorityRange();
+	void TestChanges();
 };
 
 void
@@ -193,6 +227,177 @@ QueuePriorityTest::TestPriority()
 	CPPUNIT_ASSERT_EQUAL(6u, a_order);
 }
 
+void
+QueuePriorityTest::TestMoveDelete()
+{
+	static const char *const uris[] = {
+		"0.ogg", "1.ogg", "2.ogg", "3.ogg",
+		"4.ogg", "5.ogg", "6.ogg", "7.ogg",
+		"8.ogg", "9.ogg", "a.ogg", "b.ogg",
+	};
+
+	Queue queue(32);
+
+	for (auto uri : uris)
+		queue.Append(DetachedSong(uri), 0);
+
+	queue.random = true;
+	queue.ShuffleOrder();
+	check_order(queue);
+
+	/* moving songs physically must not change the playback
+	   order */
+
+	auto expected = get_order_uris(queue);
+
+	queue.MovePostion(2, 9);
+	check_order(queue);
+	CPPUNIT_ASSERT(expected == get_order_uris(queue));
+
+	queue.MovePostion(10, 1);
+	check_order(queue);
+	CPPUNIT_ASSERT(expected == get_order_uris(queue));
+
+	queue.MoveRange(3, 6, 7);
+	check_order(queue);
+	CPPUNIT_ASSERT(expected == get_order_uris(queue));
+
+	queue.MoveRange(8, 12, 0);
+	check_order(queue);
+	CPPUNIT_ASSERT(expected == get_order_uris(queue));
+
+	queue.SwapPositions(0, 11);
+	queue.SwapOrders(queue.PositionToOrder(0), queue.PositionToOrder(11));
+	check_order(queue);
+	CPPUNIT_ASSERT(expected == get_order_uris(queue));
+
+	/* deleting a song removes only that one from the order */
+
+	const std::string deleted = queue.Get(5).GetURI();
+	expected.erase(std::find(expected.begin(), expected.end(), deleted));
+
+	queue.DeletePosition(5);
+	check_order(queue);
+	CPPUNIT_ASSERT(expected == get_order_uris(queue));
+
+	/* in normal mode, the order equals the position */
+
+	queue.random = false;
+	queue.RestoreOrder();
+	queue.MovePostion(0, 7);
+	queue.DeletePosition(3);
+	queue.MoveRange(1, 4, 5);
+
+	for (unsigned i = 0; i < queue.GetLength(); ++i)
+		CPPUNIT_ASSERT_EQUAL(i, queue.PositionToOrder(i));
+}
+
+void
+QueuePriorityTest::TestPriorityRange()
+{
+	Queue queue(32);
+
+	for (unsigned i = 0; i < 16; ++i)
+		queue.Append(DetachedSong(std::to_string(i) + ".ogg"), 0);
+
+	queue.random = true;
+	queue.ShuffleOrder();
+
+	/* without a current song, the whole range goes to the
+	   front */
+
+	queue.SetPriorityRange(0, 8, 10, -1);
+	check_order(queue);
+	check_descending_priority(&queue, 0);
+
+	for (unsigned i = 0; i < 8; ++i)
+		CPPUNIT_ASSERT(queue.PositionToOrder(i) < 8);
+
+	/* with a current song, the higher priority group is
+	   inserted right after it */
+
+	const unsigned current_order = 3;
+	const unsigned current_position =
+		queue.OrderToPosition(current_order);
+
+	queue.SetPriorityRange(8, 16, 20, current_order);
+	check_order(queue);
+	CPPUNIT_ASSERT_EQUAL(current_order,
+			     queue.PositionToOrder(current_position));
+	check_descending_priority(&queue, current_order + 1);
+
+	for (unsigned i = 8; i < 16; ++i) {
+		CPPUNIT_ASSERT(queue.PositionToOrder(i) > current_order);
+		CPPUNIT_ASSERT(queue.PositionToOrder(i) <= current_order + 8);
+	}
+}
+
+/**
+ * Check that Queue::CollectChanges() finds the same positions as
+ * Queue::IsNewerAtPosition().
+ */
+static void
+check_changes(const Queue &queue, uint32_t version)
+{
+	std::vector<unsigned> expected;
+	for (unsigned i = 0; i < queue.GetLength(); ++i)
+		if (queue.IsNewerAtPosition(i, version))
+			expected.push_back(i);
+
+	std::vector<unsigned> positions;
+	CPPUNIT_ASSERT(queue.CollectChanges(version, 0, queue.GetLength(),
+					    positions));
+	CPPUNIT_ASSERT(expected == positions);
+}
+
+void
+QueuePriorityTest::TestChanges()
+{
+	Queue queue(32);
+
+	for (unsigned i = 0; i < 16; ++i)
+		queue.Append(DetachedSong(std::to_string(i) + ".ogg"), 0);
+	queue.IncrementVersion();
+
+	const uint32_t v1 = queue.version;
+	queue.MovePostion(2, 5);
+	queue.IncrementVersion();
+
+	const uint32_t v2 = queue.version;
+	queue.DeletePosition(10);
+	queue.IncrementVersion();
+
+	const uint32_t v3 = queue.version;
+	queue.SwapPositions(0, 1);
+	queue.SetPriority(7, 5, -1);
+	queue.IncrementVersion();
+
+	for (uint32_t v = 1; v <= queue.version; ++v)
+		check_changes(queue, v);
+
+	std::vector<unsigned> positions;
+	queue.CollectChanges(v3, 0, queue.GetLength(), positions);
+	CPPUNIT_ASSERT(positions == std::vector<unsigned>({0, 1, 7}));
+
+	positions.clear();
+	queue.CollectChanges(v2, 0, queue.GetLength(), positions);
+	CPPUNIT_ASSERT_EQUAL(size_t(3 + 5), positions.size());
+
+	positions.clear();
+	queue.CollectChanges(v1, 3, 6, positions);
+	CPPUNIT_ASSERT(positions == std::vector<unsigned>({3, 4, 5}));
+
+	/* after clearing, the log covers everything again */
+
+	queue.Clear();
+	queue.IncrementVersion();
+	queue.Append(DetachedSong("x.ogg"), 0);
+	queue.IncrementVersion();
+
+	check_changes(queue, 1);
+	check_changes(queue, queue.version);
+}
+
 CPPUNIT_TEST_SUITE_REGISTRATION(QueuePriorityTest);
 
 int
@@ -0,0 +1,226 @@
+/*
+ * Unit tests for class QueueResolver.
+ */
+
+#include "config.h"
+#include "QueueResolver.hxx"
+#include "Partition.hxx"
+#include "Instance.hxx"
+#include "DetachedSong.hxx"
+#include "SongLoader.hxx"
+#include "playlist/PlaylistSong.hxx"
+#include "mixer/Volume.hxx"
+#include "event/DeferredMonitor.hxx"
+#include "util/StringCompare.hxx"
+#include "Idle.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string.h>
+#include <stdlib.h>
+
+Tag::Tag(const Tag &) {}
+void Tag::Clear() {}
+
+void
+idle_add(gcc_unused unsigned flags)
+{
+}
+
+void
+InvalidateHardwareVolume()
+{
+}
+
+DetachedSong *
+SongLoader::LoadSong(gcc_unused const char *uri_utf8,
+		     gcc_unused Error &error) const
+{
+	return nullptr;
+}
+
+/**
+ * The last modification time which is set by
+ * playlist_check_translate_song() on success.
+ */
+static constexpr time_t RESOLVED_MTIME = 1234;
+
+/**
+ * Songs below "missing/" cannot be loaded; all others get
+ * #RESOLVED_MTIME.
+ */
+bool
+playlist_check_translate_song(DetachedSong &song,
+			      gcc_unused const char *base_uri,
+			      gcc_unused const SongLoader &loader)
+{
+	if (StringStartsWith(song.GetURI(), "missing/"))
+		return false;
+
+	song.SetLastModified(RESOLVED_MTIME);
+	return true;
+}
+
+/* only the EventLoop of the Instance is used */
+
+#ifdef ENABLE_DATABASE
+
+Database *
+Instance::GetDatabase(gcc_unused Error &error)
+{
+	return nullptr;
+}
+
+void
+Instance::OnDatabaseModified()
+{
+}
+
+void
+Instance::OnDatabaseSongRemoved(gcc_unused const char *uri)
+{
+}
+
+#endif
+
+#ifdef ENABLE_NEIGHBOR_PLUGINS
+
+void
+Instance::FoundNeighbor(gcc_unused const NeighborInfo &info)
+{
+}
+
+void
+Instance::LostNeighbor(gcc_unused const NeighborInfo &info)
+{
+}
+
+#endif
+
+void
+Instance::OnIdle(gcc_unused unsigned flags)
+{
+}
+
+/* the player is never started in this test, and it doesn't use any
+   audio output */
+
+MultipleOutputs::MultipleOutputs(MixerListener &_mixer_listener,
+				 unsigned _history_size)
+	:mixer_listener(_mixer_listener), history_size(_history_size) {}
+
+MultipleOutputs::~MultipleOutputs() {}
+
+/**
+ * Breaks the #EventLoop after all #DeferredMonitor instances which
+ * were scheduled before it.
+ */
+class BreakLoop final : DeferredMonitor {
+public:
+	explicit BreakLoop(EventLoop &_loop):DeferredMonitor(_loop) {
+		DeferredMonitor::Schedule();
+	}
+
+private:
+	void RunDeferred() override {
+		GetEventLoop().Break();
+	}
+};
+
+class QueueResolverTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(QueueResolverTest);
+	CPPUNIT_TEST(TestResolve);
+	CPPUNIT_TEST(TestRunDeferred);
+	CPPUNIT_TEST_SUITE_END();
+
+	Instance instance;
+	Partition partition{instance, 16, 64, 0, 4096,
+			    HugeAllocateOptions(), 16, false,
+			    SongTime::zero(), SongTime::zero(), 1, 0};
+
+	Queue &queue = partition.playlist.queue;
+
+	/**
+	 * Append an item like queue_load_song() does when reading
+	 * the state file.
+	 */
+	unsigned AppendUnresolved(const char *uri) {
+		const unsigned id = queue.Append(DetachedSong(uri), 0);
+		queue.SetUnresolvedAtPosition(queue.IdToPosition(id), true);
+		return id;
+	}
+
+public:
+	void TestResolve();
+	void TestRunDeferred();
+};
+
+/**
+ * Resolving an item right away, before it is passed to the player.
+ */
+void
+QueueResolverTest::TestResolve()
+{
+	AppendUnresolved("a.ogg");
+	AppendUnresolved("missing/b.ogg");
+
+	partition.queue_resolver.Resolve(0);
+	CPPUNIT_ASSERT(!queue.IsUnresolvedAtPosition(0));
+	CPPUNIT_ASSERT_EQUAL(RESOLVED_MTIME, queue.Get(0).GetLastModified());
+
+	/* a song which cannot be loaded stays in the queue (the
+	   player will report the error), and it is still flagged */
+	partition.queue_resolver.Resolve(1);
+	CPPUNIT_ASSERT_EQUAL(2u, queue.GetLength());
+	CPPUNIT_ASSERT(queue.IsUnresolvedAtPosition(1));
+	CPPUNIT_ASSERT(strcmp(queue.Get(1).GetURI(), "missing/b.ogg") == 0);
+	CPPUNIT_ASSERT_EQUAL(time_t(0), queue.Get(1).GetLastModified());
+}
+
+/**
+ * Resolving in the background: songs which cannot be loaded are
+ * removed from the queue.
+ */
+void
+QueueResolverTest::TestRunDeferred()
+{
+	const unsigned a = AppendUnresolved("a.ogg");
+	const unsigned b = AppendUnresolved("missing/b.ogg");
+	const unsigned c = AppendUnresolved("c.ogg");
+	const unsigned d = AppendUnresolved("missing/d.ogg");
+
+	for (unsigned id : {a, b, c, d})
+		partition.queue_resolver.Add(id);
+
+	/* resolved already; must be skipped */
+	partition.queue_resolver.Resolve(queue.IdToPosition(c));
+
+	BreakLoop break_loop(instance.event_loop);
+	instance.event_loop.Run();
+
+	CPPUNIT_ASSERT_EQUAL(2u, queue.GetLength());
+	CPPUNIT_ASSERT_EQUAL(-1, queue.IdToPosition(b));
+	CPPUNIT_ASSERT_EQUAL(-1, queue.IdToPosition(d));
+
+	for (unsigned id : {a, c}) {
+		const int position = queue.IdToPosition(id);
+		CPPUNIT_ASSERT(position >= 0);
+		CPPUNIT_ASSERT(!queue.IsUnresolvedAtPosition(position));
+		CPPUNIT_ASSERT_EQUAL(RESOLVED_MTIME,
+				     queue.Get(position).GetLastModified());
+	}
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(QueueResolverTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
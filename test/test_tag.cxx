@@ -0,0 +1,118 @@
+/*
+ * Unit tests for the copy-on-write #Tag item array.
+ */
+
+#include "config.h"
+#include "tag/Tag.hxx"
+#include "tag/TagBuilder.hxx"
+
+#include <cppunit/TestFixture.h>
+#include <cppunit/extensions/TestFactoryRegistry.h>
+#include <cppunit/ui/text/TestRunner.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string.h>
+#include <stdlib.h>
+
+static Tag
+MakeTag(const char *artist, const char *title)
+{
+	TagBuilder builder;
+	builder.AddItem(TAG_ARTIST, artist);
+	builder.AddItem(TAG_TITLE, title);
+	return builder.Commit();
+}
+
+static bool
+HasValue(const Tag &tag, TagType type, const char *value)
+{
+	const char *actual = tag.GetValue(type);
+	return actual != nullptr && strcmp(actual, value) == 0;
+}
+
+class TagTest : public CppUnit::TestFixture {
+	CPPUNIT_TEST_SUITE(TagTest);
+	CPPUNIT_TEST(TestCopy);
+	CPPUNIT_TEST(TestCommitIntoShared);
+	CPPUNIT_TEST(TestTakeShared);
+	CPPUNIT_TEST(TestTakeUnique);
+	CPPUNIT_TEST_SUITE_END();
+
+public:
+	void TestCopy() {
+		const Tag a = MakeTag("foo", "bar");
+		const Tag b(a);
+
+		CPPUNIT_ASSERT(b.Equals(a));
+		CPPUNIT_ASSERT(HasValue(b, TAG_ARTIST, "foo"));
+		CPPUNIT_ASSERT(HasValue(b, TAG_TITLE, "bar"));
+	}
+
+	/**
+	 * Committing into a #Tag whose item array is shared with a
+	 * copy must not modify the copy.
+	 */
+	void TestCommitIntoShared() {
+		Tag a = MakeTag("foo", "bar");
+		const Tag b(a);
+
+		TagBuilder builder;
+		builder.AddItem(TAG_ALBUM, "baz");
+		builder.Commit(a);
+
+		CPPUNIT_ASSERT(!a.HasType(TAG_ARTIST));
+		CPPUNIT_ASSERT(HasValue(a, TAG_ALBUM, "baz"));
+
+		CPPUNIT_ASSERT(!b.HasType(TAG_ALBUM));
+		CPPUNIT_ASSERT(HasValue(b, TAG_ARTIST, "foo"));
+		CPPUNIT_ASSERT(HasValue(b, TAG_TITLE, "bar"));
+	}
+
+	/**
+	 * Moving a #Tag with a shared item array into a #TagBuilder
+	 * duplicates the items and leaves the copy alone.
+	 */
+	void TestTakeShared() {
+		Tag a = MakeTag("foo", "bar");
+		const Tag b(a);
+
+		TagBuilder builder(std::move(a));
+		CPPUNIT_ASSERT(a.IsEmpty());
+
+		builder.AddItem(TAG_ALBUM, "baz");
+		const Tag c = builder.Commit();
+
+		CPPUNIT_ASSERT(HasValue(c, TAG_ARTIST, "foo"));
+		CPPUNIT_ASSERT(HasValue(c, TAG_ALBUM, "baz"));
+
+		CPPUNIT_ASSERT(!b.HasType(TAG_ALBUM));
+		CPPUNIT_ASSERT(HasValue(b, TAG_ARTIST, "foo"));
+		CPPUNIT_ASSERT(HasValue(b, TAG_TITLE, "bar"));
+	}
+
+	/**
+	 * The only reference: the items are moved without touching
+	 * the tag pool.
+	 */
+	void TestTakeUnique() {
+		Tag a = MakeTag("foo", "bar");
+
+		TagBuilder builder(std::move(a));
+		CPPUNIT_ASSERT(a.IsEmpty());
+
+		const Tag c = builder.Commit();
+		CPPUNIT_ASSERT(HasValue(c, TAG_ARTIST, "foo"));
+		CPPUNIT_ASSERT(HasValue(c, TAG_TITLE, "bar"));
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TagTest);
+
+int
+main(gcc_unused int argc, gcc_unused char **argv)
+{
+	CppUnit::TextUi::TestRunner runner;
+	auto &registry = CppUnit::TestFactoryRegistry::getRegistry();
+	runner.addTest(registry.makeTest());
+	return runner.run() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -7,6 +7,10 @@
 #include "SplitStringTest.hxx"
 #include "UriUtilTest.hxx"
 #include "TestCircularBuffer.hxx"
+#include "TestLatencyHistogram.hxx"
+#include "TestSlabAllocator.hxx"
+#include "TestStringBuilder.hxx"
+#include "TestUTF8.hxx"
 
 #include <cppunit/TestFixture.h>
 #include <cppunit/extensions/TestFactoryRegistry.h>
@@ -19,6 +23,10 @@ CPPUNIT_TEST_SUITE_REGISTRATION(DivideStringTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(SplitStringTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(UriUtilTest);
 CPPUNIT_TEST_SUITE_REGISTRATION(TestCircularBuffer);
+CPPUNIT_TEST_SUITE_REGISTRATION(TestLatencyHistogram);
+CPPUNIT_TEST_SUITE_REGISTRATION(TestSlabAllocator);
+CPPUNIT_TEST_SUITE_REGISTRATION(TestStringBuilder);
+CPPUNIT_TEST_SUITE_REGISTRATION(TestUTF8);
 
 int
 main(gcc_unused int argc, gcc_unused char **argv)